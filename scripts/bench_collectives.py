@@ -0,0 +1,248 @@
+#!/usr/bin/env python
+"""Measures the latency and bandwidth of the XLA collectives.
+
+Every configuration (operation, message size, dtype and replica groups layout)
+is run on all the replicas launched by `xmp.spawn()`, and reported as a JSON
+line. The `algbw` is the message size over the step time, while the `busbw`
+scales it by the fraction of the data each replica has to send or receive,
+which makes the numbers of the different operations and group sizes
+comparable to the link bandwidth.
+"""
+
+from __future__ import print_function
+
+import argparse
+import json
+import sys
+import time
+import torch
+import torch_xla
+import torch_xla.core.xla_model as xm
+import torch_xla.distributed.xla_multiprocessing as xmp
+
+_OPS = ('all_reduce', 'all_gather', 'reduce_scatter', 'all_to_all',
+        'collective_permute')
+
+_DTYPES = {
+    'float32': torch.float32,
+    'bfloat16': torch.bfloat16,
+    'float16': torch.float16,
+    'int32': torch.int32,
+}
+
+_SIZE_SUFFIXES = {'K': 1 << 10, 'M': 1 << 20, 'G': 1 << 30}
+
+
+def parse_size(size):
+  size = size.strip().upper().rstrip('B')
+  if size and size[-1] in _SIZE_SUFFIXES:
+    return int(size[:-1]) * _SIZE_SUFFIXES[size[-1]]
+  return int(size)
+
+
+def get_sizes(args):
+  sizes = []
+  size = parse_size(args.min_size)
+  max_size = parse_size(args.max_size)
+  while size <= max_size:
+    sizes.append(size)
+    size *= args.size_factor
+  return sizes
+
+
+def get_groups(layout, group_size, world_size):
+  """Returns the replica groups, as accepted by the collectives APIs.
+
+  The `contiguous` layout groups neighbouring replicas (like the cores of a
+  chip), while the `strided` one puts replicas far apart in the same group.
+  Every group is turned into the XLA replica groups by `CreateReduceGroups()`.
+  """
+  if group_size == world_size:
+    return None
+  num_groups = world_size // group_size
+  if layout == 'contiguous':
+    return [
+        list(range(g * group_size, (g + 1) * group_size))
+        for g in range(num_groups)
+    ]
+  return [list(range(g, world_size, num_groups)) for g in range(num_groups)]
+
+
+def bus_factor(op, group_size):
+  # The fraction of the message every replica sends over the links, as in the
+  # NCCL tests conventions.
+  if op == 'all_reduce':
+    return 2.0 * (group_size - 1) / group_size
+  if op == 'collective_permute':
+    return 1.0
+  return float(group_size - 1) / group_size
+
+
+def make_step_fn(op, groups, group_size, world_size, dtype):
+  scale = 1.0 / group_size if dtype.is_floating_point else 1.0
+  if op == 'all_reduce':
+    return lambda x: xm.all_reduce(
+        xm.REDUCE_SUM, x, scale=scale, groups=groups)
+  if op == 'all_gather':
+    return lambda x: xm.all_gather(x, dim=0, groups=groups)
+  if op == 'reduce_scatter':
+    return lambda x: xm.reduce_scatter(
+        xm.REDUCE_SUM, x, scale=scale, scatter_dim=0, groups=groups)
+  if op == 'all_to_all':
+    return lambda x: xm.all_to_all(
+        x, split_dimension=0, concat_dimension=0, split_count=group_size,
+        groups=groups)
+  # A ring within every group.
+  pairs = []
+  for group in groups or [list(range(world_size))]:
+    for i, replica in enumerate(group):
+      pairs.append([replica, group[(i + 1) % len(group)]])
+  return lambda x: xm.collective_permute(x, pairs)
+
+
+def input_numel(op, size, dtype, group_size):
+  # The message size is the one of the all-gather output, and of the input of
+  # the other operations. The splitting operations need a multiple of the
+  # group size.
+  numel = max(size // torch.tensor([], dtype=dtype).element_size(), 1)
+  numel = (numel + group_size - 1) // group_size * group_size
+  if op == 'all_gather':
+    numel //= group_size
+  return numel
+
+
+def run_config(op, size, dtype_name, layout, group_size, args):
+  device = xm.xla_device()
+  world_size = xm.xrt_world_size()
+  dtype = _DTYPES[dtype_name]
+  groups = get_groups(layout, group_size, world_size)
+  step_fn = make_step_fn(op, groups, group_size, world_size, dtype)
+  numel = input_numel(op, size, dtype, group_size)
+  value = torch.ones(numel, dtype=dtype, device=device)
+  msg_bytes = numel * value.element_size()
+  if op == 'all_gather':
+    msg_bytes *= group_size
+
+  def run_steps(count):
+    step_input = value
+    for _ in range(count):
+      result = step_fn(step_input)
+      # The all-reduce result has the input shape, so it is chained across the
+      # steps. The others start from the same input every step.
+      if op == 'all_reduce':
+        step_input = result
+      xm.mark_step()
+    xm.wait_device_ops()
+
+  tag = '{}.{}.{}.{}.{}'.format(op, size, dtype_name, layout, group_size)
+  run_steps(args.warmup_steps)
+  xm.rendezvous(tag)
+  start = time.time()
+  run_steps(args.steps)
+  elapsed = (time.time() - start) / args.steps
+  # The slowest replica determines the step time.
+  elapsed = xm.mesh_reduce(tag, elapsed, max)
+  algbw = msg_bytes / elapsed / 1e9
+  return {
+      'op': op,
+      'bytes': msg_bytes,
+      'dtype': dtype_name,
+      'layout': layout if groups else 'all',
+      'group_size': group_size,
+      'world_size': world_size,
+      'device': xm.xla_device_hw(device),
+      'latency_us': elapsed * 1e6,
+      'algbw_gbps': algbw,
+      'busbw_gbps': algbw * bus_factor(op, group_size),
+  }
+
+
+def get_configs(args, world_size, device_hw):
+  group_sizes = [world_size]
+  if args.group_sizes:
+    group_sizes = [int(x) for x in args.group_sizes.split(',')]
+  for op in args.ops.split(','):
+    assert op in _OPS, 'Unknown collective: {}'.format(op)
+    for group_size in group_sizes:
+      if group_size > world_size or world_size % group_size != 0:
+        continue
+      layouts = args.layouts.split(',') if group_size < world_size else ['all']
+      for layout in layouts:
+        # Only the TPU all-gather supports replica groups.
+        if (op == 'all_gather' and group_size < world_size and
+            device_hw != 'TPU'):
+          continue
+        for dtype_name in args.dtypes.split(','):
+          for size in get_sizes(args):
+            yield op, size, dtype_name, layout, group_size
+
+
+def config_key(record):
+  return (record['op'], record['bytes'], record['dtype'], record['layout'],
+          record['group_size'], record['world_size'])
+
+
+def load_baseline(path):
+  baseline = dict()
+  with open(path, 'r') as fd:
+    for line in fd:
+      line = line.strip()
+      if line:
+        record = json.loads(line)
+        baseline[config_key(record)] = record
+  return baseline
+
+
+def _mp_fn(index, args):
+  world_size = xm.xrt_world_size()
+  device_hw = xm.xla_device_hw(xm.xla_device())
+  is_master = xm.is_master_ordinal(local=False)
+  baseline = load_baseline(args.baseline) if args.baseline else dict()
+  output = open(args.output, 'w') if args.output and is_master else None
+  regressions = []
+  for config in get_configs(args, world_size, device_hw):
+    record = run_config(*config, args=args)
+    if not is_master:
+      continue
+    base = baseline.get(config_key(record), None)
+    if base is not None:
+      record['baseline_busbw_gbps'] = base['busbw_gbps']
+      if record['busbw_gbps'] < base['busbw_gbps'] * (1.0 - args.tolerance):
+        regressions.append(record)
+    line = json.dumps(record, sort_keys=True)
+    print(line)
+    if output is not None:
+      print(line, file=output)
+      output.flush()
+  if output is not None:
+    output.close()
+  if regressions:
+    print(
+        '{} configurations regressed by more than {:.0f}% against {}'.format(
+            len(regressions), args.tolerance * 100.0, args.baseline),
+        file=sys.stderr)
+    sys.exit(1)
+
+
+if __name__ == '__main__':
+  arg_parser = argparse.ArgumentParser()
+  arg_parser.add_argument('--ops', type=str, default=','.join(_OPS))
+  arg_parser.add_argument('--dtypes', type=str, default='float32,bfloat16')
+  arg_parser.add_argument('--min_size', type=str, default='1K')
+  arg_parser.add_argument('--max_size', type=str, default='1G')
+  arg_parser.add_argument('--size_factor', type=int, default=4)
+  # The sizes of the replica groups, all the replicas if not set.
+  arg_parser.add_argument('--group_sizes', type=str, default=None)
+  arg_parser.add_argument(
+      '--layouts', type=str, default='contiguous,strided')
+  arg_parser.add_argument('--warmup_steps', type=int, default=2)
+  arg_parser.add_argument('--steps', type=int, default=10)
+  arg_parser.add_argument('--num_cores', type=int, default=None)
+  # The JSON lines file the results are written to.
+  arg_parser.add_argument('--output', type=str, default=None)
+  # A previous output to compare with, failing if the bus bandwidth of any
+  # configuration drops by more than the tolerance.
+  arg_parser.add_argument('--baseline', type=str, default=None)
+  arg_parser.add_argument('--tolerance', type=float, default=0.1)
+  args, pos_args = arg_parser.parse_known_args()
+  xmp.spawn(_mp_fn, args=(args,), nprocs=args.num_cores)
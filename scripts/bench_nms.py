@@ -0,0 +1,87 @@
+#!/usr/bin/env python
+
+from __future__ import print_function
+
+import argparse
+import time
+import torch
+import torch_xla
+import torch_xla.core.functions as xf
+import torch_xla.core.xla_model as xm
+import torch_xla.debug.metrics as met
+
+
+def gen_inputs(args, device):
+  corners = torch.rand(args.batch, args.boxes, 2, 2) * 512.0
+  boxes = torch.cat([corners.min(-2)[0], corners.max(-2)[0]], dim=-1)
+  scores = torch.rand(args.batch, args.classes, args.boxes)
+  return (boxes.to(device), scores.to(device),
+          torch.tensor(args.score_threshold, device=device),
+          torch.tensor(args.iou_threshold, device=device))
+
+
+def batched_nms(args, boxes, scores, score_threshold, iou_threshold):
+  return xf.nms(
+      boxes,
+      scores,
+      score_threshold,
+      iou_threshold,
+      args.output_size,
+      top_k=args.top_k if args.top_k > 0 else None)
+
+
+def loop_nms(args, boxes, scores, score_threshold, iou_threshold):
+  # What detection heads do without batched NMS support, one problem at a time.
+  results = []
+  for b in range(0, args.batch):
+    for c in range(0, args.classes):
+      results.append(
+          xf.nms(boxes[b], scores[b, c], score_threshold, iou_threshold,
+                 args.output_size))
+  return results
+
+
+def run_nms(fn, args, inputs):
+  for _ in range(0, 2):
+    result = fn(args, *inputs)
+    xm.mark_step()
+  xm.wait_device_ops()
+  start = time.time()
+  for _ in range(0, args.test_count):
+    result = fn(args, *inputs)
+    xm.mark_step()
+  xm.wait_device_ops()
+  return (time.time() - start) / args.test_count
+
+
+def run_benchmark(args, pos_args):
+  device = xm.xla_device()
+  inputs = gen_inputs(args, device)
+  fns = [('Batched', batched_nms)]
+  if args.loop:
+    fns.append(('Loop', loop_nms))
+  for name, fn in fns:
+    step_time = run_nms(fn, args, inputs)
+    print('{}: Batch={} Classes={} Boxes={} TopK={} StepTime={:.3f}ms'.format(
+        name, args.batch, args.classes, args.boxes, args.top_k,
+        step_time * 1000.0))
+  if args.metrics:
+    print(met.metrics_report())
+
+
+if __name__ == '__main__':
+  # The defaults are the typical COCO detection shapes, with 80 classes and the
+  # 1000 highest scoring candidates of every class going through the NMS.
+  arg_parser = argparse.ArgumentParser()
+  arg_parser.add_argument('--test_count', type=int, default=10)
+  arg_parser.add_argument('--batch', type=int, default=8)
+  arg_parser.add_argument('--classes', type=int, default=80)
+  arg_parser.add_argument('--boxes', type=int, default=5000)
+  arg_parser.add_argument('--top_k', type=int, default=1000)
+  arg_parser.add_argument('--output_size', type=int, default=100)
+  arg_parser.add_argument('--score_threshold', type=float, default=0.05)
+  arg_parser.add_argument('--iou_threshold', type=float, default=0.5)
+  arg_parser.add_argument('--loop', action='store_true')
+  arg_parser.add_argument('--metrics', action='store_true')
+  args, pos_args = arg_parser.parse_known_args()
+  run_benchmark(args, pos_args)
@@ -0,0 +1,67 @@
+#!/usr/bin/env python
+
+from __future__ import print_function
+
+import argparse
+import threading
+import time
+import torch
+import torch_xla
+import torch_xla.debug.metrics as met
+import torch_xla.core.xla_model as xm
+
+
+def run_steps(devices, args):
+  # Tiny per replica graphs, so that the step time is dominated by the host
+  # side dispatch of the executions.
+  tensors = [torch.zeros(args.size, device=device) for device in devices]
+  barrier = threading.Barrier(len(devices) + 1)
+
+  def threadfn(i):
+    t = tensors[i]
+    barrier.wait()
+    for _ in range(0, args.test_count):
+      t = t + 1
+      torch_xla._XLAC._xla_sync_multi([t], devices=[], wait=True)
+    barrier.wait()
+
+  threads = []
+  for i in range(0, len(devices)):
+    thread = threading.Thread(target=threadfn, args=(i,))
+    thread.start()
+    threads.append(thread)
+  barrier.wait()
+  start = time.time()
+  barrier.wait()
+  elapsed = time.time() - start
+  for thread in threads:
+    thread.join()
+  return elapsed / args.test_count
+
+
+def run_benchmark(args, pos_args):
+  all_devices = xm.get_xla_supported_devices()
+  counts = [int(x) for x in args.replicas.split(',')]
+  for count in counts:
+    if count > len(all_devices):
+      print('Skipping {} replicas, only {} devices available'.format(
+          count, len(all_devices)))
+      continue
+    devices = all_devices[:count]
+    # Warm up the compilations and the sessions.
+    run_steps(devices, argparse.Namespace(size=args.size, test_count=2))
+    step_time = run_steps(devices, args)
+    print('Replicas={} StepTime={:.3f}ms PerReplica={:.3f}ms'.format(
+        count, step_time * 1000.0, step_time * 1000.0 / count))
+  if args.metrics:
+    print(met.metrics_report())
+
+
+if __name__ == '__main__':
+  arg_parser = argparse.ArgumentParser()
+  arg_parser.add_argument('--test_count', type=int, default=100)
+  arg_parser.add_argument('--replicas', type=str, default='1,2,4,8')
+  arg_parser.add_argument('--size', type=int, default=16)
+  arg_parser.add_argument('--metrics', action='store_true')
+  args, pos_args = arg_parser.parse_known_args()
+  run_benchmark(args, pos_args)
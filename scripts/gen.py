@@ -206,6 +206,7 @@ _CPP_HEADER = """// Autogenerated file by {gen}. Do not edit directly!
 #include "tensorflow/compiler/xla/xla_client/tf_logging.h"
 #include "torch_xla/csrc/aten_xla_bridge.h"
 #include "torch_xla/csrc/aten_xla_type.h"
+#include "torch_xla/csrc/fallback_tracker.h"
 
 namespace torch_xla {{
 
@@ -791,6 +792,9 @@ def generate_aten_to_xla(ctx, tree, rwxtree, fname, sig, rwsig, params, fnopts):
 
   code = '{} {{\n'.format(sig)
   code += generate_entry_debug_code(tree, fname, params, fname_ns='aten')
+  # The scope spans the whole function, so that it accounts for the transfers
+  # of both the inputs and the results.
+  code += '  FallbackScope fallback_scope("aten::{}");\n'.format(fname)
   xla_ref_param = param_name(ref_param) if ref_param else None
   tfetcher = TensorFetcher('xlatens')
   param_vars = []
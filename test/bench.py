@@ -11,6 +11,8 @@ sys.path.insert(0, _XLA_FOLDER)
 # Normal imports section starts here.
 import argparse
 import inspect
+import json
+import math
 import re
 import time
 import torch
@@ -19,6 +21,7 @@ import torch.optim as optim
 import torch_xla
 import torch_xla.distributed.data_parallel as dp
 import torch_xla.debug.metrics as met
+import torch_xla.debug.metrics_compare_utils as mcu
 import torch_xla.debug.model_comparator as mc
 import torch_xla.distributed.parallel_loader as pl
 import torch_xla.utils.utils as xu
@@ -101,6 +104,320 @@ class BenchAddMulDivTransfer(BaseBench):
     self.use_results([xla_c])
 
 
+class CumSumBenchBase(BaseBench):
+
+  def setup(self):
+    self.x = torch.randn(self.rows, self.size, device=self.device)
+
+  def bench(self):
+    self.use_results([self.x.cumsum(1)])
+
+
+class BenchCumSum64(CumSumBenchBase):
+  rows, size = 4096, 64
+
+
+class BenchCumSum1K(CumSumBenchBase):
+  rows, size = 256, 1024
+
+
+class BenchCumSum16K(CumSumBenchBase):
+  rows, size = 16, 16 * 1024
+
+
+class BenchCumSum256K(CumSumBenchBase):
+  rows, size = 1, 256 * 1024
+
+
+class TopKBenchBase(BaseBench):
+
+  def setup(self):
+    self.x = torch.randn(self.rows, self.size, device=self.device)
+
+  def bench(self):
+    values, indices = torch.topk(self.x, self.k, dim=1)
+    self.use_results([values, indices])
+
+
+class BenchTopK10Of32K(TopKBenchBase):
+  rows, size, k = 64, 32 * 1024, 10
+
+
+class BenchTopK10Of128K(TopKBenchBase):
+  rows, size, k = 16, 128 * 1024, 10
+
+
+class BenchTopK10Of1M(TopKBenchBase):
+  rows, size, k = 2, 1024 * 1024, 10
+
+
+class BenchTopK100Of1M(TopKBenchBase):
+  rows, size, k = 2, 1024 * 1024, 100
+
+
+class BenchTopK4KOf32K(TopKBenchBase):
+  rows, size, k = 64, 32 * 1024, 4096
+
+
+class ModelBenchBase(BaseBench):
+  """Runs training steps of a model, and reports their performance.
+
+  Every step runs the forward and backward passes and the optimizer step over
+  a fixed device batch (so that the input pipeline is not measured), and waits
+  for the step to complete on the device, so that the step times are the
+  device ones. Subclasses set `batch_size`, and define `make_model()`,
+  `make_batch()` (returning the CPU input tensors) and `loss(model, *batch)`.
+  The returned record has the throughput (samples per second), the step time
+  percentiles, the number of compilations, the fraction of the step time
+  spent on the host side of the graph syncs, and the peak device memory, which
+  is the one of the whole process (so it is exact when a single model
+  benchmark is run).
+  """
+
+  def setup(self):
+    self.steps = xu.getenv_as('BENCH_MODEL_STEPS', int, 20)
+    self.warmup_steps = xu.getenv_as('BENCH_MODEL_WARMUP_STEPS', int, 3)
+    self.model = self.make_model().to(self.device)
+    self.optimizer = optim.SGD(self.model.parameters(), lr=0.01, momentum=0.9)
+    self.batch = [t.to(self.device) for t in self.make_batch()]
+
+  def bench(self):
+    self.optimizer.zero_grad()
+    self.loss(self.model, *self.batch).backward()
+    self.optimizer.step()
+    xm.mark_step()
+    xm.wait_device_ops()
+
+  def run(self):
+    bench_name = self._get_parent_class().__name__
+    try:
+      self.setup()
+      for _ in range(self.warmup_steps):
+        self.bench()
+      snapshot = met.metrics_snapshot()
+      step_times = []
+      for _ in range(self.steps):
+        start = time.time()
+        self.bench()
+        step_times.append(time.time() - start)
+      delta = met.metrics_delta(snapshot)
+    except Exception as e:
+      xu.eprint('Failed running benchmark "{}": {}'.format(bench_name, e))
+      return None
+    total_time = sum(step_times)
+    host_ns = sum(totals[1]
+                  for name, totals in delta['metrics'].items()
+                  if name.startswith('HostOverhead.'))
+    step_times.sort()
+    record = {
+        'samples_per_sec': self.batch_size * len(step_times) / total_time,
+        'step_ms_p50': 1000.0 * _percentile(step_times, 50),
+        'step_ms_p90': 1000.0 * _percentile(step_times, 90),
+        'step_ms_p99': 1000.0 * _percentile(step_times, 99),
+        'compiles': delta['metrics'].get('CompileTime', (0, 0.0))[0],
+        'host_overhead_fraction': host_ns / (total_time * 1e9),
+        'peak_memory_mb': xm.get_memory_info(self.device)['peak_bytes'] / 1e6,
+    }
+    print('{}: {}'.format(bench_name, json.dumps(record, sort_keys=True)))
+    return record
+
+
+def _percentile(sorted_values, percent):
+  index = int(math.ceil(percent / 100.0 * len(sorted_values))) - 1
+  return sorted_values[max(index, 0)]
+
+
+class BenchModelResNet50(ModelBenchBase):
+  batch_size = 64
+
+  def make_model(self):
+    import torchvision
+    return torchvision.models.resnet50()
+
+  def make_batch(self):
+    return (torch.randn(self.batch_size, 3, 224, 224),
+            torch.randint(0, 1000, (self.batch_size,)))
+
+  def loss(self, model, data, target):
+    return nn.functional.cross_entropy(model(data), target)
+
+
+class _TransformerLM(nn.Module):
+
+  def __init__(self, vocab_size, seq_len, d_model, nhead, num_layers, d_ff,
+               causal):
+    super(_TransformerLM, self).__init__()
+    self.causal = causal
+    self.embedding = nn.Embedding(vocab_size, d_model)
+    self.position = nn.Parameter(torch.randn(seq_len, 1, d_model) * 0.02)
+    layer = nn.TransformerEncoderLayer(
+        d_model, nhead, dim_feedforward=d_ff, activation='gelu')
+    self.encoder = nn.TransformerEncoder(layer, num_layers)
+    self.norm = nn.LayerNorm(d_model)
+    self.head = nn.Linear(d_model, vocab_size)
+
+  def forward(self, tokens):
+    # The tokens are (batch, seq), while the encoder works on (seq, batch).
+    x = self.embedding(tokens.t()) + self.position
+    mask = None
+    if self.causal:
+      seq_len = tokens.size(1)
+      mask = torch.triu(
+          torch.full((seq_len, seq_len), float('-inf'), device=x.device),
+          diagonal=1)
+    return self.head(self.norm(self.encoder(x, mask=mask)))
+
+
+class BenchModelBertBase(ModelBenchBase):
+  # BERT-base sizes, trained with a masked language model loss over all the
+  # positions.
+  batch_size, seq_len, vocab_size = 32, 128, 30522
+
+  def make_model(self):
+    return _TransformerLM(
+        self.vocab_size,
+        self.seq_len,
+        d_model=768,
+        nhead=12,
+        num_layers=12,
+        d_ff=3072,
+        causal=False)
+
+  def make_batch(self):
+    tokens = torch.randint(0, self.vocab_size, (self.batch_size, self.seq_len))
+    return tokens, tokens
+
+  def loss(self, model, tokens, target):
+    logits = model(tokens)
+    return nn.functional.cross_entropy(
+        logits.view(-1, self.vocab_size), target.t().reshape(-1))
+
+
+class BenchModelTransformerDecoder(ModelBenchBase):
+  # A GPT style decoder, trained with a next token prediction loss.
+  batch_size, seq_len, vocab_size = 16, 512, 32000
+
+  def make_model(self):
+    return _TransformerLM(
+        self.vocab_size,
+        self.seq_len,
+        d_model=1024,
+        nhead=16,
+        num_layers=8,
+        d_ff=4096,
+        causal=True)
+
+  def make_batch(self):
+    return (torch.randint(0, self.vocab_size,
+                          (self.batch_size, self.seq_len + 1)),)
+
+  def loss(self, model, tokens):
+    logits = model(tokens[:, :-1])
+    return nn.functional.cross_entropy(
+        logits.view(-1, self.vocab_size), tokens[:, 1:].t().reshape(-1))
+
+
+class _Recommender(nn.Module):
+  # A DLRM style model: the sparse features are pooled by embedding bags, and
+  # interact with the dense features through their pairwise dot products.
+
+  def __init__(self, table_sizes, embedding_dim, num_dense):
+    super(_Recommender, self).__init__()
+    self.tables = nn.ModuleList([
+        nn.EmbeddingBag(size, embedding_dim, mode='sum') for size in table_sizes
+    ])
+    self.bottom = nn.Sequential(
+        nn.Linear(num_dense, 512), nn.ReLU(), nn.Linear(512, 256), nn.ReLU(),
+        nn.Linear(256, embedding_dim), nn.ReLU())
+    num_features = len(table_sizes) + 1
+    num_interactions = num_features * (num_features - 1) // 2
+    self.top = nn.Sequential(
+        nn.Linear(num_interactions + embedding_dim, 512), nn.ReLU(),
+        nn.Linear(512, 256), nn.ReLU(), nn.Linear(256, 1))
+
+  def forward(self, dense, indices, offsets):
+    dense_features = self.bottom(dense)
+    features = [dense_features] + [
+        table(indices[i], offsets[i]) for i, table in enumerate(self.tables)
+    ]
+    x = torch.stack(features, dim=1)
+    interactions = torch.bmm(x, x.transpose(1, 2))
+    rows, cols = torch.tril_indices(
+        x.size(1), x.size(1), offset=-1, device=x.device)
+    pairs = interactions[:, rows, cols]
+    return self.top(torch.cat([dense_features, pairs], dim=1)).squeeze(1)
+
+
+class BenchModelRecommender(ModelBenchBase):
+  batch_size, num_dense, embedding_dim, bag_size = 2048, 13, 64, 4
+  table_sizes = [1000000] * 4 + [100000] * 8 + [10000] * 14
+
+  def make_model(self):
+    return _Recommender(self.table_sizes, self.embedding_dim, self.num_dense)
+
+  def make_batch(self):
+    num_tables = len(self.table_sizes)
+    indices = torch.stack([
+        torch.randint(0, size, (self.batch_size * self.bag_size,))
+        for size in self.table_sizes
+    ])
+    offsets = torch.arange(
+        0, self.batch_size * self.bag_size,
+        self.bag_size).unsqueeze(0).expand(num_tables, -1).contiguous()
+    return (torch.randn(self.batch_size, self.num_dense), indices, offsets,
+            torch.randint(0, 2, (self.batch_size,)).float())
+
+  def loss(self, model, dense, indices, offsets, target):
+    return nn.functional.binary_cross_entropy_with_logits(
+        model(dense, indices, offsets), target)
+
+
+# The comparison expressions of the model benchmark records, where only the
+# throughput is better when higher. The tolerance is a fraction of the baseline
+# mean, on top of twice the standard deviation of the recorded runs.
+_HIGHER_IS_BETTER = ('samples_per_sec',)
+
+
+def _compare_config(record, tolerance):
+  config = {'base_expression': 'True'}
+  for key in record:
+    if key in _HIGHER_IS_BETTER:
+      expression = 'v >= v_mean * {} - v_stddev * 2.0'.format(1.0 - tolerance)
+    else:
+      expression = 'v <= v_mean * {} + v_stddev * 2.0'.format(1.0 + tolerance)
+    config['{}_expression'.format(key)] = expression
+  return config
+
+
+def compare_baseline(records, baseline, tolerance):
+  regressions = 0
+  for name, record in sorted(records.items()):
+    if name not in baseline:
+      print('{}: no baseline'.format(name))
+      continue
+    report = mcu.compare_data_points(
+        baseline[name], record, config=_compare_config(record, tolerance))
+    if report:
+      regressions += 1
+      xu.eprint('{} regressed:\n{}'.format(name, report))
+  return regressions
+
+
+def record_baseline(records, path):
+  # Every recorded run is appended to the metric values of the baseline, so
+  # that the comparisons account for the run to run variance.
+  baseline = dict()
+  if os.path.exists(path):
+    with open(path, 'r') as fd:
+      baseline = json.load(fd)
+  for name, record in records.items():
+    data_points = baseline.setdefault(name, dict())
+    for key, value in record.items():
+      data_points.setdefault(key, []).append(value)
+  with open(path, 'w') as fd:
+    json.dump(baseline, fd, indent=2, sort_keys=True)
+
+
 def run_benchmarks(args):
   benchs = {}
   for name, cls in inspect.getmembers(sys.modules[__name__], inspect.isclass):
@@ -117,14 +434,30 @@ def run_benchmarks(args):
     run_benchs = list(set(run_benchs))
   else:
     run_benchs = benchs.keys()
+  records = dict()
   for name in sorted(run_benchs):
     bench = benchs[name](args)
-    bench.run()
+    record = bench.run()
+    if record is not None:
+      records[name] = record
+  if args.record:
+    record_baseline(records, args.record)
+  if args.baseline:
+    with open(args.baseline, 'r') as fd:
+      baseline = json.load(fd)
+    if compare_baseline(records, baseline, args.tolerance):
+      sys.exit(1)
 
 
 if __name__ == '__main__':
   parser = argparse.ArgumentParser(add_help=False)
   parser.add_argument('--transfer', action='store_true')
+  # The JSON file the model benchmark records are appended to.
+  parser.add_argument('--record', type=str, default=None)
+  # A JSON file written by --record, which the model benchmark records are
+  # compared with, failing on regressions beyond the tolerance.
+  parser.add_argument('--baseline', type=str, default=None)
+  parser.add_argument('--tolerance', type=float, default=0.05)
   args, benchs = parser.parse_known_args()
   args.benchs = benchs
 
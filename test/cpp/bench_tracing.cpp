@@ -0,0 +1,250 @@
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/cache.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/compiler/xla/xla_client/xla_util.h"
+#include "torch/csrc/autograd/variable.h"
+#include "torch_xla/csrc/device.h"
+#include "torch_xla/csrc/ir.h"
+#include "torch_xla/csrc/ir_util.h"
+#include "torch_xla/csrc/lowering_context.h"
+#include "torch_xla/csrc/ops/arithmetic_ir_ops.h"
+#include "torch_xla/csrc/ops/ops.h"
+#include "torch_xla/csrc/tensor.h"
+#include "torch_xla/csrc/tensor_util.h"
+
+// Microbenchmarks for the host side costs of tracing and lowering lazy tensor
+// graphs. Run with --benchmark_format=json (or --benchmark_out=FILE
+// --benchmark_out_format=json) to get results which can be compared across
+// releases. The benchmarks which need a device (graph hashing) require the
+// same XRT configuration as the C++ tests.
+
+namespace torch_xla {
+namespace cpp_test {
+namespace {
+
+xla::Shape MakeBenchShape() {
+  return xla::ShapeUtil::MakeShape(xla::PrimitiveType::F32, {64, 64});
+}
+
+// Builds num_chains independent chains of length additions of the input. Wide
+// graphs keep the depth (hence the recursion on node destruction) bounded,
+// while reaching large node counts.
+std::vector<ir::Value> MakeWideGraph(const ir::Value& input, size_t num_chains,
+                                     size_t length) {
+  std::vector<ir::Value> roots;
+  for (size_t i = 0; i < num_chains; ++i) {
+    ir::Value value = input;
+    for (size_t j = 0; j < length; ++j) {
+      value = value + ir::ops::ScalarOp(static_cast<double>(i + 1),
+                                        input.shape());
+    }
+    roots.push_back(value);
+  }
+  return roots;
+}
+
+std::vector<const ir::Node*> GetRootNodes(absl::Span<const ir::Value> roots) {
+  std::vector<const ir::Node*> nodes;
+  for (auto& root : roots) {
+    nodes.push_back(root.node.get());
+  }
+  return nodes;
+}
+
+void BM_MakeNode(benchmark::State& state) {
+  ir::Value input = ir::ops::ScalarOp(1.0, MakeBenchShape());
+  ir::Value other = ir::ops::ScalarOp(2.0, MakeBenchShape());
+  for (auto _ : state) {
+    ir::NodePtr node = input + other;
+    benchmark::DoNotOptimize(node.get());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MakeNode);
+
+// Leaf nodes hash their op, shape and seed with Node::GetOpHash().
+void BM_LeafNodeHash(benchmark::State& state) {
+  std::vector<xla::int64> dimensions(state.range(0), 8);
+  xla::Shape shape =
+      xla::ShapeUtil::MakeShape(xla::PrimitiveType::F32, dimensions);
+  for (auto _ : state) {
+    ir::NodePtr node = ir::ops::ScalarOp(1.0, shape);
+    benchmark::DoNotOptimize(node->hash());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LeafNodeHash)->Arg(1)->Arg(4)->Arg(8);
+
+// The leaf node shape hash, through the shape string (as done before the
+// structural hashing) and through xla::util::ShapeHash().
+void BM_ShapeStringHash(benchmark::State& state) {
+  std::vector<xla::int64> dimensions(state.range(0), 8);
+  xla::Shape shape =
+      xla::ShapeUtil::MakeShape(xla::PrimitiveType::F32, dimensions);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(xla::util::Hash(shape.ToString()));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ShapeStringHash)->Arg(1)->Arg(4)->Arg(8);
+
+void BM_ShapeStructuralHash(benchmark::State& state) {
+  std::vector<xla::int64> dimensions(state.range(0), 8);
+  xla::Shape shape =
+      xla::ShapeUtil::MakeShape(xla::PrimitiveType::F32, dimensions);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(xla::util::ShapeHash(shape));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ShapeStructuralHash)->Arg(1)->Arg(4)->Arg(8);
+
+// OpKind::hash() runs for every IR node, and hits the per thread symbol hash
+// table after the first call, while the string hash goes through the global
+// symbol table lock.
+void BM_OpKindHash(benchmark::State& state) {
+  ir::OpKind op(at::aten::add);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(op.hash());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_OpKindHash);
+
+void BM_OpKindStringHash(benchmark::State& state) {
+  ir::OpKind op(at::aten::add);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(xla::util::StringHash(op.op.toQualString()));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_OpKindStringHash);
+
+void BM_ComputePostOrder(benchmark::State& state) {
+  ir::Value input = ir::ops::ScalarOp(1.0, MakeBenchShape());
+  std::vector<ir::Value> roots =
+      MakeWideGraph(input, /*num_chains=*/100, state.range(0) / 100);
+  std::vector<const ir::Node*> nodes = GetRootNodes(roots);
+  for (auto _ : state) {
+    ir::Util::EmissionMap emap;
+    std::vector<const ir::Node*> post_order =
+        ir::Util::ComputePostOrder(nodes, &emap);
+    benchmark::DoNotOptimize(post_order.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ComputePostOrder)->Arg(10000)->Arg(100000);
+
+// The hash of the pending graph, computed by XLATensor::CollectSyncTensors() at
+// every step to look up the compilation cache.
+void BM_GraphHash(benchmark::State& state) {
+  Device device = GetCurrentDevice();
+  ir::Value input = ir::ops::ScalarOp(1.0, MakeBenchShape());
+  std::vector<ir::Value> roots =
+      MakeWideGraph(input, /*num_chains=*/state.range(0), /*length=*/100);
+  std::vector<XLATensor> tensors;
+  for (auto& root : roots) {
+    tensors.push_back(XLATensor::Create(root, device));
+  }
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(XLATensor::GetGraphHash(tensors));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_GraphHash)->Arg(10)->Arg(100);
+
+void BM_LoweringContext(benchmark::State& state) {
+  Device device("CPU:0");
+  ir::Value input = ir::ops::ScalarOp(1.0, MakeBenchShape());
+  std::vector<ir::Value> roots =
+      MakeWideGraph(input, /*num_chains=*/100, state.range(0) / 100);
+  ir::Util::EmissionMap emap;
+  std::vector<const ir::Node*> post_order =
+      ir::Util::ComputePostOrder(GetRootNodes(roots), &emap);
+  for (auto _ : state) {
+    ir::LoweringContext lowering_ctx("BenchLowering", device, post_order,
+                                     ir::Util::EmissionMap());
+    for (auto& root : roots) {
+      lowering_ctx.AddResult(lowering_ctx.GetOutputOp(root));
+    }
+    benchmark::DoNotOptimize(lowering_ctx.GetEmittedNodeCount());
+  }
+  state.SetItemsProcessed(state.iterations() * post_order.size());
+}
+BENCHMARK(BM_LoweringContext)->Arg(1000)->Arg(10000);
+
+// Mixed Get()/Add() traffic over a key space twice as big as the cache, so
+// that both hits and evictions happen, from an increasing number of threads.
+template <typename CacheType>
+void BM_CacheContention(benchmark::State& state) {
+  static CacheType* cache = nullptr;
+  if (state.thread_index == 0) {
+    cache = new CacheType(1024);
+  }
+  xla::int64 key = state.thread_index * 7919;
+  for (auto _ : state) {
+    key = (key * 1103515245 + 12345) % 2048;
+    auto value = cache->Get(key);
+    if (value == nullptr) {
+      value = cache->Add(key, std::make_shared<std::string>("value"));
+    }
+    benchmark::DoNotOptimize(value.get());
+  }
+  if (state.thread_index == 0) {
+    delete cache;
+    cache = nullptr;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_CacheContention,
+                   xla::util::Cache<xla::int64, std::string>)
+    ->ThreadRange(1, 16)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_CacheContention,
+                   xla::util::ShardedCache<xla::int64, std::string>)
+    ->ThreadRange(1, 16)
+    ->UseRealTime();
+
+// Copies a PyTorch CPU tensor into a device layout transfer buffer, as done by
+// the tensor uploads. The second argument selects a transposed (non
+// contiguous) source.
+void BM_CopyTensor(benchmark::State& state) {
+  static const at::ScalarType kTypes[] = {
+      at::ScalarType::Float, at::ScalarType::Double, at::ScalarType::Half,
+      at::ScalarType::Long, at::ScalarType::Byte};
+  at::ScalarType scalar_type = kTypes[state.range(0)];
+  Device device("CPU:0");
+  at::Tensor tensor =
+      at::ones({512, 512}, at::TensorOptions(at::ScalarType::Float))
+          .to(scalar_type);
+  if (state.range(1) != 0) {
+    tensor = tensor.t();
+  }
+  xla::Shape shape = MakeShapeWithDeviceLayout(
+      CreateComputationShapeFromTensor(tensor, &device), device.hw_type);
+  size_t buffer_size = xla::ShapeUtil::ByteSizeOfElements(shape);
+  std::unique_ptr<char[]> buffer(new char[buffer_size]);
+  for (auto _ : state) {
+    PopulateTensorBuffer(tensor, shape, buffer.get(), buffer_size, device);
+    benchmark::ClobberMemory();
+  }
+  state.SetLabel(c10::toString(scalar_type));
+  state.SetBytesProcessed(state.iterations() * tensor.nbytes());
+}
+BENCHMARK(BM_CopyTensor)->Apply([](benchmark::internal::Benchmark* bench) {
+  for (int type_index = 0; type_index < 5; ++type_index) {
+    bench->Args({type_index, 0})->Args({type_index, 1});
+  }
+});
+
+}  // namespace
+}  // namespace cpp_test
+}  // namespace torch_xla
+
+BENCHMARK_MAIN();
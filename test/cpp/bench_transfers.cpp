@@ -0,0 +1,194 @@
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "torch/csrc/autograd/variable.h"
+#include "torch_xla/csrc/device.h"
+#include "torch_xla/csrc/tensor_util.h"
+
+// Benchmarks of the host<->device transfers of the computation client, over a
+// matrix of shapes, types, source layouts and thread counts. Besides the end to
+// end throughput, they split the transfer time in phases, using the client
+// metrics:
+//   TransformGBps: the re-layout of the tensors into the transfer buffers, and
+//     their serialization (TransferToServerTransformTime).
+//   RpcGBps: the rest of TransferToServerTime, that is the RPC and the device
+//     allocation, over the bytes on the wire (OutboundData).
+//   ReadGBps: TransferFromServerTime, over the bytes received (InboundData).
+//   ConvertGBps: the conversion of the fetched literals into PyTorch tensors.
+// The rates are per thread, as the phase times are summed over all of them.
+// These benchmarks need the same XRT configuration as the C++ tests.
+
+namespace torch_xla {
+namespace cpp_test {
+namespace {
+
+const std::vector<xla::int64>& GetBenchShape(int index) {
+  static const std::vector<std::vector<xla::int64>>* shapes =
+      new std::vector<std::vector<xla::int64>>(
+          {{64, 16}, {512, 512}, {64, 224, 224}, {4096, 4096}});
+  return shapes->at(index);
+}
+
+at::ScalarType GetBenchType(int index) {
+  static const at::ScalarType kTypes[] = {
+      at::ScalarType::Float, at::ScalarType::BFloat16, at::ScalarType::Half,
+      at::ScalarType::Long, at::ScalarType::Byte};
+  return kTypes[index];
+}
+
+// Creates the source tensor, whose last two dimensions are swapped if
+// transposed is true, so that the upload needs a strided re-layout.
+at::Tensor MakeBenchTensor(int shape_index, int type_index, bool transposed) {
+  std::vector<int64_t> sizes(GetBenchShape(shape_index).begin(),
+                             GetBenchShape(shape_index).end());
+  if (transposed) {
+    std::swap(sizes[sizes.size() - 2], sizes[sizes.size() - 1]);
+  }
+  at::Tensor tensor = at::ones(sizes, at::TensorOptions(at::ScalarType::Float))
+                          .to(GetBenchType(type_index));
+  return transposed ? tensor.transpose(-2, -1) : tensor;
+}
+
+std::string MakeBenchLabel(const at::Tensor& tensor, bool transposed) {
+  return absl::StrCat(c10::toString(tensor.scalar_type()), "[",
+                      absl::StrJoin(tensor.sizes(), ","), "]",
+                      transposed ? " transposed" : "");
+}
+
+double GetMetricAccumulator(const std::string& name) {
+  xla::metrics::MetricData* metric = xla::metrics::GetMetric(name);
+  return metric != nullptr ? metric->Accumulator() : 0;
+}
+
+// The accumulators of the transfer metrics, whose deltas across the benchmark
+// loop give the per phase totals.
+struct TransferMetrics {
+  static TransferMetrics Get() {
+    TransferMetrics metrics;
+    metrics.upload_ns = GetMetricAccumulator("TransferToServerTime");
+    metrics.transform_ns =
+        GetMetricAccumulator("TransferToServerTransformTime");
+    metrics.download_ns = GetMetricAccumulator("TransferFromServerTime");
+    metrics.outbound_bytes = GetMetricAccumulator("OutboundData");
+    metrics.inbound_bytes = GetMetricAccumulator("InboundData");
+    return metrics;
+  }
+
+  double upload_ns = 0;
+  double transform_ns = 0;
+  double download_ns = 0;
+  double outbound_bytes = 0;
+  double inbound_bytes = 0;
+};
+
+double GigaBytesPerSecond(double bytes, double ns) {
+  return ns > 0 ? bytes / ns : 0;
+}
+
+void BM_TransferToServer(benchmark::State& state) {
+  static TransferMetrics* start_metrics = new TransferMetrics();
+  bool transposed = state.range(2) != 0;
+  Device device = GetCurrentDevice();
+  at::Tensor tensor = MakeBenchTensor(state.range(0), state.range(1),
+                                      transposed);
+  xla::Shape shape = MakeShapeWithDeviceLayout(
+      CreateComputationShapeFromTensor(tensor, &device), device.hw_type);
+  auto populate_fn =
+      [&](const xla::ComputationClient::TensorSource& source_info,
+          void* dest_buffer, size_t dest_buffer_size) {
+        PopulateTensorBuffer(tensor, source_info.shape, dest_buffer,
+                             dest_buffer_size, device);
+      };
+  std::vector<xla::ComputationClient::TensorSource> sources;
+  sources.emplace_back(shape, device.ToString(), std::move(populate_fn));
+  if (state.thread_index == 0) {
+    *start_metrics = TransferMetrics::Get();
+  }
+  for (auto _ : state) {
+    std::vector<xla::ComputationClient::DataPtr> datas =
+        xla::ComputationClient::Get()->TransferToServer(sources);
+    benchmark::DoNotOptimize(datas.data());
+  }
+  if (state.thread_index == 0) {
+    TransferMetrics end_metrics = TransferMetrics::Get();
+    double bytes = static_cast<double>(tensor.nbytes()) * state.iterations() *
+                   state.threads;
+    double transform_ns =
+        end_metrics.transform_ns - start_metrics->transform_ns;
+    double rpc_ns =
+        end_metrics.upload_ns - start_metrics->upload_ns - transform_ns;
+    double wire_bytes =
+        end_metrics.outbound_bytes - start_metrics->outbound_bytes;
+    state.counters["TransformGBps"] = GigaBytesPerSecond(bytes, transform_ns);
+    state.counters["RpcGBps"] = GigaBytesPerSecond(wire_bytes, rpc_ns);
+    state.counters["WireBytesRatio"] = bytes > 0 ? wire_bytes / bytes : 0;
+  }
+  state.SetLabel(MakeBenchLabel(tensor, transposed));
+  state.SetBytesProcessed(state.iterations() * tensor.nbytes());
+}
+
+void BM_TransferFromServer(benchmark::State& state) {
+  static TransferMetrics* start_metrics = new TransferMetrics();
+  static std::atomic<xla::int64>* convert_ns = new std::atomic<xla::int64>(0);
+  bool transposed = state.range(2) != 0;
+  Device device = GetCurrentDevice();
+  at::Tensor tensor = MakeBenchTensor(state.range(0), state.range(1),
+                                      transposed);
+  std::vector<xla::ComputationClient::DataPtr> datas = {
+      TensorToXlaData(tensor, device)};
+  if (state.thread_index == 0) {
+    *start_metrics = TransferMetrics::Get();
+    *convert_ns = 0;
+  }
+  for (auto _ : state) {
+    std::vector<xla::Literal> literals =
+        xla::ComputationClient::Get()->TransferFromServer(datas);
+    xla::int64 start_ns = xla::sys_util::NowNs();
+    at::Tensor result =
+        MakeTensorFromXlaLiteral(literals.front(), tensor.scalar_type());
+    *convert_ns += xla::sys_util::NowNs() - start_ns;
+    benchmark::DoNotOptimize(result.data_ptr());
+  }
+  if (state.thread_index == 0) {
+    TransferMetrics end_metrics = TransferMetrics::Get();
+    double bytes = static_cast<double>(tensor.nbytes()) * state.iterations() *
+                   state.threads;
+    double wire_bytes =
+        end_metrics.inbound_bytes - start_metrics->inbound_bytes;
+    state.counters["ReadGBps"] = GigaBytesPerSecond(
+        wire_bytes, end_metrics.download_ns - start_metrics->download_ns);
+    state.counters["ConvertGBps"] =
+        GigaBytesPerSecond(bytes, convert_ns->load());
+  }
+  state.SetLabel(MakeBenchLabel(tensor, transposed));
+  state.SetBytesProcessed(state.iterations() * tensor.nbytes());
+}
+
+// Arguments: shape index, type index and transposed source, run from 1 to 8
+// threads.
+void TransferArgs(benchmark::internal::Benchmark* bench) {
+  for (int shape_index = 0; shape_index < 4; ++shape_index) {
+    for (int type_index = 0; type_index < 5; ++type_index) {
+      bench->Args({shape_index, type_index, 0})
+          ->Args({shape_index, type_index, 1});
+    }
+  }
+  bench->ThreadRange(1, 8)->UseRealTime();
+}
+
+BENCHMARK(BM_TransferToServer)->Apply(TransferArgs);
+BENCHMARK(BM_TransferFromServer)->Apply(TransferArgs);
+
+}  // namespace
+}  // namespace cpp_test
+}  // namespace torch_xla
@@ -213,8 +213,12 @@ std::vector<xla::ComputationClient::DataPtr> Execute(
     xla::XlaOp root = lowering_ctx.GetOutputOp(node);
     lowering_ctx.AddResult(root);
   }
+  return Execute(&lowering_ctx, device);
+}
 
-  xla::XlaComputation computation = ConsumeValue(lowering_ctx.Build());
+std::vector<xla::ComputationClient::DataPtr> Execute(
+    ir::LoweringContext* lowering_ctx, const Device& device) {
+  xla::XlaComputation computation = ConsumeValue(lowering_ctx->Build());
   xla::ProgramShape program_shape = ConsumeValue(computation.GetProgramShape());
   xla::Shape shape =
       MakeShapeWithDeviceLayout(program_shape.result(), device.hw_type);
@@ -231,7 +235,7 @@ std::vector<xla::ComputationClient::DataPtr> Execute(
 
   xla::ComputationClient::ExecuteComputationOptions options;
   return xla::ComputationClient::Get()->ExecuteComputation(
-      *computations.front(), lowering_ctx.GetParametersData(),
+      *computations.front(), lowering_ctx->GetParametersData(),
       device.ToString(), options);
 }
 
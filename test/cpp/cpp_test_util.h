@@ -13,6 +13,7 @@
 #include "torch_xla/csrc/debug_util.h"
 #include "torch_xla/csrc/device.h"
 #include "torch_xla/csrc/ir.h"
+#include "torch_xla/csrc/lowering_context.h"
 #include "torch_xla/csrc/tensor.h"
 
 #define XLA_CPP_TEST_ENABLED(name)                          \
@@ -80,6 +81,11 @@ ir::Value GetTensorIrValue(const at::Tensor& tensor, const Device& device);
 std::vector<xla::ComputationClient::DataPtr> Execute(
     absl::Span<const ir::Value> roots, const Device& device);
 
+// Builds and executes the computation of a lowering context whose results have
+// already been added.
+std::vector<xla::ComputationClient::DataPtr> Execute(
+    ir::LoweringContext* lowering_ctx, const Device& device);
+
 std::vector<at::Tensor> Fetch(
     absl::Span<const xla::ComputationClient::DataPtr> device_data);
 
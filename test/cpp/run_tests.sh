@@ -6,6 +6,8 @@ BUILDTYPE="Release"
 VERB=
 FILTER=
 BUILD_ONLY=0
+BENCH=0
+BENCH_OUT=bench_ptxla.json
 RMBUILD=1
 LOGFILE=/tmp/pytorch_cpp_test.log
 XLA_EXPERIMENTAL="nonzero:masked_select"
@@ -14,7 +16,7 @@ if [ "$DEBUG" == "1" ]; then
   BUILDTYPE="Debug"
 fi
 
-while getopts 'VLDKBF:X:' OPTION
+while getopts 'VLDKBMF:X:O:' OPTION
 do
   case $OPTION in
     V)
@@ -32,6 +34,12 @@ do
     B)
       BUILD_ONLY=1
       ;;
+    M)
+      BENCH=1
+      ;;
+    O)
+      BENCH_OUT="$OPTARG"
+      ;;
     F)
       FILTER="--gtest_filter=$OPTARG"
       ;;
@@ -53,7 +61,12 @@ cmake "$RUNDIR" \
   -DPYTHON_LIBRARY=$(python -c "import distutils.sysconfig as sysconfig; print(sysconfig.get_config_var('LIBDIR') + '/' + sysconfig.get_config_var('LDLIBRARY'))")
 make -j $VERB
 
-if [ $BUILD_ONLY -eq 0 ]; then
+if [ $BUILD_ONLY -eq 0 -a $BENCH -eq 1 ]; then
+  # The JSON results go into the BENCH_OUT file (relative to the test folder),
+  # while the console keeps the human readable version.
+  ./bench_ptxla --benchmark_out="$RUNDIR/$BENCH_OUT" \
+    --benchmark_out_format=json
+elif [ $BUILD_ONLY -eq 0 ]; then
   if [ "$LOGFILE" != "" ]; then
     ./test_ptxla ${FILTER:+"$FILTER"} 2>$LOGFILE
   else
@@ -7,6 +7,7 @@
 #include "tensorflow/compiler/xla/util.h"
 #include "tensorflow/compiler/xla/xla_client/metrics.h"
 #include "torch_xla/csrc/aten_xla_bridge.h"
+#include "torch_xla/csrc/autocast_policy.h"
 #include "torch_xla/csrc/helpers.h"
 #include "torch_xla/csrc/torch_util.h"
 #include "torch_xla_test.h"
@@ -831,9 +832,9 @@ TEST_F(AtenXlaTensorTest, TestTriangularSolve) {
                       xla_b, xla_a, /*upper=*/upper, /*transpose=*/transpose,
                       /*unitriangular=*/unitriangular);
                   AllClose(std::get<0>(result), std::get<0>(xla_result),
-                           /*rtol=*/1e-3, /*atol=*/1e-4);
+                           /*rtol=*/1e-2, /*atol=*/1e-3);
                   AllClose(std::get<1>(result), std::get<1>(xla_result),
-                           /*rtol=*/1e-3, /*atol=*/1e-4);
+                           /*rtol=*/1e-2, /*atol=*/1e-3);
                 });
               }
             }
@@ -1139,6 +1140,71 @@ TEST_F(AtenXlaTensorTest, TestStdInDim) {
   }
 }
 
+TEST_F(AtenXlaTensorTest, TestStdMeanInDim) {
+  torch::Tensor a = torch::rand({4, 3, 4}, torch::TensorOptions(torch::kFloat));
+  int rank = a.dim();
+  for (auto unbiased : {true, false}) {
+    for (auto keepdim : {true, false}) {
+      for (int dim = -rank; dim < rank; ++dim) {
+        auto b = torch::std_mean(a, {dim}, unbiased, keepdim);
+        ForEachDevice([&](const torch::Device& device) {
+          torch::Tensor xla_a = CopyToDevice(a, device);
+          auto xla_b = torch::std_mean(xla_a, {dim}, unbiased, keepdim);
+          AllClose(std::get<0>(b), std::get<0>(xla_b));
+          AllClose(std::get<1>(b), std::get<1>(xla_b));
+        });
+      }
+    }
+  }
+}
+
+TEST_F(AtenXlaTensorTest, TestVar) {
+  torch::Tensor a = torch::rand({4, 3, 4}, torch::TensorOptions(torch::kFloat));
+  for (auto unbiased : {true, false}) {
+    torch::Tensor b = torch::var(a, unbiased);
+    ForEachDevice([&](const torch::Device& device) {
+      torch::Tensor xla_a = CopyToDevice(a, device);
+      torch::Tensor xla_b = torch::var(xla_a, unbiased);
+      AllClose(b, xla_b);
+    });
+  }
+}
+
+TEST_F(AtenXlaTensorTest, TestVarInDim) {
+  torch::Tensor a = torch::rand({4, 3, 4}, torch::TensorOptions(torch::kFloat));
+  int rank = a.dim();
+  for (auto unbiased : {true, false}) {
+    for (auto keepdim : {true, false}) {
+      for (int dim = -rank; dim < rank; ++dim) {
+        torch::Tensor b = torch::var(a, {dim}, unbiased, keepdim);
+        ForEachDevice([&](const torch::Device& device) {
+          torch::Tensor xla_a = CopyToDevice(a, device);
+          torch::Tensor xla_b = torch::var(xla_a, {dim}, unbiased, keepdim);
+          AllClose(b, xla_b);
+        });
+      }
+    }
+  }
+}
+
+TEST_F(AtenXlaTensorTest, TestVarMean) {
+  // The large offset makes a sum of squares based variance lose most of its
+  // precision.
+  torch::Tensor a =
+      torch::rand({64, 128}, torch::TensorOptions(torch::kFloat)) + 1e4;
+  for (auto unbiased : {true, false}) {
+    auto b = torch::var_mean(a.to(torch::kDouble), {1}, unbiased,
+                             /*keepdim=*/false);
+    ForEachDevice([&](const torch::Device& device) {
+      torch::Tensor xla_a = CopyToDevice(a, device);
+      auto xla_b = torch::var_mean(xla_a, {1}, unbiased, /*keepdim=*/false);
+      AllClose(std::get<0>(b).to(torch::kFloat), std::get<0>(xla_b),
+               /*rtol=*/1e-2, /*atol=*/1e-3);
+      AllClose(std::get<1>(b).to(torch::kFloat), std::get<1>(xla_b));
+    });
+  }
+}
+
 TEST_F(AtenXlaTensorTest, TestSum) {
   torch::Tensor a = torch::rand({4, 3, 4}, torch::TensorOptions(torch::kFloat));
   torch::Tensor b = torch::sum(a);
@@ -2860,6 +2926,25 @@ TEST_F(AtenXlaTensorTest, TestMatmul_2x2) {
   ExpectCounterChanged("xla::mm", cpp_test::GetIgnoredCounters());
 }
 
+TEST_F(AtenXlaTensorTest, TestMatmulAutocast) {
+  torch::Tensor a = torch::rand({8, 16}, torch::TensorOptions(torch::kFloat));
+  torch::Tensor b = torch::rand({16, 4}, torch::TensorOptions(torch::kFloat));
+  torch::Tensor c = torch::log_softmax(torch::matmul(a, b), 1);
+  ForEachDevice([&](const torch::Device& device) {
+    torch::Tensor xla_a = CopyToDevice(a, device);
+    torch::Tensor xla_b = CopyToDevice(b, device);
+    PushAutocastScope("bf16");
+    torch::Tensor xla_c = torch::log_softmax(torch::matmul(xla_a, xla_b), 1);
+    PopAutocastScope();
+    EXPECT_EQ(xla_c.scalar_type(), torch::kFloat);
+    AllClose(c, xla_c, /*rtol=*/1e-2, /*atol=*/1e-2);
+  });
+
+  ExpectCounterNotChanged("aten::.*", cpp_test::GetIgnoredCounters());
+  ExpectCounterChanged("xla::mm", cpp_test::GetIgnoredCounters());
+  ExpectCounterChanged("AutocastOperands", cpp_test::GetIgnoredCounters());
+}
+
 TEST_F(AtenXlaTensorTest, TestMatmulBcast) {
   torch::Tensor a =
       torch::rand({4, 2, 3, 2, 4}, torch::TensorOptions(torch::kFloat));
@@ -3070,7 +3155,29 @@ TEST_F(AtenXlaTensorTest, TestEinsumPyTorchLowerBilinear) {
   });
 
   ExpectCounterNotChanged("aten::.*", cpp_test::GetIgnoredCounters());
-  ExpectCounterChanged("xla::view", cpp_test::GetIgnoredCounters());
+  ExpectCounterChanged("xla::einsum", cpp_test::GetIgnoredCounters());
+}
+
+TEST_F(AtenXlaTensorTest, TestEinsumMultiOperandChain) {
+  torch::Tensor a = torch::rand({8, 64}, torch::TensorOptions(torch::kFloat));
+  torch::Tensor b = torch::rand({64, 64}, torch::TensorOptions(torch::kFloat));
+  torch::Tensor c = torch::rand({64, 64}, torch::TensorOptions(torch::kFloat));
+  torch::Tensor d =
+      torch::rand({64, 4, 3}, torch::TensorOptions(torch::kFloat));
+  std::string equation = "ij,jk,kl,lmz->mi";
+  torch::Tensor result = torch::einsum(equation, {a, b, c, d});
+  ForEachDevice([&](const torch::Device& device) {
+    torch::Tensor xla_a = CopyToDevice(a, device);
+    torch::Tensor xla_b = CopyToDevice(b, device);
+    torch::Tensor xla_c = CopyToDevice(c, device);
+    torch::Tensor xla_d = CopyToDevice(d, device);
+    torch::Tensor xla_result =
+        torch::einsum(equation, {xla_a, xla_b, xla_c, xla_d});
+    AllClose(result, xla_result, /*rtol=*/1e-3, /*atol=*/1e-3);
+  });
+
+  ExpectCounterNotChanged("aten::.*", cpp_test::GetIgnoredCounters());
+  ExpectCounterChanged("xla::einsum", cpp_test::GetIgnoredCounters());
 }
 
 TEST_F(AtenXlaTensorTest, TestEinsumPyTorchLowerDiagonal) {
@@ -3177,6 +3284,10 @@ TEST_F(AtenXlaTensorTest, TestUpsampleNearest2D) {
     torch::Tensor xla_result = torch::upsample_nearest2d(xla_input, {uh, uw});
     AllClose(result, xla_result);
   });
+
+  ExpectCounterNotChanged("aten::.*", cpp_test::GetIgnoredCounters());
+  ExpectCounterChanged("xla::upsample_nearest2d",
+                       cpp_test::GetIgnoredCounters());
 }
 
 TEST_F(AtenXlaTensorTest, TestUpsampleNearest2DBackward) {
@@ -3216,6 +3327,28 @@ TEST_F(AtenXlaTensorTest, TestUpsampleBilinear2D) {
       AllClose(result, xla_result);
     });
   }
+
+  ExpectCounterNotChanged("aten::.*", cpp_test::GetIgnoredCounters());
+  ExpectCounterChanged("xla::upsample_bilinear2d",
+                       cpp_test::GetIgnoredCounters());
+}
+
+TEST_F(AtenXlaTensorTest, TestUpsampleBilinear2DNonSquare) {
+  torch::Tensor input =
+      torch::rand({2, 3, 6, 9}, torch::TensorOptions(torch::kFloat));
+  for (bool align_corners : {true, false}) {
+    for (auto output_size : {std::vector<int64_t>{13, 4},
+                             std::vector<int64_t>{3, 20}}) {
+      ForEachDevice([&](const torch::Device& device) {
+        torch::Tensor xla_input = CopyToDevice(input, device);
+        torch::Tensor result =
+            torch::upsample_bilinear2d(input, output_size, align_corners);
+        torch::Tensor xla_result =
+            torch::upsample_bilinear2d(xla_input, output_size, align_corners);
+        AllClose(result, xla_result);
+      });
+    }
+  }
 }
 
 TEST_F(AtenXlaTensorTest, TestUpsampleBilinear2DBackward) {
@@ -4670,6 +4803,29 @@ TEST_F(AtenXlaTensorTest, TestIndexAdd) {
   }
 }
 
+TEST_F(AtenXlaTensorTest, TestIndexAddManyDuplicates) {
+  // Enough indices to go through the sorted scatter lowering, on the devices
+  // which have it enabled.
+  int index_size = 20000;
+  torch::Tensor base = torch::rand({7, 5}, torch::TensorOptions(torch::kFloat));
+  torch::Tensor index = torch::randint(0, base.size(0), {index_size},
+                                       torch::TensorOptions(torch::kLong));
+  torch::Tensor value =
+      torch::rand({index_size, 5}, torch::TensorOptions(torch::kFloat));
+  torch::Tensor result = torch::index_add(base, 0, index, value);
+  ForEachDevice([&](const torch::Device& device) {
+    torch::Tensor xla_base = CopyToDevice(base, device);
+    torch::Tensor xla_index = CopyToDevice(index, device);
+    torch::Tensor xla_value = CopyToDevice(value, device);
+    torch::Tensor xla_result =
+        torch::index_add(xla_base, 0, xla_index, xla_value);
+    AllClose(result, xla_result, /*rtol=*/1e-4, /*atol=*/1e-2);
+  });
+
+  ExpectCounterNotChanged("aten::.*", cpp_test::GetIgnoredCounters());
+  ExpectCounterChanged("xla::index_add_", cpp_test::GetIgnoredCounters());
+}
+
 TEST_F(AtenXlaTensorTest, TestIndexAddInPlace) {
   int index_size = 10;
   int rank = 3;
@@ -6589,7 +6745,7 @@ TEST_F(AtenXlaTensorTest, TestAvgPool3DNoBatch) {
 TEST_F(AtenXlaTensorTest, TestAdaptiveAvgPool2D) {
   torch::Tensor input =
       torch::rand({4, 1, 28, 28}, torch::TensorOptions(torch::kFloat));
-  for (int64_t output_size : {7, 8}) {
+  for (int64_t output_size : {7, 8, 3}) {
     torch::Tensor output =
         torch::adaptive_avg_pool2d(input, {output_size, output_size});
     ForEachDevice([&](const torch::Device& device) {
@@ -6599,6 +6755,43 @@ TEST_F(AtenXlaTensorTest, TestAdaptiveAvgPool2D) {
       AllClose(output, xla_output);
     });
   }
+  ExpectCounterNotChanged("aten::.*", cpp_test::GetIgnoredCounters());
+}
+
+TEST_F(AtenXlaTensorTest, TestAdaptiveAvgPool2DNonDivisible) {
+  torch::Tensor input =
+      torch::rand({2, 3, 7, 10}, torch::TensorOptions(torch::kFloat));
+  for (auto output_size : std::vector<std::vector<int64_t>>{
+           {3, 3}, {7, 4}, {5, 10}, {9, 12}}) {
+    torch::Tensor output = torch::adaptive_avg_pool2d(input, output_size);
+    ForEachDevice([&](const torch::Device& device) {
+      torch::Tensor xla_input = CopyToDevice(input, device);
+      torch::Tensor xla_output =
+          torch::adaptive_avg_pool2d(xla_input, output_size);
+      AllClose(output, xla_output);
+    });
+  }
+  ExpectCounterNotChanged("aten::.*", cpp_test::GetIgnoredCounters());
+  ExpectCounterChanged("xla::_adaptive_avg_pool2d",
+                       cpp_test::GetIgnoredCounters());
+}
+
+TEST_F(AtenXlaTensorTest, TestAdaptiveAvgPool3D) {
+  torch::Tensor input =
+      torch::rand({2, 3, 6, 7, 8}, torch::TensorOptions(torch::kFloat));
+  for (auto output_size : std::vector<std::vector<int64_t>>{
+           {3, 7, 4}, {4, 3, 5}, {1, 1, 1}}) {
+    torch::Tensor output = torch::adaptive_avg_pool3d(input, output_size);
+    ForEachDevice([&](const torch::Device& device) {
+      torch::Tensor xla_input = CopyToDevice(input, device);
+      torch::Tensor xla_output =
+          torch::adaptive_avg_pool3d(xla_input, output_size);
+      AllClose(output, xla_output);
+    });
+  }
+  ExpectCounterNotChanged("aten::.*", cpp_test::GetIgnoredCounters());
+  ExpectCounterChanged("xla::adaptive_avg_pool3d",
+                       cpp_test::GetIgnoredCounters());
 }
 
 TEST_F(AtenXlaTensorTest, TestAdaptiveAvgPool2DNoBatch) {
@@ -6845,6 +7038,68 @@ TEST_F(AtenXlaTensorTest, TestBatchNorm2D) {
   }
 }
 
+TEST_F(AtenXlaTensorTest, TestConvBatchNorm2DFolding) {
+  torch::NoGradGuard no_grad;
+  int in_channels = 4;
+  int out_channels = 6;
+  torch::Tensor input = torch::rand({2, in_channels, 8, 8},
+                                    torch::TensorOptions(torch::kFloat));
+  torch::Tensor conv_weight = torch::rand(
+      {out_channels, in_channels, 3, 3}, torch::TensorOptions(torch::kFloat));
+  torch::Tensor weight =
+      torch::rand({out_channels}, torch::TensorOptions(torch::kFloat));
+  torch::Tensor bias =
+      torch::rand({out_channels}, torch::TensorOptions(torch::kFloat));
+  torch::Tensor running_mean =
+      torch::rand({out_channels}, torch::TensorOptions(torch::kFloat));
+  torch::Tensor running_var =
+      torch::rand({out_channels}, torch::TensorOptions(torch::kFloat)) + 0.5;
+  torch::Tensor undef;
+  double eps = 1e-5;
+  for (bool with_conv_bias : {false, true}) {
+    torch::Tensor conv_bias =
+        with_conv_bias
+            ? torch::rand({out_channels}, torch::TensorOptions(torch::kFloat))
+            : undef;
+    auto testfn = [&](const torch::Tensor& input,
+                      const torch::Tensor& conv_weight,
+                      const torch::Tensor& conv_bias,
+                      const torch::Tensor& weight, const torch::Tensor& bias,
+                      const torch::Tensor& running_mean,
+                      const torch::Tensor& running_var) -> torch::Tensor {
+      torch::Tensor conv = torch::conv2d(input, conv_weight, conv_bias,
+                                         /*stride=*/{1, 1}, /*padding=*/{1, 1});
+      return torch::relu(torch::batch_norm(
+          conv, weight, bias, running_mean, running_var, /*training=*/false,
+          /*momentum=*/0.1, eps, /*cudnn_enabled=*/false));
+    };
+    torch::Tensor output = testfn(input, conv_weight, conv_bias, weight, bias,
+                                  running_mean, running_var);
+    ForEachDevice([&](const torch::Device& device) {
+      torch::Tensor xla_conv_weight = CopyToDevice(conv_weight, device);
+      torch::Tensor xla_conv_bias =
+          with_conv_bias ? CopyToDevice(conv_bias, device) : undef;
+      torch::Tensor xla_weight = CopyToDevice(weight, device);
+      torch::Tensor xla_bias = CopyToDevice(bias, device);
+      torch::Tensor xla_running_mean = CopyToDevice(running_mean, device);
+      torch::Tensor xla_running_var = CopyToDevice(running_var, device);
+      // The second step reuses the folded parameters of the first one.
+      for (int step = 0; step < 2; ++step) {
+        torch::Tensor xla_output =
+            testfn(CopyToDevice(input, device), xla_conv_weight,
+                   xla_conv_bias, xla_weight, xla_bias, xla_running_mean,
+                   xla_running_var);
+        AllClose(output, xla_output, /*rtol=*/1e-3, /*atol=*/1e-4);
+      }
+    });
+
+    ExpectCounterNotChanged("aten::.*", cpp_test::GetIgnoredCounters());
+    ExpectCounterChanged("ConvBatchNormFold", cpp_test::GetIgnoredCounters());
+    ExpectCounterChanged("ConvBatchNormFoldCacheHit",
+                         cpp_test::GetIgnoredCounters());
+  }
+}
+
 TEST_F(AtenXlaTensorTest, TestDim) {
   torch::Tensor input =
       torch::rand({2, 3}, torch::TensorOptions(torch::kFloat));
@@ -7065,6 +7320,32 @@ TEST_F(AtenXlaTensorTest, TestPermute) {
   }
 }
 
+TEST_F(AtenXlaTensorTest, TestPermuteFolding) {
+  torch::Tensor a = torch::rand({4, 6}, torch::TensorOptions(torch::kFloat));
+  torch::Tensor b = torch::rand({4, 6}, torch::TensorOptions(torch::kFloat));
+  torch::Tensor c =
+      torch::rand({2, 5, 4}, torch::TensorOptions(torch::kFloat));
+  torch::Tensor d =
+      torch::rand({2, 3, 4}, torch::TensorOptions(torch::kFloat));
+  torch::Tensor sunk = torch::relu(a.t() + b.t()).t() * 2.0;
+  torch::Tensor dot = torch::mm(torch::neg(a.t()), b);
+  torch::Tensor batched = torch::matmul(c, d.transpose(1, 2));
+  ForEachDevice([&](const torch::Device& device) {
+    torch::Tensor xla_a = CopyToDevice(a, device);
+    torch::Tensor xla_b = CopyToDevice(b, device);
+    torch::Tensor xla_c = CopyToDevice(c, device);
+    torch::Tensor xla_d = CopyToDevice(d, device);
+    torch::Tensor xla_sunk = torch::relu(xla_a.t() + xla_b.t()).t() * 2.0;
+    AllClose(sunk, xla_sunk);
+    torch::Tensor xla_dot = torch::mm(torch::neg(xla_a.t()), xla_b);
+    AllClose(dot, xla_dot);
+    torch::Tensor xla_batched =
+        torch::matmul(xla_c, xla_d.transpose(1, 2));
+    AllClose(batched, xla_batched);
+  });
+  ExpectCounterChanged("IrTransposesRemoved", cpp_test::GetIgnoredCounters());
+}
+
 TEST_F(AtenXlaTensorTest, TestPermuteMod) {
   std::vector<std::vector<int64_t>> dims_permutations = {
       {0, 1, 2}, {0, 2, 1}, {1, 0, 2}, {1, 2, 0}, {2, 0, 1}, {2, 1, 0}};
@@ -8206,6 +8487,54 @@ TEST_F(AtenXlaTensorTest, TestAsStridedWithInplaceCopy) {
   });
 }
 
+TEST_F(AtenXlaTensorTest, TestAsStridedPatterns) {
+  torch::Tensor input =
+      torch::rand({8, 6}, torch::TensorOptions(torch::kFloat));
+  struct Pattern {
+    std::vector<int64_t> size;
+    std::vector<int64_t> stride;
+    int64_t storage_offset;
+  };
+  std::vector<Pattern> patterns = {
+      // Strided slice of every other row and column.
+      {{4, 3}, {12, 2}, 1},
+      // Transposed strided slice.
+      {{3, 4}, {2, 12}, 0},
+      // Broadcast of a column.
+      {{8, 5}, {6, 0}, 2},
+      // Overlapping sliding windows, lowered to a gather.
+      {{10, 5}, {4, 1}, 3},
+  };
+  for (auto& pattern : patterns) {
+    torch::Tensor output = torch::as_strided(input, pattern.size,
+                                             pattern.stride,
+                                             pattern.storage_offset);
+    ForEachDevice([&](const torch::Device& device) {
+      torch::Tensor xla_input = CopyToDevice(input, device);
+      torch::Tensor xla_output = torch::as_strided(
+          xla_input, pattern.size, pattern.stride, pattern.storage_offset);
+      AllClose(output, xla_output);
+    });
+  }
+  ExpectCounterNotChanged("aten::.*", cpp_test::GetIgnoredCounters());
+  ExpectCounterChanged("AsStridedGather", cpp_test::GetIgnoredCounters());
+}
+
+TEST_F(AtenXlaTensorTest, TestAsStridedSliceInplaceCopy) {
+  torch::Tensor source =
+      torch::rand({4, 3}, torch::TensorOptions(torch::kFloat));
+  std::vector<int64_t> size = {4, 3};
+  std::vector<int64_t> stride = {12, 2};
+  torch::Tensor output = torch::zeros({8, 6}, source.options());
+  output.as_strided(size, stride, 1).copy_(source);
+  ForEachDevice([&](const torch::Device& device) {
+    torch::Tensor xla_source = CopyToDevice(source, device);
+    torch::Tensor xla_output = torch::zeros({8, 6}, xla_source.options());
+    xla_output.as_strided(size, stride, 1).copy_(xla_source);
+    AllClose(output, xla_output);
+  });
+}
+
 TEST_F(AtenXlaTensorTest, TestEmptyStrided) {
   std::vector<int64_t> size = {4, 4, 2};
   std::vector<int64_t> stride = {8, 2, 1};
@@ -8341,7 +8670,7 @@ TEST_F(AtenXlaTensorTest, TestAvgPool3DNoBatchBackward) {
 }
 
 TEST_F(AtenXlaTensorTest, TestAdaptiveAvgPool2DBackward) {
-  for (int64_t output_size : {7, 8}) {
+  for (int64_t output_size : {7, 8, 3}) {
     auto testfn =
         [&](const std::vector<torch::Tensor>& inputs) -> torch::Tensor {
       return torch::adaptive_avg_pool2d(inputs[0], {output_size, output_size});
@@ -8356,6 +8685,23 @@ TEST_F(AtenXlaTensorTest, TestAdaptiveAvgPool2DBackward) {
   }
 }
 
+TEST_F(AtenXlaTensorTest, TestAdaptiveAvgPool3DBackward) {
+  for (auto output_size :
+       std::vector<std::vector<int64_t>>{{3, 7, 4}, {4, 3, 5}}) {
+    auto testfn =
+        [&](const std::vector<torch::Tensor>& inputs) -> torch::Tensor {
+      return torch::adaptive_avg_pool3d(inputs[0], output_size);
+    };
+    ForEachDevice([&](const torch::Device& device) {
+      TestBackward(
+          {torch::rand(
+              {2, 3, 6, 7, 8},
+              torch::TensorOptions(torch::kFloat).requires_grad(true))},
+          device, testfn);
+    });
+  }
+}
+
 TEST_F(AtenXlaTensorTest, TestAdaptiveAvgPool2DNoBatchBackward) {
   for (int64_t output_size : {7, 8}) {
     auto testfn =
@@ -8410,6 +8756,35 @@ TEST_F(AtenXlaTensorTest, TestConv2DBackward) {
   }
 }
 
+TEST_F(AtenXlaTensorTest, TestPointwiseGroupedConv2DBackward) {
+  int in_channels = 16;
+  int out_channels = 32;
+  for (int stride = 1; stride <= 2; ++stride) {
+    for (int groups : {2, 16}) {  // covers grouped and depthwise conv.
+      auto testfn =
+          [&](const std::vector<torch::Tensor>& inputs) -> torch::Tensor {
+        return torch::conv2d(inputs[0], inputs[1], inputs[2],
+                             /*stride=*/{stride, stride},
+                             /*padding=*/{0, 0},
+                             /*dilation=*/{1, 1}, groups);
+      };
+      ForEachDevice([&](const torch::Device& device) {
+        TestBackward(
+            {torch::rand({2, in_channels, 7, 7},
+                         torch::TensorOptions(torch::kDouble)
+                             .requires_grad(true)),
+             torch::rand({out_channels, in_channels / groups, 1, 1},
+                         torch::TensorOptions(torch::kDouble)
+                             .requires_grad(true)),
+             torch::rand({out_channels},
+                         torch::TensorOptions(torch::kDouble)
+                             .requires_grad(true))},
+            device, testfn);
+      });
+    }
+  }
+}
+
 TEST_F(AtenXlaTensorTest, TestTransposedConv2DBackward) {
   int in_channels = 4;
   int out_channels = 8;
@@ -9039,7 +9414,7 @@ TEST_F(AtenXlaTensorTest, TestBatchNorm2DBackward) {
           torch::ones({num_features}, torch::TensorOptions(torch::kFloat));
       TestBackward({input, weight, bias, running_mean, running_var}, device,
                    testfn,
-                   /*rtol=*/1e-3, /*atol=*/1e-4);
+                   /*rtol=*/1e-2, /*atol=*/1e-3);
     });
 
     ExpectCounterNotChanged("aten::.*", cpp_test::GetIgnoredCounters());
@@ -9181,5 +9556,71 @@ TEST_F(AtenXlaTensorTest, TestEmbeddingBackward) {
   }
 }
 
+TEST_F(AtenXlaTensorTest, TestEmbeddingBag) {
+  torch::Tensor weight =
+      torch::rand({32, 7}, torch::TensorOptions(torch::kFloat));
+  torch::Tensor indices =
+      torch::randint(32, {20}, torch::TensorOptions(torch::kLong));
+  // Includes an empty bag, and a trailing one.
+  torch::Tensor offsets =
+      torch::tensor({0, 3, 3, 9, 20}, torch::TensorOptions(torch::kLong));
+  torch::Tensor per_sample_weights =
+      torch::rand({20}, torch::TensorOptions(torch::kFloat));
+  for (int64_t mode : {0, 1, 2}) {
+    for (bool include_last_offset : {false, true}) {
+      for (bool use_weights : {false, true}) {
+        if (use_weights && mode != 0) {
+          continue;
+        }
+        torch::Tensor sample_weights =
+            use_weights ? per_sample_weights : torch::Tensor();
+        torch::Tensor output = std::get<0>(torch::embedding_bag(
+            weight, indices, offsets, /*scale_grad_by_freq=*/false, mode,
+            /*sparse=*/false, sample_weights, include_last_offset));
+        ForEachDevice([&](const torch::Device& device) {
+          torch::Tensor xla_weight = CopyToDevice(weight, device);
+          torch::Tensor xla_indices = CopyToDevice(indices, device);
+          torch::Tensor xla_offsets = CopyToDevice(offsets, device);
+          torch::Tensor xla_sample_weights =
+              use_weights ? CopyToDevice(sample_weights, device)
+                          : torch::Tensor();
+          torch::Tensor xla_output = std::get<0>(torch::embedding_bag(
+              xla_weight, xla_indices, xla_offsets,
+              /*scale_grad_by_freq=*/false, mode, /*sparse=*/false,
+              xla_sample_weights, include_last_offset));
+          AllClose(output, xla_output);
+        });
+
+        ExpectCounterNotChanged("aten::.*", cpp_test::GetIgnoredCounters());
+        ExpectCounterChanged("xla::_embedding_bag",
+                             cpp_test::GetIgnoredCounters());
+      }
+    }
+  }
+}
+
+TEST_F(AtenXlaTensorTest, TestEmbeddingBagBackward) {
+  for (int64_t mode : {0, 1, 2}) {
+    auto testfn =
+        [&](const std::vector<torch::Tensor>& inputs) -> torch::Tensor {
+      return std::get<0>(torch::embedding_bag(
+          inputs[0], inputs[1], inputs[2], /*scale_grad_by_freq=*/false, mode,
+          /*sparse=*/false, /*per_sample_weights=*/torch::Tensor(),
+          /*include_last_offset=*/false));
+    };
+    ForEachDevice([&](const torch::Device& device) {
+      torch::Tensor weight = torch::rand(
+          {32, 7}, torch::TensorOptions(torch::kFloat).requires_grad(true));
+      torch::Tensor indices =
+          torch::randperm(32, torch::TensorOptions(torch::kLong))
+              .slice(0, 0, 20);
+      torch::Tensor offsets =
+          torch::tensor({0, 3, 3, 9}, torch::TensorOptions(torch::kLong));
+      TestBackward({weight, indices, offsets}, device, testfn, /*rtol=*/1e-5,
+                   /*atol=*/1e-8);
+    });
+  }
+}
+
 }  // namespace cpp_test
 }  // namespace torch_xla
@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "cpp_test_util.h"
+#include "tensorflow/core/lib/bfloat16/bfloat16.h"
+#include "torch_xla/csrc/convert_kernels.h"
+
+namespace torch_xla {
+namespace cpp_test {
+namespace {
+
+// Odd sized, so that the scalar tails of the SIMD kernels get exercised.
+static const size_t kNumElements = 100003;
+
+std::vector<float> RandomFloats(size_t size) {
+  std::mt19937 generator(17);
+  std::vector<float> values(size);
+  for (auto& value : values) {
+    // Random bit patterns cover denormals, infinities and NaNs as well.
+    uint32_t bits = generator();
+    std::memcpy(&value, &bits, sizeof(bits));
+  }
+  values[0] = std::numeric_limits<float>::quiet_NaN();
+  values[1] = -std::numeric_limits<float>::quiet_NaN();
+  values[2] = std::numeric_limits<float>::infinity();
+  return values;
+}
+
+template <typename F>
+double MeasureGBs(size_t bytes, const F& fn) {
+  static const int kIterations = 20;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIterations; ++i) {
+    fn();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return 1e-9 * bytes * kIterations / elapsed.count();
+}
+
+}  // namespace
+
+TEST(ConvertKernelsTest, FloatToBFloat16) {
+  std::vector<float> values = RandomFloats(kNumElements);
+  std::vector<tensorflow::bfloat16> result(values.size());
+  kernels::ConvertFloatToBFloat16(values.data(), result.data(), values.size());
+  for (size_t i = 0; i < values.size(); ++i) {
+    tensorflow::bfloat16 expected(values[i]);
+    ASSERT_EQ(result[i].value, expected.value) << "at index " << i;
+  }
+}
+
+TEST(ConvertKernelsTest, BFloat16ToFloat) {
+  std::vector<float> values = RandomFloats(kNumElements);
+  std::vector<tensorflow::bfloat16> bf16_values(values.size());
+  for (size_t i = 0; i < values.size(); ++i) {
+    bf16_values[i] = tensorflow::bfloat16(values[i]);
+  }
+  std::vector<float> result(values.size());
+  kernels::ConvertBFloat16ToFloat(bf16_values.data(), result.data(),
+                                  values.size());
+  for (size_t i = 0; i < values.size(); ++i) {
+    float expected = static_cast<float>(bf16_values[i]);
+    ASSERT_EQ(std::memcmp(&result[i], &expected, sizeof(float)), 0)
+        << "at index " << i;
+  }
+}
+
+TEST(ConvertKernelsTest, UInt8ToFloat) {
+  std::vector<uint8_t> values(kNumElements);
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = static_cast<uint8_t>(i * 7);
+  }
+  std::vector<float> result(values.size());
+  kernels::ConvertUInt8ToFloat(values.data(), result.data(), values.size());
+  for (size_t i = 0; i < values.size(); ++i) {
+    ASSERT_EQ(result[i], static_cast<float>(values[i])) << "at index " << i;
+  }
+}
+
+// Not a pass/fail test, but reports the throughput of the kernels, in GB/s of
+// source plus destination data.
+TEST(ConvertKernelsTest, Benchmark) {
+  static const size_t kBenchElements = 16 * 1024 * 1024;
+  std::vector<float> floats(kBenchElements, 1.5f);
+  std::vector<tensorflow::bfloat16> bf16s(kBenchElements);
+  std::vector<uint8_t> bytes(kBenchElements, 3);
+  std::cout << "Kernels ISA: " << kernels::GetKernelsIsa() << std::endl;
+  std::cout << "f32->bf16: "
+            << MeasureGBs(kBenchElements * 6,
+                          [&]() {
+                            kernels::ConvertFloatToBFloat16(
+                                floats.data(), bf16s.data(), kBenchElements);
+                          })
+            << " GB/s" << std::endl;
+  std::cout << "bf16->f32: "
+            << MeasureGBs(kBenchElements * 6,
+                          [&]() {
+                            kernels::ConvertBFloat16ToFloat(
+                                bf16s.data(), floats.data(), kBenchElements);
+                          })
+            << " GB/s" << std::endl;
+  std::cout << "u8->f32: "
+            << MeasureGBs(kBenchElements * 5,
+                          [&]() {
+                            kernels::ConvertUInt8ToFloat(
+                                bytes.data(), floats.data(), kBenchElements);
+                          })
+            << " GB/s" << std::endl;
+}
+
+}  // namespace cpp_test
+}  // namespace torch_xla
@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "cpp_test_util.h"
+#include "tensorflow/compiler/xla/xla_client/future.h"
+
+namespace torch_xla {
+namespace cpp_test {
+
+TEST(FutureTest, BaseTest) {
+  xla::util::Promise<int> promise;
+  xla::util::Future<int> future = promise.GetFuture();
+  EXPECT_FALSE(future.IsReady());
+
+  std::thread thread([&]() { promise.SetValue(17); });
+  EXPECT_EQ(future.GetValue(), 17);
+  EXPECT_TRUE(future.IsReady());
+  thread.join();
+}
+
+TEST(FutureTest, ExceptionTest) {
+  xla::util::Promise<int> promise;
+  xla::util::Future<int> future = promise.GetFuture();
+  promise.SetException(
+      std::make_exception_ptr(std::runtime_error("Future Exception")));
+  EXPECT_TRUE(future.IsReady());
+  EXPECT_THROW(future.Wait(), std::runtime_error);
+}
+
+TEST(FutureTest, OnReadyTest) {
+  xla::util::Promise<int> promise;
+  xla::util::Future<int> future = promise.GetFuture();
+  int value = 0;
+  future.OnReady([&](const xla::util::Future<int>& ready) {
+    value = ready.GetValue();
+  });
+  EXPECT_EQ(value, 0);
+  promise.SetValue(11);
+  EXPECT_EQ(value, 11);
+
+  // Callbacks attached to a ready future run right away.
+  future.OnReady([&](const xla::util::Future<int>& ready) {
+    value = ready.GetValue() * 2;
+  });
+  EXPECT_EQ(value, 22);
+}
+
+TEST(FutureTest, ThenTest) {
+  xla::util::Promise<int> promise;
+  xla::util::Future<std::string> future =
+      promise.GetFuture()
+          .Then([](int value) { return value + 1; })
+          .Then([](int value) { return std::to_string(value); });
+  promise.SetValue(41);
+  EXPECT_EQ(future.GetValue(), "42");
+
+  xla::util::Promise<int> failed_promise;
+  xla::util::Future<int> failed_future =
+      failed_promise.GetFuture().Then([](int value) -> int {
+        throw std::runtime_error("Then Exception");
+      });
+  failed_promise.SetValue(1);
+  EXPECT_THROW(failed_future.Wait(), std::runtime_error);
+}
+
+}  // namespace cpp_test
+}  // namespace torch_xla
@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "torch_xla/csrc/graph_partitioner.h"
+#include "torch_xla/csrc/ir_util.h"
+#include "torch_xla/csrc/ops/arithmetic_ir_ops.h"
+#include "torch_xla/csrc/ops/ops.h"
+
+namespace torch_xla {
+namespace cpp_test {
+namespace {
+
+ir::Value BuildChain(size_t length) {
+  ir::Value value = ir::ops::ScalarOp(0.5, xla::F32);
+  for (size_t i = 0; i < length; ++i) {
+    value = value + ir::ops::ScalarOp(static_cast<double>(i), xla::F32);
+  }
+  return value;
+}
+
+}  // namespace
+
+TEST(GraphPartitionerTest, TestSinglePartition) {
+  ir::Value root = BuildChain(10);
+  std::vector<const ir::Node*> post_order =
+      ir::Util::ComputePostOrder({root.node.get()});
+  std::vector<ir::GraphPartition> partitions =
+      ir::GraphPartitioner::Partition(post_order, 100);
+  ASSERT_EQ(partitions.size(), 1);
+  EXPECT_EQ(partitions[0].begin, 0);
+  EXPECT_EQ(partitions[0].end, post_order.size());
+  EXPECT_EQ(partitions[0].cost, 10);
+  EXPECT_TRUE(partitions[0].outputs.empty());
+}
+
+TEST(GraphPartitionerTest, TestChainPartitions) {
+  ir::Value root = BuildChain(40);
+  std::vector<const ir::Node*> post_order =
+      ir::Util::ComputePostOrder({root.node.get()});
+  std::vector<ir::GraphPartition> partitions =
+      ir::GraphPartitioner::Partition(post_order, 8);
+  ASSERT_EQ(partitions.size(), 5);
+  size_t position = 0;
+  for (size_t p = 0; p < partitions.size(); ++p) {
+    EXPECT_EQ(partitions[p].begin, position);
+    EXPECT_LE(partitions[p].cost, 8);
+    position = partitions[p].end;
+    if (p + 1 < partitions.size()) {
+      // A chain only carries its last value into the next partition.
+      ASSERT_EQ(partitions[p].outputs.size(), 1);
+      const ir::Node* output = partitions[p].outputs[0].node;
+      EXPECT_EQ(output, post_order[partitions[p].end - 1]);
+    } else {
+      EXPECT_TRUE(partitions[p].outputs.empty());
+    }
+  }
+  EXPECT_EQ(position, post_order.size());
+}
+
+TEST(GraphPartitionerTest, TestDeterministic) {
+  ir::Value root1 = BuildChain(100);
+  ir::Value root2 = BuildChain(100);
+  std::vector<ir::GraphPartition> partitions1 = ir::GraphPartitioner::Partition(
+      ir::Util::ComputePostOrder({root1.node.get()}), 16);
+  std::vector<ir::GraphPartition> partitions2 = ir::GraphPartitioner::Partition(
+      ir::Util::ComputePostOrder({root2.node.get()}), 16);
+  ASSERT_EQ(partitions1.size(), partitions2.size());
+  for (size_t p = 0; p < partitions1.size(); ++p) {
+    EXPECT_EQ(partitions1[p].begin, partitions2[p].begin);
+    EXPECT_EQ(partitions1[p].end, partitions2[p].end);
+    EXPECT_EQ(partitions1[p].outputs.size(), partitions2[p].outputs.size());
+  }
+}
+
+}  // namespace cpp_test
+}  // namespace torch_xla
@@ -1,16 +1,52 @@
 #include <gtest/gtest.h>
 
+#include <iostream>
+#include <thread>
+
 #include "cpp_test_util.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "torch_xla/csrc/ir.h"
+#include "torch_xla/csrc/ir_util.h"
 #include "torch_xla/csrc/lowering_context.h"
+#include "torch_xla/csrc/node_pool.h"
 #include "torch_xla/csrc/ops/arithmetic_ir_ops.h"
 #include "torch_xla/csrc/ops/ops.h"
 #include "torch_xla/csrc/ops/scalar.h"
 #include "torch_xla/csrc/ops/select.h"
 #include "torch_xla/csrc/ops/unselect.h"
+#include "torch_xla/csrc/recompile_analyzer.h"
 
 namespace torch_xla {
 namespace cpp_test {
+namespace {
+
+// Builds num_chains independent chains of length additions of the input, where
+// the chain i adds (i + 1) at every step.
+std::vector<ir::Value> MakeWideGraph(const ir::Value& input, size_t num_chains,
+                                     size_t length) {
+  std::vector<ir::Value> roots;
+  for (size_t i = 0; i < num_chains; ++i) {
+    ir::Value value = input;
+    for (size_t j = 0; j < length; ++j) {
+      value = value + ir::ops::ScalarOp(static_cast<double>(i + 1),
+                                        input.shape());
+    }
+    roots.push_back(value);
+  }
+  return roots;
+}
+
+std::vector<const ir::Node*> GetRootNodes(absl::Span<const ir::Value> roots) {
+  std::vector<const ir::Node*> nodes;
+  for (auto& root : roots) {
+    nodes.push_back(root.node.get());
+  }
+  return nodes;
+}
+
+}  // namespace
 
 TEST(IrTest, TestScalarCreate) {
   ir::NodePtr scalar = ir::ops::ScalarOp(1.0, xla::F32);
@@ -54,6 +90,51 @@ TEST(IrTest, TestHash) {
   EXPECT_NE(add1->hash(), sub->hash());
 }
 
+TEST(IrTest, TestGraphSize) {
+  ir::NodePtr scalar1 = ir::ops::ScalarOp(1.0, xla::F32);
+  ir::NodePtr scalar2 = ir::ops::ScalarOp(2.0, xla::F32);
+  ir::Value add = scalar1 + scalar2;
+  EXPECT_EQ(add->graph_size(), 3);
+
+  // Shared subgraphs are counted once per use.
+  ir::Value mul = add * add;
+  EXPECT_EQ(mul->graph_size(), 7);
+  EXPECT_EQ(ir::Util::GetGraphSize({mul.node.get()}), 4);
+
+  ir::NodePtr scalar3 = ir::ops::ScalarOp(3.0, xla::F32);
+  mul->ReplaceOperand(1, scalar3);
+  EXPECT_EQ(mul->graph_size(), 5);
+}
+
+TEST(IrTest, TestReplaceOperandHash) {
+  ir::NodePtr scalar1 = ir::ops::ScalarOp(1.0, xla::F32);
+  ir::NodePtr scalar2 = ir::ops::ScalarOp(2.0, xla::F32);
+  ir::Value add = scalar1 + scalar2;
+  ir::Value mul = add * scalar2;
+  ir::Value neg = ir::ops::Neg(mul);
+  xla::hash_t hash = neg->hash();
+
+  // Replacing an operand deep in the graph updates the hashes of all the
+  // nodes above it, which then match the ones of the same graph built anew.
+  ir::NodePtr scalar3 = ir::ops::ScalarOp(3.0, xla::F32);
+  add->ReplaceOperand(0, scalar3);
+  EXPECT_NE(neg->hash(), hash);
+  ir::Value expected = ir::ops::Neg((scalar3 + scalar2) * scalar2);
+  EXPECT_EQ(neg->hash(), expected->hash());
+  EXPECT_EQ(neg->graph_size(), expected->graph_size());
+}
+
+TEST(IrTest, TestLiveHostBytes) {
+  size_t live_bytes = ir::Node::GetLiveHostBytes();
+  {
+    ir::NodePtr scalar1 = ir::ops::ScalarOp(1.0, xla::F32);
+    ir::NodePtr scalar2 = ir::ops::ScalarOp(2.0, xla::F32);
+    ir::Value add = scalar1 + scalar2;
+    EXPECT_GT(ir::Node::GetLiveHostBytes(), live_bytes);
+  }
+  EXPECT_EQ(ir::Node::GetLiveHostBytes(), live_bytes);
+}
+
 TEST(IrTest, TestSelectUnselect) {
   ForEachDevice([&](const Device& device) {
     at::Tensor a =
@@ -83,5 +164,168 @@ TEST(IrTest, TestSelectUnselect) {
   });
 }
 
+TEST(IrTest, TestLoweringCse) {
+  ForEachDevice([&](const Device& device) {
+    at::Tensor a = at::rand({4, 3}, at::TensorOptions(at::kFloat));
+    ir::Value v_a = GetTensorIrValue(a, device);
+    // The two additions are distinct IR nodes, with the same operands.
+    ir::Value v_b = v_a + ir::ops::ScalarOp(2.0, v_a.shape());
+    ir::Value v_c = v_a + ir::ops::ScalarOp(2.0, v_a.shape());
+    ir::Value v_d = v_b * v_c;
+
+    ir::LoweringContext lowering_ctx("TestLoweringCse", device);
+    lowering_ctx.GetOutputOp(v_d);
+    // Both the second scalar and the second addition are eliminated.
+    EXPECT_EQ(lowering_ctx.GetEliminatedNodeCount(), 2);
+
+    auto results = ExecuteAndFetch({v_d}, device);
+    AllClose(results.front(), (a + 2.0) * (a + 2.0));
+  });
+}
+
+TEST(IrTest, TestNodePool) {
+  ir::NodePool::Trim();
+  ir::NodePool::Stats start_stats = ir::NodePool::GetStats();
+  {
+    ir::Value value = ir::ops::ScalarOp(1.0, xla::F32);
+    for (size_t i = 0; i < 16; ++i) {
+      value = value + ir::ops::ScalarOp(1.0, xla::F32);
+    }
+  }
+  ir::NodePool::Stats stats = ir::NodePool::GetStats();
+  EXPECT_EQ(stats.allocations - start_stats.allocations, 33);
+  EXPECT_GE(stats.pooled_blocks, 33);
+  {
+    // The released blocks are reused by the nodes of the following graph.
+    ir::Value value = ir::ops::ScalarOp(1.0, xla::F32);
+    for (size_t i = 0; i < 16; ++i) {
+      value = value + ir::ops::ScalarOp(1.0, xla::F32);
+    }
+  }
+  EXPECT_GE(ir::NodePool::GetStats().pool_hits - stats.pool_hits, 33);
+
+  // Two generations without allocations release all the pooled blocks.
+  ir::NodePool::Trim();
+  ir::NodePool::Trim();
+  EXPECT_EQ(ir::NodePool::GetStats().pooled_blocks, 0);
+}
+
+TEST(IrTest, TestParallelLowering) {
+  ForEachDevice([&](const Device& device) {
+    at::Tensor a = at::rand({4, 3}, at::TensorOptions(at::kFloat));
+    ir::Value v_a = GetTensorIrValue(a, device);
+    std::vector<ir::Value> roots = MakeWideGraph(v_a, 4, 8);
+    // Leaves used as roots are lowered by the calling context.
+    roots.push_back(v_a);
+    roots.push_back(ir::ops::ScalarOp(3.0, v_a.shape()));
+    std::vector<ir::Output> outputs(roots.begin(), roots.end());
+
+    // Three regions over four chains, so that some chains span two regions.
+    ir::LoweringContext lowering_ctx("TestParallelLowering", device);
+    lowering_ctx.LowerRegions(ir::Util::ComputePostOrder(GetRootNodes(roots)),
+                              outputs, 3);
+    for (auto& output : outputs) {
+      lowering_ctx.AddResult(lowering_ctx.GetOutputOp(output));
+    }
+    EXPECT_EQ(lowering_ctx.GetParametersData().size(), 1);
+
+    auto results = Fetch(Execute(&lowering_ctx, device));
+    ASSERT_EQ(results.size(), roots.size());
+    for (size_t i = 0; i < 4; ++i) {
+      AllClose(results[i], a + 8.0 * (i + 1));
+    }
+    AllClose(results[4], a);
+    AllClose(results[5], at::full({4, 3}, 3.0, at::TensorOptions(at::kFloat)));
+  });
+}
+
+TEST(IrTest, BenchmarkParallelLowering) {
+  ForEachDevice([&](const Device& device) {
+    at::Tensor a = at::rand({16, 16}, at::TensorOptions(at::kFloat));
+    ir::Value v_a = GetTensorIrValue(a, device);
+    std::vector<ir::Value> roots = MakeWideGraph(v_a, 64, 256);
+    std::vector<ir::Output> outputs(roots.begin(), roots.end());
+    std::vector<const ir::Node*> nodes = GetRootNodes(roots);
+    ir::Util::EmissionMap emission_map;
+    std::vector<const ir::Node*> post_order =
+        ir::Util::ComputePostOrder(nodes, &emission_map);
+
+    auto build = [&](ir::LoweringContext* lowering_ctx) {
+      for (auto& output : outputs) {
+        lowering_ctx->AddResult(lowering_ctx->GetOutputOp(output));
+      }
+      xla::XlaComputation computation = ConsumeValue(lowering_ctx->Build());
+      return ConsumeValue(computation.GetProgramShape());
+    };
+
+    xla::int64 start = xla::sys_util::NowNs();
+    ir::LoweringContext sequential_ctx("Sequential", device, post_order,
+                                       emission_map);
+    xla::ProgramShape sequential_shape = build(&sequential_ctx);
+    xla::int64 sequential_ns = xla::sys_util::NowNs() - start;
+
+    size_t num_regions =
+        std::max<size_t>(std::thread::hardware_concurrency(), 2);
+    start = xla::sys_util::NowNs();
+    ir::LoweringContext parallel_ctx("Parallel", device);
+    parallel_ctx.LowerRegions(post_order, outputs, num_regions);
+    xla::ProgramShape parallel_shape = build(&parallel_ctx);
+    xla::int64 parallel_ns = xla::sys_util::NowNs() - start;
+
+    EXPECT_TRUE(xla::ShapeUtil::Equal(sequential_shape.result(),
+                                      parallel_shape.result()));
+    std::cout << "Lowering of " << post_order.size()
+              << " nodes: sequential=" << sequential_ns / 1000000
+              << "ms parallel(" << num_regions
+              << ")=" << parallel_ns / 1000000 << "ms\n";
+  });
+}
+
+TEST(IrTest, BenchmarkParallelTracing) {
+  // Every thread traces the same number of nodes, so with no serialization
+  // point the wall time stays flat as the threads grow.
+  const size_t kNumChains = 16;
+  const size_t kLength = 1024;
+  for (size_t num_threads : {1, 2, 4, 8}) {
+    auto trace = [&]() {
+      xla::Shape shape = xla::ShapeUtil::MakeShape(xla::F32, {16, 16});
+      ir::Value input = ir::ops::ScalarOp(1.0, shape);
+      std::vector<ir::Value> roots = MakeWideGraph(input, kNumChains, kLength);
+      EXPECT_EQ(roots.size(), kNumChains);
+    };
+    xla::int64 start = xla::sys_util::NowNs();
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < num_threads; ++i) {
+      threads.emplace_back(trace);
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    xla::int64 elapsed_ns = xla::sys_util::NowNs() - start;
+    std::cout << "Tracing of " << 2 * kNumChains * kLength
+              << " nodes per thread: threads=" << num_threads
+              << " time=" << elapsed_ns / 1000000 << "ms\n";
+  }
+}
+
+TEST(IrTest, TestRecompileAnalyzer) {
+  auto make_graph = [](xla::int64 size) {
+    xla::Shape shape = xla::ShapeUtil::MakeShape(xla::F32, {32, size});
+    return ir::ops::ScalarOp(1.0, shape) + ir::ops::ScalarOp(2.0, shape);
+  };
+  RecompileAnalyzer analyzer(/*max_graphs=*/4);
+  ir::Value graph1 = make_graph(128);
+  std::string report = analyzer.AnalyzeCompile(
+      graph1.hash(), ir::Util::ComputePostOrder(GetRootNodes({graph1})));
+  EXPECT_TRUE(report.empty());
+  ir::Value graph2 = make_graph(127);
+  report = analyzer.AnalyzeCompile(
+      graph2.hash(), ir::Util::ComputePostOrder(GetRootNodes({graph2})));
+  EXPECT_NE(report.find("with 3 differing nodes"), std::string::npos);
+  EXPECT_NE(report.find("shape changed from f32[32,128] to f32[32,127]"),
+            std::string::npos);
+  EXPECT_EQ(analyzer.GetReports().size(), 1);
+}
+
 }  // namespace cpp_test
 }  // namespace torch_xla
@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/metrics_exporter.h"
+
+namespace torch_xla {
+namespace cpp_test {
+
+TEST(MetricsTest, HistogramBuckets) {
+  using xla::metrics::Histogram;
+  EXPECT_EQ(Histogram::BucketIndex(0.5), 0);
+  EXPECT_EQ(Histogram::BucketIndex(-3.0), 0);
+  for (double value : {1.0, 3.0, 1000.0, 123456.0, 1e12}) {
+    double bucket_value = Histogram::BucketValue(Histogram::BucketIndex(value));
+    EXPECT_LE(std::fabs(bucket_value - value) / value,
+              1.0 / Histogram::kSubBuckets);
+  }
+  EXPECT_EQ(Histogram::BucketIndex(1e30), Histogram::kNumBuckets - 1);
+}
+
+TEST(MetricsTest, HistogramPercentiles) {
+  static const int kNumThreads = 4;
+  static const int kNumValues = 1000;
+  xla::metrics::Histogram histogram;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&]() {
+      for (int i = 1; i <= kNumValues; ++i) {
+        histogram.Add(i);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  xla::metrics::Histogram::Snapshot snapshot = histogram.GetSnapshot();
+  EXPECT_EQ(snapshot.count, kNumThreads * kNumValues);
+  EXPECT_EQ(snapshot.sum, kNumThreads * kNumValues * (kNumValues + 1) / 2);
+  for (double pct : {0.1, 0.5, 0.9, 0.99}) {
+    double expected = pct * kNumValues;
+    EXPECT_LE(std::fabs(snapshot.Percentile(pct) - expected) / expected,
+              1.0 / xla::metrics::Histogram::kSubBuckets);
+  }
+
+  xla::metrics::Histogram other;
+  other.Add(1e6);
+  snapshot.Merge(other.GetSnapshot());
+  EXPECT_EQ(snapshot.count, kNumThreads * kNumValues + 1);
+  EXPECT_GT(snapshot.Percentile(0.9999), 9e5);
+}
+
+TEST(MetricsTest, SnapshotDelta) {
+  xla::metrics::Counter counter("MetricsTestSnapshotCounter");
+  xla::metrics::Metric metric("MetricsTestSnapshotMetric");
+  xla::metrics::Counter untouched("MetricsTestSnapshotUntouched");
+  counter.AddValue(3);
+  untouched.AddValue(1);
+  metric.AddSample(2.0);
+
+  xla::metrics::MetricsSnapshot before = xla::metrics::CreateMetricsSnapshot();
+  counter.AddValue(5);
+  metric.AddSample(4.0);
+  metric.AddSample(6.0);
+  xla::metrics::MetricsSnapshot after = xla::metrics::CreateMetricsSnapshot();
+
+  xla::metrics::MetricsSnapshot delta =
+      xla::metrics::DiffMetricsSnapshots(before, after);
+  EXPECT_EQ(delta.counters.at("MetricsTestSnapshotCounter"), 5);
+  EXPECT_EQ(delta.counters.count("MetricsTestSnapshotUntouched"), 0);
+  const auto& totals = delta.metrics.at("MetricsTestSnapshotMetric");
+  EXPECT_EQ(totals.total_samples, 2);
+  EXPECT_DOUBLE_EQ(totals.accumulator, 10.0);
+}
+
+TEST(MetricsTest, OpenMetricsReport) {
+  static xla::metrics::Counter* counter =
+      new xla::metrics::Counter("aten::test_counter");
+  static xla::metrics::Metric* metric =
+      new xla::metrics::Metric("TestExportedMetric");
+  counter->AddValue(3);
+  metric->AddSample(2.0);
+  metric->AddSample(4.0);
+  std::string report = xla::metrics_exporter::CreateOpenMetricsReport();
+  EXPECT_NE(report.find("# TYPE xla_aten__test_counter counter\n"
+                        "xla_aten__test_counter_total 3\n"),
+            std::string::npos);
+  EXPECT_NE(report.find("xla_TestExportedMetric_count 2\n"
+                        "xla_TestExportedMetric_sum 6\n"),
+            std::string::npos);
+  EXPECT_EQ(report.substr(report.size() - 6), "# EOF\n");
+}
+
+}  // namespace cpp_test
+}  // namespace torch_xla
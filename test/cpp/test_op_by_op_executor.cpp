@@ -29,6 +29,27 @@ TEST(OpByOpExecutorTest, TestSimpleAdd) {
   });
 }
 
+TEST(OpByOpExecutorTest, TestElementwiseChain) {
+  ForEachDevice([&](const Device& device) {
+    at::Tensor a = at::rand({4, 16, 3}, at::TensorOptions(at::kFloat));
+    at::Tensor b = at::rand({4, 16, 3}, at::TensorOptions(at::kFloat));
+    at::Tensor c = a * b;
+    at::Tensor d = at::relu(c + a) - c;
+
+    ir::Value v_a = GetTensorIrValue(a, device);
+    ir::Value v_b = GetTensorIrValue(b, device);
+    ir::Value v_c = v_a * v_b;
+    ir::Value v_d = ir::ops::ReluOp(v_c + v_a) - v_c;
+
+    auto results_data =
+        OpByOpExecutor::Get()->Execute({v_d, v_c}, device.ToString(), {});
+    auto results = Fetch(results_data);
+
+    AllClose(results[0], d);
+    AllClose(results[1], c);
+  });
+}
+
 TEST(OpByOpExecutorTest, TestStack) {
   ForEachDevice([&](const Device& device) {
     at::Tensor a = at::rand({4, 8, 3}, at::TensorOptions(at::kFloat));
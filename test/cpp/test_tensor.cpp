@@ -85,6 +85,25 @@ TEST_F(TensorTest, TestAdd) {
   });
 }
 
+TEST_F(TensorTest, TestTensorDataCache) {
+  at::Tensor a = at::rand({4, 3}, at::TensorOptions(at::kFloat));
+  at::Tensor b = at::rand({4, 3}, at::TensorOptions(at::kFloat));
+
+  ForEachDevice([&](const Device& device) {
+    XLATensor dev_b = XLATensor::Create(b, device);
+    XLATensor dev_c1 = XLATensor::add(XLATensor::Create(a, device), dev_b, 1.0);
+    AllClose(a.add(b, 1.0), dev_c1);
+    XLATensor dev_c2 = XLATensor::add(XLATensor::Create(a, device), dev_b, 1.0);
+    AllClose(a.add(b, 1.0), dev_c2);
+    ExpectCounterChanged("TensorDataCacheHit", GetIgnoredCounters());
+    // In place updates bump the version counter, so they must not be served
+    // from the cache.
+    a.add_(1.0);
+    XLATensor dev_c3 = XLATensor::add(XLATensor::Create(a, device), dev_b, 1.0);
+    AllClose(a.add(b, 1.0), dev_c3);
+  });
+}
+
 TEST_F(TensorTest, TestIntegerAdd) {
   std::vector<at::ScalarType> types(
       {at::kByte, at::kChar, at::kShort, at::kInt, at::kLong});
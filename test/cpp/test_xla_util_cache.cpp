@@ -1,6 +1,11 @@
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <chrono>
+#include <iostream>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "cpp_test_util.h"
 #include "tensorflow/compiler/xla/xla_client/cache.h"
@@ -36,5 +41,91 @@ TEST(XlaUtilCacheTest, BasicTest) {
   EXPECT_EQ(ptr, nullptr);
 }
 
+TEST(XlaUtilCacheTest, ShardedBasicTest) {
+  static const int kMaxSize = 64;
+  xla::util::ShardedCache<int, std::string> cache(kMaxSize, /*num_shards=*/4);
+
+  for (int i = 0; i < kMaxSize; ++i) {
+    std::string istr = std::to_string(i);
+    auto ptr = cache.Add(i, std::make_shared<std::string>(istr));
+    ASSERT_NE(ptr, nullptr);
+    EXPECT_EQ(*ptr, istr);
+  }
+  // Adding an existing key returns the object already in the cache.
+  auto ptr = cache.Add(0, std::make_shared<std::string>("ZERO"));
+  ASSERT_NE(ptr, nullptr);
+  EXPECT_EQ(*ptr, "0");
+
+  // Adding many more keys than the cache can hold, evicts the old ones.
+  for (int i = kMaxSize; i < 16 * kMaxSize; ++i) {
+    cache.Add(i, std::make_shared<std::string>(std::to_string(i)));
+  }
+  int live_count = 0;
+  for (int i = 0; i < 16 * kMaxSize; ++i) {
+    ptr = cache.Get(i);
+    if (ptr != nullptr) {
+      EXPECT_EQ(*ptr, std::to_string(i));
+      ++live_count;
+    }
+  }
+  EXPECT_LE(live_count, kMaxSize);
+  EXPECT_GT(live_count, 0);
+
+  ptr = cache.Add(-1, std::make_shared<std::string>("MINUS"));
+  ASSERT_NE(ptr, nullptr);
+  EXPECT_TRUE(cache.Erase(-1));
+  EXPECT_FALSE(cache.Erase(-1));
+  EXPECT_EQ(cache.Get(-1), nullptr);
+
+  cache.Clear();
+  for (int i = 0; i < 16 * kMaxSize; ++i) {
+    EXPECT_EQ(cache.Get(i), nullptr);
+  }
+}
+
+template <typename C>
+double RunCacheBenchmark(C* cache, int num_threads, int num_keys,
+                         int num_lookups) {
+  for (int i = 0; i < num_keys; ++i) {
+    cache->Add(i, std::make_shared<std::string>(std::to_string(i)));
+  }
+  std::atomic<int> misses(0);
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < num_lookups; ++i) {
+        if (cache->Get((i + t) % num_keys) == nullptr) {
+          misses += 1;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  EXPECT_EQ(misses, 0);
+  return elapsed.count();
+}
+
+// Not a pass/fail test, but reports the lookup throughput of the two cache
+// implementations, when accessed by multiple threads.
+TEST(XlaUtilCacheTest, ContentionBenchmark) {
+  static const int kNumKeys = 512;
+  static const int kNumLookups = 200000;
+  for (int num_threads : {1, 4, 16}) {
+    xla::util::Cache<int, std::string> cache(kNumKeys);
+    xla::util::ShardedCache<int, std::string> sharded_cache(kNumKeys);
+    double cache_time =
+        RunCacheBenchmark(&cache, num_threads, kNumKeys, kNumLookups);
+    double sharded_time =
+        RunCacheBenchmark(&sharded_cache, num_threads, kNumKeys, kNumLookups);
+    std::cout << "Threads=" << num_threads << " Cache=" << cache_time
+              << "s ShardedCache=" << sharded_time << "s" << std::endl;
+  }
+}
+
 }  // namespace cpp_test
 }  // namespace torch_xla
@@ -98,6 +98,17 @@ FZXY
     self.assertEqual(type(content), type(rcontent))
     self.assertEqual(content, rcontent)
 
+  def test_streaming_read(self):
+    SIZE = 10000000  # 10MB
+    FNAME = 'test_streaming_read'
+    gcs_path = _gcs_test_path(name=FNAME)
+    content = _create_gcs_file(gcs_path, 'wb', size=SIZE, cleanup=self._cleanup)
+    with gcs.open(gcs_path, mode='rb') as fd:
+      self.assertEqual(fd.read(1000), content[:1000])
+      fd.seek(SIZE // 2)
+      self.assertEqual(fd.read(), content[SIZE // 2:])
+      self.assertEqual(fd.read(), b'')
+
   def test_list(self):
     SIZE = 10000000  # 10MB
     FNAME = 'test_list'
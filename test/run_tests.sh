@@ -32,7 +32,7 @@ export PYTORCH_TEST_WITH_SLOW=1
 
 function run_opbyop {
   echo "Running in OpByOp mode ..."
-  XLA_GET_TENSORS_OPBYOP=1 XLA_SYNC_TENSORS_OPBYOP=1 "$@"
+  XLA_GET_TENSORS_OPBYOP=1 XLA_SYNC_TENSORS_OPBYOP=1 XLA_OPBYOP_COMPILE_CHUNK=4 "$@"
 }
 
 function run_dynamic {
@@ -54,10 +54,16 @@ function run_all_tests {
   python3 "$CDIR/test_mp_all_to_all.py"
   python3 "$CDIR/test_mp_collective_permute.py"
   python3 "$CDIR/test_mp_all_gather.py"
+  python3 "$CDIR/test_mp_reduce_scatter.py"
+  python3 "$CDIR/test_mp_sharded_optimizer.py"
   python3 "$CDIR/test_mp_distributed_mm.py"
+  python3 "$CDIR/test_mp_sharded_embedding_bag.py"
   python3 "$CDIR/test_mp_rendezvous.py"
   python3 "$CDIR/test_mp_save.py"
   python3 "$CDIR/test_mp_mesh_reduce.py"
+  XLA_LOCAL_CPU_DEVICES=4 python3 "$CDIR/test_spmd.py"
+  XLA_READ_ONLY_SUBGRAPHS=1 python3 "$CDIR/test_read_only_subgraphs.py"
+  XLA_COMPILATION_CACHE_SIZE=32 python3 "$CDIR/test_compilation_cache_pinning.py"
 }
 
 if [ "$LOGFILE" != "" ]; then
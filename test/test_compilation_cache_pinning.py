@@ -0,0 +1,34 @@
+import sys
+import torch
+import torch_xla
+import torch_xla.core.xla_model as xm
+import torch_xla.debug.metrics as met
+
+# Run with a small XLA_COMPILATION_CACHE_SIZE, so that compiling many graphs
+# triggers evictions.
+
+
+def _cached_hashes():
+  return set(stats['hash'] for stats in met.compiled_graphs_stats())
+
+
+def _test_pinned_graph_survives(device):
+  x = torch.randn(16, 16, device=device)
+  y = (x @ x).relu().sum()
+  pinned_hash = met.dry_run_stats([y])['hash']
+  met.pin_compiled_graph(pinned_hash)
+  xm.mark_step()
+  for size in range(1, 128):
+    z = torch.ones(size, device=device) * 2
+    xm.mark_step()
+  if not met.counter_value('CompilationCacheEvictions'):
+    print('No computation was evicted', file=sys.stderr)
+    sys.exit(1)
+  if pinned_hash not in _cached_hashes():
+    print('The pinned graph was evicted', file=sys.stderr)
+    sys.exit(1)
+  met.pin_compiled_graph(pinned_hash, pinned=False)
+
+
+if __name__ == '__main__':
+  _test_pinned_graph_survives(xm.xla_device())
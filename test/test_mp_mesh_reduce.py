@@ -1,3 +1,4 @@
+import os
 import torch
 import torch_xla
 import torch_xla.core.xla_model as xm
@@ -26,10 +27,55 @@ def _test_tensor():
   assert rvalue.allclose(tvalue * xm.xrt_world_size())
 
 
+def _test_server_reduce():
+  tvalue = torch.tensor([[1, 2], [3, 4]], dtype=torch.float32)
+  rvalue = xm.mesh_reduce('test_mp_mesh_reduce._test_server_reduce', tvalue,
+                          xm.REDUCE_SUM)
+  assert rvalue.allclose(tvalue * xm.xrt_world_size())
+  ordinal = xm.get_ordinal()
+  rvalue = xm.mesh_reduce('test_mp_mesh_reduce._test_server_reduce_max',
+                          [ordinal, -ordinal], xm.REDUCE_MAX)
+  assert rvalue == [xm.xrt_world_size() - 1, 0]
+
+
+def _test_large_rendezvous():
+  payload = bytes([xm.get_ordinal() % 256]) * (3 * 1024 * 1024 + 7)
+  payloads = xm.rendezvous('test_mp_mesh_reduce._test_large_rendezvous',
+                           payload)
+  assert len(payloads) == xm.xrt_world_size()
+  for i, rpayload in enumerate(payloads):
+    assert rpayload == bytes([i % 256]) * len(payload)
+
+
+def _test_metrics_reducer():
+  device = xm.xla_device()
+  reports = []
+  reducer = xm.MetricsReducer(
+      lambda metrics, steps: reports.append((metrics, steps)), reduce_every=2)
+  for step in range(4):
+    loss = torch.tensor(float(step), device=device)
+    accuracy = torch.tensor(float(xm.get_ordinal()), device=device)
+    reducer.add(loss=loss, accuracy=accuracy)
+    xm.mark_step()
+  world_size = xm.xrt_world_size()
+  mean_ordinal = (world_size - 1) / 2.0
+  assert len(reports) == 2
+  assert reports[0][1] == 2 and reports[1][1] == 2
+  assert abs(reports[0][0]['loss'] - 0.5) < 1e-5
+  assert abs(reports[1][0]['loss'] - 2.5) < 1e-5
+  for metrics, _ in reports:
+    assert abs(metrics['accuracy'] - mean_ordinal) < 1e-5
+
+
 def _mp_fn(index):
   _test_scalar()
   _test_tensor()
+  _test_server_reduce()
+  _test_large_rendezvous()
+  _test_metrics_reducer()
 
 
 if __name__ == '__main__':
+  # Makes the large rendezvous go through multiple chunked rounds.
+  os.environ['XRT_MESH_CHUNK_SIZE'] = str(1024 * 1024)
   xmp.spawn(_mp_fn, args=())
@@ -0,0 +1,45 @@
+import sys
+import torch
+import torch_xla
+import torch_xla.core.xla_model as xm
+import torch_xla.distributed.xla_multiprocessing as xmp
+
+
+def _mp_fn(index):
+  device = xm.xla_device()
+  if xm.xla_device_hw(device) == 'TPU':
+    shard_size = 4
+    world_size = xm.xrt_world_size()
+    ordinal = xm.get_ordinal()
+    value = torch.arange(
+        shard_size * world_size, dtype=torch.float, device=device) + ordinal
+    result_tensor = xm.reduce_scatter(
+        xm.REDUCE_SUM, value, scale=1.0 / world_size, scatter_dim=0)
+
+    # The mean of the ordinals is added to each of the shard elements.
+    offset = (world_size - 1) / 2.0
+    expected = torch.arange(
+        ordinal * shard_size, (ordinal + 1) * shard_size,
+        dtype=torch.float) + offset
+    result = result_tensor.cpu()
+    if not result.allclose(expected):
+      print(
+          'Wrong reduce-scatter result from core {}: {}'.format(
+              ordinal, result),
+          file=sys.stderr)
+      sys.exit(1)
+
+    gathered = xm.all_gather(result_tensor, dim=0).cpu()
+    expected = torch.arange(shard_size * world_size, dtype=torch.float) + offset
+    if not gathered.allclose(expected):
+      print(
+          'Wrong all-gather result from core {}: {}'.format(ordinal, gathered),
+          file=sys.stderr)
+      sys.exit(1)
+  else:
+    print(
+        'Default device {} is not a TPU device'.format(device), file=sys.stderr)
+
+
+if __name__ == '__main__':
+  xmp.spawn(_mp_fn, args=())
@@ -19,6 +19,15 @@ def _mp_fn(index):
       print('xm.all_reduce() produced wrong reductions', file=sys.stderr)
       print(xones, file=sys.stderr)
       sys.exit(1)
+
+    # Small integers are exactly representable in BF16.
+    xthrees = (ones + 2.0).to(device)
+    xm.all_reduce(xm.REDUCE_SUM_BF16, [xthrees])
+    if (xthrees.dtype != torch.float32 or
+        not xthrees.cpu().allclose(ones * 3.0 * float(xm.xrt_world_size()))):
+      print('xm.all_reduce() produced wrong BF16 reductions', file=sys.stderr)
+      print(xthrees, file=sys.stderr)
+      sys.exit(1)
   else:
     print(
         'Default device {} does not support replication'.format(device),
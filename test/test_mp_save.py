@@ -5,6 +5,7 @@ import torch
 import torch_xla
 import torch_xla.core.xla_model as xm
 import torch_xla.distributed.xla_multiprocessing as xmp
+import torch_xla.utils.async_checkpoint as xac
 
 
 def _create_state_dict(device):
@@ -35,8 +36,27 @@ def _get_data_str(data):
   return bio.getvalue()
 
 
+def _test_async_save(device):
+  w = torch.randn(8, 8, device=device)
+  expected = w.cpu()
+  path = _get_temp_file()
+  checkpointer = xac.AsyncCheckpointer()
+  checkpointer.save({'w': w, 'step': 1}, path, master_only=False)
+  # The in-place updates of the following steps must not leak into the saved
+  # snapshot.
+  for _ in range(3):
+    w.add_(1.0)
+    xm.mark_step()
+  checkpointer.wait()
+  ldd = torch.load(path)
+  os.remove(path)
+  assert ldd['step'] == 1
+  assert ldd['w'].allclose(expected)
+
+
 def _mp_fn(index, temp_file):
   device = xm.xla_device()
+  _test_async_save(device)
   dd = _create_state_dict(device)
   xm.save(dd, temp_file)
   ldd = torch.load(temp_file)
@@ -0,0 +1,46 @@
+import sys
+import torch
+import torch.nn.functional as F
+import torch_xla
+import torch_xla.core.functions as xf
+import torch_xla.core.xla_model as xm
+import torch_xla.distributed.xla_multiprocessing as xmp
+
+
+def _mp_fn(index):
+  device = xm.xla_device()
+  if xm.xla_device_hw(device) == 'TPU':
+    world_size = xm.xrt_world_size()
+    ordinal = xm.get_ordinal()
+    shard_size = 8
+    num_embeddings = shard_size * world_size
+    torch.manual_seed(11)
+    table = torch.randn(num_embeddings, 5)
+    # Every replica looks up its own bags.
+    torch.manual_seed(ordinal)
+    indices = torch.randint(0, num_embeddings, (12,))
+    offsets = torch.tensor([0, 2, 2, 7])
+    weight = table[ordinal * shard_size:(ordinal + 1) * shard_size]
+
+    for mode in ['sum', 'mean']:
+      expected = F.embedding_bag(indices, table, offsets, mode=mode)
+      result = xf.sharded_embedding_bag(
+          weight.to(device),
+          indices.to(device),
+          offsets.to(device),
+          num_embeddings,
+          mode=mode).cpu()
+      if not expected.allclose(result, rtol=1e-04, atol=1e-04):
+        print(
+            'sharded_embedding_bag() produced wrong result with mode {}'.format(
+                mode),
+            file=sys.stderr)
+        print('[{}]\n{}\n{}'.format(index, expected, result), file=sys.stderr)
+        sys.exit(1)
+  else:
+    print(
+        'Default device {} is not a TPU device'.format(device), file=sys.stderr)
+
+
+if __name__ == '__main__':
+  xmp.spawn(_mp_fn, args=())
@@ -0,0 +1,51 @@
+import sys
+import torch
+import torch.nn as nn
+import torch.optim as optim
+import torch_xla
+import torch_xla.core.xla_model as xm
+import torch_xla.distributed.xla_multiprocessing as xmp
+
+
+def _make_model(device):
+  torch.manual_seed(42)
+  # Odd sizes, so that the flattened parameters need padding.
+  return nn.Sequential(nn.Linear(7, 5), nn.ReLU(), nn.Linear(5, 3)).to(device)
+
+
+def _train(model, optimizer, step_fn, device):
+  for step in range(3):
+    torch.manual_seed(100 * step + xm.get_ordinal())
+    data = torch.randn(4, 7).to(device)
+    optimizer.zero_grad()
+    model(data).sum().backward()
+    step_fn()
+    xm.mark_step()
+  return [p.cpu() for p in model.parameters()]
+
+
+def _mp_fn(index):
+  device = xm.xla_device()
+  if xm.xla_device_hw(device) == 'TPU':
+    model = _make_model(device)
+    optimizer = optim.Adam(model.parameters(), lr=0.1)
+    expected = _train(model, optimizer, lambda: xm.optimizer_step(optimizer),
+                      device)
+
+    model = _make_model(device)
+    sharded = xm.ShardedOptimizer(model.parameters(), optim.Adam, lr=0.1)
+    results = _train(model, sharded, sharded.step, device)
+    for p, expected_p in zip(results, expected):
+      if not p.allclose(expected_p, rtol=1e-4, atol=1e-4):
+        print(
+            'Wrong sharded optimizer result from core {}:\n{}\n{}'.format(
+                xm.get_ordinal(), p, expected_p),
+            file=sys.stderr)
+        sys.exit(1)
+  else:
+    print(
+        'Default device {} is not a TPU device'.format(device), file=sys.stderr)
+
+
+if __name__ == '__main__':
+  xmp.spawn(_mp_fn, args=())
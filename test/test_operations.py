@@ -5,6 +5,7 @@ import argparse
 import os
 import sys
 import tempfile
+import threading
 
 parser = argparse.ArgumentParser(add_help=False)
 parser.add_argument('--replicated', action='store_true')
@@ -35,10 +36,15 @@ import torch_xla.distributed.data_parallel as dp
 import torch_xla.debug.metrics as met
 import torch_xla.debug.model_comparator as mc
 import torch_xla.distributed.parallel_loader as pl
+import torch_xla.distributed.pipeline_parallel as pp
+import torch_xla.utils.image_transforms as image_transforms
+import torch_xla.utils.keyd_queue as kq
 import torch_xla.utils.utils as xu
 import torch_xla.utils.serialization as xser
+import torch_xla.utils.tensor_shard as xts
 import torch_xla.core.xla_model as xm
 import torch_xla.core.functions as xf
+import torch_xla.core.optimizers as xo
 import torchvision
 import unittest
 
@@ -535,6 +541,47 @@ class TestParallelLoader(XlaTestCase):
         self.assertEqual(data.device, device)
         self.assertEqual(target.device, device)
 
+  def test_content(self):
+    device = xm.xla_device()
+    batches = [(_gen_tensor(4, 8), {'label': torch.tensor([i])})
+               for i in range(6)]
+    para_loader = pl.ParallelLoader(batches, [device], device_prefetch_size=2)
+    loader = para_loader.per_device_loader(device)
+    count = 0
+    for (data, target), (xdata, xtarget) in zip(batches, loader):
+      self.assertEqual(xdata.device, device)
+      self.assertEqual(xtarget['label'].device, device)
+      self.assertEqual(xdata.cpu(), data)
+      self.assertEqual(xtarget['label'].cpu(), target['label'])
+      count += 1
+    self.assertEqual(count, len(batches))
+
+
+class TestDeviceImageAugment(XlaTestCase):
+
+  def test_eval(self):
+    device = xm.xla_device()
+    mean = [0.485, 0.456, 0.406]
+    std = [0.229, 0.224, 0.225]
+    images = torch.randint(0, 256, (4, 10, 12, 3), dtype=torch.uint8)
+    augment = image_transforms.DeviceImageAugment((6, 8),
+                                                  mean,
+                                                  std,
+                                                  train=False)
+    expected = images.permute(0, 3, 1, 2)[:, :, 2:8, 2:10].float() / 255.0
+    expected = (expected - torch.tensor(mean).view(1, 3, 1, 1)) / torch.tensor(
+        std).view(1, 3, 1, 1)
+    self.assertEqual(augment(images.to(device)).cpu(), expected, prec=1e-5)
+
+  def test_train(self):
+    device = xm.xla_device()
+    images = torch.randint(0, 256, (8, 10, 12, 3), dtype=torch.uint8)
+    augment = image_transforms.DeviceImageAugment(6, [0.0] * 3, [1.0] * 3)
+    result = augment(images.to(device)).cpu()
+    self.assertEqual(result.size(), torch.Size([8, 3, 6, 6]))
+    self.assertGreaterEqual(result.min().item(), 0.0)
+    self.assertLessEqual(result.max().item(), 1.0)
+
 
 class TestAtenTensorTo(XlaTestCase):
 
@@ -557,6 +604,17 @@ class TestAtenTensorTo(XlaTestCase):
       t1 = t1 + torch.ones_like(t1, device=torch.device(dev1))
       self.assertEqual(t0.cpu(), t1.cpu())
 
+  def test_device_to_device(self):
+    devices = xm.get_xla_supported_devices()
+    if len(devices) < 2:
+      raise unittest.SkipTest('Requires multiple devices')
+    t = _gen_tensor(8, 12)
+    xt = t.to(device=torch.device(devices[0])) * 2
+    xt1 = xt.to(device=torch.device(devices[1]))
+    self.assertEqual(xt1.device, torch.device(devices[1]))
+    self.assertEqual(xt1.cpu(), t * 2)
+    self.assertIn('DeviceToDeviceCopy', met.counter_names())
+
 
 class XlaMNIST(nn.Module):
 
@@ -606,6 +664,45 @@ class TestParallelTensorMNIST(XlaTestCase):
     model_parallel(loop_fn, train_loader)
 
 
+class TestParallelBroadcastParams(XlaTestCase):
+
+  def test(self):
+    devices = xm.get_xla_supported_devices()
+    model = XlaMNIST()
+    model_parallel = dp.DataParallel(
+        model, device_ids=devices, broadcast_params=True)
+    for device_model in model_parallel.models:
+      for p, xp in zip(model.parameters(), device_model.parameters()):
+        self.assertEqual(p, xp.cpu())
+
+
+class TestPipelineParallel(XlaTestCase):
+
+  def test(self):
+    devices = xm.get_xla_supported_devices()
+    if len(devices) < 2:
+      raise unittest.SkipTest('Requires multiple devices')
+    stages = [nn.Sequential(nn.Linear(8, 16), nn.ReLU()), nn.Linear(16, 4)]
+    ref_model = copy.deepcopy(nn.Sequential(*stages))
+    data = _gen_tensor(8, 8)
+    target = torch.randint(0, 4, (8,), dtype=torch.int64)
+    pipeline = pp.PipelineParallel(
+        stages,
+        devices[:2],
+        loss_fn=nn.CrossEntropyLoss(),
+        num_micro_batches=4)
+    loss = pipeline.train_step(data, target)
+    ref_loss = nn.CrossEntropyLoss()(ref_model(data), target)
+    ref_loss.backward()
+    self.assertEqual(loss.cpu(), ref_loss, prec=1e-4)
+    params = list(pipeline.stages[0].parameters()) + list(
+        pipeline.stages[1].parameters())
+    for p, ref_p in zip(params, ref_model.parameters()):
+      self.assertEqual(p.grad.cpu(), ref_p.grad, prec=1e-4)
+    for stats in pipeline.stage_stats:
+      self.assertEqual(stats.steps, 1)
+
+
 class TestParallelTensorResnet18(XlaTestCase):
 
   def test(self):
@@ -678,6 +775,13 @@ class TestDynamicShape(XlaTestCase):
         torch.masked_select(x, mask), 0)
     self.assertEqual(x_dim0_shape.item(), 3)
 
+  def test_dynamic_shape_propagation(self):
+    x = torch.tensor((0, 1, 2, 0, 3, 4), device=xm.xla_device())
+    y = torch.masked_select(x, x.ge(2)).unsqueeze(1) * 2 + 1
+    y_dim0_shape = torch_xla._XLAC._get_xla_tensor_dimension_size(y, 0)
+    self.assertEqual(y_dim0_shape.item(), 3)
+    self.assertEqual(y.sum().item(), 21)
+
 
 class TestAtenXlaTensor(XlaTestCase):
 
@@ -1497,6 +1601,21 @@ class TestAtenXlaTensor(XlaTestCase):
       loaded_model = cpu_model.to(xla_device)
       self.assertEqual(model.state_dict(), loaded_model.state_dict())
 
+  def test_sharded_serialization_api(self):
+    with tempfile.TemporaryDirectory() as tmpdir:
+      path = os.path.join(tmpdir, 'checkpoint')
+      xla_device = xm.xla_device()
+      model = XlaMNIST().to(xla_device)
+      data = {'model': model.state_dict(), 'epoch': 3}
+      xser.save_sharded(data, path, num_shards=3)
+      loaded_data = xser.load_sharded(path, device=xla_device)
+      self.assertEqual(loaded_data['epoch'], 3)
+      for key, value in loaded_data['model'].items():
+        self.assertEqual(value.device, xla_device)
+      loaded_model = XlaMNIST().to(xla_device)
+      loaded_model.load_state_dict(loaded_data['model'])
+      self.assertEqual(model.state_dict(), loaded_model.state_dict())
+
   def test_deepcopy(self):
     xla_device = xm.xla_device()
     x = torch.rand(5, device=xla_device)
@@ -1648,6 +1767,159 @@ class TestAtenXlaTensor(XlaTestCase):
     y = torch.rand(5)
     self.assertEqual(x + y, y + x)
 
+  def test_nll_loss_many_classes(self):
+    # Above XLA_NLL_GATHER_MIN_CLASSES the loss is lowered with a gather, and
+    # the gradient with a scatter.
+    xla_device = xm.xla_device()
+    num_classes = 2048
+    labels = torch.randint(num_classes, (8,))
+    labels[3] = -100
+    weight = torch.rand(num_classes)
+    for reduction in ['none', 'sum', 'mean']:
+      for w in [None, weight]:
+        logits = torch.randn(8, num_classes).log_softmax(1).requires_grad_()
+        xla_logits = logits.detach().to(xla_device).requires_grad_()
+        loss = F.nll_loss(logits, labels, weight=w, reduction=reduction)
+        xla_loss = F.nll_loss(
+            xla_logits,
+            labels.to(xla_device),
+            weight=w.to(xla_device) if w is not None else None,
+            reduction=reduction)
+        self.assertEqual(loss, xla_loss.cpu(), prec=1e-4)
+        loss.sum().backward()
+        xla_loss.sum().backward()
+        self.assertEqual(logits.grad, xla_logits.grad.cpu(), prec=1e-5)
+
+  def test_index_put_unique_indices(self):
+    xla_device = xm.xla_device()
+    x = torch.zeros(100, 8)
+    index = torch.randperm(100)[:30]
+    values = torch.randn(30, 8)
+    xla_x = x.to(xla_device)
+    xla_index = xf.assume_unique_indices(index.to(xla_device))
+    xla_x.index_put_((xla_index,), values.to(xla_device), accumulate=True)
+    x.index_put_((index,), values, accumulate=True)
+    hlo_text = torch_xla._XLAC._get_xla_tensors_hlo([xla_x])
+    self.assertIn('unique_indices=true', hlo_text)
+    self.assertEqual(x, xla_x.cpu())
+
+  def test_cumulative_long_dims(self):
+    # Dimensions of at least XLA_CUMULATIVE_SCAN_MIN_SIZE elements are lowered
+    # as a log-step scan.
+    xla_device = xm.xla_device()
+    x = torch.randint(-100, 100, (4, 10000))
+    self.assertEqual(x.cumsum(1), x.to(xla_device).cumsum(1).cpu())
+    y = torch.empty(3000, 2).uniform_(0.999, 1.001)
+    self.assertEqual(
+        y.cumprod(0), y.to(xla_device).cumprod(0).cpu(), prec=1e-4)
+
+  def test_topk_many_elements(self):
+    # Small k selections out of large dimensions sort XLA_TOPK_BLOCK_SIZE
+    # blocks, and merge their candidates.
+    xla_device = xm.xla_device()
+    for size in [100000, 4096]:
+      x = torch.randn(3, size)
+      xla_x = x.to(xla_device)
+      for largest in [True, False]:
+        values, indices = torch.topk(x, 10, dim=1, largest=largest)
+        xla_values, xla_indices = torch.topk(
+            xla_x, 10, dim=1, largest=largest)
+        self.assertEqual(values, xla_values.cpu())
+        self.assertEqual(indices, xla_indices.cpu())
+      values, indices = torch.kthvalue(x.t(), 7, dim=0)
+      xla_values, xla_indices = torch.kthvalue(xla_x.t(), 7, dim=0)
+      self.assertEqual(values, xla_values.cpu())
+      self.assertEqual(indices, xla_indices.cpu())
+
+  def test_fused_cross_entropy(self):
+    xla_device = xm.xla_device()
+    num_classes = 4096
+    labels = torch.randint(num_classes, (8,))
+    labels[5] = -100
+    for chunk_size in [None, 1024, 1000]:
+      for reduction in ['none', 'sum', 'mean']:
+        logits = torch.randn(8, num_classes, requires_grad=True)
+        xla_logits = logits.detach().to(xla_device).requires_grad_()
+        loss = F.cross_entropy(logits, labels, reduction=reduction)
+        xla_loss = xf.cross_entropy(
+            xla_logits,
+            labels.to(xla_device),
+            reduction=reduction,
+            chunk_size=chunk_size)
+        self.assertEqual(loss, xla_loss.cpu(), prec=1e-4)
+        loss.sum().backward()
+        xla_loss.sum().backward()
+        self.assertEqual(logits.grad, xla_logits.grad.cpu(), prec=1e-5)
+
+  def test_growable_buffer(self):
+    xla_device = xm.xla_device()
+    buffer = xf.GrowableBuffer((2, 16, 3), dim=1, device=xla_device)
+    slices = []
+    for size in [1, 1, 4, 1]:
+      value = torch.randn(2, size, 3)
+      slices.append(value)
+      buffer.append(value.to(xla_device))
+      self.assertEqual(buffer.view().cpu(), torch.cat(slices, dim=1))
+      self.assertEqual(buffer.mask().cpu().view(-1),
+                       torch.arange(16) < buffer.length)
+    self.assertEqual(buffer.length, 7)
+    buffer.reset()
+    value = torch.randn(2, 2, 3)
+    buffer.append(value.to(xla_device))
+    self.assertEqual(buffer.view().cpu(), value)
+
+  def test_kv_cache_decoding(self):
+    xla_device = xm.xla_device()
+    q, k, v = (torch.randn(2, 4, 9, 8) for _ in range(3))
+    scores = torch.matmul(q, k.transpose(-2, -1)) / math.sqrt(8)
+    causal = torch.ones(9, 9, dtype=torch.bool).tril()
+    scores = scores.masked_fill(~causal, float('-inf'))
+    expected = torch.matmul(F.softmax(scores, dim=-1), v)
+    cache = xf.KVCache(1, 2, 4, 16, 8, device=xla_device)
+    # A prompt of three positions, followed by one position per step.
+    outputs = [
+        cache.attention(0, q[:, :, :3].to(xla_device),
+                        k[:, :, :3].to(xla_device), v[:, :, :3].to(xla_device))
+    ]
+    xm.mark_step()
+    compiles = None
+    for i in range(3, 9):
+      outputs.append(
+          cache.attention(0, q[:, :, i:i + 1].to(xla_device),
+                          k[:, :, i:i + 1].to(xla_device),
+                          v[:, :, i:i + 1].to(xla_device)))
+      xm.mark_step()
+      if i == 4:
+        compiles = met.counter_value('UncachedCompile')
+    self.assertEqual(met.counter_value('UncachedCompile'), compiles)
+    self.assertEqual(cache.length, 9)
+    self.assertEqual(
+        expected, torch.cat([x.cpu() for x in outputs], dim=2), prec=1e-4)
+
+  def test_small_batched_linalg(self):
+    xla_device = xm.xla_device()
+    for n in [4, 16]:
+      a = torch.randn(32, n, n)
+      spd = torch.matmul(a, a.transpose(-2, -1)) + n * torch.eye(n)
+      b = torch.randn(32, n, 3)
+      for upper in [False, True]:
+        xla_l = torch.cholesky(spd.to(xla_device), upper=upper)
+        self.assertEqual(
+            torch.cholesky(spd, upper=upper), xla_l.cpu(), prec=1e-3)
+        for transpose in [False, True]:
+          x, _ = torch.triangular_solve(
+              b, xla_l.cpu(), upper=upper, transpose=transpose)
+          xla_x, _ = torch.triangular_solve(
+              b.to(xla_device), xla_l, upper=upper, transpose=transpose)
+          self.assertEqual(x, xla_x.cpu(), prec=1e-3)
+      for shape in [(32, n, n), (32, n + 2, n), (32, n, n + 2)]:
+        a = torch.randn(*shape)
+        for some in [False, True]:
+          q, r = torch.qr(a, some=some)
+          xla_q, xla_r = torch.qr(a.to(xla_device), some=some)
+          self.assertEqual(q.abs(), xla_q.cpu().abs(), prec=1e-3)
+          self.assertEqual(r.abs(), xla_r.cpu().abs(), prec=1e-3)
+
 
 class MNISTComparator(nn.Module):
 
@@ -1738,6 +2010,49 @@ class TestOpBuilder(XlaTestCase):
     self.runOpBuilderTest(
         'test_mul', [torch.randn(2, 2), torch.randn(2, 2)], op_fn)
 
+  def test_registered_computation(self):
+
+    def op_fn(a, b, **kwargs):
+      return a * b + a
+
+    device = xm.xla_device()
+    # Two distinct ops building the same computation share the registered one.
+    op1 = xor.register('test_registered', op_fn)
+    op2 = xor.register('test_registered', op_fn)
+    args_list = [(torch.randn(2, 2), torch.randn(2, 2)) for _ in range(3)]
+    xla_args_list = [tuple(x.to(device) for x in args) for args in args_list]
+    hits = met.counter_value('RegisteredComputationHit') or 0
+    xla_results = op1.batch(xla_args_list)
+    self.assertEqual(
+        xla_results[0].cpu(), op2(*xla_args_list[0]).cpu(), prec=1e-5)
+    self.assertEqual(met.counter_value('RegisteredComputationHit'), hits + 1)
+    for args, xla_result in zip(args_list, xla_results):
+      self.assertEqual(op_fn(*args), xla_result.cpu(), prec=1e-5)
+
+  def test_custom_kernel_tracing(self):
+
+    def shape_fn(shapes):
+      return [
+          xb.mkshape(shapes[0].dtype, shapes[0].sizes),
+          xb.mkshape(shapes[0].dtype, shapes[0].sizes[:1])
+      ]
+
+    # The test backends have no such CustomCall target, so the kernel is only
+    # traced, and its outputs never fetched.
+    kernel = xor.register_custom_kernel(
+        'test_kernel',
+        target='test_kernel_target',
+        shape_fn=shape_fn,
+        backend_config='alpha=1')
+    device = xm.xla_device()
+    xla_x = torch.randn(4, 3, device=device)
+    xla_y, xla_z = kernel(xla_x)
+    self.assertEqual(xla_y.size(), torch.Size([4, 3]))
+    self.assertEqual(xla_z.size(), torch.Size([4]))
+    graph = torch_xla._XLAC._get_xla_tensors_text([xla_y])
+    self.assertIn('xla::_kernel_test_kernel', graph)
+    self.assertIn('target=test_kernel_target', graph)
+
   def test_conditional(self):
 
     def op_fn(k, a, b, k0=None):
@@ -1814,6 +2129,33 @@ class TestGeneric(XlaTestCase):
     self.assertTrue(revs['xla'])
     self.assertTrue('torch' in revs)
 
+  def test_flat_buffer_view_updates(self):
+
+    def update_fn(flat):
+      flat[0:5].add_(1.0)
+      flat[5:12].mul_(2.0)
+      flat[12:20].view(2, 4).fill_(3.0)
+      flat[2:4].fill_(-1.0)
+      flat[16:20].copy_(torch.arange(4, dtype=flat.dtype, device=flat.device))
+      flat[16:20].fill_(7.0)
+      return flat
+
+    flat = _gen_tensor(20)
+    xflat = flat.to(xm.xla_device())
+    self.assertEqual(update_fn(flat.clone()), update_fn(xflat).cpu())
+
+  def test_pad_to_buckets(self):
+    t = _gen_tensor(2, 5, 3)
+    padded, mask = xm.pad_to_buckets(t, [1], buckets=[4, 8], value=-1)
+    self.assertEqual(padded.size(), torch.Size([2, 8, 3]))
+    self.assertEqual(mask.size(), torch.Size([1, 8, 1]))
+    self.assertEqual(padded[:, :5, :], t)
+    self.assertTrue((padded[:, 5:, :] == -1).all())
+    self.assertEqual(mask.sum().item(), 5)
+    results = xm.pad_to_buckets([t, _gen_tensor(2, 9)], [-1])
+    self.assertEqual(results[0][0].size(), torch.Size([2, 5, 4]))
+    self.assertEqual(results[1][0].size(), torch.Size([2, 16]))
+
   def test_send_to_device_grad(self):
     xla_device = xm.xla_device()
     t = _gen_tensor(2, 2, requires_grad=True)
@@ -1846,6 +2188,319 @@ class TestGeneric(XlaTestCase):
                      torch.tensor([2, 0, 3, 1], dtype=torch.int32))
     self.assertEqual(num_valid.item(), 3)
 
+  def test_batched_nms(self):
+
+    def gen_boxes(*sizes):
+      corners = torch.rand(*sizes, 2, 2) * 10.0
+      return torch.cat([corners.min(-2)[0], corners.max(-2)[0]], dim=-1)
+
+    def nms_indices(boxes, scores, score_threshold, iou_threshold,
+                    output_size):
+      selected_indices, num_valid = xf.nms(boxes, scores, score_threshold,
+                                           iou_threshold, output_size)
+      return selected_indices.cpu()[:num_valid.item()]
+
+    xla_device = xm.xla_device()
+    batch, classes, num_boxes, output_size, top_k = 2, 3, 12, 4, 6
+    boxes = gen_boxes(batch, num_boxes).to(xla_device)
+    scores = torch.rand(batch, classes, num_boxes).to(xla_device)
+    score_threshold = torch.tensor(0.2).to(xla_device)
+    iou_threshold = torch.tensor(0.3).to(xla_device)
+
+    selected_indices, num_valid = xf.nms(boxes, scores, score_threshold,
+                                         iou_threshold, output_size)
+    self.assertEqual(selected_indices.size(), (batch, classes, output_size))
+    self.assertEqual(num_valid.size(), (batch, classes))
+    topk_indices, topk_num_valid = xf.nms(
+        boxes.unsqueeze(1).expand(batch, classes, num_boxes, 4),
+        scores,
+        score_threshold,
+        iou_threshold,
+        output_size,
+        top_k=top_k)
+    for b in range(batch):
+      for c in range(classes):
+        count = num_valid[b, c].item()
+        expected = nms_indices(boxes[b], scores[b, c], score_threshold,
+                               iou_threshold, output_size)
+        self.assertEqual(selected_indices[b, c].cpu()[:count], expected)
+        # With top_k, the problem is the same as running the NMS over the
+        # top_k highest scoring boxes only.
+        candidates = torch.topk(scores[b, c].cpu(), top_k)[1]
+        expected = nms_indices(boxes[b].cpu()[candidates].to(xla_device),
+                               scores[b, c].cpu()[candidates].to(xla_device),
+                               score_threshold, iou_threshold, output_size)
+        count = topk_num_valid[b, c].item()
+        self.assertEqual(topk_indices[b, c].cpu()[:count],
+                         candidates[expected.long()].int())
+
+  def test_simplify_identity_ops(self):
+    xla_device = xm.xla_device()
+    t = _gen_tensor(4, 8)
+    xt = t.to(xla_device)
+    xgrad = torch.zeros(4, 8, device=xla_device)
+    xgrad.add_(xt)
+    xout = (xgrad * 1 - 0).expand(4, 8)
+    text = torch_xla._XLAC._get_xla_tensors_text([xout])
+    self.assertNotIn('aten::add', text)
+    self.assertNotIn('aten::sub', text)
+    self.assertNotIn('aten::mul', text)
+    self.assertNotIn('aten::expand', text)
+    self.assertEqual(xout.cpu(), t)
+    self.assertIn('SimplifiedIrOps', met.counter_names())
+
+  def test_dropout(self):
+    xla_device = xm.xla_device()
+    x = torch.rand(64, 128) + 1.0
+    xx = x.to(xla_device).requires_grad_()
+    xout = xf.dropout(xx, p=0.25)
+    xout.sum().backward()
+    out = xout.detach().cpu()
+    grad = xx.grad.cpu()
+    kept = out != 0
+    # The kept elements are scaled, and the backward uses the same mask.
+    self.assertEqual(out[kept], x[kept] / 0.75, prec=1e-5)
+    self.assertEqual(grad, kept.to(grad.dtype) / 0.75, prec=1e-5)
+    self.assertGreater(kept.float().mean().item(), 0.7)
+    self.assertLess(kept.float().mean().item(), 0.8)
+    self.assertIs(xf.dropout(xx, p=0.25, training=False), xx)
+
+  def test_scaled_dot_product_attention(self):
+
+    def attention(query, key, value, scale):
+      scores = torch.matmul(query, key.transpose(-1, -2)) * scale
+      return torch.matmul(F.softmax(scores, dim=-1), value)
+
+    xla_device = xm.xla_device()
+    query = torch.randn(2, 3, 8, 16, requires_grad=True)
+    key = torch.randn(2, 3, 12, 16, requires_grad=True)
+    value = torch.randn(2, 3, 12, 4, requires_grad=True)
+    scale = 1.0 / math.sqrt(16)
+    output = attention(query, key, value, scale)
+    output.sum().backward()
+
+    for block_size in [4, 5, 512]:
+      xquery = query.detach().to(xla_device).requires_grad_()
+      xkey = key.detach().to(xla_device).requires_grad_()
+      xvalue = value.detach().to(xla_device).requires_grad_()
+      xoutput = xf.scaled_dot_product_attention(
+          xquery, xkey, xvalue, block_size=block_size)
+      xoutput.sum().backward()
+      self.assertEqual(output, xoutput.cpu(), prec=1e-4)
+      self.assertEqual(query.grad, xquery.grad.cpu(), prec=1e-4)
+      self.assertEqual(key.grad, xkey.grad.cpu(), prec=1e-4)
+      self.assertEqual(value.grad, xvalue.grad.cpu(), prec=1e-4)
+
+  def test_parallel_linear(self):
+    xla_device = xm.xla_device()
+    input = torch.randn(4, 3, 8, requires_grad=True)
+    weight = torch.randn(6, 8, requires_grad=True)
+    bias = torch.randn(6, requires_grad=True)
+    output = F.linear(input, weight, bias)
+    output.sum().backward()
+
+    # With a single replica, both the column and the row parallel layers are
+    # plain linear layers.
+    for parallel_linear in [xf.column_parallel_linear, xf.row_parallel_linear]:
+      for num_chunks in [1, 2, 5]:
+        xinput = input.detach().to(xla_device).requires_grad_()
+        xweight = weight.detach().to(xla_device).requires_grad_()
+        xbias = bias.detach().to(xla_device).requires_grad_()
+        xoutput = parallel_linear(xinput, xweight, xbias, num_chunks=num_chunks)
+        xoutput.sum().backward()
+        self.assertEqual(output, xoutput.cpu(), prec=1e-4)
+        self.assertEqual(input.grad, xinput.grad.cpu(), prec=1e-4)
+        self.assertEqual(weight.grad, xweight.grad.cpu(), prec=1e-4)
+        self.assertEqual(bias.grad, xbias.grad.cpu(), prec=1e-4)
+
+  def test_sync_batch_norm(self):
+    xla_device = xm.xla_device()
+    input = torch.randn(4, 3, 5, 5, requires_grad=True)
+    weight = torch.randn(3, requires_grad=True)
+    bias = torch.randn(3, requires_grad=True)
+    scale = torch.randn(4, 3, 5, 5)
+    running_mean = torch.zeros(3)
+    running_var = torch.ones(3)
+    output = F.batch_norm(
+        input, running_mean, running_var, weight, bias, training=True)
+    (output * scale).sum().backward()
+
+    # With a single replica, the synchronized batch norm is a plain one.
+    xinput = input.detach().to(xla_device).requires_grad_()
+    xweight = weight.detach().to(xla_device).requires_grad_()
+    xbias = bias.detach().to(xla_device).requires_grad_()
+    xrunning_mean = torch.zeros(3, device=xla_device)
+    xrunning_var = torch.ones(3, device=xla_device)
+    xoutput = xf.sync_batch_norm(xinput, xrunning_mean, xrunning_var, xweight,
+                                 xbias)
+    (xoutput * scale.to(xla_device)).sum().backward()
+    self.assertEqual(output, xoutput.cpu(), prec=1e-4)
+    self.assertEqual(input.grad, xinput.grad.cpu(), prec=1e-4)
+    self.assertEqual(weight.grad, xweight.grad.cpu(), prec=1e-4)
+    self.assertEqual(bias.grad, xbias.grad.cpu(), prec=1e-4)
+    self.assertEqual(running_mean, xrunning_mean.cpu(), prec=1e-4)
+    self.assertEqual(running_var, xrunning_var.cpu(), prec=1e-4)
+
+  def test_quantized_linear_and_conv2d(self):
+    xla_device = xm.xla_device()
+    input = torch.randn(4, 16)
+    weight = torch.randn(8, 16)
+    bias = torch.randn(8)
+    qweight, scale, zero_point = xf.quantize_weight(weight)
+    dqweight = qweight.float() * scale.unsqueeze(1)
+    self.assertEqual(weight, dqweight, prec=scale.max().item())
+
+    xargs = [t.to(xla_device) for t in (qweight, scale, zero_point)]
+    xinput = input.to(xla_device)
+    xbias = bias.to(xla_device)
+    # Weight-only mode.
+    output = xf.quantized_linear(xinput, *xargs, bias=xbias)
+    self.assertEqual(F.linear(input, dqweight, bias), output.cpu(), prec=1e-4)
+    # Full int8 mode, with the input quantized with a scale of 1/32.
+    qinput = torch.clamp(torch.round(input * 32), -128, 127) / 32
+    output = xf.quantized_linear(xinput, *xargs, bias=xbias, input_scale=1 / 32)
+    self.assertEqual(
+        F.linear(qinput, dqweight, bias), output.cpu(), prec=1e-4)
+    # Requantized output.
+    output = xf.quantized_linear(
+        xinput, *xargs, input_scale=1 / 32, output_scale=0.5)
+    self.assertEqual(output.dtype, torch.int8)
+    expected = torch.clamp(torch.round(F.linear(qinput, dqweight) * 2), -128,
+                           127)
+    self.assertLessEqual((output.cpu().float() - expected).abs().max(), 1)
+
+    input = torch.randn(2, 4, 7, 7)
+    weight = torch.randn(6, 2, 3, 3)
+    qweight, scale, zero_point = xf.quantize_weight(weight)
+    dqweight = qweight.float() * scale.reshape(-1, 1, 1, 1)
+    xargs = [t.to(xla_device) for t in (qweight, scale, zero_point)]
+    output = xf.quantized_conv2d(
+        input.to(xla_device), *xargs, stride=2, padding=1, groups=2)
+    self.assertEqual(
+        F.conv2d(input, dqweight, stride=2, padding=1, groups=2),
+        output.cpu(),
+        prec=1e-4)
+
+  def test_sparse_embedding(self):
+    xla_device = xm.xla_device()
+    weight = torch.randn(32, 4, requires_grad=True)
+    input = torch.tensor([[1, 5, 1], [0, 7, 5]])
+    scale = torch.randn(2, 3, 4)
+    output = F.embedding(input, weight, padding_idx=0)
+    (output * scale).sum().backward()
+
+    xweight = weight.detach().to(xla_device).requires_grad_()
+    xoutput = xf.sparse_embedding(
+        input.to(xla_device), xweight, padding_idx=0)
+    (xoutput * scale.to(xla_device)).sum().backward()
+    self.assertEqual(output, xoutput.cpu())
+    self.assertIsNone(xweight.grad)
+    sparse_grad = xf.get_sparse_grad(xweight)
+    self.assertEqual(sparse_grad.values.size(), (6, 4))
+    self.assertEqual(weight.grad, sparse_grad.to_dense().cpu(), prec=1e-5)
+
+    # Plain SGD scatters the update to the looked up rows.
+    optimizer = xo.SGD([xweight], lr=0.5)
+    optimizer.step()
+    self.assertIsNone(xf.get_sparse_grad(xweight))
+    self.assertEqual(weight - 0.5 * weight.grad, xweight.detach().cpu(),
+                     prec=1e-5)
+
+  def test_tensor_shard(self):
+    xla_device = xm.xla_device()
+    images = torch.randn(10, 3, 4, 4)
+    labels = torch.randint(0, 10, (10,))
+    with tempfile.NamedTemporaryFile() as tf:
+      xts.write_tensor_shard(tf.name, [images, labels])
+      reader = xts.TensorShardReader(tf.name, batch_size=4)
+      self.assertEqual(reader.num_records, 10)
+      self.assertEqual(len(reader), 3)
+      start = 0
+      for batch_images, batch_labels in reader:
+        count = batch_images.size(0)
+        self.assertEqual(batch_images, images[start:start + count])
+        self.assertEqual(batch_labels, labels[start:start + count])
+        # The views are uploaded straight from the mapping.
+        self.assertEqual(batch_images.to(xla_device).cpu(),
+                         images[start:start + count])
+        start += count
+      self.assertEqual(start, 10)
+      reader = xts.TensorShardReader(
+          tf.name, batch_size=4, drop_last=True, shuffle=True)
+      self.assertEqual(sorted(b[1].size(0) for b in reader), [4, 4])
+
+  def test_native_queues(self):
+    queue = kq.Queue(maxsize=2)
+    items = []
+
+    def consume():
+      while True:
+        item = queue.get()
+        if item is None:
+          break
+        items.append(item)
+
+    thread = threading.Thread(target=consume)
+    thread.start()
+    for i in range(0, 10):
+      queue.put({'batch': [i]})
+    queue.close_write()
+    thread.join()
+    self.assertEqual(items, [{'batch': [i]} for i in range(0, 10)])
+
+    keyd_queue = kq.KeydQueue(maxsize=1)
+    thread = threading.Thread(target=lambda: keyd_queue.put(7, 'seven'))
+    thread.start()
+    self.assertEqual(keyd_queue.get(7), 'seven')
+    thread.join()
+    keyd_queue.close()
+    self.assertIsNone(keyd_queue.get(3))
+
+  def _test_fused_optimizer(self, cpu_optimizer_fn, xla_optimizer_fn):
+    xla_device = xm.xla_device()
+    model = nn.Sequential(nn.Linear(8, 16), nn.ReLU(), nn.Linear(16, 4))
+    xla_model = copy.deepcopy(model).to(xla_device)
+    optimizer = cpu_optimizer_fn(model.parameters())
+    xla_optimizer = xla_optimizer_fn(xla_model.parameters())
+    for _ in range(0, 3):
+      inputs = torch.randn(2, 8)
+      optimizer.zero_grad()
+      model(inputs).sum().backward()
+      optimizer.step()
+      xla_optimizer.zero_grad()
+      xla_model(inputs.to(xla_device)).sum().backward()
+      xla_optimizer.step()
+      for p, xp in zip(model.parameters(), xla_model.parameters()):
+        self.assertEqual(p, xp.cpu(), prec=1e-5)
+
+  def test_fused_adam(self):
+    self._test_fused_optimizer(
+        lambda params: optim.Adam(params, lr=0.01, weight_decay=0.1),
+        lambda params: xo.Adam(params, lr=0.01, weight_decay=0.1))
+
+  def test_fused_sgd(self):
+    self._test_fused_optimizer(
+        lambda params: optim.SGD(
+            params, lr=0.1, momentum=0.9, weight_decay=0.1, nesterov=True),
+        lambda params: xo.SGD(
+            params, lr=0.1, momentum=0.9, weight_decay=0.1, nesterov=True))
+
+  def test_clip_grad_norm(self):
+    xla_device = xm.xla_device()
+    for norm_type, max_norm in [(2.0, 0.5), (1.0, 100.0), (float('inf'), 0.1)]:
+      model = nn.Sequential(nn.Linear(8, 16), nn.ReLU(), nn.Linear(16, 4))
+      xla_model = copy.deepcopy(model).to(xla_device)
+      inputs = torch.randn(2, 8)
+      model(inputs).sum().backward()
+      xla_model(inputs.to(xla_device)).sum().backward()
+      norm = torch.nn.utils.clip_grad_norm_(model.parameters(), max_norm,
+                                            norm_type)
+      xla_norm = xm.clip_grad_norm_(xla_model.parameters(), max_norm,
+                                    norm_type)
+      self.assertEqual(norm, xla_norm.cpu(), prec=1e-4)
+      for p, xp in zip(model.parameters(), xla_model.parameters()):
+        self.assertEqual(p.grad, xp.grad.cpu(), prec=1e-5)
+
   def test_util_foreach_api(self):
 
     class ForTest(object):
@@ -1946,6 +2601,450 @@ class TestGeneric(XlaTestCase):
     self.assertEqual(xdata.batch_sizes.device, torch.device('cpu'))
     self.assertEqual(xdata.data.device, xla_device)
 
+  def test_fallback_stats(self):
+    xla_device = xm.xla_device()
+    t = _gen_tensor(16, device=xla_device)
+    met.clear_fallback_stats()
+    xresult = torch.histc(t, bins=4)
+    stats = met.fallback_stats()
+    self.assertIn('aten::histc', stats)
+    histc_stats = stats['aten::histc']
+    self.assertEqual(histc_stats['count'], 1)
+    self.assertEqual(histc_stats['bytes_to_host'], t.numel() * t.element_size())
+    self.assertEqual(histc_stats['bytes_to_device'],
+                     xresult.numel() * xresult.element_size())
+    self.assertTrue(any('test_fallback_stats' in frame
+                        for frame in histc_stats['frames']))
+    self.assertIn('aten::histc', met.fallback_report())
+
+  def test_strict_fallbacks(self):
+    xla_device = xm.xla_device()
+    t = _gen_tensor(16, device=xla_device)
+    with met.strict_fallbacks():
+      xresult = t + 1.0
+      with self.assertRaises(RuntimeError):
+        torch.histc(t, bins=4)
+    self.assertEqual(torch.histc(xresult, bins=4).device, xla_device)
+
+  def test_checkpoint_scope(self):
+    xla_device = xm.xla_device()
+    model = nn.Sequential(
+        nn.Linear(8, 16), nn.Tanh(), nn.Linear(16, 16), nn.Tanh(),
+        nn.Linear(16, 4))
+
+    def run(device, checkpoint):
+      xmodel = copy.deepcopy(model).to(device)
+      x = _gen_tensor(4, 8, device=device)
+      if checkpoint:
+        with xm.checkpoint_scope():
+          y = xmodel[0:4](x)
+        y = xmodel[4](y)
+      else:
+        y = xmodel(x)
+      y.sum().backward()
+      return [p.grad for p in xmodel.parameters()]
+
+    torch.manual_seed(11)
+    expected = run('cpu', False)
+    torch.manual_seed(11)
+    grads = run(xla_device, True)
+    for grad, xgrad in zip(expected, grads):
+      self.assertEqual(grad, xgrad.cpu())
+    self.assertIn('CheckpointRematerializations', met.counter_names())
+
+  def test_offload_scope(self):
+    xla_device = xm.xla_device()
+    model = nn.Sequential(
+        nn.Linear(8, 16), nn.Tanh(), nn.Linear(16, 16), nn.Tanh(),
+        nn.Linear(16, 4))
+
+    def run(device, offload):
+      xmodel = copy.deepcopy(model).to(device)
+      x = _gen_tensor(4, 8, device=device)
+      scope = xm.OffloadScope() if offload else None
+      for block in xmodel:
+        x = scope(block, x) if offload else block(x)
+      x.sum().backward()
+      return [p.grad for p in xmodel.parameters()], scope
+
+    torch.manual_seed(11)
+    expected, _ = run('cpu', False)
+    torch.manual_seed(11)
+    grads, scope = run(xla_device, True)
+    for grad, xgrad in zip(expected, grads):
+      self.assertEqual(grad, xgrad.cpu())
+    report = scope.report()
+    self.assertGreater(report['offloaded_bytes'], 0)
+    self.assertEqual(report['pending_blocks'], 0)
+    self.assertIn('AsyncUploadTensors', met.metric_names())
+
+  def test_wait_tensors(self):
+    xla_device = xm.xla_device()
+    t = _gen_tensor(8, 8)
+    xt = t.to(xla_device)
+    xsum = xt.sum()
+    xprod = xt @ xt
+    torch_xla._XLAC._xla_sync_multi([xsum, xprod], devices=[])
+    xm.wait_tensors([xsum, xprod])
+    self.assertEqual(xsum.cpu(), t.sum())
+    self.assertEqual(xprod.cpu(), t @ t)
+
+  def test_read_slice(self):
+    xla_device = xm.xla_device()
+    t = _gen_tensor(16, 8)
+    xt = t.to(xla_device) * 2
+    xm.mark_step()
+    for i in range(4):
+      self.assertEqual(xm.read_slice(xt, [i], [1]), t[i:i + 1] * 2)
+    misses = met.counter_value('SliceReadCacheMiss')
+    for i in range(4, 12):
+      self.assertEqual(xm.read_slice(xt, [i, 2], [3, 5]), t[i:i + 3, 2:7] * 2)
+    self.assertEqual(met.counter_value('SliceReadCacheMiss'), misses + 1)
+    with self.assertRaises(RuntimeError):
+      xm.read_slice(xt, [15], [2])
+
+  def test_host_data_retention(self):
+    xla_device = xm.xla_device()
+    small = _gen_tensor(4, 4)
+    large = _gen_tensor(1024, 1024)
+    xsmall = small.to(xla_device)
+    xlarge = large.to(xla_device)
+    xm.mark_step()
+    self.assertIn('DroppedHostBytes', met.counter_names())
+    self.assertGreater(met.counter_value('RetainedHostBytes'), 0)
+    self.assertEqual(xsmall.cpu(), small)
+    self.assertEqual(xlarge.cpu(), large)
+
+  def test_async_step_closure(self):
+    xla_device = xm.xla_device()
+    t = _gen_tensor(8, 8)
+    xt = t.to(xla_device)
+    results = []
+
+    def report(value, scale):
+      results.append((value.device.type, value * scale))
+
+    xm.add_step_closure(report, args=(xt @ xt, 2.0), run_async=True)
+    xm.mark_step()
+    xm.wait_step_closures()
+    self.assertEqual(len(results), 1)
+    self.assertEqual(results[0][0], 'cpu')
+    self.assertEqual(results[0][1], (t @ t) * 2.0)
+
+  def test_execution_streams(self):
+    xla_device = xm.xla_device()
+    a = _gen_tensor(8, 8)
+    b = _gen_tensor(8, 8)
+    results = [None, None]
+
+    def run(index, x):
+      with xm.stream(index + 1):
+        xx = x.to(xla_device)
+        for _ in range(4):
+          xx = xx @ xx.t() / 8.0
+          torch_xla._XLAC._xla_sync_multi([xx], devices=[])
+        results[index] = xx
+
+    threads = [
+        threading.Thread(target=run, args=(i, x)) for i, x in enumerate([a, b])
+    ]
+    for thread in threads:
+      thread.start()
+    for thread in threads:
+      thread.join()
+    for x, xresult in zip([a, b], results):
+      for _ in range(4):
+        x = x @ x.t() / 8.0
+      self.assertEqual(xresult.cpu(), x)
+    # Using the data of a stream within another one fences on the first.
+    with xm.stream(3):
+      xsum = results[0] + results[1]
+    self.assertEqual(xsum.cpu(), results[0].cpu() + results[1].cpu())
+    self.assertIn('StreamFence', met.counter_names())
+
+  def test_host_overhead_report(self):
+    xla_device = xm.xla_device()
+    t = torch.ones(2, 2, device=xla_device)
+    for _ in range(2):
+      t = t * 2
+      xm.mark_step()
+    self.assertIn('HostOverhead.CacheLookup', met.metric_names())
+    self.assertIn('Host Overhead Breakdown:', met.metrics_report())
+
+  def test_compiled_graphs_stats(self):
+    xla_device = xm.xla_device()
+    t = torch.ones(4, 4, device=xla_device)
+    t = t @ t + 3.0
+    xm.mark_step()
+    graphs = met.compiled_graphs_stats()
+    self.assertGreater(len(graphs), 0)
+    self.assertEqual(len(met.compiled_graphs_stats(top_n=1)), 1)
+    compile_times = [graph['compile_time_ns'] for graph in graphs]
+    self.assertEqual(compile_times, sorted(compile_times, reverse=True))
+    for graph in graphs:
+      self.assertGreater(graph['hlo_instructions'], 0)
+      self.assertGreater(len(graph['devices']), 0)
+
+  def test_dry_run_stats(self):
+    xla_device = xm.xla_device()
+    xw = _gen_tensor(32, 32, device=xla_device)
+    xm.mark_step()
+    xw.add_(1.0)
+    xout = xw.sum()
+    stats = met.dry_run_stats([xw, xout])
+    self.assertGreaterEqual(stats['parameters_bytes'], 32 * 32 * 4)
+    self.assertEqual(stats['outputs_bytes'], 32 * 32 * 4 + 4)
+    self.assertEqual(stats['peak_bytes'],
+                     stats['parameters_bytes'] + stats['outputs_bytes'] -
+                     stats['aliased_bytes'])
+    self.assertIn('DryRunCompiles', met.counter_names())
+    # The dry run does not execute, nor drops, the pending graph.
+    self.assertEqual(xout.cpu(), xw.cpu().sum())
+
+  def test_strided_tensor_upload(self):
+    xla_device = xm.xla_device()
+    t = _gen_tensor(6, 8, 10)
+    for view in [t.permute(2, 0, 1), t[:, ::2, 1:], t[0, :, 3]]:
+      self.assertFalse(view.is_contiguous())
+      self.assertEqual(view.to(xla_device).cpu(), view)
+    self.assertIn('StridedTensorToBuffer', met.counter_names())
+
+  def test_scope_profile(self):
+    xla_device = xm.xla_device()
+    model = nn.Sequential(nn.Linear(8, 8), nn.ReLU())
+    xla_model = copy.deepcopy(model).to(xla_device)
+    handles = met.annotate_module_scopes(xla_model)
+    met.clear_scope_profile()
+    met.start_scope_profile(1)
+    t = _gen_tensor(4, 8)
+    xout = xla_model(t.to(xla_device))
+    xm.mark_step()
+    self.assertIn('ScopeProfilerGraphs', met.counter_names())
+    self.assertIn('Sequential.1/0.1', met.scope_profile_report())
+    for line in met.scope_profile_folded_stacks().splitlines():
+      self.assertIn('Sequential.1;', line)
+      self.assertGreaterEqual(int(line.rsplit(' ', 1)[1]), 0)
+    # The profiled graph still executes as usual.
+    self.assertEqual(xout.cpu(), model(t))
+    for handle in handles:
+      handle.remove()
+    met.clear_scope_profile()
+
+  def test_donate_dead_parameters(self):
+    xla_device = xm.xla_device()
+    t = _gen_tensor(16, 16)
+    xt = t.to(xla_device)
+    # Once rebound, the device data of the original tensor is only referenced
+    # by the pending graph, and can be donated to its execution.
+    xt = xt * 2.0 + 1.0
+    xm.mark_step()
+    self.assertEqual(xt.cpu(), t * 2.0 + 1.0)
+    self.assertIn('DonatedDataHandles', met.counter_names())
+
+  def test_mark_unused(self):
+    xla_device = xm.xla_device()
+    t = _gen_tensor(8, 8)
+    xt = t.to(xla_device)
+    xunused = xt * 3.0
+    xm.mark_unused(xunused)
+    xt = xt + 1.0
+    xm.mark_step()
+    self.assertIn('SyncDroppedLiveTensors', met.counter_names())
+    # The skipped tensor value is still computed on demand.
+    self.assertEqual(xunused.cpu(), t * 3.0)
+    self.assertEqual(xt.cpu(), t + 1.0)
+
+  def test_freeze_tensors(self):
+    xla_device = xm.xla_device()
+    x = _gen_tensor(4, 8)
+    w = _gen_tensor(8, 8)
+    xw = w.to(xla_device)
+    xm.freeze_tensors([xw])
+    self.assertIn('FrozenTensors', met.counter_names())
+    for i in range(2):
+      xout = x.to(xla_device) @ xw + i
+      self.assertEqual(xout.cpu(), x @ w + i)
+    self.assertEqual(xw.cpu(), w)
+    # In place updates unfreeze the tensor.
+    xw.add_(1.0)
+    xm.mark_step()
+    self.assertEqual(xw.cpu(), w + 1.0)
+
+
+  def test_metrics_delta(self):
+    xla_device = xm.xla_device()
+    x = _gen_tensor(4, 4, device=xla_device)
+    xm.mark_step()
+    snapshot = met.metrics_snapshot()
+    y = x * 2.0 + 7.5
+    xm.mark_step()
+    delta = met.metrics_delta(snapshot)
+    self.assertGreater(delta['counters'].get('MarkStep', 0), 0)
+    samples, _ = delta['metrics']['ExecuteTime']
+    self.assertGreater(samples, 0)
+    self.assertEqual(met.metrics_delta(snapshot, snapshot), {
+        'counters': {},
+        'metrics': {}
+    })
+
+  def test_compile_manifest(self):
+    xla_device = xm.xla_device()
+    x = _gen_tensor(3, 5, device=xla_device)
+    y = x * 3.0 - 1.5
+    xm.mark_step()
+    manifest = xm.get_compile_manifest()
+    self.assertGreater(len(manifest), 0)
+    for entry in manifest:
+      self.assertEqual(set(entry.keys()), set(['hash', 'device', 'devices']))
+    hashes = [entry['hash'] for entry in manifest]
+    self.assertEqual(len(hashes), len(set(hashes)))
+
+  def test_capture_step(self):
+    xla_device = xm.xla_device()
+
+    def fn(x, w):
+      return [x @ w + 1.0, w * 0.5]
+
+    step = xm.capture_step(fn)
+    t = _gen_tensor(4, 4)
+    w = _gen_tensor(4, 4)
+    xw = w.to(xla_device)
+    for i in range(3):
+      xout, xw = step(t.to(xla_device) + i, xw)
+      self.assertEqual(xout.cpu(), (t + i) @ w + 1.0)
+      w = w * 0.5
+      self.assertEqual(xw.cpu(), w)
+    self.assertIn('ReplayedGraphs', met.counter_names())
+
+  def test_export_graph(self):
+    xla_device = xm.xla_device()
+    w = _gen_tensor(4, 4)
+    b = _gen_tensor(4)
+    xw = w.to(xla_device)
+    xb = b.to(xla_device)
+
+    def fn(x):
+      return [torch.relu(x @ xw + xb), x.sum()]
+
+    t = _gen_tensor(2, 4)
+    with tempfile.TemporaryDirectory() as path:
+      xm.export_graph(fn, [t.to(xla_device)], path)
+      run = xm.load_exported_graph(path)
+      for i in range(2):
+        x = t + i
+        xout, xsum = run(x.to(xla_device))
+        self.assertEqual(xout.cpu(), torch.relu(x @ w + b))
+        self.assertEqual(xsum.cpu(), x.sum())
+    self.assertIn('ExportedGraphExecutions', met.counter_names())
+
+  def test_batching_executor(self):
+    xla_device = xm.xla_device()
+    w = _gen_tensor(4, 3)
+    xw = w.to(xla_device)
+
+    def fn(x):
+      return [x @ xw]
+
+    with tempfile.TemporaryDirectory() as path:
+      paths = []
+      for batch_size in [2, 8]:
+        paths.append(os.path.join(path, str(batch_size)))
+        xm.export_graph(fn, [_gen_tensor(batch_size, 4).to(xla_device)],
+                        paths[-1])
+      executor = xm.BatchingExecutor(paths, max_delay_ms=20)
+      inputs = [_gen_tensor(n, 4) for n in [1, 3, 2, 1]]
+      outputs = [None] * len(inputs)
+
+      def request(i):
+        outputs[i], = executor.run(inputs[i])
+
+      threads = [
+          threading.Thread(target=request, args=(i,))
+          for i in range(len(inputs))
+      ]
+      for thread in threads:
+        thread.start()
+      for thread in threads:
+        thread.join()
+      executor.close()
+    for x, y in zip(inputs, outputs):
+      self.assertEqual(y, x @ w)
+    self.assertIn('BatchingExecutor.Latency', met.metric_names())
+
+  def test_gradient_accumulator(self):
+    xla_device = xm.xla_device()
+    model = nn.Linear(8, 4)
+    xmodel = copy.deepcopy(model).to(xla_device)
+    optimizer = optim.SGD(model.parameters(), lr=0.1)
+    accumulator = xm.GradientAccumulator(
+        optim.SGD(xmodel.parameters(), lr=0.1), 3)
+    inputs = [_gen_tensor(2, 8) for _ in range(6)]
+    compiles = None
+    for i, x in enumerate(inputs):
+      model(x).sum().backward()
+      stepped = accumulator.backward(xmodel(x.to(xla_device)).sum())
+      self.assertEqual(stepped, i % 3 == 2)
+      if stepped:
+        optimizer.step()
+        optimizer.zero_grad()
+        if compiles is None:
+          compiles = met.counter_value('UncachedCompile')
+    self.assertEqual(met.counter_value('UncachedCompile'), compiles)
+    for p, xp in zip(model.parameters(), xmodel.parameters()):
+      self.assertEqual(xp.cpu(), p)
+
+  def test_model_residency_manager(self):
+    xla_device = xm.xla_device()
+    weights = [_gen_tensor(64, 64) for _ in range(3)]
+    t = _gen_tensor(2, 64)
+    with tempfile.TemporaryDirectory() as path:
+      manager = xm.ModelResidencyManager(2 * 64 * 64 * 4)
+      for i, w in enumerate(weights):
+        xw = w.to(xla_device)
+        xm.export_graph(lambda x: [x @ xw], [t.to(xla_device)],
+                        os.path.join(path, str(i)))
+        manager.register(
+            str(i), os.path.join(path, str(i)), keep_host_copy=i == 2)
+      manager.set_pinned('0', True)
+      for i in [0, 1, 2, 1, 2, 0]:
+        xout, = manager.run(str(i), t.to(xla_device))
+        self.assertEqual(xout.cpu(), t @ weights[i])
+        self.assertLessEqual(manager.resident_bytes, 2 * 64 * 64 * 4)
+      self.assertTrue(manager.is_resident('0'))
+    self.assertIn('ModelResidencyEvictions', met.counter_names())
+
+  def test_capture_step_loop(self):
+    xla_device = xm.xla_device()
+
+    def fn(x, w):
+      w.add_(x, alpha=0.5)
+      return [w, w.sum()]
+
+    loop = xm.capture_step_loop(fn)
+    t = _gen_tensor(4, 8, 8)
+    w = _gen_tensor(8, 8)
+    xw = w.to(xla_device)
+    xsum, = loop([t.to(xla_device)], [xw])
+    expected_sum = 0.0
+    for x in t:
+      w = w + x * 0.5
+      expected_sum += w.sum()
+    self.assertEqual(xw.cpu(), w)
+    self.assertEqual(xsum.cpu(), expected_sum)
+    self.assertIn('CapturedStepLoops', met.counter_names())
+
+  def test_shared_memory_loader(self):
+    xla_device = xm.xla_device()
+    data = _gen_tensor(8, 4, 3)
+    target = torch.arange(8 * 4).view(8, 4)
+    loader = torch.utils.data.DataLoader(
+        torch.utils.data.TensorDataset(data.view(-1, 3), target.view(-1)),
+        batch_size=4)
+    batches = list(pl.MpSharedMemoryLoader(loader, xla_device))
+    self.assertEqual(len(batches), 8)
+    for i, (xdata, xtarget) in enumerate(batches):
+      self.assertEqual(xdata.cpu(), data[i])
+      self.assertEqual(xtarget.cpu(), target[i])
 
 if __name__ == '__main__':
   torch.set_default_tensor_type('torch.FloatTensor')
@@ -0,0 +1,42 @@
+import sys
+import torch
+import torch_xla
+import torch_xla.core.xla_model as xm
+import torch_xla.utils.metrics as met
+
+# Run with XLA_READ_ONLY_SUBGRAPHS=1, so that the subgraphs derived from frozen
+# tensors are cached across steps.
+
+
+def _check(name, expected, result):
+  if not expected.allclose(result, rtol=1e-04, atol=1e-04):
+    print('{} produced a wrong result'.format(name), file=sys.stderr)
+    print('{}\n{}'.format(expected, result), file=sys.stderr)
+    sys.exit(1)
+
+
+def _test_frozen_bias(device):
+  torch.manual_seed(11)
+  pos = torch.randn(4, 8)
+  xla_pos = pos.to(device)
+  xm.freeze_tensors([xla_pos])
+  expected_bias = (pos * 0.5).exp().sum(1, keepdim=True)
+  for step in range(4):
+    x = torch.randn(4, 8)
+    xla_x = x.to(device)
+    xla_y = xla_x + (xla_pos * 0.5).exp().sum(1, keepdim=True)
+    xm.mark_step()
+    _check('Step {}'.format(step), x + expected_bias, xla_y.cpu())
+  if met.counter_value('ReadOnlySubgraphsMaterialized') != 1:
+    print(
+        'The read only subgraph was materialized {} times'.format(
+            met.counter_value('ReadOnlySubgraphsMaterialized')),
+        file=sys.stderr)
+    sys.exit(1)
+  if (met.counter_value('ReadOnlySubgraphsReplaced') or 0) < 3:
+    print('The read only subgraph was not reused', file=sys.stderr)
+    sys.exit(1)
+
+
+if __name__ == '__main__':
+  _test_frozen_bias(xm.xla_device())
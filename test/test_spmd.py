@@ -0,0 +1,50 @@
+import sys
+import torch
+import torch_xla
+import torch_xla.core.xla_model as xm
+import torch_xla.distributed.xla_sharding as xs
+import torch_xla.utils.metrics as met
+
+
+def _check(name, expected, result):
+  if not expected.allclose(result, rtol=1e-04, atol=1e-04):
+    print('{} produced a wrong result'.format(name), file=sys.stderr)
+    print('{}\n{}'.format(expected, result), file=sys.stderr)
+    sys.exit(1)
+
+
+def _test_sharded_matmul(device, num_devices):
+  mesh = xs.Mesh(list(range(num_devices)), (1, num_devices))
+  torch.manual_seed(11)
+  x = torch.randn(6, 10)
+  # The uneven split of the 10 input features exercises the shard padding.
+  w = torch.randn(10, 10)
+  xla_x = x.to(device)
+  xla_w = w.to(device)
+  xs.mark_sharding(xla_w, mesh, (None, 1))
+  xs.mark_sharding(xla_x, mesh, (None, None))
+  _check('Sharded weight', w, xla_w.cpu())
+  xla_y = torch.relu(xla_x.mm(xla_w))
+  xs.mark_sharding(xla_y, mesh, (None, 1))
+  xm.mark_step()
+  _check('Sharded matmul', torch.relu(x.mm(w)), xla_y.cpu())
+  # In place updates keep the tensor sharded.
+  xla_w.add_(1.0)
+  xm.mark_step()
+  _check('Sharded update', w + 1.0, xla_w.cpu())
+  xs.clear_sharding(xla_w)
+  _check('Cleared sharding', w + 1.0, xla_w.cpu())
+  if met.counter_value('ShardedGraphs') is None:
+    print('No sharded graph was executed', file=sys.stderr)
+    sys.exit(1)
+
+
+if __name__ == '__main__':
+  device = xm.xla_device()
+  num_devices = len(xm.get_xla_supported_devices())
+  if num_devices > 1 and xm.xla_device_hw(device) == 'CPU':
+    _test_sharded_matmul(device, num_devices)
+  else:
+    print(
+        'Sharding requires multiple local CPU devices (XLA_LOCAL_CPU_DEVICES)',
+        file=sys.stderr)
@@ -24,6 +24,9 @@ MODEL_OPTS = {
     '--lr_scheduler_divisor': {
         'type': int,
     },
+    '--device_augment': {
+        'action': 'store_true',
+    },
 }
 
 FLAGS = args_parse.parse_common_options(
@@ -48,6 +51,7 @@ import torchvision.transforms as transforms
 import torch_xla
 import torch_xla.debug.metrics as met
 import torch_xla.distributed.data_parallel as dp
+import torch_xla.utils.image_transforms as image_transforms
 import torch_xla.utils.utils as xu
 import torch_xla.core.xla_model as xm
 import torch_xla.test.test_utils as test_utils
@@ -99,41 +103,72 @@ def get_model_property(key):
 def train_imagenet():
   print('==> Preparing data..')
   img_dim = get_model_property('img_dim')
+  resize_dim = max(img_dim, 256)
+  mean = [0.485, 0.456, 0.406]
+  std = [0.229, 0.224, 0.225]
+  if FLAGS.device_augment:
+    # The host only decodes and resizes the images, which are sent to the
+    # device as uint8 HWC, where they get cropped, flipped and normalized.
+    train_augment = image_transforms.DeviceImageAugment(img_dim, mean, std)
+    test_augment = image_transforms.DeviceImageAugment(
+        img_dim, mean, std, train=False)
+  else:
+    train_augment = test_augment = None
   if FLAGS.fake_data:
     train_dataset_len = 1200000  # Roughly the size of Imagenet dataset.
+    if FLAGS.device_augment:
+      train_data = torch.zeros(
+          FLAGS.batch_size, resize_dim, resize_dim, 3, dtype=torch.uint8)
+      test_data = torch.zeros(
+          FLAGS.test_set_batch_size,
+          resize_dim,
+          resize_dim,
+          3,
+          dtype=torch.uint8)
+    else:
+      train_data = torch.zeros(FLAGS.batch_size, 3, img_dim, img_dim)
+      test_data = torch.zeros(FLAGS.test_set_batch_size, 3, img_dim, img_dim)
     train_loader = xu.SampleGenerator(
-        data=(torch.zeros(FLAGS.batch_size, 3, img_dim, img_dim),
-              torch.zeros(FLAGS.batch_size, dtype=torch.int64)),
+        data=(train_data, torch.zeros(FLAGS.batch_size, dtype=torch.int64)),
         sample_count=train_dataset_len // FLAGS.batch_size //
         xm.xrt_world_size())
     test_loader = xu.SampleGenerator(
-        data=(torch.zeros(FLAGS.test_set_batch_size, 3, img_dim, img_dim),
+        data=(test_data,
               torch.zeros(FLAGS.test_set_batch_size, dtype=torch.int64)),
         sample_count=50000 // FLAGS.batch_size // xm.xrt_world_size())
   else:
-    normalize = transforms.Normalize(
-        mean=[0.485, 0.456, 0.406], std=[0.229, 0.224, 0.225])
+    if FLAGS.device_augment:
+      train_transform = transforms.Compose([
+          transforms.RandomResizedCrop(resize_dim),
+          image_transforms.ToUint8HWC(),
+      ])
+      test_transform = transforms.Compose([
+          transforms.Resize(resize_dim),
+          transforms.CenterCrop(resize_dim),
+          image_transforms.ToUint8HWC(),
+      ])
+    else:
+      normalize = transforms.Normalize(mean=mean, std=std)
+      train_transform = transforms.Compose([
+          transforms.RandomResizedCrop(img_dim),
+          transforms.RandomHorizontalFlip(),
+          transforms.ToTensor(),
+          normalize,
+      ])
+      # Matches Torchvision's eval transforms except Torchvision uses size
+      # 256 resize for all models both here and in the train loader. Their
+      # version crashes during training on 299x299 images, e.g. inception.
+      test_transform = transforms.Compose([
+          transforms.Resize(resize_dim),
+          transforms.CenterCrop(img_dim),
+          transforms.ToTensor(),
+          normalize,
+      ])
     train_dataset = torchvision.datasets.ImageFolder(
-        os.path.join(FLAGS.datadir, 'train'),
-        transforms.Compose([
-            transforms.RandomResizedCrop(img_dim),
-            transforms.RandomHorizontalFlip(),
-            transforms.ToTensor(),
-            normalize,
-        ]))
+        os.path.join(FLAGS.datadir, 'train'), train_transform)
     train_dataset_len = len(train_dataset.imgs)
-    resize_dim = max(img_dim, 256)
     test_dataset = torchvision.datasets.ImageFolder(
-        os.path.join(FLAGS.datadir, 'val'),
-        # Matches Torchvision's eval transforms except Torchvision uses size
-        # 256 resize for all models both here and in the train loader. Their
-        # version crashes during training on 299x299 images, e.g. inception.
-        transforms.Compose([
-            transforms.Resize(resize_dim),
-            transforms.CenterCrop(img_dim),
-            transforms.ToTensor(),
-            normalize,
-        ]))
+        os.path.join(FLAGS.datadir, 'val'), test_transform)
 
     train_sampler = None
     test_sampler = None
@@ -193,6 +228,8 @@ def train_imagenet():
     tracker = xm.RateTracker()
     model.train()
     for x, (data, target) in enumerate(loader):
+      if train_augment is not None:
+        data = train_augment(data)
       optimizer.zero_grad()
       output = model(data)
       loss = loss_fn(output, target)
@@ -215,6 +252,8 @@ def train_imagenet():
     correct = 0
     model.eval()
     for data, target in loader:
+      if test_augment is not None:
+        data = test_augment(data)
       output = model(data)
       pred = output.max(1, keepdim=True)[1]
       correct += pred.eq(target.view_as(pred)).sum().item()
@@ -1,12 +1,17 @@
 #ifndef XLA_CLIENT_CACHE_H_
 #define XLA_CLIENT_CACHE_H_
 
+#include <algorithm>
+#include <atomic>
 #include <functional>
+#include <limits>
 #include <list>
 #include <memory>
 #include <mutex>
+#include <shared_mutex>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 namespace xla {
 namespace util {
@@ -105,6 +110,259 @@ class Cache {
   ElementMap element_map_;
 };
 
+// Same API as the Cache class above, but meant for hot lookup paths hit by
+// multiple threads. The keys are partitioned among a number of shards, each one
+// with its own reader/writer lock, and the LRU policy is approximated with the
+// CLOCK algorithm. So the Get() API only takes a shared lock on one shard, and
+// marks the object as referenced with an atomic store, without mutating the
+// shard structure.
+// If a cost function is given, the eviction follows the GreedyDual-Size-
+// Frequency policy instead: every object gets a priority equal to the shard
+// inflation value at its last reference, plus its hit count times its cost,
+// and the object with the lowest priority is evicted, raising the shard
+// inflation value to its priority. So objects which are expensive to recreate
+// survive bursts of cheap ones, while the ones not referenced for a long time
+// still age out. Objects with infinite cost are pinned, and only evicted when
+// all the shard objects are pinned.
+template <typename K, typename T, typename H = std::hash<K>,
+          typename E = std::equal_to<K>>
+class ShardedCache {
+ public:
+  using TypePtr = std::shared_ptr<T>;
+  // Returns the cost of recreating an object. Called with the shard lock held,
+  // so it must not access the cache.
+  using CostFn = std::function<double(const K&, const T&)>;
+  // Called with the shard lock held for every evicted object, together with
+  // its cost.
+  using EvictFn = std::function<void(const K&, const TypePtr&, double)>;
+
+  explicit ShardedCache(size_t max_size, size_t num_shards = 16,
+                        CostFn cost_fn = nullptr, EvictFn evict_fn = nullptr)
+      : shards_(std::max<size_t>(std::min(num_shards, max_size), 1)),
+        cost_fn_(std::move(cost_fn)),
+        evict_fn_(std::move(evict_fn)) {
+    size_t shard_size = (max_size + shards_.size() - 1) / shards_.size();
+    for (auto& shard : shards_) {
+      shard.Reset(std::max<size_t>(shard_size, 1));
+    }
+  }
+
+  // Adds an object to the cache, unless it already exists, in which case the
+  // existing object is returned. If the key shard is full, an object which has
+  // not been referenced recently is evicted.
+  TypePtr Add(K key, TypePtr object) {
+    Shard& shard = GetShard(key);
+    std::lock_guard<std::shared_timed_mutex> lock(shard.lock);
+    auto it = shard.index.find(&key);
+    if (it != shard.index.end()) {
+      Slot& slot = shard.slots[it->second];
+      slot.referenced.store(true, std::memory_order_relaxed);
+      Touch(shard, &slot);
+      return slot.object;
+    }
+    size_t position = shard.size < shard.capacity
+                          ? shard.size++
+                          : (cost_fn_ ? EvictByCost(&shard) : Evict(&shard));
+    Slot& slot = shard.slots[position];
+    slot.key = std::move(key);
+    slot.object = std::move(object);
+    slot.referenced.store(true, std::memory_order_relaxed);
+    slot.hits.store(0, std::memory_order_relaxed);
+    slot.inflation.store(shard.inflation, std::memory_order_relaxed);
+    Touch(shard, &slot);
+    shard.index.emplace(&slot.key, position);
+    return slot.object;
+  }
+
+  // Retrieves the existing object if it exists, marking it as referenced.
+  // Returns nullptr if no object with the specified key is found within the
+  // cache.
+  TypePtr Get(const K& key) {
+    Shard& shard = GetShard(key);
+    std::shared_lock<std::shared_timed_mutex> lock(shard.lock);
+    auto it = shard.index.find(&key);
+    if (it == shard.index.end()) {
+      return nullptr;
+    }
+    Slot& slot = shard.slots[it->second];
+    // Avoid bouncing the cache line among readers of hot objects, if the bit
+    // is already set.
+    if (!slot.referenced.load(std::memory_order_relaxed)) {
+      slot.referenced.store(true, std::memory_order_relaxed);
+    }
+    Touch(shard, &slot);
+    return slot.object;
+  }
+
+  bool Erase(const K& key) {
+    Shard& shard = GetShard(key);
+    std::lock_guard<std::shared_timed_mutex> lock(shard.lock);
+    auto it = shard.index.find(&key);
+    if (it == shard.index.end()) {
+      return false;
+    }
+    size_t position = it->second;
+    shard.index.erase(it);
+    size_t last = shard.size - 1;
+    if (position != last) {
+      // Keep the used slots compact, by moving the last one into the hole.
+      Slot& last_slot = shard.slots[last];
+      shard.index.erase(&last_slot.key);
+      Slot& slot = shard.slots[position];
+      slot.key = std::move(last_slot.key);
+      slot.object = std::move(last_slot.object);
+      slot.referenced.store(
+          last_slot.referenced.load(std::memory_order_relaxed),
+          std::memory_order_relaxed);
+      slot.hits.store(last_slot.hits.load(std::memory_order_relaxed),
+                      std::memory_order_relaxed);
+      slot.inflation.store(last_slot.inflation.load(std::memory_order_relaxed),
+                           std::memory_order_relaxed);
+      shard.index.emplace(&slot.key, position);
+    }
+    shard.slots[last].key = K();
+    shard.slots[last].object = nullptr;
+    shard.size = last;
+    if (shard.hand >= shard.size) {
+      shard.hand = 0;
+    }
+    return true;
+  }
+
+  void Clear() {
+    for (auto& shard : shards_) {
+      std::lock_guard<std::shared_timed_mutex> lock(shard.lock);
+      shard.Reset(shard.capacity);
+    }
+  }
+
+  // Calls fn for every object within the cache, without marking it as
+  // referenced. The function is called with the shard lock held, so it must
+  // not access the cache.
+  void ForEach(const std::function<void(const K&, const TypePtr&)>& fn) {
+    for (auto& shard : shards_) {
+      std::shared_lock<std::shared_timed_mutex> lock(shard.lock);
+      for (size_t i = 0; i < shard.size; ++i) {
+        fn(shard.slots[i].key, shard.slots[i].object);
+      }
+    }
+  }
+
+ private:
+  struct Slot {
+    K key;
+    TypePtr object;
+    std::atomic<bool> referenced{false};
+    // The GreedyDual-Size-Frequency state, only used with a cost function.
+    std::atomic<size_t> hits{0};
+    std::atomic<double> inflation{0.0};
+  };
+
+  struct Hasher {
+    size_t operator()(const K* key) const { return hasher(*key); }
+
+    H hasher;
+  };
+
+  struct Equaler {
+    bool operator()(const K* k1, const K* k2) const {
+      return equaler(*k1, *k2);
+    }
+
+    E equaler;
+  };
+
+  struct Shard {
+    void Reset(size_t shard_capacity) {
+      index.clear();
+      slots.reset(new Slot[shard_capacity]);
+      capacity = shard_capacity;
+      size = 0;
+      hand = 0;
+      inflation = 0.0;
+    }
+
+    std::shared_timed_mutex lock;
+    std::unordered_map<const K*, size_t, Hasher, Equaler> index;
+    std::unique_ptr<Slot[]> slots;
+    size_t capacity = 0;
+    size_t size = 0;
+    size_t hand = 0;
+    // Only written with the exclusive lock held, so readers holding the shared
+    // lock can read it without synchronization.
+    double inflation = 0.0;
+  };
+
+  Shard& GetShard(const K& key) {
+    size_t hash = hasher_(key);
+    // The low bits are also used by the shard index, so mix in the high ones.
+    return shards_[(hash ^ (hash >> 17)) % shards_.size()];
+  }
+
+  // Runs the CLOCK hand over the slots, clearing the referenced bits, until it
+  // finds an object which was not referenced since the last pass. Returns the
+  // position of the evicted slot.
+  static size_t Evict(Shard* shard) {
+    while (shard->slots[shard->hand].referenced.exchange(
+        false, std::memory_order_relaxed)) {
+      shard->hand = (shard->hand + 1) % shard->size;
+    }
+    size_t position = shard->hand;
+    shard->index.erase(&shard->slots[position].key);
+    shard->hand = (shard->hand + 1) % shard->size;
+    return position;
+  }
+
+  // Records a reference to the slot for the cost based eviction. Callers hold
+  // at least the shared shard lock.
+  void Touch(const Shard& shard, Slot* slot) const {
+    if (cost_fn_) {
+      slot->hits.fetch_add(1, std::memory_order_relaxed);
+      slot->inflation.store(shard.inflation, std::memory_order_relaxed);
+    }
+  }
+
+  // Evicts the unpinned object with the lowest priority, or the one the CLOCK
+  // policy picks if all the objects are pinned. Returns the position of the
+  // evicted slot.
+  size_t EvictByCost(Shard* shard) {
+    size_t position = shard->size;
+    double min_priority = std::numeric_limits<double>::infinity();
+    double victim_cost = 0.0;
+    for (size_t i = 0; i < shard->size; ++i) {
+      const Slot& slot = shard->slots[i];
+      double cost = cost_fn_(slot.key, *slot.object);
+      if (cost == std::numeric_limits<double>::infinity()) {
+        continue;
+      }
+      double priority = slot.inflation.load(std::memory_order_relaxed) +
+                        slot.hits.load(std::memory_order_relaxed) * cost;
+      if (position == shard->size || priority < min_priority) {
+        position = i;
+        min_priority = priority;
+        victim_cost = cost;
+      }
+    }
+    if (position == shard->size) {
+      victim_cost = std::numeric_limits<double>::infinity();
+      position = Evict(shard);
+    } else {
+      shard->inflation = std::max(shard->inflation, min_priority);
+      shard->index.erase(&shard->slots[position].key);
+    }
+    if (evict_fn_) {
+      const Slot& slot = shard->slots[position];
+      evict_fn_(slot.key, slot.object, victim_cost);
+    }
+    return position;
+  }
+
+  std::vector<Shard> shards_;
+  H hasher_;
+  CostFn cost_fn_;
+  EvictFn evict_fn_;
+};
+
 }  // namespace util
 }  // namespace xla
 
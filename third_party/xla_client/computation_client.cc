@@ -13,8 +13,11 @@
 #include "tensorflow/compiler/xla/status_macros.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 #include "tensorflow/compiler/xla/xla_client/env_vars.h"
+#include "tensorflow/compiler/xla/xla_client/local_computation_client.h"
 #include "tensorflow/compiler/xla/xla_client/mesh_service.h"
+#include "tensorflow/compiler/xla/xla_client/metrics_exporter.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/thread_pool.h"
 #include "tensorflow/compiler/xla/xla_client/xrt_computation_client.h"
 #include "tensorflow/core/platform/net.h"
 #include "tensorflow/core/util/device_name_utils.h"
@@ -29,6 +32,7 @@ struct DeviceCountDefaults {
 };
 
 ComputationClient* CreateClient() {
+  metrics_exporter::MaybeStartExporter();
   return ComputationClient::Create().release();
 }
 
@@ -256,6 +260,15 @@ bool ParseEnvDevices(XrtComputationClient::Options* options) {
 }  // namespace
 
 std::unique_ptr<ComputationClient> ComputationClient::Create() {
+  int num_local_cpus = sys_util::GetEnvInt(env::kEnvLocalCpuDevices, 0);
+  if (num_local_cpus > 0) {
+    LocalComputationClient::Options local_options;
+    local_options.num_devices = num_local_cpus;
+    local_options.async_execute =
+        sys_util::GetEnvBool(env::kEnvLocalAsyncExecute, true);
+    return std::unique_ptr<ComputationClient>(
+        new LocalComputationClient(std::move(local_options)));
+  }
   XrtComputationClient::Options options;
   std::unique_ptr<tensorflow::tpu::TopologyProto> topology_proto;
   if (!ParseEnvBasedTpuClusterConfig(&options) &&
@@ -279,6 +292,42 @@ std::shared_ptr<ComputationClient::Computation> ComputationClient::Compile(
   return std::move(results[0]);
 }
 
+util::Future<std::vector<Literal>> ComputationClient::TransferFromServerAsync(
+    absl::Span<const DataPtr> handles) {
+  util::Promise<std::vector<Literal>> promise;
+  auto transferfn = [this, promise,
+                     handles = std::vector<DataPtr>(
+                         handles.begin(), handles.end())]() mutable {
+    try {
+      promise.SetValue(TransferFromServer(handles));
+    } catch (...) {
+      promise.SetException(std::current_exception());
+    }
+  };
+  env::ScheduleIoClosure(std::move(transferfn));
+  return promise.GetFuture();
+}
+
+util::Future<std::vector<ComputationClient::DataPtr>>
+ComputationClient::ExecuteComputationAsync(
+    const Computation& computation, absl::Span<const DataPtr> arguments,
+    const std::string& device, const ExecuteComputationOptions& options) {
+  util::Promise<std::vector<DataPtr>> promise;
+  auto executefn = [this, promise, &computation,
+                    arguments = std::vector<DataPtr>(arguments.begin(),
+                                                     arguments.end()),
+                    device, options]() mutable {
+    try {
+      promise.SetValue(
+          ExecuteComputation(computation, arguments, device, options));
+    } catch (...) {
+      promise.SetException(std::current_exception());
+    }
+  };
+  env::ScheduleIoClosure(std::move(executefn));
+  return promise.GetFuture();
+}
+
 std::vector<std::string> ComputationClient::GetCompilationDevices(
     const std::string& device, absl::Span<const std::string> devices) const {
   std::vector<std::string> compilation_devices;
@@ -373,6 +422,11 @@ metrics::Counter* ComputationClient::ReleaseDataHandlesCounter() {
   return counter;
 }
 
+metrics::Counter* ComputationClient::DonatedDataHandlesCounter() {
+  static metrics::Counter* counter = new metrics::Counter("DonatedDataHandles");
+  return counter;
+}
+
 metrics::Counter* ComputationClient::DestroyDataHandlesCounter() {
   // Do not change the name of the counter as xla_model.py references it.
   static metrics::Counter* counter = new metrics::Counter("DestroyDataHandles");
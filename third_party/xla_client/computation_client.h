@@ -13,7 +13,9 @@
 #include "tensorflow/compiler/xla/client/xla_computation.h"
 #include "tensorflow/compiler/xla/literal_util.h"
 #include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/compiler/xla/xla_client/future.h"
 #include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/multi_wait.h"
 #include "tensorflow/compiler/xla/xla_client/types.h"
 
 namespace xla {
@@ -50,10 +52,22 @@ class ComputationClient {
 
     virtual bool HasValue() const = 0;
 
+    // The event signaled once the asynchronous operation assigning the value
+    // of a placeholder completes. Null for the data created with a value, and
+    // for the placeholders nobody registered an event for.
+    const std::shared_ptr<util::MultiWait>& ready_event() const {
+      return ready_event_;
+    }
+
+    void SetReadyEvent(std::shared_ptr<util::MultiWait> ready_event) {
+      ready_event_ = std::move(ready_event);
+    }
+
    private:
     std::string device_;
     Shape shape_;
     std::shared_ptr<Info> info_;
+    std::shared_ptr<util::MultiWait> ready_event_;
   };
 
   using DataPtr = std::shared_ptr<Data>;
@@ -99,32 +113,74 @@ class ComputationClient {
     Shape shape;
     std::string device;
     PopulateFn populate_fn;
+    // Optional host buffer lent by the creator of the source, which already
+    // holds the data in the type and layout described by shape. Clients which
+    // are able to, will use it directly instead of calling populate_fn, and
+    // will keep data_owner alive until the transfer completes.
+    const void* data = nullptr;
+    size_t data_size = 0;
+    std::shared_ptr<void> data_owner;
   };
 
+  struct MemoryInfo {
+    // Bytes held by the live Data handles created by this client.
+    int64 live_bytes = 0;
+    // Peak value reached by live_bytes.
+    int64 peak_bytes = 0;
+    // Free and total memory reported by the device, or -1 if not available.
+    int64 free_bytes = -1;
+    int64 total_bytes = -1;
+  };
+
+  // If is_sharded is true, the computation carries sharding annotations and
+  // is compiled with the SPMD partitioner, into one partition per device of
+  // devices. Such computations are run with ExecuteReplicated(), over the same
+  // devices, with the arguments and results of every partition.
   struct CompileInstance {
     CompileInstance() = default;
     CompileInstance(XlaComputation computation, std::string compilation_device,
-                    std::vector<std::string> devices, const Shape* output_shape)
+                    std::vector<std::string> devices, const Shape* output_shape,
+                    bool is_sharded = false)
         : computation(std::move(computation)),
           compilation_device(std::move(compilation_device)),
           devices(std::move(devices)),
-          output_shape(output_shape) {}
+          output_shape(output_shape),
+          is_sharded(is_sharded) {}
 
     XlaComputation computation;
     std::string compilation_device;
     std::vector<std::string> devices;
     const Shape* output_shape = nullptr;
+    bool is_sharded = false;
   };
 
   struct ExecuteOptions {
     bool explode_tuple = true;
   };
 
-  struct ExecuteComputationOptions : public ExecuteOptions {};
+  // The donated_arguments flags tell which arguments (by index) are donated to
+  // the execution: the caller guarantees it will not use their Data anymore,
+  // so the backend can release (or reuse) their device memory as soon as the
+  // execution is done with them. Missing flags mean not donated. A donated
+  // Data is left with no value, unless its device handle is shared with other
+  // Data objects, in which case donation is a no-op.
+  // The tuple outputs whose size is at most inline_result_bytes are read back
+  // together with the execution, so that fetching their value afterwards does
+  // not issue another transfer from the server. Zero disables inlining.
+  struct ExecuteComputationOptions : public ExecuteOptions {
+    std::vector<bool> donated_arguments;
+    int64 inline_result_bytes = 0;
+  };
 
-  struct ExecuteReplicatedOptions : public ExecuteOptions {};
+  // The donated_arguments flags apply to the arguments of every replica.
+  struct ExecuteReplicatedOptions : public ExecuteOptions {
+    std::vector<bool> donated_arguments;
+  };
 
-  struct ExecuteParallelOptions : public ExecuteOptions {};
+  // The donated_arguments[i] flags apply to the arguments of computations[i].
+  struct ExecuteParallelOptions : public ExecuteOptions {
+    std::vector<std::vector<bool>> donated_arguments;
+  };
 
   // Describes an operation to be fed to the ExecuteChained() API.
   // If the device_data member is not nullptr, this operation is a device data
@@ -170,6 +226,37 @@ class ComputationClient {
   virtual std::vector<Literal> TransferFromServer(
       absl::Span<const DataPtr> handles) = 0;
 
+  // Like TransferFromServer(), but the literal_fn callback is called with the
+  // index and the value of every handle, as soon as such value gets read from
+  // the server. The callback can be called concurrently from different threads,
+  // and the API returns once all the callbacks have completed.
+  using LiteralFn = std::function<void(size_t, Literal)>;
+
+  virtual void TransferFromServer(absl::Span<const DataPtr> handles,
+                                  const LiteralFn& literal_fn) = 0;
+
+  // Asynchronous version of TransferFromServer(), returning a future of the
+  // literals. The default implementation runs the synchronous API within the
+  // IO thread pool.
+  virtual util::Future<std::vector<Literal>> TransferFromServerAsync(
+      absl::Span<const DataPtr> handles);
+
+  // Copies the device data behind the handles onto the given devices, without
+  // moving it through the client host memory. The returned vector has nullptr
+  // entries for the handles which cannot be copied directly (like the ones
+  // whose devices are in different resource domains), which the caller needs
+  // to transfer by other means.
+  virtual std::vector<DataPtr> CopyDataToDevice(
+      absl::Span<const DataPtr> handles,
+      absl::Span<const std::string> devices) = 0;
+
+  // Retrieves the memory usage information of the given device.
+  virtual MemoryInfo GetMemoryInfo(const std::string& device) = 0;
+
+  // Releases the device handles which are pending release, and compacts the
+  // device allocations, to free up as much memory as possible.
+  virtual void ReclaimMemory(const std::string& device) = 0;
+
   // Compiles a set of computations.
   virtual std::vector<ComputationPtr> Compile(
       std::vector<CompileInstance> instances) = 0;
@@ -182,6 +269,16 @@ class ComputationClient {
       const Computation& computation, absl::Span<const DataPtr> arguments,
       const std::string& device, const ExecuteComputationOptions& options) = 0;
 
+  // Asynchronous version of ExecuteComputation(), returning a future of the
+  // results. The computation must be kept alive by the caller until the future
+  // is ready. The default implementation runs the synchronous API within the
+  // IO thread pool, while backends with an asynchronous execution model
+  // complete the future from their own execution threads, with no thread
+  // blocked waiting for the execution.
+  virtual util::Future<std::vector<DataPtr>> ExecuteComputationAsync(
+      const Computation& computation, absl::Span<const DataPtr> arguments,
+      const std::string& device, const ExecuteComputationOptions& options);
+
   // Executes the computation in replicated mode.
   // The size of the arguments vector is the number of replicas to execute,
   // and it must match the size of the computation.devices() as well as the
@@ -241,6 +338,11 @@ class ComputationClient {
 
   virtual const std::vector<std::string>& GetReplicationDevices() const = 0;
 
+  // Returns, for each of the replication devices, the index of the host owning
+  // it. Hosts are numbered in order of first appearance within the replication
+  // devices. Returns an empty vector if the topology is not known.
+  virtual std::vector<int64> GetReplicationDevicesHosts() const = 0;
+
   virtual void SetRngSeed(size_t seed) = 0;
 
   virtual std::map<std::string, Metric> GetMetrics() const = 0;
@@ -267,6 +369,11 @@ class ComputationClient {
   static ComputationClient* Get();
 
  protected:
+  static bool IsDonatedArgument(const std::vector<bool>& donated_arguments,
+                                size_t index) {
+    return index < donated_arguments.size() && donated_arguments[index];
+  }
+
   // Metrics common to all client intrfaces.
   static metrics::Metric* TransferToServerMetric();
   static metrics::Metric* TransferToServerTransformMetric();
@@ -279,6 +386,7 @@ class ComputationClient {
   static metrics::Metric* DeconstructTupleMetric();
   static metrics::Counter* CreateDataHandlesCounter();
   static metrics::Counter* ReleaseDataHandlesCounter();
+  static metrics::Counter* DonatedDataHandlesCounter();
   static metrics::Counter* DestroyDataHandlesCounter();
   static metrics::Metric* ReleaseDataHandlesTimeMetric();
   static metrics::Counter* CreateCompileHandlesCounter();
@@ -13,6 +13,8 @@ const char* const kEnvWorkers = "XRT_WORKERS";
 const char* const kEnvMeshService = "XRT_MESH_SERVICE_ADDRESS";
 const char* const kEnvWorldSize = "XRT_SHARD_WORLD_SIZE";
 const char* const kEnvMpDevice = "XRT_MULTI_PROCESSING_DEVICE";
+const char* const kEnvLocalCpuDevices = "XLA_LOCAL_CPU_DEVICES";
+const char* const kEnvLocalAsyncExecute = "XLA_LOCAL_ASYNC_EXECUTE";
 
 }  // namespace env
 }  // namespace xla
@@ -14,6 +14,8 @@ extern const char* const kEnvWorkers;
 extern const char* const kEnvMeshService;
 extern const char* const kEnvWorldSize;
 extern const char* const kEnvMpDevice;
+extern const char* const kEnvLocalCpuDevices;
+extern const char* const kEnvLocalAsyncExecute;
 
 }  // namespace env
 }  // namespace xla
@@ -0,0 +1,156 @@
+#ifndef XLA_CLIENT_FUTURE_H_
+#define XLA_CLIENT_FUTURE_H_
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "absl/types/optional.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+
+namespace xla {
+namespace util {
+
+template <typename T>
+class Promise;
+
+// The result of an asynchronous operation, which becomes ready once the
+// operation completes with either a value or an error. Unlike std::future,
+// copies share the same state, and continuations can be attached with
+// OnReady() and Then(), instead of blocking a thread in Wait().
+template <typename T>
+class Future {
+  struct State {
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool ready = false;
+    absl::optional<T> value;
+    std::exception_ptr exptr;
+    std::vector<std::function<void()>> callbacks;
+  };
+
+ public:
+  // Returns a future which is already ready with value.
+  static Future Ready(T value) {
+    Future future(std::make_shared<State>());
+    future.state_->value = std::move(value);
+    future.state_->ready = true;
+    return future;
+  }
+
+  bool IsReady() const {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    return state_->ready;
+  }
+
+  // Waits for the future to be ready, and rethrows the operation error, if
+  // any.
+  const Future& Wait() const {
+    std::unique_lock<std::mutex> lock(state_->mutex);
+    state_->cv.wait(lock, [this] { return state_->ready; });
+    if (state_->exptr != nullptr) {
+      std::rethrow_exception(state_->exptr);
+    }
+    return *this;
+  }
+
+  const T& GetValue() const {
+    Wait();
+    return *state_->value;
+  }
+
+  // Moves the value out of the future, leaving the other copies of it with a
+  // moved-from value.
+  T ConsumeValue() {
+    Wait();
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    return std::move(*state_->value);
+  }
+
+  // Calls fn once the future is ready, either with a value or with an error.
+  // If the future is already ready, fn runs in the calling thread, otherwise it
+  // runs in the thread completing the operation, so it should not block.
+  void OnReady(std::function<void(const Future&)> fn) const {
+    {
+      std::lock_guard<std::mutex> lock(state_->mutex);
+      if (!state_->ready) {
+        state_->callbacks.push_back(
+            [future = *this, fn = std::move(fn)]() { fn(future); });
+        return;
+      }
+    }
+    fn(*this);
+  }
+
+  // Returns the future of fn(value), which runs once this future is ready. The
+  // errors of this future, or the ones thrown by fn, are forwarded to the
+  // returned future.
+  template <typename F,
+            typename R = typename std::result_of<F(const T&)>::type>
+  Future<R> Then(F fn) const {
+    Promise<R> promise;
+    Future<R> result = promise.GetFuture();
+    OnReady([promise, fn = std::move(fn)](const Future& future) mutable {
+      try {
+        promise.SetValue(fn(future.GetValue()));
+      } catch (...) {
+        promise.SetException(std::current_exception());
+      }
+    });
+    return result;
+  }
+
+ private:
+  friend class Promise<T>;
+
+  explicit Future(std::shared_ptr<State> state) : state_(std::move(state)) {}
+
+  void Complete(absl::optional<T> value, std::exception_ptr exptr) {
+    std::vector<std::function<void()>> callbacks;
+    {
+      std::lock_guard<std::mutex> lock(state_->mutex);
+      XLA_CHECK(!state_->ready) << "Future already completed";
+      state_->value = std::move(value);
+      state_->exptr = std::move(exptr);
+      state_->ready = true;
+      std::swap(callbacks, state_->callbacks);
+    }
+    state_->cv.notify_all();
+    for (auto& callback : callbacks) {
+      callback();
+    }
+  }
+
+  std::shared_ptr<State> state_;
+};
+
+// The producer side of a Future, which must be completed exactly once, with
+// either SetValue() or SetException().
+template <typename T>
+class Promise {
+ public:
+  Promise() : future_(std::make_shared<typename Future<T>::State>()) {}
+
+  Future<T> GetFuture() const { return future_; }
+
+  void SetValue(T value) {
+    future_.Complete(std::move(value), /*exptr=*/nullptr);
+  }
+
+  void SetException(std::exception_ptr exptr) {
+    future_.Complete(absl::nullopt, std::move(exptr));
+  }
+
+ private:
+  Future<T> future_;
+};
+
+}  // namespace util
+}  // namespace xla
+
+#endif  // XLA_CLIENT_FUTURE_H_
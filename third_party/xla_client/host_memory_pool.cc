@@ -0,0 +1,179 @@
+#include "tensorflow/compiler/xla/xla_client/host_memory_pool.h"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "tensorflow/compiler/xla/util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/tf_logging.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace xla {
+namespace util {
+namespace {
+
+// Sizes up to this value are only rounded up to the alignment.
+constexpr size_t kMinSizeClassBytes = 4096;
+// The number of size classes each power of two range is split into, which
+// bounds the wasted memory to 1/kSizeClassesPerPow2 of the requested size.
+constexpr size_t kSizeClassesPerPow2 = 8;
+
+size_t GetSizeClass(size_t num_bytes) {
+  if (num_bytes <= kMinSizeClassBytes) {
+    return num_bytes;
+  }
+  size_t pow2 = 1;
+  while (pow2 * 2 <= num_bytes) {
+    pow2 *= 2;
+  }
+  return RoundUpToNearest(num_bytes, pow2 / kSizeClassesPerPow2);
+}
+
+int GetCurrentNumaNode() {
+#if defined(SYS_getcpu)
+  unsigned int cpu = 0;
+  unsigned int node = 0;
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) {
+    return static_cast<int>(node);
+  }
+#endif
+  return 0;
+}
+
+}  // namespace
+
+size_t HostMemoryPool::AllocKey::Hash::operator()(const AllocKey& hk) const {
+  return StdHashCombine(StdHashCombine(hk.alignment, hk.num_bytes),
+                        hk.numa_node);
+}
+
+HostMemoryPool* HostMemoryPool::Get() {
+  static HostMemoryPool* pool = new HostMemoryPool(
+      sys_util::GetEnvInt("XLA_TENSOR_ALLOCATOR_MAXSIZE", 1000000000),
+      sys_util::GetEnvBool("XLA_HOST_POOL_PINNED", false),
+      sys_util::GetEnvBool("XLA_HOST_POOL_NUMA", false));
+  return pool;
+}
+
+HostMemoryPool::HostMemoryPool(size_t max_size, bool pinned, bool numa_aware)
+    : max_size_(max_size), pinned_(pinned), numa_aware_(numa_aware) {}
+
+HostMemoryPool::HostMemoryPool(size_t max_size, PinFn pin_fn,
+                               UnpinFn unpin_fn)
+    : max_size_(max_size),
+      pin_fn_(std::move(pin_fn)),
+      unpin_fn_(std::move(unpin_fn)) {}
+
+void* HostMemoryPool::Allocate(size_t alignment, size_t num_bytes) {
+  // We use an alignment-sized area before the memory returned to the caller,
+  // to store a pointer to its AllocBlocks.
+  alignment = std::max<size_t>(alignment, sizeof(void*));
+  // To call aligned_alloc(), num_bytes must be multiple of alignment.
+  num_bytes = RoundUpToNearest(GetSizeClass(num_bytes), alignment);
+
+  AllocKey alloc_key = {alignment, num_bytes,
+                        numa_aware_ ? GetCurrentNumaNode() : 0};
+  void* block = nullptr;
+  AllocBlocks* alloc_blocks = nullptr;
+  std::lock_guard<std::mutex> lock(lock_);
+  auto it = allocs_.find(alloc_key);
+  if (it != allocs_.end()) {
+    alloc_blocks = &*it->second;
+    if (!alloc_blocks->blocks.empty()) {
+      block = alloc_blocks->blocks.back();
+      alloc_blocks->blocks.pop_back();
+    }
+    // LRU
+    alloc_list_.splice(alloc_list_.begin(), alloc_list_, it->second);
+  } else {
+    allocs_.emplace(alloc_key,
+                    alloc_list_.insert(alloc_list_.begin(), alloc_key));
+    alloc_blocks = &alloc_list_.front();
+  }
+  if (block == nullptr) {
+    XLA_COUNTER("HostMemoryPoolMiss", 1);
+    TrimCache(alloc_key.num_bytes);
+    block = NewBlock(alloc_blocks);
+  } else {
+    XLA_COUNTER("HostMemoryPoolHit", 1);
+  }
+  return block;
+}
+
+void HostMemoryPool::Free(void* ptr) {
+  if (ptr != nullptr) {
+    // The pointer to AllocBlocks is right before the user memory.
+    AllocBlocks* alloc_blocks = reinterpret_cast<AllocBlocks**>(ptr)[-1];
+    std::lock_guard<std::mutex> lock(lock_);
+    if (alloc_blocks->alloc_key.num_bytes < max_size_) {
+      alloc_blocks->blocks.push_back(ptr);
+    } else {
+      // We do not cache blocks whose size is bigger than the max cache size.
+      FreeBlock(ptr, alloc_blocks);
+    }
+  }
+}
+
+size_t HostMemoryPool::Size() {
+  std::lock_guard<std::mutex> lock(lock_);
+  return size_;
+}
+
+void* HostMemoryPool::NewBlock(AllocBlocks* alloc_blocks) {
+  const AllocKey& alloc_key = alloc_blocks->alloc_key;
+  // We allocate an extra alignment sized area to store the AllocBlocks
+  // pointer.
+  void* ptr = ::aligned_alloc(alloc_key.alignment,
+                              alloc_key.alignment + alloc_key.num_bytes);
+  XLA_CHECK(ptr != nullptr);
+  ptr = reinterpret_cast<char*>(ptr) + alloc_key.alignment;
+  // Store the pointer to AllocBlocks right before the user memory.
+  reinterpret_cast<AllocBlocks**>(ptr)[-1] = alloc_blocks;
+  if (pinned_ && ::mlock(ptr, alloc_key.num_bytes) != 0) {
+    // Pinning is subject to the RLIMIT_MEMLOCK limit, in which case the block
+    // is used unpinned.
+    XLA_COUNTER("HostMemoryPoolPinFailed", 1);
+    TF_VLOG(3) << "Unable to pin " << alloc_key.num_bytes
+               << " bytes of host memory";
+  }
+  if (pin_fn_ && !pin_fn_(ptr, alloc_key.num_bytes)) {
+    XLA_COUNTER("HostMemoryPoolPinFailed", 1);
+    TF_VLOG(3) << "Unable to register " << alloc_key.num_bytes
+               << " bytes of host memory with the device driver";
+  }
+  size_ += alloc_key.num_bytes;
+  XLA_VALUE_METRIC("HostMemoryPoolSize", size_);
+  return ptr;
+}
+
+void HostMemoryPool::FreeBlock(void* ptr, AllocBlocks* alloc_blocks) {
+  const AllocKey& alloc_key = alloc_blocks->alloc_key;
+  if (pinned_) {
+    ::munlock(ptr, alloc_key.num_bytes);
+  }
+  if (unpin_fn_) {
+    unpin_fn_(ptr);
+  }
+  size_ -= alloc_key.num_bytes;
+  std::free(reinterpret_cast<char*>(ptr) - alloc_key.alignment);
+}
+
+void HostMemoryPool::TrimCache(size_t num_bytes) {
+  auto it = alloc_list_.rbegin();
+  for (; size_ + num_bytes > max_size_ && it != alloc_list_.rend(); ++it) {
+    AllocBlocks* alloc_blocks = &*it;
+    while (!alloc_blocks->blocks.empty() && size_ + num_bytes > max_size_) {
+      FreeBlock(alloc_blocks->blocks.back(), alloc_blocks);
+      alloc_blocks->blocks.pop_back();
+    }
+  }
+}
+
+}  // namespace util
+}  // namespace xla
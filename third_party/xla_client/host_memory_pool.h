@@ -0,0 +1,90 @@
+#ifndef XLA_CLIENT_HOST_MEMORY_POOL_H_
+#define XLA_CLIENT_HOST_MEMORY_POOL_H_
+
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/compiler/xla/types.h"
+
+namespace xla {
+namespace util {
+
+// A pool of host memory blocks, which caches the freed blocks in order to
+// avoid paying the kernel's clear_page_c() price when the same sizes are
+// allocated again (like the staging buffers of the input batches of every
+// step). The requested sizes are rounded up to size classes, so that blocks
+// can be reused by slightly different sizes. The blocks can optionally be
+// pinned (locked in RAM) and cached per NUMA node.
+class HostMemoryPool {
+ public:
+  // Pins a new block with a device driver, returning whether it succeeded.
+  using PinFn = std::function<bool(void*, size_t)>;
+  // Unpins a block before it gets freed.
+  using UnpinFn = std::function<void(void*)>;
+
+  static HostMemoryPool* Get();
+
+  // Creates a pool whose blocks are pinned by pin_fn, like the transfer
+  // staging buffers which are registered with the GPU driver. Registering is
+  // expensive, which the pool caching amortizes.
+  HostMemoryPool(size_t max_size, PinFn pin_fn, UnpinFn unpin_fn);
+
+  void* Allocate(size_t alignment, size_t num_bytes);
+
+  void Free(void* ptr);
+
+  // Returns the number of bytes the pool holds, both the cached and the in use
+  // ones.
+  size_t Size();
+
+ private:
+  struct AllocKey {
+    struct Hash {
+      size_t operator()(const AllocKey& hk) const;
+    };
+
+    bool operator==(const AllocKey& rhs) const {
+      return num_bytes == rhs.num_bytes && alignment == rhs.alignment &&
+             numa_node == rhs.numa_node;
+    }
+
+    size_t alignment = 0;
+    size_t num_bytes = 0;
+    int numa_node = 0;
+  };
+
+  struct AllocBlocks {
+    explicit AllocBlocks(const AllocKey& alloc_key) : alloc_key(alloc_key) {}
+
+    AllocKey alloc_key;
+    std::vector<void*> blocks;
+  };
+
+  using AllocList = std::list<AllocBlocks>;
+
+  HostMemoryPool(size_t max_size, bool pinned, bool numa_aware);
+
+  void* NewBlock(AllocBlocks* alloc_blocks);
+
+  void FreeBlock(void* ptr, AllocBlocks* alloc_blocks);
+
+  void TrimCache(size_t num_bytes);
+
+  size_t max_size_ = 0;
+  bool pinned_ = false;
+  bool numa_aware_ = false;
+  PinFn pin_fn_;
+  UnpinFn unpin_fn_;
+  std::mutex lock_;
+  size_t size_ = 0;
+  AllocList alloc_list_;
+  std::unordered_map<AllocKey, AllocList::iterator, AllocKey::Hash> allocs_;
+};
+
+}  // namespace util
+}  // namespace xla
+
+#endif  // XLA_CLIENT_HOST_MEMORY_POOL_H_
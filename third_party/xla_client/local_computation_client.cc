@@ -0,0 +1,738 @@
+#include "tensorflow/compiler/xla/xla_client/local_computation_client.h"
+
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <thread>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/client/client_library.h"
+#include "tensorflow/compiler/xla/executable_run_options.h"
+#include "tensorflow/compiler/xla/service/executable.h"
+#include "tensorflow/compiler/xla/service/hlo.pb.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/service/platform_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/multi_wait.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/thread_pool.h"
+#include "tensorflow/compiler/xla/xla_client/tf_logging.h"
+
+namespace xla {
+namespace {
+
+thread_local std::vector<std::string> g_replication_devices;
+
+// The XLA host platform exposes a single device, unless told otherwise by the
+// debug flags, which are parsed from XLA_FLAGS the first time they are used.
+void SetHostPlatformDeviceCount(int num_devices) {
+  static const char* const kDeviceCountFlag =
+      "--xla_force_host_platform_device_count";
+  std::string flags = sys_util::GetEnvString("XLA_FLAGS", "");
+  if (flags.find(kDeviceCountFlag) != std::string::npos) {
+    return;
+  }
+  absl::StrAppend(&flags, flags.empty() ? "" : " ", kDeviceCountFlag, "=",
+                  num_devices);
+  setenv("XLA_FLAGS", flags.c_str(), /*overwrite=*/1);
+}
+
+// Input/output aliasing would need the execution to take ownership of the
+// donated argument buffers, which are shared by the Data handles. Aliasing is
+// only a memory optimization, so it is dropped.
+XlaComputation StripInputOutputAliasing(const XlaComputation& computation) {
+  if (computation.proto().input_output_alias().entries_size() == 0) {
+    return XlaComputation(computation.proto());
+  }
+  HloModuleProto proto = computation.proto();
+  proto.clear_input_output_alias();
+  return XlaComputation(std::move(proto));
+}
+
+// The buffer handle of an execution output, and the promise fulfilled by the
+// device worker once the execution completes.
+struct PendingBuffer {
+  PendingBuffer() : handle(std::make_shared<BufferHandle>()) {
+    handle->ready = promise.get_future().share();
+  }
+
+  std::shared_ptr<BufferHandle> handle;
+  std::promise<void> promise;
+};
+
+}  // namespace
+
+// A worker thread running the executions queued for a device, in order.
+class LocalComputationClient::ExecuteQueue {
+ public:
+  ExecuteQueue() : thread_([this]() { Run(); }) {}
+
+  ~ExecuteQueue() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      done_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+  }
+
+  void Schedule(std::function<void()> fn) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queue_.push_back(std::move(fn));
+    }
+    cv_.notify_one();
+  }
+
+ private:
+  void Run() {
+    while (true) {
+      std::function<void()> fn;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return done_ || !queue_.empty(); });
+        if (queue_.empty()) {
+          return;
+        }
+        fn = std::move(queue_.front());
+        queue_.pop_front();
+      }
+      fn();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool done_ = false;
+  std::deque<std::function<void()>> queue_;
+  std::thread thread_;
+};
+
+void LocalComputationClient::LocalData::Assign(const Data& data) {
+  const LocalData& local_data = dynamic_cast<const LocalData&>(data);
+  if (&local_data != this) {
+    handle = local_data.handle;
+    index = local_data.index;
+  }
+}
+
+ShapedBuffer LocalComputationClient::LocalData::GetShapedBuffer() const {
+  XLA_CHECK(handle != nullptr)
+      << "Data placeholder not populated: " << device();
+  if (handle->ready.valid()) {
+    // Rethrows the execution error, if any.
+    handle->ready.get();
+  }
+  return ConsumeValue(handle->buffer->SubShapedBuffer(index));
+}
+
+LocalComputationClient::LocalComputationClient(Options options)
+    : options_(std::move(options)), rng_seed_(0x5a2d296e9) {
+  XLA_CHECK_GT(options_.num_devices, 0);
+  SetHostPlatformDeviceCount(options_.num_devices);
+  se::Platform* platform = ConsumeValue(PlatformUtil::GetPlatform("Host"));
+  LocalClientOptions client_options(platform);
+  if (options_.intra_op_threads > 0) {
+    client_options.set_intra_op_parallelism_threads(options_.intra_op_threads);
+  }
+  client_ = ConsumeValue(ClientLibrary::GetOrCreateLocalClient(client_options));
+  XLA_CHECK_GE(client_->device_count(), options_.num_devices)
+      << "The XLA host platform was configured with fewer devices than "
+         "requested (XLA_FLAGS already parsed?)";
+  for (int i = 0; i < options_.num_devices; ++i) {
+    devices_.push_back(absl::StrCat("CPU:", i));
+    if (options_.async_execute) {
+      queues_.push_back(absl::make_unique<ExecuteQueue>());
+    }
+  }
+  TF_LOG(INFO) << "Local computation client running with "
+               << options_.num_devices << " CPU devices";
+}
+
+LocalComputationClient::~LocalComputationClient() {
+  // Drain the device workers before the client state they use goes away.
+  queues_.clear();
+}
+
+ComputationClient::DataPtr LocalComputationClient::CreateDataPlaceholder(
+    std::string device, Shape shape) {
+  return std::make_shared<LocalData>(std::move(device), std::move(shape));
+}
+
+std::vector<ComputationClient::DataPtr>
+LocalComputationClient::TransferToServer(
+    absl::Span<const TensorSource> tensors) {
+  metrics::TimedSection timed(TransferToServerMetric());
+  TransferManager* transfer_manager = client_->backend().transfer_manager();
+  std::vector<DataPtr> results;
+  results.reserve(tensors.size());
+  int64 total_size = 0;
+  for (auto& tensor : tensors) {
+    int device_ordinal = GetLocalOrdinal(tensor.device);
+    size_t size = ShapeUtil::ByteSizeOf(tensor.shape, sizeof(void*));
+    total_size += size;
+    auto create_buffer = [&]() {
+      if (!tensor.shape.IsArray()) {
+        Literal literal(tensor.shape);
+        tensor.populate_fn(tensor, literal.untyped_data(),
+                           literal.size_bytes());
+        return ConsumeValue(client_->LiteralToShapedBuffer(
+            literal, device_ordinal, client_->backend().memory_allocator()));
+      }
+      // The host platform device memory is host memory, so the tensor data is
+      // written straight into the device buffer.
+      ScopedShapedBuffer buffer =
+          ConsumeValue(transfer_manager->AllocateScopedShapedBuffer(
+              tensor.shape, client_->backend().memory_allocator(),
+              device_ordinal));
+      void* device_buffer = buffer.root_buffer().opaque();
+      if (tensor.data != nullptr) {
+        XLA_CHECK_EQ(tensor.data_size, size);
+        std::memcpy(device_buffer, tensor.data, size);
+      } else {
+        tensor.populate_fn(tensor, device_buffer, size);
+      }
+      return buffer;
+    };
+    auto handle = std::make_shared<BufferHandle>();
+    handle->buffer = TrackBuffer(tensor.device, tensor.shape, create_buffer());
+    results.push_back(std::make_shared<LocalData>(tensor.device, tensor.shape,
+                                                  std::move(handle)));
+    CreateDataHandlesCounter()->AddValue(1);
+  }
+  OutboundDataMetric()->AddSample(total_size);
+  return results;
+}
+
+std::vector<Literal> LocalComputationClient::TransferFromServer(
+    absl::Span<const DataPtr> handles) {
+  std::vector<Literal> results(handles.size());
+  TransferFromServer(handles, [&](size_t index, Literal literal) {
+    results[index] = std::move(literal);
+  });
+  return results;
+}
+
+void LocalComputationClient::TransferFromServer(
+    absl::Span<const DataPtr> handles, const LiteralFn& literal_fn) {
+  metrics::TimedSection timed(TransferFromServerMetric());
+  int64 total_size = 0;
+  for (size_t i = 0; i < handles.size(); ++i) {
+    const LocalData& local_data = dynamic_cast<const LocalData&>(*handles[i]);
+    Literal literal = ConsumeValue(
+        client_->ShapedBufferToLiteral(local_data.GetShapedBuffer()));
+    total_size += literal.size_bytes();
+    literal_fn(i, std::move(literal));
+  }
+  InboundDataMetric()->AddSample(total_size);
+}
+
+std::vector<ComputationClient::DataPtr> LocalComputationClient::CopyDataToDevice(
+    absl::Span<const DataPtr> handles, absl::Span<const std::string> devices) {
+  XLA_CHECK_EQ(handles.size(), devices.size());
+  XLA_TIMED("LocalCopyDataToDevice");
+  TransferManager* transfer_manager = client_->backend().transfer_manager();
+  std::vector<DataPtr> results(handles.size());
+  for (size_t i = 0; i < handles.size(); ++i) {
+    const LocalData& local_data = dynamic_cast<const LocalData&>(*handles[i]);
+    const Shape& shape = local_data.shape();
+    if (!shape.IsArray()) {
+      continue;
+    }
+    ShapedBuffer source = local_data.GetShapedBuffer();
+    // The host platform device memory is host memory, so the copy is a plain
+    // memory copy between the device buffers.
+    ScopedShapedBuffer buffer =
+        ConsumeValue(transfer_manager->AllocateScopedShapedBuffer(
+            shape, client_->backend().memory_allocator(),
+            GetLocalOrdinal(devices[i])));
+    std::memcpy(buffer.root_buffer().opaque(), source.root_buffer().opaque(),
+                ShapeUtil::ByteSizeOf(shape, sizeof(void*)));
+    auto handle = std::make_shared<BufferHandle>();
+    handle->buffer = TrackBuffer(devices[i], shape, std::move(buffer));
+    results[i] =
+        std::make_shared<LocalData>(devices[i], shape, std::move(handle));
+    CreateDataHandlesCounter()->AddValue(1);
+  }
+  return results;
+}
+
+ComputationClient::MemoryInfo LocalComputationClient::GetMemoryInfo(
+    const std::string& device) {
+  std::lock_guard<std::mutex> lock(lock_);
+  auto it = memory_stats_.find(device);
+  return it != memory_stats_.end() ? it->second : MemoryInfo();
+}
+
+void LocalComputationClient::ReclaimMemory(const std::string& device) {
+  // Buffers are freed as soon as their last Data handle goes away, so there
+  // is nothing pending release.
+}
+
+std::vector<ComputationClient::ComputationPtr> LocalComputationClient::Compile(
+    std::vector<CompileInstance> instances) {
+  metrics::TimedSection timed(CompileMetric());
+  std::vector<ComputationPtr> results;
+  results.reserve(instances.size());
+  for (auto& instance : instances) {
+    ProgramShape program_shape =
+        ConsumeValue(instance.computation.GetProgramShape());
+    std::vector<const Shape*> argument_layouts;
+    argument_layouts.reserve(program_shape.parameters_size());
+    for (auto& parameter_shape : program_shape.parameters()) {
+      argument_layouts.push_back(&parameter_shape);
+    }
+    ExecutableBuildOptions build_options;
+    build_options.set_device_ordinal(
+        GetLocalOrdinal(instance.compilation_device));
+    if (instance.is_sharded) {
+      build_options.set_num_replicas(1);
+      build_options.set_num_partitions(instance.devices.size());
+      build_options.set_use_spmd_partitioning(true);
+    } else {
+      build_options.set_num_replicas(
+          std::max<int>(instance.devices.size(), 1));
+    }
+    // The result layout of a sharded computation is the one of the partition
+    // results, which is only known once partitioned.
+    if (instance.output_shape != nullptr && !instance.is_sharded) {
+      build_options.set_result_layout(*instance.output_shape);
+    }
+    std::vector<std::unique_ptr<LocalExecutable>> executables =
+        ConsumeValue(client_->Compile(
+            StripInputOutputAliasing(instance.computation), argument_layouts,
+            build_options));
+    XLA_CHECK_EQ(executables.size(), 1);
+    if (instance.is_sharded) {
+      // The executions create the result data with the shapes of the program,
+      // which need to be the partition ones.
+      program_shape = executables.front()
+                          ->executable()
+                          ->module()
+                          .entry_computation_layout()
+                          .ComputeProgramShape();
+    }
+    results.push_back(std::make_shared<LocalComputation>(
+        std::move(instance.computation), std::move(program_shape),
+        std::move(instance.devices), std::move(executables.front()),
+        instance.is_sharded));
+    CreateCompileHandlesCounter()->AddValue(1);
+  }
+  return results;
+}
+
+std::vector<ComputationClient::DataPtr>
+LocalComputationClient::ExecuteComputation(
+    const Computation& computation, absl::Span<const DataPtr> arguments,
+    const std::string& device, const ExecuteComputationOptions& options) {
+  metrics::TimedSection timed(ExecuteMetric());
+  std::unique_lock<std::mutex> lock = LockQueues();
+  return ExecuteOnDevice(
+      dynamic_cast<const LocalComputation&>(computation),
+      std::vector<DataPtr>(arguments.begin(), arguments.end()), device,
+      options.explode_tuple, MakeRunOptions(GetLocalOrdinal(device)),
+      /*device_assignment=*/nullptr, options.donated_arguments);
+}
+
+util::Future<std::vector<ComputationClient::DataPtr>>
+LocalComputationClient::ExecuteComputationAsync(
+    const Computation& computation, absl::Span<const DataPtr> arguments,
+    const std::string& device, const ExecuteComputationOptions& options) {
+  if (!options_.async_execute) {
+    return util::Future<std::vector<DataPtr>>::Ready(
+        ExecuteComputation(computation, arguments, device, options));
+  }
+  metrics::TimedSection timed(ExecuteMetric());
+  std::unique_lock<std::mutex> lock = LockQueues();
+  std::vector<DataPtr> results = ExecuteOnDevice(
+      dynamic_cast<const LocalComputation&>(computation),
+      std::vector<DataPtr>(arguments.begin(), arguments.end()), device,
+      options.explode_tuple, MakeRunOptions(GetLocalOrdinal(device)),
+      /*device_assignment=*/nullptr, options.donated_arguments);
+  // The device worker runs the queued closures in order, so the one below
+  // completes the future right after the execution.
+  util::Promise<std::vector<DataPtr>> promise;
+  auto completefn = [promise, results]() mutable {
+    try {
+      for (auto& result : results) {
+        dynamic_cast<const LocalData&>(*result).GetShapedBuffer();
+      }
+      promise.SetValue(std::move(results));
+    } catch (...) {
+      promise.SetException(std::current_exception());
+    }
+  };
+  queues_[GetLocalOrdinal(device)]->Schedule(std::move(completefn));
+  return promise.GetFuture();
+}
+
+std::vector<std::vector<ComputationClient::DataPtr>>
+LocalComputationClient::ExecuteReplicated(
+    const Computation& computation,
+    const std::vector<std::vector<DataPtr>>& arguments,
+    absl::Span<const std::string> devices,
+    const ExecuteReplicatedOptions& options) {
+  metrics::TimedSection timed(ExecuteReplicatedMetric());
+  XLA_CHECK_EQ(arguments.size(), devices.size());
+  const LocalComputation& local_computation =
+      dynamic_cast<const LocalComputation&>(computation);
+  // The partitions of a sharded computation are the computations of a single
+  // replica.
+  auto device_assignment =
+      local_computation.is_sharded
+          ? std::make_shared<DeviceAssignment>(1, devices.size())
+          : std::make_shared<DeviceAssignment>(devices.size(), 1);
+  for (size_t i = 0; i < devices.size(); ++i) {
+    if (local_computation.is_sharded) {
+      (*device_assignment)(0, i) = GetLocalOrdinal(devices[i]);
+    } else {
+      (*device_assignment)(i, 0) = GetLocalOrdinal(devices[i]);
+    }
+  }
+  // The cross replica collectives of the CPU backend rendezvous the replicas
+  // sharing the same run ID, so all the replicas must run concurrently.
+  RunId run_id;
+  std::vector<std::vector<DataPtr>> results(devices.size());
+  auto executefn = [&](size_t i) {
+    ExecutableRunOptions run_options =
+        MakeRunOptions(GetLocalOrdinal(devices[i]));
+    run_options.set_run_id(run_id);
+    results[i] = ExecuteOnDevice(local_computation, arguments[i], devices[i],
+                                 options.explode_tuple, std::move(run_options),
+                                 device_assignment, options.donated_arguments);
+  };
+  if (options_.async_execute) {
+    // Every replica goes to the worker of its own device, and the workers run
+    // concurrently.
+    std::unique_lock<std::mutex> lock = LockQueues();
+    for (size_t i = 0; i < devices.size(); ++i) {
+      executefn(i);
+    }
+    return results;
+  }
+  util::MultiWait mwait(devices.size());
+  for (size_t i = 0; i < devices.size(); ++i) {
+    env::ScheduleClosure(mwait.Completer([&, i]() { executefn(i); }));
+  }
+  mwait.Wait();
+  return results;
+}
+
+std::vector<std::vector<ComputationClient::DataPtr>>
+LocalComputationClient::ExecuteParallel(
+    absl::Span<const Computation* const> computations,
+    const std::vector<std::vector<DataPtr>>& arguments,
+    absl::Span<const std::string> devices,
+    const ExecuteParallelOptions& options) {
+  metrics::TimedSection timed(ExecuteParallelMetric());
+  XLA_CHECK_EQ(computations.size(), devices.size());
+  XLA_CHECK_EQ(arguments.size(), devices.size());
+  std::vector<std::vector<DataPtr>> results(devices.size());
+  auto executefn = [&](size_t i) {
+    results[i] = ExecuteOnDevice(
+        dynamic_cast<const LocalComputation&>(*computations[i]), arguments[i],
+        devices[i], options.explode_tuple,
+        MakeRunOptions(GetLocalOrdinal(devices[i])),
+        /*device_assignment=*/nullptr,
+        i < options.donated_arguments.size() ? options.donated_arguments[i]
+                                             : std::vector<bool>());
+  };
+  if (options_.async_execute) {
+    std::unique_lock<std::mutex> lock = LockQueues();
+    for (size_t i = 0; i < devices.size(); ++i) {
+      executefn(i);
+    }
+    return results;
+  }
+  util::MultiWait mwait(devices.size());
+  for (size_t i = 0; i < devices.size(); ++i) {
+    env::ScheduleClosure(mwait.Completer([&, i]() { executefn(i); }));
+  }
+  mwait.Wait();
+  return results;
+}
+
+std::vector<ComputationClient::DataPtr> LocalComputationClient::ExecuteChained(
+    absl::Span<const ExecuteChainedOp> ops, const std::string& device) {
+  metrics::TimedSection timed(ExecuteChainedMetric());
+  std::vector<int64> uses(ops.size(), 0);
+  for (auto& op : ops) {
+    for (auto& input : op.inputs) {
+      uses[input.op_index] += 1;
+    }
+  }
+  std::vector<std::vector<DataPtr>> ops_outputs(ops.size());
+  std::vector<DataPtr> results;
+  for (size_t i = 0; i < ops.size(); ++i) {
+    const ExecuteChainedOp& op = ops[i];
+    if (op.device_data != nullptr) {
+      ops_outputs[i].push_back(op.device_data);
+    } else {
+      std::vector<DataPtr> arguments;
+      arguments.reserve(op.inputs.size());
+      for (auto& input : op.inputs) {
+        XLA_CHECK_LT(input.op_index, i);
+        XLA_CHECK_LT(input.output_index.value_or(0),
+                     ops_outputs[input.op_index].size());
+        arguments.push_back(
+            ops_outputs[input.op_index][input.output_index.value_or(0)]);
+      }
+      std::unique_lock<std::mutex> lock = LockQueues();
+      ops_outputs[i] = ExecuteOnDevice(
+          dynamic_cast<const LocalComputation&>(*op.computation),
+          std::move(arguments), device, /*explode_tuple=*/true,
+          MakeRunOptions(GetLocalOrdinal(device)),
+          /*device_assignment=*/nullptr, /*donated_arguments=*/{});
+    }
+    for (auto& output : op.outputs) {
+      if (output.result_index >= results.size()) {
+        results.resize(output.result_index + 1);
+      }
+      XLA_CHECK_LT(output.output_index.value_or(0), ops_outputs[i].size());
+      results[output.result_index] =
+          ops_outputs[i][output.output_index.value_or(0)];
+    }
+    // Drop references to any intermediate result which is not used anymore.
+    for (auto& input : op.inputs) {
+      uses[input.op_index] -= 1;
+      if (uses[input.op_index] == 0) {
+        ops_outputs[input.op_index].clear();
+      }
+    }
+  }
+  return results;
+}
+
+std::vector<std::vector<ComputationClient::DataPtr>>
+LocalComputationClient::DeconstructTuple(absl::Span<const DataPtr> tuples) {
+  metrics::TimedSection timed(DeconstructTupleMetric());
+  std::vector<std::vector<DataPtr>> results;
+  results.reserve(tuples.size());
+  for (auto& tuple : tuples) {
+    const LocalData& local_data = dynamic_cast<const LocalData&>(*tuple);
+    XLA_CHECK(local_data.shape().IsTuple()) << local_data.shape();
+    std::vector<DataPtr> elements;
+    for (int64 i = 0; i < ShapeUtil::TupleElementCount(local_data.shape());
+         ++i) {
+      // The elements are views sharing the tuple buffers, which are released
+      // when the tuple and all its elements are gone.
+      ShapeIndex index = local_data.index;
+      index.push_back(i);
+      elements.push_back(std::make_shared<LocalData>(
+          local_data.device(),
+          ShapeUtil::GetTupleElementShape(local_data.shape(), i),
+          local_data.handle, std::move(index)));
+      CreateDataHandlesCounter()->AddValue(1);
+    }
+    results.push_back(std::move(elements));
+  }
+  return results;
+}
+
+std::string LocalComputationClient::GetResourceDomain(
+    const std::string& device) const {
+  // All the devices share the host memory, and the executables can run on any
+  // of them.
+  return "local";
+}
+
+std::string LocalComputationClient::GetDefaultDevice() const {
+  return devices_.front();
+}
+
+size_t LocalComputationClient::GetNumDevices() const {
+  return devices_.size();
+}
+
+std::vector<std::string> LocalComputationClient::GetLocalDevices() const {
+  return devices_;
+}
+
+std::vector<std::string> LocalComputationClient::GetAllDevices() const {
+  return devices_;
+}
+
+void LocalComputationClient::SetReplicationDevices(
+    std::vector<std::string> devices) {
+  g_replication_devices = std::move(devices);
+}
+
+const std::vector<std::string>& LocalComputationClient::GetReplicationDevices()
+    const {
+  return g_replication_devices;
+}
+
+std::vector<int64> LocalComputationClient::GetReplicationDevicesHosts() const {
+  return std::vector<int64>(g_replication_devices.size(), 0);
+}
+
+void LocalComputationClient::SetRngSeed(size_t seed) { rng_seed_ = seed; }
+
+std::map<std::string, Metric> LocalComputationClient::GetMetrics() const {
+  return {};
+}
+
+ScopedShapedBuffer LocalComputationClient::RunExecutable(
+    const LocalExecutable& executable, absl::Span<const DataPtr> arguments,
+    const std::string& device, const ExecutableRunOptions& run_options) {
+  std::vector<ShapedBuffer> argument_buffers;
+  argument_buffers.reserve(arguments.size());
+  for (auto& argument : arguments) {
+    const LocalData& local_data = dynamic_cast<const LocalData&>(*argument);
+    argument_buffers.push_back(local_data.GetShapedBuffer());
+  }
+  std::vector<const ShapedBuffer*> argument_ptrs;
+  argument_ptrs.reserve(argument_buffers.size());
+  for (auto& argument_buffer : argument_buffers) {
+    argument_ptrs.push_back(&argument_buffer);
+  }
+  TF_VLOG(5) << "Executing computation on device " << device;
+  // LocalExecutable::Run() is not marked const, but it does not mutate the
+  // executable, which is shared by all the devices running it.
+  return ConsumeValue(const_cast<LocalExecutable&>(executable)
+                          .Run(argument_ptrs, run_options));
+}
+
+std::vector<ComputationClient::DataPtr>
+LocalComputationClient::ExecuteOnDevice(
+    const LocalComputation& computation, std::vector<DataPtr> arguments,
+    const std::string& device, bool explode_tuple,
+    ExecutableRunOptions run_options,
+    std::shared_ptr<const DeviceAssignment> device_assignment,
+    const std::vector<bool>& donated_arguments) {
+  size_t donated_count = 0;
+  for (size_t i = 0; i < arguments.size(); ++i) {
+    LocalData& local_data = dynamic_cast<LocalData&>(*arguments[i]);
+    if (IsDonatedArgument(donated_arguments, i) &&
+        local_data.handle != nullptr && local_data.handle.use_count() == 1) {
+      // The execution takes over the buffers, which are freed as soon as it
+      // is done with them.
+      arguments[i] = std::make_shared<LocalData>(
+          local_data.device(), local_data.shape(),
+          std::move(local_data.handle), local_data.index);
+      ++donated_count;
+    }
+  }
+  if (donated_count > 0) {
+    DonatedDataHandlesCounter()->AddValue(donated_count);
+  }
+
+  const Shape& result_shape = computation.program_shape().result();
+  bool explode = explode_tuple && result_shape.IsTuple();
+  std::vector<Shape> output_shapes;
+  if (explode) {
+    output_shapes = result_shape.tuple_shapes();
+  } else {
+    output_shapes.push_back(result_shape);
+  }
+  std::vector<std::shared_ptr<PendingBuffer>> outputs;
+  std::vector<DataPtr> results;
+  outputs.reserve(output_shapes.size());
+  results.reserve(output_shapes.size());
+  for (auto& output_shape : output_shapes) {
+    outputs.push_back(std::make_shared<PendingBuffer>());
+    results.push_back(std::make_shared<LocalData>(device, output_shape,
+                                                  outputs.back()->handle));
+  }
+  CreateDataHandlesCounter()->AddValue(results.size());
+  std::shared_future<void> ready = outputs.front()->handle->ready;
+
+  auto executefn = [this, executable = computation.executable,
+                    arguments = std::move(arguments), device, explode,
+                    output_shapes = std::move(output_shapes),
+                    outputs = std::move(outputs), run_options,
+                    device_assignment = std::move(device_assignment)]() {
+    try {
+      ExecutableRunOptions device_run_options = run_options;
+      if (device_assignment != nullptr) {
+        device_run_options.set_device_assignment(device_assignment.get());
+      }
+      ScopedShapedBuffer result =
+          RunExecutable(*executable, arguments, device, device_run_options);
+      for (size_t i = 0; i < outputs.size(); ++i) {
+        // Every exploded tuple element takes ownership of its own buffers, so
+        // that they are released independently.
+        outputs[i]->handle->buffer = TrackBuffer(
+            device, output_shapes[i],
+            explode ? result.TakeSubTree({static_cast<int64>(i)})
+                    : std::move(result));
+      }
+      for (auto& output : outputs) {
+        output->promise.set_value();
+      }
+    } catch (...) {
+      std::exception_ptr exptr = std::current_exception();
+      for (auto& output : outputs) {
+        output->promise.set_exception(exptr);
+      }
+    }
+  };
+  if (options_.async_execute) {
+    queues_[GetLocalOrdinal(device)]->Schedule(std::move(executefn));
+  } else {
+    executefn();
+    // Rethrows the execution error, if any.
+    ready.get();
+  }
+  return results;
+}
+
+std::unique_lock<std::mutex> LocalComputationClient::LockQueues() {
+  if (!options_.async_execute) {
+    return std::unique_lock<std::mutex>(queue_lock_, std::defer_lock);
+  }
+  return std::unique_lock<std::mutex>(queue_lock_);
+}
+
+std::shared_ptr<ScopedShapedBuffer> LocalComputationClient::TrackBuffer(
+    const std::string& device, const Shape& shape, ScopedShapedBuffer buffer) {
+  int64 size = TrackDataAllocation(device, shape);
+  return std::shared_ptr<ScopedShapedBuffer>(
+      new ScopedShapedBuffer(std::move(buffer)),
+      [this, device, size](ScopedShapedBuffer* ptr) {
+        delete ptr;
+        ReleaseDataAllocation(device, size);
+      });
+}
+
+ExecutableRunOptions LocalComputationClient::MakeRunOptions(
+    int device_ordinal) const {
+  ExecutableRunOptions run_options;
+  run_options.set_device_ordinal(device_ordinal);
+  run_options.set_allocator(client_->backend().memory_allocator());
+  run_options.set_intra_op_thread_pool(
+      client_->backend().eigen_intra_op_thread_pool_device());
+  run_options.set_rng_seed(static_cast<int>(rng_seed_.load()));
+  return run_options;
+}
+
+int LocalComputationClient::GetLocalOrdinal(const std::string& device) const {
+  int64 ordinal = GetDeviceOrdinal(device);
+  XLA_CHECK(ordinal >= 0 && ordinal < options_.num_devices)
+      << "Invalid local device: " << device;
+  return ordinal;
+}
+
+int64 LocalComputationClient::TrackDataAllocation(const std::string& device,
+                                                  const Shape& shape) {
+  int64 size = ShapeUtil::ByteSizeOf(shape, sizeof(void*));
+  std::lock_guard<std::mutex> lock(lock_);
+  MemoryInfo* info = &memory_stats_[device];
+  info->live_bytes += size;
+  info->peak_bytes = std::max(info->peak_bytes, info->live_bytes);
+  return size;
+}
+
+void LocalComputationClient::ReleaseDataAllocation(const std::string& device,
+                                                   int64 size) {
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    memory_stats_[device].live_bytes -= size;
+  }
+  ReleaseDataHandlesCounter()->AddValue(1);
+}
+
+}  // namespace xla
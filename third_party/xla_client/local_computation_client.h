@@ -0,0 +1,225 @@
+#ifndef XLA_CLIENT_LOCAL_COMPUTATION_CLIENT_H_
+#define XLA_CLIENT_LOCAL_COMPUTATION_CLIENT_H_
+
+#include <atomic>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "tensorflow/compiler/xla/client/local_client.h"
+#include "tensorflow/compiler/xla/service/computation_placer.h"
+#include "tensorflow/compiler/xla/service/shaped_buffer.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+
+namespace xla {
+
+// A computation client which runs the computations on the CPU devices of the
+// calling process, through the XLA local client. Unlike the XRT path through
+// the local service, transfers and executions do not go through the gRPC
+// session and its proto serialization, and the device buffers are host memory
+// which tensor data is written to, and read from, directly.
+// The XLA host platform is configured with the requested number of virtual
+// devices, and the replicated executions run the replicas concurrently, so
+// that the cross replica collectives are real ones.
+// Executions are asynchronous by default: they are queued to a per device
+// worker thread, and return Data handles which are futures of the results,
+// which block only when their buffers are accessed.
+class LocalComputationClient : public ComputationClient {
+  // The device buffers backing one or more Data handles (the tuple element
+  // views share the buffers of the tuple). If the buffers are the result of an
+  // execution still in flight, ready is valid and becomes ready (or holds the
+  // execution error) once buffer has been populated.
+  struct BufferHandle {
+    std::shared_ptr<ScopedShapedBuffer> buffer;
+    std::shared_future<void> ready;
+  };
+
+  struct LocalData : public Data {
+    LocalData(std::string device, Shape device_shape)
+        : Data(std::move(device), std::move(device_shape)) {}
+    LocalData(std::string device, Shape device_shape,
+              std::shared_ptr<BufferHandle> handle, ShapeIndex index = {})
+        : Data(std::move(device), std::move(device_shape)),
+          handle(std::move(handle)),
+          index(std::move(index)) {}
+
+    OpaqueHandle GetOpaqueHandle() override {
+      return reinterpret_cast<OpaqueHandle>(handle.get());
+    }
+
+    void Assign(const Data& data) override;
+
+    bool HasValue() const override { return handle != nullptr; }
+
+    // Returns a view of the device buffers of the data, which is a sub tree of
+    // the buffer if the data came from a DeconstructTuple(). Waits for the
+    // execution producing the buffers, if still pending.
+    ShapedBuffer GetShapedBuffer() const;
+
+    std::shared_ptr<BufferHandle> handle;
+    ShapeIndex index;
+  };
+
+  struct LocalComputation : public Computation {
+    LocalComputation(XlaComputation computation, ProgramShape program_shape,
+                     std::vector<std::string> devices,
+                     std::shared_ptr<LocalExecutable> executable,
+                     bool is_sharded)
+        : Computation(std::move(computation), std::move(program_shape),
+                      std::move(devices)),
+          executable(std::move(executable)),
+          is_sharded(is_sharded) {}
+
+    // Shared with the queued executions, which can outlive the computation.
+    std::shared_ptr<LocalExecutable> executable;
+    // Whether the executable is the SPMD partitioned version of computation,
+    // in which case the program shape is the one of a single partition.
+    bool is_sharded = false;
+  };
+
+  class ExecuteQueue;
+
+ public:
+  struct Options {
+    int num_devices = 1;
+    // The number of threads of the intra op (Eigen) thread pool shared by all
+    // the devices. Zero lets XLA pick one.
+    int intra_op_threads = 0;
+    // Whether the executions are queued to the device workers, instead of
+    // being run by the calling thread.
+    bool async_execute = true;
+  };
+
+  explicit LocalComputationClient(Options options);
+
+  ~LocalComputationClient() override;
+
+  DataPtr CreateDataPlaceholder(std::string device, Shape shape) override;
+
+  std::vector<DataPtr> TransferToServer(
+      absl::Span<const TensorSource> tensors) override;
+
+  std::vector<Literal> TransferFromServer(
+      absl::Span<const DataPtr> handles) override;
+
+  void TransferFromServer(absl::Span<const DataPtr> handles,
+                          const LiteralFn& literal_fn) override;
+
+  std::vector<DataPtr> CopyDataToDevice(
+      absl::Span<const DataPtr> handles,
+      absl::Span<const std::string> devices) override;
+
+  MemoryInfo GetMemoryInfo(const std::string& device) override;
+
+  void ReclaimMemory(const std::string& device) override;
+
+  std::vector<ComputationPtr> Compile(
+      std::vector<CompileInstance> instances) override;
+
+  std::vector<DataPtr> ExecuteComputation(
+      const Computation& computation, absl::Span<const DataPtr> arguments,
+      const std::string& device,
+      const ExecuteComputationOptions& options) override;
+
+  util::Future<std::vector<DataPtr>> ExecuteComputationAsync(
+      const Computation& computation, absl::Span<const DataPtr> arguments,
+      const std::string& device,
+      const ExecuteComputationOptions& options) override;
+
+  std::vector<std::vector<DataPtr>> ExecuteReplicated(
+      const Computation& computation,
+      const std::vector<std::vector<DataPtr>>& arguments,
+      absl::Span<const std::string> devices,
+      const ExecuteReplicatedOptions& options) override;
+
+  std::vector<std::vector<DataPtr>> ExecuteParallel(
+      absl::Span<const Computation* const> computations,
+      const std::vector<std::vector<DataPtr>>& arguments,
+      absl::Span<const std::string> devices,
+      const ExecuteParallelOptions& options) override;
+
+  std::vector<DataPtr> ExecuteChained(absl::Span<const ExecuteChainedOp> ops,
+                                      const std::string& device) override;
+
+  std::vector<std::vector<DataPtr>> DeconstructTuple(
+      absl::Span<const DataPtr> tuples) override;
+
+  std::string GetResourceDomain(const std::string& device) const override;
+
+  std::string GetDefaultDevice() const override;
+
+  size_t GetNumDevices() const override;
+
+  std::vector<std::string> GetLocalDevices() const override;
+
+  std::vector<std::string> GetAllDevices() const override;
+
+  void SetReplicationDevices(std::vector<std::string> devices) override;
+
+  const std::vector<std::string>& GetReplicationDevices() const override;
+
+  std::vector<int64> GetReplicationDevicesHosts() const override;
+
+  void SetRngSeed(size_t seed) override;
+
+  std::map<std::string, Metric> GetMetrics() const override;
+
+ private:
+  // Runs the executable on the device, waiting for the arguments buffers to
+  // be ready.
+  ScopedShapedBuffer RunExecutable(const LocalExecutable& executable,
+                                   absl::Span<const DataPtr> arguments,
+                                   const std::string& device,
+                                   const ExecutableRunOptions& run_options);
+
+  // Runs the computation on the device, and returns the result split into its
+  // tuple elements if explode_tuple is true. With asynchronous executions the
+  // computation is queued to the device worker, and the returned Data handles
+  // become ready once it completes. If not null, device_assignment is set into
+  // the run options, and kept alive until the execution completes. The buffers
+  // of the donated arguments are moved out of their Data, and released as soon
+  // as the execution completes.
+  std::vector<DataPtr> ExecuteOnDevice(
+      const LocalComputation& computation, std::vector<DataPtr> arguments,
+      const std::string& device, bool explode_tuple,
+      ExecutableRunOptions run_options,
+      std::shared_ptr<const DeviceAssignment> device_assignment,
+      const std::vector<bool>& donated_arguments);
+
+  // Returns a lock serializing the queueing of the executions, which is not
+  // locked (nor needed) with synchronous executions.
+  std::unique_lock<std::mutex> LockQueues();
+
+  // Wraps the buffer into a shared one which accounts the buffer memory in the
+  // device memory stats, for as long as the buffer is alive.
+  std::shared_ptr<ScopedShapedBuffer> TrackBuffer(const std::string& device,
+                                                  const Shape& shape,
+                                                  ScopedShapedBuffer buffer);
+
+  ExecutableRunOptions MakeRunOptions(int device_ordinal) const;
+
+  int GetLocalOrdinal(const std::string& device) const;
+
+  int64 TrackDataAllocation(const std::string& device, const Shape& shape);
+
+  void ReleaseDataAllocation(const std::string& device, int64 size);
+
+  Options options_;
+  LocalClient* client_ = nullptr;
+  std::vector<std::string> devices_;
+  std::atomic<size_t> rng_seed_;
+  std::mutex lock_;
+  std::map<std::string, MemoryInfo> memory_stats_;
+  // Serializes the queueing of executions, so that the replicas of all the
+  // replicated executions are queued in the same order on every device.
+  std::mutex queue_lock_;
+  std::vector<std::unique_ptr<ExecuteQueue>> queues_;
+};
+
+}  // namespace xla
+
+#endif  // XLA_CLIENT_LOCAL_COMPUTATION_CLIENT_H_
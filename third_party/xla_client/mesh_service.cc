@@ -9,19 +9,26 @@
 #include <grpcpp/server_builder.h>
 #include <grpcpp/server_context.h>
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <functional>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <mutex>
 #include <set>
+#include <thread>
 #include <unordered_map>
 
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
+#include "absl/types/optional.h"
 #include "tensorflow/compiler/xla/status.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 #include "tensorflow/compiler/xla/xla_client/mesh_service.grpc.pb.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
 #include "tensorflow/compiler/xla/xla_client/multi_wait.h"
 #include "tensorflow/compiler/xla/xla_client/nccl_distributed.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
@@ -47,6 +54,24 @@ namespace {
                               status.error_message());
 }
 
+int64 GetMaxMessageSize() {
+  static const int64 max_msg_size =
+      sys_util::GetEnvInt("XRT_MESH_MAX_MSGSIZE", 1024 * 1024 * 1024);
+  return max_msg_size;
+}
+
+// Returns the number of seconds after which the mesh master considers stale a
+// worker which stopped sending heartbeats. Zero disables the detection.
+double GetHeartbeatTimeout() {
+  static const double timeout =
+      sys_util::GetEnvDouble("XRT_MESH_HEARTBEAT_TIMEOUT", 60.0);
+  return timeout;
+}
+
+std::string ReduceTag(const std::string& tag) {
+  return absl::StrCat("MeshReduce:", tag);
+}
+
 std::ostream& operator<<(std::ostream& ostrm, const ::grpc::Status& status) {
   if (status.ok()) {
     ostrm << "OK";
@@ -59,7 +84,9 @@ std::ostream& operator<<(std::ostream& ostrm, const ::grpc::Status& status) {
 
 class MeshServiceImpl : public grpc::MeshService::Service {
  public:
-  MeshServiceImpl(grpc::Config config) : config_(std::move(config)) {}
+  MeshServiceImpl() = default;
+
+  void SetConfig(grpc::Config config);
 
   ::grpc::Status GetConfig(::grpc::ServerContext* context,
                            const grpc::GetConfigRequest* request,
@@ -69,12 +96,73 @@ class MeshServiceImpl : public grpc::MeshService::Service {
                             const grpc::RendezvousRequest* request,
                             grpc::RendezvousResponse* response) override;
 
+  ::grpc::Status MeshReduce(::grpc::ServerContext* context,
+                            const grpc::MeshReduceRequest* request,
+                            grpc::MeshReduceResponse* response) override;
+
   ::grpc::Status GetNcclUniqueUid(
       ::grpc::ServerContext* context,
       const grpc::GetNcclUniqueUidRequest* request,
       grpc::GetNcclUniqueUidResponse* response) override;
 
+  ::grpc::Status Heartbeat(::grpc::ServerContext* context,
+                           const grpc::HeartbeatRequest* request,
+                           grpc::HeartbeatResponse* response) override;
+
+  ::grpc::Status Rejoin(::grpc::ServerContext* context,
+                        const grpc::RejoinRequest* request,
+                        grpc::RejoinResponse* response) override;
+
  private:
+  // Collects the processes rejoining the mesh after a membership change. The
+  // last one to join resizes the mesh, before releasing the others.
+  class RejoinData {
+   public:
+    explicit RejoinData(size_t world_size)
+        : world_size_(world_size), release_count_(0) {}
+
+    bool Release() { return release_count_.fetch_add(1) + 1 == world_size_; }
+
+    ::grpc::Status Join(int64 ordinal, size_t world_size, double wait_seconds,
+                        const std::function<void()>& resize_fn) {
+      std::unique_lock<std::mutex> lock(lock_);
+      if (world_size != world_size_) {
+        return ::grpc::Status(
+            ::grpc::StatusCode::INVALID_ARGUMENT,
+            absl::StrCat("Mismatching world size: ", world_size_, " vs. ",
+                         world_size));
+      }
+      if (!ordinals_.insert(ordinal).second) {
+        return ::grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT,
+                              absl::StrCat("Duplicate ordinal: ", ordinal));
+      }
+      if (ordinals_.size() == world_size_) {
+        resize_fn();
+        cv_.notify_all();
+      } else if (!cv_.wait_for(
+                     lock, std::chrono::duration<double>(wait_seconds),
+                     [this] { return ordinals_.size() >= world_size_; })) {
+        return ::grpc::Status(
+            ::grpc::StatusCode::DEADLINE_EXCEEDED,
+            absl::StrCat("Only ", ordinals_.size(), " of ", world_size_,
+                         " processes rejoined the mesh"));
+      }
+      return ::grpc::Status::OK;
+    }
+
+    std::vector<int64> Ordinals() {
+      std::lock_guard<std::mutex> lock(lock_);
+      return std::vector<int64>(ordinals_.begin(), ordinals_.end());
+    }
+
+   private:
+    size_t world_size_;
+    std::mutex lock_;
+    std::condition_variable cv_;
+    std::set<int64> ordinals_;
+    std::atomic<size_t> release_count_;
+  };
+
   class RendezvousData {
    public:
     explicit RendezvousData(size_t count, const std::set<int64>& replicas)
@@ -85,9 +173,23 @@ class MeshServiceImpl : public grpc::MeshService::Service {
 
     bool Release() { return release_count_.fetch_add(1) == 0; }
 
-    ::grpc::Status Wait() {
-      ::grpc::Status status =
-          ToGrpcStatus(xla::util::CheckedCall([&]() { mwait_.Wait(); }));
+    // Waits for all the participants to arrive. If the stale_fn returns some
+    // of the participants which did not arrive yet, the wait fails instead of
+    // blocking the arrived ones until the RPC deadline.
+    ::grpc::Status Wait(const std::function<std::set<int64>()>& stale_fn) {
+      ::grpc::Status status;
+      double timeout = GetHeartbeatTimeout();
+      if (timeout <= 0) {
+        status =
+            ToGrpcStatus(xla::util::CheckedCall([&]() { mwait_.Wait(); }));
+      } else {
+        while (!WaitFor(timeout / 4)) {
+          status = CheckMissing(stale_fn());
+          if (!status.ok()) {
+            return status;
+          }
+        }
+      }
       if (status.ok()) {
         std::lock_guard<std::mutex> lock(lock_);
         status = status_;
@@ -95,7 +197,7 @@ class MeshServiceImpl : public grpc::MeshService::Service {
       return status;
     }
 
-    void Complete(int64 ordinal, std::string payload,
+    void Complete(int64 ordinal, std::string payload, uint64 total_size,
                   const std::set<int64>& replicas) {
       std::lock_guard<std::mutex> lock(lock_);
       if ((!replicas_.empty() && replicas_.count(ordinal) == 0) ||
@@ -114,6 +216,8 @@ class MeshServiceImpl : public grpc::MeshService::Service {
           status_ =
               ::grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT,
                              absl::StrCat("Duplicate ordinal: ", ordinal));
+        } else {
+          total_sizes_.emplace(ordinal, total_size);
         }
       }
       mwait_.Done();
@@ -121,14 +225,95 @@ class MeshServiceImpl : public grpc::MeshService::Service {
 
     const std::map<int64, std::string>& Payloads() const { return payloads_; };
 
+    const std::map<int64, uint64>& TotalSizes() const { return total_sizes_; };
+
+    // Reduces the payloads, holding arrays of doubles, once for all the
+    // participants of the rendezvous.
+    ::grpc::Status Reduce(grpc::MeshReduceType reduce_type,
+                          grpc::MeshReduceResponse* response) {
+      std::call_once(reduce_once_, [&]() { ReduceValues(reduce_type); });
+      if (reduce_status_.ok()) {
+        response->mutable_values()->Reserve(reduced_.size());
+        for (auto value : reduced_) {
+          response->add_values(value);
+        }
+      }
+      return reduce_status_;
+    }
+
    private:
+    bool WaitFor(double seconds) {
+      try {
+        mwait_.Wait(seconds);
+      } catch (const std::runtime_error&) {
+        return false;
+      }
+      return true;
+    }
+
+    ::grpc::Status CheckMissing(const std::set<int64>& stale_ordinals) {
+      std::vector<int64> missing;
+      std::lock_guard<std::mutex> lock(lock_);
+      for (auto ordinal : stale_ordinals) {
+        bool expected = replicas_.empty() ? ordinal < count_
+                                          : replicas_.count(ordinal) > 0;
+        if (expected && payloads_.count(ordinal) == 0) {
+          missing.push_back(ordinal);
+        }
+      }
+      if (missing.empty()) {
+        return ::grpc::Status::OK;
+      }
+      return ::grpc::Status(
+          ::grpc::StatusCode::UNAVAILABLE,
+          absl::StrCat("Rendezvous participants stopped sending heartbeats: ",
+                       absl::StrJoin(missing, ", ")));
+    }
+
+    void ReduceValues(grpc::MeshReduceType reduce_type) {
+      for (auto& ordinal_payload : payloads_) {
+        const std::string& payload = ordinal_payload.second;
+        size_t count = payload.size() / sizeof(double);
+        const double* values = reinterpret_cast<const double*>(payload.data());
+        if (ordinal_payload.first == payloads_.begin()->first) {
+          reduced_.assign(values, values + count);
+          continue;
+        }
+        if (count != reduced_.size()) {
+          reduce_status_ = ::grpc::Status(
+              ::grpc::StatusCode::INVALID_ARGUMENT,
+              absl::StrCat("Mismatching reduce size from ordinal ",
+                           ordinal_payload.first, ": ", count, " vs. ",
+                           reduced_.size()));
+          return;
+        }
+        for (size_t i = 0; i < count; ++i) {
+          switch (reduce_type) {
+            case grpc::MESH_REDUCE_SUM:
+              reduced_[i] += values[i];
+              break;
+            case grpc::MESH_REDUCE_MIN:
+              reduced_[i] = std::min(reduced_[i], values[i]);
+              break;
+            case grpc::MESH_REDUCE_MAX:
+              reduced_[i] = std::max(reduced_[i], values[i]);
+              break;
+          }
+        }
+      }
+    }
+
     size_t count_;
     std::set<int64> replicas_;
     std::mutex lock_;
     util::MultiWait mwait_;
     std::atomic<size_t> release_count_;
     std::map<int64, std::string> payloads_;
+    std::map<int64, uint64> total_sizes_;
     ::grpc::Status status_;
+    std::once_flag reduce_once_;
+    std::vector<double> reduced_;
+    ::grpc::Status reduce_status_;
   };
 
   std::shared_ptr<RendezvousData> GetRendezvous(
@@ -152,30 +337,75 @@ class MeshServiceImpl : public grpc::MeshService::Service {
     }
   }
 
+  std::set<int64> GetStaleOrdinals() {
+    std::set<int64> stale_ordinals;
+    int64 now = sys_util::NowNs();
+    int64 timeout_ns = static_cast<int64>(GetHeartbeatTimeout() * 1e9);
+    std::lock_guard<std::mutex> lock(lock_);
+    for (auto& ordinal_time : heartbeats_) {
+      if (now - ordinal_time.second > timeout_ns) {
+        stale_ordinals.insert(ordinal_time.first);
+      }
+    }
+    return stale_ordinals;
+  }
+
+  ::grpc::Status WaitRendezvous(RendezvousData* rendezvous) {
+    return rendezvous->Wait([this]() { return GetStaleOrdinals(); });
+  }
+
   std::mutex lock_;
   grpc::Config config_;
+  bool config_ready_ = false;
+  std::condition_variable config_cv_;
   std::unordered_map<std::string, std::shared_ptr<RendezvousData>>
       rendezvous_map_;
+  std::unordered_map<std::string, std::shared_ptr<RejoinData>> rejoin_map_;
+  // The time of the last heartbeat received from every ordinal. Ordinals which
+  // never sent one are never considered stale.
+  std::map<int64, int64> heartbeats_;
 };
 
 ::grpc::Status MeshServiceImpl::GetConfig(::grpc::ServerContext* context,
                                           const grpc::GetConfigRequest* request,
                                           grpc::GetConfigResponse* response) {
   TF_VLOG(3) << "Got config fetch request: peer=" << context->peer();
+  std::unique_lock<std::mutex> lock(lock_);
+  // The request is released as soon as the config gets published, and only
+  // wakes up periodically to notice the clients which gave up.
+  while (!config_cv_.wait_for(lock, std::chrono::seconds(1),
+                              [this]() { return config_ready_; })) {
+    if (context->IsCancelled()) {
+      return ::grpc::Status(::grpc::StatusCode::CANCELLED,
+                            "Config fetch cancelled");
+    }
+  }
   response->mutable_config()->CopyFrom(config_);
   return ::grpc::Status::OK;
 }
 
+void MeshServiceImpl::SetConfig(grpc::Config config) {
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    config_ = std::move(config);
+    config_ready_ = true;
+  }
+  config_cv_.notify_all();
+}
+
 ::grpc::Status MeshServiceImpl::Rendezvous(
     ::grpc::ServerContext* context, const grpc::RendezvousRequest* request,
     grpc::RendezvousResponse* response) {
   std::set<int64> replicas(request->replicas().begin(),
                            request->replicas().end());
   auto rendezvous = GetRendezvous(request->tag(), replicas);
-  rendezvous->Complete(request->ordinal(), request->payload(), replicas);
+  uint64 total_size = request->has_total_size() ? request->total_size()
+                                                : request->payload().size();
+  rendezvous->Complete(request->ordinal(), request->payload(), total_size,
+                       replicas);
   TF_VLOG(3) << "Entering rendezvous: ordinal=" << request->ordinal()
              << ", tag=" << request->tag() << ", peer=" << context->peer();
-  ::grpc::Status status = rendezvous->Wait();
+  ::grpc::Status status = WaitRendezvous(rendezvous.get());
   TF_VLOG(3) << "Exiting rendezvous: ordinal=" << request->ordinal()
              << ", tag=" << request->tag() << ", peer=" << context->peer()
              << ", status=" << status;
@@ -183,11 +413,42 @@ class MeshServiceImpl : public grpc::MeshService::Service {
     for (auto& ordinal_payload : rendezvous->Payloads()) {
       response->add_payloads(ordinal_payload.second);
     }
+    for (auto& ordinal_size : rendezvous->TotalSizes()) {
+      response->add_total_sizes(ordinal_size.second);
+    }
   }
   ReleaseRendezvous(request->tag(), rendezvous);
   return status;
 }
 
+::grpc::Status MeshServiceImpl::MeshReduce(
+    ::grpc::ServerContext* context, const grpc::MeshReduceRequest* request,
+    grpc::MeshReduceResponse* response) {
+  std::set<int64> replicas(request->replicas().begin(),
+                           request->replicas().end());
+  // Reduce and plain rendezvous live in different tag namespaces, as their
+  // payloads are not compatible.
+  std::string tag = ReduceTag(request->tag());
+  auto rendezvous = GetRendezvous(tag, replicas);
+  const auto& values = request->values();
+  std::string payload(reinterpret_cast<const char*>(values.data()),
+                      values.size() * sizeof(double));
+  uint64 total_size = payload.size();
+  rendezvous->Complete(request->ordinal(), std::move(payload), total_size,
+                       replicas);
+  TF_VLOG(3) << "Entering mesh reduce: ordinal=" << request->ordinal()
+             << ", tag=" << request->tag() << ", peer=" << context->peer();
+  ::grpc::Status status = WaitRendezvous(rendezvous.get());
+  TF_VLOG(3) << "Exiting mesh reduce: ordinal=" << request->ordinal()
+             << ", tag=" << request->tag() << ", peer=" << context->peer()
+             << ", status=" << status;
+  if (status.ok()) {
+    status = rendezvous->Reduce(request->reduce_type(), response);
+  }
+  ReleaseRendezvous(tag, rendezvous);
+  return status;
+}
+
 ::grpc::Status MeshServiceImpl::GetNcclUniqueUid(
     ::grpc::ServerContext* context,
     const grpc::GetNcclUniqueUidRequest* request,
@@ -202,14 +463,72 @@ class MeshServiceImpl : public grpc::MeshService::Service {
   return ::grpc::Status::OK;
 }
 
+::grpc::Status MeshServiceImpl::Heartbeat(::grpc::ServerContext* context,
+                                          const grpc::HeartbeatRequest* request,
+                                          grpc::HeartbeatResponse* response) {
+  TF_VLOG(5) << "Got heartbeat: ordinal=" << request->ordinal()
+             << ", peer=" << context->peer();
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    heartbeats_[request->ordinal()] = sys_util::NowNs();
+  }
+  for (auto ordinal : GetStaleOrdinals()) {
+    response->add_stale_ordinals(ordinal);
+  }
+  return ::grpc::Status::OK;
+}
+
+::grpc::Status MeshServiceImpl::Rejoin(::grpc::ServerContext* context,
+                                       const grpc::RejoinRequest* request,
+                                       grpc::RejoinResponse* response) {
+  static const double rejoin_wait =
+      sys_util::GetEnvDouble("XRT_MESH_REJOIN_WAIT", 300.0);
+  std::shared_ptr<RejoinData> rejoin;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    auto it = rejoin_map_.find(request->tag());
+    if (it == rejoin_map_.end()) {
+      it = rejoin_map_
+               .emplace(request->tag(),
+                        std::make_shared<RejoinData>(request->world_size()))
+               .first;
+    }
+    rejoin = it->second;
+  }
+  TF_VLOG(3) << "Entering mesh rejoin: ordinal=" << request->ordinal()
+             << ", tag=" << request->tag()
+             << ", world_size=" << request->world_size()
+             << ", peer=" << context->peer();
+  auto resize_fn = [&]() {
+    std::lock_guard<std::mutex> lock(lock_);
+    TF_LOG(INFO) << "Resizing mesh from " << config_.mesh_size() << " to "
+                 << request->world_size() << " processes";
+    config_.set_mesh_size(request->world_size());
+    // The heartbeats refer to the previous ordinals, which are now renumbered.
+    heartbeats_.clear();
+  };
+  ::grpc::Status status = rejoin->Join(
+      request->ordinal(), request->world_size(), rejoin_wait, resize_fn);
+  TF_VLOG(3) << "Exiting mesh rejoin: ordinal=" << request->ordinal()
+             << ", tag=" << request->tag() << ", status=" << status;
+  if (status.ok()) {
+    for (auto ordinal : rejoin->Ordinals()) {
+      response->add_ordinals(ordinal);
+    }
+  }
+  if (rejoin->Release() || !status.ok()) {
+    std::lock_guard<std::mutex> lock(lock_);
+    rejoin_map_.erase(request->tag());
+  }
+  return status;
+}
+
 }  // namespace
 
 struct MeshService::Impl {
-  Impl(const std::string& address, grpc::Config config)
-      : impl(std::move(config)) {
+  explicit Impl(const std::string& address) {
     ::grpc::ServerBuilder builder;
-    int64 max_msg_size =
-        sys_util::GetEnvInt("XRT_MESH_MAX_MSGSIZE", 1024 * 1024 * 1024);
+    int64 max_msg_size = GetMaxMessageSize();
     builder.SetMaxReceiveMessageSize(max_msg_size);
     builder.SetMaxSendMessageSize(max_msg_size);
     builder.AddListeningPort(address, ::grpc::InsecureServerCredentials());
@@ -222,20 +541,122 @@ struct MeshService::Impl {
 };
 
 MeshService::MeshService(const std::string& address, grpc::Config config)
-    : impl_(new Impl(address, std::move(config))) {}
+    : impl_(new Impl(address)) {
+  SetConfig(std::move(config));
+}
+
+MeshService::MeshService(const std::string& address)
+    : impl_(new Impl(address)) {}
 
 MeshService::~MeshService() {}
 
+void MeshService::SetConfig(grpc::Config config) {
+  impl_->impl.SetConfig(std::move(config));
+}
+
 struct MeshClient::Impl {
   explicit Impl(const std::string& address) : address(address) {
-    channel =
-        ::grpc::CreateChannel(address, ::grpc::InsecureChannelCredentials());
+    ::grpc::ChannelArguments args;
+    args.SetMaxReceiveMessageSize(GetMaxMessageSize());
+    args.SetMaxSendMessageSize(GetMaxMessageSize());
+    // The clients usually start before the mesh master serves, and the default
+    // reconnect backoff grows up to two minutes, delaying the connection long
+    // after the master came up.
+    args.SetInt(GRPC_ARG_MAX_RECONNECT_BACKOFF_MS, 1000);
+    channel = ::grpc::CreateCustomChannel(
+        address, ::grpc::InsecureChannelCredentials(), args);
     stub = grpc::MeshService::NewStub(channel);
   }
 
+  // Returns the size of the payload chunks exchanged at every rendezvous
+  // round. The response of a round carries one chunk per replica, so the
+  // default chunk size is such that it fits the maximum message size.
+  size_t GetChunkSize(const MeshClient* client, size_t num_replicas) {
+    static const int64 chunk_size = sys_util::GetEnvInt(
+        "XRT_MESH_CHUNK_SIZE", std::numeric_limits<int64>::max());
+    if (num_replicas == 0) {
+      if (mesh_size == 0) {
+        mesh_size = client->GetConfig().mesh_size();
+      }
+      num_replicas = mesh_size;
+    }
+    int64 fit_size = GetMaxMessageSize() / (num_replicas + 1);
+    return std::max<int64>(std::min(chunk_size, fit_size), 1);
+  }
+
+  grpc::RendezvousResponse RendezvousRound(int ordinal, const std::string& tag,
+                                           std::string payload,
+                                           absl::optional<uint64> total_size,
+                                           absl::Span<const int64> replicas) {
+    ::grpc::ClientContext context;
+    grpc::RendezvousRequest request;
+    grpc::RendezvousResponse response;
+    request.set_tag(tag);
+    request.set_payload(std::move(payload));
+    request.set_ordinal(ordinal);
+    if (total_size) {
+      request.set_total_size(*total_size);
+    }
+    for (auto& replica : replicas) {
+      request.add_replicas(replica);
+    }
+    TF_VLOG(3) << "Waiting for rendezvous: ordinal=" << ordinal
+               << " tag=" << tag;
+    ::grpc::Status status = stub->Rendezvous(&context, request, &response);
+    TF_VLOG(3) << "Rendezvous wait complete: " << tag;
+    if (!status.ok()) {
+      XLA_ERROR() << "Failed to meet rendezvous '" << tag << "': " << status;
+    }
+    return response;
+  }
+
+  // Periodically sends the ordinal heartbeat to the mesh master, recording the
+  // stale ordinals it reports back. The client is never destroyed, so the
+  // thread runs for the whole life of the process.
+  void StartHeartbeats(int64 ordinal, double interval) {
+    heartbeat_ordinal = ordinal;
+    auto heartbeats = [this, interval]() {
+      std::set<int64> reported;
+      while (true) {
+        std::this_thread::sleep_for(std::chrono::duration<double>(interval));
+        ::grpc::ClientContext context;
+        context.set_deadline(
+            std::chrono::system_clock::now() +
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::duration<double>(interval)));
+        grpc::HeartbeatRequest request;
+        grpc::HeartbeatResponse response;
+        request.set_ordinal(heartbeat_ordinal.load());
+        ::grpc::Status status = stub->Heartbeat(&context, request, &response);
+        if (!status.ok()) {
+          XLA_COUNTER("MeshHeartbeatFailures", 1);
+          TF_VLOG(1) << "Failed to send heartbeat to mesh master: " << status;
+          continue;
+        }
+        std::set<int64> stale(response.stale_ordinals().begin(),
+                              response.stale_ordinals().end());
+        for (auto stale_ordinal : stale) {
+          if (reported.count(stale_ordinal) == 0) {
+            XLA_COUNTER("MeshStaleWorkers", 1);
+            TF_LOG(WARNING) << "Mesh ordinal " << stale_ordinal
+                            << " stopped sending heartbeats";
+          }
+        }
+        reported = stale;
+        std::lock_guard<std::mutex> lock(stale_lock);
+        stale_ordinals = std::move(stale);
+      }
+    };
+    std::thread(std::move(heartbeats)).detach();
+  }
+
   std::shared_ptr<::grpc::Channel> channel;
   std::unique_ptr<grpc::MeshService::Stub> stub;
   std::string address;
+  std::atomic<int64> mesh_size{0};
+  std::atomic<int64> heartbeat_ordinal{-1};
+  std::mutex stale_lock;
+  std::set<int64> stale_ordinals;
 };
 
 MeshClient* MeshClient::Get() {
@@ -250,6 +671,7 @@ MeshClient* MeshClient::Get() {
 }
 
 MeshClient::MeshClient(const std::string& address) : impl_(new Impl(address)) {
+  XLA_TIMED("MeshClientConnect");
   int64 connect_wait_seconds =
       sys_util::GetEnvInt("XRT_MESH_CONNECT_WAIT", 300);
   TF_LOG(INFO) << "Waiting to connect to client mesh master ("
@@ -258,6 +680,13 @@ MeshClient::MeshClient(const std::string& address) : impl_(new Impl(address)) {
       std::chrono::system_clock::now() +
       std::chrono::seconds(connect_wait_seconds)))
       << "Failed to connect to client mesh master: " << address;
+
+  double heartbeat_interval =
+      sys_util::GetEnvDouble("XRT_MESH_HEARTBEAT_INTERVAL", 0.0);
+  int64 ordinal = sys_util::GetEnvInt("XRT_SHARD_ORDINAL", -1);
+  if (heartbeat_interval > 0 && ordinal >= 0) {
+    impl_->StartHeartbeats(ordinal, heartbeat_interval);
+  }
 }
 
 MeshClient::~MeshClient() {}
@@ -265,7 +694,10 @@ MeshClient::~MeshClient() {}
 const std::string& MeshClient::address() const { return impl_->address; }
 
 grpc::Config MeshClient::GetConfig() const {
+  XLA_TIMED("MeshConfigFetch");
   ::grpc::ClientContext context;
+  // The mesh master holds the request until its config is ready.
+  context.set_wait_for_ready(true);
   grpc::GetConfigRequest request;
   grpc::GetConfigResponse response;
   ::grpc::Status status = impl_->stub->GetConfig(&context, request, &response);
@@ -278,26 +710,63 @@ grpc::Config MeshClient::GetConfig() const {
 std::vector<std::string> MeshClient::Rendezvous(
     int ordinal, const std::string& tag, const std::string& payload,
     absl::Span<const int64> replicas) const {
+  size_t chunk_size = impl_->GetChunkSize(this, replicas.size());
+  // The first round carries the total payload sizes, which tell every replica
+  // how many more rounds are needed to complete the exchange.
+  absl::optional<uint64> total_size;
+  if (payload.size() > chunk_size) {
+    total_size = payload.size();
+  }
+  grpc::RendezvousResponse response = impl_->RendezvousRound(
+      ordinal, tag, payload.substr(0, chunk_size), total_size, replicas);
+  std::vector<std::string> rv_payloads;
+  size_t num_rounds = 1;
+  for (int i = 0; i < response.payloads_size(); ++i) {
+    rv_payloads.push_back(std::move(*response.mutable_payloads(i)));
+    uint64 size = i < response.total_sizes_size() ? response.total_sizes(i)
+                                                  : rv_payloads.back().size();
+    num_rounds = std::max<size_t>(num_rounds,
+                                  (size + chunk_size - 1) / chunk_size);
+    rv_payloads.back().reserve(size);
+  }
+  for (size_t round = 1; round < num_rounds; ++round) {
+    size_t offset = std::min(round * chunk_size, payload.size());
+    grpc::RendezvousResponse chunk_response = impl_->RendezvousRound(
+        ordinal, absl::StrCat(tag, ":chunk", round),
+        payload.substr(offset, chunk_size), absl::nullopt, replicas);
+    XLA_CHECK_EQ(chunk_response.payloads_size(), rv_payloads.size());
+    for (size_t i = 0; i < rv_payloads.size(); ++i) {
+      rv_payloads[i].append(chunk_response.payloads(i));
+    }
+  }
+  return rv_payloads;
+}
+
+std::vector<double> MeshClient::MeshReduce(
+    int ordinal, const std::string& tag, absl::Span<const double> values,
+    grpc::MeshReduceType reduce_type, absl::Span<const int64> replicas) const {
   ::grpc::ClientContext context;
-  grpc::RendezvousRequest request;
-  grpc::RendezvousResponse response;
+  grpc::MeshReduceRequest request;
+  grpc::MeshReduceResponse response;
   request.set_tag(tag);
-  request.set_payload(payload);
+  request.mutable_values()->Reserve(values.size());
+  for (auto value : values) {
+    request.add_values(value);
+  }
   request.set_ordinal(ordinal);
+  request.set_reduce_type(reduce_type);
   for (auto& replica : replicas) {
     request.add_replicas(replica);
   }
-  TF_VLOG(3) << "Waiting for rendezvous: ordinal=" << ordinal << " tag=" << tag;
-  ::grpc::Status status = impl_->stub->Rendezvous(&context, request, &response);
-  TF_VLOG(3) << "Rendezvous wait complete: " << tag;
+  TF_VLOG(3) << "Waiting for mesh reduce: ordinal=" << ordinal
+             << " tag=" << tag;
+  ::grpc::Status status = impl_->stub->MeshReduce(&context, request, &response);
+  TF_VLOG(3) << "Mesh reduce wait complete: " << tag;
   if (!status.ok()) {
-    XLA_ERROR() << "Failed to meet rendezvous '" << tag << "': " << status;
-  }
-  std::vector<std::string> rv_payloads;
-  for (auto& rv_payload : response.payloads()) {
-    rv_payloads.push_back(rv_payload);
+    XLA_ERROR() << "Failed to meet mesh reduce '" << tag << "': " << status;
   }
-  return rv_payloads;
+  return std::vector<double>(response.values().begin(),
+                             response.values().end());
 }
 
 std::string MeshClient::GetNcclUniqueUid(
@@ -322,5 +791,41 @@ std::string MeshClient::GetNcclUniqueUid(
   return response.uid();
 }
 
+std::vector<int64> MeshClient::Rejoin(int ordinal, const std::string& tag,
+                                      int64 world_size) const {
+  ::grpc::ClientContext context;
+  grpc::RejoinRequest request;
+  grpc::RejoinResponse response;
+  request.set_tag(tag);
+  request.set_ordinal(ordinal);
+  request.set_world_size(world_size);
+  TF_VLOG(3) << "Waiting for mesh rejoin: ordinal=" << ordinal
+             << " tag=" << tag << " world_size=" << world_size;
+  ::grpc::Status status = impl_->stub->Rejoin(&context, request, &response);
+  TF_VLOG(3) << "Mesh rejoin complete: " << tag;
+  if (!status.ok()) {
+    XLA_ERROR() << "Failed to rejoin the mesh '" << tag << "': " << status;
+  }
+  std::vector<int64> ordinals(response.ordinals().begin(),
+                              response.ordinals().end());
+  auto it = std::find(ordinals.begin(), ordinals.end(), ordinal);
+  XLA_CHECK(it != ordinals.end()) << "Ordinal " << ordinal << " not rejoined";
+  impl_->mesh_size = world_size;
+  if (impl_->heartbeat_ordinal >= 0) {
+    impl_->heartbeat_ordinal = it - ordinals.begin();
+  }
+  {
+    std::lock_guard<std::mutex> lock(impl_->stale_lock);
+    impl_->stale_ordinals.clear();
+  }
+  return ordinals;
+}
+
+std::vector<int64> MeshClient::GetStaleOrdinals() const {
+  std::lock_guard<std::mutex> lock(impl_->stale_lock);
+  return std::vector<int64>(impl_->stale_ordinals.begin(),
+                            impl_->stale_ordinals.end());
+}
+
 }  // namespace service
 }  // namespace xla
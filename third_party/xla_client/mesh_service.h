@@ -18,8 +18,15 @@ class MeshService {
  public:
   MeshService(const std::string& address, grpc::Config config);
 
+  // Starts serving with no config yet. The GetConfig() requests of the clients
+  // wait until SetConfig() publishes it, so that the clients can connect while
+  // the mesh master is still discovering the devices.
+  explicit MeshService(const std::string& address);
+
   ~MeshService();
 
+  void SetConfig(grpc::Config config);
+
  private:
   std::unique_ptr<Impl> impl_;
 };
@@ -34,12 +41,34 @@ class MeshClient {
 
   grpc::Config GetConfig() const;
 
+  // Exchanges the payloads among the replicas. Payloads bigger than the
+  // XRT_MESH_CHUNK_SIZE bytes are exchanged in multiple rounds, so that no
+  // single message has to carry all of them.
   std::vector<std::string> Rendezvous(int ordinal, const std::string& tag,
                                       const std::string& payload,
                                       absl::Span<const int64> replicas) const;
 
+  // Like Rendezvous(), but the values are reduced element-wise by the mesh
+  // master, which sends back only the reduced result instead of the values of
+  // every replica.
+  std::vector<double> MeshReduce(int ordinal, const std::string& tag,
+                                 absl::Span<const double> values,
+                                 grpc::MeshReduceType reduce_type,
+                                 absl::Span<const int64> replicas) const;
+
   std::string GetNcclUniqueUid(absl::Span<const int64> replicas) const;
 
+  // Returns the ordinals the mesh master reported as stale, at the last
+  // heartbeat sent by this client. Heartbeats are sent every
+  // XRT_MESH_HEARTBEAT_INTERVAL seconds, and none are sent if zero.
+  std::vector<int64> GetStaleOrdinals() const;
+
+  // Waits for world_size processes to rejoin the mesh after a membership
+  // change, and resizes the mesh to them. Returns the sorted previous ordinals
+  // of the rejoined processes, whose indices are their new ordinals.
+  std::vector<int64> Rejoin(int ordinal, const std::string& tag,
+                            int64 world_size) const;
+
  private:
   MeshClient(const std::string& address);
 
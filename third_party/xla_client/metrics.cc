@@ -2,10 +2,13 @@
 
 #include <algorithm>
 #include <cmath>
+#include <functional>
 #include <map>
+#include <set>
 #include <sstream>
 
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_split.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
@@ -15,6 +18,30 @@ namespace xla {
 namespace metrics {
 namespace {
 
+const std::set<std::string>* ReadEnvHistograms() {
+  std::string histograms =
+      sys_util::GetEnvString("XLA_METRICS_HISTOGRAMS", "");
+  std::unique_ptr<std::set<std::string>> names =
+      absl::make_unique<std::set<std::string>>();
+  for (auto& name : absl::StrSplit(histograms, ',', absl::SkipEmpty())) {
+    names->emplace(name);
+  }
+  return names.release();
+}
+
+bool IsHistogramMetric(const std::string& name) {
+  static const std::set<std::string>* names = ReadEnvHistograms();
+  return names->count("*") > 0 || names->count(name) > 0;
+}
+
+// The threads are assigned the shards in round robin. Hashing the thread IDs
+// does not spread them, as those are aligned thread control block addresses.
+size_t GetThreadShard(size_t num_shards) {
+  static std::atomic<size_t> next_shard(0);
+  static thread_local size_t shard = next_shard.fetch_add(1);
+  return shard % num_shards;
+}
+
 class MetricsArena {
  public:
   static MetricsArena* Get();
@@ -79,7 +106,10 @@ void MetricsArena::RegisterMetric(const std::string& name, MetricReprFn repr_fn,
   std::lock_guard<std::mutex> lock(lock_);
   if (*data == nullptr) {
     *data = xla::util::MapInsert(&metrics_, name, [&]() {
-      return std::make_shared<MetricData>(std::move(repr_fn), max_samples);
+      return IsHistogramMetric(name)
+                 ? std::make_shared<MetricData>(std::move(repr_fn))
+                 : std::make_shared<MetricData>(std::move(repr_fn),
+                                                max_samples);
     });
   }
 }
@@ -129,8 +159,30 @@ const std::vector<double>& GetPercentiles() {
   return *metrics_percentiles;
 }
 
+void EmitHistogramMetricInfo(const std::string& name, MetricData* data,
+                             std::stringstream* ss) {
+  Histogram::Snapshot snapshot = data->HistogramSnapshot();
+  (*ss) << "Metric: " << name << std::endl;
+  (*ss) << "  TotalSamples: " << snapshot.count << std::endl;
+  (*ss) << "  Accumulator: " << data->Repr(snapshot.sum) << std::endl;
+  const std::vector<double>& metrics_percentiles = GetPercentiles();
+  (*ss) << "  Percentiles: ";
+  for (size_t i = 0; i < metrics_percentiles.size(); ++i) {
+    if (i > 0) {
+      (*ss) << "; ";
+    }
+    (*ss) << (metrics_percentiles[i] * 100.0) << "%="
+          << data->Repr(snapshot.Percentile(metrics_percentiles[i]));
+  }
+  (*ss) << std::endl;
+}
+
 void EmitMetricInfo(const std::string& name, MetricData* data,
                     std::stringstream* ss) {
+  if (data->IsHistogram()) {
+    EmitHistogramMetricInfo(name, data, ss);
+    return;
+  }
   double accumulator = 0.0;
   size_t total_samples = 0;
   std::vector<Sample> samples = data->Samples(&accumulator, &total_samples);
@@ -176,12 +228,178 @@ void EmitCounterInfo(const std::string& name, CounterData* data,
   (*ss) << "  Value: " << data->Value() << std::endl;
 }
 
+class FlightRecorder {
+ public:
+  static FlightRecorder* Get() {
+    static size_t max_events =
+        sys_util::GetEnvInt("XLA_FLIGHT_RECORDER_SIZE", 1024);
+    static FlightRecorder* recorder =
+        max_events > 0 ? new FlightRecorder(max_events) : nullptr;
+    return recorder;
+  }
+
+  void Record(GraphEvent event) {
+    std::lock_guard<std::mutex> lock(lock_);
+    events_[count_ % events_.size()] = std::move(event);
+    ++count_;
+  }
+
+  std::vector<GraphEvent> Events() const {
+    std::lock_guard<std::mutex> lock(lock_);
+    std::vector<GraphEvent> events;
+    if (count_ <= events_.size()) {
+      events.insert(events.end(), events_.begin(), events_.begin() + count_);
+    } else {
+      size_t position = count_ % events_.size();
+      events.insert(events.end(), events_.begin() + position, events_.end());
+      events.insert(events.end(), events_.begin(), events_.begin() + position);
+    }
+    return events;
+  }
+
+ private:
+  explicit FlightRecorder(size_t max_events) : events_(max_events) {}
+
+  mutable std::mutex lock_;
+  size_t count_ = 0;
+  std::vector<GraphEvent> events_;
+};
+
+void EmitTraceEvent(const char* name, const GraphEvent& event, size_t tid,
+                    int64 start_ns, int64 duration_ns, bool* first,
+                    std::stringstream* ss) {
+  if (start_ns == 0) {
+    return;
+  }
+  (*ss) << (*first ? "" : ",\n") << "{\"name\":\"" << name
+        << "\",\"cat\":\"graph\",\"ph\":\"X\",\"pid\":0,\"tid\":" << tid
+        << ",\"ts\":" << start_ns / 1000 << ",\"dur\":" << duration_ns / 1000
+        << ",\"args\":{\"hash\":\"" << event.graph_hash
+        << "\",\"nodes\":" << event.num_nodes
+        << ",\"bytes_in\":" << event.bytes_in
+        << ",\"bytes_out\":" << event.bytes_out << "}}";
+  *first = false;
+}
+
 }  // namespace
 
+constexpr size_t Histogram::kSubBuckets;
+constexpr size_t Histogram::kMaxExponent;
+constexpr size_t Histogram::kNumBuckets;
+constexpr size_t Histogram::kNumShards;
+
+void Histogram::Snapshot::Merge(const Snapshot& other) {
+  for (size_t i = 0; i < kNumBuckets; ++i) {
+    buckets[i] += other.buckets[i];
+  }
+  count += other.count;
+  sum += other.sum;
+}
+
+double Histogram::Snapshot::Percentile(double pct) const {
+  uint64 total = 0;
+  for (auto bucket_count : buckets) {
+    total += bucket_count;
+  }
+  if (total == 0) {
+    return 0.0;
+  }
+  // Same semantic of the sorted samples percentiles, where the index of the
+  // sample is pct * count.
+  uint64 index = std::min<uint64>(static_cast<uint64>(pct * total), total - 1);
+  uint64 cumulative = 0;
+  for (size_t i = 0; i < kNumBuckets; ++i) {
+    cumulative += buckets[i];
+    if (cumulative > index) {
+      return BucketValue(i);
+    }
+  }
+  return BucketValue(kNumBuckets - 1);
+}
+
+Histogram::Histogram() : shards_(new Shard[kNumShards]) {
+  for (size_t i = 0; i < kNumShards; ++i) {
+    for (auto& bucket : shards_[i].buckets) {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+    shards_[i].count.store(0, std::memory_order_relaxed);
+    shards_[i].sum.store(0.0, std::memory_order_relaxed);
+  }
+}
+
+size_t Histogram::BucketIndex(double value) {
+  if (!(value >= 1.0)) {
+    // Values below one, negative ones and NaNs, all go into the first bucket.
+    return 0;
+  }
+  int exponent = 0;
+  double mantissa = std::frexp(value, &exponent);
+  // The value is within [2^(exponent - 1), 2^exponent), and the mantissa within
+  // [0.5, 1).
+  size_t power = static_cast<size_t>(exponent - 1);
+  if (power >= kMaxExponent) {
+    return kNumBuckets - 1;
+  }
+  size_t sub_bucket = std::min<size_t>(
+      static_cast<size_t>((2.0 * mantissa - 1.0) * kSubBuckets),
+      kSubBuckets - 1);
+  return 1 + power * kSubBuckets + sub_bucket;
+}
+
+double Histogram::BucketValue(size_t index) {
+  if (index == 0) {
+    return 0.0;
+  }
+  size_t power = (index - 1) / kSubBuckets;
+  size_t sub_bucket = (index - 1) % kSubBuckets;
+  double base = std::ldexp(1.0, static_cast<int>(power));
+  return base * (1.0 + (sub_bucket + 0.5) / kSubBuckets);
+}
+
+void Histogram::Add(double value) {
+  Shard& shard = shards_[GetThreadShard(kNumShards)];
+  shard.buckets[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  shard.count.fetch_add(1, std::memory_order_relaxed);
+  double sum = shard.sum.load(std::memory_order_relaxed);
+  while (!shard.sum.compare_exchange_weak(sum, sum + value,
+                                          std::memory_order_relaxed)) {
+  }
+}
+
+Histogram::Snapshot Histogram::GetSnapshot() const {
+  Snapshot snapshot;
+  for (size_t i = 0; i < kNumShards; ++i) {
+    const Shard& shard = shards_[i];
+    for (size_t j = 0; j < kNumBuckets; ++j) {
+      snapshot.buckets[j] += shard.buckets[j].load(std::memory_order_relaxed);
+    }
+    snapshot.count += shard.count.load(std::memory_order_relaxed);
+    snapshot.sum += shard.sum.load(std::memory_order_relaxed);
+  }
+  return snapshot;
+}
+
+void Histogram::GetTotals(uint64* count, double* sum) const {
+  *count = 0;
+  *sum = 0.0;
+  for (size_t i = 0; i < kNumShards; ++i) {
+    *count += shards_[i].count.load(std::memory_order_relaxed);
+    *sum += shards_[i].sum.load(std::memory_order_relaxed);
+  }
+}
+
 MetricData::MetricData(MetricReprFn repr_fn, size_t max_samples)
     : repr_fn_(std::move(repr_fn)), samples_(max_samples) {}
 
+MetricData::MetricData(MetricReprFn repr_fn)
+    : histogram_(absl::make_unique<Histogram>()),
+      repr_fn_(std::move(repr_fn)) {}
+
 void MetricData::AddSample(int64 timestamp_ns, double value) {
+  if (histogram_ != nullptr) {
+    histogram_->Add(value);
+    return;
+  }
   std::lock_guard<std::mutex> lock(lock_);
   size_t position = count_ % samples_.size();
   ++count_;
@@ -190,17 +408,50 @@ void MetricData::AddSample(int64 timestamp_ns, double value) {
 }
 
 double MetricData::Accumulator() const {
+  if (histogram_ != nullptr) {
+    return histogram_->GetSnapshot().sum;
+  }
   std::lock_guard<std::mutex> lock(lock_);
   return accumulator_;
 }
 
 size_t MetricData::TotalSamples() const {
+  if (histogram_ != nullptr) {
+    return histogram_->GetSnapshot().count;
+  }
   std::lock_guard<std::mutex> lock(lock_);
   return count_;
 }
 
+void MetricData::GetTotals(size_t* total_samples, double* accumulator) const {
+  if (histogram_ != nullptr) {
+    uint64 count = 0;
+    histogram_->GetTotals(&count, accumulator);
+    *total_samples = count;
+    return;
+  }
+  std::lock_guard<std::mutex> lock(lock_);
+  *total_samples = count_;
+  *accumulator = accumulator_;
+}
+
+Histogram::Snapshot MetricData::HistogramSnapshot() const {
+  XLA_CHECK(histogram_ != nullptr);
+  return histogram_->GetSnapshot();
+}
+
 std::vector<Sample> MetricData::Samples(double* accumulator,
                                         size_t* total_samples) const {
+  if (histogram_ != nullptr) {
+    Histogram::Snapshot snapshot = histogram_->GetSnapshot();
+    if (accumulator != nullptr) {
+      *accumulator = snapshot.sum;
+    }
+    if (total_samples != nullptr) {
+      *total_samples = snapshot.count;
+    }
+    return {};
+  }
   std::lock_guard<std::mutex> lock(lock_);
   std::vector<Sample> samples;
   if (count_ <= samples_.size()) {
@@ -258,6 +509,27 @@ MetricData* Metric::GetData() const {
   return data;
 }
 
+constexpr size_t CounterData::kNumShards;
+
+CounterData::CounterData() : shards_(new Shard[kNumShards]) {
+  for (size_t i = 0; i < kNumShards; ++i) {
+    shards_[i].value.store(0, std::memory_order_relaxed);
+  }
+}
+
+void CounterData::AddValue(xla::int64 value) {
+  shards_[GetThreadShard(kNumShards)].value.fetch_add(
+      value, std::memory_order_relaxed);
+}
+
+xla::int64 CounterData::Value() const {
+  xla::int64 value = 0;
+  for (size_t i = 0; i < kNumShards; ++i) {
+    value += shards_[i].value.load(std::memory_order_relaxed);
+  }
+  return value;
+}
+
 Counter::Counter(std::string name) : name_(std::move(name)), data_(nullptr) {}
 
 CounterData* Counter::GetData() const {
@@ -337,6 +609,116 @@ std::string CreateMetricReport() {
   return ss.str();
 }
 
+MetricsSnapshot CreateMetricsSnapshot() {
+  MetricsSnapshot snapshot;
+  MetricsArena* arena = MetricsArena::Get();
+  arena->ForEachMetric([&](const std::string& name, MetricData* data) {
+    MetricsSnapshot::MetricTotals& totals = snapshot.metrics[name];
+    data->GetTotals(&totals.total_samples, &totals.accumulator);
+  });
+  arena->ForEachCounter([&](const std::string& name, CounterData* data) {
+    snapshot.counters.emplace(name, data->Value());
+  });
+  return snapshot;
+}
+
+MetricsSnapshot DiffMetricsSnapshots(const MetricsSnapshot& before,
+                                     const MetricsSnapshot& after) {
+  MetricsSnapshot delta;
+  for (auto& name_value : after.counters) {
+    int64 value = name_value.second -
+                  util::FindOr(before.counters, name_value.first, 0);
+    if (value != 0) {
+      delta.counters.emplace(name_value.first, value);
+    }
+  }
+  for (auto& name_totals : after.metrics) {
+    MetricsSnapshot::MetricTotals totals = name_totals.second;
+    auto it = before.metrics.find(name_totals.first);
+    if (it != before.metrics.end()) {
+      totals.total_samples -= it->second.total_samples;
+      totals.accumulator -= it->second.accumulator;
+    }
+    if (totals.total_samples != 0) {
+      delta.metrics.emplace(name_totals.first, totals);
+    }
+  }
+  return delta;
+}
+
+bool IsFlightRecorderEnabled() { return FlightRecorder::Get() != nullptr; }
+
+void RecordGraphEvent(GraphEvent event) {
+  FlightRecorder* recorder = FlightRecorder::Get();
+  if (recorder != nullptr) {
+    recorder->Record(std::move(event));
+  }
+}
+
+void RecordTransferEvent(const std::string& device, const char* transfer,
+                         int64 start_ns, int64 bytes) {
+  FlightRecorder* recorder = FlightRecorder::Get();
+  if (recorder != nullptr) {
+    GraphEvent event;
+    event.device = device;
+    event.transfer = transfer;
+    event.transfer_start_ns = start_ns;
+    event.transfer_ns = sys_util::NowNs() - start_ns;
+    if (event.transfer == "H2D") {
+      event.bytes_in = bytes;
+    } else {
+      event.bytes_out = bytes;
+    }
+    recorder->Record(std::move(event));
+  }
+}
+
+std::vector<GraphEvent> GetGraphEvents() {
+  FlightRecorder* recorder = FlightRecorder::Get();
+  return recorder != nullptr ? recorder->Events() : std::vector<GraphEvent>();
+}
+
+std::string CreateTimelineTrace() {
+  std::vector<GraphEvent> events = GetGraphEvents();
+  // Every device gets its own track within the trace, plus one for each
+  // transfer direction.
+  auto track_name = [](const GraphEvent& event) {
+    return event.transfer.empty() ? event.device
+                                  : absl::StrCat(event.device, " ",
+                                                 event.transfer);
+  };
+  std::map<std::string, size_t> device_tids;
+  for (auto& event : events) {
+    device_tids.emplace(track_name(event), device_tids.size());
+  }
+  std::stringstream ss;
+  bool first = true;
+  ss << "{\"traceEvents\":[\n";
+  for (auto& device_tid : device_tids) {
+    ss << (first ? "" : ",\n")
+       << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":"
+       << device_tid.second << ",\"args\":{\"name\":\"" << device_tid.first
+       << "\"}}";
+    first = false;
+  }
+  for (auto& event : events) {
+    size_t tid = device_tids.at(track_name(event));
+    if (!event.transfer.empty()) {
+      EmitTraceEvent(event.transfer.c_str(), event, tid,
+                     event.transfer_start_ns, event.transfer_ns, &first, &ss);
+      continue;
+    }
+    EmitTraceEvent("LockWait", event, tid, event.lock_start_ns,
+                   event.lock_wait_ns, &first, &ss);
+    EmitTraceEvent("Compile", event, tid, event.compile_start_ns,
+                   event.compile_ns, &first, &ss);
+    EmitTraceEvent("Execute", event, tid, event.execute_start_ns,
+                   event.execute_ns, &first, &ss);
+  }
+  ss << "\n]}\n";
+  return ss.str();
+}
+
 std::vector<std::string> GetMetricNames() {
   return MetricsArena::Get()->GetMetricNames();
 }
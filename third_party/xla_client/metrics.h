@@ -2,6 +2,7 @@
 #define XLA_CLIENT_METRICS_H_
 
 #include <atomic>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -25,8 +26,66 @@ struct Sample {
 
 using MetricReprFn = std::function<std::string(double)>;
 
+// Log-bucketed (HDR style) histogram of non negative values. Every power of two
+// range is split into kSubBuckets linear buckets, so the values are tracked
+// with a relative error below 1/kSubBuckets. Recording a value is lock free,
+// with the counts sharded across a few cache line distant copies, selected by
+// the recording thread, to limit the contention on the hot metrics.
+class Histogram {
+ public:
+  static constexpr size_t kSubBuckets = 16;
+  static constexpr size_t kMaxExponent = 48;
+  static constexpr size_t kNumBuckets = 1 + kMaxExponent * kSubBuckets;
+
+  // A point in time copy of the histogram counts. Snapshots of different
+  // histograms can be merged together.
+  struct Snapshot {
+    Snapshot() : buckets(kNumBuckets, 0) {}
+
+    void Merge(const Snapshot& other);
+
+    // Returns the value at the given percentile (in the [0, 1] range), which is
+    // the value of the bucket containing it.
+    double Percentile(double pct) const;
+
+    std::vector<uint64> buckets;
+    uint64 count = 0;
+    double sum = 0.0;
+  };
+
+  Histogram();
+
+  void Add(double value);
+
+  Snapshot GetSnapshot() const;
+
+  // Returns the count and sum of the recorded values, without collecting the
+  // bucket counts.
+  void GetTotals(uint64* count, double* sum) const;
+
+  static size_t BucketIndex(double value);
+
+  // Returns the representative (mid range) value of the bucket.
+  static double BucketValue(size_t index);
+
+ private:
+  static constexpr size_t kNumShards = 8;
+
+  struct alignas(64) Shard {
+    std::atomic<uint64> buckets[kNumBuckets];
+    std::atomic<uint64> count;
+    std::atomic<double> sum;
+  };
+
+  std::unique_ptr<Shard[]> shards_;
+};
+
 // Class used to collect time-stamped numeric samples. The samples are stored in
 // a circular buffer whose size can be configured at constructor time.
+// Metrics whose names are listed in the XLA_METRICS_HISTOGRAMS environment
+// variable (or all of them, if it is set to "*") record their samples into a
+// lock free Histogram instead, which only keeps the distribution of the
+// values, and not their timestamps.
 class MetricData {
  public:
   // Creates a new MetricData object with the internal circular buffer storing
@@ -34,22 +93,37 @@ class MetricData {
   // pretty-prints a sample value.
   MetricData(MetricReprFn repr_fn, size_t max_samples);
 
+  // Creates a new MetricData object recording the samples into a histogram.
+  explicit MetricData(MetricReprFn repr_fn);
+
+  bool IsHistogram() const { return histogram_ != nullptr; }
+
   // Returns the total values of all the samples being posted to this metric.
   double Accumulator() const;
 
   size_t TotalSamples() const;
 
+  // Returns both TotalSamples() and Accumulator(), consistently with each
+  // other.
+  void GetTotals(size_t* total_samples, double* accumulator) const;
+
   void AddSample(int64 timestamp_ns, double value);
 
   // Returns a vector with all the current samples, from the oldest to the
   // newer. If accumulator is not nullptr, it will receive the current value of
   // the metrics' accumulator (the sum of all posted values). If total_samples
   // is not nullptr, it will receive the count of the posted values.
+  // Histogram metrics return no samples.
   std::vector<Sample> Samples(double* accumulator, size_t* total_samples) const;
 
+  // Returns the snapshot of the histogram metrics. Must only be called if
+  // IsHistogram() is true.
+  Histogram::Snapshot HistogramSnapshot() const;
+
   std::string Repr(double value) const { return repr_fn_(value); }
 
  private:
+  std::unique_ptr<Histogram> histogram_;
   mutable std::mutex lock_;
   MetricReprFn repr_fn_;
   size_t count_ = 0;
@@ -59,16 +133,25 @@ class MetricData {
 
 // Counters are a very lightweight form of metrics which do not need to track
 // sample time.
+// Like the histograms, the value is sharded across a few cache line distant
+// copies selected by the recording thread, so that the threads tracing graphs
+// concurrently do not contend on the hot counters.
 class CounterData {
  public:
-  CounterData() : value_(0) {}
+  CounterData();
 
-  void AddValue(xla::int64 value) { value_ += value; }
+  void AddValue(xla::int64 value);
 
-  xla::int64 Value() const { return value_; }
+  xla::int64 Value() const;
 
  private:
-  std::atomic<xla::int64> value_;
+  static constexpr size_t kNumShards = 8;
+
+  struct alignas(64) Shard {
+    std::atomic<xla::int64> value;
+  };
+
+  std::unique_ptr<Shard[]> shards_;
 };
 
 // Emits the value in a to_string() conversion.
@@ -174,6 +257,70 @@ std::vector<std::string> GetCounterNames();
 // does not exist.
 CounterData* GetCounter(const std::string& name);
 
+// A point in time copy of the counter values, and of the sample counts and
+// accumulators of the metrics, which costs a few atomic loads per metric, and
+// no copy of the samples. Used to monitor the metrics at every step, where
+// CreateMetricReport() would be too expensive.
+struct MetricsSnapshot {
+  struct MetricTotals {
+    size_t total_samples = 0;
+    double accumulator = 0.0;
+  };
+
+  std::map<std::string, int64> counters;
+  std::map<std::string, MetricTotals> metrics;
+};
+
+MetricsSnapshot CreateMetricsSnapshot();
+
+// Returns the changes from the before to the after snapshots, as a snapshot
+// with the differences of the counters and metrics which changed. Counters and
+// metrics which got registered in between start from zero.
+MetricsSnapshot DiffMetricsSnapshots(const MetricsSnapshot& before,
+                                     const MetricsSnapshot& after);
+
+// The record of a graph execution, as captured by the flight recorder. Times
+// are expressed in nanoseconds EPOCH time, and phases which did not happen
+// (like the compilation, on cache hits) are left with zero duration.
+struct GraphEvent {
+  std::string graph_hash;
+  std::string device;
+  int64 num_nodes = 0;
+  int64 lock_start_ns = 0;
+  int64 lock_wait_ns = 0;
+  int64 compile_start_ns = 0;
+  int64 compile_ns = 0;
+  int64 execute_start_ns = 0;
+  int64 execute_ns = 0;
+  int64 bytes_in = 0;
+  int64 bytes_out = 0;
+  // Set to "H2D" or "D2H" for the events recording a host to device or device
+  // to host transfer, which have no graph and only the transfer phase.
+  std::string transfer;
+  int64 transfer_start_ns = 0;
+  int64 transfer_ns = 0;
+};
+
+// Whether the flight recorder is enabled. The flight recorder keeps the last
+// XLA_FLIGHT_RECORDER_SIZE graph events in a circular buffer (a size of zero
+// disables it).
+bool IsFlightRecorderEnabled();
+
+void RecordGraphEvent(GraphEvent event);
+
+// Records a transfer event for the device, whose timeline gets separate
+// tracks for the transfers in each direction, so that their overlap with the
+// executions is visible.
+void RecordTransferEvent(const std::string& device, const char* transfer,
+                         int64 start_ns, int64 bytes);
+
+// Returns the recorded graph events, from the oldest to the newer.
+std::vector<GraphEvent> GetGraphEvents();
+
+// Exports the recorded graph events in the Chrome trace event (JSON) format,
+// which can be loaded by chrome://tracing or Perfetto.
+std::string CreateTimelineTrace();
+
 // Scope based utility class to measure the time the code takes within a given
 // C++ scope.
 class TimedSection {
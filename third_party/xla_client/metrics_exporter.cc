@@ -0,0 +1,190 @@
+#include "tensorflow/compiler/xla/xla_client/metrics_exporter.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <thread>
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/tf_logging.h"
+
+namespace xla {
+namespace metrics_exporter {
+namespace {
+
+static const char* const kContentType =
+    "application/openmetrics-text; version=1.0.0; charset=utf-8";
+static const double kQuantiles[] = {0.5, 0.9, 0.99};
+
+std::string SanitizeName(const std::string& name) {
+  std::string sanitized = "xla_";
+  for (char c : name) {
+    bool valid = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                 (c >= '0' && c <= '9') || c == '_';
+    sanitized.push_back(valid ? c : '_');
+  }
+  return sanitized;
+}
+
+void EmitCounter(const std::string& name, metrics::CounterData* data,
+                 std::stringstream* ss) {
+  std::string exported_name = SanitizeName(name);
+  (*ss) << "# TYPE " << exported_name << " counter\n";
+  (*ss) << exported_name << "_total " << data->Value() << "\n";
+}
+
+void EmitMetric(const std::string& name, metrics::MetricData* data,
+                std::stringstream* ss) {
+  std::string exported_name = SanitizeName(name);
+  (*ss) << "# TYPE " << exported_name << " summary\n";
+  if (data->IsHistogram()) {
+    metrics::Histogram::Snapshot snapshot = data->HistogramSnapshot();
+    for (double quantile : kQuantiles) {
+      (*ss) << exported_name << "{quantile=\"" << quantile << "\"} "
+            << snapshot.Percentile(quantile) << "\n";
+    }
+    (*ss) << exported_name << "_count " << snapshot.count << "\n";
+    (*ss) << exported_name << "_sum " << snapshot.sum << "\n";
+  } else {
+    (*ss) << exported_name << "_count " << data->TotalSamples() << "\n";
+    (*ss) << exported_name << "_sum " << data->Accumulator() << "\n";
+  }
+}
+
+bool SendAll(int fd, const std::string& data) {
+  size_t offset = 0;
+  while (offset < data.size()) {
+    ssize_t sent =
+        ::send(fd, data.data() + offset, data.size() - offset, MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR) {
+      continue;
+    }
+    if (sent <= 0) {
+      return false;
+    }
+    offset += sent;
+  }
+  return true;
+}
+
+// Reads the request line, which is all we need to route the request. The
+// headers are drained by closing the connection after the response.
+std::string ReadRequestLine(int fd) {
+  std::string request;
+  char buffer[1024];
+  while (request.find("\r\n") == std::string::npos && request.size() < 8192) {
+    ssize_t count = ::recv(fd, buffer, sizeof(buffer), 0);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      break;
+    }
+    request.append(buffer, count);
+  }
+  return request.substr(0, request.find("\r\n"));
+}
+
+void HandleConnection(int fd) {
+  // Do not let a stuck client block the (single threaded) server forever.
+  struct timeval timeout = {5, 0};
+  ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  std::string request_line = ReadRequestLine(fd);
+  std::string status = "200 OK";
+  std::string content_type = kContentType;
+  std::string body;
+  if (request_line.compare(0, 13, "GET /metrics ") == 0) {
+    body = CreateOpenMetricsReport();
+  } else {
+    status = "404 Not Found";
+    content_type = "text/plain";
+    body = "Not Found\n";
+  }
+  SendAll(fd, absl::StrCat("HTTP/1.1 ", status, "\r\nContent-Type: ",
+                           content_type, "\r\nContent-Length: ", body.size(),
+                           "\r\nConnection: close\r\n\r\n", body));
+}
+
+void ServeMetrics(int listen_fd) {
+  while (true) {
+    int fd = ::accept(listen_fd, nullptr, nullptr);
+    if (fd < 0) {
+      if (errno != EINTR) {
+        TF_LOG(WARNING) << "Metrics exporter accept() failed: "
+                        << std::strerror(errno);
+      }
+      continue;
+    }
+    HandleConnection(fd);
+    ::close(fd);
+  }
+}
+
+void StartExporter(const std::string& address, int port) {
+  int listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  XLA_CHECK_GE(listen_fd, 0) << "Unable to create the metrics exporter socket: "
+                             << std::strerror(errno);
+  int reuse = 1;
+  ::setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  struct sockaddr_in addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  XLA_CHECK_EQ(::inet_pton(AF_INET, address.c_str(), &addr.sin_addr), 1)
+      << "Invalid metrics exporter address: " << address;
+  XLA_CHECK_EQ(::bind(listen_fd, reinterpret_cast<struct sockaddr*>(&addr),
+                      sizeof(addr)),
+               0)
+      << "Unable to bind the metrics exporter to " << address << ":" << port
+      << ": " << std::strerror(errno);
+  XLA_CHECK_EQ(::listen(listen_fd, 16), 0) << std::strerror(errno);
+  TF_VLOG(1) << "Serving OpenMetrics on http://" << address << ":" << port
+             << "/metrics";
+  std::thread(ServeMetrics, listen_fd).detach();
+}
+
+}  // namespace
+
+std::string CreateOpenMetricsReport() {
+  std::stringstream ss;
+  for (auto& name : metrics::GetCounterNames()) {
+    metrics::CounterData* data = metrics::GetCounter(name);
+    if (data != nullptr) {
+      EmitCounter(name, data, &ss);
+    }
+  }
+  for (auto& name : metrics::GetMetricNames()) {
+    metrics::MetricData* data = metrics::GetMetric(name);
+    if (data != nullptr) {
+      EmitMetric(name, data, &ss);
+    }
+  }
+  ss << "# EOF\n";
+  return ss.str();
+}
+
+void MaybeStartExporter() {
+  static bool started = []() {
+    int port = sys_util::GetEnvInt("XLA_METRICS_EXPORTER_PORT", 0);
+    if (port == 0) {
+      return false;
+    }
+    StartExporter(
+        sys_util::GetEnvString("XLA_METRICS_EXPORTER_ADDR", "127.0.0.1"),
+        port);
+    return true;
+  }();
+  (void)started;
+}
+
+}  // namespace metrics_exporter
+}  // namespace xla
@@ -0,0 +1,25 @@
+#ifndef XLA_CLIENT_METRICS_EXPORTER_H_
+#define XLA_CLIENT_METRICS_EXPORTER_H_
+
+#include <string>
+
+namespace xla {
+namespace metrics_exporter {
+
+// Creates an OpenMetrics (Prometheus text format) report of the registered
+// counters and metrics. Counters are exported as xla_<name>_total, and metrics
+// as summaries with their sample count and sum (the quantiles are exported
+// only for the histogram backed metrics, as the others would need a sort of
+// their sample buffers). Names are sanitized to the [a-zA-Z0-9_] charset.
+std::string CreateOpenMetricsReport();
+
+// Starts, once per process, a background thread serving the OpenMetrics report
+// over HTTP (on GET /metrics), if XLA_METRICS_EXPORTER_PORT is set to a non
+// zero port. The server binds to XLA_METRICS_EXPORTER_ADDR (default
+// 127.0.0.1).
+void MaybeStartExporter();
+
+}  // namespace metrics_exporter
+}  // namespace xla
+
+#endif  // XLA_CLIENT_METRICS_EXPORTER_H_
@@ -18,6 +18,14 @@ void MultiWait::Done() {
   }
 }
 
+void MultiWait::Done(std::exception_ptr exptr) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    exptr_ = std::move(exptr);
+  }
+  Done();
+}
+
 void MultiWait::Wait() {
   std::unique_lock<std::mutex> lock(mutex_);
   cv_.wait(lock, [this] { return completed_count_ >= count_; });
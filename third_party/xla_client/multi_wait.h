@@ -2,6 +2,7 @@
 #define XLA_CLIENT_MULTI_WAIT_H_
 
 #include <condition_variable>
+#include <exception>
 #include <functional>
 #include <mutex>
 
@@ -18,6 +19,10 @@ class MultiWait {
   // Signal the completion of a single task.
   void Done();
 
+  // Signal the completion of a single task, which failed with exptr. The
+  // exception is re-thrown by the Wait() APIs.
+  void Done(std::exception_ptr exptr);
+
   // Waits until at least count (passed as constructor value) completions
   // happened.
   void Wait();
@@ -1,34 +1,372 @@
 #include "tensorflow/compiler/xla/xla_client/record_reader.h"
 
+#include <algorithm>
+#include <cstring>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/multi_wait.h"
+#include "tensorflow/compiler/xla/xla_client/thread_pool.h"
+#include "tensorflow/core/lib/core/coding.h"
 #include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/hash/crc32c.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/env.h"
 
 namespace xla {
 namespace util {
+namespace {
+
+constexpr char kIndexMagic[8] = {'T', 'F', 'R', 'I', 'D', 'X', '0', '1'};
+// The TFRecord framing: the uint64 length of the data and the uint32 masked
+// CRC of the length, followed by the data and by the uint32 masked CRC of it.
+constexpr size_t kRecordHeaderSize = sizeof(uint64) + sizeof(uint32);
+constexpr size_t kRecordFooterSize = sizeof(uint32);
 
-RecordReader::RecordReader(std::string path, const string& compression,
-                           int64 buffer_size)
-    : path_(std::move(path)) {
+uint64 GetFileSize(const std::string& path) {
+  uint64 file_size = 0;
+  XLA_CHECK_OK(tensorflow::Env::Default()->GetFileSize(path, &file_size))
+      << path;
+  return file_size;
+}
+
+// The sidecar index holds the magic, the size of the shard it was built from
+// (to detect stale indexes), the number of records and their offsets.
+bool LoadIndex(const std::string& index_path, uint64 file_size,
+               std::vector<uint64>* offsets) {
   tensorflow::Env* env = tensorflow::Env::Default();
-  XLA_CHECK_OK(env->NewRandomAccessFile(path_, &file_));
+  if (!env->FileExists(index_path).ok()) {
+    return false;
+  }
+  std::string data;
+  XLA_CHECK_OK(tensorflow::ReadFileToString(env, index_path, &data));
+  size_t header_size = sizeof(kIndexMagic) + 2 * sizeof(uint64);
+  if (data.size() < header_size ||
+      std::memcmp(data.data(), kIndexMagic, sizeof(kIndexMagic)) != 0 ||
+      tensorflow::core::DecodeFixed64(data.data() + sizeof(kIndexMagic)) !=
+          file_size) {
+    return false;
+  }
+  uint64 num_records = tensorflow::core::DecodeFixed64(
+      data.data() + sizeof(kIndexMagic) + sizeof(uint64));
+  if (data.size() != header_size + num_records * sizeof(uint64)) {
+    return false;
+  }
+  offsets->resize(num_records);
+  for (uint64 i = 0; i < num_records; ++i) {
+    (*offsets)[i] = tensorflow::core::DecodeFixed64(
+        data.data() + header_size + i * sizeof(uint64));
+  }
+  return true;
+}
+
+void SaveIndex(const std::string& index_path, uint64 file_size,
+               const std::vector<uint64>& offsets) {
+  std::string data(kIndexMagic, sizeof(kIndexMagic));
+  tensorflow::core::PutFixed64(&data, file_size);
+  tensorflow::core::PutFixed64(&data, offsets.size());
+  for (auto offset : offsets) {
+    tensorflow::core::PutFixed64(&data, offset);
+  }
+  XLA_CHECK_OK(tensorflow::WriteStringToFile(tensorflow::Env::Default(),
+                                             index_path, data));
+}
+
+}  // namespace
+
+struct RecordReader::Shard {
+  std::string path;
+  uint64 offset = 0;
+  std::unique_ptr<tensorflow::RandomAccessFile> file;
+  std::unique_ptr<tensorflow::io::RecordReader> reader;
+
+  bool Read(Data* value) {
+    xla::Status status = reader->ReadRecord(&offset, value);
+    if (tensorflow::errors::IsOutOfRange(status)) {
+      return false;
+    }
+    XLA_CHECK_OK(status) << path << " offset " << offset;
+    return true;
+  }
+};
+
+RecordReader::RecordReader(std::string path,
+                           const std::string& compression, int64 buffer_size)
+    : RecordReader(std::vector<std::string>({std::move(path)}), compression,
+                   buffer_size, Options()) {}
+
+RecordReader::RecordReader(std::vector<std::string> paths,
+                           const std::string& compression, int64 buffer_size,
+                           const Options& options)
+    : paths_(std::move(paths)),
+      path_(absl::StrJoin(paths_, ",")),
+      compression_(compression),
+      buffer_size_(buffer_size),
+      options_(options),
+      generator_(options.seed) {
+  size_t num_readers =
+      std::min<size_t>(std::max<int64>(options_.num_readers, 0), paths_.size());
+  active_readers_ = num_readers;
+  for (size_t i = 0; i < num_readers; ++i) {
+    readers_.emplace_back([this]() { RunReader(); });
+  }
+}
+
+RecordReader::~RecordReader() {
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    stopped_ = true;
+  }
+  cv_.notify_all();
+  for (auto& reader : readers_) {
+    reader.join();
+  }
+}
+
+std::unique_ptr<RecordReader::Shard> RecordReader::OpenShard(
+    size_t index) const {
+  std::unique_ptr<Shard> shard(new Shard());
+  shard->path = paths_[index];
+  XLA_CHECK_OK(tensorflow::Env::Default()->NewRandomAccessFile(shard->path,
+                                                               &shard->file));
   tensorflow::io::RecordReaderOptions options =
       tensorflow::io::RecordReaderOptions::CreateRecordReaderOptions(
-          compression);
-  options.buffer_size = buffer_size;
-  reader_.reset(new tensorflow::io::RecordReader(file_.get(), options));
+          compression_);
+  options.buffer_size = buffer_size_;
+  shard->reader.reset(
+      new tensorflow::io::RecordReader(shard->file.get(), options));
+  return shard;
 }
 
 bool RecordReader::Read(Data* value) {
-  std::lock_guard<std::mutex> slock(lock_);
-  xla::Status status = reader_->ReadRecord(&offset_, value);
-  if (tensorflow::errors::IsOutOfRange(status)) {
+  std::lock_guard<std::mutex> slock(read_lock_);
+  return ReadShuffled(value);
+}
+
+std::vector<RecordReader::Data> RecordReader::Read(size_t max_records) {
+  std::lock_guard<std::mutex> slock(read_lock_);
+  std::vector<Data> records;
+  records.reserve(max_records);
+  Data value;
+  while (records.size() < max_records && ReadShuffled(&value)) {
+    records.push_back(std::move(value));
+  }
+  return records;
+}
+
+bool RecordReader::ReadShuffled(Data* value) {
+  if (options_.shuffle_size < 2) {
+    return ReadRecord(value);
+  }
+  size_t shuffle_size = options_.shuffle_size;
+  while (shuffle_buffer_.size() < shuffle_size) {
+    Data record;
+    if (!ReadRecord(&record)) {
+      break;
+    }
+    shuffle_buffer_.push_back(std::move(record));
+  }
+  if (shuffle_buffer_.empty()) {
     return false;
   }
-  XLA_CHECK_OK(status) << path_ << " offset " << offset_;
+  size_t index = generator_() % shuffle_buffer_.size();
+  std::swap(shuffle_buffer_[index], shuffle_buffer_.back());
+  *value = std::move(shuffle_buffer_.back());
+  shuffle_buffer_.pop_back();
   return true;
 }
 
+bool RecordReader::ReadRecord(Data* value) {
+  return readers_.empty() ? ReadInline(value) : Dequeue(value);
+}
+
+bool RecordReader::ReadInline(Data* value) {
+  while (true) {
+    if (inline_shard_ == nullptr) {
+      if (next_shard_ >= paths_.size()) {
+        return false;
+      }
+      inline_shard_ = OpenShard(next_shard_);
+    }
+    if (inline_shard_->Read(value)) {
+      return true;
+    }
+    inline_shard_.reset();
+    ++next_shard_;
+  }
+}
+
+bool RecordReader::Dequeue(Data* value) {
+  std::unique_lock<std::mutex> lock(lock_);
+  cv_.wait(lock, [this] {
+    return !queue_.empty() || active_readers_ == 0 || exptr_ != nullptr;
+  });
+  if (exptr_ != nullptr) {
+    std::rethrow_exception(exptr_);
+  }
+  if (queue_.empty()) {
+    return false;
+  }
+  *value = std::move(queue_.front());
+  queue_.pop_front();
+  cv_.notify_all();
+  return true;
+}
+
+void RecordReader::RunReader() {
+  size_t prefetch_size = std::max<int64>(options_.prefetch_size, 1);
+  try {
+    while (true) {
+      size_t index;
+      {
+        std::lock_guard<std::mutex> lock(lock_);
+        if (stopped_ || next_shard_ >= paths_.size()) {
+          break;
+        }
+        index = next_shard_++;
+      }
+      std::unique_ptr<Shard> shard = OpenShard(index);
+      Data value;
+      while (shard->Read(&value)) {
+        std::unique_lock<std::mutex> lock(lock_);
+        cv_.wait(lock, [&] {
+          return queue_.size() < prefetch_size || stopped_;
+        });
+        if (stopped_) {
+          return;
+        }
+        queue_.push_back(std::move(value));
+        cv_.notify_all();
+      }
+    }
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(lock_);
+    exptr_ = std::current_exception();
+  }
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    --active_readers_;
+  }
+  cv_.notify_all();
+}
+
+struct IndexedRecordReader::Shard {
+  std::string path;
+  std::vector<uint64> offsets;
+  std::unique_ptr<tensorflow::RandomAccessFile> file;
+};
+
+IndexedRecordReader::IndexedRecordReader(std::vector<std::string> paths,
+                                         int64 num_threads)
+    : num_threads_(std::max<int64>(num_threads, 1)) {
+  shard_starts_.push_back(0);
+  for (auto& path : paths) {
+    std::unique_ptr<Shard> shard(new Shard());
+    shard->path = std::move(path);
+    uint64 file_size = GetFileSize(shard->path);
+    std::string index_path = IndexPath(shard->path);
+    if (!LoadIndex(index_path, file_size, &shard->offsets)) {
+      XLA_COUNTER("RecordIndexBuilds", 1);
+      shard->offsets = BuildIndex(shard->path);
+      SaveIndex(index_path, file_size, shard->offsets);
+    }
+    XLA_CHECK_OK(tensorflow::Env::Default()->NewRandomAccessFile(
+        shard->path, &shard->file));
+    shard_starts_.push_back(shard_starts_.back() + shard->offsets.size());
+    shards_.push_back(std::move(shard));
+  }
+}
+
+IndexedRecordReader::~IndexedRecordReader() {}
+
+std::vector<IndexedRecordReader::Data> IndexedRecordReader::ReadAt(
+    absl::Span<const int64> indices) const {
+  std::vector<Data> records(indices.size());
+  size_t num_tasks = std::min<size_t>(num_threads_, indices.size());
+  if (num_tasks <= 1) {
+    for (size_t i = 0; i < indices.size(); ++i) {
+      records[i] = ReadRecord(indices[i]);
+    }
+    return records;
+  }
+  // Every task reads a contiguous range of the requested records, and the
+  // tasks run on the IO thread pool, as they block on the reads.
+  size_t chunk_size = (indices.size() + num_tasks - 1) / num_tasks;
+  MultiWait mwait(num_tasks);
+  for (size_t t = 0; t < num_tasks; ++t) {
+    auto read_fn = [&, t]() {
+      size_t end = std::min(indices.size(), (t + 1) * chunk_size);
+      for (size_t i = t * chunk_size; i < end; ++i) {
+        records[i] = ReadRecord(indices[i]);
+      }
+    };
+    env::ScheduleIoClosure(mwait.Completer(std::move(read_fn)));
+  }
+  mwait.Wait();
+  return records;
+}
+
+IndexedRecordReader::Data IndexedRecordReader::ReadRecord(int64 index) const {
+  XLA_CHECK_GE(index, 0);
+  XLA_CHECK_LT(index, num_records());
+  size_t shard_index =
+      std::upper_bound(shard_starts_.begin(), shard_starts_.end(), index) -
+      shard_starts_.begin() - 1;
+  const Shard& shard = *shards_[shard_index];
+  uint64 offset = shard.offsets[index - shard_starts_[shard_index]];
+
+  char header[kRecordHeaderSize];
+  tensorflow::StringPiece result;
+  XLA_CHECK_OK(shard.file->Read(offset, sizeof(header), &result, header))
+      << shard.path << " offset " << offset;
+  XLA_CHECK_EQ(result.size(), sizeof(header))
+      << shard.path << " offset " << offset;
+  uint64 length = tensorflow::core::DecodeFixed64(result.data());
+  XLA_CHECK_EQ(tensorflow::crc32c::Unmask(tensorflow::core::DecodeFixed32(
+                   result.data() + sizeof(uint64))),
+               tensorflow::crc32c::Value(result.data(), sizeof(uint64)))
+      << "Corrupted record length in " << shard.path << " offset " << offset;
+
+  std::unique_ptr<char[]> data(new char[length + kRecordFooterSize]);
+  XLA_CHECK_OK(shard.file->Read(offset + kRecordHeaderSize,
+                                length + kRecordFooterSize, &result,
+                                data.get()))
+      << shard.path << " offset " << offset;
+  XLA_CHECK_EQ(result.size(), length + kRecordFooterSize)
+      << shard.path << " offset " << offset;
+  XLA_CHECK_EQ(tensorflow::crc32c::Unmask(
+                   tensorflow::core::DecodeFixed32(result.data() + length)),
+               tensorflow::crc32c::Value(result.data(), length))
+      << "Corrupted record data in " << shard.path << " offset " << offset;
+  return Data(result.data(), length);
+}
+
+std::vector<uint64> IndexedRecordReader::BuildIndex(const std::string& path) {
+  std::unique_ptr<tensorflow::RandomAccessFile> file;
+  XLA_CHECK_OK(tensorflow::Env::Default()->NewRandomAccessFile(path, &file));
+  tensorflow::io::RecordReaderOptions options;
+  options.buffer_size = 16 * 1024 * 1024;
+  tensorflow::io::RecordReader reader(file.get(), options);
+  std::vector<uint64> offsets;
+  uint64 offset = 0;
+  Data value;
+  while (true) {
+    uint64 record_offset = offset;
+    xla::Status status = reader.ReadRecord(&offset, &value);
+    if (tensorflow::errors::IsOutOfRange(status)) {
+      break;
+    }
+    XLA_CHECK_OK(status) << path << " offset " << record_offset;
+    offsets.push_back(record_offset);
+  }
+  return offsets;
+}
+
+std::string IndexedRecordReader::IndexPath(const std::string& path) {
+  return absl::StrCat(path, ".index");
+}
+
 }  // namespace util
 }  // namespace xla
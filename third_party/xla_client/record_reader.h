@@ -1,33 +1,132 @@
 #ifndef XLA_CLIENT_RECORD_READER_H_
 #define XLA_CLIENT_RECORD_READER_H_
 
+#include <condition_variable>
+#include <deque>
+#include <exception>
 #include <memory>
 #include <mutex>
+#include <random>
 #include <string>
+#include <thread>
+#include <vector>
 
+#include "absl/types/span.h"
 #include "tensorflow/compiler/xla/types.h"
 #include "tensorflow/core/lib/io/record_reader.h"
 
 namespace xla {
 namespace util {
 
+// Reads the records of a list of TFRecord shards. By default the shards are
+// read in order, by the thread calling Read(). With background readers, each
+// of them reads a different shard, and their records get interleaved into a
+// bounded prefetch queue. An optional shuffle buffer randomizes the order in
+// which the records are returned.
 class RecordReader {
  public:
   using Data = tensorflow::tstring;
 
+  struct Options {
+    // The number of background threads reading the shards. Zero means the
+    // records are read by the threads calling the Read() API.
+    int64 num_readers = 0;
+    // The maximum number of records the background readers can queue.
+    int64 prefetch_size = 1024;
+    // The size of the buffer the records are randomly picked from. Values
+    // smaller than two disable the shuffling.
+    int64 shuffle_size = 0;
+    uint64 seed = 0;
+  };
+
   RecordReader(std::string path, const std::string& compression,
                int64 buffer_size);
 
+  RecordReader(std::vector<std::string> paths, const std::string& compression,
+               int64 buffer_size, const Options& options);
+
+  ~RecordReader();
+
   const std::string& path() const { return path_; }
 
   bool Read(Data* value);
 
+  // Reads up to max_records records. Fewer records are returned only once the
+  // end of the data has been reached.
+  std::vector<Data> Read(size_t max_records);
+
  private:
+  struct Shard;
+
+  std::unique_ptr<Shard> OpenShard(size_t index) const;
+
+  bool ReadShuffled(Data* value);
+
+  bool ReadRecord(Data* value);
+
+  bool ReadInline(Data* value);
+
+  bool Dequeue(Data* value);
+
+  void RunReader();
+
+  std::vector<std::string> paths_;
   std::string path_;
+  std::string compression_;
+  int64 buffer_size_;
+  Options options_;
+  // Serializes the Read() callers.
+  std::mutex read_lock_;
+  std::unique_ptr<Shard> inline_shard_;
+  std::vector<Data> shuffle_buffer_;
+  std::mt19937_64 generator_;
+  // Protects the state shared with the background readers.
   std::mutex lock_;
-  uint64 offset_ = 0;
-  std::unique_ptr<tensorflow::RandomAccessFile> file_;
-  std::unique_ptr<tensorflow::io::RecordReader> reader_;
+  std::condition_variable cv_;
+  std::deque<Data> queue_;
+  size_t next_shard_ = 0;
+  size_t active_readers_ = 0;
+  bool stopped_ = false;
+  std::exception_ptr exptr_;
+  std::vector<std::thread> readers_;
+};
+
+// Random access reader of the records of a list of uncompressed TFRecord
+// shards, which allows exact global shuffles with bounded memory. Every shard
+// has an index of its record offsets, stored in a sidecar file (the shard path
+// plus the ".index" suffix), which gets built with a sequential scan of the
+// shard (and saved) when missing or stale.
+class IndexedRecordReader {
+ public:
+  using Data = RecordReader::Data;
+
+  IndexedRecordReader(std::vector<std::string> paths, int64 num_threads);
+
+  ~IndexedRecordReader();
+
+  // The total number of records, of all the shards.
+  int64 num_records() const { return shard_starts_.back(); }
+
+  // Reads the records at the given global indices, which number the records
+  // of all the shards in order, with positional reads spread over up to
+  // num_threads parallel tasks.
+  std::vector<Data> ReadAt(absl::Span<const int64> indices) const;
+
+  // Scans a TFRecord shard, and returns the offsets of its records.
+  static std::vector<uint64> BuildIndex(const std::string& path);
+
+  static std::string IndexPath(const std::string& path);
+
+ private:
+  struct Shard;
+
+  Data ReadRecord(int64 index) const;
+
+  std::vector<std::unique_ptr<Shard>> shards_;
+  // The global index of the first record of every shard, plus the total
+  // number of records as last element.
+  std::vector<int64> shard_starts_;
+  int64 num_threads_;
 };
 
 }  // namespace util
@@ -1,23 +1,172 @@
 #include "tensorflow/compiler/xla/xla_client/thread_pool.h"
 
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <deque>
 #include <exception>
+#include <fstream>
+#include <map>
 #include <mutex>
+#include <vector>
 
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
+#include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 #include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/xla/xla_client/tf_logging.h"
 
 namespace xla {
 namespace env {
 namespace {
 
+// Parses a Linux CPU list (like "0-3,8,10-11").
+std::vector<int> ParseCpuList(const std::string& cpu_list) {
+  std::vector<int> cpus;
+  for (absl::string_view range :
+       absl::StrSplit(cpu_list, ',', absl::SkipWhitespace())) {
+    std::vector<std::string> bounds = absl::StrSplit(range, '-');
+    int start = std::stoi(bounds.front());
+    int end = std::stoi(bounds.back());
+    for (int cpu = start; cpu <= end; ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+std::string ReadSysFile(const std::string& path) {
+  std::ifstream file(path);
+  std::string line;
+  std::getline(file, line);
+  return line;
+}
+
+// Returns the NUMA node of each CPU, or an empty map if not available.
+std::map<int, int> GetCpuNodes() {
+  std::map<int, int> cpu_nodes;
+  std::string online = ReadSysFile("/sys/devices/system/node/online");
+  if (online.empty()) {
+    return cpu_nodes;
+  }
+  for (int node : ParseCpuList(online)) {
+    std::string cpu_list = ReadSysFile(
+        absl::StrCat("/sys/devices/system/node/node", node, "/cpulist"));
+    for (int cpu : ParseCpuList(cpu_list)) {
+      cpu_nodes[cpu] = node;
+    }
+  }
+  return cpu_nodes;
+}
+
+std::vector<int> GetAllowedCpus() {
+  std::vector<int> cpus;
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &cpu_set)) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+  if (cpus.empty()) {
+    for (unsigned int cpu = 0; cpu < std::thread::hardware_concurrency();
+         ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+bool ShouldPinThreads() {
+  static const bool pin_threads =
+      sys_util::GetEnvString("XLA_CPU_AFFINITY", "none") == "ordinal";
+  return pin_threads;
+}
+
+std::vector<int> ComputeProcessCpus() {
+  std::vector<int> cpus = GetAllowedCpus();
+  int64 local_world_size =
+      sys_util::GetEnvInt("XRT_SHARD_LOCAL_WORLD_SIZE", 1);
+  int64 local_ordinal = sys_util::GetEnvInt("XRT_SHARD_LOCAL_ORDINAL", 0);
+  if (local_world_size <= 1 || local_ordinal < 0 ||
+      local_ordinal >= local_world_size) {
+    return cpus;
+  }
+  if (ShouldPinThreads()) {
+    // Sorting the CPUs by NUMA node makes the contiguous chunks assigned to
+    // the processes lie within a single node, when the number of processes is
+    // a multiple of the number of nodes.
+    std::map<int, int> cpu_nodes = GetCpuNodes();
+    std::stable_sort(cpus.begin(), cpus.end(), [&](int cpu1, int cpu2) {
+      return cpu_nodes[cpu1] < cpu_nodes[cpu2];
+    });
+  }
+  size_t chunk_size =
+      std::max<size_t>(cpus.size() / static_cast<size_t>(local_world_size), 1);
+  size_t start = std::min<size_t>(local_ordinal * chunk_size, cpus.size() - 1);
+  size_t end = local_ordinal + 1 == local_world_size
+                   ? cpus.size()
+                   : std::min<size_t>(start + chunk_size, cpus.size());
+  std::vector<int> process_cpus(cpus.begin() + start, cpus.begin() + end);
+  if (!ShouldPinThreads()) {
+    // Without pinning only the number of CPUs matters, which is used to size
+    // the pools without oversubscribing the host, but the threads can run on
+    // any allowed CPU.
+    return std::vector<int>(cpus.begin(), cpus.begin() + process_cpus.size());
+  }
+  TF_VLOG(1) << "Process CPUs for local ordinal " << local_ordinal << ": "
+             << absl::StrJoin(process_cpus, ",");
+  return process_cpus;
+}
+
+// Binds the calling thread to the process CPUs, if the affinity policy says
+// so.
+void MaybePinThread() {
+  if (!ShouldPinThreads()) {
+    return;
+  }
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (int cpu : GetProcessCpus()) {
+    CPU_SET(cpu, &cpu_set);
+  }
+  if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) != 0) {
+    XLA_COUNTER("ThreadPinFailed", 1);
+  }
+}
+
+// Work-stealing thread pool. Every worker has its own deque, where closures
+// scheduled from within the worker itself are pushed (and popped LIFO, for
+// cache locality), while closures scheduled from outside the pool are spread
+// round-robin. Idle workers take work from their own deque first, and then
+// steal (FIFO) from the other workers.
+// The pool never queues more closures than there are idle threads to pick
+// them up. When no idle thread is available, the closure is run on a new
+// overflow thread. This prevents tricky thread-pool-size-deadlocks caused by
+// an undersized thread pool and closures that end up doing sync waits on the
+// pool threads. To avoid thread creation storms under bursty loads, overflow
+// threads linger as spare workers for a while after having run their closure,
+// and up to num_threads spares can be alive at any given time.
 class ThreadPool {
  public:
-  explicit ThreadPool(size_t num_threads) {
+  ThreadPool(const std::string& name, size_t num_threads)
+      : queues_(std::max<size_t>(num_threads, 1)),
+        max_spares_(num_threads),
+        steals_(absl::StrCat(name, "Steals")),
+        overflow_threads_(absl::StrCat(name, "OverflowThreads")),
+        queue_depth_(absl::StrCat(name, "QueueDepth")) {
     threads_.reserve(num_threads);
     for (size_t i = 0; i < num_threads; ++i) {
-      threads_.emplace_back([this]() { Worker(); });
+      threads_.emplace_back([this, i]() { Worker(i); });
     }
   }
 
@@ -33,84 +182,200 @@ class ThreadPool {
   }
 
   void Schedule(std::function<void()> closure) {
-    // If we have more work scheduled than waiting worker threads, just schedule
-    // it on a separate thread. This prevents tricky thread-pool-size-deadlocks
-    // caused by an undersized thread pool and closures that end up doing sync
-    // waits on the pool threads.
-    bool scheduled = false;
+    if (!ReserveIdleThread()) {
+      ScheduleOnThread(std::move(closure));
+      return;
+    }
+    size_t index = (g_worker.pool == this)
+                       ? g_worker.index
+                       : next_queue_.fetch_add(1) % queues_.size();
+    WorkQueue& queue = queues_[index];
     {
-      std::lock_guard<std::mutex> lock(mutex_);
-      if (work_.size() < waiting_) {
-        work_.emplace_back(std::move(closure));
-        scheduled = true;
-      }
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      queue.work.emplace_back(std::move(closure));
     }
-    if (scheduled) {
-      cv_.notify_one();
-    } else {
-      ScheduleOnThread(std::move(closure));
+    int64 depth = queued_.fetch_add(1) + 1;
+    // Sampling every single schedule would make the metric lock a contention
+    // point on its own.
+    if (schedules_.fetch_add(1) % 16 == 0) {
+      queue_depth_.AddSample(depth);
     }
+    // Taking the mutex makes sure that a worker cannot miss the queued_
+    // update, between the check of the wait predicate and going to sleep.
+    std::lock_guard<std::mutex> lock(mutex_);
+    cv_.notify_one();
   }
 
  private:
-  void Worker() {
+  struct WorkQueue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> work;
+  };
+
+  struct WorkerInfo {
+    ThreadPool* pool = nullptr;
+    size_t index = 0;
+  };
+
+  // The available_ counter tracks the number of idle threads, minus the number
+  // of queued closures. A closure can only be queued if it can claim an idle
+  // thread, by decrementing a positive counter.
+  bool ReserveIdleThread() {
+    int64 available = available_.load();
+    while (available > 0) {
+      if (available_.compare_exchange_weak(available, available - 1)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void Worker(size_t index) {
+    MaybePinThread();
+    g_worker.pool = this;
+    g_worker.index = index;
     while (true) {
-      std::function<void()> closure = GetWork();
+      std::function<void()> closure = GetWork(index, /*linger=*/false);
       if (closure == nullptr) {
         break;
       }
-      try {
-        closure();
-      } catch (const std::exception& ex) {
-        XLA_COUNTER("ThreadPoolException", 1);
-        TF_LOG(ERROR) << "Exception from running thread pool closure: "
-                      << ex.what();
+      RunClosure(closure);
+    }
+  }
+
+  void SpareWorker(std::function<void()> closure) {
+    MaybePinThread();
+    RunClosure(closure);
+    if (spares_.fetch_add(1) >= max_spares_) {
+      spares_.fetch_sub(1);
+      return;
+    }
+    // Spare threads have no queue on their own, so they always steal.
+    size_t index = next_queue_.fetch_add(1) % queues_.size();
+    while (true) {
+      closure = GetWork(index, /*linger=*/true);
+      if (closure == nullptr) {
+        break;
       }
+      RunClosure(closure);
+    }
+    spares_.fetch_sub(1);
+  }
+
+  void RunClosure(const std::function<void()>& closure) {
+    try {
+      closure();
+    } catch (const std::exception& ex) {
+      XLA_COUNTER("ThreadPoolException", 1);
+      TF_LOG(ERROR) << "Exception from running thread pool closure: "
+                    << ex.what();
     }
   }
 
   void ScheduleOnThread(std::function<void()> closure) {
-    std::thread thread(std::move(closure));
+    overflow_threads_.AddValue(1);
+    std::thread thread(
+        [this, closure = std::move(closure)]() { SpareWorker(closure); });
     thread.detach();
   }
 
-  std::function<void()> GetWork() {
-    std::unique_lock<std::mutex> lock(mutex_);
-    ++waiting_;
-    cv_.wait(lock, [this] { return exiting_ || !work_.empty(); });
-    --waiting_;
-    if (work_.empty()) {
-      return nullptr;
+  std::function<void()> TryGetWork(size_t index) {
+    {
+      WorkQueue& queue = queues_[index];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (!queue.work.empty()) {
+        std::function<void()> closure(std::move(queue.work.back()));
+        queue.work.pop_back();
+        return closure;
+      }
     }
-    std::function<void()> closure(std::move(work_.front()));
-    work_.pop_front();
-    return closure;
+    for (size_t i = 1; i < queues_.size(); ++i) {
+      WorkQueue& queue = queues_[(index + i) % queues_.size()];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (!queue.work.empty()) {
+        std::function<void()> closure(std::move(queue.work.front()));
+        queue.work.pop_front();
+        steals_.AddValue(1);
+        return closure;
+      }
+    }
+    return nullptr;
   }
 
+  // Returns the next closure to be run, or nullptr if the thread should exit.
+  // Lingering threads exit once they stayed idle for the linger time, and no
+  // queued closure has claimed them.
+  std::function<void()> GetWork(size_t index, bool linger) {
+    static const std::chrono::milliseconds linger_time(
+        sys_util::GetEnvInt("XLA_THREAD_POOL_LINGER_MS", 100));
+    available_.fetch_add(1);
+    while (true) {
+      if (queued_.load() > 0) {
+        std::function<void()> closure = TryGetWork(index);
+        if (closure != nullptr) {
+          // Taking a closure as idle thread leaves available_ unchanged.
+          queued_.fetch_sub(1);
+          return closure;
+        }
+      }
+      std::unique_lock<std::mutex> lock(mutex_);
+      auto ready = [this] { return exiting_ || queued_.load() > 0; };
+      if (!linger) {
+        cv_.wait(lock, ready);
+        if (exiting_) {
+          return nullptr;
+        }
+      } else if (!cv_.wait_for(lock, linger_time, ready) &&
+                 ReserveIdleThread()) {
+        return nullptr;
+      }
+    }
+  }
+
+  static thread_local WorkerInfo g_worker;
+
   std::vector<std::thread> threads_;
+  std::vector<WorkQueue> queues_;
+  std::atomic<size_t> next_queue_{0};
+  std::atomic<size_t> schedules_{0};
+  std::atomic<int64> available_{0};
+  std::atomic<int64> queued_{0};
+  std::atomic<size_t> spares_{0};
+  size_t max_spares_ = 0;
   std::mutex mutex_;
   std::condition_variable cv_;
   bool exiting_ = false;
-  std::deque<std::function<void()>> work_;
-  size_t waiting_ = 0;
+  metrics::Counter steals_;
+  metrics::Counter overflow_threads_;
+  metrics::Metric queue_depth_;
 };
 
+thread_local ThreadPool::WorkerInfo ThreadPool::g_worker;
+
 ThreadPool* GetThreadPool() {
-  static size_t num_threads = sys_util::GetEnvInt(
-      "XLA_THREAD_POOL_SIZE", std::thread::hardware_concurrency());
-  static ThreadPool* pool = new ThreadPool(num_threads);
+  static size_t num_threads =
+      sys_util::GetEnvInt("XLA_THREAD_POOL_SIZE", GetProcessCpus().size());
+  static ThreadPool* pool = new ThreadPool("ThreadPool", num_threads);
   return pool;
 }
 
+// The blocking IO lane is a separate pool, so that closures waiting for IO
+// never hold back the compute closures.
 ThreadPool* GetIoThreadPool() {
-  static size_t num_threads = sys_util::GetEnvInt(
-      "XLA_IO_THREAD_POOL_SIZE", std::thread::hardware_concurrency());
-  static ThreadPool* pool = new ThreadPool(num_threads);
+  static size_t num_threads =
+      sys_util::GetEnvInt("XLA_IO_THREAD_POOL_SIZE", GetProcessCpus().size());
+  static ThreadPool* pool = new ThreadPool("IoThreadPool", num_threads);
   return pool;
 }
 
 }  // namespace
 
+const std::vector<int>& GetProcessCpus() {
+  static const std::vector<int>* process_cpus =
+      new std::vector<int>(ComputeProcessCpus());
+  return *process_cpus;
+}
+
 class Completion::Data {
  public:
   void Wait() {
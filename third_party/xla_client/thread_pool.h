@@ -4,6 +4,7 @@
 #include <functional>
 #include <memory>
 #include <thread>
+#include <vector>
 
 namespace xla {
 namespace env {
@@ -22,6 +23,12 @@ class Completion {
   std::shared_ptr<Data> data_;
 };
 
+// Returns the CPUs the threads of this process should run on. These are the
+// CPUs the process is allowed to run on, unless the XLA_CPU_AFFINITY=ordinal
+// policy splits them (grouped by NUMA node) among the local processes, by local
+// ordinal. The default sizes of the thread pools are based on their number.
+const std::vector<int>& GetProcessCpus();
+
 // Schedules a closure to be run. The closure should not block waiting for other
 // events.
 void ScheduleClosure(std::function<void()> closure);
@@ -25,6 +25,13 @@ hash_t SingleShapeHash(const Shape& shape, hash_t seed) {
   for (auto dim : shape.dimensions()) {
     seed = HashCombine(seed, dim);
   }
+  if (shape.IsArray()) {
+    for (int64 i = 0; i < shape.rank(); ++i) {
+      if (shape.is_dynamic_dimension(i)) {
+        seed = HashCombine(seed, -i - 1);
+      }
+    }
+  }
   return HashCombine(seed, static_cast<int>(shape.element_type()));
 }
 
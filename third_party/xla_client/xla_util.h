@@ -31,6 +31,8 @@ void CheckComputationStatus(
     const Status& status, absl::Span<const XlaComputation* const> computations,
     absl::Span<const Shape* const> output_shapes);
 
+// Hashes the structure of the shape (element types, dimensions, dynamic
+// dimensions and layouts), with no string materialization.
 hash_t ShapeHash(const Shape& shape);
 
 }  // namespace util
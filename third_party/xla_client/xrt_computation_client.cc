@@ -1,10 +1,14 @@
 #include "tensorflow/compiler/xla/xla_client/xrt_computation_client.h"
 
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
+#include <exception>
 #include <fstream>
 #include <functional>
 #include <limits>
 #include <list>
+#include <set>
 #include <sstream>
 #include <unordered_map>
 
@@ -13,9 +17,12 @@
 #include "absl/strings/str_join.h"
 #include "absl/strings/str_split.h"
 #include "tensorflow/cc/ops/const_op.h"
+#include "tensorflow/compiler/xla/client/xla_builder.h"
+#include "tensorflow/compiler/xla/layout_util.h"
 #include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/util.h"
 #include "tensorflow/compiler/xla/xla_client/env_vars.h"
+#include "tensorflow/compiler/xla/xla_client/host_memory_pool.h"
 #include "tensorflow/compiler/xla/xla_client/multi_wait.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/xla/xla_client/thread_pool.h"
@@ -24,8 +31,13 @@
 #include "tensorflow/compiler/xla/xla_client/xla_util.h"
 #include "tensorflow/compiler/xla/xla_client/xrt_local_service.h"
 #include "tensorflow/compiler/xrt/xrt_util.h"
+#include "tensorflow/core/framework/allocation_description.pb.h"
 #include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/platform/mem.h"
 #include "tensorflow/core/util/device_name_utils.h"
+#include "tensorflow/stream_executor/multi_platform_manager.h"
+#include "tensorflow/stream_executor/stream_executor.h"
+#include "zlib.h"
 
 namespace xla {
 namespace {
@@ -34,127 +46,102 @@ static const char* const kLocalService = "localservice";
 
 thread_local std::vector<std::string> g_replication_devices;
 
-// A simple Tensorflow Allocator which caches Tensor allocations in order to
-// avoid paying the kernel's clear_page_c() price.
-class TensorAllocator : public tensorflow::Allocator {
-  struct AllocKey {
-    struct Hash {
-      size_t operator()(const AllocKey& hk) const {
-        return util::StdHashCombine(hk.alignment, hk.num_bytes);
-      }
-    };
+// A Tensorflow TensorBuffer wrapping the host memory lent by a TensorSource,
+// which allows feeding the source data to the XRT session without copies.
+class LentTensorBuffer : public tensorflow::TensorBuffer {
+ public:
+  LentTensorBuffer(const void* data, size_t size, std::shared_ptr<void> owner)
+      : tensorflow::TensorBuffer(const_cast<void*>(data)),
+        size_(size),
+        owner_(std::move(owner)) {}
 
-    bool operator==(const AllocKey& rhs) const {
-      return num_bytes == rhs.num_bytes && alignment == rhs.alignment;
-    }
+  size_t size() const override { return size_; }
 
-    size_t alignment = 0;
-    size_t num_bytes = 0;
-  };
+  tensorflow::TensorBuffer* root_buffer() override { return this; }
 
-  struct AllocBlocks {
-    AllocBlocks(const AllocKey& alloc_key) : alloc_key(alloc_key) {}
+  void FillAllocationDescription(
+      tensorflow::AllocationDescription* proto) const override {
+    proto->set_requested_bytes(size_);
+    proto->set_allocator_name("XLA_LentTensorBuffer");
+  }
 
-    AllocKey alloc_key;
-    std::vector<void*> blocks;
-  };
+  bool OwnsMemory() const override { return false; }
 
-  using AllocList = std::list<AllocBlocks>;
+ private:
+  size_t size_ = 0;
+  std::shared_ptr<void> owner_;
+};
 
+// A Tensorflow Allocator serving the Tensor allocations from the host memory
+// pool, in order to avoid paying the kernel's clear_page_c() price.
+class TensorAllocator : public tensorflow::Allocator {
  public:
   static TensorAllocator* Get() {
-    static size_t max_size =
-        sys_util::GetEnvInt("XLA_TENSOR_ALLOCATOR_MAXSIZE", 1000000000);
-    static TensorAllocator* allocator = new TensorAllocator(max_size);
+    static TensorAllocator* allocator = new TensorAllocator();
     return allocator;
   }
 
   string Name() override { return "XLA_TensorAllocator"; }
 
   void* AllocateRaw(size_t alignment, size_t num_bytes) override {
-    // We use an alignment-sized area before the memory returned to the caller,
-    // to store a pointer to its AllocBlocks.
-    alignment = std::max<size_t>(alignment, sizeof(void*));
-    // To call aligned_alloc(), num_bytes must be multiple of alignment.
-    num_bytes = RoundUpToNearest(num_bytes, alignment);
-
-    AllocKey alloc_key = {alignment, num_bytes};
-    void* block = nullptr;
-    AllocBlocks* alloc_blocks = nullptr;
-    std::lock_guard<std::mutex> lock(lock_);
-    auto it = allocs_.find(alloc_key);
-    if (it != allocs_.end()) {
-      alloc_blocks = &*it->second;
-      if (!alloc_blocks->blocks.empty()) {
-        block = alloc_blocks->blocks.back();
-        alloc_blocks->blocks.pop_back();
-      }
-      // LRU
-      alloc_list_.splice(alloc_list_.begin(), alloc_list_, it->second);
-    } else {
-      allocs_.emplace(alloc_key,
-                      alloc_list_.insert(alloc_list_.begin(), alloc_key));
-      alloc_blocks = &alloc_list_.front();
-    }
-    if (block == nullptr) {
-      TrimCache(alloc_key.num_bytes);
-      block = NewBlock(alloc_blocks);
-    }
-    return block;
+    return util::HostMemoryPool::Get()->Allocate(alignment, num_bytes);
   }
 
   void DeallocateRaw(void* ptr) override {
-    if (ptr != nullptr) {
-      // The pointer to AllocBlocks is right before the user memory.
-      AllocBlocks* alloc_blocks = reinterpret_cast<AllocBlocks**>(ptr)[-1];
-      std::lock_guard<std::mutex> lock(lock_);
-      if (alloc_blocks->alloc_key.num_bytes < max_size_) {
-        alloc_blocks->blocks.push_back(ptr);
-      } else {
-        // We do not cache blocks whose size is bigger than the max cache size.
-        FreeBlock(ptr, alloc_blocks);
-      }
-    }
+    util::HostMemoryPool::Get()->Free(ptr);
+  }
+};
+
+// A Tensorflow Allocator serving the GPU transfer staging tensors, from a host
+// memory pool whose blocks are registered with the GPU driver. The device
+// copies from pinned memory are DMA transfers issued on the TF GPU device copy
+// streams, which overlap with the running computations, while pageable memory
+// needs a synchronous copy through a driver bounce buffer.
+class GpuStagingAllocator : public tensorflow::Allocator {
+ public:
+  // Returns nullptr if the CUDA platform is not available in this process.
+  static GpuStagingAllocator* Get() {
+    static GpuStagingAllocator* allocator = Create();
+    return allocator;
   }
 
+  string Name() override { return "XLA_GpuStagingAllocator"; }
+
+  void* AllocateRaw(size_t alignment, size_t num_bytes) override {
+    return pool_.Allocate(alignment, num_bytes);
+  }
+
+  void DeallocateRaw(void* ptr) override { pool_.Free(ptr); }
+
  private:
-  explicit TensorAllocator(size_t max_size) : max_size_(max_size) {}
-
-  void* NewBlock(AllocBlocks* alloc_blocks) {
-    // We allocate an extra alignment sized area to store the AllocBlocks
-    // pointer.
-    void* ptr = ::aligned_alloc(
-        alloc_blocks->alloc_key.alignment,
-        alloc_blocks->alloc_key.alignment + alloc_blocks->alloc_key.num_bytes);
-    XLA_CHECK(ptr != nullptr);
-    ptr = reinterpret_cast<char*>(ptr) + alloc_blocks->alloc_key.alignment;
-    // Store the pointer to AllocBlocks right before the user memory.
-    reinterpret_cast<AllocBlocks**>(ptr)[-1] = alloc_blocks;
-    size_ += alloc_blocks->alloc_key.num_bytes;
-    return ptr;
-  }
-
-  void FreeBlock(void* ptr, AllocBlocks* alloc_blocks) {
-    size_ -= alloc_blocks->alloc_key.num_bytes;
-    std::free(reinterpret_cast<char*>(ptr) - alloc_blocks->alloc_key.alignment);
-  }
-
-  void TrimCache(size_t num_bytes) {
-    auto it = alloc_list_.rbegin();
-    for (; size_ + num_bytes > max_size_ && it != alloc_list_.rend(); ++it) {
-      AllocBlocks* alloc_blocks = &*it;
-      while (!alloc_blocks->blocks.empty() && size_ + num_bytes > max_size_) {
-        FreeBlock(alloc_blocks->blocks.back(), alloc_blocks);
-        alloc_blocks->blocks.pop_back();
-      }
+  explicit GpuStagingAllocator(stream_executor::StreamExecutor* executor)
+      : pool_(sys_util::GetEnvInt("XRT_GPU_STAGING_POOL_MAXSIZE", 1000000000),
+              [executor](void* ptr, size_t num_bytes) {
+                return executor->HostMemoryRegister(ptr, num_bytes);
+              },
+              [executor](void* ptr) { executor->HostMemoryUnregister(ptr); }) {
+  }
+
+  static GpuStagingAllocator* Create() {
+    auto platform =
+        stream_executor::MultiPlatformManager::PlatformWithName("CUDA");
+    if (!platform.ok()) {
+      TF_LOG(WARNING) << "GPU pinned transfers not available: "
+                      << platform.status();
+      return nullptr;
+    }
+    // The registrations are portable across the GPU contexts, so the first
+    // device executor serves all of them.
+    auto executor = platform.ValueOrDie()->ExecutorForDevice(0);
+    if (!executor.ok()) {
+      TF_LOG(WARNING) << "GPU pinned transfers not available: "
+                      << executor.status();
+      return nullptr;
     }
+    return new GpuStagingAllocator(executor.ValueOrDie());
   }
 
-  size_t max_size_ = 0;
-  std::mutex lock_;
-  size_t size_ = 0;
-  AllocList alloc_list_;
-  std::unordered_map<AllocKey, AllocList::iterator, AllocKey::Hash> allocs_;
+  util::HostMemoryPool pool_;
 };
 
 std::string StripPrefix(const std::string& value, const std::string& prefix) {
@@ -212,6 +199,286 @@ int64 GetMaxTensorsPartitionSize() {
   return max_partition_size;
 }
 
+int64 GetStreamTransferThreshold() {
+  // Tensors bigger than this size are sent to the device in chunks, and
+  // assembled on the device side.
+  static int64 stream_threshold = sys_util::GetEnvInt(
+      "XRT_STREAM_TRANSFER_THRESHOLD", GetMaxTensorsPartitionSize());
+  return stream_threshold;
+}
+
+int64 GetPackTransferMaxBytes() {
+  // Tensors up to this size are packed into a single buffer per device, when
+  // more than one of them is uploaded together.
+  static int64 pack_max_bytes =
+      sys_util::GetEnvInt("XRT_PACK_TRANSFER_MAX_BYTES", 0);
+  return pack_max_bytes;
+}
+
+// The types the worker side DecodeRaw can produce.
+bool IsPackableType(PrimitiveType type) {
+  switch (type) {
+    case PRED:
+    case S8:
+    case U8:
+    case S16:
+    case U16:
+    case S32:
+    case S64:
+    case F16:
+    case BF16:
+    case F32:
+    case F64:
+      return true;
+    default:
+      return false;
+  }
+}
+
+int64 GetStreamChunkElements(PrimitiveType type) {
+  static int64 chunk_size =
+      sys_util::GetEnvInt("XRT_STREAM_CHUNK_SIZE", 256 * 1024 * 1024);
+  // Keep chunk offsets aligned, so that chunk buffers can be lent to the
+  // transfer API as they are.
+  const int64 alignment = tensorflow::Allocator::kAllocatorAlignment;
+  int64 chunk_elements = chunk_size / ShapeUtil::ByteSizeOfPrimitiveType(type);
+  return std::max<int64>(chunk_elements - chunk_elements % alignment,
+                         alignment);
+}
+
+// Creates the computation which reassembles a tensor of the given shape, from
+// the R1 chunks of its flat, device layout, data.
+XlaComputation CreateStreamAssembleComputation(
+    const Shape& shape, absl::Span<const int64> chunk_sizes) {
+  XlaBuilder builder("StreamAssemble");
+  std::vector<XlaOp> chunks;
+  for (size_t i = 0; i < chunk_sizes.size(); ++i) {
+    Shape chunk_shape =
+        ShapeUtil::MakeShape(shape.element_type(), {chunk_sizes[i]});
+    chunks.push_back(Parameter(&builder, i, chunk_shape, absl::StrCat("p", i)));
+  }
+  // The flat data is in physical order, so reshape to the major-to-minor
+  // dimensions, and transpose back to the logical order.
+  auto minor_to_major = shape.layout().minor_to_major();
+  int64 rank = minor_to_major.size();
+  std::vector<int64> physical_dims(rank);
+  std::vector<int64> permutation(rank);
+  for (int64 i = 0; i < rank; ++i) {
+    int64 dim = minor_to_major[rank - 1 - i];
+    physical_dims[i] = shape.dimensions(dim);
+    permutation[dim] = i;
+  }
+  XlaOp result = Transpose(
+      Reshape(ConcatInDim(&builder, chunks, 0), physical_dims), permutation);
+  return ConsumeValue(builder.Build(result));
+}
+
+struct TransferCompressionConfig {
+  bool enabled = false;
+  int64 min_size = 0;
+  int64 sample_size = 0;
+  double max_ratio = 0;
+  int level = 0;
+};
+
+const TransferCompressionConfig& GetTransferCompressionConfig() {
+  static const TransferCompressionConfig* config = []() {
+    TransferCompressionConfig* config = new TransferCompressionConfig();
+    config->enabled = sys_util::GetEnvBool("XRT_TRANSFER_COMPRESSION", false);
+    config->min_size =
+        sys_util::GetEnvInt("XRT_TRANSFER_COMPRESSION_MIN_SIZE", 1024 * 1024);
+    config->sample_size =
+        sys_util::GetEnvInt("XRT_TRANSFER_COMPRESSION_SAMPLE", 64 * 1024);
+    config->max_ratio =
+        sys_util::GetEnvDouble("XRT_TRANSFER_COMPRESSION_MAX_RATIO", 0.7);
+    config->level = sys_util::GetEnvInt("XRT_TRANSFER_COMPRESSION_LEVEL", 1);
+    return config;
+  }();
+  return *config;
+}
+
+// Only integral types (image batches, masks, labels, ...) are compressed, as
+// the generic compressors fail to shrink floating point data enough to pay for
+// the CPU time spent on it.
+bool IsCompressibleType(PrimitiveType type) {
+  switch (type) {
+    case PRED:
+    case S8:
+    case U8:
+    case S16:
+    case U16:
+    case S32:
+    case U32:
+    case S64:
+    case U64:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Rearranges the bytes of the elements in planes, with plane N holding the
+// N-th byte of every element. The high significance planes of integral data
+// are mostly constant, and compress to almost nothing.
+void ShuffleBytePlanes(absl::string_view data, size_t element_size,
+                       char* dest) {
+  size_t num_elements = data.size() / element_size;
+  for (size_t i = 0; i < num_elements; ++i) {
+    for (size_t b = 0; b < element_size; ++b) {
+      dest[b * num_elements + i] = data[i * element_size + b];
+    }
+  }
+}
+
+bool ZlibCompress(absl::string_view data, int level, std::string* output) {
+  uLongf output_size = compressBound(data.size());
+  output->resize(output_size);
+  int status = compress2(reinterpret_cast<Bytef*>(&(*output)[0]), &output_size,
+                         reinterpret_cast<const Bytef*>(data.data()),
+                         data.size(), level);
+  if (status != Z_OK) {
+    return false;
+  }
+  output->resize(output_size);
+  return true;
+}
+
+// The decompression ops have no accelerator kernels, so they are placed on
+// the CPU of the worker hosting the XRT device.
+std::string GetWorkerCpuDevice(const std::string& xrt_device) {
+  tensorflow::DeviceNameUtils::ParsedName parsed_device =
+      ParseFullXrtDevice(xrt_device);
+  parsed_device.type = "CPU";
+  parsed_device.id = 0;
+  return tensorflow::DeviceNameUtils::ParsedNameToString(parsed_device);
+}
+
+// Records how late the slowest worker of a replicated execution completed,
+// compared to the fastest one.
+void RecordStraggler(
+    const std::vector<std::pair<int64, std::string>>& completion_times) {
+  if (completion_times.size() < 2) {
+    return;
+  }
+  static metrics::Metric* metric =
+      new metrics::Metric("XrtStragglerLag", metrics::MetricFnTime);
+  auto min_max =
+      std::minmax_element(completion_times.begin(), completion_times.end());
+  int64 lag = min_max.second->first - min_max.first->first;
+  metric->AddSample(lag);
+  TF_VLOG(3) << "Slowest execution worker " << min_max.second->second
+             << " lagged " << lag / 1000000.0 << "ms behind "
+             << min_max.first->second;
+}
+
+// The outcome of a read issued on more than one session. The first successful
+// read wins, and the read fails only if all the issued ones do.
+class HedgedRead {
+ public:
+  void AddPending() {
+    std::lock_guard<std::mutex> lock(lock_);
+    ++pending_;
+  }
+
+  void Complete(tensorflow::Status status,
+                std::vector<tensorflow::Tensor> outputs, bool hedge) {
+    std::lock_guard<std::mutex> lock(lock_);
+    --pending_;
+    if (done_) {
+      return;
+    }
+    if (status.ok()) {
+      outputs_ = std::move(outputs);
+      status_ = status;
+      done_ = true;
+      hedge_won_ = hedge;
+    } else {
+      if (error_.ok()) {
+        error_ = status;
+      }
+      if (pending_ == 0) {
+        status_ = error_;
+        done_ = true;
+      }
+    }
+    if (done_) {
+      cv_.notify_all();
+    }
+  }
+
+  bool WaitFor(int64 wait_ms) {
+    std::unique_lock<std::mutex> lock(lock_);
+    return cv_.wait_for(lock, std::chrono::milliseconds(wait_ms),
+                        [this] { return done_; });
+  }
+
+  std::vector<tensorflow::Tensor> Wait() {
+    std::unique_lock<std::mutex> lock(lock_);
+    cv_.wait(lock, [this] { return done_; });
+    XLA_CHECK_OK(status_);
+    if (hedge_won_) {
+      XLA_COUNTER("XrtHedgedReadWins", 1);
+    }
+    return std::move(outputs_);
+  }
+
+ private:
+  std::mutex lock_;
+  std::condition_variable cv_;
+  size_t pending_ = 0;
+  bool done_ = false;
+  bool hedge_won_ = false;
+  tensorflow::Status status_;
+  tensorflow::Status error_;
+  std::vector<tensorflow::Tensor> outputs_;
+};
+
+// Returns the indices of the tuple outputs small enough to be read back
+// together with the execution.
+std::vector<int64> GetInlineResultIndices(
+    const Shape& result_shape,
+    const ComputationClient::ExecuteComputationOptions& options) {
+  static const size_t kMaxInlineResults = 8;
+  std::vector<int64> indices;
+  if (options.inline_result_bytes > 0 && options.explode_tuple &&
+      result_shape.IsTuple()) {
+    for (int64 i = 0; i < ShapeUtil::TupleElementCount(result_shape) &&
+                      indices.size() < kMaxInlineResults;
+         ++i) {
+      const Shape& shape = ShapeUtil::GetTupleElementShape(result_shape, i);
+      if (shape.IsArray() &&
+          ShapeUtil::ByteSizeOf(shape) <= options.inline_result_bytes) {
+        indices.push_back(i);
+      }
+    }
+  }
+  return indices;
+}
+
+// Runs the functions concurrently, the last one within the calling thread, and
+// waits for all of them. The first exception thrown is re-thrown.
+void RunConcurrently(std::vector<std::function<void()>> fns) {
+  if (fns.empty()) {
+    return;
+  }
+  util::MultiWait mwait(fns.size() - 1);
+  for (size_t i = 0; i + 1 < fns.size(); ++i) {
+    env::ScheduleIoClosure(mwait.Completer(std::move(fns[i])));
+  }
+  std::exception_ptr exptr;
+  try {
+    fns.back()();
+  } catch (...) {
+    exptr = std::current_exception();
+  }
+  // The functions running on the IO pool reference the caller state, so they
+  // must complete before any exception unwinds it.
+  mwait.Wait();
+  if (exptr) {
+    std::rethrow_exception(exptr);
+  }
+}
+
 }  // namespace
 
 XrtComputationClient::Device::Device(const std::string& device_str) {
@@ -221,10 +488,107 @@ XrtComputationClient::Device::Device(const std::string& device_str) {
   ordinal = std::stoi(parts[1]);
 }
 
+XrtComputationClient::CompilationCacheKey::CompilationCacheKey(
+    std::string domain, const std::string& serialized_computation)
+    : domain(std::move(domain)),
+      fingerprint(util::DataHash(serialized_computation.data(),
+                                 serialized_computation.size())) {
+  static const bool verify_cache =
+      sys_util::GetEnvBool("XRT_VERIFY_COMPILATION_CACHE", false);
+  if (verify_cache) {
+    this->serialized_computation = serialized_computation;
+  }
+}
+
+XrtComputationClient::XrtTupleResult::XrtTupleResult(
+    XrtComputationClient* self, std::string device, Shape shape, int64 handle)
+    : self(self),
+      device(std::move(device)),
+      shape(std::move(shape)),
+      element_handles(ShapeUtil::TupleElementCount(this->shape)),
+      element_refs(element_handles.size(), 0) {
+  // The whole tuple size is accounted to the tuple handle, so the elements
+  // surviving it are not accounted once it gets released.
+  handle_ptr = std::make_shared<XrtHandle>(
+      handle, [self, device = this->device, handle,
+               size = self->TrackDataAllocation(this->device, this->shape)]() {
+        self->ReleaseXrtData(device, handle, size);
+      });
+}
+
+void XrtComputationClient::XrtTupleResult::AddRef(int64 index) {
+  std::lock_guard<std::mutex> slock(lock);
+  element_refs[index] += 1;
+  if (element_refs[index] == 1 && element_handles[index] == nullptr) {
+    pending += 1;
+  }
+}
+
+void XrtComputationClient::XrtTupleResult::ReleaseRef(int64 index) {
+  // The handles are released outside the lock, as their releasers might
+  // trigger the release of the device memory.
+  XrtHandlePtr element_handle;
+  XrtHandlePtr tuple_handle;
+  {
+    std::lock_guard<std::mutex> slock(lock);
+    element_refs[index] -= 1;
+    if (element_refs[index] == 0) {
+      element_handle = std::move(element_handles[index]);
+      if (element_handle == nullptr) {
+        pending -= 1;
+        if (pending == 0) {
+          tuple_handle = std::move(handle_ptr);
+        }
+      }
+    }
+  }
+}
+
+int64 XrtComputationClient::XrtTupleResult::GetElementHandle(int64 index) {
+  {
+    std::lock_guard<std::mutex> slock(lock);
+    if (element_handles[index] != nullptr) {
+      return element_handles[index]->handle;
+    }
+  }
+  XLA_COUNTER("XrtTupleElementSingleMaterialize", 1);
+  std::pair<XrtTupleResult*, int64> element(this, index);
+  self->MaterializeTupleElements({element});
+  std::lock_guard<std::mutex> slock(lock);
+  return element_handles[index]->handle;
+}
+
+XrtComputationClient::XrtData::XrtData(std::shared_ptr<XrtTupleResult> tuple,
+                                       int64 tuple_index)
+    : Data(tuple->device,
+           ShapeUtil::GetTupleElementShape(tuple->shape, tuple_index)),
+      tuple(std::move(tuple)),
+      tuple_index(tuple_index) {
+  static std::atomic<int64> next_lazy_id(1);
+  lazy_id = next_lazy_id.fetch_add(1);
+  this->tuple->AddRef(tuple_index);
+}
+
+XrtComputationClient::XrtData::~XrtData() {
+  if (tuple != nullptr) {
+    tuple->ReleaseRef(tuple_index);
+  }
+}
+
 void XrtComputationClient::XrtData::Assign(const Data& data) {
   const XrtData& xrt_data = dynamic_cast<const XrtData&>(data);
   if (&xrt_data != this) {
+    if (xrt_data.tuple != nullptr) {
+      xrt_data.tuple->AddRef(xrt_data.tuple_index);
+    }
+    if (tuple != nullptr) {
+      tuple->ReleaseRef(tuple_index);
+    }
     handle_ptr = xrt_data.handle_ptr;
+    host_value = xrt_data.host_value;
+    tuple = xrt_data.tuple;
+    tuple_index = xrt_data.tuple_index;
+    lazy_id = xrt_data.lazy_id;
   }
 }
 
@@ -233,13 +597,19 @@ XrtComputationClient::XrtComputationClient(
     std::unique_ptr<tensorflow::tpu::TopologyProto> topology_proto)
     : options_(std::move(options)),
       compilation_cache_(sys_util::GetEnvInt("XLA_COMPILATION_CACHE_SIZE", 64)),
+      chained_plan_cache_(
+          sys_util::GetEnvInt("XRT_CHAINED_PLAN_CACHE_SIZE", 256)),
       rng_seed_(0x5a2d296e9) {
+  XLA_TIMED("XrtClientStartup");
   tensorflow::ConfigProto config = CreateConfigProto(options_);
   std::string local_target = GetLocalTarget(options_);
   session_cache_ = absl::make_unique<XrtSessionCache>(
       config, [this](XrtSession* s) { InitSession(s); }, local_target);
   alloc_session_cache_ =
       absl::make_unique<XrtSessionCache>(config, nullptr, local_target);
+  pinned_gpu_transfers_ =
+      !local_target.empty() &&
+      sys_util::GetEnvBool("XRT_GPU_PINNED_TRANSFERS", true);
 
   auto default_device_target =
       options_.global_device_map.find(options_.default_device);
@@ -263,7 +633,22 @@ XrtComputationClient::XrtComputationClient(
   }
   TF_VLOG(1) << "XRT default device: " << options_.default_device;
   MaybeCreateLocalService(options_);
-  InitializeDevices(std::move(topology_proto));
+  MaybeCreateMeshService();
+  // Configuring the TPU system to fetch its topology is the slowest startup
+  // step, so the sessions get pre-warmed meanwhile.
+  auto topology =
+      std::make_shared<std::unique_ptr<tensorflow::tpu::TopologyProto>>(
+          std::move(topology_proto));
+  env::Completion topology_completion =
+      env::ScheduleIoClosureWithCompletion([this, topology]() {
+        if (*topology == nullptr) {
+          *topology = FetchTopology();
+        }
+      });
+  Status prewarm_status = util::CheckedCall([this]() { PrewarmSessions(); });
+  topology_completion.Wait();
+  XLA_CHECK_OK(prewarm_status);
+  InitializeDevices(std::move(*topology));
   StartHandleReleaser();
 }
 
@@ -296,6 +681,197 @@ std::vector<size_t> XrtComputationClient::PartitionTransferToServer(
 
 std::vector<ComputationClient::DataPtr> XrtComputationClient::TransferToServer(
     absl::Span<const TensorSource> tensors) {
+  int64 stream_threshold = GetStreamTransferThreshold();
+  int64 pack_max_bytes = GetPackTransferMaxBytes();
+  std::vector<size_t> streamed_indices;
+  std::map<std::string, std::vector<size_t>> device_packed_indices;
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    int64 size = ShapeUtil::ByteSizeOfElements(tensors[i].shape);
+    if (size > stream_threshold) {
+      streamed_indices.push_back(i);
+    } else if (size <= pack_max_bytes &&
+               IsPackableType(tensors[i].shape.element_type())) {
+      device_packed_indices[GetEffectiveDevice(tensors[i].device)].push_back(
+          i);
+    }
+  }
+  std::vector<bool> special(tensors.size(), false);
+  for (auto index : streamed_indices) {
+    special[index] = true;
+  }
+  std::vector<std::vector<size_t>> packed_groups;
+  for (auto& device_indices : device_packed_indices) {
+    // A single small tensor gains nothing from packing.
+    if (device_indices.second.size() > 1) {
+      for (auto index : device_indices.second) {
+        special[index] = true;
+      }
+      packed_groups.push_back(std::move(device_indices.second));
+    }
+  }
+  if (streamed_indices.empty() && packed_groups.empty()) {
+    return TransferToServerPartitioned(tensors);
+  }
+
+  std::vector<TensorSource> regular_tensors;
+  std::vector<size_t> regular_indices;
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    if (!special[i]) {
+      regular_tensors.push_back(tensors[i]);
+      regular_indices.push_back(i);
+    }
+  }
+  // Every packed group (one per device) and the regular tensors are sent
+  // concurrently, each with its own sessions. The regular tensors go last, so
+  // that they are sent by the calling thread, as they use the IO thread pool
+  // themselves.
+  std::vector<DataPtr> results(tensors.size());
+  std::vector<std::function<void()>> senders;
+  for (auto& packed_indices : packed_groups) {
+    senders.push_back([&, indices = &packed_indices]() {
+      std::vector<TensorSource> packed_tensors;
+      for (auto index : *indices) {
+        packed_tensors.push_back(tensors[index]);
+      }
+      auto packed_results = TransferToServerPacked(packed_tensors);
+      for (size_t i = 0; i < packed_results.size(); ++i) {
+        results[(*indices)[i]] = std::move(packed_results[i]);
+      }
+    });
+  }
+  if (!regular_tensors.empty()) {
+    senders.push_back([&]() {
+      auto regular_results = TransferToServerPartitioned(regular_tensors);
+      for (size_t i = 0; i < regular_results.size(); ++i) {
+        results[regular_indices[i]] = std::move(regular_results[i]);
+      }
+    });
+  }
+  RunConcurrently(std::move(senders));
+  for (auto index : streamed_indices) {
+    results[index] = TransferToServerStreamed(tensors[index]);
+  }
+  return results;
+}
+
+std::vector<ComputationClient::DataPtr>
+XrtComputationClient::TransferToServerPacked(
+    absl::Span<const TensorSource> tensors) {
+  metrics::TimedSection timed(TransferToServerMetric());
+  std::string device = GetEffectiveDevice(tensors.front().device);
+  const std::string& xrt_device = TorchDeviceToXrtDevice(device);
+  std::vector<Shape> shapes;
+  size_t total_size = 0;
+  for (auto& tensor : tensors) {
+    shapes.push_back(tensor.shape);
+    total_size += ShapeUtil::ByteSizeOfElements(tensor.shape);
+  }
+  std::string packed(total_size, 0);
+  size_t offset = 0;
+  for (auto& tensor : tensors) {
+    size_t size = ShapeUtil::ByteSizeOfElements(tensor.shape);
+    if (tensor.data != nullptr) {
+      std::memcpy(&packed[offset], tensor.data, size);
+    } else {
+      tensor.populate_fn(tensor, &packed[offset], size);
+    }
+    offset += size;
+  }
+  XLA_COUNTER("XrtPackedTransferTensors", tensors.size());
+  XLA_COUNTER("XrtPackedTransferBytes", total_size);
+  OutboundDataMetric()->AddSample(total_size);
+
+  XrtSessionCache::SessionMap session_map;
+  XrtSession* session = GetSessionForXrtDevice(alloc_session_cache_.get(),
+                                               xrt_device, &session_map);
+  const XrtSession::CachedNode& cached_node =
+      GetPackedAllocateNode(session, xrt_device, device, shapes);
+  tensorflow::ClientSession::FeedType feed_inputs;
+  feed_inputs.insert({cached_node.holders[0], std::move(packed)});
+  std::vector<tensorflow::Tensor> outputs;
+  XLA_CHECK_OK(session->Run(feed_inputs, cached_node.outputs, &outputs));
+  XLA_CHECK_EQ(outputs.size(), tensors.size());
+
+  std::vector<DataPtr> results;
+  for (size_t i = 0; i < outputs.size(); ++i) {
+    results.push_back(std::make_shared<XrtData>(
+        this, device, tensors[i].shape, outputs[i].scalar<int64>()()));
+  }
+  CreateDataHandlesCounter()->AddValue(outputs.size());
+  return results;
+}
+
+ComputationClient::DataPtr XrtComputationClient::TransferToServerStreamed(
+    const TensorSource& tensor) {
+  XLA_COUNTER("XrtStreamedTransferToServer", 1);
+  XLA_TIMED("XrtStreamedTransferToServerTime");
+  size_t size = ShapeUtil::ByteSizeOfElements(tensor.shape);
+  const char* data = static_cast<const char*>(tensor.data);
+  std::shared_ptr<void> data_owner = tensor.data_owner;
+  if (data == nullptr) {
+    void* buffer = tensorflow::port::AlignedMalloc(
+        size, tensorflow::Allocator::kAllocatorAlignment);
+    XLA_CHECK(buffer != nullptr) << "Unable to allocate " << size << " bytes";
+    data_owner = std::shared_ptr<void>(buffer, tensorflow::port::AlignedFree);
+    tensor.populate_fn(tensor, buffer, size);
+    data = static_cast<const char*>(buffer);
+  }
+
+  int64 element_size =
+      ShapeUtil::ByteSizeOfPrimitiveType(tensor.shape.element_type());
+  int64 num_elements = ShapeUtil::ElementsIn(tensor.shape);
+  int64 chunk_elements = GetStreamChunkElements(tensor.shape.element_type());
+  std::vector<TensorSource> chunks;
+  std::vector<int64> chunk_sizes;
+  for (int64 base = 0; base < num_elements; base += chunk_elements) {
+    int64 length = std::min(chunk_elements, num_elements - base);
+    const char* chunk_data = data + base * element_size;
+    auto populate_fn = [chunk_data](const TensorSource& source_tensor,
+                                    void* dest_buffer,
+                                    size_t dest_buffer_size) {
+      std::memcpy(dest_buffer, chunk_data, dest_buffer_size);
+    };
+    chunks.emplace_back(
+        ShapeUtil::MakeShape(tensor.shape.element_type(), {length}),
+        tensor.device, std::move(populate_fn));
+    chunks.back().data = chunk_data;
+    chunks.back().data_size = length * element_size;
+    chunks.back().data_owner = data_owner;
+    chunk_sizes.push_back(length);
+  }
+
+  // Every chunk is sent with its own TransferToServerInternal() call, so that
+  // they use different sessions, which are run concurrently.
+  util::MultiWait mwait(chunks.size());
+  std::vector<DataPtr> chunks_data(chunks.size());
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    auto sender = [&, i]() {
+      auto chunk_results = TransferToServerInternal(
+          absl::Span<const TensorSource>(&chunks[i], 1));
+      chunks_data[i] = std::move(chunk_results.front());
+    };
+    env::ScheduleIoClosure(mwait.Completer(std::move(sender)));
+  }
+  mwait.Wait();
+
+  // The compilation cache takes care of not recompiling the assemble
+  // computation, for tensors of the same shape.
+  std::string device = GetEffectiveDevice(tensor.device);
+  std::vector<CompileInstance> instances;
+  instances.emplace_back(
+      CreateStreamAssembleComputation(tensor.shape, chunk_sizes), device,
+      std::vector<std::string>({device}), &tensor.shape);
+  std::vector<ComputationPtr> computations = Compile(std::move(instances));
+  std::vector<DataPtr> results =
+      ExecuteComputation(*computations.front(), chunks_data, device,
+                         ExecuteComputationOptions());
+  XLA_CHECK_EQ(results.size(), 1);
+  return std::move(results.front());
+}
+
+std::vector<ComputationClient::DataPtr>
+XrtComputationClient::TransferToServerPartitioned(
+    absl::Span<const TensorSource> tensors) {
   auto partitions = PartitionTransferToServer(tensors);
   if (partitions.size() == 1) {
     // Fast path in case of single partition. Avoid creating threads and
@@ -330,7 +906,11 @@ XrtComputationClient::TransferToServerInternal(
   metrics::TimedSection timed(TransferToServerMetric());
 
   std::mutex lock;
-  XrtSessionCache::SessionMap session_map;
+  // Every device gets its own session, even when sharing the worker with other
+  // devices, so that the tensors of a batch sharded across devices are sent
+  // with concurrent session runs, and the upload time does not grow with the
+  // number of devices.
+  std::map<std::string, XrtSessionCache::SessionMap> device_session_maps;
   int64 total_size = 0;
   util::MultiWait mwait(tensors.size());
   std::map<XrtSession*, SessionWork> session_work_map;
@@ -341,28 +921,65 @@ XrtComputationClient::TransferToServerInternal(
       auto converter = [&, i]() {
         std::string device = GetEffectiveDevice(tensors[i].device);
         const std::string& xrt_device = TorchDeviceToXrtDevice(device);
-        tensorflow::Tensor tensor(
-            TensorAllocator::Get(),
-            XlaTypeToDataType(tensors[i].shape.element_type()),
-            MakeEquivalentTensorShape(tensors[i].shape));
+        tensorflow::Tensor tensor;
+        tensorflow::Allocator* staging_allocator = GetStagingAllocator(device);
+        if (tensors[i].data != nullptr && staging_allocator == nullptr) {
+          XLA_COUNTER("XrtLentTransferToServer", 1);
+          LentTensorBuffer* buffer =
+              new LentTensorBuffer(tensors[i].data, tensors[i].data_size,
+                                   tensors[i].data_owner);
+          tensor = tensorflow::Tensor(
+              XlaTypeToDataType(tensors[i].shape.element_type()),
+              MakeEquivalentTensorShape(tensors[i].shape), buffer);
+          buffer->Unref();
+        } else {
+          tensor = tensorflow::Tensor(
+              staging_allocator != nullptr ? staging_allocator
+                                           : TensorAllocator::Get(),
+              XlaTypeToDataType(tensors[i].shape.element_type()),
+              MakeEquivalentTensorShape(tensors[i].shape));
+          auto tensor_data = tensor.tensor_data();
+          char* buffer = const_cast<char*>(tensor_data.data());
+          if (tensors[i].data != nullptr) {
+            // Pageable memory would be copied through a bounce buffer anyway,
+            // by the driver and synchronously.
+            XLA_COUNTER("XrtStagedTransferToServer", 1);
+            std::memcpy(buffer, tensors[i].data, tensor_data.size());
+          } else {
+            tensors[i].populate_fn(tensors[i], buffer, tensor_data.size());
+          }
+        }
         auto tdata = tensor.tensor_data();
-        tensors[i].populate_fn(tensors[i], const_cast<char*>(tdata.data()),
-                               tdata.size());
+        std::string compressed;
+        bool shuffled =
+            MaybeCompressTransfer(xrt_device, device, tensors[i].shape,
+                                  absl::string_view(tdata.data(), tdata.size()),
+                                  &compressed);
 
         {
           std::lock_guard<std::mutex> slock(lock);
-          XrtSession* session = GetSessionForXrtDevice(
-              alloc_session_cache_.get(), xrt_device, &session_map);
+          XrtSession* session =
+              GetSessionForXrtDevice(alloc_session_cache_.get(), xrt_device,
+                                     &device_session_maps[device]);
           SessionWork* session_work = &session_work_map[session];
-          tensorflow::Scope device_scope =
-              session->root()->WithDevice(xrt_device);
-          const XrtSession::CachedNode& cached_node =
-              GetAllocateNode(session, device_scope, device, tensors[i].shape);
-          session_work->feed_inputs.insert({cached_node.holders[0], tensor});
-          session_work->outputs_handles.push_back(cached_node.outputs[0]);
+          if (compressed.empty()) {
+            tensorflow::Scope device_scope =
+                session->root()->WithDevice(xrt_device);
+            const XrtSession::CachedNode& cached_node = GetAllocateNode(
+                session, device_scope, device, tensors[i].shape);
+            session_work->feed_inputs.insert({cached_node.holders[0], tensor});
+            session_work->outputs_handles.push_back(cached_node.outputs[0]);
+            total_size += tdata.size();
+          } else {
+            const XrtSession::CachedNode& cached_node =
+                GetCompressedAllocateNode(session, xrt_device, device,
+                                          tensors[i].shape, shuffled);
+            total_size += compressed.size();
+            session_work->feed_inputs.insert(
+                {cached_node.holders[0], std::move(compressed)});
+            session_work->outputs_handles.push_back(cached_node.outputs[0]);
+          }
           session_work->index_mapping.push_back(i);
-
-          total_size += tdata.size();
         }
       };
       env::ScheduleClosure(mwait.Completer(std::move(converter)));
@@ -377,18 +994,25 @@ XrtComputationClient::TransferToServerInternal(
     XrtSession* session = session_session_work.first;
     SessionWork* session_work = &session_session_work.second;
     auto runner = [&, session, session_work]() {
+      int64 start_ns = sys_util::NowNs();
       std::vector<tensorflow::Tensor> outputs;
-      XLA_CHECK_OK(session->session()->Run(
-          session_work->feed_inputs, session_work->outputs_handles, &outputs));
+      XLA_CHECK_OK(session->Run(session_work->feed_inputs,
+                                session_work->outputs_handles, &outputs));
       XLA_CHECK_EQ(outputs.size(), session_work->outputs_handles.size());
 
+      int64 bytes = 0;
       for (size_t i = 0; i < outputs.size(); ++i) {
         size_t li = session_work->index_mapping[i];
         results[li] = std::make_shared<XrtData>(
             this, GetEffectiveDevice(tensors[li].device), tensors[li].shape,
             outputs[i].scalar<int64>()());
+        bytes += ShapeUtil::ByteSizeOfElements(tensors[li].shape);
       }
       CreateDataHandlesCounter()->AddValue(outputs.size());
+      metrics::RecordTransferEvent(
+          GetEffectiveDevice(
+              tensors[session_work->index_mapping.front()].device),
+          "H2D", start_ns, bytes);
     };
     env::ScheduleIoClosure(mwait.Completer(std::move(runner)));
   }
@@ -396,27 +1020,156 @@ XrtComputationClient::TransferToServerInternal(
   return results;
 }
 
+bool XrtComputationClient::MaybeCompressTransfer(const std::string& xrt_device,
+                                                 const std::string& device,
+                                                 const Shape& shape,
+                                                 absl::string_view data,
+                                                 std::string* compressed) {
+  const TransferCompressionConfig& config = GetTransferCompressionConfig();
+  if (!config.enabled || data.size() < config.min_size ||
+      !IsCompressibleType(shape.element_type()) ||
+      !IsTransferCompressionSupported(xrt_device, device)) {
+    return false;
+  }
+  XLA_TIMED("XrtTransferCompressTime");
+  size_t element_size =
+      ShapeUtil::ByteSizeOfPrimitiveType(shape.element_type());
+  bool shuffled = element_size > 1;
+  auto make_payload = [&](absl::string_view source, std::string* payload) {
+    if (shuffled) {
+      payload->resize(source.size());
+      ShuffleBytePlanes(source, element_size, &(*payload)[0]);
+    } else {
+      payload->assign(source.data(), source.size());
+    }
+  };
+  auto pays_off = [&](size_t compressed_size, size_t size) {
+    return compressed_size <= config.max_ratio * size;
+  };
+  // Compress a leading sample first, to avoid spending the CPU time to
+  // compress the whole tensor when it does not pay off.
+  size_t sample_size = std::min<size_t>(data.size(), config.sample_size);
+  sample_size -= sample_size % element_size;
+  if (sample_size > 0 && sample_size < data.size()) {
+    std::string sample;
+    std::string compressed_sample;
+    make_payload(data.substr(0, sample_size), &sample);
+    if (!ZlibCompress(sample, config.level, &compressed_sample) ||
+        !pays_off(compressed_sample.size(), sample.size())) {
+      XLA_COUNTER("XrtTransferCompressionSkipped", 1);
+      return false;
+    }
+  }
+  std::string payload;
+  make_payload(data, &payload);
+  if (!ZlibCompress(payload, config.level, compressed) ||
+      !pays_off(compressed->size(), payload.size())) {
+    XLA_COUNTER("XrtTransferCompressionSkipped", 1);
+    compressed->clear();
+    return false;
+  }
+  XLA_COUNTER("XrtCompressedTransfers", 1);
+  XLA_VALUE_METRIC("XrtTransferCompressionRatio",
+                   static_cast<double>(compressed->size()) / payload.size());
+  return shuffled;
+}
+
+tensorflow::Allocator* XrtComputationClient::GetStagingAllocator(
+    const std::string& device) const {
+  if (!pinned_gpu_transfers_ || device.compare(0, 4, "GPU:") != 0) {
+    return nullptr;
+  }
+  return GpuStagingAllocator::Get();
+}
+
+bool XrtComputationClient::IsTransferCompressionSupported(
+    const std::string& xrt_device, const std::string& device) {
+  std::string worker_device = GetWorkerCpuDevice(xrt_device);
+  std::lock_guard<std::mutex> lock(compression_lock_);
+  auto it = compression_support_.find(worker_device);
+  if (it != compression_support_.end()) {
+    return it->second;
+  }
+  // Negotiate the compression by having the worker decompress a known payload.
+  // Workers lacking the decode kernels fall back to uncompressed transfers.
+  std::string payload(4096, 0);
+  for (size_t i = 0; i < payload.size(); ++i) {
+    payload[i] = static_cast<char>(i % 251);
+  }
+  std::string compressed;
+  XLA_CHECK(ZlibCompress(payload, Z_DEFAULT_COMPRESSION, &compressed));
+
+  XrtSessionCache::SessionMap session_map;
+  XrtSession* session = GetSessionForXrtDevice(alloc_session_cache_.get(),
+                                               xrt_device, &session_map);
+  const XrtSession::CachedNode& cached_node =
+      GetDecompressProbeNode(session, xrt_device, device);
+  std::vector<tensorflow::Tensor> outputs;
+  tensorflow::Status status =
+      session->Run({{cached_node.holders[0], compressed}},
+                   {cached_node.outputs[0]}, &outputs);
+  bool supported = status.ok() && outputs.size() == 1 &&
+                   outputs[0].tensor_data() == payload;
+  if (!supported) {
+    TF_LOG(WARNING) << "Transfer compression is not supported by "
+                    << worker_device << ": " << status;
+  }
+  TF_VLOG(1) << "Transfer compression for " << worker_device << ": "
+             << supported;
+  compression_support_.emplace(worker_device, supported);
+  return supported;
+}
+
 std::vector<Literal> XrtComputationClient::TransferFromServer(
     absl::Span<const DataPtr> handles) {
+  std::vector<Literal> results(handles.size());
+  TransferFromServerInternal(handles, GetMaxTensorsPartitionSize(),
+                             [&](size_t index, Literal literal) {
+                               results[index] = std::move(literal);
+                             });
+  return results;
+}
+
+void XrtComputationClient::TransferFromServer(absl::Span<const DataPtr> handles,
+                                              const LiteralFn& literal_fn) {
+  // Use smaller partitions, so that more reads are in flight, and the callers
+  // can start consuming the literals as soon as the first partitions land.
+  static int64 stream_partition_size =
+      sys_util::GetEnvInt("XRT_STREAM_READ_PARTITION", 64 * 1024 * 1024);
+  TransferFromServerInternal(
+      handles, std::min(stream_partition_size, GetMaxTensorsPartitionSize()),
+      literal_fn);
+}
+
+void XrtComputationClient::TransferFromServerInternal(
+    absl::Span<const DataPtr> handles, int64 max_partition_size,
+    const LiteralFn& literal_fn) {
   metrics::TimedSection timed(TransferFromServerMetric());
+  MaterializeLazyData(handles);
 
-  int64 max_partition_size = GetMaxTensorsPartitionSize();
-  std::list<XrtSessionCache::SessionMap> session_maps;
+  // Hedged reads can outlive this call, so the sessions are shared with them.
+  auto session_maps =
+      std::make_shared<std::list<XrtSessionCache::SessionMap>>();
   int64 current_size = 0;
-  session_maps.emplace_back();
+  session_maps->emplace_back();
   std::map<XrtSession*, SessionWork> session_work_map;
   for (size_t i = 0; i < handles.size(); ++i) {
     const XrtData& xrt_data = dynamic_cast<const XrtData&>(*handles[i]);
+    if (xrt_data.host_value != nullptr) {
+      XLA_COUNTER("XrtInlineResultReads", 1);
+      literal_fn(i, xrt_data.host_value->Clone());
+      continue;
+    }
 
     int64 shape_size = ShapeUtil::ByteSizeOfElements(xrt_data.shape());
     if (current_size + shape_size >= max_partition_size) {
-      session_maps.emplace_back();
+      session_maps->emplace_back();
       current_size = 0;
     }
     current_size += shape_size;
 
     XrtSession* session = GetSessionForDevice(
-        session_cache_.get(), xrt_data.device(), &session_maps.back());
+        session_cache_.get(), xrt_data.device(), &session_maps->back());
     SessionWork* session_work = &session_work_map[session];
     tensorflow::Scope device_scope =
         session->root()->WithDevice(TorchDeviceToXrtDevice(xrt_data.device()));
@@ -430,51 +1183,180 @@ std::vector<Literal> XrtComputationClient::TransferFromServer(
 
   util::MultiWait mwait(session_work_map.size());
   std::atomic<int64> total_size(0);
-  std::vector<Literal> results(handles.size());
   for (auto& session_session_work : session_work_map) {
     XrtSession* session = session_session_work.first;
     SessionWork* session_work = &session_session_work.second;
     auto runner = [&, session, session_work]() {
-      std::vector<tensorflow::Tensor> outputs;
-      XLA_CHECK_OK(session->session()->Run(
-          session_work->feed_inputs, session_work->outputs_handles, &outputs));
+      int64 start_ns = sys_util::NowNs();
+      std::vector<tensorflow::Tensor> outputs =
+          ReadHandles(session, *session_work, handles, session_maps);
       XLA_CHECK_EQ(outputs.size(), session_work->outputs_handles.size());
 
+      int64 bytes = 0;
       for (size_t i = 0; i < outputs.size(); ++i) {
         size_t li = session_work->index_mapping[i];
         LiteralProto response = ParseProto<LiteralProto>(outputs[i]);
-        results[li] =
+        Literal literal =
             std::move(Literal::CreateFromProto(response).ValueOrDie());
-        total_size += results[li].size_bytes();
+        bytes += literal.size_bytes();
+        literal_fn(li, std::move(literal));
       }
+      total_size += bytes;
+      metrics::RecordTransferEvent(
+          handles[session_work->index_mapping.front()]->device(), "D2H",
+          start_ns, bytes);
     };
     env::ScheduleIoClosure(mwait.Completer(std::move(runner)));
   }
   mwait.Wait();
   InboundDataMetric()->AddSample(total_size.load());
+}
+
+std::vector<tensorflow::Tensor> XrtComputationClient::ReadHandles(
+    XrtSession* session, const SessionWork& session_work,
+    absl::Span<const DataPtr> handles, std::shared_ptr<void> session_owner) {
+  static const int64 hedge_ms = sys_util::GetEnvInt("XRT_HEDGED_READ_MS", 0);
+  if (hedge_ms <= 0) {
+    std::vector<tensorflow::Tensor> outputs;
+    XLA_CHECK_OK(session->Run(session_work.feed_inputs,
+                              session_work.outputs_handles, &outputs));
+    return outputs;
+  }
+  auto read = std::make_shared<HedgedRead>();
+  auto issue_read = [read](XrtSession* session,
+                           tensorflow::ClientSession::FeedType feed_inputs,
+                           std::vector<tensorflow::Output> outputs_handles,
+                           std::shared_ptr<void> session_owner, bool hedge) {
+    read->AddPending();
+    auto runner = [read, session, feed_inputs = std::move(feed_inputs),
+                   outputs_handles = std::move(outputs_handles),
+                   session_owner = std::move(session_owner), hedge]() {
+      std::vector<tensorflow::Tensor> outputs;
+      tensorflow::Status status =
+          session->Run(feed_inputs, outputs_handles, &outputs);
+      read->Complete(std::move(status), std::move(outputs), hedge);
+    };
+    env::ScheduleIoClosure(std::move(runner));
+  };
+  issue_read(session, session_work.feed_inputs, session_work.outputs_handles,
+             std::move(session_owner), /*hedge=*/false);
+  if (!read->WaitFor(hedge_ms)) {
+    // Reads are idempotent, so the same handles can be read again. The data
+    // lives only on the worker owning it, so the hedged read targets the same
+    // worker, through another session.
+    XLA_COUNTER("XrtHedgedReads", 1);
+    auto hedge_session_map = std::make_shared<XrtSessionCache::SessionMap>();
+    XrtSession* hedge_session = nullptr;
+    tensorflow::ClientSession::FeedType feed_inputs;
+    std::vector<tensorflow::Output> outputs_handles;
+    for (auto index : session_work.index_mapping) {
+      const XrtData& xrt_data = dynamic_cast<const XrtData&>(*handles[index]);
+      if (hedge_session == nullptr) {
+        hedge_session = GetSessionForDevice(
+            session_cache_.get(), xrt_data.device(), hedge_session_map.get());
+      }
+      tensorflow::Scope device_scope = hedge_session->root()->WithDevice(
+          TorchDeviceToXrtDevice(xrt_data.device()));
+      const XrtSession::CachedNode& cached_node =
+          GetReadNode(hedge_session, device_scope, xrt_data.device());
+      feed_inputs.insert({cached_node.holders[0], xrt_data.get_handle()});
+      outputs_handles.push_back(cached_node.outputs[0]);
+    }
+    issue_read(hedge_session, std::move(feed_inputs),
+               std::move(outputs_handles), std::move(hedge_session_map),
+               /*hedge=*/true);
+  }
+  return read->Wait();
+}
+
+std::vector<ComputationClient::DataPtr> XrtComputationClient::CopyDataToDevice(
+    absl::Span<const DataPtr> handles, absl::Span<const std::string> devices) {
+  XLA_CHECK_EQ(handles.size(), devices.size());
+  XLA_TIMED("XrtCopyDataToDevice");
+
+  XrtSessionCache::SessionMap session_map;
+  std::map<XrtSession*, SessionWork> session_work_map;
+  std::vector<std::string> dest_devices(handles.size());
+  for (size_t i = 0; i < handles.size(); ++i) {
+    const XrtData& xrt_data = dynamic_cast<const XrtData&>(*handles[i]);
+    dest_devices[i] = GetEffectiveDevice(devices[i]);
+    // The copy graph runs on the worker owning both devices, moving the data
+    // through the worker host memory. Only descending layouts are copied, as
+    // those are the ones the read tensors are returned with.
+    if (!xrt_data.shape().IsArray() ||
+        !LayoutUtil::IsMonotonicWithDim0Major(xrt_data.shape().layout()) ||
+        GetResourceDomain(xrt_data.device()) !=
+            GetResourceDomain(dest_devices[i])) {
+      continue;
+    }
+    XrtSession* session = GetSessionForDevice(
+        session_cache_.get(), xrt_data.device(), &session_map);
+    SessionWork* session_work = &session_work_map[session];
+    const XrtSession::CachedNode& cached_node = GetCopyNode(
+        session, xrt_data.device(), dest_devices[i], xrt_data.shape());
+    session_work->feed_inputs.insert(
+        {cached_node.holders[0], xrt_data.get_handle()});
+    session_work->outputs_handles.push_back(cached_node.outputs[0]);
+    session_work->index_mapping.push_back(i);
+  }
+
+  util::MultiWait mwait(session_work_map.size());
+  std::vector<DataPtr> results(handles.size());
+  for (auto& session_session_work : session_work_map) {
+    XrtSession* session = session_session_work.first;
+    SessionWork* session_work = &session_session_work.second;
+    auto runner = [&, session, session_work]() {
+      std::vector<tensorflow::Tensor> outputs;
+      XLA_CHECK_OK(session->Run(session_work->feed_inputs,
+                                session_work->outputs_handles, &outputs));
+      XLA_CHECK_EQ(outputs.size(), session_work->outputs_handles.size());
+
+      for (size_t i = 0; i < outputs.size(); ++i) {
+        size_t li = session_work->index_mapping[i];
+        results[li] = std::make_shared<XrtData>(
+            this, dest_devices[li], handles[li]->shape(),
+            outputs[i].scalar<int64>()());
+      }
+      CreateDataHandlesCounter()->AddValue(outputs.size());
+    };
+    env::ScheduleIoClosure(mwait.Completer(std::move(runner)));
+  }
+  mwait.Wait();
   return results;
 }
 
 std::vector<ComputationClient::ComputationPtr> XrtComputationClient::Compile(
     std::vector<CompileInstance> instances) {
   metrics::TimedSection timed(CompileMetric());
+  for (auto& instance : instances) {
+    // The XRT compile configuration has no way to request the SPMD
+    // partitioner.
+    XLA_CHECK(!instance.is_sharded)
+        << "Sharded computations are not supported by the XRT client";
+  }
 
+  static const size_t max_worker_compiles =
+      sys_util::GetEnvInt("XRT_MAX_WORKER_COMPILES", 0);
   std::mutex lock;
   util::MultiWait mwait(instances.size());
   std::vector<ProgramShape> program_shapes(instances.size());
   std::vector<ComputationPtr> results(instances.size());
   std::vector<CompilationCacheKey> cache_keys(instances.size());
   XrtSessionCache::SessionMap session_map;
-  std::map<XrtSession*, SessionWork> session_work_map;
+  // The compilations of a session are split in chunks of at most
+  // max_worker_compiles, each run by its own session call.
+  std::map<XrtSession*, size_t> session_compiles;
+  std::map<std::pair<XrtSession*, size_t>, SessionWork> session_work_map;
   for (size_t i = 0; i < instances.size(); ++i) {
     auto builder = [&, this, i]() {
       const CompileInstance& instance = instances[i];
       std::unique_ptr<xrt::XLAComputation> xrt_computation =
           CreateXrtComputation(instance.computation, instance.devices,
                                instance.output_shape);
+      std::string serialized_computation = xrt_computation->SerializeAsString();
       CompilationCacheKey cache_key(
           GetResourceDomain(instance.compilation_device),
-          xrt_computation->SerializeAsString());
+          serialized_computation);
       auto computation_ptr = compilation_cache_.Get(cache_key);
       if (computation_ptr == nullptr) {
         cache_keys[i] = std::move(cache_key);
@@ -487,13 +1369,20 @@ std::vector<ComputationClient::ComputationPtr> XrtComputationClient::Compile(
           std::lock_guard<std::mutex> slock(lock);
           XrtSession* session = GetSessionForXrtDevice(
               session_cache_.get(), xrt_device, &session_map);
-          SessionWork* session_work = &session_work_map[session];
+          size_t chunk = session_compiles[session]++;
+          if (max_worker_compiles > 0) {
+            chunk /= max_worker_compiles;
+          } else {
+            chunk = 0;
+          }
+          SessionWork* session_work =
+              &session_work_map[std::make_pair(session, chunk)];
           tensorflow::Scope device_scope =
               session->root()->WithDevice(xrt_device);
           const XrtSession::CachedNode& cached_node = GetCompileNode(
               session, device_scope, instance.compilation_device);
           session_work->feed_inputs.insert(
-              {cached_node.holders[0], cache_keys[i].serialized_computation});
+              {cached_node.holders[0], std::move(serialized_computation)});
           session_work->outputs_handles.push_back(cached_node.outputs[0]);
           session_work->index_mapping.push_back(i);
         }
@@ -507,15 +1396,17 @@ std::vector<ComputationClient::ComputationPtr> XrtComputationClient::Compile(
   mwait.Reset(session_work_map.size());
 
   for (auto& session_and_work : session_work_map) {
-    XrtSession* session = session_and_work.first;
+    XrtSession* session = session_and_work.first.first;
     const SessionWork& session_work = session_and_work.second;
 
     auto session_runner = [&, this, session]() {
       std::vector<tensorflow::Tensor> outputs;
-      CheckCompileStatus(
-          session->session()->Run(session_work.feed_inputs,
-                                  session_work.outputs_handles, &outputs),
-          instances, session_work);
+      size_t count = session_work.outputs_handles.size();
+      AcquireCompileSlots(session->target(), count);
+      Status status = session->session()->Run(
+          session_work.feed_inputs, session_work.outputs_handles, &outputs);
+      ReleaseCompileSlots(session->target(), count);
+      CheckCompileStatus(status, instances, session_work);
       XLA_CHECK_EQ(outputs.size(), session_work.outputs_handles.size());
 
       double compile_time = timed.Elapsed();
@@ -540,6 +1431,38 @@ std::vector<ComputationClient::ComputationPtr> XrtComputationClient::Compile(
   return results;
 }
 
+void XrtComputationClient::AcquireCompileSlots(const std::string& target,
+                                               size_t count) {
+  static const size_t max_worker_compiles =
+      sys_util::GetEnvInt("XRT_MAX_WORKER_COMPILES", 0);
+  if (max_worker_compiles == 0) {
+    return;
+  }
+  std::unique_lock<std::mutex> slock(compile_slots_lock_);
+  size_t* compiles = &worker_compiles_[target];
+  if (*compiles > 0 && *compiles + count > max_worker_compiles) {
+    XLA_COUNTER("XrtThrottledCompiles", count);
+    compile_slots_cv_.wait(slock, [&] {
+      return *compiles == 0 || *compiles + count <= max_worker_compiles;
+    });
+  }
+  *compiles += count;
+}
+
+void XrtComputationClient::ReleaseCompileSlots(const std::string& target,
+                                               size_t count) {
+  static const size_t max_worker_compiles =
+      sys_util::GetEnvInt("XRT_MAX_WORKER_COMPILES", 0);
+  if (max_worker_compiles == 0) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> slock(compile_slots_lock_);
+    worker_compiles_[target] -= count;
+  }
+  compile_slots_cv_.notify_all();
+}
+
 void XrtComputationClient::CheckCompileStatus(
     const Status& status, const std::vector<CompileInstance>& instances,
     const SessionWork& session_work) {
@@ -561,23 +1484,51 @@ XrtComputationClient::ExecuteComputation(
   metrics::TimedSection timed(ExecuteMetric());
 
   XrtSessionCache::SessionMap session_map;
+  static const bool lazy_tuple_results =
+      sys_util::GetEnvBool("XRT_LAZY_TUPLE_RESULTS", false);
   std::string effective_device = GetEffectiveDevice(device);
+  const Shape& result_shape = computation.program_shape().result();
+  std::vector<int64> inline_indices =
+      GetInlineResultIndices(result_shape, options);
+  // Keeping the result as a single tuple allocation saves creating, and later
+  // releasing, one handle per output, for the outputs no execution consumes.
+  bool lazy_tuple = lazy_tuple_results && options.explode_tuple &&
+                    inline_indices.empty() && result_shape.IsTuple();
   tensorflow::ClientSession::FeedType feed_inputs;
-  std::vector<tensorflow::Output> exec_ops = CreateExecuteOps(
-      &session_map, dynamic_cast<const XrtComputation&>(computation),
-      BuildParallelArguments(arguments), options.explode_tuple,
-      {effective_device}, &feed_inputs);
+  std::vector<tensorflow::Output> exec_ops;
+  if (inline_indices.empty()) {
+    exec_ops = CreateExecuteOps(
+        &session_map, dynamic_cast<const XrtComputation&>(computation),
+        BuildParallelArguments(arguments),
+        options.explode_tuple && !lazy_tuple, {effective_device},
+        &feed_inputs);
+  } else {
+    exec_ops = CreateExecuteReadOps(
+        &session_map, dynamic_cast<const XrtComputation&>(computation),
+        arguments, inline_indices, effective_device, &feed_inputs);
+  }
 
   XrtSession* session =
       GetSessionForDevice(session_cache_.get(), effective_device, &session_map);
   std::vector<tensorflow::Tensor> outputs;
-  util::CheckComputationStatus(
-      session->session()->Run(feed_inputs, {exec_ops.front()}, &outputs),
-      {&computation.computation()}, {&computation.program_shape().result()});
-  XLA_CHECK_EQ(outputs.size(), 1);
-
-  return GetComputationResults(outputs[0], computation.program_shape().result(),
-                               effective_device);
+  util::CheckComputationStatus(session->Run(feed_inputs, exec_ops, &outputs),
+                               {&computation.computation()}, {&result_shape});
+  XLA_CHECK_EQ(outputs.size(), exec_ops.size());
+  ReleaseDonatedArguments(arguments, options.donated_arguments);
+
+  std::vector<DataPtr> results =
+      lazy_tuple
+          ? GetLazyTupleResults(outputs[0], result_shape, effective_device)
+          : GetComputationResults(outputs[0], result_shape, effective_device);
+  for (size_t i = 0; i < inline_indices.size(); ++i) {
+    LiteralProto response = ParseProto<LiteralProto>(outputs[i + 1]);
+    XrtData* xrt_data =
+        dynamic_cast<XrtData*>(results[inline_indices[i]].get());
+    xrt_data->host_value = std::make_shared<Literal>(
+        std::move(Literal::CreateFromProto(response).ValueOrDie()));
+  }
+  XLA_COUNTER("XrtInlineResults", inline_indices.size());
+  return results;
 }
 
 std::vector<std::vector<ComputationClient::DataPtr>>
@@ -596,8 +1547,12 @@ XrtComputationClient::ExecuteReplicated(
   std::vector<const Computation*> computations(devices.size());
   std::fill(computations.begin(), computations.end(), &computation);
 
-  return RunComputations(session_map, exec_ops, computations, devices,
-                         feed_inputs);
+  std::vector<std::vector<DataPtr>> results = RunComputations(
+      session_map, exec_ops, computations, devices, feed_inputs);
+  for (auto& replica_arguments : arguments) {
+    ReleaseDonatedArguments(replica_arguments, options.donated_arguments);
+  }
+  return results;
 }
 
 std::vector<std::vector<ComputationClient::DataPtr>>
@@ -630,6 +1585,9 @@ XrtComputationClient::RunComputations(
 
   util::MultiWait mwait(session_replicas.size());
   std::vector<std::vector<DataPtr>> results(devices.size());
+  std::mutex lock;
+  std::vector<std::pair<int64, std::string>> completion_times;
+  int64 start_time = sys_util::NowNs();
   for (auto& sess_replica : session_replicas) {
     XrtSession* session = sess_replica.first;
     const std::vector<size_t>& replicas = sess_replica.second;
@@ -646,7 +1604,7 @@ XrtComputationClient::RunComputations(
       }
       std::vector<tensorflow::Tensor> outputs;
       util::CheckComputationStatus(
-          session->session()->Run(feed_inputs, exec_nodes, &outputs),
+          session->Run(feed_inputs, exec_nodes, &outputs),
           xla_computations, output_shapes);
       XLA_CHECK_EQ(outputs.size(), exec_nodes.size());
 
@@ -656,10 +1614,14 @@ XrtComputationClient::RunComputations(
             outputs[i], computations[replica]->program_shape().result(),
             GetEffectiveDevice(devices[replica]));
       }
+      std::lock_guard<std::mutex> guard(lock);
+      completion_times.emplace_back(sys_util::NowNs() - start_time,
+                                    session->target());
     };
     env::ScheduleIoClosure(mwait.Completer(std::move(session_runner)));
   }
   mwait.Wait();
+  RecordStraggler(completion_times);
   return results;
 }
 
@@ -676,8 +1638,12 @@ XrtComputationClient::ExecuteParallel(
   std::vector<tensorflow::Output> exec_ops =
       CreateExecuteOps(&session_map, computations, arguments,
                        options.explode_tuple, devices, &feed_inputs);
-  return RunComputations(session_map, exec_ops, computations, devices,
-                         feed_inputs);
+  std::vector<std::vector<DataPtr>> results = RunComputations(
+      session_map, exec_ops, computations, devices, feed_inputs);
+  for (size_t i = 0; i < options.donated_arguments.size(); ++i) {
+    ReleaseDonatedArguments(arguments.at(i), options.donated_arguments[i]);
+  }
+  return results;
 }
 
 template <typename T>
@@ -701,6 +1667,27 @@ void XrtComputationClient::SetupExecConfig(const Device& device,
   }
 }
 
+tensorflow::Tensor XrtComputationClient::GetExecuteConfig(
+    const std::string& device, bool explode_tuple) {
+  auto key = std::make_tuple(device, explode_tuple, rng_seed_.load());
+  std::lock_guard<std::mutex> lock(exec_config_lock_);
+  auto it = exec_config_cache_.find(key);
+  if (it == exec_config_cache_.end()) {
+    xrt::XRTExecutionConfig exec_config;
+    exec_config.set_release_input_handles(false);
+    exec_config.set_release_compilation_handle(false);
+    exec_config.set_return_exploded_tuple(explode_tuple);
+    SetupExecConfig(Device(device), &exec_config);
+
+    tensorflow::Tensor config_tensor(tensorflow::DT_STRING,
+                                     tensorflow::TensorShape({}));
+    config_tensor.scalar<tensorflow::tstring>()() =
+        exec_config.SerializeAsString();
+    it = exec_config_cache_.emplace(key, std::move(config_tensor)).first;
+  }
+  return it->second;
+}
+
 std::vector<ComputationClient::DataPtr> XrtComputationClient::ExecuteChained(
     absl::Span<const ExecuteChainedOp> ops, const std::string& device) {
   static int64 split_mode = sys_util::GetEnvInt("XRT_SPLIT_CHAINED_EXEC", 0);
@@ -720,19 +1707,89 @@ std::vector<ComputationClient::DataPtr> XrtComputationClient::ExecuteChainedXrt(
       GetSessionForXrtDevice(session_cache_.get(), xrt_device, &session_map);
   tensorflow::Scope device_scope = session->root()->WithDevice(xrt_device);
 
+  std::shared_ptr<ChainedPlan> chained_plan =
+      GetChainedPlan(ops, effective_device);
+  std::string serialized_plan;
+  {
+    std::lock_guard<std::mutex> lock(chained_plan->lock);
+    for (auto op_index : chained_plan->data_ops) {
+      const XrtData& xrt_data =
+          dynamic_cast<const XrtData&>(*ops[op_index].device_data);
+      chained_plan->plan.mutable_ops(op_index)->set_data_handle(
+          xrt_data.get_handle());
+    }
+    serialized_plan = chained_plan->plan.SerializeAsString();
+  }
+
+  const XrtSession::CachedNode& cached_node =
+      GetExecuteChainedNode(session, device_scope, effective_device);
+  feed_inputs.insert({cached_node.holders[0], serialized_plan});
+  feed_inputs.insert(
+      {cached_node.holders[1], chained_plan->serialized_config});
+
+  std::vector<tensorflow::Tensor> outputs;
+  util::CheckComputationStatus(
+      session->Run(feed_inputs, {cached_node.outputs[0]}, &outputs), {}, {});
+  XLA_CHECK_EQ(outputs.size(), 1);
+
+  std::vector<DataPtr> results;
+  auto handles_vec = outputs[0].vec<int64>();
+  for (int64 i = 0; i < handles_vec.size(); ++i) {
+    results.push_back(std::make_shared<XrtData>(
+        this, effective_device, chained_plan->result_shapes.at(i),
+        handles_vec(i)));
+  }
+  CreateDataHandlesCounter()->AddValue(results.size());
+  return results;
+}
+
+std::shared_ptr<XrtComputationClient::ChainedPlan>
+XrtComputationClient::GetChainedPlan(absl::Span<const ExecuteChainedOp> ops,
+                                     const std::string& device) {
+  hash_t key = util::MHash(device, static_cast<size_t>(rng_seed_));
+  for (auto& op : ops) {
+    if (op.device_data != nullptr) {
+      key = util::HashCombine(
+          key, util::MHash(-1, ShapeUtil::Hash(op.device_data->shape())));
+    } else {
+      const XrtComputation& xrt_computation =
+          dynamic_cast<const XrtComputation&>(*op.computation);
+      key = util::HashCombine(key, util::MHash(xrt_computation.get_handle(),
+                                               op.inputs.size()));
+      for (auto& input : op.inputs) {
+        key = util::HashCombine(
+            key, util::MHash(input.op_index,
+                             input.output_index.value_or(ops.size())));
+      }
+    }
+    for (auto& output : op.outputs) {
+      key = util::HashCombine(
+          key, util::MHash(output.result_index,
+                           output.output_index.value_or(ops.size())));
+    }
+  }
+  std::shared_ptr<ChainedPlan> chained_plan = chained_plan_cache_.Get(key);
+  if (chained_plan != nullptr) {
+    XLA_COUNTER("XrtChainedPlanCacheHit", 1);
+    return chained_plan;
+  }
+  XLA_COUNTER("XrtChainedPlanCacheMiss", 1);
+
+  chained_plan = std::make_shared<ChainedPlan>();
   xrt::XRTChainedExecuteConfig exec_config;
   SetupExecConfig(Device(device), &exec_config);
+  chained_plan->serialized_config = exec_config.SerializeAsString();
 
-  xrt::XRTChainedExecutePlan plan;
-  std::vector<xla::Shape> result_shapes;
+  xrt::XRTChainedExecutePlan* plan = &chained_plan->plan;
+  std::vector<xla::Shape>* result_shapes = &chained_plan->result_shapes;
   for (size_t i = 0; i < ops.size(); ++i) {
     const ExecuteChainedOp& op = ops[i];
-    xrt::XRTChainedExecuteOp* plan_op = plan.add_ops();
+    xrt::XRTChainedExecuteOp* plan_op = plan->add_ops();
     const xla::Shape* op_shape = nullptr;
     if (op.device_data != nullptr) {
-      const XrtData& xrt_data = dynamic_cast<const XrtData&>(*op.device_data);
-      op_shape = &xrt_data.shape();
-      plan_op->set_data_handle(xrt_data.get_handle());
+      op_shape = &op.device_data->shape();
+      // The data handle is filled at every execution.
+      chained_plan->data_ops.push_back(i);
     } else {
       const XrtComputation& xrt_computation =
           dynamic_cast<const XrtComputation&>(*op.computation);
@@ -751,41 +1808,21 @@ std::vector<ComputationClient::DataPtr> XrtComputationClient::ExecuteChainedXrt(
     for (auto& output : op.outputs) {
       XLA_CHECK(op_shape != nullptr);
 
-      xrt::XRTChainedExecuteOp::Output* plan_output = plan_op->add_outputs();
-      plan_output->set_result_index(output.result_index);
-      if (output.result_index >= result_shapes.size()) {
-        result_shapes.resize(output.result_index + 1);
-      }
-      if (output.output_index) {
-        plan_output->set_output_index(*output.output_index + 1);
-        result_shapes[output.result_index] =
-            ShapeUtil::GetTupleElementShape(*op_shape, *output.output_index);
-      } else {
-        result_shapes[output.result_index] = *op_shape;
-      }
-    }
-  }
-
-  const XrtSession::CachedNode& cached_node =
-      GetExecuteChainedNode(session, device_scope, effective_device);
-  feed_inputs.insert({cached_node.holders[0], plan.SerializeAsString()});
-  feed_inputs.insert({cached_node.holders[1], exec_config.SerializeAsString()});
-
-  std::vector<tensorflow::Tensor> outputs;
-  util::CheckComputationStatus(
-      session->session()->Run(feed_inputs, {cached_node.outputs[0]}, &outputs),
-      {}, {});
-  XLA_CHECK_EQ(outputs.size(), 1);
-
-  std::vector<DataPtr> results;
-  auto handles_vec = outputs[0].vec<int64>();
-  for (int64 i = 0; i < handles_vec.size(); ++i) {
-    results.push_back(std::make_shared<XrtData>(this, effective_device,
-                                                std::move(result_shapes.at(i)),
-                                                handles_vec(i)));
+      xrt::XRTChainedExecuteOp::Output* plan_output = plan_op->add_outputs();
+      plan_output->set_result_index(output.result_index);
+      if (output.result_index >= result_shapes->size()) {
+        result_shapes->resize(output.result_index + 1);
+      }
+      if (output.output_index) {
+        plan_output->set_output_index(*output.output_index + 1);
+        (*result_shapes)[output.result_index] =
+            ShapeUtil::GetTupleElementShape(*op_shape, *output.output_index);
+      } else {
+        (*result_shapes)[output.result_index] = *op_shape;
+      }
+    }
   }
-  CreateDataHandlesCounter()->AddValue(results.size());
-  return results;
+  return chained_plan_cache_.Add(key, std::move(chained_plan));
 }
 
 std::vector<ComputationClient::DataPtr>
@@ -830,7 +1867,7 @@ XrtComputationClient::ExecuteChainedSplit(
 
       std::vector<tensorflow::Tensor> outputs;
       util::CheckComputationStatus(
-          session->session()->Run(feed_inputs, {exec_ops.front()}, &outputs),
+          session->Run(feed_inputs, {exec_ops.front()}, &outputs),
           {&op.computation->computation()},
           {&op.computation->program_shape().result()});
       XLA_CHECK_EQ(outputs.size(), 1);
@@ -895,9 +1932,9 @@ XrtComputationClient::DeconstructTuple(absl::Span<const DataPtr> tuples) {
   std::vector<std::vector<DataPtr>> results(tuples.size());
   for (auto& session_work : session_work_map) {
     std::vector<tensorflow::Tensor> outputs;
-    XLA_CHECK_OK(session_work.first->session()->Run(
-        session_work.second.feed_inputs, session_work.second.outputs_handles,
-        &outputs));
+    XLA_CHECK_OK(session_work.first->Run(session_work.second.feed_inputs,
+                                         session_work.second.outputs_handles,
+                                         &outputs));
     XLA_CHECK_EQ(outputs.size(), session_work.second.outputs_handles.size());
 
     size_t output_index = 0;
@@ -1005,14 +2042,32 @@ std::unique_ptr<xrt::XLAComputation> XrtComputationClient::CreateXrtComputation(
 }
 
 tensorflow::Tensor XrtComputationClient::GetArgumentsInputs(
-    absl::Span<const DataPtr> arguments, const std::string& device) {
-  tensorflow::Tensor inputs_tensor(tensorflow::DT_INT64,
-                                   tensorflow::TensorShape({arguments.size()}));
+    const XrtComputation& computation, absl::Span<const DataPtr> arguments,
+    const std::string& device) {
+  MaterializeLazyData(arguments);
+  // All the data objects are created by this client, so the static cast is
+  // safe, and saves a dynamic_cast per argument at every execution.
+  std::vector<int64> handles(arguments.size());
   for (size_t i = 0; i < arguments.size(); ++i) {
-    const XrtData& xrt_data = dynamic_cast<const XrtData&>(*arguments[i]);
+    const XrtData& xrt_data = static_cast<const XrtData&>(*arguments[i]);
     XLA_CHECK_EQ(device, xrt_data.device());
-    inputs_tensor.flat<tensorflow::int64>()(i) = xrt_data.get_handle();
+    handles[i] = xrt_data.get_handle();
   }
+  std::lock_guard<std::mutex> lock(computation.arguments_inputs_lock);
+  XrtComputation::ArgumentsInputs& inputs =
+      computation.arguments_inputs[device];
+  if (inputs.handles == handles) {
+    XLA_COUNTER("XrtArgumentsInputsCacheHit", 1);
+    return inputs.tensor;
+  }
+  // The cached tensor might still be in use by executions in flight, so a new
+  // one is created, rather than updating it.
+  tensorflow::Tensor inputs_tensor(tensorflow::DT_INT64,
+                                   tensorflow::TensorShape({arguments.size()}));
+  std::copy(handles.begin(), handles.end(),
+            inputs_tensor.flat<tensorflow::int64>().data());
+  inputs.handles = std::move(handles);
+  inputs.tensor = inputs_tensor;
   return inputs_tensor;
 }
 
@@ -1026,7 +2081,8 @@ std::vector<tensorflow::Output> XrtComputationClient::CreateExecuteOps(
   for (size_t i = 0; i < computations.size(); ++i) {
     const XrtComputation* xrt_computation =
         dynamic_cast<const XrtComputation*>(computations[i]);
-    auto inputs = GetArgumentsInputs(arguments[i], devices[i]);
+    auto inputs =
+        GetArgumentsInputs(*xrt_computation, arguments[i], devices[i]);
     const std::string& xrt_device = TorchDeviceToXrtDevice(devices[i]);
     XrtSession* session =
         GetSessionForXrtDevice(session_cache_.get(), xrt_device, session_map);
@@ -1036,14 +2092,8 @@ std::vector<tensorflow::Output> XrtComputationClient::CreateExecuteOps(
     feed_inputs->insert(
         {cached_node.holders[0], xrt_computation->get_handle()});
 
-    xrt::XRTExecutionConfig exec_config;
-    exec_config.set_release_input_handles(false);
-    exec_config.set_release_compilation_handle(false);
-    exec_config.set_return_exploded_tuple(explode_tuple);
-    SetupExecConfig(Device(devices[i]), &exec_config);
-
     feed_inputs->insert(
-        {cached_node.holders[1], exec_config.SerializeAsString()});
+        {cached_node.holders[1], GetExecuteConfig(devices[i], explode_tuple)});
     feed_inputs->insert({cached_node.holders[2], inputs});
 
     exec_ops.push_back(cached_node.outputs[0]);
@@ -1058,7 +2108,7 @@ std::vector<tensorflow::Output> XrtComputationClient::CreateExecuteOps(
     tensorflow::ClientSession::FeedType* feed_inputs) {
   std::vector<tensorflow::Output> exec_ops;
   for (size_t i = 0; i < arguments.size(); ++i) {
-    auto inputs = GetArgumentsInputs(arguments[i], devices[i]);
+    auto inputs = GetArgumentsInputs(computation, arguments[i], devices[i]);
     const std::string& xrt_device = TorchDeviceToXrtDevice(devices[i]);
     XrtSession* session =
         GetSessionForXrtDevice(session_cache_.get(), xrt_device, session_map);
@@ -1067,14 +2117,8 @@ std::vector<tensorflow::Output> XrtComputationClient::CreateExecuteOps(
         GetExecuteNode(session, device_scope, devices[i]);
     feed_inputs->insert({cached_node.holders[0], computation.get_handle()});
 
-    xrt::XRTExecutionConfig exec_config;
-    exec_config.set_release_input_handles(false);
-    exec_config.set_release_compilation_handle(false);
-    exec_config.set_return_exploded_tuple(explode_tuple);
-    SetupExecConfig(Device(devices[i]), &exec_config);
-
     feed_inputs->insert(
-        {cached_node.holders[1], exec_config.SerializeAsString()});
+        {cached_node.holders[1], GetExecuteConfig(devices[i], explode_tuple)});
     feed_inputs->insert({cached_node.holders[2], inputs});
 
     exec_ops.push_back(cached_node.outputs[0]);
@@ -1082,6 +2126,33 @@ std::vector<tensorflow::Output> XrtComputationClient::CreateExecuteOps(
   return exec_ops;
 }
 
+std::vector<tensorflow::Output> XrtComputationClient::CreateExecuteReadOps(
+    XrtSessionCache::SessionMap* session_map,
+    const XrtComputation& computation, absl::Span<const DataPtr> arguments,
+    absl::Span<const int64> inline_indices, const std::string& device,
+    tensorflow::ClientSession::FeedType* feed_inputs) {
+  auto inputs = GetArgumentsInputs(computation, arguments, device);
+  const std::string& xrt_device = TorchDeviceToXrtDevice(device);
+  XrtSession* session =
+      GetSessionForXrtDevice(session_cache_.get(), xrt_device, session_map);
+  tensorflow::Scope device_scope = session->root()->WithDevice(xrt_device);
+  const XrtSession::CachedNode& cached_node = GetExecuteReadNode(
+      session, device_scope, device, inline_indices.size());
+  feed_inputs->insert({cached_node.holders[0], computation.get_handle()});
+  feed_inputs->insert({cached_node.holders[1],
+                       GetExecuteConfig(device, /*explode_tuple=*/true)});
+  feed_inputs->insert({cached_node.holders[2], inputs});
+
+  tensorflow::Tensor indices_tensor(
+      tensorflow::DT_INT64, tensorflow::TensorShape({inline_indices.size()}));
+  auto flat_indices_tensor = indices_tensor.flat<tensorflow::int64>();
+  for (size_t i = 0; i < inline_indices.size(); ++i) {
+    flat_indices_tensor(i) = inline_indices[i];
+  }
+  feed_inputs->insert({cached_node.holders[3], indices_tensor});
+  return cached_node.outputs;
+}
+
 void XrtComputationClient::ReleaseHandles(
     std::vector<DeviceHandle>* handles,
     const std::function<const XrtSession::CachedNode&(
@@ -1094,6 +2165,7 @@ void XrtComputationClient::ReleaseHandles(
     released_handles.swap(*handles);
   }
   if (!released_handles.empty()) {
+    XLA_VALUE_METRIC("ReleaseHandlesBatchSize", released_handles.size());
     metrics::TimedSection timed(timed_metric);
 
     XrtSessionCache::SessionMap session_map;
@@ -1122,8 +2194,8 @@ void XrtComputationClient::ReleaseHandles(
       feed_inputs.insert({cached_node.holders[0], handles_tensor});
 
       std::vector<tensorflow::Tensor> outputs;
-      XLA_CHECK_OK(session->session()->Run(
-          feed_inputs, {}, {cached_node.operations[0]}, &outputs));
+      XLA_CHECK_OK(session->Run(feed_inputs, {}, {cached_node.operations[0]},
+                                &outputs));
     }
     destroy_counter->AddValue(released_handles.size());
   }
@@ -1136,9 +2208,35 @@ void XrtComputationClient::StartHandleReleaser() {
       std::max<size_t>(options_.devices.size(), kMinReleaserThreads));
   triggered_task_.reset(
       new util::TriggeredTask([this]() { HandleReleaser(); }, num_threads));
+  release_deadline_thread_.reset(
+      new std::thread([this]() { ReleaseDeadlineTimer(); }));
+}
+
+void XrtComputationClient::ReleaseDeadlineTimer() {
+  static const std::chrono::milliseconds deadline(
+      sys_util::GetEnvInt("XLA_HANDLE_RELEASE_DEADLINE_MS", 20));
+  std::unique_lock<std::mutex> lock(lock_);
+  while (true) {
+    release_cv_.wait(lock, [this] { return release_batch_count_ > 0; });
+    bool flushed = release_cv_.wait_until(
+        lock, release_batch_start_ + deadline,
+        [this] { return release_batch_count_ == 0; });
+    if (!flushed) {
+      release_batch_count_ = 0;
+      release_batch_bytes_ = 0;
+      lock.unlock();
+      triggered_task_->Activate();
+      lock.lock();
+    }
+  }
 }
 
 void XrtComputationClient::HandleReleaser() {
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    release_batch_count_ = 0;
+    release_batch_bytes_ = 0;
+  }
   auto data_op_generator =
       [this](XrtSession* session, const tensorflow::Scope& scope,
              const std::string& device) -> const XrtSession::CachedNode& {
@@ -1158,24 +2256,132 @@ void XrtComputationClient::HandleReleaser() {
 }
 
 void XrtComputationClient::ReleaseHandle(int64 handle,
-                                         const std::string& device,
+                                         const std::string& device, int64 size,
                                          std::vector<DeviceHandle>* handles) {
+  static const size_t batch_count =
+      sys_util::GetEnvInt("XLA_HANDLE_RELEASE_BATCH", 256);
+  static const int64 batch_bytes =
+      sys_util::GetEnvInt("XLA_HANDLE_RELEASE_BATCH_BYTES", 256 * 1024 * 1024);
+  static const int64 large_bytes =
+      sys_util::GetEnvInt("XLA_HANDLE_RELEASE_LARGE_BYTES", 64 * 1024 * 1024);
+  bool activate = false;
+  bool first = false;
   {
     std::lock_guard<std::mutex> lock(lock_);
     handles->push_back({device, handle});
+    first = release_batch_count_ == 0;
+    if (first) {
+      release_batch_start_ = std::chrono::steady_clock::now();
+    }
+    release_batch_count_ += 1;
+    release_batch_bytes_ += size;
+    // Large allocations are released immediately, together with whatever else
+    // is pending, as holding them back is likely to cause memory pressure.
+    activate = release_batch_count_ >= batch_count ||
+               release_batch_bytes_ >= batch_bytes || size >= large_bytes;
+    if (activate) {
+      release_batch_count_ = 0;
+      release_batch_bytes_ = 0;
+    }
+  }
+  if (activate) {
+    triggered_task_->Activate();
+  } else if (first) {
+    release_cv_.notify_one();
+  }
+}
+
+void XrtComputationClient::ReleaseDonatedArguments(
+    absl::Span<const DataPtr> arguments,
+    const std::vector<bool>& donated_arguments) {
+  size_t donated_count = 0;
+  for (size_t i = 0; i < arguments.size(); ++i) {
+    if (IsDonatedArgument(donated_arguments, i)) {
+      XrtData& xrt_data = dynamic_cast<XrtData&>(*arguments[i]);
+      if (xrt_data.handle_ptr != nullptr &&
+          xrt_data.handle_ptr.use_count() == 1) {
+        xrt_data.handle_ptr.reset();
+        ++donated_count;
+      }
+    }
+  }
+  if (donated_count > 0) {
+    DonatedDataHandlesCounter()->AddValue(donated_count);
+    triggered_task_->Activate();
   }
-  triggered_task_->Activate();
+}
+
+int64 XrtComputationClient::TrackDataAllocation(const std::string& device,
+                                                const Shape& shape) {
+  int64 size = ShapeUtil::ByteSizeOf(shape, sizeof(void*));
+  std::lock_guard<std::mutex> lock(memory_lock_);
+  MemoryInfo* info = &memory_stats_[device];
+  info->live_bytes += size;
+  info->peak_bytes = std::max(info->peak_bytes, info->live_bytes);
+  return size;
 }
 
 void XrtComputationClient::ReleaseXrtData(const std::string& device,
-                                          int64 handle) {
-  ReleaseHandle(handle, device, &released_data_handles_);
+                                          int64 handle, int64 size) {
+  {
+    std::lock_guard<std::mutex> lock(memory_lock_);
+    memory_stats_[device].live_bytes -= size;
+  }
+  ReleaseHandle(handle, device, size, &released_data_handles_);
   ReleaseDataHandlesCounter()->AddValue(1);
 }
 
+ComputationClient::MemoryInfo XrtComputationClient::GetMemoryInfo(
+    const std::string& device) {
+  std::string effective_device = GetEffectiveDevice(device);
+  MemoryInfo info;
+  {
+    std::lock_guard<std::mutex> lock(memory_lock_);
+    auto it = memory_stats_.find(effective_device);
+    if (it != memory_stats_.end()) {
+      info = it->second;
+    }
+  }
+
+  XrtSessionCache::SessionMap session_map;
+  XrtSession* session =
+      GetSessionForDevice(session_cache_.get(), effective_device, &session_map);
+  tensorflow::Scope device_scope =
+      session->root()->WithDevice(TorchDeviceToXrtDevice(effective_device));
+  const XrtSession::CachedNode& cached_node =
+      GetMemoryInfoNode(session, device_scope, effective_device);
+  std::vector<tensorflow::Tensor> outputs;
+  XLA_CHECK_OK(session->Run({}, {cached_node.outputs[0]}, &outputs));
+  XLA_CHECK_EQ(outputs.size(), 1);
+
+  xrt::MemoryInfo mem_info = ParseProto<xrt::MemoryInfo>(outputs[0]);
+  info.free_bytes = mem_info.kb_free() * 1024;
+  info.total_bytes = mem_info.kb_total() * 1024;
+  return info;
+}
+
+void XrtComputationClient::ReclaimMemory(const std::string& device) {
+  XLA_COUNTER("XrtReclaimMemory", 1);
+  // Run the releaser synchronously, so that all the handles which became
+  // unreferenced up to now, are freed before the compaction.
+  HandleReleaser();
+
+  std::string effective_device = GetEffectiveDevice(device);
+  XrtSessionCache::SessionMap session_map;
+  XrtSession* session =
+      GetSessionForDevice(session_cache_.get(), effective_device, &session_map);
+  tensorflow::Scope device_scope =
+      session->root()->WithDevice(TorchDeviceToXrtDevice(effective_device));
+  const XrtSession::CachedNode& cached_node =
+      GetCompactAllocationsNode(session, device_scope, effective_device);
+  std::vector<tensorflow::Tensor> outputs;
+  XLA_CHECK_OK(session->Run({}, {}, {cached_node.operations[0]}, &outputs));
+}
+
 void XrtComputationClient::ReleaseXrtComputation(
     const std::string& compilation_device, int64 handle) {
-  ReleaseHandle(handle, compilation_device, &released_compile_handles_);
+  ReleaseHandle(handle, compilation_device, /*size=*/0,
+                &released_compile_handles_);
   ReleaseCompileHandlesCounter()->AddValue(1);
 }
 
@@ -1208,6 +2414,7 @@ const std::vector<int>& XrtComputationClient::GetDeviceMeshCoords(
 tensorflow::tpu::TopologyProto XrtComputationClient::InitializeAndFetchTopology(
     const std::string& job, int task_no, const std::string& worker_host_port,
     const tensorflow::ConfigProto& config) {
+  XLA_TIMED("XrtFetchTopology");
   tensorflow::SessionOptions session_options;
   session_options.env = tensorflow::Env::Default();
   session_options.target = worker_host_port;
@@ -1248,36 +2455,35 @@ tensorflow::tpu::TopologyProto XrtComputationClient::InitializeAndFetchTopology(
   return ParseProto<tensorflow::tpu::TopologyProto>(outputs[0]);
 }
 
-void XrtComputationClient::InitializeDevices(
-    std::unique_ptr<tensorflow::tpu::TopologyProto> topology_proto) {
-  if (topology_proto == nullptr) {
-    std::set<Worker> tpu_workers;
-    for (const auto& dev_target : options_.global_device_map) {
-      tensorflow::DeviceNameUtils::ParsedName parsed_device =
-          ParseFullXrtDevice(dev_target.second);
-      if (parsed_device.type == "TPU") {
-        tpu_workers.emplace(parsed_device.job, parsed_device.task);
-      }
-    }
-    if (!tpu_workers.empty()) {
-      const Worker& worker = *tpu_workers.begin();
-      auto it = options_.workers_map.find(worker);
-      XLA_CHECK(it != options_.workers_map.end());
-
-      TF_VLOG(1) << "Configuring TPU for master worker " << worker.name << ":"
-                 << worker.task_no << " at " << it->second;
-      tensorflow::tpu::TopologyProto worker_topology_proto =
-          InitializeAndFetchTopology(worker.name, worker.task_no, it->second,
-                                     session_cache_->GetConfig());
-      if (topology_proto == nullptr) {
-        topology_proto = absl::make_unique<tensorflow::tpu::TopologyProto>(
-            std::move(worker_topology_proto));
-      }
-    }
-    if (topology_proto != nullptr) {
-      TF_VLOG(1) << "TPU topology: " << topology_proto->DebugString();
+std::unique_ptr<tensorflow::tpu::TopologyProto>
+XrtComputationClient::FetchTopology() const {
+  std::set<Worker> tpu_workers;
+  for (const auto& dev_target : options_.global_device_map) {
+    tensorflow::DeviceNameUtils::ParsedName parsed_device =
+        ParseFullXrtDevice(dev_target.second);
+    if (parsed_device.type == "TPU") {
+      tpu_workers.emplace(parsed_device.job, parsed_device.task);
     }
   }
+  if (tpu_workers.empty()) {
+    return nullptr;
+  }
+  const Worker& worker = *tpu_workers.begin();
+  auto it = options_.workers_map.find(worker);
+  XLA_CHECK(it != options_.workers_map.end());
+
+  TF_VLOG(1) << "Configuring TPU for master worker " << worker.name << ":"
+             << worker.task_no << " at " << it->second;
+  auto topology_proto = absl::make_unique<tensorflow::tpu::TopologyProto>(
+      InitializeAndFetchTopology(worker.name, worker.task_no, it->second,
+                                 session_cache_->GetConfig()));
+  TF_VLOG(1) << "TPU topology: " << topology_proto->DebugString();
+  return topology_proto;
+}
+
+void XrtComputationClient::InitializeDevices(
+    std::unique_ptr<tensorflow::tpu::TopologyProto> topology_proto) {
+  XLA_TIMED("XrtInitializeDevices");
   for (const auto& dev_target : options_.global_device_map) {
     tensorflow::DeviceNameUtils::ParsedName parsed_device =
         ParseFullXrtDevice(dev_target.second);
@@ -1302,34 +2508,65 @@ void XrtComputationClient::InitializeDevices(
     device_mesh_coords_.insert(
         {dev_target.second, std::move(device_mesh_coords)});
   }
-
-  // Create the mesh service only if we have more than one worker, or if
-  // multi-processing is active.
-  std::string mesh_service_address =
-      sys_util::GetEnvString(env::kEnvMeshService, "");
-  std::string mp_device = GetMultiProcessingDevice();
-  if (!mesh_service_address.empty() && !mp_device.empty()) {
-    Device device(mp_device);
-    if (device.ordinal == 0) {
-      CreateMeshService(mesh_service_address, topology_proto.get());
-    }
+  if (mesh_service_ != nullptr) {
+    mesh_service_->SetConfig(CreateMeshConfig(topology_proto.get()));
+  }
+  if (!GetMultiProcessingDevice().empty() &&
+      !sys_util::GetEnvString(env::kEnvMeshService, "").empty()) {
     SetupGpuRuntime();
   }
 }
 
 void XrtComputationClient::SetupGpuRuntime() {
+  // The mesh service hands out a single UID per replica group for the whole
+  // process lifetime, so the UIDs are cached locally, saving a round trip
+  // every time the GPU runtime creates the communicators of a computation.
   struct NcclUniqueIdFactory : public tensorflow::NcclUniqueIdFactory {
     std::string GetUniqueId(absl::Span<const xla::int64> replicas) override {
-      return service::MeshClient::Get()->GetNcclUniqueUid(replicas);
+      std::string replicas_str = absl::StrJoin(replicas, ",");
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = replicas_uid_map.find(replicas_str);
+        if (it != replicas_uid_map.end()) {
+          XLA_COUNTER("NcclUniqueIdCacheHit", 1);
+          return it->second;
+        }
+      }
+      XLA_COUNTER("NcclUniqueIdRequests", 1);
+      std::string uid = service::MeshClient::Get()->GetNcclUniqueUid(replicas);
+      XLA_CHECK(!uid.empty()) << "Empty NCCL UID for replicas (" << replicas_str
+                              << ")";
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = replicas_uid_map.emplace(std::move(replicas_str), uid).first;
+      XLA_CHECK_EQ(it->second, uid)
+          << "Mismatching NCCL UID for replicas (" << it->first << ")";
+      return uid;
     }
+
+    std::mutex mutex;
+    std::map<std::string, std::string> replicas_uid_map;
   };
 
   tensorflow::SetNcclUniqueIdFactory(std::make_shared<NcclUniqueIdFactory>());
 }
 
-void XrtComputationClient::CreateMeshService(
-    const std::string& address,
-    const tensorflow::tpu::TopologyProto* topology_proto) {
+void XrtComputationClient::MaybeCreateMeshService() {
+  // Create the mesh service only if we have more than one worker, or if
+  // multi-processing is active. It starts serving right away, so that the
+  // other processes connect while this one discovers the devices.
+  std::string mesh_service_address =
+      sys_util::GetEnvString(env::kEnvMeshService, "");
+  std::string mp_device = GetMultiProcessingDevice();
+  if (mesh_service_address.empty() || mp_device.empty() ||
+      Device(mp_device).ordinal != 0) {
+    return;
+  }
+  TF_VLOG(1) << "Creating mesh service bound to " << mesh_service_address;
+  mesh_service_ = absl::make_unique<service::MeshService>(mesh_service_address);
+}
+
+service::grpc::Config XrtComputationClient::CreateMeshConfig(
+    const tensorflow::tpu::TopologyProto* topology_proto) const {
   struct Device {
     std::string local_name;
     std::string global_name;
@@ -1361,10 +2598,7 @@ void XrtComputationClient::CreateMeshService(
     }
   }
   config.set_mesh_size(sys_util::GetEnvInt(env::kEnvWorldSize, 1));
-
-  TF_VLOG(1) << "Creating mesh service bound to " << address;
-  mesh_service_ =
-      absl::make_unique<service::MeshService>(address, std::move(config));
+  return config;
 }
 
 std::vector<ComputationClient::DataPtr>
@@ -1387,6 +2621,107 @@ XrtComputationClient::GetComputationResults(
   return results;
 }
 
+std::vector<ComputationClient::DataPtr>
+XrtComputationClient::GetLazyTupleResults(const tensorflow::Tensor& xrt_result,
+                                          const Shape& result_shape,
+                                          const std::string& device) {
+  auto tuple = std::make_shared<XrtTupleResult>(this, device, result_shape,
+                                                xrt_result.scalar<int64>()());
+  std::vector<DataPtr> results;
+  for (int64 i = 0; i < ShapeUtil::TupleElementCount(result_shape); ++i) {
+    results.push_back(std::make_shared<XrtData>(tuple, i));
+  }
+  CreateDataHandlesCounter()->AddValue(1);
+  XLA_COUNTER("XrtLazyTupleResults", 1);
+  return results;
+}
+
+void XrtComputationClient::MaterializeTupleElements(
+    absl::Span<const std::pair<XrtTupleResult*, int64>> elements) {
+  XrtSessionCache::SessionMap session_map;
+  std::map<XrtSession*, SessionWork> session_work_map;
+  std::set<std::pair<XrtTupleResult*, int64>> seen_elements;
+  // Holds the tuple handles alive until the element handles are created.
+  std::vector<XrtHandlePtr> tuple_handles;
+  for (size_t i = 0; i < elements.size(); ++i) {
+    XrtTupleResult* tuple = elements[i].first;
+    if (!seen_elements.insert(elements[i]).second) {
+      continue;
+    }
+    {
+      std::lock_guard<std::mutex> slock(tuple->lock);
+      if (tuple->element_handles[elements[i].second] != nullptr) {
+        continue;
+      }
+      // A referenced element without a handle keeps the tuple handle alive.
+      tuple_handles.push_back(tuple->handle_ptr);
+    }
+    XrtSession* session =
+        GetSessionForDevice(session_cache_.get(), tuple->device, &session_map);
+    SessionWork* session_work = &session_work_map[session];
+    session_work->index_mapping.push_back(i);
+
+    tensorflow::Scope device_scope =
+        session->root()->WithDevice(TorchDeviceToXrtDevice(tuple->device));
+    const XrtSession::CachedNode& cached_node =
+        GetSubTupleNode(session, device_scope, tuple->device);
+    session_work->feed_inputs.insert(
+        {cached_node.holders[0], tuple_handles.back()->handle});
+    tensorflow::Tensor index_tensor(tensorflow::DT_INT32,
+                                    tensorflow::TensorShape({1}));
+    index_tensor.flat<tensorflow::int32>()(0) = elements[i].second;
+    session_work->feed_inputs.insert({cached_node.holders[1], index_tensor});
+    session_work->outputs_handles.push_back(cached_node.outputs[0]);
+  }
+
+  for (auto& session_work : session_work_map) {
+    std::vector<tensorflow::Tensor> outputs;
+    XLA_CHECK_OK(session_work.first->Run(session_work.second.feed_inputs,
+                                         session_work.second.outputs_handles,
+                                         &outputs));
+    XLA_CHECK_EQ(outputs.size(), session_work.second.outputs_handles.size());
+
+    for (size_t i = 0; i < outputs.size(); ++i) {
+      XrtTupleResult* tuple =
+          elements[session_work.second.index_mapping[i]].first;
+      int64 index = elements[session_work.second.index_mapping[i]].second;
+      int64 handle = outputs[i].scalar<int64>()();
+      // The element memory is accounted to the tuple handle.
+      auto element_handle = std::make_shared<XrtHandle>(
+          handle, [this, device = tuple->device, handle]() {
+            ReleaseXrtData(device, handle, /*size=*/0);
+          });
+      XrtHandlePtr tuple_handle;
+      {
+        std::lock_guard<std::mutex> slock(tuple->lock);
+        if (tuple->element_handles[index] == nullptr) {
+          tuple->element_handles[index] = std::move(element_handle);
+          tuple->pending -= 1;
+          if (tuple->pending == 0) {
+            tuple_handle = std::move(tuple->handle_ptr);
+          }
+        }
+      }
+    }
+    CreateDataHandlesCounter()->AddValue(outputs.size());
+    XLA_COUNTER("XrtTupleElementsMaterialized", outputs.size());
+  }
+}
+
+void XrtComputationClient::MaterializeLazyData(
+    absl::Span<const DataPtr> datas) {
+  std::vector<std::pair<XrtTupleResult*, int64>> elements;
+  for (auto& data : datas) {
+    const XrtData& xrt_data = static_cast<const XrtData&>(*data);
+    if (xrt_data.handle_ptr == nullptr && xrt_data.tuple != nullptr) {
+      elements.emplace_back(xrt_data.tuple.get(), xrt_data.tuple_index);
+    }
+  }
+  if (!elements.empty()) {
+    MaterializeTupleElements(elements);
+  }
+}
+
 std::string XrtComputationClient::GetResourceDomain(
     const std::string& device) const {
   return GetWorkerForDevice(device).second;
@@ -1423,6 +2758,24 @@ const std::vector<std::string>& XrtComputationClient::GetReplicationDevices()
   return g_replication_devices;
 }
 
+std::vector<int64> XrtComputationClient::GetReplicationDevicesHosts() const {
+  std::map<Worker, int64> hosts;
+  std::vector<int64> devices_hosts;
+  devices_hosts.reserve(g_replication_devices.size());
+  for (auto& device : g_replication_devices) {
+    auto it = options_.global_device_map.find(device);
+    if (it == options_.global_device_map.end()) {
+      return {};
+    }
+    tensorflow::DeviceNameUtils::ParsedName parsed_device =
+        ParseFullXrtDevice(it->second);
+    Worker worker(parsed_device.job, parsed_device.task);
+    auto host_it = hosts.emplace(worker, hosts.size()).first;
+    devices_hosts.push_back(host_it->second);
+  }
+  return devices_hosts;
+}
+
 void XrtComputationClient::SetRngSeed(size_t seed) { rng_seed_ = seed; }
 
 std::map<std::string, Metric> XrtComputationClient::GetMetrics() const {
@@ -1532,6 +2885,21 @@ std::map<std::string, Metric> XrtComputationClient::GetMetrics() const {
   return metrics_data;
 }
 
+void XrtComputationClient::PrewarmSessions() {
+  int64 count = sys_util::GetEnvInt("XRT_SESSION_PREWARM", 1);
+  if (count <= 0) {
+    return;
+  }
+  std::set<std::string> targets;
+  for (auto& device : options_.devices) {
+    targets.insert(GetWorkerForDevice(device).second);
+  }
+  std::vector<std::string> targets_list(targets.begin(), targets.end());
+  TF_VLOG(1) << "Pre-warming " << count << " XRT sessions for "
+             << targets_list.size() << " worker targets";
+  session_cache_->Prewarm(targets_list, count);
+}
+
 void XrtComputationClient::InitSession(XrtSession* session) const {
   struct InitNode {
     int count;
@@ -1604,6 +2972,38 @@ const XrtSession::CachedNode& XrtComputationClient::GetExecuteNode(
   return cache->Get();
 }
 
+const XrtSession::CachedNode& XrtComputationClient::GetExecuteReadNode(
+    XrtSession* session, const tensorflow::Scope& scope,
+    const std::string& device, size_t count) const {
+  static const std::string op_name("XrtExecuteRead");
+  XrtSession::NodeCache* cache = session->GetNodeCache(
+      XrtSession::GetCacheKey(absl::StrCat(op_name, count), device));
+  if (cache->Empty()) {
+    XLA_COUNTER("XrtExecuteRead_Empty", 1);
+    std::vector<tensorflow::ops::Placeholder> holders(
+        {tensorflow::ops::Placeholder(scope, tensorflow::DT_INT64),
+         tensorflow::ops::Placeholder(scope, tensorflow::DT_STRING),
+         tensorflow::ops::Placeholder(
+             scope, tensorflow::DT_INT64,
+             tensorflow::ops::Placeholder::Shape({-1})),
+         tensorflow::ops::Placeholder(
+             scope, tensorflow::DT_INT64,
+             tensorflow::ops::Placeholder::Shape(
+                 {static_cast<int64>(count)}))});
+    tensorflow::Output handles = tensorflow::ops::XRTExecute(
+        scope, holders[0], holders[1], {tensorflow::Output(holders[2])});
+    tensorflow::ops::Unstack read_handles(
+        scope, tensorflow::ops::Gather(scope, handles, holders[3]), count);
+    std::vector<tensorflow::Output> outputs({handles});
+    for (auto& read_handle : read_handles.output) {
+      outputs.push_back(tensorflow::ops::XRTReadLiteral(scope, read_handle));
+    }
+    cache->Add(
+        std::make_shared<XrtSession::CachedNode>(std::move(outputs), holders));
+  }
+  return cache->Get();
+}
+
 const XrtSession::CachedNode& XrtComputationClient::GetExecuteChainedNode(
     XrtSession* session, const tensorflow::Scope& scope,
     const std::string& device) const {
@@ -1638,6 +3038,32 @@ const XrtSession::CachedNode& XrtComputationClient::GetReadNode(
   return cache->Get();
 }
 
+const XrtSession::CachedNode& XrtComputationClient::GetCopyNode(
+    XrtSession* session, const std::string& device,
+    const std::string& dest_device, const Shape& shape) const {
+  std::stringstream ss;
+  ss << "XrtCopy(" << dest_device << "," << shape << ")";
+  XrtSession::NodeCache* cache =
+      session->GetNodeCache(XrtSession::GetCacheKey(ss.str(), device));
+  if (cache->Empty()) {
+    XLA_COUNTER("XrtCopy_Empty", 1);
+    tensorflow::Scope scope =
+        session->root()->WithDevice(TorchDeviceToXrtDevice(device));
+    tensorflow::Scope dest_scope =
+        session->root()->WithDevice(TorchDeviceToXrtDevice(dest_device));
+    std::vector<tensorflow::ops::Placeholder> holders(
+        {tensorflow::ops::Placeholder(scope, tensorflow::DT_INT64)});
+    tensorflow::ops::XRTReadToTensor read(
+        scope, holders[0], {XlaTypeToDataType(shape.element_type())});
+    cache->Add(std::make_shared<XrtSession::CachedNode>(
+        tensorflow::ops::XRTAllocateFromTensor(
+            dest_scope, read.tensors,
+            {tensorflow::TensorShape(shape.dimensions())}),
+        holders));
+  }
+  return cache->Get();
+}
+
 const XrtSession::CachedNode& XrtComputationClient::GetAllocateNode(
     XrtSession* session, const tensorflow::Scope& scope,
     const std::string& device, const Shape& shape) const {
@@ -1668,6 +3094,135 @@ const XrtSession::CachedNode& XrtComputationClient::GetAllocateNode(
   return cache->Get();
 }
 
+const XrtSession::CachedNode& XrtComputationClient::GetCompressedAllocateNode(
+    XrtSession* session, const std::string& xrt_device,
+    const std::string& device, const Shape& shape, bool shuffled) const {
+  std::stringstream ss;
+  ss << "XRTAllocateFromCompressed(" << shape << "," << shuffled << ")";
+  XrtSession::NodeCache* cache =
+      session->GetNodeCache(XrtSession::GetCacheKey(ss.str(), device));
+  if (cache->Empty()) {
+    XLA_COUNTER("XRTAllocateFromCompressed_Empty", 1);
+    tensorflow::Scope device_scope = session->root()->WithDevice(xrt_device);
+    tensorflow::Scope cpu_scope =
+        session->root()->WithDevice(GetWorkerCpuDevice(xrt_device));
+    tensorflow::DataType dtype = XlaTypeToDataType(shape.element_type());
+    tensorflow::TensorShape tensor_shape(shape.dimensions());
+    tensorflow::TensorShape equiv_tensor_shape =
+        MakeEquivalentTensorShape(shape);
+    std::vector<int> layout(shape.layout().minor_to_major().begin(),
+                            shape.layout().minor_to_major().end());
+    std::vector<tensorflow::ops::Placeholder> holders(
+        {tensorflow::ops::Placeholder(
+            cpu_scope, tensorflow::DT_STRING,
+            tensorflow::ops::Placeholder::Shape(tensorflow::TensorShape()))});
+    tensorflow::Output data = tensorflow::ops::DecodeCompressed(
+        cpu_scope, holders[0],
+        tensorflow::ops::DecodeCompressed::CompressionType("ZLIB"));
+    tensorflow::Output value;
+    if (shuffled) {
+      int64 element_size =
+          ShapeUtil::ByteSizeOfPrimitiveType(shape.element_type());
+      tensorflow::Output bytes =
+          tensorflow::ops::DecodeRaw(cpu_scope, data, tensorflow::DT_UINT8);
+      tensorflow::Output planes = tensorflow::ops::Reshape(
+          cpu_scope, bytes, {element_size, static_cast<int64>(-1)});
+      tensorflow::Output elements =
+          tensorflow::ops::Transpose(cpu_scope, planes, {1, 0});
+      value = tensorflow::ops::Bitcast(cpu_scope, elements, dtype);
+    } else {
+      value = tensorflow::ops::DecodeRaw(cpu_scope, data, dtype);
+    }
+    tensorflow::Tensor dims(tensorflow::DT_INT64,
+                            tensorflow::TensorShape({equiv_tensor_shape.dims()}));
+    for (int i = 0; i < equiv_tensor_shape.dims(); ++i) {
+      dims.vec<int64>()(i) = equiv_tensor_shape.dim_size(i);
+    }
+    value = tensorflow::ops::Reshape(cpu_scope, value, dims);
+    tensorflow::ops::XRTAllocateFromTensor::Attrs alloc_attrs =
+        tensorflow::ops::XRTAllocateFromTensor::Layouts(layout);
+    cache->Add(std::make_shared<XrtSession::CachedNode>(
+        tensorflow::ops::XRTAllocateFromTensor(device_scope, {value},
+                                               {tensor_shape}, alloc_attrs),
+        holders));
+  }
+  return cache->Get();
+}
+
+const XrtSession::CachedNode& XrtComputationClient::GetPackedAllocateNode(
+    XrtSession* session, const std::string& xrt_device,
+    const std::string& device, absl::Span<const Shape> shapes) const {
+  std::stringstream ss;
+  ss << "XRTAllocateFromPacked(";
+  for (auto& shape : shapes) {
+    ss << shape << ";";
+  }
+  ss << ")";
+  XrtSession::NodeCache* cache =
+      session->GetNodeCache(XrtSession::GetCacheKey(ss.str(), device));
+  if (cache->Empty()) {
+    XLA_COUNTER("XRTAllocateFromPacked_Empty", 1);
+    tensorflow::Scope device_scope = session->root()->WithDevice(xrt_device);
+    tensorflow::Scope cpu_scope =
+        session->root()->WithDevice(GetWorkerCpuDevice(xrt_device));
+    std::vector<tensorflow::ops::Placeholder> holders(
+        {tensorflow::ops::Placeholder(
+            cpu_scope, tensorflow::DT_STRING,
+            tensorflow::ops::Placeholder::Shape(tensorflow::TensorShape()))});
+    std::vector<tensorflow::Output> outputs;
+    int64 offset = 0;
+    for (auto& shape : shapes) {
+      int64 size = ShapeUtil::ByteSizeOfElements(shape);
+      tensorflow::Output bytes =
+          tensorflow::ops::Substr(cpu_scope, holders[0], offset, size);
+      tensorflow::Output value = tensorflow::ops::DecodeRaw(
+          cpu_scope, bytes, XlaTypeToDataType(shape.element_type()));
+      tensorflow::TensorShape equiv_tensor_shape =
+          MakeEquivalentTensorShape(shape);
+      tensorflow::Tensor dims(
+          tensorflow::DT_INT64,
+          tensorflow::TensorShape({equiv_tensor_shape.dims()}));
+      for (int i = 0; i < equiv_tensor_shape.dims(); ++i) {
+        dims.vec<int64>()(i) = equiv_tensor_shape.dim_size(i);
+      }
+      value = tensorflow::ops::Reshape(cpu_scope, value, dims);
+      std::vector<int> layout(shape.layout().minor_to_major().begin(),
+                              shape.layout().minor_to_major().end());
+      tensorflow::ops::XRTAllocateFromTensor::Attrs alloc_attrs =
+          tensorflow::ops::XRTAllocateFromTensor::Layouts(layout);
+      outputs.push_back(tensorflow::ops::XRTAllocateFromTensor(
+          device_scope, {value}, {tensorflow::TensorShape(shape.dimensions())},
+          alloc_attrs));
+      offset += size;
+    }
+    cache->Add(
+        std::make_shared<XrtSession::CachedNode>(std::move(outputs), holders));
+  }
+  return cache->Get();
+}
+
+const XrtSession::CachedNode& XrtComputationClient::GetDecompressProbeNode(
+    XrtSession* session, const std::string& xrt_device,
+    const std::string& device) const {
+  static const std::string op_name("XrtDecompressProbe");
+  XrtSession::NodeCache* cache =
+      session->GetNodeCache(XrtSession::GetCacheKey(op_name, device));
+  if (cache->Empty()) {
+    XLA_COUNTER("XrtDecompressProbe_Empty", 1);
+    tensorflow::Scope cpu_scope =
+        session->root()->WithDevice(GetWorkerCpuDevice(xrt_device));
+    std::vector<tensorflow::ops::Placeholder> holders(
+        {tensorflow::ops::Placeholder(cpu_scope, tensorflow::DT_STRING)});
+    tensorflow::Output data = tensorflow::ops::DecodeCompressed(
+        cpu_scope, holders[0],
+        tensorflow::ops::DecodeCompressed::CompressionType("ZLIB"));
+    cache->Add(std::make_shared<XrtSession::CachedNode>(
+        tensorflow::ops::DecodeRaw(cpu_scope, data, tensorflow::DT_UINT8),
+        holders));
+  }
+  return cache->Get();
+}
+
 const XrtSession::CachedNode&
 XrtComputationClient::GetReleaseAllocationHandleNode(
     XrtSession* session, const tensorflow::Scope& scope,
@@ -1703,6 +3258,36 @@ const XrtSession::CachedNode& XrtComputationClient::GetReleaseCompileHandleNode(
   return cache->Get();
 }
 
+const XrtSession::CachedNode& XrtComputationClient::GetMemoryInfoNode(
+    XrtSession* session, const tensorflow::Scope& scope,
+    const std::string& device) const {
+  static const std::string op_name("XrtMemoryInfo");
+  XrtSession::NodeCache* cache =
+      session->GetNodeCache(XrtSession::GetCacheKey(op_name, device));
+  if (cache->Empty()) {
+    XLA_COUNTER("XrtMemoryInfo_Empty", 1);
+    cache->Add(std::make_shared<XrtSession::CachedNode>(
+        tensorflow::ops::XRTMemoryInfo(scope),
+        std::vector<tensorflow::ops::Placeholder>()));
+  }
+  return cache->Get();
+}
+
+const XrtSession::CachedNode& XrtComputationClient::GetCompactAllocationsNode(
+    XrtSession* session, const tensorflow::Scope& scope,
+    const std::string& device) const {
+  static const std::string op_name("XrtCompactAllocations");
+  XrtSession::NodeCache* cache =
+      session->GetNodeCache(XrtSession::GetCacheKey(op_name, device));
+  if (cache->Empty()) {
+    XLA_COUNTER("XrtCompactAllocations_Empty", 1);
+    cache->Add(std::make_shared<XrtSession::CachedNode>(
+        tensorflow::ops::XRTCompactAllocations(scope).operation,
+        std::vector<tensorflow::ops::Placeholder>()));
+  }
+  return cache->Get();
+}
+
 const XrtSession::CachedNode& XrtComputationClient::GetSubTupleNode(
     XrtSession* session, const tensorflow::Scope& scope,
     const std::string& device) const {
@@ -2,18 +2,24 @@
 #define XLA_CLIENT_XRT_COMPUTATION_CLIENT_H_
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <functional>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
+#include <tuple>
 #include <utility>
 
+#include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
 #include "tensorflow/cc/client/client_session.h"
 #include "tensorflow/cc/framework/ops.h"
 #include "tensorflow/cc/framework/scope.h"
 #include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/xla_client/cache.h"
 #include "tensorflow/compiler/xla/xla_client/computation_client.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
@@ -51,26 +57,75 @@ class XrtComputationClient : public ComputationClient {
 
   using XrtHandlePtr = std::shared_ptr<XrtHandle>;
 
+  // The single tuple allocation returned by an execution whose result was not
+  // exploded (see XRT_LAZY_TUPLE_RESULTS). The handles of the tuple elements
+  // are created with XRTSubTuple only once a consumer needs them, and the
+  // tuple handle is released as soon as no unmaterialized element is
+  // referenced anymore, which frees the buffers of the dropped elements.
+  struct XrtTupleResult {
+    XrtTupleResult(XrtComputationClient* self, std::string device, Shape shape,
+                   int64 handle);
+
+    void AddRef(int64 index);
+
+    void ReleaseRef(int64 index);
+
+    int64 GetElementHandle(int64 index);
+
+    XrtComputationClient* self;
+    std::string device;
+    Shape shape;
+    std::mutex lock;
+    XrtHandlePtr handle_ptr;
+    std::vector<XrtHandlePtr> element_handles;
+    // The number of XrtData objects referencing every element.
+    std::vector<int64> element_refs;
+    // The number of referenced elements without a handle yet.
+    int64 pending = 0;
+  };
+
   struct XrtData : public Data {
     XrtData(std::string device, Shape device_shape)
         : Data(std::move(device), std::move(device_shape)) {}
+    XrtData(std::shared_ptr<XrtTupleResult> tuple, int64 tuple_index);
     XrtData(XrtComputationClient* self, std::string device, Shape device_shape,
             int64 handle)
         : Data(std::move(device), std::move(device_shape)),
           handle_ptr(std::make_shared<XrtHandle>(
-              handle, [self, device = this->device(), handle]() {
-                self->ReleaseXrtData(device, handle);
+              handle,
+              [self, device = this->device(), handle,
+               size = self->TrackDataAllocation(this->device(), shape())]() {
+                self->ReleaseXrtData(device, handle, size);
               })) {}
 
-    int64 get_handle() const { return handle_ptr->handle; }
+    ~XrtData() override;
+
+    int64 get_handle() const {
+      return handle_ptr != nullptr ? handle_ptr->handle
+                                   : tuple->GetElementHandle(tuple_index);
+    }
 
-    OpaqueHandle GetOpaqueHandle() override { return get_handle(); }
+    // The lazy tuple elements are identified by a negative unique ID, so that
+    // collecting the graph parameters does not create their handles.
+    OpaqueHandle GetOpaqueHandle() override {
+      return tuple != nullptr ? -lazy_id : get_handle();
+    }
 
     void Assign(const Data& data) override;
 
-    bool HasValue() const override { return handle_ptr != nullptr; }
+    bool HasValue() const override {
+      return handle_ptr != nullptr || tuple != nullptr;
+    }
 
     XrtHandlePtr handle_ptr;
+    // The host value read together with the execution which produced the
+    // data, if the output was small enough to be inlined.
+    std::shared_ptr<const Literal> host_value;
+    // The tuple result the data is an element of, if its handle is created
+    // lazily.
+    std::shared_ptr<XrtTupleResult> tuple;
+    int64 tuple_index = 0;
+    int64 lazy_id = 0;
   };
 
   struct XrtComputation : public Computation {
@@ -88,6 +143,17 @@ class XrtComputationClient : public ComputationClient {
     int64 get_handle() const { return handle_ptr->handle; }
 
     XrtHandlePtr handle_ptr;
+
+    // The handles tensor of the latest arguments the computation has been
+    // executed with on every device, which is fed again as long as the handles
+    // do not change (like for the weights of inference graphs).
+    struct ArgumentsInputs {
+      std::vector<int64> handles;
+      tensorflow::Tensor tensor;
+    };
+
+    mutable std::mutex arguments_inputs_lock;
+    mutable std::map<std::string, ArgumentsInputs> arguments_inputs;
   };
 
  public:
@@ -146,6 +212,17 @@ class XrtComputationClient : public ComputationClient {
   std::vector<Literal> TransferFromServer(
       absl::Span<const DataPtr> handles) override;
 
+  void TransferFromServer(absl::Span<const DataPtr> handles,
+                          const LiteralFn& literal_fn) override;
+
+  std::vector<DataPtr> CopyDataToDevice(
+      absl::Span<const DataPtr> handles,
+      absl::Span<const std::string> devices) override;
+
+  MemoryInfo GetMemoryInfo(const std::string& device) override;
+
+  void ReclaimMemory(const std::string& device) override;
+
   std::vector<ComputationPtr> Compile(
       std::vector<CompileInstance> instances) override;
 
@@ -186,6 +263,8 @@ class XrtComputationClient : public ComputationClient {
 
   const std::vector<std::string>& GetReplicationDevices() const override;
 
+  std::vector<int64> GetReplicationDevicesHosts() const override;
+
   void SetRngSeed(size_t seed) override;
 
   std::map<std::string, Metric> GetMetrics() const override;
@@ -198,31 +277,45 @@ class XrtComputationClient : public ComputationClient {
   // The data structure used for the key in the compilation cache. Compilations
   // handles are valid within given domain (essentially the host+port worker
   // endpoints), so the key must include the domain.
+  // The computations are keyed by a 128 bit fingerprint of their serialized
+  // proto, rather than by the proto itself, which for large graphs would keep
+  // tens of MB per cache entry. The full proto is only kept, and compared, with
+  // XRT_VERIFY_COMPILATION_CACHE set.
   struct CompilationCacheKey {
     struct Hash {
       size_t operator()(const CompilationCacheKey& entry) const {
-        util::PartialHasher<std::string, 4096> hasher;
         hash_t h = util::DataHash(entry.domain.data(), entry.domain.size());
-        return util::HashReduce(
-            util::HashCombine(h, hasher(entry.serialized_computation)));
+        return util::HashReduce(util::HashCombine(h, entry.fingerprint));
       }
     };
 
-    CompilationCacheKey(std::string domain, std::string serialized_computation)
-        : domain(std::move(domain)),
-          serialized_computation(std::move(serialized_computation)) {}
+    CompilationCacheKey(std::string domain,
+                        const std::string& serialized_computation);
     CompilationCacheKey() = default;
     CompilationCacheKey(CompilationCacheKey&&) = default;
     CompilationCacheKey& operator=(CompilationCacheKey&&) = default;
     bool operator==(const CompilationCacheKey& rhs) const {
-      return domain == rhs.domain &&
+      return domain == rhs.domain && fingerprint == rhs.fingerprint &&
              serialized_computation == rhs.serialized_computation;
     }
 
     std::string domain;
+    hash_t fingerprint = 0;
     std::string serialized_computation;
   };
 
+  // A cached XRTChainedExecutePlan, for structurally identical chained
+  // executions. Only the handles of the device data ops, at the data_ops plan
+  // positions, change across executions, and are patched in place before
+  // serializing the plan.
+  struct ChainedPlan {
+    std::mutex lock;
+    xrt::XRTChainedExecutePlan plan;
+    std::vector<size_t> data_ops;
+    std::vector<Shape> result_shapes;
+    std::string serialized_config;
+  };
+
   // When we split a batch operation into per-session batches, we use this data
   // structure to collect the per-session work.
   struct SessionWork {
@@ -249,11 +342,20 @@ class XrtComputationClient : public ComputationClient {
   template <typename T>
   void SetupExecConfig(const Device& device, T* exec_config) const;
 
+  // Returns the serialized XRTExecutionConfig for the device, as a string
+  // tensor ready to be fed to the execute nodes. The configurations only
+  // depend on the device, the explode_tuple flag and the RNG seed, so they are
+  // cached instead of being built and serialized for every replica at every
+  // step.
+  tensorflow::Tensor GetExecuteConfig(const std::string& device,
+                                      bool explode_tuple);
+
   std::unique_ptr<xrt::XLAComputation> CreateXrtComputation(
       const XlaComputation& computation, absl::Span<const std::string> devices,
       const Shape* output_shape) const;
 
-  tensorflow::Tensor GetArgumentsInputs(absl::Span<const DataPtr> arguments,
+  tensorflow::Tensor GetArgumentsInputs(const XrtComputation& computation,
+                                        absl::Span<const DataPtr> arguments,
                                         const std::string& device);
 
   std::vector<tensorflow::Output> CreateExecuteOps(
@@ -270,6 +372,14 @@ class XrtComputationClient : public ComputationClient {
       absl::Span<const std::string> devices,
       tensorflow::ClientSession::FeedType* feed_inputs);
 
+  // Like CreateExecuteOps(), but the returned outputs are followed by the
+  // literals of the inline_indices tuple outputs of the execution.
+  std::vector<tensorflow::Output> CreateExecuteReadOps(
+      XrtSessionCache::SessionMap* session_map,
+      const XrtComputation& computation, absl::Span<const DataPtr> arguments,
+      absl::Span<const int64> inline_indices, const std::string& device,
+      tensorflow::ClientSession::FeedType* feed_inputs);
+
   std::vector<std::vector<DataPtr>> RunComputations(
       const XrtSessionCache::SessionMap& session_map,
       const std::vector<tensorflow::Output>& exec_ops,
@@ -277,9 +387,43 @@ class XrtComputationClient : public ComputationClient {
       absl::Span<const std::string> devices,
       const tensorflow::ClientSession::FeedType& feed_inputs);
 
+  // Drops the device handles of the donated arguments which are not shared
+  // with other Data objects, and kicks the handle releaser so that their device
+  // memory is freed right away, instead of with the next release batch.
+  void ReleaseDonatedArguments(absl::Span<const DataPtr> arguments,
+                               const std::vector<bool>& donated_arguments);
+
   std::vector<DataPtr> TransferToServerInternal(
       absl::Span<const TensorSource> tensors);
 
+  void TransferFromServerInternal(absl::Span<const DataPtr> handles,
+                                  int64 max_partition_size,
+                                  const LiteralFn& literal_fn);
+
+  // Reads the handles of the session work. If the read takes more than
+  // XRT_HEDGED_READ_MS milliseconds, the same read is issued on another
+  // session to the same worker, and the first one to complete wins. The
+  // session_owner keeps the primary session out of the cache until its read
+  // completes.
+  std::vector<tensorflow::Tensor> ReadHandles(
+      XrtSession* session, const SessionWork& session_work,
+      absl::Span<const DataPtr> handles,
+      std::shared_ptr<void> session_owner);
+
+  std::vector<DataPtr> TransferToServerPartitioned(
+      absl::Span<const TensorSource> tensors);
+
+  // Sends a tensor in fixed-size chunks, over multiple sessions in flight, and
+  // reassembles it with a device computation. This allows sending tensors which
+  // would not fit the 2GB protobuf limit.
+  DataPtr TransferToServerStreamed(const TensorSource& tensor);
+
+  // Sends tensors of the same device, concatenated into a single host buffer,
+  // which is split back on the worker host CPU. This saves the per tensor
+  // request overhead when uploading many small tensors.
+  std::vector<DataPtr> TransferToServerPacked(
+      absl::Span<const TensorSource> tensors);
+
   // Retrieves the worker,worker_host pair for a given PyTorch device (ie,
   // TPU:0).
   std::pair<Worker, std::string> GetWorkerForDevice(
@@ -297,10 +441,17 @@ class XrtComputationClient : public ComputationClient {
                       metrics::Metric* timed_metric,
                       metrics::Counter* destroy_counter);
 
-  void ReleaseHandle(int64 handle, const std::string& device,
+  // Queues a handle for release. The handle releaser is activated only once
+  // enough handles (by count or bytes) are pending, or a large allocation is
+  // released, or the oldest pending handle reaches the batching deadline.
+  void ReleaseHandle(int64 handle, const std::string& device, int64 size,
                      std::vector<DeviceHandle>* handles);
 
-  void ReleaseXrtData(const std::string& device, int64 handle);
+  // Accounts the memory used by an XRT data of the given shape, and returns its
+  // size in bytes.
+  int64 TrackDataAllocation(const std::string& device, const Shape& shape);
+
+  void ReleaseXrtData(const std::string& device, int64 handle, int64 size);
 
   void ReleaseXrtComputation(const std::string& compilation_device,
                              int64 handle);
@@ -308,6 +459,10 @@ class XrtComputationClient : public ComputationClient {
   // Starts the handle releaser thread (which runs the HandleReleaser() API).
   void StartHandleReleaser();
 
+  // Runs in the release deadline thread and never returns. Activates the handle
+  // releaser when the pending handles batch reaches its deadline.
+  void ReleaseDeadlineTimer();
+
   // The handler releaser function. Runs in the releaser thread and never
   // returns.
   void HandleReleaser();
@@ -316,11 +471,20 @@ class XrtComputationClient : public ComputationClient {
   const std::vector<int>& GetDeviceMeshCoords(
       const std::string& xrt_device) const;
 
+  // Configures the TPU system of the master TPU worker, returning its topology,
+  // or nullptr if there are no TPU devices.
+  std::unique_ptr<tensorflow::tpu::TopologyProto> FetchTopology() const;
+
   void InitializeDevices(
       std::unique_ptr<tensorflow::tpu::TopologyProto> topology_proto);
 
-  void CreateMeshService(const std::string& address,
-                         const tensorflow::tpu::TopologyProto* topology_proto);
+  // Starts the mesh service with no config, if this process is the mesh
+  // master. InitializeDevices() publishes the config once the topology is
+  // known.
+  void MaybeCreateMeshService();
+
+  service::grpc::Config CreateMeshConfig(
+      const tensorflow::tpu::TopologyProto* topology_proto) const;
 
   void SetupGpuRuntime();
 
@@ -328,12 +492,34 @@ class XrtComputationClient : public ComputationClient {
       const tensorflow::Tensor& xrt_result, const Shape& result_shape,
       const std::string& device);
 
+  std::vector<DataPtr> GetLazyTupleResults(const tensorflow::Tensor& xrt_result,
+                                           const Shape& result_shape,
+                                           const std::string& device);
+
+  // Creates, with a single session run per worker, the handles of the given
+  // (tuple, index) elements which do not have one yet.
+  void MaterializeTupleElements(
+      absl::Span<const std::pair<XrtTupleResult*, int64>> elements);
+
+  // Creates the handles of the lazy tuple elements among the given data.
+  void MaterializeLazyData(absl::Span<const DataPtr> datas);
+
   void InitSession(XrtSession* session) const;
 
+  // Creates XRT_SESSION_PREWARM sessions for each of the local worker targets,
+  // so that the first replicated executions find them ready.
+  void PrewarmSessions();
+
   // Implement the chained execution using the XRTExecuteChained op support.
   std::vector<DataPtr> ExecuteChainedXrt(absl::Span<const ExecuteChainedOp> ops,
                                          const std::string& device);
 
+  // Retrieves the cached plan for the chained execution, keyed by the structure
+  // of the ops (the computation handles, the inputs and outputs wiring, and the
+  // shape of the device data), or creates a new one.
+  std::shared_ptr<ChainedPlan> GetChainedPlan(
+      absl::Span<const ExecuteChainedOp> ops, const std::string& device);
+
   // Implement the chained execution using multiple XRTExecute in many RPC round
   // trips.
   std::vector<DataPtr> ExecuteChainedSplit(
@@ -367,6 +553,22 @@ class XrtComputationClient : public ComputationClient {
                                                const tensorflow::Scope& scope,
                                                const std::string& device) const;
 
+  // Creates an XRT graph with an XRTExecute operation, followed by the reads of
+  // count of its exploded tuple outputs:
+  //
+  //  handles = XRTExecute(holders[0], holders[1], holders[2])
+  //  outputs[0] = handles
+  //  outputs[1 + i] = XRTReadLiteral(Unstack(Gather(handles, holders[3]))[i])
+  //
+  // With:
+  //  holders[0] = XLA Computation handle place-holder (DT_INT64)
+  //  holders[1] = xrt::XRTExecutionConfig place-holder (DT_STRING)
+  //  holders[2] = Inputs for the XRTExecute (DT_INT64[])
+  //  holders[3] = Indices of the outputs to read (DT_INT64[count])
+  const XrtSession::CachedNode& GetExecuteReadNode(
+      XrtSession* session, const tensorflow::Scope& scope,
+      const std::string& device, size_t count) const;
+
   // Creates an XRT graph with an XRTExecute operation:
   //
   //  XRTExecuteChained(
@@ -393,6 +595,20 @@ class XrtComputationClient : public ComputationClient {
                                             const tensorflow::Scope& scope,
                                             const std::string& device) const;
 
+  // Creates an XRT graph which copies an allocation of the given shape from
+  // the source device to the destination one, within the same worker:
+  //
+  //  XRTAllocateFromTensor(
+  //    XRTReadToTensor(holders[0])
+  //  )
+  //
+  // With:
+  //  holders[0] = The source handle place-holder (DT_INT64)
+  const XrtSession::CachedNode& GetCopyNode(XrtSession* session,
+                                            const std::string& device,
+                                            const std::string& dest_device,
+                                            const Shape& shape) const;
+
   // Creates an XRTAllocateFromTensor node for creating a device tensor with
   // the given shape and layout:
   //
@@ -407,6 +623,63 @@ class XrtComputationClient : public ComputationClient {
                                                 const std::string& device,
                                                 const Shape& shape) const;
 
+  // Creates an XRTAllocateFromTensor node whose input tensor is decoded, on the
+  // worker host CPU, from a ZLIB compressed payload:
+  //
+  //  XRTAllocateFromTensor(
+  //    Reshape(Unshuffle(DecodeRaw(DecodeCompressed(holders[0]))))
+  //  )
+  //
+  // With:
+  //  holders[0] = The compressed tensor bytes place-holder (DT_STRING)
+  // If shuffled is true, the payload bytes are grouped in byte planes (see
+  // ShuffleBytePlanes()), which are transposed back before the bitcast to the
+  // tensor type.
+  const XrtSession::CachedNode& GetCompressedAllocateNode(
+      XrtSession* session, const std::string& xrt_device,
+      const std::string& device, const Shape& shape, bool shuffled) const;
+
+  // Creates the XRTAllocateFromTensor nodes for tensors packed within a single
+  // buffer:
+  //
+  //  XRTAllocateFromTensor(
+  //    Reshape(DecodeRaw(Substr(holders[0], offset[i], size[i])))
+  //  )
+  //
+  // With:
+  //  holders[0] = The packed tensors bytes place-holder (DT_STRING)
+  // The outputs are the handles of the tensors, in the shapes order.
+  const XrtSession::CachedNode& GetPackedAllocateNode(
+      XrtSession* session, const std::string& xrt_device,
+      const std::string& device, absl::Span<const Shape> shapes) const;
+
+  // Creates the node used to probe whether a worker is able to decompress the
+  // transfer payloads:
+  //
+  //  DecodeRaw(DecodeCompressed(holders[0]))
+  //
+  // With:
+  //  holders[0] = The compressed bytes place-holder (DT_STRING)
+  const XrtSession::CachedNode& GetDecompressProbeNode(
+      XrtSession* session, const std::string& xrt_device,
+      const std::string& device) const;
+
+  // Checks, by running a probe decompression on the worker the first time,
+  // whether the worker hosting xrt_device can accept compressed transfers.
+  bool IsTransferCompressionSupported(const std::string& xrt_device,
+                                      const std::string& device);
+
+  // Compresses the tensor data into compressed if the transfer compression is
+  // enabled, and it pays off for the tensor. Returns whether the bytes have
+  // been shuffled in planes before the compression.
+  bool MaybeCompressTransfer(const std::string& xrt_device,
+                             const std::string& device, const Shape& shape,
+                             absl::string_view data, std::string* compressed);
+
+  // Returns the allocator of the host tensors staging the transfers to the
+  // device, or nullptr if the tensor data can be lent to the transfer as is.
+  tensorflow::Allocator* GetStagingAllocator(const std::string& device) const;
+
   // Creates an XRTReleaseAllocationHandle node:
   //
   //  XRTReleaseAllocationHandle(
@@ -431,6 +704,20 @@ class XrtComputationClient : public ComputationClient {
       XrtSession* session, const tensorflow::Scope& scope,
       const std::string& device) const;
 
+  // Creates an XRTMemoryInfo node:
+  //
+  //  XRTMemoryInfo()
+  const XrtSession::CachedNode& GetMemoryInfoNode(
+      XrtSession* session, const tensorflow::Scope& scope,
+      const std::string& device) const;
+
+  // Creates an XRTCompactAllocations node:
+  //
+  //  XRTCompactAllocations()
+  const XrtSession::CachedNode& GetCompactAllocationsNode(
+      XrtSession* session, const tensorflow::Scope& scope,
+      const std::string& device) const;
+
   // Creates an XRTSubTuple node:
   //
   //  XRTSubTuple(
@@ -451,6 +738,13 @@ class XrtComputationClient : public ComputationClient {
                                  const std::vector<CompileInstance>& instances,
                                  const SessionWork& session_work);
 
+  // Waits until the worker at target runs fewer than XRT_MAX_WORKER_COMPILES
+  // compilations, and accounts count more to it. The compilations run on the
+  // worker host CPUs, so capping them leaves room for the input pipelines.
+  void AcquireCompileSlots(const std::string& target, size_t count);
+
+  void ReleaseCompileSlots(const std::string& target, size_t count);
+
   // Converts an XLA data type to a tensorflow data type.
   static tensorflow::DataType XlaTypeToDataType(PrimitiveType dtype);
 
@@ -485,14 +779,41 @@ class XrtComputationClient : public ComputationClient {
   std::map<std::string, std::vector<int>> device_mesh_coords_;
   std::unique_ptr<XrtSessionCache> session_cache_;
   std::unique_ptr<XrtSessionCache> alloc_session_cache_;
+  // Whether the transfers to the GPU devices are staged through pinned host
+  // memory, which requires the XRT service to run within this process.
+  bool pinned_gpu_transfers_ = false;
   std::unique_ptr<util::TriggeredTask> triggered_task_;
   util::Cache<CompilationCacheKey, Computation, CompilationCacheKey::Hash>
       compilation_cache_;
+  util::Cache<hash_t, ChainedPlan, util::HashReducer> chained_plan_cache_;
   std::atomic<size_t> rng_seed_;
+  std::mutex exec_config_lock_;
+  std::map<std::tuple<std::string, bool, size_t>, tensorflow::Tensor>
+      exec_config_cache_;
   // Access to the following members must be done while holding lock_.
   // XRT thread safety semantics.
   std::vector<DeviceHandle> released_data_handles_;
   std::vector<DeviceHandle> released_compile_handles_;
+  // The number and size of the handles queued for release since the last
+  // releaser activation, and the time the first one has been queued.
+  size_t release_batch_count_ = 0;
+  int64 release_batch_bytes_ = 0;
+  std::chrono::steady_clock::time_point release_batch_start_;
+  std::condition_variable release_cv_;
+  std::unique_ptr<std::thread> release_deadline_thread_;
+  // The live and peak bytes of the XRT data handles, per device. Access must be
+  // done while holding memory_lock_.
+  std::mutex memory_lock_;
+  std::map<std::string, MemoryInfo> memory_stats_;
+  // Whether the worker hosting a given XRT device supports compressed
+  // transfers. Access must be done while holding compression_lock_.
+  std::mutex compression_lock_;
+  std::map<std::string, bool> compression_support_;
+  // The number of compilations running on every worker target. Access must be
+  // done while holding compile_slots_lock_.
+  std::mutex compile_slots_lock_;
+  std::condition_variable compile_slots_cv_;
+  std::map<std::string, size_t> worker_compiles_;
   // The mesh service which is used to coordinate all the client hosts which are
   // feeding different TPU devices in a POD (or slice) training.
   std::unique_ptr<service::MeshService> mesh_service_;
@@ -1,13 +1,40 @@
 #include "tensorflow/compiler/xla/xla_client/xrt_session.h"
 
 #include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
 
 namespace xla {
 
 XrtSession::XrtSession(const tensorflow::SessionOptions& session_options)
     : target_(session_options.target),
       root_(tensorflow::Scope::NewRootScope()),
-      session_(root_, session_options) {}
+      session_(root_, session_options),
+      rpc_metric_(absl::StrCat("XrtRpcTime.", target_),
+                  metrics::MetricFnTime) {}
+
+tensorflow::Status XrtSession::Run(
+    const tensorflow::ClientSession::FeedType& inputs,
+    const std::vector<tensorflow::Output>& fetch_outputs,
+    const std::vector<tensorflow::Operation>& run_outputs,
+    std::vector<tensorflow::Tensor>* outputs) {
+  static const int64 timeout_ms = sys_util::GetEnvInt("XRT_RPC_TIMEOUT_MS", 0);
+  tensorflow::RunOptions run_options;
+  if (timeout_ms > 0) {
+    run_options.set_timeout_in_ms(timeout_ms);
+  }
+  tensorflow::Status status;
+  {
+    metrics::TimedSection timed(&rpc_metric_);
+    status = session_.Run(run_options, inputs, fetch_outputs, run_outputs,
+                          outputs, /*run_metadata=*/nullptr);
+  }
+  if (status.code() == tensorflow::error::DEADLINE_EXCEEDED) {
+    XLA_COUNTER("XrtRpcDeadlineExceeded", 1);
+    TF_LOG(ERROR) << "XRT call to " << target_ << " exceeded the "
+                  << timeout_ms << "ms deadline";
+  }
+  return status;
+}
 
 void XrtSession::Reset() {
   for (auto& name_cache : node_cache_) {
@@ -14,6 +14,7 @@
 #include "tensorflow/cc/ops/standard_ops.h"
 #include "tensorflow/compiler/xla/types.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
 
 namespace xla {
 
@@ -81,6 +82,20 @@ class XrtSession {
 
   tensorflow::ClientSession* session() { return &session_; }
 
+  // Runs the session graph with the XRT_RPC_TIMEOUT_MS deadline (if set), and
+  // records the time taken within the XrtRpcTime.<target> metric, which allows
+  // to spot the straggling workers.
+  tensorflow::Status Run(const tensorflow::ClientSession::FeedType& inputs,
+                         const std::vector<tensorflow::Output>& fetch_outputs,
+                         const std::vector<tensorflow::Operation>& run_outputs,
+                         std::vector<tensorflow::Tensor>* outputs);
+
+  tensorflow::Status Run(const tensorflow::ClientSession::FeedType& inputs,
+                         const std::vector<tensorflow::Output>& fetch_outputs,
+                         std::vector<tensorflow::Tensor>* outputs) {
+    return Run(inputs, fetch_outputs, {}, outputs);
+  }
+
   NodeCache* GetNodeCache(const std::string& key) { return &node_cache_[key]; }
 
   void Reset();
@@ -92,6 +107,7 @@ class XrtSession {
   std::string target_;
   tensorflow::Scope root_;
   tensorflow::ClientSession session_;
+  metrics::Metric rpc_metric_;
   std::map<std::string, NodeCache> node_cache_;
 };
 
@@ -1,7 +1,9 @@
 #include "tensorflow/compiler/xla/xla_client/xrt_session_cache.h"
 
 #include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/multi_wait.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/thread_pool.h"
 
 namespace xla {
 
@@ -13,15 +15,31 @@ XrtSessionCache::XrtSessionCache(tensorflow::ConfigProto config,
       local_target_(std::move(local_target)) {}
 
 XrtSessionCache::Ref XrtSessionCache::GetSession(const std::string& target) {
-  std::lock_guard<std::mutex> lock(lock_);
-  auto& session_queue = session_map_[target];
-  if (!session_queue.empty()) {
-    std::shared_ptr<XrtSession> session = std::move(session_queue.back());
-    session_queue.pop_back();
-    session->Reset();
-    return Ref(this, std::move(session));
+  std::shared_ptr<XrtSession> session;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    auto& session_queue = session_map_[target];
+    if (!session_queue.empty()) {
+      std::thread::id thread_id = std::this_thread::get_id();
+      auto it = session_queue.rbegin();
+      for (; it != session_queue.rend() && it->owner != thread_id; ++it) {
+      }
+      if (it == session_queue.rend()) {
+        it = session_queue.rbegin();
+      } else {
+        XLA_COUNTER("XrtSessionAffinityHit", 1);
+      }
+      session = std::move(it->session);
+      session_queue.erase(std::next(it).base());
+    }
+  }
+  if (session == nullptr) {
+    // Sessions creation goes over the wire, so it must not happen under the
+    // cache lock, serializing all the parallel requests.
+    return Ref(this, CreateSession(target));
   }
-  return Ref(this, CreateSession(target));
+  session->Reset();
+  return Ref(this, std::move(session));
 }
 
 XrtSession* XrtSessionCache::GetSession(const std::string& target,
@@ -35,7 +53,27 @@ XrtSession* XrtSessionCache::GetSession(const std::string& target,
 
 void XrtSessionCache::AddSession(std::shared_ptr<XrtSession> session) {
   std::lock_guard<std::mutex> lock(lock_);
-  session_map_[session->target()].push_back(std::move(session));
+  auto& session_queue = session_map_[session->target()];
+  session_queue.push_back({std::move(session), std::this_thread::get_id()});
+}
+
+void XrtSessionCache::Prewarm(const std::vector<std::string>& targets,
+                              size_t count) {
+  XLA_TIMED("XrtSessionPrewarm");
+  std::vector<std::shared_ptr<XrtSession>> sessions(targets.size() * count);
+  util::MultiWait mwait(sessions.size());
+  for (size_t i = 0; i < sessions.size(); ++i) {
+    auto create = [&, i]() { sessions[i] = CreateSession(targets[i / count]); };
+    env::ScheduleIoClosure(mwait.Completer(std::move(create)));
+  }
+  mwait.Wait();
+
+  std::lock_guard<std::mutex> lock(lock_);
+  for (auto& session : sessions) {
+    // Pre-warmed sessions have no owner, so they are handed out after the ones
+    // with thread affinity.
+    session_map_[session->target()].push_front({std::move(session), {}});
+  }
 }
 
 std::shared_ptr<XrtSession> XrtSessionCache::CreateSession(
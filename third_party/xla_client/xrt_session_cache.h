@@ -3,11 +3,14 @@
 
 #include <deque>
 #include <functional>
+#include <iterator>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <utility>
+#include <vector>
 
 #include "tensorflow/compiler/xla/types.h"
 #include "tensorflow/compiler/xla/xla_client/xrt_session.h"
@@ -84,14 +87,27 @@ class XrtSessionCache {
 
   void AddSession(std::shared_ptr<XrtSession> session);
 
+  // Creates count sessions for each of the targets, in parallel, and adds them
+  // to the cache, so that the first parallel executes do not have to create
+  // and initialize them serially.
+  void Prewarm(const std::vector<std::string>& targets, size_t count);
+
  private:
+  // A cached session, together with the thread which last returned it.
+  // GetSession() prefers the sessions last used by the calling thread, whose
+  // node caches have been populated for the devices that thread works with.
+  struct SessionEntry {
+    std::shared_ptr<XrtSession> session;
+    std::thread::id owner;
+  };
+
   std::shared_ptr<XrtSession> CreateSession(const std::string& target) const;
 
   tensorflow::ConfigProto config_;
   std::function<void(XrtSession*)> initfn_;
   std::string local_target_;
   std::mutex lock_;
-  std::map<std::string, std::deque<std::shared_ptr<XrtSession>>> session_map_;
+  std::map<std::string, std::deque<SessionEntry>> session_map_;
 };
 
 }  // namespace xla
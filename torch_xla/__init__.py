@@ -1,3 +1,4 @@
+import atexit
 import os
 import re
 
@@ -51,3 +52,5 @@ from .version import __version__
 import _XLAC
 
 _XLAC._initialize_aten_bindings()
+# Makes sure the graphs saved via XLA_SAVE_TENSORS_FILE are all written out.
+atexit.register(_XLAC._xla_flush_graph_dumps)
@@ -1,4 +1,6 @@
+import math
 import torch
+import torch.nn.functional as F
 import torch_xla
 import torch_xla.core.xla_model as xm
 
@@ -84,27 +86,928 @@ def all_gather(value, dim=0):
   return AllGather.apply(value, dim)
 
 
-def nms(boxes, scores, score_threshold, iou_threshold, output_size):
+class AllToAll(torch.autograd.Function):
+
+  @staticmethod
+  def forward(ctx, input, split_dimension, concat_dimension, split_count,
+              groups):
+    ctx.split_dimension = split_dimension
+    ctx.concat_dimension = concat_dimension
+    ctx.split_count = split_count
+    ctx.groups = groups
+    return xm.all_to_all(
+        input, split_dimension, concat_dimension, split_count, groups=groups)
+
+  @staticmethod
+  def backward(ctx, grad_output):
+    # The gradients flow back to where the chunks came from, which is an
+    # all-to-all with the split and concat dimensions swapped.
+    return xm.all_to_all(
+        grad_output,
+        ctx.concat_dimension,
+        ctx.split_dimension,
+        ctx.split_count,
+        groups=ctx.groups), None, None, None, None
+
+
+def all_to_all(value,
+               split_dimension,
+               concat_dimension,
+               split_count,
+               groups=None):
+  """Performs an XLA `AllToAll()` operation on the input tensor.
+
+  This is the same as `xm.all_to_all()` but supports autograd differentiation.
+
+  Args:
+    value (torch.Tensor): The input tensor.
+    split_dimension (int): The dimension upon which the split should happen.
+    concat_dimension (int): The dimension upon which the concat should happen.
+    split_count (int): The split count.
+    groups (list, optional): A list of list, representing the replica groups for
+      the `all_to_all()` operation. If `None` there will be only one group with
+      all the replicas in it.
+  Returns:
+    The result `torch.Tensor` of the `all_to_all()` operation.
+  """
+  return AllToAll.apply(value, split_dimension, concat_dimension, split_count,
+                        groups)
+
+
+def _get_group_ordinal(groups):
+  ordinal = xm.get_ordinal()
+  for group in groups or []:
+    if ordinal in group:
+      return group.index(ordinal)
+  return ordinal
+
+
+def _linear_weight_grads(ctx, grad_output, input):
+  grad_output_2d = grad_output.reshape(-1, grad_output.size(-1))
+  grad_weight = grad_bias = None
+  if ctx.needs_input_grad[1]:
+    grad_weight = grad_output_2d.t().matmul(input.reshape(-1, input.size(-1)))
+  if ctx.needs_input_grad[2]:
+    grad_bias = grad_output_2d.sum(0)
+  return grad_weight, grad_bias
+
+
+class ColumnParallelLinear(torch.autograd.Function):
+
+  @staticmethod
+  def forward(ctx, input, weight, bias, gather_output, groups, num_chunks):
+    ctx.gather_output = gather_output
+    ctx.groups = groups
+    ctx.num_chunks = num_chunks
+    ctx.save_for_backward(input, weight)
+    return xm.column_parallel_matmul(
+        input,
+        weight,
+        bias=bias,
+        gather_output=gather_output,
+        groups=groups,
+        num_chunks=num_chunks)
+
+  @staticmethod
+  def backward(ctx, grad_output):
+    input, weight = ctx.saved_tensors
+    if ctx.gather_output:
+      shard_size = weight.size(0)
+      grad_output = torch.narrow(grad_output, -1,
+                                 _get_group_ordinal(ctx.groups) * shard_size,
+                                 shard_size)
+    grad_input = None
+    if ctx.needs_input_grad[0]:
+      # The input is shared by all the replicas, so its gradient is the sum of
+      # the ones of every weight shard, which is a row parallel matmul with the
+      # transposed weight.
+      grad_input = xm.row_parallel_matmul(
+          grad_output,
+          weight.t(),
+          groups=ctx.groups,
+          num_chunks=ctx.num_chunks)
+    grad_weight, grad_bias = _linear_weight_grads(ctx, grad_output, input)
+    return grad_input, grad_weight, grad_bias, None, None, None
+
+
+def column_parallel_linear(input,
+                           weight,
+                           bias=None,
+                           gather_output=True,
+                           groups=None,
+                           num_chunks=1):
+  """Applies a linear layer whose weight is sharded along the output features.
+
+  This is the same as `xm.column_parallel_matmul()` but supports autograd
+  differentiation. The backward sums the input gradients of the replicas with
+  a single fused matmul and all-reduce.
+
+  Args:
+    input (torch.Tensor): The `[..., K]` input tensor, same on all the replicas.
+    weight (torch.Tensor): The `[N, K]` weight shard of the replica.
+    bias (torch.Tensor, optional): The `[N]` bias shard of the replica.
+      Default: None
+    gather_output (bool, optional): Whether the results of the replicas should
+      be all-gathered along the last dimension. A column parallel layer
+      followed by a row parallel one usually does not gather its output.
+      Default: True
+    groups (list, optional): A list of list, representing the replica groups for
+      the collective operations. If `None` there will be only one group with
+      all the replicas in it.
+    num_chunks (int, optional): The number of chunks the matmuls are split
+      into, to overlap the collectives with the computation.
+      Default: 1
+  Returns:
+    The `[..., N * GROUP_SIZE]` result if `gather_output` is `True`, or the
+    `[..., N]` result of the replica otherwise.
+  """
+  return ColumnParallelLinear.apply(input, weight, bias, gather_output, groups,
+                                    num_chunks)
+
+
+class RowParallelLinear(torch.autograd.Function):
+
+  @staticmethod
+  def forward(ctx, input, weight, bias, scatter_output, groups, num_chunks):
+    ctx.scatter_output = scatter_output
+    ctx.groups = groups
+    ctx.save_for_backward(input, weight)
+    return xm.row_parallel_matmul(
+        input,
+        weight,
+        bias=bias,
+        scatter_output=scatter_output,
+        groups=groups,
+        num_chunks=num_chunks)
+
+  @staticmethod
+  def backward(ctx, grad_output):
+    input, weight = ctx.saved_tensors
+    if ctx.scatter_output:
+      grad_output = xm.all_gather(grad_output, dim=0, groups=ctx.groups)
+    grad_input = None
+    if ctx.needs_input_grad[0]:
+      grad_input = grad_output.matmul(weight)
+    grad_weight, grad_bias = _linear_weight_grads(ctx, grad_output, input)
+    return grad_input, grad_weight, grad_bias, None, None, None
+
+
+def row_parallel_linear(input,
+                        weight,
+                        bias=None,
+                        scatter_output=False,
+                        groups=None,
+                        num_chunks=1):
+  """Applies a linear layer whose weight is sharded along the input features.
+
+  This is the same as `xm.row_parallel_matmul()` but supports autograd
+  differentiation.
+
+  Args:
+    input (torch.Tensor): The `[..., K]` input shard of the replica, like the
+      output of a `column_parallel_linear()` with `gather_output=False`.
+    weight (torch.Tensor): The `[N, K]` weight shard of the replica.
+    bias (torch.Tensor, optional): The `[N]` bias, same on all the replicas.
+      Default: None
+    scatter_output (bool, optional): Whether the reduced result should be
+      reduce-scattered along its first dimension, instead of all-reduced.
+      Default: False
+    groups (list, optional): A list of list, representing the replica groups for
+      the collective operations. If `None` there will be only one group with
+      all the replicas in it.
+    num_chunks (int, optional): The number of chunks the matmul is split into,
+      to overlap the reduction with the computation.
+      Default: 1
+  Returns:
+    The `[..., N]` reduced result, or the shard of the replica along the first
+    dimension if `scatter_output` is `True`.
+  """
+  return RowParallelLinear.apply(input, weight, bias, scatter_output, groups,
+                                 num_chunks)
+
+
+class ScaledDotProductAttention(torch.autograd.Function):
+
+  @staticmethod
+  def forward(ctx, query, key, value, scale, block_size):
+    ctx.scale = scale
+    ctx.block_size = block_size
+    output, logsumexp = torch_xla._XLAC._xla_scaled_dot_product_attention(
+        query, key, value, scale, block_size)
+    # Only the per query logsumexp is saved, and the attention probabilities
+    # are recomputed by the backward.
+    ctx.save_for_backward(query, key, value, output, logsumexp)
+    return output
+
+  @staticmethod
+  def backward(ctx, grad_output):
+    query, key, value, output, logsumexp = ctx.saved_tensors
+    grad_query, grad_key, grad_value = (
+        torch_xla._XLAC._xla_scaled_dot_product_attention_backward(
+            grad_output, query, key, value, output, logsumexp, ctx.scale,
+            ctx.block_size))
+    return grad_query, grad_key, grad_value, None, None
+
+
+def scaled_dot_product_attention(query, key, value, scale=None,
+                                 block_size=512):
+  """Computes `softmax(query @ key^T * scale) @ value` as a single fused op.
+
+  The key sequence is processed in blocks, with the softmax computed online, so
+  that the `[Sq, Sk]` attention scores are never materialized, neither in the
+  forward nor in the backward pass (which recomputes them block by block).
+
+  Args:
+    query (torch.Tensor): The `[..., Sq, D]` query tensor.
+    key (torch.Tensor): The `[..., Sk, D]` key tensor.
+    value (torch.Tensor): The `[..., Sk, Dv]` value tensor.
+    scale (float, optional): The scale applied to the attention scores. If
+      `None`, `1 / sqrt(D)` is used.
+      Default: None
+    block_size (int, optional): The size of the key blocks. If it does not
+      divide `Sk`, the whole key sequence is processed as a single block.
+      Default: 512
+  Returns:
+    The `[..., Sq, Dv]` attention output.
+  """
+  if scale is None:
+    scale = 1.0 / math.sqrt(query.size(-1))
+  return ScaledDotProductAttention.apply(query, key, value, scale, block_size)
+
+
+class Dropout(torch.autograd.Function):
+
+  @staticmethod
+  def forward(ctx, input, p):
+    ctx.p = p
+    output, seed = torch_xla._XLAC._xla_dropout(input, p)
+    # Only the scalar seed is saved, and the backward regenerates the mask.
+    ctx.save_for_backward(seed)
+    return output
+
+  @staticmethod
+  def backward(ctx, grad_output):
+    seed, = ctx.saved_tensors
+    grad_input = torch_xla._XLAC._xla_dropout_backward(grad_output, seed,
+                                                       ctx.p)
+    return grad_input, None
+
+
+def dropout(input, p=0.5, training=True):
+  """Computes `F.dropout()` without keeping the mask alive for the backward.
+
+  The mask is drawn from raw 32 bit random words compared to a threshold, and
+  the scaling is fused with the masking. The backward regenerates the mask from
+  the seed of the forward, so a dropout layer only keeps a scalar for the
+  backward, instead of a mask as large as its input.
+
+  Args:
+    input (torch.Tensor): The input tensor.
+    p (float, optional): The probability of an element to be zeroed.
+      Default: 0.5
+    training (bool, optional): Whether to apply the dropout. If `False`, the
+      input is returned.
+      Default: True
+  Returns:
+    The input with the dropped elements zeroed, and the other ones scaled by
+    `1 / (1 - p)`.
+  """
+  assert 0.0 <= p <= 1.0, 'Invalid dropout probability: {}'.format(p)
+  if not training or p == 0.0:
+    return input
+  return Dropout.apply(input, p)
+
+
+class SyncBatchNorm(torch.autograd.Function):
+
+  @staticmethod
+  def forward(ctx, input, weight, bias, eps, groups):
+    ctx.groups = groups
+    output, mean, invstd, count = xm.sync_batch_norm(
+        input, weight, bias, eps=eps, groups=groups)
+    ctx.save_for_backward(input, weight, mean, invstd, count)
+    ctx.mark_non_differentiable(mean, invstd, count)
+    return output, mean, invstd, count
+
+  @staticmethod
+  def backward(ctx, grad_output, grad_mean, grad_invstd, grad_count):
+    input, weight, mean, invstd, count = ctx.saved_tensors
+    grad_input, grad_weight, grad_bias = xm.sync_batch_norm_backward(
+        grad_output, input, weight, mean, invstd, count, groups=ctx.groups)
+    return grad_input, grad_weight, grad_bias, None, None
+
+
+def sync_batch_norm(input,
+                    running_mean,
+                    running_var,
+                    weight=None,
+                    bias=None,
+                    training=True,
+                    momentum=0.1,
+                    eps=1e-5,
+                    groups=None):
+  """Computes `F.batch_norm()` with the statistics of all the replicas.
+
+  In training mode, the statistics are computed over the inputs of all the
+  replicas of the group, with a single all-reduce of the packed per feature
+  sums, and the backward issues a single all-reduce too. The running
+  statistics are updated in place with the global ones. In eval mode this is
+  the same as `F.batch_norm()`.
+
+  Args:
+    input (torch.Tensor): The `[N, C, ...]` input of the replica.
+    running_mean (torch.Tensor): The `[C]` running mean, or `None`.
+    running_var (torch.Tensor): The `[C]` running variance, or `None`.
+    weight (torch.Tensor, optional): The `[C]` weight.
+      Default: None
+    bias (torch.Tensor, optional): The `[C]` bias.
+      Default: None
+    training (bool, optional): Whether the batch statistics are used.
+      Default: True
+    momentum (float, optional): The running statistics update factor.
+      Default: 0.1
+    eps (float, optional): The value added to the variance.
+      Default: 1e-5
+    groups (list, optional): A list of list, representing the replica groups for
+      the collective operations. If `None` there will be only one group with
+      all the replicas in it.
+  Returns:
+    The normalized input.
+  """
+  if not training:
+    return F.batch_norm(
+        input,
+        running_mean,
+        running_var,
+        weight=weight,
+        bias=bias,
+        training=False,
+        eps=eps)
+  num_features = input.size(1)
+  if weight is None:
+    weight = torch.ones(num_features, dtype=input.dtype, device=input.device)
+  if bias is None:
+    bias = torch.zeros(num_features, dtype=input.dtype, device=input.device)
+  output, mean, invstd, count = SyncBatchNorm.apply(input, weight, bias, eps,
+                                                    groups)
+  if running_mean is not None and running_var is not None:
+    with torch.no_grad():
+      variance = (1.0 / (invstd * invstd) - eps) * count / (count - 1)
+      running_mean.mul_(1.0 - momentum).add_(mean, alpha=momentum)
+      running_var.mul_(1.0 - momentum).add_(variance, alpha=momentum)
+  return output
+
+
+def quantize_weight(weight):
+  """Quantizes a weight to int8 values, with a symmetric per channel scale.
+
+  Every output channel (the first dimension of the `[out_features, ...]` linear
+  and convolution weights) gets the scale mapping its largest absolute value
+  to 127, and a zero point of 0.
+
+  Args:
+    weight (torch.Tensor): The floating point weight.
+  Returns:
+    A `(qweight, scale, zero_point)` tuple, with the `torch.int8` quantized
+    weight, and the `[out_features]` floating point scales and `torch.int32`
+    zero points, usable with :func:`quantized_linear` and
+    :func:`quantized_conv2d`.
+  """
+  max_abs = weight.detach().abs().reshape(weight.size(0), -1).max(dim=1)[0]
+  scale = torch.where(max_abs > 0, max_abs / 127.0, torch.ones_like(max_abs))
+  scale_shape = [-1] + [1] * (weight.dim() - 1)
+  qweight = torch.clamp(
+      torch.round(weight.detach() / scale.reshape(scale_shape)), -128,
+      127).to(torch.int8)
+  zero_point = torch.zeros(
+      weight.size(0), dtype=torch.int32, device=weight.device)
+  return qweight, scale, zero_point
+
+
+def _quantization_params(scale, zero_point):
+  return None if scale is None else (float(scale), int(zero_point))
+
+
+def quantized_linear(input,
+                     weight,
+                     weight_scale,
+                     weight_zero_point,
+                     bias=None,
+                     input_scale=None,
+                     input_zero_point=0,
+                     output_scale=None,
+                     output_zero_point=0):
+  """Computes `F.linear()` with an int8 quantized weight.
+
+  Without `input_scale`, only the weight is quantized (weight-only mode): it
+  is converted to the input type within the fused matmul, so only its int8
+  form lives in memory. With `input_scale`, the input is quantized too (full
+  int8 mode), and the matmul runs on integers with an int32 accumulation,
+  before the result is rescaled to floating point.
+
+  Args:
+    input (torch.Tensor): The `[..., in_features]` input. In full int8 mode
+      it can also be an already quantized `torch.int8` tensor.
+    weight (torch.Tensor): The `[out_features, in_features]` `torch.int8`
+      weight.
+    weight_scale (torch.Tensor): The `[out_features]` floating point scales.
+    weight_zero_point (torch.Tensor): The `[out_features]` integer zero points.
+    bias (torch.Tensor, optional): The `[out_features]` floating point bias.
+      Default: None
+    input_scale (float, optional): The scale of the quantized input, which
+      selects the full int8 mode.
+      Default: None
+    input_zero_point (int, optional): The zero point of the quantized input.
+      Default: 0
+    output_scale (float, optional): If not `None`, the result is requantized
+      to `torch.int8` with this scale.
+      Default: None
+    output_zero_point (int, optional): The zero point of the requantized
+      result.
+      Default: 0
+  Returns:
+    The `[..., out_features]` result.
+  """
+  return torch_xla._XLAC._xla_quantized_matmul(
+      input, weight, weight_scale, weight_zero_point, bias,
+      _quantization_params(input_scale, input_zero_point),
+      _quantization_params(output_scale, output_zero_point))
+
+
+def quantized_conv2d(input,
+                     weight,
+                     weight_scale,
+                     weight_zero_point,
+                     bias=None,
+                     stride=1,
+                     padding=0,
+                     dilation=1,
+                     groups=1,
+                     input_scale=None,
+                     input_zero_point=0,
+                     output_scale=None,
+                     output_zero_point=0):
+  """Computes `F.conv2d()` with an int8 quantized weight.
+
+  The quantization modes are the ones of :func:`quantized_linear`, with the
+  scales and zero points of the weight applying to its output channels.
+
+  Args:
+    input (torch.Tensor): The `[N, C, H, W]` input.
+    weight (torch.Tensor): The `[O, C / groups, kH, kW]` `torch.int8` weight.
+    weight_scale (torch.Tensor): The `[O]` floating point scales.
+    weight_zero_point (torch.Tensor): The `[O]` integer zero points.
+    bias (torch.Tensor, optional): The `[O]` floating point bias.
+      Default: None
+    stride (int or tuple, optional): The stride of the convolution.
+      Default: 1
+    padding (int or tuple, optional): The zero padding of the input.
+      Default: 0
+    dilation (int or tuple, optional): The dilation of the weight.
+      Default: 1
+    groups (int, optional): The number of blocked connections.
+      Default: 1
+    input_scale (float, optional): See :func:`quantized_linear`.
+      Default: None
+    input_zero_point (int, optional): See :func:`quantized_linear`.
+      Default: 0
+    output_scale (float, optional): See :func:`quantized_linear`.
+      Default: None
+    output_zero_point (int, optional): See :func:`quantized_linear`.
+      Default: 0
+  Returns:
+    The `[N, O, oH, oW]` result.
+  """
+
+  def pair(value):
+    return list(value) if isinstance(value, (list, tuple)) else [value] * 2
+
+  return torch_xla._XLAC._xla_quantized_convolution(
+      input, weight, weight_scale, weight_zero_point, bias, pair(stride),
+      pair(padding), pair(dilation), groups,
+      _quantization_params(input_scale, input_zero_point),
+      _quantization_params(output_scale, output_zero_point))
+
+
+class SparseGrad(object):
+  """A row sparse gradient of a `[num_rows, ...]` parameter.
+
+  The `values[i]` row is the gradient of the `indices[i]` row of the
+  parameter, and the values of repeated indices are summed. The size of the
+  gradient is the number of looked up rows, instead of the size of the table,
+  so its collectives and updates scale with the batch lookups.
+  """
+
+  def __init__(self, indices, values, num_rows):
+    self.indices = indices
+    self.values = values
+    self.num_rows = num_rows
+
+  def add(self, indices, values):
+    """Accumulates the gradient of more rows."""
+    self.indices = torch.cat([self.indices, indices])
+    self.values = torch.cat([self.values, values])
+
+  def to_dense(self):
+    """Returns the dense gradient, summing the values of repeated indices."""
+    dense = torch.zeros(
+        self.num_rows,
+        *self.values.shape[1:],
+        dtype=self.values.dtype,
+        device=self.values.device)
+    return dense.index_add_(0, self.indices, self.values)
+
+
+def get_sparse_grad(param):
+  """Returns the :class:`SparseGrad` of a parameter, or `None` if it has none."""
+  return getattr(param, '_xla_sparse_grad', None)
+
+
+def clear_sparse_grad(param):
+  """Drops the :class:`SparseGrad` of a parameter."""
+  param._xla_sparse_grad = None
+
+
+class SparseEmbedding(torch.autograd.Function):
+
+  @staticmethod
+  def forward(ctx, input, weight, padding_idx):
+    ctx.weight = weight
+    ctx.padding_idx = padding_idx
+    ctx.save_for_backward(input)
+    output = weight.index_select(0, input.reshape(-1))
+    return output.reshape(*input.shape, *weight.shape[1:])
+
+  @staticmethod
+  def backward(ctx, grad_output):
+    input, = ctx.saved_tensors
+    weight = ctx.weight
+    indices = input.reshape(-1)
+    values = grad_output.reshape(indices.size(0), *weight.shape[1:])
+    if ctx.padding_idx is not None:
+      mask = (indices != ctx.padding_idx).to(values.dtype)
+      values = values * mask.reshape(-1, *([1] * (values.dim() - 1)))
+    sparse_grad = get_sparse_grad(weight)
+    if sparse_grad is None:
+      weight._xla_sparse_grad = SparseGrad(indices, values, weight.size(0))
+    else:
+      sparse_grad.add(indices, values)
+    # The weight gradient only lives as a SparseGrad, and never in weight.grad.
+    return None, None, None
+
+
+def sparse_embedding(input, weight, padding_idx=None):
+  """Computes `F.embedding()` with a row sparse weight gradient.
+
+  Instead of a dense `weight.grad` as large as the whole table, the backward
+  leaves a :class:`SparseGrad` (see :func:`get_sparse_grad`), holding only the
+  looked up rows. The :func:`~torch_xla.core.xla_model.reduce_gradients` API
+  all-gathers its indices and values across the replicas, and the
+  `torch_xla.core.optimizers` optimizers consume it, with plain SGD scattering
+  the update to the looked up rows only. The other optimizers densify it into
+  the parameter `.grad` before their update.
+
+  Args:
+    input (torch.Tensor): The integer tensor with the rows to look up.
+    weight (torch.Tensor): The `[num_rows, ...]` embedding table.
+    padding_idx (int, optional): The row whose lookups do not contribute to
+      the gradient.
+      Default: None
+  Returns:
+    The `input.shape + weight.shape[1:]` embeddings.
+  """
+  if padding_idx is not None and padding_idx < 0:
+    padding_idx += weight.size(0)
+  return SparseEmbedding.apply(input, weight, padding_idx)
+
+
+def assume_unique_indices(index, sorted=False):
+  """Marks an index tensor as holding unique values.
+
+  The advanced indexing updates (like `x[index] = v` and
+  `x.index_put_((index,), v, accumulate=True)`) using the returned tensor as
+  index are lowered to scatters flagged with unique indices, which the
+  backends can run without serializing the updates. The indices coming from a
+  boolean mask are recognized as unique without calling this API.
+  Example::
+
+    perm = xf.assume_unique_indices(torch.randperm(n, device=device))
+    x[perm] = values
+
+  Args:
+    index (torch.Tensor): The integer index tensor. Its values, once wrapped
+      into the indexed dimension when negative, must be unique, or the result
+      of the updates is undefined.
+    sorted (bool, optional): Whether the values are also sorted in ascending
+      order.
+      Default: False
+  Returns:
+    The index tensor, marked as unique.
+  """
+  return torch_xla._XLAC._xla_assume_unique_indices(index, sorted=sorted)
+
+
+class CrossEntropy(torch.autograd.Function):
+
+  @staticmethod
+  def forward(ctx, logits, target, ignore_index, chunk_size):
+    ctx.ignore_index = ignore_index
+    ctx.chunk_size = chunk_size
+    loss, logsumexp = torch_xla._XLAC._xla_cross_entropy(
+        logits, target, ignore_index, chunk_size)
+    # Only the per sample logsumexp is saved, and the softmax is recomputed by
+    # the backward.
+    ctx.save_for_backward(logits, target, logsumexp)
+    return loss
+
+  @staticmethod
+  def backward(ctx, grad_output):
+    logits, target, logsumexp = ctx.saved_tensors
+    grad_logits = torch_xla._XLAC._xla_cross_entropy_backward(
+        grad_output, logits, target, logsumexp, ctx.ignore_index,
+        ctx.chunk_size)
+    return grad_logits, None, None, None
+
+
+def cross_entropy(input,
+                  target,
+                  ignore_index=-100,
+                  reduction='mean',
+                  chunk_size=None):
+  """Computes `F.cross_entropy()` as a single fused op.
+
+  The forward computes the logsumexp of the logits and gathers the target
+  logits, without materializing the log-probabilities, and the backward
+  recomputes `softmax - one_hot` from the saved logsumexp. With `chunk_size`,
+  the classes are processed in chunks, which caps the peak memory of huge
+  output layers.
+
+  Args:
+    input (torch.Tensor): The `[..., C]` logits.
+    target (torch.Tensor): The `[...]` class indices.
+    ignore_index (int, optional): The target value which does not contribute
+      to the loss.
+      Default: -100
+    reduction (string, optional): One of ``'none'``, ``'sum'`` and ``'mean'``.
+      The mean is taken over the targets which are not ignored.
+      Default: 'mean'
+    chunk_size (int, optional): The number of classes processed at once. If
+      `None`, or if it does not divide `C`, all the classes are processed
+      together.
+      Default: None
+  Returns:
+    The reduced loss, or the `[...]` per sample losses with the ``'none'``
+    reduction.
+  """
+  assert reduction in ('none', 'sum',
+                       'mean'), 'Unsupported reduction: {}'.format(reduction)
+  loss = CrossEntropy.apply(
+      input.reshape(-1, input.size(-1)), target.reshape(-1), ignore_index,
+      chunk_size or 0)
+  if reduction == 'none':
+    return loss.view(target.size())
+  if reduction == 'sum':
+    return loss.sum()
+  count = (target != ignore_index).sum().clamp(min=1)
+  return loss.sum() / count.to(loss.dtype)
+
+
+class GrowableBuffer(object):
+  """A fixed capacity device tensor, grown by appending slices to it.
+
+  Growing a tensor with `torch.cat()` copies the whole accumulated tensor at
+  every step (like the key/value caches of autoregressive decoding, which adds
+  up to quadratic copies), and changes its shape, so every step compiles a new
+  graph. This buffer instead allocates its capacity upfront, and writes every
+  new slice in place at a device side offset. As the buffer is device data
+  updated in place, the graph output gets aliased to the buffer memory, and
+  every step only copies the new slice, always with the same graph.
+  Example::
+
+    keys = xf.GrowableBuffer((batch, heads, max_len, head_dim), dim=2,
+                             device=device)
+    for step in range(max_len):
+      keys.append(new_keys)
+      scores = torch.matmul(query, keys.tensor.transpose(-2, -1))
+      scores = scores.masked_fill(~keys.mask(), float('-inf'))
+
+  Args:
+    size (tuple): The size of the buffer, with its full capacity along `dim`.
+    dim (int): The dimension the buffer grows along.
+    dtype (torch.dtype, optional): The type of the buffer.
+      Default: torch.float32
+    device (torch.device, optional): The device of the buffer. If `None` the
+      default XLA device is used.
+      Default: None
+  """
+
+  def __init__(self, size, dim, dtype=torch.float32, device=None):
+    if device is None:
+      device = xm.xla_device()
+    self._tensor = torch.zeros(size, dtype=dtype, device=device)
+    self._dim = dim if dim >= 0 else dim + self._tensor.dim()
+    self._offset = torch.zeros((), dtype=torch.int32, device=device)
+    self._length = 0
+
+  @property
+  def tensor(self):
+    """The whole buffer, including the slices not written yet."""
+    return self._tensor
+
+  @property
+  def length(self):
+    """The current length of the buffer along its growth dimension."""
+    return self._length
+
+  @property
+  def capacity(self):
+    return self._tensor.size(self._dim)
+
+  @property
+  def offset(self):
+    """The current length of the buffer, as an `int32` device scalar."""
+    return self._offset
+
+  def append(self, value):
+    """Writes a slice at the end of the buffer.
+
+    Args:
+      value (torch.Tensor): The slice to be appended. It must match the buffer
+        size in every dimension other than the growth one.
+    """
+    size = value.size(self._dim)
+    assert self._length + size <= self.capacity, (
+        'Appending {} elements to a buffer of length {} exceeds its capacity {}'
+        .format(size, self._length, self.capacity))
+    torch_xla._XLAC._xla_dynamic_update_slice_(self._tensor, value,
+                                               self._offset, self._dim)
+    self._offset += size
+    self._length += size
+
+  def view(self):
+    """Returns the written part of the buffer.
+
+    The size of the returned tensor changes with every append, so graphs using
+    it get compiled once per length. Use `tensor` together with `mask()` to
+    keep the graphs shape stable.
+    """
+    return self._tensor.narrow(self._dim, 0, self._length)
+
+  def mask(self):
+    """Returns the mask of the written part of the buffer.
+
+    Returns:
+      A `bool` tensor of the buffer rank, with the buffer capacity along the
+      growth dimension and size one along the others, which is `True` on the
+      written positions.
+    """
+    size = [1] * self._tensor.dim()
+    size[self._dim] = self.capacity
+    positions = torch.arange(
+        self.capacity, dtype=torch.int32, device=self._tensor.device)
+    return (positions < self._offset).view(size)
+
+  def reset(self):
+    """Empties the buffer, keeping its memory."""
+    self._offset.zero_()
+    self._length = 0
+
+
+class KVCache(object):
+  """Static key/value caches for autoregressive decoding.
+
+  The keys and values of every layer are kept in `GrowableBuffer` objects of
+  fixed maximum length, and the attention runs over their whole capacity,
+  masking the positions past the current one. The current position is a
+  device scalar, so the graph of a generation step does not change as the
+  sequence grows, and the whole generation loop compiles once (plus once for
+  the prompt, if its length differs from the per step one).
+  Example::
+
+    cache = xf.KVCache(num_layers, batch, heads, max_len, head_dim,
+                       device=device)
+    for step in range(num_tokens):
+      # Within the layer `i` of the model:
+      #   output = cache.attention(i, query, key, value)
+      logits = model(tokens, cache)
+      tokens = logits[:, -1:].argmax(dim=-1)
+      xm.mark_step()
+
+  Args:
+    num_layers (int): The number of attention layers.
+    batch_size (int): The batch size.
+    num_heads (int): The number of attention heads.
+    max_length (int): The maximum sequence length, prompt included.
+    head_dim (int): The size of every key and value head.
+    dtype (torch.dtype, optional): The type of the caches.
+      Default: torch.float32
+    device (torch.device, optional): The device of the caches. If `None` the
+      default XLA device is used.
+      Default: None
+  """
+
+  def __init__(self,
+               num_layers,
+               batch_size,
+               num_heads,
+               max_length,
+               head_dim,
+               dtype=torch.float32,
+               device=None):
+    size = (batch_size, num_heads, max_length, head_dim)
+    self._keys = [
+        GrowableBuffer(size, dim=2, dtype=dtype, device=device)
+        for _ in range(num_layers)
+    ]
+    self._values = [
+        GrowableBuffer(size, dim=2, dtype=dtype, device=device)
+        for _ in range(num_layers)
+    ]
+
+  @property
+  def length(self):
+    """The number of positions written in the caches."""
+    return self._keys[0].length
+
+  def attention(self, layer, query, key, value, scale=None):
+    """Appends the new keys and values of a layer, and attends over the cache.
+
+    Every query attends to the cached positions up to its own one, so a
+    multi token prompt gets causal masking.
+
+    Args:
+      layer (int): The index of the layer.
+      query (torch.Tensor): The `[B, H, S, D]` queries of the new positions.
+      key (torch.Tensor): The `[B, H, S, D]` keys of the new positions.
+      value (torch.Tensor): The `[B, H, S, D]` values of the new positions.
+      scale (float, optional): The scaling applied to the attention scores. If
+        `None`, `1 / sqrt(D)` is used.
+        Default: None
+    Returns:
+      The `[B, H, S, D]` attention output.
+    """
+    keys = self._keys[layer]
+    values = self._values[layer]
+    if scale is None:
+      scale = 1.0 / math.sqrt(query.size(-1))
+    num_queries = query.size(-2)
+    query_positions = keys.offset + torch.arange(
+        num_queries, dtype=torch.int32, device=query.device)
+    keys.append(key)
+    values.append(value)
+    key_positions = torch.arange(
+        keys.capacity, dtype=torch.int32, device=query.device)
+    mask = key_positions.view(1, -1) <= query_positions.view(-1, 1)
+    scores = torch.matmul(query, keys.tensor.transpose(-2, -1)) * scale
+    scores = scores.masked_fill(~mask, float('-inf'))
+    return torch.matmul(F.softmax(scores, dim=-1), values.tensor)
+
+  def reset(self):
+    """Empties the caches, keeping their memory."""
+    for buffer in self._keys + self._values:
+      buffer.reset()
+
+
+def nms(boxes,
+        scores,
+        score_threshold,
+        iou_threshold,
+        output_size,
+        top_k=None):
   """Performs a Non Maximal Suppression operation.
 
+  Many independent problems (like the classes of a batch of images) can be
+  handled by a single call, by adding leading dimensions to the inputs.
+
   Args:
     boxes (torch.Tensor): A `torch.Tensor` of shape `[N, 4]` listing the boxes
-      coordinates in `(y0, x0, y1, x1)` form.
+      coordinates in `(y0, x0, y1, x1)` form. In the batched form, the shape is
+      `[B, C, N, 4]`, or `[B, N, 4]` if the boxes are shared by all the classes.
     scores (torch.Tensor): A `torch.Tensor` of shape `[N]` listing the scores
-      of each box.
+      of each box. In the batched form, the shape is `[B, C, N]`.
     score_threshold (torch.Tensor): The minimum score for a box to qualify as
       valid.
     iou_threshold (torch.Tensor): The minimum IOU (Intersection Over Union)
       score to trigger overlap logic.
     output_size (int): The maximum number of returned indices (must be lower or
-      equal to N).
+      equal to N, or to `top_k` if specified).
+    top_k (int, optional): If specified, only the `top_k` highest scoring boxes
+      of each problem are considered, which is much cheaper than considering
+      all the `N` boxes when `top_k` is small compared with `N`.
+      Default: None
 
   Returns:
     A tuple of `torch.Tensor` with the first element being the selected box
-    indices, and the second element being the number of valid boxes.
+    indices, and the second element being the number of valid boxes. In the
+    batched form, the shapes are `[B, C, output_size]` and `[B, C]`.
   """
-  return torch_xla._XLAC._xla_nms(boxes, scores, score_threshold, iou_threshold,
-                                  output_size)
+  return torch_xla._XLAC._xla_nms(
+      boxes,
+      scores,
+      score_threshold,
+      iou_threshold,
+      output_size,
+      top_k=top_k if top_k is not None else -1)
 
 
 def distributed_mm(w, x, split=1):
@@ -150,3 +1053,74 @@ def distributed_mm(w, x, split=1):
     wx = torch.narrow(rwxg, 1, ordinal * xs.size(1), xs.size(1))
     results.append(wx)
   return torch.cat(results, dim=1) if len(results) > 1 else results[0]
+
+
+def sharded_embedding_bag(weight,
+                          indices,
+                          offsets,
+                          num_embeddings,
+                          mode='sum',
+                          per_sample_weights=None):
+  """Performs an embedding bag lookup into a table sharded across replicas.
+
+  Every replica holds the `num_embeddings / WORLD_SIZE` rows shard of the table
+  for its ordinal, and its own batch of bags. The indices of all the replicas
+  are gathered, every replica reduces the bags of all the replicas over its
+  own rows only, and the partial results are exchanged with an `all_to_all()`
+  so that each replica sums the contributions to its own bags.
+
+  Args:
+    weight (torch.Tensor): The `[num_embeddings / WORLD_SIZE, D]` local shard
+      of the table.
+    indices (torch.Tensor): The rank 1 `torch.long` tensor with the table rows
+      to be looked up. All the replicas must use the same number of indices.
+    offsets (torch.Tensor): The rank 1 `torch.long` tensor with the start of
+      each bag within `indices`. All the replicas must use the same number of
+      bags.
+    num_embeddings (int): The number of rows of the whole table.
+    mode (string, optional): Either ``'sum'`` or ``'mean'``.
+      Default: 'sum'
+    per_sample_weights (torch.Tensor, optional): The weights of each index,
+      supported only with the ``'sum'`` mode.
+      Default: None
+  Returns:
+    The `[num_bags, D]` tensor with the reductions of the local bags.
+  """
+  assert mode in ('sum', 'mean'), 'Unsupported mode: {}'.format(mode)
+  assert mode == 'sum' or per_sample_weights is None
+  world_size = xm.xrt_world_size()
+  ordinal = xm.get_ordinal()
+  assert num_embeddings % world_size == 0
+  shard_size = num_embeddings // world_size
+  assert weight.size(0) == shard_size
+  num_indices = indices.size(0)
+  num_bags = offsets.size(0)
+  # The offsets of the gathered indices, of each replica, need to move to
+  # where the replica indices land.
+  all_indices = xm.all_gather(indices, dim=0)
+  bag_replicas = torch.arange(
+      0, world_size * num_bags, device=offsets.device) // num_bags
+  all_offsets = xm.all_gather(offsets, dim=0) + bag_replicas * num_indices
+  local_indices = all_indices - ordinal * shard_size
+  in_shard = (local_indices >= 0) & (local_indices < shard_size)
+  sample_weights = in_shard.to(weight.dtype)
+  if per_sample_weights is not None:
+    sample_weights = sample_weights * xm.all_gather(per_sample_weights, dim=0)
+  partial = F.embedding_bag(
+      torch.where(in_shard, local_indices, torch.zeros_like(local_indices)),
+      weight,
+      all_offsets,
+      mode='sum',
+      per_sample_weights=sample_weights)
+  # partial = (WORLD_SIZE * num_bags) x D, with the bags of replica R at the
+  # R-th chunk, which the all_to_all() sends to replica R.
+  partial = all_to_all(partial, 0, 0, world_size)
+  output = partial.view(world_size, num_bags, -1).sum(dim=0)
+  if mode == 'mean':
+    ends = torch.cat([
+        offsets[1:],
+        torch.tensor([num_indices], dtype=offsets.dtype, device=offsets.device)
+    ])
+    bag_size = torch.clamp(ends - offsets, min=1)
+    output = output / bag_size.unsqueeze(1).to(output.dtype)
+  return output
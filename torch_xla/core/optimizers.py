@@ -0,0 +1,144 @@
+import math
+import torch
+import torch_xla
+import torch_xla.core.functions as xf
+import torch_xla.core.xla_model as xm
+
+
+def _group_params(params, key_fn):
+  groups = dict()
+  for p in params:
+    groups.setdefault(key_fn(p), []).append(p)
+  return groups.values()
+
+
+def _apply_sparse_grads(group, lr=None):
+  # Consumes the row sparse gradients of the group. With lr, they are applied
+  # as a plain SGD update scattered to their rows, otherwise they are densified
+  # into the parameter gradients.
+  for p in group['params']:
+    sparse_grad = xf.get_sparse_grad(p)
+    if sparse_grad is None:
+      continue
+    if lr is not None:
+      p.data.index_add_(0, sparse_grad.indices, sparse_grad.values * -lr)
+    elif p.grad is None:
+      p.grad = sparse_grad.to_dense()
+    else:
+      p.grad.data.add_(sparse_grad.to_dense())
+    xf.clear_sparse_grad(p)
+
+
+def _fallback_step(base, group, params=None):
+  # Runs the base class step() on the given group only, optionally restricted
+  # to a subset of its parameters.
+  if params is not None and not params:
+    return
+  optimizer = base.__self__
+  saved_param_groups = optimizer.param_groups
+  fallback_group = dict(group)
+  if params is not None:
+    fallback_group['params'] = params
+  optimizer.param_groups = [fallback_group]
+  try:
+    base.step()
+  finally:
+    optimizer.param_groups = saved_param_groups
+
+
+class Adam(torch.optim.Adam):
+  """A `torch.optim.Adam` which updates all the XLA parameters with one IR node.
+
+  The parameters are updated in place by a single fused operation per device,
+  instead of the chain of element-wise operations the stock implementation
+  issues for every parameter. Non XLA parameters, sparse gradients and the
+  `amsgrad` variant fall back to the `torch.optim.Adam` implementation. The
+  row sparse gradients of :func:`torch_xla.core.functions.sparse_embedding`
+  are densified before the update.
+  """
+
+  def step(self, closure=None):
+    loss = None
+    if closure is not None:
+      loss = closure()
+    for group in self.param_groups:
+      _apply_sparse_grads(group)
+      if group['amsgrad']:
+        _fallback_step(super(Adam, self), group)
+        continue
+      params = []
+      fallback_params = []
+      for p in group['params']:
+        if p.grad is None:
+          continue
+        if xm.is_xla_tensor(p) and not p.grad.is_sparse:
+          params.append(p)
+        else:
+          fallback_params.append(p)
+      _fallback_step(super(Adam, self), group, params=fallback_params)
+      for p in params:
+        state = self.state[p]
+        if len(state) == 0:
+          state['step'] = 0
+          state['exp_avg'] = torch.zeros_like(p.data)
+          state['exp_avg_sq'] = torch.zeros_like(p.data)
+        state['step'] += 1
+      beta1, beta2 = group['betas']
+      for gparams in _group_params(
+          params, lambda p: (p.device, self.state[p]['step'])):
+        step = self.state[gparams[0]]['step']
+        bias_correction1 = 1 - beta1**step
+        bias_correction2 = 1 - beta2**step
+        torch_xla._XLAC._xla_adam_step_multi(
+            [p.data for p in gparams], [p.grad.data for p in gparams],
+            [self.state[p]['exp_avg'] for p in gparams],
+            [self.state[p]['exp_avg_sq'] for p in gparams],
+            group['lr'] / bias_correction1, math.sqrt(bias_correction2), beta1,
+            beta2, group['eps'], group['weight_decay'])
+    return loss
+
+
+class SGD(torch.optim.SGD):
+  """A `torch.optim.SGD` which updates all the XLA parameters with one IR node.
+
+  When momentum is used, the parameters and their momentum buffers are updated
+  in place by a single fused operation per device. Non XLA parameters, sparse
+  gradients and groups without momentum fall back to the `torch.optim.SGD`
+  implementation. The row sparse gradients of
+  :func:`torch_xla.core.functions.sparse_embedding` are scattered to their rows
+  when neither momentum nor weight decay is used, and densified otherwise.
+  """
+
+  def step(self, closure=None):
+    loss = None
+    if closure is not None:
+      loss = closure()
+    for group in self.param_groups:
+      plain_sgd = group['momentum'] == 0 and group['weight_decay'] == 0
+      _apply_sparse_grads(group, lr=group['lr'] if plain_sgd else None)
+      if group['momentum'] == 0:
+        _fallback_step(super(SGD, self), group)
+        continue
+      params = []
+      fallback_params = []
+      for p in group['params']:
+        if p.grad is None:
+          continue
+        if xm.is_xla_tensor(p) and not p.grad.is_sparse:
+          params.append(p)
+        else:
+          fallback_params.append(p)
+      _fallback_step(super(SGD, self), group, params=fallback_params)
+      for gparams in _group_params(
+          params,
+          lambda p: (p.device, 'momentum_buffer' not in self.state[p])):
+        init_momentum_buffers = 'momentum_buffer' not in self.state[gparams[0]]
+        if init_momentum_buffers:
+          for p in gparams:
+            self.state[p]['momentum_buffer'] = torch.zeros_like(p.data)
+        torch_xla._XLAC._xla_sgd_momentum_step_multi(
+            [p.data for p in gparams], [p.grad.data for p in gparams],
+            [self.state[p]['momentum_buffer'] for p in gparams], group['lr'],
+            group['momentum'], group['dampening'], group['weight_decay'],
+            group['nesterov'], init_momentum_buffers)
+    return loss
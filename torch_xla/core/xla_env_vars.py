@@ -5,6 +5,7 @@ SERVICE_ADDRESS = 'XRT_MESH_SERVICE_ADDRESS'
 DEVICE_MAP = 'XRT_DEVICE_MAP'
 WORKERS = 'XRT_WORKERS'
 LOCAL_ORDINAL = 'XRT_SHARD_LOCAL_ORDINAL'
+LOCAL_WORLD_SIZE = 'XRT_SHARD_LOCAL_WORLD_SIZE'
 ORDINAL = 'XRT_SHARD_ORDINAL'
 WORLD_SIZE = 'XRT_SHARD_WORLD_SIZE'
 TPU_NUM_DEVICES = 'TPU_NUM_DEVICES'
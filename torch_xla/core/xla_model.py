@@ -1,12 +1,16 @@
 from __future__ import print_function
 
+import atexit
 import collections
+import contextlib
 import io
 import sys
 import os
+import queue
 import re
 import threading
 import time
+import weakref
 import torch
 import torch.nn.functional as F
 import torch_xla
@@ -21,8 +25,14 @@ REDUCE_AND = 'and'
 REDUCE_OR = 'or'
 REDUCE_MIN = 'min'
 REDUCE_MAX = 'max'
+# Sum of the floating point values in BF16, which halves the communication
+# volume of FP32 gradients.
+REDUCE_SUM_BF16 = 'sum_bf16'
 
 _TLS = threading.local()
+# The per parameter errors introduced by the BF16 compression of the gradients,
+# fed back to the next step gradients.
+_BF16_RESIDUALS = weakref.WeakKeyDictionary()
 
 
 def is_xla_tensor(tensor):
@@ -285,6 +295,71 @@ class RateTracker(object):
     return count / delta if delta > 0 else 0.0
 
 
+class MetricsReducer(object):
+  """Reduces scalar metrics (like loss and accuracy) across the replicas.
+
+  The metric tensors are accumulated on device, and every `reduce_every` steps
+  their sums are all-reduced within the training graph, with a single fused
+  `all_reduce()` for all the metrics. The reduced values are then handed to the
+  `report_fn` callable using a step closure (see `add_step_closure()`), so the
+  only transfer to host happens once the step graph has been executed, and no
+  mesh rendezvous is needed.
+
+  Args:
+    report_fn (callable): The function called with a dictionary mapping the
+      metric names to their mean across the replicas and the accumulated steps,
+      and the number of accumulated steps.
+    reduce_every (int): The number of `add()` calls after which the metrics are
+      reduced and reported.
+      Default: 1
+    groups (list, optional): The replica groups for the `all_reduce()`
+      operation, like in `all_reduce()`.
+      Default: None
+  """
+
+  def __init__(self, report_fn, reduce_every=1, groups=None):
+    assert reduce_every > 0, reduce_every
+    self._report_fn = report_fn
+    self._reduce_every = reduce_every
+    self._groups = groups
+    self._sums = collections.OrderedDict()
+    self._steps = 0
+
+  def add(self, **metrics):
+    """Adds the values of the given metrics for the current step.
+
+    Args:
+      **metrics: The metric names with their values, as scalar XLA tensors.
+        The same metrics should be passed at every step.
+    """
+    for name, value in metrics.items():
+      value = value.detach().to(torch.float32).sum()
+      current = self._sums.get(name, None)
+      self._sums[name] = value if current is None else current + value
+    self._steps += 1
+    if self._steps >= self._reduce_every:
+      self.flush()
+
+  def flush(self):
+    """Reduces and reports the metrics accumulated since the last report."""
+    if not self._sums:
+      return
+    names = list(self._sums.keys())
+    count = self._steps * _get_shard_count(self._groups)
+    reduced = all_reduce(
+        REDUCE_SUM,
+        torch.stack(list(self._sums.values())),
+        scale=1.0 / count,
+        groups=self._groups)
+    add_step_closure(self._report, args=(names, reduced, self._steps))
+    self._sums = collections.OrderedDict()
+    self._steps = 0
+
+  def _report(self, names, reduced, steps):
+    values = reduced.cpu().tolist()
+    self._report_fn(dict(zip(names, values)), steps)
+
+
 class ToXlaTensorArena(object):
 
   def __init__(self, convert_fn, select_fn):
@@ -375,6 +450,29 @@ def _fetch_gradients(optimizer):
   return gradients
 
 
+def _fetch_sparse_gradients(optimizer):
+  sparse_grads = []
+  for param_group in optimizer.__getstate__()['param_groups']:
+    for p in param_group['params']:
+      sparse_grad = getattr(p, '_xla_sparse_grad', None)
+      if sparse_grad is not None:
+        sparse_grads.append(sparse_grad)
+  return sparse_grads
+
+
+def _apply_bf16_error_feedback(optimizer):
+  for param_group in optimizer.__getstate__()['param_groups']:
+    for p in param_group['params']:
+      if (not isinstance(p, torch.Tensor) or p.grad is None or
+          p.grad.dtype not in (torch.float32, torch.float64)):
+        continue
+      grad = p.grad.data
+      residual = _BF16_RESIDUALS.get(p, None)
+      if residual is not None:
+        grad.add_(residual)
+      _BF16_RESIDUALS[p] = grad - grad.to(torch.bfloat16).to(grad.dtype)
+
+
 def _get_all_reduce_token():
   token = getattr(_TLS, 'all_reduce_token', None)
   if token is None:
@@ -388,7 +486,7 @@ def all_reduce(reduce_type, inputs, scale=1.0, groups=None):
 
   Args:
     reduce_type (string): One of ``REDUCE_SUM``, ``REDUCE_MUL``, ``REDUCE_AND``,
-      ``REDUCE_OR``, ``REDUCE_MIN`` and ``REDUCE_MIN``.
+      ``REDUCE_OR``, ``REDUCE_MIN``, ``REDUCE_MAX`` and ``REDUCE_SUM_BF16``.
     inputs: Either a single `torch.Tensor` or a list of `torch.Tensor` to
       perform the all reduce op to.
     scale (float): A default scaling value to be applied after the reduce.
@@ -416,19 +514,37 @@ def all_reduce(reduce_type, inputs, scale=1.0, groups=None):
     return inputs
 
 
-def all_gather(value, dim=0):
+def _get_shard_count(groups):
+  return len(groups[0]) if groups else xrt_world_size()
+
+
+def all_gather(value, dim=0, groups=None):
   """Performs an all-gather operation along a given dimension.
 
   Args:
     value (torch.Tensor): The input tensor.
     dim (int): The gather dimension.
       Default: 0
+    groups (list, optional): A list of list, representing the replica groups for
+      the `all_gather()` operation. Example: `[[0, 1, 2, 3], [4, 5, 6, 7]]`
+        defines two groups, one with the `[0, 1, 2, 3]` replicas and one with
+        the `[4, 5, 6, 7]` replicas. If `None` there will be only one group with
+        all the replicas in it. Only supported on TPU devices.
   Returns:
     A tensor which has, in the ``dim`` dimension, all the values from the
     participating replicas.
   """
   if dim < 0:
     dim = value.dim() + dim
+  if xla_device_hw(value.device) == 'TPU':
+    result = torch_xla._XLAC._xla_all_gather(value, _get_all_reduce_token(),
+                                             dim, _get_shard_count(groups),
+                                             groups or [])
+    _TLS.all_reduce_token = result[1]
+    return result[0]
+  # The other devices lack the AllToAll() the native all-gather is built upon,
+  # so they emulate it with an all-reduce of the zero padded values.
+  assert not groups, 'Replica groups are only supported on TPU devices'
   size = value.size(dim)
   padding = [0] * (2 * value.dim())
   idx = value.dim() - 1 - dim
@@ -438,6 +554,43 @@ def all_gather(value, dim=0):
   return all_reduce(REDUCE_SUM, F.pad(value, padding))
 
 
+def reduce_scatter(reduce_type, value, scale=1.0, scatter_dim=0, groups=None):
+  """Performs a reduce-scatter operation along a given dimension.
+
+  The input tensors of the replicas are reduced, and the result is split in
+  as many shards as the number of replicas along the ``scatter_dim`` dimension,
+  with each replica receiving the shard at its own position within the group.
+  Together with `all_gather()`, it allows to shard the optimizer state across
+  the replicas.
+
+  Args:
+    reduce_type (string): One of ``REDUCE_SUM``, ``REDUCE_MUL``, ``REDUCE_AND``,
+      ``REDUCE_OR``, ``REDUCE_MIN`` and ``REDUCE_MAX``.
+    value (torch.Tensor): The input tensor. The size of its ``scatter_dim``
+      dimension must be a multiple of the number of replicas in the group.
+    scale (float): A default scaling value to be applied after the reduce.
+      Default: 1.0
+    scatter_dim (int): The dimension upon which the result is split.
+      Default: 0
+    groups (list, optional): A list of list, representing the replica groups for
+      the `reduce_scatter()` operation. Example: `[[0, 1, 2, 3], [4, 5, 6, 7]]`
+        defines two groups, one with the `[0, 1, 2, 3]` replicas and one with
+        the `[4, 5, 6, 7]` replicas. If `None` there will be only one group with
+        all the replicas in it.
+  Returns:
+    The shard of the reduced tensor which belongs to the calling replica.
+  """
+  if scatter_dim < 0:
+    scatter_dim = value.dim() + scatter_dim
+  result = torch_xla._XLAC._xla_reduce_scatter(reduce_type, value,
+                                               _get_all_reduce_token(), scale,
+                                               scatter_dim,
+                                               _get_shard_count(groups),
+                                               groups or [])
+  _TLS.all_reduce_token = result[1]
+  return result[0]
+
+
 def all_to_all(value,
                split_dimension,
                concat_dimension,
@@ -491,7 +644,263 @@ def collective_permute(value, pairs):
   return result[0]
 
 
-def add_step_closure(closure, args=()):
+def column_parallel_matmul(input,
+                           weight,
+                           bias=None,
+                           gather_output=True,
+                           groups=None,
+                           num_chunks=1):
+  """Performs the matmul of a column parallel (output features sharded) layer.
+
+  Every replica holds the `[N, K]` shard of the `[N * GROUP_SIZE, K]` weight of
+  a linear layer, with its own `N` output features, and computes the linear
+  transformation of the `[..., K]` input (which is the same on all the
+  replicas) with its shard. The matmul and the all-gather of the results are
+  lowered as a single IR node.
+
+  Args:
+    input (torch.Tensor): The `[..., K]` input tensor.
+    weight (torch.Tensor): The `[N, K]` weight shard of the replica.
+    bias (torch.Tensor, optional): The `[N]` bias shard of the replica.
+      Default: None
+    gather_output (bool, optional): Whether the results of the replicas should
+      be all-gathered along the last dimension.
+      Default: True
+    groups (list, optional): A list of list, representing the replica groups for
+      the collective operation. If `None` there will be only one group with
+      all the replicas in it.
+    num_chunks (int, optional): The number of chunks the input rows are split
+      into, to let the all-gather of a chunk overlap with the matmul of the
+      next one. If it does not divide the number of rows, no split happens.
+      Default: 1
+  Returns:
+    The `[..., N * GROUP_SIZE]` result if `gather_output` is `True`, or the
+    `[..., N]` result of the replica otherwise.
+  """
+  if gather_output and xla_device_hw(input.device) != 'TPU':
+    # The all-gather is only natively supported on TPU, so the other devices
+    # go through the emulated one.
+    return all_gather(F.linear(input, weight, bias), dim=-1, groups=groups)
+  result = torch_xla._XLAC._xla_column_parallel_matmul(
+      input, weight, bias, _get_all_reduce_token(), gather_output,
+      _get_shard_count(groups), num_chunks, groups or [])
+  _TLS.all_reduce_token = result[1]
+  return result[0]
+
+
+def row_parallel_matmul(input,
+                        weight,
+                        bias=None,
+                        scatter_output=False,
+                        groups=None,
+                        num_chunks=1):
+  """Performs the matmul of a row parallel (input features sharded) layer.
+
+  Every replica holds the `[N, K]` shard of the `[N, K * GROUP_SIZE]` weight of
+  a linear layer, with its own `K` input features, and the matching `[..., K]`
+  shard of the input. The partial results of the replicas are summed, and the
+  matmul and the reduction are lowered as a single IR node.
+
+  Args:
+    input (torch.Tensor): The `[..., K]` input shard of the replica.
+    weight (torch.Tensor): The `[N, K]` weight shard of the replica.
+    bias (torch.Tensor, optional): The `[N]` bias, added after the reduction.
+      Default: None
+    scatter_output (bool, optional): Whether the reduced result should be
+      reduce-scattered along its first dimension, instead of all-reduced.
+      Default: False
+    groups (list, optional): A list of list, representing the replica groups for
+      the collective operation. If `None` there will be only one group with
+      all the replicas in it.
+    num_chunks (int, optional): The number of chunks the matmul is split into,
+      to let the reduction of a chunk overlap with the matmul of the next one.
+      If it does not divide the split dimension, no split happens.
+      Default: 1
+  Returns:
+    The `[..., N]` reduced result, or the shard of the replica along the first
+    dimension if `scatter_output` is `True`.
+  """
+  result = torch_xla._XLAC._xla_row_parallel_matmul(
+      input, weight, bias, _get_all_reduce_token(), scatter_output,
+      _get_shard_count(groups), num_chunks, groups or [])
+  _TLS.all_reduce_token = result[1]
+  return result[0]
+
+
+def sync_batch_norm(input, weight, bias, eps=1e-5, groups=None):
+  """Performs the training batch norm of the `[N, C, ...]` input, with the
+  statistics computed over the inputs of all the replicas.
+
+  The local per feature sums, sums of squares, and element counts are packed
+  into a single buffer, so only one all-reduce is issued.
+
+  Args:
+    input (torch.Tensor): The `[N, C, ...]` input of the replica.
+    weight (torch.Tensor): The `[C]` weight.
+    bias (torch.Tensor): The `[C]` bias.
+    eps (float, optional): The value added to the variance.
+      Default: 1e-5
+    groups (list, optional): A list of list, representing the replica groups for
+      the collective operation. If `None` there will be only one group with
+      all the replicas in it.
+  Returns:
+    The output, the `[C]` mean, the `[C]` inverted standard deviation, and the
+    number of elements of every feature across the replicas.
+  """
+  result = torch_xla._XLAC._xla_sync_batch_norm(input, weight, bias,
+                                                _get_all_reduce_token(), eps,
+                                                groups or [])
+  _TLS.all_reduce_token = result[-1]
+  return result[:-1]
+
+
+def sync_batch_norm_backward(grad_output,
+                             input,
+                             weight,
+                             mean,
+                             invstd,
+                             count,
+                             groups=None):
+  """Computes the gradients of `sync_batch_norm()`, with a single all-reduce.
+
+  Args:
+    grad_output (torch.Tensor): The gradient of the output.
+    input (torch.Tensor): The input of the forward.
+    weight (torch.Tensor): The weight of the forward.
+    mean (torch.Tensor): The mean returned by the forward.
+    invstd (torch.Tensor): The inverted standard deviation returned by the
+      forward.
+    count (torch.Tensor): The element count returned by the forward.
+    groups (list, optional): The replica groups of the forward.
+  Returns:
+    The input, weight and bias gradients. The weight and bias ones are the
+    local ones of the replica, which get reduced together with the other
+    parameter gradients.
+  """
+  result = torch_xla._XLAC._xla_sync_batch_norm_backward(
+      grad_output, input, weight, mean, invstd, count,
+      _get_all_reduce_token(), groups or [])
+  _TLS.all_reduce_token = result[-1]
+  return result[:-1]
+
+
+def zeros_on_device(model, device):
+  """Materializes the model parameters and buffers as zeros on device.
+
+  The zero tensors are generated by the device itself, so no host data is
+  uploaded. Together with `broadcast_master_param()` it allows non master
+  replicas to receive their weights from the master one.
+
+  Args:
+    model (torch.nn.Module): The model whose tensors should be replaced.
+    device (torch.device): The XLA device where the zeros should be created.
+  Returns:
+    The `model` itself.
+  """
+  return model._apply(lambda t: torch.zeros_like(t, device=device))
+
+
+def broadcast_master_param(model):
+  """Broadcasts the model parameters and buffers of the master replica.
+
+  The broadcast is an all-reduce where all the replicas except the global
+  master one (ordinal 0, device index 0) contribute zeros, so the host weights
+  need to be uploaded to the master device only, and the replicas can create
+  theirs with `zeros_on_device()`. This function must be called by all the
+  replicas, and it issues a `mark_step()` to materialize the result.
+
+  Args:
+    model (torch.nn.Module): The model whose tensors should be broadcast.
+  """
+  tensors = [t.data for t in model.parameters()]
+  tensors += [t.data for t in model.buffers()]
+  if not (is_master_ordinal(local=False) and is_master_ordinal(local=True)):
+    for t in tensors:
+      t.zero_()
+  # Boolean tensors cannot be summed, but OR-ing with False is an identity.
+  bool_tensors = [t for t in tensors if t.dtype == torch.bool]
+  tensors = [t for t in tensors if t.dtype != torch.bool]
+  if tensors:
+    all_reduce(REDUCE_SUM, tensors)
+  if bool_tensors:
+    all_reduce(REDUCE_OR, bool_tensors)
+  mark_step()
+
+
+class _FetchedTensor(object):
+
+  def __init__(self, index):
+    self.index = index
+
+
+class _AsyncClosureRunner(object):
+  """Runs the async step closures, in order, on a dedicated thread."""
+
+  def __init__(self, max_pending):
+    self._queue = queue.Queue(maxsize=max_pending)
+    self._lock = threading.Lock()
+    self._errors = []
+    self._thread = threading.Thread(target=self._run, daemon=True)
+    self._thread.start()
+    atexit.register(self._queue.join)
+
+  def schedule(self, closure, args):
+    fetches = []
+
+    def convert_fn(tensors):
+      fetches.append(torch_xla._XLAC._xla_fetch_tensors_async(tensors))
+      return [_FetchedTensor(i) for i in range(len(tensors))]
+
+    def select_fn(v):
+      return type(v) == torch.Tensor and is_xla_tensor(v)
+
+    ref_args = ToXlaTensorArena(convert_fn, select_fn).transform(args)
+    fetch = fetches[0] if fetches else None
+    self._queue.put((closure, ref_args, fetch))
+
+  def wait(self):
+    self._queue.join()
+    self.check_errors()
+
+  def check_errors(self):
+    with self._lock:
+      errors = self._errors
+      self._errors = []
+    if errors:
+      raise errors[0]
+
+  def _run(self):
+    while True:
+      closure, ref_args, fetch = self._queue.get()
+      try:
+        cpu_tensors = []
+        if fetch is not None:
+          cpu_tensors = torch_xla._XLAC._xla_wait_fetch(fetch)
+        args = xu.for_each_instance_rewrite(
+            ref_args, lambda v: isinstance(v, _FetchedTensor),
+            lambda r: cpu_tensors[r.index])
+        closure(*args)
+      except Exception as e:
+        with self._lock:
+          self._errors.append(e)
+      finally:
+        self._queue.task_done()
+
+
+_ASYNC_CLOSURE_RUNNER = None
+_ASYNC_CLOSURE_RUNNER_LOCK = threading.Lock()
+
+
+def _get_async_closure_runner():
+  global _ASYNC_CLOSURE_RUNNER
+  with _ASYNC_CLOSURE_RUNNER_LOCK:
+    if _ASYNC_CLOSURE_RUNNER is None:
+      _ASYNC_CLOSURE_RUNNER = _AsyncClosureRunner(
+          xu.getenv_as('XLA_ASYNC_CLOSURE_QUEUE', int, 100))
+    return _ASYNC_CLOSURE_RUNNER
+
+
+def add_step_closure(closure, args=(), run_async=False):
   """Adds a closure to the list of the ones to be run at the end of the step.
 
   Many times during model training there is the need to print/report (print to
@@ -509,15 +918,37 @@ def add_step_closure(closure, args=()):
   Note that even though using this API the execution will be optimized, it is
   advised to throttle the printing/reporting events once every N steps.
 
+  Async closures do not stall the training thread waiting for the step
+  execution. The XLA tensors within their arguments are fetched to host in the
+  background, once the step producing them has been executed, and the closures
+  are called with the CPU tensors in their place, on a dedicated thread. Their
+  exceptions are raised by the following `mark_step()` or
+  `wait_step_closures()` calls.
+
   Args:
     closure (callable): The function to be called.
     args (tuple): The arguments to be passed to the closure.
+    run_async (bool, optional): Whether the closure is run asynchronously.
+      Default: False
   """
   step_closures = getattr(_TLS, 'step_closures', None)
   if step_closures is None:
     step_closures = []
     _TLS.step_closures = step_closures
-  step_closures.append(lambda a=args: closure(*a))
+  if run_async:
+    step_closures.append(
+        lambda a=args: _get_async_closure_runner().schedule(closure, a))
+  else:
+    step_closures.append(lambda a=args: closure(*a))
+
+
+def wait_step_closures():
+  """Waits for the async step closures queued so far to complete.
+
+  Raises the first exception thrown by the closures, if any.
+  """
+  if _ASYNC_CLOSURE_RUNNER is not None:
+    _ASYNC_CLOSURE_RUNNER.wait()
 
 
 def _run_step_closures():
@@ -526,6 +957,240 @@ def _run_step_closures():
     _TLS.step_closures = []
     for closure in step_closures:
       closure()
+  if _ASYNC_CLOSURE_RUNNER is not None:
+    _ASYNC_CLOSURE_RUNNER.check_errors()
+
+
+@contextlib.contextmanager
+def checkpoint_scope():
+  """Context manager marking a region whose activations are recomputed.
+
+  The values computed within the region, which the backward pass needs, are not
+  kept live until the backward pass. They are instead recomputed from the region
+  inputs when the step graph runs, trading compute for device memory. The
+  region is local to the calling thread, and has no effect when autograd is
+  disabled. Example::
+
+    for block in model.blocks:
+      with xm.checkpoint_scope():
+        x = block(x)
+    loss = loss_fn(x, target)
+    loss.backward()
+  """
+  torch_xla._XLAC._xla_push_checkpoint_region()
+  try:
+    yield
+  finally:
+    torch_xla._XLAC._xla_pop_checkpoint_region()
+
+
+class _OffloadedBlock(torch.autograd.Function):
+
+  @staticmethod
+  def forward(ctx, scope, fn, *args):
+    ctx.scope = scope
+    ctx.fn = fn
+    ctx.index = scope._offload(args)
+    with torch.no_grad():
+      return fn(*args)
+
+  @staticmethod
+  def backward(ctx, *grads):
+    inputs = ctx.scope._restore(ctx.index)
+    with torch.enable_grad():
+      outputs = ctx.fn(*inputs)
+    if isinstance(outputs, torch.Tensor):
+      outputs = (outputs,)
+    torch.autograd.backward(outputs, grads)
+    ctx.scope._end_backward()
+    return (None, None) + tuple(
+        inp.grad if isinstance(inp, torch.Tensor) else None for inp in inputs)
+
+
+class OffloadScope(object):
+  """Offloads the activations of model blocks to the host memory.
+
+  Every block run through the scope keeps no activation on the device until
+  the backward pass. Its forward runs without autograd, and its tensor inputs
+  are fetched to the host in the background, once the (asynchronously
+  executed) graph computing them completes, overlapping with the following
+  blocks. The backward pass uploads the inputs of a block back to the device,
+  from the IO thread pool, ahead of its use: while a block recomputes its
+  activations and runs its backward, the inputs of the `prefetch` blocks
+  preceding it are being uploaded. Example::
+
+    scope = xm.OffloadScope()
+    for block in model.blocks:
+      x = scope(block, x)
+    loss = loss_fn(x, target)
+    loss.backward()
+    print(scope.report())
+
+  Args:
+    prefetch (int, optional): The number of blocks whose inputs are uploaded
+      ahead of the block running its backward.
+      Default: 1
+    sync_backward (bool, optional): Whether the backward of every block is
+      executed as its own graph, so that the device only holds the
+      activations of one block at a time. Otherwise the backward pass is a
+      single graph, and only the memory between the forward and the backward
+      passes is saved.
+      Default: True
+  """
+
+  def __init__(self, prefetch=1, sync_backward=True):
+    self._prefetch = prefetch
+    self._sync_backward = sync_backward
+    self._entries = []
+    self._offloaded_bytes = 0
+    self._transfer_ns = 0
+    self._blocked_ns = 0
+
+  def __call__(self, fn, *args):
+    """Runs `fn(*args)` as an offloaded block, returning its outputs."""
+    if not torch.is_grad_enabled():
+      return fn(*args)
+    return _OffloadedBlock.apply(self, fn, *args)
+
+  def report(self):
+    """Returns the statistics of the transfers issued by the scope.
+
+    The `overlap` is the fraction of the transfer time during which the
+    training thread was not blocked waiting for them.
+    """
+    transfer_time = self._transfer_ns / 1e9
+    blocked_time = self._blocked_ns / 1e9
+    overlap = 1.0 - blocked_time / transfer_time if transfer_time > 0 else 0.0
+    return {
+        'offloaded_bytes': self._offloaded_bytes,
+        'pending_blocks': sum(1 for e in self._entries if e is not None),
+        'transfer_time': transfer_time,
+        'blocked_time': blocked_time,
+        'overlap': max(overlap, 0.0),
+    }
+
+  def _offload(self, args):
+    entry = {'args': list(args), 'indices': [], 'requires_grad': []}
+    tensors = []
+    for i, arg in enumerate(args):
+      if isinstance(arg, torch.Tensor) and is_xla_tensor(arg):
+        entry['indices'].append(i)
+        entry['requires_grad'].append(arg.requires_grad)
+        entry['args'][i] = None
+        tensors.append(arg.detach())
+        self._offloaded_bytes += arg.numel() * arg.element_size()
+    if tensors:
+      entry['device'] = str(tensors[0].device)
+      entry['fetch'] = torch_xla._XLAC._xla_fetch_tensors_async(tensors)
+    self._entries.append(entry)
+    return len(self._entries) - 1
+
+  def _wait(self, wait_fn, handle):
+    start = time.time()
+    result = wait_fn(handle)
+    self._blocked_ns += int((time.time() - start) * 1e9)
+    return result
+
+  def _start_upload(self, index):
+    entry = self._entries[index]
+    if entry is None or 'fetch' not in entry or 'upload' in entry:
+      return
+    fetch = entry.pop('fetch')
+    cpu_tensors = self._wait(torch_xla._XLAC._xla_wait_fetch, fetch)
+    self._transfer_ns += torch_xla._XLAC._xla_fetch_transfer_ns(fetch)
+    entry['upload'] = torch_xla._XLAC._xla_upload_tensors_async(
+        cpu_tensors, [entry['device']] * len(cpu_tensors))
+
+  def _restore(self, index):
+    self._start_upload(index)
+    for prev_index in range(max(index - self._prefetch, 0), index):
+      self._start_upload(prev_index)
+    entry = self._entries[index]
+    self._entries[index] = None
+    args = entry['args']
+    if 'upload' in entry:
+      upload = entry['upload']
+      tensors = self._wait(torch_xla._XLAC._xla_wait_upload, upload)
+      self._transfer_ns += torch_xla._XLAC._xla_upload_transfer_ns(upload)
+      for i, tensor, requires_grad in zip(entry['indices'], tensors,
+                                          entry['requires_grad']):
+        args[i] = tensor.requires_grad_(requires_grad)
+    return args
+
+  def _end_backward(self):
+    if self._sync_backward:
+      torch_xla._XLAC._xla_sync_live_tensors(
+          torch_xla._XLAC._xla_get_default_device(), [], wait=False)
+    # Only keep the blocks whose backward has not run yet.
+    while self._entries and self._entries[-1] is None:
+      self._entries.pop()
+
+
+@contextlib.contextmanager
+def autocast(enabled=True, dtype=torch.bfloat16):
+  """Context manager selecting the mixed precision policy of a region.
+
+  Within the region, matrix multiplications and convolutions compute in `dtype`,
+  while reductions, softmax and losses compute in `torch.float32`. The results
+  are cast back to the types the operations would have otherwise produced, so
+  the model weights stay in full precision. The region is local to the calling
+  thread, and overrides the policy set with the `XLA_AUTOCAST` environment
+  variable. Example::
+
+    with xm.autocast():
+      loss = loss_fn(model(data), target)
+    loss.backward()
+
+  Args:
+    enabled (bool, optional): Whether the policy is enabled within the region.
+      Default: True
+    dtype (torch.dtype, optional): The type the matrix multiplications and
+      convolutions compute in, either `torch.bfloat16` or `torch.float16`.
+      Default: torch.bfloat16
+  """
+  if not enabled:
+    ctype = ''
+  elif dtype == torch.bfloat16:
+    ctype = 'bf16'
+  elif dtype == torch.float16:
+    ctype = 'f16'
+  else:
+    raise ValueError('Unsupported autocast type: {}'.format(dtype))
+  torch_xla._XLAC._xla_push_autocast(ctype)
+  try:
+    yield
+  finally:
+    torch_xla._XLAC._xla_pop_autocast()
+
+
+@contextlib.contextmanager
+def stream(stream):
+  """Context manager selecting the execution stream of a region.
+
+  Every stream has its own execution queue on a device, so the graphs of
+  independent models (like an evaluation running in a separate thread, next to
+  the training loop) can execute concurrently, when the device allows it.
+  Tensors produced by a stream can be used by another one, which will then
+  wait for the producing stream operations to complete. The stream is local to
+  the calling thread. Since `mark_step()` syncs all the live tensors of the
+  device, the stream graphs should rather be run by syncing the stream tensors.
+  Example::
+
+    def evaluate(model, data):
+      with xm.stream(1):
+        output = model(data)
+        torch_xla._XLAC._xla_sync_multi([output], devices=[])
+      return output.cpu()
+
+  Args:
+    stream (int): The stream identifier. The default stream is 0.
+  """
+  prev_stream = torch_xla._XLAC._xla_get_current_stream()
+  torch_xla._XLAC._xla_set_current_stream(stream)
+  try:
+    yield
+  finally:
+    torch_xla._XLAC._xla_set_current_stream(prev_stream)
 
 
 def mark_step():
@@ -542,6 +1207,356 @@ def mark_step():
   _TLS.all_reduce_token = None
 
 
+def mark_unused(*tensors):
+  """Hints that the given XLA tensors are not going to be read anymore.
+
+  The step barrier (`mark_step()`) materializes every live XLA tensor with a
+  pending value. Hinted tensors (like temporaries kept referenced by closures)
+  are left out of the step graph, reducing its outputs and the device memory
+  they use. If read again, their value is computed on demand. The hint is
+  cleared when a tensor is updated in place.
+
+  Args:
+    tensors (torch.Tensor...): The XLA tensors which are not going to be read.
+  """
+  torch_xla._XLAC._xla_set_liveness_hint(list(tensors), live=False)
+
+
+def freeze_tensors(tensors):
+  """Freezes the current value of the given XLA tensors into the graphs.
+
+  Frozen tensors (like the weights of an inference model) are embedded as
+  constants in the graphs using them, instead of being fed as parameters at
+  every execution, and the XLA compiler can fold the computations depending
+  only on them. The compiled graphs are specialized on the frozen values, so
+  the tensors should not change afterwards. Updating a frozen tensor in place
+  unfreezes it.
+
+  Args:
+    tensors (list, torch.Tensor): The XLA tensors to be frozen.
+  """
+  torch_xla._XLAC._xla_freeze_tensors(list(tensors))
+
+
+def capture_step(fn, devices=[]):
+  """Captures a step function once, and replays its computation afterwards.
+
+  The first call traces `fn(*inputs)` and runs its graph, like a `mark_step()`
+  on its outputs would do. The following calls run the captured computation
+  over the new inputs directly, without running `fn` nor tracing the IR graph.
+  All the device tensors the step updates (like the model parameters and the
+  optimizer state) must be passed as inputs and returned as outputs, as the
+  other device data read by `fn` are captured as constants. The replay outputs
+  are detached from autograd. Example::
+
+    def train_step(*args):
+      ...
+      return new_params
+
+    step = xm.capture_step(train_step)
+    for data in loader:
+      params = step(data, *params)
+
+  Args:
+    fn (python:function): The step function, taking XLA tensors and returning
+      a list or tuple of XLA tensors computed by it.
+    devices (string..., optional): The devices participating in the replicated
+      computation.
+      Default: []
+
+  Returns:
+    A function with the same signature of `fn`, returning the outputs as list.
+  """
+  graph = None
+
+  def step(*inputs):
+    nonlocal graph
+    if graph is None:
+      graph, outputs = torch_xla._XLAC._xla_capture_graph(
+          lambda: fn(*inputs), list(inputs), devices)
+      return outputs
+    return torch_xla._XLAC._xla_replay_graph(graph, list(inputs))
+
+  return step
+
+
+def capture_step_loop(fn, devices=[]):
+  """Captures a training step, and runs many steps of it with one dispatch.
+
+  The returned function takes a list of batches, each stacking the data of K
+  steps over its first dimension, and a list of state tensors (like the model
+  parameters and the optimizer state). It runs the K steps on device, within a
+  single XLA While loop, updating the state tensors in place, and returns the
+  step metrics summed over the K steps. The first call traces the step with
+  `fn(*batch_slices, *state)`, which returns the new state tensors, followed by
+  the metrics of the step. Device data read by `fn` which is not part of the
+  batches or of the state is captured as a constant. Example::
+
+    def train_step(data, target, *params):
+      ...
+      return new_params + [loss]
+
+    loop = xm.capture_step_loop(train_step)
+    for data, target in stacked_loader:
+      loss_sum, = loop([data, target], params)
+
+  Args:
+    fn (python:function): The step function, taking XLA tensors and returning
+      a list or tuple of XLA tensors computed by it.
+    devices (string..., optional): The devices participating in the replicated
+      computation.
+      Default: []
+
+  Returns:
+    A function taking the list of stacked batches and the list of state
+    tensors, and returning the list of the summed metrics.
+  """
+  graph = None
+
+  def loop(batches, state):
+    nonlocal graph
+    batches, state = list(batches), list(state)
+    if graph is None:
+      slices = [batch[0] for batch in batches]
+      graph = torch_xla._XLAC._xla_capture_step_loop(
+          lambda: fn(*slices, *state), slices, batches, state, devices)
+    outputs = torch_xla._XLAC._xla_replay_graph(graph, batches + state)
+    return outputs[len(state):]
+
+  return loop
+
+
+def export_graph(fn, inputs, path, num_shards=1):
+  """Exports an inference graph, together with its weights, for serving.
+
+  The graph of `fn(*inputs)` is traced, compiled and run once, like a
+  `capture_step()` would do, and its HLO module gets written into the `path`
+  directory. The device data read by `fn` which is not part of the `inputs`
+  (like the model weights) is written next to it, in the checkpoint format of
+  `torch_xla.utils.serialization.save_sharded()`. The exported graph can then
+  be served with `load_exported_graph()`, or by the `ExportedGraph` C++
+  loader, without the model code, nor any tracing and IR lowering. Example::
+
+    with torch.no_grad():
+      xm.export_graph(lambda x: [model(x)], [example_input], '/tmp/model')
+    # Within the serving process:
+    run = xm.load_exported_graph('/tmp/model')
+    output, = run(batch)
+
+  Args:
+    fn (python:function): The inference function, taking XLA tensors and
+      returning a list or tuple of XLA tensors computed by it.
+    inputs (list): The example XLA tensors fed to `fn`. The exported graph
+      accepts inputs with the same shapes and types.
+    path (string): The directory where the graph is exported. Any location
+      supported by the TF filesystem layer can be used.
+    num_shards (int, optional): The number of shard files the weights get
+      spread over.
+      Default: 1
+  Returns:
+    The outputs of `fn(*inputs)`.
+  """
+  inputs = list(inputs)
+  graph, outputs = torch_xla._XLAC._xla_capture_graph(lambda: fn(*inputs),
+                                                      inputs, [])
+  torch_xla._XLAC._xla_export_graph(graph, path, num_shards)
+  return outputs
+
+
+def load_exported_graph(path, device=None):
+  """Loads a graph exported with `export_graph()`.
+
+  Loading compiles the HLO module and uploads the weights onto the device.
+  Every call of the returned function runs the computation straight away,
+  with no tracing involved.
+
+  Args:
+    path (string): The directory where the graph was exported.
+    device (string, optional): The device the graph runs on. If `None`, the
+      current default device is used.
+      Default: None
+  Returns:
+    A function taking the XLA tensor inputs, and returning the list of output
+    tensors.
+  """
+  graph = torch_xla._XLAC._xla_load_exported_graph(
+      path, str(device) if device is not None else '')
+
+  def run(*inputs):
+    return torch_xla._XLAC._xla_run_exported_graph(graph, list(inputs))
+
+  return run
+
+
+def get_compile_manifest():
+  """Returns the manifest of the graphs compiled by this process so far.
+
+  The manifest is a list of dictionaries (one per graph, with the `hash`,
+  `device` and `devices` keys) which can be stored (for example with
+  `json.dump()`) and handed to `warmup_compile()` at the start of a later run.
+
+  Returns:
+    The list of the compiled graphs, in compilation order.
+  """
+  return torch_xla._XLAC._xla_get_compile_manifest()
+
+
+def warmup_compile(manifest):
+  """Compiles the graphs of a manifest before they are needed.
+
+  The HLO of the graphs is read from the persistent cache (which requires the
+  `XLA_PERSISTENT_CACHE_PATH` environment variable to point to the cache used
+  by the run which created the manifest), and all the graphs are compiled
+  with a single batched call, which the XLA client compiles in parallel. The
+  graphs which are already compiled, or missing from the persistent cache,
+  are skipped. Once the graphs are warm, the first steps of the run find them
+  in the compilation cache. Example::
+
+    manifest = json.load(open('/tmp/manifest.json'))
+    xm.warmup_compile(manifest)
+    train_loop()
+    json.dump(xm.get_compile_manifest(), open('/tmp/manifest.json', 'w'))
+
+  Args:
+    manifest (list): The manifest returned by `get_compile_manifest()`.
+  Returns:
+    The number of graphs compiled.
+  """
+  return torch_xla._XLAC._xla_warmup_compile(list(manifest))
+
+
+class BatchingExecutor(object):
+  """Runs exported inference graphs over dynamically batched requests.
+
+  The requests submitted with `run()` are queued, and a native thread merges
+  them into batches up to the biggest bucket size, or until the oldest queued
+  request waited `max_delay_ms`. Every batch is padded to the smallest bucket
+  fitting it, and runs with one upload, execution and download, whose outputs
+  get split back across the requests. The `BatchingExecutor.Latency`,
+  `BatchingExecutor.BatchSize` and `BatchingExecutor.BatchFill` metrics track
+  the request latencies (with their percentiles) and how full the buckets are.
+  Example::
+
+    # Graphs exported with xm.export_graph() for batch sizes 1, 8 and 32.
+    executor = xm.BatchingExecutor(['/models/b1', '/models/b8', '/models/b32'])
+    # Within every request handler thread:
+    output, = executor.run(input)
+
+  Args:
+    paths (list): The directories of the graphs exported with
+      `export_graph()`, one per bucket batch size. Their inputs must carry the
+      batch on the first dimension, and differ only by the batch size.
+    max_delay_ms (float, optional): The maximum time a request waits for other
+      requests to batch with.
+      Default: 2
+    device (string, optional): The device the graphs run on. If `None`, the
+      current default device is used.
+      Default: None
+  """
+
+  def __init__(self, paths, max_delay_ms=2, device=None):
+    device = str(device) if device is not None else ''
+    graphs = [
+        torch_xla._XLAC._xla_load_exported_graph(path, device) for path in paths
+    ]
+    self._executor = torch_xla._XLAC._xla_create_batching_executor(
+        graphs, int(max_delay_ms * 1000))
+
+  def run(self, *inputs):
+    """Runs a request, and waits for its outputs.
+
+    Args:
+      inputs (torch.Tensor...): The CPU input tensors of the request, with the
+        request batch on their first dimension.
+    Returns:
+      The list of the CPU output tensors of the request.
+    """
+    return torch_xla._XLAC._xla_batching_executor_run(self._executor,
+                                                      list(inputs))
+
+  def close(self):
+    """Runs the queued requests, and stops the executor."""
+    torch_xla._XLAC._xla_batching_executor_close(self._executor)
+
+
+class ModelResidencyManager(object):
+  """Keeps many exported models on a device, within a device memory budget.
+
+  The models are exported with `export_graph()`, and get loaded on their
+  first run (or ahead of time with `prefetch()`). Whenever the resident
+  weights exceed the budget, the least recently used models which are not
+  pinned are evicted from the device, and get reloaded on their next run.
+  Example::
+
+    manager = xm.ModelResidencyManager(8 * 1024**3)
+    manager.register('ranker', '/models/ranker', pinned=True)
+    manager.register('tagger', '/models/tagger', keep_host_copy=True)
+    output, = manager.run('tagger', input)
+
+  Args:
+    budget_bytes (int): The device memory the resident models weights can
+      use.
+    device (string, optional): The device the models run on. If `None`, the
+      current default device is used.
+      Default: None
+  """
+
+  def __init__(self, budget_bytes, device=None):
+    self._manager = torch_xla._XLAC._xla_create_model_residency_manager(
+        str(device) if device is not None else '', budget_bytes)
+
+  def register(self, name, path, pinned=False, keep_host_copy=False):
+    """Registers a model, without loading it.
+
+    Args:
+      name (string): The name of the model.
+      path (string): The directory the model was exported to.
+      pinned (bool, optional): Whether the model should never be evicted once
+        loaded.
+        Default: False
+      keep_host_copy (bool, optional): Whether the weights should be kept in
+        host memory while the model is evicted, so that reloading it does not
+        read the export directory again.
+        Default: False
+    """
+    torch_xla._XLAC._xla_model_residency_register(self._manager, name, path,
+                                                  pinned, keep_host_copy)
+
+  def run(self, name, *inputs):
+    """Runs a model, loading it first if it is not resident.
+
+    Args:
+      name (string): The name of the model.
+      inputs (torch.Tensor...): The XLA tensor inputs of the model.
+    Returns:
+      The list of the output tensors.
+    """
+    graph = torch_xla._XLAC._xla_model_residency_acquire(self._manager, name)
+    return torch_xla._XLAC._xla_run_exported_graph(graph, list(inputs))
+
+  def prefetch(self, name):
+    """Starts loading a model in background, if it is not resident."""
+    torch_xla._XLAC._xla_model_residency_prefetch(self._manager, name)
+
+  def set_pinned(self, name, pinned):
+    """Sets whether a model can be evicted."""
+    torch_xla._XLAC._xla_model_residency_set_pinned(self._manager, name,
+                                                    pinned)
+
+  def evict(self, name):
+    """Evicts a model from the device."""
+    torch_xla._XLAC._xla_model_residency_evict(self._manager, name)
+
+  def is_resident(self, name):
+    return torch_xla._XLAC._xla_model_residency_is_resident(
+        self._manager, name)
+
+  @property
+  def resident_bytes(self):
+    """The device memory used by the weights of the resident models."""
+    return torch_xla._XLAC._xla_model_residency_resident_bytes(self._manager)
+
+
 def wait_device_ops(devices=[]):
   """Waits for all the async operations on the given devices to complete.
 
@@ -552,7 +1567,49 @@ def wait_device_ops(devices=[]):
   torch_xla._XLAC._xla_wait_device_ops(devices=devices)
 
 
-def reduce_gradients(optimizer, groups=None):
+def wait_tensors(tensors):
+  """Waits for the async operations producing the given tensors to complete.
+
+  Unlike `wait_device_ops()`, the operations queued after the ones producing
+  the tensors are not waited for, so the host can read (log, or checkpoint) the
+  values of a step while the following steps are still executing. Tensors
+  whose value is still a pending graph are not synced.
+
+  Args:
+    tensors (torch.Tensor...): The XLA tensors to wait for.
+  """
+  torch_xla._XLAC._xla_wait_tensors(tensors)
+
+
+def read_slice(tensor, start, size):
+  """Reads a window of an XLA tensor to the CPU.
+
+  Unlike slicing the tensor and moving the result to the CPU, the window is cut
+  by a cached computation which takes the start indices as device data, so that
+  reading windows of the same size at different offsets (like the rows of a
+  large tensor, in a debugging or sampling loop) does not compile new graphs,
+  nor transfers the whole tensor.
+
+  Args:
+    tensor (torch.Tensor): The XLA tensor to read from.
+    start (list of int): The start indices of the window. The trailing
+      dimensions which are missing start at zero.
+    size (list of int): The sizes of the window, for the same dimensions as
+      `start`. The trailing dimensions which are missing are read whole.
+
+  Returns:
+    The PyTorch CPU tensor with the window.
+  """
+  assert len(start) == len(size), 'start and size must have the same length'
+  start = list(start) + [0] * (tensor.dim() - len(start))
+  size = list(size) + list(tensor.size())[len(size):]
+  return torch_xla._XLAC._xla_read_slice(tensor, start, size)
+
+
+def reduce_gradients(optimizer,
+                     groups=None,
+                     reduce_type=REDUCE_SUM,
+                     error_feedback=False):
   """Reduces all the gradients handled by an optimizer.
 
   Args:
@@ -563,11 +1620,30 @@ def reduce_gradients(optimizer, groups=None):
         defines two groups, one with the `[0, 1, 2, 3]` replicas and one with
         the `[4, 5, 6, 7]` replicas. If `None` there will be only one group with
         all the replicas in it.
+    reduce_type (string, optional): Either ``REDUCE_SUM`` or
+      ``REDUCE_SUM_BF16``. The latter reduces the floating point gradients in
+      BF16, which halves the data moved across the replicas.
+      Default: ``REDUCE_SUM``
+    error_feedback (bool, optional): With ``REDUCE_SUM_BF16``, adds to every
+      gradient the error its BF16 compression introduced at the previous step,
+      so that such errors do not accumulate over the training.
+      Default: False
+
+  The row sparse gradients (see :class:`torch_xla.core.functions.SparseGrad`)
+  are all-gathered instead, with their values scaled like the reduced ones.
   """
   count = torch_xla._XLAC._xla_get_replication_devices_count()
   if count > 1:
+    if reduce_type == REDUCE_SUM_BF16 and error_feedback:
+      _apply_bf16_error_feedback(optimizer)
     gradients = _fetch_gradients(optimizer)
-    all_reduce(REDUCE_SUM, gradients, scale=1.0 / count, groups=groups)
+    all_reduce(reduce_type, gradients, scale=1.0 / count, groups=groups)
+    # The row sparse gradients are all-gathered, so their size grows with the
+    # rows looked up by all the replicas, not with the size of the tables.
+    for sparse_grad in _fetch_sparse_gradients(optimizer):
+      sparse_grad.indices = all_gather(sparse_grad.indices, groups=groups)
+      sparse_grad.values = all_gather(
+          sparse_grad.values, groups=groups) * (1.0 / count)
 
 
 def optimizer_step(optimizer, barrier=False, optimizer_args={}, groups=None):
@@ -600,6 +1676,255 @@ def optimizer_step(optimizer, barrier=False, optimizer_args={}, groups=None):
   return loss
 
 
+def clip_grad_norm_(parameters, max_norm, norm_type=2.0):
+  """Clips the gradients norm of the parameters, in place.
+
+  A drop-in replacement of `torch.nn.utils.clip_grad_norm_()`, which computes
+  the norm of all the gradients and scales them with a single IR node, instead
+  of a norm reduction per gradient followed by a scaling per gradient. The
+  gradients are scaled whether or not the norm exceeds `max_norm` (with a
+  coefficient of one in the latter case), so that no value is fetched to the
+  CPU. Gradients which are not XLA tensors, or which live on different
+  devices, fall back to the `torch.nn.utils.clip_grad_norm_()` implementation.
+
+  Args:
+    parameters (torch.Tensor...): The parameters (or the single parameter)
+      whose gradients are clipped.
+    max_norm (float): The maximum norm of the gradients.
+    norm_type (float, optional): The type of the norm, which can be `inf`.
+      Default: 2.0
+
+  Returns:
+    The total norm of the gradients, before the clipping.
+  """
+  if isinstance(parameters, torch.Tensor):
+    parameters = [parameters]
+  parameters = [p for p in parameters if p.grad is not None]
+  if not parameters:
+    return torch.tensor(0.)
+  devices = set(p.grad.device for p in parameters)
+  if (len(devices) > 1 or not is_xla_tensor(parameters[0].grad) or
+      any(p.grad.is_sparse for p in parameters)):
+    return torch.nn.utils.clip_grad_norm_(parameters, max_norm, norm_type)
+  return torch_xla._XLAC._xla_clip_grad_norm_multi(
+      [p.grad.data for p in parameters], float(max_norm), float(norm_type))
+
+
+class GradientAccumulator(object):
+  """Accumulates the gradients of many micro-batches into every optimizer step.
+
+  Every micro-batch runs as its own step, whose graph adds the micro-batch
+  gradients in place to the `.grad` device buffers (which are aliased to the
+  graph outputs), and the last micro-batch of every group of `steps` is
+  followed by the optimizer step graph, which also zeroes the gradients.
+  As the gradients are always device data when a micro-batch starts (they are
+  created as zeros upfront), all the micro-batches share the same graph, and
+  a large effective batch size costs one forward/backward graph plus one
+  optimizer graph. Example::
+
+    accumulator = xm.GradientAccumulator(optimizer, 4)
+    for data, target in loader:
+      loss = loss_fn(model(data), target) / 4
+      accumulator.backward(loss)
+
+  Args:
+    optimizer (:class:`torch.Optimizer`): The `torch.Optimizer` instance whose
+      parameters gradients are accumulated.
+    steps (int): The number of micro-batches accumulated into every optimizer
+      step.
+    optimizer_args (dict, optional): Named arguments dictionary for the
+      `optimizer.step()` call.
+    groups (list, optional): The replica groups for the gradients reduction, as
+      in `optimizer_step()`.
+      Default: None
+  """
+
+  def __init__(self, optimizer, steps, optimizer_args={}, groups=None):
+    assert steps > 0, 'Invalid accumulation steps: {}'.format(steps)
+    self._optimizer = optimizer
+    self._steps = steps
+    self._optimizer_args = optimizer_args
+    self._groups = groups
+    self._count = 0
+    for param_group in optimizer.param_groups:
+      for p in param_group['params']:
+        if p.requires_grad and p.grad is None:
+          p.grad = torch.zeros_like(p)
+    mark_step()
+
+  @property
+  def count(self):
+    """The number of micro-batches accumulated since the last optimizer step."""
+    return self._count
+
+  def backward(self, loss):
+    """Runs the backward of a micro-batch loss, and the optimizer step when
+    the micro-batch is the last of its group.
+
+    Args:
+      loss (torch.Tensor): The loss of the micro-batch.
+    Returns:
+      Whether the optimizer step was run.
+    """
+    loss.backward()
+    mark_step()
+    self._count += 1
+    if self._count < self._steps:
+      return False
+    self._count = 0
+    optimizer_step(
+        self._optimizer,
+        optimizer_args=self._optimizer_args,
+        groups=self._groups)
+    # Zeroing the gradients within the optimizer graph keeps them device data
+    # for the next micro-batch, instead of the first micro-batch graph being a
+    # different one adding to zero constants (or creating the gradients).
+    for param_group in self._optimizer.param_groups:
+      for p in param_group['params']:
+        if p.grad is not None:
+          p.grad.zero_()
+    mark_step()
+    return True
+
+
+class ShardedOptimizer(object):
+  """Shards the optimizer state and update across the replicas.
+
+  The parameters of every parameter group are flattened (per dtype) into a
+  single vector, padded to a multiple of the number of replicas, and every
+  replica owns one contiguous shard of it. The wrapped optimizer is created
+  over the shards only, so its state takes `1/N` of the memory it would need
+  with `optimizer_step()` over `N` replicas. At every step, the gradients are
+  reduce-scattered (instead of all-reduced) into the shards, every replica
+  updates its own shard, and the updated shards are all-gathered back into the
+  model parameters. The shards and the parameters are updated in place, so
+  their device buffers are aliased to the step graph outputs. Example::
+
+    optimizer = xm.ShardedOptimizer(model.parameters(), optim.Adam, lr=1e-3)
+    for data, target in loader:
+      optimizer.zero_grad()
+      loss_fn(model(data), target).backward()
+      optimizer.step()
+
+  Args:
+    params (iterable): The parameters to optimize, or the parameter groups
+      (dicts), as accepted by the `torch.optim.Optimizer` constructors. The
+      parameters which do not require gradients are left alone.
+    optimizer_class (class): The `torch.optim.Optimizer` subclass run over the
+      shards.
+    groups (list, optional): The replica groups the parameters are sharded
+      across, as in `reduce_scatter()`. The shards of the replicas within
+      different groups hold the same values.
+      Default: None
+    **defaults: The options of `optimizer_class`.
+  """
+
+  def __init__(self, params, optimizer_class, groups=None, **defaults):
+    self._groups = groups
+    self._shard_count = _get_shard_count(groups)
+    self._shard_index = self._get_shard_index(groups)
+    param_groups = list(params)
+    if param_groups and not isinstance(param_groups[0], dict):
+      param_groups = [{'params': param_groups}]
+    # Every bucket holds the parameters of a group with the same dtype, and the
+    # shard of their flattened values.
+    self._buckets = []
+    shard_groups = []
+    for param_group in param_groups:
+      shard_group = {k: v for k, v in param_group.items() if k != 'params'}
+      shard_group['params'] = []
+      buckets = collections.OrderedDict()
+      for p in param_group['params']:
+        if p.requires_grad:
+          buckets.setdefault(p.dtype, []).append(p)
+      for bucket_params in buckets.values():
+        shard = self._make_shard(bucket_params)
+        self._buckets.append((bucket_params, shard))
+        shard_group['params'].append(shard)
+      shard_groups.append(shard_group)
+    self.optimizer = optimizer_class(shard_groups, **defaults)
+    mark_step()
+
+  @staticmethod
+  def _get_shard_index(groups):
+    if not groups:
+      return get_ordinal()
+    ordinal = get_ordinal()
+    for group in groups:
+      if ordinal in group:
+        return group.index(ordinal)
+    raise ValueError('Ordinal {} is not part of the replica groups: {}'.format(
+        ordinal, groups))
+
+  def _get_shard_size(self, params):
+    numel = sum(p.numel() for p in params)
+    return (numel + self._shard_count - 1) // self._shard_count
+
+  def _flatten(self, tensors, params):
+    flat = torch.cat([t.reshape(-1) for t in tensors])
+    padding = self._get_shard_size(params) * self._shard_count - flat.numel()
+    if padding > 0:
+      flat = torch.cat([flat, flat.new_zeros(padding)])
+    return flat
+
+  def _make_shard(self, params):
+    shard_size = self._get_shard_size(params)
+    with torch.no_grad():
+      flat = self._flatten(params, params)
+      shard = flat[self._shard_index * shard_size:(self._shard_index + 1) *
+                   shard_size].clone()
+    return torch.nn.Parameter(shard)
+
+  @property
+  def param_groups(self):
+    return self.optimizer.param_groups
+
+  def zero_grad(self):
+    """Zeroes the gradients of the model parameters."""
+    for params, shard in self._buckets:
+      shard.grad = None
+      for p in params:
+        if p.grad is not None:
+          p.grad.detach_()
+          p.grad.zero_()
+
+  def step(self, **optimizer_args):
+    """Runs the optimizer step over the shards, and updates the parameters.
+
+    Args:
+      **optimizer_args: The named arguments of the wrapped `optimizer.step()`.
+    Returns:
+      The same value returned by the wrapped `optimizer.step()` call.
+    """
+    for params, shard in self._buckets:
+      grads = [
+          p.grad if p.grad is not None else torch.zeros_like(p) for p in params
+      ]
+      shard.grad = reduce_scatter(
+          REDUCE_SUM,
+          self._flatten(grads, params),
+          scale=1.0 / self._shard_count,
+          scatter_dim=0,
+          groups=self._groups)
+    loss = self.optimizer.step(**optimizer_args)
+    with torch.no_grad():
+      for params, shard in self._buckets:
+        flat = all_gather(shard.detach(), dim=0, groups=self._groups)
+        offset = 0
+        for p in params:
+          p.copy_(flat[offset:offset + p.numel()].view_as(p))
+          offset += p.numel()
+    return loss
+
+  def state_dict(self):
+    """Returns the state of the wrapped optimizer, which holds the state of the
+    shard of the calling replica only."""
+    return self.optimizer.state_dict()
+
+  def load_state_dict(self, state_dict):
+    self.optimizer.load_state_dict(state_dict)
+
+
 def save(data, file_or_path, master_only=True, global_master=False):
   """Saves the input data into a file.
 
@@ -662,6 +1987,39 @@ def send_cpu_data_to_device(data, device):
   return ToXlaTensorArena(convert_fn, select_fn).transform(data)
 
 
+def pad_to_buckets(tensors, dims, buckets=None, value=0):
+  """Pads dimensions of input tensors up to fixed bucket sizes.
+
+  Inputs whose sizes vary along some dimensions (like the sequence length of NLP
+  batches) make every distinct size a new graph, and a new compilation. Padding
+  such dimensions up to a bucket size bounds the number of graphs to the number
+  of buckets. The `ShapeBucketPadElements` and `ShapeBucketElements` counters
+  track the padding waste, and the `ShapeBucketHit_SIZE` ones the hits of every
+  bucket.
+
+  Args:
+    tensors (torch.Tensor or list): The tensor, or list of tensors, to be padded.
+    dims (list, int): The dimensions to be padded.
+    buckets (list, int, optional): The bucket sizes. Sizes bigger than the
+      largest bucket are not padded. If `None`, powers of two are used.
+      Default: None
+    value (number, optional): The value used for the padded elements.
+      Default: 0
+
+  Returns:
+    A `(padded, mask)` tuple, or a list of them if `tensors` was a list. The
+    `mask` is a boolean tensor which is `True` for the original elements, and
+    has the padded sizes over `dims` and size one over the other dimensions, so
+    that it broadcasts against `padded`.
+  """
+  input_list = tensors if isinstance(tensors, (list, tuple)) else [tensors]
+  padded, masks = torch_xla._XLAC._xla_pad_to_buckets(input_list, list(dims),
+                                                      list(buckets or []),
+                                                      value)
+  results = list(zip(padded, masks))
+  return results if isinstance(tensors, (list, tuple)) else results[0]
+
+
 def rendezvous(tag, payload=b'', replicas=[]):
   """Waits for all the mesh clients to reach the named rendezvous.
 
@@ -707,6 +2065,24 @@ def do_on_ordinals(target, data=(), ordinals=(0,)):
   return result
 
 
+def _mesh_reduce_values(tag, data, reduce_type):
+  if isinstance(data, torch.Tensor):
+    cpu_data = data.cpu()
+    values = cpu_data.to(torch.float64).flatten().tolist()
+  elif isinstance(data, (list, tuple)):
+    values = [float(x) for x in data]
+  else:
+    values = [float(data)]
+  result = torch_xla._XLAC._xla_mesh_reduce(get_ordinal(), tag, values,
+                                            reduce_type, [])
+  if isinstance(data, torch.Tensor):
+    return torch.tensor(
+        result, dtype=torch.float64).to(cpu_data.dtype).view(cpu_data.shape)
+  if isinstance(data, (list, tuple)):
+    return type(data)(result)
+  return type(data)(result[0])
+
+
 def mesh_reduce(tag, data, reduce_fn):
   """Performs an out-of-graph client mesh reduction.
 
@@ -715,12 +2091,18 @@ def mesh_reduce(tag, data, reduce_fn):
     data: The data to be reduced. The `reduce_fn` callable will receive a list
       with the copies of the same data coming from all the mesh client processes
       (one per core).
-    reduce_fn (callable): A function which receives a list of `data`-like
-      objects and returns the reduced result.
+    reduce_fn (callable or string): A function which receives a list of
+      `data`-like objects and returns the reduced result. Alternatively, one of
+      ``xla_model.REDUCE_SUM``, ``xla_model.REDUCE_MIN`` and
+      ``xla_model.REDUCE_MAX``, in which case `data` must be a number, a list of
+      numbers or a tensor, and the element-wise reduction is computed by the
+      mesh master, which only sends back the reduced result.
 
   Returns:
     The reduced value.
   """
+  if isinstance(reduce_fn, str):
+    return _mesh_reduce_values(tag, data, reduce_fn)
   cpu_data = _maybe_convert_to_cpu(data)
   bio = io.BytesIO()
   torch.save(cpu_data, bio)
@@ -732,6 +2114,50 @@ def mesh_reduce(tag, data, reduce_fn):
   return reduce_fn(xldata) if xldata else cpu_data
 
 
+def resize_replication(tag, world_size):
+  """Resizes the replica set, after processes left or rejoined the mesh.
+
+  All the processes of the new replica set must call this API with the same
+  `tag` and `world_size`. Once all of them rejoined the mesh, their ordinals
+  are renumbered following the order of the previous ones, the replication
+  devices are rebuilt from the devices of the rejoined processes, and only the
+  computations which depend on the replica set are dropped from the
+  compilation cache. The state held by the surviving processes (like the model
+  parameters and the optimizer state) is left untouched, so the training can
+  resume from it without a full restart.
+  Example::
+
+    try:
+      train_loop_fn(loader)
+    except RuntimeError:
+      # The launcher tells the survivors the new world size.
+      xm.resize_replication('resize-1', new_world_size)
+
+  Args:
+    tag (string): The name of the rejoin rendezvous, which must be unique for
+      every membership change.
+    world_size (int): The number of processes of the new replica set.
+
+  Returns:
+    The new ordinal of the process.
+  """
+  ordinal = get_ordinal()
+  ordinals = torch_xla._XLAC._xla_rejoin_mesh(ordinal, tag, world_size)
+  devices = torch_xla._XLAC._xla_get_replication_devices()
+  if devices:
+    # Every process drives one replication device, indexed by its ordinal.
+    assert max(ordinals) < len(devices), (
+        'Rejoined ordinals {} outside the {} replication devices'.format(
+            ordinals, len(devices)))
+    torch_xla._XLAC._xla_set_replication_devices([devices[x] for x in ordinals])
+  new_ordinal = ordinals.index(ordinal)
+  os.environ[xenv.ORDINAL] = str(new_ordinal)
+  os.environ[xenv.WORLD_SIZE] = str(world_size)
+  torch_xla._XLAC._xla_clear_replicated_computations()
+  _TLS.all_reduce_token = None
+  return new_ordinal
+
+
 def set_rng_state(seed, device=None):
   """Sets the random number generator state.
 
@@ -758,3 +2184,18 @@ def get_rng_state(device=None):
   if device is None:
     device = torch_xla._XLAC._xla_get_default_device()
   return torch_xla._XLAC._xla_get_rng_seed(str(device) if device else '')
+
+
+def get_memory_info(device=None):
+  """Retrieves the device memory usage information.
+
+  Args:
+    device (string, optional): The device whose memory information needs to be
+      retrieved. If missing the default device will be used.
+
+  Returns:
+    A dictionary with `live_bytes` (the bytes held by live device data handles),
+    `peak_bytes` (the peak value of `live_bytes`), and `free_bytes` and
+    `total_bytes` as reported by the device (-1 if not available).
+  """
+  return torch_xla._XLAC._xla_memory_info(str(device) if device else '')
@@ -1,9 +1,11 @@
 from __future__ import division
 from __future__ import print_function
 
+import ctypes
 import pickle
 import sys
 import threading
+import torch
 import torch_xla
 import torch_xla.core.xla_builder as xb
 import torch_xla.utils.utils as xu
@@ -24,16 +26,7 @@ class Op(object):
     self._lock = threading.Lock()
     self._computations = dict()
 
-  def __call__(self, *args, **kwargs):
-    """Perform the PyTorch operation based on XLA tensors.
-
-    Args:
-      args: The PyTorch XLA tensors which are inputs of the operation.
-      kwargs: Keyword arguments passed to the lowering function. These are
-        Python scalars and cannot be XLA tensors.
-    Returns:
-      The PyTorch tensors wrapping the values returned by XLA lowering function.
-    """
+  def _get_computation(self, args, kwargs):
     shapes = xb.tensor_shape(args)
     key = pickle.dumps([shapes, kwargs])
     with self._lock:
@@ -44,10 +37,46 @@ class Op(object):
         self._computations[key] = computation
         if xu.getenv_as('XLA_OP_PRINT_COMPUTATIONS', bool, False):
           print(xb.get_computation_hlo(computation), file=sys.stderr)
+    return computation
+
+  def __call__(self, *args, **kwargs):
+    """Perform the PyTorch operation based on XLA tensors.
+
+    Args:
+      args: The PyTorch XLA tensors which are inputs of the operation.
+      kwargs: Keyword arguments passed to the lowering function. These are
+        Python scalars and cannot be XLA tensors.
+    Returns:
+      The PyTorch tensors wrapping the values returned by XLA lowering function.
+    """
+    computation = self._get_computation(args, kwargs)
     result = torch_xla._XLAC._xla_user_computation(self._opname, args,
                                                    computation)
     return result[0] if len(result) == 1 else result
 
+  def batch(self, args_list, **kwargs):
+    """Perform the PyTorch operation on many sets of XLA tensors.
+
+    All the sets of inputs must have the same shapes, so the operation is
+    lowered once, and all the call sites are created with a single call into
+    the PyTorch/XLA bridge.
+
+    Args:
+      args_list (list): The list of the tuples of the PyTorch XLA tensors which
+        are inputs of the operation.
+      kwargs: Keyword arguments passed to the lowering function. These are
+        Python scalars and cannot be XLA tensors.
+    Returns:
+      The list of the results, one per set of inputs, in the same form returned
+      by a direct call of the operation.
+    """
+    if not args_list:
+      return []
+    computation = self._get_computation(args_list[0], kwargs)
+    results = torch_xla._XLAC._xla_user_computation_batch(
+        self._opname, [list(args) for args in args_list], computation)
+    return [result[0] if len(result) == 1 else result for result in results]
+
 
 def register(name, opfn):
   """Registers a PyTorch operation with an XLA lowering function.
@@ -85,3 +114,129 @@ def register(name, opfn):
     operation.
   """
   return Op(name, opfn)
+
+
+class _CustomKernelFunction(torch.autograd.Function):
+
+  @staticmethod
+  def forward(ctx, kernel, *args):
+    ctx.kernel = kernel
+    ctx.save_for_backward(*args)
+    result = torch_xla._XLAC._xla_custom_kernel(kernel.name, list(args))
+    return tuple(result) if len(result) > 1 else result[0]
+
+  @staticmethod
+  def backward(ctx, *grad_outputs):
+    args = ctx.saved_tensors
+    grads = xu.as_list(ctx.kernel.grad(*(tuple(args) + grad_outputs)))
+    assert len(grads) == len(args), (
+        'The gradient of the {} kernel returned {} values, expected {}'.format(
+            ctx.kernel.name, len(grads), len(args)))
+    return (None,) + tuple(grads)
+
+
+class CustomKernel(object):
+  """A PyTorch operation implemented by a backend specific XLA CustomCall.
+
+  Args:
+    name (str): The name the kernel was registered with.
+    grad (callable, optional): The function computing the gradients of the
+      kernel inputs, called with the inputs followed by the gradients of the
+      kernel outputs. It can be another `CustomKernel`.
+      Default: None
+  """
+
+  def __init__(self, name, grad=None):
+    self.name = name
+    self.grad = grad
+
+  def __call__(self, *args):
+    """Runs the kernel on XLA tensors.
+
+    Args:
+      args: The PyTorch XLA tensors which are inputs of the kernel.
+    Returns:
+      The output tensor of the kernel, or the tuple of the output tensors if
+      the kernel has multiple outputs.
+    """
+    if self.grad is not None and torch.is_grad_enabled() and any(
+        a.requires_grad for a in args):
+      return _CustomKernelFunction.apply(self, *args)
+    result = torch_xla._XLAC._xla_custom_kernel(self.name, list(args))
+    return tuple(result) if len(result) > 1 else result[0]
+
+
+def load_custom_kernels(path):
+  """Loads a shared library registering custom kernels.
+
+  The library registers its kernels (with the XLA backend custom call registry,
+  and with the `torch_xla::CustomKernelRegistry` one) when loaded, after which
+  they can be reached by name with `register_custom_kernel()`.
+
+  Args:
+    path (str): The path of the shared library.
+  """
+  ctypes.CDLL(path, mode=ctypes.RTLD_GLOBAL)
+
+
+def register_custom_kernel(name,
+                           target=None,
+                           shape_fn=None,
+                           backend_config='',
+                           grad=None,
+                           has_side_effect=False):
+  """Registers a PyTorch operation implemented by an XLA CustomCall kernel.
+
+  The CustomCall target must be known by the XLA backend the operation runs
+  on. Kernels whose shape function lives in a shared library loaded with
+  `load_custom_kernels()` only need the name.
+
+  Example::
+
+    import torch_xla.core.xla_builder as xb
+    import torch_xla.core.xla_op_registry as xor
+
+    def layer_norm_gelu_shape(shapes):
+      return xb.mkshape(shapes[0].dtype, shapes[0].sizes)
+
+    LAYER_NORM_GELU = xor.register_custom_kernel(
+        'layer_norm_gelu', target='fused_layer_norm_gelu',
+        shape_fn=layer_norm_gelu_shape, backend_config='eps=1e-5')
+    y = LAYER_NORM_GELU(x, weight, bias)
+
+  Args:
+    name (str): The name of the operation.
+    target (str, optional): The CustomCall target name. Required together
+      with `shape_fn`.
+    shape_fn (callable, optional): The function receiving the list of the
+      input `xla_builder.Shape` objects, and returning the output shape (or
+      the list of the output shapes).
+    backend_config (str, optional): The opaque configuration string passed to
+      the kernel.
+      Default: ''
+    grad (callable, optional): The function computing the gradients of the
+      inputs, as described for `CustomKernel`.
+      Default: None
+    has_side_effect (bool, optional): Whether the kernel has side effects, so
+      XLA must not remove nor duplicate it.
+      Default: False
+  Returns:
+    The `CustomKernel` object which can be called to perform the operation.
+  """
+  if shape_fn is not None:
+    assert target is not None, 'The target of the {} kernel is missing'.format(
+        name)
+
+    def py_shape_fn(shapes):
+      shape = shape_fn([xb.Shape(s) for s in shapes])
+      if isinstance(shape, (list, tuple)):
+        return tuple(s.shape for s in shape)
+      return shape.shape
+
+    torch_xla._XLAC._xla_register_custom_kernel(
+        name,
+        target,
+        backend_config,
+        py_shape_fn,
+        has_side_effect=has_side_effect)
+  return CustomKernel(name, grad=grad)
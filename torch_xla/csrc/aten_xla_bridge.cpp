@@ -8,6 +8,7 @@
 #include "tensorflow/compiler/xla/xla_client/computation_client.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 #include "torch_xla/csrc/device.h"
+#include "torch_xla/csrc/fallback_tracker.h"
 #include "torch_xla/csrc/tensor_impl.h"
 #include "torch_xla/csrc/torch_util.h"
 
@@ -47,7 +48,14 @@ AtenXlaDeviceMapper* AtenXlaDeviceMapper::Get() {
 }
 
 XLATensorImpl* GetXlaTensorImpl(const at::Tensor& tensor) {
-  return dynamic_cast<XLATensorImpl*>(tensor.unsafeGetTensorImpl());
+  // This is called for every tensor argument of every operation, so the
+  // dispatch key (which only XLATensorImpl registers) is checked instead of
+  // paying a dynamic_cast.
+  c10::TensorImpl* impl = tensor.unsafeGetTensorImpl();
+  if (!impl->key_set().has(c10::DispatchKey::XLA)) {
+    return nullptr;
+  }
+  return static_cast<XLATensorImpl*>(impl);
 }
 
 }  // namespace
@@ -65,15 +73,14 @@ bool IsXlaTensor(const at::Tensor& tensor) {
 }
 
 XLATensor GetXlaTensor(const at::Tensor& tensor) {
-  auto xtensor = TryGetXlaTensor(tensor);
-  XLA_CHECK(xtensor) << "Input tensor is not an XLA tensor: "
-                     << tensor.toString();
-  return *xtensor;
+  XLATensorImpl* impl = GetXlaTensorImpl(tensor);
+  XLA_CHECK(impl != nullptr)
+      << "Input tensor is not an XLA tensor: " << tensor.toString();
+  return impl->tensor();
 }
 
 void ReplaceXlaTensor(const at::Tensor& tensor, XLATensor new_xla_tensor) {
-  XLATensorImpl* impl =
-      dynamic_cast<XLATensorImpl*>(tensor.unsafeGetTensorImpl());
+  XLATensorImpl* impl = GetXlaTensorImpl(tensor);
   XLA_CHECK(impl != nullptr)
       << "Input tensor is not an XLA tensor: " << tensor.toString();
   impl->set_tensor(std::move(new_xla_tensor));
@@ -119,6 +126,8 @@ std::vector<at::Tensor> XlaCreateTensorList(const at::TensorList& tensors) {
   // positions.
   for (size_t i = 0, defined_pos = 0; i < tensors.size(); ++i) {
     if (to_translate[i]) {
+      FallbackScope::AddBytesToHost(
+          defined_aten_xla_tensors[defined_pos].nbytes());
       aten_xla_tensors[i] = std::move(defined_aten_xla_tensors[defined_pos++]);
     }
   }
@@ -135,6 +144,7 @@ void XlaUpdateTensors(absl::Span<const at::Tensor> dest_xla_tensors,
     if (dest_impl != nullptr) {
       auto xla_source = TryGetXlaTensor(source);
       if (!xla_source) {
+        FallbackScope::AddBytesToDevice(source.nbytes());
         dest_impl->tensor().UpdateFromTensorOut(source);
       } else {
         dest_impl->tensor().UpdateFromTensorOut(*xla_source);
@@ -147,11 +157,11 @@ void XlaUpdateTensors(absl::Span<const at::Tensor> dest_xla_tensors,
 }
 
 c10::optional<Device> GetXlaDevice(const at::Tensor& tensor) {
-  auto xtensor = TryGetXlaTensor(tensor);
-  if (!xtensor) {
+  XLATensorImpl* impl = GetXlaTensorImpl(tensor);
+  if (impl == nullptr) {
     return c10::nullopt;
   }
-  return xtensor->GetDevice();
+  return impl->tensor().GetDevice();
 }
 
 c10::optional<Device> GetXlaDevice(const at::TensorList& tensors) {
@@ -251,6 +261,7 @@ std::vector<at::Tensor> AtenFromXlaTensors(
 at::Tensor CreateXlaTensor(at::Tensor tensor,
                            const c10::optional<Device>& device) {
   if (tensor.defined() && device) {
+    FallbackScope::AddBytesToDevice(tensor.nbytes());
     XLATensor xla_tensor = XLATensor::Create(std::move(tensor), *device);
     tensor = AtenFromXlaTensor(xla_tensor);
   }
@@ -13,11 +13,11 @@
 #include "torch_xla/csrc/aten_xla_type_default.h"
 #include "torch_xla/csrc/debug_util.h"
 #include "torch_xla/csrc/device.h"
+#include "torch_xla/csrc/einsum_path.h"
 #include "torch_xla/csrc/helpers.h"
 #include "torch_xla/csrc/ops/as_strided.h"
 #include "torch_xla/csrc/ops/einsum.h"
 #include "torch_xla/csrc/ops/index_ops.h"
-#include "torch_xla/csrc/pooling.h"
 #include "torch_xla/csrc/tensor_impl.h"
 #include "torch_xla/csrc/tensor_util.h"
 #include "torch_xla/csrc/torch_util.h"
@@ -135,6 +135,17 @@ void CheckBinaryOpTypePromotion(const at::Tensor& out, const at::Tensor& self,
   XLA_CHECK(at::canCast(/*from=*/resultType, /*to=*/out.scalar_type()));
 }
 
+// The operations with data dependent output shapes (like nonzero() and
+// masked_select()) are lowered with an upper bound shape and a dynamic
+// dimension, which the following operations propagate on device, when either
+// their own experiment or the "dynamic_shapes" one is enabled. Only the XLA TPU
+// backend for now implements the dynamic dimension setting they require.
+bool UseDynamicShapeLowering(const std::string& name, const XLATensor& tensor) {
+  return (DebugUtil::ExperimentEnabled(name) ||
+          DebugUtil::ExperimentEnabled("dynamic_shapes")) &&
+         tensor.GetDevice().hw_type == DeviceType::TPU;
+}
+
 void AtenInitialize() {
   TF_VLOG(1) << "PyTorch GIT revision: " << TORCH_GITREV;
   TF_VLOG(1) << "XLA GIT revision: " << XLA_GITREV;
@@ -218,25 +229,13 @@ at::Tensor AtenXlaType::__rshift__(const at::Tensor& self,
 at::Tensor AtenXlaType::_adaptive_avg_pool2d(const at::Tensor& self,
                                              at::IntArrayRef output_size) {
   XLA_FN_COUNTER("xla::");
-  auto output_size_list = XlaHelpers::I64List(output_size);
-  if (!IsSupportedAdaptiveAvgPool2d(XlaHelpers::I64List(self.sizes()),
-                                    output_size_list)) {
-    return AtenXlaTypeDefault::_adaptive_avg_pool2d(self, output_size);
-  }
   return bridge::AtenFromXlaTensor(XLATensor::_adaptive_avg_pool2d(
-      bridge::GetXlaTensor(self), output_size_list));
+      bridge::GetXlaTensor(self), XlaHelpers::I64List(output_size)));
 }
 
 at::Tensor AtenXlaType::_adaptive_avg_pool2d_backward(
     const at::Tensor& grad_output, const at::Tensor& self) {
   XLA_FN_COUNTER("xla::");
-  int64_t rank = grad_output.dim();
-  std::vector<xla::int64> output_size{grad_output.size(rank - 2),
-                                      grad_output.size(rank - 1)};
-  if (!IsSupportedAdaptiveAvgPool2d(XlaHelpers::I64List(self.sizes()),
-                                    output_size)) {
-    return AtenXlaTypeDefault::_adaptive_avg_pool2d_backward(grad_output, self);
-  }
   return bridge::AtenFromXlaTensor(XLATensor::_adaptive_avg_pool2d_backward(
       bridge::GetXlaTensor(grad_output), bridge::GetXlaTensor(self)));
 }
@@ -248,6 +247,67 @@ at::Tensor AtenXlaType::_copy_from(const at::Tensor& self,
   return dst;
 }
 
+std::tuple<at::Tensor, at::Tensor, at::Tensor, at::Tensor>
+AtenXlaType::_embedding_bag(const at::Tensor& weight, const at::Tensor& indices,
+                            const at::Tensor& offsets, bool scale_grad_by_freq,
+                            int64_t mode, bool sparse,
+                            const at::Tensor& per_sample_weights,
+                            bool include_last_offset) {
+  XLA_FN_COUNTER("xla::");
+  if (sparse) {
+    return AtenXlaTypeDefault::_embedding_bag(
+        weight, indices, offsets, scale_grad_by_freq, mode, sparse,
+        per_sample_weights, include_last_offset);
+  }
+  XLATensor weight_tensor = bridge::GetXlaTensor(weight);
+  auto outputs = XLATensor::embedding_bag(
+      weight_tensor, bridge::GetXlaTensor(indices),
+      bridge::GetXlaTensor(offsets),
+      bridge::GetOrCreateXlaTensor(per_sample_weights,
+                                   weight_tensor.GetDevice()),
+      mode, include_last_offset);
+  return std::make_tuple(bridge::AtenFromXlaTensor(std::get<0>(outputs)),
+                         bridge::AtenFromXlaTensor(std::get<1>(outputs)),
+                         bridge::AtenFromXlaTensor(std::get<2>(outputs)),
+                         bridge::AtenFromXlaTensor(std::get<3>(outputs)));
+}
+
+at::Tensor AtenXlaType::_embedding_bag_dense_backward(
+    const at::Tensor& grad, const at::Tensor& indices,
+    const at::Tensor& offsets, const at::Tensor& offset2bag,
+    const at::Tensor& bag_size, const at::Tensor& maximum_indices,
+    int64_t num_weights, bool scale_grad_by_freq, int64_t mode,
+    const at::Tensor& per_sample_weights) {
+  XLA_FN_COUNTER("xla::");
+  XLATensor grad_tensor = bridge::GetXlaTensor(grad);
+  return bridge::AtenFromXlaTensor(XLATensor::embedding_bag_dense_backward(
+      grad_tensor, bridge::GetXlaTensor(indices),
+      bridge::GetXlaTensor(offset2bag), bridge::GetXlaTensor(bag_size),
+      bridge::GetXlaTensor(maximum_indices),
+      bridge::GetOrCreateXlaTensor(per_sample_weights,
+                                   grad_tensor.GetDevice()),
+      num_weights, scale_grad_by_freq, mode));
+}
+
+at::Tensor AtenXlaType::_embedding_bag_per_sample_weights_backward(
+    const at::Tensor& grad, const at::Tensor& weight,
+    const at::Tensor& indices, const at::Tensor& offsets,
+    const at::Tensor& offset2bag, int64_t mode) {
+  XLA_FN_COUNTER("xla::");
+  XLA_CHECK_EQ(mode, 0)
+      << "Per sample weights are only supported with the sum mode";
+  // The gradient of each sample weight is the dot product of its weight row
+  // with the gradient of the bag it belongs to.
+  XLATensor bag_grad = XLATensor::index_select(
+      bridge::GetXlaTensor(grad), 0, bridge::GetXlaTensor(offset2bag));
+  XLATensor rows = XLATensor::index_select(bridge::GetXlaTensor(weight), 0,
+                                           bridge::GetXlaTensor(indices));
+  return bridge::AtenFromXlaTensor(
+      XLATensor::sum(XLATensor::mul(bag_grad, rows), {1},
+                     /*keep_reduced_dimensions=*/false,
+                     /*dtype=*/c10::nullopt));
+}
+
 at::Tensor& AtenXlaType::_index_put_impl_(at::Tensor& self,
                                           at::TensorList indices,
                                           const at::Tensor& values,
@@ -345,6 +405,20 @@ at::Tensor& AtenXlaType::acos_(at::Tensor& self) {
   return self;
 }
 
+at::Tensor AtenXlaType::adaptive_avg_pool3d(const at::Tensor& self,
+                                            at::IntArrayRef output_size) {
+  XLA_FN_COUNTER("xla::");
+  return bridge::AtenFromXlaTensor(XLATensor::adaptive_avg_pool3d(
+      bridge::GetXlaTensor(self), XlaHelpers::I64List(output_size)));
+}
+
+at::Tensor AtenXlaType::adaptive_avg_pool3d_backward(
+    const at::Tensor& grad_output, const at::Tensor& self) {
+  XLA_FN_COUNTER("xla::");
+  return bridge::AtenFromXlaTensor(XLATensor::adaptive_avg_pool3d_backward(
+      bridge::GetXlaTensor(grad_output), bridge::GetXlaTensor(self)));
+}
+
 at::Tensor AtenXlaType::add(const at::Tensor& self, const at::Tensor& other,
                             at::Scalar alpha) {
   XLA_FN_COUNTER("xla::");
@@ -1060,9 +1134,20 @@ at::Tensor AtenXlaType::dot(const at::Tensor& self, const at::Tensor& tensor) {
 
 at::Tensor AtenXlaType::einsum(std::string equation, at::TensorList tensors) {
   XLA_FN_COUNTER("xla::");
-  if (tensors.size() != 2 ||
-      !ir::ops::Einsum::SupportsEquation(equation, tensors[0].dim(),
-                                         tensors[1].dim())) {
+  bool supported = false;
+  if (tensors.size() == 2) {
+    supported = ir::ops::Einsum::SupportsEquation(equation, tensors[0].dim(),
+                                                  tensors[1].dim());
+  } else if (tensors.size() > 2) {
+    // Equations with more operands are split in pairwise contractions, in
+    // the order minimizing their cost.
+    std::vector<std::vector<xla::int64>> operand_sizes;
+    for (auto& tensor : tensors) {
+      operand_sizes.push_back(xla::util::ToVector<xla::int64>(tensor.sizes()));
+    }
+    supported = GetEinsumPath(equation, operand_sizes) != nullptr;
+  }
+  if (!supported) {
     return at::native::einsum(equation, tensors);
   }
   return bridge::AtenFromXlaTensor(
@@ -1794,11 +1879,7 @@ at::Tensor AtenXlaType::masked_select(const at::Tensor& self,
                                       const at::Tensor& mask) {
   XLA_FN_COUNTER("xla::");
   XLATensor self_tensor = bridge::GetXlaTensor(self);
-  // Initially make XLA handled masked_select() handling experimental, and
-  // opt-in. Only the XLA TPU backend for now implements the dynamic dimension
-  // setting required by the masked_select implementation.
-  if (!DebugUtil::ExperimentEnabled("masked_select") ||
-      self_tensor.GetDevice().hw_type != DeviceType::TPU) {
+  if (!UseDynamicShapeLowering("masked_select", self_tensor)) {
     return AtenXlaTypeDefault::masked_select(self, mask);
   }
   return bridge::AtenFromXlaTensor(
@@ -2245,11 +2326,7 @@ std::tuple<at::Tensor, at::Tensor> AtenXlaType::nll_loss_forward(
 at::Tensor AtenXlaType::nonzero(const at::Tensor& self) {
   XLA_FN_COUNTER("xla::");
   XLATensor self_tensor = bridge::GetXlaTensor(self);
-  // Initially make XLA handled nonzero() handling experimental, and opt-in.
-  // Only the XLA TPU backend for now implements the dynamic dimension setting
-  // required by the nonzero implementation.
-  if (!DebugUtil::ExperimentEnabled("nonzero") ||
-      self_tensor.GetDevice().hw_type != DeviceType::TPU) {
+  if (!UseDynamicShapeLowering("nonzero", self_tensor)) {
     return AtenXlaTypeDefault::nonzero(self);
   }
   return bridge::AtenFromXlaTensor(XLATensor::nonzero(self_tensor));
@@ -2850,6 +2927,30 @@ at::Tensor AtenXlaType::std(const at::Tensor& self, at::IntArrayRef dim,
       /*keep_reduced_dimensions=*/keepdim, unbiased));
 }
 
+std::tuple<at::Tensor, at::Tensor> AtenXlaType::std_mean(
+    const at::Tensor& self, bool unbiased) {
+  XLA_FN_COUNTER("xla::");
+  XLATensor self_tensor = bridge::GetXlaTensor(self);
+  auto results = XLATensor::var_mean(
+      self_tensor,
+      xla::util::Iota<xla::int64>(self_tensor.shape().get().rank()),
+      /*keep_reduced_dimensions=*/false, unbiased);
+  return std::make_tuple(
+      bridge::AtenFromXlaTensor(XLATensor::sqrt(std::get<0>(results))),
+      bridge::AtenFromXlaTensor(std::get<1>(results)));
+}
+
+std::tuple<at::Tensor, at::Tensor> AtenXlaType::std_mean(
+    const at::Tensor& self, at::IntArrayRef dim, bool unbiased, bool keepdim) {
+  XLA_FN_COUNTER("xla::");
+  auto results = XLATensor::var_mean(
+      bridge::GetXlaTensor(self), xla::util::ToVector<xla::int64>(dim),
+      /*keep_reduced_dimensions=*/keepdim, unbiased);
+  return std::make_tuple(
+      bridge::AtenFromXlaTensor(XLATensor::sqrt(std::get<0>(results))),
+      bridge::AtenFromXlaTensor(std::get<1>(results)));
+}
+
 at::Tensor AtenXlaType::sub(const at::Tensor& self, const at::Tensor& other,
                             at::Scalar alpha) {
   XLA_FN_COUNTER("xla::");
@@ -3144,10 +3245,7 @@ at::Tensor AtenXlaType::upsample_bilinear2d(const at::Tensor& self,
                                             c10::optional<double> scales_w) {
   XLA_FN_COUNTER("xla::");
   XLATensor self_tensor = bridge::GetXlaTensor(self);
-  // Only the XLA TPU backend for now implements the CustomCall required by our
-  // XLA lowering.
-  if (self_tensor.GetDevice().hw_type != DeviceType::TPU ||
-      (scales_h && *scales_h != 1.0) || (scales_w && *scales_w != 1.0)) {
+  if ((scales_h && *scales_h != 1.0) || (scales_w && *scales_w != 1.0)) {
     return AtenXlaTypeDefault::upsample_bilinear2d(
         self, output_size, align_corners, scales_h, scales_w);
   }
@@ -3162,10 +3260,7 @@ at::Tensor AtenXlaType::upsample_bilinear2d_backward(
     c10::optional<double> scales_h, c10::optional<double> scales_w) {
   XLA_FN_COUNTER("xla::");
   XLATensor grad_output_tensor = bridge::GetXlaTensor(grad_output);
-  // Only the XLA TPU backend for now implements the CustomCall required by our
-  // XLA lowering.
-  if (grad_output_tensor.GetDevice().hw_type != DeviceType::TPU ||
-      (scales_h && *scales_h != 1.0) || (scales_w && *scales_w != 1.0)) {
+  if ((scales_h && *scales_h != 1.0) || (scales_w && *scales_w != 1.0)) {
     return AtenXlaTypeDefault::upsample_bilinear2d_backward(
         grad_output, output_size, input_size, align_corners, scales_h,
         scales_w);
@@ -3181,10 +3276,7 @@ at::Tensor AtenXlaType::upsample_nearest2d(const at::Tensor& self,
                                            c10::optional<double> scales_w) {
   XLA_FN_COUNTER("xla::");
   XLATensor self_tensor = bridge::GetXlaTensor(self);
-  // Only the XLA TPU backend for now implements the CustomCall required by our
-  // XLA lowering.
-  if (self_tensor.GetDevice().hw_type != DeviceType::TPU ||
-      (scales_h && *scales_h != 1.0) || (scales_w && *scales_w != 1.0)) {
+  if ((scales_h && *scales_h != 1.0) || (scales_w && *scales_w != 1.0)) {
     return AtenXlaTypeDefault::upsample_nearest2d(self, output_size, scales_h,
                                                   scales_w);
   }
@@ -3198,10 +3290,7 @@ at::Tensor AtenXlaType::upsample_nearest2d_backward(
     c10::optional<double> scales_w) {
   XLA_FN_COUNTER("xla::");
   XLATensor grad_output_tensor = bridge::GetXlaTensor(grad_output);
-  // Only the XLA TPU backend for now implements the CustomCall required by our
-  // XLA lowering.
-  if (grad_output_tensor.GetDevice().hw_type != DeviceType::TPU ||
-      (scales_h && *scales_h != 1.0) || (scales_w && *scales_w != 1.0)) {
+  if ((scales_h && *scales_h != 1.0) || (scales_w && *scales_w != 1.0)) {
     return AtenXlaTypeDefault::upsample_nearest2d_backward(
         grad_output, output_size, input_size, scales_h, scales_w);
   }
@@ -3210,6 +3299,45 @@ at::Tensor AtenXlaType::upsample_nearest2d_backward(
       xla::util::ToVector<xla::int64>(input_size)));
 }
 
+at::Tensor AtenXlaType::var(const at::Tensor& self, bool unbiased) {
+  XLA_FN_COUNTER("xla::");
+  XLATensor self_tensor = bridge::GetXlaTensor(self);
+  return bridge::AtenFromXlaTensor(XLATensor::var(
+      self_tensor,
+      xla::util::Iota<xla::int64>(self_tensor.shape().get().rank()),
+      /*keep_reduced_dimensions=*/false, unbiased));
+}
+
+at::Tensor AtenXlaType::var(const at::Tensor& self, at::IntArrayRef dim,
+                            bool unbiased, bool keepdim) {
+  XLA_FN_COUNTER("xla::");
+  return bridge::AtenFromXlaTensor(XLATensor::var(
+      bridge::GetXlaTensor(self), xla::util::ToVector<xla::int64>(dim),
+      /*keep_reduced_dimensions=*/keepdim, unbiased));
+}
+
+std::tuple<at::Tensor, at::Tensor> AtenXlaType::var_mean(
+    const at::Tensor& self, bool unbiased) {
+  XLA_FN_COUNTER("xla::");
+  XLATensor self_tensor = bridge::GetXlaTensor(self);
+  auto results = XLATensor::var_mean(
+      self_tensor,
+      xla::util::Iota<xla::int64>(self_tensor.shape().get().rank()),
+      /*keep_reduced_dimensions=*/false, unbiased);
+  return std::make_tuple(bridge::AtenFromXlaTensor(std::get<0>(results)),
+                         bridge::AtenFromXlaTensor(std::get<1>(results)));
+}
+
+std::tuple<at::Tensor, at::Tensor> AtenXlaType::var_mean(
+    const at::Tensor& self, at::IntArrayRef dim, bool unbiased, bool keepdim) {
+  XLA_FN_COUNTER("xla::");
+  auto results = XLATensor::var_mean(
+      bridge::GetXlaTensor(self), xla::util::ToVector<xla::int64>(dim),
+      /*keep_reduced_dimensions=*/keepdim, unbiased);
+  return std::make_tuple(bridge::AtenFromXlaTensor(std::get<0>(results)),
+                         bridge::AtenFromXlaTensor(std::get<1>(results)));
+}
+
 at::Tensor AtenXlaType::view(const at::Tensor& self, at::IntArrayRef size) {
   XLA_FN_COUNTER("xla::");
   return bridge::AtenFromXlaTensor(
@@ -40,6 +40,25 @@ class AtenXlaType {
   static at::Tensor _copy_from(const at::Tensor& self, const at::Tensor& dst,
                                bool non_blocking);
 
+  static std::tuple<at::Tensor, at::Tensor, at::Tensor, at::Tensor>
+  _embedding_bag(const at::Tensor& weight, const at::Tensor& indices,
+                 const at::Tensor& offsets, bool scale_grad_by_freq,
+                 int64_t mode, bool sparse,
+                 const at::Tensor& per_sample_weights,
+                 bool include_last_offset);
+
+  static at::Tensor _embedding_bag_dense_backward(
+      const at::Tensor& grad, const at::Tensor& indices,
+      const at::Tensor& offsets, const at::Tensor& offset2bag,
+      const at::Tensor& bag_size, const at::Tensor& maximum_indices,
+      int64_t num_weights, bool scale_grad_by_freq, int64_t mode,
+      const at::Tensor& per_sample_weights);
+
+  static at::Tensor _embedding_bag_per_sample_weights_backward(
+      const at::Tensor& grad, const at::Tensor& weight,
+      const at::Tensor& indices, const at::Tensor& offsets,
+      const at::Tensor& offset2bag, int64_t mode);
+
   static at::Tensor& _index_put_impl_(at::Tensor& self, at::TensorList indices,
                                       const at::Tensor& values, bool accumulate,
                                       bool unsafe);
@@ -80,6 +99,12 @@ class AtenXlaType {
 
   static at::Tensor& acos_(at::Tensor& self);
 
+  static at::Tensor adaptive_avg_pool3d(const at::Tensor& self,
+                                        at::IntArrayRef output_size);
+
+  static at::Tensor adaptive_avg_pool3d_backward(const at::Tensor& grad_output,
+                                                 const at::Tensor& self);
+
   static at::Tensor add(const at::Tensor& self, const at::Tensor& other,
                         at::Scalar alpha);
 
@@ -868,6 +893,14 @@ class AtenXlaType {
   static at::Tensor std(const at::Tensor& self, at::IntArrayRef dim,
                         bool unbiased, bool keepdim);
 
+  static std::tuple<at::Tensor, at::Tensor> std_mean(const at::Tensor& self,
+                                                     bool unbiased);
+
+  static std::tuple<at::Tensor, at::Tensor> std_mean(const at::Tensor& self,
+                                                     at::IntArrayRef dim,
+                                                     bool unbiased,
+                                                     bool keepdim);
+
   static at::Tensor sub(const at::Tensor& self, const at::Tensor& other,
                         at::Scalar alpha);
 
@@ -982,6 +1015,19 @@ class AtenXlaType {
                                                 c10::optional<double> scales_h,
                                                 c10::optional<double> scales_w);
 
+  static at::Tensor var(const at::Tensor& self, bool unbiased);
+
+  static at::Tensor var(const at::Tensor& self, at::IntArrayRef dim,
+                        bool unbiased, bool keepdim);
+
+  static std::tuple<at::Tensor, at::Tensor> var_mean(const at::Tensor& self,
+                                                     bool unbiased);
+
+  static std::tuple<at::Tensor, at::Tensor> var_mean(const at::Tensor& self,
+                                                     at::IntArrayRef dim,
+                                                     bool unbiased,
+                                                     bool keepdim);
+
   static at::Tensor view(const at::Tensor& self, at::IntArrayRef size);
 
   static at::Tensor& zero_(at::Tensor& self);
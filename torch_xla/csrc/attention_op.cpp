@@ -0,0 +1,277 @@
+#include "torch_xla/csrc/attention_op.h"
+
+#include "tensorflow/compiler/xla/client/lib/constants.h"
+#include "tensorflow/compiler/xla/client/lib/loops.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "torch_xla/csrc/helpers.h"
+
+namespace torch_xla {
+namespace {
+
+// The attention inputs are [..., S, D], with the leading dimensions being batch
+// ones.
+struct AttentionDims {
+  explicit AttentionDims(const xla::Shape& key_shape, xla::int64 block_size)
+      : rank(key_shape.rank()),
+        key_length(key_shape.dimensions(rank - 2)),
+        block_size(GetAttentionBlockSize(key_length, block_size)),
+        num_blocks(key_length / this->block_size) {}
+
+  xla::int64 batch_rank() const { return rank - 2; }
+
+  // The broadcast dimensions of a per query [..., Sq] value into a
+  // [..., Sq, X] one.
+  std::vector<xla::int64> query_dims() const {
+    return xla::util::Iota<xla::int64>(rank - 1);
+  }
+
+  xla::int64 rank;
+  xla::int64 key_length;
+  xla::int64 block_size;
+  xla::int64 num_blocks;
+};
+
+xla::PrimitiveType GetComputeType(xla::PrimitiveType type) {
+  // The softmax statistics are accumulated in full precision.
+  return type == xla::PrimitiveType::BF16 || type == xla::PrimitiveType::F16
+             ? xla::PrimitiveType::F32
+             : type;
+}
+
+xla::XlaOp ConvertTo(xla::XlaOp op, xla::PrimitiveType type) {
+  if (XlaHelpers::TypeOfXlaOp(op) == type) {
+    return op;
+  }
+  return xla::ConvertElementType(op, type);
+}
+
+// Multiplies two [..., X, Y] operands, with the leading batch_rank dimensions
+// as batch ones, contracting the given dimensions.
+xla::XlaOp BatchDot(xla::XlaOp lhs, xla::int64 lhs_contracting, xla::XlaOp rhs,
+                    xla::int64 rhs_contracting, xla::int64 batch_rank) {
+  xla::DotDimensionNumbers dims;
+  for (xla::int64 i = 0; i < batch_rank; ++i) {
+    dims.add_lhs_batch_dimensions(i);
+    dims.add_rhs_batch_dimensions(i);
+  }
+  dims.add_lhs_contracting_dimensions(lhs_contracting);
+  dims.add_rhs_contracting_dimensions(rhs_contracting);
+  xla::PrecisionConfig precision_config =
+      XlaHelpers::BuildPrecisionConfig(XlaHelpers::mat_mul_precision());
+  return xla::DotGeneral(lhs, rhs, dims, &precision_config);
+}
+
+// Slices the block_index-th block of block_size rows out of a [..., Sk, X]
+// key or value operand.
+xla::XlaOp SliceKeyBlock(xla::XlaOp input, xla::XlaOp block_index,
+                         const AttentionDims& dims, xla::XlaBuilder* builder) {
+  xla::XlaOp zero = xla::Zero(builder, xla::PrimitiveType::S32);
+  std::vector<xla::XlaOp> start_indices(dims.rank, zero);
+  start_indices[dims.rank - 2] =
+      block_index * xla::ConstantR0<xla::int32>(builder, dims.block_size);
+  std::vector<xla::int64> sizes = XlaHelpers::SizesOfXlaOp(input);
+  sizes[dims.rank - 2] = dims.block_size;
+  return xla::DynamicSlice(input, start_indices, sizes);
+}
+
+xla::XlaOp UpdateKeyBlock(xla::XlaOp input, xla::XlaOp update,
+                          xla::XlaOp block_index, const AttentionDims& dims,
+                          xla::XlaBuilder* builder) {
+  xla::XlaOp zero = xla::Zero(builder, xla::PrimitiveType::S32);
+  std::vector<xla::XlaOp> start_indices(dims.rank, zero);
+  start_indices[dims.rank - 2] =
+      block_index * xla::ConstantR0<xla::int32>(builder, dims.block_size);
+  return xla::DynamicUpdateSlice(input, update, start_indices);
+}
+
+xla::XlaOp ReduceLastDim(xla::XlaOp input, xla::XlaOp init_value,
+                         const xla::XlaComputation& computation) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(input);
+  return xla::Reduce(input, init_value, computation, {shape.rank() - 1});
+}
+
+// The scaled attention scores of the query against a key block.
+xla::XlaOp BlockScores(xla::XlaOp query, xla::XlaOp key_block, double scale,
+                       const AttentionDims& dims, xla::XlaBuilder* builder) {
+  xla::XlaOp scores = BatchDot(query, dims.rank - 1, key_block, dims.rank - 1,
+                               dims.batch_rank());
+  return scores * XlaHelpers::ScalarValue<double>(
+                      scale, XlaHelpers::TypeOfXlaOp(scores), builder);
+}
+
+xla::StatusOr<xla::XlaOp> BlockCondition(const AttentionDims& dims,
+                                         absl::Span<const xla::XlaOp> values,
+                                         xla::XlaBuilder* builder) {
+  return xla::Lt(values[0],
+                 xla::ConstantR0<xla::int32>(builder, dims.num_blocks));
+}
+
+}  // namespace
+
+xla::int64 GetAttentionBlockSize(xla::int64 key_length, xla::int64 block_size) {
+  return block_size > 0 && block_size < key_length &&
+                 key_length % block_size == 0
+             ? block_size
+             : key_length;
+}
+
+AttentionResult BuildScaledDotProductAttention(xla::XlaOp query, xla::XlaOp key,
+                                               xla::XlaOp value, double scale,
+                                               xla::int64 block_size) {
+  const xla::Shape& query_shape = XlaHelpers::ShapeOfXlaOp(query);
+  const xla::Shape& key_shape = XlaHelpers::ShapeOfXlaOp(key);
+  const xla::Shape& value_shape = XlaHelpers::ShapeOfXlaOp(value);
+  XLA_CHECK_GE(query_shape.rank(), 2) << query_shape;
+  XLA_CHECK_EQ(query_shape.rank(), key_shape.rank()) << key_shape;
+  XLA_CHECK_EQ(query_shape.rank(), value_shape.rank()) << value_shape;
+  AttentionDims dims(key_shape, block_size);
+  XLA_CHECK_EQ(value_shape.dimensions(dims.rank - 2), dims.key_length)
+      << value_shape;
+  xla::PrimitiveType type = GetComputeType(query_shape.element_type());
+  xla::XlaBuilder* builder = query.builder();
+
+  std::vector<xla::int64> stats_sizes(
+      query_shape.dimensions().begin(),
+      query_shape.dimensions().begin() + dims.rank - 1);
+  std::vector<xla::int64> acc_sizes = stats_sizes;
+  acc_sizes.push_back(value_shape.dimensions(dims.rank - 1));
+  std::vector<xla::XlaOp> init_values = {
+      xla::Zero(builder, xla::PrimitiveType::S32),
+      xla::Broadcast(xla::MinValue(builder, type), stats_sizes),
+      xla::Broadcast(xla::Zero(builder, type), stats_sizes),
+      xla::Broadcast(xla::Zero(builder, type), acc_sizes),
+      ConvertTo(query, type),
+      ConvertTo(key, type),
+      ConvertTo(value, type)};
+
+  auto cond_fn = [&](absl::Span<const xla::XlaOp> values,
+                     xla::XlaBuilder* body_builder) {
+    return BlockCondition(dims, values, body_builder);
+  };
+  auto body_fn = [&](absl::Span<const xla::XlaOp> values,
+                     xla::XlaBuilder* body_builder)
+      -> xla::StatusOr<std::vector<xla::XlaOp>> {
+    xla::XlaOp block_index = values[0];
+    xla::XlaOp max = values[1];
+    xla::XlaOp sum = values[2];
+    xla::XlaOp acc = values[3];
+    xla::XlaOp key_block =
+        SliceKeyBlock(values[5], block_index, dims, body_builder);
+    xla::XlaOp value_block =
+        SliceKeyBlock(values[6], block_index, dims, body_builder);
+    xla::XlaOp scores =
+        BlockScores(values[4], key_block, scale, dims, body_builder);
+
+    xla::XlaOp new_max = xla::Max(
+        max, ReduceLastDim(scores, xla::MinValue(body_builder, type),
+                           XlaHelpers::CreateMaxComputation(type)));
+    // Rescales the partial results computed with the old running maximum.
+    xla::XlaOp rescale = xla::Exp(max - new_max);
+    xla::XlaOp probs = xla::Exp(xla::Sub(scores, new_max, dims.query_dims()));
+    xla::XlaOp new_sum =
+        sum * rescale + ReduceLastDim(probs, xla::Zero(body_builder, type),
+                                      XlaHelpers::CreateAddComputation(type));
+    xla::XlaOp new_acc =
+        xla::Add(xla::Mul(acc, rescale, dims.query_dims()),
+                 BatchDot(probs, dims.rank - 1, value_block, dims.rank - 2,
+                          dims.batch_rank()));
+    return std::vector<xla::XlaOp>{
+        block_index + xla::One(body_builder, xla::PrimitiveType::S32),
+        new_max,
+        new_sum,
+        new_acc,
+        values[4],
+        values[5],
+        values[6]};
+  };
+  std::vector<xla::XlaOp> results = ConsumeValue(xla::WhileLoopHelper(
+      cond_fn, body_fn, init_values, "AttentionLoop", builder));
+
+  xla::XlaOp output = xla::Div(results[3], results[2], dims.query_dims());
+  xla::XlaOp logsumexp = results[1] + xla::Log(results[2]);
+  return {ConvertTo(output, query_shape.element_type()), logsumexp};
+}
+
+AttentionGradResult BuildScaledDotProductAttentionBackward(
+    xla::XlaOp grad_output, xla::XlaOp query, xla::XlaOp key, xla::XlaOp value,
+    xla::XlaOp output, xla::XlaOp logsumexp, double scale,
+    xla::int64 block_size) {
+  const xla::Shape& query_shape = XlaHelpers::ShapeOfXlaOp(query);
+  const xla::Shape& key_shape = XlaHelpers::ShapeOfXlaOp(key);
+  const xla::Shape& value_shape = XlaHelpers::ShapeOfXlaOp(value);
+  AttentionDims dims(key_shape, block_size);
+  xla::PrimitiveType type = GetComputeType(query_shape.element_type());
+  xla::XlaBuilder* builder = query.builder();
+
+  xla::XlaOp grad = ConvertTo(grad_output, type);
+  // The softmax backward term sum(dP * P), which equals sum(dO * O) per query.
+  xla::XlaOp delta = ReduceLastDim(grad * ConvertTo(output, type),
+                                   xla::Zero(builder, type),
+                                   XlaHelpers::CreateAddComputation(type));
+  std::vector<xla::XlaOp> init_values = {
+      xla::Zero(builder, xla::PrimitiveType::S32),
+      xla::Broadcast(xla::Zero(builder, type), query_shape.dimensions()),
+      xla::Broadcast(xla::Zero(builder, type), key_shape.dimensions()),
+      xla::Broadcast(xla::Zero(builder, type), value_shape.dimensions()),
+      ConvertTo(query, type),
+      ConvertTo(key, type),
+      ConvertTo(value, type),
+      grad,
+      ConvertTo(logsumexp, type),
+      delta};
+
+  auto cond_fn = [&](absl::Span<const xla::XlaOp> values,
+                     xla::XlaBuilder* body_builder) {
+    return BlockCondition(dims, values, body_builder);
+  };
+  auto body_fn = [&](absl::Span<const xla::XlaOp> values,
+                     xla::XlaBuilder* body_builder)
+      -> xla::StatusOr<std::vector<xla::XlaOp>> {
+    xla::XlaOp block_index = values[0];
+    xla::XlaOp body_query = values[4];
+    xla::XlaOp body_grad = values[7];
+    xla::XlaOp key_block =
+        SliceKeyBlock(values[5], block_index, dims, body_builder);
+    xla::XlaOp value_block =
+        SliceKeyBlock(values[6], block_index, dims, body_builder);
+    xla::XlaOp probs = xla::Exp(
+        xla::Sub(BlockScores(body_query, key_block, scale, dims, body_builder),
+                 values[8], dims.query_dims()));
+
+    xla::XlaOp grad_value_block = BatchDot(probs, dims.rank - 2, body_grad,
+                                           dims.rank - 2, dims.batch_rank());
+    xla::XlaOp grad_probs = BatchDot(body_grad, dims.rank - 1, value_block,
+                                     dims.rank - 1, dims.batch_rank());
+    xla::XlaOp scale_value =
+        XlaHelpers::ScalarValue<double>(scale, type, body_builder);
+    xla::XlaOp grad_scores =
+        probs * xla::Sub(grad_probs, values[9], dims.query_dims()) *
+        scale_value;
+    xla::XlaOp grad_query =
+        values[1] + BatchDot(grad_scores, dims.rank - 1, key_block,
+                             dims.rank - 2, dims.batch_rank());
+    xla::XlaOp grad_key_block = BatchDot(grad_scores, dims.rank - 2, body_query,
+                                         dims.rank - 2, dims.batch_rank());
+    return std::vector<xla::XlaOp>{
+        block_index + xla::One(body_builder, xla::PrimitiveType::S32),
+        grad_query,
+        UpdateKeyBlock(values[2], grad_key_block, block_index, dims,
+                       body_builder),
+        UpdateKeyBlock(values[3], grad_value_block, block_index, dims,
+                       body_builder),
+        body_query,
+        values[5],
+        values[6],
+        body_grad,
+        values[8],
+        values[9]};
+  };
+  std::vector<xla::XlaOp> results = ConsumeValue(xla::WhileLoopHelper(
+      cond_fn, body_fn, init_values, "AttentionBackwardLoop", builder));
+  return {ConvertTo(results[1], query_shape.element_type()),
+          ConvertTo(results[2], key_shape.element_type()),
+          ConvertTo(results[3], value_shape.element_type())};
+}
+
+}  // namespace torch_xla
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "tensorflow/compiler/xla/client/xla_builder.h"
+
+namespace torch_xla {
+
+struct AttentionResult {
+  xla::XlaOp output;
+  // The log of the softmax denominator, per query, which is all the backward
+  // pass needs to recompute the attention probabilities.
+  xla::XlaOp logsumexp;
+};
+
+struct AttentionGradResult {
+  xla::XlaOp grad_query;
+  xla::XlaOp grad_key;
+  xla::XlaOp grad_value;
+};
+
+// Computes softmax(query @ key^T * scale) @ value, where query is [..., Sq, D],
+// key is [..., Sk, D] and value is [..., Sk, Dv]. The key dimension is visited
+// in blocks of block_size, with the softmax computed online (rescaling the
+// partial results as the running maximum grows), so that no [Sq, Sk] scores
+// tensor is ever materialized.
+AttentionResult BuildScaledDotProductAttention(xla::XlaOp query, xla::XlaOp key,
+                                               xla::XlaOp value, double scale,
+                                               xla::int64 block_size);
+
+// Computes the gradients of BuildScaledDotProductAttention() with respect to
+// its inputs, recomputing the attention probabilities block by block from the
+// saved logsumexp.
+AttentionGradResult BuildScaledDotProductAttentionBackward(
+    xla::XlaOp grad_output, xla::XlaOp query, xla::XlaOp key, xla::XlaOp value,
+    xla::XlaOp output, xla::XlaOp logsumexp, double scale,
+    xla::int64 block_size);
+
+// Returns the key block size used by the lowering, which is the requested one
+// if it divides the key sequence length, or the whole sequence otherwise.
+xla::int64 GetAttentionBlockSize(xla::int64 key_length, xla::int64 block_size);
+
+}  // namespace torch_xla
@@ -0,0 +1,121 @@
+#include "torch_xla/csrc/autocast_policy.h"
+
+#include <unordered_set>
+#include <vector>
+
+#include "absl/strings/str_split.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "torch_xla/csrc/ops/cast.h"
+
+namespace torch_xla {
+namespace {
+
+struct AutocastLists {
+  std::unordered_set<c10::Symbol> allow;
+  std::unordered_set<c10::Symbol> deny;
+};
+
+std::unordered_set<c10::Symbol> ParseOpList(const char* env,
+                                            const char* defval) {
+  std::unordered_set<c10::Symbol> ops;
+  std::string op_list = xla::sys_util::GetEnvString(env, defval);
+  for (auto& name : absl::StrSplit(op_list, ',', absl::SkipWhitespace())) {
+    ops.insert(c10::Symbol::fromQualString(std::string(name)));
+  }
+  return ops;
+}
+
+const AutocastLists& GetAutocastLists() {
+  static const AutocastLists* lists = new AutocastLists(
+      {ParseOpList("XLA_AUTOCAST_ALLOW_OPS",
+                   "aten::mm,aten::matmul,aten::addmm,"
+                   "aten::convolution_overrideable"),
+       ParseOpList("XLA_AUTOCAST_DENY_OPS",
+                   "aten::sum,aten::mean,aten::softmax,aten::log_softmax,"
+                   "aten::nll_loss")});
+  return *lists;
+}
+
+xla::PrimitiveType ParseAutocastType(const std::string& type) {
+  if (type.empty()) {
+    return xla::PRIMITIVE_TYPE_INVALID;
+  }
+  if (type == "bf16") {
+    return xla::PrimitiveType::BF16;
+  }
+  if (type == "f16") {
+    return xla::PrimitiveType::F16;
+  }
+  XLA_ERROR() << "Invalid autocast type: " << type;
+}
+
+struct AutocastContext {
+  std::vector<xla::PrimitiveType> scopes;
+};
+
+thread_local AutocastContext g_autocast_context;
+
+xla::PrimitiveType GetCurrentAutocastType() {
+  static const xla::PrimitiveType default_type =
+      ParseAutocastType(xla::sys_util::GetEnvString("XLA_AUTOCAST", ""));
+  return g_autocast_context.scopes.empty() ? default_type
+                                           : g_autocast_context.scopes.back();
+}
+
+bool IsLowPrecisionType(xla::PrimitiveType type) {
+  return type == xla::PrimitiveType::BF16 || type == xla::PrimitiveType::F16;
+}
+
+}  // namespace
+
+AutocastOp::AutocastOp(const ir::OpKind& op) {
+  xla::PrimitiveType type = GetCurrentAutocastType();
+  if (type == xla::PRIMITIVE_TYPE_INVALID) {
+    return;
+  }
+  const AutocastLists& lists = GetAutocastLists();
+  if (lists.allow.count(op.op) > 0) {
+    compute_type_ = type;
+  } else if (lists.deny.count(op.op) > 0) {
+    compute_type_ = xla::PrimitiveType::F32;
+  }
+}
+
+ir::Value AutocastOp::Operand(const ir::Value& value) {
+  if (compute_type_ == xla::PRIMITIVE_TYPE_INVALID) {
+    return value;
+  }
+  xla::PrimitiveType type = value.shape().element_type();
+  bool needs_cast = compute_type_ == xla::PrimitiveType::F32
+                        ? IsLowPrecisionType(type)
+                        : type == xla::PrimitiveType::F32;
+  if (!needs_cast) {
+    return value;
+  }
+  if (result_type_ == xla::PRIMITIVE_TYPE_INVALID) {
+    result_type_ = type;
+  }
+  XLA_COUNTER("AutocastOperands", 1);
+  return ir::MakeNode<ir::ops::Cast>(value, compute_type_);
+}
+
+ir::Value AutocastOp::Result(const ir::Value& value) const {
+  if (result_type_ == xla::PRIMITIVE_TYPE_INVALID ||
+      value.shape().element_type() == result_type_) {
+    return value;
+  }
+  return ir::MakeNode<ir::ops::Cast>(value, result_type_);
+}
+
+void PushAutocastScope(const std::string& type) {
+  g_autocast_context.scopes.push_back(ParseAutocastType(type));
+}
+
+void PopAutocastScope() {
+  XLA_CHECK(!g_autocast_context.scopes.empty());
+  g_autocast_context.scopes.pop_back();
+}
+
+}  // namespace torch_xla
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+
+#include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/compiler/xla/xla_data.pb.h"
+#include "torch_xla/csrc/ir.h"
+
+namespace torch_xla {
+
+// Mixed precision policy applied by the XLATensor operations at IR creation
+// time. While a policy is active, the operations in the allow list (matrix
+// multiplications and convolutions) compute in the policy type (BF16 or F16),
+// while the ones in the deny list (reductions, softmax and losses) compute in
+// F32, even if their inputs are stored in a lower precision type. Either way
+// the results are cast back to the type the operation would have otherwise
+// produced, so the tensors (and the master weights) keep their types.
+//
+// The default policy comes from XLA_AUTOCAST ("bf16", "f16" or empty for none),
+// and the lists can be replaced with XLA_AUTOCAST_ALLOW_OPS and
+// XLA_AUTOCAST_DENY_OPS (comma separated "aten::mm" like op names).
+class AutocastOp {
+ public:
+  explicit AutocastOp(const ir::OpKind& op);
+
+  // Casts the operand to the type the operation should compute in, if it is a
+  // floating point value the policy applies to.
+  ir::Value Operand(const ir::Value& value);
+
+  // Casts the operation result back to the type of the first operand which has
+  // been cast by Operand().
+  ir::Value Result(const ir::Value& value) const;
+
+  // Whether Operand() has cast any operand.
+  bool cast() const { return result_type_ != xla::PRIMITIVE_TYPE_INVALID; }
+
+ private:
+  xla::PrimitiveType compute_type_ = xla::PRIMITIVE_TYPE_INVALID;
+  xla::PrimitiveType result_type_ = xla::PRIMITIVE_TYPE_INVALID;
+};
+
+// Enters a new autocast scope on the calling thread, whose policy computes the
+// allowed operations in the given type ("bf16" or "f16"), or disables the
+// policy if the type is empty.
+void PushAutocastScope(const std::string& type);
+
+void PopAutocastScope();
+
+}  // namespace torch_xla
@@ -1,6 +1,9 @@
 #include "torch_xla/csrc/batch_norm.h"
 
 #include "tensorflow/compiler/xla/client/lib/constants.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "torch_xla/csrc/cross_replica_reduces.h"
 #include "torch_xla/csrc/helpers.h"
 
 namespace torch_xla {
@@ -15,6 +18,46 @@ xla::XlaOp VarianceRecover(xla::XlaOp invstd, float eps_value) {
   return one_over_invstd * one_over_invstd - eps;
 }
 
+// Sums the NCHW input over all the dimensions but the feature one.
+xla::XlaOp SumFeatures(xla::XlaOp input, const xla::Shape& input_shape) {
+  std::vector<xla::int64> dimensions;
+  for (xla::int64 dim = 0; dim < input_shape.rank(); ++dim) {
+    if (dim != 1) {
+      dimensions.push_back(dim);
+    }
+  }
+  return xla::Reduce(
+      input, xla::Zero(input.builder(), input_shape.element_type()),
+      XlaHelpers::CreateAddComputation(input_shape.element_type()),
+      dimensions);
+}
+
+xla::XlaOp BroadcastFeatures(xla::XlaOp features,
+                             const xla::Shape& input_shape) {
+  return xla::BroadcastInDim(features, input_shape.dimensions(), {1});
+}
+
+// All-reduces the rank 1 statistics with a single collective, and returns the
+// reduced statistics followed by the new token.
+std::vector<xla::XlaOp> AllReduceStatistics(
+    absl::Span<const xla::XlaOp> statistics, xla::XlaOp token,
+    const std::vector<std::vector<xla::int64>>& groups) {
+  xla::XlaOp packed =
+      xla::ConcatInDim(statistics.front().builder(), statistics, 0);
+  std::vector<xla::XlaOp> reduced =
+      BuildAllReduce(AllReduceType::kSum, {packed}, token, 1.0, groups);
+  std::vector<xla::XlaOp> results;
+  xla::int64 offset = 0;
+  for (auto& value : statistics) {
+    xla::int64 size = XlaHelpers::ShapeOfXlaOp(value).dimensions(0);
+    results.push_back(
+        xla::SliceInDim(reduced[0], offset, offset + size, 1, 0));
+    offset += size;
+  }
+  results.push_back(reduced[1]);
+  return results;
+}
+
 }  // namespace
 
 xla::XlaOp BatchNormVarianceInvert(xla::XlaOp variance, float eps_value) {
@@ -25,9 +68,10 @@ xla::XlaOp BatchNormVarianceInvert(xla::XlaOp variance, float eps_value) {
 }
 
 BatchNormOutput BuildBatchNormTraining(xla::XlaOp input, xla::XlaOp weight,
-                                       xla::XlaOp bias, float eps_value) {
-  xla::XlaOp outputs = xla::BatchNormTraining(input, weight, bias, eps_value,
-                                              /*feature_index=*/1);
+                                       xla::XlaOp bias, float eps_value,
+                                       xla::int64 feature_index) {
+  xla::XlaOp outputs =
+      xla::BatchNormTraining(input, weight, bias, eps_value, feature_index);
   xla::XlaOp output = xla::GetTupleElement(outputs, 0);
   xla::XlaOp batch_mean = xla::GetTupleElement(outputs, 1);
   xla::XlaOp batch_variance = xla::GetTupleElement(outputs, 2);
@@ -36,9 +80,10 @@ BatchNormOutput BuildBatchNormTraining(xla::XlaOp input, xla::XlaOp weight,
 
 xla::XlaOp BuildBatchNormInference(xla::XlaOp input, xla::XlaOp weight,
                                    xla::XlaOp bias, xla::XlaOp mean,
-                                   xla::XlaOp variance, float eps_value) {
+                                   xla::XlaOp variance, float eps_value,
+                                   xla::int64 feature_index) {
   return xla::BatchNormInference(input, weight, bias, mean, variance, eps_value,
-                                 /*feature_index=*/1);
+                                 feature_index);
 }
 
 BatchNormGrads BuildBatchNormBackward(xla::XlaOp grad, xla::XlaOp input,
@@ -54,4 +99,52 @@ BatchNormGrads BuildBatchNormBackward(xla::XlaOp grad, xla::XlaOp input,
   return {grad_input, grad_weight, grad_bias};
 }
 
+SyncBatchNormOutput BuildSyncBatchNormTraining(
+    xla::XlaOp input, xla::XlaOp weight, xla::XlaOp bias, xla::XlaOp token,
+    float eps_value, const std::vector<std::vector<xla::int64>>& groups) {
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  XLA_CHECK_GE(input_shape.rank(), 2) << input_shape;
+  xla::int64 num_features = input_shape.dimensions(1);
+  xla::int64 local_count =
+      xla::ShapeUtil::ElementsIn(input_shape) / num_features;
+  xla::XlaOp count = XlaHelpers::ScalarValue<double>(
+      local_count, input_shape.element_type(), input.builder());
+  std::vector<xla::XlaOp> reduced = AllReduceStatistics(
+      {SumFeatures(input, input_shape),
+       SumFeatures(input * input, input_shape), xla::Reshape(count, {1})},
+      token, groups);
+  xla::XlaOp global_count = xla::Reshape(reduced[2], {});
+  xla::XlaOp mean = reduced[0] / global_count;
+  xla::XlaOp variance = xla::Max(
+      reduced[1] / global_count - mean * mean,
+      xla::Zero(input.builder(), input_shape.element_type()));
+  xla::XlaOp invstd = BatchNormVarianceInvert(variance, eps_value);
+  xla::XlaOp output =
+      (input - BroadcastFeatures(mean, input_shape)) *
+          BroadcastFeatures(invstd * weight, input_shape) +
+      BroadcastFeatures(bias, input_shape);
+  return {output, mean, invstd, global_count, reduced[3]};
+}
+
+SyncBatchNormGrads BuildSyncBatchNormBackward(
+    xla::XlaOp grad, xla::XlaOp input, xla::XlaOp weight, xla::XlaOp mean,
+    xla::XlaOp invstd, xla::XlaOp count, xla::XlaOp token,
+    const std::vector<std::vector<xla::int64>>& groups) {
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  xla::XlaOp centered_input = input - BroadcastFeatures(mean, input_shape);
+  xla::XlaOp sum_grad = SumFeatures(grad, input_shape);
+  xla::XlaOp sum_grad_centered =
+      SumFeatures(grad * centered_input, input_shape);
+  std::vector<xla::XlaOp> reduced =
+      AllReduceStatistics({sum_grad, sum_grad_centered}, token, groups);
+  xla::XlaOp mean_grad = reduced[0] / count;
+  xla::XlaOp mean_grad_centered = reduced[1] / count;
+  xla::XlaOp centered_scale = invstd * invstd * mean_grad_centered;
+  xla::XlaOp grad_input =
+      (grad - BroadcastFeatures(mean_grad, input_shape) -
+       centered_input * BroadcastFeatures(centered_scale, input_shape)) *
+      BroadcastFeatures(invstd * weight, input_shape);
+  return {grad_input, sum_grad_centered * invstd, sum_grad, reduced[2]};
+}
+
 }  // namespace torch_xla
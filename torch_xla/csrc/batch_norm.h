@@ -1,5 +1,7 @@
 #pragma once
 
+#include <vector>
+
 #include "tensorflow/compiler/xla/client/xla_builder.h"
 
 namespace torch_xla {
@@ -16,18 +18,54 @@ struct BatchNormGrads {
   xla::XlaOp grad_bias;
 };
 
+struct SyncBatchNormOutput {
+  xla::XlaOp output;
+  xla::XlaOp mean;
+  xla::XlaOp invstd;
+  // The number of elements of every feature, across the replicas.
+  xla::XlaOp count;
+  xla::XlaOp token;
+};
+
+struct SyncBatchNormGrads {
+  xla::XlaOp grad_input;
+  xla::XlaOp grad_weight;
+  xla::XlaOp grad_bias;
+  xla::XlaOp token;
+};
+
 xla::XlaOp BatchNormVarianceInvert(xla::XlaOp variance, float eps_value);
 
+// The feature_index is 1 for PyTorch (NCHW) inputs, and the last dimension for
+// channels-last ones.
 BatchNormOutput BuildBatchNormTraining(xla::XlaOp input, xla::XlaOp weight,
-                                       xla::XlaOp bias, float eps_value);
+                                       xla::XlaOp bias, float eps_value,
+                                       xla::int64 feature_index = 1);
 
 xla::XlaOp BuildBatchNormInference(xla::XlaOp input, xla::XlaOp weight,
                                    xla::XlaOp bias, xla::XlaOp mean,
-                                   xla::XlaOp variance, float eps_value);
+                                   xla::XlaOp variance, float eps_value,
+                                   xla::int64 feature_index = 1);
 
 BatchNormGrads BuildBatchNormBackward(xla::XlaOp grad, xla::XlaOp input,
                                       xla::XlaOp weight, xla::XlaOp save_mean,
                                       xla::XlaOp save_invstd, bool training,
                                       float eps_value);
 
+// Batch norm training of NCHW inputs, with the statistics computed over the
+// inputs of all the replicas of each group. The local sums and sums of squares
+// of the features, and the local count, are packed into a single buffer, so
+// that one all-reduce is issued.
+SyncBatchNormOutput BuildSyncBatchNormTraining(
+    xla::XlaOp input, xla::XlaOp weight, xla::XlaOp bias, xla::XlaOp token,
+    float eps_value, const std::vector<std::vector<xla::int64>>& groups);
+
+// The backward of BuildSyncBatchNormTraining(), which also issues a single
+// all-reduce. The weight and bias gradients are the local ones, as the
+// replicas reduce them together with the other parameter gradients.
+SyncBatchNormGrads BuildSyncBatchNormBackward(
+    xla::XlaOp grad, xla::XlaOp input, xla::XlaOp weight, xla::XlaOp mean,
+    xla::XlaOp invstd, xla::XlaOp count, xla::XlaOp token,
+    const std::vector<std::vector<xla::int64>>& groups);
+
 }  // namespace torch_xla
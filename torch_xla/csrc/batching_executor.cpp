@@ -0,0 +1,187 @@
+#include "torch_xla/csrc/batching_executor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "torch_xla/csrc/tensor_util.h"
+
+namespace torch_xla {
+namespace {
+
+xla::metrics::Metric* GetLatencyMetric() {
+  static xla::metrics::Metric* metric = new xla::metrics::Metric(
+      "BatchingExecutor.Latency", xla::metrics::MetricFnTime);
+  return metric;
+}
+
+// Concatenates the requests inputs along the batch dimension, and pads them
+// with zeros up to the bucket batch size.
+at::Tensor MergeInputs(std::vector<at::Tensor> inputs, xla::int64 batch_size,
+                       xla::int64 bucket_size) {
+  if (batch_size < bucket_size) {
+    std::vector<int64_t> padding_sizes = inputs.front().sizes().vec();
+    padding_sizes[0] = bucket_size - batch_size;
+    inputs.push_back(at::zeros(padding_sizes, inputs.front().options()));
+  }
+  return inputs.size() > 1 ? at::cat(inputs, 0) : inputs.front();
+}
+
+}  // namespace
+
+BatchingExecutor::BatchingExecutor(
+    std::vector<std::shared_ptr<ExportedGraph>> graphs,
+    xla::int64 max_delay_us)
+    : graphs_(std::move(graphs)), max_delay_ns_(max_delay_us * 1000) {
+  XLA_CHECK(!graphs_.empty());
+  auto bucket_size = [](const std::shared_ptr<ExportedGraph>& graph) {
+    XLA_CHECK(!graph->input_shapes().empty());
+    XLA_CHECK_GT(graph->input_shapes().front().rank(), 0);
+    return graph->input_shapes().front().dimensions(0);
+  };
+  std::sort(graphs_.begin(), graphs_.end(),
+            [&](const std::shared_ptr<ExportedGraph>& graph1,
+                const std::shared_ptr<ExportedGraph>& graph2) {
+              return bucket_size(graph1) < bucket_size(graph2);
+            });
+  for (auto& graph : graphs_) {
+    XLA_CHECK_EQ(graph->device(), graphs_.front()->device());
+    bucket_sizes_.push_back(bucket_size(graph));
+  }
+  thread_ = std::thread([this] { RunLoop(); });
+}
+
+BatchingExecutor::~BatchingExecutor() { Close(); }
+
+std::vector<at::Tensor> BatchingExecutor::Run(
+    std::vector<at::Tensor> inputs) {
+  XLA_CHECK(!inputs.empty());
+  auto request = std::make_shared<Request>();
+  request->batch_size = inputs.front().size(0);
+  XLA_CHECK_LE(request->batch_size, bucket_sizes_.back())
+      << "Request batch size exceeds the biggest bucket";
+  request->inputs = std::move(inputs);
+  request->enqueue_ns = xla::sys_util::NowNs();
+  std::future<std::vector<at::Tensor>> outputs = request->outputs.get_future();
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    XLA_CHECK(!closed_) << "Batching executor closed";
+    queued_rows_ += request->batch_size;
+    queue_.push_back(std::move(request));
+  }
+  cv_.notify_all();
+  return outputs.get();
+}
+
+void BatchingExecutor::Close() {
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    if (closed_) {
+      return;
+    }
+    closed_ = true;
+  }
+  cv_.notify_all();
+  thread_.join();
+}
+
+void BatchingExecutor::RunLoop() {
+  xla::int64 max_batch_size = bucket_sizes_.back();
+  while (true) {
+    std::vector<std::shared_ptr<Request>> requests;
+    xla::int64 batch_size = 0;
+    {
+      std::unique_lock<std::mutex> lock(lock_);
+      cv_.wait(lock, [this] { return closed_ || !queue_.empty(); });
+      if (queue_.empty()) {
+        break;
+      }
+      // Wait for more requests to fill the biggest bucket, but no longer than
+      // the deadline of the oldest one.
+      auto deadline = std::chrono::steady_clock::now() +
+                      std::chrono::nanoseconds(
+                          queue_.front()->enqueue_ns + max_delay_ns_ -
+                          xla::sys_util::NowNs());
+      cv_.wait_until(lock, deadline, [&] {
+        return closed_ || queued_rows_ >= max_batch_size;
+      });
+      while (!queue_.empty() &&
+             batch_size + queue_.front()->batch_size <= max_batch_size) {
+        batch_size += queue_.front()->batch_size;
+        queued_rows_ -= queue_.front()->batch_size;
+        requests.push_back(std::move(queue_.front()));
+        queue_.pop_front();
+      }
+    }
+    RunBatch(requests, batch_size);
+  }
+}
+
+void BatchingExecutor::RunBatch(
+    const std::vector<std::shared_ptr<Request>>& requests,
+    xla::int64 batch_size) {
+  std::vector<std::vector<at::Tensor>> requests_outputs;
+  try {
+    size_t bucket = std::lower_bound(bucket_sizes_.begin(),
+                                     bucket_sizes_.end(), batch_size) -
+                    bucket_sizes_.begin();
+    xla::int64 bucket_size = bucket_sizes_[bucket];
+    const ExportedGraph& graph = *graphs_[bucket];
+    XLA_VALUE_METRIC("BatchingExecutor.BatchSize", batch_size);
+    XLA_VALUE_METRIC("BatchingExecutor.BatchFill",
+                     static_cast<double>(batch_size) / bucket_size);
+
+    size_t num_inputs = graph.input_shapes().size();
+    std::vector<at::Tensor> inputs;
+    for (size_t i = 0; i < num_inputs; ++i) {
+      std::vector<at::Tensor> request_inputs;
+      for (auto& request : requests) {
+        XLA_CHECK_EQ(request->inputs.size(), num_inputs);
+        request_inputs.push_back(request->inputs[i]);
+      }
+      inputs.push_back(
+          MergeInputs(std::move(request_inputs), batch_size, bucket_size));
+    }
+    std::vector<xla::ComputationClient::DataPtr> outputs_data;
+    {
+      XLA_TIMED("BatchingExecutor.Execute");
+      outputs_data = graph.Execute(CreateTensorsData(
+          inputs,
+          std::vector<std::string>(num_inputs, graph.device().ToString())));
+    }
+    std::vector<at::Tensor> outputs =
+        XlaDataToTensors(outputs_data, graph.output_types());
+
+    xla::int64 offset = 0;
+    for (auto& request : requests) {
+      // Outputs without the bucket batch dimension are handed whole to every
+      // request.
+      std::vector<at::Tensor> request_outputs;
+      for (auto& output : outputs) {
+        if (output.dim() > 0 && output.size(0) == bucket_size) {
+          request_outputs.push_back(
+              output.narrow(0, offset, request->batch_size));
+        } else {
+          request_outputs.push_back(output);
+        }
+      }
+      offset += request->batch_size;
+      requests_outputs.push_back(std::move(request_outputs));
+    }
+  } catch (...) {
+    for (auto& request : requests) {
+      request->outputs.set_exception(std::current_exception());
+    }
+    return;
+  }
+  for (size_t i = 0; i < requests.size(); ++i) {
+    requests[i]->outputs.set_value(std::move(requests_outputs[i]));
+    GetLatencyMetric()->AddSample(xla::sys_util::NowNs() -
+                                  requests[i]->enqueue_ns);
+  }
+}
+
+}  // namespace torch_xla
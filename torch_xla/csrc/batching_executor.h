@@ -0,0 +1,64 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "tensorflow/compiler/xla/types.h"
+#include "torch/csrc/autograd/variable.h"
+#include "torch_xla/csrc/exported_graph.h"
+
+namespace torch_xla {
+
+// Dynamic batching executor for online inference. The requests (host tensors
+// with the batch on their first dimension) are queued, and a background thread
+// merges them into batches, up to the biggest bucket batch size, or until the
+// oldest queued request waited max_delay_us. Every batch is padded to the
+// smallest bucket fitting it, and run with the exported graph of that bucket
+// (the graphs differ only by the batch size of their inputs) as a single
+// upload, execution and download. The outputs are then split back across the
+// requests.
+class BatchingExecutor {
+ public:
+  BatchingExecutor(std::vector<std::shared_ptr<ExportedGraph>> graphs,
+                   xla::int64 max_delay_us);
+
+  ~BatchingExecutor();
+
+  // Queues a request, and waits for its outputs. Can be called concurrently by
+  // many threads.
+  std::vector<at::Tensor> Run(std::vector<at::Tensor> inputs);
+
+  // Runs the queued requests, and stops the executor.
+  void Close();
+
+ private:
+  struct Request {
+    std::vector<at::Tensor> inputs;
+    xla::int64 batch_size = 0;
+    xla::int64 enqueue_ns = 0;
+    std::promise<std::vector<at::Tensor>> outputs;
+  };
+
+  void RunLoop();
+
+  void RunBatch(const std::vector<std::shared_ptr<Request>>& requests,
+                xla::int64 batch_size);
+
+  // Graphs sorted by increasing bucket batch size.
+  std::vector<std::shared_ptr<ExportedGraph>> graphs_;
+  std::vector<xla::int64> bucket_sizes_;
+  xla::int64 max_delay_ns_;
+  std::mutex lock_;
+  std::condition_variable cv_;
+  std::deque<std::shared_ptr<Request>> queue_;
+  xla::int64 queued_rows_ = 0;
+  bool closed_ = false;
+  std::thread thread_;
+};
+
+}  // namespace torch_xla
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+
+namespace torch_xla {
+
+// Bounded multi producer, multi consumer queues, backing the ones of the
+// torch_xla.utils.keyd_queue Python module. The items are moved in and out
+// through pointers, so that the callers control the thread state under which
+// they get destroyed (Python objects need the GIL, while the waits on the
+// queues should not hold it).
+class BlockingQueueBase {
+ public:
+  explicit BlockingQueueBase(size_t max_size) : max_size_(max_size) {}
+
+  size_t max_size() const { return max_size_; }
+
+  // Wakes up all the waiters. No more items are accepted, while the queued
+  // ones can still be read.
+  void Close() {
+    std::lock_guard<std::mutex> lock(lock_);
+    close_read_ = true;
+    close_write_ = true;
+    ready_cv_.notify_all();
+    space_cv_.notify_all();
+  }
+
+  // Signals that no more items will be written, so the readers stop waiting
+  // once the queue is empty.
+  void CloseWrite() {
+    std::lock_guard<std::mutex> lock(lock_);
+    close_write_ = true;
+    ready_cv_.notify_all();
+  }
+
+ protected:
+  size_t max_size_;
+  std::mutex lock_;
+  std::condition_variable ready_cv_;
+  std::condition_variable space_cv_;
+  bool close_read_ = false;
+  bool close_write_ = false;
+};
+
+template <typename T>
+class BlockingQueue : public BlockingQueueBase {
+ public:
+  explicit BlockingQueue(size_t max_size) : BlockingQueueBase(max_size) {}
+
+  // Moves *item at the end of the queue, waiting for room. Returns false, with
+  // *item untouched, if the queue has been closed.
+  bool Put(T* item) {
+    std::unique_lock<std::mutex> lock(lock_);
+    space_cv_.wait(lock,
+                   [this] { return items_.size() < max_size_ || close_read_; });
+    if (close_read_) {
+      return false;
+    }
+    items_.push_back(std::move(*item));
+    ready_cv_.notify_one();
+    return true;
+  }
+
+  // Moves the first item into *item, waiting for one. Returns false once the
+  // queue is empty and closed for writing.
+  bool Get(T* item) {
+    std::unique_lock<std::mutex> lock(lock_);
+    ready_cv_.wait(lock, [this] { return !items_.empty() || close_write_; });
+    if (items_.empty()) {
+      return false;
+    }
+    *item = std::move(items_.front());
+    items_.pop_front();
+    space_cv_.notify_one();
+    return true;
+  }
+
+ private:
+  std::deque<T> items_;
+};
+
+template <typename K, typename T>
+class KeydBlockingQueue : public BlockingQueueBase {
+ public:
+  explicit KeydBlockingQueue(size_t max_size) : BlockingQueueBase(max_size) {}
+
+  // Stores *item under key, waiting for room unless a reader is waiting for
+  // such key. An item already stored under the same key is replaced, and moved
+  // into *item. Returns false, with *item untouched, if the queue has been
+  // closed.
+  bool Put(const K& key, T* item) {
+    std::unique_lock<std::mutex> lock(lock_);
+    space_cv_.wait(lock, [&] {
+      return items_.size() < max_size_ || waited_keys_.count(key) > 0 ||
+             close_read_;
+    });
+    if (close_read_) {
+      return false;
+    }
+    auto it = items_.find(key);
+    if (it != items_.end()) {
+      std::swap(it->second, *item);
+    } else {
+      items_.emplace(key, std::move(*item));
+    }
+    if (waited_keys_.count(key) > 0) {
+      ready_cv_.notify_all();
+    }
+    return true;
+  }
+
+  // Moves the item stored under key into *item, waiting for it. Returns false
+  // if the queue gets closed for writing without such item.
+  bool Get(const K& key, T* item) {
+    std::unique_lock<std::mutex> lock(lock_);
+    while (items_.count(key) == 0 && !close_write_) {
+      waited_keys_.insert(key);
+      space_cv_.notify_all();
+      ready_cv_.wait(lock);
+      waited_keys_.erase(waited_keys_.find(key));
+    }
+    auto it = items_.find(key);
+    if (it == items_.end()) {
+      return false;
+    }
+    *item = std::move(it->second);
+    items_.erase(it);
+    space_cv_.notify_one();
+    return true;
+  }
+
+ private:
+  std::unordered_map<K, T> items_;
+  std::multiset<K> waited_keys_;
+};
+
+}  // namespace torch_xla
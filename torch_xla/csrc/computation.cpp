@@ -1,14 +1,123 @@
 #include "torch_xla/csrc/computation.h"
 
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
 
 namespace torch_xla {
+namespace {
+
+using IdMap = std::unordered_map<xla::int64, xla::int64>;
+
+xla::int64 RemapId(const IdMap& id_map, xla::int64 id) {
+  auto it = id_map.find(id);
+  return it != id_map.end() ? it->second : id;
+}
+
+void RemapIds(const IdMap& id_map,
+              google::protobuf::RepeatedField<xla::int64>* ids) {
+  for (auto& id : *ids) {
+    id = RemapId(id_map, id);
+  }
+}
+
+// The builders assign unique names and IDs to computations and instructions,
+// so two builds of the same function lead to different protos. The hash is
+// computed over a copy of the proto with the names and the debug metadata
+// removed, and the IDs renumbered in order of appearance.
+xla::hash_t ComputeStructuralHash(const xla::HloModuleProto& proto) {
+  IdMap computation_ids;
+  IdMap instruction_ids;
+  for (auto& computation : proto.computations()) {
+    computation_ids.emplace(computation.id(), computation_ids.size());
+    for (auto& instruction : computation.instructions()) {
+      instruction_ids.emplace(instruction.id(), instruction_ids.size());
+    }
+  }
+  xla::HloModuleProto canonical(proto);
+  canonical.clear_name();
+  canonical.clear_id();
+  canonical.clear_entry_computation_name();
+  canonical.set_entry_computation_id(
+      RemapId(computation_ids, canonical.entry_computation_id()));
+  for (auto& computation : *canonical.mutable_computations()) {
+    computation.clear_name();
+    computation.set_id(RemapId(computation_ids, computation.id()));
+    computation.set_root_id(RemapId(instruction_ids, computation.root_id()));
+    for (auto& instruction : *computation.mutable_instructions()) {
+      instruction.clear_name();
+      instruction.clear_metadata();
+      instruction.set_id(RemapId(instruction_ids, instruction.id()));
+      RemapIds(instruction_ids, instruction.mutable_operand_ids());
+      RemapIds(instruction_ids, instruction.mutable_control_predecessor_ids());
+      RemapIds(computation_ids, instruction.mutable_called_computation_ids());
+    }
+  }
+  return xla::util::MHash(canonical.SerializeAsString());
+}
+
+class ComputationRegistry {
+ public:
+  static ComputationRegistry* Get() {
+    static ComputationRegistry* registry = new ComputationRegistry();
+    return registry;
+  }
+
+  ComputationPtr Register(ComputationPtr computation) {
+    std::lock_guard<std::mutex> lock(lock_);
+    auto it = computations_.find(computation->hash());
+    if (it != computations_.end()) {
+      ComputationPtr registered = it->second.lock();
+      if (registered != nullptr) {
+        XLA_COUNTER("RegisteredComputationHit", 1);
+        return registered;
+      }
+      it->second = computation;
+    } else {
+      // The registry holds weak references, so the entries of the released
+      // computations are dropped every time the registry doubles in size.
+      if (computations_.size() >= prune_size_) {
+        Prune();
+      }
+      computations_.emplace(computation->hash(), computation);
+    }
+    XLA_COUNTER("RegisteredComputationMiss", 1);
+    return computation;
+  }
+
+ private:
+  void Prune() {
+    for (auto it = computations_.begin(); it != computations_.end();) {
+      if (it->second.expired()) {
+        it = computations_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    prune_size_ = std::max<size_t>(2 * computations_.size(), 64);
+  }
+
+  std::mutex lock_;
+  std::unordered_map<xla::hash_t, std::weak_ptr<Computation>,
+                     xla::util::HashReducer>
+      computations_;
+  size_t prune_size_ = 64;
+};
+
+}  // namespace
 
 Computation::Computation(std::string name, xla::XlaComputation computation)
     : name_(std::move(name)), computation_(std::move(computation)) {
   program_shape_ = ConsumeValue(computation_.GetProgramShape());
-  hash_ = xla::util::MHash(name_, computation_.proto().SerializeAsString());
+  hash_ = xla::util::MHash(name_, ComputeStructuralHash(computation_.proto()));
+}
+
+ComputationPtr RegisterComputation(ComputationPtr computation) {
+  return ComputationRegistry::Get()->Register(std::move(computation));
 }
 
 }  // namespace torch_xla
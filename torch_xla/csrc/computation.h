@@ -30,4 +30,11 @@ class Computation {
 
 using ComputationPtr = std::shared_ptr<Computation>;
 
+// Returns the registered computation with the same name and structure (the
+// HLO modules only differing in their unique names and IDs) of the given one,
+// or registers the given one if there is none. The users of the same
+// registered computation share its node hash, and the single copy of it which
+// gets embedded in the lowered graph.
+ComputationPtr RegisterComputation(ComputationPtr computation);
+
 }  // namespace torch_xla
@@ -0,0 +1,168 @@
+#include "torch_xla/csrc/conv_bn_folding.h"
+
+#include <ATen/core/grad_mode.h>
+
+#include "tensorflow/compiler/xla/xla_client/cache.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "torch_xla/csrc/ops/convolution_overrideable.h"
+#include "torch_xla/csrc/ops/device_data.h"
+
+namespace torch_xla {
+namespace {
+
+struct FoldedConvParams {
+  xla::ComputationClient::DataPtr weight;
+  xla::ComputationClient::DataPtr bias;
+};
+
+using FoldedConvParamsCache =
+    xla::util::Cache<xla::hash_t, FoldedConvParams, xla::util::HashReducer>;
+
+FoldedConvParamsCache* GetFoldedConvParamsCache() {
+  static const size_t kMaxCacheSize =
+      xla::sys_util::GetEnvInt("XLA_CONV_BN_FOLD_CACHE_SIZE", 256);
+  static FoldedConvParamsCache* cache =
+      new FoldedConvParamsCache(kMaxCacheSize);
+  return cache;
+}
+
+xla::ComputationClient::DataPtr GetNodeData(const ir::Node* node) {
+  ir::ops::DeviceData* device_data = ir::ops::DeviceData::Cast(node);
+  if (device_data == nullptr || !device_data->data()->HasValue()) {
+    return nullptr;
+  }
+  return device_data->data();
+}
+
+// Optional parameters can be missing, but not hold pending IR computations.
+bool GetTensorData(const XLATensor& tensor,
+                   xla::ComputationClient::DataPtr* data) {
+  if (!tensor.is_null()) {
+    *data = GetNodeData(tensor.GetIrValue().node.get());
+    return *data != nullptr;
+  }
+  return true;
+}
+
+// Device data handles are never reused, so they identify the parameters
+// generation.
+xla::hash_t GetFoldingHash(
+    absl::Span<const xla::ComputationClient::DataPtr> datas, double eps) {
+  xla::hash_t hash = xla::util::MHash(eps);
+  for (auto& data : datas) {
+    hash = xla::util::HashCombine(
+        hash, xla::util::MHash(data != nullptr
+                                   ? static_cast<xla::int64>(
+                                         data->GetOpaqueHandle())
+                                   : -1));
+  }
+  return hash;
+}
+
+std::shared_ptr<FoldedConvParams> ComputeFoldedConvParams(
+    const XLATensor& conv_weight, const XLATensor& conv_bias,
+    const XLATensor& weight, const XLATensor& bias,
+    const XLATensor& running_mean, const XLATensor& running_var, double eps) {
+  XLA_COUNTER("ConvBatchNormFold", 1);
+  // scale = weight / sqrt(running_var + eps)
+  // W' = W * scale (over the output channels)
+  // b' = (b - running_mean) * scale + bias
+  XLATensor scale = XLATensor::rsqrt(XLATensor::add(running_var, eps, 1));
+  if (!weight.is_null()) {
+    scale = XLATensor::mul(scale, weight);
+  }
+  xla::util::MaybeRef<xla::Shape> conv_weight_shape = conv_weight.shape();
+  std::vector<xla::int64> scale_sizes(conv_weight_shape.get().rank(), 1);
+  scale_sizes[0] = conv_weight_shape.get().dimensions(0);
+  XLATensor folded_weight =
+      XLATensor::mul(conv_weight, XLATensor::view(scale, scale_sizes));
+  XLATensor folded_bias =
+      conv_bias.is_null()
+          ? XLATensor::mul(XLATensor::neg(running_mean), scale)
+          : XLATensor::mul(XLATensor::sub(conv_bias, running_mean, 1), scale);
+  if (!bias.is_null()) {
+    folded_bias = XLATensor::add(folded_bias, bias, 1);
+  }
+  std::vector<XLATensor> tensors = {folded_weight, folded_bias};
+  XLATensor::SyncTensorsGraph(&tensors, /*devices=*/{}, /*wait=*/true,
+                              /*sync_xla_data=*/false);
+  auto folded = std::make_shared<FoldedConvParams>();
+  folded->weight = tensors[0].GetXlaData();
+  folded->bias = tensors[1].GetXlaData();
+  return folded;
+}
+
+}  // namespace
+
+XLATensor TryFoldConvBatchNorm(const XLATensor& input, const XLATensor& weight,
+                               const XLATensor& bias,
+                               const XLATensor& running_mean,
+                               const XLATensor& running_var, double eps) {
+  static const bool kFoldConvBatchNorm =
+      xla::sys_util::GetEnvBool("XLA_FOLD_CONV_BN", true);
+  if (!kFoldConvBatchNorm || at::GradMode::is_enabled() ||
+      running_mean.is_null() || running_var.is_null()) {
+    return XLATensor();
+  }
+  ir::Value input_value = input.CurrentIrValue();
+  if (!input_value) {
+    return XLATensor();
+  }
+  ir::ops::ConvolutionOverrideable* conv =
+      ir::NodeCast<ir::ops::ConvolutionOverrideable>(
+          input_value.node.get(),
+          ir::OpKind(at::aten::convolution_overrideable));
+  if (conv == nullptr || conv->transposed()) {
+    return XLATensor();
+  }
+  xla::ComputationClient::DataPtr conv_weight_data =
+      GetNodeData(conv->operand(1).node);
+  xla::ComputationClient::DataPtr conv_bias_data;
+  if (conv->operands().size() > 2) {
+    conv_bias_data = GetNodeData(conv->operand(2).node);
+    if (conv_bias_data == nullptr) {
+      return XLATensor();
+    }
+  }
+  xla::ComputationClient::DataPtr weight_data;
+  xla::ComputationClient::DataPtr bias_data;
+  xla::ComputationClient::DataPtr running_mean_data;
+  xla::ComputationClient::DataPtr running_var_data;
+  if (conv_weight_data == nullptr || !GetTensorData(weight, &weight_data) ||
+      !GetTensorData(bias, &bias_data) ||
+      !GetTensorData(running_mean, &running_mean_data) ||
+      !GetTensorData(running_var, &running_var_data)) {
+    return XLATensor();
+  }
+
+  std::vector<xla::ComputationClient::DataPtr> datas = {
+      conv_weight_data, conv_bias_data,    weight_data,
+      bias_data,        running_mean_data, running_var_data};
+  xla::hash_t hash = GetFoldingHash(datas, eps);
+  std::shared_ptr<FoldedConvParams> folded =
+      GetFoldedConvParamsCache()->Get(hash);
+  if (folded == nullptr) {
+    at::ScalarType conv_type = input.dtype();
+    XLATensor conv_bias;
+    if (conv_bias_data != nullptr) {
+      conv_bias = XLATensor::Create(conv_bias_data, conv_type);
+    }
+    folded = ComputeFoldedConvParams(
+        XLATensor::Create(conv_weight_data, conv_type), conv_bias, weight,
+        bias, running_mean, running_var, eps);
+    GetFoldedConvParamsCache()->Add(hash, folded);
+  } else {
+    XLA_COUNTER("ConvBatchNormFoldCacheHit", 1);
+  }
+  ir::NodePtr node = ir::MakeNode<ir::ops::ConvolutionOverrideable>(
+      ir::Value(conv->operand_node(0), conv->operand(0).index),
+      ir::MakeNode<ir::ops::DeviceData>(folded->weight),
+      ir::MakeNode<ir::ops::DeviceData>(folded->bias), conv->stride(),
+      conv->padding(), conv->dilation(), conv->transposed(),
+      conv->output_padding(), conv->groups());
+  return input.CreateFrom(ir::Value(node));
+}
+
+}  // namespace torch_xla
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "torch_xla/csrc/tensor.h"
+
+namespace torch_xla {
+
+// Folds an inference mode batch norm over the output of a convolution, into
+// the convolution weight and bias. This only happens when all the parameters
+// are device data, and autograd is off. The folded parameters are computed on
+// device once per parameters generation (a new generation starts whenever any
+// of the parameters gets assigned new device data), and cached.
+// Returns the output of the folded convolution, or a null tensor if the
+// pattern does not apply.
+XLATensor TryFoldConvBatchNorm(const XLATensor& input, const XLATensor& weight,
+                               const XLATensor& bias,
+                               const XLATensor& running_mean,
+                               const XLATensor& running_var, double eps);
+
+}  // namespace torch_xla
@@ -0,0 +1,245 @@
+#include "torch_xla/csrc/convert_kernels.h"
+
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace torch_xla {
+namespace kernels {
+namespace {
+
+static const uint32_t kBFloat16NaN = 0x7fc0;
+
+uint16_t FloatBitsToBFloat16Bits(uint32_t bits) {
+  if ((bits & 0x7fffffff) > 0x7f800000) {
+    return kBFloat16NaN;
+  }
+  uint32_t lsb = (bits >> 16) & 1;
+  return static_cast<uint16_t>((bits + 0x7fff + lsb) >> 16);
+}
+
+// The bfloat16 types are 16 bits wrappers of the upper half of a float, so the
+// kernels below operate on their bit representation.
+void ScalarFloatToBFloat16(const float* src, uint16_t* dest, xla::int64 n) {
+  for (xla::int64 i = 0; i < n; ++i) {
+    uint32_t bits;
+    std::memcpy(&bits, src + i, sizeof(bits));
+    dest[i] = FloatBitsToBFloat16Bits(bits);
+  }
+}
+
+void ScalarBFloat16ToFloat(const uint16_t* src, float* dest, xla::int64 n) {
+  for (xla::int64 i = 0; i < n; ++i) {
+    uint32_t bits = static_cast<uint32_t>(src[i]) << 16;
+    std::memcpy(dest + i, &bits, sizeof(bits));
+  }
+}
+
+void ScalarUInt8ToFloat(const uint8_t* src, float* dest, xla::int64 n) {
+  for (xla::int64 i = 0; i < n; ++i) {
+    dest[i] = static_cast<float>(src[i]);
+  }
+}
+
+#if defined(__x86_64__)
+
+__attribute__((target("avx2"))) void Avx2FloatToBFloat16(const float* src,
+                                                         uint16_t* dest,
+                                                         xla::int64 n) {
+  const __m256i bias = _mm256_set1_epi32(0x7fff);
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i nan = _mm256_set1_epi32(kBFloat16NaN);
+  xla::int64 i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 values = _mm256_loadu_ps(src + i);
+    __m256i bits = _mm256_castps_si256(values);
+    __m256i lsb = _mm256_and_si256(_mm256_srli_epi32(bits, 16), one);
+    __m256i rounded = _mm256_srli_epi32(
+        _mm256_add_epi32(bits, _mm256_add_epi32(bias, lsb)), 16);
+    __m256i is_nan =
+        _mm256_castps_si256(_mm256_cmp_ps(values, values, _CMP_UNORD_Q));
+    rounded = _mm256_blendv_epi8(rounded, nan, is_nan);
+    // The pack works within 128 bit lanes, so the 64 bit quarters need to be
+    // put back in order.
+    __m256i packed = _mm256_permute4x64_epi64(
+        _mm256_packus_epi32(rounded, _mm256_setzero_si256()), 0xd8);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i),
+                     _mm256_castsi256_si128(packed));
+  }
+  ScalarFloatToBFloat16(src + i, dest + i, n - i);
+}
+
+__attribute__((target("avx2"))) void Avx2BFloat16ToFloat(const uint16_t* src,
+                                                         float* dest,
+                                                         xla::int64 n) {
+  xla::int64 i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    __m256i bits = _mm256_slli_epi32(_mm256_cvtepu16_epi32(values), 16);
+    _mm256_storeu_ps(dest + i, _mm256_castsi256_ps(bits));
+  }
+  ScalarBFloat16ToFloat(src + i, dest + i, n - i);
+}
+
+__attribute__((target("avx2"))) void Avx2UInt8ToFloat(const uint8_t* src,
+                                                      float* dest,
+                                                      xla::int64 n) {
+  xla::int64 i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i values = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i));
+    _mm256_storeu_ps(dest + i,
+                     _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(values)));
+  }
+  ScalarUInt8ToFloat(src + i, dest + i, n - i);
+}
+
+__attribute__((target("avx512f"))) void Avx512FloatToBFloat16(
+    const float* src, uint16_t* dest, xla::int64 n) {
+  const __m512i bias = _mm512_set1_epi32(0x7fff);
+  const __m512i one = _mm512_set1_epi32(1);
+  const __m512i nan = _mm512_set1_epi32(kBFloat16NaN);
+  xla::int64 i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m512 values = _mm512_loadu_ps(src + i);
+    __m512i bits = _mm512_castps_si512(values);
+    __m512i lsb = _mm512_and_si512(_mm512_srli_epi32(bits, 16), one);
+    __m512i rounded = _mm512_srli_epi32(
+        _mm512_add_epi32(bits, _mm512_add_epi32(bias, lsb)), 16);
+    __mmask16 is_nan = _mm512_cmp_ps_mask(values, values, _CMP_UNORD_Q);
+    rounded = _mm512_mask_mov_epi32(rounded, is_nan, nan);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i),
+                        _mm512_cvtepi32_epi16(rounded));
+  }
+  Avx2FloatToBFloat16(src + i, dest + i, n - i);
+}
+
+__attribute__((target("avx512f"))) void Avx512BFloat16ToFloat(
+    const uint16_t* src, float* dest, xla::int64 n) {
+  xla::int64 i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m256i values =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    __m512i bits = _mm512_slli_epi32(_mm512_cvtepu16_epi32(values), 16);
+    _mm512_storeu_ps(dest + i, _mm512_castsi512_ps(bits));
+  }
+  Avx2BFloat16ToFloat(src + i, dest + i, n - i);
+}
+
+__attribute__((target("avx512f"))) void Avx512UInt8ToFloat(const uint8_t* src,
+                                                           float* dest,
+                                                           xla::int64 n) {
+  xla::int64 i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    _mm512_storeu_ps(dest + i,
+                     _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(values)));
+  }
+  Avx2UInt8ToFloat(src + i, dest + i, n - i);
+}
+
+#elif defined(__aarch64__)
+
+void NeonFloatToBFloat16(const float* src, uint16_t* dest, xla::int64 n) {
+  const uint32x4_t bias = vdupq_n_u32(0x7fff);
+  const uint32x4_t one = vdupq_n_u32(1);
+  const uint32x4_t nan = vdupq_n_u32(kBFloat16NaN);
+  xla::int64 i = 0;
+  for (; i + 4 <= n; i += 4) {
+    float32x4_t values = vld1q_f32(src + i);
+    uint32x4_t bits = vreinterpretq_u32_f32(values);
+    uint32x4_t lsb = vandq_u32(vshrq_n_u32(bits, 16), one);
+    uint32x4_t rounded =
+        vshrq_n_u32(vaddq_u32(bits, vaddq_u32(bias, lsb)), 16);
+    uint32x4_t is_number = vceqq_f32(values, values);
+    rounded = vbslq_u32(is_number, rounded, nan);
+    vst1_u16(dest + i, vmovn_u32(rounded));
+  }
+  ScalarFloatToBFloat16(src + i, dest + i, n - i);
+}
+
+void NeonBFloat16ToFloat(const uint16_t* src, float* dest, xla::int64 n) {
+  xla::int64 i = 0;
+  for (; i + 4 <= n; i += 4) {
+    uint32x4_t bits = vshll_n_u16(vld1_u16(src + i), 16);
+    vst1q_f32(dest + i, vreinterpretq_f32_u32(bits));
+  }
+  ScalarBFloat16ToFloat(src + i, dest + i, n - i);
+}
+
+void NeonUInt8ToFloat(const uint8_t* src, float* dest, xla::int64 n) {
+  xla::int64 i = 0;
+  for (; i + 8 <= n; i += 8) {
+    uint16x8_t values = vmovl_u8(vld1_u8(src + i));
+    vst1q_f32(dest + i, vcvtq_f32_u32(vmovl_u16(vget_low_u16(values))));
+    vst1q_f32(dest + i + 4, vcvtq_f32_u32(vmovl_u16(vget_high_u16(values))));
+  }
+  ScalarUInt8ToFloat(src + i, dest + i, n - i);
+}
+
+#endif
+
+struct Kernels {
+  const char* isa = "scalar";
+  void (*float_to_bf16)(const float*, uint16_t*, xla::int64) =
+      ScalarFloatToBFloat16;
+  void (*bf16_to_float)(const uint16_t*, float*, xla::int64) =
+      ScalarBFloat16ToFloat;
+  void (*uint8_to_float)(const uint8_t*, float*, xla::int64) =
+      ScalarUInt8ToFloat;
+};
+
+Kernels SelectKernels() {
+  Kernels kernels;
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    kernels.isa = "avx512f";
+    kernels.float_to_bf16 = Avx512FloatToBFloat16;
+    kernels.bf16_to_float = Avx512BFloat16ToFloat;
+    kernels.uint8_to_float = Avx512UInt8ToFloat;
+  } else if (__builtin_cpu_supports("avx2")) {
+    kernels.isa = "avx2";
+    kernels.float_to_bf16 = Avx2FloatToBFloat16;
+    kernels.bf16_to_float = Avx2BFloat16ToFloat;
+    kernels.uint8_to_float = Avx2UInt8ToFloat;
+  }
+#elif defined(__aarch64__)
+  kernels.isa = "neon";
+  kernels.float_to_bf16 = NeonFloatToBFloat16;
+  kernels.bf16_to_float = NeonBFloat16ToFloat;
+  kernels.uint8_to_float = NeonUInt8ToFloat;
+#endif
+  return kernels;
+}
+
+const Kernels& GetKernels() {
+  static const Kernels kernels = SelectKernels();
+  return kernels;
+}
+
+}  // namespace
+
+void ConvertFloatToBFloat16(const float* src, xla::bfloat16* dest,
+                            xla::int64 n) {
+  static_assert(sizeof(xla::bfloat16) == sizeof(uint16_t),
+                "Unexpected bfloat16 size");
+  GetKernels().float_to_bf16(src, reinterpret_cast<uint16_t*>(dest), n);
+}
+
+void ConvertBFloat16ToFloat(const xla::bfloat16* src, float* dest,
+                            xla::int64 n) {
+  GetKernels().bf16_to_float(reinterpret_cast<const uint16_t*>(src), dest, n);
+}
+
+void ConvertUInt8ToFloat(const uint8_t* src, float* dest, xla::int64 n) {
+  GetKernels().uint8_to_float(src, dest, n);
+}
+
+const char* GetKernelsIsa() { return GetKernels().isa; }
+
+}  // namespace kernels
+}  // namespace torch_xla
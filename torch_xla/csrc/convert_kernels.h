@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+#include "tensorflow/compiler/xla/types.h"
+
+namespace torch_xla {
+namespace kernels {
+
+// Bulk element conversion kernels used by the host <-> device tensor copies.
+// The implementation is selected at runtime, according to the SIMD extensions
+// supported by the host CPU (AVX-512, AVX2, NEON), with a scalar fallback. The
+// results are bit-identical to the ones of the scalar element casts.
+
+// Rounds to nearest even, and maps all NaNs to the canonical bfloat16 NaN.
+void ConvertFloatToBFloat16(const float* src, xla::bfloat16* dest,
+                            xla::int64 n);
+
+void ConvertBFloat16ToFloat(const xla::bfloat16* src, float* dest,
+                            xla::int64 n);
+
+void ConvertUInt8ToFloat(const uint8_t* src, float* dest, xla::int64 n);
+
+// Returns the name of the SIMD extension the kernels dispatch to.
+const char* GetKernelsIsa();
+
+}  // namespace kernels
+}  // namespace torch_xla
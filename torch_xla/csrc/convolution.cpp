@@ -3,6 +3,7 @@
 #include "tensorflow/compiler/tf2xla/kernels/conv_op_helpers.h"
 #include "tensorflow/compiler/xla/client/lib/constants.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/kernels/conv_grad_ops.h"
 #include "third_party/xla_client/debug_macros.h"
@@ -95,9 +96,29 @@ namespace {
  *   - filter: [N, Hout, Wout, Cout] // func: FilterTransposePermutation
  *          => [Hout, Wout, Cout, N] // swap batch & channel dimension
  *          => [Hout, Wout, N, Cout]
+ *
+ * The transposes above are not free, and the grouped weight gradient built by
+ * the wrappers is a single convolution whose window spans the whole output.
+ * For G > 1 (unless XLA_GROUPED_CONV_BACKWARD_REWRITE is false) the weight
+ * gradient is instead lowered as a single ConvGeneralDilated with
+ * batch_group_count = G, which needs no transpose at all:
+ *   - lhs: input [N, Cin, Hin, Win], with Cin as batch and N as feature
+ *   - rhs: grad_output [N, Cout, Hout, Wout], with N as input feature
+ *   - output: [Cout, Cin / G, Hker, Wker], with Cin / G as batch
+ * Pointwise (1x1 kernel, unit stride, no padding) grouped convolutions are
+ * G independent matrix multiplications, so when the per group matrices are
+ * large enough to be worth it, both gradients are lowered as batched dots:
+ *   - grad_output: [N, Cout, H, W] => [N, G, Cout / G, H * W]
+ *   - weight: [Cout, Cin / G, 1, 1] => [G, Cout / G, Cin / G]
+ *   - input: [N, Cin, H, W] => [N, G, Cin / G, H * W]
  */
 // clang-format on
 
+// The minimum per group channel count for which the pointwise grouped
+// convolution gradients are lowered as batched matrix multiplications. Smaller
+// matrices do not fill the matrix units, and the convolution is as good.
+constexpr xla::int64 kMinGroupMatMulChannels = 8;
+
 // Create a TF convolution metadata structure out of PyTorch convolution
 // attributes.
 tensorflow::ConvOpAttrs MakeConvOpAttrs(
@@ -230,6 +251,125 @@ xla::XlaOp BuildConvBackwardWeight(
   return xla::Transpose(conv, inv_transpose_permutation);
 }
 
+bool UseGroupedBackwardRewrite(xla::int64 groups) {
+  static const bool rewrite =
+      xla::sys_util::GetEnvBool("XLA_GROUPED_CONV_BACKWARD_REWRITE", true);
+  return rewrite && groups > 1;
+}
+
+// Whether the grouped convolution is a batch of large enough matrix
+// multiplications, with the groups as batch dimension.
+bool IsGroupMatMul(const xla::Shape& kernel_shape,
+                   absl::Span<const xla::int64> spatial_stride,
+                   absl::Span<const xla::int64> spatial_padding,
+                   xla::int64 groups) {
+  for (size_t i = 0; i < spatial_stride.size(); ++i) {
+    if (kernel_shape.dimensions(2 + i) != 1 || spatial_stride[i] != 1 ||
+        spatial_padding[i] != 0) {
+      return false;
+    }
+  }
+  return kernel_shape.dimensions(1) >= kMinGroupMatMulChannels &&
+         kernel_shape.dimensions(0) / groups >= kMinGroupMatMulChannels;
+}
+
+// Reshapes a [N, C, spatial...] tensor to [N, G, C / G, prod(spatial)].
+xla::XlaOp SplitGroups(xla::XlaOp input, xla::int64 groups) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(input);
+  return XlaHelpers::DynamicReshape(
+      input, {shape.dimensions(0), groups, shape.dimensions(1) / groups,
+              xla::ShapeUtil::ElementsIn(shape) /
+                  (shape.dimensions(0) * shape.dimensions(1))});
+}
+
+// Computes the input gradient of a pointwise grouped convolution.
+xla::XlaOp BuildGroupMatMulBackwardInput(xla::XlaOp grad_output,
+                                         xla::XlaOp kernel,
+                                         const xla::Shape& input_shape,
+                                         xla::int64 groups) {
+  const xla::Shape& kernel_shape = XlaHelpers::ShapeOfXlaOp(kernel);
+  xla::XlaOp grouped_kernel = XlaHelpers::DynamicReshape(
+      kernel, {groups, kernel_shape.dimensions(0) / groups,
+               kernel_shape.dimensions(1)});
+  // [G, Cout / G, Cin / G] x [N, G, Cout / G, HW] => [G, Cin / G, N, HW]
+  xla::DotDimensionNumbers dims;
+  dims.add_lhs_batch_dimensions(0);
+  dims.add_rhs_batch_dimensions(1);
+  dims.add_lhs_contracting_dimensions(1);
+  dims.add_rhs_contracting_dimensions(2);
+  xla::PrecisionConfig precision_config =
+      XlaHelpers::BuildPrecisionConfig(XlaHelpers::mat_mul_precision());
+  xla::XlaOp grad = xla::DotGeneral(
+      grouped_kernel, SplitGroups(grad_output, groups), dims,
+      &precision_config);
+  return XlaHelpers::DynamicReshape(xla::Transpose(grad, {2, 0, 1, 3}),
+                                    input_shape.dimensions());
+}
+
+// Computes the kernel gradient of a pointwise grouped convolution.
+xla::XlaOp BuildGroupMatMulBackwardWeight(xla::XlaOp grad_output,
+                                          xla::XlaOp input,
+                                          const xla::Shape& kernel_shape,
+                                          xla::int64 groups) {
+  // [N, G, Cout / G, HW] x [N, G, Cin / G, HW] => [G, Cout / G, Cin / G]
+  xla::DotDimensionNumbers dims;
+  dims.add_lhs_batch_dimensions(1);
+  dims.add_rhs_batch_dimensions(1);
+  dims.add_lhs_contracting_dimensions(0);
+  dims.add_lhs_contracting_dimensions(3);
+  dims.add_rhs_contracting_dimensions(0);
+  dims.add_rhs_contracting_dimensions(3);
+  xla::PrecisionConfig precision_config =
+      XlaHelpers::BuildPrecisionConfig(XlaHelpers::mat_mul_precision());
+  xla::XlaOp grad = xla::DotGeneral(SplitGroups(grad_output, groups),
+                                    SplitGroups(input, groups), dims,
+                                    &precision_config);
+  return XlaHelpers::DynamicReshape(grad, kernel_shape.dimensions());
+}
+
+// Computes the kernel gradient of a grouped convolution as a single
+// convolution with batch_group_count = groups.
+xla::XlaOp BuildGroupedConvBackwardWeight(
+    xla::XlaOp grad_output, xla::XlaOp input, const xla::Shape& kernel_shape,
+    absl::Span<const xla::int64> spatial_stride,
+    absl::Span<const xla::int64> spatial_padding,
+    absl::Span<const xla::int64> spatial_dilation, xla::int64 groups) {
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  const xla::Shape& grad_output_shape = XlaHelpers::ShapeOfXlaOp(grad_output);
+  xla::ConvolutionDimensionNumbers dimension_numbers;
+  dimension_numbers.set_input_batch_dimension(1);
+  dimension_numbers.set_input_feature_dimension(0);
+  dimension_numbers.set_kernel_input_feature_dimension(0);
+  dimension_numbers.set_kernel_output_feature_dimension(1);
+  dimension_numbers.set_output_batch_dimension(1);
+  dimension_numbers.set_output_feature_dimension(0);
+  std::vector<std::pair<xla::int64, xla::int64>> dims_padding;
+  for (size_t i = 0; i < spatial_stride.size(); ++i) {
+    dimension_numbers.add_input_spatial_dimensions(2 + i);
+    dimension_numbers.add_kernel_spatial_dimensions(2 + i);
+    dimension_numbers.add_output_spatial_dimensions(2 + i);
+    // The grad_output is the window, dilated by the forward stride, and slides
+    // over the input by the forward dilation. The high padding is whatever
+    // makes the result as large as the kernel, and can be negative when the
+    // forward convolution dropped trailing input elements.
+    xla::int64 window_size =
+        (grad_output_shape.dimensions(2 + i) - 1) * spatial_stride[i] + 1;
+    xla::int64 padded_size =
+        (kernel_shape.dimensions(2 + i) - 1) * spatial_dilation[i] +
+        window_size;
+    dims_padding.emplace_back(spatial_padding[i],
+                              padded_size - input_shape.dimensions(2 + i) -
+                                  spatial_padding[i]);
+  }
+  xla::PrecisionConfig precision_config =
+      XlaHelpers::BuildPrecisionConfig(XlaHelpers::mat_mul_precision());
+  return xla::ConvGeneralDilated(
+      input, grad_output, /*window_strides=*/spatial_dilation, dims_padding,
+      /*lhs_dilation=*/{}, /*rhs_dilation=*/spatial_stride, dimension_numbers,
+      /*feature_group_count=*/1, /*batch_group_count=*/groups,
+      &precision_config);
+}
+
 xla::XlaOp BuildGradBias(xla::XlaOp grad_output) {
   const xla::Shape& grad_output_shape = XlaHelpers::ShapeOfXlaOp(grad_output);
   // The bias contribution is linear in each output feature. Reduce the
@@ -325,6 +465,41 @@ xla::XlaOp BuildConvolutionOverrideableBias(
   return conv + bias_broadcast;
 }
 
+xla::XlaOp BuildConvolutionChannelsLast(
+    xla::XlaOp input, xla::XlaOp kernel, const xla::XlaOp* bias,
+    absl::Span<const xla::int64> stride, absl::Span<const xla::int64> padding,
+    absl::Span<const xla::int64> dilation, xla::int64 groups) {
+  xla::int64 num_spatial = stride.size();
+  xla::ConvolutionDimensionNumbers dimension_numbers;
+  dimension_numbers.set_input_batch_dimension(0);
+  dimension_numbers.set_input_feature_dimension(num_spatial + 1);
+  dimension_numbers.set_kernel_output_feature_dimension(0);
+  dimension_numbers.set_kernel_input_feature_dimension(1);
+  dimension_numbers.set_output_batch_dimension(0);
+  dimension_numbers.set_output_feature_dimension(num_spatial + 1);
+  for (xla::int64 i = 0; i < num_spatial; ++i) {
+    dimension_numbers.add_input_spatial_dimensions(1 + i);
+    dimension_numbers.add_kernel_spatial_dimensions(2 + i);
+    dimension_numbers.add_output_spatial_dimensions(1 + i);
+  }
+  xla::PrecisionConfig precision_config =
+      XlaHelpers::BuildPrecisionConfig(XlaHelpers::mat_mul_precision());
+  xla::XlaOp conv = xla::ConvGeneralDilated(
+      input, kernel, stride, MakePadding(padding),
+      /*lhs_dilation*/ {},
+      /*rhs_dilation*/ dilation, dimension_numbers,
+      /*feature_group_count*/ groups,
+      /*batch_group_count=*/1, &precision_config);
+  if (bias == nullptr) {
+    return conv;
+  }
+  // The channels are the minor dimension, so the bias broadcast needs no
+  // transpose.
+  auto conv_sizes = XlaHelpers::SizesOfXlaOp(conv);
+  return conv + xla::BroadcastInDim(*bias, conv_sizes,
+                                    {static_cast<xla::int64>(num_spatial + 1)});
+}
+
 ConvGrads BuildConvolutionBackwardOverrideable(
     xla::XlaOp grad_output, xla::XlaOp input, xla::XlaOp kernel,
     absl::Span<const xla::int64> stride, absl::Span<const xla::int64> padding,
@@ -335,12 +510,27 @@ ConvGrads BuildConvolutionBackwardOverrideable(
                                               stride, padding, dilation,
                                               output_padding, groups);
   } else {
-    xla::XlaOp grad_input = BuildConvBackwardInput(
-        grad_output, kernel, XlaHelpers::ShapeOfXlaOp(input), stride, padding,
-        dilation, groups);
-    xla::XlaOp grad_weight = BuildConvBackwardWeight(
-        grad_output, input, XlaHelpers::ShapeOfXlaOp(kernel), stride, padding,
-        dilation, groups);
+    const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+    const xla::Shape& kernel_shape = XlaHelpers::ShapeOfXlaOp(kernel);
+    xla::XlaOp grad_input;
+    xla::XlaOp grad_weight;
+    if (UseGroupedBackwardRewrite(groups) &&
+        IsGroupMatMul(kernel_shape, stride, padding, groups)) {
+      grad_input = BuildGroupMatMulBackwardInput(grad_output, kernel,
+                                                 input_shape, groups);
+      grad_weight = BuildGroupMatMulBackwardWeight(grad_output, input,
+                                                   kernel_shape, groups);
+    } else {
+      grad_input = BuildConvBackwardInput(grad_output, kernel, input_shape,
+                                          stride, padding, dilation, groups);
+      grad_weight =
+          UseGroupedBackwardRewrite(groups)
+              ? BuildGroupedConvBackwardWeight(grad_output, input,
+                                               kernel_shape, stride, padding,
+                                               dilation, groups)
+              : BuildConvBackwardWeight(grad_output, input, kernel_shape,
+                                        stride, padding, dilation, groups);
+    }
     xla::XlaOp grad_bias = BuildGradBias(grad_output);
     return {grad_input, grad_weight, grad_bias};
   }
@@ -20,6 +20,14 @@ xla::XlaOp BuildConvolutionOverrideableBias(
     absl::Span<const xla::int64> dilation, bool transposed,
     absl::Span<const xla::int64> output_padding, xla::int64 groups);
 
+// Computes a non transposed convolution, with input and result in
+// channels-last (NHWC) layout, while the kernel keeps the PyTorch layout. The
+// bias is optional.
+xla::XlaOp BuildConvolutionChannelsLast(
+    xla::XlaOp input, xla::XlaOp kernel, const xla::XlaOp* bias,
+    absl::Span<const xla::int64> stride, absl::Span<const xla::int64> padding,
+    absl::Span<const xla::int64> dilation, xla::int64 groups);
+
 struct ConvGrads {
   xla::XlaOp grad_input;
   xla::XlaOp grad_weight;
@@ -2,8 +2,12 @@
 
 #include <map>
 
+#include "absl/types/optional.h"
 #include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
 #include "torch_xla/csrc/convert_ops.h"
 #include "torch_xla/csrc/device.h"
@@ -52,6 +56,7 @@ xla::XlaComputation GetReduceComutation(AllReduceType reduce_type,
                                         xla::PrimitiveType type) {
   switch (reduce_type) {
     case AllReduceType::kSum:
+    case AllReduceType::kSumBf16:
       return XlaHelpers::CreateAddComputation(type);
     case AllReduceType::kMul:
       return XlaHelpers::CreateMulComputation(type);
@@ -81,43 +86,323 @@ std::vector<xla::ReplicaGroup> CreateReduceGroups(
   return reduce_groups;
 }
 
+// The replicas of a multi host mesh, which flat all-reduce operations can
+// reduce in steps within and across the hosts.
+struct ReplicaTopology {
+  // The replicas of each host.
+  std::vector<xla::ReplicaGroup> host_groups;
+  // The replicas with the same index within their host group.
+  std::vector<xla::ReplicaGroup> cross_host_groups;
+  // The index of every replica within its host group.
+  std::vector<xla::int32> local_indices;
+  xla::int64 local_count = 0;
+};
+
+absl::optional<ReplicaTopology> GetReplicaTopology(
+    AllReduceType reduce_type,
+    const std::vector<std::vector<xla::int64>>& groups) {
+  static const bool hierarchical =
+      xla::sys_util::GetEnvBool("XLA_HIERARCHICAL_ALL_REDUCE", false);
+  if (!hierarchical || reduce_type != AllReduceType::kSum || !groups.empty()) {
+    return absl::nullopt;
+  }
+  std::vector<xla::int64> hosts =
+      xla::ComputationClient::Get()->GetReplicationDevicesHosts();
+  std::vector<std::vector<xla::int64>> host_replicas;
+  for (size_t i = 0; i < hosts.size(); ++i) {
+    if (static_cast<size_t>(hosts[i]) >= host_replicas.size()) {
+      host_replicas.resize(hosts[i] + 1);
+    }
+    host_replicas[hosts[i]].push_back(i);
+  }
+  // Only meshes with at least two hosts, with the same number of (more than
+  // one) replicas each, benefit from the hierarchical reduction.
+  if (host_replicas.size() < 2 || host_replicas.front().size() < 2) {
+    return absl::nullopt;
+  }
+  ReplicaTopology topology;
+  topology.local_count = host_replicas.front().size();
+  topology.local_indices.resize(hosts.size());
+  for (auto& replicas : host_replicas) {
+    if (static_cast<xla::int64>(replicas.size()) != topology.local_count) {
+      return absl::nullopt;
+    }
+    for (size_t i = 0; i < replicas.size(); ++i) {
+      topology.local_indices[replicas[i]] = i;
+    }
+  }
+  topology.host_groups = CreateReduceGroups(host_replicas);
+  std::vector<std::vector<xla::int64>> cross_host_replicas(
+      topology.local_count);
+  for (auto& replicas : host_replicas) {
+    for (size_t i = 0; i < replicas.size(); ++i) {
+      cross_host_replicas[i].push_back(replicas[i]);
+    }
+  }
+  topology.cross_host_groups = CreateReduceGroups(cross_host_replicas);
+  return topology;
+}
+
+// Sums the operands of a single type, flattened in a single vector, first
+// within each host, then across the hosts on the 1/local_count shard owned by
+// each replica, and finally gathers the shards within each host. The amount of
+// data moved across the hosts is local_count times smaller than the one of a
+// flat all-reduce. The gather step is an all-reduce of the zero padded shards,
+// as it only moves data within the hosts. Returns the chained token.
+xla::XlaOp BuildHierarchicalTypeAllReduce(xla::PrimitiveType type,
+                                          PerTypeContext* ctx,
+                                          xla::XlaOp token, double scale,
+                                          const ReplicaTopology& topology,
+                                          std::vector<xla::XlaOp>* result) {
+  xla::XlaBuilder* builder = token.builder();
+  xla::XlaOp token_op = MaybeConvertTo(token, type);
+  ctx->ops.push_back(token_op);
+  ctx->operand_shapes.push_back(XlaHelpers::ShapeOfXlaOp(token_op));
+
+  std::vector<xla::XlaOp> flat_ops;
+  std::vector<xla::int64> offsets;
+  xla::int64 size = 0;
+  for (size_t i = 0; i < ctx->ops.size(); ++i) {
+    xla::int64 elements = xla::ShapeUtil::ElementsIn(ctx->operand_shapes[i]);
+    flat_ops.push_back(xla::Reshape(ctx->ops[i], {elements}));
+    offsets.push_back(size);
+    size += elements;
+  }
+  xla::int64 shard_size =
+      (size + topology.local_count - 1) / topology.local_count;
+  xla::int64 padded_size = shard_size * topology.local_count;
+  xla::XlaOp zero = xla::Zero(builder, type);
+  if (padded_size > size) {
+    flat_ops.push_back(xla::Broadcast(zero, {padded_size - size}));
+  }
+  xla::XlaComputation add = XlaHelpers::CreateAddComputation(type);
+  xla::XlaOp host_sum = xla::AllReduce(xla::ConcatInDim(builder, flat_ops, 0),
+                                       add, topology.host_groups);
+
+  xla::XlaOp replica_id =
+      xla::ConvertElementType(xla::ReplicaId(builder), xla::PrimitiveType::S32);
+  xla::XlaOp local_index = xla::Reshape(
+      xla::DynamicSlice(xla::ConstantR1<xla::int32>(builder,
+                                                    topology.local_indices),
+                        {replica_id}, {1}),
+      {});
+  xla::XlaOp offset =
+      local_index * xla::ConstantR0<xla::int32>(builder, shard_size);
+  xla::XlaOp shard = xla::AllReduce(
+      xla::DynamicSlice(host_sum, {offset}, {shard_size}), add,
+      topology.cross_host_groups);
+  xla::XlaOp reduced = xla::AllReduce(
+      xla::DynamicUpdateSlice(xla::Broadcast(zero, {padded_size}), shard,
+                              {offset}),
+      add, topology.host_groups);
+
+  auto unflatten = [&](size_t i) {
+    const xla::Shape& shape = ctx->operand_shapes[i];
+    xla::XlaOp piece = xla::SliceInDim(
+        reduced, offsets[i], offsets[i] + xla::ShapeUtil::ElementsIn(shape),
+        /*stride=*/1, /*dimno=*/0);
+    return xla::Reshape(piece, shape.dimensions());
+  };
+  for (size_t i = 0; i < ctx->indices.size(); ++i) {
+    xla::XlaOp value = unflatten(i);
+    if (scale != 1.0) {
+      value = value * XlaHelpers::ScalarValue<float>(scale, type, builder);
+    }
+    (*result)[ctx->indices[i]] = value;
+  }
+  XLA_COUNTER("HierarchicalAllReduce", 1);
+  return unflatten(ctx->indices.size());
+}
+
+// Reduces the operands of a single type, and returns the chained token.
+xla::XlaOp BuildTypeAllReduce(AllReduceType reduce_type,
+                              xla::PrimitiveType type, PerTypeContext* ctx,
+                              xla::XlaOp token, double scale,
+                              absl::Span<const xla::ReplicaGroup> reduce_groups,
+                              const ReplicaTopology* topology,
+                              std::vector<xla::XlaOp>* result) {
+  if (topology != nullptr) {
+    return BuildHierarchicalTypeAllReduce(type, ctx, token, scale, *topology,
+                                          result);
+  }
+  xla::XlaOp token_op = MaybeConvertTo(token, type);
+  ctx->ops.push_back(token_op);
+  ctx->operand_shapes.push_back(XlaHelpers::ShapeOfXlaOp(token_op));
+
+  xla::XlaOp reduce = xla::AllReduce(
+      xla::Tuple(token_op.builder(), ctx->ops),
+      GetReduceComutation(reduce_type, type), reduce_groups,
+      /*channel_id=*/absl::nullopt, MakeReduceShape(ctx->operand_shapes));
+  for (size_t i = 0; i < ctx->indices.size(); ++i) {
+    size_t op_idx = ctx->indices[i];
+    xla::XlaOp gte = xla::GetTupleElement(reduce, i);
+    if (scale != 1.0) {
+      xla::XlaOp scaling_value = XlaHelpers::ScalarValue<float>(
+          scale, ctx->operand_shapes[i].element_type(), gte.builder());
+      gte = gte * scaling_value;
+    }
+    (*result)[op_idx] = gte;
+  }
+  return xla::GetTupleElement(reduce, ctx->indices.size());
+}
+
+xla::XlaOp GetReduceInitValue(AllReduceType reduce_type,
+                              xla::PrimitiveType type,
+                              xla::XlaBuilder* builder) {
+  switch (reduce_type) {
+    case AllReduceType::kSum:
+    case AllReduceType::kSumBf16:
+    case AllReduceType::kOr:
+      return xla::Zero(builder, type);
+    case AllReduceType::kMul:
+    case AllReduceType::kAnd:
+      return xla::One(builder, type);
+    case AllReduceType::kMin:
+      return XlaHelpers::ScalarValue(XlaHelpers::MinMaxValues(type).max, type,
+                                     builder);
+    case AllReduceType::kMax:
+      return XlaHelpers::ScalarValue(XlaHelpers::MinMaxValues(type).min, type,
+                                     builder);
+  }
+  XLA_ERROR() << "Invalid reduce type: "
+              << xla::util::GetEnumValue(reduce_type);
+}
+
+// Issues an AllToAll() of the input, pinning the layout of its result as
+// BuildAllToAll() does.
+xla::XlaOp BuildPinnedAllToAll(
+    xla::XlaOp input, xla::int64 split_dimension, xla::int64 concat_dimension,
+    xla::int64 split_count, absl::Span<const xla::ReplicaGroup> reduce_groups) {
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  xla::Shape reduce_shape = MakeArrayShapeFromDimensions(
+      input_shape.dimensions(), input_shape.dynamic_dimensions(),
+      input_shape.element_type(), GetCurrentDevice().hw_type);
+  return xla::AllToAll(input, split_dimension, concat_dimension, split_count,
+                       reduce_groups, reduce_shape.layout());
+}
+
+bool IsCompressibleType(xla::PrimitiveType type) {
+  return type == xla::PrimitiveType::F32 || type == xla::PrimitiveType::F64;
+}
+
+// Reduces the compressible operands in BF16, and the others in their own type.
+std::vector<xla::XlaOp> BuildCompressedAllReduce(
+    absl::Span<const xla::XlaOp> operands, xla::XlaOp token, double scale,
+    const std::vector<std::vector<xla::int64>>& groups) {
+  std::vector<xla::XlaOp> compressed;
+  std::vector<xla::PrimitiveType> types;
+  compressed.reserve(operands.size());
+  types.reserve(operands.size());
+  for (auto& operand : operands) {
+    xla::PrimitiveType type = XlaHelpers::TypeOfXlaOp(operand);
+    compressed.push_back(
+        IsCompressibleType(type)
+            ? xla::ConvertElementType(operand, xla::PrimitiveType::BF16)
+            : operand);
+    types.push_back(type);
+  }
+  // The scaling happens after the conversion back, so that it does not lose
+  // further precision.
+  std::vector<xla::XlaOp> result =
+      BuildAllReduce(AllReduceType::kSum, compressed, token,
+                     /*scale=*/1.0, groups);
+  for (size_t i = 0; i < operands.size(); ++i) {
+    if (IsCompressibleType(types[i])) {
+      result[i] = xla::ConvertElementType(result[i], types[i]);
+    }
+    if (scale != 1.0) {
+      result[i] = result[i] * XlaHelpers::ScalarValue<float>(
+                                  scale, types[i], result[i].builder());
+    }
+  }
+  return result;
+}
+
+xla::int64 GetAllReduceBucketBytes() {
+  static const xla::int64 bucket_bytes =
+      xla::sys_util::GetEnvInt("XLA_ALL_REDUCE_BUCKET_BYTES", 0);
+  return bucket_bytes;
+}
+
+// Computes input * weight^T for the [M, K] input and the [N, K] weight,
+// without materializing the weight transpose.
+xla::XlaOp BuildLinearDot(xla::XlaOp input, xla::XlaOp weight) {
+  xla::DotDimensionNumbers dimension_numbers;
+  dimension_numbers.add_lhs_contracting_dimensions(1);
+  dimension_numbers.add_rhs_contracting_dimensions(1);
+  xla::PrecisionConfig precision_config =
+      XlaHelpers::BuildPrecisionConfig(XlaHelpers::mat_mul_precision());
+  return xla::DotGeneral(input, weight, dimension_numbers, &precision_config);
+}
+
+// Returns the chunk count to be used to split a dimension of the given size,
+// or 1 if the requested chunk count does not divide it.
+xla::int64 GetChunkCount(xla::int64 size, xla::int64 num_chunks) {
+  return num_chunks > 1 && size % num_chunks == 0 ? num_chunks : 1;
+}
+
 }  // namespace
 
 std::vector<xla::XlaOp> BuildAllReduce(
     AllReduceType reduce_type, absl::Span<const xla::XlaOp> operands,
     xla::XlaOp token, double scale,
     const std::vector<std::vector<xla::int64>>& groups) {
+  if (reduce_type == AllReduceType::kSumBf16) {
+    return BuildCompressedAllReduce(operands, token, scale, groups);
+  }
   std::vector<xla::ReplicaGroup> reduce_groups = CreateReduceGroups(groups);
   // TODO: We use pseudo-tokens ATM, which are real values. This need to be
   // switched to use the real XLA Token once support has been added to XLA
   // AllReduce().
   xla::XlaOp chained_token = token;
-  ReduceContext redux = GetReduceContext(operands);
   std::vector<xla::XlaOp> result(operands.size());
-  for (auto& type_ctx : redux.contexts) {
-    xla::XlaOp token_op = MaybeConvertTo(chained_token, type_ctx.first);
-    type_ctx.second.ops.push_back(token_op);
-    type_ctx.second.operand_shapes.push_back(
-        XlaHelpers::ShapeOfXlaOp(token_op));
-
-    xla::XlaOp reduce = xla::AllReduce(
-        xla::Tuple(operands[0].builder(), type_ctx.second.ops),
-        GetReduceComutation(reduce_type, type_ctx.first), reduce_groups,
-        /*channel_id=*/absl::nullopt,
-        MakeReduceShape(type_ctx.second.operand_shapes));
-    for (size_t i = 0; i < type_ctx.second.indices.size(); ++i) {
-      size_t op_idx = type_ctx.second.indices[i];
-      xla::XlaOp gte = xla::GetTupleElement(reduce, i);
-      if (scale != 1.0) {
-        xla::XlaOp scaling_value = XlaHelpers::ScalarValue<float>(
-            scale, type_ctx.second.operand_shapes[i].element_type(),
-            gte.builder());
-        gte = gte * scaling_value;
+  absl::optional<ReplicaTopology> topology =
+      GetReplicaTopology(reduce_type, groups);
+  const ReplicaTopology* topology_ptr = topology ? &*topology : nullptr;
+  xla::int64 bucket_bytes = GetAllReduceBucketBytes();
+  if (bucket_bytes <= 0) {
+    ReduceContext redux = GetReduceContext(operands);
+    for (auto& type_ctx : redux.contexts) {
+      chained_token =
+          BuildTypeAllReduce(reduce_type, type_ctx.first, &type_ctx.second,
+                             chained_token, scale, reduce_groups,
+                             topology_ptr, &result);
+    }
+  } else {
+    // The operands (like the gradients of the model parameters) are usually
+    // computed in reverse order, so the buckets are filled starting from the
+    // last operand. Every bucket only depends on its own operands and on the
+    // token of the previous bucket, which lets the XLA scheduler overlap its
+    // communication with the computation of the following buckets operands.
+    ReduceContext redux;
+    std::map<xla::PrimitiveType, xla::int64> bytes;
+    for (size_t i = operands.size(); i > 0; --i) {
+      xla::Shape operand_shape = XlaHelpers::ShapeOfXlaOp(operands[i - 1]);
+      xla::PrimitiveType type = operand_shape.element_type();
+      xla::int64 operand_bytes =
+          xla::ShapeUtil::ByteSizeOfElements(operand_shape);
+      PerTypeContext& ctx = redux.contexts[type];
+      if (!ctx.ops.empty() && bytes[type] + operand_bytes > bucket_bytes) {
+        chained_token = BuildTypeAllReduce(reduce_type, type, &ctx,
+                                           chained_token, scale,
+                                           reduce_groups, topology_ptr,
+                                           &result);
+        ctx = PerTypeContext();
+        bytes[type] = 0;
+        XLA_COUNTER("AllReduceBuckets", 1);
       }
-      result[op_idx] = gte;
+      ctx.ops.push_back(operands[i - 1]);
+      ctx.indices.push_back(i - 1);
+      ctx.operand_shapes.push_back(std::move(operand_shape));
+      bytes[type] += operand_bytes;
+    }
+    for (auto& type_ctx : redux.contexts) {
+      chained_token =
+          BuildTypeAllReduce(reduce_type, type_ctx.first, &type_ctx.second,
+                             chained_token, scale, reduce_groups,
+                             topology_ptr, &result);
+      XLA_COUNTER("AllReduceBuckets", 1);
     }
-    chained_token =
-        xla::GetTupleElement(reduce, type_ctx.second.indices.size());
   }
   result.push_back(
       MaybeConvertTo(chained_token, XlaHelpers::TypeOfXlaOp(token)));
@@ -140,6 +425,67 @@ AllToAllResult BuildAllToAll(
   return {reduce_result, token_handler.GetNewToken(reduce_result)};
 }
 
+AllGatherResult BuildAllGather(
+    xla::XlaOp input, xla::XlaOp token, xla::int64 dim, xla::int64 shard_count,
+    const std::vector<std::vector<xla::int64>>& groups) {
+  std::vector<xla::ReplicaGroup> reduce_groups = CreateReduceGroups(groups);
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  XLA_CHECK(dim >= 0 && dim < input_shape.rank())
+      << "Invalid all-gather dimension " << dim << " for shape "
+      << input_shape;
+  TokenHandler token_handler(token);
+  // Every replica sends a copy of its input to each of the others, which then
+  // concatenate them in replica order. The AllToAll() moves the same amount of
+  // data of a native all-gather, instead of the shard_count times bigger
+  // operand required by an emulation via AllReduce().
+  xla::XlaOp broadcast = xla::Broadcast(
+      token_handler.GetInput(input, &input_shape), {shard_count});
+  xla::XlaOp gathered = BuildPinnedAllToAll(
+      broadcast, /*split_dimension=*/0, /*concat_dimension=*/dim + 1,
+      shard_count, reduce_groups);
+  std::vector<xla::int64> result_sizes(input_shape.dimensions().begin(),
+                                       input_shape.dimensions().end());
+  result_sizes[dim] *= shard_count;
+  xla::XlaOp result = XlaHelpers::DynamicReshape(gathered, result_sizes);
+  return {result, token_handler.GetNewToken(result)};
+}
+
+ReduceScatterResult BuildReduceScatter(
+    AllReduceType reduce_type, xla::XlaOp input, xla::XlaOp token,
+    double scale, xla::int64 dim, xla::int64 shard_count,
+    const std::vector<std::vector<xla::int64>>& groups) {
+  std::vector<xla::ReplicaGroup> reduce_groups = CreateReduceGroups(groups);
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  XLA_CHECK(dim >= 0 && dim < input_shape.rank())
+      << "Invalid reduce-scatter dimension " << dim << " for shape "
+      << input_shape;
+  XLA_CHECK_EQ(input_shape.dimensions(dim) % shard_count, 0)
+      << "The reduce-scatter dimension " << dim << " of shape " << input_shape
+      << " is not divisible by the shard count " << shard_count;
+  TokenHandler token_handler(token);
+  // The scatter dimension is split in (shard_count, size / shard_count), and
+  // the AllToAll() delivers the i-th shard of every replica to the i-th
+  // replica, stacked along the shard dimension, which is then reduced locally.
+  std::vector<xla::int64> split_sizes(input_shape.dimensions().begin(),
+                                      input_shape.dimensions().end());
+  split_sizes[dim] /= shard_count;
+  split_sizes.insert(split_sizes.begin() + dim, shard_count);
+  xla::XlaOp split = XlaHelpers::DynamicReshape(
+      token_handler.GetInput(input, &input_shape), split_sizes);
+  xla::XlaOp shards =
+      BuildPinnedAllToAll(split, /*split_dimension=*/dim,
+                          /*concat_dimension=*/dim, shard_count, reduce_groups);
+  xla::PrimitiveType type = input_shape.element_type();
+  xla::XlaOp result = xla::Reduce(
+      shards, GetReduceInitValue(reduce_type, type, input.builder()),
+      GetReduceComutation(reduce_type, type), {dim});
+  if (scale != 1.0) {
+    result = result * XlaHelpers::ScalarValue<float>(scale, type,
+                                                     input.builder());
+  }
+  return {result, token_handler.GetNewToken(result)};
+}
+
 CollectivePermuteResult BuildCollectivePermute(
     xla::XlaOp input, xla::XlaOp token,
     const std::vector<std::pair<xla::int64, xla::int64>>& source_target_pairs) {
@@ -153,4 +499,117 @@ CollectivePermuteResult BuildCollectivePermute(
   return {result, token_handler.GetNewToken(result)};
 }
 
+ParallelMatMulResult BuildColumnParallelMatMul(
+    xla::XlaOp input, xla::XlaOp weight, const absl::optional<xla::XlaOp>& bias,
+    xla::XlaOp token, bool gather_output, xla::int64 shard_count,
+    xla::int64 num_chunks, const std::vector<std::vector<xla::int64>>& groups) {
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  const xla::Shape& weight_shape = XlaHelpers::ShapeOfXlaOp(weight);
+  XLA_CHECK_GE(input_shape.rank(), 1) << input_shape;
+  XLA_CHECK_EQ(weight_shape.rank(), 2) << weight_shape;
+  xla::int64 in_features = input_shape.dimensions(input_shape.rank() - 1);
+  XLA_CHECK_EQ(in_features, weight_shape.dimensions(1))
+      << "Input shape " << input_shape << " does not match weight shape "
+      << weight_shape;
+  xla::int64 rows = xla::ShapeUtil::ElementsIn(input_shape) / in_features;
+  xla::XlaOp input_2d = xla::Reshape(input, {rows, in_features});
+  xla::int64 chunks = GetChunkCount(rows, num_chunks);
+  xla::int64 chunk_size = rows / chunks;
+  xla::XlaOp chained_token = token;
+  std::vector<xla::XlaOp> results;
+  for (xla::int64 i = 0; i < chunks; ++i) {
+    xla::XlaOp chunk =
+        chunks > 1 ? xla::SliceInDim(input_2d, i * chunk_size,
+                                     (i + 1) * chunk_size, 1, 0)
+                   : input_2d;
+    xla::XlaOp result = BuildLinearDot(chunk, weight);
+    if (bias) {
+      result = xla::Add(result, *bias, {1});
+    }
+    if (gather_output) {
+      AllGatherResult gather =
+          BuildAllGather(result, chained_token, 1, shard_count, groups);
+      result = gather.result;
+      chained_token = gather.token;
+    }
+    results.push_back(result);
+  }
+  xla::XlaOp result = results.size() > 1
+                          ? xla::ConcatInDim(input.builder(), results, 0)
+                          : results.front();
+  std::vector<xla::int64> result_sizes(input_shape.dimensions().begin(),
+                                       input_shape.dimensions().end());
+  result_sizes.back() =
+      weight_shape.dimensions(0) * (gather_output ? shard_count : 1);
+  return {xla::Reshape(result, result_sizes), chained_token};
+}
+
+ParallelMatMulResult BuildRowParallelMatMul(
+    xla::XlaOp input, xla::XlaOp weight, const absl::optional<xla::XlaOp>& bias,
+    xla::XlaOp token, bool scatter_output, xla::int64 shard_count,
+    xla::int64 num_chunks, const std::vector<std::vector<xla::int64>>& groups) {
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  const xla::Shape& weight_shape = XlaHelpers::ShapeOfXlaOp(weight);
+  XLA_CHECK_GE(input_shape.rank(), 1) << input_shape;
+  XLA_CHECK_EQ(weight_shape.rank(), 2) << weight_shape;
+  xla::int64 in_features = input_shape.dimensions(input_shape.rank() - 1);
+  XLA_CHECK_EQ(in_features, weight_shape.dimensions(1))
+      << "Input shape " << input_shape << " does not match weight shape "
+      << weight_shape;
+  xla::int64 out_features = weight_shape.dimensions(0);
+  xla::int64 rows = xla::ShapeUtil::ElementsIn(input_shape) / in_features;
+  xla::XlaOp input_2d = xla::Reshape(input, {rows, in_features});
+  std::vector<xla::int64> result_sizes(input_shape.dimensions().begin(),
+                                       input_shape.dimensions().end());
+  result_sizes.back() = out_features;
+  xla::XlaOp chained_token = token;
+  std::vector<xla::XlaOp> results;
+  xla::int64 concat_dim = 0;
+  if (scatter_output) {
+    XLA_CHECK_GE(input_shape.rank(), 2) << input_shape;
+    XLA_CHECK_EQ(input_shape.dimensions(0) % shard_count, 0)
+        << "The first dimension of shape " << input_shape
+        << " is not divisible by the shard count " << shard_count;
+    // The shard of the first dimension owned by each replica is a contiguous
+    // block of rows, so the reduce-scatter is chunked along the columns.
+    xla::int64 chunks = GetChunkCount(out_features, num_chunks);
+    xla::int64 chunk_size = out_features / chunks;
+    for (xla::int64 i = 0; i < chunks; ++i) {
+      xla::XlaOp weight_chunk =
+          chunks > 1 ? xla::SliceInDim(weight, i * chunk_size,
+                                       (i + 1) * chunk_size, 1, 0)
+                     : weight;
+      ReduceScatterResult scatter = BuildReduceScatter(
+          AllReduceType::kSum, BuildLinearDot(input_2d, weight_chunk),
+          chained_token, 1.0, 0, shard_count, groups);
+      results.push_back(scatter.result);
+      chained_token = scatter.token;
+    }
+    concat_dim = 1;
+    result_sizes.front() /= shard_count;
+  } else {
+    xla::int64 chunks = GetChunkCount(rows, num_chunks);
+    xla::int64 chunk_size = rows / chunks;
+    for (xla::int64 i = 0; i < chunks; ++i) {
+      xla::XlaOp chunk =
+          chunks > 1 ? xla::SliceInDim(input_2d, i * chunk_size,
+                                       (i + 1) * chunk_size, 1, 0)
+                     : input_2d;
+      std::vector<xla::XlaOp> reduced =
+          BuildAllReduce(AllReduceType::kSum, {BuildLinearDot(chunk, weight)},
+                         chained_token, 1.0, groups);
+      results.push_back(reduced.front());
+      chained_token = reduced.back();
+    }
+  }
+  xla::XlaOp result =
+      results.size() > 1
+          ? xla::ConcatInDim(input.builder(), results, concat_dim)
+          : results.front();
+  if (bias) {
+    result = xla::Add(result, *bias, {1});
+  }
+  return {xla::Reshape(result, result_sizes), chained_token};
+}
+
 }  // namespace torch_xla
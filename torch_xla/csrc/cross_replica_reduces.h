@@ -2,6 +2,7 @@
 
 #include <vector>
 
+#include "absl/types/optional.h"
 #include "absl/types/span.h"
 #include "tensorflow/compiler/xla/client/xla_builder.h"
 
@@ -14,6 +15,9 @@ enum class AllReduceType {
   kMul,
   kOr,
   kAnd,
+  // Sum where the floating point operands wider than 16 bits are reduced in
+  // BF16, to halve the communication volume, and converted back afterwards.
+  kSumBf16,
 };
 
 struct AllToAllResult {
@@ -26,6 +30,21 @@ struct CollectivePermuteResult {
   xla::XlaOp token;
 };
 
+struct AllGatherResult {
+  xla::XlaOp result;
+  xla::XlaOp token;
+};
+
+struct ReduceScatterResult {
+  xla::XlaOp result;
+  xla::XlaOp token;
+};
+
+struct ParallelMatMulResult {
+  xla::XlaOp result;
+  xla::XlaOp token;
+};
+
 std::vector<xla::XlaOp> BuildAllReduce(
     AllReduceType reduce_type, absl::Span<const xla::XlaOp> operands,
     xla::XlaOp token, double scale,
@@ -36,8 +55,43 @@ AllToAllResult BuildAllToAll(
     xla::int64 concat_dimension, xla::int64 split_count,
     const std::vector<std::vector<xla::int64>>& groups);
 
+// Concatenates along dim the inputs of the shard_count replicas of each group.
+AllGatherResult BuildAllGather(
+    xla::XlaOp input, xla::XlaOp token, xla::int64 dim, xla::int64 shard_count,
+    const std::vector<std::vector<xla::int64>>& groups);
+
+// Reduces the inputs of the shard_count replicas of each group, and returns the
+// i-th of the shard_count slices along dim to the i-th replica of the group.
+ReduceScatterResult BuildReduceScatter(
+    AllReduceType reduce_type, xla::XlaOp input, xla::XlaOp token,
+    double scale, xla::int64 dim, xla::int64 shard_count,
+    const std::vector<std::vector<xla::int64>>& groups);
+
 CollectivePermuteResult BuildCollectivePermute(
     xla::XlaOp input, xla::XlaOp token,
     const std::vector<std::pair<xla::int64, xla::int64>>& source_target_pairs);
 
+// Multiplies the [..., K] input by the [N, K] shard of the weight which holds
+// the N output features of the replica (plus the optional [N] bias shard). If
+// gather_output is true, the [..., N * shard_count] result is all-gathered
+// across the replicas of each group. The rows are processed in num_chunks
+// chunks, so that the all-gather of a chunk overlaps with the matmul of the
+// following one.
+ParallelMatMulResult BuildColumnParallelMatMul(
+    xla::XlaOp input, xla::XlaOp weight, const absl::optional<xla::XlaOp>& bias,
+    xla::XlaOp token, bool gather_output, xla::int64 shard_count,
+    xla::int64 num_chunks, const std::vector<std::vector<xla::int64>>& groups);
+
+// Multiplies the [..., K] input shard by the [N, K] weight shard which holds
+// the same K input features, and sums the partial results across the replicas
+// of each group. If scatter_output is true the sum is reduce-scattered along
+// the first dimension of the result, otherwise it is all-reduced. The
+// optional [N] bias is added after the reduction. The matmul is processed in
+// num_chunks chunks, so that the reduction of a chunk overlaps with the
+// matmul of the following one.
+ParallelMatMulResult BuildRowParallelMatMul(
+    xla::XlaOp input, xla::XlaOp weight, const absl::optional<xla::XlaOp>& bias,
+    xla::XlaOp token, bool scatter_output, xla::int64 shard_count,
+    xla::int64 num_chunks, const std::vector<std::vector<xla::int64>>& groups);
+
 }  // namespace torch_xla
@@ -0,0 +1,28 @@
+#include "torch_xla/csrc/custom_kernels.h"
+
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+
+namespace torch_xla {
+
+CustomKernelRegistry* CustomKernelRegistry::Get() {
+  static CustomKernelRegistry* registry = new CustomKernelRegistry();
+  return registry;
+}
+
+void CustomKernelRegistry::Register(CustomKernel kernel) {
+  XLA_CHECK(!kernel.name.empty());
+  XLA_CHECK(!kernel.target.empty()) << kernel.name;
+  XLA_CHECK(kernel.shape_fn != nullptr) << kernel.name;
+  std::string name = kernel.name;
+  std::lock_guard<std::mutex> lock(lock_);
+  kernels_[name] = std::make_shared<const CustomKernel>(std::move(kernel));
+}
+
+std::shared_ptr<const CustomKernel> CustomKernelRegistry::Find(
+    const std::string& name) {
+  std::lock_guard<std::mutex> lock(lock_);
+  auto it = kernels_.find(name);
+  return it != kernels_.end() ? it->second : nullptr;
+}
+
+}  // namespace torch_xla
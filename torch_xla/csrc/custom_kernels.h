@@ -0,0 +1,53 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/xla/shape.h"
+
+namespace torch_xla {
+
+// A backend specific kernel, reached as an XLA CustomCall. The kernel itself
+// must be registered with the XLA custom call target registry of the backend
+// (like with XLA_REGISTER_CUSTOM_CALL_TARGET_WITH_SYM for GPU), by the same
+// shared library registering the CustomKernel object.
+struct CustomKernel {
+  // Computes the output shape of the kernel (a tuple shape for multiple
+  // outputs) out of the shapes of its inputs.
+  using ShapeFn = std::function<xla::Shape(absl::Span<const xla::Shape>)>;
+
+  // The name of the IR operation, which will show up as xla::_kernel_<name>.
+  std::string name;
+  std::string target;
+  // The opaque string passed to the kernel, which usually holds its
+  // configuration.
+  std::string backend_config;
+  ShapeFn shape_fn;
+  bool has_side_effect = false;
+};
+
+// The CustomKernelRegistry class is a singleton accessible via its Get() API
+// which maps the kernel names into their registrations. Shared libraries
+// holding custom kernels register them at load time, like with a static
+// object calling Register() within their constructor.
+class CustomKernelRegistry {
+ public:
+  static CustomKernelRegistry* Get();
+
+  // Registers a kernel, replacing any kernel previously registered with the
+  // same name.
+  void Register(CustomKernel kernel);
+
+  // Returns the kernel registered with the given name, or nullptr if none.
+  std::shared_ptr<const CustomKernel> Find(const std::string& name);
+
+ private:
+  std::mutex lock_;
+  std::map<std::string, std::shared_ptr<const CustomKernel>> kernels_;
+};
+
+}  // namespace torch_xla
@@ -0,0 +1,175 @@
+#include "torch_xla/csrc/data_loader.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "torch_xla/csrc/aten_xla_bridge.h"
+#include "torch_xla/csrc/tensor.h"
+#include "torch_xla/csrc/tensor_util.h"
+
+namespace torch_xla {
+
+DeviceDataLoader::DeviceDataLoader(std::vector<Device> devices,
+                                   size_t ring_size)
+    : devices_(std::move(devices)),
+      ring_size_(std::max<size_t>(ring_size, 1)),
+      rings_(devices_.size()) {}
+
+bool DeviceDataLoader::Upload(
+    const std::vector<std::vector<at::Tensor>>& device_tensors) {
+  XLA_CHECK_EQ(device_tensors.size(), devices_.size());
+  {
+    std::unique_lock<std::mutex> lock(lock_);
+    XLA_CHECK(!write_closed_);
+    cv_.wait(lock, [this] { return closed_ || RingsHaveRoom(); });
+    if (closed_) {
+      return false;
+    }
+  }
+
+  XLA_TIMED("DeviceDataLoaderUpload");
+  std::vector<at::Tensor> tensors;
+  std::vector<std::string> devices;
+  for (size_t i = 0; i < device_tensors.size(); ++i) {
+    for (auto& tensor : device_tensors[i]) {
+      tensors.push_back(tensor);
+      devices.push_back(devices_[i].ToString());
+    }
+  }
+  std::vector<xla::ComputationClient::DataPtr> handles =
+      CreateTensorsData(tensors, devices);
+
+  std::vector<std::vector<at::Tensor>> items(device_tensors.size());
+  size_t index = 0;
+  for (size_t i = 0; i < device_tensors.size(); ++i) {
+    items[i].reserve(device_tensors[i].size());
+    for (auto& tensor : device_tensors[i]) {
+      XLATensor xla_tensor = XLATensor::Create(std::move(handles[index]));
+      items[i].push_back(torch::autograd::make_variable(
+          bridge::AtenFromXlaTensor(std::move(xla_tensor)),
+          /*requires_grad=*/tensor.requires_grad()));
+      ++index;
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    if (closed_) {
+      return false;
+    }
+    for (size_t i = 0; i < items.size(); ++i) {
+      rings_[i].push_back(std::move(items[i]));
+    }
+  }
+  cv_.notify_all();
+  return true;
+}
+
+bool DeviceDataLoader::Next(size_t device_index,
+                            std::vector<at::Tensor>* tensors) {
+  XLA_CHECK_LT(device_index, rings_.size());
+  std::deque<std::vector<at::Tensor>>& ring = rings_[device_index];
+  {
+    std::unique_lock<std::mutex> lock(lock_);
+    cv_.wait(lock, [&] { return closed_ || write_closed_ || !ring.empty(); });
+    if (ring.empty()) {
+      return false;
+    }
+    *tensors = std::move(ring.front());
+    ring.pop_front();
+  }
+  cv_.notify_all();
+  return true;
+}
+
+void DeviceDataLoader::CloseWrite() {
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    write_closed_ = true;
+  }
+  cv_.notify_all();
+}
+
+void DeviceDataLoader::Close() {
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    closed_ = true;
+    for (auto& ring : rings_) {
+      ring.clear();
+    }
+  }
+  cv_.notify_all();
+}
+
+bool DeviceDataLoader::RingsHaveRoom() const {
+  for (auto& ring : rings_) {
+    if (ring.size() >= ring_size_) {
+      return false;
+    }
+  }
+  return true;
+}
+
+DevicePrefetcher::DevicePrefetcher(std::shared_ptr<SharedBatchRing> ring,
+                                   Device device, size_t queue_size)
+    : ring_(std::move(ring)),
+      device_(std::move(device)),
+      queue_(std::max<size_t>(queue_size, 1)),
+      thread_([this] { Run(); }) {}
+
+DevicePrefetcher::~DevicePrefetcher() {
+  done_ = true;
+  ring_->Close();
+  thread_.join();
+}
+
+bool DevicePrefetcher::Next(Item* item) {
+  while (!queue_.TryPop(item)) {
+    if (finished_.load(std::memory_order_acquire)) {
+      // The producer might have pushed its last items before finishing.
+      if (queue_.TryPop(item)) {
+        break;
+      }
+      if (exception_ != nullptr) {
+        std::rethrow_exception(exception_);
+      }
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+  }
+  return true;
+}
+
+void DevicePrefetcher::Run() {
+  try {
+    SharedBatchRing::Batch batch;
+    while (!done_ && ring_->Read(&batch)) {
+      Item item;
+      {
+        XLA_TIMED("DevicePrefetcherUpload");
+        std::vector<std::string> devices(batch.tensors.size(),
+                                         device_.ToString());
+        std::vector<xla::ComputationClient::DataPtr> handles =
+            CreateTensorsData(batch.tensors, devices);
+        // The upload copied the data out of the shared memory slot, which can
+        // be handed back to the writers.
+        ring_->Release(batch);
+        for (auto& handle : handles) {
+          item.tensors.push_back(torch::autograd::make_variable(
+              bridge::AtenFromXlaTensor(XLATensor::Create(std::move(handle))),
+              /*requires_grad=*/false));
+        }
+        item.metadata = std::move(batch.metadata);
+      }
+      while (!done_ && !queue_.TryPush(&item)) {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+      }
+    }
+  } catch (...) {
+    exception_ = std::current_exception();
+  }
+  finished_.store(true, std::memory_order_release);
+}
+
+}  // namespace torch_xla
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "torch/csrc/autograd/variable.h"
+#include "torch_xla/csrc/device.h"
+#include "torch_xla/csrc/shared_batch_ring.h"
+
+namespace torch_xla {
+
+// Native upload stage of the ParallelLoader. Host batches for all the devices
+// are uploaded with a single CreateTensorsData() call, and the resulting device
+// tensors are kept within a bounded per device ring, from which the device
+// loaders pick them once ready.
+class DeviceDataLoader {
+ public:
+  DeviceDataLoader(std::vector<Device> devices, size_t ring_size);
+
+  const std::vector<Device>& devices() const { return devices_; }
+
+  // Uploads device_tensors[i] to devices()[i], and queues them as one item into
+  // the ring of such device. Waits for all the rings to have a free slot before
+  // starting the upload, so that no more than ring_size batches per device are
+  // resident on device at any time. Returns false if the loader has been
+  // closed.
+  bool Upload(const std::vector<std::vector<at::Tensor>>& device_tensors);
+
+  // Pops the next item of the ring of devices()[device_index], waiting for it
+  // to be uploaded. Returns false once the ring is empty and no more uploads
+  // will happen.
+  bool Next(size_t device_index, std::vector<at::Tensor>* tensors);
+
+  // Signals that no more uploads will happen.
+  void CloseWrite();
+
+  // Drops all the queued items and wakes up all the waiters.
+  void Close();
+
+ private:
+  bool RingsHaveRoom() const;
+
+  std::vector<Device> devices_;
+  size_t ring_size_;
+  std::mutex lock_;
+  std::condition_variable cv_;
+  std::vector<std::deque<std::vector<at::Tensor>>> rings_;
+  bool write_closed_ = false;
+  bool closed_ = false;
+};
+
+// Lock-free queue with a single producer thread and a single consumer thread.
+template <typename T>
+class SpscQueue {
+ public:
+  explicit SpscQueue(size_t capacity) : slots_(capacity + 1) {}
+
+  bool TryPush(T* value) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t next_tail = (tail + 1) % slots_.size();
+    if (next_tail == head_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    slots_[tail] = std::move(*value);
+    tail_.store(next_tail, std::memory_order_release);
+    return true;
+  }
+
+  bool TryPop(T* value) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    *value = std::move(slots_[head]);
+    head_.store((head + 1) % slots_.size(), std::memory_order_release);
+    return true;
+  }
+
+ private:
+  std::vector<T> slots_;
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) std::atomic<size_t> tail_{0};
+};
+
+// Uploads the batches of a SharedBatchRing onto a device, from a background
+// thread which involves no Python, and hands the resulting device tensors over
+// to the training thread through a lock-free queue.
+class DevicePrefetcher {
+ public:
+  struct Item {
+    std::vector<at::Tensor> tensors;
+    std::string metadata;
+  };
+
+  DevicePrefetcher(std::shared_ptr<SharedBatchRing> ring, Device device,
+                   size_t queue_size);
+
+  ~DevicePrefetcher();
+
+  // Waits for the next uploaded batch. Returns false once all the batches of
+  // the ring have been consumed. Must be called by a single thread.
+  bool Next(Item* item);
+
+ private:
+  void Run();
+
+  std::shared_ptr<SharedBatchRing> ring_;
+  Device device_;
+  SpscQueue<Item> queue_;
+  std::atomic<bool> done_{false};
+  std::atomic<bool> finished_{false};
+  std::exception_ptr exception_;
+  std::thread thread_;
+};
+
+}  // namespace torch_xla
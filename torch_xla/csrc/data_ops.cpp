@@ -20,10 +20,37 @@
 namespace torch_xla {
 namespace {
 
+SparseLoweringCosts GetDefaultSparseLoweringCosts(DeviceType hw_type) {
+  switch (hw_type) {
+    case DeviceType::TPU:
+      // Scatter updates hitting the same rows are serialized on TPU.
+      return {/*dense_gather_factor=*/100, /*dense_scatter_factor=*/100,
+              /*sorted_scatter_min_indices=*/1024};
+    case DeviceType::GPU:
+      return {/*dense_gather_factor=*/100, /*dense_scatter_factor=*/0,
+              /*sorted_scatter_min_indices=*/16384};
+    default:
+      return {/*dense_gather_factor=*/100, /*dense_scatter_factor=*/0,
+              /*sorted_scatter_min_indices=*/0};
+  }
+}
+
+SparseLoweringCosts CreateSparseLoweringCosts(DeviceType hw_type) {
+  SparseLoweringCosts costs = GetDefaultSparseLoweringCosts(hw_type);
+  costs.dense_gather_factor = xla::sys_util::GetEnvInt(
+      "XLA_DENSE_GATHER_FACTOR", costs.dense_gather_factor);
+  costs.dense_scatter_factor = xla::sys_util::GetEnvInt(
+      "XLA_DENSE_SCATTER_FACTOR", costs.dense_scatter_factor);
+  costs.sorted_scatter_min_indices = xla::sys_util::GetEnvInt(
+      "XLA_SORTED_SCATTER_MIN_INDICES", costs.sorted_scatter_min_indices);
+  return costs;
+}
+
 bool IsSparseGather(const xla::Shape& input_shape,
-                    const xla::Shape& index_shape, xla::int64 dim) {
-  static int dense_gather_factor =
-      xla::sys_util::GetEnvInt("XLA_DENSE_GATHER_FACTOR", 100);
+                    const xla::Shape& index_shape, xla::int64 dim,
+                    const Device* device) {
+  xla::int64 dense_gather_factor =
+      GetSparseLoweringCosts(device).dense_gather_factor;
   xla::int64 input_elements = xla::ShapeUtil::ElementsIn(input_shape);
   xla::int64 index_elements = xla::ShapeUtil::ElementsIn(index_shape);
   // Simple heuristic. Might need fine tuning.
@@ -32,9 +59,20 @@ bool IsSparseGather(const xla::Shape& input_shape,
 
 }  // namespace
 
-bool IsSparseGather(xla::XlaOp input, xla::XlaOp index, xla::int64 dim) {
+const SparseLoweringCosts& GetSparseLoweringCosts(const Device* device) {
+  static const std::vector<SparseLoweringCosts>* costs =
+      new std::vector<SparseLoweringCosts>(
+          {CreateSparseLoweringCosts(DeviceType::CPU),
+           CreateSparseLoweringCosts(DeviceType::GPU),
+           CreateSparseLoweringCosts(DeviceType::TPU)});
+  Device xla_device = GetDeviceOrCurrent(device);
+  return (*costs)[xla::util::GetEnumValue(xla_device.hw_type)];
+}
+
+bool IsSparseGather(xla::XlaOp input, xla::XlaOp index, xla::int64 dim,
+                    const Device* device) {
   return IsSparseGather(XlaHelpers::ShapeOfXlaOp(input),
-                        XlaHelpers::ShapeOfXlaOp(index), dim);
+                        XlaHelpers::ShapeOfXlaOp(index), dim, device);
 }
 
 std::vector<xla::int64> GetCompleteShape(
@@ -206,6 +244,25 @@ std::vector<xla::XlaOp> BuildSplit(xla::XlaOp input,
   return splits;
 }
 
+xla::XlaOp BuildDynamicUpdateSlice(xla::XlaOp input, xla::XlaOp source,
+                                   xla::XlaOp start, xla::int64 dim) {
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  const xla::Shape& source_shape = XlaHelpers::ShapeOfXlaOp(source);
+  const xla::Shape& start_shape = XlaHelpers::ShapeOfXlaOp(start);
+  XLA_CHECK_EQ(start_shape.rank(), 0) << start_shape;
+  XLA_CHECK_EQ(source_shape.rank(), input_shape.rank()) << source_shape;
+  xla::XlaOp update_source = source;
+  if (source_shape.element_type() != input_shape.element_type()) {
+    update_source = ConvertTo(source, source_shape.element_type(),
+                              input_shape.element_type(), /*device=*/nullptr);
+  }
+  std::vector<xla::XlaOp> start_indices(
+      input_shape.rank(),
+      xla::Zero(input.builder(), start_shape.element_type()));
+  start_indices[dim] = start;
+  return xla::DynamicUpdateSlice(input, update_source, start_indices);
+}
+
 xla::XlaOp BuildUpdateSlice(xla::XlaOp input, xla::XlaOp source,
                             absl::Span<const xla::int64> base_indices) {
   const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
@@ -254,9 +311,9 @@ xla::XlaOp BuildTake(xla::XlaOp input, xla::XlaOp index) {
       XlaHelpers::ScalarValue(xla::ShapeUtil::ElementsIn(input_shape),
                               index_shape.element_type(), index.builder());
   xla::XlaOp bound_index = BoundIndices(r1_index, max_index);
-  xla::XlaOp r1_result =
-      xla::TorchGather(r1_input, bound_index, take_dim,
-                       IsSparseGather(input_shape, index_shape, take_dim));
+  xla::XlaOp r1_result = xla::TorchGather(
+      r1_input, bound_index, take_dim,
+      IsSparseGather(input_shape, index_shape, take_dim, /*device=*/nullptr));
   return XlaHelpers::DynamicReshape(r1_result, index_shape.dimensions());
 }
 
@@ -5,12 +5,31 @@
 #include "absl/types/optional.h"
 #include "absl/types/span.h"
 #include "tensorflow/compiler/xla/client/xla_builder.h"
+#include "torch_xla/csrc/device.h"
 
 // Collection of XLA lowerings for operations which only involve some form of
 // data movement and no computation.
 namespace torch_xla {
 
-bool IsSparseGather(xla::XlaOp input, xla::XlaOp index, xla::int64 dim);
+// Per device type thresholds used to pick between the dense and the sparse
+// lowerings of the gather and scatter operations. Each of them can be
+// overridden for all the device types with an environment variable.
+struct SparseLoweringCosts {
+  // Gathers use the sparse lowering when the input has more than
+  // dense_gather_factor times the elements of the index.
+  xla::int64 dense_gather_factor;
+  // Scatters use the dense lowering when dense_scatter_factor times the index
+  // elements are at least as many as the input ones. Zero disables it.
+  xla::int64 dense_scatter_factor;
+  // Accumulating row scatters with at least this many indices sort them and
+  // combine the duplicated ones before scattering. Zero disables it.
+  xla::int64 sorted_scatter_min_indices;
+};
+
+const SparseLoweringCosts& GetSparseLoweringCosts(const Device* device);
+
+bool IsSparseGather(xla::XlaOp input, xla::XlaOp index, xla::int64 dim,
+                    const Device* device);
 
 // For input_sizes and a potentially incomplete output_sizes, return a complete
 // output shape. The complete output shape has same total number of elements as
@@ -66,6 +85,12 @@ std::vector<xla::XlaOp> BuildSplit(xla::XlaOp input,
                                    absl::Span<const xla::int64> split_sizes,
                                    xla::int64 dim);
 
+// Creates an updated version of input, where the slice starting at the start
+// offset (a scalar integer operation) along dim, is overwritten with source.
+// The offset is clamped so that the source fits within the input.
+xla::XlaOp BuildDynamicUpdateSlice(xla::XlaOp input, xla::XlaOp source,
+                                   xla::XlaOp start, xla::int64 dim);
+
 // Creates an updated version of input, where, starting at base_indices, source
 // if overlapped with input.
 xla::XlaOp BuildUpdateSlice(xla::XlaOp input, xla::XlaOp source,
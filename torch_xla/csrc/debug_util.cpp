@@ -1,15 +1,21 @@
 #include "torch_xla/csrc/debug_util.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <fstream>
 #include <mutex>
 #include <sstream>
+#include <thread>
 #include <unordered_set>
 
 #include "absl/memory/memory.h"
 #include "absl/strings/str_split.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/xla/xla_client/unique.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
 #include "torch_xla/csrc/device.h"
 #include "torch_xla/csrc/ir.h"
 #include "torch_xla/csrc/ir_dump_util.h"
@@ -43,66 +49,73 @@ std::unordered_set<std::string>* LoadExperiments() {
   return xset.release();
 }
 
-}  // namespace
+std::atomic<xla::int64> g_step(0);
 
-DebugUtil::GraphFormat DebugUtil::GetDefaultGraphFormat() {
-  static GraphFormat format = DefaultGraphFormat();
-  return format;
-}
+struct GraphRoots {
+  std::vector<ir::Value> values;
+  std::vector<xla::hash_t> hashes;
+  Device device;
+};
 
-std::string DebugUtil::GetTensorsGraphInfo(absl::Span<const XLATensor> tensors,
-                                           const std::vector<size_t>* indices,
-                                           GraphFormat format) {
-  std::vector<const ir::Node*> root_nodes;
-  std::vector<ir::Value> root_values;
-  std::vector<xla::hash_t> root_hashes;
+// Captures the IR values of the graph roots, which keep the (immutable) graph
+// alive until it gets formatted.
+GraphRoots CaptureGraphRoots(absl::Span<const XLATensor> tensors,
+                             const std::vector<size_t>* indices) {
+  GraphRoots roots;
   xla::util::Unique<Device> unique_device;
+  auto add_root = [&](const XLATensor& tensor) {
+    ir::Value ir_value = tensor.CurrentIrValue();
+    if (ir_value) {
+      roots.hashes.push_back(ir_value.hash());
+      roots.values.push_back(std::move(ir_value));
+      unique_device.set(tensor.GetDevice());
+    }
+  };
   if (indices != nullptr) {
     for (auto index : *indices) {
-      const XLATensor& tensor = tensors[index];
-      ir::Value ir_value = tensor.CurrentIrValue();
-      if (ir_value) {
-        root_nodes.push_back(ir_value.node.get());
-        root_hashes.push_back(ir_value.hash());
-        root_values.push_back(std::move(ir_value));
-        unique_device.set(tensor.GetDevice());
-      }
+      add_root(tensors[index]);
     }
   } else {
     for (auto& tensor : tensors) {
-      ir::Value ir_value = tensor.CurrentIrValue();
-      if (ir_value) {
-        root_nodes.push_back(ir_value.node.get());
-        root_hashes.push_back(ir_value.hash());
-        root_values.push_back(std::move(ir_value));
-        unique_device.set(tensor.GetDevice());
-      }
+      add_root(tensor);
     }
   }
+  roots.device = unique_device ? *unique_device : GetCurrentDevice();
+  return roots;
+}
+
+std::string FormatGraphInfo(const std::vector<SourceLocation>& frames,
+                            const GraphRoots& roots,
+                            DebugUtil::GraphFormat format, xla::int64 step) {
   std::stringstream ss;
-  std::vector<SourceLocation> frames = GetPythonFrames();
   ss << "TensorsGraphInfo:\n";
   for (auto& location : frames) {
     ss << "  " << location.function << " (" << location.file << ":"
        << location.line << ")\n";
   }
   ss << "\nHashes: (";
-  for (size_t i = 0; i < root_hashes.size(); ++i) {
+  for (size_t i = 0; i < roots.hashes.size(); ++i) {
     if (i > 0) {
       ss << ", ";
     }
-    ss << xla::util::HexHash(root_hashes[i]);
+    ss << xla::util::HexHash(roots.hashes[i]);
   }
   ss << ")\n";
+  if (step >= 0) {
+    ss << "Step: " << step << "\n";
+  }
 
+  std::vector<const ir::Node*> root_nodes;
+  for (auto& value : roots.values) {
+    root_nodes.push_back(value.node.get());
+  }
   std::string graph_str;
-  if (format == GraphFormat::kText) {
+  if (format == DebugUtil::GraphFormat::kText) {
     graph_str = ir::DumpUtil::ToText(root_nodes);
-  } else if (format == GraphFormat::kDot) {
+  } else if (format == DebugUtil::GraphFormat::kDot) {
     graph_str = ir::DumpUtil::ToDot(root_nodes);
-  } else if (format == GraphFormat::kHlo) {
-    graph_str = ir::DumpUtil::ToHlo(
-        root_values, unique_device ? *unique_device : GetCurrentDevice());
+  } else if (format == DebugUtil::GraphFormat::kHlo) {
+    graph_str = ir::DumpUtil::ToHlo(roots.values, roots.device);
   } else {
     XLA_ERROR() << "Invalid graph format: " << format;
   }
@@ -110,21 +123,125 @@ std::string DebugUtil::GetTensorsGraphInfo(absl::Span<const XLATensor> tensors,
   return ss.str();
 }
 
+// Formats the saved graphs, and appends them to the save file, from a
+// background thread, in the order they were saved.
+class GraphInfoWriter {
+ public:
+  struct Entry {
+    std::string name;
+    std::vector<FrameToken> frame_tokens;
+    GraphRoots roots;
+    DebugUtil::GraphFormat format = DebugUtil::GraphFormat::kText;
+    xla::int64 step = 0;
+  };
+
+  static GraphInfoWriter* Get() {
+    static GraphInfoWriter* writer = new GraphInfoWriter();
+    return writer;
+  }
+
+  bool IsNewGraph(xla::hash_t hash) {
+    std::lock_guard<std::mutex> lock(lock_);
+    return saved_hashes_.insert(hash).second;
+  }
+
+  // Queues an entry. The producers never wait for the writer, which might
+  // need the GIL (to resolve the Python frames) they could be holding.
+  void Add(const std::string& path, Entry entry) {
+    std::lock_guard<std::mutex> lock(lock_);
+    if (!thread_started_) {
+      std::thread([this, path]() { Run(path); }).detach();
+      thread_started_ = true;
+    }
+    pending_.push_back(std::move(entry));
+    cv_.notify_all();
+  }
+
+  void Flush() {
+    std::unique_lock<std::mutex> lock(lock_);
+    cv_.wait(lock, [this] { return pending_.empty() && !writing_; });
+  }
+
+ private:
+  void Run(const std::string& path) {
+    while (true) {
+      Entry entry;
+      {
+        std::unique_lock<std::mutex> lock(lock_);
+        cv_.wait(lock, [this] { return !pending_.empty(); });
+        entry = std::move(pending_.front());
+        pending_.pop_front();
+        writing_ = true;
+        cv_.notify_all();
+      }
+      std::string info =
+          FormatGraphInfo(ResolvePythonFrames(entry.frame_tokens), entry.roots,
+                          entry.format, entry.step);
+      {
+        std::ofstream graph_file(path, std::ios_base::app);
+        graph_file << "[" << entry.name << "]\n" << info << "\n";
+      }
+      // Releases the graph before signaling the flushers. The writer thread
+      // never allocates IR nodes, so it has no node pool and the released
+      // nodes go straight back to the system allocator.
+      entry = Entry();
+      std::lock_guard<std::mutex> lock(lock_);
+      writing_ = false;
+      cv_.notify_all();
+    }
+  }
+
+  std::mutex lock_;
+  std::condition_variable cv_;
+  std::deque<Entry> pending_;
+  std::unordered_set<xla::hash_t, xla::util::HashReducer> saved_hashes_;
+  bool thread_started_ = false;
+  bool writing_ = false;
+};
+
+}  // namespace
+
+DebugUtil::GraphFormat DebugUtil::GetDefaultGraphFormat() {
+  static GraphFormat format = DefaultGraphFormat();
+  return format;
+}
+
+std::string DebugUtil::GetTensorsGraphInfo(absl::Span<const XLATensor> tensors,
+                                           const std::vector<size_t>* indices,
+                                           GraphFormat format) {
+  return FormatGraphInfo(GetPythonFrames(), CaptureGraphRoots(tensors, indices),
+                         format, /*step=*/-1);
+}
+
 void DebugUtil::SaveTensorsGraphInfo(const char* name,
                                      absl::Span<const XLATensor> tensors,
                                      const std::vector<size_t>* indices,
                                      GraphFormat format) {
   static const std::string save_file =
       xla::sys_util::GetEnvOrdinalPath("XLA_SAVE_TENSORS_FILE", "");
+  static const bool dedup =
+      xla::sys_util::GetEnvBool("XLA_SAVE_TENSORS_DEDUP", false);
   if (!save_file.empty()) {
-    static std::mutex lock;
-    std::string info = GetTensorsGraphInfo(tensors, indices, format);
-    std::lock_guard<std::mutex> guard(lock);
-    std::ofstream graph_file(save_file, std::ios_base::app);
-    graph_file << "[" << name << "]\n" << info << "\n";
+    GraphInfoWriter::Entry entry;
+    entry.roots = CaptureGraphRoots(tensors, indices);
+    xla::hash_t graph_hash =
+        xla::util::MHash(entry.roots.hashes, static_cast<int>(format));
+    if (dedup && !GraphInfoWriter::Get()->IsNewGraph(graph_hash)) {
+      XLA_COUNTER("DedupedGraphInfo", 1);
+      return;
+    }
+    entry.name = name;
+    entry.frame_tokens = GetPythonFrameTokens();
+    entry.format = format;
+    entry.step = g_step.load();
+    GraphInfoWriter::Get()->Add(save_file, std::move(entry));
   }
 }
 
+void DebugUtil::FlushTensorsGraphInfo() { GraphInfoWriter::Get()->Flush(); }
+
+void DebugUtil::MarkStep() { g_step += 1; }
+
 bool DebugUtil::ExperimentEnabled(const std::string& name) {
   static const std::unordered_set<std::string>* xset = LoadExperiments();
   return xset->find(name) != xset->end();
@@ -28,12 +28,20 @@ class DebugUtil {
 
   // If the environment variable XLA_SAVE_TENSORS_FILE is set to the proper
   // output path, an instance of the report returned by GetTensorsGraphInfo() is
-  // saved.
+  // saved. Only the IR roots and the Python frames are captured by the caller,
+  // while the graph is formatted and written by a background thread. With
+  // XLA_SAVE_TENSORS_DEDUP, every distinct graph is saved only once.
   static void SaveTensorsGraphInfo(
       const char* name, absl::Span<const XLATensor> tensors,
       const std::vector<size_t>* indices,
       GraphFormat format = GetDefaultGraphFormat());
 
+  // Waits for the graphs queued by SaveTensorsGraphInfo() to be written.
+  static void FlushTensorsGraphInfo();
+
+  // Advances the step counter written together with the saved graphs.
+  static void MarkStep();
+
   static bool ExperimentEnabled(const std::string& name);
 };
 
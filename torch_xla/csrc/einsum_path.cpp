@@ -0,0 +1,289 @@
+#include "torch_xla/csrc/einsum_path.h"
+
+#include <algorithm>
+#include <cctype>
+#include <limits>
+#include <map>
+#include <set>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "tensorflow/compiler/xla/xla_client/cache.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "torch_xla/csrc/ops/einsum.h"
+
+namespace torch_xla {
+namespace {
+
+using EinsumPathCache =
+    xla::util::Cache<xla::hash_t, const EinsumPath, xla::util::HashReducer>;
+
+EinsumPathCache* GetEinsumPathCache() {
+  static EinsumPathCache* cache = new EinsumPathCache(1024);
+  return cache;
+}
+
+struct Equation {
+  std::vector<std::string> inputs;
+  std::string output;
+  std::map<char, xla::int64> label_sizes;
+};
+
+bool ParseLabels(const std::string& labels) {
+  std::set<char> seen;
+  for (char label : labels) {
+    if (!std::isalpha(static_cast<unsigned char>(label)) ||
+        !seen.insert(label).second) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ParseEquation(const std::string& equation,
+                   absl::Span<const std::vector<xla::int64>> operand_sizes,
+                   Equation* parsed) {
+  std::string spec;
+  for (char c : equation) {
+    if (!std::isspace(static_cast<unsigned char>(c))) {
+      spec.push_back(c);
+    }
+  }
+  size_t arrow = spec.find("->");
+  parsed->inputs = absl::StrSplit(spec.substr(0, arrow), ',');
+  if (parsed->inputs.size() != operand_sizes.size()) {
+    return false;
+  }
+  std::map<char, xla::int64> label_counts;
+  for (size_t i = 0; i < parsed->inputs.size(); ++i) {
+    const std::string& labels = parsed->inputs[i];
+    if (!ParseLabels(labels) || labels.size() != operand_sizes[i].size()) {
+      return false;
+    }
+    for (size_t j = 0; j < labels.size(); ++j) {
+      auto it = parsed->label_sizes.emplace(labels[j], operand_sizes[i][j]);
+      if (it.first->second != operand_sizes[i][j]) {
+        return false;
+      }
+      label_counts[labels[j]] += 1;
+    }
+  }
+  if (arrow != std::string::npos) {
+    parsed->output = spec.substr(arrow + 2);
+    if (!ParseLabels(parsed->output)) {
+      return false;
+    }
+    for (char label : parsed->output) {
+      if (label_counts.count(label) == 0) {
+        return false;
+      }
+    }
+  } else {
+    // The implicit output holds the labels appearing only once, sorted.
+    for (auto& label_count : label_counts) {
+      if (label_count.second == 1) {
+        parsed->output.push_back(label_count.first);
+      }
+    }
+  }
+  return true;
+}
+
+class PathSearch {
+ public:
+  explicit PathSearch(const Equation* equation) : equation_(equation) {}
+
+  // Returns the labels of the contraction of the i and j operands, which are
+  // the ones still needed by the output or by the other operands.
+  std::string ContractLabels(const std::vector<std::string>& operands,
+                             size_t i, size_t j) const {
+    std::string labels;
+    for (char label : operands[i] + operands[j]) {
+      if (labels.find(label) != std::string::npos) {
+        continue;
+      }
+      bool needed = equation_->output.find(label) != std::string::npos;
+      for (size_t k = 0; k < operands.size() && !needed; ++k) {
+        needed = k != i && k != j &&
+                 operands[k].find(label) != std::string::npos;
+      }
+      if (needed) {
+        labels.push_back(label);
+      }
+    }
+    return labels;
+  }
+
+  double Size(const std::string& labels) const {
+    double size = 1;
+    for (char label : labels) {
+      size *= equation_->label_sizes.at(label);
+    }
+    return size;
+  }
+
+  // The FLOPs of a contraction are the product of all the sizes of its
+  // labels, as every output element sums over the contracted ones.
+  double Flops(const std::string& x, const std::string& y) const {
+    std::string labels = x;
+    for (char label : y) {
+      if (labels.find(label) == std::string::npos) {
+        labels.push_back(label);
+      }
+    }
+    return Size(labels);
+  }
+
+  // Exhaustively searches the contraction order with the fewest FLOPs,
+  // preferring the smaller peak intermediate size on ties.
+  void SearchOptimal(const std::vector<std::string>& operands, double flops,
+                     double peak_size,
+                     std::vector<std::pair<size_t, size_t>>* pairs) {
+    if (flops > best_flops_ ||
+        (flops == best_flops_ && peak_size >= best_peak_size_)) {
+      return;
+    }
+    if (operands.size() == 1) {
+      best_flops_ = flops;
+      best_peak_size_ = peak_size;
+      best_pairs_ = *pairs;
+      return;
+    }
+    for (size_t i = 0; i < operands.size(); ++i) {
+      for (size_t j = i + 1; j < operands.size(); ++j) {
+        std::string labels = ContractLabels(operands, i, j);
+        pairs->emplace_back(i, j);
+        SearchOptimal(Contract(operands, i, j, labels),
+                      flops + Flops(operands[i], operands[j]),
+                      std::max(peak_size, Size(labels)), pairs);
+        pairs->pop_back();
+      }
+    }
+  }
+
+  // Greedily picks the contraction which shrinks the total operands size the
+  // most (or grows it the least), breaking ties with the FLOPs.
+  void SearchGreedy(std::vector<std::string> operands) {
+    while (operands.size() > 1) {
+      std::pair<size_t, size_t> best_pair;
+      std::string best_labels;
+      double best_cost = std::numeric_limits<double>::infinity();
+      double best_flops = std::numeric_limits<double>::infinity();
+      for (size_t i = 0; i < operands.size(); ++i) {
+        for (size_t j = i + 1; j < operands.size(); ++j) {
+          std::string labels = ContractLabels(operands, i, j);
+          double cost = Size(labels) - Size(operands[i]) - Size(operands[j]);
+          double flops = Flops(operands[i], operands[j]);
+          if (cost < best_cost || (cost == best_cost && flops < best_flops)) {
+            best_pair = std::make_pair(i, j);
+            best_labels = labels;
+            best_cost = cost;
+            best_flops = flops;
+          }
+        }
+      }
+      best_pairs_.push_back(best_pair);
+      operands =
+          Contract(operands, best_pair.first, best_pair.second, best_labels);
+    }
+  }
+
+  const std::vector<std::pair<size_t, size_t>>& best_pairs() const {
+    return best_pairs_;
+  }
+
+  static std::vector<std::string> Contract(
+      const std::vector<std::string>& operands, size_t i, size_t j,
+      std::string labels) {
+    std::vector<std::string> contracted;
+    for (size_t k = 0; k < operands.size(); ++k) {
+      if (k != i && k != j) {
+        contracted.push_back(operands[k]);
+      }
+    }
+    contracted.push_back(std::move(labels));
+    return contracted;
+  }
+
+ private:
+  const Equation* equation_;
+  double best_flops_ = std::numeric_limits<double>::infinity();
+  double best_peak_size_ = std::numeric_limits<double>::infinity();
+  std::vector<std::pair<size_t, size_t>> best_pairs_;
+};
+
+std::shared_ptr<const EinsumPath> ComputeEinsumPath(
+    const std::string& equation,
+    absl::Span<const std::vector<xla::int64>> operand_sizes) {
+  static const size_t optimal_max_operands =
+      xla::sys_util::GetEnvInt("XLA_EINSUM_OPTIMAL_MAX_OPERANDS", 5);
+  Equation parsed;
+  if (!ParseEquation(equation, operand_sizes, &parsed)) {
+    return nullptr;
+  }
+  PathSearch search(&parsed);
+  auto path = std::make_shared<EinsumPath>();
+  // Labels showing up within a single operand, and not in the output, are
+  // summed upfront, as the pairwise XLA einsum does not reduce them.
+  std::vector<std::string> operands;
+  for (size_t i = 0; i < parsed.inputs.size(); ++i) {
+    std::string labels = search.ContractLabels(parsed.inputs, i, i);
+    std::vector<xla::int64> reduce_dimensions;
+    for (size_t j = 0; j < parsed.inputs[i].size(); ++j) {
+      if (labels.find(parsed.inputs[i][j]) == std::string::npos) {
+        reduce_dimensions.push_back(j);
+      }
+    }
+    path->reduce_dimensions.push_back(std::move(reduce_dimensions));
+    operands.push_back(std::move(labels));
+  }
+  if (operands.size() <= optimal_max_operands) {
+    std::vector<std::pair<size_t, size_t>> pairs;
+    search.SearchOptimal(operands, 0, 0, &pairs);
+  } else {
+    search.SearchGreedy(operands);
+  }
+  for (auto& pair : search.best_pairs()) {
+    std::string labels =
+        operands.size() == 2
+            ? parsed.output
+            : search.ContractLabels(operands, pair.first, pair.second);
+    EinsumStep step;
+    step.x = pair.first;
+    step.y = pair.second;
+    step.equation = absl::StrCat(operands[pair.first], ",",
+                                 operands[pair.second], "->", labels);
+    if (!ir::ops::Einsum::SupportsEquation(step.equation,
+                                           operands[pair.first].size(),
+                                           operands[pair.second].size())) {
+      return nullptr;
+    }
+    path->steps.push_back(std::move(step));
+    operands = PathSearch::Contract(operands, pair.first, pair.second, labels);
+  }
+  return path;
+}
+
+}  // namespace
+
+std::shared_ptr<const EinsumPath> GetEinsumPath(
+    const std::string& equation,
+    absl::Span<const std::vector<xla::int64>> operand_sizes) {
+  XLA_CHECK_GT(operand_sizes.size(), 2) << equation;
+  std::vector<std::vector<xla::int64>> sizes(operand_sizes.begin(),
+                                             operand_sizes.end());
+  xla::hash_t hash = xla::util::MHash(equation, sizes);
+  EinsumPathCache* cache = GetEinsumPathCache();
+  std::shared_ptr<const EinsumPath> path = cache->Get(hash);
+  if (path != nullptr) {
+    XLA_COUNTER("EinsumPathCacheHit", 1);
+    return path;
+  }
+  path = ComputeEinsumPath(equation, operand_sizes);
+  return path != nullptr ? cache->Add(hash, path) : nullptr;
+}
+
+}  // namespace torch_xla
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/xla/types.h"
+
+namespace torch_xla {
+
+// A pairwise contraction of a multi-operand einsum. The x and y operands are
+// taken (and removed) from the current list of operands, and the result of
+// the two operands einsum equation is appended to it.
+struct EinsumStep {
+  xla::int64 x = 0;
+  xla::int64 y = 0;
+  std::string equation;
+};
+
+struct EinsumPath {
+  // The dimensions of every operand which should be summed before the
+  // contractions start, as their labels appear nowhere else.
+  std::vector<std::vector<xla::int64>> reduce_dimensions;
+  std::vector<EinsumStep> steps;
+};
+
+// Splits an einsum equation with more than two operands into a sequence of
+// pairwise contractions, ordered to minimize the FLOPs and the size of the
+// intermediate results. Up to XLA_EINSUM_OPTIMAL_MAX_OPERANDS operands all the
+// orders are searched, while bigger equations use a greedy search. The paths
+// are cached per equation and operand sizes.
+// Returns nullptr if the equation is not supported (ellipsis, repeated labels
+// within one operand, or pairwise equations XLA cannot lower).
+std::shared_ptr<const EinsumPath> GetEinsumPath(
+    const std::string& equation,
+    absl::Span<const std::vector<xla::int64>> operand_sizes);
+
+}  // namespace torch_xla
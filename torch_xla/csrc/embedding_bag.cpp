@@ -0,0 +1,200 @@
+#include "torch_xla/csrc/embedding_bag.h"
+
+#include "tensorflow/compiler/xla/client/lib/constants.h"
+#include "tensorflow/compiler/xla/client/lib/slicing.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "torch_xla/csrc/convert_ops.h"
+#include "torch_xla/csrc/helpers.h"
+#include "torch_xla/csrc/reduction.h"
+#include "torch_xla/csrc/xla_lower_util.h"
+
+namespace torch_xla {
+namespace {
+
+xla::XlaOp BroadcastRows(xla::XlaOp op, absl::Span<const xla::int64> sizes) {
+  return xla::BroadcastInDim(op, sizes, {0});
+}
+
+// Returns the bag index of each one of the num_indices indices, given the
+// bag_offsets (which do not include the past-the-end one). Each offset marks
+// the start of a bag, so the bag index is the inclusive prefix sum of the bag
+// starts minus one. Offsets equal to num_indices (trailing empty bags) fall out
+// of bounds, and the scatter skips them.
+xla::XlaOp BuildOffset2Bag(const Device& device, xla::XlaOp bag_offsets,
+                           xla::int64 num_indices) {
+  xla::XlaBuilder* builder = bag_offsets.builder();
+  const xla::Shape& offsets_shape = XlaHelpers::ShapeOfXlaOp(bag_offsets);
+  xla::PrimitiveType type = offsets_shape.element_type();
+  xla::XlaOp zeros =
+      xla::Zeros(builder, xla::ShapeUtil::MakeShape(type, {num_indices}));
+  xla::XlaOp bag_starts = CreateIndexAdd(
+      device, zeros, 0, bag_offsets,
+      xla::Broadcast(xla::One(builder, type), offsets_shape.dimensions()));
+  xla::XlaOp offset2bag = BuildCumulativeComputation(
+      bag_starts, 0, XlaHelpers::CreateAddComputation(type),
+      xla::Zero(builder, type),
+      [](xla::XlaOp lhs, xla::XlaOp rhs) { return lhs + rhs; });
+  return offset2bag - xla::One(builder, type);
+}
+
+}  // namespace
+
+EmbeddingBagResult BuildEmbeddingBag(
+    const Device& device, xla::XlaOp weight, xla::XlaOp indices,
+    xla::XlaOp offsets, const absl::optional<xla::XlaOp>& per_sample_weights,
+    EmbeddingBagMode mode, bool include_last_offset) {
+  xla::XlaBuilder* builder = weight.builder();
+  const xla::Shape& weight_shape = XlaHelpers::ShapeOfXlaOp(weight);
+  const xla::Shape& indices_shape = XlaHelpers::ShapeOfXlaOp(indices);
+  XLA_CHECK_EQ(weight_shape.rank(), 2) << weight_shape;
+  XLA_CHECK_EQ(indices_shape.rank(), 1) << indices_shape;
+  xla::PrimitiveType index_type = indices_shape.element_type();
+  xla::XlaOp index_offsets = MaybeConvertTo(offsets, index_type);
+  xla::int64 num_indices = indices_shape.dimensions(0);
+  xla::int64 num_offsets =
+      XlaHelpers::ShapeOfXlaOp(index_offsets).dimensions(0);
+  xla::int64 num_bags = include_last_offset ? num_offsets - 1 : num_offsets;
+  XLA_CHECK_GE(num_bags, 0);
+  xla::int64 embedding_dim = weight_shape.dimensions(1);
+
+  xla::XlaOp bag_offsets = xla::SliceInDim(index_offsets, 0, num_bags, 1, 0);
+  xla::XlaOp bag_ends =
+      include_last_offset
+          ? xla::SliceInDim(index_offsets, 1, num_offsets, 1, 0)
+          : xla::ConcatInDim(
+                builder,
+                {xla::SliceInDim(index_offsets, 1, num_offsets, 1, 0),
+                 xla::Broadcast(XlaHelpers::ScalarValue(num_indices, index_type,
+                                                        builder),
+                                {1})},
+                0);
+  xla::XlaOp bag_size = bag_ends - bag_offsets;
+  xla::XlaOp offset2bag = BuildOffset2Bag(device, bag_offsets, num_indices);
+
+  xla::XlaOp rows = CreateIndex(
+      weight, XlaHelpers::DynamicReshape(indices, {num_indices, 1}), 0);
+  if (per_sample_weights) {
+    XLA_CHECK(mode == EmbeddingBagMode::kSum)
+        << "Per sample weights are only supported with the sum mode";
+    rows = rows * BroadcastRows(MaybeConvertTo(*per_sample_weights,
+                                               weight_shape.element_type()),
+                                {num_indices, embedding_dim});
+  }
+  std::vector<xla::int64> output_sizes({num_bags, embedding_dim});
+  xla::XlaOp zero_output = xla::Broadcast(
+      xla::Zero(builder, weight_shape.element_type()), output_sizes);
+  xla::XlaOp max_indices =
+      xla::Broadcast(xla::Zero(builder, index_type), output_sizes);
+  xla::XlaOp output;
+  if (mode == EmbeddingBagMode::kMax) {
+    xla::XlaOp non_empty = BroadcastRows(
+        xla::Gt(bag_size, xla::Zero(builder, index_type)), output_sizes);
+    XlaOpCombiner max_combiner = [](xla::XlaOp x, xla::XlaOp y) {
+      return xla::Max(x, y);
+    };
+    XlaOpCombiner min_combiner = [](xla::XlaOp x, xla::XlaOp y) {
+      return xla::Min(x, y);
+    };
+    // The offset2bag is already sorted, so the sorted row scatter only costs
+    // the (trivial) sort of an ordered sequence.
+    output = xla::Select(
+        non_empty,
+        CreateSortedRowScatter(
+            xla::Broadcast(xla::MinValue(builder, weight_shape.element_type()),
+                           output_sizes),
+            offset2bag, rows, max_combiner),
+        zero_output);
+    // Picks, for each output element, the first weight row holding the max.
+    xla::XlaOp is_max =
+        xla::Eq(rows, xla::TorchIndexSelect(output, offset2bag, 0));
+    xla::XlaOp no_row = xla::Broadcast(
+        XlaHelpers::ScalarValue(weight_shape.dimensions(0), index_type,
+                                builder),
+        {num_indices, embedding_dim});
+    xla::XlaOp candidates = xla::Select(
+        is_max, BroadcastRows(indices, {num_indices, embedding_dim}), no_row);
+    max_indices = xla::Select(
+        non_empty,
+        CreateSortedRowScatter(
+            xla::Broadcast(XlaHelpers::ScalarValue(weight_shape.dimensions(0),
+                                                   index_type, builder),
+                           output_sizes),
+            offset2bag, candidates, min_combiner),
+        max_indices);
+  } else {
+    output = CreateIndexAdd(device, zero_output, 0, offset2bag, rows);
+    if (mode == EmbeddingBagMode::kMean) {
+      xla::XlaOp divisor = xla::Max(bag_size, xla::One(builder, index_type));
+      output = output / BroadcastRows(MaybeConvertTo(
+                                          divisor, weight_shape.element_type()),
+                                      output_sizes);
+    }
+  }
+  return {output, offset2bag, bag_size, max_indices};
+}
+
+xla::XlaOp BuildEmbeddingBagBackward(
+    const Device& device, xla::XlaOp grad_output, xla::XlaOp indices,
+    xla::XlaOp offset2bag, xla::XlaOp bag_size, xla::XlaOp max_indices,
+    const absl::optional<xla::XlaOp>& per_sample_weights,
+    xla::int64 num_weights, bool scale_grad_by_freq, EmbeddingBagMode mode) {
+  xla::XlaBuilder* builder = grad_output.builder();
+  const xla::Shape& grad_shape = XlaHelpers::ShapeOfXlaOp(grad_output);
+  const xla::Shape& indices_shape = XlaHelpers::ShapeOfXlaOp(indices);
+  xla::PrimitiveType type = grad_shape.element_type();
+  xla::PrimitiveType index_type = indices_shape.element_type();
+  xla::int64 num_bags = grad_shape.dimensions(0);
+  xla::int64 embedding_dim = grad_shape.dimensions(1);
+  xla::int64 num_indices = indices_shape.dimensions(0);
+  xla::XlaOp grad_weight = xla::Broadcast(xla::Zero(builder, type),
+                                          {num_weights, embedding_dim});
+  if (mode == EmbeddingBagMode::kMax) {
+    XLA_CHECK(!scale_grad_by_freq)
+        << "scale_grad_by_freq is not supported with the max mode";
+    std::vector<xla::int64> grad_sizes({num_bags, embedding_dim});
+    xla::XlaOp non_empty = BroadcastRows(
+        xla::Gt(MaybeConvertTo(bag_size, index_type),
+                xla::Zero(builder, index_type)),
+        grad_sizes);
+    xla::XlaOp grad = xla::Select(non_empty, grad_output,
+                                  xla::Broadcast(xla::Zero(builder, type),
+                                                 grad_sizes));
+    std::vector<xla::int64> index_sizes({num_bags, embedding_dim, 1});
+    xla::XlaOp rows = XlaHelpers::DynamicReshape(
+        MaybeConvertTo(max_indices, index_type), index_sizes);
+    xla::XlaOp columns = xla::Iota(
+        builder, xla::ShapeUtil::MakeShape(index_type, index_sizes), 1);
+    XlaOpCombiner add_combiner = [](xla::XlaOp x, xla::XlaOp y) {
+      return x + y;
+    };
+    return CreateIndexUpdate(grad_weight,
+                             xla::ConcatInDim(builder, {rows, columns}, 2),
+                             /*start_dim=*/0, grad, add_combiner);
+  }
+  std::vector<xla::int64> rows_sizes({num_indices, embedding_dim});
+  xla::XlaOp index_offset2bag = MaybeConvertTo(offset2bag, index_type);
+  xla::XlaOp grad = xla::TorchIndexSelect(grad_output, index_offset2bag, 0);
+  if (mode == EmbeddingBagMode::kMean) {
+    xla::XlaOp divisor =
+        xla::Max(xla::TorchIndexSelect(MaybeConvertTo(bag_size, index_type),
+                                       index_offset2bag, 0),
+                 xla::One(builder, index_type));
+    grad = grad / BroadcastRows(MaybeConvertTo(divisor, type), rows_sizes);
+  }
+  if (per_sample_weights) {
+    grad = grad *
+           BroadcastRows(MaybeConvertTo(*per_sample_weights, type), rows_sizes);
+  }
+  if (scale_grad_by_freq) {
+    xla::XlaOp counts = CreateIndexAdd(
+        device,
+        xla::Zeros(builder, xla::ShapeUtil::MakeShape(type, {num_weights})), 0,
+        indices, xla::Broadcast(xla::One(builder, type), {num_indices}));
+    grad = grad / BroadcastRows(xla::TorchIndexSelect(counts, indices, 0),
+                                rows_sizes);
+  }
+  return CreateIndexAdd(device, grad_weight, 0, indices, grad);
+}
+
+}  // namespace torch_xla
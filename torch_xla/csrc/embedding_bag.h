@@ -0,0 +1,39 @@
+#pragma once
+
+#include "absl/types/optional.h"
+#include "tensorflow/compiler/xla/client/xla_builder.h"
+#include "torch_xla/csrc/device.h"
+
+namespace torch_xla {
+
+// The embedding bag reduction modes, with the same values PyTorch uses.
+enum class EmbeddingBagMode { kSum = 0, kMean = 1, kMax = 2 };
+
+struct EmbeddingBagResult {
+  xla::XlaOp output;
+  // The bag each one of the indices belongs to.
+  xla::XlaOp offset2bag;
+  xla::XlaOp bag_size;
+  // The weight row selected by the max reduction, for every output element.
+  // All zeros for the other modes.
+  xla::XlaOp max_indices;
+};
+
+// Reduces, for each bag, the weight rows selected by the rank 1 indices, where
+// the bag b spans the indices from offsets[b] to offsets[b + 1] (or to the end
+// of indices for the last one, unless include_last_offset is true). Empty bags
+// produce zeros.
+EmbeddingBagResult BuildEmbeddingBag(
+    const Device& device, xla::XlaOp weight, xla::XlaOp indices,
+    xla::XlaOp offsets, const absl::optional<xla::XlaOp>& per_sample_weights,
+    EmbeddingBagMode mode, bool include_last_offset);
+
+// Computes the gradient of BuildEmbeddingBag() with respect to the weight,
+// from the offset2bag, bag_size and max_indices forward results.
+xla::XlaOp BuildEmbeddingBagBackward(
+    const Device& device, xla::XlaOp grad_output, xla::XlaOp indices,
+    xla::XlaOp offset2bag, xla::XlaOp bag_size, xla::XlaOp max_indices,
+    const absl::optional<xla::XlaOp>& per_sample_weights,
+    xla::int64 num_weights, bool scale_grad_by_freq, EmbeddingBagMode mode);
+
+}  // namespace torch_xla
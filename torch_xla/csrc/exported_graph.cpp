@@ -0,0 +1,211 @@
+#include "torch_xla/csrc/exported_graph.h"
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
+#include "tensorflow/compiler/xla/primitive_util.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
+#include "torch_xla/csrc/tensor_checkpoint.h"
+#include "torch_xla/csrc/tensor_util.h"
+
+namespace torch_xla {
+namespace {
+
+static const char* const kGraphFile = "graph.hlo";
+static const char* const kMetaFile = "graph.meta";
+static const char* const kWeightsDir = "weights";
+static const char* const kMetaVersion = "xla_exported_graph_v1";
+
+xla::Shape ParseShape(absl::string_view type, absl::string_view dims) {
+  std::vector<xla::int64> dimensions;
+  for (auto dim : absl::StrSplit(dims, ',', absl::SkipEmpty())) {
+    xla::int64 size = 0;
+    XLA_CHECK(absl::SimpleAtoi(dim, &size)) << "Invalid dimension: " << dim;
+    dimensions.push_back(size);
+  }
+  return xla::ShapeUtil::MakeShape(
+      ConsumeValue(xla::primitive_util::StringToPrimitiveType(
+          std::string(type))),
+      dimensions);
+}
+
+// The meta file has one line per input (with its shape), per parameter (with
+// the index of the input feeding it, or -1 for weights) and per output (with
+// its tensor type).
+std::string SerializeMeta(const XLATensor::CapturedGraph& graph) {
+  std::string meta = absl::StrCat(kMetaVersion, "\n");
+  for (auto& shape : graph.input_shapes) {
+    absl::StrAppend(
+        &meta, "input\t",
+        xla::primitive_util::LowercasePrimitiveTypeName(shape.element_type()),
+        "\t", absl::StrJoin(shape.dimensions(), ","), "\n");
+  }
+  for (auto input_index : graph.parameter_inputs) {
+    absl::StrAppend(&meta, "parameter\t", input_index, "\n");
+  }
+  for (auto output_type : graph.output_types) {
+    absl::StrAppend(&meta, "output\t", c10::toString(output_type), "\n");
+  }
+  return meta;
+}
+
+}  // namespace
+
+void ExportedGraph::Save(const std::string& path,
+                         const XLATensor::CapturedGraph& graph,
+                         size_t num_shards) {
+  XLA_TIMED("ExportedGraphSave");
+  std::vector<xla::ComputationClient::DataPtr> weights_data;
+  std::vector<at::ScalarType> weights_types;
+  std::vector<std::string> weights_names;
+  for (size_t i = 0; i < graph.parameters_data.size(); ++i) {
+    if (graph.parameter_inputs[i] < 0) {
+      weights_data.push_back(graph.parameters_data[i]);
+      weights_types.push_back(TensorTypeFromXlaType(
+          graph.parameters_data[i]->shape().element_type()));
+      weights_names.push_back(absl::StrCat("parameter.", i));
+    }
+  }
+  tensorflow::Env* env = tensorflow::Env::Default();
+  XLA_CHECK_OK(env->RecursivelyCreateDir(path));
+  TensorCheckpoint::Save(tensorflow::io::JoinPath(path, kWeightsDir),
+                         weights_names,
+                         XlaDataToTensors(weights_data, weights_types),
+                         num_shards);
+  XLA_CHECK_OK(tensorflow::WriteStringToFile(
+      env, tensorflow::io::JoinPath(path, kGraphFile),
+      graph.computation->computation().proto().SerializeAsString()));
+  // The meta file is written last, so that its presence marks a complete
+  // export.
+  XLA_CHECK_OK(tensorflow::WriteStringToFile(
+      env, tensorflow::io::JoinPath(path, kMetaFile), SerializeMeta(graph)));
+}
+
+std::shared_ptr<ExportedGraph> ExportedGraph::Load(
+    const std::string& path, const Device& device,
+    const std::vector<at::Tensor>* host_weights) {
+  XLA_TIMED("ExportedGraphLoad");
+  tensorflow::Env* env = tensorflow::Env::Default();
+  std::string meta;
+  XLA_CHECK_OK(tensorflow::ReadFileToString(
+      env, tensorflow::io::JoinPath(path, kMetaFile), &meta));
+  std::vector<absl::string_view> lines =
+      absl::StrSplit(meta, '\n', absl::SkipEmpty());
+  XLA_CHECK(!lines.empty() && lines[0] == kMetaVersion)
+      << "Invalid exported graph: " << path;
+  std::shared_ptr<ExportedGraph> graph(new ExportedGraph(device));
+  for (size_t i = 1; i < lines.size(); ++i) {
+    std::vector<absl::string_view> fields = absl::StrSplit(lines[i], '\t');
+    if (fields[0] == "input" && fields.size() == 3) {
+      graph->input_shapes_.push_back(ParseShape(fields[1], fields[2]));
+    } else if (fields[0] == "parameter" && fields.size() == 2) {
+      xla::int64 input_index = 0;
+      XLA_CHECK(absl::SimpleAtoi(fields[1], &input_index)) << lines[i];
+      graph->parameter_inputs_.push_back(input_index);
+    } else if (fields[0] == "output" && fields.size() == 2) {
+      graph->output_types_.push_back(
+          TensorCheckpoint::ParseScalarType(fields[1]));
+    } else {
+      XLA_ERROR() << "Invalid exported graph line: " << lines[i];
+    }
+  }
+
+  std::string hlo;
+  XLA_CHECK_OK(tensorflow::ReadFileToString(
+      env, tensorflow::io::JoinPath(path, kGraphFile), &hlo));
+  xla::HloModuleProto proto;
+  XLA_CHECK(proto.ParseFromString(hlo)) << "Invalid exported graph: " << path;
+  xla::XlaComputation computation(std::move(proto));
+  xla::ProgramShape program_shape = ConsumeValue(computation.GetProgramShape());
+  XLA_CHECK_EQ(program_shape.parameters_size(),
+               graph->parameter_inputs_.size());
+  xla::Shape shape =
+      MakeShapeWithDeviceLayout(program_shape.result(), device.hw_type);
+  std::vector<xla::ComputationClient::CompileInstance> instances;
+  instances.push_back(
+      {std::move(computation), device.ToString(),
+       xla::ComputationClient::Get()->GetCompilationDevices(device.ToString(),
+                                                            {}),
+       &shape});
+  graph->computation_ =
+      std::move(xla::ComputationClient::Get()->Compile(std::move(instances))
+                    .front());
+
+  std::vector<xla::ComputationClient::DataPtr> weights_data;
+  if (host_weights != nullptr) {
+    weights_data = CreateTensorsData(
+        *host_weights,
+        std::vector<std::string>(host_weights->size(), device.ToString()));
+  } else {
+    std::string weights_path = tensorflow::io::JoinPath(path, kWeightsDir);
+    TensorCheckpoint::Index index = TensorCheckpoint::LoadIndex(weights_path);
+    weights_data = TensorCheckpoint::Load(weights_path, index, device);
+  }
+  auto weights_it = weights_data.begin();
+  for (auto input_index : graph->parameter_inputs_) {
+    if (input_index < 0) {
+      XLA_CHECK(weights_it != weights_data.end())
+          << "Missing exported graph weights: " << path;
+      graph->parameters_data_.push_back(std::move(*weights_it));
+      ++weights_it;
+    } else {
+      XLA_CHECK_LT(input_index, graph->input_shapes_.size());
+      graph->parameters_data_.push_back(nullptr);
+    }
+  }
+  XLA_CHECK(weights_it == weights_data.end())
+      << "Unused exported graph weights: " << path;
+  return graph;
+}
+
+std::vector<at::Tensor> ExportedGraph::GetHostWeights() const {
+  std::vector<xla::ComputationClient::DataPtr> weights_data;
+  std::vector<at::ScalarType> weights_types;
+  for (auto& data : parameters_data_) {
+    if (data != nullptr) {
+      weights_data.push_back(data);
+      weights_types.push_back(
+          TensorTypeFromXlaType(data->shape().element_type()));
+    }
+  }
+  return XlaDataToTensors(weights_data, weights_types);
+}
+
+xla::int64 ExportedGraph::weights_bytes() const {
+  xla::int64 bytes = 0;
+  for (auto& data : parameters_data_) {
+    if (data != nullptr) {
+      bytes += xla::ShapeUtil::ByteSizeOf(data->shape());
+    }
+  }
+  return bytes;
+}
+
+std::vector<xla::ComputationClient::DataPtr> ExportedGraph::Execute(
+    absl::Span<const xla::ComputationClient::DataPtr> inputs) const {
+  XLA_CHECK_EQ(inputs.size(), input_shapes_.size());
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    XLA_CHECK(xla::ShapeUtil::Compatible(inputs[i]->shape(), input_shapes_[i]))
+        << "Input " << i << " shape " << inputs[i]->shape()
+        << " does not match the exported " << input_shapes_[i];
+  }
+  std::vector<xla::ComputationClient::DataPtr> parameters_data =
+      parameters_data_;
+  for (size_t i = 0; i < parameters_data.size(); ++i) {
+    if (parameter_inputs_[i] >= 0) {
+      parameters_data[i] = inputs[parameter_inputs_[i]];
+    }
+  }
+  XLA_COUNTER("ExportedGraphExecutions", 1);
+  return xla::ComputationClient::Get()->ExecuteComputation(
+      *computation_, parameters_data, device_.ToString(),
+      xla::ComputationClient::ExecuteComputationOptions());
+}
+
+}  // namespace torch_xla
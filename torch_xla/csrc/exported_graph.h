@@ -0,0 +1,68 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/compiler/xla/shape.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+#include "torch_xla/csrc/device.h"
+#include "torch_xla/csrc/tensor.h"
+
+namespace torch_xla {
+
+// Inference graph exported for serving. The export directory holds the HLO
+// module of a captured graph, the feeding of its parameters, and the device
+// data captured at trace time (the model weights) in the TensorCheckpoint
+// format. Loading an exported graph only compiles the HLO module and uploads
+// the weights, so no model code, tracing or IR lowering is involved, and every
+// Execute() is a straight computation execution.
+class ExportedGraph {
+ public:
+  // Writes the captured graph into the path directory, spreading its weights
+  // over num_shards checkpoint shards.
+  static void Save(const std::string& path,
+                   const XLATensor::CapturedGraph& graph, size_t num_shards);
+
+  // Loads the graph exported at path, compiling it and uploading its weights
+  // onto the device. If host_weights is not null, the weights are uploaded
+  // from it (as returned by GetHostWeights()) instead of being read from the
+  // export directory.
+  static std::shared_ptr<ExportedGraph> Load(
+      const std::string& path, const Device& device,
+      const std::vector<at::Tensor>* host_weights = nullptr);
+
+  // Runs the graph over the inputs data, whose shapes must match the ones
+  // seen at capture time, and returns the outputs data.
+  std::vector<xla::ComputationClient::DataPtr> Execute(
+      absl::Span<const xla::ComputationClient::DataPtr> inputs) const;
+
+  // Downloads the weights into host tensors.
+  std::vector<at::Tensor> GetHostWeights() const;
+
+  // The device memory held by the weights.
+  xla::int64 weights_bytes() const;
+
+  const Device& device() const { return device_; }
+
+  const std::vector<xla::Shape>& input_shapes() const { return input_shapes_; }
+
+  const std::vector<at::ScalarType>& output_types() const {
+    return output_types_;
+  }
+
+ private:
+  explicit ExportedGraph(Device device) : device_(std::move(device)) {}
+
+  Device device_;
+  std::shared_ptr<xla::ComputationClient::Computation> computation_;
+  // The weights feeding the computation parameters, or null for the ones fed
+  // by the inputs.
+  std::vector<xla::ComputationClient::DataPtr> parameters_data_;
+  // For each parameter, the index of the input feeding it, or -1.
+  std::vector<xla::int64> parameter_inputs_;
+  std::vector<xla::Shape> input_shapes_;
+  std::vector<at::ScalarType> output_types_;
+};
+
+}  // namespace torch_xla
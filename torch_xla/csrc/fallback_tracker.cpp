@@ -0,0 +1,117 @@
+#include "torch_xla/csrc/fallback_tracker.h"
+
+#include <mutex>
+#include <sstream>
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "torch_xla/csrc/python_util.h"
+
+namespace torch_xla {
+namespace {
+
+struct ThreadState {
+  FallbackScope* scope = nullptr;
+  int strict_depth = 0;
+};
+
+thread_local ThreadState g_tls_state;
+
+std::mutex g_stats_mutex;
+std::map<std::string, FallbackStats>* g_stats =
+    new std::map<std::string, FallbackStats>();
+
+std::string GetTriggeringFrame() {
+  auto frame = GetPythonFrameTop();
+  if (!frame) {
+    return "<unknown>";
+  }
+  return absl::StrCat(frame->function, " (", frame->file, ":", frame->line,
+                      ")");
+}
+
+}  // namespace
+
+FallbackScope::FallbackScope(const char* name) : name_(name) {
+  if (g_tls_state.scope != nullptr) {
+    return;
+  }
+  if (g_tls_state.strict_depth > 0) {
+    std::stringstream ss;
+    ss << GetPythonFrames();
+    XLA_ERROR() << "CPU fallback of " << name_
+                << " within a strict fallback region\n"
+                << ss.str();
+  }
+  frame_ = GetTriggeringFrame();
+  active_ = true;
+  start_ns_ = xla::sys_util::NowNs();
+  g_tls_state.scope = this;
+}
+
+FallbackScope::~FallbackScope() {
+  if (!active_) {
+    return;
+  }
+  g_tls_state.scope = nullptr;
+  xla::int64 elapsed_ns = xla::sys_util::NowNs() - start_ns_;
+  std::lock_guard<std::mutex> lock(g_stats_mutex);
+  FallbackStats& stats = (*g_stats)[name_];
+  stats.count += 1;
+  stats.bytes_to_host += bytes_to_host_;
+  stats.bytes_to_device += bytes_to_device_;
+  stats.time_ns += elapsed_ns;
+  stats.frames[frame_] += 1;
+}
+
+void FallbackScope::AddBytesToHost(xla::int64 bytes) {
+  if (g_tls_state.scope != nullptr) {
+    g_tls_state.scope->bytes_to_host_ += bytes;
+  }
+}
+
+void FallbackScope::AddBytesToDevice(xla::int64 bytes) {
+  if (g_tls_state.scope != nullptr) {
+    g_tls_state.scope->bytes_to_device_ += bytes;
+  }
+}
+
+void EnterFallbackStrictRegion() { g_tls_state.strict_depth += 1; }
+
+void ExitFallbackStrictRegion() {
+  XLA_CHECK_GT(g_tls_state.strict_depth, 0);
+  g_tls_state.strict_depth -= 1;
+}
+
+std::map<std::string, FallbackStats> GetFallbackStats() {
+  std::lock_guard<std::mutex> lock(g_stats_mutex);
+  return *g_stats;
+}
+
+void ResetFallbackStats() {
+  std::lock_guard<std::mutex> lock(g_stats_mutex);
+  g_stats->clear();
+}
+
+std::string CreateFallbackReport() {
+  std::stringstream ss;
+  for (auto& name_stats : GetFallbackStats()) {
+    const FallbackStats& stats = name_stats.second;
+    ss << "Fallback: " << name_stats.first << "\n";
+    ss << "  Count: " << stats.count << "\n";
+    ss << "  Time: " << xla::metrics::MetricFnTime(stats.time_ns) << "\n";
+    ss << "  BytesToHost: " << xla::metrics::MetricFnBytes(stats.bytes_to_host)
+       << "\n";
+    ss << "  BytesToDevice: "
+       << xla::metrics::MetricFnBytes(stats.bytes_to_device) << "\n";
+    ss << "  Frames:\n";
+    for (auto& frame_count : stats.frames) {
+      ss << "    " << frame_count.second << "x " << frame_count.first << "\n";
+    }
+  }
+  return ss.str();
+}
+
+}  // namespace torch_xla
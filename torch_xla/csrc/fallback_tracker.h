@@ -0,0 +1,59 @@
+#pragma once
+
+#include <map>
+#include <string>
+
+#include "tensorflow/compiler/xla/types.h"
+
+namespace torch_xla {
+
+// Telemetry about the ATEN operations which have no XLA lowering, and are
+// hence executed on CPU, at the cost of a graph sync and host<->device
+// transfers.
+struct FallbackStats {
+  xla::int64 count = 0;
+  xla::int64 bytes_to_host = 0;
+  xla::int64 bytes_to_device = 0;
+  xla::int64 time_ns = 0;
+  // Maps the "function (file:line)" Python location which triggered the
+  // fallback, to the number of times it did.
+  std::map<std::string, xla::int64> frames;
+};
+
+// Wraps the execution of a CPU fallback. Only the outermost scope of a thread
+// is accounted, as fallbacks can be nested (a CPU composite calling into other
+// overridden ops).
+class FallbackScope {
+ public:
+  explicit FallbackScope(const char* name);
+
+  ~FallbackScope();
+
+  // Accounts the bytes moved by the transfers issued by the fallback currently
+  // running on the calling thread (if any).
+  static void AddBytesToHost(xla::int64 bytes);
+
+  static void AddBytesToDevice(xla::int64 bytes);
+
+ private:
+  const char* name_;
+  bool active_ = false;
+  xla::int64 start_ns_ = 0;
+  xla::int64 bytes_to_host_ = 0;
+  xla::int64 bytes_to_device_ = 0;
+  std::string frame_;
+};
+
+// Within a strict region, any CPU fallback raises an error instead of being
+// executed. Regions are per thread, and can be nested.
+void EnterFallbackStrictRegion();
+
+void ExitFallbackStrictRegion();
+
+std::map<std::string, FallbackStats> GetFallbackStats();
+
+void ResetFallbackStats();
+
+std::string CreateFallbackReport();
+
+}  // namespace torch_xla
@@ -0,0 +1,165 @@
+#include "torch_xla/csrc/graph_partitioner.h"
+
+#include <limits>
+#include <set>
+#include <unordered_map>
+
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+
+namespace torch_xla {
+namespace ir {
+namespace {
+
+// The fraction of the partition budget after which the partitioner starts
+// looking for the cheapest cut.
+static const double kCutWindowStart = 0.75;
+static const double kFlopsPerCostUnit = 1 << 20;
+
+double ShapeElements(const xla::Shape& shape) {
+  if (shape.IsTuple()) {
+    double elements = 0;
+    for (auto& element_shape : shape.tuple_shapes()) {
+      elements += ShapeElements(element_shape);
+    }
+    return elements;
+  }
+  return shape.IsArray() ? xla::ShapeUtil::ElementsIn(shape) : 0;
+}
+
+double ShapeBytes(const xla::Shape& shape) {
+  if (shape.IsTuple()) {
+    double bytes = 0;
+    for (auto& element_shape : shape.tuple_shapes()) {
+      bytes += ShapeBytes(element_shape);
+    }
+    return bytes;
+  }
+  return shape.IsArray() ? xla::ShapeUtil::ByteSizeOfElements(shape) : 0;
+}
+
+// Returns the number of multiply-adds contributing to each output element. Only
+// the contraction ops have a size dependent value, as they dominate the
+// compilation and execution cost of the graphs they belong to.
+double ContractionSize(const Node* node) {
+  if (node->op() == OpKind(at::aten::mm) ||
+      node->op() == OpKind(at::aten::addmm) ||
+      node->op() == OpKind(at::aten::matmul)) {
+    const xla::Shape& shape = node->operand(0).shape();
+    return shape.rank() > 0 ? shape.dimensions(shape.rank() - 1) : 1;
+  }
+  if (node->op() == OpKind(at::aten::convolution_overrideable) ||
+      node->op() == OpKind(at::aten::convolution_backward_overrideable)) {
+    // The weight is the second operand of the forward convolution, and the
+    // third of the backward one.
+    size_t weight_index = node->operands().size() > 2 ? 2 : 1;
+    const xla::Shape& shape = node->operand(weight_index).shape();
+    return shape.rank() > 0 && shape.dimensions(0) > 0
+               ? ShapeElements(shape) / shape.dimensions(0)
+               : 1;
+  }
+  return 1;
+}
+
+}  // namespace
+
+double GraphPartitioner::NodeCost(const Node* node) {
+  if (node->operands().empty()) {
+    return 0;
+  }
+  double flops = ShapeElements(node->shape()) * ContractionSize(node);
+  return 1 + flops / kFlopsPerCostUnit;
+}
+
+std::vector<GraphPartition> GraphPartitioner::Partition(
+    absl::Span<const Node* const> post_order, double budget) {
+  XLA_CHECK_GT(budget, 0);
+  size_t num_nodes = post_order.size();
+  std::unordered_map<const Node*, size_t> positions;
+  positions.reserve(num_nodes);
+  for (size_t i = 0; i < num_nodes; ++i) {
+    positions.emplace(post_order[i], i);
+  }
+  // Uses from nodes which are not part of the post-order (like pending graphs
+  // of other tensors) are ignored.
+  std::vector<size_t> last_use(num_nodes, 0);
+  std::vector<double> costs(num_nodes);
+  std::vector<double> bytes(num_nodes);
+  for (size_t i = 0; i < num_nodes; ++i) {
+    const Node* node = post_order[i];
+    for (auto& use : node->uses()) {
+      auto it = positions.find(use.node);
+      if (it != positions.end() && it->second > last_use[i]) {
+        last_use[i] = it->second;
+      }
+    }
+    costs[i] = NodeCost(node);
+    bytes[i] = node->operands().empty() ? 0 : ShapeBytes(node->shape());
+  }
+
+  std::vector<GraphPartition> partitions;
+  // The bytes of the values of the current partition whose last use is at a
+  // given position.
+  std::vector<double> releases(num_nodes, 0);
+  std::vector<size_t> release_positions;
+  size_t start = 0;
+  while (start < num_nodes) {
+    double cost = 0;
+    double live_bytes = 0;
+    double best_live_bytes = std::numeric_limits<double>::max();
+    size_t best_cut = num_nodes;
+    size_t end = num_nodes;
+    for (size_t i = start; i < num_nodes; ++i) {
+      if (cost + costs[i] > budget && i > start) {
+        end = best_cut < num_nodes ? best_cut + 1 : i;
+        break;
+      }
+      cost += costs[i];
+      if (bytes[i] > 0 && last_use[i] > i) {
+        live_bytes += bytes[i];
+        releases[last_use[i]] += bytes[i];
+        release_positions.push_back(last_use[i]);
+      }
+      live_bytes -= releases[i];
+      // Prefer later cuts on ties, to produce fewer partitions.
+      if (cost >= kCutWindowStart * budget && live_bytes <= best_live_bytes) {
+        best_live_bytes = live_bytes;
+        best_cut = i;
+      }
+    }
+    for (auto position : release_positions) {
+      releases[position] = 0;
+    }
+    release_positions.clear();
+
+    GraphPartition partition;
+    partition.begin = start;
+    partition.end = end;
+    for (size_t i = start; i < end; ++i) {
+      partition.cost += costs[i];
+      const Node* node = post_order[i];
+      if (node->operands().empty() || last_use[i] < end) {
+        continue;
+      }
+      // Non array outputs (like tokens) cannot be materialized, so those are
+      // left to be recomputed by the later partitions using them.
+      std::set<size_t> indices;
+      for (auto& use : node->uses()) {
+        auto it = positions.find(use.node);
+        if (it != positions.end() && it->second >= end &&
+            node->shape(use.index).IsArray()) {
+          indices.insert(use.index);
+        }
+      }
+      for (auto index : indices) {
+        partition.outputs.emplace_back(node, index);
+      }
+    }
+    partitions.push_back(std::move(partition));
+    start = end;
+  }
+  return partitions;
+}
+
+}  // namespace ir
+}  // namespace torch_xla
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+
+#include "absl/types/span.h"
+#include "torch_xla/csrc/ir.h"
+
+namespace torch_xla {
+namespace ir {
+
+// A contiguous range of a graph post-order, which can be lowered and executed
+// once all the partitions before it have been.
+struct GraphPartition {
+  size_t begin = 0;
+  size_t end = 0;
+  double cost = 0;
+  // The outputs of the partition nodes which are used by nodes of later
+  // partitions, sorted by post-order position.
+  std::vector<Output> outputs;
+};
+
+class GraphPartitioner {
+ public:
+  // Estimates the cost of lowering and compiling the node, in node units. Leaf
+  // nodes (device data, constants) have zero cost, while every other node costs
+  // one unit plus one per 2^20 estimated FLOPs.
+  static double NodeCost(const Node* node);
+
+  // Splits the post-order into partitions of at most budget cost (a single
+  // node exceeding the budget gets its own partition). Within the last quarter
+  // of a partition budget, the cut is placed where the bytes of the values
+  // crossing it is minimal. The result only depends on the graph structure and
+  // shapes, so identical graphs are always split at the same boundaries.
+  static std::vector<GraphPartition> Partition(
+      absl::Span<const Node* const> post_order, double budget);
+};
+
+}  // namespace ir
+}  // namespace torch_xla
@@ -0,0 +1,356 @@
+#include "torch_xla/csrc/graph_speculator.h"
+
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <map>
+#include <thread>
+#include <unordered_map>
+
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "torch_xla/csrc/helpers.h"
+#include "torch_xla/csrc/ir_util.h"
+#include "torch_xla/csrc/lowering_context.h"
+#include "torch_xla/csrc/ops/device_data.h"
+
+namespace torch_xla {
+namespace {
+
+// The device data of the speculated graphs, which only holds a shape. It is
+// only used to lower the graphs, which need the shapes and distinct handles.
+class SpeculativeData : public xla::ComputationClient::Data {
+ public:
+  SpeculativeData(std::string device, xla::Shape shape)
+      : Data(std::move(device), std::move(shape)), handle_(NextHandle()) {}
+
+  OpaqueHandle GetOpaqueHandle() override { return handle_; }
+
+  void Assign(const Data& data) override {
+    XLA_ERROR() << "Speculative data cannot be assigned";
+  }
+
+  bool HasValue() const override { return false; }
+
+ private:
+  // Negative, so that they never clash with the device handles.
+  static OpaqueHandle NextHandle() {
+    static std::atomic<OpaqueHandle> next_handle(-1);
+    return next_handle--;
+  }
+
+  OpaqueHandle handle_;
+};
+
+// The signature of a graph covers the nodes (with their attributes) and the
+// topology, but not the shapes of the device data nodes.
+xla::hash_t ComputeSignature(
+    absl::Span<const ir::Node* const> post_order,
+    absl::Span<const ir::Value> roots,
+    const std::unordered_map<const ir::Node*, size_t>& node_to_index) {
+  xla::hash_t signature = xla::util::MHash(post_order.size());
+  for (auto node : post_order) {
+    if (ir::ops::DeviceData::Cast(node) != nullptr) {
+      signature = xla::util::HashCombine(signature, node->op().hash());
+      continue;
+    }
+    // The hash of leaf nodes also covers their shapes, which do not vary.
+    signature = xla::util::HashCombine(signature, node->node_hash());
+    for (auto& operand : node->operands()) {
+      signature = xla::util::HashCombine(
+          signature,
+          xla::util::MHash(node_to_index.at(operand.node), operand.index));
+    }
+  }
+  for (auto& root : roots) {
+    signature = xla::util::HashCombine(
+        signature, xla::util::MHash(node_to_index.at(root.node.get()),
+                                    root.index));
+  }
+  return signature;
+}
+
+struct SizeChange {
+  xla::int64 from = 0;
+  xla::int64 to = 0;
+  // The (device data node, dimension) positions holding the size.
+  std::vector<std::pair<size_t, xla::int64>> positions;
+};
+
+// Returns the change between the input shapes of two graphs with the same
+// signature, if a single size changed.
+absl::optional<SizeChange> DiffInputShapes(
+    absl::Span<const xla::Shape> last_shapes,
+    absl::Span<const xla::Shape> shapes) {
+  SizeChange change;
+  for (size_t i = 0; i < shapes.size(); ++i) {
+    if (shapes[i].IsTuple() || last_shapes[i].IsTuple() ||
+        shapes[i].element_type() != last_shapes[i].element_type() ||
+        shapes[i].rank() != last_shapes[i].rank()) {
+      return absl::nullopt;
+    }
+    for (xla::int64 dim = 0; dim < shapes[i].rank(); ++dim) {
+      xla::int64 from = last_shapes[i].dimensions(dim);
+      xla::int64 to = shapes[i].dimensions(dim);
+      if (from == to) {
+        continue;
+      }
+      if (change.positions.empty()) {
+        change.from = from;
+        change.to = to;
+      } else if (change.from != from || change.to != to) {
+        return absl::nullopt;
+      }
+      change.positions.emplace_back(i, dim);
+    }
+  }
+  if (change.positions.empty()) {
+    return absl::nullopt;
+  }
+  return change;
+}
+
+// Clones the graph replacing the device data with speculative data of the
+// given shapes, indexed by the post-order position of the device data nodes.
+std::vector<ir::Value> CloneGraph(
+    absl::Span<const ir::Node* const> post_order,
+    absl::Span<const ir::Value> roots,
+    const std::unordered_map<const ir::Node*, size_t>& node_to_index,
+    const std::map<size_t, xla::Shape>& data_shapes) {
+  std::vector<ir::NodePtr> clones(post_order.size());
+  // Keyed by handle, the same way the graph parameters are deduplicated.
+  std::unordered_map<xla::ComputationClient::Data::OpaqueHandle,
+                     xla::ComputationClient::DataPtr>
+      datas;
+  for (size_t i = 0; i < post_order.size(); ++i) {
+    const ir::Node* node = post_order[i];
+    const ir::ops::DeviceData* device_data = ir::ops::DeviceData::Cast(node);
+    if (device_data != nullptr) {
+      const xla::ComputationClient::DataPtr& source = device_data->data();
+      xla::ComputationClient::DataPtr& data =
+          datas[source->GetOpaqueHandle()];
+      if (data == nullptr) {
+        data = std::make_shared<SpeculativeData>(source->device(),
+                                                 data_shapes.at(i));
+      }
+      clones[i] = ir::MakeNode<ir::ops::DeviceData>(data);
+      continue;
+    }
+    std::vector<ir::Value> operands;
+    for (auto& operand : node->operands()) {
+      operands.emplace_back(clones[node_to_index.at(operand.node)],
+                            operand.index);
+    }
+    clones[i] = node->Clone(operands);
+  }
+  std::vector<ir::Value> cloned_roots;
+  for (auto& root : roots) {
+    cloned_roots.emplace_back(clones[node_to_index.at(root.node.get())],
+                              root.index);
+  }
+  return cloned_roots;
+}
+
+void LowerPriority() {
+  // On Linux the nice value is per thread, so the speculative compilations
+  // yield the CPU to the training threads.
+  setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+}
+
+}  // namespace
+
+GraphSpeculator* GraphSpeculator::Get() {
+  static GraphSpeculator* speculator = []() -> GraphSpeculator* {
+    xla::int64 num_variants =
+        xla::sys_util::GetEnvInt("XLA_SPECULATIVE_COMPILE", 0);
+    return num_variants > 0 ? new GraphSpeculator(num_variants) : nullptr;
+  }();
+  return speculator;
+}
+
+GraphSpeculator::GraphSpeculator(size_t num_variants)
+    : num_variants_(num_variants), input_shapes_(1024) {}
+
+void GraphSpeculator::AddCompiledGraph(const CompiledGraph& graph) {
+  if (graph.post_order.empty()) {
+    // The graph computation came from the persistent cache, without walking
+    // the IR graph.
+    return;
+  }
+  std::unordered_map<const ir::Node*, size_t> node_to_index;
+  node_to_index.reserve(graph.post_order.size());
+  auto shapes = std::make_shared<std::vector<xla::Shape>>();
+  std::vector<size_t> data_indices;
+  for (size_t i = 0; i < graph.post_order.size(); ++i) {
+    node_to_index[graph.post_order[i]] = i;
+    if (ir::ops::DeviceData::Cast(graph.post_order[i]) != nullptr) {
+      shapes->push_back(graph.post_order[i]->shape());
+      data_indices.push_back(i);
+    }
+  }
+  xla::hash_t signature = xla::util::MHash(
+      ComputeSignature(graph.post_order, graph.roots, node_to_index),
+      graph.force_xla_data, graph.device.ToString());
+  std::shared_ptr<std::vector<xla::Shape>> last_shapes =
+      input_shapes_.Get(signature);
+  input_shapes_.Erase(signature);
+  input_shapes_.Add(signature, shapes);
+  if (last_shapes == nullptr) {
+    return;
+  }
+  absl::optional<SizeChange> change = DiffInputShapes(*last_shapes, *shapes);
+  if (!change) {
+    XLA_COUNTER("SpeculativeCompileUnpredictable", 1);
+    return;
+  }
+  xla::int64 step = change->to - change->from;
+  std::string resource_domain =
+      xla::ComputationClient::Get()->GetResourceDomain(
+          graph.device.ToString());
+  for (size_t k = 1; k <= num_variants_; ++k) {
+    xla::int64 size = change->to + k * step;
+    if (size <= 0) {
+      break;
+    }
+    std::map<size_t, xla::Shape> data_shapes;
+    for (size_t i = 0; i < data_indices.size(); ++i) {
+      data_shapes.emplace(data_indices[i], (*shapes)[i]);
+    }
+    for (auto& position : change->positions) {
+      data_shapes.at(data_indices[position.first])
+          .set_dimensions(position.second, size);
+    }
+    Variant variant;
+    try {
+      variant.roots = CloneGraph(graph.post_order, graph.roots, node_to_index,
+                                 data_shapes);
+    } catch (const std::exception& ex) {
+      // Some nodes hold attributes which only fit the traced shapes.
+      TF_VLOG(3) << "Speculative graph variant rejected: " << ex.what();
+      XLA_COUNTER("SpeculativeCompileRejected", 1);
+      return;
+    }
+    // Same as the graph hash computed by XLATensor::CollectSyncTensors().
+    variant.hash = xla::util::MHash(graph.force_xla_data);
+    for (auto& root : variant.roots) {
+      variant.hash = xla::util::HashCombine(variant.hash, root.hash());
+    }
+    variant.parameter_sequence.assign(graph.parameter_sequence.begin(),
+                                      graph.parameter_sequence.end());
+    variant.hash = xla::util::HashCombine(
+        xla::util::MHash(variant.hash, resource_domain),
+        xla::util::Hash(variant.parameter_sequence));
+    variant.aliases = graph.aliases;
+    variant.device = graph.device;
+    variant.devices = graph.devices;
+    variant.compile_fn = graph.compile_fn;
+    variant.cached_fn = graph.cached_fn;
+    ScheduleVariant(std::move(variant));
+  }
+}
+
+void GraphSpeculator::AddCacheHit(const xla::hash_t& hash) {
+  std::lock_guard<std::mutex> lock(lock_);
+  if (speculated_.erase(hash) > 0) {
+    XLA_COUNTER("SpeculativeCompileHit", 1);
+  }
+}
+
+void GraphSpeculator::ScheduleVariant(Variant variant) {
+  static const size_t max_pending =
+      xla::sys_util::GetEnvInt("XLA_SPECULATIVE_COMPILE_QUEUE", 8);
+  if (variant.cached_fn(variant.hash)) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(lock_);
+  if (speculated_.count(variant.hash) > 0) {
+    return;
+  }
+  if (pending_.size() >= max_pending) {
+    XLA_COUNTER("SpeculativeCompileDropped", 1);
+    return;
+  }
+  if (!thread_started_) {
+    std::thread([this]() { Run(); }).detach();
+    thread_started_ = true;
+  }
+  speculated_.insert(variant.hash);
+  pending_.push_back(std::move(variant));
+  cv_.notify_one();
+}
+
+void GraphSpeculator::CompileVariant(const Variant& variant) {
+  std::vector<const ir::Node*> root_nodes;
+  std::vector<ir::Output> outputs;
+  for (auto& root : variant.roots) {
+    root_nodes.push_back(root.node.get());
+    outputs.push_back(root);
+  }
+  ir::Util::EmissionMap emission_map;
+  std::vector<const ir::Node*> post_order =
+      ir::Util::ComputePostOrder(root_nodes, &emission_map);
+  ir::LoweringContext lowering_ctx("SyncTensorsGraph", variant.device,
+                                   post_order, std::move(emission_map),
+                                   outputs);
+  for (auto& output : outputs) {
+    lowering_ctx.AddResult(lowering_ctx.GetOutputOp(output));
+  }
+  // The IR shapes of every node must match the ones of its lowering, or
+  // the graph would be cached under the hash of a graph which lowers into a
+  // different computation.
+  for (auto node : post_order) {
+    for (size_t i = 0; i < node->num_outputs(); ++i) {
+      xla::XlaOp op = lowering_ctx.GetOutputOp(ir::Output(node, i));
+      const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(op);
+      XLA_CHECK(xla::ShapeUtil::Compatible(shape, node->shape(i)))
+          << "Mismatching shapes for " << node->ToString() << ": " << shape
+          << " vs. " << node->shape(i);
+    }
+  }
+  XLA_CHECK(lowering_ctx.GetParameterSequence() == variant.parameter_sequence);
+  const std::vector<xla::ComputationClient::DataPtr>& parameters_data =
+      lowering_ctx.GetParametersData();
+  for (auto& alias : variant.aliases) {
+    const xla::Shape& root_shape =
+        XlaHelpers::ShapeOfXlaOp(lowering_ctx.GetResult(alias.second));
+    XLA_CHECK(parameters_data.at(alias.first)->shape() == root_shape);
+    lowering_ctx.builder()->SetUpAlias(
+        {static_cast<xla::int64>(alias.second)}, alias.first, {});
+  }
+  xla::XlaComputation computation = ConsumeValue(lowering_ctx.Build());
+  variant.compile_fn(std::move(computation), variant.device, variant.devices,
+                     variant.hash, parameters_data.size());
+}
+
+void GraphSpeculator::Run() {
+  LowerPriority();
+  while (true) {
+    Variant variant;
+    {
+      std::unique_lock<std::mutex> lock(lock_);
+      cv_.wait(lock, [this] { return !pending_.empty(); });
+      variant = std::move(pending_.front());
+      pending_.pop_front();
+    }
+    if (variant.cached_fn(variant.hash)) {
+      continue;
+    }
+    try {
+      XLA_TIMED("SpeculativeCompileTime");
+      CompileVariant(variant);
+      XLA_COUNTER("SpeculativeCompiles", 1);
+    } catch (const std::exception& ex) {
+      TF_VLOG(3) << "Speculative compilation of IR graph hash "
+                 << xla::util::HexHash(variant.hash) << " failed: "
+                 << ex.what();
+      XLA_COUNTER("SpeculativeCompileRejected", 1);
+    }
+  }
+}
+
+}  // namespace torch_xla
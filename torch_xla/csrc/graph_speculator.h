@@ -0,0 +1,97 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/xla/client/xla_computation.h"
+#include "tensorflow/compiler/xla/xla_client/cache.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "torch_xla/csrc/device.h"
+#include "torch_xla/csrc/ir.h"
+
+namespace torch_xla {
+
+// The GraphSpeculator class is a singleton accessible via its Get() API which
+// compiles, in background, the variants of the compiled graphs which are likely
+// to show up next. Graphs sharing a structural signature (same nodes, same
+// attributes and same topology, but possibly different input shapes) are
+// compared by their input shapes, and if a single size changed (like the
+// sequence length going from 128 to 256), the next sizes of the progression
+// (384, 512, ...) are predicted. The variants are created by cloning the IR
+// graph with the predicted input shapes, and are only compiled if the shapes
+// inferred by the IR nodes match the ones of their lowered XLA operations, so
+// that no variant can be cached under the hash of a different graph.
+class GraphSpeculator {
+ public:
+  // Compiles the computation of a variant and adds it to the computation cache.
+  using CompileFn = std::function<void(
+      xla::XlaComputation computation, const Device& device,
+      const std::vector<std::string>& devices, const xla::hash_t& hash,
+      size_t num_parameters)>;
+  // Tells whether the computation cache already holds the given graph hash.
+  using CachedFn = std::function<bool(const xla::hash_t& hash)>;
+
+  struct CompiledGraph {
+    absl::Span<const ir::Node* const> post_order;
+    absl::Span<const ir::Value> roots;
+    absl::Span<const size_t> parameter_sequence;
+    // The (parameter, output) pairs of the aliased buffers.
+    std::vector<std::pair<size_t, size_t>> aliases;
+    bool force_xla_data = false;
+    Device device;
+    std::vector<std::string> devices;
+    CompileFn compile_fn;
+    CachedFn cached_fn;
+  };
+
+  // Returns nullptr unless XLA_SPECULATIVE_COMPILE is set to the number of
+  // variants to predict for every varying graph.
+  static GraphSpeculator* Get();
+
+  explicit GraphSpeculator(size_t num_variants);
+
+  // Records a graph which missed the computation cache, and schedules the
+  // compilation of its predicted variants.
+  void AddCompiledGraph(const CompiledGraph& graph);
+
+  // Accounts the computation cache hits of the speculated graphs.
+  void AddCacheHit(const xla::hash_t& hash);
+
+ private:
+  struct Variant {
+    std::vector<ir::Value> roots;
+    std::vector<size_t> parameter_sequence;
+    std::vector<std::pair<size_t, size_t>> aliases;
+    Device device;
+    std::vector<std::string> devices;
+    xla::hash_t hash;
+    CompileFn compile_fn;
+    CachedFn cached_fn;
+  };
+
+  using ShapesCache = xla::util::Cache<xla::hash_t, std::vector<xla::Shape>,
+                                       xla::util::HashReducer>;
+
+  void ScheduleVariant(Variant variant);
+
+  void CompileVariant(const Variant& variant);
+
+  void Run();
+
+  size_t num_variants_;
+  // The input shapes of the last compiled graph of every signature.
+  ShapesCache input_shapes_;
+  std::mutex lock_;
+  std::condition_variable cv_;
+  std::deque<Variant> pending_;
+  std::unordered_set<xla::hash_t, xla::util::HashReducer> speculated_;
+  bool thread_started_ = false;
+};
+
+}  // namespace torch_xla
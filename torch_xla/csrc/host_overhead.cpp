@@ -0,0 +1,106 @@
+#include "torch_xla/csrc/host_overhead.h"
+
+#include <array>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+
+namespace torch_xla {
+namespace {
+
+constexpr size_t kNumPhases = static_cast<size_t>(HostPhase::kNumPhases);
+
+const char* const kPhaseNames[kNumPhases] = {
+    "Other",       "DeviceLockWait", "CollectSyncTensors", "PostOrder",
+    "CacheLookup", "Compile",        "FetchTensorData",    "Schedule"};
+
+struct ThreadState {
+  HostPhaseTimer* timer = nullptr;
+  std::array<xla::int64, kNumPhases> step_ns = {};
+  bool active = false;
+};
+
+thread_local ThreadState g_tls_state;
+
+xla::metrics::Metric* GetPhaseMetric(size_t phase) {
+  static std::array<xla::metrics::Metric*, kNumPhases>* metrics = []() {
+    auto phase_metrics = new std::array<xla::metrics::Metric*, kNumPhases>();
+    for (size_t i = 0; i < kNumPhases; ++i) {
+      (*phase_metrics)[i] = new xla::metrics::Metric(
+          absl::StrCat("HostOverhead.", kPhaseNames[i]),
+          xla::metrics::MetricFnTime);
+    }
+    return phase_metrics;
+  }();
+  return (*metrics)[phase];
+}
+
+}  // namespace
+
+HostPhaseTimer::HostPhaseTimer(HostPhase phase)
+    : phase_(phase),
+      parent_(g_tls_state.timer),
+      start_ns_(xla::sys_util::NowNs()) {
+  g_tls_state.timer = this;
+}
+
+HostPhaseTimer::~HostPhaseTimer() {
+  xla::int64 elapsed_ns = xla::sys_util::NowNs() - start_ns_;
+  g_tls_state.timer = parent_;
+  if (parent_ != nullptr) {
+    parent_->nested_ns_ += elapsed_ns;
+  }
+  g_tls_state.step_ns[static_cast<size_t>(phase_)] += elapsed_ns - nested_ns_;
+  g_tls_state.active = true;
+}
+
+void MarkHostOverheadStep() {
+  ThreadState& state = g_tls_state;
+  if (!state.active) {
+    return;
+  }
+  // All the phases get a sample, even if zero, so that the metrics averages
+  // are per step ones.
+  for (size_t i = 0; i < kNumPhases; ++i) {
+    GetPhaseMetric(i)->AddSample(state.step_ns[i]);
+    state.step_ns[i] = 0;
+  }
+  state.active = false;
+}
+
+std::string CreateHostOverheadReport() {
+  std::array<double, kNumPhases> means = {};
+  double total_mean = 0.0;
+  size_t num_steps = 0;
+  for (size_t i = 0; i < kNumPhases; ++i) {
+    double accumulator = 0.0;
+    size_t total_samples = 0;
+    GetPhaseMetric(i)->Samples(&accumulator, &total_samples);
+    if (total_samples > 0) {
+      means[i] = accumulator / total_samples;
+      total_mean += means[i];
+      num_steps = total_samples;
+    }
+  }
+  if (num_steps == 0) {
+    return "";
+  }
+  std::stringstream ss;
+  ss << "Host Overhead Breakdown:\n";
+  ss << "  Steps: " << num_steps << "\n";
+  ss << "  TotalPerStep: " << xla::metrics::MetricFnTime(total_mean) << "\n";
+  for (size_t i = 0; i < kNumPhases; ++i) {
+    double share = total_mean > 0 ? 100.0 * means[i] / total_mean : 0.0;
+    ss << "  " << kPhaseNames[i] << ": "
+       << xla::metrics::MetricFnTime(means[i]) << " (" << std::fixed
+       << std::setprecision(1) << share << "%)\n";
+    ss.unsetf(std::ios_base::fixed);
+  }
+  return ss.str();
+}
+
+}  // namespace torch_xla
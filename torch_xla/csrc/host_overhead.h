@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+
+#include "tensorflow/compiler/xla/types.h"
+
+namespace torch_xla {
+
+// The host side phases of a graph sync. On a compilation cache hit, these are
+// the whole per step cost paid by the framework on top of the device
+// execution.
+enum class HostPhase {
+  // The time within a graph sync not accounted to any of the finer phases.
+  kOther,
+  kDeviceLockWait,
+  // Collecting the tensors to sync and hashing their pending graphs.
+  kCollectSyncTensors,
+  // Walking the graph to collect the device data parameters.
+  kPostOrder,
+  kCacheLookup,
+  kCompile,
+  kFetchTensorData,
+  // Materializing deferred parameters and queueing the execution.
+  kSchedule,
+  kNumPhases,
+};
+
+// Accounts the time spent within its scope to the given phase, for the step
+// currently running on the calling thread. Timers can be nested, in which case
+// the time spent within the inner timers is only accounted to their phases, so
+// that the phase totals of a step add up to its overall host overhead.
+class HostPhaseTimer {
+ public:
+  explicit HostPhaseTimer(HostPhase phase);
+
+  ~HostPhaseTimer();
+
+ private:
+  HostPhase phase_;
+  HostPhaseTimer* parent_;
+  xla::int64 start_ns_;
+  xla::int64 nested_ns_ = 0;
+};
+
+// Closes the step running on the calling thread, recording its per phase
+// totals into the HostOverhead.* metrics.
+void MarkHostOverheadStep();
+
+// Returns the per step breakdown of the host overhead, as a section to be
+// appended to the metrics report.
+std::string CreateHostOverheadReport();
+
+}  // namespace torch_xla
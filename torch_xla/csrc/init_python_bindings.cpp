@@ -1,6 +1,8 @@
 #include <c10/core/Device.h>
 #include <c10/util/Optional.h>
 
+#include <atomic>
+#include <cctype>
 #include <cstring>
 #include <sstream>
 #include <string>
@@ -14,6 +16,7 @@
 #include "tensorflow/compiler/xla/xla_client/metrics_reader.h"
 #include "tensorflow/compiler/xla/xla_client/multi_wait.h"
 #include "tensorflow/compiler/xla/xla_client/record_reader.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/xla/xla_client/thread_pool.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
 #include "tensorflow/compiler/xla/xla_client/xla_util.h"
@@ -25,18 +28,36 @@
 #include "torch/csrc/jit/python/pybind.h"
 #include "torch_xla/csrc/aten_xla_bridge.h"
 #include "torch_xla/csrc/aten_xla_type.h"
+#include "torch_xla/csrc/autocast_policy.h"
+#include "torch_xla/csrc/batching_executor.h"
+#include "torch_xla/csrc/blocking_queue.h"
 #include "torch_xla/csrc/computation.h"
+#include "torch_xla/csrc/custom_kernels.h"
+#include "torch_xla/csrc/data_loader.h"
+#include "torch_xla/csrc/debug_util.h"
 #include "torch_xla/csrc/device.h"
+#include "torch_xla/csrc/exported_graph.h"
+#include "torch_xla/csrc/fallback_tracker.h"
 #include "torch_xla/csrc/helpers.h"
+#include "torch_xla/csrc/host_overhead.h"
 #include "torch_xla/csrc/ir_dump_util.h"
 #include "torch_xla/csrc/ir_util.h"
+#include "torch_xla/csrc/layout_manager.h"
+#include "torch_xla/csrc/model_residency.h"
 #include "torch_xla/csrc/ops/token.h"
 #include "torch_xla/csrc/python_util.h"
+#include "torch_xla/csrc/recompile_analyzer.h"
+#include "torch_xla/csrc/scope_profiler.h"
+#include "torch_xla/csrc/shape_bucketing.h"
+#include "torch_xla/csrc/shared_batch_ring.h"
+#include "torch_xla/csrc/tensor_checkpoint.h"
 #include "torch_xla/csrc/tensor_impl.h"
+#include "torch_xla/csrc/tensor_shard.h"
 #include "torch_xla/csrc/tensor_util.h"
 #include "torch_xla/csrc/torch_util.h"
 #include "torch_xla/csrc/version.h"
 #include "torch_xla/csrc/xla_op_builder.h"
+#include "torch_xla/csrc/xla_sharding_util.h"
 
 namespace torch_xla {
 namespace {
@@ -131,6 +152,8 @@ AllReduceType GetReduceType(const std::string& reduce_type) {
     return AllReduceType::kMin;
   } else if (reduce_type == "max") {
     return AllReduceType::kMax;
+  } else if (reduce_type == "sum_bf16") {
+    return AllReduceType::kSumBf16;
   }
   XLA_ERROR() << "Unknown AllReduce type: " << reduce_type;
 }
@@ -197,6 +220,63 @@ std::pair<at::Tensor, std::shared_ptr<ir::Value>> AllToAll(
       std::make_shared<ir::Value>(new_token));
 }
 
+std::pair<at::Tensor, std::shared_ptr<ir::Value>> AllGather(
+    const at::Tensor& input, const std::shared_ptr<ir::Value>& token,
+    xla::int64 dim, xla::int64 shard_count,
+    const std::vector<std::vector<xla::int64>>& replica_groups) {
+  XLATensor result;
+  ir::Value new_token;
+  std::tie(result, new_token) = XLATensor::all_gather(
+      bridge::GetXlaTensor(input), *token, dim, shard_count, replica_groups);
+  return std::pair<at::Tensor, std::shared_ptr<ir::Value>>(
+      bridge::AtenFromXlaTensor(std::move(result)),
+      std::make_shared<ir::Value>(new_token));
+}
+
+std::pair<at::Tensor, std::shared_ptr<ir::Value>> ReduceScatter(
+    const std::string& reduce_type, const at::Tensor& input,
+    const std::shared_ptr<ir::Value>& token, double scale,
+    xla::int64 scatter_dim, xla::int64 shard_count,
+    const std::vector<std::vector<xla::int64>>& replica_groups) {
+  XLATensor result;
+  ir::Value new_token;
+  std::tie(result, new_token) = XLATensor::reduce_scatter(
+      bridge::GetXlaTensor(input), *token, GetReduceType(reduce_type), scale,
+      scatter_dim, shard_count, replica_groups);
+  return std::pair<at::Tensor, std::shared_ptr<ir::Value>>(
+      bridge::AtenFromXlaTensor(std::move(result)),
+      std::make_shared<ir::Value>(new_token));
+}
+
+std::pair<at::Tensor, std::shared_ptr<ir::Value>> ParallelMatMul(
+    bool column_parallel, const at::Tensor& input, const at::Tensor& weight,
+    const py::object& bias, const std::shared_ptr<ir::Value>& token,
+    bool combine_output, xla::int64 shard_count, xla::int64 num_chunks,
+    const std::vector<std::vector<xla::int64>>& replica_groups) {
+  XLATensor xbias;
+  if (!bias.is_none()) {
+    xbias = bridge::GetXlaTensor(bias.cast<at::Tensor>());
+  }
+  XLATensor result;
+  ir::Value new_token;
+  {
+    NoGilSection nogil;
+    std::tie(result, new_token) =
+        column_parallel
+            ? XLATensor::column_parallel_matmul(
+                  bridge::GetXlaTensor(input), bridge::GetXlaTensor(weight),
+                  xbias, *token, combine_output, shard_count, num_chunks,
+                  replica_groups)
+            : XLATensor::row_parallel_matmul(
+                  bridge::GetXlaTensor(input), bridge::GetXlaTensor(weight),
+                  xbias, *token, combine_output, shard_count, num_chunks,
+                  replica_groups);
+  }
+  return std::pair<at::Tensor, std::shared_ptr<ir::Value>>(
+      bridge::AtenFromXlaTensor(std::move(result)),
+      std::make_shared<ir::Value>(new_token));
+}
+
 std::pair<at::Tensor, std::shared_ptr<ir::Value>> CollectivePermute(
     const at::Tensor& input, const std::shared_ptr<ir::Value>& token,
     const std::vector<std::pair<xla::int64, xla::int64>>& source_target_pairs) {
@@ -209,6 +289,67 @@ std::pair<at::Tensor, std::shared_ptr<ir::Value>> CollectivePermute(
       std::make_shared<ir::Value>(new_token));
 }
 
+// The quantization parameters are passed as None, or as a (scale, zero_point)
+// tuple.
+absl::optional<QuantizationParams> GetQuantizationParams(
+    const py::object& params) {
+  if (params.is_none()) {
+    return absl::nullopt;
+  }
+  auto params_tuple = params.cast<py::tuple>();
+  XLA_CHECK_EQ(params_tuple.size(), 2);
+  QuantizationParams quantization_params;
+  quantization_params.scale = params_tuple[0].cast<double>();
+  quantization_params.zero_point = params_tuple[1].cast<xla::int64>();
+  return quantization_params;
+}
+
+at::Tensor QuantizedMatMul(const at::Tensor& input, const at::Tensor& weight,
+                           const at::Tensor& weight_scale,
+                           const at::Tensor& weight_zero_point,
+                           const py::object& bias,
+                           const py::object& input_params,
+                           const py::object& output_params) {
+  XLATensor xbias;
+  if (!bias.is_none()) {
+    xbias = bridge::GetXlaTensor(bias.cast<at::Tensor>());
+  }
+  absl::optional<QuantizationParams> input_qparams =
+      GetQuantizationParams(input_params);
+  absl::optional<QuantizationParams> output_qparams =
+      GetQuantizationParams(output_params);
+  NoGilSection nogil;
+  return bridge::AtenFromXlaTensor(XLATensor::quantized_matmul(
+      bridge::GetXlaTensor(input), bridge::GetXlaTensor(weight),
+      bridge::GetXlaTensor(weight_scale),
+      bridge::GetXlaTensor(weight_zero_point), xbias, input_qparams,
+      output_qparams));
+}
+
+at::Tensor QuantizedConvolution(
+    const at::Tensor& input, const at::Tensor& weight,
+    const at::Tensor& weight_scale, const at::Tensor& weight_zero_point,
+    const py::object& bias, std::vector<xla::int64> stride,
+    std::vector<xla::int64> padding, std::vector<xla::int64> dilation,
+    xla::int64 groups, const py::object& input_params,
+    const py::object& output_params) {
+  XLATensor xbias;
+  if (!bias.is_none()) {
+    xbias = bridge::GetXlaTensor(bias.cast<at::Tensor>());
+  }
+  absl::optional<QuantizationParams> input_qparams =
+      GetQuantizationParams(input_params);
+  absl::optional<QuantizationParams> output_qparams =
+      GetQuantizationParams(output_params);
+  NoGilSection nogil;
+  return bridge::AtenFromXlaTensor(XLATensor::quantized_convolution(
+      bridge::GetXlaTensor(input), bridge::GetXlaTensor(weight),
+      bridge::GetXlaTensor(weight_scale),
+      bridge::GetXlaTensor(weight_zero_point), xbias, std::move(stride),
+      std::move(padding), std::move(dilation), groups, input_qparams,
+      output_qparams));
+}
+
 void SyncTensors(const std::vector<at::Tensor>& tensors,
                  const std::vector<std::string>& devices, bool wait,
                  bool sync_xla_data) {
@@ -231,6 +372,76 @@ void StepMarker(const std::string& device_str,
   XLATensor::MarkStep(device);
 }
 
+// An empty tensors list dry runs the graph of all the live tensors of the
+// current device, like the step barrier would.
+XLATensor::CompilationStats DryRunCompile(
+    const std::vector<at::Tensor>& tensors,
+    const std::vector<std::string>& devices) {
+  std::vector<XLATensor> xtensors;
+  if (tensors.empty()) {
+    Device device = GetDeviceOrCurrent("");
+    xtensors = XLATensor::GetLiveTensors(&device);
+  } else {
+    xtensors = GetXlaTensors(tensors, /*want_all=*/false);
+  }
+  return XLATensor::DryRunCompile(&xtensors, devices);
+}
+
+py::dict CompilationStatsToDict(const XLATensor::CompilationStats& stats) {
+  py::dict stats_dict;
+  stats_dict["hash"] = py::str(xla::util::HexHash(stats.hash));
+  stats_dict["hlo_instructions"] = py::int_(stats.hlo_instructions);
+  stats_dict["num_parameters"] = py::int_(stats.num_parameters);
+  stats_dict["parameters_bytes"] = py::int_(stats.parameters_bytes);
+  stats_dict["num_outputs"] = py::int_(stats.num_outputs);
+  stats_dict["outputs_bytes"] = py::int_(stats.outputs_bytes);
+  stats_dict["num_aliases"] = py::int_(stats.num_aliases);
+  stats_dict["aliased_bytes"] = py::int_(stats.aliased_bytes);
+  stats_dict["peak_bytes"] = py::int_(stats.peak_bytes);
+  stats_dict["compile_time_ns"] = py::int_(stats.compile_time_ns);
+  stats_dict["devices"] = py::cast(stats.devices);
+  return stats_dict;
+}
+
+xla::hash_t ParseHexHash(const std::string& hex_hash) {
+  xla::hash_t hash = 0;
+  for (char c : hex_hash) {
+    int digit = std::isdigit(static_cast<unsigned char>(c))
+                    ? c - '0'
+                    : std::tolower(static_cast<unsigned char>(c)) - 'a' + 10;
+    XLA_CHECK(digit >= 0 && digit < 16) << "Invalid graph hash: " << hex_hash;
+    hash = (hash << 4) | static_cast<xla::uint64>(digit);
+  }
+  return hash;
+}
+
+py::list CompileManifestToList(
+    const std::vector<XLATensor::CompileManifestEntry>& manifest) {
+  py::list entries;
+  for (auto& entry : manifest) {
+    py::dict entry_dict;
+    entry_dict["hash"] = py::str(xla::util::HexHash(entry.hash));
+    entry_dict["device"] = py::str(entry.device);
+    entry_dict["devices"] = py::cast(entry.devices);
+    entries.append(entry_dict);
+  }
+  return entries;
+}
+
+std::vector<XLATensor::CompileManifestEntry> CompileManifestFromList(
+    const py::list& entries) {
+  std::vector<XLATensor::CompileManifestEntry> manifest;
+  for (auto& item : entries) {
+    py::dict entry_dict = item.cast<py::dict>();
+    XLATensor::CompileManifestEntry entry;
+    entry.hash = ParseHexHash(entry_dict["hash"].cast<std::string>());
+    entry.device = entry_dict["device"].cast<std::string>();
+    entry.devices = entry_dict["devices"].cast<std::vector<std::string>>();
+    manifest.push_back(std::move(entry));
+  }
+  return manifest;
+}
+
 void SetRngSeed(xla::uint64 seed, const std::string& device_str) {
   auto opt_device = GetOptionalDevice(device_str);
   const Device* device = opt_device ? &opt_device.value() : nullptr;
@@ -263,8 +474,10 @@ std::string GetLiveTensorsReport(size_t nodes_threshold,
            << ", device=" << tensor.GetDevice()
            << ", ir_nodes=" << post_order.size() << "\n";
         for (size_t i = post_order.size(); i > 0; --i) {
-          if (!post_order[i - 1]->metadata().frame_info.empty()) {
-            ss << post_order[i - 1]->metadata().frame_info;
+          std::vector<SourceLocation> frames =
+              post_order[i - 1]->metadata().GetFrameInfo();
+          if (!frames.empty()) {
+            ss << frames;
             break;
           }
         }
@@ -330,6 +543,21 @@ py::object GetMetricData(const std::string& name) {
   return result;
 }
 
+py::object GetMemoryInfo(const std::string& device_str) {
+  xla::ComputationClient::MemoryInfo mem_info;
+  {
+    NoGilSection nogil;
+    Device device = GetDeviceOrCurrent(device_str);
+    mem_info = xla::ComputationClient::Get()->GetMemoryInfo(device.ToString());
+  }
+  auto py_dict = py::dict();
+  py_dict["live_bytes"] = py::cast(mem_info.live_bytes);
+  py_dict["peak_bytes"] = py::cast(mem_info.peak_bytes);
+  py_dict["free_bytes"] = py::cast(mem_info.free_bytes);
+  py_dict["total_bytes"] = py::cast(mem_info.total_bytes);
+  return py_dict;
+}
+
 py::object GetRevisions() {
   auto py_dict = py::dict();
   py_dict["xla"] = std::string(XLA_GITREV);
@@ -354,10 +582,48 @@ std::vector<py::bytes> Rendezvous(int ordinal, const std::string& tag,
   return payloads;
 }
 
+xla::service::grpc::MeshReduceType GetMeshReduceType(
+    const std::string& reduce_type) {
+  if (reduce_type == "sum") {
+    return xla::service::grpc::MESH_REDUCE_SUM;
+  } else if (reduce_type == "min") {
+    return xla::service::grpc::MESH_REDUCE_MIN;
+  } else if (reduce_type == "max") {
+    return xla::service::grpc::MESH_REDUCE_MAX;
+  }
+  XLA_ERROR() << "Unknown mesh reduce type: " << reduce_type;
+}
+
+std::vector<double> MeshReduce(int ordinal, const std::string& tag,
+                               const std::vector<double>& values,
+                               const std::string& reduce_type,
+                               const std::vector<xla::int64>& replicas) {
+  xla::service::grpc::MeshReduceType mesh_reduce_type =
+      GetMeshReduceType(reduce_type);
+  xla::service::MeshClient* mesh_client = xla::service::MeshClient::Get();
+  if (mesh_client == nullptr) {
+    XLA_CHECK(replicas.empty() || (replicas.size() == 1 && replicas[0] == 0));
+    return values;
+  }
+  return mesh_client->MeshReduce(ordinal, tag, values, mesh_reduce_type,
+                                 replicas);
+}
+
+std::vector<xla::int64> RejoinMesh(int ordinal, const std::string& tag,
+                                   xla::int64 world_size) {
+  xla::service::MeshClient* mesh_client = xla::service::MeshClient::Get();
+  if (mesh_client == nullptr) {
+    XLA_CHECK_EQ(world_size, 1);
+    return {ordinal};
+  }
+  return mesh_client->Rejoin(ordinal, tag, world_size);
+}
+
 std::shared_ptr<xla::util::RecordReader> CreateRecordReader(
-    std::string path, const std::string& compression, xla::int64 buffer_size) {
-  return std::make_shared<xla::util::RecordReader>(std::move(path), compression,
-                                                   buffer_size);
+    std::vector<std::string> paths, const std::string& compression,
+    xla::int64 buffer_size, const xla::util::RecordReader::Options& options) {
+  return std::make_shared<xla::util::RecordReader>(
+      std::move(paths), compression, buffer_size, options);
 }
 
 bool RecordRead(const std::shared_ptr<xla::util::RecordReader>& reader,
@@ -366,42 +632,41 @@ bool RecordRead(const std::shared_ptr<xla::util::RecordReader>& reader,
   return reader->Read(value);
 }
 
-py::object RecordReadExample(
-    const std::shared_ptr<xla::util::RecordReader>& reader) {
+// A parsed TF example feature. Bytes lists with more than one element are
+// returned to Python as lists of tensors.
+struct ExampleFeature {
+  std::string name;
+  std::vector<at::Tensor> tensors;
+  bool is_list = false;
+};
+
+// Parses a TF example into PyTorch CPU tensors. Does not touch Python objects,
+// so it can (and should) be called with the GIL released.
+std::vector<ExampleFeature> ParseExample(
+    const xla::util::RecordReader::Data& value, const std::string& path) {
   auto make_r1_size = [](int64_t size) -> std::vector<int64_t> {
     return std::vector<int64_t>({size});
   };
 
-  xla::util::RecordReader::Data value;
-  if (!RecordRead(reader, &value)) {
-    return py::none();
-  }
   tensorflow::Example exmsg;
   if (!exmsg.ParseFromArray(value.data(), value.size())) {
-    XLA_ERROR() << "Unable to parse TF example from " << reader->path();
+    XLA_ERROR() << "Unable to parse TF example from " << path;
   }
-  auto example = py::dict();
+  std::vector<ExampleFeature> features;
+  features.reserve(exmsg.features().feature().size());
   for (auto& name_feat : exmsg.features().feature()) {
+    ExampleFeature feature;
+    feature.name = name_feat.first;
     switch (name_feat.second.kind_case()) {
       case tensorflow::Feature::kBytesList: {
         const tensorflow::BytesList& bvalue = name_feat.second.bytes_list();
-        if (bvalue.value_size() == 1) {
-          const std::string& svalue = bvalue.value(0);
+        feature.is_list = bvalue.value_size() != 1;
+        for (int i = 0; i < bvalue.value_size(); ++i) {
+          const std::string& svalue = bvalue.value(i);
           at::Tensor data = at::empty(make_r1_size(svalue.size()),
                                       at::TensorOptions(at::kChar));
           std::memcpy(data.data_ptr<int8_t>(), svalue.data(), svalue.size());
-          example[py::str(name_feat.first)] =
-              torch::autograd::make_variable(data);
-        } else {
-          auto tlist = py::list(bvalue.value_size());
-          for (int i = 0; i < bvalue.value_size(); ++i) {
-            const std::string& svalue = bvalue.value(i);
-            at::Tensor data = at::empty(make_r1_size(svalue.size()),
-                                        at::TensorOptions(at::kChar));
-            std::memcpy(data.data_ptr<int8_t>(), svalue.data(), svalue.size());
-            tlist[i] = torch::autograd::make_variable(data);
-          }
-          example[py::str(name_feat.first)] = tlist;
+          feature.tensors.push_back(torch::autograd::make_variable(data));
         }
       } break;
       case tensorflow::Feature::kFloatList: {
@@ -410,8 +675,7 @@ py::object RecordReadExample(
                                     at::TensorOptions(at::kFloat));
         std::memcpy(data.data_ptr<float>(), fvalue.value().data(),
                     fvalue.value_size() * sizeof(float));
-        example[py::str(name_feat.first)] =
-            torch::autograd::make_variable(data);
+        feature.tensors.push_back(torch::autograd::make_variable(data));
       } break;
       case tensorflow::Feature::kInt64List: {
         const tensorflow::Int64List& ivalue = name_feat.second.int64_list();
@@ -419,16 +683,106 @@ py::object RecordReadExample(
                                     at::TensorOptions(at::kLong));
         std::memcpy(data.data_ptr<int64_t>(), ivalue.value().data(),
                     ivalue.value_size() * sizeof(int64_t));
-        example[py::str(name_feat.first)] =
-            torch::autograd::make_variable(data);
+        feature.tensors.push_back(torch::autograd::make_variable(data));
       } break;
       default:
-        XLA_ERROR() << "Unknown data type from " << reader->path();
+        XLA_ERROR() << "Unknown data type from " << path;
+    }
+    features.push_back(std::move(feature));
+  }
+  return features;
+}
+
+py::dict ExampleToDict(const std::vector<ExampleFeature>& features) {
+  auto example = py::dict();
+  for (auto& feature : features) {
+    if (feature.is_list) {
+      auto tlist = py::list(feature.tensors.size());
+      for (size_t i = 0; i < feature.tensors.size(); ++i) {
+        tlist[i] = feature.tensors[i];
+      }
+      example[py::str(feature.name)] = tlist;
+    } else {
+      example[py::str(feature.name)] = feature.tensors.front();
     }
   }
   return example;
 }
 
+py::object RecordReadExample(
+    const std::shared_ptr<xla::util::RecordReader>& reader) {
+  std::vector<ExampleFeature> features;
+  bool has_record = false;
+  {
+    NoGilSection nogil;
+    xla::util::RecordReader::Data value;
+    has_record = reader->Read(&value);
+    if (has_record) {
+      features = ParseExample(value, reader->path());
+    }
+  }
+  if (!has_record) {
+    return py::none();
+  }
+  return ExampleToDict(features);
+}
+
+py::list RecordReadExamples(
+    const std::shared_ptr<xla::util::RecordReader>& reader,
+    size_t max_records) {
+  std::vector<std::vector<ExampleFeature>> examples;
+  {
+    NoGilSection nogil;
+    std::vector<xla::util::RecordReader::Data> records =
+        reader->Read(max_records);
+    examples.reserve(records.size());
+    for (auto& record : records) {
+      examples.push_back(ParseExample(record, reader->path()));
+    }
+  }
+  auto py_examples = py::list(examples.size());
+  for (size_t i = 0; i < examples.size(); ++i) {
+    py_examples[i] = ExampleToDict(examples[i]);
+  }
+  return py_examples;
+}
+
+py::list IndexedRecordReadAt(
+    const std::shared_ptr<xla::util::IndexedRecordReader>& reader,
+    const std::vector<xla::int64>& indices) {
+  std::vector<xla::util::IndexedRecordReader::Data> records;
+  {
+    NoGilSection nogil;
+    records = reader->ReadAt(indices);
+  }
+  auto py_records = py::list(records.size());
+  for (size_t i = 0; i < records.size(); ++i) {
+    py_records[i] = py::bytes(records[i].data(), records[i].size());
+  }
+  return py_records;
+}
+
+py::list IndexedExampleReadAt(
+    const std::shared_ptr<xla::util::IndexedRecordReader>& reader,
+    const std::vector<xla::int64>& indices) {
+  std::vector<std::vector<ExampleFeature>> examples;
+  {
+    NoGilSection nogil;
+    std::vector<xla::util::IndexedRecordReader::Data> records =
+        reader->ReadAt(indices);
+    examples.reserve(records.size());
+    for (size_t i = 0; i < records.size(); ++i) {
+      examples.push_back(ParseExample(
+          records[i], absl::StrCat("record ", indices[i])));
+    }
+  }
+  auto py_examples = py::list(examples.size());
+  for (size_t i = 0; i < examples.size(); ++i) {
+    py_examples[i] = ExampleToDict(examples[i]);
+  }
+  return py_examples;
+}
+
 std::unique_ptr<tensorflow::RandomAccessFile> OpenTfFile(
     const std::string& path) {
   tensorflow::Env* env = tensorflow::Env::Default();
@@ -453,27 +807,40 @@ py::object StatTfFile(const std::string& path) {
 
 py::bytes ReadTfFile(tensorflow::RandomAccessFile* file, uint64_t offset,
                      size_t size) {
-  static const size_t kMinReadSize = 1024 * 1024;
+  // The range is split into stripes, read by up to concurrency tasks on the IO
+  // thread pool, each grabbing the next stripe to be read.
+  static const size_t kStripeSize = xla::sys_util::GetEnvInt(
+      "XLA_TFFILE_READ_STRIPE_SIZE", 8 * 1024 * 1024);
+  static const size_t kConcurrency = xla::sys_util::GetEnvInt(
+      "XLA_TFFILE_READ_CONCURRENCY", std::thread::hardware_concurrency());
   std::unique_ptr<char[]> buffer;
   {
     NoGilSection nogil;
     buffer.reset(new char[size]);
 
-    size_t num_threads = std::max<size_t>(size / kMinReadSize, 1);
-    num_threads =
-        std::min<size_t>(num_threads, std::thread::hardware_concurrency());
-    size_t block_size = size / num_threads;
-
-    xla::util::MultiWait mwait(num_threads);
-    for (size_t i = 0; i < num_threads; ++i) {
-      auto reader = [&, i]() {
-        uint64_t base = static_cast<uint64_t>(i) * block_size;
-        size_t tsize =
-            (i + 1 < num_threads) ? block_size : (size - i * block_size);
-
-        tensorflow::StringPiece result;
-        XLA_CHECK_OK(
-            file->Read(offset + base, tsize, &result, buffer.get() + base));
+    size_t num_stripes = std::max<size_t>(
+        (size + kStripeSize - 1) / kStripeSize, 1);
+    size_t num_tasks =
+        std::min<size_t>(num_stripes, std::max<size_t>(kConcurrency, 1));
+    std::atomic<size_t> next_stripe(0);
+
+    xla::util::MultiWait mwait(num_tasks);
+    for (size_t i = 0; i < num_tasks; ++i) {
+      auto reader = [&]() {
+        for (size_t stripe = next_stripe++; stripe < num_stripes;
+             stripe = next_stripe++) {
+          uint64_t base = static_cast<uint64_t>(stripe) * kStripeSize;
+          size_t ssize = std::min<size_t>(kStripeSize, size - base);
+          tensorflow::StringPiece result;
+          XLA_CHECK_OK(
+              file->Read(offset + base, ssize, &result, buffer.get() + base));
+          XLA_CHECK_EQ(result.size(), ssize);
+          // File systems are allowed to return data not stored in the scratch
+          // buffer.
+          if (result.data() != buffer.get() + base) {
+            std::memcpy(buffer.get() + base, result.data(), ssize);
+          }
+        }
       };
       xla::env::ScheduleIoClosure(mwait.Completer(std::move(reader)));
     }
@@ -521,15 +888,24 @@ void RemoveTfFile(const std::string& path) {
 
 py::object XlaNms(const at::Tensor& boxes, const at::Tensor& scores,
                   const at::Tensor& score_threshold,
-                  const at::Tensor& iou_threshold, xla::int64 output_size) {
+                  const at::Tensor& iou_threshold, xla::int64 output_size,
+                  xla::int64 top_k) {
   at::Tensor selected_indices;
   at::Tensor num_valid;
   {
     NoGilSection nogil;
-    auto nms_result = XLATensor::nms(
-        bridge::GetXlaTensor(boxes), bridge::GetXlaTensor(scores),
-        bridge::GetXlaTensor(score_threshold),
-        bridge::GetXlaTensor(iou_threshold), output_size);
+    XLATensor xboxes = bridge::GetXlaTensor(boxes);
+    XLATensor xscores = bridge::GetXlaTensor(scores);
+    XLATensor xscore_threshold = bridge::GetXlaTensor(score_threshold);
+    XLATensor xiou_threshold = bridge::GetXlaTensor(iou_threshold);
+    // The single problem case without pre-filtering keeps using the original
+    // lowering.
+    auto nms_result =
+        scores.dim() == 1 && top_k <= 0
+            ? XLATensor::nms(xboxes, xscores, xscore_threshold,
+                             xiou_threshold, output_size)
+            : XLATensor::batched_nms(xboxes, xscores, xscore_threshold,
+                                     xiou_threshold, output_size, top_k);
     selected_indices = bridge::AtenFromXlaTensor(std::move(nms_result.first));
     num_valid = bridge::AtenFromXlaTensor(std::move(nms_result.second));
   }
@@ -541,6 +917,201 @@ py::object XlaNms(const at::Tensor& boxes, const at::Tensor& scores,
   return result_tuple;
 }
 
+void AdamStepMulti(const std::vector<at::Tensor>& params,
+                   const std::vector<at::Tensor>& grads,
+                   const std::vector<at::Tensor>& exp_avgs,
+                   const std::vector<at::Tensor>& exp_avg_sqs,
+                   double step_size, double bias_correction2_sqrt,
+                   double beta1, double beta2, double eps,
+                   double weight_decay) {
+  std::vector<XLATensor> xparams = GetXlaTensors(params, /*want_all=*/true);
+  std::vector<XLATensor> xexp_avgs = GetXlaTensors(exp_avgs, /*want_all=*/true);
+  std::vector<XLATensor> xexp_avg_sqs =
+      GetXlaTensors(exp_avg_sqs, /*want_all=*/true);
+  XLATensor::adam_step_multi(&xparams, GetXlaTensors(grads, /*want_all=*/true),
+                             &xexp_avgs, &xexp_avg_sqs, step_size,
+                             bias_correction2_sqrt, beta1, beta2, eps,
+                             weight_decay);
+}
+
+at::Tensor ClipGradNormMulti(const std::vector<at::Tensor>& grads,
+                             double max_norm, double norm_type) {
+  std::vector<XLATensor> xgrads = GetXlaTensors(grads, /*want_all=*/true);
+  return bridge::AtenFromXlaTensor(
+      XLATensor::clip_grad_norm_multi(&xgrads, max_norm, norm_type));
+}
+
+void SgdMomentumStepMulti(const std::vector<at::Tensor>& params,
+                          const std::vector<at::Tensor>& grads,
+                          const std::vector<at::Tensor>& momentum_buffers,
+                          double lr, double momentum, double dampening,
+                          double weight_decay, bool nesterov,
+                          bool init_momentum_buffers) {
+  std::vector<XLATensor> xparams = GetXlaTensors(params, /*want_all=*/true);
+  std::vector<XLATensor> xmomentum_buffers =
+      GetXlaTensors(momentum_buffers, /*want_all=*/true);
+  XLATensor::sgd_momentum_step_multi(
+      &xparams, GetXlaTensors(grads, /*want_all=*/true), &xmomentum_buffers,
+      lr, momentum, dampening, weight_decay, nesterov, init_momentum_buffers);
+}
+
+py::object XlaScaledDotProductAttention(const at::Tensor& query,
+                                        const at::Tensor& key,
+                                        const at::Tensor& value, double scale,
+                                        xla::int64 block_size) {
+  at::Tensor output;
+  at::Tensor logsumexp;
+  {
+    NoGilSection nogil;
+    auto result = XLATensor::scaled_dot_product_attention(
+        bridge::GetXlaTensor(query), bridge::GetXlaTensor(key),
+        bridge::GetXlaTensor(value), scale, block_size);
+    output = bridge::AtenFromXlaTensor(std::move(result.first));
+    logsumexp = bridge::AtenFromXlaTensor(std::move(result.second));
+  }
+  auto result_tuple = py::tuple(2);
+  result_tuple[0] =
+      torch::autograd::make_variable(output, /*requires_grad=*/false);
+  result_tuple[1] =
+      torch::autograd::make_variable(logsumexp, /*requires_grad=*/false);
+  return result_tuple;
+}
+
+py::object XlaCrossEntropy(const at::Tensor& logits, const at::Tensor& labels,
+                           xla::int64 ignore_index, xla::int64 chunk_size) {
+  at::Tensor loss;
+  at::Tensor logsumexp;
+  {
+    NoGilSection nogil;
+    auto result = XLATensor::cross_entropy(bridge::GetXlaTensor(logits),
+                                           bridge::GetXlaTensor(labels),
+                                           ignore_index, chunk_size);
+    loss = bridge::AtenFromXlaTensor(std::move(result.first));
+    logsumexp = bridge::AtenFromXlaTensor(std::move(result.second));
+  }
+  auto result_tuple = py::tuple(2);
+  result_tuple[0] =
+      torch::autograd::make_variable(loss, /*requires_grad=*/false);
+  result_tuple[1] =
+      torch::autograd::make_variable(logsumexp, /*requires_grad=*/false);
+  return result_tuple;
+}
+
+py::object XlaDropout(const at::Tensor& input, double probability) {
+  at::Tensor output;
+  at::Tensor seed;
+  {
+    NoGilSection nogil;
+    auto result = XLATensor::dropout(bridge::GetXlaTensor(input), probability);
+    output = bridge::AtenFromXlaTensor(std::move(result.first));
+    seed = bridge::AtenFromXlaTensor(std::move(result.second));
+  }
+  auto result_tuple = py::tuple(2);
+  result_tuple[0] =
+      torch::autograd::make_variable(output, /*requires_grad=*/false);
+  result_tuple[1] =
+      torch::autograd::make_variable(seed, /*requires_grad=*/false);
+  return result_tuple;
+}
+
+at::Tensor XlaDropoutBackward(const at::Tensor& grad_output,
+                              const at::Tensor& seed, double probability) {
+  at::Tensor grad;
+  {
+    NoGilSection nogil;
+    grad = bridge::AtenFromXlaTensor(XLATensor::dropout_backward(
+        bridge::GetXlaTensor(grad_output), bridge::GetXlaTensor(seed),
+        probability));
+  }
+  return torch::autograd::make_variable(grad, /*requires_grad=*/false);
+}
+
+at::Tensor XlaAssumeUniqueIndices(const at::Tensor& index, bool sorted) {
+  at::Tensor result;
+  {
+    NoGilSection nogil;
+    result = bridge::AtenFromXlaTensor(XLATensor::assume_unique_indices(
+        bridge::GetXlaTensor(index), sorted));
+  }
+  return torch::autograd::make_variable(result, /*requires_grad=*/false);
+}
+
+at::Tensor XlaCrossEntropyBackward(const at::Tensor& grad_output,
+                                   const at::Tensor& logits,
+                                   const at::Tensor& labels,
+                                   const at::Tensor& logsumexp,
+                                   xla::int64 ignore_index,
+                                   xla::int64 chunk_size) {
+  at::Tensor grad;
+  {
+    NoGilSection nogil;
+    grad = bridge::AtenFromXlaTensor(XLATensor::cross_entropy_backward(
+        bridge::GetXlaTensor(grad_output), bridge::GetXlaTensor(logits),
+        bridge::GetXlaTensor(labels), bridge::GetXlaTensor(logsumexp),
+        ignore_index, chunk_size));
+  }
+  return torch::autograd::make_variable(grad, /*requires_grad=*/false);
+}
+
+py::object XlaScaledDotProductAttentionBackward(
+    const at::Tensor& grad_output, const at::Tensor& query,
+    const at::Tensor& key, const at::Tensor& value, const at::Tensor& output,
+    const at::Tensor& logsumexp, double scale, xla::int64 block_size) {
+  std::vector<at::Tensor> grads;
+  {
+    NoGilSection nogil;
+    auto result = XLATensor::scaled_dot_product_attention_backward(
+        bridge::GetXlaTensor(grad_output), bridge::GetXlaTensor(query),
+        bridge::GetXlaTensor(key), bridge::GetXlaTensor(value),
+        bridge::GetXlaTensor(output), bridge::GetXlaTensor(logsumexp), scale,
+        block_size);
+    grads.push_back(bridge::AtenFromXlaTensor(std::move(std::get<0>(result))));
+    grads.push_back(bridge::AtenFromXlaTensor(std::move(std::get<1>(result))));
+    grads.push_back(bridge::AtenFromXlaTensor(std::move(std::get<2>(result))));
+  }
+  auto result_tuple = py::tuple(grads.size());
+  for (size_t i = 0; i < grads.size(); ++i) {
+    result_tuple[i] =
+        torch::autograd::make_variable(grads[i], /*requires_grad=*/false);
+  }
+  return result_tuple;
+}
+
+std::vector<at::Tensor> XlaCustomKernel(const std::string& name,
+                                        const std::vector<at::Tensor>& inputs) {
+  std::vector<XLATensor> xinputs = GetXlaTensors(inputs, /*want_all=*/true);
+  std::vector<XLATensor> xresults = XLATensor::custom_kernel(name, xinputs);
+  std::vector<at::Tensor> results;
+  for (auto& xresult : xresults) {
+    at::Tensor tensor = bridge::AtenFromXlaTensor(std::move(xresult));
+    results.push_back(
+        torch::autograd::make_variable(tensor, /*requires_grad=*/false));
+  }
+  return results;
+}
+
+void RegisterPythonCustomKernel(const std::string& name,
+                                const std::string& target,
+                                const std::string& backend_config,
+                                py::function shape_fn, bool has_side_effect) {
+  CustomKernel kernel;
+  kernel.name = name;
+  kernel.target = target;
+  kernel.backend_config = backend_config;
+  kernel.has_side_effect = has_side_effect;
+  // The shape function runs while tracing, which happens with the GIL
+  // released.
+  kernel.shape_fn = [shape_fn](absl::Span<const xla::Shape> shapes) {
+    py::gil_scoped_acquire gil;
+    py::list py_shapes(shapes.size());
+    for (size_t i = 0; i < shapes.size(); ++i) {
+      py_shapes[i] = op_builder::ShapeToPyShape(shapes[i]);
+    }
+    return op_builder::PyShapeToShape(shape_fn(py_shapes));
+  };
+  CustomKernelRegistry::Get()->Register(std::move(kernel));
+}
+
 std::vector<at::Tensor> XlaUserComputation(
     const std::string& opname, const std::vector<at::Tensor>& inputs,
     ComputationPtr computation) {
@@ -558,7 +1129,8 @@ std::vector<at::Tensor> XlaUserComputation(
 
 ComputationPtr CreateComputation(const std::string& name, xla::XlaOp root) {
   xla::XlaComputation computation = ConsumeValue(root.builder()->Build(root));
-  return std::make_shared<Computation>(name, std::move(computation));
+  return RegisterComputation(
+      std::make_shared<Computation>(name, std::move(computation)));
 }
 
 ComputationPtr CreateComputationFromProto(const std::string& name,
@@ -566,7 +1138,8 @@ ComputationPtr CreateComputationFromProto(const std::string& name,
   xla::HloModuleProto proto;
   proto.ParseFromString(module_proto);
   xla::XlaComputation computation(std::move(proto));
-  return std::make_shared<Computation>(name, std::move(computation));
+  return RegisterComputation(
+      std::make_shared<Computation>(name, std::move(computation)));
 }
 
 xla::Shape GetTensorShape(const at::Tensor& tensor,
@@ -587,12 +1160,98 @@ void InitXlaModuleBindings(py::module m) {
         [](const at::Tensor& tensor, int dim) {
           return GetXlaTensorDimensionSize(tensor, dim);
         });
-  m.def("_xla_nms", [](const at::Tensor& boxes, const at::Tensor& scores,
-                       const at::Tensor& score_threshold,
-                       const at::Tensor& iou_threshold,
-                       xla::int64 output_size) {
-    return XlaNms(boxes, scores, score_threshold, iou_threshold, output_size);
+  m.def("_xla_nms",
+        [](const at::Tensor& boxes, const at::Tensor& scores,
+           const at::Tensor& score_threshold, const at::Tensor& iou_threshold,
+           xla::int64 output_size, xla::int64 top_k) {
+          return XlaNms(boxes, scores, score_threshold, iou_threshold,
+                        output_size, top_k);
+        },
+        py::arg("boxes"), py::arg("scores"), py::arg("score_threshold"),
+        py::arg("iou_threshold"), py::arg("output_size"),
+        py::arg("top_k") = -1);
+  m.def("_xla_assume_unique_indices",
+        [](const at::Tensor& index, bool sorted) {
+          return XlaAssumeUniqueIndices(index, sorted);
+        },
+        py::arg("index"), py::arg("sorted") = false);
+  m.def("_xla_dynamic_update_slice_",
+        [](at::Tensor& input, const at::Tensor& source, const at::Tensor& start,
+           xla::int64 dim) {
+          NoGilSection nogil;
+          XLATensor input_tensor = bridge::GetXlaTensor(input);
+          XLATensor::dynamic_update_slice_(input_tensor,
+                                           bridge::GetXlaTensor(source),
+                                           bridge::GetXlaTensor(start), dim);
+        });
+  m.def("_xla_cross_entropy",
+        [](const at::Tensor& logits, const at::Tensor& labels,
+           xla::int64 ignore_index, xla::int64 chunk_size) {
+          return XlaCrossEntropy(logits, labels, ignore_index, chunk_size);
+        });
+  m.def("_xla_cross_entropy_backward",
+        [](const at::Tensor& grad_output, const at::Tensor& logits,
+           const at::Tensor& labels, const at::Tensor& logsumexp,
+           xla::int64 ignore_index, xla::int64 chunk_size) {
+          return XlaCrossEntropyBackward(grad_output, logits, labels, logsumexp,
+                                         ignore_index, chunk_size);
+        });
+  m.def("_xla_dropout", [](const at::Tensor& input, double probability) {
+    return XlaDropout(input, probability);
   });
+  m.def("_xla_dropout_backward",
+        [](const at::Tensor& grad_output, const at::Tensor& seed,
+           double probability) {
+          return XlaDropoutBackward(grad_output, seed, probability);
+        });
+  m.def("_xla_scaled_dot_product_attention",
+        [](const at::Tensor& query, const at::Tensor& key,
+           const at::Tensor& value, double scale, xla::int64 block_size) {
+          return XlaScaledDotProductAttention(query, key, value, scale,
+                                              block_size);
+        });
+  m.def("_xla_scaled_dot_product_attention_backward",
+        [](const at::Tensor& grad_output, const at::Tensor& query,
+           const at::Tensor& key, const at::Tensor& value,
+           const at::Tensor& output, const at::Tensor& logsumexp, double scale,
+           xla::int64 block_size) {
+          return XlaScaledDotProductAttentionBackward(
+              grad_output, query, key, value, output, logsumexp, scale,
+              block_size);
+        });
+  m.def("_xla_adam_step_multi",
+        [](const std::vector<at::Tensor>& params,
+           const std::vector<at::Tensor>& grads,
+           const std::vector<at::Tensor>& exp_avgs,
+           const std::vector<at::Tensor>& exp_avg_sqs, double step_size,
+           double bias_correction2_sqrt, double beta1, double beta2,
+           double eps, double weight_decay) {
+          NoGilSection nogil;
+          AdamStepMulti(params, grads, exp_avgs, exp_avg_sqs, step_size,
+                        bias_correction2_sqrt, beta1, beta2, eps,
+                        weight_decay);
+        });
+  m.def("_xla_clip_grad_norm_multi",
+        [](const std::vector<at::Tensor>& grads, double max_norm,
+           double norm_type) {
+          at::Tensor result;
+          {
+            NoGilSection nogil;
+            result = ClipGradNormMulti(grads, max_norm, norm_type);
+          }
+          return result;
+        });
+  m.def("_xla_sgd_momentum_step_multi",
+        [](const std::vector<at::Tensor>& params,
+           const std::vector<at::Tensor>& grads,
+           const std::vector<at::Tensor>& momentum_buffers, double lr,
+           double momentum, double dampening, double weight_decay,
+           bool nesterov, bool init_momentum_buffers) {
+          NoGilSection nogil;
+          SgdMomentumStepMulti(params, grads, momentum_buffers, lr, momentum,
+                               dampening, weight_decay, nesterov,
+                               init_momentum_buffers);
+        });
   m.def("_xla_user_computation",
         [](const std::string& opname, const std::vector<at::Tensor>& inputs,
            const ComputationPtr& computation) {
@@ -603,6 +1262,32 @@ void InitXlaModuleBindings(py::module m) {
           }
           return results;
         });
+  m.def("_xla_user_computation_batch",
+        [](const std::string& opname,
+           const std::vector<std::vector<at::Tensor>>& inputs_batch,
+           const ComputationPtr& computation) {
+          std::vector<std::vector<at::Tensor>> results_batch;
+          {
+            NoGilSection nogil;
+            for (auto& inputs : inputs_batch) {
+              results_batch.push_back(
+                  XlaUserComputation(opname, inputs, computation));
+            }
+          }
+          return results_batch;
+        });
+  m.def("_xla_register_custom_kernel", &RegisterPythonCustomKernel,
+        py::arg("name"), py::arg("target"), py::arg("backend_config"),
+        py::arg("shape_fn"), py::arg("has_side_effect") = false);
+  m.def("_xla_custom_kernel",
+        [](const std::string& name, const std::vector<at::Tensor>& inputs) {
+          std::vector<at::Tensor> results;
+          {
+            NoGilSection nogil;
+            results = XlaCustomKernel(name, inputs);
+          }
+          return results;
+        });
   m.def("_get_xla_tensors_dot",
         [](const std::vector<at::Tensor>& tensors) -> std::string {
           auto coverter = [](absl::Span<const ir::Node* const> nodes) {
@@ -636,6 +1321,23 @@ void InitXlaModuleBindings(py::module m) {
     }
     return result;
   });
+  m.def("_xla_pad_to_buckets",
+        [](const std::vector<at::Tensor>& tensors,
+           const std::vector<xla::int64>& dims,
+           const std::vector<xla::int64>& bucket_sizes, at::Scalar value) {
+          ShapeBucketing bucketing(dims, bucket_sizes);
+          std::vector<at::Tensor> padded_tensors;
+          std::vector<at::Tensor> masks;
+          {
+            NoGilSection nogil;
+            for (auto& tensor : tensors) {
+              ShapeBucketing::Result result = bucketing.Pad(tensor, value);
+              padded_tensors.push_back(std::move(result.tensor));
+              masks.push_back(std::move(result.mask));
+            }
+          }
+          return std::make_pair(padded_tensors, masks);
+        });
   m.def("_xla_get_cpu_tensors", [](const std::vector<at::Tensor>& tensors) {
     std::vector<at::Tensor> result;
     {
@@ -650,6 +1352,238 @@ void InitXlaModuleBindings(py::module m) {
     }
     return result;
   });
+  py::class_<XLATensor::AsyncFetch, std::shared_ptr<XLATensor::AsyncFetch>>(
+      m, "AsyncFetch");
+  m.def("_xla_fetch_tensors_async",
+        [](const std::vector<at::Tensor>& tensors) {
+          NoGilSection nogil;
+          std::vector<XLATensor> xtensors =
+              GetXlaTensors(tensors, /*want_all=*/true);
+          return XLATensor::FetchTensorsAsync(&xtensors);
+        });
+  m.def("_xla_wait_fetch",
+        [](const std::shared_ptr<XLATensor::AsyncFetch>& fetch) {
+          std::vector<at::Tensor> result;
+          {
+            NoGilSection nogil;
+            std::vector<at::Tensor> cpu_tensors = fetch->Wait();
+            result.reserve(cpu_tensors.size());
+            for (auto& cpu_tensor : cpu_tensors) {
+              result.push_back(torch::autograd::make_variable(
+                  cpu_tensor, /*requires_grad=*/false));
+            }
+          }
+          return result;
+        });
+  m.def("_xla_fetch_transfer_ns",
+        [](const std::shared_ptr<XLATensor::AsyncFetch>& fetch) {
+          return fetch->transfer_ns;
+        });
+  m.def("_xla_read_slice", [](const at::Tensor& tensor,
+                              const std::vector<xla::int64>& start_indices,
+                              const std::vector<xla::int64>& sizes) {
+    at::Tensor result;
+    {
+      NoGilSection nogil;
+      XLATensor xtensor = bridge::GetXlaTensor(tensor);
+      result = torch::autograd::make_variable(
+          xtensor.ReadSlice(start_indices, sizes), /*requires_grad=*/false);
+    }
+    return result;
+  });
+  py::class_<XLATensor::AsyncUpload, std::shared_ptr<XLATensor::AsyncUpload>>(
+      m, "AsyncUpload");
+  m.def("_xla_upload_tensors_async",
+        [](const std::vector<at::Tensor>& tensors,
+           const std::vector<std::string>& devices) {
+          NoGilSection nogil;
+          std::vector<at::Tensor> cpu_tensors;
+          cpu_tensors.reserve(tensors.size());
+          for (auto& tensor : tensors) {
+            cpu_tensors.push_back(tensor.detach());
+          }
+          return XLATensor::CreateTensorsAsync(std::move(cpu_tensors),
+                                               GetXlaDevices(devices));
+        });
+  m.def("_xla_wait_upload",
+        [](const std::shared_ptr<XLATensor::AsyncUpload>& upload) {
+          std::vector<at::Tensor> result;
+          {
+            NoGilSection nogil;
+            std::vector<XLATensor> xla_tensors = upload->Wait();
+            result.reserve(xla_tensors.size());
+            for (auto& xla_tensor : xla_tensors) {
+              result.push_back(torch::autograd::make_variable(
+                  bridge::AtenFromXlaTensor(std::move(xla_tensor)),
+                  /*requires_grad=*/false));
+            }
+          }
+          return result;
+        });
+  m.def("_xla_upload_transfer_ns",
+        [](const std::shared_ptr<XLATensor::AsyncUpload>& upload) {
+          return upload->transfer_ns;
+        });
+  py::class_<XLATensor::CapturedGraph,
+             std::shared_ptr<XLATensor::CapturedGraph>>(m, "CapturedGraph");
+  m.def("_xla_capture_graph",
+        [](const py::function& fn, const std::vector<at::Tensor>& inputs,
+           const std::vector<std::string>& devices) {
+          std::vector<xla::ComputationClient::DataPtr> inputs_data;
+          {
+            NoGilSection nogil;
+            std::vector<XLATensor> xinputs =
+                GetXlaTensors(inputs, /*want_all=*/true);
+            inputs_data = XLATensor::GetCaptureInputsData(&xinputs);
+          }
+          std::vector<at::Tensor> outputs =
+              fn().cast<std::vector<at::Tensor>>();
+          std::shared_ptr<XLATensor::CapturedGraph> graph;
+          {
+            NoGilSection nogil;
+            std::vector<XLATensor> xoutputs =
+                GetXlaTensors(outputs, /*want_all=*/true);
+            graph = XLATensor::CaptureGraph(inputs_data, &xoutputs,
+                                            GetXlaDevices(devices));
+          }
+          return std::make_pair(graph, outputs);
+        },
+        py::arg("fn"), py::arg("inputs"), py::arg("devices"));
+  m.def("_xla_replay_graph",
+        [](const std::shared_ptr<XLATensor::CapturedGraph>& graph,
+           const std::vector<at::Tensor>& inputs) {
+          NoGilSection nogil;
+          std::vector<XLATensor> xinputs =
+              GetXlaTensors(inputs, /*want_all=*/true);
+          return bridge::AtenFromXlaTensors(
+              XLATensor::ReplayGraph(*graph, &xinputs));
+        });
+  py::class_<ExportedGraph, std::shared_ptr<ExportedGraph>>(m, "ExportedGraph");
+  m.def("_xla_export_graph",
+        [](const std::shared_ptr<XLATensor::CapturedGraph>& graph,
+           const std::string& path, size_t num_shards) {
+          NoGilSection nogil;
+          ExportedGraph::Save(path, *graph, num_shards);
+        });
+  m.def("_xla_load_exported_graph",
+        [](const std::string& path, const std::string& device) {
+          NoGilSection nogil;
+          return ExportedGraph::Load(path, GetDeviceOrCurrent(device));
+        });
+  m.def("_xla_run_exported_graph",
+        [](const std::shared_ptr<ExportedGraph>& graph,
+           const std::vector<at::Tensor>& inputs) {
+          NoGilSection nogil;
+          std::vector<XLATensor> xinputs =
+              GetXlaTensors(inputs, /*want_all=*/true);
+          std::vector<xla::ComputationClient::DataPtr> outputs_data =
+              graph->Execute(XLATensor::GetCaptureInputsData(&xinputs));
+          std::vector<XLATensor> outputs;
+          for (size_t i = 0; i < outputs_data.size(); ++i) {
+            outputs.push_back(XLATensor::Create(std::move(outputs_data[i]),
+                                                graph->output_types()[i]));
+          }
+          return bridge::AtenFromXlaTensors(outputs);
+        });
+  py::class_<BatchingExecutor, std::shared_ptr<BatchingExecutor>>(
+      m, "BatchingExecutor");
+  m.def("_xla_create_batching_executor",
+        [](const std::vector<std::shared_ptr<ExportedGraph>>& graphs,
+           xla::int64 max_delay_us) {
+          NoGilSection nogil;
+          return std::make_shared<BatchingExecutor>(graphs, max_delay_us);
+        });
+  m.def("_xla_batching_executor_run",
+        [](const std::shared_ptr<BatchingExecutor>& executor,
+           const std::vector<at::Tensor>& inputs) {
+          NoGilSection nogil;
+          return executor->Run(inputs);
+        });
+  m.def("_xla_batching_executor_close",
+        [](const std::shared_ptr<BatchingExecutor>& executor) {
+          NoGilSection nogil;
+          executor->Close();
+        });
+  py::class_<ModelResidencyManager, std::shared_ptr<ModelResidencyManager>>(
+      m, "ModelResidencyManager");
+  m.def("_xla_create_model_residency_manager",
+        [](const std::string& device, xla::int64 budget_bytes) {
+          return std::make_shared<ModelResidencyManager>(
+              GetDeviceOrCurrent(device), budget_bytes);
+        });
+  m.def("_xla_model_residency_register",
+        [](const std::shared_ptr<ModelResidencyManager>& manager,
+           const std::string& name, const std::string& path, bool pinned,
+           bool keep_host_copy) {
+          manager->Register(name, path, pinned, keep_host_copy);
+        });
+  m.def("_xla_model_residency_acquire",
+        [](const std::shared_ptr<ModelResidencyManager>& manager,
+           const std::string& name) {
+          NoGilSection nogil;
+          return manager->Acquire(name);
+        });
+  m.def("_xla_model_residency_prefetch",
+        [](const std::shared_ptr<ModelResidencyManager>& manager,
+           const std::string& name) { manager->Prefetch(name); });
+  m.def("_xla_model_residency_set_pinned",
+        [](const std::shared_ptr<ModelResidencyManager>& manager,
+           const std::string& name, bool pinned) {
+          NoGilSection nogil;
+          manager->SetPinned(name, pinned);
+        });
+  m.def("_xla_model_residency_evict",
+        [](const std::shared_ptr<ModelResidencyManager>& manager,
+           const std::string& name) {
+          NoGilSection nogil;
+          manager->Evict(name);
+        });
+  m.def("_xla_model_residency_is_resident",
+        [](const std::shared_ptr<ModelResidencyManager>& manager,
+           const std::string& name) { return manager->IsResident(name); });
+  m.def("_xla_model_residency_resident_bytes",
+        [](const std::shared_ptr<ModelResidencyManager>& manager) {
+          return manager->resident_bytes();
+        });
+  m.def("_xla_capture_step_loop",
+        [](const py::function& fn, const std::vector<at::Tensor>& slices,
+           const std::vector<at::Tensor>& batches,
+           const std::vector<at::Tensor>& state,
+           const std::vector<std::string>& devices) {
+          std::vector<xla::ComputationClient::DataPtr> slices_data;
+          std::vector<xla::ComputationClient::DataPtr> batches_data;
+          std::vector<xla::ComputationClient::DataPtr> state_data;
+          {
+            NoGilSection nogil;
+            std::vector<XLATensor> xslices =
+                GetXlaTensors(slices, /*want_all=*/true);
+            slices_data = XLATensor::GetCaptureInputsData(&xslices);
+            std::vector<XLATensor> xbatches =
+                GetXlaTensors(batches, /*want_all=*/true);
+            batches_data = XLATensor::GetCaptureInputsData(&xbatches);
+            std::vector<XLATensor> xstate =
+                GetXlaTensors(state, /*want_all=*/true);
+            state_data = XLATensor::GetCaptureInputsData(&xstate);
+          }
+          std::vector<at::Tensor> outputs =
+              fn().cast<std::vector<at::Tensor>>();
+          NoGilSection nogil;
+          std::vector<XLATensor> xoutputs =
+              GetXlaTensors(outputs, /*want_all=*/true);
+          std::shared_ptr<XLATensor::CapturedGraph> graph =
+              XLATensor::CaptureStepLoop(slices_data, batches_data, state_data,
+                                         &xoutputs, GetXlaDevices(devices));
+          // The traced step might have updated the state in place, which is
+          // restored as the captured loop runs from the initial state.
+          std::vector<XLATensor> xstate =
+              GetXlaTensors(state, /*want_all=*/true);
+          for (size_t i = 0; i < xstate.size(); ++i) {
+            xstate[i].SetXlaData(state_data[i]);
+          }
+          return graph;
+        },
+        py::arg("fn"), py::arg("slices"), py::arg("batches"),
+        py::arg("state"), py::arg("devices"));
   m.def("_xla_get_tensor_view_alias_id",
         [](const at::Tensor& tensor) { return GetTensorViewAliasId(tensor); });
   m.def("_xla_get_tensor_id",
@@ -681,6 +1615,29 @@ void InitXlaModuleBindings(py::module m) {
            const std::vector<xla::int64>& replicas) {
           return Rendezvous(ordinal, tag, payload, replicas);
         });
+  m.def("_xla_mesh_reduce",
+        [](int ordinal, const std::string& tag,
+           const std::vector<double>& values, const std::string& reduce_type,
+           const std::vector<xla::int64>& replicas) {
+          std::vector<double> result;
+          {
+            NoGilSection nogil;
+            result = MeshReduce(ordinal, tag, values, reduce_type, replicas);
+          }
+          return result;
+        });
+
+  m.def("_xla_rejoin_mesh",
+        [](int ordinal, const std::string& tag, xla::int64 world_size) {
+          std::vector<xla::int64> ordinals;
+          {
+            NoGilSection nogil;
+            ordinals = RejoinMesh(ordinal, tag, world_size);
+          }
+          return ordinals;
+        });
+  m.def("_xla_clear_replicated_computations",
+        []() { return XLATensor::ClearReplicatedComputations(); });
 
   py::class_<ir::Value, std::shared_ptr<ir::Value>>(m, "IrValue");
   m.def("_xla_create_token", []() {
@@ -740,6 +1697,81 @@ void InitXlaModuleBindings(py::module m) {
           result_tuple[1] = new_token;
           return result_tuple;
         });
+  m.def("_xla_all_gather",
+        [](const at::Tensor& input, const std::shared_ptr<ir::Value>& token,
+           xla::int64 dim, xla::int64 shard_count, const py::list& groups) {
+          std::vector<std::vector<xla::int64>> replica_groups =
+              CreateReduceGroups(groups);
+          at::Tensor result;
+          std::shared_ptr<ir::Value> new_token;
+          {
+            NoGilSection nogil;
+            std::tie(result, new_token) =
+                AllGather(input, token, dim, shard_count, replica_groups);
+          }
+          auto result_tuple = py::tuple(2);
+          result_tuple[0] = torch::autograd::make_variable(
+              result, /*requires_grad=*/input.requires_grad());
+          result_tuple[1] = new_token;
+          return result_tuple;
+        });
+  m.def("_xla_reduce_scatter",
+        [](const std::string& reduce_type, const at::Tensor& input,
+           const std::shared_ptr<ir::Value>& token, double scale,
+           xla::int64 scatter_dim, xla::int64 shard_count,
+           const py::list& groups) {
+          std::vector<std::vector<xla::int64>> replica_groups =
+              CreateReduceGroups(groups);
+          at::Tensor result;
+          std::shared_ptr<ir::Value> new_token;
+          {
+            NoGilSection nogil;
+            std::tie(result, new_token) =
+                ReduceScatter(reduce_type, input, token, scale, scatter_dim,
+                              shard_count, replica_groups);
+          }
+          auto result_tuple = py::tuple(2);
+          result_tuple[0] = torch::autograd::make_variable(
+              result, /*requires_grad=*/input.requires_grad());
+          result_tuple[1] = new_token;
+          return result_tuple;
+        });
+  m.def("_xla_column_parallel_matmul",
+        [](const at::Tensor& input, const at::Tensor& weight,
+           const py::object& bias, const std::shared_ptr<ir::Value>& token,
+           bool gather_output, xla::int64 shard_count, xla::int64 num_chunks,
+           const py::list& groups) {
+          std::vector<std::vector<xla::int64>> replica_groups =
+              CreateReduceGroups(groups);
+          at::Tensor result;
+          std::shared_ptr<ir::Value> new_token;
+          std::tie(result, new_token) = ParallelMatMul(
+              /*column_parallel=*/true, input, weight, bias, token,
+              gather_output, shard_count, num_chunks, replica_groups);
+          auto result_tuple = py::tuple(2);
+          result_tuple[0] = torch::autograd::make_variable(
+              result, /*requires_grad=*/false);
+          result_tuple[1] = new_token;
+          return result_tuple;
+        });
+  m.def("_xla_row_parallel_matmul",
+        [](const at::Tensor& input, const at::Tensor& weight,
+           const py::object& bias, const std::shared_ptr<ir::Value>& token,
+           bool scatter_output, xla::int64 shard_count, xla::int64 num_chunks,
+           const py::list& groups) {
+          std::vector<std::vector<xla::int64>> replica_groups =
+              CreateReduceGroups(groups);
+          at::Tensor result;
+          std::shared_ptr<ir::Value> new_token;
+          std::tie(result, new_token) = ParallelMatMul(
+              /*column_parallel=*/false, input, weight, bias, token,
+              scatter_output, shard_count, num_chunks, replica_groups);
+          auto result_tuple = py::tuple(2);
+          result_tuple[0] = torch::autograd::make_variable(
+              result, /*requires_grad=*/false);
+          result_tuple[1] = new_token;
+          return result_tuple;
+        });
   m.def("_xla_collective_permute",
         [](const at::Tensor& input, const std::shared_ptr<ir::Value>& token,
            const py::list& pairs) {
@@ -758,6 +1790,90 @@ void InitXlaModuleBindings(py::module m) {
           result_tuple[1] = new_token;
           return result_tuple;
         });
+  m.def("_xla_sync_batch_norm",
+        [](const at::Tensor& input, const at::Tensor& weight,
+           const at::Tensor& bias, const std::shared_ptr<ir::Value>& token,
+           double eps, const py::list& groups) {
+          std::vector<std::vector<xla::int64>> replica_groups =
+              CreateReduceGroups(groups);
+          std::vector<at::Tensor> results;
+          ir::Value new_token;
+          {
+            NoGilSection nogil;
+            XLATensor output, mean, invstd, count;
+            std::tie(output, mean, invstd, count, new_token) =
+                XLATensor::sync_batch_norm(
+                    bridge::GetXlaTensor(input), bridge::GetXlaTensor(weight),
+                    bridge::GetXlaTensor(bias), *token, eps, replica_groups);
+            for (auto& result : {output, mean, invstd, count}) {
+              results.push_back(bridge::AtenFromXlaTensor(result));
+            }
+          }
+          auto result_tuple = py::tuple(results.size() + 1);
+          for (size_t i = 0; i < results.size(); ++i) {
+            result_tuple[i] = torch::autograd::make_variable(
+                results[i], /*requires_grad=*/false);
+          }
+          result_tuple[results.size()] =
+              std::make_shared<ir::Value>(new_token);
+          return result_tuple;
+        });
+  m.def("_xla_sync_batch_norm_backward",
+        [](const at::Tensor& grad_output, const at::Tensor& input,
+           const at::Tensor& weight, const at::Tensor& mean,
+           const at::Tensor& invstd, const at::Tensor& count,
+           const std::shared_ptr<ir::Value>& token, const py::list& groups) {
+          std::vector<std::vector<xla::int64>> replica_groups =
+              CreateReduceGroups(groups);
+          std::vector<at::Tensor> results;
+          ir::Value new_token;
+          {
+            NoGilSection nogil;
+            XLATensor grad_input, grad_weight, grad_bias;
+            std::tie(grad_input, grad_weight, grad_bias, new_token) =
+                XLATensor::sync_batch_norm_backward(
+                    bridge::GetXlaTensor(grad_output),
+                    bridge::GetXlaTensor(input), bridge::GetXlaTensor(weight),
+                    bridge::GetXlaTensor(mean), bridge::GetXlaTensor(invstd),
+                    bridge::GetXlaTensor(count), *token, replica_groups);
+            for (auto& result : {grad_input, grad_weight, grad_bias}) {
+              results.push_back(bridge::AtenFromXlaTensor(result));
+            }
+          }
+          auto result_tuple = py::tuple(results.size() + 1);
+          for (size_t i = 0; i < results.size(); ++i) {
+            result_tuple[i] = torch::autograd::make_variable(
+                results[i], /*requires_grad=*/false);
+          }
+          result_tuple[results.size()] =
+              std::make_shared<ir::Value>(new_token);
+          return result_tuple;
+        });
+  m.def("_xla_quantized_matmul",
+        [](const at::Tensor& input, const at::Tensor& weight,
+           const at::Tensor& weight_scale, const at::Tensor& weight_zero_point,
+           const py::object& bias, const py::object& input_params,
+           const py::object& output_params) {
+          at::Tensor result =
+              QuantizedMatMul(input, weight, weight_scale, weight_zero_point,
+                              bias, input_params, output_params);
+          return torch::autograd::make_variable(result,
+                                                /*requires_grad=*/false);
+        });
+  m.def("_xla_quantized_convolution",
+        [](const at::Tensor& input, const at::Tensor& weight,
+           const at::Tensor& weight_scale, const at::Tensor& weight_zero_point,
+           const py::object& bias, std::vector<xla::int64> stride,
+           std::vector<xla::int64> padding, std::vector<xla::int64> dilation,
+           xla::int64 groups, const py::object& input_params,
+           const py::object& output_params) {
+          at::Tensor result = QuantizedConvolution(
+              input, weight, weight_scale, weight_zero_point, bias,
+              std::move(stride), std::move(padding), std::move(dilation),
+              groups, input_params, output_params);
+          return torch::autograd::make_variable(result,
+                                                /*requires_grad=*/false);
+        });
   m.def("_xla_set_default_device", [](const std::string& device) {
     return SetCurrentThreadDevice(device);
   });
@@ -779,6 +1895,47 @@ void InitXlaModuleBindings(py::module m) {
         },
         py::arg("tensors"), py::arg("devices"), py::arg("wait") = true,
         py::arg("sync_xla_data") = true);
+  m.def("_xla_flush_graph_dumps", []() {
+    NoGilSection nogil;
+    DebugUtil::FlushTensorsGraphInfo();
+  });
+  m.def("_xla_set_liveness_hint",
+        [](const std::vector<at::Tensor>& tensors, bool live) {
+          for (auto& xtensor : GetXlaTensors(tensors, /*want_all=*/false)) {
+            xtensor.SetLivenessHint(live);
+          }
+        },
+        py::arg("tensors"), py::arg("live"));
+  m.def("_xla_freeze_tensors", [](const std::vector<at::Tensor>& tensors) {
+    NoGilSection nogil;
+    for (auto& xtensor : GetXlaTensors(tensors, /*want_all=*/true)) {
+      xtensor.Freeze();
+    }
+  });
+  m.def("_xla_mark_sharding",
+        [](const at::Tensor& input, const std::vector<xla::int64>& tile_dims,
+           const std::vector<xla::int64>& tile_devices,
+           const std::vector<int>& device_ids) {
+          NoGilSection nogil;
+          XLATensor xtensor = bridge::GetXlaTensor(input);
+          std::vector<std::string> devices;
+          for (auto device_id : device_ids) {
+            devices.push_back(
+                Device(xtensor.GetDevice().hw_type, device_id).ToString());
+          }
+          xtensor.SetShardingSpec(ShardingUtil::CreateShardingSpec(
+              tile_dims, tile_devices, std::move(devices)));
+        },
+        py::arg("input"), py::arg("tile_dims"), py::arg("tile_devices"),
+        py::arg("device_ids"));
+  m.def("_xla_clear_sharding", [](const at::Tensor& input) {
+    NoGilSection nogil;
+    bridge::GetXlaTensor(input).ClearShardingSpec();
+  });
+  m.def("_get_xla_sharding_spec", [](const at::Tensor& input) -> std::string {
+    ShardingSpecPtr spec = bridge::GetXlaTensor(input).GetShardingSpec();
+    return spec != nullptr ? ShardingUtil::GetSpecString(*spec) : std::string();
+  });
   m.def("_xla_sync_live_tensors",
         [](const std::string& device, const std::vector<std::string>& devices,
            bool wait) {
@@ -799,6 +1956,12 @@ void InitXlaModuleBindings(py::module m) {
           XLATensor::WaitDeviceOps(devices);
         },
         py::arg("devices"));
+  m.def("_xla_wait_tensors", [](const std::vector<at::Tensor>& tensors) {
+    std::vector<XLATensor> xtensors =
+        GetXlaTensors(tensors, /*want_all=*/false);
+    NoGilSection nogil;
+    XLATensor::WaitTensors(xtensors);
+  });
   m.def("_xla_counter_names", []() { return xla::metrics::GetCounterNames(); });
   m.def("_xla_counter_value", [](const std::string& name) -> py::object {
     xla::metrics::CounterData* data = xla::metrics::GetCounter(name);
@@ -808,8 +1971,129 @@ void InitXlaModuleBindings(py::module m) {
   m.def("_xla_metric_data", [](const std::string& name) -> py::object {
     return GetMetricData(name);
   });
-  m.def("_xla_metrics_report",
-        []() { return xla::metrics_reader::CreateMetricReport(); });
+  py::class_<xla::metrics::MetricsSnapshot,
+             std::shared_ptr<xla::metrics::MetricsSnapshot>>(
+      m, "MetricsSnapshot");
+  m.def("_xla_metrics_snapshot", []() {
+    return std::make_shared<xla::metrics::MetricsSnapshot>(
+        xla::metrics::CreateMetricsSnapshot());
+  });
+  m.def("_xla_metrics_delta",
+        [](const xla::metrics::MetricsSnapshot& before,
+           const xla::metrics::MetricsSnapshot& after) {
+          xla::metrics::MetricsSnapshot delta =
+              xla::metrics::DiffMetricsSnapshots(before, after);
+          py::dict counters;
+          for (auto& name_value : delta.counters) {
+            counters[py::str(name_value.first)] =
+                py::int_(name_value.second);
+          }
+          py::dict metrics;
+          for (auto& name_totals : delta.metrics) {
+            metrics[py::str(name_totals.first)] =
+                py::make_tuple(name_totals.second.total_samples,
+                               name_totals.second.accumulator);
+          }
+          py::dict delta_dict;
+          delta_dict["counters"] = counters;
+          delta_dict["metrics"] = metrics;
+          return delta_dict;
+        });
+  m.def("_xla_metrics_report", []() {
+    return xla::metrics_reader::CreateMetricReport() +
+           CreateHostOverheadReport();
+  });
+  m.def("_xla_dump_timeline",
+        []() { return xla::metrics::CreateTimelineTrace(); });
+  m.def("_xla_fallback_stats", []() {
+    py::dict fallbacks;
+    for (auto& name_stats : GetFallbackStats()) {
+      const FallbackStats& stats = name_stats.second;
+      py::dict stats_dict;
+      stats_dict["count"] = py::int_(stats.count);
+      stats_dict["bytes_to_host"] = py::int_(stats.bytes_to_host);
+      stats_dict["bytes_to_device"] = py::int_(stats.bytes_to_device);
+      stats_dict["time_ns"] = py::int_(stats.time_ns);
+      stats_dict["frames"] = py::cast(stats.frames);
+      fallbacks[py::str(name_stats.first)] = stats_dict;
+    }
+    return fallbacks;
+  });
+  m.def("_xla_fallback_report", []() { return CreateFallbackReport(); });
+  m.def("_xla_compiled_graphs_stats",
+        [](size_t top_n) {
+          py::list graphs;
+          for (auto& stats : XLATensor::GetCachedComputationStats(top_n)) {
+            graphs.append(CompilationStatsToDict(stats));
+          }
+          return graphs;
+        },
+        py::arg("top_n") = 0);
+  m.def("_xla_pin_compiled_graph",
+        [](const std::string& hash, bool pinned) {
+          XLATensor::PinComputation(ParseHexHash(hash), pinned);
+        },
+        py::arg("hash"), py::arg("pinned") = true);
+  m.def("_xla_get_compile_manifest", []() {
+    return CompileManifestToList(XLATensor::GetCompileManifest());
+  });
+  m.def("_xla_warmup_compile", [](const py::list& entries) {
+    std::vector<XLATensor::CompileManifestEntry> manifest =
+        CompileManifestFromList(entries);
+    NoGilSection nogil;
+    return XLATensor::WarmupCompile(manifest);
+  });
+  m.def("_xla_dry_run_compile",
+        [](const std::vector<at::Tensor>& tensors,
+           const std::vector<std::string>& devices) {
+          XLATensor::CompilationStats stats;
+          {
+            NoGilSection nogil;
+            stats = DryRunCompile(tensors, devices);
+          }
+          return CompilationStatsToDict(stats);
+        },
+        py::arg("tensors"), py::arg("devices"));
+  m.def("_xla_recompile_reports", []() {
+    RecompileAnalyzer* recompile_analyzer = RecompileAnalyzer::Get();
+    return recompile_analyzer != nullptr ? recompile_analyzer->GetReports()
+                                         : std::vector<std::string>();
+  });
+  m.def("_xla_start_scope_profile", [](xla::int64 num_steps) {
+    ScopeProfiler::Get()->Start(num_steps);
+  });
+  m.def("_xla_stop_scope_profile", []() { ScopeProfiler::Get()->Stop(); });
+  m.def("_xla_scope_profile_report",
+        []() { return ScopeProfiler::Get()->GetReport(); });
+  m.def("_xla_scope_profile_folded_stacks",
+        []() { return ScopeProfiler::Get()->GetFoldedStacks(); });
+  m.def("_xla_reset_scope_profile", []() { ScopeProfiler::Get()->Reset(); });
+  m.def("_xla_reset_fallback_stats", []() { ResetFallbackStats(); });
+  m.def("_xla_enter_fallback_strict", []() { EnterFallbackStrictRegion(); });
+  m.def("_xla_exit_fallback_strict", []() { ExitFallbackStrictRegion(); });
+  m.def("_xla_push_ir_scope",
+        [](const std::string& name) { ir::PushScope(name); });
+  m.def("_xla_pop_ir_scope", []() { ir::PopScope(); });
+  m.def("_xla_push_checkpoint_region", []() { ir::PushCheckpointRegion(); });
+  m.def("_xla_pop_checkpoint_region", []() { ir::PopCheckpointRegion(); });
+  m.def("_xla_push_autocast",
+        [](const std::string& type) { PushAutocastScope(type); });
+  m.def("_xla_pop_autocast", []() { PopAutocastScope(); });
+  m.def("_xla_get_current_stream",
+        []() { return XLATensor::GetCurrentStream(); });
+  m.def("_xla_set_current_stream", [](xla::int64 stream) {
+    XLATensor::SetCurrentStream(stream);
+  });
+  m.def("_xla_memory_info",
+        [](const std::string& device) { return GetMemoryInfo(device); },
+        py::arg("device") = "");
+  m.def("_xla_reclaim_memory",
+        [](const std::string& device) {
+          NoGilSection nogil;
+          xla::ComputationClient::Get()->ReclaimMemory(
+              GetDeviceOrCurrent(device).ToString());
+        },
+        py::arg("device") = "");
   m.def("_xla_tensors_report",
         [](size_t nodes_threshold, const std::string& device) {
           return GetLiveTensorsReport(nodes_threshold, device);
@@ -823,16 +2107,197 @@ void InitXlaModuleBindings(py::module m) {
         },
         py::arg("use_full_mat_mul_precision") = true);
 
+  m.def("_xla_save_autotuned_layouts",
+        [](const std::string& path) { SaveAutotunedLayouts(path); });
+
+  py::class_<DeviceDataLoader, std::shared_ptr<DeviceDataLoader>>(
+      m, "DeviceDataLoader");
+  m.def("_xla_create_device_data_loader",
+        [](const std::vector<std::string>& devices, size_t ring_size) {
+          std::vector<Device> xla_devices;
+          xla_devices.reserve(devices.size());
+          for (auto& device_str : devices) {
+            xla_devices.push_back(
+                bridge::AtenDeviceToXlaDevice(c10::Device(device_str)));
+          }
+          return std::make_shared<DeviceDataLoader>(std::move(xla_devices),
+                                                    ring_size);
+        },
+        py::arg("devices"), py::arg("ring_size") = 4);
+  m.def("_xla_device_data_loader_upload",
+        [](const std::shared_ptr<DeviceDataLoader>& loader,
+           const std::vector<std::vector<at::Tensor>>& device_tensors) {
+          NoGilSection nogil;
+          return loader->Upload(device_tensors);
+        });
+  m.def("_xla_device_data_loader_next",
+        [](const std::shared_ptr<DeviceDataLoader>& loader,
+           size_t device_index) -> py::object {
+          std::vector<at::Tensor> tensors;
+          bool has_item;
+          {
+            NoGilSection nogil;
+            has_item = loader->Next(device_index, &tensors);
+          }
+          if (!has_item) {
+            return py::none();
+          }
+          return py::cast(tensors);
+        });
+  m.def("_xla_device_data_loader_close_write",
+        [](const std::shared_ptr<DeviceDataLoader>& loader) {
+          loader->CloseWrite();
+        });
+  m.def("_xla_device_data_loader_close",
+        [](const std::shared_ptr<DeviceDataLoader>& loader) {
+          loader->Close();
+        });
+
+  using PyQueue = BlockingQueue<py::object>;
+  using PyKeydQueue = KeydBlockingQueue<xla::int64, py::object>;
+  py::class_<BlockingQueueBase, std::shared_ptr<BlockingQueueBase>>(
+      m, "BlockingQueueBase");
+  py::class_<PyQueue, BlockingQueueBase, std::shared_ptr<PyQueue>>(
+      m, "BlockingQueue");
+  py::class_<PyKeydQueue, BlockingQueueBase, std::shared_ptr<PyKeydQueue>>(
+      m, "KeydBlockingQueue");
+  m.def("_xla_create_queue", [](size_t max_size) {
+    return std::make_shared<PyQueue>(max_size);
+  });
+  m.def("_xla_queue_put",
+        [](const std::shared_ptr<PyQueue>& queue, py::object item) {
+          // The item is only moved while the GIL is released, and a rejected
+          // one is destroyed after the GIL has been reacquired.
+          NoGilSection nogil;
+          return queue->Put(&item);
+        });
+  m.def("_xla_queue_get", [](const std::shared_ptr<PyQueue>& queue) {
+    py::object item;
+    bool has_item;
+    {
+      NoGilSection nogil;
+      has_item = queue->Get(&item);
+    }
+    return has_item ? item : py::none();
+  });
+  m.def("_xla_create_keyd_queue", [](size_t max_size) {
+    return std::make_shared<PyKeydQueue>(max_size);
+  });
+  m.def("_xla_keyd_queue_put", [](const std::shared_ptr<PyKeydQueue>& queue,
+                                  xla::int64 key, py::object item) {
+    NoGilSection nogil;
+    return queue->Put(key, &item);
+  });
+  m.def("_xla_keyd_queue_get",
+        [](const std::shared_ptr<PyKeydQueue>& queue, xla::int64 key) {
+          py::object item;
+          bool has_item;
+          {
+            NoGilSection nogil;
+            has_item = queue->Get(key, &item);
+          }
+          return has_item ? item : py::none();
+        });
+  m.def("_xla_queue_close",
+        [](const std::shared_ptr<BlockingQueueBase>& queue) {
+          queue->Close();
+        });
+  m.def("_xla_queue_close_write",
+        [](const std::shared_ptr<BlockingQueueBase>& queue) {
+          queue->CloseWrite();
+        });
+
+  py::class_<SharedBatchRing, std::shared_ptr<SharedBatchRing>>(
+      m, "SharedBatchRing");
+  m.def("_xla_create_shared_batch_ring",
+        [](const std::string& name, size_t num_slots, size_t slot_size,
+           bool create) {
+          return std::make_shared<SharedBatchRing>(name, num_slots, slot_size,
+                                                   create);
+        },
+        py::arg("name"), py::arg("num_slots"), py::arg("slot_size"),
+        py::arg("create"));
+  m.def("_xla_shared_batch_ring_write",
+        [](const std::shared_ptr<SharedBatchRing>& ring,
+           const std::vector<at::Tensor>& tensors, const py::bytes& metadata) {
+          std::string metadata_str = metadata;
+          NoGilSection nogil;
+          return ring->Write(tensors, metadata_str);
+        });
+  m.def("_xla_shared_batch_ring_close_write",
+        [](const std::shared_ptr<SharedBatchRing>& ring,
+           xla::int64 num_batches) { ring->CloseWrite(num_batches); });
+  m.def("_xla_shared_batch_ring_close",
+        [](const std::shared_ptr<SharedBatchRing>& ring) { ring->Close(); });
+  py::class_<DevicePrefetcher, std::shared_ptr<DevicePrefetcher>>(
+      m, "DevicePrefetcher");
+  m.def("_xla_create_device_prefetcher",
+        [](const std::shared_ptr<SharedBatchRing>& ring,
+           const std::string& device, size_t queue_size) {
+          return std::make_shared<DevicePrefetcher>(
+              ring, bridge::AtenDeviceToXlaDevice(c10::Device(device)),
+              queue_size);
+        },
+        py::arg("ring"), py::arg("device"), py::arg("queue_size") = 4);
+  m.def("_xla_device_prefetcher_next",
+        [](const std::shared_ptr<DevicePrefetcher>& prefetcher) -> py::object {
+          DevicePrefetcher::Item item;
+          bool has_item;
+          {
+            NoGilSection nogil;
+            has_item = prefetcher->Next(&item);
+          }
+          if (!has_item) {
+            return py::none();
+          }
+          return py::make_tuple(py::cast(item.tensors),
+                                py::bytes(item.metadata));
+        });
+
+  py::class_<TensorShard, std::shared_ptr<TensorShard>>(m, "TensorShard");
+  m.def("_xla_write_tensor_shard",
+        [](const std::string& path, const std::vector<at::Tensor>& columns) {
+          NoGilSection nogil;
+          TensorShard::Write(path, columns);
+        });
+  m.def("_xla_open_tensor_shard", [](const std::string& path) {
+    NoGilSection nogil;
+    return std::make_shared<TensorShard>(path);
+  });
+  m.def("_xla_tensor_shard_num_records",
+        [](const std::shared_ptr<TensorShard>& shard) {
+          return shard->num_records();
+        });
+  m.def("_xla_tensor_shard_batch",
+        [](const std::shared_ptr<TensorShard>& shard, xla::int64 start,
+           xla::int64 count) {
+          std::vector<at::Tensor> tensors;
+          {
+            NoGilSection nogil;
+            tensors = shard->GetBatch(start, count);
+          }
+          return tensors;
+        });
+
   py::class_<xla::util::RecordReader, std::shared_ptr<xla::util::RecordReader>>(
       m, "RecordReader");
   m.def("_xla_create_tfrecord_reader",
-        [](const std::string& path, const std::string& compression,
-           xla::int64 buffer_size) {
+        [](const std::vector<std::string>& paths,
+           const std::string& compression, xla::int64 buffer_size,
+           xla::int64 num_readers, xla::int64 prefetch_size,
+           xla::int64 shuffle_size, xla::uint64 seed) {
+          xla::util::RecordReader::Options options;
+          options.num_readers = num_readers;
+          options.prefetch_size = prefetch_size;
+          options.shuffle_size = shuffle_size;
+          options.seed = seed;
           NoGilSection nogil;
-          return CreateRecordReader(path, compression, buffer_size);
+          return CreateRecordReader(paths, compression, buffer_size, options);
         },
-        py::arg("path"), py::arg("compression") = "",
-        py::arg("buffer_size") = 16 * 1024 * 1024);
+        py::arg("paths"), py::arg("compression") = "",
+        py::arg("buffer_size") = 16 * 1024 * 1024, py::arg("num_readers") = 0,
+        py::arg("prefetch_size") = 1024, py::arg("shuffle_size") = 0,
+        py::arg("seed") = 0);
   m.def(
       "_xla_tfrecord_read",
       [](const std::shared_ptr<xla::util::RecordReader>& reader) -> py::object {
@@ -846,6 +2311,28 @@ void InitXlaModuleBindings(py::module m) {
         [](const std::shared_ptr<xla::util::RecordReader>& reader) {
           return RecordReadExample(reader);
         });
+  m.def("_xla_tfexample_read_batch",
+        [](const std::shared_ptr<xla::util::RecordReader>& reader,
+           size_t max_records) {
+          return RecordReadExamples(reader, max_records);
+        });
+
+  py::class_<xla::util::IndexedRecordReader,
+             std::shared_ptr<xla::util::IndexedRecordReader>>(
+      m, "IndexedRecordReader");
+  m.def("_xla_create_indexed_record_reader",
+        [](const std::vector<std::string>& paths, xla::int64 num_threads) {
+          NoGilSection nogil;
+          return std::make_shared<xla::util::IndexedRecordReader>(paths,
+                                                                  num_threads);
+        },
+        py::arg("paths"), py::arg("num_threads") = 8);
+  m.def("_xla_indexed_record_reader_num_records",
+        [](const std::shared_ptr<xla::util::IndexedRecordReader>& reader) {
+          return reader->num_records();
+        });
+  m.def("_xla_indexed_record_read_at", &IndexedRecordReadAt);
+  m.def("_xla_indexed_example_read_at", &IndexedExampleReadAt);
 
   py::class_<tensorflow::RandomAccessFile>(m, "TfRdFile");
   m.def("_xla_tffile_open", [](const std::string& path) {
@@ -884,6 +2371,33 @@ void InitXlaModuleBindings(py::module m) {
     FlushTfFile(file);
   });
 
+  m.def("_xla_save_tensor_checkpoint",
+        [](const std::string& path, const std::vector<std::string>& names,
+           const std::vector<at::Tensor>& tensors, size_t num_shards) {
+          NoGilSection nogil;
+          TensorCheckpoint::Save(path, names,
+                                 bridge::XlaCreateTensorList(tensors),
+                                 num_shards);
+        });
+  m.def("_xla_load_tensor_checkpoint",
+        [](const std::string& path, const std::string& device) {
+          std::vector<std::string> names;
+          std::vector<at::Tensor> tensors;
+          {
+            NoGilSection nogil;
+            Device xla_device = GetDeviceOrCurrent(device);
+            TensorCheckpoint::Index index = TensorCheckpoint::LoadIndex(path);
+            std::vector<xla::ComputationClient::DataPtr> tensors_data =
+                TensorCheckpoint::Load(path, index, xla_device);
+            for (size_t i = 0; i < index.entries.size(); ++i) {
+              names.push_back(index.entries[i].name);
+              tensors.push_back(bridge::AtenFromXlaTensor(XLATensor::Create(
+                  std::move(tensors_data[i]), index.entries[i].scalar_type)));
+            }
+          }
+          return std::make_pair(std::move(names), std::move(tensors));
+        });
+
   m.def("_xla_tffs_list",
         [](const std::string& pattern) { return ListTfFs(pattern); });
   m.def("_xla_tffs_remove", [](const std::string& path) {
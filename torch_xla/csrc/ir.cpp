@@ -1,21 +1,94 @@
 #include "torch_xla/csrc/ir.h"
 
+#include <array>
 #include <functional>
+#include <limits>
+#include <mutex>
 #include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <ATen/core/grad_mode.h>
 
 #include "absl/strings/str_cat.h"
 #include "tensorflow/compiler/xla/xla_client/cache.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/compiler/xla/xla_client/xla_util.h"
 #include "torch_xla/csrc/lowering_context.h"
 
 namespace torch_xla {
 namespace ir {
 namespace {
 
-using ShapeCache =
-    xla::util::Cache<xla::hash_t, xla::Shape, xla::util::HashReducer>;
+using ShapeCache = xla::util::ShardedCache<xla::hash_t, const xla::Shape,
+                                           xla::util::HashReducer>;
+
+// Graphs are dominated by a few distinct shapes, so the IR nodes share the
+// canonical immutable copy of their shape held by this pool, instead of each
+// carrying its own. The canonical shapes are never released.
+class ShapePool {
+ public:
+  std::shared_ptr<const xla::Shape> Intern(xla::Shape shape) {
+    xla::hash_t hash = xla::util::ShapeHash(shape);
+    // Every thread looks up the shapes it interned last first, so that the
+    // threads tracing concurrently only meet on the pool lock for new shapes.
+    ThreadCache::Entry& entry = GetThreadCache()->Lookup(hash);
+    if (entry.value != nullptr && entry.hash == hash &&
+        *entry.value == shape) {
+      return entry.value;
+    }
+    std::lock_guard<std::mutex> lock(lock_);
+    std::vector<std::shared_ptr<const xla::Shape>>& bucket = shapes_[hash];
+    for (auto& pooled_shape : bucket) {
+      if (*pooled_shape == shape) {
+        entry = {hash, pooled_shape};
+        return pooled_shape;
+      }
+    }
+    bucket.push_back(std::make_shared<const xla::Shape>(std::move(shape)));
+    entry = {hash, bucket.back()};
+    return bucket.back();
+  }
+
+  // A small direct mapped cache of shapes, private to every thread.
+  class ThreadCache {
+   public:
+    struct Entry {
+      xla::hash_t hash = 0;
+      std::shared_ptr<const xla::Shape> value;
+    };
+
+    Entry& Lookup(const xla::hash_t& hash) {
+      return entries_[xla::util::HashReduce(hash) % kNumEntries];
+    }
+
+   private:
+    static constexpr size_t kNumEntries = 64;
+
+    std::array<Entry, kNumEntries> entries_;
+  };
+
+ private:
+  static ThreadCache* GetThreadCache() {
+    static thread_local ThreadCache cache;
+    return &cache;
+  }
+
+ private:
+  std::mutex lock_;
+  std::unordered_map<xla::hash_t,
+                     std::vector<std::shared_ptr<const xla::Shape>>,
+                     xla::util::HashReducer>
+      shapes_;
+};
+
+ShapePool* GetShapePool() {
+  static ShapePool* pool = new ShapePool();
+  return pool;
+}
 
 struct ScapeEntry {
   std::string name;
@@ -29,17 +102,24 @@ struct ScopeContext {
 
 thread_local ScopeContext g_scope_context;
 
-void PushScope(const std::string& name) {
-  size_t id = g_scope_context.next_id;
-  g_scope_context.scopes.push_back(
-      {absl::StrCat(name, ".", id), g_scope_context.next_id + 1});
-  g_scope_context.next_id = 1;
+struct CheckpointContext {
+  std::vector<size_t> regions;
+  size_t next_id = 1;
+};
+
+thread_local CheckpointContext g_checkpoint_context;
+
+// Updated at every node creation and destruction, so it is sharded like the
+// metrics counters.
+xla::metrics::CounterData* GetLiveHostBytesCounter() {
+  static xla::metrics::CounterData* live_host_bytes =
+      new xla::metrics::CounterData();
+  return live_host_bytes;
 }
 
-void PopScope() {
-  XLA_CHECK(!g_scope_context.scopes.empty());
-  g_scope_context.next_id = g_scope_context.scopes.back().saved_next_id;
-  g_scope_context.scopes.pop_back();
+size_t GetNodeHostBytes(size_t num_operands) {
+  return sizeof(Node) +
+         num_operands * (sizeof(NodePtr) + sizeof(Output) + sizeof(Use));
 }
 
 void ResetScopeContext() {
@@ -47,6 +127,13 @@ void ResetScopeContext() {
   g_scope_context.next_id = 1;
 }
 
+size_t GetCurrentCheckpointId() {
+  // Without autograd there is no backward pass to recompute the values for.
+  return !g_checkpoint_context.regions.empty() && at::GradMode::is_enabled()
+             ? g_checkpoint_context.regions.back()
+             : 0;
+}
+
 std::string GetCurrentScope() {
   std::string scope;
   for (auto& scope_entry : g_scope_context.scopes) {
@@ -83,6 +170,19 @@ void EmitShortFrameInfo(std::ostream& stream,
 
 }  // namespace
 
+std::vector<SourceLocation> MetaData::GetFrameInfo(size_t max_frames) const {
+  if (!frame_tokens.empty()) {
+    absl::Span<const FrameToken> tokens(frame_tokens);
+    return ResolvePythonFrames(max_frames > 0 ? tokens.subspan(0, max_frames)
+                                              : tokens);
+  }
+  if (max_frames == 0 || frame_info.size() <= max_frames) {
+    return frame_info;
+  }
+  return std::vector<SourceLocation>(frame_info.begin(),
+                                     frame_info.begin() + max_frames);
+}
+
 bool Use::operator<(const Use& rhs) const {
   if (node->op() != rhs.node->op()) {
     return node->op() < rhs.node->op();
@@ -132,22 +232,38 @@ OpKind OpKind::Get(const std::string& name) {
 }
 
 xla::hash_t OpKind::hash() const {
-  return xla::util::StringHash(op.toQualString());
+  // Called for every IR node created. The hash must be stable across
+  // processes, hence computed from the symbol name, but the name lookup takes
+  // the global symbols lock, so the hashes are cached in a per thread table
+  // indexed by the (dense) symbol values.
+  thread_local std::vector<xla::hash_t> symbol_hashes;
+  size_t index = static_cast<c10::unique_t>(op);
+  if (index >= symbol_hashes.size()) {
+    symbol_hashes.resize(index + 1, 0);
+  }
+  xla::hash_t& hash = symbol_hashes[index];
+  if (hash == 0) {
+    hash = xla::util::StringHash(op.toQualString());
+  }
+  return hash;
 }
 
 Node::Node(OpKind op, OpList operands, xla::Shape shape, size_t num_outputs,
            xla::hash_t hash_seed)
     : op_(std::move(op)),
       num_outputs_(num_outputs),
-      shape_(std::move(shape)),
+      shape_(GetShapePool()->Intern(std::move(shape))),
       node_hash_(xla::util::HashCombine(op_.hash(), hash_seed)),
       hash_(node_hash_) {
   metadata_.scope = GetCurrentScope();
-  metadata_.frame_info = GetFrameInfo();
+  CaptureFrameInfo(&metadata_);
   for (auto& operand : operands) {
     AddOperand(operand.node, operand.index);
     hash_ = xla::util::HashCombine(hash_, operand.hash());
   }
+  UpdateGraphSize();
+  AddHostBytes(GetNodeHostBytes(operands.size()));
+  SetCheckpointInfo(/*check_operands=*/true);
 }
 
 Node::Node(OpKind op, OpList operands,
@@ -163,25 +279,37 @@ Node::Node(OpKind op, xla::Shape shape, size_t num_outputs,
            xla::hash_t hash_seed)
     : op_(std::move(op)),
       num_outputs_(num_outputs),
-      shape_(std::move(shape)),
-      node_hash_(GetOpHash(op_, shape_, hash_seed)),
+      shape_(GetShapePool()->Intern(std::move(shape))),
+      node_hash_(GetOpHash(op_, *shape_, hash_seed)),
       hash_(node_hash_) {
   metadata_.scope = GetCurrentScope();
-  metadata_.frame_info = GetFrameInfo();
+  CaptureFrameInfo(&metadata_);
+  AddHostBytes(GetNodeHostBytes(/*num_operands=*/0));
+  SetCheckpointInfo(/*check_operands=*/false);
 }
 
 Node::~Node() {
   for (size_t i = 0; i < operands_as_outputs_.size(); ++i) {
     operands_[i]->RemoveUse(Use(this, i, operands_as_outputs_[i].index));
   }
+  GetLiveHostBytesCounter()->AddValue(-static_cast<xla::int64>(host_bytes_));
+}
+
+void Node::AddHostBytes(size_t bytes) {
+  host_bytes_ += bytes;
+  GetLiveHostBytesCounter()->AddValue(bytes);
+}
+
+size_t Node::GetLiveHostBytes() {
+  return static_cast<size_t>(GetLiveHostBytesCounter()->Value());
 }
 
 const xla::Shape& Node::shape(size_t output_index) const {
-  if (shape_.IsTuple()) {
-    return shape_.tuple_shapes(output_index);
+  if (shape_->IsTuple()) {
+    return shape_->tuple_shapes(output_index);
   }
   XLA_CHECK_EQ(output_index, 0);
-  return shape_;
+  return *shape_;
 }
 
 void Node::AddOperand(NodePtr node, size_t index) {
@@ -198,6 +326,49 @@ void Node::ReplaceOperand(size_t operand_no, NodePtr node, size_t index) {
   node->AddUse(Use(this, operand_no, index));
   *output = Output(node.get(), index);
   operands_[operand_no] = std::move(node);
+  UpdateUsersGraphInfo();
+}
+
+void Node::UpdateUsersGraphInfo() {
+  // Orders this node and its (transitive) users so that every node comes
+  // before its users, by reversing the post-order of the walk over the uses.
+  std::vector<Node*> post_order;
+  std::unordered_set<Node*> visited;
+  std::vector<std::pair<Node*, bool>> stack({{this, false}});
+  while (!stack.empty()) {
+    std::pair<Node*, bool> entry = stack.back();
+    stack.pop_back();
+    if (entry.second) {
+      post_order.push_back(entry.first);
+    } else if (visited.insert(entry.first).second) {
+      stack.emplace_back(entry.first, true);
+      for (auto& use : entry.first->uses_) {
+        stack.emplace_back(use.node, false);
+      }
+    }
+  }
+  // The node hash carries the checkpoint information already, so combining it
+  // with the new operand hashes gives a rewired graph the hash of the same
+  // graph built from scratch, and not the one of the original graph.
+  for (auto it = post_order.rbegin(); it != post_order.rend(); ++it) {
+    Node* node = *it;
+    node->hash_ = node->node_hash_;
+    for (auto& operand : node->operands_as_outputs_) {
+      node->hash_ = xla::util::HashCombine(node->hash_, operand.hash());
+    }
+    node->UpdateGraphSize();
+  }
+}
+
+void Node::UpdateGraphSize() {
+  static const size_t kMaxGraphSize = std::numeric_limits<size_t>::max();
+  graph_size_ = 1;
+  for (auto& operand : operands_) {
+    size_t operand_size = operand->graph_size();
+    graph_size_ = operand_size < kMaxGraphSize - graph_size_
+                      ? graph_size_ + operand_size
+                      : kMaxGraphSize;
+  }
 }
 
 void Node::ReplaceAllUsesWith(NodePtr node, size_t index) {
@@ -235,7 +406,7 @@ std::string Node::ToString() const {
   if (!metadata_.scope.empty()) {
     ss << ", scope=" << metadata_.scope;
   }
-  EmitShortFrameInfo(ss, metadata_.frame_info);
+  EmitShortFrameInfo(ss, metadata_.GetFrameInfo(/*max_frames=*/1));
   return ss.str();
 }
 
@@ -250,25 +421,102 @@ XlaOpVector Node::Lower(LoweringContext* loctx) const {
 xla::hash_t Node::GetOpHash(OpKind op, const xla::Shape& shape,
                             xla::hash_t hash_seed) {
   xla::hash_t h =
-      xla::util::HashCombine(op.hash(), xla::util::Hash(shape.ToString()));
+      xla::util::HashCombine(op.hash(), xla::util::ShapeHash(shape));
   return xla::util::HashCombine(h, hash_seed);
 }
 
-xla::Shape Node::GetOpShape(const std::function<xla::Shape()>& shape_fn) const {
+std::shared_ptr<const xla::Shape> Node::GetOpShape(
+    const std::function<xla::Shape()>& shape_fn) const {
+  // The per thread front-end skips the shared cache shard locks for the ops
+  // the thread traced last.
+  static thread_local ShapePool::ThreadCache thread_cache;
+  ShapePool::ThreadCache::Entry& entry = thread_cache.Lookup(hash());
+  if (entry.value != nullptr && entry.hash == hash()) {
+    return entry.value;
+  }
   ShapeCache* shape_cache = GetShapeCache();
   auto shape = shape_cache->Get(hash());
   if (shape == nullptr) {
-    shape = shape_cache->Add(hash(), std::make_shared<xla::Shape>(shape_fn()));
+    shape = shape_cache->Add(hash(), GetShapePool()->Intern(shape_fn()));
   }
-  return *shape;
+  entry = {hash(), shape};
+  return shape;
 }
 
-std::vector<SourceLocation> Node::GetFrameInfo() {
+void Node::CaptureFrameInfo(MetaData* metadata) {
   // At the time of writing, retrieving Python frames costs from 1us up to 20us.
   // This per IR Node. Since it is not unreasonable to have a many hundreds of
   // IR Node, this can be a multi-millisecond cost, which is not negligible.
+  // The deferred mode only captures compact frame tokens, whose strings are
+  // resolved when needed (like when lowering the HLO metadata), and sampling
+  // captures the frames of one node every sample_rate.
   static bool wants_frames = xla::sys_util::GetEnvBool("XLA_IR_DEBUG", false);
-  return wants_frames ? GetPythonFrames() : std::vector<SourceLocation>();
+  static bool deferred_frames =
+      xla::sys_util::GetEnvBool("XLA_IR_DEBUG_DEFERRED", false);
+  static xla::int64 sample_rate =
+      xla::sys_util::GetEnvInt("XLA_IR_DEBUG_SAMPLE_RATE", 1);
+  if (!wants_frames) {
+    return;
+  }
+  if (sample_rate > 1) {
+    thread_local xla::int64 node_count = 0;
+    if (node_count++ % sample_rate != 0) {
+      return;
+    }
+  }
+  if (deferred_frames) {
+    metadata->frame_tokens = GetPythonFrameTokens();
+  } else {
+    metadata->frame_info = GetPythonFrames();
+  }
+}
+
+void Node::SetCheckpointInfo(bool check_operands) {
+  // Both the region membership and the rematerialization change the lowering,
+  // so they need to be part of the hashes.
+  checkpoint_id_ = GetCurrentCheckpointId();
+  if (checkpoint_id_ != 0) {
+    node_hash_ = xla::util::HashCombine(node_hash_, checkpoint_id_);
+    hash_ = xla::util::HashCombine(hash_, checkpoint_id_);
+  } else if (check_operands && !at::GradMode::is_enabled()) {
+    for (auto& operand : operands_as_outputs_) {
+      if (operand.node->checkpoint_id() != 0) {
+        rematerialize_operands_ = true;
+        node_hash_ = xla::util::HashCombine(node_hash_, 0x3c1f7d98a);
+        hash_ = xla::util::HashCombine(hash_, 0x3c1f7d98a);
+        break;
+      }
+    }
+  }
+}
+
+void PushCheckpointRegion() {
+  g_checkpoint_context.regions.push_back(g_checkpoint_context.next_id);
+  g_checkpoint_context.next_id += 1;
+}
+
+void PopCheckpointRegion() {
+  XLA_CHECK(!g_checkpoint_context.regions.empty());
+  g_checkpoint_context.regions.pop_back();
+}
+
+void CheckpointScope::ResetCheckpoints() {
+  XLA_CHECK_EQ(g_checkpoint_context.regions.size(), 0)
+      << "Step marked within a checkpoint region";
+  g_checkpoint_context.next_id = 1;
+}
+
+void PushScope(const std::string& name) {
+  size_t id = g_scope_context.next_id;
+  g_scope_context.scopes.push_back(
+      {absl::StrCat(name, ".", id), g_scope_context.next_id + 1});
+  g_scope_context.next_id = 1;
+}
+
+void PopScope() {
+  XLA_CHECK(!g_scope_context.scopes.empty());
+  g_scope_context.next_id = g_scope_context.scopes.back().saved_next_id;
+  g_scope_context.scopes.pop_back();
 }
 
 ScopePusher::ScopePusher(const std::string& name) { PushScope(name); }
@@ -16,6 +16,7 @@
 #include "tensorflow/compiler/xla/client/xla_builder.h"
 #include "tensorflow/compiler/xla/xla_client/types.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
+#include "torch_xla/csrc/node_pool.h"
 #include "torch_xla/csrc/python_util.h"
 
 namespace torch_xla {
@@ -35,8 +36,15 @@ struct UserMetaData {
 };
 
 struct MetaData {
+  // Returns the Python frames captured when the node was created, resolving
+  // the deferred ones. If max_frames is greater than zero, at most max_frames
+  // (innermost) frames are returned.
+  std::vector<SourceLocation> GetFrameInfo(size_t max_frames = 0) const;
+
   std::string scope;
   std::vector<SourceLocation> frame_info;
+  // The frames captured in deferred mode, resolved by GetFrameInfo().
+  std::vector<FrameToken> frame_tokens;
 };
 
 // Represents a use of the output of a given node.
@@ -192,7 +200,7 @@ class Node {
 
   // Retrieves the full shape of the IR Node. Note that if this is a
   // multi-output node, the returned shape will be a tuple.
-  const xla::Shape& shape() const { return shape_; }
+  const xla::Shape& shape() const { return *shape_; }
 
   // Retrieves the shape of the output at a given index. If the node is not a
   // multi-output node, output_index must be zero.
@@ -202,14 +210,40 @@ class Node {
 
   const Output& operand(size_t i) const { return operands_as_outputs_.at(i); }
 
+  // Retrieves the node providing the i-th operand, holding a reference to it.
+  const NodePtr& operand_node(size_t i) const { return operands_.at(i); }
+
   const std::set<Use>& uses() const { return uses_; }
 
   xla::hash_t node_hash() const { return node_hash_; }
 
   xla::hash_t hash() const { return hash_; }
 
+  // An upper bound of the number of nodes of the graph rooted at this node,
+  // computed at construction as the saturating sum of the operands ones. The
+  // subgraphs shared by more than one operand are counted more than once.
+  size_t graph_size() const { return graph_size_; }
+
+  // Replaces the graph size upper bound with the precise count.
+  void set_graph_size(size_t graph_size) { graph_size_ = graph_size; }
+
+  // Accounts host memory held by the node on top of the node object itself,
+  // like the literal of the constants.
+  void AddHostBytes(size_t bytes);
+
+  // Returns the (estimated) host memory held by all the live IR nodes.
+  static size_t GetLiveHostBytes();
+
   const MetaData& metadata() const { return metadata_; }
 
+  // The checkpoint region the node has been created within, or zero if none.
+  size_t checkpoint_id() const { return checkpoint_id_; }
+
+  // Whether the node has been created with autograd disabled (typically by the
+  // backward pass) and consumes values of checkpoint regions, which should
+  // then be recomputed for it rather than kept live.
+  bool rematerialize_operands() const { return rematerialize_operands_; }
+
   UserMetaData* user_metadata() const { return user_metadata_.get(); }
 
   std::shared_ptr<UserMetaData> SetUserMetadata(
@@ -239,19 +273,30 @@ class Node {
 
   void AddUse(Use use) { uses_.insert(std::move(use)); }
 
+  void UpdateGraphSize();
+
+  // Recomputes the graph hash and size of the nodes using this one, directly or
+  // not, after one of its operands got replaced.
+  void UpdateUsersGraphInfo();
+
   void RemoveUse(const Use& use) { uses_.erase(use); }
 
-  xla::Shape GetOpShape(const std::function<xla::Shape()>& shape_fn) const;
+  std::shared_ptr<const xla::Shape> GetOpShape(
+      const std::function<xla::Shape()>& shape_fn) const;
 
   static xla::hash_t GetOpHash(OpKind op, const xla::Shape& shape,
                                xla::hash_t hash_seed);
 
-  static std::vector<SourceLocation> GetFrameInfo();
+  static void CaptureFrameInfo(MetaData* metadata);
+
+  void SetCheckpointInfo(bool check_operands);
 
   // The ID of the operation captured by this node.
   OpKind op_;
   size_t num_outputs_ = 1;
-  xla::Shape shape_;
+  // The canonical (interned) shape, shared with the other nodes having the same
+  // shape.
+  std::shared_ptr<const xla::Shape> shape_;
   // A node holds a real reference to its operands.
   std::vector<NodePtr> operands_;
   // Outputs do not hold references on the nodes, and neither do the uses, since
@@ -263,13 +308,23 @@ class Node {
   xla::hash_t node_hash_ = 0;
   // The hash value of the graph rooted at this node.
   xla::hash_t hash_ = 0;
+  size_t graph_size_ = 1;
+  size_t host_bytes_ = 0;
   // The IR specific metadata attached to the IR node.
   MetaData metadata_;
+  size_t checkpoint_id_ = 0;
+  bool rematerialize_operands_ = false;
   // The IR framework user can attach a user defined metadata object deriving
   // from UserMetaData.
   std::shared_ptr<UserMetaData> user_metadata_;
 };
 
+// Enters (and exits) a new IR scope. Scope names get their position within the
+// parent scope appended, so that they are stable across steps.
+void PushScope(const std::string& name);
+
+void PopScope();
+
 // RAII data structure to be used a stack variable to enter a new IR scope. IR
 // scope names will appear in the IR and will help identifying the source of the
 // single IR nodes.
@@ -280,14 +335,35 @@ struct ScopePusher {
   static void ResetScopes();
 };
 
+// The IR nodes created with autograd enabled within a checkpoint region are
+// tagged with the region ID. When the graph is lowered, the region values used
+// by nodes created with autograd disabled are recomputed from the region
+// inputs, instead of keeping the forward ones live until the backward pass.
+void PushCheckpointRegion();
+
+void PopCheckpointRegion();
+
+// RAII data structure to be used a stack variable to enter a new checkpoint
+// region.
+struct CheckpointScope {
+  CheckpointScope() { PushCheckpointRegion(); }
+  ~CheckpointScope() { PopCheckpointRegion(); }
+
+  // The region IDs are assigned by creation order within a step, so that the
+  // graphs hashes are stable across steps.
+  static void ResetCheckpoints();
+};
+
 inline std::ostream& operator<<(std::ostream& stream, const Node& node) {
   stream << node.ToString();
   return stream;
 }
 
+// The nodes are allocated from the per thread NodePool.
 template <typename T, typename... Args>
 NodePtr MakeNode(Args&&... args) {
-  return std::make_shared<T>(std::forward<Args>(args)...);
+  return std::allocate_shared<T>(NodePoolAllocator<T>(),
+                                 std::forward<Args>(args)...);
 }
 
 template <typename T>
@@ -3,17 +3,22 @@
 #include <algorithm>
 #include <exception>
 #include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <string>
 #include <unordered_map>
 
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
 #include "absl/strings/str_split.h"
 #include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/xla/xla_client/tf_logging.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/core/platform/env.h"
 
 namespace torch_xla {
 namespace {
@@ -27,6 +32,11 @@ class LayoutManager {
 
   const std::vector<xla::int64>* GetLayout(
       absl::Span<const xla::int64> dimensions) const {
+    // Skips hashing the dimensions of every traced shape when no layout is
+    // configured, which is the common case.
+    if (layouts_.empty()) {
+      return nullptr;
+    }
     auto it = layouts_.find(dimensions);
     return it != layouts_.end() ? &it->second->layout : nullptr;
   }
@@ -60,21 +70,33 @@ class LayoutManager {
     // Layouts: SHAPE=LAYOUT;...
     // SHAPE: INT,...
     // LAYOUT: INT,...
-    std::string layouts_env = xla::sys_util::GetEnvString("XLA_LAYOUTS", "");
-    if (!layouts_env.empty()) {
-      std::vector<std::string> layouts = absl::StrSplit(layouts_env, ';');
-      for (const auto& layout_str : layouts) {
-        std::vector<std::string> parts = absl::StrSplit(layout_str, '=');
-        XLA_CHECK_EQ(parts.size(), 2) << layout_str;
-
-        auto entry = std::make_shared<LayoutEntry>();
-        entry->dimensions = ParseIntList(parts[0]);
-        entry->layout = ParseLayout(parts[1], entry->dimensions.size());
-        layouts_.emplace(entry->dimensions, entry);
-
-        TF_VLOG(2) << "Registering layout " << parts[1] << " for shape "
-                   << parts[0];
-      }
+    // The XLA_LAYOUTS_FILE file has one SHAPE=LAYOUT entry per line, and the
+    // XLA_LAYOUTS entries override its ones.
+    std::string layouts_file =
+        xla::sys_util::GetEnvString("XLA_LAYOUTS_FILE", "");
+    if (!layouts_file.empty()) {
+      std::string layouts;
+      XLA_CHECK_OK(tensorflow::ReadFileToString(tensorflow::Env::Default(),
+                                                layouts_file, &layouts));
+      ParseLayouts(layouts, '\n');
+    }
+    ParseLayouts(xla::sys_util::GetEnvString("XLA_LAYOUTS", ""), ';');
+  }
+
+  void ParseLayouts(const std::string& layouts_str, char separator) {
+    std::vector<std::string> layouts =
+        absl::StrSplit(layouts_str, separator, absl::SkipWhitespace());
+    for (const auto& layout_str : layouts) {
+      std::vector<std::string> parts = absl::StrSplit(layout_str, '=');
+      XLA_CHECK_EQ(parts.size(), 2) << layout_str;
+
+      auto entry = std::make_shared<LayoutEntry>();
+      entry->dimensions = ParseIntList(parts[0]);
+      entry->layout = ParseLayout(parts[1], entry->dimensions.size());
+      layouts_[entry->dimensions] = entry;
+
+      TF_VLOG(2) << "Registering layout " << parts[1] << " for shape "
+                 << parts[0];
     }
   }
 
@@ -111,6 +133,80 @@ double PaddingFactor(xla::int64 size, int padding) {
                         : 0.0);
 }
 
+// Records the shapes which get the layout picked by the TPU heuristic, and
+// chooses their layouts with a cost model, to be saved and loaded by the
+// following runs with XLA_LAYOUTS_FILE.
+class LayoutAutotuner {
+ public:
+  static LayoutAutotuner* Get() {
+    static const bool enabled =
+        xla::sys_util::GetEnvBool("XLA_LAYOUT_AUTOTUNE", false);
+    static LayoutAutotuner* autotuner =
+        enabled ? new LayoutAutotuner() : nullptr;
+    return autotuner;
+  }
+
+  void Record(absl::Span<const xla::int64> dimensions) {
+    std::lock_guard<std::mutex> lock(lock_);
+    ++shapes_[xla::util::ToVector<xla::int64>(dimensions)];
+  }
+
+  std::string GetLayouts() const {
+    static const double relayout_cost =
+        xla::sys_util::GetEnvDouble("XLA_LAYOUT_RELAYOUT_COST", 0.05);
+    std::lock_guard<std::mutex> lock(lock_);
+    std::string layouts;
+    for (auto& dimensions_count : shapes_) {
+      const std::vector<xla::int64>& dimensions = dimensions_count.first;
+      std::vector<xla::int64> layout =
+          ChooseLayout(dimensions, relayout_cost);
+      absl::StrAppend(&layouts, absl::StrJoin(dimensions, ","), "=",
+                      absl::StrJoin(layout, ","), "\n");
+    }
+    return layouts;
+  }
+
+ private:
+  // The TPU tiles the two most minor dimensions by 128 and 8, so the cost of a
+  // layout is its padding factor, plus a flat penalty for the non row-major
+  // ones, which need to be re-laid out when transferred from and to the host.
+  static std::vector<xla::int64> ChooseLayout(
+      const std::vector<xla::int64>& dimensions, double relayout_cost) {
+    xla::int64 rank = dimensions.size();
+    std::vector<xla::int64> descending_layout =
+        xla::util::Iota<xla::int64>(rank, rank - 1, -1);
+    std::vector<xla::int64> best_layout = descending_layout;
+    double best_cost = PaddingFactor(dimensions[rank - 1], 128) *
+                       PaddingFactor(dimensions[rank - 2], 8);
+    for (xla::int64 minor = 0; minor < rank; ++minor) {
+      for (xla::int64 second_minor = 0; second_minor < rank; ++second_minor) {
+        if (minor == second_minor) {
+          continue;
+        }
+        std::vector<xla::int64> layout({minor, second_minor});
+        for (auto dim : descending_layout) {
+          if (dim != minor && dim != second_minor) {
+            layout.push_back(dim);
+          }
+        }
+        double cost = PaddingFactor(dimensions[minor], 128) *
+                      PaddingFactor(dimensions[second_minor], 8);
+        if (layout != descending_layout) {
+          cost += relayout_cost;
+        }
+        if (cost < best_cost) {
+          best_cost = cost;
+          best_layout = std::move(layout);
+        }
+      }
+    }
+    return best_layout;
+  }
+
+  mutable std::mutex lock_;
+  std::map<std::vector<xla::int64>, size_t> shapes_;
+};
+
 xla::Shape MakeShapeWithSortedLayout(absl::Span<const xla::int64> dimensions,
                                      xla::PrimitiveType type) {
   // Place bigger dimensions on most minor layout locations.
@@ -181,9 +277,21 @@ xla::Shape MakeArrayShapeFromDimensions(
                                *layout_ptr);
   }
   if (dimensions.size() > 1 && device_type == DeviceType::TPU) {
+    LayoutAutotuner* autotuner = LayoutAutotuner::Get();
+    if (autotuner != nullptr) {
+      autotuner->Record(dimensions);
+    }
     return MakeTpuShape(dimensions, dynamic_dimensions, type);
   }
   return MakeTorchTensorLayout(dimensions, dynamic_dimensions, type);
 }
 
+void SaveAutotunedLayouts(const std::string& path) {
+  LayoutAutotuner* autotuner = LayoutAutotuner::Get();
+  XLA_CHECK(autotuner != nullptr)
+      << "Layout autotuning requires XLA_LAYOUT_AUTOTUNE=1";
+  XLA_CHECK_OK(tensorflow::WriteStringToFile(
+      tensorflow::Env::Default(), path, autotuner->GetLayouts()));
+}
+
 }  // namespace torch_xla
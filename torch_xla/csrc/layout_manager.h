@@ -1,5 +1,7 @@
 #pragma once
 
+#include <string>
+
 #include "absl/types/span.h"
 #include "tensorflow/compiler/xla/shape.h"
 #include "tensorflow/compiler/xla/types.h"
@@ -22,4 +24,9 @@ xla::Shape MakeArrayShapeFromDimensions(
     absl::Span<const bool> dynamic_dimensions, xla::PrimitiveType type,
     DeviceType device_type);
 
+// Writes to path the layouts chosen for the shapes recorded (with
+// XLA_LAYOUT_AUTOTUNE=1) by MakeArrayShapeFromDimensions(), in the format
+// loaded by XLA_LAYOUTS_FILE.
+void SaveAutotunedLayouts(const std::string& path);
+
 }  // namespace torch_xla
@@ -1,12 +1,27 @@
 #include "torch_xla/csrc/lowering_context.h"
 
+#include <algorithm>
+#include <map>
+#include <memory>
 #include <sstream>
 #include <stdexcept>
+#include <thread>
+#include <unordered_set>
 
 #include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/primitive_util.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/util.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/multi_wait.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/thread_pool.h"
+#include "torch_xla/csrc/helpers.h"
+#include "torch_xla/csrc/ops/permute.h"
+#include "torch_xla/csrc/ops/xla_ops.h"
 #include "torch_xla/csrc/python_util.h"
+#include "torch_xla/csrc/xla_sharding_util.h"
 
 namespace torch_xla {
 namespace ir {
@@ -40,8 +55,10 @@ class HloMetadataSetter {
     if (!nmeta.scope.empty()) {
       metadata.set_op_name(nmeta.scope);
     }
-    if (!nmeta.frame_info.empty()) {
-      const SourceLocation& frame = nmeta.frame_info.front();
+    std::vector<SourceLocation> frames =
+        nmeta.GetFrameInfo(/*max_frames=*/1);
+    if (!frames.empty()) {
+      const SourceLocation& frame = frames.front();
       std::string::size_type pos = frame.file.find_last_of('/');
       if (pos == std::string::npos) {
         pos = 0;
@@ -57,6 +74,115 @@ class HloMetadataSetter {
   LoweringContext* loctx_ = nullptr;
 };
 
+// The minimum number of nodes a region should have when the number of regions
+// is picked automatically, as each region adds a call and a tuple to the final
+// computation.
+static const size_t kMinRegionNodes = 512;
+
+// The elementwise operations which can be lowered in channels-last layout, or
+// over the unpermuted version of their operands, as their lowering does not
+// depend on the position of the dimensions.
+bool IsLayoutAgnosticElementwise(const Node* node) {
+  static const std::unordered_set<c10::Symbol>* ops =
+      new std::unordered_set<c10::Symbol>(
+          {at::aten::add, at::aten::sub, at::aten::mul, at::aten::div,
+           at::aten::relu, at::aten::clamp, at::aten::hardtanh,
+           at::aten::sigmoid, at::aten::tanh, at::aten::leaky_relu,
+           at::aten::neg, at::aten::abs, at::aten::exp, at::aten::where});
+  return ops->count(node->op().op) > 0;
+}
+
+std::vector<xla::int64> ChannelsLastPermutation(xla::int64 rank) {
+  // NCHW -> NHWC
+  std::vector<xla::int64> permutation = {0};
+  for (xla::int64 dim = 2; dim < rank; ++dim) {
+    permutation.push_back(dim);
+  }
+  permutation.push_back(1);
+  return permutation;
+}
+
+struct LoweringRegion {
+  size_t begin = 0;
+  size_t end = 0;
+  // The values computed outside the region, which it takes as parameters.
+  std::vector<Output> inputs;
+  // The values computed by the region, which it returns as tuple elements.
+  std::vector<Output> outputs;
+  size_t cse_eliminated = 0;
+  xla::XlaComputation computation;
+};
+
+// Constants are cheap to lower, so each region lowers its own copy of the ones
+// it uses. All the other leaves (device data, tokens, ...) are lowered once by
+// the calling context, and passed to the regions using them.
+bool IsRegionLocalLeaf(const Node* node) {
+  return node->operands().empty() && node->op() == OpKind(at::prim::Constant);
+}
+
+// Region values only need to be recomputed if they are not leaves.
+bool IsRematerializable(const Node* node) {
+  return node->checkpoint_id() != 0 && !node->operands().empty();
+}
+
+bool IsValidRematerializationGate(const xla::Shape& shape) {
+  return shape.IsArray() && xla::ShapeUtil::ElementsIn(shape) > 0 &&
+         !xla::primitive_util::IsComplexType(shape.element_type());
+}
+
+// Creates a predicate which XLA cannot constant fold, from the first element of
+// the gate value. A NaN makes it false, which is fine as both the conditional
+// branches compute the same values.
+xla::XlaOp MakeGatePredicate(xla::XlaOp gate, const xla::Shape& shape) {
+  xla::XlaOp value = gate;
+  if (shape.rank() > 0) {
+    std::vector<xla::int64> zeros(shape.rank(), 0);
+    std::vector<xla::int64> ones(shape.rank(), 1);
+    value = xla::Reshape(xla::Slice(gate, zeros, ones, ones), {});
+  }
+  value = xla::ConvertElementType(value, xla::PrimitiveType::F32);
+  return xla::Eq(value, value);
+}
+
+size_t GetAutoRegionCount(size_t num_nodes) {
+  static const size_t min_nodes =
+      xla::sys_util::GetEnvInt("XLA_PARALLEL_LOWERING_MIN_NODES", 0);
+  static const size_t max_regions = xla::sys_util::GetEnvInt(
+      "XLA_PARALLEL_LOWERING_REGIONS",
+      std::max<xla::int64>(std::thread::hardware_concurrency(), 1));
+  if (min_nodes == 0 || num_nodes < min_nodes) {
+    return 1;
+  }
+  return std::max<size_t>(std::min(max_regions, num_nodes / kMinRegionNodes),
+                          1);
+}
+
+void LowerRegion(const std::string& name, const Device& device,
+                 absl::Span<const Node* const> post_order,
+                 LoweringRegion* region) {
+  LoweringContext loctx(name, device);
+  for (size_t i = 0; i < region->inputs.size(); ++i) {
+    const Output& input = region->inputs[i];
+    loctx.AssignOutputOp(input, xla::Parameter(loctx.builder(), i,
+                                               input.shape(),
+                                               absl::StrCat("p", i)));
+  }
+  for (size_t i = region->begin; i < region->end; ++i) {
+    // Local leaves are lowered on demand by GetOutputOp().
+    if (!post_order[i]->operands().empty()) {
+      loctx.LowerNode(post_order[i]);
+    }
+  }
+  std::vector<xla::XlaOp> outputs;
+  outputs.reserve(region->outputs.size());
+  for (auto& output : region->outputs) {
+    outputs.push_back(loctx.GetOutputOp(output));
+  }
+  region->computation = ConsumeValue(
+      loctx.Build(xla::Tuple(loctx.builder(), outputs)));
+  region->cse_eliminated = loctx.GetEliminatedNodeCount();
+}
+
 }  // namespace
 
 LoweringContext::LoweringContext(const std::string& name, Device device)
@@ -64,12 +190,34 @@ LoweringContext::LoweringContext(const std::string& name, Device device)
 
 LoweringContext::LoweringContext(const std::string& name, Device device,
                                  absl::Span<const Node* const> post_order,
-                                 Util::EmissionMap emit_status)
+                                 Util::EmissionMap emit_status,
+                                 absl::Span<const Output> roots)
     : builder_(name),
       device_(std::move(device)),
       emit_status_(std::move(emit_status)) {
-  for (auto node : post_order) {
-    LowerNode(node);
+  size_t num_regions =
+      !roots.empty() ? GetAutoRegionCount(post_order.size()) : 1;
+  if (num_regions > 1) {
+    LowerRegions(post_order, roots, num_regions);
+  } else {
+    if (!roots.empty() && TransposeFoldingEnabled()) {
+      for (auto node : post_order) {
+        for (auto& operand : node->operands()) {
+          ++output_uses_[operand];
+        }
+      }
+      for (auto& root : roots) {
+        ++output_uses_[root];
+      }
+    }
+    for (auto node : post_order) {
+      LowerNode(node);
+    }
+    for (auto& root : roots) {
+      if (permuted_outputs_.count(GetCanonicalOutput(root)) > 0) {
+        read_permuted_outputs_.insert(GetCanonicalOutput(root));
+      }
+    }
   }
 }
 
@@ -78,6 +226,13 @@ xla::XlaOp LoweringContext::GetParameter(
   xla::ComputationClient::Data::OpaqueHandle handle = data->GetOpaqueHandle();
   auto it = parameters_map_.find(handle);
   if (it == parameters_map_.end()) {
+    ShardedData* sharded_data = ShardingUtil::GetShardedData(data);
+    absl::optional<xla::OpSharding> sharding;
+    if (sharded_data != nullptr) {
+      sharding = sharded_data->spec()->sharding;
+      is_sharded_ = true;
+    }
+    xla::XlaScopedShardingAssignment scoped_sharding(builder(), sharding);
     xla::XlaOp param =
         xla::Parameter(builder(), parameters_.size(), data->shape(),
                        absl::StrCat("p", parameters_.size()));
@@ -111,8 +266,30 @@ void LoweringContext::SetResult(size_t index, xla::XlaOp op) {
   root_tuple_.at(index) = std::move(op);
 }
 
+void LoweringContext::SetResultSharding(size_t index,
+                                        const xla::OpSharding& sharding) {
+  result_shardings_[index] = sharding;
+  is_sharded_ = true;
+}
+
 xla::StatusOr<xla::XlaComputation> LoweringContext::Build() {
   if (!root_tuple_.empty()) {
+    absl::optional<xla::OpSharding> sharding;
+    if (is_sharded_) {
+      // The partitioner takes the output shardings from the root tuple.
+      sharding = xla::OpSharding();
+      sharding->set_type(xla::OpSharding::TUPLE);
+      for (size_t i = 0; i < root_tuple_.size(); ++i) {
+        auto it = result_shardings_.find(i);
+        xla::OpSharding* element = sharding->add_tuple_shardings();
+        if (it != result_shardings_.end()) {
+          *element = it->second;
+        } else {
+          element->set_type(xla::OpSharding::REPLICATED);
+        }
+      }
+    }
+    xla::XlaScopedShardingAssignment scoped_sharding(builder(), sharding);
     xla::XlaOp root = xla::Tuple(builder(), root_tuple_);
     return builder()->Build(root);
   }
@@ -144,18 +321,623 @@ xla::XlaOp LoweringContext::GetOutputOp(const Output& output) {
   return it->second;
 }
 
+bool LoweringContext::ChannelsLastEnabled() {
+  static const bool channels_last =
+      xla::sys_util::GetEnvBool("XLA_CHANNELS_LAST", false);
+  return channels_last;
+}
+
+xla::XlaOp LoweringContext::GetOutputOpChannelsLast(const Output& output) {
+  auto it = channels_last_outputs_.find(output);
+  if (it != channels_last_outputs_.end()) {
+    return it->second;
+  }
+  XLA_COUNTER("ChannelsLastTransposes", 1);
+  xla::XlaOp op = GetOutputOp(output);
+  xla::XlaOp channels_last_op =
+      xla::Transpose(op, ChannelsLastPermutation(output.shape().rank()));
+  channels_last_outputs_[output] = channels_last_op;
+  return channels_last_op;
+}
+
+bool LoweringContext::HasOutputOpChannelsLast(const Output& output) const {
+  return channels_last_outputs_.find(output) != channels_last_outputs_.end();
+}
+
+void LoweringContext::AssignOutputOpChannelsLast(const Output& output,
+                                                 xla::XlaOp op) {
+  AssignOutputOp(output,
+                 xla::Transpose(op, xla::InversePermutation(
+                                        ChannelsLastPermutation(
+                                            output.shape().rank()))));
+  channels_last_outputs_[output] = std::move(op);
+}
+
+bool LoweringContext::TryLowerNodeChannelsLast(const Node* node,
+                                                XlaOpVector* result_ops) {
+  const xla::Shape& shape = node->shape();
+  if (node->num_outputs() != 1 || shape.IsTuple() || shape.rank() < 4 ||
+      !IsLayoutAgnosticElementwise(node)) {
+    return false;
+  }
+  // Only go channels-last if it saves transposes, that is if all the full
+  // shape operands already are, and the others are scalars.
+  std::vector<const Output*> channels_last_operands;
+  for (auto& operand : node->operands()) {
+    const xla::Shape& operand_shape = operand.shape();
+    if (xla::ShapeUtil::IsScalar(operand_shape)) {
+      continue;
+    }
+    if (!xla::ShapeUtil::SameDimensions(operand_shape, shape) ||
+        !HasOutputOpChannelsLast(operand)) {
+      return false;
+    }
+    channels_last_operands.push_back(&operand);
+  }
+  if (channels_last_operands.empty()) {
+    return false;
+  }
+  // Temporarily point the operands to their channels-last lowering, so that
+  // the node lowering picks them up.
+  std::vector<xla::XlaOp> saved_ops;
+  for (auto operand : channels_last_operands) {
+    xla::XlaOp& op = emitted_outputs_[*operand];
+    saved_ops.push_back(op);
+    op = channels_last_outputs_.at(*operand);
+  }
+  XlaOpVector ops = node->Lower(this);
+  for (size_t i = 0; i < channels_last_operands.size(); ++i) {
+    emitted_outputs_[*channels_last_operands[i]] = saved_ops[i];
+  }
+  AssignOutputOpChannelsLast(Output(node), ops.at(0));
+  *result_ops = XlaOpVector({GetOutputOp(Output(node))});
+  return true;
+}
+
+bool LoweringContext::TransposeFoldingEnabled() {
+  static const bool transpose_folding =
+      xla::sys_util::GetEnvBool("XLA_IR_TRANSPOSE_FOLDING", true);
+  return transpose_folding;
+}
+
+size_t LoweringContext::GetRemovedTransposeCount() const {
+  // Every lowered permute had a transpose, while now only the permuted values
+  // whose transposed lowering is used have one. The others are removed by XLA
+  // as dead code.
+  return lowered_permutes_ > read_permuted_outputs_.size()
+             ? lowered_permutes_ - read_permuted_outputs_.size()
+             : 0;
+}
+
+const LoweringContext::PermutedOp* LoweringContext::GetFoldablePermutedOp(
+    const Output& operand) const {
+  auto uses_it = output_uses_.find(operand);
+  if (uses_it == output_uses_.end() || uses_it->second != 1) {
+    return nullptr;
+  }
+  auto it = permuted_outputs_.find(GetCanonicalOutput(operand));
+  return it != permuted_outputs_.end() ? &it->second : nullptr;
+}
+
+void LoweringContext::AssignOutputOpPermuted(
+    const Output& output, xla::XlaOp source,
+    std::vector<xla::int64> permutation) {
+  AssignOutputOp(output, xla::Transpose(source, permutation));
+  permuted_outputs_[output] = PermutedOp{source, std::move(permutation)};
+}
+
+bool LoweringContext::TryLowerNodePermuted(const Node* node,
+                                           XlaOpVector* result_ops,
+                                           OutputSet* folded_operands) {
+  if (output_uses_.empty() || node->num_outputs() != 1 ||
+      node->shape().IsTuple()) {
+    return false;
+  }
+  if (dynamic_cast<const ops::Permute*>(node) != nullptr) {
+    return LowerPermuteFolded(node, result_ops, folded_operands);
+  }
+  if (node->op() == OpKind(at::aten::mm) ||
+      node->op() == OpKind(at::aten::matmul)) {
+    return TryLowerDotPermuted(node, result_ops, folded_operands);
+  }
+  if (IsLayoutAgnosticElementwise(node)) {
+    return TryLowerElementwisePermuted(node, result_ops, folded_operands);
+  }
+  return false;
+}
+
+bool LoweringContext::LowerPermuteFolded(const Node* node,
+                                         XlaOpVector* result_ops,
+                                         OutputSet* folded_operands) {
+  const Output& operand = node->operand(0);
+  std::vector<xla::int64> permutation =
+      dynamic_cast<const ops::Permute*>(node)->dims();
+  xla::XlaOp source;
+  const PermutedOp* permuted = GetFoldablePermutedOp(operand);
+  if (permuted != nullptr) {
+    // permute(permute(x, p1), p2) == permute(x, p1[p2]).
+    for (auto& dim : permutation) {
+      dim = permuted->permutation[dim];
+    }
+    source = permuted->source;
+    folded_operands->insert(operand);
+  } else {
+    source = GetOutputOp(operand);
+  }
+  ++lowered_permutes_;
+  Output output(node);
+  if (xla::IsIdentityPermutation(permutation)) {
+    AssignOutputOp(output, source);
+  } else {
+    AssignOutputOpPermuted(output, source, std::move(permutation));
+  }
+  *result_ops = XlaOpVector({GetOutputOp(output)});
+  return true;
+}
+
+bool LoweringContext::TryLowerDotPermuted(const Node* node,
+                                          XlaOpVector* result_ops,
+                                          OutputSet* folded_operands) {
+  // Only the plain (batched) matrix products, with no broadcast of the batch
+  // dimensions nor type promotion, are folded.
+  const Output& lhs = node->operand(0);
+  const Output& rhs = node->operand(1);
+  const xla::Shape& lhs_shape = lhs.shape();
+  const xla::Shape& rhs_shape = rhs.shape();
+  xla::int64 rank = lhs_shape.rank();
+  if (rank < 2 || rhs_shape.rank() != rank ||
+      lhs_shape.element_type() != rhs_shape.element_type()) {
+    return false;
+  }
+  for (xla::int64 dim = 0; dim < rank - 2; ++dim) {
+    if (lhs_shape.dimensions(dim) != rhs_shape.dimensions(dim)) {
+      return false;
+    }
+  }
+  // Permutes moving the batch dimensions are left alone, as they would need
+  // the dot to transpose its output.
+  auto get_permuted = [&](const Output& operand) -> const PermutedOp* {
+    const PermutedOp* permuted = GetFoldablePermutedOp(operand);
+    for (xla::int64 dim = 0; permuted != nullptr && dim < rank - 2; ++dim) {
+      if (permuted->permutation[dim] != dim) {
+        permuted = nullptr;
+      }
+    }
+    return permuted;
+  };
+  const PermutedOp* lhs_permuted = get_permuted(lhs);
+  const PermutedOp* rhs_permuted = get_permuted(rhs);
+  if (lhs_permuted == nullptr && rhs_permuted == nullptr) {
+    return false;
+  }
+  // The dimension dim of a permuted operand is the dimension permutation[dim]
+  // of its source, and the batch dimensions stay in place.
+  auto source_dim = [](const PermutedOp* permuted, xla::int64 dim) {
+    return permuted != nullptr ? permuted->permutation[dim] : dim;
+  };
+  xla::DotDimensionNumbers dims;
+  for (xla::int64 dim = 0; dim < rank - 2; ++dim) {
+    dims.add_lhs_batch_dimensions(dim);
+    dims.add_rhs_batch_dimensions(dim);
+  }
+  dims.add_lhs_contracting_dimensions(source_dim(lhs_permuted, rank - 1));
+  dims.add_rhs_contracting_dimensions(source_dim(rhs_permuted, rank - 2));
+
+  xla::XlaOp lhs_op;
+  if (lhs_permuted != nullptr) {
+    lhs_op = lhs_permuted->source;
+    folded_operands->insert(lhs);
+  } else {
+    lhs_op = GetOutputOp(lhs);
+  }
+  xla::XlaOp rhs_op;
+  if (rhs_permuted != nullptr) {
+    rhs_op = rhs_permuted->source;
+    folded_operands->insert(rhs);
+  } else {
+    rhs_op = GetOutputOp(rhs);
+  }
+  xla::PrecisionConfig precision_config =
+      XlaHelpers::BuildPrecisionConfig(XlaHelpers::mat_mul_precision());
+  *result_ops = node->ReturnOp(
+      xla::DotGeneral(lhs_op, rhs_op, dims, &precision_config), this);
+  return true;
+}
+
+bool LoweringContext::TryLowerElementwisePermuted(const Node* node,
+                                                  XlaOpVector* result_ops,
+                                                  OutputSet* folded_operands) {
+  // The transpose is sunk below the node only if all the full shape operands
+  // have the same permutation, and the others are scalars.
+  const xla::Shape& shape = node->shape();
+  std::vector<xla::int64> permutation;
+  std::vector<const Output*> permuted_operands;
+  for (auto& operand : node->operands()) {
+    const xla::Shape& operand_shape = operand.shape();
+    if (xla::ShapeUtil::IsScalar(operand_shape)) {
+      continue;
+    }
+    const PermutedOp* permuted = GetFoldablePermutedOp(operand);
+    if (!xla::ShapeUtil::SameDimensions(operand_shape, shape) ||
+        permuted == nullptr ||
+        (!permuted_operands.empty() &&
+         permuted->permutation != permutation)) {
+      return false;
+    }
+    permutation = permuted->permutation;
+    permuted_operands.push_back(&operand);
+  }
+  if (permuted_operands.empty()) {
+    return false;
+  }
+  // Temporarily point the operands to their unpermuted source, so that the
+  // node lowering picks them up.
+  std::vector<xla::XlaOp> saved_ops;
+  for (auto operand : permuted_operands) {
+    xla::XlaOp& op = emitted_outputs_[*operand];
+    saved_ops.push_back(op);
+    op = GetFoldablePermutedOp(*operand)->source;
+  }
+  XlaOpVector ops = node->Lower(this);
+  for (size_t i = 0; i < permuted_operands.size(); ++i) {
+    emitted_outputs_[*permuted_operands[i]] = saved_ops[i];
+    folded_operands->insert(*permuted_operands[i]);
+  }
+  AssignOutputOpPermuted(Output(node), ops.at(0), std::move(permutation));
+  *result_ops = XlaOpVector({GetOutputOp(Output(node))});
+  return true;
+}
+
+void LoweringContext::MarkPermutedOperandsRead(
+    const Node* node, const OutputSet& folded_operands) {
+  for (auto& operand : node->operands()) {
+    Output canonical = GetCanonicalOutput(operand);
+    if (folded_operands.count(operand) == 0 &&
+        permuted_outputs_.count(canonical) > 0) {
+      read_permuted_outputs_.insert(canonical);
+    }
+  }
+}
+
+XlaOpVector LoweringContext::LowerNodeRematerialized(const Node* node) {
+  std::map<size_t, std::vector<Output>> missing_outputs;
+  std::vector<Output> region_operands;
+  const Output* gate = nullptr;
+  for (auto& operand : node->operands()) {
+    if (IsRematerializable(operand.node)) {
+      region_operands.push_back(operand);
+      if (rematerialized_outputs_.count(operand) == 0) {
+        std::vector<Output>& outputs =
+            missing_outputs[operand.node->checkpoint_id()];
+        if (std::find(outputs.begin(), outputs.end(), operand) ==
+            outputs.end()) {
+          outputs.push_back(operand);
+        }
+      }
+    } else if (gate == nullptr &&
+               IsValidRematerializationGate(operand.shape())) {
+      gate = &operand;
+    }
+  }
+  if (gate == nullptr) {
+    // Without a value computed outside the region, XLA would be free to run
+    // the recomputation early, and to merge it with the original one.
+    return node->Lower(this);
+  }
+  for (auto& region_outputs : missing_outputs) {
+    RematerializeRegion(region_outputs.first, region_outputs.second, *gate);
+  }
+  std::vector<xla::XlaOp> saved_ops;
+  for (auto& operand : region_operands) {
+    xla::XlaOp& op = emitted_outputs_[operand];
+    saved_ops.push_back(op);
+    op = rematerialized_outputs_.at(operand);
+  }
+  XlaOpVector result_ops = node->Lower(this);
+  // Restore in reverse order, in case the node uses the same value twice.
+  for (size_t i = region_operands.size(); i > 0; --i) {
+    emitted_outputs_[region_operands[i - 1]] = saved_ops[i - 1];
+  }
+  return result_ops;
+}
+
+void LoweringContext::RematerializeRegion(size_t checkpoint_id,
+                                          absl::Span<const Output> outputs,
+                                          const Output& gate) {
+  XLA_COUNTER("CheckpointRematerializations", 1);
+  // The region inputs are the values produced outside of it, and the non
+  // constant leaves. Marking their nodes as emitted makes the post-order walk
+  // stop at them.
+  Util::EmissionMap emit_map;
+  std::vector<Output> inputs;
+  OutputSet inputs_set;
+  std::unordered_set<const Node*> visited;
+  std::vector<const Node*> queue;
+  for (auto& output : outputs) {
+    queue.push_back(output.node);
+  }
+  while (!queue.empty()) {
+    const Node* node = queue.back();
+    queue.pop_back();
+    if (!visited.insert(node).second) {
+      continue;
+    }
+    for (auto& operand : node->operands()) {
+      if (operand.node->checkpoint_id() == checkpoint_id &&
+          (!operand.node->operands().empty() ||
+           IsRegionLocalLeaf(operand.node))) {
+        queue.push_back(operand.node);
+      } else if (inputs_set.insert(operand).second) {
+        inputs.push_back(operand);
+        emit_map[operand.node] = Util::kEmitted;
+      }
+    }
+  }
+  std::vector<const Node*> post_order;
+  for (auto& output : outputs) {
+    std::vector<const Node*> nodes =
+        Util::ComputePostOrder(output.node, &emit_map);
+    post_order.insert(post_order.end(), nodes.begin(), nodes.end());
+  }
+
+  LoweringContext loctx(absl::StrCat("Checkpoint", checkpoint_id), device_);
+  std::vector<xla::Shape> input_shapes;
+  std::vector<xla::XlaOp> input_ops;
+  for (auto& input : inputs) {
+    input_shapes.push_back(input.shape());
+    input_ops.push_back(GetOutputOp(input));
+  }
+  xla::XlaOp param =
+      xla::Parameter(loctx.builder(), 0,
+                     xla::ShapeUtil::MakeTupleShape(input_shapes), "p0");
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    loctx.AssignOutputOp(inputs[i], xla::GetTupleElement(param, i));
+  }
+  for (auto node : post_order) {
+    // Local leaves are lowered on demand by GetOutputOp().
+    if (!node->operands().empty()) {
+      loctx.LowerNode(node);
+    }
+  }
+  std::vector<xla::XlaOp> results;
+  for (auto& output : outputs) {
+    results.push_back(loctx.GetOutputOp(output));
+  }
+  xla::XlaComputation computation =
+      ConsumeValue(loctx.Build(xla::Tuple(loctx.builder(), results)));
+
+  xla::XlaOp operand = xla::Tuple(builder(), input_ops);
+  xla::XlaOp result =
+      xla::Conditional(MakeGatePredicate(GetOutputOp(gate), gate.shape()),
+                       operand, computation, operand, computation);
+  for (size_t i = 0; i < outputs.size(); ++i) {
+    rematerialized_outputs_[outputs[i]] = xla::GetTupleElement(result, i);
+  }
+}
+
+void LoweringContext::LowerRegions(absl::Span<const Node* const> post_order,
+                                   absl::Span<const Output> roots,
+                                   size_t num_regions) {
+  XLA_TIMED("LowerRegions");
+  std::unordered_map<const Node*, size_t> positions;
+  positions.reserve(post_order.size());
+  std::vector<size_t> lowered_nodes;
+  for (size_t i = 0; i < post_order.size(); ++i) {
+    positions.emplace(post_order[i], i);
+    if (!post_order[i]->operands().empty()) {
+      lowered_nodes.push_back(i);
+    }
+  }
+  num_regions = std::max<size_t>(
+      std::min<size_t>(num_regions, lowered_nodes.size()), 1);
+
+  // Regions split the non leaf nodes evenly. The leaves are lowered either by
+  // this context, or on demand by the regions using them.
+  std::vector<LoweringRegion> regions(num_regions);
+  for (size_t i = 0; i < num_regions; ++i) {
+    size_t last = (i + 1) * lowered_nodes.size() / num_regions;
+    regions[i].begin = i > 0 ? regions[i - 1].end : 0;
+    regions[i].end =
+        i + 1 < num_regions ? lowered_nodes[last - 1] + 1 : post_order.size();
+  }
+  auto region_of = [&](const Node* node) -> size_t {
+    size_t position = positions.at(node);
+    auto it = std::upper_bound(
+        regions.begin(), regions.end(), position,
+        [](size_t pos, const LoweringRegion& region) {
+          return pos < region.end;
+        });
+    return it - regions.begin();
+  };
+  using OutputSet = std::unordered_set<Output, Output::Hasher>;
+  std::vector<OutputSet> region_inputs(num_regions);
+  std::vector<OutputSet> region_outputs(num_regions);
+  auto add_output = [&](size_t index, const Output& output) {
+    if (region_outputs[index].insert(output).second) {
+      regions[index].outputs.push_back(output);
+    }
+  };
+  for (size_t i = 0; i < num_regions; ++i) {
+    LoweringRegion& region = regions[i];
+    for (size_t j = region.begin; j < region.end; ++j) {
+      for (auto& operand : post_order[j]->operands()) {
+        if (IsRegionLocalLeaf(operand.node)) {
+          continue;
+        }
+        size_t operand_region = operand.node->operands().empty()
+                                    ? num_regions
+                                    : region_of(operand.node);
+        if (operand_region == i) {
+          continue;
+        }
+        if (region_inputs[i].insert(operand).second) {
+          region.inputs.push_back(operand);
+        }
+        if (operand_region < num_regions) {
+          add_output(operand_region, operand);
+        }
+      }
+    }
+  }
+  std::unordered_set<const Node*> leaf_roots;
+  for (auto& root : roots) {
+    if (!root.node->operands().empty()) {
+      add_output(region_of(root.node), root);
+    } else {
+      leaf_roots.insert(root.node);
+    }
+  }
+
+  std::string name = builder()->name();
+  xla::util::MultiWait mwait(num_regions - 1);
+  for (size_t i = 0; i + 1 < num_regions; ++i) {
+    LoweringRegion* region = &regions[i];
+    auto lower_fn = [&, region, i]() {
+      LowerRegion(absl::StrCat(name, "_region", i), device_, post_order,
+                  region);
+    };
+    xla::env::ScheduleClosure(mwait.Completer(std::move(lower_fn)));
+  }
+  // The last region is lowered by the calling thread, which then lowers the
+  // leaves in post-order, so that the parameters are created in the same order
+  // of the sequential lowering. The closures reference the local state, so
+  // waiting for them cannot be skipped.
+  std::exception_ptr exptr;
+  try {
+    LowerRegion(absl::StrCat(name, "_region", num_regions - 1), device_,
+                post_order, &regions.back());
+    for (auto node : post_order) {
+      if (node->operands().empty() &&
+          (!IsRegionLocalLeaf(node) || leaf_roots.count(node) > 0)) {
+        LowerNode(node);
+      }
+    }
+  } catch (...) {
+    exptr = std::current_exception();
+  }
+  mwait.Wait();
+  if (exptr != nullptr) {
+    std::rethrow_exception(exptr);
+  }
+
+  for (auto& region : regions) {
+    std::vector<xla::XlaOp> inputs;
+    inputs.reserve(region.inputs.size());
+    for (auto& input : region.inputs) {
+      inputs.push_back(GetOutputOp(input));
+    }
+    xla::XlaOp call = xla::Call(builder(), region.computation, inputs);
+    for (size_t i = 0; i < region.outputs.size(); ++i) {
+      AssignOutputOp(region.outputs[i], xla::GetTupleElement(call, i));
+    }
+    cse_eliminated_ += region.cse_eliminated;
+  }
+  for (auto node : post_order) {
+    emit_status_[node] = Util::kEmitted;
+  }
+  XLA_COUNTER("LoweringRegions", num_regions);
+}
+
+Output LoweringContext::GetCanonicalOutput(const Output& output) const {
+  auto it = cse_replacements_.find(output.node);
+  return it != cse_replacements_.end() ? Output(it->second, output.index)
+                                       : output;
+}
+
+xla::hash_t LoweringContext::GetCseKey(const Node* node) const {
+  // The node hash already accounts for the op, the shape and the op specific
+  // parameters. The operands are mixed in by identity, after replacement, so
+  // that equivalent nodes end up with equal keys even if the hash of the graph
+  // rooted at them is different (like for device data with the same shape).
+  xla::hash_t key = node->node_hash();
+  for (auto& operand : node->operands()) {
+    Output canonical = GetCanonicalOutput(operand);
+    key = xla::util::HashCombine(
+        key, xla::util::MHash(reinterpret_cast<uintptr_t>(canonical.node),
+                              canonical.index));
+  }
+  return key;
+}
+
+const Node* LoweringContext::FindEquivalentNode(const Node* node,
+                                                const xla::hash_t& key) const {
+  auto it = cse_nodes_.find(key);
+  if (it == cse_nodes_.end()) {
+    return nullptr;
+  }
+  for (const Node* candidate : it->second) {
+    if (candidate->op() != node->op() ||
+        candidate->node_hash() != node->node_hash() ||
+        candidate->num_outputs() != node->num_outputs() ||
+        candidate->operands().size() != node->operands().size() ||
+        !xla::ShapeUtil::Equal(candidate->shape(), node->shape())) {
+      continue;
+    }
+    bool equal_operands = true;
+    for (size_t i = 0; i < node->operands().size() && equal_operands; ++i) {
+      equal_operands = GetCanonicalOutput(candidate->operand(i)) ==
+                       GetCanonicalOutput(node->operand(i));
+    }
+    if (equal_operands) {
+      return candidate;
+    }
+  }
+  return nullptr;
+}
+
 XlaOpVector LoweringContext::LowerNode(const Node* node) {
+  static const bool enable_cse = xla::sys_util::GetEnvBool("XLA_IR_CSE", true);
+  // Device data nodes are only identified by their shape within the node hash,
+  // and the parameters they lower to are already de-duplicated by handle. The
+  // only other leaves considered are constants, whose value is in the hash.
+  bool cse_candidate = enable_cse && node->op() != ops::xla_device_data &&
+                       node->op() != ops::xla_not_supported &&
+                       (!node->operands().empty() ||
+                        node->op() == OpKind(at::prim::Constant));
+  xla::hash_t cse_key;
+  if (cse_candidate) {
+    cse_key = GetCseKey(node);
+    const Node* equivalent = FindEquivalentNode(node, cse_key);
+    if (equivalent != nullptr) {
+      XlaOpVector result_ops;
+      for (size_t i = 0; i < node->num_outputs(); ++i) {
+        // The users of node read the permuted outputs of equivalent through
+        // the canonical output, so they are not copied.
+        xla::XlaOp op = GetOutputOp(Output(equivalent, i));
+        AssignOutputOp(Output(node, i), op);
+        auto it = channels_last_outputs_.find(Output(equivalent, i));
+        if (it != channels_last_outputs_.end()) {
+          channels_last_outputs_[Output(node, i)] = it->second;
+        }
+        result_ops.push_back(op);
+      }
+      cse_replacements_.emplace(node, equivalent);
+      ++cse_eliminated_;
+      return result_ops;
+    }
+  }
   XlaOpVector result_ops;
+  OutputSet folded_operands;
   try {
     HloMetadataSetter meta_setter(this, node);
 
-    result_ops = node->Lower(this);
+    if (node->rematerialize_operands()) {
+      result_ops = LowerNodeRematerialized(node);
+    } else if ((!ChannelsLastEnabled() ||
+                !TryLowerNodeChannelsLast(node, &result_ops)) &&
+               !TryLowerNodePermuted(node, &result_ops, &folded_operands)) {
+      result_ops = node->Lower(this);
+    }
   } catch (const std::exception& ex) {
     ReportBuilderError(node, ex.what());
   }
   if (!builder()->first_error().ok()) {
     ReportBuilderError(node, /*error_msg=*/nullptr);
   }
+  MarkPermutedOperandsRead(node, folded_operands);
+  if (cse_candidate) {
+    cse_nodes_[cse_key].push_back(node);
+  }
   return result_ops;
 }
 
@@ -173,7 +955,7 @@ void LoweringContext::ReportBuilderError(const Node* node,
   if (!nmeta.scope.empty()) {
     ss << "Scope: " << nmeta.scope << "\n";
   }
-  ss << nmeta.frame_info;
+  ss << nmeta.GetFrameInfo();
   throw std::runtime_error(ss.str());
 }
 
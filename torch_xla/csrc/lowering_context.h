@@ -1,5 +1,6 @@
 #pragma once
 
+#include <map>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -10,6 +11,7 @@
 #include "tensorflow/compiler/xla/client/xla_builder.h"
 #include "tensorflow/compiler/xla/types.h"
 #include "tensorflow/compiler/xla/xla_client/computation_client.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
 #include "tensorflow/core/platform/macros.h"
 #include "torch_xla/csrc/device.h"
 #include "torch_xla/csrc/ir.h"
@@ -23,7 +25,8 @@ class LoweringContext {
   explicit LoweringContext(const std::string& name, Device device);
   LoweringContext(const std::string& name, Device device,
                   absl::Span<const Node* const> post_order,
-                  Util::EmissionMap emit_status);
+                  Util::EmissionMap emit_status,
+                  absl::Span<const Output> roots = {});
 
   xla::XlaBuilder* builder() { return &builder_; }
 
@@ -31,7 +34,8 @@ class LoweringContext {
 
   // If a parameter associated with data has already been declared, it will be
   // returned. Otherwise a new one will be created, associated with the tensor
-  // held in data.
+  // held in data. The parameters of sharded data carry the data sharding, and
+  // make the computation a sharded one.
   xla::XlaOp GetParameter(
       const std::shared_ptr<xla::ComputationClient::Data>& data);
 
@@ -49,6 +53,14 @@ class LoweringContext {
 
   void SetResult(size_t index, xla::XlaOp op);
 
+  // Sets the sharding of the result at index, which makes the computation a
+  // sharded one. In sharded computations, the results with no sharding are
+  // replicated.
+  void SetResultSharding(size_t index, const xla::OpSharding& sharding);
+
+  // Whether the computation needs to be compiled with the SPMD partitioner.
+  bool IsSharded() const { return is_sharded_; }
+
   // Assigns the given XLA operation to the specified output. As outputs are
   // lowered in a post-order fashion, later nodes should always find their
   // operands among the emitted outputs.
@@ -59,6 +71,33 @@ class LoweringContext {
   // corresponding XLA operation returned.
   xla::XlaOp GetOutputOp(const Output& output);
 
+  // Whether the convolution, pooling, batch norm and elementwise lowerings
+  // should work in channels-last (NHWC) layout (XLA_CHANNELS_LAST), keeping the
+  // intermediate values in such layout and only transposing at the boundaries.
+  static bool ChannelsLastEnabled();
+
+  // Retrieves the channels-last version of an output. If the output has not
+  // been lowered in channels-last layout, its regular lowering is transposed.
+  xla::XlaOp GetOutputOpChannelsLast(const Output& output);
+
+  // Returns whether the output has been lowered in channels-last layout.
+  bool HasOutputOpChannelsLast(const Output& output) const;
+
+  // Assigns the channels-last lowering of output. The regular lowering is the
+  // transposed version of it, which gets removed by XLA as dead code unless
+  // some consumer (or the computation results) needs it.
+  void AssignOutputOpChannelsLast(const Output& output, xla::XlaOp op);
+
+  // Whether the graph lowering folds the permutes (XLA_IR_TRANSPOSE_FOLDING):
+  // chains of permutes are composed, permutes are sunk through the elementwise
+  // operations consuming them, and folded into the dimension numbers of the
+  // dots. Only the permuted values with a single consumer are folded.
+  static bool TransposeFoldingEnabled();
+
+  // Retrieves the number of permutes lowered by the graph, whose transposes
+  // have been folded away.
+  size_t GetRemovedTransposeCount() const;
+
   // Build the XLA computation capturing all the operations created with the
   // embedded XLA builder (returned by the builder() API).
   xla::StatusOr<xla::XlaComputation> Build();
@@ -71,9 +110,29 @@ class LoweringContext {
 
   // Lowers a single IR node. All the inputs to the node must have a lowering
   // before calling this API. Returns the generated XLA operations.
+  // Unless XLA_IR_CSE is set to false, a node equivalent to one already lowered
+  // (same op, node hash and shape, with equivalent operands) is not lowered
+  // again, and reuses the XLA operations of the first one.
   XlaOpVector LowerNode(const Node* node);
 
-  size_t GetEmittedNodeCount() const { return emit_status_.size(); }
+  // Lowers the nodes of the post-order split into num_regions contiguous
+  // regions. Each region is lowered by a thread pool closure into a separate
+  // computation, which takes the values it uses from the other regions as
+  // parameters, and returns the ones used by the later regions (or the roots).
+  // The embedded builder then calls the region computations in order. Once
+  // this API returns, GetOutputOp() can be used for all the roots.
+  void LowerRegions(absl::Span<const Node* const> post_order,
+                    absl::Span<const Output> roots, size_t num_regions);
+
+  size_t GetEmittedNodeCount() const {
+    return emit_status_.size() > cse_eliminated_
+               ? emit_status_.size() - cse_eliminated_
+               : 0;
+  }
+
+  // Retrieves the number of nodes which have been eliminated by the common
+  // subexpression elimination within LowerNode().
+  size_t GetEliminatedNodeCount() const { return cse_eliminated_; }
 
  private:
   struct Parameter {
@@ -81,10 +140,71 @@ class LoweringContext {
     size_t index = 0;
   };
 
+  // Returns the output which replaces the given one, if its node has been
+  // eliminated, or the output itself otherwise.
+  Output GetCanonicalOutput(const Output& output) const;
+
+  xla::hash_t GetCseKey(const Node* node) const;
+
+  // Looks for an already lowered node equivalent to the given one, returning
+  // nullptr if none is found.
+  const Node* FindEquivalentNode(const Node* node,
+                                 const xla::hash_t& key) const;
+
   // Reports an XLA builder error for the given node.
   TF_ATTRIBUTE_NORETURN void ReportBuilderError(const Node* node,
                                                 const char* error_msg);
 
+  // Lowers an elementwise node over the channels-last versions of its
+  // operands, if they all have one.
+  bool TryLowerNodeChannelsLast(const Node* node, XlaOpVector* result_ops);
+
+  // A value lowered as the transpose of source by permutation.
+  struct PermutedOp {
+    xla::XlaOp source;
+    std::vector<xla::int64> permutation;
+  };
+
+  // Returns the permuted lowering of operand, if it has one and the consuming
+  // node is its only user. Returns nullptr otherwise.
+  const PermutedOp* GetFoldablePermutedOp(const Output& operand) const;
+
+  // Assigns the transpose of source to output, and records it as permuted.
+  void AssignOutputOpPermuted(const Output& output, xla::XlaOp source,
+                              std::vector<xla::int64> permutation);
+
+  // Lowers a permute, dot or elementwise node folding the permutes of its
+  // operands. The operands whose permute has been folded are added to
+  // folded_operands.
+  bool TryLowerNodePermuted(const Node* node, XlaOpVector* result_ops,
+                            OutputSet* folded_operands);
+
+  bool LowerPermuteFolded(const Node* node, XlaOpVector* result_ops,
+                          OutputSet* folded_operands);
+
+  bool TryLowerDotPermuted(const Node* node, XlaOpVector* result_ops,
+                           OutputSet* folded_operands);
+
+  bool TryLowerElementwisePermuted(const Node* node, XlaOpVector* result_ops,
+                                   OutputSet* folded_operands);
+
+  // Records that the transposed lowering of the permuted operands of node, the
+  // folded ones aside, is used.
+  void MarkPermutedOperandsRead(const Node* node,
+                                const OutputSet& folded_operands);
+
+  // Lowers a node consuming checkpoint region values, over a recomputed
+  // version of such values.
+  XlaOpVector LowerNodeRematerialized(const Node* node);
+
+  // Recomputes the given outputs of a checkpoint region from the region inputs.
+  // The recomputation lives within a conditional whose predicate depends on
+  // the gate value, so that XLA can neither schedule it before the gate is
+  // available, nor merge it with the original computation.
+  void RematerializeRegion(size_t checkpoint_id,
+                           absl::Span<const Output> outputs,
+                           const Output& gate);
+
   xla::XlaBuilder builder_;
   Device device_;
   std::vector<xla::ComputationClient::DataPtr> parameters_;
@@ -92,8 +212,24 @@ class LoweringContext {
       parameters_map_;
   std::vector<size_t> parameter_sequence_;
   std::vector<xla::XlaOp> root_tuple_;
+  std::map<size_t, xla::OpSharding> result_shardings_;
+  bool is_sharded_ = false;
   OutputMap<xla::XlaOp> emitted_outputs_;
+  OutputMap<xla::XlaOp> channels_last_outputs_;
+  OutputMap<xla::XlaOp> rematerialized_outputs_;
+  OutputMap<PermutedOp> permuted_outputs_;
+  // The permuted outputs whose transposed lowering is used.
+  OutputSet read_permuted_outputs_;
+  // The number of users of the graph outputs, the roots included. Permute
+  // folding is only enabled when this is populated.
+  OutputMap<size_t> output_uses_;
+  size_t lowered_permutes_ = 0;
   Util::EmissionMap emit_status_;
+  std::unordered_map<xla::hash_t, std::vector<const Node*>,
+                     xla::util::HashReducer>
+      cse_nodes_;
+  std::unordered_map<const Node*, const Node*> cse_replacements_;
+  size_t cse_eliminated_ = 0;
 };
 
 }  // namespace ir
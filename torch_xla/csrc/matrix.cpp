@@ -1,10 +1,13 @@
 #include "torch_xla/csrc/matrix.h"
 
+#include <algorithm>
+
 #include "tensorflow/compiler/xla/client/lib/constants.h"
 #include "tensorflow/compiler/xla/client/lib/matrix.h"
 #include "tensorflow/compiler/xla/client/lib/qr.h"
 #include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/util.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "torch_xla/csrc/convert_ops.h"
 #include "torch_xla/csrc/helpers.h"
 
@@ -79,6 +82,46 @@ std::vector<xla::int64> GetDiagonalPermutation(xla::int64 rank, xla::int64 dim1,
   return permutation;
 }
 
+xla::XlaOp SliceRows(xla::XlaOp input, xla::int64 start, xla::int64 end) {
+  xla::int64 rank = XlaHelpers::ShapeOfXlaOp(input).rank();
+  return xla::SliceInDim(input, start, end, 1, rank - 2);
+}
+
+xla::XlaOp SliceCols(xla::XlaOp input, xla::int64 start, xla::int64 end) {
+  xla::int64 rank = XlaHelpers::ShapeOfXlaOp(input).rank();
+  return xla::SliceInDim(input, start, end, 1, rank - 1);
+}
+
+// Returns the [..., 1, 1] element at (row, col).
+xla::XlaOp SliceElement(xla::XlaOp input, xla::int64 row, xla::int64 col) {
+  return SliceCols(SliceRows(input, row, row + 1), col, col + 1);
+}
+
+// Sums the input along dim, keeping it with size one.
+xla::XlaOp SumInDim(xla::XlaOp input, xla::int64 dim) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(input);
+  xla::XlaOp sum = xla::Reduce(
+      input, xla::Zero(input.builder(), shape.element_type()),
+      XlaHelpers::CreateAddComputation(shape.element_type()), {dim});
+  std::vector<xla::int64> dimensions(shape.dimensions().begin(),
+                                     shape.dimensions().end());
+  dimensions[dim] = 1;
+  return xla::Reshape(sum, dimensions);
+}
+
+// Returns the [rows, 1] mask holding one for the rows within [start, end), and
+// zero for the other ones.
+xla::XlaOp RowRangeMask(xla::XlaBuilder* builder, xla::PrimitiveType type,
+                        xla::int64 rows, xla::int64 start, xla::int64 end) {
+  xla::XlaOp iota = xla::Iota(
+      builder, xla::ShapeUtil::MakeShape(xla::PrimitiveType::S32, {rows, 1}),
+      0);
+  xla::XlaOp in_range =
+      xla::And(xla::Ge(iota, xla::ConstantR0<xla::int32>(builder, start)),
+               xla::Lt(iota, xla::ConstantR0<xla::int32>(builder, end)));
+  return xla::ConvertElementType(in_range, type);
+}
+
 }  // namespace
 
 xla::XlaOp BuildTriu(xla::XlaOp input, xla::int64 diagonal) {
@@ -140,4 +183,125 @@ xla::XlaOp BuildInverse(xla::XlaOp input) {
                               xla::TriangularSolveOptions::NO_TRANSPOSE);
 }
 
+bool UseSmallMatrixLowering(xla::int64 size) {
+  static const xla::int64 max_size =
+      xla::sys_util::GetEnvInt("XLA_SMALL_MATRIX_MAX_SIZE", 16);
+  return size <= max_size;
+}
+
+xla::XlaOp BuildSmallCholesky(xla::XlaOp input, bool lower) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(input);
+  xla::int64 rank = shape.rank();
+  xla::int64 n = shape.dimensions(rank - 1);
+  // The upper triangle of the input is the lower triangle of its transpose,
+  // and the upper factor the transpose of the lower one.
+  xla::XlaOp a = lower ? input : xla::TransposeInMinorDims(input);
+  std::vector<xla::XlaOp> columns;
+  for (xla::int64 k = 0; k < n; ++k) {
+    // Column k of the factor is the (masked) column k of the remaining
+    // matrix, divided by the square root of its diagonal element. The outer
+    // product of the column with itself is then removed from the matrix.
+    xla::XlaOp pivot = xla::Sqrt(SliceElement(a, k, k));
+    xla::XlaOp column = XlaHelpers::PromotedMul(
+        XlaHelpers::PromotedDiv(SliceCols(a, k, k + 1), pivot),
+        RowRangeMask(input.builder(), shape.element_type(), n, k, n));
+    columns.push_back(column);
+    if (k + 1 < n) {
+      a = XlaHelpers::PromotedSub(
+          a, XlaHelpers::PromotedMul(column,
+                                     xla::TransposeInMinorDims(column)));
+    }
+  }
+  xla::XlaOp factor = xla::ConcatInDim(input.builder(), columns, rank - 1);
+  return lower ? factor : xla::TransposeInMinorDims(factor);
+}
+
+xla::XlaOp BuildSmallTriangularSolve(xla::XlaOp a, xla::XlaOp b,
+                                     bool left_side, bool lower,
+                                     bool transpose, bool unit_diagonal) {
+  // Reduce to op(a) x = b: the transposed matrix swaps the triangles, and the
+  // right side x a = b is solved as a^T x^T = b^T.
+  if (transpose) {
+    a = xla::TransposeInMinorDims(a);
+    lower = !lower;
+  }
+  if (!left_side) {
+    a = xla::TransposeInMinorDims(a);
+    b = xla::TransposeInMinorDims(b);
+    lower = !lower;
+  }
+  a = xla::Triangle(a, lower);
+  const xla::Shape& a_shape = XlaHelpers::ShapeOfXlaOp(a);
+  xla::int64 rank = a_shape.rank();
+  xla::int64 n = a_shape.dimensions(rank - 1);
+  std::vector<xla::XlaOp> rows(n);
+  for (xla::int64 step = 0; step < n; ++step) {
+    // Substitute the solved row into the ones still to be solved. The rows
+    // already solved only get their copies within b updated, which are not
+    // read anymore.
+    xla::int64 j = lower ? step : n - 1 - step;
+    xla::XlaOp row = SliceRows(b, j, j + 1);
+    if (!unit_diagonal) {
+      row = XlaHelpers::PromotedDiv(row, SliceElement(a, j, j));
+    }
+    rows[j] = row;
+    if (step + 1 < n) {
+      b = XlaHelpers::PromotedSub(
+          b, XlaHelpers::PromotedMul(SliceCols(a, j, j + 1), row));
+    }
+  }
+  xla::XlaOp x = xla::ConcatInDim(a.builder(), rows, rank - 2);
+  return left_side ? x : xla::TransposeInMinorDims(x);
+}
+
+std::vector<xla::XlaOp> BuildSmallQR(xla::XlaOp input, bool full_matrices) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(input);
+  xla::XlaBuilder* builder = input.builder();
+  xla::PrimitiveType type = shape.element_type();
+  xla::int64 rank = shape.rank();
+  xla::int64 m = shape.dimensions(rank - 2);
+  xla::int64 n = shape.dimensions(rank - 1);
+  std::vector<xla::int64> batch_dims(shape.dimensions().begin(),
+                                     shape.dimensions().end() - 2);
+  xla::XlaOp one = xla::One(builder, type);
+  xla::XlaOp r = input;
+  xla::XlaOp q =
+      xla::Broadcast(xla::IdentityMatrix(builder, type, m, m), batch_dims);
+  for (xla::int64 k = 0; k < std::min(m - 1, n); ++k) {
+    // Householder reflector zeroing column k below the diagonal, computed as
+    // in LAPACK xLARFG: beta = -sign(alpha) * norm, tau = (beta - alpha) /
+    // beta, v = x / (alpha - beta) with v[k] = 1. A zero column below the
+    // diagonal gets the identity reflector (tau = 0).
+    xla::XlaOp alpha = SliceElement(r, k, k);
+    xla::XlaOp below = XlaHelpers::PromotedMul(
+        SliceCols(r, k, k + 1), RowRangeMask(builder, type, m, k + 1, m));
+    xla::XlaOp sigma = SumInDim(below * below, rank - 2);
+    xla::XlaOp norm = xla::Sqrt(alpha * alpha + sigma);
+    xla::XlaOp sigma_is_zero = xla::Eq(sigma, xla::ZerosLike(sigma));
+    xla::XlaOp beta = xla::Select(xla::Lt(alpha, xla::ZerosLike(alpha)), norm,
+                                  xla::Neg(norm));
+    xla::XlaOp tau = xla::Select(sigma_is_zero, xla::ZerosLike(alpha),
+                                 (beta - alpha) / beta);
+    xla::XlaOp scale = xla::Select(sigma_is_zero, xla::ZerosLike(alpha),
+                                   XlaHelpers::PromotedDiv(one, alpha - beta));
+    xla::XlaOp v = XlaHelpers::PromotedAdd(
+        XlaHelpers::PromotedMul(below, scale),
+        RowRangeMask(builder, type, m, k, k + 1));
+    xla::XlaOp tau_v = XlaHelpers::PromotedMul(v, tau);
+    // R = (I - tau v v^T) R and Q = Q (I - tau v v^T).
+    xla::XlaOp v_r = SumInDim(XlaHelpers::PromotedMul(v, r), rank - 2);
+    r = XlaHelpers::PromotedSub(r, XlaHelpers::PromotedMul(tau_v, v_r));
+    xla::XlaOp q_v = SumInDim(
+        XlaHelpers::PromotedMul(q, xla::TransposeInMinorDims(v)), rank - 1);
+    q = XlaHelpers::PromotedSub(
+        q, XlaHelpers::PromotedMul(q_v, xla::TransposeInMinorDims(tau_v)));
+  }
+  r = xla::Triangle(r, /*lower=*/false);
+  if (!full_matrices && m > n) {
+    q = SliceCols(q, 0, n);
+    r = SliceRows(r, 0, n);
+  }
+  return {q, r};
+}
+
 }  // namespace torch_xla
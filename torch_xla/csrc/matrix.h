@@ -1,5 +1,7 @@
 #pragma once
 
+#include <vector>
+
 #include "tensorflow/compiler/xla/client/xla_builder.h"
 
 namespace torch_xla {
@@ -17,4 +19,25 @@ xla::XlaOp BuildDiagonalViewUpdate(xla::XlaOp target, xla::XlaOp input,
 
 xla::XlaOp BuildInverse(xla::XlaOp input);
 
+// Whether the decompositions and solves of matrices of the given size should
+// use the unrolled lowerings below (XLA_SMALL_MATRIX_MAX_SIZE). They run one
+// step per row or column, each a handful of elementwise operations over the
+// whole batch, instead of the blocked XLA algorithms which are tuned for a few
+// large matrices.
+bool UseSmallMatrixLowering(xla::int64 size);
+
+// Unrolled Cholesky decomposition of the [..., N, N] input, reading only its
+// lower (or upper) triangle.
+xla::XlaOp BuildSmallCholesky(xla::XlaOp input, bool lower);
+
+// Unrolled substitution solving op(a) x = b (or x op(a) = b if left_side is
+// false), where a and b have the same batch dimensions.
+xla::XlaOp BuildSmallTriangularSolve(xla::XlaOp a, xla::XlaOp b,
+                                     bool left_side, bool lower,
+                                     bool transpose, bool unit_diagonal);
+
+// Unrolled Householder QR decomposition of the [..., M, N] input, following
+// the LAPACK reflector conventions. Returns Q and R.
+std::vector<xla::XlaOp> BuildSmallQR(xla::XlaOp input, bool full_matrices);
+
 }  // namespace torch_xla
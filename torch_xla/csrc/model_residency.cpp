@@ -0,0 +1,156 @@
+#include "torch_xla/csrc/model_residency.h"
+
+#include <exception>
+#include <iterator>
+
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/thread_pool.h"
+
+namespace torch_xla {
+
+ModelResidencyManager::ModelResidencyManager(Device device,
+                                             xla::int64 budget_bytes)
+    : device_(std::move(device)), budget_bytes_(budget_bytes) {}
+
+void ModelResidencyManager::Register(const std::string& name,
+                                     const std::string& path, bool pinned,
+                                     bool keep_host_copy) {
+  std::lock_guard<std::mutex> lock(lock_);
+  Model& model = models_[name];
+  XLA_CHECK(model.path.empty()) << "Model already registered: " << name;
+  model.path = path;
+  model.pinned = pinned;
+  model.keep_host_copy = keep_host_copy;
+  model.lru_it = lru_.end();
+}
+
+ModelResidencyManager::Model* ModelResidencyManager::GetModel(
+    const std::string& name) {
+  auto it = models_.find(name);
+  XLA_CHECK(it != models_.end()) << "Unknown model: " << name;
+  return &it->second;
+}
+
+std::shared_ptr<ExportedGraph> ModelResidencyManager::Acquire(
+    const std::string& name) {
+  std::shared_future<std::shared_ptr<ExportedGraph>> loading;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    Model* model = GetModel(name);
+    if (model->graph != nullptr) {
+      lru_.splice(lru_.begin(), lru_, model->lru_it);
+      XLA_COUNTER("ModelResidencyHit", 1);
+      return model->graph;
+    }
+    XLA_COUNTER("ModelResidencyMiss", 1);
+    loading = model->loading.valid() ? model->loading : StartLoad(name, model);
+  }
+  return loading.get();
+}
+
+void ModelResidencyManager::Prefetch(const std::string& name) {
+  std::lock_guard<std::mutex> lock(lock_);
+  Model* model = GetModel(name);
+  if (model->graph == nullptr && !model->loading.valid()) {
+    StartLoad(name, model);
+  }
+}
+
+void ModelResidencyManager::SetPinned(const std::string& name, bool pinned) {
+  std::lock_guard<std::mutex> lock(lock_);
+  GetModel(name)->pinned = pinned;
+  if (!pinned) {
+    EvictToBudget();
+  }
+}
+
+void ModelResidencyManager::Evict(const std::string& name) {
+  std::lock_guard<std::mutex> lock(lock_);
+  Model* model = GetModel(name);
+  if (model->graph != nullptr) {
+    EvictModel(name, model);
+  }
+}
+
+bool ModelResidencyManager::IsResident(const std::string& name) {
+  std::lock_guard<std::mutex> lock(lock_);
+  return GetModel(name)->graph != nullptr;
+}
+
+xla::int64 ModelResidencyManager::resident_bytes() {
+  std::lock_guard<std::mutex> lock(lock_);
+  return resident_bytes_;
+}
+
+std::shared_future<std::shared_ptr<ExportedGraph>>
+ModelResidencyManager::StartLoad(const std::string& name, Model* model) {
+  auto promise =
+      std::make_shared<std::promise<std::shared_ptr<ExportedGraph>>>();
+  model->loading = promise->get_future().share();
+  auto host_weights =
+      std::make_shared<std::vector<at::Tensor>>(std::move(model->host_weights));
+  model->host_weights.clear();
+  auto loadfn = [this, name, path = model->path, host_weights, promise]() {
+    std::shared_ptr<ExportedGraph> graph;
+    try {
+      XLA_TIMED("ModelResidencyLoad");
+      graph = ExportedGraph::Load(
+          path, device_, host_weights->empty() ? nullptr : host_weights.get());
+    } catch (...) {
+      {
+        std::lock_guard<std::mutex> lock(lock_);
+        models_.at(name).loading = {};
+      }
+      promise->set_exception(std::current_exception());
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      Model& loaded_model = models_.at(name);
+      loaded_model.graph = graph;
+      loaded_model.bytes = graph->weights_bytes();
+      loaded_model.loading = {};
+      loaded_model.lru_it = lru_.insert(lru_.begin(), name);
+      resident_bytes_ += loaded_model.bytes;
+      XLA_COUNTER("ModelResidencyLoads", 1);
+      EvictToBudget();
+    }
+    promise->set_value(std::move(graph));
+  };
+  xla::env::ScheduleIoClosure(std::move(loadfn));
+  return model->loading;
+}
+
+void ModelResidencyManager::EvictModel(const std::string& name, Model* model) {
+  if (model->keep_host_copy) {
+    model->host_weights = model->graph->GetHostWeights();
+  }
+  model->graph.reset();
+  lru_.erase(model->lru_it);
+  model->lru_it = lru_.end();
+  resident_bytes_ -= model->bytes;
+  XLA_COUNTER("ModelResidencyEvictions", 1);
+}
+
+void ModelResidencyManager::EvictToBudget() {
+  auto it = lru_.end();
+  while (resident_bytes_ > budget_bytes_ && it != lru_.begin()) {
+    --it;
+    Model* model = GetModel(*it);
+    if (model->pinned) {
+      continue;
+    }
+    // The most recently used model is the one just acquired or loaded, which
+    // is kept even if it alone exceeds the budget.
+    if (it == lru_.begin()) {
+      break;
+    }
+    auto next_it = std::next(it);
+    EvictModel(*it, model);
+    it = next_it;
+  }
+  XLA_VALUE_METRIC("ModelResidencyBytes", resident_bytes_);
+}
+
+}  // namespace torch_xla
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "tensorflow/compiler/xla/types.h"
+#include "torch_xla/csrc/device.h"
+#include "torch_xla/csrc/exported_graph.h"
+
+namespace torch_xla {
+
+// Keeps a set of exported models resident on a device, within a budget of
+// device memory. Models are loaded on first use (or ahead of time with
+// Prefetch()), and when the resident weights exceed the budget, the least
+// recently used models which are not pinned get evicted. Eviction drops the
+// model executable and weights handles, which releases their device memory
+// once no in-flight execution holds them anymore. The weights of the models
+// registered with keep_host_copy are downloaded to host before eviction, so
+// that reloads skip reading the export directory.
+class ModelResidencyManager {
+ public:
+  ModelResidencyManager(Device device, xla::int64 budget_bytes);
+
+  // Registers the model exported at path (see ExportedGraph) under name,
+  // without loading it.
+  void Register(const std::string& name, const std::string& path, bool pinned,
+                bool keep_host_copy);
+
+  // Returns the resident graph of the model, waiting for it to be loaded if
+  // needed, and marks it as the most recently used.
+  std::shared_ptr<ExportedGraph> Acquire(const std::string& name);
+
+  // Starts loading the model in background, if not already resident.
+  void Prefetch(const std::string& name);
+
+  // Pinned models are never evicted.
+  void SetPinned(const std::string& name, bool pinned);
+
+  void Evict(const std::string& name);
+
+  bool IsResident(const std::string& name);
+
+  xla::int64 resident_bytes();
+
+ private:
+  struct Model {
+    std::string path;
+    bool pinned = false;
+    bool keep_host_copy = false;
+    std::shared_ptr<ExportedGraph> graph;
+    std::vector<at::Tensor> host_weights;
+    xla::int64 bytes = 0;
+    // Valid while the model is being loaded.
+    std::shared_future<std::shared_ptr<ExportedGraph>> loading;
+    std::list<std::string>::iterator lru_it;
+  };
+
+  Model* GetModel(const std::string& name);
+
+  // Must be called with the lock held.
+  std::shared_future<std::shared_ptr<ExportedGraph>> StartLoad(
+      const std::string& name, Model* model);
+
+  // Must be called with the lock held.
+  void EvictModel(const std::string& name, Model* model);
+
+  // Evicts models, starting from the least recently used ones, until the
+  // resident weights fit the budget. Must be called with the lock held.
+  void EvictToBudget();
+
+  Device device_;
+  xla::int64 budget_bytes_;
+  std::mutex lock_;
+  std::map<std::string, Model> models_;
+  // Resident models, the most recently used first.
+  std::list<std::string> lru_;
+  xla::int64 resident_bytes_ = 0;
+};
+
+}  // namespace torch_xla
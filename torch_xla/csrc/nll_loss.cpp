@@ -2,6 +2,10 @@
 
 #include "absl/types/span.h"
 #include "tensorflow/compiler/xla/client/lib/constants.h"
+#include "tensorflow/compiler/xla/client/lib/loops.h"
+#include "tensorflow/compiler/xla/client/lib/slicing.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "torch_xla/csrc/data_ops.h"
 #include "torch_xla/csrc/helpers.h"
 #include "torch_xla/csrc/tensor_util.h"
@@ -100,6 +104,275 @@ WeightScale GetMaskedWeight(const absl::optional<xla::XlaOp>& weight,
   return {result_weight, scale};
 }
 
+// The one-hot lowering materializes a [batch, classes] tensor as big as the
+// logits, so above this number of classes the target logits are gathered, and
+// the gradients scattered, instead.
+bool UseGatherLowering(const xla::Shape& logits_shape) {
+  static const xla::int64 min_classes =
+      xla::sys_util::GetEnvInt("XLA_NLL_GATHER_MIN_CLASSES", 1024);
+  return logits_shape.rank() == 2 && logits_shape.dimensions(1) >= min_classes;
+}
+
+// Replaces the ignored labels with zero, so that they can be used as indices,
+// and returns the bitmap of the valid ones within valid_bitmap.
+xla::XlaOp GetValidLabels(xla::XlaOp labels, int ignore_index,
+                          xla::XlaOp* valid_bitmap) {
+  const xla::Shape& labels_shape = XlaHelpers::ShapeOfXlaOp(labels);
+  *valid_bitmap = xla::Ne(
+      labels, XlaHelpers::ScalarValue<xla::int64>(
+                  ignore_index, labels_shape.element_type(), labels.builder()));
+  return xla::Select(*valid_bitmap, labels, xla::ZerosLike(labels));
+}
+
+struct RowWeightScale {
+  // The [batch] valid labels, with the ignored ones replaced by zero.
+  xla::XlaOp labels;
+  // The [batch] weights of the labels, zero for the ignored ones.
+  xla::XlaOp weight;
+  xla::XlaOp scale;
+};
+
+RowWeightScale GetRowWeight(const absl::optional<xla::XlaOp>& weight,
+                            const xla::Shape& logits_shape, xla::XlaOp labels,
+                            int ignore_index) {
+  xla::XlaBuilder* builder = labels.builder();
+  const xla::Shape& labels_shape = XlaHelpers::ShapeOfXlaOp(labels);
+  xla::XlaOp valid_bitmap;
+  xla::XlaOp valid_labels = GetValidLabels(labels, ignore_index, &valid_bitmap);
+  xla::XlaOp row_weight;
+  if (weight) {
+    row_weight = xla::TorchIndexSelect(*weight, valid_labels, 0);
+  } else {
+    row_weight = XlaHelpers::ScalarBroadcast<float>(
+        1.0,
+        xla::ShapeUtil::MakeShape(logits_shape.element_type(),
+                                  labels_shape.dimensions()),
+        builder);
+  }
+  row_weight =
+      xla::Select(valid_bitmap, row_weight, xla::ZerosLike(row_weight));
+
+  xla::XlaComputation add_func =
+      XlaHelpers::CreateAddComputation(logits_shape.element_type());
+  xla::XlaOp zero = xla::Zero(builder, logits_shape.element_type());
+  xla::XlaOp one = xla::One(builder, logits_shape.element_type());
+  xla::XlaOp scale = xla::ReduceAll(row_weight, zero, add_func);
+  scale = xla::Select(xla::Ne(scale, zero), scale, one);
+  return {valid_labels, row_weight, scale};
+}
+
+// Gathers the [batch] values at the labels columns of a [batch, classes]
+// input.
+xla::XlaOp GatherRowValues(xla::XlaOp input, xla::XlaOp labels) {
+  xla::int64 batch_size = XlaHelpers::ShapeOfXlaOp(input).dimensions(0);
+  return xla::Reshape(
+      xla::TorchGather(input, xla::Reshape(labels, {batch_size, 1}),
+                       /*dim=*/1, /*sparse=*/true),
+      {batch_size});
+}
+
+// Adds the [batch] updates at the labels columns of a [batch, classes] buffer.
+xla::XlaOp ScatterAddRowValues(xla::XlaOp buffer, xla::XlaOp labels,
+                               xla::XlaOp updates) {
+  const xla::Shape& buffer_shape = XlaHelpers::ShapeOfXlaOp(buffer);
+  const xla::Shape& labels_shape = XlaHelpers::ShapeOfXlaOp(labels);
+  xla::int64 batch_size = buffer_shape.dimensions(0);
+  xla::XlaOp rows = xla::Iota(
+      buffer.builder(),
+      xla::ShapeUtil::MakeShape(labels_shape.element_type(), {batch_size, 1}),
+      0);
+  xla::XlaOp indices = xla::ConcatInDim(
+      buffer.builder(), {rows, xla::Reshape(labels, {batch_size, 1})}, 1);
+  xla::ScatterDimensionNumbers scatter_dnums;
+  scatter_dnums.add_inserted_window_dims(0);
+  scatter_dnums.add_inserted_window_dims(1);
+  scatter_dnums.add_scatter_dims_to_operand_dims(0);
+  scatter_dnums.add_scatter_dims_to_operand_dims(1);
+  scatter_dnums.set_index_vector_dim(1);
+  return xla::Scatter(
+      buffer, indices, updates,
+      XlaHelpers::CreateAddComputation(buffer_shape.element_type()),
+      scatter_dnums);
+}
+
+xla::XlaOp BuildNllLossGather(xla::XlaOp logits, xla::XlaOp labels,
+                              const absl::optional<xla::XlaOp>& weight,
+                              int ignore_index, ReductionMode reduction_mode) {
+  const xla::Shape& logits_shape = XlaHelpers::ShapeOfXlaOp(logits);
+  RowWeightScale row_weight =
+      GetRowWeight(weight, logits_shape, labels, ignore_index);
+  xla::XlaOp target_logits = GatherRowValues(logits, row_weight.labels);
+  xla::XlaOp loss = xla::Neg(target_logits) * row_weight.weight;
+  if (reduction_mode == ReductionMode::kNone) {
+    return loss;
+  }
+  xla::XlaOp sum = xla::ReduceAll(
+      loss, xla::Zero(logits.builder(), logits_shape.element_type()),
+      XlaHelpers::CreateAddComputation(logits_shape.element_type()));
+  if (reduction_mode == ReductionMode::kSum) {
+    return sum;
+  }
+  return sum / row_weight.scale;
+}
+
+xla::XlaOp BuildNllLossBackwardScatter(xla::XlaOp grad_output,
+                                       xla::XlaOp logits, xla::XlaOp labels,
+                                       const absl::optional<xla::XlaOp>& weight,
+                                       int ignore_index,
+                                       ReductionMode reduction_mode) {
+  const xla::Shape& logits_shape = XlaHelpers::ShapeOfXlaOp(logits);
+  RowWeightScale row_weight =
+      GetRowWeight(weight, logits_shape, labels, ignore_index);
+  xla::int64 batch_size = logits_shape.dimensions(0);
+  const xla::Shape& grad_output_shape = XlaHelpers::ShapeOfXlaOp(grad_output);
+  xla::XlaOp grad = grad_output;
+  if (grad_output_shape.rank() == 0) {
+    grad = xla::Broadcast(grad, {batch_size});
+  }
+  xla::XlaOp updates = xla::Neg(grad) * row_weight.weight;
+  if (reduction_mode == ReductionMode::kMean) {
+    updates = updates / row_weight.scale;
+  }
+  // Scatter the per row gradients at the (row, label) coordinates of a zero
+  // initialized gradient.
+  xla::XlaOp zeros = xla::Broadcast(
+      xla::Zero(logits.builder(), logits_shape.element_type()),
+      logits_shape.dimensions());
+  return ScatterAddRowValues(zeros, row_weight.labels, updates);
+}
+
+xla::PrimitiveType GetComputeType(xla::PrimitiveType type) {
+  // The softmax statistics are accumulated in full precision.
+  return type == xla::PrimitiveType::BF16 || type == xla::PrimitiveType::F16
+             ? xla::PrimitiveType::F32
+             : type;
+}
+
+xla::XlaOp ConvertTo(xla::XlaOp op, xla::PrimitiveType type) {
+  if (XlaHelpers::TypeOfXlaOp(op) == type) {
+    return op;
+  }
+  return xla::ConvertElementType(op, type);
+}
+
+xla::XlaOp SliceClassChunk(xla::XlaOp input, xla::XlaOp chunk_index,
+                           xla::int64 chunk_size, xla::XlaBuilder* builder) {
+  xla::XlaOp start =
+      chunk_index * xla::ConstantR0<xla::int32>(builder, chunk_size);
+  return xla::DynamicSlice(input,
+                           {xla::Zero(builder, xla::PrimitiveType::S32), start},
+                           {XlaHelpers::SizesOfXlaOp(input)[0], chunk_size});
+}
+
+xla::StatusOr<xla::XlaOp> ChunkCondition(xla::int64 num_chunks,
+                                         absl::Span<const xla::XlaOp> values,
+                                         xla::XlaBuilder* builder) {
+  return xla::Lt(values[0], xla::ConstantR0<xla::int32>(builder, num_chunks));
+}
+
+xla::XlaOp ReduceClasses(xla::XlaOp input, xla::XlaOp init_value,
+                         const xla::XlaComputation& computation) {
+  return xla::Reduce(input, init_value, computation, {1});
+}
+
+// Computes the [batch] logsumexp of the [batch, classes] logits, visiting the
+// classes in chunks, with the running maximum and sum rescaled as the maximum
+// grows.
+xla::XlaOp BuildLogSumExp(xla::XlaOp logits, xla::int64 chunk_size,
+                          xla::PrimitiveType type) {
+  const xla::Shape& logits_shape = XlaHelpers::ShapeOfXlaOp(logits);
+  xla::XlaBuilder* builder = logits.builder();
+  xla::int64 num_chunks = logits_shape.dimensions(1) / chunk_size;
+  if (num_chunks == 1) {
+    xla::XlaOp xlogits = ConvertTo(logits, type);
+    xla::XlaOp max = ReduceClasses(xlogits, xla::MinValue(builder, type),
+                                   XlaHelpers::CreateMaxComputation(type));
+    xla::XlaOp sum = ReduceClasses(xla::Exp(xla::Sub(xlogits, max, {0})),
+                                   xla::Zero(builder, type),
+                                   XlaHelpers::CreateAddComputation(type));
+    return max + xla::Log(sum);
+  }
+  std::vector<xla::int64> stats_sizes = {logits_shape.dimensions(0)};
+  std::vector<xla::XlaOp> init_values = {
+      xla::Zero(builder, xla::PrimitiveType::S32),
+      xla::Broadcast(xla::MinValue(builder, type), stats_sizes),
+      xla::Broadcast(xla::Zero(builder, type), stats_sizes), logits};
+  auto cond_fn = [&](absl::Span<const xla::XlaOp> values,
+                     xla::XlaBuilder* body_builder) {
+    return ChunkCondition(num_chunks, values, body_builder);
+  };
+  auto body_fn = [&](absl::Span<const xla::XlaOp> values,
+                     xla::XlaBuilder* body_builder)
+      -> xla::StatusOr<std::vector<xla::XlaOp>> {
+    xla::XlaOp chunk = ConvertTo(
+        SliceClassChunk(values[3], values[0], chunk_size, body_builder), type);
+    xla::XlaOp new_max = xla::Max(
+        values[1], ReduceClasses(chunk, xla::MinValue(body_builder, type),
+                                 XlaHelpers::CreateMaxComputation(type)));
+    xla::XlaOp new_sum =
+        values[2] * xla::Exp(values[1] - new_max) +
+        ReduceClasses(xla::Exp(xla::Sub(chunk, new_max, {0})),
+                      xla::Zero(body_builder, type),
+                      XlaHelpers::CreateAddComputation(type));
+    return std::vector<xla::XlaOp>{
+        values[0] + xla::One(body_builder, xla::PrimitiveType::S32), new_max,
+        new_sum, values[3]};
+  };
+  std::vector<xla::XlaOp> results = ConsumeValue(xla::WhileLoopHelper(
+      cond_fn, body_fn, init_values, "CrossEntropyLoop", builder));
+  return results[1] + xla::Log(results[2]);
+}
+
+// Computes the [batch, classes] softmax(logits) * scale, scale being [batch],
+// one chunk of classes at a time.
+xla::XlaOp BuildScaledSoftmax(xla::XlaOp logits, xla::XlaOp logsumexp,
+                              xla::XlaOp scale, xla::int64 chunk_size,
+                              xla::PrimitiveType type) {
+  const xla::Shape& logits_shape = XlaHelpers::ShapeOfXlaOp(logits);
+  xla::XlaBuilder* builder = logits.builder();
+  xla::int64 num_chunks = logits_shape.dimensions(1) / chunk_size;
+  auto scaled_softmax = [&](xla::XlaOp chunk) {
+    xla::XlaOp probs =
+        xla::Exp(xla::Sub(ConvertTo(chunk, type), logsumexp, {0}));
+    return ConvertTo(xla::Mul(probs, scale, {0}), logits_shape.element_type());
+  };
+  if (num_chunks == 1) {
+    return scaled_softmax(logits);
+  }
+  std::vector<xla::XlaOp> init_values = {
+      xla::Zero(builder, xla::PrimitiveType::S32),
+      xla::Broadcast(xla::Zero(builder, logits_shape.element_type()),
+                     logits_shape.dimensions()),
+      logits, logsumexp, scale};
+  auto cond_fn = [&](absl::Span<const xla::XlaOp> values,
+                     xla::XlaBuilder* body_builder) {
+    return ChunkCondition(num_chunks, values, body_builder);
+  };
+  auto body_fn = [&](absl::Span<const xla::XlaOp> values,
+                     xla::XlaBuilder* body_builder)
+      -> xla::StatusOr<std::vector<xla::XlaOp>> {
+    xla::XlaOp chunk_index = values[0];
+    xla::XlaOp probs = xla::Exp(xla::Sub(
+        ConvertTo(SliceClassChunk(values[2], chunk_index, chunk_size,
+                                  body_builder),
+                  type),
+        values[3], {0}));
+    xla::XlaOp update =
+        ConvertTo(xla::Mul(probs, values[4], {0}), logits_shape.element_type());
+    xla::XlaOp start =
+        chunk_index * xla::ConstantR0<xla::int32>(body_builder, chunk_size);
+    xla::XlaOp grad = xla::DynamicUpdateSlice(
+        values[1], update,
+        {xla::Zero(body_builder, xla::PrimitiveType::S32), start});
+    return std::vector<xla::XlaOp>{
+        chunk_index + xla::One(body_builder, xla::PrimitiveType::S32), grad,
+        values[2], values[3], values[4]};
+  };
+  std::vector<xla::XlaOp> results = ConsumeValue(xla::WhileLoopHelper(
+      cond_fn, body_fn, init_values, "CrossEntropyBackwardLoop", builder));
+  return results[1];
+}
+
 }  // namespace
 
 // Builds the NLLLoss for log-probabilities "logits" and class indices "labels".
@@ -108,6 +381,10 @@ xla::XlaOp BuildNllLoss(xla::XlaOp logits, xla::XlaOp labels,
                         int ignore_index, ReductionMode reduction_mode) {
   const int classes_axis = 1;
   const xla::Shape& logits_shape = XlaHelpers::ShapeOfXlaOp(logits);
+  if (UseGatherLowering(logits_shape)) {
+    return BuildNllLossGather(logits, labels, weight, ignore_index,
+                              reduction_mode);
+  }
   xla::XlaOp zero = xla::Zero(logits.builder(), logits_shape.element_type());
   xla::XlaOp one = xla::One(logits.builder(), logits_shape.element_type());
   xla::XlaOp one_hot_labels = LabelsToOneHot(
@@ -134,6 +411,49 @@ xla::XlaOp BuildNllLoss(xla::XlaOp logits, xla::XlaOp labels,
   return sum / weight_scale.scale;
 }
 
+xla::int64 GetCrossEntropyChunkSize(xla::int64 num_classes,
+                                    xla::int64 chunk_size) {
+  return chunk_size > 0 && chunk_size < num_classes &&
+                 num_classes % chunk_size == 0
+             ? chunk_size
+             : num_classes;
+}
+
+CrossEntropyResult BuildCrossEntropy(xla::XlaOp logits, xla::XlaOp labels,
+                                     int ignore_index, xla::int64 chunk_size) {
+  const xla::Shape& logits_shape = XlaHelpers::ShapeOfXlaOp(logits);
+  XLA_CHECK_EQ(logits_shape.rank(), 2) << logits_shape;
+  xla::PrimitiveType type = GetComputeType(logits_shape.element_type());
+  xla::XlaOp valid_bitmap;
+  xla::XlaOp valid_labels = GetValidLabels(labels, ignore_index, &valid_bitmap);
+  xla::XlaOp logsumexp = BuildLogSumExp(
+      logits,
+      GetCrossEntropyChunkSize(logits_shape.dimensions(1), chunk_size), type);
+  xla::XlaOp loss =
+      logsumexp - ConvertTo(GatherRowValues(logits, valid_labels), type);
+  loss = xla::Select(valid_bitmap, loss, xla::ZerosLike(loss));
+  return {ConvertTo(loss, logits_shape.element_type()), logsumexp};
+}
+
+xla::XlaOp BuildCrossEntropyBackward(xla::XlaOp grad_output, xla::XlaOp logits,
+                                     xla::XlaOp labels, xla::XlaOp logsumexp,
+                                     int ignore_index, xla::int64 chunk_size) {
+  const xla::Shape& logits_shape = XlaHelpers::ShapeOfXlaOp(logits);
+  xla::PrimitiveType type = GetComputeType(logits_shape.element_type());
+  xla::XlaOp valid_bitmap;
+  xla::XlaOp valid_labels = GetValidLabels(labels, ignore_index, &valid_bitmap);
+  xla::XlaOp grad = ConvertTo(grad_output, type);
+  grad = xla::Select(valid_bitmap, grad, xla::ZerosLike(grad));
+  // The gradient is (softmax - one_hot) * grad, with the one-hot term
+  // scattered at the labels instead of being materialized.
+  xla::XlaOp grad_logits = BuildScaledSoftmax(
+      logits, ConvertTo(logsumexp, type), grad,
+      GetCrossEntropyChunkSize(logits_shape.dimensions(1), chunk_size), type);
+  return ScatterAddRowValues(
+      grad_logits, valid_labels,
+      ConvertTo(xla::Neg(grad), logits_shape.element_type()));
+}
+
 // Builds the NLLLoss gradient for log-probabilities "logits" and class indices
 // "labels".
 xla::XlaOp BuildNllLossBackward(xla::XlaOp grad_output, xla::XlaOp logits,
@@ -144,6 +464,10 @@ xla::XlaOp BuildNllLossBackward(xla::XlaOp grad_output, xla::XlaOp logits,
                                 ReductionMode reduction_mode) {
   const int classes_axis = 1;
   const xla::Shape& logits_shape = XlaHelpers::ShapeOfXlaOp(logits);
+  if (UseGatherLowering(logits_shape)) {
+    return BuildNllLossBackwardScatter(grad_output, logits, labels, weight,
+                                       ignore_index, reduction_mode);
+  }
   xla::XlaOp zero = xla::Zero(logits.builder(), logits_shape.element_type());
   xla::XlaOp one = xla::One(logits.builder(), logits_shape.element_type());
   xla::XlaOp one_hot_labels = LabelsToOneHot(
@@ -19,4 +19,31 @@ xla::XlaOp BuildNllLossBackward(xla::XlaOp grad_output, xla::XlaOp logits,
                                 const absl::optional<xla::XlaOp>& total_weight,
                                 int ignore_index, ReductionMode reduction_mode);
 
+struct CrossEntropyResult {
+  // The [batch] losses, zero for the ignored labels.
+  xla::XlaOp loss;
+  // The [batch] logsumexp of the logits, which is all the backward pass needs
+  // to recompute the softmax.
+  xla::XlaOp logsumexp;
+};
+
+// Computes the cross entropy of the [batch, classes] "logits" against the
+// [batch] class indices "labels", without materializing the log-probabilities.
+// The classes are visited in chunks of chunk_size, so that the exponentials
+// are never computed for all the classes at once.
+CrossEntropyResult BuildCrossEntropy(xla::XlaOp logits, xla::XlaOp labels,
+                                     int ignore_index, xla::int64 chunk_size);
+
+// Computes the gradient of BuildCrossEntropy() with respect to the logits, as
+// softmax(logits) - one_hot(labels), recomputing the softmax chunk by chunk
+// from the saved logsumexp.
+xla::XlaOp BuildCrossEntropyBackward(xla::XlaOp grad_output, xla::XlaOp logits,
+                                     xla::XlaOp labels, xla::XlaOp logsumexp,
+                                     int ignore_index, xla::int64 chunk_size);
+
+// Returns the class chunk size used by the lowering, which is the requested
+// one if it divides the number of classes, or all the classes otherwise.
+xla::int64 GetCrossEntropyChunkSize(xla::int64 num_classes,
+                                    xla::int64 chunk_size);
+
 }  // namespace torch_xla
@@ -6,6 +6,7 @@
 #include "tensorflow/compiler/xla/client/lib/comparators.h"
 #include "tensorflow/compiler/xla/client/lib/constants.h"
 #include "tensorflow/compiler/xla/client/lib/loops.h"
+#include "tensorflow/compiler/xla/client/lib/slicing.h"
 #include "tensorflow/compiler/xla/client/lib/sorting.h"
 #include "tensorflow/compiler/xla/util.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
@@ -85,6 +86,71 @@ struct SuppressBodyFn {
   xla::int64 num_boxes;
 };
 
+struct BatchedWhileCondFn {
+  BatchedWhileCondFn(xla::int64 num_boxes, xla::int64 output_size)
+      : num_boxes(num_boxes), output_size(output_size) {}
+
+  xla::StatusOr<xla::XlaOp> operator()(absl::Span<const xla::XlaOp> values,
+                                       xla::XlaBuilder* builder) const {
+    xla::XlaOp row_idx = values[0];
+    xla::XlaOp row_in_bounds =
+        xla::Lt(row_idx, xla::ConstantR0<xla::int32>(builder, num_boxes));
+    // Keep going until all the problems have collected output_size outputs.
+    xla::XlaOp min_outputs = xla::Reduce(
+        values[1], xla::MaxValue(builder, xla::PrimitiveType::S32),
+        xla::CreateScalarMinComputation(xla::PrimitiveType::S32, builder),
+        {0});
+    xla::XlaOp results_not_full =
+        xla::Lt(min_outputs, xla::ConstantR0<xla::int32>(builder, output_size));
+    return xla::And(row_in_bounds, results_not_full);
+  }
+
+  xla::int64 num_boxes;
+  xla::int64 output_size;
+};
+
+// Same as SuppressBodyFn, but processing the row_idx box of all the problems
+// at once. The IOU mask is [M, K, K], and the included mask is [M, K].
+struct BatchedSuppressBodyFn {
+  BatchedSuppressBodyFn(xla::int64 num_problems, xla::int64 num_boxes)
+      : num_problems(num_problems), num_boxes(num_boxes) {}
+
+  xla::StatusOr<std::vector<xla::XlaOp>> operator()(
+      absl::Span<const xla::XlaOp> values, xla::XlaBuilder* builder) const {
+    xla::XlaOp row_idx = values[0];
+    xla::XlaOp num_outputs_so_far = values[1];
+    xla::XlaOp iou_mask = values[2];
+    xla::XlaOp included_iou = values[3];
+    xla::XlaOp zero = xla::Zero(builder, xla::PrimitiveType::S32);
+    xla::XlaOp one = xla::One(builder, xla::PrimitiveType::S32);
+    xla::XlaOp active_elem = xla::Reshape(
+        xla::DynamicSlice(included_iou, {zero, row_idx}, {num_problems, 1}),
+        {num_problems});
+    num_outputs_so_far =
+        xla::Select(active_elem, num_outputs_so_far + one, num_outputs_so_far);
+    xla::XlaOp row_iou =
+        xla::Reshape(xla::DynamicSlice(iou_mask, {zero, row_idx, zero},
+                                       {num_problems, 1, num_boxes}),
+                     {num_problems, num_boxes});
+    // Remove the diagonal from consideration. An elem cannot suppress itself.
+    xla::XlaOp not_self = xla::Ne(
+        xla::Iota(builder,
+                  xla::ShapeUtil::MakeShape(xla::PrimitiveType::S32,
+                                            {num_problems, num_boxes}),
+                  1),
+        row_idx);
+    xla::XlaOp supp_mask = xla::Not(xla::And(row_iou, not_self));
+    included_iou = xla::Select(
+        xla::BroadcastInDim(active_elem, {num_problems, num_boxes}, {0}),
+        xla::And(included_iou, supp_mask), included_iou);
+    return std::vector<xla::XlaOp>{row_idx + one, num_outputs_so_far, iou_mask,
+                                   included_iou};
+  }
+
+  xla::int64 num_problems;
+  xla::int64 num_boxes;
+};
+
 xla::XlaOp NmsGather(xla::XlaOp input, absl::Span<const xla::int64> input_sizes,
                      xla::XlaOp indices,
                      absl::Span<const xla::int64> indices_sizes,
@@ -289,4 +355,145 @@ NmsResult BuildNms(xla::XlaOp boxes, xla::XlaOp scores,
   return {selected_indices, num_valid};
 }
 
+NmsResult BuildBatchedNms(xla::XlaOp boxes, xla::XlaOp scores,
+                          xla::XlaOp score_threshold, xla::XlaOp iou_threshold,
+                          xla::int64 output_size, xla::int64 top_k) {
+  const xla::Shape& boxes_shape = XlaHelpers::ShapeOfXlaOp(boxes);
+  const xla::Shape& scores_shape = XlaHelpers::ShapeOfXlaOp(scores);
+  XLA_CHECK_GE(scores_shape.rank(), 1) << scores_shape;
+  XLA_CHECK_EQ(boxes_shape.dimensions(boxes_shape.rank() - 1), 4)
+      << boxes_shape;
+  xla::int64 num_boxes = scores_shape.dimensions(scores_shape.rank() - 1);
+  std::vector<xla::int64> batch_sizes(scores_shape.dimensions().begin(),
+                                      scores_shape.dimensions().end() - 1);
+  std::vector<xla::int64> full_boxes_sizes(batch_sizes);
+  full_boxes_sizes.push_back(num_boxes);
+  full_boxes_sizes.push_back(4);
+  if (boxes_shape.rank() == scores_shape.rank()) {
+    // Boxes shared by all the classes, [B, N, 4] with scores [B, C, N].
+    XLA_CHECK_EQ(scores_shape.rank(), 3) << scores_shape;
+    XLA_CHECK_EQ(boxes_shape.dimensions(0), scores_shape.dimensions(0))
+        << boxes_shape << " vs. " << scores_shape;
+    XLA_CHECK_EQ(boxes_shape.dimensions(1), num_boxes)
+        << boxes_shape << " vs. " << scores_shape;
+    boxes = xla::BroadcastInDim(boxes, full_boxes_sizes, {0, 2, 3});
+  } else {
+    XLA_CHECK(xla::ShapeUtil::SameDimensions(
+        boxes_shape, xla::ShapeUtil::MakeShape(boxes_shape.element_type(),
+                                               full_boxes_sizes)))
+        << boxes_shape << " vs. " << scores_shape;
+  }
+  xla::int64 num_problems = xla::util::Multiply<xla::int64>(batch_sizes);
+  xla::int64 num_candidates =
+      top_k > 0 ? std::min(top_k, num_boxes) : num_boxes;
+  XLA_CHECK_LT(num_boxes, std::numeric_limits<xla::int32>::max());
+  XLA_CHECK_GE(output_size, 0);
+  XLA_CHECK_LE(output_size, num_candidates);
+
+  xla::XlaBuilder* builder = boxes.builder();
+  xla::PrimitiveType scores_type = scores_shape.element_type();
+  scores = xla::Reshape(scores, {num_problems, num_boxes});
+  boxes = xla::Reshape(boxes, {num_problems, num_boxes, 4});
+  xla::XlaOp neg_inf = xla::MinValue(builder, scores_type);
+  // The score threshold pre-filter pushes the boxes which would be discarded
+  // at the end anyway, behind the valid ones taking part in the top-k.
+  xla::XlaOp scores_filtered = xla::Select(
+      xla::Gt(scores, xla::Broadcast(score_threshold,
+                                     {num_problems, num_boxes})),
+      scores, xla::Broadcast(neg_inf, {num_problems, num_boxes}));
+  // The top-k also sorts the candidates by decreasing score, which is the
+  // order the suppression loop wants. Shapes are henceforth [M, K].
+  xla::XlaOp topk = xla::TopK(scores_filtered, num_candidates);
+  xla::XlaOp scores_sorted = xla::GetTupleElement(topk, 0);
+  xla::XlaOp indices_sorted = xla::GetTupleElement(topk, 1);
+  xla::XlaOp boxes_sorted = xla::TorchIndexSelect(boxes, indices_sorted,
+                                                  /*dim=*/1, /*batch_dims=*/1);
+
+  auto coordinate = [&](xla::int64 index) {
+    return xla::Reshape(
+        xla::SliceInDim(boxes_sorted, index, index + 1, 1, /*dimno=*/2),
+        {num_problems, num_candidates});
+  };
+  xla::XlaOp c_y0 = coordinate(0);
+  xla::XlaOp c_x0 = coordinate(1);
+  xla::XlaOp c_y1 = coordinate(2);
+  xla::XlaOp c_x1 = coordinate(3);
+  xla::XlaOp y1 = xla::Min(c_y0, c_y1);
+  xla::XlaOp y2 = xla::Max(c_y0, c_y1);
+  xla::XlaOp x1 = xla::Min(c_x0, c_x1);
+  xla::XlaOp x2 = xla::Max(c_x0, c_x1);
+  xla::XlaOp area = (y2 - y1) * (x2 - x1);
+
+  // Shapes are henceforth [M, K, K].
+  std::vector<xla::int64> square_sizes = {num_problems, num_candidates,
+                                          num_candidates};
+  auto rows = [&](xla::XlaOp op) {
+    return xla::BroadcastInDim(op, square_sizes, {0, 1});
+  };
+  auto cols = [&](xla::XlaOp op) {
+    return xla::BroadcastInDim(op, square_sizes, {0, 2});
+  };
+  xla::XlaOp i_xmin = xla::Max(rows(x1), cols(x1));
+  xla::XlaOp i_ymin = xla::Max(rows(y1), cols(y1));
+  xla::XlaOp i_xmax = xla::Min(rows(x2), cols(x2));
+  xla::XlaOp i_ymax = xla::Min(rows(y2), cols(y2));
+  xla::XlaOp square_zero = xla::ZerosLike(i_xmin);
+  xla::XlaOp i_area = xla::Max(i_xmax - i_xmin, square_zero) *
+                      xla::Max(i_ymax - i_ymin, square_zero);
+  xla::XlaOp u_area = rows(area) + cols(area) - i_area;
+  xla::XlaOp iou = i_area / u_area;
+  xla::XlaOp iou_threshold_mask = xla::Gt(iou, iou_threshold + square_zero);
+
+  xla::XlaOp zero_s32 = xla::Zero(builder, xla::PrimitiveType::S32);
+  xla::XlaOp one_s32 = xla::One(builder, xla::PrimitiveType::S32);
+  std::vector<xla::XlaOp> init_values;
+  init_values.reserve(4);
+  init_values.push_back(zero_s32);  // row_idx
+  init_values.push_back(xla::Broadcast(zero_s32, {num_problems}));
+  init_values.push_back(iou_threshold_mask);
+  init_values.push_back(xla::Broadcast(xla::ConstantR0<bool>(builder, true),
+                                       {num_problems, num_candidates}));
+  auto suppress_loop_result = ConsumeValue(xla::WhileLoopHelper(
+      BatchedWhileCondFn(num_candidates, output_size),
+      BatchedSuppressBodyFn(num_problems, num_candidates), init_values,
+      "BatchedBoxSuppressLoop", builder));
+
+  xla::XlaOp included_score = xla::Gt(
+      scores_sorted,
+      xla::Broadcast(score_threshold, {num_problems, num_candidates}));
+  xla::XlaOp included = xla::And(included_score, suppress_loop_result[3]);
+  // Only consider boxes over which we have iterated, which for the problems
+  // which filled their output early, are more than needed.
+  xla::XlaOp iota_candidates = xla::Iota(
+      builder,
+      xla::ShapeUtil::MakeShape(xla::PrimitiveType::S32,
+                                {num_problems, num_candidates}),
+      1);
+  included =
+      xla::And(included, xla::Lt(iota_candidates, suppress_loop_result[0]));
+
+  xla::XlaOp scores_included =
+      xla::Select(included, scores_sorted,
+                  xla::Broadcast(neg_inf, {num_problems, num_candidates}));
+  xla::XlaOp selected_sorted =
+      xla::GetTupleElement(xla::TopK(scores_included, output_size), 1);
+  xla::XlaOp ones_included =
+      xla::Select(included, xla::Broadcast(one_s32, {num_problems,
+                                                     num_candidates}),
+                  xla::Broadcast(zero_s32, {num_problems, num_candidates}));
+  xla::XlaOp num_valid_total = xla::Reduce(
+      ones_included, zero_s32,
+      xla::CreateScalarAddComputation(xla::PrimitiveType::S32, builder), {1});
+  xla::XlaOp num_valid = xla::Min(
+      num_valid_total, xla::ConstantR0<xla::int32>(builder, output_size));
+
+  // Map the selected positions within the top-k back to the original boxes.
+  xla::XlaOp selected_indices = xla::TorchIndexSelect(
+      indices_sorted, selected_sorted, /*dim=*/1, /*batch_dims=*/1);
+  std::vector<xla::int64> output_sizes(batch_sizes);
+  output_sizes.push_back(output_size);
+  return {xla::Reshape(selected_indices, output_sizes),
+          xla::Reshape(num_valid, batch_sizes)};
+}
+
 }  // namespace torch_xla
@@ -13,4 +13,16 @@ NmsResult BuildNms(xla::XlaOp boxes, xla::XlaOp scores,
                    xla::XlaOp score_threshold, xla::XlaOp iou_threshold,
                    xla::int64 output_size);
 
+// Runs many independent NMS problems at once. The scores are [..., N], where
+// the leading dimensions are typically [B, C] (batch and classes), while the
+// boxes are either [..., N, 4], or [B, N, 4] with the boxes shared by all the
+// classes of a batch element. If top_k is positive, only the top_k highest
+// scoring boxes of every problem take part in the suppression, which shrinks
+// the IOU matrices from [N, N] to [top_k, top_k]. The selected indices are
+// [..., output_size] (pointing within N), and num_valid has the leading
+// dimensions of the scores.
+NmsResult BuildBatchedNms(xla::XlaOp boxes, xla::XlaOp scores,
+                          xla::XlaOp score_threshold, xla::XlaOp iou_threshold,
+                          xla::int64 output_size, xla::int64 top_k);
+
 }  // namespace torch_xla
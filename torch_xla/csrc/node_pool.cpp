@@ -0,0 +1,158 @@
+#include "torch_xla/csrc/node_pool.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+
+namespace torch_xla {
+namespace ir {
+namespace {
+
+// Blocks are rounded up to the size class granularity, and the ones bigger
+// than the largest size class are not pooled.
+static const size_t kSizeClassBytes = 16;
+static const size_t kNumSizeClasses = 128;
+
+struct SizeClass {
+  std::vector<void*> blocks;
+  // The number of blocks allocated within the current generation.
+  size_t allocations = 0;
+};
+
+class ThreadNodePool {
+ public:
+  ThreadNodePool();
+
+  ~ThreadNodePool();
+
+  void* Allocate(size_t size);
+
+  void Free(void* ptr, size_t size);
+
+  void Trim();
+
+  NodePool::Stats GetStats() const;
+
+ private:
+  SizeClass classes_[kNumSizeClasses];
+  NodePool::Stats stats_;
+};
+
+// Tells whether the pool of the current thread is still usable. Nodes can be
+// released after the thread local pool has been destroyed (like by static
+// objects holding IR values, at process exit), in which case they go straight
+// to the system allocator. Blocks are always individually allocated, so this is
+// safe for pooled blocks as well.
+thread_local bool thread_pool_alive = false;
+
+ThreadNodePool::ThreadNodePool() { thread_pool_alive = true; }
+
+ThreadNodePool::~ThreadNodePool() {
+  thread_pool_alive = false;
+  for (auto& size_class : classes_) {
+    for (auto block : size_class.blocks) {
+      ::operator delete(block);
+    }
+  }
+}
+
+void* ThreadNodePool::Allocate(size_t size) {
+  XLA_COUNTER("IrNodeAllocations", 1);
+  ++stats_.allocations;
+  size_t index = (size - 1) / kSizeClassBytes;
+  if (index >= kNumSizeClasses) {
+    return ::operator new(size);
+  }
+  SizeClass& size_class = classes_[index];
+  ++size_class.allocations;
+  if (size_class.blocks.empty()) {
+    return ::operator new((index + 1) * kSizeClassBytes);
+  }
+  XLA_COUNTER("IrNodePoolHits", 1);
+  ++stats_.pool_hits;
+  void* block = size_class.blocks.back();
+  size_class.blocks.pop_back();
+  --stats_.pooled_blocks;
+  stats_.pooled_bytes -= (index + 1) * kSizeClassBytes;
+  return block;
+}
+
+void ThreadNodePool::Free(void* ptr, size_t size) {
+  size_t index = (size - 1) / kSizeClassBytes;
+  if (index >= kNumSizeClasses) {
+    ::operator delete(ptr);
+    return;
+  }
+  classes_[index].blocks.push_back(ptr);
+  ++stats_.pooled_blocks;
+  stats_.pooled_bytes += (index + 1) * kSizeClassBytes;
+}
+
+void ThreadNodePool::Trim() {
+  for (size_t i = 0; i < kNumSizeClasses; ++i) {
+    SizeClass& size_class = classes_[i];
+    size_t retained =
+        std::min(size_class.blocks.size(), size_class.allocations);
+    for (size_t j = retained; j < size_class.blocks.size(); ++j) {
+      ::operator delete(size_class.blocks[j]);
+    }
+    size_t released = size_class.blocks.size() - retained;
+    stats_.pooled_blocks -= released;
+    stats_.pooled_bytes -= released * (i + 1) * kSizeClassBytes;
+    size_class.blocks.resize(retained);
+    if (retained == 0) {
+      size_class.blocks.shrink_to_fit();
+    }
+    size_class.allocations = 0;
+  }
+  XLA_VALUE_METRIC("IrNodePoolBytes", stats_.pooled_bytes);
+}
+
+NodePool::Stats ThreadNodePool::GetStats() const { return stats_; }
+
+bool IsPoolEnabled() {
+  static const bool enabled =
+      xla::sys_util::GetEnvBool("XLA_IR_NODE_POOL", true);
+  return enabled;
+}
+
+ThreadNodePool* GetThreadPool() {
+  static thread_local ThreadNodePool pool;
+  return thread_pool_alive ? &pool : nullptr;
+}
+
+}  // namespace
+
+void* NodePool::Allocate(size_t size) {
+  ThreadNodePool* pool = IsPoolEnabled() ? GetThreadPool() : nullptr;
+  return pool != nullptr ? pool->Allocate(size) : ::operator new(size);
+}
+
+void NodePool::Free(void* ptr, size_t size) {
+  ThreadNodePool* pool =
+      IsPoolEnabled() && thread_pool_alive ? GetThreadPool() : nullptr;
+  if (pool != nullptr) {
+    pool->Free(ptr, size);
+  } else {
+    ::operator delete(ptr);
+  }
+}
+
+void NodePool::Trim() {
+  if (IsPoolEnabled()) {
+    ThreadNodePool* pool = GetThreadPool();
+    if (pool != nullptr) {
+      pool->Trim();
+    }
+  }
+}
+
+NodePool::Stats NodePool::GetStats() {
+  ThreadNodePool* pool = IsPoolEnabled() ? GetThreadPool() : nullptr;
+  return pool != nullptr ? pool->GetStats() : Stats();
+}
+
+}  // namespace ir
+}  // namespace torch_xla
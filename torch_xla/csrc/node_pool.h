@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+namespace torch_xla {
+namespace ir {
+
+// Per thread pool of the memory blocks backing the IR nodes. The blocks are
+// grouped in size classes and, once released, kept in the free list of the
+// releasing thread to be reused by the following allocations, instead of going
+// through the system allocator for every node of every traced step.
+class NodePool {
+ public:
+  struct Stats {
+    size_t allocations = 0;
+    size_t pool_hits = 0;
+    size_t pooled_blocks = 0;
+    size_t pooled_bytes = 0;
+  };
+
+  static void* Allocate(size_t size);
+
+  static void Free(void* ptr, size_t size);
+
+  // Closes the current allocation generation of the calling thread (the
+  // MarkStep() API calls it at every step). The free lists are trimmed to the
+  // number of blocks allocated within the generation, which are what the next
+  // step is expected to need, and the excess memory is returned to the system.
+  static void Trim();
+
+  // Returns the stats of the calling thread pool.
+  static Stats GetStats();
+};
+
+// Allocator to be used with std::allocate_shared(), which makes the node and
+// the shared pointer control block share a single pooled block.
+template <typename T>
+class NodePoolAllocator {
+ public:
+  using value_type = T;
+
+  NodePoolAllocator() = default;
+
+  template <typename U>
+  NodePoolAllocator(const NodePoolAllocator<U>&) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(NodePool::Allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T* ptr, size_t n) { NodePool::Free(ptr, n * sizeof(T)); }
+
+  template <typename U>
+  bool operator==(const NodePoolAllocator<U>&) const {
+    return true;
+  }
+
+  template <typename U>
+  bool operator!=(const NodePoolAllocator<U>&) const {
+    return false;
+  }
+};
+
+}  // namespace ir
+}  // namespace torch_xla
@@ -1,6 +1,10 @@
 #include "torch_xla/csrc/op_by_op_executor.h"
 
+#include <algorithm>
+#include <iterator>
 #include <list>
+#include <memory>
+#include <numeric>
 #include <unordered_map>
 
 #include "absl/strings/str_cat.h"
@@ -8,6 +12,7 @@
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 #include "tensorflow/compiler/xla/xla_client/metrics.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/thread_pool.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
 #include "tensorflow/compiler/xla/xla_client/xla_util.h"
 #include "torch_xla/csrc/device.h"
@@ -41,12 +46,19 @@ const xla::Shape& GetParameterShape(const ir::Output& operand,
              : xla::ShapeUtil::GetTupleElementShape(input_shape, operand.index);
 }
 
+// Nodes whose chained_operand operand is produced by the previous node of a
+// fusion group have a null input shape for it, and only its position is hashed.
 xla::hash_t ComputeNodeKey(const ir::Node* node,
                            absl::Span<const xla::Shape* const> input_shapes,
-                           const xla::hash_t& seed) {
+                           const xla::hash_t& seed,
+                           xla::int64 chained_operand = -1) {
   xla::hash_t key = seed;
   const auto& operands = node->operands();
   for (size_t i = 0; i < operands.size(); ++i) {
+    if (static_cast<xla::int64>(i) == chained_operand) {
+      key = xla::util::HashCombine(key, xla::util::MHash(chained_operand));
+      continue;
+    }
     key = xla::util::HashCombine(key, xla::util::ShapeHash(GetParameterShape(
                                           operands[i], *input_shapes[i])));
   }
@@ -54,18 +66,121 @@ xla::hash_t ComputeNodeKey(const ir::Node* node,
   return xla::util::HashCombine(key, node->node_hash());
 }
 
-xla::XlaComputation BuildNodeComputation(
-    const ir::Node* node, absl::Span<const xla::Shape* const> input_shapes,
-    const Device& device) {
-  ir::LoweringContext loctx("BuildNodeComputation", device);
-  const auto& operands = node->operands();
-  for (size_t i = 0; i < operands.size(); ++i) {
-    xla::XlaOp param = xla::Parameter(
-        loctx.builder(), i, GetParameterShape(operands[i], *input_shapes[i]),
-        absl::StrCat("p", i));
-    loctx.AssignOutputOp(operands[i], param);
+// A chain of nodes lowered into a single computation. Every node but the first
+// has its chained_operands operand produced by the previous node, which has no
+// other use. Operands produced outside the group become computation parameters,
+// in node and operand order. Non fused nodes are groups of one.
+struct FusionGroup {
+  std::vector<const ir::Node*> nodes;
+  std::vector<xla::int64> chained_operands;
+  // The input shapes of every node, with null entries for the chained operands.
+  std::vector<std::vector<const xla::Shape*>> input_shapes;
+};
+
+bool IsFusible(const ir::Node* node) {
+  return ir::ops::DeviceData::Cast(node) == nullptr &&
+         node->op() != ir::ops::xla_not_supported &&
+         node->num_outputs() == 1 && !node->shape().IsTuple();
+}
+
+// Splits the post-order into fusion groups, returned in the post-order of their
+// last node. The node_groups vector maps every post-order index to the index of
+// the group holding it.
+std::vector<FusionGroup> ComputeFusionGroups(
+    absl::Span<const ir::Node* const> post_order,
+    const std::unordered_map<const ir::Node*, size_t>& node_to_index,
+    absl::Span<const ir::Value> roots, size_t max_fusion_size,
+    std::vector<size_t>* node_groups) {
+  std::vector<size_t> use_counts(post_order.size(), 0);
+  for (auto node : post_order) {
+    for (auto& operand : node->operands()) {
+      ++use_counts[node_to_index.at(operand.node)];
+    }
+  }
+  for (auto& root : roots) {
+    ++use_counts[node_to_index.at(root.node.get())];
+  }
+
+  // Groups are first indexed in creation order, and sorted once complete.
+  std::vector<FusionGroup> groups;
+  std::vector<size_t> tail_indices;
+  node_groups->assign(post_order.size(), 0);
+  for (size_t i = 0; i < post_order.size(); ++i) {
+    const ir::Node* node = post_order[i];
+    xla::int64 chained_operand = -1;
+    size_t group_index = groups.size();
+    if (max_fusion_size > 1 && IsFusible(node)) {
+      const auto& operands = node->operands();
+      for (size_t j = 0; j < operands.size(); ++j) {
+        size_t op_index = node_to_index.at(operands[j].node);
+        // A single use means the operand is the last node of its group.
+        if (use_counts[op_index] == 1 && IsFusible(operands[j].node) &&
+            xla::ShapeUtil::Equal(operands[j].node->shape(), node->shape()) &&
+            groups[(*node_groups)[op_index]].nodes.size() < max_fusion_size) {
+          chained_operand = j;
+          group_index = (*node_groups)[op_index];
+          break;
+        }
+      }
+    }
+    if (group_index == groups.size()) {
+      groups.emplace_back();
+      tail_indices.push_back(i);
+    }
+    groups[group_index].nodes.push_back(node);
+    groups[group_index].chained_operands.push_back(chained_operand);
+    tail_indices[group_index] = i;
+    (*node_groups)[i] = group_index;
+  }
+
+  std::vector<size_t> order(groups.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return tail_indices[a] < tail_indices[b];
+  });
+  std::vector<size_t> group_positions(groups.size());
+  std::vector<FusionGroup> sorted_groups;
+  sorted_groups.reserve(groups.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    group_positions[order[i]] = i;
+    sorted_groups.push_back(std::move(groups[order[i]]));
   }
-  for (auto& xla_op : loctx.LowerNode(node)) {
+  for (auto& group_index : *node_groups) {
+    group_index = group_positions[group_index];
+  }
+  return sorted_groups;
+}
+
+xla::hash_t ComputeGroupKey(const FusionGroup& group, const xla::hash_t& seed) {
+  xla::hash_t key = seed;
+  for (size_t i = 0; i < group.nodes.size(); ++i) {
+    key = ComputeNodeKey(group.nodes[i], group.input_shapes[i], key,
+                         group.chained_operands[i]);
+  }
+  return key;
+}
+
+xla::XlaComputation BuildGroupComputation(const FusionGroup& group,
+                                          const Device& device) {
+  ir::LoweringContext loctx("BuildGroupComputation", device);
+  size_t param_index = 0;
+  ir::XlaOpVector result_ops;
+  for (size_t i = 0; i < group.nodes.size(); ++i) {
+    const auto& operands = group.nodes[i]->operands();
+    for (size_t j = 0; j < operands.size(); ++j) {
+      if (static_cast<xla::int64>(j) == group.chained_operands[i]) {
+        continue;
+      }
+      xla::XlaOp param = xla::Parameter(
+          loctx.builder(), param_index,
+          GetParameterShape(operands[j], *group.input_shapes[i][j]),
+          absl::StrCat("p", param_index));
+      loctx.AssignOutputOp(operands[j], param);
+      ++param_index;
+    }
+    result_ops = loctx.LowerNode(group.nodes[i]);
+  }
+  for (auto& xla_op : result_ops) {
     loctx.AddResult(xla_op);
   }
   return ConsumeValue(loctx.Build());
@@ -78,12 +193,17 @@ xla::hash_t GetNodesKeySeed(const std::string& device,
 
 }  // namespace
 
-OpByOpExecutor::OpByOpExecutor(size_t compile_cache_size)
-    : compile_cache_(compile_cache_size) {}
+OpByOpExecutor::OpByOpExecutor(size_t compile_cache_size,
+                               size_t max_fusion_size,
+                               size_t compile_chunk_size)
+    : compile_cache_(compile_cache_size),
+      max_fusion_size_(max_fusion_size),
+      compile_chunk_size_(compile_chunk_size) {}
 
-std::vector<xla::ComputationClient::ExecuteChainedOp> OpByOpExecutor::BuildOps(
+OpByOpExecutor::OpsPlan OpByOpExecutor::PlanOps(
     absl::Span<const ir::Value> roots, const std::string& device,
-    absl::Span<const std::string> devices) {
+    absl::Span<const std::string> devices,
+    std::vector<const ir::Node*>* op_nodes) {
   std::vector<const ir::Node*> root_nodes;
   root_nodes.reserve(roots.size());
   for (auto& root : roots) {
@@ -99,105 +219,314 @@ std::vector<xla::ComputationClient::ExecuteChainedOp> OpByOpExecutor::BuildOps(
   for (size_t i = 0; i < post_order.size(); ++i) {
     node_to_index[post_order[i]] = i;
   }
+  // Every group becomes one chained op, and external operands are always
+  // produced by the last node of their group, so node_groups maps the
+  // post-order index of a node into the index of the op producing its value.
+  std::vector<size_t> node_groups;
+  std::vector<FusionGroup> groups =
+      ComputeFusionGroups(post_order, node_to_index, roots, max_fusion_size_,
+                          &node_groups);
+  XLA_VALUE_METRIC("OpByOpGroupsSize", groups.size());
+  if (op_nodes != nullptr) {
+    op_nodes->clear();
+    for (auto& group : groups) {
+      op_nodes->push_back(group.nodes.back());
+    }
+  }
 
   auto compilation_devices =
       xla::ComputationClient::Get()->GetCompilationDevices(device, devices);
   xla::hash_t nodes_key_seed = GetNodesKeySeed(device, compilation_devices);
   Device exec_device(device);
-  std::vector<xla::hash_t> cache_keys;
-  std::unordered_map<xla::hash_t, std::vector<size_t>, xla::util::HashReducer>
-      compile_indices;
+  OpsPlan plan;
   std::unordered_map<xla::hash_t, size_t, xla::util::HashReducer>
       cache_keys_instance;
-  std::list<xla::Shape> compile_shapes;
-  std::vector<bool> device_data_ops(post_order.size());
-  std::vector<const xla::Shape*> ops_shapes(post_order.size());
-  std::vector<xla::ComputationClient::CompileInstance> compile_instances;
-  std::vector<xla::ComputationClient::ExecuteChainedOp> chained_exec_ops(
-      post_order.size());
-  for (size_t i = 0; i < post_order.size(); ++i) {
-    const ir::Node* node = post_order[i];
-    xla::ComputationClient::ExecuteChainedOp& cxop = chained_exec_ops[i];
-    const ir::ops::DeviceData* device_data = ir::ops::DeviceData::Cast(node);
+  std::vector<bool> device_data_ops(groups.size());
+  std::vector<const xla::Shape*> ops_shapes(groups.size());
+  plan.ops.resize(groups.size());
+  for (size_t i = 0; i < groups.size(); ++i) {
+    FusionGroup& group = groups[i];
+    xla::ComputationClient::ExecuteChainedOp& cxop = plan.ops[i];
+    const ir::ops::DeviceData* device_data =
+        ir::ops::DeviceData::Cast(group.nodes.front());
     if (device_data != nullptr) {
       cxop.device_data = device_data->data();
       ops_shapes[i] = &cxop.device_data->shape();
       device_data_ops[i] = true;
     } else {
-      std::vector<const xla::Shape*> op_input_shapes;
-      for (auto& operand : node->operands()) {
-        size_t op_index = node_to_index.at(operand.node);
-        cxop.inputs.push_back(
-            {op_index,
-             GetOutputIndex(device_data_ops[op_index], operand.index)});
-        op_input_shapes.push_back(ops_shapes[op_index]);
+      group.input_shapes.resize(group.nodes.size());
+      for (size_t j = 0; j < group.nodes.size(); ++j) {
+        const auto& operands = group.nodes[j]->operands();
+        for (size_t k = 0; k < operands.size(); ++k) {
+          if (static_cast<xla::int64>(k) == group.chained_operands[j]) {
+            group.input_shapes[j].push_back(nullptr);
+            continue;
+          }
+          size_t op_index = node_groups[node_to_index.at(operands[k].node)];
+          cxop.inputs.push_back(
+              {op_index,
+               GetOutputIndex(device_data_ops[op_index], operands[k].index)});
+          group.input_shapes[j].push_back(ops_shapes[op_index]);
+        }
+      }
+      if (group.nodes.size() > 1) {
+        XLA_COUNTER("OpByOpFusedNodes", group.nodes.size());
       }
 
-      xla::hash_t cache_key =
-          ComputeNodeKey(node, op_input_shapes, nodes_key_seed);
+      xla::hash_t cache_key = ComputeGroupKey(group, nodes_key_seed);
       cxop.computation = compile_cache_.Get(cache_key);
       if (cxop.computation == nullptr) {
         XLA_COUNTER("OpByOpCompileCacheMiss", 1);
 
         // Within a single IR graph, there can be many duplicated IR nodes, so
         // make sure we do not issue an XLA compilation for each one of those.
-        auto& cache_key_indices = compile_indices[cache_key];
+        auto& cache_key_indices = plan.compile_indices[cache_key];
         cache_key_indices.push_back(i);
         if (cache_key_indices.size() == 1) {
-          cache_keys.push_back(cache_key);
-          cache_keys_instance[cache_key] = compile_instances.size();
+          plan.cache_keys.push_back(cache_key);
+          cache_keys_instance[cache_key] = plan.compile_instances.size();
 
           xla::XlaComputation computation =
-              BuildNodeComputation(node, op_input_shapes, exec_device);
+              BuildGroupComputation(group, exec_device);
           xla::ProgramShape program_shape =
               ConsumeValue(computation.GetProgramShape());
-          compile_shapes.push_back(MakeShapeWithDeviceLayout(
+          plan.compile_shapes.push_back(MakeShapeWithDeviceLayout(
               program_shape.result(), exec_device.hw_type));
-          compile_instances.push_back({std::move(computation), device,
-                                       compilation_devices,
-                                       &compile_shapes.back()});
-          ops_shapes[i] = &compile_shapes.back();
+          plan.compile_instances.push_back({std::move(computation), device,
+                                            compilation_devices,
+                                            &plan.compile_shapes.back()});
+          ops_shapes[i] = &plan.compile_shapes.back();
         } else {
-          ops_shapes[i] =
-              compile_instances[cache_keys_instance.at(cache_key)].output_shape;
+          ops_shapes[i] = plan.compile_instances[cache_keys_instance.at(
+                                                     cache_key)]
+                              .output_shape;
         }
       } else {
         ops_shapes[i] = &cxop.computation->program_shape().result();
       }
     }
   }
-  // Fixup the requested outputs (roots) within the chained ops vector.
+  // Fixup the requested outputs (roots) within the chained ops vector. Roots
+  // are never fused within a group, unless they are its last node.
   for (size_t i = 0; i < roots.size(); ++i) {
-    size_t op_index = node_to_index.at(roots[i].node.get());
-    chained_exec_ops[op_index].outputs.push_back(
+    size_t op_index = node_groups[node_to_index.at(roots[i].node.get())];
+    plan.ops[op_index].outputs.push_back(
         {i, GetOutputIndex(device_data_ops[op_index], roots[i].index)});
   }
+  return plan;
+}
+
+void OpByOpExecutor::AddComputations(
+    OpsPlan* plan, size_t start, size_t end,
+    absl::Span<const xla::ComputationClient::ComputationPtr> computations) {
+  XLA_CHECK_EQ(end - start, computations.size());
+  for (size_t i = start; i < end; ++i) {
+    const xla::hash_t& cache_key = plan->cache_keys[i];
+    compile_cache_.Add(cache_key, computations[i - start]);
+    for (auto index : plan->compile_indices.at(cache_key)) {
+      plan->ops[index].computation = computations[i - start];
+    }
+  }
+}
 
+std::vector<xla::ComputationClient::ExecuteChainedOp> OpByOpExecutor::BuildOps(
+    absl::Span<const ir::Value> roots, const std::string& device,
+    absl::Span<const std::string> devices,
+    std::vector<const ir::Node*>* op_nodes) {
+  OpsPlan plan = PlanOps(roots, device, devices, op_nodes);
   // If we missed the cache for certain ops, compile them now and fixup the
   // chained ops vector.
-  if (!compile_instances.empty()) {
-    TF_VLOG(3) << "Compiling " << compile_instances.size()
-               << " computations on device " << device;
-    auto computation_ptrs =
-        xla::ComputationClient::Get()->Compile(std::move(compile_instances));
+  if (!plan.compile_instances.empty()) {
+    size_t num_instances = plan.compile_instances.size();
+    TF_VLOG(3) << "Compiling " << num_instances << " computations on device "
+               << device;
+    auto computation_ptrs = xla::ComputationClient::Get()->Compile(
+        std::move(plan.compile_instances));
     TF_VLOG(3) << "Compiling " << computation_ptrs.size()
                << " computations on device " << device << " done!";
-    for (size_t i = 0; i < computation_ptrs.size(); ++i) {
-      compile_cache_.Add(cache_keys[i], computation_ptrs[i]);
-      for (auto index : compile_indices[cache_keys[i]]) {
-        chained_exec_ops[index].computation = computation_ptrs[i];
-      }
-    }
+    AddComputations(&plan, 0, num_instances, computation_ptrs);
   }
-  return chained_exec_ops;
+  return std::move(plan.ops);
 }
 
 std::vector<xla::ComputationClient::DataPtr> OpByOpExecutor::Execute(
     absl::Span<const ir::Value> roots, const std::string& device,
     absl::Span<const std::string> devices) {
-  auto chained_exec_ops = BuildOps(roots, device, devices);
-  return xla::ComputationClient::Get()->ExecuteChained(chained_exec_ops,
-                                                       device);
+  OpsPlan plan = PlanOps(roots, device, devices, /*op_nodes=*/nullptr);
+  std::vector<xla::ComputationClient::DataPtr> device_data;
+  for (auto& cxop : plan.ops) {
+    if (cxop.device_data != nullptr) {
+      device_data.push_back(cxop.device_data);
+    }
+  }
+  MaterializeDeferredTensorsData(device_data);
+  if (compile_chunk_size_ > 0 &&
+      plan.compile_instances.size() > compile_chunk_size_) {
+    return ExecutePipelined(&plan, device);
+  }
+  if (!plan.compile_instances.empty()) {
+    size_t num_instances = plan.compile_instances.size();
+    auto computation_ptrs = xla::ComputationClient::Get()->Compile(
+        std::move(plan.compile_instances));
+    AddComputations(&plan, 0, num_instances, computation_ptrs);
+  }
+  return xla::ComputationClient::Get()->ExecuteChained(plan.ops, device);
+}
+
+std::vector<xla::ComputationClient::DataPtr> OpByOpExecutor::ExecutePipelined(
+    OpsPlan* plan, const std::string& device) {
+  XLA_COUNTER("OpByOpPipelinedGraphs", 1);
+  size_t num_instances = plan->compile_instances.size();
+  size_t num_chunks =
+      (num_instances + compile_chunk_size_ - 1) / compile_chunk_size_;
+  // The ops before the first use of a chunk computations only need the
+  // computations of the previous chunks, so chunk_ends[c] is the end of the
+  // ops prefix which can run once the chunks up to c are compiled.
+  std::vector<size_t> chunk_ends(num_chunks, plan->ops.size());
+  for (size_t c = 0; c + 1 < num_chunks; ++c) {
+    chunk_ends[c] = plan->compile_indices
+                        .at(plan->cache_keys[(c + 1) * compile_chunk_size_])
+                        .front();
+  }
+  // The chunks are compiled on the IO thread pool (the compilation mostly
+  // waits for the service). The closures own their output shapes and results,
+  // so that an early failure does not leave them using freed memory.
+  std::vector<xla::env::Completion> completions;
+  std::vector<
+      std::shared_ptr<std::vector<xla::ComputationClient::ComputationPtr>>>
+      chunk_computations;
+  for (size_t c = 0; c < num_chunks; ++c) {
+    size_t start = c * compile_chunk_size_;
+    size_t end = std::min(start + compile_chunk_size_, num_instances);
+    std::vector<xla::ComputationClient::CompileInstance> instances(
+        std::make_move_iterator(plan->compile_instances.begin() + start),
+        std::make_move_iterator(plan->compile_instances.begin() + end));
+    auto shapes = std::make_shared<std::list<xla::Shape>>();
+    for (auto& instance : instances) {
+      shapes->push_back(*instance.output_shape);
+      instance.output_shape = &shapes->back();
+    }
+    auto computations =
+        std::make_shared<std::vector<xla::ComputationClient::ComputationPtr>>();
+    auto compilefn = [instances = std::move(instances), shapes,
+                      computations]() mutable {
+      *computations =
+          xla::ComputationClient::Get()->Compile(std::move(instances));
+    };
+    chunk_computations.push_back(std::move(computations));
+    completions.push_back(
+        xla::env::ScheduleIoClosureWithCompletion(std::move(compilefn)));
+  }
+
+  // The last op using the result of every op, across all the segments.
+  std::vector<size_t> last_uses(plan->ops.size(), 0);
+  for (size_t i = 0; i < plan->ops.size(); ++i) {
+    for (auto& input : plan->ops[i].inputs) {
+      last_uses[input.op_index] = i;
+    }
+  }
+  // The outputs of the executed ops which are used by the following segments,
+  // by op index and output index.
+  std::vector<std::unordered_map<size_t, xla::ComputationClient::DataPtr>>
+      op_outputs(plan->ops.size());
+  std::vector<xla::ComputationClient::DataPtr> results;
+  auto set_result = [&](size_t result_index,
+                        xla::ComputationClient::DataPtr data) {
+    if (result_index >= results.size()) {
+      results.resize(result_index + 1);
+    }
+    results[result_index] = std::move(data);
+  };
+  size_t start = 0;
+  for (size_t c = 0; c < num_chunks; ++c) {
+    completions[c].Wait();
+    size_t chunk_start = c * compile_chunk_size_;
+    AddComputations(plan, chunk_start,
+                    chunk_start + chunk_computations[c]->size(),
+                    *chunk_computations[c]);
+    size_t end = chunk_ends[c];
+    if (end == start) {
+      continue;
+    }
+    // Builds the segment of the [start, end) ops, where the values produced
+    // by the previous segments (and the device data) become device data ops.
+    std::vector<xla::ComputationClient::ExecuteChainedOp> segment_ops;
+    std::vector<size_t> segment_indices(end - start);
+    // The result indices of the roots computed by the segment.
+    std::vector<size_t> segment_outputs;
+    for (size_t i = start; i < end; ++i) {
+      const xla::ComputationClient::ExecuteChainedOp& cxop = plan->ops[i];
+      if (cxop.device_data != nullptr) {
+        for (auto& output : cxop.outputs) {
+          set_result(output.result_index, cxop.device_data);
+        }
+        continue;
+      }
+      xla::ComputationClient::ExecuteChainedOp segment_op;
+      segment_op.computation = cxop.computation;
+      for (auto& input : cxop.inputs) {
+        const xla::ComputationClient::ExecuteChainedOp& input_op =
+            plan->ops[input.op_index];
+        if (input.op_index >= start && input_op.device_data == nullptr) {
+          segment_op.inputs.push_back(
+              {segment_indices[input.op_index - start], input.output_index});
+          continue;
+        }
+        xla::ComputationClient::ExecuteChainedOp data_op;
+        data_op.device_data =
+            input_op.device_data != nullptr
+                ? input_op.device_data
+                : op_outputs[input.op_index].at(input.output_index.value_or(0));
+        segment_op.inputs.push_back({segment_ops.size(), absl::nullopt});
+        segment_ops.push_back(std::move(data_op));
+      }
+      for (auto& output : cxop.outputs) {
+        segment_op.outputs.push_back(
+            {segment_outputs.size(), output.output_index});
+        segment_outputs.push_back(output.result_index);
+      }
+      segment_indices[i - start] = segment_ops.size();
+      segment_ops.push_back(std::move(segment_op));
+    }
+    // The outputs of the segment ops used by the following segments are
+    // appended after the roots ones.
+    std::vector<std::pair<size_t, size_t>> carried_outputs;
+    for (size_t i = end; i < plan->ops.size(); ++i) {
+      for (auto& input : plan->ops[i].inputs) {
+        size_t output_index = input.output_index.value_or(0);
+        if (input.op_index >= start && input.op_index < end &&
+            plan->ops[input.op_index].device_data == nullptr &&
+            op_outputs[input.op_index].emplace(output_index, nullptr).second) {
+          xla::ComputationClient::ExecuteChainedOp& segment_op =
+              segment_ops[segment_indices[input.op_index - start]];
+          segment_op.outputs.push_back(
+              {segment_outputs.size() + carried_outputs.size(),
+               input.output_index});
+          carried_outputs.emplace_back(input.op_index, output_index);
+        }
+      }
+    }
+    if (!segment_ops.empty()) {
+      XLA_COUNTER("OpByOpPipelinedSegments", 1);
+      std::vector<xla::ComputationClient::DataPtr> segment_results =
+          xla::ComputationClient::Get()->ExecuteChained(segment_ops, device);
+      for (size_t i = 0; i < segment_outputs.size(); ++i) {
+        set_result(segment_outputs[i], segment_results[i]);
+      }
+      for (size_t i = 0; i < carried_outputs.size(); ++i) {
+        op_outputs[carried_outputs[i].first][carried_outputs[i].second] =
+            segment_results[segment_outputs.size() + i];
+      }
+    }
+    // Drop the carried values which are not used past this segment.
+    for (size_t i = 0; i < end; ++i) {
+      if (last_uses[i] < end) {
+        op_outputs[i].clear();
+      }
+    }
+    start = end;
+  }
+  return results;
 }
 
 OpByOpExecutor::AsyncTask OpByOpExecutor::ExecuteAsync(
@@ -217,8 +546,12 @@ OpByOpExecutor::AsyncTask OpByOpExecutor::ExecuteAsync(
 OpByOpExecutor* OpByOpExecutor::Get() {
   static const xla::int64 compile_cache_size =
       xla::sys_util::GetEnvInt("SPLIT_EXECUTOR_CACHE_SIZE", 2048);
-  static OpByOpExecutor* split_executor =
-      new OpByOpExecutor(compile_cache_size);
+  static const xla::int64 max_fusion_size =
+      xla::sys_util::GetEnvInt("XLA_OPBYOP_FUSION_SIZE", 1);
+  static const xla::int64 compile_chunk_size =
+      xla::sys_util::GetEnvInt("XLA_OPBYOP_COMPILE_CHUNK", 0);
+  static OpByOpExecutor* split_executor = new OpByOpExecutor(
+      compile_cache_size, max_fusion_size, compile_chunk_size);
   return split_executor;
 }
 
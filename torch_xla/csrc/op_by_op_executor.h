@@ -1,6 +1,8 @@
 #pragma once
 
+#include <list>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "absl/types/span.h"
@@ -16,7 +18,12 @@ namespace torch_xla {
 // The OpByOpExecutor class is a singleton accessible via its Get() API that
 // allows to run an IR graph is per-IR-node isolation mode. Instead of lowering
 // the whole IR graph in a single XLA computation, the single IR nodes are
-// lowered and executed independently.
+// lowered and executed independently. Chains of same shape IR nodes, each one
+// the only user of the previous one, can optionally be fused into a single
+// computation, which is cached by the keys of all its nodes.
+// When a graph misses the cache for many computations, Execute() can compile
+// them in chunks, in parallel, and run the ops whose computations are ready
+// while the following chunks are still compiling.
 class OpByOpExecutor {
  public:
   using AsyncResult = std::vector<xla::ComputationClient::DataPtr>;
@@ -24,9 +31,12 @@ class OpByOpExecutor {
 
   static OpByOpExecutor* Get();
 
+  // If op_nodes is not nullptr, it receives the IR node each op computes (the
+  // last node of the fused ones).
   std::vector<xla::ComputationClient::ExecuteChainedOp> BuildOps(
       absl::Span<const ir::Value> roots, const std::string& device,
-      absl::Span<const std::string> devices);
+      absl::Span<const std::string> devices,
+      std::vector<const ir::Node*>* op_nodes = nullptr);
 
   std::vector<xla::ComputationClient::DataPtr> Execute(
       absl::Span<const ir::Value> roots, const std::string& device,
@@ -38,12 +48,41 @@ class OpByOpExecutor {
 
  private:
   using CompileCache =
-      xla::util::Cache<xla::hash_t, xla::ComputationClient::Computation,
-                       xla::util::HashReducer>;
+      xla::util::ShardedCache<xla::hash_t, xla::ComputationClient::Computation,
+                              xla::util::HashReducer>;
+
+  // The chained ops of a graph, together with the computations which missed
+  // the cache. The compile instances are in the post-order of the first op
+  // using them, and the ops using them have a null computation.
+  struct OpsPlan {
+    std::vector<xla::ComputationClient::ExecuteChainedOp> ops;
+    std::vector<xla::hash_t> cache_keys;
+    std::unordered_map<xla::hash_t, std::vector<size_t>,
+                       xla::util::HashReducer>
+        compile_indices;
+    std::list<xla::Shape> compile_shapes;
+    std::vector<xla::ComputationClient::CompileInstance> compile_instances;
+  };
+
+  OpByOpExecutor(size_t compile_cache_size, size_t max_fusion_size,
+                 size_t compile_chunk_size);
+
+  OpsPlan PlanOps(absl::Span<const ir::Value> roots, const std::string& device,
+                  absl::Span<const std::string> devices,
+                  std::vector<const ir::Node*>* op_nodes);
+
+  // Adds the compiled computations of the [start, end) compile instances of
+  // the plan to the cache, and to the ops using them.
+  void AddComputations(
+      OpsPlan* plan, size_t start, size_t end,
+      absl::Span<const xla::ComputationClient::ComputationPtr> computations);
 
-  explicit OpByOpExecutor(size_t compile_cache_size);
+  std::vector<xla::ComputationClient::DataPtr> ExecutePipelined(
+      OpsPlan* plan, const std::string& device);
 
   CompileCache compile_cache_;
+  size_t max_fusion_size_;
+  size_t compile_chunk_size_;
 };
 
 }  // namespace torch_xla
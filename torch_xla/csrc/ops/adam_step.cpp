@@ -0,0 +1,101 @@
+#include "torch_xla/csrc/ops/adam_step.h"
+
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "torch_xla/csrc/lowering_context.h"
+#include "torch_xla/csrc/optimizer_ops.h"
+#include "torch_xla/csrc/ops/xla_ops.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(absl::Span<const Value> params) {
+  std::vector<xla::Shape> tuple_shapes;
+  tuple_shapes.reserve(params.size() * 3);
+  for (size_t i = 0; i < 3; ++i) {
+    for (auto& param : params) {
+      tuple_shapes.push_back(param.shape());
+    }
+  }
+  return xla::ShapeUtil::MakeTupleShape(tuple_shapes);
+}
+
+std::vector<Value> GetOperandList(absl::Span<const Value> params,
+                                  absl::Span<const Value> grads,
+                                  absl::Span<const Value> exp_avgs,
+                                  absl::Span<const Value> exp_avg_sqs,
+                                  const Value& step_size,
+                                  const Value& bias_correction2_sqrt) {
+  XLA_CHECK_EQ(params.size(), grads.size());
+  XLA_CHECK_EQ(params.size(), exp_avgs.size());
+  XLA_CHECK_EQ(params.size(), exp_avg_sqs.size());
+  std::vector<Value> operand_list;
+  operand_list.reserve(params.size() * 4 + 2);
+  for (auto values : {params, grads, exp_avgs, exp_avg_sqs}) {
+    operand_list.insert(operand_list.end(), values.begin(), values.end());
+  }
+  operand_list.push_back(step_size);
+  operand_list.push_back(bias_correction2_sqrt);
+  return operand_list;
+}
+
+}  // namespace
+
+AdamStep::AdamStep(absl::Span<const Value> params,
+                   absl::Span<const Value> grads,
+                   absl::Span<const Value> exp_avgs,
+                   absl::Span<const Value> exp_avg_sqs, const Value& step_size,
+                   const Value& bias_correction2_sqrt, double beta1,
+                   double beta2, double eps, double weight_decay)
+    : Node(xla_adam_step,
+           GetOperandList(params, grads, exp_avgs, exp_avg_sqs, step_size,
+                          bias_correction2_sqrt),
+           [&]() { return NodeOutputShape(params); },
+           /*num_outputs=*/params.size() * 3,
+           xla::util::MHash(beta1, beta2, eps, weight_decay)),
+      beta1_(beta1),
+      beta2_(beta2),
+      eps_(eps),
+      weight_decay_(weight_decay) {}
+
+NodePtr AdamStep::Clone(OpList operands) const {
+  size_t count = (operands.size() - 2) / 4;
+  return MakeNode<AdamStep>(
+      operands.subspan(0, count), operands.subspan(count, count),
+      operands.subspan(2 * count, count), operands.subspan(3 * count, count),
+      operands.at(4 * count), operands.at(4 * count + 1), beta1_, beta2_, eps_,
+      weight_decay_);
+}
+
+XlaOpVector AdamStep::Lower(LoweringContext* loctx) const {
+  size_t count = (operands().size() - 2) / 4;
+  xla::XlaOp step_size = loctx->GetOutputOp(operand(4 * count));
+  xla::XlaOp bias_correction2_sqrt =
+      loctx->GetOutputOp(operand(4 * count + 1));
+  std::vector<xla::XlaOp> results(count * 3);
+  for (size_t i = 0; i < count; ++i) {
+    AdamStepResult result = BuildAdamStep(
+        loctx->GetOutputOp(operand(i)), loctx->GetOutputOp(operand(count + i)),
+        loctx->GetOutputOp(operand(2 * count + i)),
+        loctx->GetOutputOp(operand(3 * count + i)), step_size,
+        bias_correction2_sqrt, beta1_, beta2_, eps_, weight_decay_);
+    results[i] = result.param;
+    results[count + i] = result.exp_avg;
+    results[2 * count + i] = result.exp_avg_sq;
+  }
+  return ReturnOps(results, loctx);
+}
+
+std::string AdamStep::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", beta1=" << beta1_ << ", beta2=" << beta2_
+     << ", eps=" << eps_ << ", weight_decay=" << weight_decay_;
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "torch_xla/csrc/ir.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+// Applies the Adam update to a whole group of parameters, within a single IR
+// node. The outputs are the new params, exp_avgs and exp_avg_sqs, in this
+// order, each one of them as many as the input parameters.
+class AdamStep : public Node {
+ public:
+  AdamStep(absl::Span<const Value> params, absl::Span<const Value> grads,
+           absl::Span<const Value> exp_avgs,
+           absl::Span<const Value> exp_avg_sqs, const Value& step_size,
+           const Value& bias_correction2_sqrt, double beta1, double beta2,
+           double eps, double weight_decay);
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  std::string ToString() const override;
+
+  double beta1() const { return beta1_; }
+
+  double beta2() const { return beta2_; }
+
+  double eps() const { return eps_; }
+
+  double weight_decay() const { return weight_decay_; }
+
+ private:
+  double beta1_;
+  double beta2_;
+  double eps_;
+  double weight_decay_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
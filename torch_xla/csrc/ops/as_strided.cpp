@@ -1,9 +1,12 @@
 #include "torch_xla/csrc/ops/as_strided.h"
 
 #include <algorithm>
+#include <limits>
 
 #include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
 #include "torch_xla/csrc/data_ops.h"
 #include "torch_xla/csrc/helpers.h"
@@ -18,26 +21,53 @@ namespace {
 
 xla::XlaOp LowerAsStrided(xla::XlaOp input, absl::Span<const xla::int64> size,
                           absl::Span<const xla::int64> stride,
-                          xla::int64 storage_offset) {
-  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
-  xla::int64 input_element_count = xla::ShapeUtil::ElementsIn(input_shape);
-  xla::int64 slice_size = xla::util::Multiply<xla::int64>(size);
-  XLA_CHECK_LE(storage_offset + slice_size, input_element_count);
-
-  xla::XlaOp off_input = input;
-  if (storage_offset > 0 || slice_size < input_element_count) {
-    xla::XlaOp r1_input = XlaHelpers::Flatten(input);
-    off_input = xla::SliceInDim(r1_input, storage_offset,
-                                storage_offset + slice_size, 1, 0);
+                          xla::int64 storage_offset,
+                          const AsStrided::StridedLayout& layout) {
+  xla::Shape input_shape;
+  xla::XlaOp r1_input = XlaHelpers::Flatten(input, &input_shape);
+  if (xla::util::Multiply<xla::int64>(size) == 0) {
+    return xla::Broadcast(XlaHelpers::ScalarValue<float>(
+                              0, input_shape.element_type(), input.builder()),
+                          size);
+  }
+  if (layout.use_gather) {
+    return BuildTake(r1_input,
+                     AsStrided::BuildGatherIndices(input.builder(), size,
+                                                   stride, storage_offset));
+  }
+  xla::XlaOp region =
+      AsStrided::GetBaseRegion(r1_input, layout, storage_offset);
+  // Every region dimension is sliced to the size of its view dimension, and
+  // the trailing one to its first element.
+  std::vector<xla::int64> sorted_sizes;
+  for (auto dim : layout.dims) {
+    sorted_sizes.push_back(size[dim]);
   }
+  std::vector<xla::int64> limits(sorted_sizes);
+  limits.push_back(1);
+  if (limits != layout.region_sizes) {
+    region = xla::Slice(region, std::vector<xla::int64>(limits.size(), 0),
+                        limits, std::vector<xla::int64>(limits.size(), 1));
+  }
+  region = XlaHelpers::DynamicReshape(region, sorted_sizes);
 
-  std::vector<xla::int64> permutation = xla::InversePermutation(
-      AsStrided::GetArrayStridePermutation(stride, size));
-  std::vector<xla::int64> new_sizes = xla::Permute(permutation, size);
-  xla::XlaOp reshaped_input = XlaHelpers::DynamicReshape(off_input, new_sizes);
-  return xla::IsIdentityPermutation(permutation)
-             ? reshaped_input
-             : xla::Transpose(reshaped_input, permutation);
+  std::vector<xla::int64> view_dims(layout.dims);
+  std::sort(view_dims.begin(), view_dims.end());
+  std::vector<xla::int64> permutation;
+  for (auto dim : view_dims) {
+    permutation.push_back(
+        std::find(layout.dims.begin(), layout.dims.end(), dim) -
+        layout.dims.begin());
+  }
+  if (!xla::IsIdentityPermutation(permutation)) {
+    region = xla::Transpose(region, permutation);
+  }
+  bool has_broadcasts = false;
+  for (size_t i = 0; i < size.size(); ++i) {
+    has_broadcasts |= size[i] > 1 && stride[i] == 0;
+  }
+  return has_broadcasts ? xla::BroadcastInDim(region, size, view_dims)
+                        : XlaHelpers::DynamicReshape(region, size);
 }
 
 }  // namespace
@@ -52,7 +82,12 @@ AsStrided::AsStrided(const Value& input, std::vector<xla::int64> size,
            /*num_outputs=*/1, xla::util::MHash(size, stride, storage_offset)),
       size_(std::move(size)),
       stride_(std::move(stride)),
-      storage_offset_(storage_offset) {}
+      storage_offset_(storage_offset),
+      layout_(GetStridedLayout(size_, stride_)) {
+  if (layout_.use_gather) {
+    XLA_COUNTER("AsStridedGather", 1);
+  }
+}
 
 std::string AsStrided::ToString() const {
   std::stringstream ss;
@@ -68,26 +103,107 @@ NodePtr AsStrided::Clone(OpList operands) const {
 
 XlaOpVector AsStrided::Lower(LoweringContext* loctx) const {
   xla::XlaOp input = loctx->GetOutputOp(operand(0));
-  return ReturnOp(LowerAsStrided(input, size_, stride_, storage_offset_),
-                  loctx);
+  return ReturnOp(
+      LowerAsStrided(input, size_, stride_, storage_offset_, layout_), loctx);
 }
 
 bool AsStrided::StrideIsSupported(const xla::Shape& input_shape,
                                   absl::Span<const xla::int64> size,
                                   absl::Span<const xla::int64> stride,
                                   xla::int64 storage_offset) {
-  std::vector<xla::int64> sorted_stride(stride.begin(), stride.end());
-  std::sort(sorted_stride.begin(), sorted_stride.end());
-  return stride.empty() || sorted_stride.front() == 1;
+  // Every stride pattern is lowered on device (the ones with no slice
+  // decomposition to gathers), as long as the view lies within the input.
+  if (storage_offset < 0) {
+    return false;
+  }
+  xla::int64 max_index = storage_offset;
+  for (size_t i = 0; i < size.size(); ++i) {
+    if (size[i] == 0) {
+      return true;
+    }
+    if (stride[i] < 0) {
+      return false;
+    }
+    max_index += (size[i] - 1) * stride[i];
+  }
+  return max_index < xla::ShapeUtil::ElementsIn(input_shape);
 }
 
-std::vector<xla::int64> AsStrided::GetArrayStridePermutation(
-    absl::Span<const xla::int64> stride, absl::Span<const xla::int64> size) {
-  std::vector<xla::int64> permutation =
-      xla::util::Iota<xla::int64>(stride.size());
-  std::sort(permutation.begin(), permutation.end(),
-            [&](xla::int64 a, xla::int64 b) { return stride[a] > stride[b]; });
-  return permutation;
+AsStrided::StridedLayout AsStrided::GetStridedLayout(
+    absl::Span<const xla::int64> size, absl::Span<const xla::int64> stride) {
+  StridedLayout layout;
+  for (size_t i = 0; i < size.size(); ++i) {
+    if (size[i] > 1 && stride[i] != 0) {
+      layout.dims.push_back(i);
+    }
+  }
+  std::stable_sort(
+      layout.dims.begin(), layout.dims.end(),
+      [&](xla::int64 a, xla::int64 b) { return stride[a] > stride[b]; });
+  if (layout.dims.empty()) {
+    layout.region_sizes.push_back(1);
+    return layout;
+  }
+  layout.region_sizes.push_back(size[layout.dims.front()]);
+  for (size_t i = 1; i < layout.dims.size(); ++i) {
+    xla::int64 outer_stride = stride[layout.dims[i - 1]];
+    xla::int64 inner_stride = stride[layout.dims[i]];
+    if (outer_stride % inner_stride != 0 ||
+        outer_stride < inner_stride * size[layout.dims[i]]) {
+      layout.use_gather = true;
+      layout.region_sizes.clear();
+      return layout;
+    }
+    layout.region_sizes.push_back(outer_stride / inner_stride);
+  }
+  layout.region_sizes.push_back(stride[layout.dims.back()]);
+  return layout;
+}
+
+xla::XlaOp AsStrided::GetBaseRegion(xla::XlaOp r1_base,
+                                    const StridedLayout& layout,
+                                    xla::int64 storage_offset) {
+  const xla::Shape& base_shape = XlaHelpers::ShapeOfXlaOp(r1_base);
+  xla::int64 base_size = base_shape.dimensions(0);
+  xla::int64 region_size = xla::util::Multiply<xla::int64>(layout.region_sizes);
+  xla::int64 available_size = base_size - storage_offset;
+  xla::XlaOp region = r1_base;
+  if (storage_offset > 0 || region_size < base_size) {
+    region = xla::SliceInDim(
+        r1_base, storage_offset,
+        storage_offset + std::min(region_size, available_size), 1, 0);
+  }
+  if (region_size > available_size) {
+    // The tail of the last region row is never read by the view.
+    region = PadInDim(region, 0, 0, region_size - available_size);
+  }
+  return XlaHelpers::DynamicReshape(region, layout.region_sizes);
+}
+
+xla::XlaOp AsStrided::BuildGatherIndices(xla::XlaBuilder* builder,
+                                         absl::Span<const xla::int64> size,
+                                         absl::Span<const xla::int64> stride,
+                                         xla::int64 storage_offset) {
+  xla::int64 max_index = storage_offset;
+  for (size_t i = 0; i < size.size(); ++i) {
+    max_index += (size[i] - 1) * stride[i];
+  }
+  xla::PrimitiveType type =
+      max_index > std::numeric_limits<xla::int32>::max()
+          ? xla::PrimitiveType::S64
+          : xla::PrimitiveType::S32;
+  xla::Shape shape = xla::ShapeUtil::MakeShape(type, size);
+  xla::XlaOp indices = xla::Broadcast(
+      XlaHelpers::ScalarValue<xla::int64>(storage_offset, type, builder),
+      size);
+  for (size_t i = 0; i < size.size(); ++i) {
+    if (size[i] > 1 && stride[i] != 0) {
+      indices = indices + xla::Iota(builder, shape, i) *
+                              XlaHelpers::ScalarValue<xla::int64>(
+                                  stride[i], type, builder);
+    }
+  }
+  return indices;
 }
 
 }  // namespace ops
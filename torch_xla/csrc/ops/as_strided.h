@@ -11,6 +11,21 @@ namespace ops {
 
 class AsStrided : public Node {
  public:
+  // The decomposition of an as_strided() view of a flattened base into cheap
+  // ops. The view dimensions with a zero stride are broadcast, and the others,
+  // sorted by decreasing stride, are slices of the base region (from the
+  // storage offset) reshaped so that every stride is the one of a dense
+  // dimension. Views whose dimensions overlap (like the sliding windows of
+  // unfold()) have no such decomposition, and are lowered to gathers.
+  struct StridedLayout {
+    // The view dimensions which index the base, by decreasing stride.
+    std::vector<xla::int64> dims;
+    // The shape the base region is reshaped to, with a dimension for each of
+    // dims, plus a trailing one of the innermost stride.
+    std::vector<xla::int64> region_sizes;
+    bool use_gather = false;
+  };
+
   AsStrided(const Value& input, std::vector<xla::int64> size,
             std::vector<xla::int64> stride, xla::int64 storage_offset);
 
@@ -31,13 +46,28 @@ class AsStrided : public Node {
                                 absl::Span<const xla::int64> stride,
                                 xla::int64 storage_offset);
 
-  static std::vector<xla::int64> GetArrayStridePermutation(
-      absl::Span<const xla::int64> stride, absl::Span<const xla::int64> size);
+  static StridedLayout GetStridedLayout(absl::Span<const xla::int64> size,
+                                        absl::Span<const xla::int64> stride);
+
+  // Returns the base region of the layout, sliced from the rank 1 base at the
+  // storage offset (and padded if it runs past its end), reshaped to the
+  // region sizes.
+  static xla::XlaOp GetBaseRegion(xla::XlaOp r1_base,
+                                  const StridedLayout& layout,
+                                  xla::int64 storage_offset);
+
+  // Returns the indices within the flattened base of the view elements, for
+  // the views lowered to gathers.
+  static xla::XlaOp BuildGatherIndices(xla::XlaBuilder* builder,
+                                       absl::Span<const xla::int64> size,
+                                       absl::Span<const xla::int64> stride,
+                                       xla::int64 storage_offset);
 
  private:
   std::vector<xla::int64> size_;
   std::vector<xla::int64> stride_;
   xla::int64 storage_offset_;
+  StridedLayout layout_;
 };
 
 }  // namespace ops
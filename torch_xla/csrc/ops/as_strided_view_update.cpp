@@ -1,5 +1,7 @@
 #include "torch_xla/csrc/ops/as_strided_view_update.h"
 
+#include <algorithm>
+
 #include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
 #include "torch_xla/csrc/data_ops.h"
@@ -9,34 +11,84 @@
 #include "torch_xla/csrc/ops/xla_ops.h"
 #include "torch_xla/csrc/tensor_util.h"
 #include "torch_xla/csrc/torch_util.h"
+#include "torch_xla/csrc/xla_lower_util.h"
 
 namespace torch_xla {
 namespace ir {
 namespace ops {
 namespace {
 
-xla::XlaOp LowerAsStridedViewUpdate(xla::XlaOp target, xla::XlaOp input,
-                                    absl::Span<const xla::int64> size,
-                                    absl::Span<const xla::int64> stride,
-                                    xla::int64 storage_offset) {
+xla::XlaOp LowerAsStridedViewUpdate(
+    const Device& device, xla::XlaOp target, xla::XlaOp input,
+    absl::Span<const xla::int64> size, absl::Span<const xla::int64> stride,
+    xla::int64 storage_offset, const AsStrided::StridedLayout& layout) {
   const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
-  xla::int64 input_element_count = xla::ShapeUtil::ElementsIn(input_shape);
-  xla::int64 slice_size = xla::util::Multiply<xla::int64>(size);
-  XLA_CHECK_LE(storage_offset + input_element_count, slice_size);
+  xla::Shape target_shape;
+  xla::XlaOp r1_target = XlaHelpers::Flatten(target, &target_shape);
+  xla::int64 target_element_count = xla::ShapeUtil::ElementsIn(target_shape);
+  if (xla::ShapeUtil::ElementsIn(input_shape) == 0) {
+    return XlaHelpers::DynamicReshape(r1_target, size);
+  }
+  if (layout.use_gather) {
+    xla::XlaOp indices = AsStrided::BuildGatherIndices(
+        input.builder(), input_shape.dimensions(), stride, storage_offset);
+    return XlaHelpers::DynamicReshape(
+        CreatePut(device, r1_target, indices, input, /*accumulate=*/false),
+        size);
+  }
+  // The view dimensions which do not index the base are either of size one,
+  // or broadcast ones, whose first element is the one written.
+  std::vector<xla::int64> limits;
+  std::vector<xla::int64> view_dims;
+  for (xla::int64 i = 0; i < input_shape.rank(); ++i) {
+    bool indexes_base = std::find(layout.dims.begin(), layout.dims.end(), i) !=
+                        layout.dims.end();
+    limits.push_back(indexes_base ? input_shape.dimensions(i) : 1);
+    if (indexes_base) {
+      view_dims.push_back(i);
+    }
+  }
+  xla::XlaOp update = input;
+  if (absl::MakeConstSpan(limits) != input_shape.dimensions()) {
+    update = xla::Slice(update, std::vector<xla::int64>(limits.size(), 0),
+                        limits, std::vector<xla::int64>(limits.size(), 1));
+  }
+  std::vector<xla::int64> view_sizes;
+  for (auto dim : view_dims) {
+    view_sizes.push_back(input_shape.dimensions(dim));
+  }
+  update = XlaHelpers::DynamicReshape(update, view_sizes);
+  std::vector<xla::int64> permutation;
+  for (auto dim : layout.dims) {
+    permutation.push_back(std::find(view_dims.begin(), view_dims.end(), dim) -
+                          view_dims.begin());
+  }
+  if (!xla::IsIdentityPermutation(permutation)) {
+    update = xla::Transpose(update, permutation);
+  }
+  std::vector<xla::int64> update_sizes;
+  for (auto dim : layout.dims) {
+    update_sizes.push_back(input_shape.dimensions(dim));
+  }
+  update_sizes.push_back(1);
+  update = XlaHelpers::DynamicReshape(update, update_sizes);
 
-  std::vector<xla::int64> permutation =
-      AsStrided::GetArrayStridePermutation(stride, input_shape.dimensions());
-  xla::XlaOp transposed_input = xla::IsIdentityPermutation(permutation)
-                                    ? input
-                                    : xla::Transpose(input, permutation);
-  if (storage_offset > 0 || input_element_count < slice_size) {
-    xla::XlaOp r1_input = XlaHelpers::Flatten(transposed_input);
-    xla::XlaOp r1_target = XlaHelpers::Flatten(target);
-    transposed_input = xla::DynamicUpdateSlice(
-        r1_target, r1_input,
-        {XlaHelpers::ScalarValue<xla::int64>(storage_offset, input.builder())});
+  xla::XlaOp region =
+      AsStrided::GetBaseRegion(r1_target, layout, storage_offset);
+  region = BuildUpdateSlice(
+      region, update, std::vector<xla::int64>(update_sizes.size(), 0));
+  xla::int64 region_size =
+      std::min(xla::util::Multiply<xla::int64>(layout.region_sizes),
+               target_element_count - storage_offset);
+  xla::XlaOp r1_region = XlaHelpers::Flatten(region);
+  if (region_size < xla::util::Multiply<xla::int64>(layout.region_sizes)) {
+    r1_region = xla::SliceInDim(r1_region, 0, region_size, 1, 0);
   }
-  return XlaHelpers::DynamicReshape(transposed_input, size);
+  xla::XlaOp r1_result =
+      region_size == target_element_count
+          ? r1_region
+          : BuildUpdateSlice(r1_target, r1_region, {storage_offset});
+  return XlaHelpers::DynamicReshape(r1_result, size);
 }
 
 }  // namespace
@@ -54,7 +106,9 @@ AsStridedViewUpdate::AsStridedViewUpdate(const Value& target,
            /*num_outputs=*/1, xla::util::MHash(size, stride, storage_offset)),
       size_(std::move(size)),
       stride_(std::move(stride)),
-      storage_offset_(storage_offset) {}
+      storage_offset_(storage_offset),
+      layout_(AsStrided::GetStridedLayout(input.shape().dimensions(),
+                                          stride_)) {}
 
 std::string AsStridedViewUpdate::ToString() const {
   std::stringstream ss;
@@ -73,7 +127,8 @@ XlaOpVector AsStridedViewUpdate::Lower(LoweringContext* loctx) const {
   xla::XlaOp target = loctx->GetOutputOp(operand(0));
   xla::XlaOp input = loctx->GetOutputOp(operand(1));
   return ReturnOp(
-      LowerAsStridedViewUpdate(target, input, size_, stride_, storage_offset_),
+      LowerAsStridedViewUpdate(loctx->device(), target, input, size_, stride_,
+                               storage_offset_, layout_),
       loctx);
 }
 
@@ -4,6 +4,7 @@
 
 #include "tensorflow/compiler/xla/types.h"
 #include "torch_xla/csrc/ir.h"
+#include "torch_xla/csrc/ops/as_strided.h"
 
 namespace torch_xla {
 namespace ir {
@@ -32,6 +33,7 @@ class AsStridedViewUpdate : public Node {
   std::vector<xla::int64> size_;
   std::vector<xla::int64> stride_;
   xla::int64 storage_offset_;
+  AsStrided::StridedLayout layout_;
 };
 
 }  // namespace ops
@@ -71,6 +71,16 @@ NodePtr AvgPoolNd::Clone(OpList operands) const {
 }
 
 XlaOpVector AvgPoolNd::Lower(LoweringContext* loctx) const {
+  if (loctx->ChannelsLastEnabled() &&
+      loctx->HasOutputOpChannelsLast(operand(0)) &&
+      operand(0).shape().rank() == spatial_dim_count_ + 2) {
+    xla::XlaOp output =
+        BuildAvgPoolNd(loctx->GetOutputOpChannelsLast(operand(0)),
+                       spatial_dim_count_, kernel_size_, stride_, padding_,
+                       ceil_mode_, count_include_pad_, /*channels_last=*/true);
+    loctx->AssignOutputOpChannelsLast(Output(this), output);
+    return {loctx->GetOutputOp(Output(this))};
+  }
   xla::XlaOp input = loctx->GetOutputOp(operand(0));
   xla::XlaOp output =
       BuildAvgPoolNd(input, spatial_dim_count_, kernel_size_, stride_, padding_,
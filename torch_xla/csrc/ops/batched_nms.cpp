@@ -0,0 +1,69 @@
+#include "torch_xla/csrc/ops/batched_nms.h"
+
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "torch_xla/csrc/lowering_context.h"
+#include "torch_xla/csrc/nms_op.h"
+#include "torch_xla/csrc/ops/infer_output_shape.h"
+#include "torch_xla/csrc/ops/xla_ops.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(const Value& boxes, const Value& scores,
+                           const Value& score_threshold,
+                           const Value& iou_threshold, xla::int64 output_size,
+                           xla::int64 top_k) {
+  auto shape_fn = [&](absl::Span<const xla::XlaOp> operands) -> xla::XlaOp {
+    NmsResult result = BuildBatchedNms(operands[0], operands[1], operands[2],
+                                       operands[3], output_size, top_k);
+    return xla::Tuple(result.selected_indices.builder(),
+                      {result.selected_indices, result.num_valid});
+  };
+  return InferOutputShape({boxes.shape(), scores.shape(),
+                           score_threshold.shape(), iou_threshold.shape()},
+                          shape_fn);
+}
+
+}  // namespace
+
+BatchedNms::BatchedNms(const Value& boxes, const Value& scores,
+                       const Value& score_threshold,
+                       const Value& iou_threshold, xla::int64 output_size,
+                       xla::int64 top_k)
+    : Node(xla_batched_nms, {boxes, scores, score_threshold, iou_threshold},
+           [&]() {
+             return NodeOutputShape(boxes, scores, score_threshold,
+                                    iou_threshold, output_size, top_k);
+           },
+           /*num_outputs=*/2, xla::util::MHash(output_size, top_k)),
+      output_size_(output_size),
+      top_k_(top_k) {}
+
+NodePtr BatchedNms::Clone(OpList operands) const {
+  return MakeNode<BatchedNms>(operands.at(0), operands.at(1), operands.at(2),
+                              operands.at(3), output_size_, top_k_);
+}
+
+XlaOpVector BatchedNms::Lower(LoweringContext* loctx) const {
+  xla::XlaOp boxes = loctx->GetOutputOp(operand(0));
+  xla::XlaOp scores = loctx->GetOutputOp(operand(1));
+  xla::XlaOp score_threshold = loctx->GetOutputOp(operand(2));
+  xla::XlaOp iou_threshold = loctx->GetOutputOp(operand(3));
+  NmsResult result = BuildBatchedNms(boxes, scores, score_threshold,
+                                     iou_threshold, output_size_, top_k_);
+  return ReturnOps({result.selected_indices, result.num_valid}, loctx);
+}
+
+std::string BatchedNms::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", output_size=" << output_size_
+     << ", top_k=" << top_k_;
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "torch_xla/csrc/ir.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+class BatchedNms : public Node {
+ public:
+  BatchedNms(const Value& boxes, const Value& scores,
+             const Value& score_threshold, const Value& iou_threshold,
+             xla::int64 output_size, xla::int64 top_k);
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  std::string ToString() const override;
+
+  xla::int64 output_size() const { return output_size_; }
+
+  xla::int64 top_k() const { return top_k_; }
+
+ private:
+  xla::int64 output_size_;
+  xla::int64 top_k_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
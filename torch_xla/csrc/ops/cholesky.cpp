@@ -3,7 +3,9 @@
 #include "tensorflow/compiler/xla/client/lib/matrix.h"
 #include "tensorflow/compiler/xla/client/xla_builder.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
+#include "torch_xla/csrc/helpers.h"
 #include "torch_xla/csrc/lowering_context.h"
+#include "torch_xla/csrc/matrix.h"
 
 namespace torch_xla {
 namespace ir {
@@ -20,8 +22,15 @@ NodePtr Cholesky::Clone(OpList operands) const {
 
 XlaOpVector Cholesky::Lower(LoweringContext* loctx) const {
   xla::XlaOp input = loctx->GetOutputOp(operand(0));
-  xla::XlaOp output =
-      xla::Triangle(xla::Cholesky(input, /*lower=*/lower_), /*lower=*/lower_);
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  xla::XlaOp output;
+  if (UseSmallMatrixLowering(
+          input_shape.dimensions(input_shape.rank() - 1))) {
+    output = BuildSmallCholesky(input, /*lower=*/lower_);
+  } else {
+    output = xla::Triangle(xla::Cholesky(input, /*lower=*/lower_),
+                           /*lower=*/lower_);
+  }
   return ReturnOp(output, loctx);
 }
 
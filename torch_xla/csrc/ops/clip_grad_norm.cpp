@@ -0,0 +1,69 @@
+#include "torch_xla/csrc/ops/clip_grad_norm.h"
+
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "torch_xla/csrc/lowering_context.h"
+#include "torch_xla/csrc/optimizer_ops.h"
+#include "torch_xla/csrc/ops/xla_ops.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(absl::Span<const Value> grads) {
+  std::vector<xla::Shape> tuple_shapes;
+  tuple_shapes.reserve(grads.size() + 1);
+  for (auto& grad : grads) {
+    tuple_shapes.push_back(grad.shape());
+  }
+  tuple_shapes.push_back(
+      xla::ShapeUtil::MakeShape(grads.front().shape().element_type(), {}));
+  return xla::ShapeUtil::MakeTupleShape(tuple_shapes);
+}
+
+std::vector<Value> GetOperandList(absl::Span<const Value> grads,
+                                  const Value& max_norm) {
+  std::vector<Value> operand_list(grads.begin(), grads.end());
+  operand_list.push_back(max_norm);
+  return operand_list;
+}
+
+}  // namespace
+
+ClipGradNorm::ClipGradNorm(absl::Span<const Value> grads,
+                           const Value& max_norm, double norm_type)
+    : Node(xla_clip_grad_norm, GetOperandList(grads, max_norm),
+           [&]() { return NodeOutputShape(grads); },
+           /*num_outputs=*/grads.size() + 1, xla::util::MHash(norm_type)),
+      norm_type_(norm_type) {}
+
+NodePtr ClipGradNorm::Clone(OpList operands) const {
+  size_t count = operands.size() - 1;
+  return MakeNode<ClipGradNorm>(operands.subspan(0, count),
+                                operands.at(count), norm_type_);
+}
+
+XlaOpVector ClipGradNorm::Lower(LoweringContext* loctx) const {
+  size_t count = operands().size() - 1;
+  std::vector<xla::XlaOp> grads;
+  grads.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    grads.push_back(loctx->GetOutputOp(operand(i)));
+  }
+  ClipGradNormResult result = BuildClipGradNorm(
+      grads, loctx->GetOutputOp(operand(count)), norm_type_);
+  std::vector<xla::XlaOp> results = std::move(result.grads);
+  results.push_back(result.total_norm);
+  return ReturnOps(results, loctx);
+}
+
+std::string ClipGradNorm::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", norm_type=" << norm_type_;
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "torch_xla/csrc/ir.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+// Clips the norm of a whole group of gradients, within a single IR node. The
+// outputs are the scaled gradients, as many as the input ones, followed by the
+// total norm.
+class ClipGradNorm : public Node {
+ public:
+  ClipGradNorm(absl::Span<const Value> grads, const Value& max_norm,
+               double norm_type);
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  std::string ToString() const override;
+
+  double norm_type() const { return norm_type_; }
+
+ private:
+  double norm_type_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
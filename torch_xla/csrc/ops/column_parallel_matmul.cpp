@@ -0,0 +1,96 @@
+#include "torch_xla/csrc/ops/column_parallel_matmul.h"
+
+#include "absl/strings/str_join.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "torch_xla/csrc/lowering_context.h"
+#include "torch_xla/csrc/ops/infer_output_shape.h"
+#include "torch_xla/csrc/ops/xla_ops.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(const Value& input, const Value& weight,
+                           const absl::optional<Value>& bias,
+                           const Value& token, bool gather_output,
+                           xla::int64 shard_count, xla::int64 num_chunks,
+                           const std::vector<std::vector<xla::int64>>& groups) {
+  auto shape_fn = [&](absl::Span<const xla::XlaOp> operands) -> xla::XlaOp {
+    absl::optional<xla::XlaOp> bias;
+    if (operands.size() > 3) {
+      bias = operands[3];
+    }
+    ParallelMatMulResult result =
+        BuildColumnParallelMatMul(operands[0], operands[1], bias, operands[2],
+                                  gather_output, shard_count, num_chunks,
+                                  groups);
+    return xla::Tuple(operands[0].builder(), {result.result, result.token});
+  };
+  std::vector<xla::Shape> shapes;
+  for (auto& operand :
+       xla::util::GetValuesVector<Value>({input, weight, token}, {&bias})) {
+    shapes.push_back(operand.shape());
+  }
+  return InferOutputShape(shapes, shape_fn);
+}
+
+}  // namespace
+
+ColumnParallelMatMul::ColumnParallelMatMul(
+    const Value& input, const Value& weight, const absl::optional<Value>& bias,
+    const Value& token, bool gather_output, xla::int64 shard_count,
+    xla::int64 num_chunks, std::vector<std::vector<xla::int64>> groups)
+    : Node(xla_column_parallel_matmul,
+           xla::util::GetValuesVector<Value>({input, weight, token}, {&bias}),
+           [&]() {
+             return NodeOutputShape(input, weight, bias, token, gather_output,
+                                    shard_count, num_chunks, groups);
+           },
+           /*num_outputs=*/2,
+           xla::util::MHash(gather_output, shard_count, num_chunks, groups)),
+      gather_output_(gather_output),
+      shard_count_(shard_count),
+      num_chunks_(num_chunks),
+      groups_(std::move(groups)) {}
+
+NodePtr ColumnParallelMatMul::Clone(OpList operands) const {
+  absl::optional<Value> bias;
+  if (operands.size() > 3) {
+    bias = operands.at(3);
+  }
+  return MakeNode<ColumnParallelMatMul>(operands.at(0), operands.at(1), bias,
+                                        operands.at(2), gather_output_,
+                                        shard_count_, num_chunks_, groups_);
+}
+
+XlaOpVector ColumnParallelMatMul::Lower(LoweringContext* loctx) const {
+  xla::XlaOp input = loctx->GetOutputOp(operand(0));
+  xla::XlaOp weight = loctx->GetOutputOp(operand(1));
+  xla::XlaOp token = loctx->GetOutputOp(operand(2));
+  absl::optional<xla::XlaOp> bias;
+  if (operands().size() > 3) {
+    bias = loctx->GetOutputOp(operand(3));
+  }
+  ParallelMatMulResult result =
+      BuildColumnParallelMatMul(input, weight, bias, token, gather_output_,
+                                shard_count_, num_chunks_, groups_);
+  return ReturnOps({result.result, result.token}, loctx);
+}
+
+std::string ColumnParallelMatMul::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", gather_output=" << gather_output_
+     << ", shard_count=" << shard_count_ << ", num_chunks=" << num_chunks_
+     << ", groups=(";
+  for (size_t i = 0; i < groups_.size(); ++i) {
+    ss << (i == 0 ? "(" : ",(");
+    ss << absl::StrJoin(groups_[i], ", ") << ")";
+  }
+  ss << ")";
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
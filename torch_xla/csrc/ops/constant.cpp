@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <sstream>
 
+#include "tensorflow/compiler/xla/shape_util.h"
 #include "torch_xla/csrc/lowering_context.h"
 
 namespace torch_xla {
@@ -12,7 +13,9 @@ namespace ops {
 Constant::Constant(xla::Literal value)
     : Node(OpKind(at::prim::Constant), value.shape(), /*num_outputs=*/1,
            value.Hash()),
-      value_(std::move(value)) {}
+      value_(std::move(value)) {
+  AddHostBytes(xla::ShapeUtil::ByteSizeOf(value_.shape(), sizeof(void*)));
+}
 
 std::string Constant::ToString() const {
   // The Literal to string conversion produces \n separated content, which we do
@@ -84,6 +84,9 @@ NodePtr ConvolutionOverrideable::Clone(OpList operands) const {
 }
 
 XlaOpVector ConvolutionOverrideable::Lower(LoweringContext* loctx) const {
+  if (loctx->ChannelsLastEnabled() && !transposed_) {
+    return LowerChannelsLast(loctx);
+  }
   xla::XlaOp input = loctx->GetOutputOp(operand(0));
   xla::XlaOp kernel = loctx->GetOutputOp(operand(1));
   xla::XlaOp output;
@@ -101,6 +104,21 @@ XlaOpVector ConvolutionOverrideable::Lower(LoweringContext* loctx) const {
   return ReturnOp(output, loctx);
 }
 
+XlaOpVector ConvolutionOverrideable::LowerChannelsLast(
+    LoweringContext* loctx) const {
+  xla::XlaOp input = loctx->GetOutputOpChannelsLast(operand(0));
+  xla::XlaOp kernel = loctx->GetOutputOp(operand(1));
+  xla::XlaOp bias;
+  if (operands().size() == 3) {
+    bias = loctx->GetOutputOp(operand(2));
+  }
+  xla::XlaOp output = BuildConvolutionChannelsLast(
+      input, kernel, operands().size() == 3 ? &bias : nullptr, stride_,
+      padding_, dilation_, groups_);
+  loctx->AssignOutputOpChannelsLast(Output(this), output);
+  return {loctx->GetOutputOp(Output(this))};
+}
+
 std::string ConvolutionOverrideable::ToString() const {
   std::stringstream ss;
   ss << Node::ToString() << ", stride=(" << absl::StrJoin(stride_, ", ")
@@ -46,6 +46,10 @@ class ConvolutionOverrideable : public Node {
   xla::int64 groups() const { return groups_; }
 
  private:
+  // Lowers the convolution with input and output in NHWC layout, which the
+  // lowering context converts back to NCHW only for non channels-last users.
+  XlaOpVector LowerChannelsLast(LoweringContext* loctx) const;
+
   std::vector<xla::int64> stride_;
   std::vector<xla::int64> padding_;
   std::vector<xla::int64> dilation_;
@@ -0,0 +1,58 @@
+#include "torch_xla/csrc/ops/cross_entropy.h"
+
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "torch_xla/csrc/lowering_context.h"
+#include "torch_xla/csrc/nll_loss.h"
+#include "torch_xla/csrc/ops/infer_output_shape.h"
+#include "torch_xla/csrc/ops/xla_ops.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(const Value& logits, const Value& labels,
+                           int ignore_index, xla::int64 chunk_size) {
+  auto shape_fn = [&](absl::Span<const xla::XlaOp> operands) -> xla::XlaOp {
+    CrossEntropyResult result =
+        BuildCrossEntropy(operands[0], operands[1], ignore_index, chunk_size);
+    return xla::Tuple(result.loss.builder(), {result.loss, result.logsumexp});
+  };
+  return InferOutputShape({logits.shape(), labels.shape()}, shape_fn);
+}
+
+}  // namespace
+
+CrossEntropy::CrossEntropy(const Value& logits, const Value& labels,
+                           int ignore_index, xla::int64 chunk_size)
+    : Node(xla_cross_entropy, {logits, labels},
+           [&]() {
+             return NodeOutputShape(logits, labels, ignore_index, chunk_size);
+           },
+           /*num_outputs=*/2, xla::util::MHash(ignore_index, chunk_size)),
+      ignore_index_(ignore_index),
+      chunk_size_(chunk_size) {}
+
+NodePtr CrossEntropy::Clone(OpList operands) const {
+  return MakeNode<CrossEntropy>(operands.at(0), operands.at(1), ignore_index_,
+                                chunk_size_);
+}
+
+XlaOpVector CrossEntropy::Lower(LoweringContext* loctx) const {
+  xla::XlaOp logits = loctx->GetOutputOp(operand(0));
+  xla::XlaOp labels = loctx->GetOutputOp(operand(1));
+  CrossEntropyResult result =
+      BuildCrossEntropy(logits, labels, ignore_index_, chunk_size_);
+  return ReturnOps({result.loss, result.logsumexp}, loctx);
+}
+
+std::string CrossEntropy::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", ignore_index=" << ignore_index_
+     << ", chunk_size=" << chunk_size_;
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "torch_xla/csrc/ir.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+// Fused log-softmax and NLL loss, with the per sample losses and the logsumexp
+// of the logits (needed by the backward) as outputs.
+class CrossEntropy : public Node {
+ public:
+  CrossEntropy(const Value& logits, const Value& labels, int ignore_index,
+               xla::int64 chunk_size);
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  std::string ToString() const override;
+
+  int ignore_index() const { return ignore_index_; }
+
+  xla::int64 chunk_size() const { return chunk_size_; }
+
+ private:
+  int ignore_index_;
+  xla::int64 chunk_size_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
@@ -0,0 +1,50 @@
+#include "torch_xla/csrc/ops/cross_entropy_backward.h"
+
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "torch_xla/csrc/lowering_context.h"
+#include "torch_xla/csrc/nll_loss.h"
+#include "torch_xla/csrc/ops/xla_ops.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+CrossEntropyBackward::CrossEntropyBackward(const Value& grad_output,
+                                           const Value& logits,
+                                           const Value& labels,
+                                           const Value& logsumexp,
+                                           int ignore_index,
+                                           xla::int64 chunk_size)
+    : Node(xla_cross_entropy_backward,
+           {grad_output, logits, labels, logsumexp}, logits.shape(),
+           /*num_outputs=*/1, xla::util::MHash(ignore_index, chunk_size)),
+      ignore_index_(ignore_index),
+      chunk_size_(chunk_size) {}
+
+NodePtr CrossEntropyBackward::Clone(OpList operands) const {
+  return MakeNode<CrossEntropyBackward>(operands.at(0), operands.at(1),
+                                        operands.at(2), operands.at(3),
+                                        ignore_index_, chunk_size_);
+}
+
+XlaOpVector CrossEntropyBackward::Lower(LoweringContext* loctx) const {
+  xla::XlaOp grad_output = loctx->GetOutputOp(operand(0));
+  xla::XlaOp logits = loctx->GetOutputOp(operand(1));
+  xla::XlaOp labels = loctx->GetOutputOp(operand(2));
+  xla::XlaOp logsumexp = loctx->GetOutputOp(operand(3));
+  return ReturnOp(BuildCrossEntropyBackward(grad_output, logits, labels,
+                                            logsumexp, ignore_index_,
+                                            chunk_size_),
+                  loctx);
+}
+
+std::string CrossEntropyBackward::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", ignore_index=" << ignore_index_
+     << ", chunk_size=" << chunk_size_;
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
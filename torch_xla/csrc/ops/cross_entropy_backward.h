@@ -0,0 +1,33 @@
+#pragma once
+
+#include "torch_xla/csrc/ir.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+// The gradient of the fused cross entropy with respect to the logits.
+class CrossEntropyBackward : public Node {
+ public:
+  CrossEntropyBackward(const Value& grad_output, const Value& logits,
+                       const Value& labels, const Value& logsumexp,
+                       int ignore_index, xla::int64 chunk_size);
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  std::string ToString() const override;
+
+  int ignore_index() const { return ignore_index_; }
+
+  xla::int64 chunk_size() const { return chunk_size_; }
+
+ private:
+  int ignore_index_;
+  xla::int64 chunk_size_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
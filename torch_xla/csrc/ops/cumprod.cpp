@@ -22,7 +22,9 @@ xla::XlaOp LowerCumProd(xla::XlaOp input, xla::int64 dim,
       xla::One(casted_input.builder(), input_shape.element_type());
   xla::XlaComputation reducer =
       XlaHelpers::CreateMulComputation(input_shape.element_type());
-  return BuildCumulativeComputation(casted_input, dim, reducer, init);
+  return BuildCumulativeComputation(
+      casted_input, dim, reducer, init,
+      [](xla::XlaOp lhs, xla::XlaOp rhs) { return lhs * rhs; });
 }
 
 xla::Shape NodeOutputShape(const Value& input,
@@ -21,7 +21,9 @@ xla::XlaOp LowerCumSum(xla::XlaOp input, xla::int64 dim,
       0, input_shape.element_type(), casted_input.builder());
   xla::XlaComputation reducer =
       XlaHelpers::CreateAddComputation(input_shape.element_type());
-  return BuildCumulativeComputation(casted_input, dim, reducer, init);
+  return BuildCumulativeComputation(
+      casted_input, dim, reducer, init,
+      [](xla::XlaOp lhs, xla::XlaOp rhs) { return lhs + rhs; });
 }
 
 xla::Shape NodeOutputShape(const Value& input,
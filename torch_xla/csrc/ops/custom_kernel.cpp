@@ -0,0 +1,67 @@
+#include "torch_xla/csrc/ops/custom_kernel.h"
+
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "torch_xla/csrc/lowering_context.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(const CustomKernel& kernel, OpList operands) {
+  std::vector<xla::Shape> input_shapes;
+  for (auto& operand : operands) {
+    input_shapes.push_back(operand.shape());
+  }
+  return kernel.shape_fn(input_shapes);
+}
+
+size_t GetNumOutputs(const xla::Shape& shape) {
+  return shape.IsTuple() ? shape.tuple_shapes_size() : 1;
+}
+
+}  // namespace
+
+CustomKernelOp::CustomKernelOp(std::shared_ptr<const CustomKernel> kernel,
+                               OpList operands)
+    : CustomKernelOp(kernel, operands, NodeOutputShape(*kernel, operands)) {}
+
+CustomKernelOp::CustomKernelOp(std::shared_ptr<const CustomKernel> kernel,
+                               OpList operands, xla::Shape shape)
+    : Node(OpKind::Get("xla::_kernel_" + kernel->name), operands, shape,
+           GetNumOutputs(shape),
+           xla::util::MHash(kernel->target, kernel->backend_config,
+                            kernel->has_side_effect)),
+      kernel_(std::move(kernel)) {}
+
+NodePtr CustomKernelOp::Clone(OpList operands) const {
+  return MakeNode<CustomKernelOp>(kernel_, operands);
+}
+
+XlaOpVector CustomKernelOp::Lower(LoweringContext* loctx) const {
+  std::vector<xla::XlaOp> inputs;
+  for (auto& op : operands()) {
+    inputs.push_back(loctx->GetOutputOp(op));
+  }
+  xla::XlaOp output =
+      xla::CustomCall(loctx->builder(), kernel_->target, inputs, shape(),
+                      kernel_->backend_config, kernel_->has_side_effect);
+  if (!shape().IsTuple()) {
+    return ReturnOp(output, loctx);
+  }
+  XlaOpVector results;
+  for (xla::int64 i = 0; i < shape().tuple_shapes_size(); ++i) {
+    results.push_back(xla::GetTupleElement(output, i));
+  }
+  return ReturnOps(results, loctx);
+}
+
+std::string CustomKernelOp::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", target=" << kernel_->target;
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
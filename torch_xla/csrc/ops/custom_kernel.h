@@ -0,0 +1,35 @@
+#pragma once
+
+#include <memory>
+
+#include "torch_xla/csrc/custom_kernels.h"
+#include "torch_xla/csrc/ir.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+class CustomKernelOp : public Node {
+ public:
+  CustomKernelOp(std::shared_ptr<const CustomKernel> kernel, OpList operands);
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  std::string ToString() const override;
+
+  const std::shared_ptr<const CustomKernel>& kernel() const { return kernel_; }
+
+ private:
+  // The shape function of the kernel might be expensive (like a Python one),
+  // so it is called only once.
+  CustomKernelOp(std::shared_ptr<const CustomKernel> kernel, OpList operands,
+                 xla::Shape shape);
+
+  std::shared_ptr<const CustomKernel> kernel_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
@@ -0,0 +1,35 @@
+#include "torch_xla/csrc/ops/dropout.h"
+
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "torch_xla/csrc/lowering_context.h"
+#include "torch_xla/csrc/ops/xla_ops.h"
+#include "torch_xla/csrc/xla_lower_util.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+Dropout::Dropout(const Value& input, const Value& seed, double probability)
+    : Node(xla_dropout, {input, seed}, input.shape(),
+           /*num_outputs=*/1, xla::util::MHash(probability)),
+      probability_(probability) {}
+
+NodePtr Dropout::Clone(OpList operands) const {
+  return MakeNode<Dropout>(operands.at(0), operands.at(1), probability_);
+}
+
+XlaOpVector Dropout::Lower(LoweringContext* loctx) const {
+  xla::XlaOp input = loctx->GetOutputOp(operand(0));
+  xla::XlaOp seed = loctx->GetOutputOp(operand(1));
+  return ReturnOp(BuildDropout(input, probability_, seed), loctx);
+}
+
+std::string Dropout::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", probability=" << probability_;
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
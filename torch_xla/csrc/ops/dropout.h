@@ -0,0 +1,30 @@
+#pragma once
+
+#include "torch_xla/csrc/ir.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+// Dropout with a mask drawn from the seed operand. The backward is the same op
+// over the gradient, with the seed of the forward, which regenerates the mask
+// instead of keeping it alive.
+class Dropout : public Node {
+ public:
+  Dropout(const Value& input, const Value& seed, double probability);
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  std::string ToString() const override;
+
+  double probability() const { return probability_; }
+
+ private:
+  double probability_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
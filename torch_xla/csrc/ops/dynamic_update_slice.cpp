@@ -0,0 +1,53 @@
+#include "torch_xla/csrc/ops/dynamic_update_slice.h"
+
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "torch_xla/csrc/data_ops.h"
+#include "torch_xla/csrc/lowering_context.h"
+#include "torch_xla/csrc/ops/infer_output_shape.h"
+#include "torch_xla/csrc/ops/xla_ops.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(const Value& input, const Value& source,
+                           const Value& start, xla::int64 dim) {
+  auto lower_for_shape_fn =
+      [&](absl::Span<const xla::XlaOp> operands) -> xla::XlaOp {
+    return BuildDynamicUpdateSlice(operands[0], operands[1], operands[2], dim);
+  };
+  return InferOutputShape({input.shape(), source.shape(), start.shape()},
+                          lower_for_shape_fn);
+}
+
+}  // namespace
+
+DynamicUpdateSlice::DynamicUpdateSlice(const Value& input, const Value& source,
+                                       const Value& start, xla::int64 dim)
+    : Node(xla_dynamic_update_slice, {input, source, start},
+           [&]() { return NodeOutputShape(input, source, start, dim); },
+           /*num_outputs=*/1, xla::util::MHash(dim)),
+      dim_(dim) {}
+
+NodePtr DynamicUpdateSlice::Clone(OpList operands) const {
+  return MakeNode<DynamicUpdateSlice>(operands.at(0), operands.at(1),
+                                      operands.at(2), dim_);
+}
+
+XlaOpVector DynamicUpdateSlice::Lower(LoweringContext* loctx) const {
+  xla::XlaOp input = loctx->GetOutputOp(operand(0));
+  xla::XlaOp source = loctx->GetOutputOp(operand(1));
+  xla::XlaOp start = loctx->GetOutputOp(operand(2));
+  return ReturnOp(BuildDynamicUpdateSlice(input, source, start, dim_), loctx);
+}
+
+std::string DynamicUpdateSlice::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", dim=" << dim_;
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
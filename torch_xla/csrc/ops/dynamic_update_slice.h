@@ -0,0 +1,31 @@
+#pragma once
+
+#include "torch_xla/csrc/ir.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+// Overwrites the slice of the input starting at the start (scalar integer
+// value) offset along dim, with the source. Unlike UpdateSlice, the offset is
+// a runtime value, so updates at different offsets share the same graph.
+class DynamicUpdateSlice : public Node {
+ public:
+  DynamicUpdateSlice(const Value& input, const Value& source,
+                     const Value& start, xla::int64 dim);
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  std::string ToString() const override;
+
+  xla::int64 dim() const { return dim_; }
+
+ private:
+  xla::int64 dim_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
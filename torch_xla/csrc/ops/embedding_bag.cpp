@@ -0,0 +1,84 @@
+#include "torch_xla/csrc/ops/embedding_bag.h"
+
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "torch_xla/csrc/lowering_context.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(const Value& weight, const Value& indices,
+                           const Value& offsets, bool include_last_offset) {
+  const xla::Shape& weight_shape = weight.shape();
+  const xla::Shape& indices_shape = indices.shape();
+  xla::PrimitiveType index_type = indices_shape.element_type();
+  xla::int64 num_bags = offsets.shape().dimensions(0);
+  if (include_last_offset) {
+    num_bags -= 1;
+  }
+  xla::int64 embedding_dim = weight_shape.dimensions(1);
+  return xla::ShapeUtil::MakeTupleShape(
+      {xla::ShapeUtil::MakeShape(weight_shape.element_type(),
+                                 {num_bags, embedding_dim}),
+       xla::ShapeUtil::MakeShape(index_type, indices_shape.dimensions()),
+       xla::ShapeUtil::MakeShape(index_type, {num_bags}),
+       xla::ShapeUtil::MakeShape(index_type, {num_bags, embedding_dim})});
+}
+
+}  // namespace
+
+EmbeddingBag::EmbeddingBag(const Value& weight, const Value& indices,
+                           const Value& offsets,
+                           const absl::optional<Value>& per_sample_weights,
+                           EmbeddingBagMode mode, bool include_last_offset)
+    : Node(ir::OpKind(at::aten::_embedding_bag),
+           xla::util::GetValuesVector<Value>({weight, indices, offsets},
+                                             {&per_sample_weights}),
+           [&]() {
+             return NodeOutputShape(weight, indices, offsets,
+                                    include_last_offset);
+           },
+           /*num_outputs=*/4,
+           xla::util::MHash(xla::util::GetEnumValue(mode),
+                            include_last_offset)),
+      mode_(mode),
+      include_last_offset_(include_last_offset) {}
+
+NodePtr EmbeddingBag::Clone(OpList operands) const {
+  absl::optional<Value> per_sample_weights;
+  if (operands.size() > 3) {
+    per_sample_weights = operands.at(3);
+  }
+  return MakeNode<EmbeddingBag>(operands.at(0), operands.at(1), operands.at(2),
+                                per_sample_weights, mode_,
+                                include_last_offset_);
+}
+
+XlaOpVector EmbeddingBag::Lower(LoweringContext* loctx) const {
+  xla::XlaOp weight = loctx->GetOutputOp(operand(0));
+  xla::XlaOp indices = loctx->GetOutputOp(operand(1));
+  xla::XlaOp offsets = loctx->GetOutputOp(operand(2));
+  absl::optional<xla::XlaOp> per_sample_weights;
+  if (operands().size() > 3) {
+    per_sample_weights = loctx->GetOutputOp(operand(3));
+  }
+  EmbeddingBagResult result =
+      BuildEmbeddingBag(loctx->device(), weight, indices, offsets,
+                        per_sample_weights, mode_, include_last_offset_);
+  return ReturnOps({result.output, result.offset2bag, result.bag_size,
+                    result.max_indices},
+                   loctx);
+}
+
+std::string EmbeddingBag::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", mode=" << xla::util::GetEnumValue(mode_)
+     << ", include_last_offset=" << include_last_offset_;
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
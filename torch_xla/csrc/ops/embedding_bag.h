@@ -0,0 +1,36 @@
+#pragma once
+
+#include "absl/types/optional.h"
+#include "torch_xla/csrc/embedding_bag.h"
+#include "torch_xla/csrc/ir.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+// Outputs the bag reductions, the offset2bag, the bag_size and the
+// max_indices, in this order.
+class EmbeddingBag : public Node {
+ public:
+  EmbeddingBag(const Value& weight, const Value& indices, const Value& offsets,
+               const absl::optional<Value>& per_sample_weights,
+               EmbeddingBagMode mode, bool include_last_offset);
+
+  std::string ToString() const override;
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  EmbeddingBagMode mode() const { return mode_; }
+
+  bool include_last_offset() const { return include_last_offset_; }
+
+ private:
+  EmbeddingBagMode mode_;
+  bool include_last_offset_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
@@ -0,0 +1,64 @@
+#include "torch_xla/csrc/ops/embedding_bag_backward.h"
+
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "torch_xla/csrc/lowering_context.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+EmbeddingBagBackward::EmbeddingBagBackward(
+    const Value& grad_output, const Value& indices, const Value& offset2bag,
+    const Value& bag_size, const Value& max_indices,
+    const absl::optional<Value>& per_sample_weights, xla::int64 num_weights,
+    bool scale_grad_by_freq, EmbeddingBagMode mode)
+    : Node(ir::OpKind(at::aten::_embedding_bag_dense_backward),
+           xla::util::GetValuesVector<Value>(
+               {grad_output, indices, offset2bag, bag_size, max_indices},
+               {&per_sample_weights}),
+           xla::ShapeUtil::MakeShape(
+               grad_output.shape().element_type(),
+               {num_weights, grad_output.shape().dimensions(1)}),
+           /*num_outputs=*/1,
+           xla::util::MHash(num_weights, scale_grad_by_freq,
+                            xla::util::GetEnumValue(mode))),
+      num_weights_(num_weights),
+      scale_grad_by_freq_(scale_grad_by_freq),
+      mode_(mode) {}
+
+NodePtr EmbeddingBagBackward::Clone(OpList operands) const {
+  absl::optional<Value> per_sample_weights;
+  if (operands.size() > 5) {
+    per_sample_weights = operands.at(5);
+  }
+  return MakeNode<EmbeddingBagBackward>(
+      operands.at(0), operands.at(1), operands.at(2), operands.at(3),
+      operands.at(4), per_sample_weights, num_weights_, scale_grad_by_freq_,
+      mode_);
+}
+
+XlaOpVector EmbeddingBagBackward::Lower(LoweringContext* loctx) const {
+  absl::optional<xla::XlaOp> per_sample_weights;
+  if (operands().size() > 5) {
+    per_sample_weights = loctx->GetOutputOp(operand(5));
+  }
+  xla::XlaOp grad_weight = BuildEmbeddingBagBackward(
+      loctx->device(), loctx->GetOutputOp(operand(0)),
+      loctx->GetOutputOp(operand(1)), loctx->GetOutputOp(operand(2)),
+      loctx->GetOutputOp(operand(3)), loctx->GetOutputOp(operand(4)),
+      per_sample_weights, num_weights_, scale_grad_by_freq_, mode_);
+  return ReturnOp(grad_weight, loctx);
+}
+
+std::string EmbeddingBagBackward::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", num_weights=" << num_weights_
+     << ", scale_grad_by_freq=" << scale_grad_by_freq_
+     << ", mode=" << xla::util::GetEnumValue(mode_);
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
@@ -16,8 +16,9 @@ xla::Shape NodeOutputShape(const Value& input, const Value& index,
                            xla::int64 dim) {
   auto lower_for_shape_fn =
       [&](absl::Span<const xla::XlaOp> operands) -> xla::XlaOp {
-    return xla::TorchGather(operands[0], operands[1], dim,
-                            IsSparseGather(operands[0], operands[1], dim));
+    return xla::TorchGather(
+        operands[0], operands[1], dim,
+        IsSparseGather(operands[0], operands[1], dim, /*device=*/nullptr));
   };
   return InferOutputShape({input.shape(), index.shape()}, lower_for_shape_fn);
 }
@@ -38,7 +39,8 @@ XlaOpVector Gather::Lower(LoweringContext* loctx) const {
   xla::XlaOp input = loctx->GetOutputOp(operand(0));
   xla::XlaOp index = loctx->GetOutputOp(operand(1));
   return ReturnOp(
-      xla::TorchGather(input, index, dim_, IsSparseGather(input, index, dim_)),
+      xla::TorchGather(input, index, dim_,
+                       IsSparseGather(input, index, dim_, &loctx->device())),
       loctx);
 }
 
@@ -16,6 +16,9 @@
 #include "torch_xla/csrc/ops/ops.h"
 #include "torch_xla/csrc/ops/permute.h"
 #include "torch_xla/csrc/ops/scalar.h"
+#include "torch_xla/csrc/ops/select.h"
+#include "torch_xla/csrc/ops/unique_indices.h"
+#include "torch_xla/csrc/ops/xla_ops.h"
 #include "torch_xla/csrc/xla_lower_util.h"
 
 namespace torch_xla {
@@ -145,6 +148,77 @@ std::vector<XLATensor> WrapIndicesOnce(const XLATensor& base,
   return canonical_indices;
 }
 
+struct IndexOrdering {
+  bool sorted = false;
+  bool unique = false;
+};
+
+// Returns the nonzero() node whose column the index has been selected from,
+// and stores the column number within column, or returns nullptr.
+const ir::Node* GetNonzeroColumn(const ir::Value& index, xla::int64* column) {
+  const ir::Node* node = index.node.get();
+  if (node->op() == ir::OpKind(at::aten::view)) {
+    node = node->operand(0).node;
+  }
+  const ir::ops::Select* select =
+      ir::NodeCast<ir::ops::Select>(node, ir::ops::xla_select);
+  if (select == nullptr || select->dim() != 1 ||
+      select->end() != select->start() + 1) {
+    return nullptr;
+  }
+  const ir::Output& source = select->operand(0);
+  if (source.node->op() != ir::OpKind(at::aten::nonzero) || source.index != 0) {
+    return nullptr;
+  }
+  *column = select->start();
+  return source.node;
+}
+
+// Returns what is known about the index tuples addressed by the indices. The
+// rows of a nonzero() result (like the indices a boolean mask expands to) are
+// unique, provided all of its columns are used. Otherwise the indices are
+// unique if one of them has been marked with the UniqueIndices op, and none
+// of them gets broadcasted.
+IndexOrdering GetIndexOrdering(absl::Span<const XLATensor> indices) {
+  IndexOrdering ordering;
+  std::vector<ir::Value> index_values;
+  for (auto& index : indices) {
+    index_values.push_back(index.GetIrValue());
+  }
+  const ir::Node* nonzero = nullptr;
+  for (size_t i = 0; i < index_values.size(); ++i) {
+    xla::int64 column = -1;
+    const ir::Node* source = GetNonzeroColumn(index_values[i], &column);
+    if (source == nullptr || column != static_cast<xla::int64>(i) ||
+        (nonzero != nullptr && source != nonzero)) {
+      nonzero = nullptr;
+      break;
+    }
+    nonzero = source;
+  }
+  if (nonzero != nullptr && nonzero->shape(0).dimensions(1) ==
+                                static_cast<xla::int64>(index_values.size())) {
+    ordering.unique = true;
+    return ordering;
+  }
+  for (auto& index_value : index_values) {
+    if (!xla::ShapeUtil::Compatible(index_value.shape(),
+                                    index_values.front().shape())) {
+      return ordering;
+    }
+  }
+  for (auto& index_value : index_values) {
+    const ir::ops::UniqueIndices* marker =
+        ir::NodeCast<ir::ops::UniqueIndices>(index_value.node.get(),
+                                             ir::ops::xla_unique_indices);
+    if (marker != nullptr) {
+      ordering.unique = true;
+      ordering.sorted = marker->sorted() && index_values.size() == 1;
+    }
+  }
+  return ordering;
+}
+
 ir::NodePtr IndexFillOp(const ir::Value& buffer, xla::int64 dim,
                         const ir::Value& index, const ir::Value& value) {
   auto lower_fn = [dim](const ir::Node& node,
@@ -177,12 +251,14 @@ ir::NodePtr IndexAddOp(const ir::Value& buffer, xla::int64 dim,
     xla::XlaOp xla_base = loctx->GetOutputOp(node.operand(0));
     xla::XlaOp xla_index = loctx->GetOutputOp(node.operand(1));
     xla::XlaOp xla_source = loctx->GetOutputOp(node.operand(2));
-    return node.ReturnOp(CreateIndexAdd(xla_base, dim, xla_index, xla_source),
-                         loctx);
+    return node.ReturnOp(
+        CreateIndexAdd(loctx->device(), xla_base, dim, xla_index, xla_source),
+        loctx);
   };
   auto lower_for_shape_fn =
       [dim](absl::Span<const xla::XlaOp> operands) -> xla::XlaOp {
-    return CreateIndexAdd(operands[0], dim, operands[1], operands[2]);
+    return CreateIndexAdd(GetCurrentDevice(), operands[0], dim, operands[1],
+                          operands[2]);
   };
   ir::Value index_rank1 = EnsureRank1(index);
   return ir::ops::GenericOp(
@@ -273,15 +349,16 @@ ir::Value IndexPutByTensors(const XLATensor& base,
   if (indices.empty()) {
     return base.GetIrValue();
   }
+  IndexOrdering ordering = GetIndexOrdering(indices);
   auto canonical_indices = WrapIndicesOnce(base, indices, start_dim);
   xla::int64 indices_rank = canonical_indices.front().shape().get().rank();
   // Stack the indices to allow the whole multi-indexing to be dispatched with a
   // single scatter.
   XLATensor indices_nd = XLATensor::stack(canonical_indices, indices_rank);
   return ir::MakeNode<ir::ops::Permute>(
-      ir::MakeNode<ir::ops::IndexPut>(base.GetIrValue(),
-                                      indices_nd.GetIrValue(), start_dim,
-                                      values.GetIrValue(), accumulate),
+      ir::MakeNode<ir::ops::IndexPut>(
+          base.GetIrValue(), indices_nd.GetIrValue(), start_dim,
+          values.GetIrValue(), accumulate, ordering.sorted, ordering.unique),
       xla::util::ToVector<xla::int64>(result_permutation));
 }
 
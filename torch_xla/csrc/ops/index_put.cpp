@@ -10,22 +10,30 @@ namespace ops {
 
 IndexPut::IndexPut(const ir::Value& base, const ir::Value& indices,
                    xla::int64 start_dim, const ir::Value& values,
-                   bool accumulate)
+                   bool accumulate, bool indices_are_sorted,
+                   bool unique_indices)
     : Node(OpKind(at::aten::index_put), {base, indices, values}, base.shape(),
-           /*num_outputs=*/1, xla::util::MHash(start_dim, accumulate)),
+           /*num_outputs=*/1,
+           xla::util::MHash(start_dim, accumulate, indices_are_sorted,
+                            unique_indices)),
       start_dim_(start_dim),
-      accumulate_(accumulate) {}
+      accumulate_(accumulate),
+      indices_are_sorted_(indices_are_sorted),
+      unique_indices_(unique_indices) {}
 
 std::string IndexPut::ToString() const {
   std::stringstream ss;
   ss << Node::ToString() << ", start_dim=" << start_dim_
-     << ", accumulate=" << accumulate_;
+     << ", accumulate=" << accumulate_
+     << ", indices_are_sorted=" << indices_are_sorted_
+     << ", unique_indices=" << unique_indices_;
   return ss.str();
 }
 
 NodePtr IndexPut::Clone(OpList operands) const {
   return MakeNode<IndexPut>(operands.at(0), operands.at(1), start_dim_,
-                            operands.at(2), accumulate_);
+                            operands.at(2), accumulate_, indices_are_sorted_,
+                            unique_indices_);
 }
 
 XlaOpVector IndexPut::Lower(LoweringContext* loctx) const {
@@ -35,9 +43,10 @@ XlaOpVector IndexPut::Lower(LoweringContext* loctx) const {
   xla::XlaOp base = loctx->GetOutputOp(operand(0));
   xla::XlaOp indices = loctx->GetOutputOp(operand(1));
   xla::XlaOp values = loctx->GetOutputOp(operand(2));
-  xla::XlaOp output =
-      CreateIndexUpdate(base, indices, start_dim_, values,
-                        accumulate_ ? add_scatter_combiner : nullptr);
+  xla::XlaOp output = CreateIndexUpdate(
+      base, indices, start_dim_, values,
+      accumulate_ ? add_scatter_combiner : nullptr, indices_are_sorted_,
+      unique_indices_);
   return ReturnOp(output, loctx);
 }
 
@@ -9,7 +9,8 @@ namespace ops {
 class IndexPut : public Node {
  public:
   IndexPut(const ir::Value& base, const ir::Value& indices,
-           xla::int64 start_dim, const ir::Value& values, bool accumulate);
+           xla::int64 start_dim, const ir::Value& values, bool accumulate,
+           bool indices_are_sorted = false, bool unique_indices = false);
 
   std::string ToString() const override;
 
@@ -21,11 +22,19 @@ class IndexPut : public Node {
 
   bool accumulate() const { return accumulate_; }
 
+  bool indices_are_sorted() const { return indices_are_sorted_; }
+
+  bool unique_indices() const { return unique_indices_; }
+
  private:
   // The dimension number at which indexing starts.
   xla::int64 start_dim_;
   // Whether to accumulate instead of set.
   bool accumulate_;
+  // Whether the index tuples are known to be sorted, or unique, which lets
+  // the scatter updates run in parallel.
+  bool indices_are_sorted_;
+  bool unique_indices_;
 };
 
 }  // namespace ops
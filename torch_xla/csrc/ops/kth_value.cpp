@@ -14,8 +14,9 @@ xla::Shape NodeOutputShape(const Value& input, xla::int64 k, xla::int64 dim,
                            bool keepdim) {
   auto lower_for_shape_fn =
       [&](absl::Span<const xla::XlaOp> operands) -> xla::XlaOp {
-    return xla::Tuple(operands[0].builder(),
-                      CreateKthValue(operands[0], k, dim, keepdim));
+    return xla::Tuple(
+        operands[0].builder(),
+        CreateKthValue(GetCurrentDevice(), operands[0], k, dim, keepdim));
   };
   return InferOutputShape({input.shape()}, lower_for_shape_fn);
 }
@@ -37,7 +38,8 @@ NodePtr KthValue::Clone(OpList operands) const {
 
 XlaOpVector KthValue::Lower(LoweringContext* loctx) const {
   xla::XlaOp input = loctx->GetOutputOp(operand(0));
-  return ReturnOps(CreateKthValue(input, k_, dim_, keepdim_), loctx);
+  return ReturnOps(
+      CreateKthValue(loctx->device(), input, k_, dim_, keepdim_), loctx);
 }
 
 std::string KthValue::ToString() const {
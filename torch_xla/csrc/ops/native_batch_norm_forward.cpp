@@ -14,11 +14,12 @@ namespace {
 std::vector<xla::XlaOp> LowerBatchNorm(xla::XlaOp input, xla::XlaOp weight,
                                        xla::XlaOp bias, xla::XlaOp running_mean,
                                        xla::XlaOp running_var, bool training,
-                                       double eps) {
+                                       double eps,
+                                       xla::int64 feature_index = 1) {
   std::vector<xla::XlaOp> values;
   if (training) {
     BatchNormOutput batch_norm_output =
-        BuildBatchNormTraining(input, weight, bias, eps);
+        BuildBatchNormTraining(input, weight, bias, eps, feature_index);
     values.push_back(std::move(batch_norm_output.output));
     values.push_back(std::move(batch_norm_output.batch_mean));
     values.push_back(batch_norm_output.batch_variance);
@@ -26,7 +27,7 @@ std::vector<xla::XlaOp> LowerBatchNorm(xla::XlaOp input, xla::XlaOp weight,
         BatchNormVarianceInvert(batch_norm_output.batch_variance, eps));
   } else {
     values.push_back(BuildBatchNormInference(input, weight, bias, running_mean,
-                                             running_var, eps));
+                                             running_var, eps, feature_index));
     values.push_back(running_mean);
     values.push_back(running_var);
     values.push_back(BatchNormVarianceInvert(running_var, eps));
@@ -79,6 +80,22 @@ XlaOpVector NativeBatchNormForward::Lower(LoweringContext* loctx) const {
   xla::XlaOp bias = loctx->GetOutputOp(operand(2));
   xla::XlaOp running_mean = loctx->GetOutputOp(operand(3));
   xla::XlaOp running_var = loctx->GetOutputOp(operand(4));
+  if (loctx->ChannelsLastEnabled() &&
+      loctx->HasOutputOpChannelsLast(operand(0))) {
+    // Only the normalized output has the input layout, the statistics are
+    // per feature vectors.
+    std::vector<xla::XlaOp> values = LowerBatchNorm(
+        loctx->GetOutputOpChannelsLast(operand(0)), weight, bias, running_mean,
+        running_var, training_, eps_,
+        /*feature_index=*/operand(0).shape().rank() - 1);
+    loctx->AssignOutputOpChannelsLast(Output(this, 0), values[0]);
+    XlaOpVector result_ops = {loctx->GetOutputOp(Output(this, 0))};
+    for (size_t i = 1; i < values.size(); ++i) {
+      loctx->AssignOutputOp(Output(this, i), values[i]);
+      result_ops.push_back(values[i]);
+    }
+    return result_ops;
+  }
 
   return ReturnOps(LowerBatchNorm(input, weight, bias, running_mean,
                                   running_var, training_, eps_),
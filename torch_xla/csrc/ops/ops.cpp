@@ -347,6 +347,30 @@ NodePtr AdaptiveAvgPool2dBackward(const Value& grad_output,
       std::move(lower_fn));
 }
 
+NodePtr AdaptiveAvgPool3dBackward(const Value& grad_output,
+                                  const Value& input) {
+  auto lower_fn = [](const Node& node, LoweringContext* loctx) -> XlaOpVector {
+    xla::XlaOp grad_output = loctx->GetOutputOp(node.operand(0));
+    xla::XlaOp input = loctx->GetOutputOp(node.operand(1));
+    xla::XlaOp xla_output = BuildAdaptiveAvgPool3dBackward(
+        /*out_backprop=*/grad_output, /*input=*/input);
+    return node.ReturnOp(xla_output, loctx);
+  };
+  auto lower_for_shape_fn =
+      [](absl::Span<const xla::XlaOp> operands) -> xla::XlaOp {
+    XLA_CHECK_EQ(operands.size(), 2);
+    return BuildAdaptiveAvgPool3dBackward(/*out_backprop=*/operands[0],
+                                          /*input=*/operands[1]);
+  };
+  return GenericOp(
+      OpKind(at::aten::adaptive_avg_pool3d_backward), {grad_output, input},
+      [&]() {
+        return InferOutputShape({grad_output.shape(), input.shape()},
+                                lower_for_shape_fn);
+      },
+      std::move(lower_fn));
+}
+
 NodePtr ComparisonOp(c10::Symbol kind, const Value& input, const Value& other) {
   auto lower_fn = [kind](const Node& node,
                          LoweringContext* loctx) -> XlaOpVector {
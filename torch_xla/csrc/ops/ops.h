@@ -148,6 +148,8 @@ NodePtr MatMul(const Value& lhs, const Value& rhs);
 
 NodePtr AdaptiveAvgPool2dBackward(const Value& grad_output, const Value& input);
 
+NodePtr AdaptiveAvgPool3dBackward(const Value& grad_output, const Value& input);
+
 NodePtr ComparisonOp(c10::Symbol kind, const Value& input, const Value& other);
 
 NodePtr Where(const Value& condition, const Value& input, const Value& other);
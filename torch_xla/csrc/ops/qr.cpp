@@ -7,6 +7,7 @@
 #include "torch_xla/csrc/data_ops.h"
 #include "torch_xla/csrc/helpers.h"
 #include "torch_xla/csrc/lowering_context.h"
+#include "torch_xla/csrc/matrix.h"
 
 namespace torch_xla {
 namespace ir {
@@ -14,6 +15,12 @@ namespace ops {
 namespace {
 
 std::vector<xla::XlaOp> LowerQR(xla::XlaOp input, bool some) {
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  if (UseSmallMatrixLowering(
+          std::max(input_shape.dimensions(input_shape.rank() - 2),
+                   input_shape.dimensions(input_shape.rank() - 1)))) {
+    return BuildSmallQR(input, /*full_matrices=*/!some);
+  }
   xla::QRDecompositionResult qr_result =
       xla::QRDecomposition(input, /*full_matrices=*/!some,
                            /*block_size=*/128, XlaHelpers::mat_mul_precision())
@@ -0,0 +1,119 @@
+#include "torch_xla/csrc/ops/quantized_convolution.h"
+
+#include "absl/strings/str_join.h"
+#include "tensorflow/compiler/xla/primitive_util.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "torch_xla/csrc/lowering_context.h"
+#include "torch_xla/csrc/ops/infer_output_shape.h"
+#include "torch_xla/csrc/ops/xla_ops.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(
+    const Value& input, const Value& weight, const Value& weight_scale,
+    const Value& weight_zero_point, const absl::optional<Value>& bias,
+    absl::Span<const xla::int64> stride, absl::Span<const xla::int64> padding,
+    absl::Span<const xla::int64> dilation, xla::int64 groups,
+    const absl::optional<QuantizationParams>& input_params,
+    const absl::optional<QuantizationParams>& output_params,
+    xla::PrimitiveType output_type) {
+  auto shape_fn = [&](absl::Span<const xla::XlaOp> operands) -> xla::XlaOp {
+    absl::optional<xla::XlaOp> bias;
+    if (operands.size() > 4) {
+      bias = operands[4];
+    }
+    return BuildQuantizedConvolution(
+        operands[0], operands[1], operands[2], operands[3], bias, stride,
+        padding, dilation, groups, input_params, output_params, output_type);
+  };
+  std::vector<xla::Shape> shapes;
+  for (auto& operand : xla::util::GetValuesVector<Value>(
+           {input, weight, weight_scale, weight_zero_point}, {&bias})) {
+    shapes.push_back(operand.shape());
+  }
+  return InferOutputShape(shapes, shape_fn);
+}
+
+}  // namespace
+
+QuantizedConvolution::QuantizedConvolution(
+    const Value& input, const Value& weight, const Value& weight_scale,
+    const Value& weight_zero_point, const absl::optional<Value>& bias,
+    std::vector<xla::int64> stride, std::vector<xla::int64> padding,
+    std::vector<xla::int64> dilation, xla::int64 groups,
+    absl::optional<QuantizationParams> input_params,
+    absl::optional<QuantizationParams> output_params,
+    xla::PrimitiveType output_type)
+    : Node(xla_quantized_convolution,
+           xla::util::GetValuesVector<Value>(
+               {input, weight, weight_scale, weight_zero_point}, {&bias}),
+           [&]() {
+             return NodeOutputShape(input, weight, weight_scale,
+                                    weight_zero_point, bias, stride, padding,
+                                    dilation, groups, input_params,
+                                    output_params, output_type);
+           },
+           /*num_outputs=*/1,
+           xla::util::MHash(stride, padding, dilation, groups,
+                            QuantizationParamsHash(input_params),
+                            QuantizationParamsHash(output_params),
+                            static_cast<int>(output_type))),
+      stride_(std::move(stride)),
+      padding_(std::move(padding)),
+      dilation_(std::move(dilation)),
+      groups_(groups),
+      input_params_(std::move(input_params)),
+      output_params_(std::move(output_params)),
+      output_type_(output_type) {}
+
+NodePtr QuantizedConvolution::Clone(OpList operands) const {
+  absl::optional<Value> bias;
+  if (operands.size() > 4) {
+    bias = operands.at(4);
+  }
+  return MakeNode<QuantizedConvolution>(
+      operands.at(0), operands.at(1), operands.at(2), operands.at(3), bias,
+      stride_, padding_, dilation_, groups_, input_params_, output_params_,
+      output_type_);
+}
+
+XlaOpVector QuantizedConvolution::Lower(LoweringContext* loctx) const {
+  xla::XlaOp input = loctx->GetOutputOp(operand(0));
+  xla::XlaOp weight = loctx->GetOutputOp(operand(1));
+  xla::XlaOp weight_scale = loctx->GetOutputOp(operand(2));
+  xla::XlaOp weight_zero_point = loctx->GetOutputOp(operand(3));
+  absl::optional<xla::XlaOp> bias;
+  if (operands().size() > 4) {
+    bias = loctx->GetOutputOp(operand(4));
+  }
+  return ReturnOp(BuildQuantizedConvolution(
+                      input, weight, weight_scale, weight_zero_point, bias,
+                      stride_, padding_, dilation_, groups_, input_params_,
+                      output_params_, output_type_),
+                  loctx);
+}
+
+std::string QuantizedConvolution::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", stride=(" << absl::StrJoin(stride_, ", ")
+     << "), padding=(" << absl::StrJoin(padding_, ", ") << "), dilation=("
+     << absl::StrJoin(dilation_, ", ") << "), groups=" << groups_;
+  if (input_params_) {
+    ss << ", input_scale=" << input_params_->scale
+       << ", input_zero_point=" << input_params_->zero_point;
+  }
+  if (output_params_) {
+    ss << ", output_scale=" << output_params_->scale
+       << ", output_zero_point=" << output_params_->zero_point
+       << ", output_type="
+       << xla::primitive_util::LowercasePrimitiveTypeName(output_type_);
+  }
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "absl/types/optional.h"
+#include "torch_xla/csrc/ir.h"
+#include "torch_xla/csrc/quantization.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+// Convolution of the input with the int8 quantized weight. See
+// BuildQuantizedConvolution() for the meaning of the quantization parameters.
+class QuantizedConvolution : public Node {
+ public:
+  QuantizedConvolution(const Value& input, const Value& weight,
+                       const Value& weight_scale,
+                       const Value& weight_zero_point,
+                       const absl::optional<Value>& bias,
+                       std::vector<xla::int64> stride,
+                       std::vector<xla::int64> padding,
+                       std::vector<xla::int64> dilation, xla::int64 groups,
+                       absl::optional<QuantizationParams> input_params,
+                       absl::optional<QuantizationParams> output_params,
+                       xla::PrimitiveType output_type);
+
+  std::string ToString() const override;
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  const std::vector<xla::int64>& stride() const { return stride_; }
+
+  const std::vector<xla::int64>& padding() const { return padding_; }
+
+  const std::vector<xla::int64>& dilation() const { return dilation_; }
+
+  xla::int64 groups() const { return groups_; }
+
+  const absl::optional<QuantizationParams>& input_params() const {
+    return input_params_;
+  }
+
+  const absl::optional<QuantizationParams>& output_params() const {
+    return output_params_;
+  }
+
+  xla::PrimitiveType output_type() const { return output_type_; }
+
+ private:
+  std::vector<xla::int64> stride_;
+  std::vector<xla::int64> padding_;
+  std::vector<xla::int64> dilation_;
+  xla::int64 groups_;
+  absl::optional<QuantizationParams> input_params_;
+  absl::optional<QuantizationParams> output_params_;
+  xla::PrimitiveType output_type_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
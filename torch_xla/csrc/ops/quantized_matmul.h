@@ -0,0 +1,46 @@
+#pragma once
+
+#include "absl/types/optional.h"
+#include "torch_xla/csrc/ir.h"
+#include "torch_xla/csrc/quantization.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+// Matmul of the input with the int8 quantized weight. See
+// BuildQuantizedMatMul() for the meaning of the quantization parameters.
+class QuantizedMatMul : public Node {
+ public:
+  QuantizedMatMul(const Value& input, const Value& weight,
+                  const Value& weight_scale, const Value& weight_zero_point,
+                  const absl::optional<Value>& bias,
+                  absl::optional<QuantizationParams> input_params,
+                  absl::optional<QuantizationParams> output_params,
+                  xla::PrimitiveType output_type);
+
+  std::string ToString() const override;
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  const absl::optional<QuantizationParams>& input_params() const {
+    return input_params_;
+  }
+
+  const absl::optional<QuantizationParams>& output_params() const {
+    return output_params_;
+  }
+
+  xla::PrimitiveType output_type() const { return output_type_; }
+
+ private:
+  absl::optional<QuantizationParams> input_params_;
+  absl::optional<QuantizationParams> output_params_;
+  xla::PrimitiveType output_type_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "absl/types/optional.h"
+#include "torch_xla/csrc/cross_replica_reduces.h"
+#include "torch_xla/csrc/ir.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+// Matmul with the input features shard of the weight, followed by the
+// all-reduce (or reduce-scatter) of the partial results of the replicas.
+class RowParallelMatMul : public Node {
+ public:
+  RowParallelMatMul(const Value& input, const Value& weight,
+                    const absl::optional<Value>& bias, const Value& token,
+                    bool scatter_output, xla::int64 shard_count,
+                    xla::int64 num_chunks,
+                    std::vector<std::vector<xla::int64>> groups);
+
+  std::string ToString() const override;
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  bool scatter_output() const { return scatter_output_; }
+
+  xla::int64 shard_count() const { return shard_count_; }
+
+  xla::int64 num_chunks() const { return num_chunks_; }
+
+  const std::vector<std::vector<xla::int64>>& groups() const { return groups_; }
+
+ private:
+  bool scatter_output_;
+  xla::int64 shard_count_;
+  xla::int64 num_chunks_;
+  std::vector<std::vector<xla::int64>> groups_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
@@ -0,0 +1,65 @@
+#include "torch_xla/csrc/ops/scaled_dot_product_attention.h"
+
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "torch_xla/csrc/attention_op.h"
+#include "torch_xla/csrc/lowering_context.h"
+#include "torch_xla/csrc/ops/infer_output_shape.h"
+#include "torch_xla/csrc/ops/xla_ops.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(const Value& query, const Value& key,
+                           const Value& value, double scale,
+                           xla::int64 block_size) {
+  auto shape_fn = [&](absl::Span<const xla::XlaOp> operands) -> xla::XlaOp {
+    AttentionResult result = BuildScaledDotProductAttention(
+        operands[0], operands[1], operands[2], scale, block_size);
+    return xla::Tuple(result.output.builder(),
+                      {result.output, result.logsumexp});
+  };
+  return InferOutputShape({query.shape(), key.shape(), value.shape()},
+                          shape_fn);
+}
+
+}  // namespace
+
+ScaledDotProductAttention::ScaledDotProductAttention(const Value& query,
+                                                     const Value& key,
+                                                     const Value& value,
+                                                     double scale,
+                                                     xla::int64 block_size)
+    : Node(xla_scaled_dot_product_attention, {query, key, value},
+           [&]() {
+             return NodeOutputShape(query, key, value, scale, block_size);
+           },
+           /*num_outputs=*/2, xla::util::MHash(scale, block_size)),
+      scale_(scale),
+      block_size_(block_size) {}
+
+NodePtr ScaledDotProductAttention::Clone(OpList operands) const {
+  return MakeNode<ScaledDotProductAttention>(
+      operands.at(0), operands.at(1), operands.at(2), scale_, block_size_);
+}
+
+XlaOpVector ScaledDotProductAttention::Lower(LoweringContext* loctx) const {
+  xla::XlaOp query = loctx->GetOutputOp(operand(0));
+  xla::XlaOp key = loctx->GetOutputOp(operand(1));
+  xla::XlaOp value = loctx->GetOutputOp(operand(2));
+  AttentionResult result =
+      BuildScaledDotProductAttention(query, key, value, scale_, block_size_);
+  return ReturnOps({result.output, result.logsumexp}, loctx);
+}
+
+std::string ScaledDotProductAttention::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", scale=" << scale_
+     << ", block_size=" << block_size_;
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
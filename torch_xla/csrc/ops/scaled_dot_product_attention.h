@@ -0,0 +1,34 @@
+#pragma once
+
+#include "torch_xla/csrc/ir.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+// Fused attention, with the attention output and the per query logsumexp of
+// the scores (needed by the backward) as outputs.
+class ScaledDotProductAttention : public Node {
+ public:
+  ScaledDotProductAttention(const Value& query, const Value& key,
+                            const Value& value, double scale,
+                            xla::int64 block_size);
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  std::string ToString() const override;
+
+  double scale() const { return scale_; }
+
+  xla::int64 block_size() const { return block_size_; }
+
+ private:
+  double scale_;
+  xla::int64 block_size_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
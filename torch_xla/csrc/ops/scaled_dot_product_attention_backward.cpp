@@ -0,0 +1,54 @@
+#include "torch_xla/csrc/ops/scaled_dot_product_attention_backward.h"
+
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "torch_xla/csrc/attention_op.h"
+#include "torch_xla/csrc/lowering_context.h"
+#include "torch_xla/csrc/ops/xla_ops.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+ScaledDotProductAttentionBackward::ScaledDotProductAttentionBackward(
+    const Value& grad_output, const Value& query, const Value& key,
+    const Value& value, const Value& output, const Value& logsumexp,
+    double scale, xla::int64 block_size)
+    : Node(xla_scaled_dot_product_attention_backward,
+           {grad_output, query, key, value, output, logsumexp},
+           xla::ShapeUtil::MakeTupleShape(
+               {query.shape(), key.shape(), value.shape()}),
+           /*num_outputs=*/3, xla::util::MHash(scale, block_size)),
+      scale_(scale),
+      block_size_(block_size) {}
+
+NodePtr ScaledDotProductAttentionBackward::Clone(OpList operands) const {
+  return MakeNode<ScaledDotProductAttentionBackward>(
+      operands.at(0), operands.at(1), operands.at(2), operands.at(3),
+      operands.at(4), operands.at(5), scale_, block_size_);
+}
+
+XlaOpVector ScaledDotProductAttentionBackward::Lower(
+    LoweringContext* loctx) const {
+  xla::XlaOp grad_output = loctx->GetOutputOp(operand(0));
+  xla::XlaOp query = loctx->GetOutputOp(operand(1));
+  xla::XlaOp key = loctx->GetOutputOp(operand(2));
+  xla::XlaOp value = loctx->GetOutputOp(operand(3));
+  xla::XlaOp output = loctx->GetOutputOp(operand(4));
+  xla::XlaOp logsumexp = loctx->GetOutputOp(operand(5));
+  AttentionGradResult result = BuildScaledDotProductAttentionBackward(
+      grad_output, query, key, value, output, logsumexp, scale_, block_size_);
+  return ReturnOps({result.grad_query, result.grad_key, result.grad_value},
+                   loctx);
+}
+
+std::string ScaledDotProductAttentionBackward::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", scale=" << scale_
+     << ", block_size=" << block_size_;
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
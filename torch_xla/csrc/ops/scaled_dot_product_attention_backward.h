@@ -0,0 +1,36 @@
+#pragma once
+
+#include "torch_xla/csrc/ir.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+// The gradients of the fused attention with respect to the query, key and
+// value inputs.
+class ScaledDotProductAttentionBackward : public Node {
+ public:
+  ScaledDotProductAttentionBackward(const Value& grad_output,
+                                    const Value& query, const Value& key,
+                                    const Value& value, const Value& output,
+                                    const Value& logsumexp, double scale,
+                                    xla::int64 block_size);
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  std::string ToString() const override;
+
+  double scale() const { return scale_; }
+
+  xla::int64 block_size() const { return block_size_; }
+
+ private:
+  double scale_;
+  xla::int64 block_size_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
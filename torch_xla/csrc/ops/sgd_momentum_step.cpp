@@ -0,0 +1,95 @@
+#include "torch_xla/csrc/ops/sgd_momentum_step.h"
+
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "torch_xla/csrc/lowering_context.h"
+#include "torch_xla/csrc/optimizer_ops.h"
+#include "torch_xla/csrc/ops/xla_ops.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(absl::Span<const Value> params) {
+  std::vector<xla::Shape> tuple_shapes;
+  tuple_shapes.reserve(params.size() * 2);
+  for (size_t i = 0; i < 2; ++i) {
+    for (auto& param : params) {
+      tuple_shapes.push_back(param.shape());
+    }
+  }
+  return xla::ShapeUtil::MakeTupleShape(tuple_shapes);
+}
+
+std::vector<Value> GetOperandList(absl::Span<const Value> params,
+                                  absl::Span<const Value> grads,
+                                  absl::Span<const Value> momentum_buffers,
+                                  const Value& lr) {
+  XLA_CHECK_EQ(params.size(), grads.size());
+  XLA_CHECK_EQ(params.size(), momentum_buffers.size());
+  std::vector<Value> operand_list;
+  operand_list.reserve(params.size() * 3 + 1);
+  for (auto values : {params, grads, momentum_buffers}) {
+    operand_list.insert(operand_list.end(), values.begin(), values.end());
+  }
+  operand_list.push_back(lr);
+  return operand_list;
+}
+
+}  // namespace
+
+SgdMomentumStep::SgdMomentumStep(absl::Span<const Value> params,
+                                 absl::Span<const Value> grads,
+                                 absl::Span<const Value> momentum_buffers,
+                                 const Value& lr, double momentum,
+                                 double dampening, double weight_decay,
+                                 bool nesterov, bool init_momentum_buffers)
+    : Node(xla_sgd_momentum_step,
+           GetOperandList(params, grads, momentum_buffers, lr),
+           [&]() { return NodeOutputShape(params); },
+           /*num_outputs=*/params.size() * 2,
+           xla::util::MHash(momentum, dampening, weight_decay, nesterov,
+                            init_momentum_buffers)),
+      momentum_(momentum),
+      dampening_(dampening),
+      weight_decay_(weight_decay),
+      nesterov_(nesterov),
+      init_momentum_buffers_(init_momentum_buffers) {}
+
+NodePtr SgdMomentumStep::Clone(OpList operands) const {
+  size_t count = (operands.size() - 1) / 3;
+  return MakeNode<SgdMomentumStep>(
+      operands.subspan(0, count), operands.subspan(count, count),
+      operands.subspan(2 * count, count), operands.at(3 * count), momentum_,
+      dampening_, weight_decay_, nesterov_, init_momentum_buffers_);
+}
+
+XlaOpVector SgdMomentumStep::Lower(LoweringContext* loctx) const {
+  size_t count = (operands().size() - 1) / 3;
+  xla::XlaOp lr = loctx->GetOutputOp(operand(3 * count));
+  std::vector<xla::XlaOp> results(count * 2);
+  for (size_t i = 0; i < count; ++i) {
+    SgdMomentumStepResult result = BuildSgdMomentumStep(
+        loctx->GetOutputOp(operand(i)), loctx->GetOutputOp(operand(count + i)),
+        loctx->GetOutputOp(operand(2 * count + i)), lr, momentum_, dampening_,
+        weight_decay_, nesterov_, init_momentum_buffers_);
+    results[i] = result.param;
+    results[count + i] = result.momentum_buffer;
+  }
+  return ReturnOps(results, loctx);
+}
+
+std::string SgdMomentumStep::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", momentum=" << momentum_
+     << ", dampening=" << dampening_ << ", weight_decay=" << weight_decay_
+     << ", nesterov=" << nesterov_
+     << ", init_momentum_buffers=" << init_momentum_buffers_;
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "torch_xla/csrc/ir.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+// Applies the SGD with momentum update to a whole group of parameters, within
+// a single IR node. The outputs are the new params and momentum buffers, in
+// this order, each one of them as many as the input parameters.
+class SgdMomentumStep : public Node {
+ public:
+  SgdMomentumStep(absl::Span<const Value> params,
+                  absl::Span<const Value> grads,
+                  absl::Span<const Value> momentum_buffers, const Value& lr,
+                  double momentum, double dampening, double weight_decay,
+                  bool nesterov, bool init_momentum_buffers);
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  std::string ToString() const override;
+
+  double momentum() const { return momentum_; }
+
+  double dampening() const { return dampening_; }
+
+  double weight_decay() const { return weight_decay_; }
+
+  bool nesterov() const { return nesterov_; }
+
+  bool init_momentum_buffers() const { return init_momentum_buffers_; }
+
+ private:
+  double momentum_;
+  double dampening_;
+  double weight_decay_;
+  bool nesterov_;
+  bool init_momentum_buffers_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
@@ -0,0 +1,72 @@
+#include "torch_xla/csrc/ops/sync_batch_norm.h"
+
+#include "absl/strings/str_join.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "torch_xla/csrc/batch_norm.h"
+#include "torch_xla/csrc/lowering_context.h"
+#include "torch_xla/csrc/ops/infer_output_shape.h"
+#include "torch_xla/csrc/ops/xla_ops.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(const Value& input, const Value& weight,
+                           const Value& bias, const Value& token,
+                           const std::vector<std::vector<xla::int64>>& groups) {
+  auto shape_fn = [&](absl::Span<const xla::XlaOp> operands) -> xla::XlaOp {
+    SyncBatchNormOutput result = BuildSyncBatchNormTraining(
+        operands[0], operands[1], operands[2], operands[3], 0.5, groups);
+    return xla::Tuple(operands[0].builder(),
+                      {result.output, result.mean, result.invstd, result.count,
+                       result.token});
+  };
+  return InferOutputShape(
+      {input.shape(), weight.shape(), bias.shape(), token.shape()}, shape_fn);
+}
+
+}  // namespace
+
+SyncBatchNorm::SyncBatchNorm(const Value& input, const Value& weight,
+                             const Value& bias, const Value& token, double eps,
+                             std::vector<std::vector<xla::int64>> groups)
+    : Node(xla_sync_batch_norm, {input, weight, bias, token},
+           [&]() {
+             return NodeOutputShape(input, weight, bias, token, groups);
+           },
+           /*num_outputs=*/5, xla::util::MHash(eps, groups)),
+      eps_(eps),
+      groups_(std::move(groups)) {}
+
+NodePtr SyncBatchNorm::Clone(OpList operands) const {
+  return MakeNode<SyncBatchNorm>(operands.at(0), operands.at(1),
+                                 operands.at(2), operands.at(3), eps_, groups_);
+}
+
+XlaOpVector SyncBatchNorm::Lower(LoweringContext* loctx) const {
+  xla::XlaOp input = loctx->GetOutputOp(operand(0));
+  xla::XlaOp weight = loctx->GetOutputOp(operand(1));
+  xla::XlaOp bias = loctx->GetOutputOp(operand(2));
+  xla::XlaOp token = loctx->GetOutputOp(operand(3));
+  SyncBatchNormOutput result =
+      BuildSyncBatchNormTraining(input, weight, bias, token, eps_, groups_);
+  return ReturnOps({result.output, result.mean, result.invstd, result.count,
+                    result.token},
+                   loctx);
+}
+
+std::string SyncBatchNorm::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", eps=" << eps_ << ", groups=(";
+  for (size_t i = 0; i < groups_.size(); ++i) {
+    ss << (i == 0 ? "(" : ",(");
+    ss << absl::StrJoin(groups_[i], ", ") << ")";
+  }
+  ss << ")";
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "torch_xla/csrc/ir.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+// Batch norm training with the statistics computed across the replicas of
+// each group. The outputs are the result, the mean, the inverted standard
+// deviation, the global count of the elements of every feature, and the token.
+class SyncBatchNorm : public Node {
+ public:
+  SyncBatchNorm(const Value& input, const Value& weight, const Value& bias,
+                const Value& token, double eps,
+                std::vector<std::vector<xla::int64>> groups);
+
+  std::string ToString() const override;
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  double eps() const { return eps_; }
+
+  const std::vector<std::vector<xla::int64>>& groups() const { return groups_; }
+
+ private:
+  double eps_;
+  std::vector<std::vector<xla::int64>> groups_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
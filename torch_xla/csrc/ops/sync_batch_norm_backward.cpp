@@ -0,0 +1,80 @@
+#include "torch_xla/csrc/ops/sync_batch_norm_backward.h"
+
+#include "absl/strings/str_join.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "torch_xla/csrc/batch_norm.h"
+#include "torch_xla/csrc/lowering_context.h"
+#include "torch_xla/csrc/ops/infer_output_shape.h"
+#include "torch_xla/csrc/ops/xla_ops.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(absl::Span<const Value> operands,
+                           const std::vector<std::vector<xla::int64>>& groups) {
+  auto shape_fn = [&](absl::Span<const xla::XlaOp> operands) -> xla::XlaOp {
+    SyncBatchNormGrads grads = BuildSyncBatchNormBackward(
+        operands[0], operands[1], operands[2], operands[3], operands[4],
+        operands[5], operands[6], groups);
+    return xla::Tuple(
+        operands[0].builder(),
+        {grads.grad_input, grads.grad_weight, grads.grad_bias, grads.token});
+  };
+  std::vector<xla::Shape> shapes;
+  for (auto& operand : operands) {
+    shapes.push_back(operand.shape());
+  }
+  return InferOutputShape(shapes, shape_fn);
+}
+
+}  // namespace
+
+SyncBatchNormBackward::SyncBatchNormBackward(
+    const Value& grad_output, const Value& input, const Value& weight,
+    const Value& mean, const Value& invstd, const Value& count,
+    const Value& token, std::vector<std::vector<xla::int64>> groups)
+    : Node(xla_sync_batch_norm_backward,
+           {grad_output, input, weight, mean, invstd, count, token},
+           [&]() {
+             return NodeOutputShape(
+                 {grad_output, input, weight, mean, invstd, count, token},
+                 groups);
+           },
+           /*num_outputs=*/4, xla::util::MHash(groups)),
+      groups_(std::move(groups)) {}
+
+NodePtr SyncBatchNormBackward::Clone(OpList operands) const {
+  return MakeNode<SyncBatchNormBackward>(
+      operands.at(0), operands.at(1), operands.at(2), operands.at(3),
+      operands.at(4), operands.at(5), operands.at(6), groups_);
+}
+
+XlaOpVector SyncBatchNormBackward::Lower(LoweringContext* loctx) const {
+  std::vector<xla::XlaOp> inputs;
+  for (size_t i = 0; i < operands().size(); ++i) {
+    inputs.push_back(loctx->GetOutputOp(operand(i)));
+  }
+  SyncBatchNormGrads grads =
+      BuildSyncBatchNormBackward(inputs[0], inputs[1], inputs[2], inputs[3],
+                                 inputs[4], inputs[5], inputs[6], groups_);
+  return ReturnOps(
+      {grads.grad_input, grads.grad_weight, grads.grad_bias, grads.token},
+      loctx);
+}
+
+std::string SyncBatchNormBackward::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", groups=(";
+  for (size_t i = 0; i < groups_.size(); ++i) {
+    ss << (i == 0 ? "(" : ",(");
+    ss << absl::StrJoin(groups_[i], ", ") << ")";
+  }
+  ss << ")";
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "torch_xla/csrc/ir.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+// The outputs are the input, weight and bias gradients, and the token.
+class SyncBatchNormBackward : public Node {
+ public:
+  SyncBatchNormBackward(const Value& grad_output, const Value& input,
+                        const Value& weight, const Value& mean,
+                        const Value& invstd, const Value& count,
+                        const Value& token,
+                        std::vector<std::vector<xla::int64>> groups);
+
+  std::string ToString() const override;
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  const std::vector<std::vector<xla::int64>>& groups() const { return groups_; }
+
+ private:
+  std::vector<std::vector<xla::int64>> groups_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
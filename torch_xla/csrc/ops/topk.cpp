@@ -15,7 +15,8 @@ xla::Shape NodeOutputShape(const Value& input, xla::int64 k, xla::int64 dim,
   auto lower_for_shape_fn =
       [&](absl::Span<const xla::XlaOp> operands) -> xla::XlaOp {
     return xla::Tuple(operands[0].builder(),
-                      CreateTopK(operands[0], k, dim, largest, sorted));
+                      CreateTopK(GetCurrentDevice(), operands[0], k, dim,
+                                 largest, sorted));
   };
   return InferOutputShape({input.shape()}, lower_for_shape_fn);
 }
@@ -38,7 +39,8 @@ NodePtr TopK::Clone(OpList operands) const {
 
 XlaOpVector TopK::Lower(LoweringContext* loctx) const {
   xla::XlaOp input = loctx->GetOutputOp(operand(0));
-  return ReturnOps(CreateTopK(input, k_, dim_, largest_, sorted_), loctx);
+  return ReturnOps(
+      CreateTopK(loctx->device(), input, k_, dim_, largest_, sorted_), loctx);
 }
 
 std::string TopK::ToString() const {
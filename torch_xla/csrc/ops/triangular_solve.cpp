@@ -5,6 +5,7 @@
 #include "tensorflow/compiler/xla/xla_client/util.h"
 #include "torch_xla/csrc/helpers.h"
 #include "torch_xla/csrc/lowering_context.h"
+#include "torch_xla/csrc/matrix.h"
 
 namespace torch_xla {
 namespace ir {
@@ -58,10 +59,17 @@ std::vector<xla::XlaOp> LowerTriangularSolve(xla::XlaOp rhs, xla::XlaOp lhs,
   xla::XlaOp lhs_broadcasted =
       XlaHelpers::ImplicitBroadcast(lhs, lhs_shape, broadcasted_shapes.second);
 
-  xla::XlaOp solution = xla::TriangularSolve(
-      lhs_broadcasted, rhs_broadcasted, left_side, lower, unit_diagonal,
-      transpose ? xla::TriangularSolveOptions::TRANSPOSE
-                : xla::TriangularSolveOptions::NO_TRANSPOSE);
+  xla::XlaOp solution;
+  if (UseSmallMatrixLowering(lhs_shape.dimensions(lhs_shape.rank() - 1))) {
+    solution =
+        BuildSmallTriangularSolve(lhs_broadcasted, rhs_broadcasted, left_side,
+                                  lower, transpose, unit_diagonal);
+  } else {
+    solution = xla::TriangularSolve(
+        lhs_broadcasted, rhs_broadcasted, left_side, lower, unit_diagonal,
+        transpose ? xla::TriangularSolveOptions::TRANSPOSE
+                  : xla::TriangularSolveOptions::NO_TRANSPOSE);
+  }
   return {solution, lhs_broadcasted};
 }
 
@@ -0,0 +1,32 @@
+#include "torch_xla/csrc/ops/unique_indices.h"
+
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "torch_xla/csrc/lowering_context.h"
+#include "torch_xla/csrc/ops/xla_ops.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+UniqueIndices::UniqueIndices(const Value& input, bool sorted)
+    : Node(xla_unique_indices, {input}, input.shape(),
+           /*num_outputs=*/1, xla::util::MHash(sorted)),
+      sorted_(sorted) {}
+
+NodePtr UniqueIndices::Clone(OpList operands) const {
+  return MakeNode<UniqueIndices>(operands.at(0), sorted_);
+}
+
+XlaOpVector UniqueIndices::Lower(LoweringContext* loctx) const {
+  return ReturnOp(loctx->GetOutputOp(operand(0)), loctx);
+}
+
+std::string UniqueIndices::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", sorted=" << sorted_;
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "torch_xla/csrc/ir.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+
+// Marks an index tensor whose values are known to be unique (and optionally
+// sorted), so that the scatters consuming it can be lowered without
+// serializing the updates. Lowers to its input.
+class UniqueIndices : public Node {
+ public:
+  UniqueIndices(const Value& input, bool sorted);
+
+  std::string ToString() const override;
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  bool sorted() const { return sorted_; }
+
+ private:
+  bool sorted_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
@@ -12,7 +12,11 @@ namespace {
 xla::Shape NodeOutputShape(const Value& input, int dim) {
   const xla::Shape& shape = input.shape();
   auto dimensions = BuildUnsqueezeDimensions(shape.dimensions(), dim);
-  return xla::ShapeUtil::MakeShape(shape.element_type(), dimensions);
+  std::vector<bool> dynamic_dimensions(shape.dynamic_dimensions().begin(),
+                                       shape.dynamic_dimensions().end());
+  dynamic_dimensions.insert(dynamic_dimensions.begin() + dim, false);
+  return xla::ShapeUtil::MakeShape(shape.element_type(), dimensions,
+                                   dynamic_dimensions);
 }
 
 }  // namespace
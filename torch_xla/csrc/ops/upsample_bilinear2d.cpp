@@ -27,10 +27,18 @@ NodePtr UpsampleBilinear::Clone(OpList operands) const {
 }
 
 XlaOpVector UpsampleBilinear::Lower(LoweringContext* loctx) const {
-  xla::XlaOp input = loctx->GetOutputOp(operand(0));
-  xla::XlaOp output =
-      resize::LowerForward2d("ResizeBilinear", input, shape(), align_corners_,
-                             /*half_pixel_centers=*/!align_corners_);
+  bool channels_last = loctx->ChannelsLastEnabled() &&
+                       loctx->HasOutputOpChannelsLast(operand(0));
+  xla::XlaOp input = channels_last
+                         ? loctx->GetOutputOpChannelsLast(operand(0))
+                         : loctx->GetOutputOp(operand(0));
+  xla::XlaOp output = resize::LowerForward2d(
+      loctx->device(), "ResizeBilinear", input, shape(), align_corners_,
+      /*half_pixel_centers=*/!align_corners_, channels_last);
+  if (channels_last) {
+    loctx->AssignOutputOpChannelsLast(Output(this), output);
+    return {loctx->GetOutputOp(Output(this))};
+  }
   return ReturnOp(output, loctx);
 }
 
@@ -29,10 +29,18 @@ NodePtr UpsampleBilinearBackward::Clone(OpList operands) const {
 }
 
 XlaOpVector UpsampleBilinearBackward::Lower(LoweringContext* loctx) const {
-  xla::XlaOp input = loctx->GetOutputOp(operand(0));
+  bool channels_last = loctx->ChannelsLastEnabled() &&
+                       loctx->HasOutputOpChannelsLast(operand(0));
+  xla::XlaOp input = channels_last
+                         ? loctx->GetOutputOpChannelsLast(operand(0))
+                         : loctx->GetOutputOp(operand(0));
   xla::XlaOp output = resize::LowerBackward2d(
-      "ResizeBilinearGrad", input, shape(), align_corners_,
-      /*half_pixel_centers=*/!align_corners_);
+      loctx->device(), "ResizeBilinearGrad", input, shape(), align_corners_,
+      /*half_pixel_centers=*/!align_corners_, channels_last);
+  if (channels_last) {
+    loctx->AssignOutputOpChannelsLast(Output(this), output);
+    return {loctx->GetOutputOp(Output(this))};
+  }
   return ReturnOp(output, loctx);
 }
 
@@ -24,10 +24,18 @@ NodePtr UpsampleNearest::Clone(OpList operands) const {
 }
 
 XlaOpVector UpsampleNearest::Lower(LoweringContext* loctx) const {
-  xla::XlaOp input = loctx->GetOutputOp(operand(0));
-  xla::XlaOp output = resize::LowerForward2d("ResizeNearest", input, shape(),
-                                             /*align_corners=*/false,
-                                             /*half_pixel_centers=*/false);
+  bool channels_last = loctx->ChannelsLastEnabled() &&
+                       loctx->HasOutputOpChannelsLast(operand(0));
+  xla::XlaOp input = channels_last
+                         ? loctx->GetOutputOpChannelsLast(operand(0))
+                         : loctx->GetOutputOp(operand(0));
+  xla::XlaOp output = resize::LowerForward2d(
+      loctx->device(), "ResizeNearest", input, shape(),
+      /*align_corners=*/false, /*half_pixel_centers=*/false, channels_last);
+  if (channels_last) {
+    loctx->AssignOutputOpChannelsLast(Output(this), output);
+    return {loctx->GetOutputOp(Output(this))};
+  }
   return ReturnOp(output, loctx);
 }
 
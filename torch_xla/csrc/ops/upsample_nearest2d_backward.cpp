@@ -27,10 +27,18 @@ NodePtr UpsampleNearestBackward::Clone(OpList operands) const {
 }
 
 XlaOpVector UpsampleNearestBackward::Lower(LoweringContext* loctx) const {
-  xla::XlaOp input = loctx->GetOutputOp(operand(0));
+  bool channels_last = loctx->ChannelsLastEnabled() &&
+                       loctx->HasOutputOpChannelsLast(operand(0));
+  xla::XlaOp input = channels_last
+                         ? loctx->GetOutputOpChannelsLast(operand(0))
+                         : loctx->GetOutputOp(operand(0));
   xla::XlaOp output = resize::LowerBackward2d(
-      "ResizeNearestGrad", input, shape(),
-      /*align_corners=*/false, /*half_pixel_centers=*/false);
+      loctx->device(), "ResizeNearestGrad", input, shape(),
+      /*align_corners=*/false, /*half_pixel_centers=*/false, channels_last);
+  if (channels_last) {
+    loctx->AssignOutputOpChannelsLast(Output(this), output);
+    return {loctx->GetOutputOp(Output(this))};
+  }
   return ReturnOp(output, loctx);
 }
 
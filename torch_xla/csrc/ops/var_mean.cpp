@@ -0,0 +1,72 @@
+#include "torch_xla/csrc/ops/var_mean.h"
+
+#include "absl/strings/str_join.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "torch_xla/csrc/lowering_context.h"
+#include "torch_xla/csrc/ops/infer_output_shape.h"
+#include "torch_xla/csrc/reduction.h"
+
+namespace torch_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+std::vector<xla::XlaOp> LowerVarMean(xla::XlaOp input,
+                                     absl::Span<const xla::int64> dimensions,
+                                     bool keep_reduced_dimensions,
+                                     bool unbiased) {
+  VarianceAndMean result = BuildVarianceAndMean(
+      input, dimensions, keep_reduced_dimensions, unbiased);
+  return {result.variance, result.mean};
+}
+
+xla::Shape NodeOutputShape(const Value& input,
+                           std::vector<xla::int64>& dimensions,
+                           bool keep_reduced_dimensions, bool unbiased) {
+  auto lower_for_shape_fn =
+      [&](absl::Span<const xla::XlaOp> operands) -> xla::XlaOp {
+    return xla::Tuple(operands[0].builder(),
+                      LowerVarMean(operands[0], dimensions,
+                                   keep_reduced_dimensions, unbiased));
+  };
+  return InferOutputShape({input.shape()}, lower_for_shape_fn);
+}
+
+}  // namespace
+
+VarMean::VarMean(const Value& input, std::vector<xla::int64> dimensions,
+                 bool keep_reduced_dimensions, bool unbiased)
+    : Node(ir::OpKind(at::aten::var_mean), {input},
+           [&]() {
+             return NodeOutputShape(input, dimensions, keep_reduced_dimensions,
+                                    unbiased);
+           },
+           /*num_outputs=*/2,
+           xla::util::MHash(dimensions, keep_reduced_dimensions, unbiased)),
+      dimensions_(std::move(dimensions)),
+      keep_reduced_dimensions_(keep_reduced_dimensions),
+      unbiased_(unbiased) {}
+
+NodePtr VarMean::Clone(OpList operands) const {
+  return MakeNode<VarMean>(operands.at(0), dimensions_,
+                           keep_reduced_dimensions_, unbiased_);
+}
+
+XlaOpVector VarMean::Lower(LoweringContext* loctx) const {
+  xla::XlaOp input = loctx->GetOutputOp(operand(0));
+  return ReturnOps(LowerVarMean(input, dimensions_, keep_reduced_dimensions_,
+                                unbiased_),
+                   loctx);
+}
+
+std::string VarMean::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", dimensions=(" << absl::StrJoin(dimensions_, ", ")
+     << "), keep_reduced_dimensions=" << keep_reduced_dimensions_
+     << ", unbiased=" << unbiased_;
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace torch_xla
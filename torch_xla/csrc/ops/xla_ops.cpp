@@ -4,24 +4,48 @@ namespace torch_xla {
 namespace ir {
 namespace ops {
 
+const OpKindWrapper xla_adam_step("xla::adam_step");
+const OpKindWrapper xla_all_gather("xla::all_gather");
 const OpKindWrapper xla_all_to_all("xla::all_to_all");
 const OpKindWrapper xla_as_strided_view_update("xla::as_strided_view_update");
+const OpKindWrapper xla_batched_nms("xla::batched_nms");
 const OpKindWrapper xla_cast("xla::cast");
+const OpKindWrapper xla_clip_grad_norm("xla::clip_grad_norm");
 const OpKindWrapper xla_collective_permute("xla::collective_permute");
+const OpKindWrapper xla_column_parallel_matmul(
+    "xla::column_parallel_matmul");
+const OpKindWrapper xla_cross_entropy("xla::cross_entropy");
+const OpKindWrapper xla_cross_entropy_backward("xla::cross_entropy_backward");
 const OpKindWrapper xla_cross_replica_sum("xla::cross_replica_sum");
 const OpKindWrapper xla_device_data("xla::device_data");
 const OpKindWrapper xla_diagonal_view_update("xla::diagonal_view_update");
+const OpKindWrapper xla_dropout("xla::dropout");
+const OpKindWrapper xla_dynamic_update_slice("xla::dynamic_update_slice");
 const OpKindWrapper xla_generic_slice("xla::generic_slice");
 const OpKindWrapper xla_get_dimensions_size("xla::xla_get_dimensions_size");
 const OpKindWrapper xla_moving_average("xla::moving_average");
 const OpKindWrapper xla_nms("xla::nms");
 const OpKindWrapper xla_not_supported("xla::not_supported");
+const OpKindWrapper xla_quantized_convolution(
+    "xla::quantized_convolution");
+const OpKindWrapper xla_quantized_matmul("xla::quantized_matmul");
+const OpKindWrapper xla_reduce_scatter("xla::reduce_scatter");
 const OpKindWrapper xla_replication_pad("xla::replication_pad");
 const OpKindWrapper xla_replication_pad_backward(
     "xla::replication_pad_backward");
+const OpKindWrapper xla_row_parallel_matmul("xla::row_parallel_matmul");
+const OpKindWrapper xla_scaled_dot_product_attention(
+    "xla::scaled_dot_product_attention");
+const OpKindWrapper xla_scaled_dot_product_attention_backward(
+    "xla::scaled_dot_product_attention_backward");
+const OpKindWrapper xla_sgd_momentum_step("xla::sgd_momentum_step");
 const OpKindWrapper xla_select("xla::select");
+const OpKindWrapper xla_sync_batch_norm("xla::sync_batch_norm");
+const OpKindWrapper xla_sync_batch_norm_backward(
+    "xla::sync_batch_norm_backward");
 const OpKindWrapper xla_tensor_data("xla::tensor_data");
 const OpKindWrapper xla_token("xla::token");
+const OpKindWrapper xla_unique_indices("xla::unique_indices");
 const OpKindWrapper xla_unselect("xla::unselect");
 const OpKindWrapper xla_update_slice("xla::update_slice");
 
@@ -28,23 +28,42 @@ class OpKindWrapper {
   mutable std::once_flag once_;
 };
 
+extern const OpKindWrapper xla_adam_step;
+extern const OpKindWrapper xla_all_gather;
 extern const OpKindWrapper xla_all_to_all;
 extern const OpKindWrapper xla_as_strided_view_update;
+extern const OpKindWrapper xla_batched_nms;
 extern const OpKindWrapper xla_cast;
+extern const OpKindWrapper xla_clip_grad_norm;
 extern const OpKindWrapper xla_collective_permute;
+extern const OpKindWrapper xla_column_parallel_matmul;
+extern const OpKindWrapper xla_cross_entropy;
+extern const OpKindWrapper xla_cross_entropy_backward;
 extern const OpKindWrapper xla_cross_replica_sum;
 extern const OpKindWrapper xla_device_data;
 extern const OpKindWrapper xla_diagonal_view_update;
+extern const OpKindWrapper xla_dropout;
+extern const OpKindWrapper xla_dynamic_update_slice;
 extern const OpKindWrapper xla_generic_slice;
 extern const OpKindWrapper xla_get_dimensions_size;
 extern const OpKindWrapper xla_moving_average;
 extern const OpKindWrapper xla_nms;
 extern const OpKindWrapper xla_not_supported;
+extern const OpKindWrapper xla_quantized_convolution;
+extern const OpKindWrapper xla_quantized_matmul;
+extern const OpKindWrapper xla_reduce_scatter;
 extern const OpKindWrapper xla_replication_pad;
 extern const OpKindWrapper xla_replication_pad_backward;
+extern const OpKindWrapper xla_row_parallel_matmul;
+extern const OpKindWrapper xla_scaled_dot_product_attention;
+extern const OpKindWrapper xla_scaled_dot_product_attention_backward;
+extern const OpKindWrapper xla_sgd_momentum_step;
 extern const OpKindWrapper xla_select;
+extern const OpKindWrapper xla_sync_batch_norm;
+extern const OpKindWrapper xla_sync_batch_norm_backward;
 extern const OpKindWrapper xla_tensor_data;
 extern const OpKindWrapper xla_token;
+extern const OpKindWrapper xla_unique_indices;
 extern const OpKindWrapper xla_unselect;
 extern const OpKindWrapper xla_update_slice;
 
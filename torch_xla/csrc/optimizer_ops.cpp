@@ -0,0 +1,116 @@
+#include "torch_xla/csrc/optimizer_ops.h"
+
+#include <cmath>
+
+#include "tensorflow/compiler/xla/client/lib/arithmetic.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "torch_xla/csrc/convert_ops.h"
+#include "torch_xla/csrc/helpers.h"
+
+namespace torch_xla {
+namespace {
+
+xla::XlaOp ApplyWeightDecay(xla::XlaOp param, xla::XlaOp grad,
+                            double weight_decay, xla::PrimitiveType type,
+                            xla::XlaBuilder* builder) {
+  if (weight_decay == 0) {
+    return grad;
+  }
+  return grad +
+         param * XlaHelpers::ScalarValue<double>(weight_decay, type, builder);
+}
+
+}  // namespace
+
+AdamStepResult BuildAdamStep(xla::XlaOp param, xla::XlaOp grad,
+                             xla::XlaOp exp_avg, xla::XlaOp exp_avg_sq,
+                             xla::XlaOp step_size,
+                             xla::XlaOp bias_correction2_sqrt, double beta1,
+                             double beta2, double eps, double weight_decay) {
+  xla::XlaBuilder* builder = param.builder();
+  xla::PrimitiveType type = XlaHelpers::TypeOfXlaOp(param);
+  auto scalar = [&](double value) {
+    return XlaHelpers::ScalarValue<double>(value, type, builder);
+  };
+  xla::XlaOp decayed_grad =
+      ApplyWeightDecay(param, grad, weight_decay, type, builder);
+  xla::XlaOp new_exp_avg =
+      exp_avg * scalar(beta1) + decayed_grad * scalar(1.0 - beta1);
+  xla::XlaOp new_exp_avg_sq = exp_avg_sq * scalar(beta2) +
+                              decayed_grad * decayed_grad * scalar(1.0 - beta2);
+  xla::XlaOp corrected_sqrt =
+      xla::Sqrt(new_exp_avg_sq) / MaybeConvertTo(bias_correction2_sqrt, type);
+  xla::XlaOp denom = corrected_sqrt + scalar(eps);
+  xla::XlaOp new_param =
+      param - MaybeConvertTo(step_size, type) * new_exp_avg / denom;
+  return {new_param, new_exp_avg, new_exp_avg_sq};
+}
+
+ClipGradNormResult BuildClipGradNorm(absl::Span<const xla::XlaOp> grads,
+                                     xla::XlaOp max_norm, double norm_type) {
+  XLA_CHECK(!grads.empty());
+  xla::XlaBuilder* builder = grads.front().builder();
+  auto scalar = [&](double value) {
+    return XlaHelpers::ScalarValue<double>(value, xla::PrimitiveType::F32,
+                                           builder);
+  };
+  bool inf_norm = std::isinf(norm_type);
+  xla::XlaComputation reduce_computation =
+      inf_norm ? XlaHelpers::CreateMaxComputation(xla::PrimitiveType::F32)
+               : XlaHelpers::CreateAddComputation(xla::PrimitiveType::F32);
+  xla::XlaOp accumulator = scalar(0);
+  for (auto grad : grads) {
+    xla::XlaOp value =
+        xla::Abs(MaybeConvertTo(grad, xla::PrimitiveType::F32));
+    if (norm_type == 2) {
+      value = value * value;
+    } else if (!inf_norm) {
+      value = xla::Pow(value, scalar(norm_type));
+    }
+    xla::XlaOp partial = xla::ReduceAll(value, scalar(0), reduce_computation);
+    accumulator = inf_norm ? xla::Max(accumulator, partial)
+                           : accumulator + partial;
+  }
+  xla::XlaOp total_norm = accumulator;
+  if (norm_type == 2) {
+    total_norm = xla::Sqrt(accumulator);
+  } else if (!inf_norm) {
+    total_norm = xla::Pow(accumulator, scalar(1.0 / norm_type));
+  }
+  xla::XlaOp clip_coef =
+      xla::Min(MaybeConvertTo(max_norm, xla::PrimitiveType::F32) /
+                   (total_norm + scalar(1e-6)),
+               scalar(1));
+  ClipGradNormResult result;
+  for (auto grad : grads) {
+    xla::PrimitiveType type = XlaHelpers::TypeOfXlaOp(grad);
+    result.grads.push_back(grad * MaybeConvertTo(clip_coef, type));
+  }
+  result.total_norm = MaybeConvertTo(
+      total_norm, XlaHelpers::TypeOfXlaOp(grads.front()));
+  return result;
+}
+
+SgdMomentumStepResult BuildSgdMomentumStep(
+    xla::XlaOp param, xla::XlaOp grad, xla::XlaOp momentum_buffer,
+    xla::XlaOp lr, double momentum, double dampening, double weight_decay,
+    bool nesterov, bool init_momentum_buffer) {
+  xla::XlaBuilder* builder = param.builder();
+  xla::PrimitiveType type = XlaHelpers::TypeOfXlaOp(param);
+  auto scalar = [&](double value) {
+    return XlaHelpers::ScalarValue<double>(value, type, builder);
+  };
+  xla::XlaOp decayed_grad =
+      ApplyWeightDecay(param, grad, weight_decay, type, builder);
+  xla::XlaOp new_momentum_buffer =
+      init_momentum_buffer ? decayed_grad
+                           : momentum_buffer * scalar(momentum) +
+                                 decayed_grad * scalar(1.0 - dampening);
+  xla::XlaOp update =
+      nesterov ? decayed_grad + new_momentum_buffer * scalar(momentum)
+               : new_momentum_buffer;
+  xla::XlaOp new_param = param - MaybeConvertTo(lr, type) * update;
+  return {new_param, new_momentum_buffer};
+}
+
+}  // namespace torch_xla
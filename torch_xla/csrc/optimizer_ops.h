@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/xla/client/xla_builder.h"
+
+namespace torch_xla {
+
+struct AdamStepResult {
+  xla::XlaOp param;
+  xla::XlaOp exp_avg;
+  xla::XlaOp exp_avg_sq;
+};
+
+struct ClipGradNormResult {
+  std::vector<xla::XlaOp> grads;
+  xla::XlaOp total_norm;
+};
+
+struct SgdMomentumStepResult {
+  xla::XlaOp param;
+  xla::XlaOp momentum_buffer;
+};
+
+// Computes one torch.optim.Adam update step for a single parameter. The
+// step_size (lr / bias_correction1) and bias_correction2_sqrt are scalar
+// operands, so that changing them from step to step does not lead to
+// recompilations.
+AdamStepResult BuildAdamStep(xla::XlaOp param, xla::XlaOp grad,
+                             xla::XlaOp exp_avg, xla::XlaOp exp_avg_sq,
+                             xla::XlaOp step_size,
+                             xla::XlaOp bias_correction2_sqrt, double beta1,
+                             double beta2, double eps, double weight_decay);
+
+// Computes the norm_type norm of all the grads taken together, and scales them
+// by min(max_norm / (total_norm + 1e-6), 1), like the
+// torch.nn.utils.clip_grad_norm_() API does. The per grad partial reductions
+// accumulate in F32, and an infinite norm_type computes the largest absolute
+// value. The total_norm has the type of the first grad.
+ClipGradNormResult BuildClipGradNorm(absl::Span<const xla::XlaOp> grads,
+                                     xla::XlaOp max_norm, double norm_type);
+
+// Computes one torch.optim.SGD with momentum update step for a single
+// parameter. If init_momentum_buffer is true, the momentum buffer is set to the
+// (weight decayed) gradient, like PyTorch does at the first step.
+SgdMomentumStepResult BuildSgdMomentumStep(
+    xla::XlaOp param, xla::XlaOp grad, xla::XlaOp momentum_buffer,
+    xla::XlaOp lr, double momentum, double dampening, double weight_decay,
+    bool nesterov, bool init_momentum_buffer);
+
+}  // namespace torch_xla
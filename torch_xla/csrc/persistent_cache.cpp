@@ -0,0 +1,194 @@
+#include "torch_xla/csrc/persistent_cache.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/thread_pool.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
+#include "torch_xla/csrc/version.h"
+
+namespace torch_xla {
+namespace {
+
+static const char* const kEntrySuffix = ".hlo";
+static const char* const kLockSuffix = ".lock";
+
+std::string GetTempPath(const std::string& path) {
+  static std::atomic<size_t>* counter = new std::atomic<size_t>(0);
+  return absl::StrCat(path, ".tmp.", getpid(), ".", counter->fetch_add(1));
+}
+
+}  // namespace
+
+PersistentCache::PersistentCache(std::string path)
+    : path_(std::move(path)),
+      is_local_(path_.find("://") == std::string::npos) {
+  WarmUp();
+}
+
+PersistentCache* PersistentCache::Get() {
+  static PersistentCache* cache = []() -> PersistentCache* {
+    std::string path =
+        xla::sys_util::GetEnvString("XLA_PERSISTENT_CACHE_PATH", "");
+    return !path.empty() ? new PersistentCache(std::move(path)) : nullptr;
+  }();
+  return cache;
+}
+
+xla::hash_t PersistentCache::GetKey(const xla::hash_t& hash) {
+  static const xla::hash_t version_hash = xla::util::MHash(
+      std::string(XLA_GITREV), std::string(TORCH_GITREV));
+  return xla::util::HashCombine(hash, version_hash);
+}
+
+std::string PersistentCache::GetEntryPath(const xla::hash_t& key) const {
+  return tensorflow::io::JoinPath(
+      path_, absl::StrCat(xla::util::HexHash(key), kEntrySuffix));
+}
+
+void PersistentCache::WarmUp() {
+  tensorflow::Env* env = tensorflow::Env::Default();
+  XLA_CHECK_OK(env->RecursivelyCreateDir(path_));
+  std::vector<std::string> files;
+  XLA_CHECK_OK(env->GetMatchingPaths(
+      tensorflow::io::JoinPath(path_, absl::StrCat("*", kEntrySuffix)),
+      &files));
+  std::lock_guard<std::mutex> lock(lock_);
+  for (auto& file : files) {
+    entries_.insert(std::string(tensorflow::io::Basename(file)));
+  }
+  TF_VLOG(1) << "Persistent compilation cache at " << path_ << " has "
+             << entries_.size() << " entries";
+}
+
+std::unique_ptr<xla::XlaComputation> PersistentCache::Load(
+    const xla::hash_t& key) {
+  std::string entry_path = GetEntryPath(key);
+  std::string entry_name(tensorflow::io::Basename(entry_path));
+  bool shared = false;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    if (entries_.count(entry_name) == 0) {
+      // Entries stored by other processes after the warm up are only visible
+      // on the local file system, where checking for them is cheap.
+      if (!is_local_ ||
+          !tensorflow::Env::Default()->FileExists(entry_path).ok()) {
+        XLA_COUNTER("PersistentCacheMiss", 1);
+        return nullptr;
+      }
+      entries_.insert(entry_name);
+      shared = true;
+    }
+  }
+  XLA_TIMED("PersistentCacheLoad");
+  std::string data;
+  tensorflow::Status status = tensorflow::ReadFileToString(
+      tensorflow::Env::Default(), entry_path, &data);
+  xla::HloModuleProto proto;
+  if (!status.ok() || !proto.ParseFromString(data)) {
+    // A corrupted or vanished entry simply results in a cache miss, and will
+    // be overwritten by the following Store().
+    TF_LOG(WARNING) << "Unable to load persistent cache entry " << entry_path
+                    << ": " << status;
+    XLA_COUNTER("PersistentCacheMiss", 1);
+    return nullptr;
+  }
+  if (shared) {
+    XLA_COUNTER("PersistentCacheSharedHit", 1);
+  } else {
+    XLA_COUNTER("PersistentCacheHit", 1);
+  }
+  return absl::make_unique<xla::XlaComputation>(std::move(proto));
+}
+
+std::unique_ptr<xla::XlaComputation> PersistentCache::WaitShared(
+    const xla::hash_t& key) {
+  static const xla::int64 wait_ms =
+      xla::sys_util::GetEnvInt("XLA_PERSISTENT_CACHE_WAIT_MS", 0);
+  if (wait_ms <= 0 || !is_local_) {
+    return nullptr;
+  }
+  std::string entry_path = GetEntryPath(key);
+  std::string lock_path = absl::StrCat(entry_path, kLockSuffix);
+  tensorflow::Env* env = tensorflow::Env::Default();
+  xla::int64 deadline_ns = xla::sys_util::NowNs() + wait_ms * 1000000;
+  while (true) {
+    int fd = open(lock_path.c_str(), O_CREAT | O_EXCL | O_WRONLY, 0644);
+    if (fd >= 0) {
+      close(fd);
+      std::lock_guard<std::mutex> lock(lock_);
+      locked_entries_.insert(entry_path);
+      return nullptr;
+    }
+    if (env->FileExists(entry_path).ok()) {
+      return Load(key);
+    }
+    if (xla::sys_util::NowNs() > deadline_ns) {
+      // The process holding the lock is either too slow or gone, so the graph
+      // gets lowered here as well.
+      XLA_COUNTER("PersistentCacheWaitTimeout", 1);
+      return nullptr;
+    }
+    usleep(10000);
+  }
+}
+
+void PersistentCache::ReleaseEntryLock(const std::string& entry_path) {
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    if (locked_entries_.erase(entry_path) == 0) {
+      return;
+    }
+  }
+  tensorflow::Env::Default()
+      ->DeleteFile(absl::StrCat(entry_path, kLockSuffix))
+      .IgnoreError();
+}
+
+void PersistentCache::Store(const xla::hash_t& key,
+                            const xla::XlaComputation& computation) {
+  std::string entry_path = GetEntryPath(key);
+  std::string entry_name(tensorflow::io::Basename(entry_path));
+  bool stored = false;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    stored = !entries_.insert(entry_name).second;
+  }
+  if (stored) {
+    ReleaseEntryLock(entry_path);
+    return;
+  }
+  auto data = std::make_shared<std::string>(
+      computation.proto().SerializeAsString());
+  auto writer = [this, entry_path, entry_name, data]() {
+    XLA_TIMED("PersistentCacheStore");
+    tensorflow::Env* env = tensorflow::Env::Default();
+    std::string temp_path = GetTempPath(entry_path);
+    tensorflow::Status status =
+        tensorflow::WriteStringToFile(env, temp_path, *data);
+    if (status.ok()) {
+      status = env->RenameFile(temp_path, entry_path);
+    }
+    if (!status.ok()) {
+      TF_LOG(WARNING) << "Unable to store persistent cache entry "
+                      << entry_path << ": " << status;
+      env->DeleteFile(temp_path).IgnoreError();
+      std::lock_guard<std::mutex> lock(lock_);
+      entries_.erase(entry_name);
+    }
+    // The processes waiting on the lock look for the entry itself, which
+    // shows up atomically with the rename, so the lock can go either way.
+    ReleaseEntryLock(entry_path);
+  };
+  xla::env::ScheduleIoClosure(std::move(writer));
+}
+
+}  // namespace torch_xla
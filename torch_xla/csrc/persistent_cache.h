@@ -0,0 +1,62 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
+#include "tensorflow/compiler/xla/client/xla_computation.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace torch_xla {
+
+// Persistent tier of the computation cache. Stores the HLO module of the
+// computations compiled by the SyncTensorsGraph() path, keyed by the graph
+// hash, so that a restarted process can skip the IR lowering of graphs it
+// already saw. The path can be any location supported by the TF filesystem
+// layer (local paths, gs://...).
+class PersistentCache {
+ public:
+  explicit PersistentCache(std::string path);
+
+  // Returns the persistent cache configured by the XLA_PERSISTENT_CACHE_PATH
+  // environment variable, or nullptr if such variable is not set.
+  static PersistentCache* Get();
+
+  // Mixes the graph hash with the library version, so that stale entries
+  // created by a different build are never picked up.
+  static xla::hash_t GetKey(const xla::hash_t& hash);
+
+  std::unique_ptr<xla::XlaComputation> Load(const xla::hash_t& key);
+
+  // Coordinates the processes of the same host (like the xmp.spawn ones)
+  // missing the same entry of a local cache directory, so that only one of
+  // them lowers the graph. Waits up to XLA_PERSISTENT_CACHE_WAIT_MS for the
+  // entry to be stored by another process, and returns nullptr if the caller
+  // has to lower the graph itself, and Store() it.
+  std::unique_ptr<xla::XlaComputation> WaitShared(const xla::hash_t& key);
+
+  // Writes are atomic (write to temporary file, then rename), and happen
+  // asynchronously on the IO thread pool.
+  void Store(const xla::hash_t& key, const xla::XlaComputation& computation);
+
+  const std::string& path() const { return path_; }
+
+ private:
+  std::string GetEntryPath(const xla::hash_t& key) const;
+
+  void WarmUp();
+
+  void ReleaseEntryLock(const std::string& entry_path);
+
+  std::string path_;
+  // Whether the path is on the local file system, where the entries stored
+  // by the other processes are looked up, and the entry locks are created.
+  bool is_local_ = false;
+  std::mutex lock_;
+  std::unordered_set<std::string> entries_;
+  // The entries this process holds the lock file of.
+  std::unordered_set<std::string> locked_entries_;
+};
+
+}  // namespace torch_xla
@@ -1,5 +1,7 @@
 #include "torch_xla/csrc/pooling.h"
 
+#include <algorithm>
+
 #include "tensorflow/compiler/xla/client/lib/pooling.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
@@ -16,6 +18,19 @@ xla::TensorFormat MakeNCHWFormat(xla::int64 spatial_dim_count) {
       /*spatial_dimensions=*/xla::util::Iota<xla::int64>(spatial_dim_count, 2)};
 }
 
+xla::TensorFormat MakeNHWCFormat(xla::int64 spatial_dim_count) {
+  return {
+      /*batch_dimension=*/0,
+      /*feature_dimension=*/spatial_dim_count + 1,
+      /*spatial_dimensions=*/xla::util::Iota<xla::int64>(spatial_dim_count, 1)};
+}
+
+xla::TensorFormat MakeTensorFormat(xla::int64 spatial_dim_count,
+                                   bool channels_last) {
+  return channels_last ? MakeNHWCFormat(spatial_dim_count)
+                       : MakeNCHWFormat(spatial_dim_count);
+}
+
 // Holds the attributes common to all pooling operators.
 struct PoolingOpAttributes {
   std::vector<xla::int64> kernel_size;
@@ -36,7 +51,7 @@ xla::XlaComputation CreateGeComputation(xla::PrimitiveType type) {
 // padding.
 PoolingOpAttributes MakePoolingOpAttributes(
     absl::Span<const xla::int64> kernel_size_attr,
-    absl::Span<const xla::int64> stride_attr) {
+    absl::Span<const xla::int64> stride_attr, bool channels_last = false) {
   // Create a NCHW kernel size with 1 for batch size and feature.
   std::vector<xla::int64> kernel_size(2, 1);
   kernel_size.insert(kernel_size.end(), kernel_size_attr.begin(),
@@ -50,29 +65,90 @@ PoolingOpAttributes MakePoolingOpAttributes(
     stride.resize(2, 1);
     stride.insert(stride.end(), stride_attr.begin(), stride_attr.end());
   }
+  if (channels_last) {
+    // Move the unit feature entry (at index 1) to the minor position.
+    std::rotate(kernel_size.begin() + 1, kernel_size.begin() + 2,
+                kernel_size.end());
+    std::rotate(stride.begin() + 1, stride.begin() + 2, stride.end());
+  }
   return {kernel_size, stride};
 }
 
 // Compute the average pool kernel size required for the specified output_size
-// from the given input_size, when the stride is the same as the kernel size.
+// from the given (batched) input_size, when the stride is the same as the
+// kernel size. The spatial dimensions whose input size is not a multiple of the
+// output size get a unit kernel, as their bins are averaged by
+// AdaptiveAvgPoolDim() instead.
 std::vector<xla::int64> AdaptiveAvgPoolKernelSize(
     absl::Span<const xla::int64> input_size,
     absl::Span<const xla::int64> output_size) {
   // Create a NCHW kernel size with 1 for batch size and feature.
   std::vector<xla::int64> kernel_size(2, 1);
-  xla::int64 spatial_dim_off = input_size.size() - 2;
-  for (int spatial_dim = 0; spatial_dim < 2; ++spatial_dim) {
-    XLA_CHECK_EQ(
-        input_size[spatial_dim_off + spatial_dim] % output_size[spatial_dim], 0)
-        << "Target output size " << output_size[spatial_dim]
-        << " doesn't divide the input size "
-        << input_size[spatial_dim_off + spatial_dim];
-    kernel_size.push_back(input_size[spatial_dim_off + spatial_dim] /
-                          output_size[spatial_dim]);
+  for (size_t spatial_dim = 0; spatial_dim < output_size.size();
+       ++spatial_dim) {
+    xla::int64 size = input_size[2 + spatial_dim];
+    kernel_size.push_back(size % output_size[spatial_dim] == 0
+                              ? size / output_size[spatial_dim]
+                              : 1);
   }
   return kernel_size;
 }
 
+bool IsUnitKernel(absl::Span<const xla::int64> kernel_size) {
+  return std::all_of(kernel_size.begin(), kernel_size.end(),
+                     [](xla::int64 size) { return size == 1; });
+}
+
+// Returns the [output_size, input_size] matrix averaging the input elements of
+// every adaptive pooling bin, whose bounds are the PyTorch ones:
+// [floor(o * input_size / output_size), ceil((o + 1) * input_size /
+// output_size)).
+xla::XlaOp AdaptiveAvgPoolMatrix(xla::XlaBuilder* builder,
+                                 xla::int64 input_size, xla::int64 output_size,
+                                 xla::PrimitiveType type) {
+  std::vector<double> weights(output_size * input_size, 0.0);
+  for (xla::int64 o = 0; o < output_size; ++o) {
+    xla::int64 start = (o * input_size) / output_size;
+    xla::int64 end = ((o + 1) * input_size + output_size - 1) / output_size;
+    for (xla::int64 i = start; i < end; ++i) {
+      weights[o * input_size + i] = 1.0 / (end - start);
+    }
+  }
+  // Not all the devices support F64, so only F64 inputs get an F64 matrix.
+  xla::XlaOp matrix;
+  if (type == xla::PrimitiveType::F64) {
+    matrix = xla::ConstantR1<double>(builder, weights);
+  } else {
+    std::vector<float> float_weights(weights.begin(), weights.end());
+    matrix = xla::ConvertElementType(
+        xla::ConstantR1<float>(builder, float_weights), type);
+  }
+  return xla::Reshape(matrix, {output_size, input_size});
+}
+
+// Averages the bins of the dim dimension of the input, with a contraction
+// against the AdaptiveAvgPoolMatrix() one. With transpose, the input holds the
+// output gradients, which get spread back over the input elements of the bins.
+xla::XlaOp AdaptiveAvgPoolDim(xla::XlaOp input, xla::int64 dim,
+                              xla::int64 input_size, xla::int64 output_size,
+                              bool transpose) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(input);
+  xla::XlaOp matrix = AdaptiveAvgPoolMatrix(input.builder(), input_size,
+                                            output_size, shape.element_type());
+  xla::DotDimensionNumbers dims;
+  dims.add_lhs_contracting_dimensions(dim);
+  dims.add_rhs_contracting_dimensions(transpose ? 0 : 1);
+  xla::PrecisionConfig precision_config =
+      XlaHelpers::BuildPrecisionConfig(XlaHelpers::mat_mul_precision());
+  xla::XlaOp result = xla::DotGeneral(input, matrix, dims, &precision_config);
+  // The dot appends the new dimension as the minor one, move it back in place.
+  std::vector<xla::int64> permutation;
+  for (xla::int64 i = 0; i < shape.rank(); ++i) {
+    permutation.push_back(i < dim ? i : (i == dim ? shape.rank() - 1 : i - 1));
+  }
+  return xla::Transpose(result, permutation);
+}
+
 struct BatchInput {
   xla::XlaOp batch_input;
   xla::int64 original_rank;
@@ -106,11 +182,12 @@ xla::XlaOp RemoveTrivialBatch(xla::XlaOp batch, xla::int64 original_rank,
 std::vector<std::pair<xla::int64, xla::int64>> CeilModePadding(
     absl::Span<const xla::int64> padding, const xla::Shape& input_shape,
     absl::Span<const xla::int64> kernel_size,
-    absl::Span<const xla::int64> stride, bool ceil_mode) {
+    absl::Span<const xla::int64> stride, bool ceil_mode,
+    xla::int64 spatial_dim_offset = 2) {
   std::vector<std::pair<xla::int64, xla::int64>> ceil_mode_padding;
   for (int i = 0; i < padding.size(); ++i) {
     xla::int64 left_padding = padding[i];
-    xla::int64 input_size = input_shape.dimensions(2 + i);
+    xla::int64 input_size = input_shape.dimensions(spatial_dim_offset + i);
     xla::int64 output_size_rem =
         (input_size + 2 * left_padding - kernel_size[i]) % stride[i];
     xla::int64 right_padding = left_padding;
@@ -126,13 +203,15 @@ std::vector<std::pair<xla::int64, xla::int64>> CeilModePadding(
 xla::PaddingConfig MakeXlaPaddingConfig(
     absl::Span<const xla::int64> padding, const xla::Shape& input_shape,
     absl::Span<const xla::int64> kernel_size,
-    absl::Span<const xla::int64> stride, bool ceil_mode) {
+    absl::Span<const xla::int64> stride, bool ceil_mode,
+    bool channels_last = false) {
   xla::PaddingConfig padding_config;
-  for (int i = 0; i < 2; ++i) {
+  for (int i = 0; i < (channels_last ? 1 : 2); ++i) {
     padding_config.add_dimensions();
   }
   const auto ceil_mode_padding =
-      CeilModePadding(padding, input_shape, kernel_size, stride, ceil_mode);
+      CeilModePadding(padding, input_shape, kernel_size, stride, ceil_mode,
+                      /*spatial_dim_offset=*/channels_last ? 1 : 2);
   for (int i = 0; i < padding.size(); ++i) {
     xla::PaddingConfig::PaddingConfigDimension* dims =
         padding_config.add_dimensions();
@@ -140,47 +219,42 @@ xla::PaddingConfig MakeXlaPaddingConfig(
     dims->set_edge_padding_low(dim_padding.first);
     dims->set_edge_padding_high(dim_padding.second);
   }
+  if (channels_last) {
+    padding_config.add_dimensions();
+  }
   return padding_config;
 }
 
 }  // namespace
 
-bool IsSupportedAdaptiveAvgPool2d(absl::Span<const xla::int64> input_size,
-                                  absl::Span<const xla::int64> output_size) {
-  xla::int64 rank = input_size.size();
-  for (int spatial_dim = 0; spatial_dim < 2; ++spatial_dim) {
-    if (input_size[rank - 2 + spatial_dim] % output_size[spatial_dim] != 0) {
-      return false;
-    }
-  }
-  return true;
-}
-
 xla::XlaOp BuildMaxPoolNd(xla::XlaOp input, xla::int64 spatial_dim_count,
                           absl::Span<const xla::int64> kernel_size,
                           absl::Span<const xla::int64> stride,
-                          absl::Span<const xla::int64> padding,
-                          bool ceil_mode) {
+                          absl::Span<const xla::int64> padding, bool ceil_mode,
+                          bool channels_last) {
   xla::XlaBuilder* builder = input.builder();
   BatchInput batch_input_info = CreateBatchInput(input, spatial_dim_count);
+  XLA_CHECK(!channels_last ||
+            batch_input_info.original_rank == spatial_dim_count + 2)
+      << "Channels-last pooling requires a batch dimension";
   const xla::Shape& input_shape =
       XlaHelpers::ShapeOfXlaOp(batch_input_info.batch_input);
   xla::Literal init_value =
       xla::LiteralUtil::MinValue(input_shape.element_type());
   xla::XlaOp xla_init_value = xla::ConstantLiteral(builder, init_value);
   xla::PaddingConfig padding_config = MakeXlaPaddingConfig(
-      padding, input_shape, kernel_size, stride, ceil_mode);
+      padding, input_shape, kernel_size, stride, ceil_mode, channels_last);
   xla::XlaOp padded_input =
       xla::Pad(batch_input_info.batch_input, xla_init_value, padding_config);
   PoolingOpAttributes pooling_op_attributes =
       MakePoolingOpAttributes(/*kernel_size_attr=*/kernel_size,
-                              /*stride_attr=*/stride);
+                              /*stride_attr=*/stride, channels_last);
   xla::XlaOp batch_result = xla::MaxPool(
       /*operand=*/padded_input,
       /*kernel_size=*/pooling_op_attributes.kernel_size,
       /*stride=*/pooling_op_attributes.stride,
       /*padding=*/xla::Padding::kValid,
-      /*data_format=*/MakeNCHWFormat(spatial_dim_count));
+      /*data_format=*/MakeTensorFormat(spatial_dim_count, channels_last));
   return RemoveTrivialBatch(/*batch=*/batch_result,
                             /*original_rank=*/batch_input_info.original_rank,
                             /*spatial_dim_count=*/spatial_dim_count);
@@ -230,21 +304,25 @@ xla::XlaOp BuildAvgPoolNd(xla::XlaOp input, xla::int64 spatial_dim_count,
                           absl::Span<const xla::int64> kernel_size,
                           absl::Span<const xla::int64> stride,
                           absl::Span<const xla::int64> padding, bool ceil_mode,
-                          bool count_include_pad) {
+                          bool count_include_pad, bool channels_last) {
   PoolingOpAttributes pooling_op_attributes =
       MakePoolingOpAttributes(/*kernel_size_attr=*/kernel_size,
-                              /*stride_attr=*/stride);
+                              /*stride_attr=*/stride, channels_last);
   BatchInput batch_input_info = CreateBatchInput(input, spatial_dim_count);
+  XLA_CHECK(!channels_last ||
+            batch_input_info.original_rank == spatial_dim_count + 2)
+      << "Channels-last pooling requires a batch dimension";
   const xla::Shape& input_shape =
       XlaHelpers::ShapeOfXlaOp(batch_input_info.batch_input);
   const auto ceil_mode_padding =
-      CeilModePadding(padding, input_shape, kernel_size, stride, ceil_mode);
+      CeilModePadding(padding, input_shape, kernel_size, stride, ceil_mode,
+                      /*spatial_dim_offset=*/channels_last ? 1 : 2);
   xla::XlaOp batch_result = xla::AvgPool(
       /*operand=*/batch_input_info.batch_input,
       /*kernel_size=*/pooling_op_attributes.kernel_size,
       /*stride=*/pooling_op_attributes.stride,
       /*padding=*/ceil_mode_padding,
-      /*data_format=*/MakeNCHWFormat(spatial_dim_count),
+      /*data_format=*/MakeTensorFormat(spatial_dim_count, channels_last),
       /*counts_include_padding=*/count_include_pad);
   return RemoveTrivialBatch(/*batch=*/batch_result,
                             /*original_rank=*/batch_input_info.original_rank,
@@ -280,59 +358,115 @@ xla::XlaOp BuildAvgPoolNdBackward(xla::XlaOp out_backprop, xla::XlaOp input,
                             /*spatial_dim_count=*/spatial_dim_count);
 }
 
-xla::XlaOp BuildAdaptiveAvgPool2d(xla::XlaOp input,
+namespace {
+
+// Adaptive average pooling averages the bins of the spatial dimensions whose
+// input size is a multiple of the output size with a regular average pooling,
+// and the variable size bins of the other ones with AdaptiveAvgPoolDim().
+xla::XlaOp BuildAdaptiveAvgPoolNd(xla::XlaOp input,
                                   absl::Span<const xla::int64> output_size) {
-  XLA_CHECK_EQ(output_size.size(), 2) << "Invalid output size rank";
-  const auto input_size = XlaHelpers::SizesOfXlaOp(input);
-  XLA_CHECK(input_size.size() == 4 || input_size.size() == 3)
-      << "Only 4D or 3D tensors supported";
+  xla::int64 spatial_dim_count = output_size.size();
+  BatchInput batch_input_info = CreateBatchInput(input, spatial_dim_count);
+  const auto input_size =
+      XlaHelpers::SizesOfXlaOp(batch_input_info.batch_input);
   const auto kernel_size = AdaptiveAvgPoolKernelSize(input_size, output_size);
-  std::vector<std::pair<xla::int64, xla::int64>> no_padding(2);
-  BatchInput batch_input_info =
-      CreateBatchInput(input, /*spatial_dim_count=*/2);
-  xla::XlaOp batch_result = xla::AvgPool(
-      /*operand=*/batch_input_info.batch_input,
-      /*kernel_size=*/kernel_size,
-      /*stride=*/kernel_size,
-      /*padding=*/no_padding,
-      /*data_format=*/MakeNCHWFormat(2),
-      /*counts_include_padding=*/false);
+  xla::XlaOp batch_result = batch_input_info.batch_input;
+  if (!IsUnitKernel(kernel_size)) {
+    std::vector<std::pair<xla::int64, xla::int64>> no_padding(
+        spatial_dim_count);
+    batch_result = xla::AvgPool(
+        /*operand=*/batch_result,
+        /*kernel_size=*/kernel_size,
+        /*stride=*/kernel_size,
+        /*padding=*/no_padding,
+        /*data_format=*/MakeNCHWFormat(spatial_dim_count),
+        /*counts_include_padding=*/false);
+  }
+  for (xla::int64 spatial_dim = 0; spatial_dim < spatial_dim_count;
+       ++spatial_dim) {
+    xla::int64 dim = 2 + spatial_dim;
+    if (input_size[dim] % output_size[spatial_dim] != 0) {
+      batch_result =
+          AdaptiveAvgPoolDim(batch_result, dim, input_size[dim],
+                             output_size[spatial_dim], /*transpose=*/false);
+    }
+  }
   return RemoveTrivialBatch(/*batch=*/batch_result,
                             /*original_rank=*/batch_input_info.original_rank,
-                            /*spatial_dim_count=*/2);
+                            /*spatial_dim_count=*/spatial_dim_count);
 }
 
-xla::XlaOp BuildAdaptiveAvgPool2dBackward(xla::XlaOp out_backprop,
-                                          xla::XlaOp input) {
+xla::XlaOp BuildAdaptiveAvgPoolNdBackward(xla::XlaOp out_backprop,
+                                          xla::XlaOp input,
+                                          xla::int64 spatial_dim_count) {
   BatchInput batch_out_backprop_info =
-      CreateBatchInput(/*input=*/out_backprop, /*spatial_dim_count=*/2);
+      CreateBatchInput(/*input=*/out_backprop, spatial_dim_count);
   const auto out_backprop_size =
       XlaHelpers::SizesOfXlaOp(batch_out_backprop_info.batch_input);
-  XLA_CHECK_EQ(out_backprop_size.size(), 4)
-      << "Invalid rank of gradient output";
-  std::vector<xla::int64> output_size{out_backprop_size[2],
-                                      out_backprop_size[3]};
+  std::vector<xla::int64> output_size(out_backprop_size.begin() + 2,
+                                      out_backprop_size.end());
   auto gradients_size = XlaHelpers::SizesOfXlaOp(input);
-  XLA_CHECK(gradients_size.size() == 4 || gradients_size.size() == 3)
-      << "Only 4D or 3D tensors supported";
-  if (gradients_size.size() == 3) {
+  XLA_CHECK(gradients_size.size() == spatial_dim_count + 2 ||
+            gradients_size.size() == spatial_dim_count + 1)
+      << "Only " << spatial_dim_count + 2 << "D or " << spatial_dim_count + 1
+      << "D tensors supported";
+  if (gradients_size.size() == spatial_dim_count + 1) {
     gradients_size.insert(gradients_size.begin(), 1);
   }
   const auto kernel_size =
       AdaptiveAvgPoolKernelSize(gradients_size, output_size);
-  std::vector<std::pair<xla::int64, xla::int64>> no_padding(2);
-  xla::XlaOp batch_result = xla::AvgPoolGrad(
-      /*out_backprop=*/batch_out_backprop_info.batch_input,
-      /*gradients_size=*/gradients_size,
-      /*kernel_size=*/kernel_size,
-      /*stride=*/kernel_size,
-      /*spatial_padding=*/no_padding,
-      /*data_format=*/MakeNCHWFormat(2),
-      /*counts_include_padding=*/false);
+  xla::XlaOp batch_result = batch_out_backprop_info.batch_input;
+  for (xla::int64 spatial_dim = 0; spatial_dim < spatial_dim_count;
+       ++spatial_dim) {
+    xla::int64 dim = 2 + spatial_dim;
+    if (gradients_size[dim] % output_size[spatial_dim] != 0) {
+      batch_result =
+          AdaptiveAvgPoolDim(batch_result, dim, gradients_size[dim],
+                             output_size[spatial_dim], /*transpose=*/true);
+    }
+  }
+  if (!IsUnitKernel(kernel_size)) {
+    std::vector<std::pair<xla::int64, xla::int64>> no_padding(
+        spatial_dim_count);
+    batch_result = xla::AvgPoolGrad(
+        /*out_backprop=*/batch_result,
+        /*gradients_size=*/gradients_size,
+        /*kernel_size=*/kernel_size,
+        /*stride=*/kernel_size,
+        /*spatial_padding=*/no_padding,
+        /*data_format=*/MakeNCHWFormat(spatial_dim_count),
+        /*counts_include_padding=*/false);
+  }
   return RemoveTrivialBatch(
       /*batch=*/batch_result,
       /*original_rank=*/batch_out_backprop_info.original_rank,
-      /*spatial_dim_count=*/2);
+      /*spatial_dim_count=*/spatial_dim_count);
+}
+
+}  // namespace
+
+xla::XlaOp BuildAdaptiveAvgPool2d(xla::XlaOp input,
+                                  absl::Span<const xla::int64> output_size) {
+  XLA_CHECK_EQ(output_size.size(), 2) << "Invalid output size rank";
+  return BuildAdaptiveAvgPoolNd(input, output_size);
+}
+
+xla::XlaOp BuildAdaptiveAvgPool2dBackward(xla::XlaOp out_backprop,
+                                          xla::XlaOp input) {
+  return BuildAdaptiveAvgPoolNdBackward(out_backprop, input,
+                                        /*spatial_dim_count=*/2);
+}
+
+xla::XlaOp BuildAdaptiveAvgPool3d(xla::XlaOp input,
+                                  absl::Span<const xla::int64> output_size) {
+  XLA_CHECK_EQ(output_size.size(), 3) << "Invalid output size rank";
+  return BuildAdaptiveAvgPoolNd(input, output_size);
+}
+
+xla::XlaOp BuildAdaptiveAvgPool3dBackward(xla::XlaOp out_backprop,
+                                          xla::XlaOp input) {
+  return BuildAdaptiveAvgPoolNdBackward(out_backprop, input,
+                                        /*spatial_dim_count=*/3);
 }
 
 }  // namespace torch_xla
@@ -5,11 +5,13 @@
 
 namespace torch_xla {
 
-// Computes max pooling for the given input.
+// Computes max pooling for the given input. If channels_last is true, the input
+// (which must have the batch dimension) and the result use the NHWC layout.
 xla::XlaOp BuildMaxPoolNd(xla::XlaOp input, xla::int64 spatial_dim_count,
                           absl::Span<const xla::int64> kernel_size,
                           absl::Span<const xla::int64> stride,
-                          absl::Span<const xla::int64> padding, bool ceil_mode);
+                          absl::Span<const xla::int64> padding, bool ceil_mode,
+                          bool channels_last = false);
 
 // Computes the gradient for max pooling.
 xla::XlaOp BuildMaxPoolNdBackward(xla::XlaOp out_backprop, xla::XlaOp input,
@@ -19,12 +21,13 @@ xla::XlaOp BuildMaxPoolNdBackward(xla::XlaOp out_backprop, xla::XlaOp input,
                                   absl::Span<const xla::int64> padding,
                                   bool ceil_mode);
 
-// Computes average pooling for the given input.
+// Computes average pooling for the given input. The channels_last argument has
+// the same meaning as for BuildMaxPoolNd().
 xla::XlaOp BuildAvgPoolNd(xla::XlaOp input, xla::int64 spatial_dim_count,
                           absl::Span<const xla::int64> kernel_size,
                           absl::Span<const xla::int64> stride,
                           absl::Span<const xla::int64> padding, bool ceil_mode,
-                          bool count_include_pad);
+                          bool count_include_pad, bool channels_last = false);
 
 // Computes the gradient for average pooling.
 xla::XlaOp BuildAvgPoolNdBackward(xla::XlaOp out_backprop, xla::XlaOp input,
@@ -34,7 +37,8 @@ xla::XlaOp BuildAvgPoolNdBackward(xla::XlaOp out_backprop, xla::XlaOp input,
                                   absl::Span<const xla::int64> padding,
                                   bool ceil_mode, bool count_include_pad);
 
-// Computes adaptive average pooling for the given input and output size.
+// Computes adaptive average pooling for the given input and output size. The
+// spatial input sizes do not need to be multiples of the output ones.
 xla::XlaOp BuildAdaptiveAvgPool2d(xla::XlaOp input,
                                   absl::Span<const xla::int64> output_size);
 
@@ -42,9 +46,12 @@ xla::XlaOp BuildAdaptiveAvgPool2d(xla::XlaOp input,
 xla::XlaOp BuildAdaptiveAvgPool2dBackward(xla::XlaOp out_backprop,
                                           xla::XlaOp input);
 
-// Returns true if XLA lowering is supported for the given input and output size
-// combination.
-bool IsSupportedAdaptiveAvgPool2d(absl::Span<const xla::int64> input_size,
+// Computes 3D adaptive average pooling, like BuildAdaptiveAvgPool2d() does.
+xla::XlaOp BuildAdaptiveAvgPool3d(xla::XlaOp input,
                                   absl::Span<const xla::int64> output_size);
 
+// Computes the gradient for 3D adaptive average pooling.
+xla::XlaOp BuildAdaptiveAvgPool3dBackward(xla::XlaOp out_backprop,
+                                          xla::XlaOp input);
+
 }  // namespace torch_xla
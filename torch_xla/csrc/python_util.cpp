@@ -5,7 +5,56 @@
 #include <pybind11/pybind11.h>
 #include <torch/csrc/utils/python_strings.h>
 
+#include <unordered_map>
+
 namespace torch_xla {
+namespace {
+
+// The code objects referenced by the frame tokens. They are kept alive (they
+// are few, one per traced Python function), and are only accessed while
+// holding the GIL, which protects the table as well.
+struct CodeTable {
+  struct Entry {
+    PyCodeObject* code = nullptr;
+    // Unpacked on the first resolution.
+    std::string file;
+    std::string function;
+    bool resolved = false;
+  };
+
+  int32_t Intern(PyCodeObject* code) {
+    auto it = code_indices.find(code);
+    if (it != code_indices.end()) {
+      return it->second;
+    }
+    Py_INCREF(code);
+    int32_t index = static_cast<int32_t>(entries.size());
+    entries.emplace_back();
+    entries.back().code = code;
+    code_indices.emplace(code, index);
+    return index;
+  }
+
+  const Entry& Resolve(int32_t index) {
+    Entry& entry = entries.at(index);
+    if (!entry.resolved) {
+      entry.file = THPUtils_unpackString(entry.code->co_filename);
+      entry.function = THPUtils_unpackString(entry.code->co_name);
+      entry.resolved = true;
+    }
+    return entry;
+  }
+
+  std::unordered_map<PyCodeObject*, int32_t> code_indices;
+  std::vector<Entry> entries;
+};
+
+CodeTable* GetCodeTable() {
+  static CodeTable* table = new CodeTable();
+  return table;
+}
+
+}  // namespace
 
 c10::optional<SourceLocation> GetPythonFrameTop() {
   if (!Py_IsInitialized()) {
@@ -40,6 +89,43 @@ std::vector<SourceLocation> GetPythonFrames() {
   return frames;
 }
 
+std::vector<FrameToken> GetPythonFrameTokens(size_t max_frames) {
+  std::vector<FrameToken> tokens;
+  if (Py_IsInitialized()) {
+    pybind11::gil_scoped_acquire gil;
+    CodeTable* table = GetCodeTable();
+    PyFrameObject* frame = PyEval_GetFrame();
+    while (frame != nullptr &&
+           (max_frames == 0 || tokens.size() < max_frames)) {
+      FrameToken token;
+      token.code_index = table->Intern(frame->f_code);
+      token.lasti = frame->f_lasti;
+      tokens.push_back(token);
+      frame = frame->f_back;
+    }
+  }
+  return tokens;
+}
+
+std::vector<SourceLocation> ResolvePythonFrames(
+    absl::Span<const FrameToken> tokens) {
+  std::vector<SourceLocation> frames;
+  if (!tokens.empty() && Py_IsInitialized()) {
+    pybind11::gil_scoped_acquire gil;
+    CodeTable* table = GetCodeTable();
+    frames.reserve(tokens.size());
+    for (auto& token : tokens) {
+      const CodeTable::Entry& entry = table->Resolve(token.code_index);
+      SourceLocation loc;
+      loc.line = PyCode_Addr2Line(entry.code, token.lasti);
+      loc.file = entry.file;
+      loc.function = entry.function;
+      frames.push_back(std::move(loc));
+    }
+  }
+  return frames;
+}
+
 std::ostream& operator<<(std::ostream& stream,
                          const std::vector<SourceLocation>& frames) {
   stream << "Python Frames:\n";
@@ -2,10 +2,13 @@
 
 #include <c10/util/Optional.h>
 
+#include <cstdint>
 #include <iostream>
 #include <string>
 #include <vector>
 
+#include "absl/types/span.h"
+
 namespace torch_xla {
 
 struct SourceLocation {
@@ -14,10 +17,26 @@ struct SourceLocation {
   int line = -1;
 };
 
+// A compact reference to a Python frame, made of the interned code object
+// index and the bytecode offset within it, which can be resolved later into a
+// SourceLocation with ResolvePythonFrames().
+struct FrameToken {
+  int32_t code_index = -1;
+  int32_t lasti = -1;
+};
+
 c10::optional<SourceLocation> GetPythonFrameTop();
 
 std::vector<SourceLocation> GetPythonFrames();
 
+// Like GetPythonFrames(), but captures the frames as tokens, with no string
+// unpacking and no line number computation. At most max_frames frames are
+// captured, if max_frames is greater than zero.
+std::vector<FrameToken> GetPythonFrameTokens(size_t max_frames = 0);
+
+std::vector<SourceLocation> ResolvePythonFrames(
+    absl::Span<const FrameToken> tokens);
+
 std::ostream& operator<<(std::ostream& stream,
                          const std::vector<SourceLocation>& frames);
 
@@ -0,0 +1,144 @@
+#include "torch_xla/csrc/quantization.h"
+
+#include <functional>
+
+#include "tensorflow/compiler/xla/primitive_util.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "torch_xla/csrc/convert_ops.h"
+#include "torch_xla/csrc/convolution.h"
+#include "torch_xla/csrc/helpers.h"
+
+namespace torch_xla {
+namespace {
+
+using ProductFn = std::function<xla::XlaOp(xla::XlaOp, xla::XlaOp)>;
+
+// Broadcasts the [C] per channel value along the channel_dim of the shape.
+xla::XlaOp BroadcastChannels(xla::XlaOp value, const xla::Shape& shape,
+                             xla::int64 channel_dim) {
+  return xla::BroadcastInDim(value, shape.dimensions(), {channel_dim});
+}
+
+// Returns the quantized weight, minus its per output channel zero point, as
+// S32 values.
+xla::XlaOp WeightToAccumulator(xla::XlaOp weight,
+                               xla::XlaOp weight_zero_point) {
+  const xla::Shape& weight_shape = XlaHelpers::ShapeOfXlaOp(weight);
+  xla::XlaOp zero_point =
+      xla::ConvertElementType(weight_zero_point, xla::PrimitiveType::S32);
+  return xla::ConvertElementType(weight, xla::PrimitiveType::S32) -
+         BroadcastChannels(zero_point, weight_shape, 0);
+}
+
+xla::XlaOp BuildQuantizedProduct(
+    xla::XlaOp input, xla::XlaOp weight, xla::XlaOp weight_scale,
+    xla::XlaOp weight_zero_point, const absl::optional<xla::XlaOp>& bias,
+    const absl::optional<QuantizationParams>& input_params,
+    const absl::optional<QuantizationParams>& output_params,
+    xla::PrimitiveType output_type, xla::int64 channel_dim,
+    const ProductFn& product_fn) {
+  xla::XlaOp weight_values = WeightToAccumulator(weight, weight_zero_point);
+  xla::XlaOp result;
+  xla::XlaOp scale;
+  if (input_params) {
+    xla::PrimitiveType float_type = XlaHelpers::TypeOfXlaOp(weight_scale);
+    xla::XlaOp input_values = input;
+    if (xla::primitive_util::IsFloatingPointType(
+            XlaHelpers::TypeOfXlaOp(input))) {
+      input_values =
+          BuildQuantize(input, *input_params, xla::PrimitiveType::S32);
+    }
+    input_values =
+        xla::ConvertElementType(input_values, xla::PrimitiveType::S32) -
+        XlaHelpers::ScalarValue<xla::int64>(input_params->zero_point,
+                                            xla::PrimitiveType::S32,
+                                            input.builder());
+    result = xla::ConvertElementType(product_fn(input_values, weight_values),
+                                     float_type);
+    scale = weight_scale * XlaHelpers::ScalarValue<double>(
+                               input_params->scale, float_type,
+                               input.builder());
+  } else {
+    xla::PrimitiveType float_type = XlaHelpers::TypeOfXlaOp(input);
+    result = product_fn(input,
+                        xla::ConvertElementType(weight_values, float_type));
+    scale = xla::ConvertElementType(weight_scale, float_type);
+  }
+  // The weight scales are per output channel, so they are applied to the
+  // (much smaller) result, instead of the weight.
+  const xla::Shape& result_shape = XlaHelpers::ShapeOfXlaOp(result);
+  result = result * BroadcastChannels(scale, result_shape, channel_dim);
+  if (bias) {
+    result = result + BroadcastChannels(
+                          xla::ConvertElementType(
+                              *bias, result_shape.element_type()),
+                          result_shape, channel_dim);
+  }
+  if (output_params) {
+    result = BuildQuantize(result, *output_params, output_type);
+  }
+  return result;
+}
+
+}  // namespace
+
+xla::hash_t QuantizationParamsHash(
+    const absl::optional<QuantizationParams>& params) {
+  return params ? xla::util::MHash(params->scale, params->zero_point)
+                : xla::util::MHash(false);
+}
+
+xla::XlaOp BuildQuantize(xla::XlaOp input, const QuantizationParams& params,
+                         xla::PrimitiveType type) {
+  xla::PrimitiveType input_type = XlaHelpers::TypeOfXlaOp(input);
+  xla::XlaBuilder* builder = input.builder();
+  xla::XlaOp quantized =
+      xla::Round(input / XlaHelpers::ScalarValue<double>(params.scale,
+                                                         input_type, builder)) +
+      XlaHelpers::ScalarValue<xla::int64>(params.zero_point, input_type,
+                                          builder);
+  quantized = xla::Clamp(
+      XlaHelpers::ScalarValue<xla::int64>(-128, input_type, builder), quantized,
+      XlaHelpers::ScalarValue<xla::int64>(127, input_type, builder));
+  return xla::ConvertElementType(quantized, type);
+}
+
+xla::XlaOp BuildQuantizedMatMul(
+    xla::XlaOp input, xla::XlaOp weight, xla::XlaOp weight_scale,
+    xla::XlaOp weight_zero_point, const absl::optional<xla::XlaOp>& bias,
+    const absl::optional<QuantizationParams>& input_params,
+    const absl::optional<QuantizationParams>& output_params,
+    xla::PrimitiveType output_type) {
+  xla::int64 rank = XlaHelpers::ShapeOfXlaOp(input).rank();
+  auto product_fn = [rank](xla::XlaOp lhs, xla::XlaOp rhs) -> xla::XlaOp {
+    xla::DotDimensionNumbers dims;
+    dims.add_lhs_contracting_dimensions(rank - 1);
+    dims.add_rhs_contracting_dimensions(1);
+    xla::PrecisionConfig precision_config =
+        XlaHelpers::BuildPrecisionConfig(XlaHelpers::mat_mul_precision());
+    return xla::DotGeneral(lhs, rhs, dims, &precision_config);
+  };
+  return BuildQuantizedProduct(input, weight, weight_scale, weight_zero_point,
+                               bias, input_params, output_params, output_type,
+                               /*channel_dim=*/rank - 1, product_fn);
+}
+
+xla::XlaOp BuildQuantizedConvolution(
+    xla::XlaOp input, xla::XlaOp weight, xla::XlaOp weight_scale,
+    xla::XlaOp weight_zero_point, const absl::optional<xla::XlaOp>& bias,
+    absl::Span<const xla::int64> stride, absl::Span<const xla::int64> padding,
+    absl::Span<const xla::int64> dilation, xla::int64 groups,
+    const absl::optional<QuantizationParams>& input_params,
+    const absl::optional<QuantizationParams>& output_params,
+    xla::PrimitiveType output_type) {
+  auto product_fn = [&](xla::XlaOp lhs, xla::XlaOp rhs) -> xla::XlaOp {
+    return BuildConvolutionOverrideable(lhs, rhs, stride, padding, dilation,
+                                        /*transposed=*/false,
+                                        /*output_padding=*/{}, groups);
+  };
+  return BuildQuantizedProduct(input, weight, weight_scale, weight_zero_point,
+                               bias, input_params, output_params, output_type,
+                               /*channel_dim=*/1, product_fn);
+}
+
+}  // namespace torch_xla
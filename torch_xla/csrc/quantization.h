@@ -0,0 +1,52 @@
+#pragma once
+
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
+#include "tensorflow/compiler/xla/client/xla_builder.h"
+#include "tensorflow/compiler/xla/xla_client/types.h"
+
+namespace torch_xla {
+
+// The affine per tensor quantization of the activations, where the real value
+// is (quantized - zero_point) * scale.
+struct QuantizationParams {
+  double scale = 1.0;
+  xla::int64 zero_point = 0;
+};
+
+xla::hash_t QuantizationParamsHash(
+    const absl::optional<QuantizationParams>& params);
+
+// Quantizes the floating point input to int8 values, held by the type
+// element type (which is wider than S8 on the devices not supporting it).
+xla::XlaOp BuildQuantize(xla::XlaOp input, const QuantizationParams& params,
+                         xla::PrimitiveType type);
+
+// Multiplies the [..., K] input by the transposed [N, K] int8 weight, which
+// has the [N] per output channel scale and zero point.
+// With input_params, the input (quantized with them, or quantized on the fly
+// if it is floating point) and the weight are multiplied with an int32
+// accumulation, and the result is rescaled to the scale type. Otherwise only
+// the weight is quantized, and it is converted to the input type before the
+// multiplication. The optional [N] bias is added to the floating point result,
+// which is then requantized to output_type values if output_params is given.
+xla::XlaOp BuildQuantizedMatMul(
+    xla::XlaOp input, xla::XlaOp weight, xla::XlaOp weight_scale,
+    xla::XlaOp weight_zero_point, const absl::optional<xla::XlaOp>& bias,
+    const absl::optional<QuantizationParams>& input_params,
+    const absl::optional<QuantizationParams>& output_params,
+    xla::PrimitiveType output_type);
+
+// Same as BuildQuantizedMatMul() for a (non transposed) convolution of the NCHW
+// input with the [O, I / groups, ...] int8 weight, with O channel scales and
+// zero points.
+xla::XlaOp BuildQuantizedConvolution(
+    xla::XlaOp input, xla::XlaOp weight, xla::XlaOp weight_scale,
+    xla::XlaOp weight_zero_point, const absl::optional<xla::XlaOp>& bias,
+    absl::Span<const xla::int64> stride, absl::Span<const xla::int64> padding,
+    absl::Span<const xla::int64> dilation, xla::int64 groups,
+    const absl::optional<QuantizationParams>& input_params,
+    const absl::optional<QuantizationParams>& output_params,
+    xla::PrimitiveType output_type);
+
+}  // namespace torch_xla
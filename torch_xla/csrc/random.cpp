@@ -119,6 +119,13 @@ xla::XlaOp RngUniform(xla::XlaOp seed, const xla::Shape& shape,
   }
 }
 
+xla::XlaOp RngBits(xla::XlaOp seed, const xla::Shape& shape) {
+  xla::XlaOp rng_seed = MakeSeed(seed);
+  xla::XlaOp initial_state =
+      xla::Zero(rng_seed.builder(), xla::PrimitiveType::U64);
+  return GetBitGenerator()(rng_seed, initial_state, shape).value;
+}
+
 xla::XlaOp RngNormal(xla::XlaOp seed, const xla::Shape& shape, xla::XlaOp mean,
                      xla::XlaOp std) {
   xla::XlaOp rng_seed = MakeSeed(seed);
@@ -7,6 +7,10 @@ namespace torch_xla {
 xla::XlaOp RngUniform(xla::XlaOp seed, const xla::Shape& shape,
                       xla::XlaOp minval, xla::XlaOp maxval);
 
+// Returns the raw bits drawn by the random bit generator, for an integral
+// shape (like U32).
+xla::XlaOp RngBits(xla::XlaOp seed, const xla::Shape& shape);
+
 xla::XlaOp RngNormal(xla::XlaOp seed, const xla::Shape& shape, xla::XlaOp mean,
                      xla::XlaOp std);
 
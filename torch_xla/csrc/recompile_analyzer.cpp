@@ -0,0 +1,158 @@
+#include "torch_xla/csrc/recompile_analyzer.h"
+
+#include <algorithm>
+#include <sstream>
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/tf_logging.h"
+#include "torch_xla/csrc/ops/device_data.h"
+
+namespace torch_xla {
+namespace {
+
+static const size_t kMaxNodeTextSize = 160;
+static const size_t kMaxReportedDiffs = 8;
+static const size_t kMaxReports = 16;
+
+}  // namespace
+
+RecompileAnalyzer::RecompileAnalyzer(size_t max_graphs)
+    : max_graphs_(max_graphs) {}
+
+RecompileAnalyzer* RecompileAnalyzer::Get() {
+  static RecompileAnalyzer* analyzer = []() -> RecompileAnalyzer* {
+    xla::int64 max_graphs =
+        xla::sys_util::GetEnvInt("XLA_RECOMPILE_ANALYSIS_GRAPHS", 0);
+    return max_graphs > 0 ? new RecompileAnalyzer(max_graphs) : nullptr;
+  }();
+  return analyzer;
+}
+
+std::string RecompileAnalyzer::AnalyzeCompile(
+    const xla::hash_t& hash, absl::Span<const ir::Node* const> post_order) {
+  GraphSignature graph = MakeSignature(hash, post_order);
+  std::lock_guard<std::mutex> lock(lock_);
+  // The nearest graph is the one with the most node signatures matching in
+  // post order position, preferring the most recent on ties.
+  const GraphSignature* nearest = nullptr;
+  size_t nearest_matches = 0;
+  for (auto it = graphs_.rbegin(); it != graphs_.rend(); ++it) {
+    size_t num_nodes = std::min(it->nodes.size(), graph.nodes.size());
+    size_t matches = 0;
+    for (size_t i = 0; i < num_nodes; ++i) {
+      if (it->nodes[i].node_hash == graph.nodes[i].node_hash) {
+        ++matches;
+      }
+    }
+    if (nearest == nullptr || matches > nearest_matches) {
+      nearest = &(*it);
+      nearest_matches = matches;
+    }
+  }
+  std::string report;
+  if (nearest != nullptr) {
+    XLA_COUNTER("RecompileAnalysis", 1);
+    report = CreateReport(graph, *nearest);
+    TF_LOG(INFO) << report;
+    reports_.push_back(report);
+    if (reports_.size() > kMaxReports) {
+      reports_.pop_front();
+    }
+  }
+  graphs_.push_back(std::move(graph));
+  if (graphs_.size() > max_graphs_) {
+    graphs_.pop_front();
+  }
+  return report;
+}
+
+std::vector<std::string> RecompileAnalyzer::GetReports() {
+  std::lock_guard<std::mutex> lock(lock_);
+  return std::vector<std::string>(reports_.begin(), reports_.end());
+}
+
+RecompileAnalyzer::GraphSignature RecompileAnalyzer::MakeSignature(
+    const xla::hash_t& hash, absl::Span<const ir::Node* const> post_order) {
+  GraphSignature graph;
+  graph.hash = hash;
+  graph.nodes.reserve(post_order.size());
+  int num_inputs = 0;
+  for (auto node : post_order) {
+    NodeSignature signature;
+    signature.node_hash = node->node_hash();
+    signature.op = node->op().ToString();
+    signature.shape = xla::ShapeUtil::HumanString(node->shape());
+    signature.text = node->ToString().substr(0, kMaxNodeTextSize);
+    std::vector<SourceLocation> frames =
+        node->metadata().GetFrameInfo(/*max_frames=*/1);
+    if (!frames.empty()) {
+      signature.frame = absl::StrCat(frames.front().function, " (",
+                                     frames.front().file, ":",
+                                     frames.front().line, ")");
+    }
+    if (ir::ops::DeviceData::Cast(node) != nullptr) {
+      signature.input_index = num_inputs;
+      ++num_inputs;
+    }
+    graph.nodes.push_back(std::move(signature));
+  }
+  return graph;
+}
+
+std::string RecompileAnalyzer::CreateReport(const GraphSignature& graph,
+                                            const GraphSignature& nearest) {
+  std::stringstream diffs;
+  size_t num_nodes = std::min(graph.nodes.size(), nearest.nodes.size());
+  size_t num_diffs = 0;
+  for (size_t i = 0; i < num_nodes; ++i) {
+    const NodeSignature& node = graph.nodes[i];
+    const NodeSignature& other = nearest.nodes[i];
+    if (node.node_hash == other.node_hash) {
+      continue;
+    }
+    ++num_diffs;
+    if (num_diffs > kMaxReportedDiffs) {
+      continue;
+    }
+    if (node.input_index >= 0) {
+      diffs << "  input " << node.input_index;
+    } else {
+      diffs << "  node " << i;
+    }
+    diffs << " (" << node.op << "): ";
+    if (node.op != other.op) {
+      diffs << "op changed from " << other.op;
+    } else if (node.shape != other.shape) {
+      diffs << "shape changed from " << other.shape << " to " << node.shape;
+    } else {
+      diffs << "attributes changed from '" << other.text << "' to '"
+            << node.text << "'";
+    }
+    diffs << "\n";
+    if (!node.frame.empty()) {
+      diffs << "    at " << node.frame << "\n";
+    }
+  }
+  std::stringstream ss;
+  ss << "Recompiling graph " << xla::util::HexHash(graph.hash) << " ("
+     << graph.nodes.size() << " nodes), nearest compiled graph is "
+     << xla::util::HexHash(nearest.hash) << " (" << nearest.nodes.size()
+     << " nodes), with " << num_diffs << " differing nodes";
+  if (num_diffs > kMaxReportedDiffs) {
+    ss << " (showing the first " << kMaxReportedDiffs << ")";
+  }
+  ss << ":\n" << diffs.str();
+  if (graph.nodes.size() != nearest.nodes.size()) {
+    ss << "  the graph has " << graph.nodes.size() << " nodes instead of "
+       << nearest.nodes.size() << "\n";
+  } else if (num_diffs == 0) {
+    ss << "  all the nodes match, the graphs differ in how their inputs share "
+          "device data, or in the sync configuration\n";
+  }
+  return ss.str();
+}
+
+}  // namespace torch_xla
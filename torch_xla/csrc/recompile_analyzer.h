@@ -0,0 +1,64 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "torch_xla/csrc/ir.h"
+
+namespace torch_xla {
+
+// Keeps a compact structural signature of the last compiled graphs, so that
+// on a compilation cache miss the new graph can be diffed against the most
+// similar one already compiled, pointing to the nodes (and Python frames,
+// with XLA_IR_DEBUG) which caused the recompilation.
+class RecompileAnalyzer {
+ public:
+  explicit RecompileAnalyzer(size_t max_graphs);
+
+  // Returns the analyzer keeping the last XLA_RECOMPILE_ANALYSIS_GRAPHS
+  // compiled graphs, or nullptr if such variable is not set (or zero).
+  static RecompileAnalyzer* Get();
+
+  // Records the graph about to be compiled, and returns the report of its
+  // differences with the nearest previously compiled graph (empty if there
+  // was none).
+  std::string AnalyzeCompile(const xla::hash_t& hash,
+                             absl::Span<const ir::Node* const> post_order);
+
+  // Returns the most recent reports, from the oldest to the newer.
+  std::vector<std::string> GetReports();
+
+ private:
+  struct NodeSignature {
+    xla::hash_t node_hash = 0;
+    std::string op;
+    std::string shape;
+    std::string text;
+    std::string frame;
+    // The index of the node among the graph device data nodes, or -1 if it
+    // is not one.
+    int input_index = -1;
+  };
+
+  struct GraphSignature {
+    xla::hash_t hash = 0;
+    std::vector<NodeSignature> nodes;
+  };
+
+  static GraphSignature MakeSignature(
+      const xla::hash_t& hash, absl::Span<const ir::Node* const> post_order);
+
+  static std::string CreateReport(const GraphSignature& graph,
+                                  const GraphSignature& nearest);
+
+  size_t max_graphs_;
+  std::mutex lock_;
+  std::deque<GraphSignature> graphs_;
+  std::deque<std::string> reports_;
+};
+
+}  // namespace torch_xla
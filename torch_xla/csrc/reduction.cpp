@@ -6,6 +6,7 @@
 #include "tensorflow/compiler/xla/client/lib/constants.h"
 #include "tensorflow/compiler/xla/literal_util.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "torch_xla/csrc/helpers.h"
 #include "torch_xla/csrc/tensor_util.h"
 
@@ -65,6 +66,29 @@ xla::XlaComputation CreateAnyComputation(xla::PrimitiveType type) {
   return ConsumeValue(builder.Build());
 }
 
+// Merges the (count, mean, M2) statistics of two sets of values, with the
+// parallel variant of the Welford algorithm, where M2 is the sum of the squared
+// differences from the mean. Unlike the sum of squares, it does not suffer from
+// cancellation when the mean is large compared to the deviation.
+xla::XlaComputation CreateWelfordComputation(xla::PrimitiveType type) {
+  xla::XlaBuilder builder("WelfordComputation");
+  xla::Shape shape = xla::ShapeUtil::MakeShape(type, {});
+  xla::XlaOp count_a = xla::Parameter(&builder, 0, shape, "count_a");
+  xla::XlaOp mean_a = xla::Parameter(&builder, 1, shape, "mean_a");
+  xla::XlaOp m2_a = xla::Parameter(&builder, 2, shape, "m2_a");
+  xla::XlaOp count_b = xla::Parameter(&builder, 3, shape, "count_b");
+  xla::XlaOp mean_b = xla::Parameter(&builder, 4, shape, "mean_b");
+  xla::XlaOp m2_b = xla::Parameter(&builder, 5, shape, "m2_b");
+  xla::XlaOp zero = xla::Zero(&builder, type);
+  xla::XlaOp count = count_a + count_b;
+  xla::XlaOp weight_b =
+      xla::Select(xla::Gt(count, zero), count_b / count, zero);
+  xla::XlaOp delta = mean_b - mean_a;
+  xla::Tuple(&builder, {count, mean_a + delta * weight_b,
+                        m2_a + m2_b + delta * delta * count_a * weight_b});
+  return ConsumeValue(builder.Build());
+}
+
 xla::XlaOp GetScaleValue(xla::XlaOp input, xla::XlaOp count,
                          xla::PrimitiveType type) {
   xla::XlaOp zero = xla::Zero(input.builder(), XlaHelpers::TypeOfXlaOp(count));
@@ -251,10 +275,28 @@ xla::XlaOp BuildMseLossBackward(xla::XlaOp grad_output, xla::XlaOp input,
   return d_input * grad_value;
 }
 
-xla::XlaOp BuildCumulativeComputation(xla::XlaOp input, xla::int64 dim,
-                                      const xla::XlaComputation& reducer,
-                                      xla::XlaOp init) {
+xla::XlaOp BuildCumulativeComputation(
+    xla::XlaOp input, xla::int64 dim, const xla::XlaComputation& reducer,
+    xla::XlaOp init,
+    const std::function<xla::XlaOp(xla::XlaOp, xla::XlaOp)>& combiner) {
+  // The window reduction does O(N^2) work on a dimension of size N, so from
+  // this size on the dimension is scanned in log2(N) elementwise steps, each
+  // combining every element with the one shift positions before it.
+  static const xla::int64 scan_min_size =
+      xla::sys_util::GetEnvInt("XLA_CUMULATIVE_SCAN_MIN_SIZE", 128);
   const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  xla::int64 size = input_shape.dimensions(dim);
+  if (scan_min_size > 0 && size >= scan_min_size) {
+    xla::XlaOp result = input;
+    for (xla::int64 shift = 1; shift < size; shift *= 2) {
+      xla::XlaOp head = xla::SliceInDim(result, 0, shift, 1, dim);
+      xla::XlaOp tail = xla::SliceInDim(result, shift, size, 1, dim);
+      xla::XlaOp prev = xla::SliceInDim(result, 0, size - shift, 1, dim);
+      result = xla::ConcatInDim(input.builder(), {head, combiner(prev, tail)},
+                                dim);
+    }
+    return result;
+  }
   std::vector<xla::int64> window_strides(input_shape.rank(), 1);
   std::vector<xla::int64> window_dims(input_shape.rank(), 1);
   window_dims[dim] = input_shape.dimensions(dim);
@@ -272,33 +314,55 @@ xla::XlaOp BuildMean(xla::XlaOp input, absl::Span<const xla::int64> dimensions,
       .result;
 }
 
+VarianceAndMean BuildVarianceAndMean(xla::XlaOp input,
+                                     absl::Span<const xla::int64> dimensions,
+                                     bool keep_reduced_dimensions,
+                                     bool unbiased) {
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  xla::PrimitiveType type = input_shape.element_type();
+  // The half precision types do not have enough mantissa bits to accumulate
+  // the statistics of large reductions.
+  xla::PrimitiveType accumulation_type =
+      type == xla::PrimitiveType::BF16 || type == xla::PrimitiveType::F16
+          ? xla::PrimitiveType::F32
+          : type;
+  xla::XlaOp zero = xla::Zero(input.builder(), accumulation_type);
+  xla::XlaOp one = xla::One(input.builder(), accumulation_type);
+  // Every input element is the statistics of a set made of itself only.
+  xla::XlaOp reduced = xla::Reduce(
+      input.builder(),
+      {xla::Broadcast(one, input_shape.dimensions()),
+       xla::ConvertElementType(input, accumulation_type),
+       xla::Broadcast(zero, input_shape.dimensions())},
+      {zero, zero, zero}, CreateWelfordComputation(accumulation_type),
+      dimensions);
+  xla::XlaOp count = xla::GetTupleElement(reduced, 0);
+  xla::XlaOp mean = xla::GetTupleElement(reduced, 1);
+  xla::XlaOp m2 = xla::GetTupleElement(reduced, 2);
+  VarianceAndMean result;
+  result.variance = xla::ConvertElementType(
+      GetScaleValue(m2, unbiased ? count - one : count, accumulation_type),
+      type);
+  result.mean = xla::ConvertElementType(
+      xla::Select(xla::Ne(count, zero), mean,
+                  xla::NanValue(input.builder(), accumulation_type)),
+      type);
+  if (keep_reduced_dimensions) {
+    ReductionInfo rinfo = GetReductionInfo(input, input_shape, dimensions,
+                                           keep_reduced_dimensions);
+    result.variance =
+        XlaHelpers::DynamicReshape(result.variance, rinfo.new_dimensions);
+    result.mean = XlaHelpers::DynamicReshape(result.mean, rinfo.new_dimensions);
+  }
+  return result;
+}
+
 xla::XlaOp BuildStdDeviation(xla::XlaOp input,
                              absl::Span<const xla::int64> dimensions,
                              bool keep_reduced_dimensions, bool unbiased) {
-  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
-  xla::XlaOp mean =
-      BuildMean(input, dimensions, /*keep_reduced_dimensions*/ true);
-  xla::XlaOp bcast_mean =
-      xla::BroadcastInDim(mean, input_shape.dimensions(),
-                          xla::util::Iota<xla::int64>(input_shape.rank()));
-  xla::XlaOp input_mean_diff = input - bcast_mean;
-  xla::XlaOp squared_var = input_mean_diff * input_mean_diff;
-  xla::XlaOp squared_result;
-  if (unbiased) {
-    SummationResult sum_result = CreateSummation(
-        squared_var, dimensions, keep_reduced_dimensions, /*scale=*/false);
-    squared_result = GetScaleValue(
-        sum_result.result,
-        sum_result.rinfo.element_count.size -
-            xla::One(input.builder(), XlaHelpers::TypeOfXlaOp(
-                                          sum_result.rinfo.element_count.size)),
-        input_shape.element_type());
-  } else {
-    SummationResult sum_result = CreateSummation(
-        squared_var, dimensions, keep_reduced_dimensions, /*scale=*/true);
-    squared_result = sum_result.result;
-  }
-  return xla::Sqrt(squared_result);
+  return xla::Sqrt(BuildVarianceAndMean(input, dimensions,
+                                        keep_reduced_dimensions, unbiased)
+                       .variance);
 }
 
 xla::XlaOp BuildSum(xla::XlaOp input, absl::Span<const xla::int64> dimensions,
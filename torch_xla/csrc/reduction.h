@@ -1,5 +1,7 @@
 #pragma once
 
+#include <functional>
+
 #include "absl/types/span.h"
 #include "tensorflow/compiler/xla/client/xla_builder.h"
 
@@ -37,6 +39,23 @@ xla::XlaOp BuildMseLossBackward(xla::XlaOp grad_output, xla::XlaOp input,
 xla::XlaOp BuildMean(xla::XlaOp input, absl::Span<const xla::int64> dimensions,
                      bool keep_reduced_dimensions);
 
+struct VarianceAndMean {
+  xla::XlaOp variance;
+  xla::XlaOp mean;
+};
+
+// Builds the variance and the mean of the values by reducing all the
+// dimensions listed in dimensions, reading the input once with a single
+// variadic Welford reduction. The unbiased variance uses the Bessel
+// correction. If keep_reduced_dimensions is true, the reduced dimensions will
+// be retained, with value 1.
+VarianceAndMean BuildVarianceAndMean(xla::XlaOp input,
+                                     absl::Span<const xla::int64> dimensions,
+                                     bool keep_reduced_dimensions,
+                                     bool unbiased);
+
+// Builds the standard deviation, as the square root of the variance computed
+// by BuildVarianceAndMean().
 xla::XlaOp BuildStdDeviation(xla::XlaOp input,
                              absl::Span<const xla::int64> dimensions,
                              bool keep_reduced_dimensions, bool unbiased);
@@ -79,10 +98,12 @@ xla::XlaOp BuildProd(xla::XlaOp input, absl::Span<const xla::int64> dimensions,
                      bool keep_reduced_dimensions);
 
 // Compute the cumulative computation specified by "reducer" and "init" in the
-// given dimension "dim".
-xla::XlaOp BuildCumulativeComputation(xla::XlaOp input, xla::int64 dim,
-                                      const xla::XlaComputation& reducer,
-                                      xla::XlaOp init);
+// given dimension "dim". The "combiner" applies the same operation as the
+// "reducer", elementwise, and is used to scan the long dimensions.
+xla::XlaOp BuildCumulativeComputation(
+    xla::XlaOp input, xla::int64 dim, const xla::XlaComputation& reducer,
+    xla::XlaOp init,
+    const std::function<xla::XlaOp(xla::XlaOp, xla::XlaOp)>& combiner);
 
 xla::XlaOp BuildAll(xla::XlaOp input, absl::Span<const xla::int64> dimensions,
                     bool keep_reduced_dimensions);
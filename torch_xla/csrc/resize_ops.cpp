@@ -18,14 +18,174 @@ std::string GetBackendConfig(bool align_corners, bool half_pixel_centers) {
   return absl::StrCat("\"", align_corners, half_pixel_centers, "\"");
 }
 
-double ResizeFactor(const xla::Shape& input_shape,
-                    const xla::Shape& output_shape, int dim) {
-  return static_cast<double>(input_shape.dimensions(dim)) /
-         static_cast<double>(output_shape.dimensions(dim));
+double ResizeFactor(xla::int64 input_size, xla::int64 output_size) {
+  return static_cast<double>(input_size) / static_cast<double>(output_size);
+}
+
+bool IsNearestTarget(const std::string& target) {
+  if (target == "ResizeNearest" || target == "ResizeNearestGrad") {
+    return true;
+  }
+  XLA_CHECK(target == "ResizeBilinear" || target == "ResizeBilinearGrad")
+      << "Unknown resize target: " << target;
+  return false;
+}
+
+xla::int64 HeightDim(bool channels_last) { return channels_last ? 1 : 2; }
+
+// Returns the NCHW shape in the layout of the lowered values.
+xla::Shape GetLayoutShape(const xla::Shape& shape, bool channels_last) {
+  if (!channels_last) {
+    return shape;
+  }
+  return xla::ShapeUtil::MakeShape(
+      shape.element_type(), {shape.dimensions(0), shape.dimensions(2),
+                             shape.dimensions(3), shape.dimensions(1)});
+}
+
+// The resize kernels interpolate dimensions 1 and 2, with the channels as
+// minor dimension. The two spatial dimensions are interpolated independently,
+// so NHWC values are resized as they are, while NCHW ones are transposed to
+// NWHC, and back.
+xla::XlaOp LowerCustomCall(const std::string& target, xla::XlaOp input,
+                           const xla::Shape& output_shape, bool channels_last,
+                           const std::string& backend_config,
+                           bool split_dims) {
+  if (channels_last) {
+    xla::Shape resized_shape = GetLayoutShape(output_shape, channels_last);
+    if (split_dims) {
+      xla::Shape partial_shape = resized_shape;
+      partial_shape.mutable_dimensions()[1] =
+          XlaHelpers::ShapeOfXlaOp(input).dimensions(1);
+      input = xla::CustomCall(input.builder(), target, {input}, partial_shape,
+                              backend_config);
+    }
+    return xla::CustomCall(input.builder(), target, {input}, resized_shape,
+                           backend_config);
+  }
+  std::vector<xla::int64> transpose_permute({0, 3, 2, 1});
+  auto inv_transpose_permute = xla::InversePermutation(transpose_permute);
+  xla::Shape resized_shape =
+      xla::ShapeUtil::PermuteDimensions(inv_transpose_permute, output_shape);
+  xla::XlaOp tinput = xla::Transpose(input, transpose_permute);
+  if (split_dims) {
+    xla::Shape partial_shape = resized_shape;
+    partial_shape.mutable_dimensions()[1] =
+        XlaHelpers::ShapeOfXlaOp(tinput).dimensions(1);
+    tinput = xla::CustomCall(input.builder(), target, {tinput}, partial_shape,
+                             backend_config);
+  }
+  xla::XlaOp resized = xla::CustomCall(input.builder(), target, {tinput},
+                                       resized_shape, backend_config);
+  return xla::Transpose(resized, inv_transpose_permute);
+}
+
+// Returns the [output_size, input_size] matrix whose rows hold the weights of
+// the input elements interpolated into every output element, following the
+// PyTorch source index computation.
+xla::XlaOp BuildInterpolationMatrix(xla::XlaBuilder* builder,
+                                    xla::int64 input_size,
+                                    xla::int64 output_size, bool nearest,
+                                    bool align_corners,
+                                    bool half_pixel_centers,
+                                    xla::PrimitiveType type) {
+  xla::Shape shape = xla::ShapeUtil::MakeShape(xla::PrimitiveType::F32,
+                                               {output_size, input_size});
+  xla::XlaOp output_index = xla::Iota(builder, shape, 0);
+  xla::XlaOp input_index = xla::Iota(builder, shape, 1);
+  xla::XlaOp zero = xla::Zero(builder, xla::PrimitiveType::F32);
+  xla::XlaOp one = xla::One(builder, xla::PrimitiveType::F32);
+  xla::XlaOp max_index = xla::ConstantR0<float>(builder, input_size - 1);
+  xla::XlaOp weights;
+  if (nearest) {
+    xla::XlaOp scale = xla::ConstantR0<float>(
+        builder, static_cast<float>(ResizeFactor(input_size, output_size)));
+    xla::XlaOp source = xla::Min(xla::Floor(output_index * scale), max_index);
+    weights = xla::ConvertElementType(xla::Eq(source, input_index),
+                                      xla::PrimitiveType::F32);
+  } else {
+    double scale_value = 0;
+    if (align_corners) {
+      if (output_size > 1) {
+        scale_value = static_cast<double>(input_size - 1) / (output_size - 1);
+      }
+    } else {
+      scale_value = ResizeFactor(input_size, output_size);
+    }
+    xla::XlaOp scale =
+        xla::ConstantR0<float>(builder, static_cast<float>(scale_value));
+    xla::XlaOp source;
+    if (half_pixel_centers) {
+      xla::XlaOp half = xla::ConstantR0<float>(builder, 0.5);
+      source = xla::Max((output_index + half) * scale - half, zero);
+    } else {
+      source = output_index * scale;
+    }
+    source = xla::Min(source, max_index);
+    // The two input elements around the source index get weights which
+    // linearly decrease with their distance from it.
+    weights = xla::Max(one - xla::Abs(source - input_index), zero);
+  }
+  return xla::ConvertElementType(weights, type);
+}
+
+// Contracts dim of input with weights_dim of the interpolation weights. The
+// other dimension of the weights becomes the last dimension of the result.
+xla::XlaOp InterpolateDim(xla::XlaOp input, xla::int64 dim,
+                          xla::XlaOp weights, xla::int64 weights_dim) {
+  xla::PrecisionConfig precision_config =
+      XlaHelpers::BuildPrecisionConfig(XlaHelpers::mat_mul_precision());
+  xla::DotDimensionNumbers dims;
+  dims.add_lhs_contracting_dimensions(dim);
+  dims.add_rhs_contracting_dimensions(weights_dim);
+  return xla::DotGeneral(input, weights, dims, &precision_config);
+}
+
+// Lowers the resize as the product of the input with the interpolation
+// matrices of its two spatial dimensions. The backward uses the same
+// matrices, contracted over their output dimension. Contracting the height
+// first, and then the width, yields the NCHW result without transposes.
+xla::XlaOp LowerInterpolation(xla::XlaOp input, const xla::Shape& output_shape,
+                              bool channels_last, bool nearest,
+                              bool align_corners, bool half_pixel_centers,
+                              bool backward) {
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  xla::int64 dim = HeightDim(channels_last);
+  xla::int64 input_height = input_shape.dimensions(dim);
+  xla::int64 input_width = input_shape.dimensions(dim + 1);
+  xla::int64 output_height = output_shape.dimensions(2);
+  xla::int64 output_width = output_shape.dimensions(3);
+  xla::XlaOp height_weights;
+  xla::XlaOp width_weights;
+  if (backward) {
+    height_weights = BuildInterpolationMatrix(
+        input.builder(), output_height, input_height, nearest, align_corners,
+        half_pixel_centers, input_shape.element_type());
+    width_weights = BuildInterpolationMatrix(
+        input.builder(), output_width, input_width, nearest, align_corners,
+        half_pixel_centers, input_shape.element_type());
+  } else {
+    height_weights = BuildInterpolationMatrix(
+        input.builder(), input_height, output_height, nearest, align_corners,
+        half_pixel_centers, input_shape.element_type());
+    width_weights = BuildInterpolationMatrix(
+        input.builder(), input_width, output_width, nearest, align_corners,
+        half_pixel_centers, input_shape.element_type());
+  }
+  xla::int64 weights_dim = backward ? 0 : 1;
+  // NCHW -> NCWH' -> NCH'W', or NHWC -> NWCH' -> NCH'W'.
+  xla::XlaOp output = InterpolateDim(
+      InterpolateDim(input, dim, height_weights, weights_dim), dim,
+      width_weights, weights_dim);
+  return channels_last ? xla::Transpose(output, {0, 2, 3, 1}) : output;
 }
 
 }  // namespace
 
+bool HasCustomCallLowering(const Device& device) {
+  return device.hw_type == DeviceType::TPU;
+}
+
 xla::Shape GetForwardOutputShape2d(const xla::Shape& input_shape,
                                    absl::Span<const xla::int64> output_size) {
   XLA_CHECK_EQ(output_size.size(), 2);
@@ -42,61 +202,57 @@ xla::Shape GetBackwardOutputShape2d(const xla::Shape& input_shape,
   return xla::ShapeUtil::MakeShape(input_shape.element_type(), input_size);
 }
 
-xla::XlaOp LowerForward2d(const std::string& target, xla::XlaOp input,
-                          const xla::Shape& output_shape, bool align_corners,
-                          bool half_pixel_centers) {
+xla::XlaOp LowerForward2d(const Device& device, const std::string& target,
+                          xla::XlaOp input, const xla::Shape& output_shape,
+                          bool align_corners, bool half_pixel_centers,
+                          bool channels_last) {
   const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
-  if (input_shape.dimensions(2) == output_shape.dimensions(2) &&
-      input_shape.dimensions(3) == output_shape.dimensions(3)) {
+  xla::int64 dim = HeightDim(channels_last);
+  if (input_shape.dimensions(dim) == output_shape.dimensions(2) &&
+      input_shape.dimensions(dim + 1) == output_shape.dimensions(3)) {
     return input;
   }
-  if (input_shape.dimensions(2) == 1 && input_shape.dimensions(3) == 1) {
-    return input + xla::Zeros(input.builder(), output_shape);
+  if (input_shape.dimensions(dim) == 1 &&
+      input_shape.dimensions(dim + 1) == 1) {
+    return input + xla::Zeros(input.builder(),
+                              GetLayoutShape(output_shape, channels_last));
   }
-  // XLA wants NHWC while PyTorch comes in as NCHW, so we need to transpose,
-  // call the kernel, and transpose back.
-  std::vector<xla::int64> transpose_permute({0, 3, 2, 1});
-  auto inv_transpose_permute = xla::InversePermutation(transpose_permute);
-  xla::Shape resized_shape =
-      xla::ShapeUtil::PermuteDimensions(inv_transpose_permute, output_shape);
-  xla::XlaOp tinput = xla::Transpose(input, transpose_permute);
-  xla::XlaOp resised =
-      xla::CustomCall(input.builder(), target, {tinput}, resized_shape,
-                      GetBackendConfig(align_corners, half_pixel_centers));
-  return xla::Transpose(resised, inv_transpose_permute);
+  if (!HasCustomCallLowering(device)) {
+    return LowerInterpolation(input, output_shape, channels_last,
+                              IsNearestTarget(target), align_corners,
+                              half_pixel_centers, /*backward=*/false);
+  }
+  return LowerCustomCall(target, input, output_shape, channels_last,
+                         GetBackendConfig(align_corners, half_pixel_centers),
+                         /*split_dims=*/false);
 }
 
-xla::XlaOp LowerBackward2d(const std::string& target, xla::XlaOp input,
-                           const xla::Shape& output_shape, bool align_corners,
-                           bool half_pixel_centers) {
+xla::XlaOp LowerBackward2d(const Device& device, const std::string& target,
+                           xla::XlaOp input, const xla::Shape& output_shape,
+                           bool align_corners, bool half_pixel_centers,
+                           bool channels_last) {
   static double resiple_split_factor =
       xla::sys_util::GetEnvDouble("XLA_RESIZE_SPLIT_FACTOR", 3.0);
   const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
-  if (input_shape.dimensions(2) == output_shape.dimensions(2) &&
-      input_shape.dimensions(3) == output_shape.dimensions(3)) {
+  xla::int64 dim = HeightDim(channels_last);
+  if (input_shape.dimensions(dim) == output_shape.dimensions(2) &&
+      input_shape.dimensions(dim + 1) == output_shape.dimensions(3)) {
     return input;
   }
-  // XLA wants NHWC while PyTorch comes in as NCHW, so we need to transpose,
-  // call the kernel, and transpose back.
-  std::vector<xla::int64> transpose_permute({0, 3, 2, 1});
-  auto inv_transpose_permute = xla::InversePermutation(transpose_permute);
-  xla::Shape resized_shape =
-      xla::ShapeUtil::PermuteDimensions(inv_transpose_permute, output_shape);
-  xla::XlaOp tinput = xla::Transpose(input, transpose_permute);
-  std::string backend_config =
-      GetBackendConfig(align_corners, half_pixel_centers);
-  if (ResizeFactor(input_shape, output_shape, 2) > resiple_split_factor &&
-      ResizeFactor(input_shape, output_shape, 3) > resiple_split_factor) {
-    // If the resize is too large, do one dimension at a time.
-    xla::Shape partial_shape = resized_shape;
-    // Partial shape is in NHWC, while input shape is in NCHW.
-    partial_shape.mutable_dimensions()[1] = input_shape.dimensions(2);
-    tinput = xla::CustomCall(input.builder(), target, {tinput}, partial_shape,
-                             backend_config);
+  if (!HasCustomCallLowering(device)) {
+    return LowerInterpolation(input, output_shape, channels_last,
+                              IsNearestTarget(target), align_corners,
+                              half_pixel_centers, /*backward=*/true);
   }
-  xla::XlaOp resised = xla::CustomCall(input.builder(), target, {tinput},
-                                       resized_shape, backend_config);
-  return xla::Transpose(resised, inv_transpose_permute);
+  // If the resize is too large, do one dimension at a time.
+  bool split_dims =
+      ResizeFactor(input_shape.dimensions(dim), output_shape.dimensions(2)) >
+          resiple_split_factor &&
+      ResizeFactor(input_shape.dimensions(dim + 1),
+                   output_shape.dimensions(3)) > resiple_split_factor;
+  return LowerCustomCall(target, input, output_shape, channels_last,
+                         GetBackendConfig(align_corners, half_pixel_centers),
+                         split_dims);
 }
 
 }  // namespace resize
@@ -4,23 +4,33 @@
 
 #include "absl/types/span.h"
 #include "tensorflow/compiler/xla/client/xla_builder.h"
+#include "torch_xla/csrc/device.h"
 
 namespace torch_xla {
 namespace resize {
 
+// Whether the resize operations are lowered with the CustomCall kernels,
+// which only the XLA TPU backend implements. The other backends get them
+// lowered as products with interpolation matrices.
+bool HasCustomCallLowering(const Device& device);
+
 xla::Shape GetForwardOutputShape2d(const xla::Shape& input_shape,
                                    absl::Span<const xla::int64> output_size);
 
 xla::Shape GetBackwardOutputShape2d(const xla::Shape& input_shape,
                                     absl::Span<const xla::int64> input_size);
 
-xla::XlaOp LowerForward2d(const std::string& target, xla::XlaOp input,
-                          const xla::Shape& output_shape, bool align_corners,
-                          bool half_pixel_centers);
-
-xla::XlaOp LowerBackward2d(const std::string& target, xla::XlaOp input,
-                           const xla::Shape& output_shape, bool align_corners,
-                           bool half_pixel_centers);
+// The output_shape is NCHW. If channels_last is true the input is NHWC, and so
+// is the result.
+xla::XlaOp LowerForward2d(const Device& device, const std::string& target,
+                          xla::XlaOp input, const xla::Shape& output_shape,
+                          bool align_corners, bool half_pixel_centers,
+                          bool channels_last);
+
+xla::XlaOp LowerBackward2d(const Device& device, const std::string& target,
+                           xla::XlaOp input, const xla::Shape& output_shape,
+                           bool align_corners, bool half_pixel_centers,
+                           bool channels_last);
 
 }  // namespace resize
 }  // namespace torch_xla
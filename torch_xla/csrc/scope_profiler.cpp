@@ -0,0 +1,189 @@
+#include "torch_xla/csrc/scope_profiler.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "torch_xla/csrc/op_by_op_executor.h"
+
+namespace torch_xla {
+namespace {
+
+struct OpSample {
+  const ir::Node* node = nullptr;
+  xla::int64 time_ns = 0;
+};
+
+// Nodes with the same scope and op kind, created at the same Python location,
+// are accounted to the same entry.
+std::string GetEntryKey(const ir::Node* node) {
+  const ir::MetaData& metadata = node->metadata();
+  std::string key = absl::StrCat(metadata.scope, "|", node->op().ToString());
+  if (!metadata.frame_tokens.empty()) {
+    absl::StrAppend(&key, "|", metadata.frame_tokens.front().code_index, ":",
+                    metadata.frame_tokens.front().lasti);
+  } else if (!metadata.frame_info.empty()) {
+    absl::StrAppend(&key, "|", metadata.frame_info.front().file, ":",
+                    metadata.frame_info.front().line);
+  }
+  return key;
+}
+
+std::string GetScopeName(const std::string& scope) {
+  return scope.empty() ? "<root>" : scope;
+}
+
+}  // namespace
+
+ScopeProfiler* ScopeProfiler::Get() {
+  static ScopeProfiler* profiler = new ScopeProfiler();
+  return profiler;
+}
+
+void ScopeProfiler::Start(xla::int64 num_steps) {
+  XLA_CHECK_GT(num_steps, 0);
+  std::lock_guard<std::mutex> lock(lock_);
+  remaining_steps_ = num_steps;
+}
+
+void ScopeProfiler::Stop() {
+  std::lock_guard<std::mutex> lock(lock_);
+  remaining_steps_ = 0;
+}
+
+bool ScopeProfiler::IsActive() {
+  std::lock_guard<std::mutex> lock(lock_);
+  return remaining_steps_ > 0;
+}
+
+void ScopeProfiler::MarkStep() {
+  std::lock_guard<std::mutex> lock(lock_);
+  if (remaining_steps_ > 0) {
+    remaining_steps_ -= 1;
+  }
+}
+
+void ScopeProfiler::ProfileGraph(absl::Span<const ir::Value> roots,
+                                 const std::string& device,
+                                 absl::Span<const std::string> devices) {
+  XLA_COUNTER("ScopeProfilerGraphs", 1);
+  std::vector<const ir::Node*> op_nodes;
+  auto ops = OpByOpExecutor::Get()->BuildOps(roots, device, devices, &op_nodes);
+  // The results of every op are released after their last use, so that the
+  // profiled graph does not need more memory than the op-by-op execution.
+  std::vector<size_t> last_uses(ops.size(), ops.size());
+  for (size_t i = 0; i < ops.size(); ++i) {
+    for (auto& input : ops[i].inputs) {
+      last_uses[input.op_index] = i;
+    }
+  }
+  xla::ComputationClient::ExecuteComputationOptions options;
+  std::vector<std::vector<xla::ComputationClient::DataPtr>> ops_results(
+      ops.size());
+  std::vector<OpSample> samples;
+  for (size_t i = 0; i < ops.size(); ++i) {
+    const xla::ComputationClient::ExecuteChainedOp& cxop = ops[i];
+    if (cxop.device_data != nullptr) {
+      ops_results[i].push_back(cxop.device_data);
+      continue;
+    }
+    std::vector<xla::ComputationClient::DataPtr> arguments;
+    for (auto& input : cxop.inputs) {
+      arguments.push_back(
+          ops_results[input.op_index][input.output_index.value_or(0)]);
+    }
+    xla::int64 start_ns = xla::sys_util::NowNs();
+    ops_results[i] = xla::ComputationClient::Get()->ExecuteComputation(
+        *cxop.computation, arguments, device, options);
+    samples.push_back({op_nodes[i], xla::sys_util::NowNs() - start_ns});
+    for (auto& input : cxop.inputs) {
+      if (last_uses[input.op_index] == i) {
+        ops_results[input.op_index].clear();
+      }
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(lock_);
+  for (auto& sample : samples) {
+    Entry& entry = entries_[GetEntryKey(sample.node)];
+    if (entry.count == 0) {
+      entry.op = sample.node->op().ToString();
+      entry.metadata = sample.node->metadata();
+    }
+    entry.count += 1;
+    entry.total_ns += sample.time_ns;
+  }
+}
+
+std::vector<const ScopeProfiler::Entry*> ScopeProfiler::GetSortedEntries()
+    const {
+  std::vector<const Entry*> entries;
+  for (auto& key_entry : entries_) {
+    entries.push_back(&key_entry.second);
+  }
+  std::stable_sort(entries.begin(), entries.end(),
+                   [](const Entry* a, const Entry* b) {
+                     return a->total_ns > b->total_ns;
+                   });
+  return entries;
+}
+
+std::string ScopeProfiler::GetReport() {
+  std::lock_guard<std::mutex> lock(lock_);
+  std::vector<const Entry*> entries = GetSortedEntries();
+  xla::int64 total_ns = 0;
+  for (auto entry : entries) {
+    total_ns += entry->total_ns;
+  }
+  std::stringstream ss;
+  ss << "Scope Profile:\n";
+  ss << "  Total: " << xla::metrics::MetricFnTime(total_ns) << "\n";
+  for (auto entry : entries) {
+    double share = total_ns > 0 ? 100.0 * entry->total_ns / total_ns : 0.0;
+    ss << "  " << GetScopeName(entry->metadata.scope) << " " << entry->op
+       << ": " << xla::metrics::MetricFnTime(entry->total_ns) << " ("
+       << std::fixed << std::setprecision(1) << share << "%) count "
+       << entry->count;
+    ss.unsetf(std::ios_base::fixed);
+    std::vector<SourceLocation> frames =
+        entry->metadata.GetFrameInfo(/*max_frames=*/1);
+    if (!frames.empty()) {
+      ss << " at " << frames.front().file << ":" << frames.front().line;
+    }
+    ss << "\n";
+  }
+  return ss.str();
+}
+
+std::string ScopeProfiler::GetFoldedStacks() {
+  std::lock_guard<std::mutex> lock(lock_);
+  std::stringstream ss;
+  for (auto entry : GetSortedEntries()) {
+    // The Python frames are innermost first, while folded stacks start from
+    // the outermost frame.
+    std::vector<SourceLocation> frames = entry->metadata.GetFrameInfo();
+    for (auto it = frames.rbegin(); it != frames.rend(); ++it) {
+      ss << it->function << " (" << it->file << ":" << it->line << ");";
+    }
+    if (!entry->metadata.scope.empty()) {
+      for (auto& scope : absl::StrSplit(entry->metadata.scope, '/')) {
+        ss << scope << ";";
+      }
+    }
+    ss << entry->op << " " << entry->total_ns << "\n";
+  }
+  return ss.str();
+}
+
+void ScopeProfiler::Reset() {
+  std::lock_guard<std::mutex> lock(lock_);
+  entries_.clear();
+}
+
+}  // namespace torch_xla
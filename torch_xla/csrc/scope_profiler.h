@@ -0,0 +1,66 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/xla/types.h"
+#include "torch_xla/csrc/ir.h"
+
+namespace torch_xla {
+
+// The ScopeProfiler class is a singleton accessible via its Get() API which
+// attributes the device time of the graphs executed within a window of steps
+// to the IR scopes, and Python frames, the IR nodes were created within.
+// The XRT client does not expose the device profiler traces, so the profiled
+// graphs are also run through the op-by-op executor (before their regular
+// execution), timing every op on its own. The times include the per op
+// dispatch overhead, so they are meant to rank the scopes and ops against
+// each other, rather than to measure the absolute fused graph time.
+class ScopeProfiler {
+ public:
+  static ScopeProfiler* Get();
+
+  // Profiles the graphs executed within the next num_steps steps.
+  void Start(xla::int64 num_steps);
+
+  void Stop();
+
+  bool IsActive();
+
+  // Closes a step of the profiling window.
+  void MarkStep();
+
+  void ProfileGraph(absl::Span<const ir::Value> roots,
+                    const std::string& device,
+                    absl::Span<const std::string> devices);
+
+  // Returns the per scope and op time table, sorted by decreasing time.
+  std::string GetReport();
+
+  // Returns the samples in the folded stacks format of the flame graph tools,
+  // one "frame;...;scope;...;op nanoseconds" line per scope and op.
+  std::string GetFoldedStacks();
+
+  void Reset();
+
+ private:
+  struct Entry {
+    std::string op;
+    // The metadata of the first sampled node, whose frames get resolved only
+    // when the reports are created.
+    ir::MetaData metadata;
+    xla::int64 count = 0;
+    xla::int64 total_ns = 0;
+  };
+
+  std::vector<const Entry*> GetSortedEntries() const;
+
+  std::mutex lock_;
+  xla::int64 remaining_steps_ = 0;
+  std::map<std::string, Entry> entries_;
+};
+
+}  // namespace torch_xla
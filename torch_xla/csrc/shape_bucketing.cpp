@@ -0,0 +1,79 @@
+#include "torch_xla/csrc/shape_bucketing.h"
+
+#include <algorithm>
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "torch_xla/csrc/helpers.h"
+
+namespace torch_xla {
+
+ShapeBucketing::ShapeBucketing(std::vector<xla::int64> dims,
+                               std::vector<xla::int64> bucket_sizes)
+    : dims_(std::move(dims)), bucket_sizes_(std::move(bucket_sizes)) {
+  for (auto size : bucket_sizes_) {
+    XLA_CHECK_GT(size, 0) << "Invalid bucket size: " << size;
+  }
+  std::sort(bucket_sizes_.begin(), bucket_sizes_.end());
+}
+
+xla::int64 ShapeBucketing::GetBucketSize(xla::int64 size) const {
+  if (bucket_sizes_.empty()) {
+    xla::int64 bucket_size = 1;
+    while (bucket_size < size) {
+      bucket_size *= 2;
+    }
+    return bucket_size;
+  }
+  auto it = std::lower_bound(bucket_sizes_.begin(), bucket_sizes_.end(), size);
+  if (it == bucket_sizes_.end()) {
+    XLA_COUNTER("ShapeBucketOverflow", 1);
+    return size;
+  }
+  return *it;
+}
+
+ShapeBucketing::Result ShapeBucketing::Pad(const at::Tensor& tensor,
+                                           at::Scalar pad_value) const {
+  xla::int64 rank = tensor.dim();
+  std::vector<xla::int64> sizes =
+      xla::util::ToVector<xla::int64>(tensor.sizes());
+  std::vector<xla::int64> padded_sizes(sizes);
+  std::vector<xla::int64> mask_sizes(rank, 1);
+  std::vector<xla::int64> dims;
+  for (auto dim : dims_) {
+    dims.push_back(XlaHelpers::GetCanonicalDimensionIndex(dim, rank));
+  }
+  for (auto dim : dims) {
+    padded_sizes[dim] = GetBucketSize(sizes[dim]);
+    mask_sizes[dim] = padded_sizes[dim];
+    xla::metrics::Counter(absl::StrCat("ShapeBucketHit_", padded_sizes[dim]))
+        .AddValue(1);
+  }
+  xla::int64 padded_numel = xla::util::Multiply<xla::int64>(padded_sizes);
+  XLA_COUNTER("ShapeBucketElements", padded_numel);
+  XLA_COUNTER("ShapeBucketPadElements", padded_numel - tensor.numel());
+
+  Result result;
+  result.mask = at::zeros(mask_sizes, tensor.options().dtype(at::kBool));
+  at::Tensor mask_view = result.mask;
+  for (auto dim : dims) {
+    mask_view = mask_view.narrow(dim, 0, sizes[dim]);
+  }
+  mask_view.fill_(true);
+  if (padded_sizes == sizes) {
+    result.tensor = tensor;
+    return result;
+  }
+  result.tensor = at::full(padded_sizes, pad_value, tensor.options());
+  at::Tensor view = result.tensor;
+  for (auto dim : dims) {
+    view = view.narrow(dim, 0, sizes[dim]);
+  }
+  view.copy_(tensor);
+  return result;
+}
+
+}  // namespace torch_xla
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+
+#include "tensorflow/compiler/xla/types.h"
+#include "torch/csrc/autograd/variable.h"
+
+namespace torch_xla {
+
+// Pads selected dimensions of input tensors up to a bucket size, so that inputs
+// whose sizes vary along them (like the sequence length of NLP batches) are
+// traced into a handful of graphs, instead of one graph (and one compilation)
+// per distinct size.
+class ShapeBucketing {
+ public:
+  struct Result {
+    at::Tensor tensor;
+    // A boolean tensor which is true for the original elements. It has the
+    // padded sizes for the bucketed dimensions, and size one for the others, so
+    // that it broadcasts against the padded tensor.
+    at::Tensor mask;
+  };
+
+  // An empty bucket_sizes vector means powers of two buckets.
+  ShapeBucketing(std::vector<xla::int64> dims,
+                 std::vector<xla::int64> bucket_sizes);
+
+  // Returns the smallest bucket size greater or equal to size. Sizes bigger
+  // than the largest bucket are returned unchanged.
+  xla::int64 GetBucketSize(xla::int64 size) const;
+
+  Result Pad(const at::Tensor& tensor, at::Scalar pad_value) const;
+
+ private:
+  std::vector<xla::int64> dims_;
+  std::vector<xla::int64> bucket_sizes_;
+};
+
+}  // namespace torch_xla
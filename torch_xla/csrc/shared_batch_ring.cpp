@@ -0,0 +1,199 @@
+#include "torch_xla/csrc/shared_batch_ring.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+
+namespace torch_xla {
+namespace {
+
+enum SlotState : uint32_t {
+  kFree = 0,
+  kWriting = 1,
+  kReady = 2,
+};
+
+constexpr size_t kAlignment = 64;
+
+size_t AlignUp(size_t size) {
+  return (size + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+// The writers and the reader live in different processes, so they poll the
+// shared state rather than waiting on process local condition variables.
+void PollWait() { std::this_thread::sleep_for(std::chrono::microseconds(50)); }
+
+}  // namespace
+
+struct SharedBatchRing::Header {
+  std::atomic<xla::uint64> write_ticket;
+  // The total number of batches, or -1 while still being written.
+  std::atomic<xla::int64> num_batches;
+  std::atomic<uint32_t> closed;
+};
+
+struct SharedBatchRing::SlotHeader {
+  struct TensorInfo {
+    int32_t scalar_type;
+    int32_t rank;
+    xla::int64 sizes[kMaxRank];
+    xla::uint64 offset;
+  };
+
+  std::atomic<uint32_t> state;
+  // The sequence number of the batch the slot is reserved to. Starts at the
+  // slot index, and gets advanced by num_slots every time the slot is read.
+  std::atomic<xla::uint64> sequence;
+  uint32_t num_tensors;
+  uint32_t metadata_size;
+  TensorInfo tensors[kMaxTensors];
+};
+
+SharedBatchRing::SharedBatchRing(std::string name, size_t num_slots,
+                                 size_t slot_size, bool create)
+    : name_(std::move(name)),
+      num_slots_(num_slots),
+      slot_size_(AlignUp(slot_size)),
+      slot_stride_(AlignUp(sizeof(SlotHeader)) + slot_size_),
+      region_size_(AlignUp(sizeof(Header)) + num_slots * slot_stride_),
+      owner_(create) {
+  XLA_CHECK_GT(num_slots_, 0);
+  int fd = shm_open(name_.c_str(), create ? O_CREAT | O_EXCL | O_RDWR : O_RDWR,
+                    0600);
+  XLA_CHECK_GE(fd, 0) << "Unable to open shared memory " << name_ << ": "
+                      << std::strerror(errno);
+  if (create && ftruncate(fd, region_size_) != 0) {
+    int error = errno;
+    close(fd);
+    shm_unlink(name_.c_str());
+    XLA_ERROR() << "Unable to size shared memory " << name_ << ": "
+                << std::strerror(error);
+  }
+  region_ = mmap(nullptr, region_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                 0);
+  close(fd);
+  XLA_CHECK(region_ != MAP_FAILED)
+      << "Unable to map shared memory " << name_ << ": "
+      << std::strerror(errno);
+  header_ = static_cast<Header*>(region_);
+  if (create) {
+    new (header_) Header();
+    header_->write_ticket.store(0);
+    header_->num_batches.store(-1);
+    header_->closed.store(0);
+    for (size_t i = 0; i < num_slots_; ++i) {
+      SlotHeader* slot = new (GetSlot(i)) SlotHeader();
+      slot->state.store(kFree);
+      slot->sequence.store(i);
+    }
+  }
+}
+
+SharedBatchRing::~SharedBatchRing() {
+  munmap(region_, region_size_);
+  if (owner_) {
+    shm_unlink(name_.c_str());
+  }
+}
+
+bool SharedBatchRing::Write(absl::Span<const at::Tensor> tensors,
+                            const std::string& metadata) {
+  XLA_CHECK_LE(tensors.size(), kMaxTensors);
+  xla::uint64 sequence = header_->write_ticket.fetch_add(1);
+  SlotHeader* slot = GetSlot(sequence);
+  while (slot->sequence.load() != sequence || slot->state.load() != kFree) {
+    if (IsClosed()) {
+      return false;
+    }
+    PollWait();
+  }
+  slot->state.store(kWriting);
+
+  char* data = GetSlotData(slot);
+  size_t offset = AlignUp(metadata.size());
+  XLA_CHECK_LE(offset, slot_size_) << "Batch metadata too big for the slot";
+  std::memcpy(data, metadata.data(), metadata.size());
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    const at::Tensor& tensor = tensors[i];
+    XLA_CHECK(tensor.device().is_cpu() && tensor.is_contiguous());
+    XLA_CHECK_LE(tensor.dim(), kMaxRank);
+    size_t nbytes = tensor.numel() * tensor.element_size();
+    XLA_CHECK_LE(offset + nbytes, slot_size_)
+        << "Batch too big for the shared memory slot size " << slot_size_;
+    SlotHeader::TensorInfo* info = &slot->tensors[i];
+    info->scalar_type = static_cast<int32_t>(tensor.scalar_type());
+    info->rank = tensor.dim();
+    for (xla::int64 dim = 0; dim < tensor.dim(); ++dim) {
+      info->sizes[dim] = tensor.size(dim);
+    }
+    info->offset = offset;
+    std::memcpy(data + offset, tensor.data_ptr(), nbytes);
+    offset = AlignUp(offset + nbytes);
+  }
+  slot->num_tensors = tensors.size();
+  slot->metadata_size = metadata.size();
+  slot->state.store(kReady);
+  return true;
+}
+
+void SharedBatchRing::CloseWrite(xla::int64 num_batches) {
+  header_->num_batches.store(num_batches);
+}
+
+void SharedBatchRing::Close() { header_->closed.store(1); }
+
+bool SharedBatchRing::Read(Batch* batch) {
+  SlotHeader* slot = GetSlot(next_sequence_);
+  while (slot->sequence.load() != next_sequence_ ||
+         slot->state.load() != kReady) {
+    xla::int64 num_batches = header_->num_batches.load();
+    if (IsClosed() ||
+        (num_batches >= 0 &&
+         next_sequence_ >= static_cast<xla::uint64>(num_batches))) {
+      return false;
+    }
+    PollWait();
+  }
+  char* data = GetSlotData(slot);
+  batch->sequence = next_sequence_;
+  batch->metadata.assign(data, slot->metadata_size);
+  batch->tensors.clear();
+  for (uint32_t i = 0; i < slot->num_tensors; ++i) {
+    const SlotHeader::TensorInfo& info = slot->tensors[i];
+    batch->tensors.push_back(at::from_blob(
+        data + info.offset,
+        at::IntArrayRef(info.sizes, static_cast<size_t>(info.rank)),
+        at::TensorOptions(static_cast<at::ScalarType>(info.scalar_type))));
+  }
+  ++next_sequence_;
+  return true;
+}
+
+void SharedBatchRing::Release(const Batch& batch) {
+  SlotHeader* slot = GetSlot(batch.sequence);
+  slot->state.store(kFree);
+  slot->sequence.store(batch.sequence + num_slots_);
+}
+
+SharedBatchRing::SlotHeader* SharedBatchRing::GetSlot(
+    xla::uint64 sequence) const {
+  char* base = static_cast<char*>(region_) + AlignUp(sizeof(Header));
+  return reinterpret_cast<SlotHeader*>(base +
+                                       (sequence % num_slots_) * slot_stride_);
+}
+
+char* SharedBatchRing::GetSlotData(SlotHeader* slot) const {
+  return reinterpret_cast<char*>(slot) + AlignUp(sizeof(SlotHeader));
+}
+
+bool SharedBatchRing::IsClosed() const { return header_->closed.load() != 0; }
+
+}  // namespace torch_xla
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/xla/types.h"
+#include "torch/csrc/autograd/variable.h"
+
+namespace torch_xla {
+
+// A ring of host batch slots living within a POSIX shared memory region. Many
+// writer processes (like the DataLoader workers) store their collated batches
+// into it, while a single reader (the DevicePrefetcher of the training
+// process) consumes them in write order, without any Python involvement.
+class SharedBatchRing {
+ public:
+  static constexpr size_t kMaxTensors = 32;
+  static constexpr size_t kMaxRank = 8;
+
+  // Readable view of a batch stored within a slot. The tensors point to the
+  // shared memory, and are valid until the Release() of the batch.
+  struct Batch {
+    xla::int64 sequence = -1;
+    std::vector<at::Tensor> tensors;
+    std::string metadata;
+  };
+
+  // Creates the shared memory region with the given name if create is true,
+  // or attaches to an existing one otherwise. The slot_size is the capacity in
+  // bytes of every slot, for the batch tensors data plus its metadata.
+  SharedBatchRing(std::string name, size_t num_slots, size_t slot_size,
+                  bool create);
+
+  ~SharedBatchRing();
+
+  const std::string& name() const { return name_; }
+
+  // Copies the (CPU, contiguous) tensors and the opaque metadata into the next
+  // ring slot, waiting for it to be free. Returns false if the ring has been
+  // closed.
+  bool Write(absl::Span<const at::Tensor> tensors, const std::string& metadata);
+
+  // Signals that num_batches batches have been written, in total.
+  void CloseWrite(xla::int64 num_batches);
+
+  // Wakes up all the readers and writers, which will give up waiting.
+  void Close();
+
+  // Waits for the next batch in write order. Returns false once all the
+  // batches have been read, or the ring has been closed.
+  bool Read(Batch* batch);
+
+  // Frees the slot of a batch returned by Read(), making it available to the
+  // writers.
+  void Release(const Batch& batch);
+
+ private:
+  struct Header;
+  struct SlotHeader;
+
+  SlotHeader* GetSlot(xla::uint64 sequence) const;
+
+  char* GetSlotData(SlotHeader* slot) const;
+
+  bool IsClosed() const;
+
+  std::string name_;
+  size_t num_slots_ = 0;
+  size_t slot_size_ = 0;
+  size_t slot_stride_ = 0;
+  size_t region_size_ = 0;
+  bool owner_ = false;
+  void* region_ = nullptr;
+  Header* header_ = nullptr;
+  // Only used by the single reader.
+  xla::uint64 next_sequence_ = 0;
+};
+
+}  // namespace torch_xla
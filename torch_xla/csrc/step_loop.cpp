@@ -0,0 +1,118 @@
+#include "torch_xla/csrc/step_loop.h"
+
+#include "tensorflow/compiler/xla/client/lib/constants.h"
+#include "tensorflow/compiler/xla/client/lib/loops.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace torch_xla {
+namespace {
+
+xla::XlaOp SliceStep(xla::XlaOp batch, xla::XlaOp step,
+                     const xla::Shape& batch_shape) {
+  std::vector<xla::XlaOp> start_indices(
+      batch_shape.rank(), xla::Zero(batch.builder(), xla::PrimitiveType::S32));
+  start_indices[0] = step;
+  std::vector<xla::int64> slice_sizes(batch_shape.dimensions().begin(),
+                                      batch_shape.dimensions().end());
+  slice_sizes[0] = 1;
+  xla::XlaOp slice = xla::DynamicSlice(batch, start_indices, slice_sizes);
+  return xla::Reshape(slice, xla::util::ToVector<xla::int64>(
+                                 batch_shape.dimensions().subspan(1)));
+}
+
+}  // namespace
+
+xla::XlaComputation BuildStepLoop(const xla::XlaComputation& step_computation,
+                                  absl::Span<const StepArgument> step_arguments,
+                                  absl::Span<const xla::Shape> batch_shapes,
+                                  absl::Span<const xla::Shape> state_shapes,
+                                  absl::Span<const xla::Shape> constant_shapes,
+                                  xla::int64 num_steps) {
+  xla::ProgramShape step_shape =
+      ConsumeValue(step_computation.GetProgramShape());
+  const xla::Shape& step_result = step_shape.result();
+  XLA_CHECK(step_result.IsTuple());
+  XLA_CHECK_GE(step_result.tuple_shapes_size(), state_shapes.size());
+  XLA_CHECK_EQ(step_shape.parameters_size(), step_arguments.size());
+
+  xla::XlaBuilder builder("StepLoop");
+  std::vector<xla::XlaOp> initial_values;
+  for (auto& shape : batch_shapes) {
+    XLA_CHECK_GE(shape.rank(), 1);
+    XLA_CHECK_EQ(shape.dimensions(0), num_steps) << shape;
+    initial_values.push_back(
+        xla::Parameter(&builder, initial_values.size(), shape, "batch"));
+  }
+  for (size_t i = 0; i < state_shapes.size(); ++i) {
+    XLA_CHECK(xla::ShapeUtil::Compatible(step_result.tuple_shapes(i),
+                                         state_shapes[i]))
+        << "The step state output " << i << " shape "
+        << step_result.tuple_shapes(i) << " differs from the input one "
+        << state_shapes[i];
+    initial_values.push_back(xla::Parameter(&builder, initial_values.size(),
+                                            state_shapes[i], "state"));
+  }
+  for (auto& shape : constant_shapes) {
+    initial_values.push_back(
+        xla::Parameter(&builder, initial_values.size(), shape, "constant"));
+  }
+  size_t num_parameters = initial_values.size();
+  for (xla::int64 i = state_shapes.size(); i < step_result.tuple_shapes_size();
+       ++i) {
+    const xla::Shape& metric_shape = step_result.tuple_shapes(i);
+    initial_values.push_back(
+        xla::Broadcast(xla::Zero(&builder, metric_shape.element_type()),
+                       metric_shape.dimensions()));
+  }
+
+  size_t state_base = batch_shapes.size();
+  size_t constant_base = state_base + state_shapes.size();
+  auto body_fn = [&](xla::XlaOp step, absl::Span<const xla::XlaOp> values,
+                     xla::XlaBuilder* body_builder)
+      -> xla::StatusOr<std::vector<xla::XlaOp>> {
+    std::vector<xla::XlaOp> arguments;
+    arguments.reserve(step_arguments.size());
+    for (auto& argument : step_arguments) {
+      switch (argument.kind) {
+        case StepArgument::kBatch:
+          arguments.push_back(SliceStep(values[argument.index], step,
+                                        batch_shapes[argument.index]));
+          break;
+        case StepArgument::kState:
+          arguments.push_back(values[state_base + argument.index]);
+          break;
+        case StepArgument::kConstant:
+          arguments.push_back(values[constant_base + argument.index]);
+          break;
+      }
+    }
+    xla::XlaOp result = xla::Call(body_builder, step_computation, arguments);
+    std::vector<xla::XlaOp> new_values(values.begin(), values.end());
+    for (size_t i = 0; i < state_shapes.size(); ++i) {
+      new_values[state_base + i] = xla::GetTupleElement(result, i);
+    }
+    for (size_t i = num_parameters; i < new_values.size(); ++i) {
+      new_values[i] = values[i] + xla::GetTupleElement(
+                                      result, i - num_parameters +
+                                                  state_shapes.size());
+    }
+    return new_values;
+  };
+  std::vector<xla::XlaOp> final_values = ConsumeValue(
+      xla::ForEachIndex(num_steps, xla::PrimitiveType::S32, body_fn,
+                        initial_values, "StepLoop", &builder));
+
+  std::vector<xla::XlaOp> results;
+  for (size_t i = 0; i < state_shapes.size(); ++i) {
+    results.push_back(final_values[state_base + i]);
+    builder.SetUpAlias({static_cast<xla::int64>(i)}, state_base + i, {});
+  }
+  for (size_t i = num_parameters; i < final_values.size(); ++i) {
+    results.push_back(final_values[i]);
+  }
+  return ConsumeValue(builder.Build(xla::Tuple(&builder, results)));
+}
+
+}  // namespace torch_xla
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/xla/client/xla_builder.h"
+#include "tensorflow/compiler/xla/shape.h"
+
+namespace torch_xla {
+
+// Where a parameter of the step computation is fed from, within the loop.
+struct StepArgument {
+  enum Kind {
+    // The num_steps slice of a batch, at the current step.
+    kBatch,
+    // The loop carried state.
+    kState,
+    // Device data which does not change across steps.
+    kConstant,
+  };
+
+  Kind kind;
+  size_t index;
+};
+
+// Builds a computation running num_steps times the step computation, within a
+// single XLA While loop. The loop computation parameters are the batches (with
+// a leading num_steps dimension), the state and the constants, in that order.
+// The step computation returns a tuple with the new state, followed by the
+// per step metrics. The loop computation returns a tuple with the final state
+// (aliased in place with the state parameters), followed by the metrics summed
+// over all the steps.
+xla::XlaComputation BuildStepLoop(const xla::XlaComputation& step_computation,
+                                  absl::Span<const StepArgument> step_arguments,
+                                  absl::Span<const xla::Shape> batch_shapes,
+                                  absl::Span<const xla::Shape> state_shapes,
+                                  absl::Span<const xla::Shape> constant_shapes,
+                                  xla::int64 num_steps);
+
+}  // namespace torch_xla
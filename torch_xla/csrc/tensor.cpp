@@ -1,17 +1,22 @@
 #include "torch_xla/csrc/tensor.h"
 
 #include <algorithm>
+#include <array>
 #include <atomic>
 #include <cmath>
 #include <condition_variable>
 #include <exception>
 #include <functional>
+#include <limits>
+#include <map>
 #include <mutex>
 #include <set>
 #include <stdexcept>
+#include <unordered_set>
 
 #include "absl/memory/memory.h"
 #include "absl/strings/str_join.h"
+#include "absl/strings/string_view.h"
 #include "tensorflow/compiler/xla/literal_util.h"
 #include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/xla_client/cache.h"
@@ -24,17 +29,26 @@
 #include "tensorflow/core/lib/core/errors.h"
 #include "torch/csrc/autograd/variable.h"
 #include "torch_xla/csrc/debug_util.h"
+#include "torch_xla/csrc/graph_partitioner.h"
+#include "torch_xla/csrc/graph_speculator.h"
 #include "torch_xla/csrc/helpers.h"
+#include "torch_xla/csrc/host_overhead.h"
 #include "torch_xla/csrc/ir_dump_util.h"
 #include "torch_xla/csrc/layout_manager.h"
+#include "torch_xla/csrc/node_pool.h"
 #include "torch_xla/csrc/op_by_op_executor.h"
 #include "torch_xla/csrc/ops/arithmetic_ir_ops.h"
 #include "torch_xla/csrc/ops/cast.h"
+#include "torch_xla/csrc/ops/constant.h"
 #include "torch_xla/csrc/ops/device_data.h"
 #include "torch_xla/csrc/ops/expand.h"
 #include "torch_xla/csrc/ops/ops.h"
 #include "torch_xla/csrc/ops/view.h"
 #include "torch_xla/csrc/ops/xla_ops.h"
+#include "torch_xla/csrc/persistent_cache.h"
+#include "torch_xla/csrc/recompile_analyzer.h"
+#include "torch_xla/csrc/scope_profiler.h"
+#include "torch_xla/csrc/step_loop.h"
 #include "torch_xla/csrc/tensor_util.h"
 #include "torch_xla/csrc/torch_util.h"
 
@@ -45,10 +59,109 @@ struct TlsData {
   void Reset() { trim_counter = 0; }
 
   size_t trim_counter = 0;
+  // Not reset across steps, as it is set by the user.
+  xla::int64 stream = 0;
+  // The op local hash of the node after which the pending graphs are spilled,
+  // kept across steps.
+  xla::hash_t spill_anchor = 0;
+  bool spilling = false;
 };
 
 thread_local TlsData g_tls_data;
 
+// If XLA_MEMORY_PRESSURE_CHECK is enabled, verifies that the device has enough
+// free memory to hold the computation results, and tries to reclaim memory
+// otherwise.
+void MaybeReclaimDeviceMemory(
+    const std::string& device,
+    const xla::ComputationClient::Computation& computation) {
+  static const bool pressure_check =
+      xla::sys_util::GetEnvBool("XLA_MEMORY_PRESSURE_CHECK", false);
+  if (!pressure_check) {
+    return;
+  }
+  xla::int64 result_size = xla::ShapeUtil::ByteSizeOf(
+      computation.program_shape().result(), sizeof(void*));
+  xla::ComputationClient::MemoryInfo mem_info =
+      xla::ComputationClient::Get()->GetMemoryInfo(device);
+  if (mem_info.free_bytes >= 0 && result_size > mem_info.free_bytes) {
+    TF_VLOG(3) << "Reclaiming memory on device " << device << ": free="
+               << mem_info.free_bytes << " required=" << result_size;
+    XLA_COUNTER("MemoryPressureReclaim", 1);
+    xla::ComputationClient::Get()->ReclaimMemory(device);
+  }
+}
+
+// The live bytes of the host copies kept on the XLA tensors next to their
+// device data.
+xla::metrics::Counter* RetainedHostBytesCounter() {
+  static xla::metrics::Counter* counter =
+      new xla::metrics::Counter("RetainedHostBytes");
+  return counter;
+}
+
+bool ShouldRetainHostData(xla::int64 size) {
+  static const xla::int64 max_size =
+      xla::sys_util::GetEnvInt("XLA_HOST_DATA_RETAIN_BYTES", 1 << 20);
+  static const xla::int64 budget = xla::sys_util::GetEnvInt(
+      "XLA_HOST_DATA_RETAIN_LIMIT", static_cast<xla::int64>(1) << 30);
+  return size <= max_size &&
+         RetainedHostBytesCounter()->Value() + size <= budget;
+}
+
+// Tracks the graph hashes which are currently being compiled in the
+// background, so that we do not issue multiple compilations for the same graph
+// while the first one is still in flight.
+class PendingCompiles {
+ public:
+  static PendingCompiles* Get() {
+    static PendingCompiles* pending_compiles = new PendingCompiles();
+    return pending_compiles;
+  }
+
+  bool Add(const xla::hash_t& hash) {
+    std::lock_guard<std::mutex> lock(lock_);
+    return hashes_.insert(hash).second;
+  }
+
+  void Remove(const xla::hash_t& hash) {
+    std::lock_guard<std::mutex> lock(lock_);
+    hashes_.erase(hash);
+  }
+
+ private:
+  std::mutex lock_;
+  std::unordered_set<xla::hash_t, xla::util::HashReducer> hashes_;
+};
+
+// The graph hashes whose computations the compilation cache never evicts in
+// favor of unpinned ones. Graphs can be pinned before being compiled.
+class PinnedComputations {
+ public:
+  static PinnedComputations* Get() {
+    static PinnedComputations* pinned_computations = new PinnedComputations();
+    return pinned_computations;
+  }
+
+  void Set(const xla::hash_t& hash, bool pinned) {
+    std::lock_guard<std::mutex> lock(lock_);
+    if (pinned) {
+      hashes_.insert(hash);
+    } else {
+      hashes_.erase(hash);
+    }
+  }
+
+  bool IsPinned(const xla::hash_t& hash) {
+    std::lock_guard<std::mutex> lock(lock_);
+    return hashes_.count(hash) > 0;
+  }
+
+ private:
+  std::mutex lock_;
+  std::unordered_set<xla::hash_t, xla::util::HashReducer> hashes_;
+};
+
 // Locking:
 // We perform two kinds of operations of tensors, synchronous and asynchronous.
 // The ApplyPendingGraph() are synchronous, as we need the device data result
@@ -60,35 +173,73 @@ thread_local TlsData g_tls_data;
 // scheduled the asynchronous operation. While executing, the asynchronous
 // operations will hold locks on all the participating devices (in most common
 // cases there will be only one device).
-// Since asynchronous operations capture device locks, only one asynchronous
-// operation can execute at the same time, on a given device. Tensor operations
-// which send data to device do not need to hold any device locks while doing
-// so. Only operations which _use_ device data (computations, and transfer from
-// server) need to wait for asynchronous operations to complete (barrier).
+// The device locks are slots of a bounded, in-order, execution queue whose
+// depth is controlled by the XLA_DEVICE_QUEUE_DEPTH environment variable
+// (default 1). With a depth greater than one, the host can trace and schedule
+// the following steps while previous ones are still executing, and the device
+// data placeholders of a step feed the parameters of the next. Asynchronous
+// operations wait for their turn in the queue before executing.
+// Tensor operations which send data to device do not need to hold any device
+// locks while doing so. Only operations which _use_ device data (computations,
+// and transfer from server) need to wait for asynchronous operations to
+// complete (barrier).
+// Every execution stream has its own queue on a device, so graphs issued from
+// different streams do not wait for each other, unless one uses the device
+// data the other produces (see XLATensor::FenceStream()).
 
 class DeviceLocker {
  public:
-  explicit DeviceLocker(Device device) : device_(std::move(device)) {}
+  DeviceLocker(Device device, xla::int64 stream, size_t depth)
+      : device_(std::move(device)), stream_(stream), depth_(depth) {}
 
   const Device& device() const { return device_; }
 
-  void Lock() {
+  xla::int64 stream() const { return stream_; }
+
+  // Reserves a slot in the device execution queue, waiting if the queue
+  // already holds depth operations. Returns the ticket identifying the slot,
+  // which has to be handed back to the Unlock() API.
+  size_t Lock() {
     std::unique_lock<std::mutex> lock(mutex_);
-    cv_.wait(lock, [this] { return !locked_; });
+    cv_.wait(lock, [this] { return in_flight_ < depth_; });
     CheckResetException();
-    locked_ = true;
+    in_flight_ += 1;
+    XLA_VALUE_METRIC("DeviceQueueOccupancy", in_flight_);
+    return next_ticket_++;
   }
 
-  void Unlock(std::exception_ptr exptr) {
+  void Unlock(size_t ticket, std::exception_ptr exptr) {
     std::lock_guard<std::mutex> lock(mutex_);
-    locked_ = false;
-    exptr_ = std::move(exptr);
+    in_flight_ -= 1;
+    if (exptr != nullptr) {
+      exptr_ = std::move(exptr);
+    }
+    // Operations might release their slot out of order (ie, a collection
+    // which ended up not scheduling any computation), so we keep track of the
+    // first ticket whose predecessors have all completed.
+    done_tickets_.insert(ticket);
+    while (!done_tickets_.empty() && *done_tickets_.begin() == done_ticket_) {
+      done_tickets_.erase(done_tickets_.begin());
+      done_ticket_ += 1;
+    }
     cv_.notify_all();
   }
 
+  // Waits until all the operations queued before ticket have completed, so
+  // that the device data they produce (which can be used as parameters by the
+  // operation holding ticket) is available. If one of them failed, its
+  // exception is re-thrown here, without clearing it.
+  void WaitTurn(size_t ticket) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this, ticket] { return done_ticket_ >= ticket; });
+    if (exptr_ != nullptr) {
+      std::rethrow_exception(exptr_);
+    }
+  }
+
   void Barrier() {
     std::unique_lock<std::mutex> lock(mutex_);
-    cv_.wait(lock, [this] { return !locked_; });
+    cv_.wait(lock, [this] { return in_flight_ == 0; });
     cv_.notify_all();
     CheckResetException();
   }
@@ -103,9 +254,14 @@ class DeviceLocker {
   }
 
   Device device_;
+  xla::int64 stream_;
+  size_t depth_;
   std::mutex mutex_;
   std::condition_variable cv_;
-  bool locked_ = false;
+  size_t in_flight_ = 0;
+  size_t next_ticket_ = 0;
+  size_t done_ticket_ = 0;
+  std::set<size_t> done_tickets_;
   std::exception_ptr exptr_;
 };
 
@@ -116,75 +272,157 @@ class DeviceLockerArena {
     return arena;
   }
 
-  std::shared_ptr<DeviceLocker> GetLocker(const Device& device) {
+  std::shared_ptr<DeviceLocker> GetLocker(const Device& device,
+                                          xla::int64 stream) {
+    static const size_t depth = std::max<size_t>(
+        xla::sys_util::GetEnvInt("XLA_DEVICE_QUEUE_DEPTH", 1), 1);
     std::lock_guard<std::mutex> lock(mutex_);
-    auto it = lockers_.find(device);
+    auto key = std::make_pair(device, stream);
+    auto it = lockers_.find(key);
     if (it == lockers_.end()) {
-      it = lockers_.emplace(device, std::make_shared<DeviceLocker>(device))
+      it = lockers_
+               .emplace(key,
+                        std::make_shared<DeviceLocker>(device, stream, depth))
                .first;
     }
     return it->second;
   }
 
+  // Returns the lockers of all the streams which have been used on device.
+  std::vector<std::shared_ptr<DeviceLocker>> GetLockers(const Device& device) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::shared_ptr<DeviceLocker>> lockers;
+    for (auto it = lockers_.lower_bound(std::make_pair(
+             device, std::numeric_limits<xla::int64>::min()));
+         it != lockers_.end() && it->first.first == device; ++it) {
+      lockers.push_back(it->second);
+    }
+    return lockers;
+  }
+
  private:
   std::mutex mutex_;
-  std::map<Device, std::shared_ptr<DeviceLocker>> lockers_;
+  std::map<std::pair<Device, xla::int64>, std::shared_ptr<DeviceLocker>>
+      lockers_;
 };
 
-xla::util::ExceptionCleanup LockDevice(const Device& device) {
-  auto locker = DeviceLockerArena::Get()->GetLocker(device);
-  locker->Lock();
-  return xla::util::ExceptionCleanup(
-      [locker =
-           std::move(locker)](xla::util::ExceptionCleanup::StatusType status) {
-        locker->Unlock(std::move(status));
-      });
-}
-
+// Waits for the operations of all the streams of device.
 void DeviceBarrier(const Device& device) {
-  auto locker = DeviceLockerArena::Get()->GetLocker(device);
-  locker->Barrier();
+  for (auto& locker : DeviceLockerArena::Get()->GetLockers(device)) {
+    locker->Barrier();
+  }
 }
 
 // Use a set to impose an order on the device locking sequence (ABBA
-// prevention).
+// prevention). The wait_turn function, to be called before executing on the
+// devices, waits for the operations queued ahead of this one to complete.
+// The queues of the current stream are the ones being locked.
 std::vector<xla::util::ExceptionCleanup> LockDevices(
-    const std::set<Device>& devices) {
+    const std::set<Device>& devices, std::function<void()>* wait_turn) {
   std::vector<xla::util::ExceptionCleanup> unlocker;
+  std::vector<std::pair<std::shared_ptr<DeviceLocker>, size_t>> tickets;
   unlocker.reserve(devices.size());
+  tickets.reserve(devices.size());
   for (auto& device : devices) {
-    unlocker.emplace_back(LockDevice(device));
-  }
+    auto locker = DeviceLockerArena::Get()->GetLocker(
+        device, XLATensor::GetCurrentStream());
+    size_t ticket = locker->Lock();
+    tickets.emplace_back(locker, ticket);
+    unlocker.emplace_back(
+        [locker = std::move(locker),
+         ticket](xla::util::ExceptionCleanup::StatusType status) {
+          locker->Unlock(ticket, std::move(status));
+        });
+  }
+  *wait_turn = [tickets = std::move(tickets)]() {
+    for (auto& locker_ticket : tickets) {
+      locker_ticket.first->WaitTurn(locker_ticket.second);
+    }
+  };
   return unlocker;
 }
 
-class XlaDataCacheArena {
- public:
-  struct TensorHasher {
-    size_t operator()(const at::Tensor& tensor) const {
-      return xla::util::HashReduce(xla::util::HashCombine(
-          xla::util::GetEnumValue(tensor.scalar_type()), TensorHash(tensor)));
-    };
-  };
-  struct TensorComparer {
-    bool operator()(const at::Tensor& tensor1,
-                    const at::Tensor& tensor2) const {
-      return TensorCompare(tensor1, tensor2);
-    }
+void DevicesBarrier(const std::set<Device>& devices) {
+  for (auto& device : devices) {
+    DeviceBarrier(device);
+  }
+}
+
+// Waits for the asynchronous operation assigning the device data, if it is
+// a placeholder, to complete. Unlike the device barriers, the operations
+// queued after (or on other streams than) the producing one are not waited.
+void WaitDataReady(const xla::ComputationClient::DataPtr& data) {
+  if (data != nullptr && data->ready_event() != nullptr) {
+    data->ready_event()->Wait();
+  }
+}
+
+struct TensorHasher {
+  size_t operator()(const at::Tensor& tensor) const {
+    return xla::util::HashReduce(xla::util::HashCombine(
+        xla::util::GetEnumValue(tensor.scalar_type()), TensorHash(tensor)));
   };
+};
+
+struct TensorComparer {
+  bool operator()(const at::Tensor& tensor1, const at::Tensor& tensor2) const {
+    return TensorCompare(tensor1, tensor2);
+  }
+};
+
+// Identifies the content of a contiguous CPU tensor without looking at its
+// data. The version counter is bumped by every in-place operation on the
+// tensor (or on any of its views), so equal identities refer to the same bytes
+// as long as the storage has not been replaced.
+struct TensorIdentity {
+  const c10::StorageImpl* storage = nullptr;
+  int64_t storage_offset = 0;
+  uint32_t version = 0;
+  at::ScalarType scalar_type = at::ScalarType::Undefined;
+  std::vector<int64_t> sizes;
+};
+
+struct TensorIdentityHasher {
+  size_t operator()(const TensorIdentity& identity) const {
+    return xla::util::HashReduce(xla::util::MHash(
+        reinterpret_cast<uintptr_t>(identity.storage), identity.storage_offset,
+        identity.version, xla::util::GetEnumValue(identity.scalar_type),
+        identity.sizes));
+  }
+};
 
-  using XlaDataCache =
-      xla::util::Cache<at::Tensor, xla::ComputationClient::Data, TensorHasher,
-                       TensorComparer>;
+struct TensorIdentityComparer {
+  bool operator()(const TensorIdentity& identity1,
+                  const TensorIdentity& identity2) const {
+    return identity1.storage == identity2.storage &&
+           identity1.storage_offset == identity2.storage_offset &&
+           identity1.version == identity2.version &&
+           identity1.scalar_type == identity2.scalar_type &&
+           identity1.sizes == identity2.sizes;
+  }
+};
+
+struct TensorDataCacheEntry {
+  // The weak reference does not keep the tensor memory alive, but it keeps the
+  // StorageImpl object allocated, so its address cannot be reused by a new
+  // storage while the entry exists. An expired reference means the storage
+  // which created the entry is gone.
+  c10::weak_intrusive_ptr<c10::StorageImpl> storage;
+  size_t sample_hash = 0;
+  xla::ComputationClient::DataPtr data;
+};
 
-  explicit XlaDataCacheArena(size_t max_cache_size)
+template <typename C>
+class DeviceCacheArena {
+ public:
+  explicit DeviceCacheArena(size_t max_cache_size)
       : max_cache_size_(max_cache_size) {}
 
-  XlaDataCache* Get(const Device& device) {
+  C* Get(const Device& device) {
     std::lock_guard<std::mutex> lock(mutex_);
     auto it = device_caches_.find(device);
     if (it == device_caches_.end()) {
-      std::unique_ptr<XlaDataCache> cache(new XlaDataCache(max_cache_size_));
+      std::unique_ptr<C> cache(new C(max_cache_size_));
       it = device_caches_.emplace(device, std::move(cache)).first;
     }
     return it->second.get();
@@ -193,16 +431,34 @@ class XlaDataCacheArena {
  private:
   size_t max_cache_size_ = 0;
   std::mutex mutex_;
-  std::map<Device, std::unique_ptr<XlaDataCache>> device_caches_;
+  std::map<Device, std::unique_ptr<C>> device_caches_;
 };
 
-XlaDataCacheArena::XlaDataCache* GetXlaDataCache(const Device& device) {
+using XlaDataCache =
+    xla::util::ShardedCache<at::Tensor, xla::ComputationClient::Data,
+                            TensorHasher, TensorComparer>;
+
+using TensorDataCache =
+    xla::util::ShardedCache<TensorIdentity, TensorDataCacheEntry,
+                            TensorIdentityHasher, TensorIdentityComparer>;
+
+XlaDataCache* GetXlaDataCache(const Device& device) {
   static const size_t kMaxCacheSize =
       xla::sys_util::GetEnvInt("XLA_DEVDATA_CACHE_SIZE", 128);
-  static XlaDataCacheArena* arena = new XlaDataCacheArena(kMaxCacheSize);
+  static DeviceCacheArena<XlaDataCache>* arena =
+      new DeviceCacheArena<XlaDataCache>(kMaxCacheSize);
   return arena->Get(device);
 }
 
+TensorDataCache* GetTensorDataCache(const Device& device) {
+  static const size_t kMaxCacheSize =
+      xla::sys_util::GetEnvInt("XLA_TENSOR_DATA_CACHE_SIZE", 32);
+  static DeviceCacheArena<TensorDataCache>* arena =
+      kMaxCacheSize > 0 ? new DeviceCacheArena<TensorDataCache>(kMaxCacheSize)
+                        : nullptr;
+  return arena != nullptr ? arena->Get(device) : nullptr;
+}
+
 ir::Value IrValueFromScalar(at::Scalar value, at::ScalarType scalar_type,
                             const Device& device) {
   at::Tensor tensor = at::scalar_tensor(value, at::TensorOptions(scalar_type));
@@ -212,17 +468,74 @@ ir::Value IrValueFromScalar(at::Scalar value, at::ScalarType scalar_type,
 
 xla::ComputationClient::DataPtr GetDeviceData(const at::Tensor& tensor,
                                               const Device& device) {
-  XlaDataCacheArena::XlaDataCache* cache = GetXlaDataCache(device);
+  // With scalars hoisting, the device data of new values is only a placeholder,
+  // and all the values used by a graph are uploaded together with a single
+  // transfer, right before the graph execution.
+  static const bool hoist_scalars =
+      xla::sys_util::GetEnvBool("XLA_HOIST_SCALARS", false);
+  XlaDataCache* cache = GetXlaDataCache(device);
   xla::ComputationClient::DataPtr device_data = cache->Get(tensor);
   if (device_data == nullptr) {
     at::Tensor tensor_copy = CopyTensor(tensor);
-    device_data = TensorToXlaData(tensor_copy, device);
+    device_data = hoist_scalars ? CreateDeferredTensorData(tensor_copy, device)
+                                : TensorToXlaData(tensor_copy, device);
     cache->Add(std::move(tensor_copy), device_data);
     XLA_COUNTER("DeviceDataCacheMiss", 1);
   }
   return device_data;
 }
 
+// Uploads a non scalar CPU tensor, reusing the device data of a previous upload
+// of the same tensor content. Unlike the GetDeviceData() API, the lookup does
+// not hash the whole tensor data, as the cache is keyed by the tensor identity.
+// A window of the data is hashed anyway, to catch writes to the tensor memory
+// which do not go through the version counter (like numpy arrays sharing it).
+xla::ComputationClient::DataPtr GetTensorDeviceData(const at::Tensor& tensor,
+                                                    const Device& device,
+                                                    bool* shared) {
+  static const xla::int64 kMaxTensorBytes = xla::sys_util::GetEnvInt(
+      "XLA_TENSOR_DATA_CACHE_MAX_BYTES", 4 * 1024 * 1024);
+  TensorDataCache* cache = GetTensorDataCache(device);
+  xla::int64 tensor_bytes = tensor.numel() * tensor.element_size();
+  *shared = false;
+  if (cache == nullptr || tensor_bytes > kMaxTensorBytes ||
+      !tensor.is_contiguous()) {
+    return TensorToXlaData(tensor, device);
+  }
+  TensorIdentity identity;
+  identity.storage = tensor.storage().unsafeGetStorageImpl();
+  identity.storage_offset = tensor.storage_offset();
+  identity.version =
+      tensor.unsafeGetTensorImpl()->version_counter().current_version();
+  identity.scalar_type = tensor.scalar_type();
+  identity.sizes = tensor.sizes().vec();
+
+  size_t sample_hash = xla::util::PartialHasher<absl::string_view, 4096>()(
+      absl::string_view(static_cast<const char*>(tensor.data_ptr()),
+                        tensor_bytes));
+  // The returned device data is shared among all the uploads of the tensor, so
+  // the caller must make sure it is never donated to a computation output.
+  *shared = true;
+  std::shared_ptr<TensorDataCacheEntry> entry = cache->Get(identity);
+  if (entry != nullptr) {
+    if (!entry->storage.expired() && entry->sample_hash == sample_hash) {
+      XLA_COUNTER("TensorDataCacheHit", 1);
+      return entry->data;
+    }
+    cache->Erase(identity);
+  }
+  XLA_COUNTER("TensorDataCacheMiss", 1);
+  c10::Storage storage = tensor.storage();
+  entry = std::make_shared<TensorDataCacheEntry>();
+  entry->storage = c10::weak_intrusive_ptr<c10::StorageImpl>(
+      c10::intrusive_ptr<c10::StorageImpl>::reclaim(
+          storage.unsafeReleaseStorageImpl()));
+  entry->sample_hash = sample_hash;
+  entry->data = TensorToXlaData(tensor, device);
+  cache->Add(std::move(identity), entry);
+  return entry->data;
+}
+
 xla::ComputationClient::DataPtr GetDeviceData(at::Scalar value,
                                               at::ScalarType scalar_type,
                                               const Device& device) {
@@ -244,10 +557,402 @@ bool IsSpecialScalar(at::Scalar value) {
   return false;
 }
 
+const at::ScalarType kSeedType = at::ScalarType::Long;
+const xla::uint64 kSeedMul = 214013;
+const xla::uint64 kSeedAdd = 2531011;
+
+// When enabled, the RNG state lives on device as a persistent scalar tensor,
+// which is advanced within the traced graphs and updated in place when they
+// are executed, instead of uploading a new seed scalar at every step.
+bool UseDeviceRngState() {
+  static const bool device_rng_state =
+      xla::sys_util::GetEnvBool("XLA_DEVICE_RNG_STATE", false);
+  return device_rng_state;
+}
+
 bool ShouldSyncIrValue(const ir::Value& ir_value) {
   return ir_value->op() != ir::ops::xla_not_supported;
 }
 
+// Caches the DeviceData leaves of an IR graph, in post-order, keyed by the
+// graph root nodes. On a hit, the parameters of a computation can be collected
+// without walking a graph which can have tens of thousands of nodes. The
+// entries do not hold references to the graph, as the roots are tracked with
+// weak pointers, and the leaves are kept alive by the roots. IR graphs are
+// immutable once created, so a live set of roots always maps to the same
+// leaves.
+class GraphParametersCache {
+ public:
+  struct Entry {
+    std::vector<std::weak_ptr<ir::Node>> roots;
+    std::vector<const ir::ops::DeviceData*> device_data;
+    size_t graph_size = 0;
+  };
+
+  static GraphParametersCache* Get() {
+    static const size_t kMaxCacheSize =
+        xla::sys_util::GetEnvInt("XLA_GRAPH_PARAMETERS_CACHE_SIZE", 64);
+    static GraphParametersCache* cache =
+        kMaxCacheSize > 0 ? new GraphParametersCache(kMaxCacheSize) : nullptr;
+    return cache;
+  }
+
+  std::shared_ptr<Entry> Lookup(absl::Span<const ir::NodePtr> roots) {
+    std::shared_ptr<Entry> entry = cache_.Get(GetKey(roots));
+    if (entry == nullptr || entry->roots.size() != roots.size()) {
+      return nullptr;
+    }
+    for (size_t i = 0; i < roots.size(); ++i) {
+      if (entry->roots[i].lock() != roots[i]) {
+        return nullptr;
+      }
+    }
+    return entry;
+  }
+
+  void Add(absl::Span<const ir::NodePtr> roots,
+           std::vector<const ir::ops::DeviceData*> device_data,
+           size_t graph_size) {
+    auto entry = std::make_shared<Entry>();
+    entry->roots.assign(roots.begin(), roots.end());
+    entry->device_data = std::move(device_data);
+    entry->graph_size = graph_size;
+    // A stale entry with the same key would not be replaced by Add().
+    xla::hash_t key = GetKey(roots);
+    cache_.Erase(key);
+    cache_.Add(key, std::move(entry));
+  }
+
+ private:
+  using Cache = xla::util::Cache<xla::hash_t, Entry, xla::util::HashReducer>;
+
+  explicit GraphParametersCache(size_t max_size) : cache_(max_size) {}
+
+  static xla::hash_t GetKey(absl::Span<const ir::NodePtr> roots) {
+    xla::hash_t key = 0x8a3e9c71;
+    for (auto& root : roots) {
+      key = xla::util::HashCombine(
+          key, xla::util::HashCombine(xla::util::Hash(root.get()),
+                                      root->hash()));
+    }
+    return key;
+  }
+
+  Cache cache_;
+};
+
+xla::int64 GetLeavesByteSize(const xla::Shape& shape) {
+  xla::int64 size = 0;
+  xla::ShapeUtil::ForEachSubshape(
+      shape, [&](const xla::Shape& subshape, const xla::ShapeIndex&) {
+        if (subshape.IsArray()) {
+          size += xla::ShapeUtil::ByteSizeOfElements(subshape);
+        }
+      });
+  return size;
+}
+
+// Parameters whose Data is only referenced by the pending execution (no live
+// tensor or IR graph holds them anymore) are donated to it, so that their
+// device memory can be released as soon as the execution is done with them.
+std::vector<bool> GetDonatedParameters(
+    absl::Span<const xla::ComputationClient::DataPtr> parameters_data) {
+  static const bool donate_parameters =
+      xla::sys_util::GetEnvBool("XLA_DONATE_DEAD_PARAMETERS", true);
+  std::vector<bool> donated;
+  if (donate_parameters) {
+    donated.reserve(parameters_data.size());
+    for (auto& data : parameters_data) {
+      donated.push_back(data.use_count() == 1);
+    }
+  }
+  return donated;
+}
+
+void RecordExecuteEvent(
+    xla::metrics::GraphEvent* event, xla::int64 execute_start_ns,
+    absl::Span<const xla::ComputationClient::DataPtr> parameters_data,
+    absl::Span<const xla::ComputationClient::DataPtr> results) {
+  event->execute_start_ns = execute_start_ns;
+  event->execute_ns = xla::sys_util::NowNs() - execute_start_ns;
+  for (auto& data : parameters_data) {
+    event->bytes_in += xla::ShapeUtil::ByteSizeOf(data->shape());
+  }
+  for (auto& data : results) {
+    event->bytes_out += xla::ShapeUtil::ByteSizeOf(data->shape());
+  }
+  xla::metrics::RecordGraphEvent(*event);
+}
+
+// Collects the parameters data out of the DeviceData leaves of the graph,
+// given in post-order. DeviceData nodes referencing the same device data are
+// mapped to the same parameter.
+void CollectParametersData(
+    absl::Span<const ir::ops::DeviceData* const> device_data,
+    std::vector<xla::ComputationClient::DataPtr>* parameters_data,
+    std::vector<size_t>* parameter_sequence) {
+  std::unordered_map<xla::ComputationClient::Data::OpaqueHandle, size_t>
+      data_handles;
+  for (auto node : device_data) {
+    xla::ComputationClient::Data::OpaqueHandle handle =
+        node->data()->GetOpaqueHandle();
+    auto it = data_handles.find(handle);
+    if (it != data_handles.end()) {
+      parameter_sequence->push_back(it->second);
+    } else {
+      parameter_sequence->push_back(parameters_data->size());
+      data_handles[handle] = parameters_data->size();
+      parameters_data->push_back(node->data());
+    }
+  }
+}
+
+// Counts the transposes the entry computation root depends on. Dead ones, like
+// the NCHW copies of channels-last values nobody reads, are skipped as the XLA
+// compiler removes them anyway.
+size_t CountLiveHloTransposes(const xla::XlaComputation& computation) {
+  const xla::HloModuleProto& module = computation.proto();
+  for (auto& hlo_computation : module.computations()) {
+    if (hlo_computation.id() != module.entry_computation_id()) {
+      continue;
+    }
+    std::unordered_map<xla::int64, const xla::HloInstructionProto*>
+        instructions;
+    for (auto& instruction : hlo_computation.instructions()) {
+      instructions.emplace(instruction.id(), &instruction);
+    }
+    size_t count = 0;
+    std::unordered_set<xla::int64> visited;
+    std::vector<xla::int64> queue = {hlo_computation.root_id()};
+    while (!queue.empty()) {
+      xla::int64 id = queue.back();
+      queue.pop_back();
+      auto it = instructions.find(id);
+      if (!visited.insert(id).second || it == instructions.end()) {
+        continue;
+      }
+      if (it->second->opcode() == "transpose") {
+        ++count;
+      }
+      queue.insert(queue.end(), it->second->operand_ids().begin(),
+                   it->second->operand_ids().end());
+    }
+    return count;
+  }
+  return 0;
+}
+
+bool HasHloCollectives(const xla::XlaComputation& computation) {
+  static const std::unordered_set<std::string>* const collectives =
+      new std::unordered_set<std::string>(
+          {"all-gather", "all-reduce", "all-to-all", "collective-permute",
+           "reduce-scatter", "replica-id"});
+  for (auto& hlo_computation : computation.proto().computations()) {
+    for (auto& instruction : hlo_computation.instructions()) {
+      if (collectives->count(instruction.opcode()) > 0) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// Tracks the live tensor data objects of a device. Registrations land on a
+// shard selected by the calling thread, so that threads creating and
+// destroying tensors do not contend on the same lock. Every shard is a slab of
+// weak pointers, with a free list of the released slots, which makes both
+// registration and unregistration O(1), and the enumeration a linear scan.
+template <typename T>
+class LiveTensorRegistry {
+ public:
+  void Register(const std::shared_ptr<T>& data) {
+    size_t shard_index = GetThreadShard();
+    Shard& shard = shards_[shard_index];
+    std::lock_guard<std::mutex> lock(shard.lock);
+    size_t slot = shard.slots.size();
+    if (!shard.free_slots.empty()) {
+      slot = shard.free_slots.back();
+      shard.free_slots.pop_back();
+      shard.slots[slot] = data;
+    } else {
+      shard.slots.emplace_back(data);
+    }
+    data->registry_shard = shard_index;
+    data->registry_slot = slot;
+  }
+
+  void Unregister(T* data) {
+    if (data->registry_shard < 0) {
+      return;
+    }
+    Shard& shard = shards_[data->registry_shard];
+    std::lock_guard<std::mutex> lock(shard.lock);
+    shard.slots[data->registry_slot].reset();
+    shard.free_slots.push_back(data->registry_slot);
+  }
+
+  // Returns the live data objects sorted by unique ID, which is the creation
+  // order. The graphs built from the live tensors (hence their hashes) depend
+  // on the order, so it must not be affected by the slot reuse.
+  std::vector<std::shared_ptr<T>> GetLive() {
+    std::vector<std::shared_ptr<T>> live;
+    for (auto& shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard.lock);
+      live.reserve(live.size() + shard.slots.size() - shard.free_slots.size());
+      for (auto& slot : shard.slots) {
+        std::shared_ptr<T> data = slot.lock();
+        if (data != nullptr) {
+          live.push_back(std::move(data));
+        }
+      }
+    }
+    std::sort(live.begin(), live.end(),
+              [](const std::shared_ptr<T>& d1, const std::shared_ptr<T>& d2) {
+                return d1->unique_id < d2->unique_id;
+              });
+    return live;
+  }
+
+ private:
+  static constexpr size_t kNumShards = 16;
+
+  struct Shard {
+    std::mutex lock;
+    std::vector<std::weak_ptr<T>> slots;
+    std::vector<size_t> free_slots;
+  };
+
+  static size_t GetThreadShard() {
+    static std::atomic<size_t> next_shard(0);
+    static thread_local size_t shard = next_shard.fetch_add(1) % kNumShards;
+    return shard;
+  }
+
+  std::array<Shard, kNumShards> shards_;
+};
+
+struct CompileManifest {
+  std::mutex lock;
+  std::vector<XLATensor::CompileManifestEntry> entries;
+  std::unordered_set<xla::hash_t, xla::util::HashReducer> hashes;
+};
+
+CompileManifest* GetCompileManifestRecord() {
+  static CompileManifest* manifest = new CompileManifest();
+  return manifest;
+}
+
+void RecordCompileManifestEntry(const xla::hash_t& hash, const Device& device,
+                                absl::Span<const std::string> devices) {
+  CompileManifest* manifest = GetCompileManifestRecord();
+  std::lock_guard<std::mutex> lock(manifest->lock);
+  if (manifest->hashes.insert(hash).second) {
+    XLATensor::CompileManifestEntry entry;
+    entry.hash = hash;
+    entry.device = device.ToString();
+    entry.devices.assign(devices.begin(), devices.end());
+    manifest->entries.push_back(std::move(entry));
+  }
+}
+
+// Hands out one mutex per graph hash, which the threads driving the local
+// devices of a single process (like the DataParallel ones) take to compile a
+// graph, so that the graph is compiled once, and the other threads pick it up
+// from the computation cache once the first compilation is done.
+class GraphCompileLocks {
+ public:
+  static GraphCompileLocks* Get() {
+    static GraphCompileLocks* locks = new GraphCompileLocks();
+    return locks;
+  }
+
+  std::shared_ptr<std::mutex> GetLock(const xla::hash_t& hash) {
+    std::lock_guard<std::mutex> lock(lock_);
+    std::shared_ptr<std::mutex> mutex = mutexes_[hash].lock();
+    if (mutex == nullptr) {
+      mutex = std::make_shared<std::mutex>();
+      mutexes_[hash] = mutex;
+      if (mutexes_.size() > kMaxExpiredMutexes) {
+        for (auto it = mutexes_.begin(); it != mutexes_.end();) {
+          it = it->second.expired() ? mutexes_.erase(it) : std::next(it);
+        }
+      }
+    }
+    return mutex;
+  }
+
+ private:
+  static constexpr size_t kMaxExpiredMutexes = 64;
+
+  std::mutex lock_;
+  std::map<xla::hash_t, std::weak_ptr<std::mutex>> mutexes_;
+};
+
+// Caches the computations used by XLATensor::ReadSlice(), which take the
+// tensor data and a vector with the start indices, and return the dynamic
+// slice of the given sizes. They are keyed by the data shape, the slice sizes
+// and the device, so that reading different windows of the same size does not
+// compile new computations.
+class SliceReadComputations {
+ public:
+  static SliceReadComputations* Get() {
+    static const size_t kMaxCacheSize =
+        xla::sys_util::GetEnvInt("XLA_SLICE_READ_CACHE_SIZE", 64);
+    static SliceReadComputations* computations =
+        new SliceReadComputations(kMaxCacheSize);
+    return computations;
+  }
+
+  xla::ComputationClient::ComputationPtr GetComputation(
+      const xla::Shape& shape, absl::Span<const xla::int64> sizes,
+      const Device& device) {
+    xla::hash_t key = xla::util::MHash(shape.ToString(/*print_layout=*/true),
+                                       sizes, device.ToString());
+    xla::ComputationClient::ComputationPtr computation = cache_.Get(key);
+    if (computation != nullptr) {
+      XLA_COUNTER("SliceReadCacheHit", 1);
+      return computation;
+    }
+    XLA_COUNTER("SliceReadCacheMiss", 1);
+    xla::XlaBuilder builder("SliceRead");
+    xla::XlaOp input = xla::Parameter(&builder, 0, shape, "input");
+    xla::XlaOp starts = xla::Parameter(
+        &builder, 1,
+        xla::ShapeUtil::MakeShape(xla::PrimitiveType::S32, {shape.rank()}),
+        "starts");
+    std::vector<xla::XlaOp> start_indices;
+    for (xla::int64 dim = 0; dim < shape.rank(); ++dim) {
+      start_indices.push_back(
+          xla::Reshape(xla::SliceInDim(starts, dim, dim + 1, 1, 0), {}));
+    }
+    xla::XlaOp slice = xla::DynamicSlice(
+        input, start_indices, xla::util::ToVector<xla::int64>(sizes));
+    xla::XlaComputation slice_computation =
+        ConsumeValue(builder.Build(slice));
+    xla::Shape result_shape = MakeShapeWithDeviceLayout(
+        ConsumeValue(slice_computation.GetProgramShape()).result(),
+        device.hw_type);
+    std::vector<xla::ComputationClient::CompileInstance> instances;
+    instances.push_back(
+        {std::move(slice_computation), device.ToString(),
+         xla::ComputationClient::Get()->GetCompilationDevices(
+             device.ToString(), {}),
+         &result_shape});
+    computation =
+        xla::ComputationClient::Get()->Compile(std::move(instances)).front();
+    return cache_.Add(key, std::move(computation));
+  }
+
+ private:
+  using Cache = xla::util::Cache<xla::hash_t,
+                                 xla::ComputationClient::Computation,
+                                 xla::util::HashReducer>;
+
+  explicit SliceReadComputations(size_t max_size) : cache_(max_size) {}
+
+  Cache cache_;
+};
+
 }  // namespace
 
 // The DeviceContextArena holds per device live information and statistics,
@@ -258,10 +963,12 @@ bool ShouldSyncIrValue(const ir::Value& ir_value) {
 class XLATensor::DeviceContextArena {
   struct DeviceContext {
     std::mutex lock;
-    std::map<xla::int64, std::weak_ptr<Data>> tensors_data;
+    LiveTensorRegistry<Data> tensors_data;
     xla::uint64 seed = 101;
     xla::uint64 running_seed = 101;
     ir::Value seed_ir_value;
+    // The device RNG state tensor, when XLA_DEVICE_RNG_STATE is enabled.
+    std::shared_ptr<Data> rng_state;
   };
 
  public:
@@ -271,28 +978,20 @@ class XLATensor::DeviceContextArena {
   }
 
   void RegisterTensor(std::shared_ptr<Data> data) {
-    DeviceContext* devctx = GetDeviceContext(data->device);
-    std::lock_guard<std::mutex> lock(devctx->lock);
-    devctx->tensors_data.emplace(data->unique_id, data);
+    GetDeviceContext(data->device)->tensors_data.Register(data);
     XLA_COUNTER("CreateXlaTensor", 1);
   }
 
   void UnregisterTensor(Data* data) {
-    DeviceContext* devctx = GetDeviceContext(data->device);
-    std::lock_guard<std::mutex> lock(devctx->lock);
-    devctx->tensors_data.erase(data->unique_id);
+    GetDeviceContext(data->device)->tensors_data.Unregister(data);
     XLA_COUNTER("DestroyXlaTensor", 1);
   }
 
   std::vector<XLATensor> GetLiveTensors(const Device* device) {
     std::vector<XLATensor> tensors;
     auto fn = [&](DeviceContext* devctx) {
-      std::lock_guard<std::mutex> lock(devctx->lock);
-      for (auto& uid_wptr : devctx->tensors_data) {
-        std::shared_ptr<Data> data = uid_wptr.second.lock();
-        if (data != nullptr) {
-          tensors.push_back(XLATensor(std::move(data)));
-        }
+      for (auto& data : devctx->tensors_data.GetLive()) {
+        tensors.push_back(XLATensor(std::move(data)));
       }
     };
     ForAllDeviceContexts(fn, device);
@@ -300,10 +999,10 @@ class XLATensor::DeviceContextArena {
   }
 
   ir::Value GetRngSeed(const Device& device) {
-    static const at::ScalarType kSeedType = at::ScalarType::Long;
-    static const xla::uint64 kSeedMul = 214013;
-    static const xla::uint64 kSeedAdd = 2531011;
     DeviceContext* devctx = GetDeviceContext(device);
+    if (UseDeviceRngState()) {
+      return GetDeviceRngSeed(devctx, device);
+    }
     std::lock_guard<std::mutex> lock(devctx->lock);
     if (!devctx->seed_ir_value) {
       devctx->seed_ir_value =
@@ -314,11 +1013,7 @@ class XLATensor::DeviceContextArena {
     devctx->running_seed = kSeedAdd + kSeedMul * devctx->running_seed;
     // Compose new seeds from the root seed, to avoid creating too many XLA
     // computation parameters which might overflow the TPU capacity.
-    ir::Value k = ir::ops::ScalarOp(MakeIntScalar(kSeedMul),
-                                    MakeXlaPrimitiveType(kSeedType, &device));
-    ir::Value b = ir::ops::ScalarOp(MakeIntScalar(kSeedAdd),
-                                    MakeXlaPrimitiveType(kSeedType, &device));
-    devctx->seed_ir_value = b + k * devctx->seed_ir_value;
+    devctx->seed_ir_value = AdvanceSeed(devctx->seed_ir_value, device);
     return devctx->seed_ir_value;
   }
 
@@ -330,15 +1025,24 @@ class XLATensor::DeviceContextArena {
 
   void SetRngSeed(const Device* device, xla::uint64 seed) {
     auto fn = [&](DeviceContext* devctx) {
+      // The state tensor unregisters itself from the device context when
+      // released, so it must be dropped outside of the lock.
+      std::shared_ptr<Data> rng_state;
       std::lock_guard<std::mutex> lock(devctx->lock);
       devctx->seed = seed;
       devctx->running_seed = devctx->seed;
       devctx->seed_ir_value = ir::Value();
+      rng_state = std::move(devctx->rng_state);
     };
     ForAllDeviceContexts(fn, device);
   }
 
   void StepRngSeed(const Device* device) {
+    if (UseDeviceRngState()) {
+      // The device state keeps advancing across steps, and the running seed
+      // mirrors it.
+      return;
+    }
     auto fn = [&](DeviceContext* devctx) {
       std::lock_guard<std::mutex> lock(devctx->lock);
       devctx->seed = 1012031 + devctx->seed * 7012063;
@@ -349,6 +1053,46 @@ class XLATensor::DeviceContextArena {
   }
 
  private:
+  static ir::Value AdvanceSeed(const ir::Value& seed, const Device& device) {
+    ir::Value k = ir::ops::ScalarOp(MakeIntScalar(kSeedMul),
+                                    MakeXlaPrimitiveType(kSeedType, &device));
+    ir::Value b = ir::ops::ScalarOp(MakeIntScalar(kSeedAdd),
+                                    MakeXlaPrimitiveType(kSeedType, &device));
+    return b + k * seed;
+  }
+
+  // The seeds are derived from the device state tensor, whose pending IR value
+  // becomes the advanced state. The state is a live tensor, so it is synced by
+  // the step graphs, and being non read-only device data, it is aliased to its
+  // own output, with no host transfer. The seed values never enter the graph
+  // hash, only the number of advances does.
+  ir::Value GetDeviceRngSeed(DeviceContext* devctx, const Device& device) {
+    std::shared_ptr<Data> new_state;
+    std::unique_lock<std::mutex> lock(devctx->lock);
+    if (devctx->rng_state == nullptr) {
+      at::Tensor seed_tensor = at::scalar_tensor(
+          static_cast<int64_t>(devctx->seed), at::TensorOptions(kSeedType));
+      // Creating the tensor registers it with the device context.
+      lock.unlock();
+      new_state =
+          XLATensor::Create(TensorToXlaData(seed_tensor, device), kSeedType)
+              .data_ptr();
+      lock.lock();
+      if (devctx->rng_state == nullptr) {
+        XLA_COUNTER("DeviceRngStateUpload", 1);
+        devctx->rng_state = new_state;
+      }
+    }
+    XLATensor state(devctx->rng_state);
+    devctx->running_seed = kSeedAdd + kSeedMul * devctx->running_seed;
+    ir::Value seed = AdvanceSeed(state.GetIrValue(), device);
+    state.data()->xla_data = nullptr;
+    state.ClearTensorData();
+    state.AssignIrValue(seed);
+    lock.unlock();
+    return seed;
+  }
+
   std::vector<DeviceContext*> GetAllDeviceContexts() {
     std::vector<DeviceContext*> all_device_contexts;
     std::lock_guard<std::mutex> lock(lock_);
@@ -371,11 +1115,20 @@ class XLATensor::DeviceContextArena {
   }
 
   DeviceContext* GetDeviceContext(const Device& device) {
+    // Device contexts are never released, so every thread can cache the last
+    // one it used, and skip the arena lock on the tensor creation paths.
+    static thread_local Device last_device;
+    static thread_local DeviceContext* last_devctx = nullptr;
+    if (last_devctx != nullptr && last_device == device) {
+      return last_devctx;
+    }
     std::lock_guard<std::mutex> lock(lock_);
     auto it = device_contexts_.find(device);
     if (it == device_contexts_.end()) {
       it = device_contexts_.emplace(device, new DeviceContext()).first;
     }
+    last_device = device;
+    last_devctx = it->second;
     return it->second;
   }
 
@@ -391,7 +1144,87 @@ struct DeviceDataInfo : public xla::ComputationClient::Data::Info {
   bool read_only = false;
 };
 
-XLATensor::Data::~Data() { DeviceContextArena::Get()->UnregisterTensor(this); }
+// Caches the results of the subgraphs whose leaves are all constants or read
+// only device data, keyed by the subgraph hash and the identities of the leaf
+// data. An entry is created the first time a subgraph is seen, and its result
+// is only materialized when the subgraph shows up again in a later sync, so
+// that the subgraphs over the inputs uploaded at every step do not trigger
+// extra executions. The entries track the leaf data with weak pointers, so
+// that they do not keep the inputs alive, and an entry whose leaf data is gone
+// is stale, as its addresses can have been reused by other data.
+class ReadOnlySubgraphCache {
+ public:
+  struct Entry {
+    std::vector<std::weak_ptr<xla::ComputationClient::Data>> leaves;
+    xla::ComputationClient::DataPtr data;
+  };
+
+  static ReadOnlySubgraphCache* Get() {
+    static const size_t kMaxCacheSize =
+        xla::sys_util::GetEnvInt("XLA_READ_ONLY_SUBGRAPHS_CACHE_SIZE", 128);
+    static ReadOnlySubgraphCache* cache =
+        new ReadOnlySubgraphCache(kMaxCacheSize);
+    return cache;
+  }
+
+  // Returns the hash of a leaf node, which includes the identity of its data,
+  // or nullopt if the node is neither a constant nor read only device data.
+  static c10::optional<xla::hash_t> GetLeafKey(const ir::Node* node) {
+    if (node->op() == ir::OpKind(at::prim::Constant)) {
+      return node->hash();
+    }
+    const ir::ops::DeviceData* device_data = ir::ops::DeviceData::Cast(node);
+    if (device_data == nullptr) {
+      return c10::nullopt;
+    }
+    DeviceDataInfo* data_info =
+        dynamic_cast<DeviceDataInfo*>(device_data->data()->info());
+    if (data_info == nullptr || !data_info->read_only) {
+      return c10::nullopt;
+    }
+    return xla::util::HashCombine(
+        node->hash(), xla::util::Hash(device_data->data().get()));
+  }
+
+  std::shared_ptr<Entry> Lookup(xla::hash_t key) {
+    std::shared_ptr<Entry> entry = cache_.Get(key);
+    if (entry == nullptr) {
+      return nullptr;
+    }
+    for (auto& leaf : entry->leaves) {
+      if (leaf.expired()) {
+        cache_.Erase(key);
+        return nullptr;
+      }
+    }
+    return entry;
+  }
+
+  std::shared_ptr<Entry> Add(xla::hash_t key, const ir::Node* root) {
+    auto entry = std::make_shared<Entry>();
+    for (auto node : ir::Util::ComputePostOrder({root})) {
+      const ir::ops::DeviceData* device_data = ir::ops::DeviceData::Cast(node);
+      if (device_data != nullptr) {
+        entry->leaves.push_back(device_data->data());
+      }
+    }
+    return cache_.Add(key, std::move(entry));
+  }
+
+ private:
+  using Cache = xla::util::Cache<xla::hash_t, Entry, xla::util::HashReducer>;
+
+  explicit ReadOnlySubgraphCache(size_t max_size) : cache_(max_size) {}
+
+  Cache cache_;
+};
+
+XLATensor::Data::~Data() {
+  if (retained_host_bytes > 0) {
+    RetainedHostBytesCounter()->AddValue(-retained_host_bytes);
+  }
+  DeviceContextArena::Get()->UnregisterTensor(this);
+}
 
 XLATensor::Async::Async(
     SyncTensorCollection* coll,
@@ -401,10 +1234,33 @@ XLATensor::Async::Async(
     : mwait(1),
       indices(std::move(coll->indices)),
       unlocker(std::move(coll->unlocker)),
+      wait_turn(std::move(coll->wait_turn)),
+      event(std::move(coll->event)),
       parameters_data(std::move(parameters_data)),
       device(coll->device.ToString()),
       cached_computation(std::move(cached_computation)),
-      tensors_data(std::move(tensors_data)) {}
+      tensors_data(std::move(tensors_data)),
+      ready(std::make_shared<xla::util::MultiWait>(1)),
+      profile_roots(std::move(coll->profile_roots)),
+      sharded_graph(std::move(coll->sharded_graph)) {
+  for (auto& data : this->tensors_data) {
+    if (data != nullptr) {
+      data->SetReadyEvent(ready);
+    }
+  }
+}
+
+std::function<void()> XLATensor::Async::Completer(std::function<void()> fn) {
+  return mwait.Completer([ready = ready, fn = std::move(fn)]() {
+    try {
+      fn();
+    } catch (...) {
+      ready->Done(std::current_exception());
+      throw;
+    }
+    ready->Done();
+  });
+}
 
 void XLATensor::Async::Wait() {
   mwait.Wait();
@@ -568,6 +1424,7 @@ xla::ComputationClient::DataPtr XLATensor::GetXlaData() {
   } else {
     XLA_CHECK(data()->tensor_data);
     data()->xla_data = TensorToXlaData(*data()->tensor_data, GetDevice());
+    ApplyHostDataRetention();
   }
   return data()->xla_data;
 }
@@ -589,6 +1446,49 @@ std::string XLATensor::DumpHloComputation(
                             : std::string();
 }
 
+xla::hash_t XLATensor::GetGraphHash(const std::vector<XLATensor>& tensors) {
+  SyncTensorsConfig config;
+  config.force_xla_data = false;
+  config.sync_xla_data = false;
+  return CollectSyncTensors(tensors, config).hash;
+}
+
+std::vector<XLATensor::CompilationStats> XLATensor::GetCachedComputationStats(
+    size_t top_n) {
+  std::vector<CompilationStats> computations_stats;
+  GetComputationCache()->ForEach(
+      [&](const xla::hash_t& hash,
+          const ComputationCache::TypePtr& cached_computation) {
+        computations_stats.push_back(cached_computation->stats);
+      });
+  std::sort(computations_stats.begin(), computations_stats.end(),
+            [](const CompilationStats& s1, const CompilationStats& s2) {
+              return s1.compile_time_ns > s2.compile_time_ns;
+            });
+  if (top_n > 0 && computations_stats.size() > top_n) {
+    computations_stats.resize(top_n);
+  }
+  return computations_stats;
+}
+
+size_t XLATensor::ClearReplicatedComputations() {
+  std::vector<xla::hash_t> hashes;
+  GetComputationCache()->ForEach(
+      [&](const xla::hash_t& hash,
+          const ComputationCache::TypePtr& cached_computation) {
+        if (cached_computation->stats.devices.size() > 1 ||
+            HasHloCollectives(
+                cached_computation->computation->computation())) {
+          hashes.push_back(hash);
+        }
+      });
+  for (auto& hash : hashes) {
+    GetComputationCache()->Erase(hash);
+  }
+  XLA_COUNTER("ReplicatedComputationsCleared", hashes.size());
+  return hashes.size();
+}
+
 void XLATensor::SetXlaData(xla::ComputationClient::DataPtr xla_data) {
   SetXlaData(std::move(xla_data), /*sync=*/true);
 }
@@ -596,18 +1496,20 @@ void XLATensor::SetXlaData(xla::ComputationClient::DataPtr xla_data) {
 void XLATensor::SetXlaData(xla::ComputationClient::DataPtr xla_data,
                            bool sync) {
   data()->xla_data = std::move(xla_data);
+  data()->stream = GetCurrentStream();
   // Assigning a device data should always clear the IR node, to allow graph
   // trimming. A view cannot be reset though, unless we are at a step-end sync.
   AssignIrValue(ir::Value());
   if (sync) {
     data()->view = nullptr;
-    data()->tensor_data = c10::nullopt;
+    ClearTensorData();
   }
 }
 
 void XLATensor::SetIrValue(ir::Value ir_value) {
   data()->xla_data = nullptr;
-  data()->tensor_data = c10::nullopt;
+  ClearTensorData();
+  data()->dead_hint = false;
   if (data()->view != nullptr) {
     // If we have an active view, and a SetIrValue() happens, it means we are
     // within an in-place execution context, and we need to update the view's
@@ -618,6 +1520,7 @@ void XLATensor::SetIrValue(ir::Value ir_value) {
     AssignIrValue(std::move(ir_value));
     TryLimitGraphSize();
   }
+  MaybeSpillPendingGraphs();
 }
 
 void XLATensor::SetInPlaceIrValue(ir::Value ir_value) {
@@ -636,18 +1539,68 @@ void XLATensor::AssignIrValue(ir::Value ir_value) const {
 
 void XLATensor::TryLimitGraphSize() {
   static const size_t kCheckFrequency =
-      xla::sys_util::GetEnvInt("XLA_TRIM_GRAPH_CHECK_FREQUENCY", 5000);
+      xla::sys_util::GetEnvInt("XLA_TRIM_GRAPH_CHECK_FREQUENCY", 1000);
   static const size_t kMaxPendingGraphSize =
       xla::sys_util::GetEnvInt("XLA_TRIM_GRAPH_SIZE", 100000);
-  if (data()->ir_value && ++g_tls_data.trim_counter % kCheckFrequency == 0) {
-    size_t graph_size = ir::Util::GetGraphSize({data()->ir_value.node.get()});
-    if (graph_size > kMaxPendingGraphSize) {
-      XLA_COUNTER("TrimIrGraph", 1);
-      ApplyPendingGraph();
-    }
+  ir::Node* node = data()->ir_value.node.get();
+  if (node == nullptr || node->graph_size() <= kMaxPendingGraphSize) {
+    return;
+  }
+  // The node graph size overcounts the shared subgraphs, so it is confirmed
+  // with a precise count. If that turns out to be below the limit, the next
+  // kCheckFrequency checks are skipped, to avoid walking graphs with a lot of
+  // sharing at every op.
+  if (g_tls_data.trim_counter > 0) {
+    --g_tls_data.trim_counter;
+    return;
+  }
+  XLA_COUNTER("TrimIrGraphCheck", 1);
+  size_t graph_size = ir::Util::GetGraphSize({node});
+  if (graph_size > kMaxPendingGraphSize) {
+    XLA_COUNTER("TrimIrGraph", 1);
+    ApplyPendingGraph();
+  } else {
+    node->set_graph_size(graph_size);
+    g_tls_data.trim_counter = kCheckFrequency;
   }
 }
 
+void XLATensor::MaybeSpillPendingGraphs() {
+  static const xla::int64 kHostBytesBudget =
+      xla::sys_util::GetEnvInt("XLA_PENDING_IR_HOST_BYTES", 0);
+  if (kHostBytesBudget <= 0 || g_tls_data.spilling) {
+    return;
+  }
+  xla::int64 host_bytes =
+      ir::Node::GetLiveHostBytes() + GetDeferredTensorsBytes();
+  ir::Value ir_value = CurrentIrValue();
+  if (host_bytes <= kHostBytesBudget || !ir_value) {
+    return;
+  }
+  // The first spill picks the anchor op. Then the spills wait for it to show
+  // up again, unless the budget gets exceeded by far.
+  xla::hash_t node_hash = ir_value->node_hash();
+  if (g_tls_data.spill_anchor != 0 && node_hash != g_tls_data.spill_anchor &&
+      host_bytes <= 2 * kHostBytesBudget) {
+    return;
+  }
+  if (node_hash != g_tls_data.spill_anchor) {
+    XLA_COUNTER("SpillAnchorChange", 1);
+    g_tls_data.spill_anchor = node_hash;
+  }
+  XLA_COUNTER("SpillPendingGraphs", 1);
+  TF_VLOG(3) << "Spilling the pending graphs of device " << GetDevice()
+             << ", holding " << host_bytes << " host bytes";
+  g_tls_data.spilling = true;
+  try {
+    SyncLiveTensorsGraph(&GetDevice(), /*devices=*/{}, /*wait=*/false);
+  } catch (...) {
+    g_tls_data.spilling = false;
+    throw;
+  }
+  g_tls_data.spilling = false;
+}
+
 ir::Value XLATensor::GetIrValue() const {
   ir::Value ir_value = CurrentIrValue();
   if (ir_value) {
@@ -661,6 +1614,7 @@ ir::Value XLATensor::GetIrValue() const {
     // will still collapse them all into a single XLA parameter op). So call
     // which wants the XLA data will still find it, w/out having to fetch it via
     // a computation client from-server call.
+    FenceStream();
     AssignIrValue(CreateTensorNode(xla_data, /*read_only=*/false));
     return data()->ir_value;
   }
@@ -678,9 +1632,34 @@ ir::Value XLATensor::CurrentIrValue() const {
 }
 
 void XLATensor::SetTensorData(at::Tensor tensor_data) {
+  ClearTensorData();
   data()->tensor_data = std::move(tensor_data);
 }
 
+void XLATensor::ClearTensorData() const {
+  data()->tensor_data = c10::nullopt;
+  if (data()->retained_host_bytes > 0) {
+    RetainedHostBytesCounter()->AddValue(-data()->retained_host_bytes);
+    data()->retained_host_bytes = 0;
+  }
+}
+
+void XLATensor::ApplyHostDataRetention() const {
+  if (!data()->tensor_data || data()->xla_data == nullptr ||
+      data()->retained_host_bytes > 0) {
+    return;
+  }
+  xla::int64 size =
+      data()->tensor_data->numel() * data()->tensor_data->element_size();
+  if (ShouldRetainHostData(size)) {
+    data()->retained_host_bytes = size;
+    RetainedHostBytesCounter()->AddValue(size);
+  } else {
+    data()->tensor_data = c10::nullopt;
+    XLA_COUNTER("DroppedHostBytes", size);
+  }
+}
+
 c10::optional<at::Tensor> XLATensor::CurrentTensorData() const {
   if (data()->view != nullptr && !data()->view->IsUpToDate()) {
     return c10::nullopt;
@@ -703,7 +1682,7 @@ ir::Value XLATensor::GetIrValueForTensor(const at::Tensor& tensor,
     read_only = true;
   } else {
     XLA_TIMED("IrValueTensorToXlaData");
-    data = TensorToXlaData(tensor, device);
+    data = GetTensorDeviceData(tensor, device, &read_only);
   }
   return CreateTensorNode(std::move(data), read_only);
 }
@@ -759,7 +1738,7 @@ View::IrNode XLATensor::GetViewUpdate(const std::shared_ptr<View>& view) const {
   View::IrNode ir_value_updated = view->GetViewIrNode();
   if (ir_value_updated.updated) {
     data()->xla_data = nullptr;
-    data()->tensor_data = c10::nullopt;
+    ClearTensorData();
   }
   return ir_value_updated;
 }
@@ -809,13 +1788,14 @@ at::Tensor XLATensor::ToTensor(bool detached) {
   at::Tensor tensor;
   c10::optional<at::Tensor> tensor_data = CurrentTensorData();
   if (!tensor_data) {
-    DeviceBarrier(GetDevice());
+    WaitDataReady(CurrentXlaData());
     // The GetXlaData() call will trigger an ApplyPendingGraph() if an IR Node
     // is available on the tensor.
     std::vector<at::Tensor> tensors = XlaDataToTensors({GetXlaData()}, dtype());
     tensor = std::move(tensors.front());
     if (!detached) {
       SetTensorData(tensor);
+      ApplyHostDataRetention();
     }
   } else {
     tensor = *tensor_data;
@@ -824,7 +1804,7 @@ at::Tensor XLATensor::ToTensor(bool detached) {
           data()->view != nullptr) {
         // If we have other authoritive sources, just drop our reference and
         // transfer it to the caller.
-        data()->tensor_data = c10::nullopt;
+        ClearTensorData();
       } else {
         // Otherwise we need to make a copy to prevent the caller changing our
         // version.
@@ -888,6 +1868,73 @@ std::vector<XLATensor> XLATensor::GetLiveTensors(const Device* device) {
   return DeviceContextArena::Get()->GetLiveTensors(device);
 }
 
+void XLATensor::SetLivenessHint(bool live) const { data()->dead_hint = !live; }
+
+void XLATensor::Freeze() {
+  XLA_CHECK(data()->view == nullptr) << "Views cannot be frozen";
+  xla::ComputationClient::DataPtr xla_data = GetXlaData();
+  at::Tensor value = XlaDataToTensors({xla_data}, dtype()).front();
+  // The tensor keeps its device data, which is what the reads fetch, while
+  // the IR value holding the constant is what the graphs are built upon. As
+  // long as the device data is there, the syncs leave the IR value alone.
+  AssignIrValue(ir::MakeNode<ir::ops::Constant>(
+      GetTensorLiteral(value, &xla_data->shape(), &GetDevice())));
+  XLA_COUNTER("FrozenTensors", 1);
+}
+
+void XLATensor::SetShardingSpec(ShardingSpecPtr sharding_spec) {
+  XLA_CHECK(sharding_spec != nullptr);
+  data()->sharding_spec = sharding_spec;
+  if (CurrentXlaData() == nullptr && CurrentIrValue()) {
+    // The graph materializing the tensor value produces it sharded.
+    return;
+  }
+  xla::ComputationClient::DataPtr xla_data = GetXlaData();
+  ShardedData* sharded_data = ShardingUtil::GetShardedData(xla_data);
+  if (sharded_data != nullptr &&
+      ShardingUtil::EqualSpecs(*sharded_data->spec(), *sharding_spec)) {
+    return;
+  }
+  at::Tensor value = XlaDataToTensors({xla_data}, dtype()).front();
+  SetXlaData(ShardingUtil::CreateShardedData(value, GetDevice(),
+                                             std::move(sharding_spec)));
+  XLA_COUNTER("ShardedTensors", 1);
+}
+
+void XLATensor::ClearShardingSpec() {
+  data()->sharding_spec = nullptr;
+  xla::ComputationClient::DataPtr xla_data = CurrentXlaData();
+  if (xla_data != nullptr &&
+      ShardingUtil::GetShardedData(xla_data) != nullptr) {
+    WaitDataReady(xla_data);
+    at::Tensor value = XlaDataToTensors({xla_data}, dtype()).front();
+    SetXlaData(TensorToXlaData(value, GetDevice()));
+  }
+}
+
+ShardingSpecPtr XLATensor::GetShardingSpec() const {
+  return data()->sharding_spec;
+}
+
+void XLATensor::DropUnusedLiveTensors(std::vector<XLATensor>* tensors) {
+  size_t num_dropped = 0;
+  auto it = std::remove_if(
+      tensors->begin(), tensors->end(), [&](const XLATensor& tensor) {
+        if (tensor.CurrentXlaData() != nullptr) {
+          return false;
+        }
+        // A use count of one means that no tensor object (hence no Python
+        // reference) holds the data anymore, and the tensor is expiring.
+        bool unused = tensor.data()->dead_hint || tensor.data_.use_count() == 1;
+        num_dropped += unused ? 1 : 0;
+        return unused;
+      });
+  tensors->erase(it, tensors->end());
+  if (num_dropped > 0) {
+    XLA_COUNTER("SyncDroppedLiveTensors", num_dropped);
+  }
+}
+
 std::vector<xla::ComputationClient::DataPtr> XLATensor::GatherTensorsXlaData(
     const std::vector<XLATensor>& tensors, absl::Span<const size_t> indices,
     absl::Span<const xla::ComputationClient::DataPtr> tensors_data) {
@@ -909,11 +1956,42 @@ std::vector<xla::ComputationClient::DataPtr> XLATensor::GatherTensorsXlaData(
   return result_tensors_data;
 }
 
+std::vector<at::Tensor> XLATensor::FetchTensors(
+    const std::vector<XLATensor>& tensors,
+    absl::Span<const xla::ComputationClient::DataPtr> tensors_data) {
+  std::vector<at::ScalarType> element_types;
+  element_types.reserve(tensors_data.size());
+  for (auto& tensor : tensors) {
+    if (!tensor.CurrentTensorData()) {
+      element_types.push_back(tensor.dtype());
+    }
+  }
+  std::vector<at::Tensor> literal_tensors =
+      XlaDataToTensors(tensors_data, element_types);
+  std::vector<at::Tensor> results;
+  size_t literals_index = 0;
+  results.reserve(tensors.size());
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    c10::optional<at::Tensor> tensor_data = tensors[i].CurrentTensorData();
+    if (tensor_data) {
+      results.push_back(*tensor_data);
+    } else {
+      XLA_CHECK_LT(literals_index, literal_tensors.size());
+      results.push_back(std::move(literal_tensors[literals_index]));
+      ++literals_index;
+    }
+  }
+  return results;
+}
+
 std::vector<at::Tensor> XLATensor::GetTensorsOpByOp(
     std::vector<XLATensor>* tensors) {
   SyncTensorsConfig config;
   config.force_xla_data = false;
   SyncTensorCollection coll = CollectSyncTensors(*tensors, config);
+  if (coll.wait_turn) {
+    coll.wait_turn();
+  }
   std::vector<xla::ComputationClient::DataPtr> async_tensors_data;
   if (!coll.indices.empty()) {
     DebugUtil::SaveTensorsGraphInfo("GetTensorsOpByOp", *tensors,
@@ -926,23 +2004,7 @@ std::vector<at::Tensor> XLATensor::GetTensorsOpByOp(
 
   std::vector<xla::ComputationClient::DataPtr> tensors_data =
       GatherTensorsXlaData(*tensors, coll.indices, async_tensors_data);
-  std::vector<xla::Literal> literals =
-      xla::ComputationClient::Get()->TransferFromServer(tensors_data);
-  std::vector<at::Tensor> results;
-  size_t literals_index = 0;
-  results.reserve(tensors->size());
-  for (size_t i = 0; i < tensors->size(); ++i) {
-    c10::optional<at::Tensor> tensor_data = (*tensors)[i].CurrentTensorData();
-    if (tensor_data) {
-      results.push_back(*tensor_data);
-    } else {
-      XLA_CHECK_LT(literals_index, literals.size());
-      results.push_back(MakeTensorFromXlaLiteral(literals[literals_index],
-                                                 (*tensors)[i].dtype()));
-      ++literals_index;
-    }
-  }
-  return results;
+  return FetchTensors(*tensors, tensors_data);
 }
 
 std::vector<at::Tensor> XLATensor::GetTensors(std::vector<XLATensor>* tensors) {
@@ -959,6 +2021,9 @@ std::vector<at::Tensor> XLATensor::GetTensorsFused(
   if (async != nullptr) {
     async->mwait.Wait();
   }
+  // The device data of the tensors which did not need a sync might still be
+  // pending within operations queued by previous steps.
+  WaitTensors(*tensors);
   std::vector<xla::ComputationClient::DataPtr> tensors_data =
       GatherTensorsXlaData(
           *tensors,
@@ -966,23 +2031,139 @@ std::vector<at::Tensor> XLATensor::GetTensorsFused(
           async != nullptr
               ? async->tensors_data
               : absl::Span<const xla::ComputationClient::DataPtr>());
-  std::vector<xla::Literal> literals =
-      xla::ComputationClient::Get()->TransferFromServer(tensors_data);
-  std::vector<at::Tensor> results;
-  size_t literals_index = 0;
-  results.reserve(tensors->size());
+  return FetchTensors(*tensors, tensors_data);
+}
+
+at::Tensor XLATensor::ReadSlice(absl::Span<const xla::int64> start_indices,
+                                absl::Span<const xla::int64> sizes) {
+  xla::util::MaybeRef<xla::Shape> tensor_shape = shape();
+  XLA_CHECK_EQ(start_indices.size(), tensor_shape.get().rank());
+  XLA_CHECK_EQ(sizes.size(), tensor_shape.get().rank());
+  for (size_t dim = 0; dim < sizes.size(); ++dim) {
+    XLA_CHECK(start_indices[dim] >= 0 && sizes[dim] >= 0 &&
+              start_indices[dim] + sizes[dim] <=
+                  tensor_shape.get().dimensions(dim))
+        << "Slice of size " << sizes[dim] << " at " << start_indices[dim]
+        << " is out of bounds for dimension " << dim << " of "
+        << tensor_shape.get();
+  }
+  c10::optional<at::Tensor> tensor_data = CurrentTensorData();
+  if (tensor_data) {
+    at::Tensor slice = *tensor_data;
+    for (size_t dim = 0; dim < sizes.size(); ++dim) {
+      slice = slice.narrow(dim, start_indices[dim], sizes[dim]);
+    }
+    return slice.clone();
+  }
+  xla::ComputationClient::DataPtr xla_data = CurrentXlaData();
+  if (xla_data == nullptr || data()->view != nullptr) {
+    xla_data = GetXlaData();
+  }
+  XLA_CHECK(ShardingUtil::GetShardedData(xla_data) == nullptr)
+      << "Slice reads of sharded tensors are not supported";
+  XLA_COUNTER("SliceReads", 1);
+  XLA_TIMED("SliceRead");
+  const Device& device = GetDevice();
+  xla::ComputationClient::ComputationPtr computation =
+      SliceReadComputations::Get()->GetComputation(xla_data->shape(), sizes,
+                                                   device);
+  // The start indices are device data, so that every window of a given size
+  // runs the same computation. Their uploads are cached by value as well.
+  std::vector<int32_t> starts(start_indices.begin(), start_indices.end());
+  xla::ComputationClient::DataPtr starts_data = GetDeviceData(
+      at::tensor(starts, at::TensorOptions(at::ScalarType::Int)), device);
+  MaterializeDeferredTensorsData({starts_data});
+
+  // Holding a slot of the device execution queue makes sure that the tensor
+  // data is available, and that no later computation can alias it meanwhile.
+  std::function<void()> wait_turn;
+  std::vector<xla::util::ExceptionCleanup> unlocker =
+      LockDevices({device}, &wait_turn);
+  wait_turn();
+  WaitDataReady(xla_data);
+  std::vector<xla::ComputationClient::DataPtr> results =
+      xla::ComputationClient::Get()->ExecuteComputation(
+          *computation, {xla_data, starts_data}, device.ToString(),
+          xla::ComputationClient::ExecuteComputationOptions());
+  return XlaDataToTensors(results, dtype()).front();
+}
+
+std::vector<at::Tensor> XLATensor::AsyncFetch::Wait() {
+  mwait.Wait();
+  return results;
+}
+
+std::shared_ptr<XLATensor::AsyncFetch> XLATensor::FetchTensorsAsync(
+    std::vector<XLATensor>* tensors) {
+  static const size_t num_chunks = std::max<size_t>(
+      xla::sys_util::GetEnvInt("XLA_ASYNC_FETCH_CHUNKS", 4), 1);
+  SyncTensorsConfig config;
+  config.sync_xla_data = true;
+  auto async = SyncTensorsGraphInternal(tensors, {}, config);
+  std::vector<xla::ComputationClient::DataPtr> tensors_data =
+      GatherTensorsXlaData(
+          *tensors,
+          async != nullptr ? async->indices : absl::Span<const size_t>(),
+          async != nullptr
+              ? async->tensors_data
+              : absl::Span<const xla::ComputationClient::DataPtr>());
+
+  auto fetch = std::make_shared<AsyncFetch>();
+  fetch->results.resize(tensors->size());
+  std::vector<at::ScalarType> element_types;
+  std::vector<size_t> result_indices;
+  std::set<Device> devices;
   for (size_t i = 0; i < tensors->size(); ++i) {
-    c10::optional<at::Tensor> tensor_data = (*tensors)[i].CurrentTensorData();
+    const XLATensor& tensor = (*tensors)[i];
+    c10::optional<at::Tensor> tensor_data = tensor.CurrentTensorData();
     if (tensor_data) {
-      results.push_back(*tensor_data);
+      fetch->results[i] = *tensor_data;
     } else {
-      XLA_CHECK_LT(literals_index, literals.size());
-      results.push_back(MakeTensorFromXlaLiteral(literals[literals_index],
-                                                 (*tensors)[i].dtype()));
-      ++literals_index;
+      element_types.push_back(tensor.dtype());
+      result_indices.push_back(i);
+      devices.insert(tensor.GetDevice());
     }
   }
-  return results;
+  XLA_CHECK_EQ(tensors_data.size(), result_indices.size());
+  // The queue slot is taken after the computation which has just been
+  // scheduled, so the fetch only runs once the tensors data is available.
+  std::function<void()> wait_turn;
+  auto unlocker = std::make_shared<std::vector<xla::util::ExceptionCleanup>>(
+      LockDevices(devices, &wait_turn));
+  auto fetchfn = [fetch, tensors_data = std::move(tensors_data),
+                  element_types = std::move(element_types),
+                  result_indices = std::move(result_indices),
+                  unlocker = std::move(unlocker),
+                  wait_turn = std::move(wait_turn)]() {
+    XLA_TIMED("AsyncFetchTensors");
+    if (wait_turn) {
+      wait_turn();
+    }
+    xla::int64 start_ns = xla::sys_util::NowNs();
+    size_t chunk_size = std::max<size_t>(
+        (tensors_data.size() + num_chunks - 1) / num_chunks, 1);
+    size_t count = (tensors_data.size() + chunk_size - 1) / chunk_size;
+    xla::util::MultiWait mwait(count);
+    for (size_t start = 0; start < tensors_data.size(); start += chunk_size) {
+      size_t size = std::min(chunk_size, tensors_data.size() - start);
+      auto chunkfn = [&, start, size]() {
+        std::vector<at::Tensor> chunk_tensors = XlaDataToTensors(
+            absl::MakeConstSpan(tensors_data).subspan(start, size),
+            absl::MakeConstSpan(element_types).subspan(start, size));
+        for (size_t i = 0; i < size; ++i) {
+          fetch->results[result_indices[start + i]] =
+              std::move(chunk_tensors[i]);
+        }
+      };
+      xla::env::ScheduleIoClosure(mwait.Completer(std::move(chunkfn)));
+    }
+    mwait.Wait();
+    fetch->transfer_ns = xla::sys_util::NowNs() - start_ns;
+    // Releases the device queue slot.
+    unlocker->clear();
+  };
+  xla::env::ScheduleIoClosure(fetch->mwait.Completer(std::move(fetchfn)));
+  return fetch;
 }
 
 std::vector<XLATensor> XLATensor::CreateTensors(
@@ -998,6 +2179,25 @@ std::vector<XLATensor> XLATensor::CreateTensors(
   return xla_tensors;
 }
 
+std::vector<XLATensor> XLATensor::AsyncUpload::Wait() {
+  mwait.Wait();
+  return results;
+}
+
+std::shared_ptr<XLATensor::AsyncUpload> XLATensor::CreateTensorsAsync(
+    std::vector<at::Tensor> tensors, std::vector<std::string> devices) {
+  auto upload = std::make_shared<AsyncUpload>();
+  auto uploadfn = [upload, tensors = std::move(tensors),
+                   devices = std::move(devices)]() {
+    XLA_TIMED("AsyncUploadTensors");
+    xla::int64 start_ns = xla::sys_util::NowNs();
+    upload->results = CreateTensors(tensors, devices);
+    upload->transfer_ns = xla::sys_util::NowNs() - start_ns;
+  };
+  xla::env::ScheduleIoClosure(upload->mwait.Completer(std::move(uploadfn)));
+  return upload;
+}
+
 ir::Value XLATensor::CreateTensorNode(xla::ComputationClient::DataPtr data,
                                       bool read_only) const {
   data->SetInfo(std::make_shared<DeviceDataInfo>(GetUniqueId(), read_only));
@@ -1014,7 +2214,27 @@ std::vector<XLATensor> XLATensor::MakeOutputTensors(ir::NodePtr node) const {
 }
 
 XLATensor XLATensor::CopyTensorToDevice(const Device& device) {
-  // TODO: This can be optimized via proper XRT/XLA computation.
+  // Tensors whose value still lives on host are uploaded straight to the new
+  // device. Device data of the same device type is copied within its resource
+  // domain when possible, and goes through a host round trip otherwise.
+  if (CurrentXlaData() == nullptr && !CurrentIrValue()) {
+    c10::optional<at::Tensor> tensor_data = CurrentTensorData();
+    if (tensor_data) {
+      return Create(*tensor_data, device);
+    }
+  }
+  if (device.hw_type == GetDevice().hw_type) {
+    // Wait for any asynchronous execution still producing the source data.
+    WaitDataReady(CurrentXlaData());
+    std::vector<xla::ComputationClient::DataPtr> results =
+        xla::ComputationClient::Get()->CopyDataToDevice({GetXlaData()},
+                                                        {device.ToString()});
+    if (results.front() != nullptr) {
+      XLA_COUNTER("DeviceToDeviceCopy", 1);
+      return Create(std::move(results.front()), dtype_optional());
+    }
+  }
+  XLA_COUNTER("HostRoundTripDeviceCopy", 1);
   return Create(ToTensor(/*detached=*/true), device);
 }
 
@@ -1026,6 +2246,17 @@ ir::Value XLATensor::MaybeCastIrValue(
   }
   if (logical_element_type &&
       RequiresRawTypeCasting(*logical_element_type, &device)) {
+    static const bool simplify =
+        xla::sys_util::GetEnvBool("XLA_IR_SIMPLIFY", true);
+    // Values flowing from tensor to tensor often are already the result of
+    // the same logical type cast, which does not need to be applied twice.
+    ir::ops::Cast* cast =
+        ir::NodeCast<ir::ops::Cast>(ir_value.node.get(), ir::ops::xla_cast);
+    if (simplify && cast != nullptr &&
+        cast->dtype() == logical_element_type && !cast->stype()) {
+      XLA_COUNTER("SimplifiedIrOps", 1);
+      return ir_value;
+    }
     ir_value = ir::MakeNode<ir::ops::Cast>(ir_value, *logical_element_type);
   }
   return ir_value;
@@ -1067,12 +2298,26 @@ XLATensor XLATensor::CreateFrom(ir::Value ir_value, const Device& device,
 }
 
 void XLATensor::ApplyPendingGraph() {
-  DeviceBarrier(GetDevice());
   // This method is called to ensure that the tensor data is available on
   // device, so that a call to CurrentXlaData() returns a valid pointer.
-  if (CurrentXlaData() == nullptr) {
+  xla::ComputationClient::DataPtr xla_data = CurrentXlaData();
+  if (xla_data == nullptr) {
     std::vector<XLATensor> tensors({*this});
+    std::vector<std::vector<ir::Use>> shared_uses =
+        AddSharedSubgraphs(&tensors);
     SyncTensorsGraph(&tensors, {}, /*wait=*/true, /*sync_xla_data=*/false);
+    for (size_t i = 0; i < shared_uses.size(); ++i) {
+      xla::ComputationClient::DataPtr shared_data =
+          tensors[i + 1].CurrentXlaData();
+      XLA_CHECK(shared_data != nullptr);
+      ir::NodePtr device_data =
+          ir::MakeNode<ir::ops::DeviceData>(std::move(shared_data));
+      for (auto& use : shared_uses[i]) {
+        use.node->ReplaceOperand(use.operand_index, device_data);
+      }
+    }
+  } else {
+    WaitDataReady(xla_data);
   }
 }
 
@@ -1098,9 +2343,19 @@ XLATensor::SyncTensorCollection XLATensor::CollectSyncTensors(
   coll.indices.reserve(tensors.size());
   TF_VLOG(4) << "Waiting on device barrier for device " << coll.device
              << " ...";
+  if (xla::metrics::IsFlightRecorderEnabled()) {
+    coll.event = std::make_shared<xla::metrics::GraphEvent>();
+    coll.event->device = coll.device.ToString();
+    coll.event->lock_start_ns = xla::sys_util::NowNs();
+  }
   {
     XLA_TIMED("DeviceLockWait");
-    coll.unlocker = LockDevices(unique_device.AsSet());
+    HostPhaseTimer phase_timer(HostPhase::kDeviceLockWait);
+    coll.unlocker = LockDevices(unique_device.AsSet(), &coll.wait_turn);
+  }
+  if (coll.event != nullptr) {
+    coll.event->lock_wait_ns =
+        xla::sys_util::NowNs() - coll.event->lock_start_ns;
   }
   TF_VLOG(4) << "Waiting on device barrier for device " << coll.device
              << " done!";
@@ -1136,9 +2391,11 @@ XLATensor::SyncTensorCollection XLATensor::CollectSyncTensors(
     for (size_t i = 0; i < handles.size(); ++i) {
       // If we are here, it means that the IR Value for the tensor is not
       // present. Also, we uploaded the at::Tensor data to the device, but such
-      // data is still valid so we leave it live on the XLA tensor (so that a
-      // following ToTensor() does not need to fetch it from device).
+      // data is still valid so we may leave it live on the XLA tensor (so that
+      // a following ToTensor() does not need to fetch it from device), if the
+      // host data retention policy allows.
       tensors[at_tensor_index[i]].data()->xla_data = std::move(handles[i]);
+      tensors[at_tensor_index[i]].ApplyHostDataRetention();
     }
   }
   TF_VLOG(4) << "Tensors graph hash " << xla::util::HexHash(coll.hash)
@@ -1167,53 +2424,111 @@ XLATensor::ComputationCache::TypePtr XLATensor::LookupCachedCompile(
 std::shared_ptr<XLATensor::Async> XLATensor::TryRunCachedSync(
     std::vector<XLATensor>* tensors, SyncTensorCollection* coll,
     PostOrderData* po_data) {
-  ComputationCache::TypePtr cached_computation =
-      LookupCachedCompile(*tensors, coll->hash);
+  ComputationCache::TypePtr cached_computation;
+  {
+    HostPhaseTimer phase_timer(HostPhase::kCacheLookup);
+    cached_computation = LookupCachedCompile(*tensors, coll->hash);
+  }
   if (cached_computation == nullptr) {
     return nullptr;
   }
-  XLA_VALUE_METRIC("TensorsGraphSize", po_data->post_order.size());
-  TF_VLOG(5) << "TensorsGraphSize=" << po_data->post_order.size();
+  XLA_VALUE_METRIC("TensorsGraphSize", po_data->graph_size);
+  TF_VLOG(5) << "TensorsGraphSize=" << po_data->graph_size;
 
   return ScheduleSyncTensorsGraph(
       tensors, coll, std::move(po_data->parameters_data),
       coll->device.ToString(), std::move(cached_computation));
 }
 
+void XLATensor::PinComputation(const xla::hash_t& hash, bool pinned) {
+  PinnedComputations::Get()->Set(hash, pinned);
+}
+
 XLATensor::ComputationCache* XLATensor::GetComputationCache() {
   static const size_t kMaxCacheSize =
       xla::sys_util::GetEnvInt("XLA_COMPILATION_CACHE_SIZE", 1024);
-  static ComputationCache* cache = new ComputationCache(kMaxCacheSize);
+  static const bool kCostEviction =
+      xla::sys_util::GetEnvBool("XLA_COMPILATION_CACHE_COST_EVICTION", true);
+  // The cost of a computation is its compile time in seconds, with a floor so
+  // that the hit count still matters for the cheap ones. The cache is bounded
+  // by entry count, and XRT does not report the executable sizes, so all the
+  // computations are given the same size.
+  auto cost_fn = [](const xla::hash_t& hash,
+                    const CachedComputation& cached_computation) {
+    if (PinnedComputations::Get()->IsPinned(hash)) {
+      return std::numeric_limits<double>::infinity();
+    }
+    return std::max<xla::int64>(cached_computation.stats.compile_time_ns,
+                                1000000) *
+           1e-9;
+  };
+  auto evict_fn = [](const xla::hash_t& hash,
+                     const ComputationCache::TypePtr& cached_computation,
+                     double cost) {
+    XLA_COUNTER("CompilationCacheEvictions", 1);
+    if (cost == std::numeric_limits<double>::infinity()) {
+      XLA_COUNTER("CompilationCachePinnedEvictions", 1);
+    } else if (cost < 1.0) {
+      XLA_COUNTER("CompilationCacheEvictionsUnder1s", 1);
+    } else if (cost < 10.0) {
+      XLA_COUNTER("CompilationCacheEvictionsUnder10s", 1);
+    } else if (cost < 60.0) {
+      XLA_COUNTER("CompilationCacheEvictionsUnder60s", 1);
+    } else {
+      XLA_COUNTER("CompilationCacheEvictionsOver60s", 1);
+    }
+  };
+  static ComputationCache* cache =
+      kCostEviction
+          ? new ComputationCache(kMaxCacheSize, /*num_shards=*/16, cost_fn,
+                                 evict_fn)
+          : new ComputationCache(kMaxCacheSize);
   return cache;
 }
 
 XLATensor::PostOrderData XLATensor::RunPostOrder(
-    const std::vector<XLATensor>& tensors, absl::Span<const size_t> indices) {
-  std::vector<const ir::Node*> roots;
+    const std::vector<XLATensor>& tensors, absl::Span<const size_t> indices,
+    bool parameters_only) {
+  std::vector<ir::NodePtr> roots;
   roots.reserve(indices.size());
   for (auto index : indices) {
     ir::Value ir_value = tensors.at(index).CurrentIrValue();
-    roots.push_back(ir_value.node.get());
+    roots.push_back(ir_value.node);
   }
   PostOrderData po_data;
-  po_data.post_order = ir::Util::ComputePostOrder(roots, &po_data.emission_map);
-  std::unordered_map<xla::ComputationClient::Data::OpaqueHandle, size_t>
-      data_handles;
+  GraphParametersCache* parameters_cache = GraphParametersCache::Get();
+  if (parameters_only && parameters_cache != nullptr) {
+    auto entry = parameters_cache->Lookup(roots);
+    if (entry != nullptr) {
+      XLA_COUNTER("GraphParametersCacheHit", 1);
+      po_data.graph_size = entry->graph_size;
+      CollectParametersData(entry->device_data, &po_data.parameters_data,
+                            &po_data.parameter_sequence);
+      return po_data;
+    }
+    XLA_COUNTER("GraphParametersCacheMiss", 1);
+  }
+  std::vector<const ir::Node*> root_nodes;
+  root_nodes.reserve(roots.size());
+  for (auto& root : roots) {
+    root_nodes.push_back(root.get());
+  }
+  po_data.post_order =
+      ir::Util::ComputePostOrder(root_nodes, &po_data.emission_map);
+  po_data.graph_size = po_data.post_order.size();
+  std::vector<const ir::ops::DeviceData*> device_data;
   for (auto node : po_data.post_order) {
-    const ir::ops::DeviceData* device_data = ir::ops::DeviceData::Cast(node);
-    if (device_data != nullptr) {
-      xla::ComputationClient::Data::OpaqueHandle handle =
-          device_data->data()->GetOpaqueHandle();
-      auto it = data_handles.find(handle);
-      if (it != data_handles.end()) {
-        po_data.parameter_sequence.push_back(it->second);
-      } else {
-        po_data.parameter_sequence.push_back(po_data.parameters_data.size());
-        data_handles[handle] = po_data.parameters_data.size();
-        po_data.parameters_data.push_back(device_data->data());
-      }
+    const ir::ops::DeviceData* device_data_node =
+        ir::ops::DeviceData::Cast(node);
+    if (device_data_node != nullptr) {
+      device_data.push_back(device_data_node);
     }
   }
+  CollectParametersData(device_data, &po_data.parameters_data,
+                        &po_data.parameter_sequence);
+  if (parameters_cache != nullptr) {
+    parameters_cache->Add(roots, std::move(device_data), po_data.graph_size);
+  }
   return po_data;
 }
 
@@ -1229,7 +2544,7 @@ std::vector<ir::Value> XLATensor::CollectRoots(
 
 std::vector<xla::ComputationClient::DataPtr> XLATensor::FetchTensorData(
     std::vector<XLATensor>* tensors, const SyncTensorsConfig& config,
-    absl::Span<const size_t> indices) {
+    absl::Span<const size_t> indices, const ShardedGraph* sharded_graph) {
   std::vector<xla::ComputationClient::DataPtr> tensors_data;
   tensors_data.reserve(indices.size());
   for (auto index : indices) {
@@ -1248,8 +2563,14 @@ std::vector<xla::ComputationClient::DataPtr> XLATensor::FetchTensorData(
       const Device& tensor_device = tensor.GetDevice();
       xla::Shape shape =
           MakeShapeWithDeviceLayout(tensor.shape(), tensor_device.hw_type);
-      xla_data = xla::ComputationClient::Get()->CreateDataPlaceholder(
-          tensor_device.ToString(), std::move(shape));
+      if (sharded_graph != nullptr) {
+        xla_data = ShardingUtil::CreateShardedPlaceholder(
+            tensor_device, std::move(shape),
+            sharded_graph->output_specs.at(tensors_data.size()));
+      } else {
+        xla_data = xla::ComputationClient::Get()->CreateDataPlaceholder(
+            tensor_device.ToString(), std::move(shape));
+      }
       tensor.SetXlaData(xla_data, config.sync_xla_data);
     }
     tensors_data.emplace_back(std::move(xla_data));
@@ -1257,25 +2578,119 @@ std::vector<xla::ComputationClient::DataPtr> XLATensor::FetchTensorData(
   return tensors_data;
 }
 
+void XLATensor::CollectShardedGraph(const std::vector<XLATensor>& tensors,
+                                    const PostOrderData& po_data,
+                                    SyncTensorCollection* coll) {
+  std::vector<std::string> devices;
+  auto add_spec = [&](const ShardingSpec& spec) {
+    if (devices.empty()) {
+      devices = spec.devices;
+    }
+    XLA_CHECK(devices == spec.devices)
+        << "A graph cannot mix tensors sharded across different meshes: "
+        << ShardingUtil::GetSpecString(spec);
+  };
+  for (auto index : coll->indices) {
+    const ShardingSpecPtr& spec = tensors[index].data()->sharding_spec;
+    if (spec != nullptr) {
+      add_spec(*spec);
+    }
+  }
+  for (auto& data : po_data.parameters_data) {
+    ShardedData* sharded_data = ShardingUtil::GetShardedData(data);
+    if (sharded_data != nullptr) {
+      add_spec(*sharded_data->spec());
+    }
+  }
+  if (devices.empty()) {
+    return;
+  }
+  auto sharded_graph = std::make_shared<ShardedGraph>();
+  ShardingSpecPtr replicated_spec = ShardingUtil::CreateReplicatedSpec(devices);
+  xla::hash_t hash = xla::util::Hash(devices);
+  for (auto index : coll->indices) {
+    const XLATensor& tensor = tensors[index];
+    ShardingSpecPtr spec = tensor.data()->sharding_spec;
+    if (spec == nullptr) {
+      spec = replicated_spec;
+    }
+    hash = xla::util::HashCombine(hash, ShardingUtil::GetSpecHash(*spec));
+    sharded_graph->output_specs.push_back(std::move(spec));
+    sharded_graph->output_shapes.push_back(MakeShapeWithDeviceLayout(
+        tensor.shape(), tensor.GetDevice().hw_type));
+  }
+  for (size_t i = 0; i < po_data.parameters_data.size(); ++i) {
+    ShardedData* sharded_data =
+        ShardingUtil::GetShardedData(po_data.parameters_data[i]);
+    if (sharded_data != nullptr) {
+      hash = xla::util::HashCombine(
+          hash, xla::util::MHash(
+                    i, ShardingUtil::GetSpecHash(*sharded_data->spec())));
+    }
+  }
+  sharded_graph->devices = std::move(devices);
+  coll->hash = xla::util::HashCombine(coll->hash, hash);
+  coll->sharded_graph = std::move(sharded_graph);
+  XLA_COUNTER("ShardedGraphs", 1);
+}
+
 std::shared_ptr<XLATensor::Async> XLATensor::ScheduleSyncTensorsGraph(
     SyncTensorCollection* coll,
     std::vector<xla::ComputationClient::DataPtr> parameters_data,
     std::vector<xla::ComputationClient::DataPtr> tensors_data,
     ComputationCache::TypePtr cached_computation) {
+  HostPhaseTimer phase_timer(HostPhase::kSchedule);
+  MaterializeDeferredTensorsData(parameters_data);
   std::shared_ptr<Async> async = std::make_shared<Async>(
       coll, std::move(parameters_data), std::move(tensors_data),
       std::move(cached_computation));
 
   auto syncfn = [async, hash = coll->hash]() {
+    static const xla::int64 inline_result_bytes =
+        xla::sys_util::GetEnvInt("XLA_INLINE_RESULT_BYTES", 0);
     xla::ComputationClient::ExecuteComputationOptions options;
+    options.inline_result_bytes = inline_result_bytes;
     try {
+      async->wait_turn();
+      MaybeReclaimDeviceMemory(async->device,
+                               *async->cached_computation->computation);
+      if (!async->profile_roots.empty() && async->sharded_graph == nullptr) {
+        // Profiled before the graph execution, which might donate the
+        // parameters buffers.
+        ScopeProfiler::Get()->ProfileGraph(
+            async->profile_roots, async->device,
+            async->cached_computation->computation->devices());
+        async->profile_roots.clear();
+      }
       TF_VLOG(3) << "Executing IR graph hash " << xla::util::HexHash(hash)
                  << " on device " << async->device << " ...";
-      auto results = xla::ComputationClient::Get()->ExecuteComputation(
-          *async->cached_computation->computation, async->parameters_data,
-          async->device, options);
+      xla::int64 execute_start_ns = xla::sys_util::NowNs();
+      std::vector<xla::ComputationClient::DataPtr> results;
+      if (async->sharded_graph != nullptr) {
+        // The partitions run on all the mesh devices. The parameters are not
+        // donated, as their shards can be shared with other sharded data.
+        const ShardedGraph& sharded_graph = *async->sharded_graph;
+        results = ShardingUtil::WrapShardedResults(
+            sharded_graph, async->device,
+            xla::ComputationClient::Get()->ExecuteReplicated(
+                *async->cached_computation->computation,
+                ShardingUtil::GetShardedArguments(async->parameters_data,
+                                                  sharded_graph.devices),
+                sharded_graph.devices,
+                xla::ComputationClient::ExecuteReplicatedOptions()));
+      } else {
+        options.donated_arguments =
+            GetDonatedParameters(async->parameters_data);
+        results = xla::ComputationClient::Get()->ExecuteComputation(
+            *async->cached_computation->computation, async->parameters_data,
+            async->device, options);
+      }
       TF_VLOG(3) << "Executing IR graph hash " << xla::util::HexHash(hash)
                  << " on device " << async->device << " done!";
+      if (async->event != nullptr) {
+        RecordExecuteEvent(async->event.get(), execute_start_ns,
+                           async->parameters_data, results);
+      }
 
       for (size_t i = 0; i < results.size(); ++i) {
         if (async->tensors_data[i] != nullptr) {
@@ -1302,7 +2717,7 @@ std::shared_ptr<XLATensor::Async> XLATensor::ScheduleSyncTensorsGraph(
     }
   };
 
-  xla::env::ScheduleIoClosure(async->mwait.Completer(std::move(syncfn)));
+  xla::env::ScheduleIoClosure(async->Completer(std::move(syncfn)));
   return async;
 }
 
@@ -1310,7 +2725,15 @@ std::shared_ptr<XLATensor::Async> XLATensor::ScheduleSyncTensorsGraph(
     std::vector<XLATensor>* tensors, SyncTensorCollection* coll,
     std::vector<xla::ComputationClient::DataPtr> parameters_data,
     std::string device, ComputationCache::TypePtr cached_computation) {
-  auto tensors_data = FetchTensorData(tensors, coll->config, coll->indices);
+  if (ScopeProfiler::Get()->IsActive()) {
+    coll->profile_roots = CollectRoots(*tensors, coll->indices);
+  }
+  std::vector<xla::ComputationClient::DataPtr> tensors_data;
+  {
+    HostPhaseTimer phase_timer(HostPhase::kFetchTensorData);
+    tensors_data = FetchTensorData(tensors, coll->config, coll->indices,
+                                   coll->sharded_graph.get());
+  }
   return ScheduleSyncTensorsGraph(coll, std::move(parameters_data),
                                   std::move(tensors_data),
                                   std::move(cached_computation));
@@ -1340,8 +2763,11 @@ void XLATensor::SyncLiveTensorsGraph(const Device* device,
                                      absl::Span<const std::string> devices,
                                      bool wait) {
   auto tensors = GetLiveTensors(device);
+  DropUnusedLiveTensors(&tensors);
   TF_VLOG(4) << tensors.size() << " live tensors: devices=("
              << absl::StrJoin(devices, ",") << ")";
+  CacheReadOnlySubgraphs(&tensors, devices);
+  PartitionPendingGraph(&tensors, devices);
   SyncTensorsGraph(&tensors, devices, wait, /*sync_xla_data=*/true);
 }
 
@@ -1349,7 +2775,12 @@ void XLATensor::MarkStep(const Device* device) {
   XLA_COUNTER("MarkStep", 1);
   DeviceContextArena::Get()->StepRngSeed(device);
   ir::ScopePusher::ResetScopes();
+  ir::CheckpointScope::ResetCheckpoints();
   g_tls_data.Reset();
+  ir::NodePool::Trim();
+  MarkHostOverheadStep();
+  ScopeProfiler::Get()->MarkStep();
+  DebugUtil::MarkStep();
 }
 
 void XLATensor::WaitDeviceOps(absl::Span<const std::string> devices) {
@@ -1363,10 +2794,26 @@ void XLATensor::WaitDeviceOps(absl::Span<const std::string> devices) {
       wait_devices.insert(Device(device_str));
     }
   }
-  // The LockDevices() API returns a vector of xla::util::ExceptionCleanup
-  // object, which is going to be freed immediately, turning this operation into
-  // a lock barrier.
-  LockDevices(wait_devices);
+  DevicesBarrier(wait_devices);
+}
+
+xla::int64 XLATensor::GetCurrentStream() { return g_tls_data.stream; }
+
+void XLATensor::SetCurrentStream(xla::int64 stream) {
+  g_tls_data.stream = stream;
+}
+
+void XLATensor::WaitTensors(const std::vector<XLATensor>& tensors) {
+  for (auto& tensor : tensors) {
+    WaitDataReady(tensor.CurrentXlaData());
+  }
+}
+
+void XLATensor::FenceStream() const {
+  if (data()->stream != GetCurrentStream()) {
+    XLA_COUNTER("StreamFence", 1);
+    WaitDataReady(CurrentXlaData());
+  }
 }
 
 XLATensor::OpByOpAsync XLATensor::SyncTensorsGraphOpByOp(
@@ -1400,6 +2847,9 @@ XLATensor::OpByOpAsync XLATensor::SyncTensorsGraphOpByOp(
   auto syncfn = [async]() -> xla::Status {
     xla::Status status;
     try {
+      if (async->coll.wait_turn) {
+        async->coll.wait_turn();
+      }
       TF_VLOG(3) << "Executing (OpByOp) IR graph hash "
                  << xla::util::HexHash(async->coll.hash) << " on device "
                  << async->coll.device << " ...";
@@ -1467,17 +2917,72 @@ XLATensor::CompilationResult XLATensor::Compile(
     const std::vector<XLATensor>& tensors,
     absl::Span<const std::string> devices, const SyncTensorCollection& coll,
     PostOrderData* po_data) {
+  size_t emitted_nodes = 0;
+  xla::XlaComputation computation =
+      BuildComputation(tensors, coll, po_data, &emitted_nodes);
+  CompilationStats stats;
+  std::shared_ptr<xla::ComputationClient::Computation> compiled_computation =
+      CompileComputation(std::move(computation), devices, coll.device,
+                         coll.hash, po_data->parameters_data.size(), &stats,
+                         coll.sharded_graph.get());
+  return {/*device=*/coll.device,
+          /*emitted_nodes=*/emitted_nodes,
+          /*computation=*/std::move(compiled_computation),
+          /*parameters_data=*/std::move(po_data->parameters_data),
+          /*stats=*/std::move(stats)};
+}
+
+xla::XlaComputation XLATensor::BuildComputation(
+    const std::vector<XLATensor>& tensors, const SyncTensorCollection& coll,
+    PostOrderData* po_data, size_t* emitted_nodes) {
+  PersistentCache* persistent_cache = PersistentCache::Get();
+  if (persistent_cache != nullptr) {
+    xla::hash_t key = PersistentCache::GetKey(coll.hash);
+    std::unique_ptr<xla::XlaComputation> computation =
+        persistent_cache->Load(key);
+    if (computation == nullptr) {
+      computation = persistent_cache->WaitShared(key);
+    }
+    if (computation != nullptr) {
+      // The stored HLO module already carries the input/output aliasing
+      // configuration, so there is no need to lower the IR graph again.
+      *emitted_nodes = po_data->graph_size;
+      return std::move(*computation);
+    }
+  }
+  if (po_data->post_order.empty()) {
+    // The parameters came from the graph parameters cache, but lowering needs
+    // the full post-order. The walk yields the same parameters data.
+    *po_data = RunPostOrder(tensors, coll.indices, /*parameters_only=*/false);
+  }
+  RecompileAnalyzer* recompile_analyzer = RecompileAnalyzer::Get();
+  if (recompile_analyzer != nullptr) {
+    recompile_analyzer->AnalyzeCompile(coll.hash, po_data->post_order);
+  }
+
   static const bool enable_aliasing =
       xla::sys_util::GetEnvBool("XLA_ENABLE_PARAM_ALIASING", true);
+  std::vector<ir::Output> roots;
+  roots.reserve(coll.indices.size());
+  for (auto index : coll.indices) {
+    roots.push_back(tensors[index].CurrentIrValue());
+  }
   ir::LoweringContext lowering_ctx("SyncTensorsGraph", coll.device,
                                    po_data->post_order,
-                                   std::move(po_data->emission_map));
-  for (auto index : coll.indices) {
-    ir::Value ir_value = tensors[index].CurrentIrValue();
-    xla::XlaOp root = lowering_ctx.GetOutputOp(ir_value);
-    lowering_ctx.AddResult(root);
+                                   std::move(po_data->emission_map), roots);
+  for (size_t i = 0; i < roots.size(); ++i) {
+    size_t index = lowering_ctx.AddResult(lowering_ctx.GetOutputOp(roots[i]));
+    if (coll.sharded_graph != nullptr) {
+      const ShardingSpec& spec = *coll.sharded_graph->output_specs[i];
+      if (!ShardingUtil::IsReplicated(spec)) {
+        lowering_ctx.SetResultSharding(index, spec.sharding);
+      }
+    }
   }
-  if (enable_aliasing && coll.config.sync_xla_data) {
+  // The partitions of a sharded graph can have parameter and output shards of
+  // different shapes, so the sharded graphs do not alias.
+  if (enable_aliasing && coll.config.sync_xla_data &&
+      coll.sharded_graph == nullptr) {
     // We can only alias at the step barrier, when force_xla_data is true.
     // Consider the case:
     //   1. Tensor A(DEVICE_DATA)
@@ -1506,71 +3011,895 @@ XLATensor::CompilationResult XLATensor::Compile(
   }
 
   xla::XlaComputation computation = ConsumeValue(lowering_ctx.Build());
+  XLA_VALUE_METRIC("HloTransposeCount", CountLiveHloTransposes(computation));
+  if (persistent_cache != nullptr) {
+    persistent_cache->Store(PersistentCache::GetKey(coll.hash), computation);
+  }
+  *emitted_nodes = lowering_ctx.GetEmittedNodeCount();
+  if (lowering_ctx.GetEliminatedNodeCount() > 0) {
+    XLA_COUNTER("IrCseEliminatedNodes", lowering_ctx.GetEliminatedNodeCount());
+  }
+  if (ir::LoweringContext::TransposeFoldingEnabled()) {
+    size_t removed_transposes = lowering_ctx.GetRemovedTransposeCount();
+    XLA_VALUE_METRIC("IrTransposesRemovedPerGraph", removed_transposes);
+    if (removed_transposes > 0) {
+      XLA_COUNTER("IrTransposesRemoved", removed_transposes);
+    }
+  }
+  return computation;
+}
+
+std::shared_ptr<xla::ComputationClient::Computation>
+XLATensor::CompileComputation(xla::XlaComputation computation,
+                              absl::Span<const std::string> devices,
+                              const Device& device, const xla::hash_t& hash,
+                              size_t num_parameters, CompilationStats* stats,
+                              const ShardedGraph* sharded_graph) {
   xla::ProgramShape program_shape = ConsumeValue(computation.GetProgramShape());
-  xla::Shape shape =
-      MakeShapeWithDeviceLayout(program_shape.result(), coll.device.hw_type);
+  xla::Shape shape = FillCompilationStats(computation, program_shape, devices,
+                                          device, hash, stats);
 
   std::vector<xla::ComputationClient::CompileInstance> instances;
-  instances.push_back({std::move(computation), coll.device.ToString(),
-                       xla::ComputationClient::Get()->GetCompilationDevices(
-                           coll.device.ToString(), devices),
-                       &shape});
+  if (sharded_graph != nullptr) {
+    // The warmup compilations replay the manifest as unsharded graphs, so the
+    // sharded ones are left out of it.
+    stats->devices = sharded_graph->devices;
+    instances.push_back({std::move(computation), device.ToString(),
+                         sharded_graph->devices, /*output_shape=*/nullptr,
+                         /*is_sharded=*/true});
+  } else {
+    RecordCompileManifestEntry(hash, device, devices);
+    instances.push_back(
+        {std::move(computation), device.ToString(), stats->devices, &shape});
+  }
 
-  TF_VLOG(3) << "Compiling IR graph hash " << xla::util::HexHash(coll.hash)
-             << " on device " << coll.device << " ...";
+  TF_VLOG(3) << "Compiling IR graph hash " << xla::util::HexHash(hash)
+             << " on device " << device << " ...";
+  xla::int64 compile_start_ns = xla::sys_util::NowNs();
   std::vector<std::shared_ptr<xla::ComputationClient::Computation>>
       computations =
           xla::ComputationClient::Get()->Compile(std::move(instances));
-  TF_VLOG(3) << "Compiling IR graph hash " << xla::util::HexHash(coll.hash)
-             << " on device " << coll.device << " done!";
+  stats->compile_time_ns = xla::sys_util::NowNs() - compile_start_ns;
+  TF_VLOG(3) << "Compiling IR graph hash " << xla::util::HexHash(hash)
+             << " on device " << device << " done!";
   TF_VLOG(5)
-      << "Graph hash " << xla::util::HexHash(coll.hash)
-      << " is computation hash "
+      << "Graph hash " << xla::util::HexHash(hash) << " is computation hash "
       << xla::util::HexHash(xla::util::Hash(
              computations.front()->computation().proto().SerializeAsString()));
-  XLA_CHECK_EQ(program_shape.parameters_size(),
-               po_data->parameters_data.size());
+  XLA_CHECK_EQ(program_shape.parameters_size(), num_parameters);
+  return std::move(computations.front());
+}
 
-  return {/*device=*/coll.device,
-          /*emitted_nodes=*/lowering_ctx.GetEmittedNodeCount(),
-          /*computation=*/std::move(computations.front()),
-          /*parameters_data=*/std::move(po_data->parameters_data)};
+xla::Shape XLATensor::FillCompilationStats(
+    const xla::XlaComputation& computation,
+    const xla::ProgramShape& program_shape,
+    absl::Span<const std::string> devices, const Device& device,
+    const xla::hash_t& hash, CompilationStats* stats) {
+  xla::Shape shape =
+      MakeShapeWithDeviceLayout(program_shape.result(), device.hw_type);
+  stats->hash = hash;
+  for (auto& hlo_computation : computation.proto().computations()) {
+    stats->hlo_instructions += hlo_computation.instructions_size();
+  }
+  stats->num_parameters = program_shape.parameters_size();
+  for (auto& parameter_shape : program_shape.parameters()) {
+    stats->parameters_bytes += GetLeavesByteSize(parameter_shape);
+  }
+  stats->num_outputs = shape.IsTuple() ? shape.tuple_shapes_size() : 1;
+  stats->outputs_bytes = GetLeavesByteSize(shape);
+  stats->num_aliases = computation.proto().input_output_alias().entries_size();
+  for (auto& entry : computation.proto().input_output_alias().entries()) {
+    xla::ShapeIndex output_index(entry.output_shape_index().begin(),
+                                 entry.output_shape_index().end());
+    stats->aliased_bytes +=
+        GetLeavesByteSize(xla::ShapeUtil::GetSubshape(shape, output_index));
+  }
+  stats->peak_bytes =
+      stats->parameters_bytes + stats->outputs_bytes - stats->aliased_bytes;
+  stats->devices = xla::ComputationClient::Get()->GetCompilationDevices(
+      device.ToString(), devices);
+  return shape;
+}
+
+std::vector<XLATensor::CompileManifestEntry> XLATensor::GetCompileManifest() {
+  CompileManifest* manifest = GetCompileManifestRecord();
+  std::lock_guard<std::mutex> lock(manifest->lock);
+  return manifest->entries;
+}
+
+size_t XLATensor::WarmupCompile(
+    absl::Span<const CompileManifestEntry> manifest) {
+  PersistentCache* persistent_cache = PersistentCache::Get();
+  XLA_CHECK(persistent_cache != nullptr)
+      << "The compilation warmup loads the graphs from the persistent cache, "
+         "which needs XLA_PERSISTENT_CACHE_PATH to be set";
+  struct WarmupGraph {
+    const CompileManifestEntry* entry = nullptr;
+    xla::Shape shape;
+    CompilationStats stats;
+  };
+  std::vector<WarmupGraph> graphs;
+  std::vector<xla::ComputationClient::CompileInstance> instances;
+  graphs.reserve(manifest.size());
+  for (auto& entry : manifest) {
+    if (GetComputationCache()->Get(entry.hash) != nullptr) {
+      continue;
+    }
+    std::unique_ptr<xla::XlaComputation> computation =
+        persistent_cache->Load(PersistentCache::GetKey(entry.hash));
+    if (computation == nullptr) {
+      XLA_COUNTER("WarmupCompileMissingGraphs", 1);
+      continue;
+    }
+    graphs.emplace_back();
+    WarmupGraph* graph = &graphs.back();
+    graph->entry = &entry;
+    xla::ProgramShape program_shape =
+        ConsumeValue(computation->GetProgramShape());
+    graph->shape =
+        FillCompilationStats(*computation, program_shape, entry.devices,
+                             Device(entry.device), entry.hash, &graph->stats);
+    instances.push_back({std::move(*computation), entry.device,
+                         graph->stats.devices, &graph->shape});
+  }
+  if (instances.empty()) {
+    return 0;
+  }
+  TF_VLOG(3) << "Warming up " << instances.size() << " graphs ...";
+  xla::int64 compile_start_ns = xla::sys_util::NowNs();
+  std::vector<std::shared_ptr<xla::ComputationClient::Computation>>
+      computations =
+          xla::ComputationClient::Get()->Compile(std::move(instances));
+  xla::int64 compile_time_ns = xla::sys_util::NowNs() - compile_start_ns;
+  for (size_t i = 0; i < graphs.size(); ++i) {
+    // The graphs are compiled in parallel, so each gets the share of the
+    // batch time.
+    graphs[i].stats.compile_time_ns = compile_time_ns / graphs.size();
+    RecordCompileManifestEntry(graphs[i].entry->hash,
+                               Device(graphs[i].entry->device),
+                               graphs[i].entry->devices);
+    GetComputationCache()->Add(
+        graphs[i].entry->hash,
+        std::make_shared<CachedComputation>(std::move(computations[i]),
+                                            std::move(graphs[i].stats)));
+  }
+  XLA_COUNTER("WarmupCompiledGraphs", graphs.size());
+  return graphs.size();
+}
+
+void XLATensor::SpeculateGraphVariants(
+    const std::vector<XLATensor>& tensors,
+    absl::Span<const std::string> devices, const SyncTensorCollection& coll,
+    const PostOrderData& po_data,
+    const CachedComputation& cached_computation) {
+  std::vector<ir::Value> roots = CollectRoots(tensors, coll.indices);
+  GraphSpeculator::CompiledGraph graph;
+  graph.post_order = po_data.post_order;
+  graph.roots = roots;
+  graph.parameter_sequence = po_data.parameter_sequence;
+  for (auto& entry : cached_computation.computation->computation()
+                         .proto()
+                         .input_output_alias()
+                         .entries()) {
+    graph.aliases.emplace_back(entry.parameter_number(),
+                               entry.output_shape_index(0));
+  }
+  graph.force_xla_data = coll.config.force_xla_data;
+  graph.device = coll.device;
+  graph.devices.assign(devices.begin(), devices.end());
+  graph.compile_fn = [](xla::XlaComputation computation, const Device& device,
+                        const std::vector<std::string>& devices,
+                        const xla::hash_t& hash, size_t num_parameters) {
+    // Holding the graph lock makes a real sync of the same graph wait for
+    // the speculative compilation, rather than compiling it again.
+    std::shared_ptr<std::mutex> compile_mutex =
+        GraphCompileLocks::Get()->GetLock(hash);
+    std::lock_guard<std::mutex> compile_lock(*compile_mutex);
+    if (GetComputationCache()->Get(hash) != nullptr) {
+      return;
+    }
+    CompilationStats stats;
+    auto compiled_computation = CompileComputation(
+        std::move(computation), devices, device, hash, num_parameters, &stats);
+    GetComputationCache()->Add(
+        hash, std::make_shared<CachedComputation>(
+                  std::move(compiled_computation), std::move(stats)));
+  };
+  graph.cached_fn = [](const xla::hash_t& hash) {
+    return GetComputationCache()->Get(hash) != nullptr;
+  };
+  GraphSpeculator::Get()->AddCompiledGraph(graph);
+}
+
+std::shared_ptr<XLATensor::Async> XLATensor::ScheduleAsyncCompile(
+    std::vector<XLATensor>* tensors, absl::Span<const std::string> devices,
+    SyncTensorCollection* coll, PostOrderData* po_data) {
+  if (PendingCompiles::Get()->Add(coll->hash)) {
+    // Lowering needs to happen synchronously, as it reads the current state of
+    // the tensors, but the XLA compilation is pushed to the background. Once
+    // that completes, the computation cache gets populated and the next
+    // SyncTensorsGraphInternal() with the same graph hash will pick it up.
+    size_t emitted_nodes = 0;
+    auto computation = std::make_shared<xla::XlaComputation>(
+        BuildComputation(*tensors, *coll, po_data, &emitted_nodes));
+    auto compilefn = [computation,
+                      devices =
+                          std::vector<std::string>(devices.begin(),
+                                                   devices.end()),
+                      device = coll->device, hash = coll->hash,
+                      num_parameters = po_data->parameters_data.size()]() {
+      try {
+        XLA_TIMED("AsyncCompileTime");
+        CompilationStats stats;
+        auto compiled_computation =
+            CompileComputation(std::move(*computation), devices, device, hash,
+                               num_parameters, &stats);
+        auto cached_computation = std::make_shared<CachedComputation>(
+            std::move(compiled_computation), std::move(stats));
+        GetComputationCache()->Add(hash, std::move(cached_computation));
+      } catch (const std::exception& ex) {
+        // Failing here is not fatal, the graph will keep running in OpByOp
+        // mode, and a new compilation will be attempted next time.
+        TF_LOG(ERROR) << "Background compilation of IR graph hash "
+                      << xla::util::HexHash(hash) << " failed: " << ex.what();
+      }
+      PendingCompiles::Get()->Remove(hash);
+    };
+    xla::env::ScheduleClosure(std::move(compilefn));
+  }
+  XLA_COUNTER("AsyncCompileOpByOpFallback", 1);
+  return ScheduleSyncTensorsGraphOpByOp(tensors, coll, devices);
+}
+
+std::shared_ptr<XLATensor::Async> XLATensor::ScheduleSyncTensorsGraphOpByOp(
+    std::vector<XLATensor>* tensors, SyncTensorCollection* coll,
+    absl::Span<const std::string> devices) {
+  std::vector<ir::Value> roots = CollectRoots(*tensors, coll->indices);
+  auto tensors_data = FetchTensorData(tensors, coll->config, coll->indices);
+  std::shared_ptr<Async> async = std::make_shared<Async>(
+      coll, std::vector<xla::ComputationClient::DataPtr>(),
+      std::move(tensors_data), nullptr);
+
+  auto syncfn = [async, roots = std::move(roots),
+                 devices = std::vector<std::string>(devices.begin(),
+                                                    devices.end()),
+                 hash = coll->hash]() {
+    try {
+      async->wait_turn();
+      TF_VLOG(3) << "Executing (OpByOp) IR graph hash "
+                 << xla::util::HexHash(hash) << " on device " << async->device
+                 << " ...";
+      xla::int64 execute_start_ns = xla::sys_util::NowNs();
+      std::vector<xla::ComputationClient::DataPtr> results =
+          OpByOpExecutor::Get()->Execute(roots, async->device, devices);
+      if (async->event != nullptr) {
+        RecordExecuteEvent(async->event.get(), execute_start_ns,
+                           async->parameters_data, results);
+      }
+      TF_VLOG(3) << "Executing (OpByOp) IR graph hash "
+                 << xla::util::HexHash(hash) << " on device " << async->device
+                 << " done!";
+
+      for (size_t i = 0; i < results.size(); ++i) {
+        if (async->tensors_data[i] != nullptr) {
+          async->tensors_data[i]->Assign(*results[i]);
+        } else {
+          async->tensors_data[i] = std::move(results[i]);
+        }
+      }
+    } catch (...) {
+      // See the exception handling comment in ScheduleSyncTensorsGraph().
+      std::exception_ptr exptr = std::current_exception();
+      for (auto& unlocker : async->unlocker) {
+        unlocker.SetStatus(exptr);
+      }
+      throw;
+    }
+  };
+
+  xla::env::ScheduleIoClosure(async->Completer(std::move(syncfn)));
+  return async;
 }
 
 std::shared_ptr<XLATensor::Async> XLATensor::SyncTensorsGraphInternal(
     std::vector<XLATensor>* tensors, absl::Span<const std::string> devices,
     const SyncTensorsConfig& config) {
-  SyncTensorCollection coll = CollectSyncTensors(*tensors, config);
+  HostPhaseTimer sync_timer(HostPhase::kOther);
+  SyncTensorCollection coll;
+  {
+    HostPhaseTimer phase_timer(HostPhase::kCollectSyncTensors);
+    coll = CollectSyncTensors(*tensors, config);
+  }
   if (coll.indices.empty()) {
     return nullptr;
   }
   DebugUtil::SaveTensorsGraphInfo("ScheduleSyncTensorsGraph", *tensors,
                                   &coll.indices);
 
-  PostOrderData po_data = RunPostOrder(*tensors, coll.indices);
+  PostOrderData po_data;
+  {
+    HostPhaseTimer phase_timer(HostPhase::kPostOrder);
+    po_data = RunPostOrder(*tensors, coll.indices, /*parameters_only=*/true);
+  }
   coll.hash = xla::util::HashCombine(
       coll.hash, xla::util::Hash(po_data.parameter_sequence));
+  CollectShardedGraph(*tensors, po_data, &coll);
   TF_VLOG(4) << "Parameter sequence graph hash "
              << xla::util::HexHash(coll.hash);
+  if (coll.event != nullptr) {
+    coll.event->graph_hash = xla::util::HexHash(coll.hash);
+    coll.event->num_nodes = po_data.graph_size;
+  }
   std::shared_ptr<Async> async = TryRunCachedSync(tensors, &coll, &po_data);
+  GraphSpeculator* speculator = GraphSpeculator::Get();
   if (async != nullptr) {
+    if (speculator != nullptr) {
+      speculator->AddCacheHit(coll.hash);
+    }
     return async;
   }
 
-  CompilationResult compile_result = Compile(*tensors, devices, coll, &po_data);
+  static const bool async_compile =
+      xla::sys_util::GetEnvBool("XLA_ASYNC_COMPILE", false);
+  // The sharded graphs cannot fall back to the op-by-op execution.
+  if (async_compile && coll.sharded_graph == nullptr) {
+    return ScheduleAsyncCompile(tensors, devices, &coll, &po_data);
+  }
+
+  std::shared_ptr<std::mutex> compile_mutex =
+      GraphCompileLocks::Get()->GetLock(coll.hash);
+  std::unique_lock<std::mutex> compile_lock(*compile_mutex);
+  if (GetComputationCache()->Get(coll.hash) != nullptr) {
+    // Another thread compiled the same graph while this one was waiting.
+    XLA_COUNTER("SharedGraphCompile", 1);
+    async = TryRunCachedSync(tensors, &coll, &po_data);
+    if (async != nullptr) {
+      return async;
+    }
+  }
+
+  xla::int64 compile_start_ns = xla::sys_util::NowNs();
+  CompilationResult compile_result;
+  {
+    HostPhaseTimer phase_timer(HostPhase::kCompile);
+    compile_result = Compile(*tensors, devices, coll, &po_data);
+  }
+  if (coll.event != nullptr) {
+    coll.event->compile_start_ns = compile_start_ns;
+    coll.event->compile_ns = xla::sys_util::NowNs() - compile_start_ns;
+    coll.event->num_nodes = compile_result.emitted_nodes;
+  }
 
   XLA_VALUE_METRIC("TensorsGraphSize", compile_result.emitted_nodes);
   TF_VLOG(5) << "TensorsGraphSize=" << compile_result.emitted_nodes;
 
   auto cached_computation = std::make_shared<CachedComputation>(
-      std::move(compile_result.computation));
+      std::move(compile_result.computation), std::move(compile_result.stats));
   GetComputationCache()->Add(coll.hash, cached_computation);
+  compile_lock.unlock();
+  if (speculator != nullptr && coll.sharded_graph == nullptr) {
+    SpeculateGraphVariants(*tensors, devices, coll, po_data,
+                           *cached_computation);
+  }
 
   return ScheduleSyncTensorsGraph(
       tensors, &coll, std::move(compile_result.parameters_data),
       compile_result.device.ToString(), std::move(cached_computation));
 }
 
+XLATensor::CompilationStats XLATensor::DryRunCompile(
+    std::vector<XLATensor>* tensors, absl::Span<const std::string> devices) {
+  SyncTensorsConfig config;
+  SyncTensorCollection coll = CollectSyncTensors(*tensors, config);
+  if (coll.indices.empty()) {
+    return CompilationStats();
+  }
+  PostOrderData po_data =
+      RunPostOrder(*tensors, coll.indices, /*parameters_only=*/true);
+  coll.hash = xla::util::HashCombine(
+      coll.hash, xla::util::Hash(po_data.parameter_sequence));
+  ComputationCache::TypePtr cached_computation =
+      GetComputationCache()->Get(coll.hash);
+  if (cached_computation == nullptr) {
+    CompilationResult compile_result =
+        Compile(*tensors, devices, coll, &po_data);
+    cached_computation = std::make_shared<CachedComputation>(
+        std::move(compile_result.computation), std::move(compile_result.stats));
+    GetComputationCache()->Add(coll.hash, cached_computation);
+  }
+  XLA_COUNTER("DryRunCompiles", 1);
+  return cached_computation->stats;
+}
+
+std::vector<xla::ComputationClient::DataPtr> XLATensor::GetCaptureInputsData(
+    std::vector<XLATensor>* inputs) {
+  SyncTensorsGraph(inputs, {}, /*wait=*/false, /*sync_xla_data=*/true);
+  std::vector<xla::ComputationClient::DataPtr> inputs_data;
+  inputs_data.reserve(inputs->size());
+  for (auto& input : *inputs) {
+    xla::ComputationClient::DataPtr xla_data = input.CurrentXlaData();
+    XLA_CHECK(xla_data != nullptr)
+        << "Graph inputs must be device data: " << input.shape().get();
+    input.FenceStream();
+    inputs_data.push_back(std::move(xla_data));
+  }
+  return inputs_data;
+}
+
+std::shared_ptr<XLATensor::CapturedGraph> XLATensor::CaptureGraph(
+    absl::Span<const xla::ComputationClient::DataPtr> inputs_data,
+    std::vector<XLATensor>* outputs, absl::Span<const std::string> devices) {
+  // Aliasing is disabled, as the same inputs can be fed to more replays.
+  SyncTensorsConfig config;
+  config.sync_xla_data = false;
+  SyncTensorCollection coll = CollectSyncTensors(*outputs, config);
+  XLA_CHECK_EQ(coll.indices.size(), outputs->size())
+      << "All the captured graph outputs must be computed by the graph";
+  PostOrderData po_data =
+      RunPostOrder(*outputs, coll.indices, /*parameters_only=*/false);
+  coll.hash = xla::util::HashCombine(
+      coll.hash, xla::util::Hash(po_data.parameter_sequence));
+
+  CompilationResult compile_result = Compile(*outputs, devices, coll, &po_data);
+  auto graph = std::make_shared<CapturedGraph>();
+  graph->device = coll.device;
+  graph->hash = coll.hash;
+  graph->computation = compile_result.computation;
+  std::unordered_map<const xla::ComputationClient::Data*, xla::int64>
+      input_indices;
+  for (size_t i = 0; i < inputs_data.size(); ++i) {
+    input_indices.emplace(inputs_data[i].get(), i);
+    graph->input_shapes.push_back(inputs_data[i]->shape());
+  }
+  for (auto& data : compile_result.parameters_data) {
+    auto it = input_indices.find(data.get());
+    graph->parameter_inputs.push_back(it != input_indices.end() ? it->second
+                                                                : -1);
+    graph->parameters_data.push_back(it != input_indices.end() ? nullptr
+                                                               : data);
+  }
+  for (auto& output : *outputs) {
+    graph->output_shapes.push_back(output.shape().get());
+    graph->output_types.push_back(output.dtype());
+    graph->output_inputs.push_back(-1);
+  }
+  XLA_COUNTER("CapturedGraphs", 1);
+
+  ScheduleSyncTensorsGraph(
+      outputs, &coll, std::move(compile_result.parameters_data),
+      coll.device.ToString(),
+      std::make_shared<CachedComputation>(std::move(compile_result.computation),
+                                          std::move(compile_result.stats)));
+  return graph;
+}
+
+std::shared_ptr<XLATensor::CapturedGraph> XLATensor::CaptureStepLoop(
+    absl::Span<const xla::ComputationClient::DataPtr> slices_data,
+    absl::Span<const xla::ComputationClient::DataPtr> batches_data,
+    absl::Span<const xla::ComputationClient::DataPtr> state_data,
+    std::vector<XLATensor>* outputs, absl::Span<const std::string> devices) {
+  XLA_CHECK_EQ(slices_data.size(), batches_data.size());
+  XLA_CHECK(!batches_data.empty());
+  XLA_CHECK_GE(outputs->size(), state_data.size());
+  xla::int64 num_steps = batches_data.front()->shape().dimensions(0);
+
+  SyncTensorsConfig config;
+  config.sync_xla_data = false;
+  SyncTensorCollection coll = CollectSyncTensors(*outputs, config);
+  XLA_CHECK_EQ(coll.indices.size(), outputs->size())
+      << "All the step outputs must be computed by the step";
+  PostOrderData po_data =
+      RunPostOrder(*outputs, coll.indices, /*parameters_only=*/false);
+  std::vector<ir::Output> roots;
+  for (auto& output : *outputs) {
+    roots.push_back(output.CurrentIrValue());
+  }
+  ir::LoweringContext lowering_ctx("TrainingStep", coll.device,
+                                   po_data.post_order,
+                                   std::move(po_data.emission_map), roots);
+  for (auto& root : roots) {
+    lowering_ctx.AddResult(lowering_ctx.GetOutputOp(root));
+  }
+  xla::XlaComputation step_computation = ConsumeValue(lowering_ctx.Build());
+
+  std::unordered_map<const xla::ComputationClient::Data*, StepArgument>
+      step_inputs;
+  std::vector<xla::Shape> batch_shapes;
+  for (size_t i = 0; i < slices_data.size(); ++i) {
+    step_inputs.emplace(slices_data[i].get(),
+                        StepArgument{StepArgument::kBatch, i});
+    batch_shapes.push_back(batches_data[i]->shape());
+  }
+  std::vector<xla::Shape> state_shapes;
+  for (size_t i = 0; i < state_data.size(); ++i) {
+    step_inputs.emplace(state_data[i].get(),
+                        StepArgument{StepArgument::kState, i});
+    state_shapes.push_back(state_data[i]->shape());
+  }
+  auto graph = std::make_shared<CapturedGraph>();
+  graph->device = coll.device;
+  for (size_t i = 0; i < batches_data.size() + state_data.size(); ++i) {
+    graph->parameters_data.push_back(nullptr);
+    graph->parameter_inputs.push_back(i);
+  }
+  std::vector<StepArgument> step_arguments;
+  std::vector<xla::Shape> constant_shapes;
+  for (auto& data : lowering_ctx.GetParametersData()) {
+    auto it = step_inputs.find(data.get());
+    if (it != step_inputs.end()) {
+      step_arguments.push_back(it->second);
+    } else {
+      step_arguments.push_back(
+          {StepArgument::kConstant, constant_shapes.size()});
+      constant_shapes.push_back(data->shape());
+      graph->parameters_data.push_back(data);
+      graph->parameter_inputs.push_back(-1);
+    }
+  }
+  xla::XlaComputation computation =
+      BuildStepLoop(step_computation, step_arguments, batch_shapes,
+                    state_shapes, constant_shapes, num_steps);
+
+  graph->input_shapes = batch_shapes;
+  graph->input_shapes.insert(graph->input_shapes.end(), state_shapes.begin(),
+                             state_shapes.end());
+  for (size_t i = 0; i < outputs->size(); ++i) {
+    graph->output_shapes.push_back((*outputs)[i].shape().get());
+    graph->output_types.push_back((*outputs)[i].dtype());
+    graph->output_inputs.push_back(
+        i < state_data.size() ? static_cast<xla::int64>(batches_data.size() + i)
+                              : -1);
+  }
+  graph->hash = xla::util::HashCombine(
+      xla::util::HashCombine(coll.hash,
+                             xla::util::Hash(po_data.parameter_sequence)),
+      xla::util::Hash(num_steps));
+  CompilationStats stats;
+  graph->computation = CompileComputation(
+      std::move(computation), devices, coll.device, graph->hash,
+      graph->parameters_data.size(), &stats);
+  XLA_COUNTER("CapturedStepLoops", 1);
+  return graph;
+}
+
+std::vector<XLATensor> XLATensor::ReplayGraph(const CapturedGraph& graph,
+                                              std::vector<XLATensor>* inputs) {
+  std::vector<xla::ComputationClient::DataPtr> inputs_data =
+      GetCaptureInputsData(inputs);
+  XLA_CHECK_EQ(inputs_data.size(), graph.input_shapes.size());
+  for (size_t i = 0; i < inputs_data.size(); ++i) {
+    XLA_CHECK(xla::ShapeUtil::Compatible(inputs_data[i]->shape(),
+                                         graph.input_shapes[i]))
+        << "Replay input " << i << " shape " << inputs_data[i]->shape()
+        << " does not match the captured " << graph.input_shapes[i];
+  }
+  std::vector<xla::ComputationClient::DataPtr> parameters_data =
+      graph.parameters_data;
+  for (size_t i = 0; i < parameters_data.size(); ++i) {
+    if (graph.parameter_inputs[i] >= 0) {
+      parameters_data[i] = inputs_data[graph.parameter_inputs[i]];
+    }
+  }
+  // Only the parameters data should hold the inputs data, so that the ones
+  // updated in place can be donated to the execution.
+  inputs_data.clear();
+
+  SyncTensorCollection coll;
+  coll.hash = graph.hash;
+  coll.device = graph.device;
+  coll.unlocker = LockDevices({graph.device}, &coll.wait_turn);
+  std::vector<xla::ComputationClient::DataPtr> tensors_data;
+  std::vector<XLATensor> outputs;
+  for (size_t i = 0; i < graph.output_shapes.size(); ++i) {
+    xla::ComputationClient::DataPtr xla_data =
+        xla::ComputationClient::Get()->CreateDataPlaceholder(
+            graph.device.ToString(),
+            MakeShapeWithDeviceLayout(graph.output_shapes[i],
+                                      graph.device.hw_type));
+    if (graph.output_inputs[i] >= 0) {
+      XLATensor& input = (*inputs)[graph.output_inputs[i]];
+      input.SetXlaData(xla_data);
+      outputs.push_back(input);
+    } else {
+      outputs.push_back(Create(xla_data, graph.output_types[i]));
+    }
+    tensors_data.push_back(std::move(xla_data));
+  }
+  XLA_COUNTER("ReplayedGraphs", 1);
+
+  ScheduleSyncTensorsGraph(
+      &coll, std::move(parameters_data), std::move(tensors_data),
+      std::make_shared<CachedComputation>(graph.computation));
+  return outputs;
+}
+
+void XLATensor::PartitionPendingGraph(std::vector<XLATensor>* tensors,
+                                      absl::Span<const std::string> devices) {
+  static const size_t kMinGraphSize =
+      xla::sys_util::GetEnvInt("XLA_PARTITION_GRAPH_SIZE", 0);
+  static const double kCostBudget =
+      xla::sys_util::GetEnvDouble("XLA_PARTITION_COST_BUDGET", 20000);
+  if (kMinGraphSize == 0) {
+    return;
+  }
+  std::vector<size_t> indices;
+  std::vector<const ir::Node*> roots;
+  for (size_t i = 0; i < tensors->size(); ++i) {
+    if ((*tensors)[i].CurrentXlaData() == nullptr) {
+      ir::Value ir_value = (*tensors)[i].CurrentIrValue();
+      if (ir_value && ShouldSyncIrValue(ir_value)) {
+        indices.push_back(i);
+        roots.push_back(ir_value.node.get());
+      }
+    }
+  }
+  if (indices.empty()) {
+    return;
+  }
+  std::vector<const ir::Node*> post_order =
+      ir::Util::ComputePostOrder(roots);
+  if (post_order.size() < kMinGraphSize) {
+    return;
+  }
+  std::vector<ir::GraphPartition> partitions =
+      ir::GraphPartitioner::Partition(post_order, kCostBudget);
+  if (partitions.size() <= 1) {
+    return;
+  }
+  XLA_COUNTER("PartitionedGraphs", 1);
+  XLA_VALUE_METRIC("GraphPartitions", partitions.size());
+  TF_VLOG(4) << "Partitioning graph of " << post_order.size() << " nodes in "
+             << partitions.size() << " partitions";
+
+  std::unordered_map<const ir::Node*, size_t> node_partitions;
+  for (size_t p = 0; p < partitions.size(); ++p) {
+    for (size_t i = partitions[p].begin; i < partitions[p].end; ++i) {
+      node_partitions.emplace(post_order[i], p);
+    }
+  }
+  std::vector<std::vector<size_t>> partition_roots(partitions.size());
+  for (size_t i = 0; i < indices.size(); ++i) {
+    partition_roots[node_partitions.at(roots[i])].push_back(indices[i]);
+  }
+  Device device = (*tensors)[indices.front()].GetDevice();
+  for (size_t p = 0; p + 1 < partitions.size(); ++p) {
+    const std::vector<ir::Output>& outputs = partitions[p].outputs;
+    // The uses from later partitions are collected before running the sync, as
+    // every output is guaranteed to have at least one, and their operand holds
+    // the node reference needed to create the temporary tensors.
+    std::vector<std::vector<ir::Use>> later_uses(outputs.size());
+    std::vector<XLATensor> sync_tensors;
+    for (size_t i = 0; i < outputs.size(); ++i) {
+      for (auto& use : outputs[i].node->uses()) {
+        auto it = node_partitions.find(use.node);
+        if (use.index == outputs[i].index && it != node_partitions.end() &&
+            it->second > p) {
+          later_uses[i].push_back(use);
+        }
+      }
+      XLA_CHECK(!later_uses[i].empty()) << outputs[i];
+      const ir::Use& use = later_uses[i].front();
+      sync_tensors.push_back(XLATensor::Create(
+          ir::Value(use.node->operand_node(use.operand_index), use.index),
+          device));
+    }
+    for (auto index : partition_roots[p]) {
+      sync_tensors.push_back((*tensors)[index]);
+    }
+    // The device locks make sure the following partitions, and the final
+    // graph, will execute after this one, so there is no need to wait.
+    SyncTensorsGraph(&sync_tensors, devices, /*wait=*/false,
+                     /*sync_xla_data=*/true);
+    for (size_t i = 0; i < outputs.size(); ++i) {
+      xla::ComputationClient::DataPtr xla_data =
+          sync_tensors[i].CurrentXlaData();
+      XLA_CHECK(xla_data != nullptr) << outputs[i];
+      ir::NodePtr device_data =
+          ir::MakeNode<ir::ops::DeviceData>(std::move(xla_data));
+      for (auto& use : later_uses[i]) {
+        use.node->ReplaceOperand(use.operand_index, device_data);
+      }
+    }
+  }
+}
+
+void XLATensor::CacheReadOnlySubgraphs(std::vector<XLATensor>* tensors,
+                                       absl::Span<const std::string> devices) {
+  static const size_t kMinSubgraphSize =
+      xla::sys_util::GetEnvInt("XLA_READ_ONLY_SUBGRAPHS", 0);
+  if (kMinSubgraphSize == 0) {
+    return;
+  }
+  std::vector<const ir::Node*> roots;
+  for (auto& tensor : *tensors) {
+    if (tensor.CurrentXlaData() == nullptr) {
+      ir::Value ir_value = tensor.CurrentIrValue();
+      if (ir_value && ShouldSyncIrValue(ir_value)) {
+        roots.push_back(ir_value.node.get());
+      }
+    }
+  }
+  if (roots.empty()) {
+    return;
+  }
+  // A node is read only if it is a constant or read only device data, or if
+  // all its operands are. The key of a read only node combines its hash with
+  // the keys of its operands, which eventually carry the leaf data identities.
+  std::vector<const ir::Node*> post_order =
+      ir::Util::ComputePostOrder(roots);
+  std::unordered_map<const ir::Node*, xla::hash_t> read_only_keys;
+  for (auto node : post_order) {
+    if (node->operands().empty()) {
+      c10::optional<xla::hash_t> key =
+          ReadOnlySubgraphCache::GetLeafKey(node);
+      if (key) {
+        read_only_keys.emplace(node, *key);
+      }
+      continue;
+    }
+    xla::hash_t key = node->hash();
+    bool read_only = true;
+    for (auto& operand : node->operands()) {
+      auto it = read_only_keys.find(operand.node);
+      if (it == read_only_keys.end()) {
+        read_only = false;
+        break;
+      }
+      key = xla::util::HashCombine(key, it->second);
+    }
+    if (read_only) {
+      read_only_keys.emplace(node, key);
+    }
+  }
+  // The maximal read only subgraphs are rooted at the read only operands of
+  // the other nodes. Their uses are collected before running any sync, as the
+  // use operands hold the node references needed to create the tensors.
+  Device device = tensors->front().GetDevice();
+  std::unordered_map<ir::Output, size_t, ir::Output::Hasher> cut_indices;
+  std::vector<std::shared_ptr<ReadOnlySubgraphCache::Entry>> entries;
+  std::vector<std::vector<ir::Use>> cut_uses;
+  std::vector<XLATensor> sync_tensors;
+  std::vector<size_t> sync_indices;
+  for (auto node : post_order) {
+    if (read_only_keys.count(node) > 0) {
+      continue;
+    }
+    for (auto& operand : node->operands()) {
+      auto key_it = read_only_keys.find(operand.node);
+      if (key_it == read_only_keys.end() || operand.node->operands().empty() ||
+          operand.node->graph_size() < kMinSubgraphSize ||
+          !cut_indices.emplace(operand, entries.size()).second) {
+        continue;
+      }
+      xla::hash_t key = xla::util::HashCombine(
+          xla::util::HashCombine(key_it->second, operand.index),
+          xla::util::Hash(device.ToString()));
+      std::shared_ptr<ReadOnlySubgraphCache::Entry> entry =
+          ReadOnlySubgraphCache::Get()->Lookup(key);
+      bool seen = entry != nullptr;
+      if (!seen) {
+        entry = ReadOnlySubgraphCache::Get()->Add(key, operand.node);
+      }
+      std::vector<ir::Use> uses;
+      for (auto& use : operand.node->uses()) {
+        if (use.index == operand.index && read_only_keys.count(use.node) == 0) {
+          uses.push_back(use);
+        }
+      }
+      XLA_CHECK(!uses.empty()) << operand;
+      if (seen && entry->data == nullptr) {
+        const ir::Use& use = uses.front();
+        sync_tensors.push_back(XLATensor::Create(
+            ir::Value(use.node->operand_node(use.operand_index), use.index),
+            device));
+        sync_indices.push_back(entries.size());
+      }
+      entries.push_back(std::move(entry));
+      cut_uses.push_back(std::move(uses));
+    }
+  }
+  if (!sync_tensors.empty()) {
+    XLA_COUNTER("ReadOnlySubgraphsMaterialized", sync_tensors.size());
+    // The device locks make sure the graph using the results executes after
+    // this one, so there is no need to wait.
+    SyncTensorsGraph(&sync_tensors, devices, /*wait=*/false,
+                     /*sync_xla_data=*/true);
+    for (size_t i = 0; i < sync_tensors.size(); ++i) {
+      xla::ComputationClient::DataPtr xla_data =
+          sync_tensors[i].CurrentXlaData();
+      XLA_CHECK(xla_data != nullptr);
+      // Read only, so that the graphs using the cached result never donate
+      // its buffer.
+      xla_data->SetInfo(std::make_shared<DeviceDataInfo>(
+          /*tensor_id=*/-1, /*read_only=*/true));
+      entries[sync_indices[i]]->data = std::move(xla_data);
+    }
+  }
+  size_t replaced = 0;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    if (entries[i]->data == nullptr) {
+      continue;
+    }
+    ir::NodePtr device_data =
+        ir::MakeNode<ir::ops::DeviceData>(entries[i]->data);
+    for (auto& use : cut_uses[i]) {
+      use.node->ReplaceOperand(use.operand_index, device_data);
+    }
+    ++replaced;
+  }
+  if (replaced > 0) {
+    XLA_COUNTER("ReadOnlySubgraphsReplaced", replaced);
+  }
+}
+
+std::vector<std::vector<ir::Use>> XLATensor::AddSharedSubgraphs(
+    std::vector<XLATensor>* tensors) {
+  static const size_t kMinSharedSize =
+      xla::sys_util::GetEnvInt("XLA_SYNC_SHARED_SUBGRAPHS", 0);
+  std::vector<std::vector<ir::Use>> shared_uses;
+  XLATensor& tensor = tensors->front();
+  ir::Value ir_value = tensor.CurrentIrValue();
+  if (kMinSharedSize == 0 || !ir_value) {
+    return shared_uses;
+  }
+  std::vector<const ir::Node*> post_order =
+      ir::Util::ComputePostOrder({ir_value.node.get()});
+  std::unordered_set<const ir::Node*> synced_nodes(post_order.begin(),
+                                                   post_order.end());
+  // Walks the pending graphs of the other live tensors, down to the nodes
+  // which are part of the synced graph. Those are the roots of the subgraphs
+  // shared with the synced tensor, and the uses to be replaced are the ones
+  // of the nodes which are not.
+  std::unordered_map<ir::Output, size_t, ir::Output::Hasher> shared_outputs;
+  std::vector<XLATensor> shared_tensors;
+  std::unordered_set<const ir::Node*> visited;
+  Device device = tensor.GetDevice();
+  for (auto& live_tensor : GetLiveTensors(&device)) {
+    if (live_tensor.GetUniqueId() == tensor.GetUniqueId() ||
+        live_tensor.CurrentXlaData() != nullptr) {
+      continue;
+    }
+    ir::Value live_value = live_tensor.CurrentIrValue();
+    if (!live_value || !ShouldSyncIrValue(live_value)) {
+      continue;
+    }
+    if (synced_nodes.count(live_value.node.get()) > 0) {
+      shared_tensors.push_back(std::move(live_tensor));
+      continue;
+    }
+    std::vector<ir::Node*> queue({live_value.node.get()});
+    while (!queue.empty()) {
+      ir::Node* node = queue.back();
+      queue.pop_back();
+      if (!visited.insert(node).second) {
+        continue;
+      }
+      for (size_t i = 0; i < node->operands().size(); ++i) {
+        const ir::Output& operand = node->operands()[i];
+        if (synced_nodes.count(operand.node) == 0) {
+          queue.push_back(node->operand_node(i).get());
+        } else if (operand.node->graph_size() >= kMinSharedSize &&
+                   !operand.node->operands().empty()) {
+          auto it = shared_outputs.emplace(operand, shared_uses.size());
+          if (it.second) {
+            shared_uses.emplace_back();
+            tensors->push_back(XLATensor::Create(
+                ir::Value(node->operand_node(i), operand.index), device));
+          }
+          shared_uses[it.first->second].emplace_back(node, i, operand.index);
+        }
+      }
+    }
+  }
+  for (auto& shared_tensor : shared_tensors) {
+    tensors->push_back(std::move(shared_tensor));
+  }
+  if (!shared_uses.empty()) {
+    XLA_COUNTER("SharedSubgraphOutputs", shared_uses.size());
+  }
+  return shared_uses;
+}
+
 xla::int64 XLATensor::GetNextTensorId() {
   static std::atomic<xla::int64>* id_generator = new std::atomic<xla::int64>(1);
   return id_generator->fetch_add(1);
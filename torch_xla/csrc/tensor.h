@@ -1,5 +1,6 @@
 #pragma once
 
+#include <functional>
 #include <iostream>
 #include <memory>
 #include <string>
@@ -20,7 +21,9 @@
 #include "torch_xla/csrc/ir.h"
 #include "torch_xla/csrc/ir_util.h"
 #include "torch_xla/csrc/lowering_context.h"
+#include "torch_xla/csrc/quantization.h"
 #include "torch_xla/csrc/view.h"
+#include "torch_xla/csrc/xla_sharding_util.h"
 
 namespace torch_xla {
 
@@ -136,12 +139,101 @@ class XLATensor {
   // attached the tensors.
   static std::string DumpHloComputation(const std::vector<XLATensor>& tensors);
 
+  // Retrieves the hash of the graph a SyncTensorsGraph() call would compile for
+  // the given tensors, without compiling or executing it.
+  static xla::hash_t GetGraphHash(const std::vector<XLATensor>& tensors);
+
+  // Telemetry about the compilation of a graph, kept alongside its compilation
+  // cache entry.
+  struct CompilationStats {
+    xla::hash_t hash = 0;
+    xla::int64 hlo_instructions = 0;
+    xla::int64 num_parameters = 0;
+    xla::int64 parameters_bytes = 0;
+    xla::int64 num_outputs = 0;
+    xla::int64 outputs_bytes = 0;
+    xla::int64 num_aliases = 0;
+    // The bytes of the outputs which reuse the buffers of parameters.
+    xla::int64 aliased_bytes = 0;
+    // The device memory the parameters and outputs of an execution take, with
+    // the aliased buffers counted once. The backend temporary allocations are
+    // not included, as XRT does not report them.
+    xla::int64 peak_bytes = 0;
+    xla::int64 compile_time_ns = 0;
+    std::vector<std::string> devices;
+  };
+
+  // A graph compiled by this process, which WarmupCompile() can compile again
+  // in a later run, from the HLO the persistent cache stored for it.
+  struct CompileManifestEntry {
+    xla::hash_t hash = 0;
+    std::string device;
+    std::vector<std::string> devices;
+  };
+
+  // Returns the graphs compiled by this process so far, in compilation order.
+  static std::vector<CompileManifestEntry> GetCompileManifest();
+
+  // Compiles the manifest graphs missing from the compilation cache, whose HLO
+  // is found in the persistent cache, all in a single batched compilation.
+  // Returns the number of graphs compiled.
+  static size_t WarmupCompile(absl::Span<const CompileManifestEntry> manifest);
+
+  // Retrieves the compilation stats of the computations currently within the
+  // compilation cache, sorted by decreasing compile time. If top_n is not
+  // zero, at most top_n entries are returned.
+  static std::vector<CompilationStats> GetCachedComputationStats(size_t top_n);
+
+  // Compiles the graph which syncing the tensors would execute (or fetches it
+  // from the compilation cache), without executing it, and returns its stats.
+  // The tensors keep their pending IR values.
+  static CompilationStats DryRunCompile(std::vector<XLATensor>* tensors,
+                                        absl::Span<const std::string> devices);
+
+  // Drops from the compilation cache the computations which depend on the
+  // replication devices, either because compiled for more than one replica, or
+  // because issuing collectives. Called when the replica set changes, it
+  // returns the number of dropped computations.
+  static size_t ClearReplicatedComputations();
+
+  // Pins (or unpins) the computation of the graph with the given hash within
+  // the compilation cache, so that the cost based eviction only drops it when
+  // all the other computations of its cache shard are pinned as well. The
+  // graph does not need to be compiled yet.
+  static void PinComputation(const xla::hash_t& hash, bool pinned);
+
   // Retrieves the set of XLA tensors which are currently live in the system,
   // for the given device. If device is nullptr, the live tensors for all
   // devices will be returned. Returned tensors are sorted by device as primary
   // key, and by unique ID as secondary key.
   static std::vector<XLATensor> GetLiveTensors(const Device* device);
 
+  // Hints whether the tensor value is going to be read again. Tensors hinted
+  // as not live keep their pending IR value at the live tensors sync (like the
+  // step barrier), and get it materialized only if read again. The hint is
+  // cleared when the tensor value is updated in place.
+  void SetLivenessHint(bool live) const;
+
+  // Freezes the current value of the tensor into the graphs using it, as an
+  // XLA constant rather than a parameter, so that it is no longer fed at every
+  // execution, and the compiler can fold the computations depending only on
+  // it (like weight layout transforms). The graphs get specialized on the
+  // frozen value, which is meant for the weights of inference models. Writing
+  // the tensor in place unfreezes it.
+  void Freeze();
+
+  // Splits the tensor across the devices of a mesh, according to the sharding
+  // spec. The graphs computing or reading sharded tensors are compiled with the
+  // SPMD partitioner, and run on all the mesh devices. A tensor with device
+  // data is resharded right away, while one with a pending IR value gets
+  // sharded by the graph materializing it.
+  void SetShardingSpec(ShardingSpecPtr sharding_spec);
+
+  // Removes the sharding spec, gathering the tensor data on its device.
+  void ClearShardingSpec();
+
+  ShardingSpecPtr GetShardingSpec() const;
+
   // Applies all the pending IR operations queued over the input tensors. All
   // the tensors must be on the same device. If wait is true, the sync operation
   // will be run synchronously. The devices argument, if not empty, tells the
@@ -166,19 +258,140 @@ class XLATensor {
   // If devices is empty, the wait will happen for all local devices.
   static void WaitDeviceOps(absl::Span<const std::string> devices);
 
+  // Waits for the operations producing the device data of the tensors to
+  // complete, without waiting for the other operations queued on their
+  // devices. Tensors whose value is still a pending IR graph are not synced.
+  static void WaitTensors(const std::vector<XLATensor>& tensors);
+
+  // The execution stream of the calling thread. Graphs issued from different
+  // streams are queued independently, and can execute concurrently on the
+  // same device. The tensors device data belongs to the stream which produced
+  // it, and using it from another stream first waits for that stream.
+  static xla::int64 GetCurrentStream();
+
+  static void SetCurrentStream(xla::int64 stream);
+
   // Retrieves the PyTorch CPU tensors behind the XLA tensors IR operations.
   // All the tensors must be on the same device.
   static std::vector<at::Tensor> GetTensors(std::vector<XLATensor>* tensors);
 
+  // Retrieves the PyTorch CPU tensor with the window of the tensor value which
+  // starts at start_indices and has the given sizes. The window is cut on the
+  // device, by a cached dynamic slice computation whose start indices are a
+  // parameter, so that reading different windows of the same size neither
+  // compiles a new graph nor transfers the whole tensor.
+  at::Tensor ReadSlice(absl::Span<const xla::int64> start_indices,
+                       absl::Span<const xla::int64> sizes);
+
+  // The handle of a background fetch of the tensors values, started by the
+  // FetchTensorsAsync() API.
+  struct AsyncFetch {
+    AsyncFetch() : mwait(1) {}
+
+    // Waits for the fetch to complete, and returns the PyTorch CPU tensors.
+    std::vector<at::Tensor> Wait();
+
+    xla::util::MultiWait mwait;
+    std::vector<at::Tensor> results;
+    // The time spent fetching the data, once it was available on the device.
+    xla::int64 transfer_ns = 0;
+  };
+
+  // Like GetTensors(), but without blocking the caller. The tensors device
+  // data is fetched in the background (in parallel chunks) while holding a
+  // slot of the device execution queue, so that the following computations
+  // cannot alias (and hence overwrite) it before the fetch completes.
+  static std::shared_ptr<AsyncFetch> FetchTensorsAsync(
+      std::vector<XLATensor>* tensors);
+
   // Operation which creates XLA tensors out of PyTorch CPU tensors by batching
   // the requests to the computation servers.
   static std::vector<XLATensor> CreateTensors(
       const std::vector<at::Tensor>& tensors,
       const std::vector<std::string>& devices);
 
+  // The pending upload of the CPU tensors passed to the CreateTensorsAsync()
+  // API.
+  struct AsyncUpload {
+    AsyncUpload() : mwait(1) {}
+
+    // Waits for the upload to complete, and returns the XLA tensors.
+    std::vector<XLATensor> Wait();
+
+    xla::util::MultiWait mwait;
+    std::vector<XLATensor> results;
+    xla::int64 transfer_ns = 0;
+  };
+
+  // Like CreateTensors(), but without blocking the caller. The upload runs
+  // within the IO thread pool.
+  static std::shared_ptr<AsyncUpload> CreateTensorsAsync(
+      std::vector<at::Tensor> tensors, std::vector<std::string> devices);
+
+  // A computation captured by CaptureGraph(), which ReplayGraph() runs over new
+  // inputs without tracing and hashing the IR graph again.
+  struct CapturedGraph {
+    Device device;
+    xla::hash_t hash = 0;
+    std::shared_ptr<xla::ComputationClient::Computation> computation;
+    // The computation parameters. The ones fed by the inputs are null, and get
+    // filled at every replay.
+    std::vector<xla::ComputationClient::DataPtr> parameters_data;
+    // For each parameter, the index of the input feeding it, or -1 if the
+    // parameter is device data captured at trace time.
+    std::vector<xla::int64> parameter_inputs;
+    std::vector<xla::Shape> input_shapes;
+    std::vector<xla::Shape> output_shapes;
+    std::vector<at::ScalarType> output_types;
+    // For each output, the index of the input it updates in place, or -1 if
+    // the output is a new tensor.
+    std::vector<xla::int64> output_inputs;
+  };
+
+  // Retrieves the device data of the inputs of a captured graph, scheduling
+  // the sync of the inputs which have pending IR operations.
+  static std::vector<xla::ComputationClient::DataPtr> GetCaptureInputsData(
+      std::vector<XLATensor>* inputs);
+
+  // Compiles and runs the pending IR graph of the outputs, like a
+  // SyncTensorsGraph() would do, and captures the resulting computation. The
+  // graph parameters which are the inputs_data get fed by the replay inputs,
+  // while all the other device data the graph reads are captured as constants.
+  static std::shared_ptr<CapturedGraph> CaptureGraph(
+      absl::Span<const xla::ComputationClient::DataPtr> inputs_data,
+      std::vector<XLATensor>* outputs, absl::Span<const std::string> devices);
+
+  // Captures a computation running num_steps training steps within an XLA
+  // While loop. The step graph is the one pending on the outputs, traced over
+  // the first slice of the batches (slices_data) and over the state_data. The
+  // outputs are the new state, which is updated in place at every step,
+  // followed by the step metrics, which are summed over the steps. The inputs
+  // of the captured graph are the batches followed by the state.
+  static std::shared_ptr<CapturedGraph> CaptureStepLoop(
+      absl::Span<const xla::ComputationClient::DataPtr> slices_data,
+      absl::Span<const xla::ComputationClient::DataPtr> batches_data,
+      absl::Span<const xla::ComputationClient::DataPtr> state_data,
+      std::vector<XLATensor>* outputs, absl::Span<const std::string> devices);
+
+  // Runs the captured computation over the new inputs, and returns the output
+  // tensors, whose device data is filled asynchronously.
+  static std::vector<XLATensor> ReplayGraph(const CapturedGraph& graph,
+                                            std::vector<XLATensor>* inputs);
+
   //////////////////////////////////////////////////////////////////////////////
   // XLA dedicated operators follows here, listed in alphabetical order.
   //////////////////////////////////////////////////////////////////////////////
+  // Applies in place a torch.optim.Adam step to all the params, and their
+  // exp_avgs and exp_avg_sqs states, with a single IR node. The step_size is
+  // lr / bias_correction1.
+  static void adam_step_multi(std::vector<XLATensor>* params,
+                              absl::Span<const XLATensor> grads,
+                              std::vector<XLATensor>* exp_avgs,
+                              std::vector<XLATensor>* exp_avg_sqs,
+                              double step_size, double bias_correction2_sqrt,
+                              double beta1, double beta2, double eps,
+                              double weight_decay);
+
   static std::pair<XLATensor, ir::Value> all_reduce(
       const XLATensor& input, const ir::Value& token, AllReduceType reduce_type,
       double scale, std::vector<std::vector<xla::int64>> groups);
@@ -197,17 +410,76 @@ class XLATensor {
       xla::int64 split_dimension, xla::int64 concat_dimension,
       xla::int64 split_count, std::vector<std::vector<xla::int64>> groups);
 
+  static std::pair<XLATensor, ir::Value> all_gather(
+      const XLATensor& input, const ir::Value& token, xla::int64 dim,
+      xla::int64 shard_count, std::vector<std::vector<xla::int64>> groups);
+
+  static std::pair<XLATensor, ir::Value> reduce_scatter(
+      const XLATensor& input, const ir::Value& token, AllReduceType reduce_type,
+      double scale, xla::int64 scatter_dim, xla::int64 shard_count,
+      std::vector<std::vector<xla::int64>> groups);
+
+  // Scales in place all the grads, so that their norm_type norm taken together
+  // is at most max_norm, with a single IR node. Returns the total norm, before
+  // the clipping.
+  static XLATensor clip_grad_norm_multi(std::vector<XLATensor>* grads,
+                                        double max_norm, double norm_type);
+
+  // Tensor parallel matmuls of the input with the weight shard (and the bias
+  // shard, which can be null) of the replica, fused with the collective which
+  // combines the results of the replicas.
+  static std::pair<XLATensor, ir::Value> column_parallel_matmul(
+      const XLATensor& input, const XLATensor& weight, const XLATensor& bias,
+      const ir::Value& token, bool gather_output, xla::int64 shard_count,
+      xla::int64 num_chunks, std::vector<std::vector<xla::int64>> groups);
+
+  static std::pair<XLATensor, ir::Value> row_parallel_matmul(
+      const XLATensor& input, const XLATensor& weight, const XLATensor& bias,
+      const ir::Value& token, bool scatter_output, xla::int64 shard_count,
+      xla::int64 num_chunks, std::vector<std::vector<xla::int64>> groups);
+
   static std::pair<XLATensor, ir::Value> collective_permute(
       const XLATensor& input, const ir::Value& token,
       std::vector<std::pair<xla::int64, xla::int64>> source_target_pairs);
 
+  // Batch norm training with the statistics computed across the replicas of
+  // each group, using a single all-reduce. Returns the output, the mean, the
+  // inverted standard deviation, the global count of the elements of every
+  // feature, and the new token.
+  static std::tuple<XLATensor, XLATensor, XLATensor, XLATensor, ir::Value>
+  sync_batch_norm(const XLATensor& input, const XLATensor& weight,
+                  const XLATensor& bias, const ir::Value& token, double eps,
+                  std::vector<std::vector<xla::int64>> groups);
+
+  static std::tuple<XLATensor, XLATensor, XLATensor, ir::Value>
+  sync_batch_norm_backward(const XLATensor& grad_output,
+                           const XLATensor& input, const XLATensor& weight,
+                           const XLATensor& mean, const XLATensor& invstd,
+                           const XLATensor& count, const ir::Value& token,
+                           std::vector<std::vector<xla::int64>> groups);
+
   static XLATensor get_dimensions_size(const XLATensor& input,
                                        std::vector<xla::int64> dimensions);
 
+  // Applies in place a torch.optim.SGD with momentum step to all the params,
+  // and their momentum_buffers, with a single IR node.
+  static void sgd_momentum_step_multi(std::vector<XLATensor>* params,
+                                      absl::Span<const XLATensor> grads,
+                                      std::vector<XLATensor>* momentum_buffers,
+                                      double lr, double momentum,
+                                      double dampening, double weight_decay,
+                                      bool nesterov,
+                                      bool init_momentum_buffers);
+
   static std::vector<XLATensor> user_computation(
       const std::string& opname, absl::Span<const XLATensor> inputs,
       ComputationPtr computation);
 
+  // Runs the custom kernel registered with the given name within the
+  // CustomKernelRegistry.
+  static std::vector<XLATensor> custom_kernel(
+      const std::string& name, absl::Span<const XLATensor> inputs);
+
   //////////////////////////////////////////////////////////////////////////////
   // ATEN operators follows here, listed in alphabetical order.
   //////////////////////////////////////////////////////////////////////////////
@@ -243,6 +515,12 @@ class XLATensor {
   static XLATensor acos(const XLATensor& input);
   static void acos_(XLATensor& input);
 
+  static XLATensor adaptive_avg_pool3d(const XLATensor& input,
+                                       std::vector<xla::int64> output_size);
+
+  static XLATensor adaptive_avg_pool3d_backward(const XLATensor& grad_output,
+                                                const XLATensor& input);
+
   static XLATensor add(
       const XLATensor& input, const XLATensor& other, at::Scalar alpha,
       c10::optional<at::ScalarType> logical_element_type = c10::nullopt);
@@ -297,6 +575,10 @@ class XLATensor {
   static XLATensor asin(const XLATensor& input);
   static void asin_(XLATensor& input);
 
+  // Returns the input index tensor, marked as holding unique (and sorted, if
+  // sorted is true) values, for the scatters using it.
+  static XLATensor assume_unique_indices(const XLATensor& input, bool sorted);
+
   static XLATensor atan(const XLATensor& input);
   static void atan_(XLATensor& input);
 
@@ -417,6 +699,20 @@ class XLATensor {
   static XLATensor cross(const XLATensor& input, const XLATensor& other,
                          c10::optional<xla::int64> dim);
 
+  // Returns the per sample cross entropy losses of the logits, and the per
+  // sample logsumexp of the logits to be passed to the backward.
+  static std::pair<XLATensor, XLATensor> cross_entropy(const XLATensor& logits,
+                                                       const XLATensor& labels,
+                                                       xla::int64 ignore_index,
+                                                       xla::int64 chunk_size);
+
+  static XLATensor cross_entropy_backward(const XLATensor& grad_output,
+                                          const XLATensor& logits,
+                                          const XLATensor& labels,
+                                          const XLATensor& logsumexp,
+                                          xla::int64 ignore_index,
+                                          xla::int64 chunk_size);
+
   // Returns the cumulative product of elements of input in the given dimension.
   static XLATensor cumprod(const XLATensor& input, xla::int64 dim,
                            c10::optional<at::ScalarType> dtype);
@@ -444,6 +740,21 @@ class XLATensor {
   static void div_(XLATensor& input, const XLATensor& other);
   static void div_(XLATensor& input, at::Scalar other);
 
+  // Returns the input with the elements zeroed with the given probability (and
+  // the other ones scaled), and the scalar seed the mask was drawn from, which
+  // is all the backward needs.
+  static std::pair<XLATensor, XLATensor> dropout(const XLATensor& input,
+                                                 double probability);
+
+  static XLATensor dropout_backward(const XLATensor& grad_output,
+                                    const XLATensor& seed, double probability);
+
+  // Overwrites, in place, the slice of input starting at the start (scalar
+  // integer tensor) offset along dim, with source. As the offset is a device
+  // value, updates at different offsets do not trigger new compilations.
+  static void dynamic_update_slice_(XLATensor& input, const XLATensor& source,
+                                    const XLATensor& start, xla::int64 dim);
+
   // A generalized contraction between tensors of arbitrary dimension defined by
   // the given equation and applied to the input tensors.
   static XLATensor einsum(const std::string& equation,
@@ -457,6 +768,19 @@ class XLATensor {
                                 at::Scalar scale, at::Scalar input_scale,
                                 const XLATensor& output);
 
+  // Returns the bag reductions, the offset2bag, the bag_size and the
+  // max_indices. The per_sample_weights tensor can be null.
+  static std::tuple<XLATensor, XLATensor, XLATensor, XLATensor> embedding_bag(
+      const XLATensor& weight, const XLATensor& indices,
+      const XLATensor& offsets, const XLATensor& per_sample_weights,
+      xla::int64 mode, bool include_last_offset);
+
+  static XLATensor embedding_bag_dense_backward(
+      const XLATensor& grad_output, const XLATensor& indices,
+      const XLATensor& offset2bag, const XLATensor& bag_size,
+      const XLATensor& max_indices, const XLATensor& per_sample_weights,
+      xla::int64 num_weights, bool scale_grad_by_freq, xla::int64 mode);
+
   static XLATensor embedding_dense_backward(const XLATensor& grad_output,
                                             const XLATensor& indices,
                                             xla::int64 num_weights,
@@ -796,6 +1120,12 @@ class XLATensor {
                                              const XLATensor& iou_threshold,
                                              xla::int64 output_size);
 
+  // Batched version of nms(), see BuildBatchedNms() for the accepted shapes.
+  static std::pair<XLATensor, XLATensor> batched_nms(
+      const XLATensor& boxes, const XLATensor& scores,
+      const XLATensor& score_threshold, const XLATensor& iou_threshold,
+      xla::int64 output_size, xla::int64 top_k);
+
   static XLATensor nonzero(const XLATensor& input);
 
   static XLATensor norm(const XLATensor& input, c10::optional<at::Scalar> p,
@@ -833,6 +1163,23 @@ class XLATensor {
 
   static std::tuple<XLATensor, XLATensor> qr(const XLATensor& input, bool some);
 
+  // Convolution of the input with the int8 quantized weight, whose output
+  // channels have their own scale and zero point. The input_params select the
+  // int8 input mode, and the output_params the requantization of the result.
+  static XLATensor quantized_convolution(
+      const XLATensor& input, const XLATensor& weight,
+      const XLATensor& weight_scale, const XLATensor& weight_zero_point,
+      const XLATensor& bias, std::vector<xla::int64> stride,
+      std::vector<xla::int64> padding, std::vector<xla::int64> dilation,
+      xla::int64 groups, absl::optional<QuantizationParams> input_params,
+      absl::optional<QuantizationParams> output_params);
+
+  static XLATensor quantized_matmul(
+      const XLATensor& input, const XLATensor& weight,
+      const XLATensor& weight_scale, const XLATensor& weight_zero_point,
+      const XLATensor& bias, absl::optional<QuantizationParams> input_params,
+      absl::optional<QuantizationParams> output_params);
+
   static XLATensor randperm(xla::int64 n, const Device& device,
                             at::ScalarType scalar_type);
 
@@ -895,6 +1242,18 @@ class XLATensor {
 
   static void copy_(XLATensor& input, XLATensor& src);
 
+  // Returns the attention output, and the per query logsumexp of the attention
+  // scores to be passed to the backward.
+  static std::pair<XLATensor, XLATensor> scaled_dot_product_attention(
+      const XLATensor& query, const XLATensor& key, const XLATensor& value,
+      double scale, xla::int64 block_size);
+
+  static std::tuple<XLATensor, XLATensor, XLATensor>
+  scaled_dot_product_attention_backward(
+      const XLATensor& grad_output, const XLATensor& query,
+      const XLATensor& key, const XLATensor& value, const XLATensor& output,
+      const XLATensor& logsumexp, double scale, xla::int64 block_size);
+
   static void scatter_(XLATensor& input, xla::int64 dim, const XLATensor& index,
                        const XLATensor& src);
   static void scatter_(XLATensor& input, xla::int64 dim, const XLATensor& index,
@@ -1086,6 +1445,16 @@ class XLATensor {
       const XLATensor& grad_output, std::vector<xla::int64> output_size,
       std::vector<xla::int64> input_size);
 
+  static XLATensor var(const XLATensor& input,
+                       std::vector<xla::int64> dimensions,
+                       bool keep_reduced_dimensions, bool unbiased);
+
+  // Returns the variance and the mean of the input, computed by a single
+  // reduction.
+  static std::tuple<XLATensor, XLATensor> var_mean(
+      const XLATensor& input, std::vector<xla::int64> dimensions,
+      bool keep_reduced_dimensions, bool unbiased);
+
   // Like reshape, but it returns a view into the original tensor.
   static XLATensor view(const XLATensor& input,
                         absl::Span<const xla::int64> output_size);
@@ -1112,7 +1481,16 @@ class XLATensor {
     std::vector<size_t> indices;
     xla::hash_t hash;
     std::vector<xla::util::ExceptionCleanup> unlocker;
+    // Waits for the operations queued on the device before this collection to
+    // complete. Must be called before executing on the device.
+    std::function<void()> wait_turn;
     Device device;
+    // Collects the flight recorder timings, if the recorder is enabled.
+    std::shared_ptr<xla::metrics::GraphEvent> event;
+    // The roots of the graph, captured only when the scope profiler is active.
+    std::vector<ir::Value> profile_roots;
+    // Set if the graph is compiled with the SPMD partitioner.
+    std::shared_ptr<const ShardedGraph> sharded_graph;
   };
 
   struct PostOrderData {
@@ -1120,6 +1498,10 @@ class XLATensor {
     ir::Util::EmissionMap emission_map;
     std::vector<xla::ComputationClient::DataPtr> parameters_data;
     std::vector<size_t> parameter_sequence;
+    // The number of nodes of the graph. Set even when post_order is empty,
+    // which happens if the parameters were fetched from the graph parameters
+    // cache.
+    size_t graph_size = 0;
   };
 
   struct CompilationResult {
@@ -1127,18 +1509,22 @@ class XLATensor {
     size_t emitted_nodes = 0;
     std::shared_ptr<xla::ComputationClient::Computation> computation;
     std::vector<xla::ComputationClient::DataPtr> parameters_data;
+    CompilationStats stats;
   };
 
   struct CachedComputation {
     CachedComputation(
-        std::shared_ptr<xla::ComputationClient::Computation> computation)
-        : computation(std::move(computation)) {}
+        std::shared_ptr<xla::ComputationClient::Computation> computation,
+        CompilationStats stats = CompilationStats())
+        : computation(std::move(computation)), stats(std::move(stats)) {}
 
     std::shared_ptr<xla::ComputationClient::Computation> computation;
+    CompilationStats stats;
   };
 
   using ComputationCache =
-      xla::util::Cache<xla::hash_t, CachedComputation, xla::util::HashReducer>;
+      xla::util::ShardedCache<xla::hash_t, CachedComputation,
+                              xla::util::HashReducer>;
 
   struct Async {
     Async(SyncTensorCollection* coll,
@@ -1148,13 +1534,23 @@ class XLATensor {
 
     void Wait();
 
+    // Wraps the function executing the graph, so that both the Wait() API and
+    // the readiness events of the tensors data get signaled on completion.
+    std::function<void()> Completer(std::function<void()> fn);
+
     xla::util::MultiWait mwait;
     std::vector<size_t> indices;
     std::vector<xla::util::ExceptionCleanup> unlocker;
+    std::function<void()> wait_turn;
+    std::shared_ptr<xla::metrics::GraphEvent> event;
     std::vector<xla::ComputationClient::DataPtr> parameters_data;
     std::string device;
     ComputationCache::TypePtr cached_computation;
     std::vector<xla::ComputationClient::DataPtr> tensors_data;
+    // The readiness event of the tensors_data placeholders.
+    std::shared_ptr<xla::util::MultiWait> ready;
+    std::vector<ir::Value> profile_roots;
+    std::shared_ptr<const ShardedGraph> sharded_graph;
   };
 
   // This is the core XLA tensor data structure where all the tensor data is
@@ -1195,6 +1591,17 @@ class XLATensor {
     const Device device;
     const xla::int64 unique_id = 0;
     size_t generation = 1;
+    // Set by SetLivenessHint() when the tensor value is not going to be read.
+    bool dead_hint = false;
+    // The execution stream which produced the xla_data.
+    xla::int64 stream = GetCurrentStream();
+    // The location of the data within the live tensors registry of its device.
+    int registry_shard = -1;
+    size_t registry_slot = 0;
+    ShardingSpecPtr sharding_spec;
+    // The size of the host tensor_data kept next to the device xla_data, as
+    // accounted by the host data retention policy.
+    xla::int64 retained_host_bytes = 0;
   };
 
   XLATensor(const at::Tensor& tensor, const Device& device);
@@ -1221,8 +1628,19 @@ class XLATensor {
 
   void AssignIrValue(ir::Value ir_value) const;
 
+  // Waits for the operations queued on the stream which produced the tensor
+  // device data, if that is not the current stream.
+  void FenceStream() const;
+
   void SetTensorData(at::Tensor tensor_data);
 
+  void ClearTensorData() const;
+
+  // Decides whether the host tensor_data stays live next to the device data the
+  // tensor has just been uploaded to (or fetched from). Small host copies are
+  // kept, so that ToTensor() needs no device fetch, within a total budget.
+  void ApplyHostDataRetention() const;
+
   ir::Value CreateTensorNode(xla::ComputationClient::DataPtr data,
                              bool read_only) const;
 
@@ -1260,6 +1678,17 @@ class XLATensor {
   //     a = a + b
   void TryLimitGraphSize();
 
+  // Once the host memory held by the pending IR graphs exceeds the
+  // XLA_PENDING_IR_HOST_BYTES budget, syncs the live tensors of the device,
+  // right after the same op every time (when possible), so that the spilled
+  // graphs stay the same across the iterations of a loop.
+  void MaybeSpillPendingGraphs();
+
+  // Removes from the live tensors to be synced the ones with a pending IR
+  // value which are not going to be read anymore: the ones hinted as not live,
+  // and the ones whose last holder is the live tensors vector itself.
+  static void DropUnusedLiveTensors(std::vector<XLATensor>* tensors);
+
   std::vector<XLATensor> MakeOutputTensors(ir::NodePtr node) const;
 
   ir::Value GetIrValueForTensor(const at::Tensor& tensor,
@@ -1271,6 +1700,12 @@ class XLATensor {
       const std::vector<XLATensor>& tensors, const SyncTensorsConfig& config);
 
   // Implementation of the GetTensors() API using the op-by-op executor.
+  // Fetches the values of the tensors, using the tensor data if present, or
+  // fetching it from the tensors_data (in tensors order) otherwise.
+  static std::vector<at::Tensor> FetchTensors(
+      const std::vector<XLATensor>& tensors,
+      absl::Span<const xla::ComputationClient::DataPtr> tensors_data);
+
   static std::vector<at::Tensor> GetTensorsOpByOp(
       std::vector<XLATensor>* tensors);
 
@@ -1292,9 +1727,18 @@ class XLATensor {
   static std::vector<ir::Value> CollectRoots(
       const std::vector<XLATensor>& tensors, absl::Span<const size_t> indices);
 
+  // The placeholders of the sharded graph outputs are sharded data.
   static std::vector<xla::ComputationClient::DataPtr> FetchTensorData(
       std::vector<XLATensor>* tensors, const SyncTensorsConfig& config,
-      absl::Span<const size_t> indices);
+      absl::Span<const size_t> indices,
+      const ShardedGraph* sharded_graph = nullptr);
+
+  // Sets coll->sharded_graph if any of the sync tensors has a sharding spec, or
+  // any of the graph parameters is sharded, and mixes the shardings into the
+  // graph hash.
+  static void CollectShardedGraph(const std::vector<XLATensor>& tensors,
+                                  const PostOrderData& po_data,
+                                  SyncTensorCollection* coll);
 
   // Schedules the execution of a sync tensors operation in background. The
   // asynchronous operation will hold the device locks by capturing the ones
@@ -1310,8 +1754,12 @@ class XLATensor {
       std::vector<xla::ComputationClient::DataPtr> parameters_data,
       std::string device, ComputationCache::TypePtr cached_computation);
 
+  // Collects the parameters of the graph rooted at the tensors selected by
+  // indices. If parameters_only is true, the post-order (and emission map) are
+  // left empty when the parameters could be fetched from cache.
   static PostOrderData RunPostOrder(const std::vector<XLATensor>& tensors,
-                                    absl::Span<const size_t> indices);
+                                    absl::Span<const size_t> indices,
+                                    bool parameters_only);
 
   static ComputationCache::TypePtr LookupCachedCompile(
       const std::vector<XLATensor>& tensors, const xla::hash_t& hash);
@@ -1329,10 +1777,74 @@ class XLATensor {
                                    const SyncTensorCollection& coll,
                                    PostOrderData* po_data);
 
+  // Lowers the IR graph rooted at the coll.indices tensors, or fetches it from
+  // the persistent cache if enabled.
+  static xla::XlaComputation BuildComputation(
+      const std::vector<XLATensor>& tensors, const SyncTensorCollection& coll,
+      PostOrderData* po_data, size_t* emitted_nodes);
+
+  static std::shared_ptr<xla::ComputationClient::Computation>
+  CompileComputation(xla::XlaComputation computation,
+                     absl::Span<const std::string> devices,
+                     const Device& device, const xla::hash_t& hash,
+                     size_t num_parameters, CompilationStats* stats,
+                     const ShardedGraph* sharded_graph = nullptr);
+
+  // Fills the stats of a computation about to be compiled, and returns its
+  // result shape with the device layout.
+  static xla::Shape FillCompilationStats(
+      const xla::XlaComputation& computation,
+      const xla::ProgramShape& program_shape,
+      absl::Span<const std::string> devices, const Device& device,
+      const xla::hash_t& hash, CompilationStats* stats);
+
+  // Used when XLA_SPECULATIVE_COMPILE is enabled. Hands the graph which just
+  // got compiled to the GraphSpeculator, which compiles in background the
+  // variants it predicts.
+  static void SpeculateGraphVariants(
+      const std::vector<XLATensor>& tensors,
+      absl::Span<const std::string> devices, const SyncTensorCollection& coll,
+      const PostOrderData& po_data,
+      const CachedComputation& cached_computation);
+
+  // Used when XLA_ASYNC_COMPILE is enabled. Schedules the compilation of the
+  // graph in background, and runs the current one in OpByOp mode.
+  static std::shared_ptr<Async> ScheduleAsyncCompile(
+      std::vector<XLATensor>* tensors, absl::Span<const std::string> devices,
+      SyncTensorCollection* coll, PostOrderData* po_data);
+
+  static std::shared_ptr<Async> ScheduleSyncTensorsGraphOpByOp(
+      std::vector<XLATensor>* tensors, SyncTensorCollection* coll,
+      absl::Span<const std::string> devices);
+
   static std::shared_ptr<Async> SyncTensorsGraphInternal(
       std::vector<XLATensor>* tensors, absl::Span<const std::string> devices,
       const SyncTensorsConfig& config);
 
+  // Used when XLA_PARTITION_GRAPH_SIZE is set. If the pending graph of the
+  // tensors is larger than that, executes all but the last partition chosen by
+  // the ir::GraphPartitioner, and replaces the uses of their outputs within the
+  // remaining graph with the resulting device data.
+  static void PartitionPendingGraph(std::vector<XLATensor>* tensors,
+                                    absl::Span<const std::string> devices);
+
+  // Used when XLA_READ_ONLY_SUBGRAPHS is set. Finds the maximal subgraphs of
+  // the pending graphs of tensors whose leaves are all constants or read only
+  // device data, and replaces their uses with the device data of their cached
+  // results, materializing the results of the subgraphs seen in a previous
+  // sync which are not cached yet.
+  static void CacheReadOnlySubgraphs(std::vector<XLATensor>* tensors,
+                                     absl::Span<const std::string> devices);
+
+  // Used when XLA_SYNC_SHARED_SUBGRAPHS is set. Appends to tensors (which holds
+  // the single tensor about to be synced) the roots of the subgraphs which the
+  // pending graphs of the other live tensors share with it, plus the live
+  // tensors whose whole graph is shared. Returns the uses of every appended
+  // root within the other graphs, which ApplyPendingGraph() rewires to the
+  // resulting device data, so that later syncs do not compute them again.
+  static std::vector<std::vector<ir::Use>> AddSharedSubgraphs(
+      std::vector<XLATensor>* tensors);
+
   static xla::int64 GetNextTensorId();
 
   std::shared_ptr<Data> data_;
@@ -0,0 +1,241 @@
+#include "torch_xla/csrc/tensor_checkpoint.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <numeric>
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/multi_wait.h"
+#include "tensorflow/compiler/xla/xla_client/thread_pool.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
+#include "torch_xla/csrc/tensor_util.h"
+
+namespace torch_xla {
+namespace {
+
+static const char* const kIndexFile = "index";
+static const char* const kIndexVersion = "xla_tensor_checkpoint_v1";
+
+const at::ScalarType kScalarTypes[] = {
+    at::ScalarType::Bool,  at::ScalarType::Byte,     at::ScalarType::Char,
+    at::ScalarType::Short, at::ScalarType::Int,      at::ScalarType::Long,
+    at::ScalarType::Half,  at::ScalarType::BFloat16, at::ScalarType::Float,
+    at::ScalarType::Double, at::ScalarType::ComplexFloat,
+    at::ScalarType::ComplexDouble};
+
+std::string GetShardPath(const std::string& path, size_t shard,
+                         size_t num_shards) {
+  return tensorflow::io::JoinPath(
+      path, absl::StrCat("data-", shard, "-of-", num_shards));
+}
+
+std::string GetIndexPath(const std::string& path) {
+  return tensorflow::io::JoinPath(path, kIndexFile);
+}
+
+// Reads a whole range, as file systems are allowed to return fewer bytes than
+// requested, or to point the result to memory other than the given buffer.
+void ReadFileRange(tensorflow::RandomAccessFile* file, xla::uint64 offset,
+                   size_t size, char* buffer) {
+  while (size > 0) {
+    tensorflow::StringPiece result;
+    XLA_CHECK_OK(file->Read(offset, size, &result, buffer));
+    XLA_CHECK_GT(result.size(), 0) << "Truncated checkpoint shard";
+    if (result.data() != buffer) {
+      std::memcpy(buffer, result.data(), result.size());
+    }
+    offset += result.size();
+    buffer += result.size();
+    size -= result.size();
+  }
+}
+
+// Assigns the tensors to the shards starting from the biggest ones, always
+// picking the shard currently holding the fewest bytes.
+std::vector<size_t> AssignShards(const std::vector<at::Tensor>& tensors,
+                                 size_t num_shards) {
+  std::vector<size_t> order(tensors.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return tensors[a].nbytes() > tensors[b].nbytes();
+  });
+  std::vector<xla::uint64> shard_bytes(num_shards, 0);
+  std::vector<size_t> shards(tensors.size());
+  for (auto index : order) {
+    size_t shard =
+        std::min_element(shard_bytes.begin(), shard_bytes.end()) -
+        shard_bytes.begin();
+    shards[index] = shard;
+    shard_bytes[shard] += tensors[index].nbytes();
+  }
+  return shards;
+}
+
+std::string SerializeIndex(
+    const std::vector<TensorCheckpoint::Entry>& entries, size_t num_shards) {
+  std::string index = absl::StrCat(kIndexVersion, "\t", num_shards, "\n");
+  for (auto& entry : entries) {
+    absl::StrAppend(&index, entry.name, "\t", c10::toString(entry.scalar_type),
+                    "\t", absl::StrJoin(entry.dimensions, ","), "\t",
+                    entry.shard, "\t", entry.offset, "\t", entry.size, "\n");
+  }
+  return index;
+}
+
+}  // namespace
+
+at::ScalarType TensorCheckpoint::ParseScalarType(absl::string_view name) {
+  for (auto scalar_type : kScalarTypes) {
+    if (name == c10::toString(scalar_type)) {
+      return scalar_type;
+    }
+  }
+  XLA_ERROR() << "Invalid checkpoint tensor type: " << name;
+}
+
+void TensorCheckpoint::Save(const std::string& path,
+                            const std::vector<std::string>& names,
+                            const std::vector<at::Tensor>& tensors,
+                            size_t num_shards) {
+  XLA_TIMED("TensorCheckpointSave");
+  XLA_CHECK_EQ(names.size(), tensors.size());
+  num_shards = std::max<size_t>(std::min(num_shards, tensors.size()), 1);
+  std::vector<at::Tensor> contiguous_tensors;
+  contiguous_tensors.reserve(tensors.size());
+  for (auto& tensor : tensors) {
+    contiguous_tensors.push_back(tensor.contiguous());
+  }
+  std::vector<size_t> shards = AssignShards(contiguous_tensors, num_shards);
+  std::vector<Entry> entries(tensors.size());
+  std::vector<std::vector<size_t>> shard_tensors(num_shards);
+  std::vector<xla::uint64> shard_offsets(num_shards, 0);
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    XLA_CHECK(names[i].find_first_of("\t\n") == std::string::npos)
+        << "Invalid checkpoint tensor name: " << names[i];
+    Entry& entry = entries[i];
+    entry.name = names[i];
+    entry.scalar_type = contiguous_tensors[i].scalar_type();
+    entry.dimensions = xla::util::ToVector<xla::int64>(tensors[i].sizes());
+    entry.shard = shards[i];
+    entry.offset = shard_offsets[entry.shard];
+    entry.size = contiguous_tensors[i].nbytes();
+    shard_offsets[entry.shard] += entry.size;
+    shard_tensors[entry.shard].push_back(i);
+  }
+
+  tensorflow::Env* env = tensorflow::Env::Default();
+  XLA_CHECK_OK(env->RecursivelyCreateDir(path));
+  xla::util::MultiWait mwait(num_shards);
+  for (size_t shard = 0; shard < num_shards; ++shard) {
+    auto writer = [&, shard]() {
+      std::unique_ptr<tensorflow::WritableFile> file;
+      XLA_CHECK_OK(
+          env->NewWritableFile(GetShardPath(path, shard, num_shards), &file));
+      for (auto index : shard_tensors[shard]) {
+        const at::Tensor& tensor = contiguous_tensors[index];
+        XLA_CHECK_OK(file->Append(tensorflow::StringPiece(
+            static_cast<const char*>(tensor.data_ptr()), tensor.nbytes())));
+      }
+      XLA_CHECK_OK(file->Close());
+    };
+    xla::env::ScheduleIoClosure(mwait.Completer(std::move(writer)));
+  }
+  mwait.Wait();
+  // The index is written last, so that its presence marks a complete
+  // checkpoint.
+  XLA_CHECK_OK(tensorflow::WriteStringToFile(
+      env, GetIndexPath(path), SerializeIndex(entries, num_shards)));
+}
+
+TensorCheckpoint::Index TensorCheckpoint::LoadIndex(
+    const std::string& path) {
+  std::string index;
+  XLA_CHECK_OK(tensorflow::ReadFileToString(tensorflow::Env::Default(),
+                                            GetIndexPath(path), &index));
+  std::vector<absl::string_view> lines =
+      absl::StrSplit(index, '\n', absl::SkipEmpty());
+  XLA_CHECK(!lines.empty()) << "Empty checkpoint index: " << path;
+  std::vector<absl::string_view> header = absl::StrSplit(lines[0], '\t');
+  XLA_CHECK(header.size() == 2 && header[0] == kIndexVersion)
+      << "Invalid checkpoint index: " << path;
+  Index checkpoint_index;
+  XLA_CHECK(absl::SimpleAtoi(header[1], &checkpoint_index.num_shards));
+  for (size_t i = 1; i < lines.size(); ++i) {
+    std::vector<absl::string_view> fields = absl::StrSplit(lines[i], '\t');
+    XLA_CHECK_EQ(fields.size(), 6) << "Invalid checkpoint index line: "
+                                   << lines[i];
+    Entry entry;
+    entry.name = std::string(fields[0]);
+    entry.scalar_type = ParseScalarType(fields[1]);
+    for (auto dim : absl::StrSplit(fields[2], ',', absl::SkipEmpty())) {
+      xla::int64 size = 0;
+      XLA_CHECK(absl::SimpleAtoi(dim, &size)) << lines[i];
+      entry.dimensions.push_back(size);
+    }
+    XLA_CHECK(absl::SimpleAtoi(fields[3], &entry.shard)) << lines[i];
+    XLA_CHECK(absl::SimpleAtoi(fields[4], &entry.offset)) << lines[i];
+    XLA_CHECK(absl::SimpleAtoi(fields[5], &entry.size)) << lines[i];
+    XLA_CHECK_LT(entry.shard, checkpoint_index.num_shards) << lines[i];
+    checkpoint_index.entries.push_back(std::move(entry));
+  }
+  return checkpoint_index;
+}
+
+std::vector<xla::ComputationClient::DataPtr> TensorCheckpoint::Load(
+    const std::string& path, const Index& index, const Device& device) {
+  XLA_TIMED("TensorCheckpointLoad");
+  tensorflow::Env* env = tensorflow::Env::Default();
+  size_t num_shards = index.num_shards;
+  std::vector<std::shared_ptr<tensorflow::RandomAccessFile>> files(num_shards);
+  std::vector<xla::ComputationClient::TensorSource> source_tensors;
+  source_tensors.reserve(index.entries.size());
+  for (auto& entry : index.entries) {
+    if (files[entry.shard] == nullptr) {
+      std::unique_ptr<tensorflow::RandomAccessFile> file;
+      XLA_CHECK_OK(env->NewRandomAccessFile(
+          GetShardPath(path, entry.shard, num_shards), &file));
+      files[entry.shard] = std::move(file);
+    }
+    xla::PrimitiveType raw_type = TensorTypeToRawXlaType(entry.scalar_type);
+    xla::Shape shape = MakeShapeWithDeviceLayout(
+        xla::ShapeUtil::MakeShape(
+            MakeXlaPrimitiveType(entry.scalar_type, &device),
+            entry.dimensions),
+        device.hw_type);
+    // The populate function is called by the transfer workers, so the shard
+    // reads happen in parallel, straight into the transfer buffers when no
+    // type conversion is needed.
+    auto populate_fn =
+        [&entry, &device, file = files[entry.shard], raw_type](
+            const xla::ComputationClient::TensorSource& source_tensor,
+            void* dest_buffer, size_t dest_buffer_size) {
+          if (source_tensor.shape.element_type() == raw_type) {
+            XLA_CHECK_EQ(dest_buffer_size, entry.size);
+            ReadFileRange(file.get(), entry.offset, entry.size,
+                          static_cast<char*>(dest_buffer));
+            return;
+          }
+          std::unique_ptr<char[]> buffer(new char[entry.size]);
+          ReadFileRange(file.get(), entry.offset, entry.size, buffer.get());
+          at::Tensor tensor = at::from_blob(
+              buffer.get(), xla::util::ToVector<int64_t>(entry.dimensions),
+              at::TensorOptions(entry.scalar_type));
+          PopulateTensorBuffer(tensor, source_tensor.shape, dest_buffer,
+                               dest_buffer_size, device);
+        };
+    source_tensors.emplace_back(std::move(shape), device.ToString(),
+                                std::move(populate_fn));
+  }
+  return xla::ComputationClient::Get()->TransferToServer(source_tensors);
+}
+
+}  // namespace torch_xla
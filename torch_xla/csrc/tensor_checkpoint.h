@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "tensorflow/compiler/xla/shape.h"
+#include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+#include "torch/csrc/autograd/variable.h"
+#include "torch_xla/csrc/device.h"
+
+namespace torch_xla {
+
+// Native checkpoint format, made of a flat index file and a number of shard
+// files holding the raw (dim0-major) tensor data blobs back to back. Shards
+// are written in parallel, and restored straight into the device transfer
+// buffers, without materializing the tensors on host.
+class TensorCheckpoint {
+ public:
+  struct Entry {
+    std::string name;
+    at::ScalarType scalar_type;
+    std::vector<xla::int64> dimensions;
+    size_t shard = 0;
+    xla::uint64 offset = 0;
+    xla::uint64 size = 0;
+  };
+
+  struct Index {
+    size_t num_shards = 0;
+    std::vector<Entry> entries;
+  };
+
+  // Writes the PyTorch CPU tensors into the checkpoint at path (a directory,
+  // which is created if missing), spreading them over num_shards shards.
+  static void Save(const std::string& path,
+                   const std::vector<std::string>& names,
+                   const std::vector<at::Tensor>& tensors, size_t num_shards);
+
+  static Index LoadIndex(const std::string& path);
+
+  // Parses the tensor type names written in the index.
+  static at::ScalarType ParseScalarType(absl::string_view name);
+
+  // Uploads the content of all the checkpoint entries onto device, in index
+  // order.
+  static std::vector<xla::ComputationClient::DataPtr> Load(
+      const std::string& path, const Index& index, const Device& device);
+};
+
+}  // namespace torch_xla
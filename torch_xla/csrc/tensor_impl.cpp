@@ -4,6 +4,8 @@
 #include <c10/core/impl/DeviceGuardImplInterface.h>
 #include <c10/macros/Macros.h>
 
+#include <algorithm>
+
 #include "tensorflow/compiler/xla/xla_client/computation_client.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 #include "torch_xla/csrc/aten_xla_bridge.h"
@@ -116,15 +118,23 @@ void XLATensorImpl::SetupSizeProperties() {
     // Fill up the basic dimension data members which the base class
     // implementation uses in its APIs.
     auto shape = tensor_.shape();
-    sizes_.clear();
-    numel_ = 1;
-    for (auto dim : shape.get().dimensions()) {
-      sizes_.push_back(dim);
-      numel_ *= dim;
-    }
-    strides_.clear();
-    for (auto stride : ComputeArrayStrides(shape.get().dimensions())) {
-      strides_.push_back(stride);
+    absl::Span<const xla::int64> dimensions = shape.get().dimensions();
+    // In place operations bump the generation while mostly leaving the sizes
+    // untouched, in which case the size members are already up to date.
+    if (generation_ == 0 || sizes_.size() != dimensions.size() ||
+        !std::equal(dimensions.begin(), dimensions.end(), sizes_.begin())) {
+      sizes_.assign(dimensions.begin(), dimensions.end());
+      numel_ = 1;
+      for (auto dim : dimensions) {
+        numel_ *= dim;
+      }
+      // Same as ComputeArrayStrides(), without the temporary vector.
+      strides_.resize(dimensions.size());
+      int64_t stride = 1;
+      for (size_t i = dimensions.size(); i > 0; --i) {
+        strides_[i - 1] = stride;
+        stride *= dimensions[i - 1];
+      }
     }
     generation_ = generation;
   }
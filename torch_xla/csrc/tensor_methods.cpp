@@ -6,18 +6,26 @@
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_split.h"
 #include "tensorflow/compiler/xla/literal_util.h"
+#include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 #include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
 #include "tensorflow/compiler/xla/xla_client/xla_util.h"
 #include "torch/csrc/autograd/variable.h"
+#include "torch_xla/csrc/autocast_policy.h"
+#include "torch_xla/csrc/conv_bn_folding.h"
 #include "torch_xla/csrc/data_ops.h"
+#include "torch_xla/csrc/einsum_path.h"
 #include "torch_xla/csrc/helpers.h"
 #include "torch_xla/csrc/ir_util.h"
 #include "torch_xla/csrc/layout_manager.h"
 #include "torch_xla/csrc/lowering_context.h"
+#include "torch_xla/csrc/ops/adam_step.h"
 #include "torch_xla/csrc/ops/adaptive_avg_pool2d.h"
+#include "torch_xla/csrc/ops/adaptive_avg_pool3d.h"
 #include "torch_xla/csrc/ops/all.h"
+#include "torch_xla/csrc/ops/all_gather.h"
 #include "torch_xla/csrc/ops/all_reduce.h"
 #include "torch_xla/csrc/ops/all_to_all.h"
 #include "torch_xla/csrc/ops/any.h"
@@ -27,6 +35,7 @@
 #include "torch_xla/csrc/ops/as_strided.h"
 #include "torch_xla/csrc/ops/avg_pool_nd.h"
 #include "torch_xla/csrc/ops/avg_pool_nd_backward.h"
+#include "torch_xla/csrc/ops/batched_nms.h"
 #include "torch_xla/csrc/ops/bernoulli.h"
 #include "torch_xla/csrc/ops/binary_cross_entropy.h"
 #include "torch_xla/csrc/ops/binary_cross_entropy_backward.h"
@@ -34,16 +43,25 @@
 #include "torch_xla/csrc/ops/cast.h"
 #include "torch_xla/csrc/ops/cat.h"
 #include "torch_xla/csrc/ops/cholesky.h"
+#include "torch_xla/csrc/ops/clip_grad_norm.h"
 #include "torch_xla/csrc/ops/collective_permute.h"
+#include "torch_xla/csrc/ops/column_parallel_matmul.h"
 #include "torch_xla/csrc/ops/constant.h"
 #include "torch_xla/csrc/ops/constant_pad_nd.h"
 #include "torch_xla/csrc/ops/convolution_backward_overrideable.h"
 #include "torch_xla/csrc/ops/convolution_overrideable.h"
+#include "torch_xla/csrc/ops/cross_entropy.h"
+#include "torch_xla/csrc/ops/cross_entropy_backward.h"
 #include "torch_xla/csrc/ops/cumprod.h"
+#include "torch_xla/csrc/ops/custom_kernel.h"
 #include "torch_xla/csrc/ops/cumsum.h"
 #include "torch_xla/csrc/ops/device_data.h"
 #include "torch_xla/csrc/ops/diagonal.h"
+#include "torch_xla/csrc/ops/dropout.h"
+#include "torch_xla/csrc/ops/dynamic_update_slice.h"
 #include "torch_xla/csrc/ops/einsum.h"
+#include "torch_xla/csrc/ops/embedding_bag.h"
+#include "torch_xla/csrc/ops/embedding_bag_backward.h"
 #include "torch_xla/csrc/ops/expand.h"
 #include "torch_xla/csrc/ops/exponential.h"
 #include "torch_xla/csrc/ops/flip.h"
@@ -86,17 +104,24 @@
 #include "torch_xla/csrc/ops/prod.h"
 #include "torch_xla/csrc/ops/put.h"
 #include "torch_xla/csrc/ops/qr.h"
+#include "torch_xla/csrc/ops/reduce_scatter.h"
 #include "torch_xla/csrc/ops/reflection_pad2d.h"
 #include "torch_xla/csrc/ops/reflection_pad2d_backward.h"
 #include "torch_xla/csrc/ops/repeat.h"
+#include "torch_xla/csrc/ops/quantized_convolution.h"
+#include "torch_xla/csrc/ops/quantized_matmul.h"
 #include "torch_xla/csrc/ops/replication_pad.h"
 #include "torch_xla/csrc/ops/replication_pad_backward.h"
 #include "torch_xla/csrc/ops/resize.h"
+#include "torch_xla/csrc/ops/row_parallel_matmul.h"
 #include "torch_xla/csrc/ops/rrelu_with_noise.h"
 #include "torch_xla/csrc/ops/rrelu_with_noise_backward.h"
 #include "torch_xla/csrc/ops/scalar.h"
+#include "torch_xla/csrc/ops/scaled_dot_product_attention.h"
+#include "torch_xla/csrc/ops/scaled_dot_product_attention_backward.h"
 #include "torch_xla/csrc/ops/scatter.h"
 #include "torch_xla/csrc/ops/scatter_add.h"
+#include "torch_xla/csrc/ops/sgd_momentum_step.h"
 #include "torch_xla/csrc/ops/shrink_backward.h"
 #include "torch_xla/csrc/ops/softmax.h"
 #include "torch_xla/csrc/ops/softshrink.h"
@@ -107,6 +132,8 @@
 #include "torch_xla/csrc/ops/sum.h"
 #include "torch_xla/csrc/ops/svd.h"
 #include "torch_xla/csrc/ops/symeig.h"
+#include "torch_xla/csrc/ops/sync_batch_norm.h"
+#include "torch_xla/csrc/ops/sync_batch_norm_backward.h"
 #include "torch_xla/csrc/ops/threshold.h"
 #include "torch_xla/csrc/ops/threshold_backward.h"
 #include "torch_xla/csrc/ops/topk.h"
@@ -114,12 +141,14 @@
 #include "torch_xla/csrc/ops/tril.h"
 #include "torch_xla/csrc/ops/triu.h"
 #include "torch_xla/csrc/ops/uniform.h"
+#include "torch_xla/csrc/ops/unique_indices.h"
 #include "torch_xla/csrc/ops/unsqueeze.h"
 #include "torch_xla/csrc/ops/upsample_bilinear2d.h"
 #include "torch_xla/csrc/ops/upsample_bilinear2d_backward.h"
 #include "torch_xla/csrc/ops/upsample_nearest2d.h"
 #include "torch_xla/csrc/ops/upsample_nearest2d_backward.h"
 #include "torch_xla/csrc/ops/user_computation.h"
+#include "torch_xla/csrc/ops/var_mean.h"
 #include "torch_xla/csrc/ops/view.h"
 #include "torch_xla/csrc/shape_builder.h"
 #include "torch_xla/csrc/tensor.h"
@@ -285,11 +314,129 @@ ViewInfo CreateAsStridedViewInfo(const xla::Shape& input_shape,
                   input_shape, std::move(as_strided_info));
 }
 
+bool IsSimplifyEnabled() {
+  static const bool simplify =
+      xla::sys_util::GetEnvBool("XLA_IR_SIMPLIFY", true);
+  return simplify;
+}
+
+// Returns whether the value is known to be the given constant, possibly
+// broadcasted, like the zeros gradients get accumulated into after
+// zero_grad(), or the default alpha of add().
+bool IsConstantValue(const ir::Value& value, int constant) {
+  const ir::Node* node = value.node.get();
+  while (node->op() == ir::OpKind(at::aten::expand)) {
+    node = node->operand(0).node;
+  }
+  if (node->op() != ir::OpKind(at::prim::Constant)) {
+    return false;
+  }
+  const ir::ops::Scalar* scalar = dynamic_cast<const ir::ops::Scalar*>(node);
+  if (scalar != nullptr) {
+    const at::Scalar& scalar_value = scalar->value();
+    return (scalar_value.isIntegral() || scalar_value.isFloatingPoint()) &&
+           scalar_value.toDouble() == constant;
+  }
+  const ir::ops::Constant* literal =
+      dynamic_cast<const ir::ops::Constant*>(node);
+  return literal != nullptr && literal->value().shape().IsArray() &&
+         literal->value().IsAll(constant);
+}
+
+// Whether the binary op with the identity operand can be replaced by the
+// other operand, which must already have the promoted result shape.
+bool IsIdentityOperation(const ir::Value& value, const ir::Value& identity,
+                         int constant) {
+  if (!IsSimplifyEnabled() || !IsConstantValue(identity, constant)) {
+    return false;
+  }
+  xla::Shape shape =
+      XlaHelpers::GetPromotedBinaryOpShape(value.shape(), identity.shape());
+  if (!xla::ShapeUtil::Equal(shape, value.shape())) {
+    return false;
+  }
+  XLA_COUNTER("SimplifiedIrOps", 1);
+  return true;
+}
+
+ir::Value AddValues(const ir::Value& input, const ir::Value& other) {
+  if (IsIdentityOperation(input, other, 0)) {
+    return input;
+  }
+  if (IsIdentityOperation(other, input, 0)) {
+    return other;
+  }
+  return input + other;
+}
+
+ir::Value SubValues(const ir::Value& input, const ir::Value& other) {
+  if (IsIdentityOperation(input, other, 0)) {
+    return input;
+  }
+  return input - other;
+}
+
+ir::Value MulValues(const ir::Value& input, const ir::Value& other) {
+  if (IsIdentityOperation(input, other, 1)) {
+    return input;
+  }
+  if (IsIdentityOperation(other, input, 1)) {
+    return other;
+  }
+  return input * other;
+}
+
+std::vector<ir::Value> GetIrValues(absl::Span<const XLATensor> tensors) {
+  std::vector<ir::Value> values;
+  values.reserve(tensors.size());
+  for (auto& tensor : tensors) {
+    values.push_back(tensor.GetIrValue());
+  }
+  return values;
+}
+
+// Returns the type of the quantized, or of the rescaled, results.
+at::ScalarType QuantizedResultType(
+    const XLATensor& input, const XLATensor& weight_scale,
+    const absl::optional<QuantizationParams>& input_params,
+    const absl::optional<QuantizationParams>& output_params) {
+  if (output_params) {
+    return at::ScalarType::Char;
+  }
+  return input_params ? weight_scale.dtype() : input.dtype();
+}
+
 }  // namespace
 
 //////////////////////////////////////////////////////////////////////////////
 // XLA dedicated operators follows here, listed in alphabetical order.
 //////////////////////////////////////////////////////////////////////////////
+void XLATensor::adam_step_multi(std::vector<XLATensor>* params,
+                                absl::Span<const XLATensor> grads,
+                                std::vector<XLATensor>* exp_avgs,
+                                std::vector<XLATensor>* exp_avg_sqs,
+                                double step_size, double bias_correction2_sqrt,
+                                double beta1, double beta2, double eps,
+                                double weight_decay) {
+  if (params->empty()) {
+    return;
+  }
+  const XLATensor& first = params->front();
+  xla::PrimitiveType type = first.shape().get().element_type();
+  ir::NodePtr node = ir::MakeNode<ir::ops::AdamStep>(
+      GetIrValues(*params), GetIrValues(grads), GetIrValues(*exp_avgs),
+      GetIrValues(*exp_avg_sqs),
+      GetIrValueForScalar(step_size, type, first.GetDevice()),
+      GetIrValueForScalar(bias_correction2_sqrt, type, first.GetDevice()),
+      beta1, beta2, eps, weight_decay);
+  size_t count = params->size();
+  for (size_t i = 0; i < count; ++i) {
+    (*params)[i].SetInPlaceIrValue(ir::Value(node, i));
+    (*exp_avgs)[i].SetInPlaceIrValue(ir::Value(node, count + i));
+    (*exp_avg_sqs)[i].SetInPlaceIrValue(ir::Value(node, 2 * count + i));
+  }
+}
+
 std::pair<XLATensor, ir::Value> XLATensor::all_reduce(
     const XLATensor& input, const ir::Value& token, AllReduceType reduce_type,
     double scale, std::vector<std::vector<xla::int64>> groups) {
@@ -336,6 +483,64 @@ std::pair<XLATensor, ir::Value> XLATensor::all_to_all(
   return {input.CreateFrom(ir::Value(node, 0)), ir::Value(node, 1)};
 }
 
+std::pair<XLATensor, ir::Value> XLATensor::all_gather(
+    const XLATensor& input, const ir::Value& token, xla::int64 dim,
+    xla::int64 shard_count, std::vector<std::vector<xla::int64>> groups) {
+  xla::int64 canonical_dim =
+      XlaHelpers::GetCanonicalDimensionIndex(dim, input.shape().get().rank());
+  ir::NodePtr node = ir::MakeNode<ir::ops::AllGather>(
+      input.GetIrValue(), token, canonical_dim, shard_count, std::move(groups));
+  return {input.CreateFrom(ir::Value(node, 0)), ir::Value(node, 1)};
+}
+
+std::pair<XLATensor, ir::Value> XLATensor::reduce_scatter(
+    const XLATensor& input, const ir::Value& token, AllReduceType reduce_type,
+    double scale, xla::int64 scatter_dim, xla::int64 shard_count,
+    std::vector<std::vector<xla::int64>> groups) {
+  xla::int64 canonical_dim = XlaHelpers::GetCanonicalDimensionIndex(
+      scatter_dim, input.shape().get().rank());
+  ir::NodePtr node = ir::MakeNode<ir::ops::ReduceScatter>(
+      reduce_type, input.GetIrValue(), token, scale, canonical_dim, shard_count,
+      std::move(groups));
+  return {input.CreateFrom(ir::Value(node, 0)), ir::Value(node, 1)};
+}
+
+XLATensor XLATensor::clip_grad_norm_multi(std::vector<XLATensor>* grads,
+                                          double max_norm, double norm_type) {
+  XLA_CHECK(!grads->empty());
+  const XLATensor& first = grads->front();
+  ir::NodePtr node = ir::MakeNode<ir::ops::ClipGradNorm>(
+      GetIrValues(*grads),
+      GetIrValueForScalar(max_norm, xla::PrimitiveType::F32,
+                          first.GetDevice()),
+      norm_type);
+  size_t count = grads->size();
+  for (size_t i = 0; i < count; ++i) {
+    (*grads)[i].SetInPlaceIrValue(ir::Value(node, i));
+  }
+  return first.CreateFrom(ir::Value(node, count));
+}
+
+std::pair<XLATensor, ir::Value> XLATensor::column_parallel_matmul(
+    const XLATensor& input, const XLATensor& weight, const XLATensor& bias,
+    const ir::Value& token, bool gather_output, xla::int64 shard_count,
+    xla::int64 num_chunks, std::vector<std::vector<xla::int64>> groups) {
+  ir::NodePtr node = ir::MakeNode<ir::ops::ColumnParallelMatMul>(
+      input.GetIrValue(), weight.GetIrValue(), GetOptionalIrValue(bias), token,
+      gather_output, shard_count, num_chunks, std::move(groups));
+  return {input.CreateFrom(ir::Value(node, 0)), ir::Value(node, 1)};
+}
+
+std::pair<XLATensor, ir::Value> XLATensor::row_parallel_matmul(
+    const XLATensor& input, const XLATensor& weight, const XLATensor& bias,
+    const ir::Value& token, bool scatter_output, xla::int64 shard_count,
+    xla::int64 num_chunks, std::vector<std::vector<xla::int64>> groups) {
+  ir::NodePtr node = ir::MakeNode<ir::ops::RowParallelMatMul>(
+      input.GetIrValue(), weight.GetIrValue(), GetOptionalIrValue(bias), token,
+      scatter_output, shard_count, num_chunks, std::move(groups));
+  return {input.CreateFrom(ir::Value(node, 0)), ir::Value(node, 1)};
+}
+
 std::pair<XLATensor, ir::Value> XLATensor::collective_permute(
     const XLATensor& input, const ir::Value& token,
     std::vector<std::pair<xla::int64, xla::int64>> source_target_pairs) {
@@ -344,6 +549,37 @@ std::pair<XLATensor, ir::Value> XLATensor::collective_permute(
   return {input.CreateFrom(ir::Value(node, 0)), ir::Value(node, 1)};
 }
 
+std::tuple<XLATensor, XLATensor, XLATensor, XLATensor, ir::Value>
+XLATensor::sync_batch_norm(const XLATensor& input, const XLATensor& weight,
+                           const XLATensor& bias, const ir::Value& token,
+                           double eps,
+                           std::vector<std::vector<xla::int64>> groups) {
+  ir::NodePtr node = ir::MakeNode<ir::ops::SyncBatchNorm>(
+      input.GetIrValue(), weight.GetIrValue(), bias.GetIrValue(), token, eps,
+      std::move(groups));
+  return std::make_tuple(input.CreateFrom(ir::Value(node, 0)),
+                         input.CreateFrom(ir::Value(node, 1)),
+                         input.CreateFrom(ir::Value(node, 2)),
+                         input.CreateFrom(ir::Value(node, 3)),
+                         ir::Value(node, 4));
+}
+
+std::tuple<XLATensor, XLATensor, XLATensor, ir::Value>
+XLATensor::sync_batch_norm_backward(
+    const XLATensor& grad_output, const XLATensor& input,
+    const XLATensor& weight, const XLATensor& mean, const XLATensor& invstd,
+    const XLATensor& count, const ir::Value& token,
+    std::vector<std::vector<xla::int64>> groups) {
+  ir::NodePtr node = ir::MakeNode<ir::ops::SyncBatchNormBackward>(
+      grad_output.GetIrValue(), input.GetIrValue(), weight.GetIrValue(),
+      mean.GetIrValue(), invstd.GetIrValue(), count.GetIrValue(), token,
+      std::move(groups));
+  return std::make_tuple(input.CreateFrom(ir::Value(node, 0)),
+                         weight.CreateFrom(ir::Value(node, 1)),
+                         weight.CreateFrom(ir::Value(node, 2)),
+                         ir::Value(node, 3));
+}
+
 XLATensor XLATensor::get_dimensions_size(const XLATensor& input,
                                          std::vector<xla::int64> dimensions) {
   return input.CreateFrom(ir::MakeNode<ir::ops::GetDimensionsSize>(
@@ -351,6 +587,27 @@ XLATensor XLATensor::get_dimensions_size(const XLATensor& input,
                           at::ScalarType::Int);
 }
 
+void XLATensor::sgd_momentum_step_multi(
+    std::vector<XLATensor>* params, absl::Span<const XLATensor> grads,
+    std::vector<XLATensor>* momentum_buffers, double lr, double momentum,
+    double dampening, double weight_decay, bool nesterov,
+    bool init_momentum_buffers) {
+  if (params->empty()) {
+    return;
+  }
+  const XLATensor& first = params->front();
+  xla::PrimitiveType type = first.shape().get().element_type();
+  ir::NodePtr node = ir::MakeNode<ir::ops::SgdMomentumStep>(
+      GetIrValues(*params), GetIrValues(grads), GetIrValues(*momentum_buffers),
+      GetIrValueForScalar(lr, type, first.GetDevice()), momentum, dampening,
+      weight_decay, nesterov, init_momentum_buffers);
+  size_t count = params->size();
+  for (size_t i = 0; i < count; ++i) {
+    (*params)[i].SetInPlaceIrValue(ir::Value(node, i));
+    (*momentum_buffers)[i].SetInPlaceIrValue(ir::Value(node, count + i));
+  }
+}
+
 std::vector<XLATensor> XLATensor::user_computation(
     const std::string& opname, absl::Span<const XLATensor> inputs,
     ComputationPtr computation) {
@@ -364,6 +621,21 @@ std::vector<XLATensor> XLATensor::user_computation(
   return inputs.front().MakeOutputTensors(node);
 }
 
+std::vector<XLATensor> XLATensor::custom_kernel(
+    const std::string& name, absl::Span<const XLATensor> inputs) {
+  XLA_CHECK(!inputs.empty()) << name;
+  std::shared_ptr<const CustomKernel> kernel =
+      CustomKernelRegistry::Get()->Find(name);
+  XLA_CHECK(kernel != nullptr) << "Custom kernel not registered: " << name;
+  std::vector<ir::Value> input_values;
+  for (auto& input : inputs) {
+    input_values.push_back(input.GetIrValue());
+  }
+  ir::NodePtr node =
+      ir::MakeNode<ir::ops::CustomKernelOp>(std::move(kernel), input_values);
+  return inputs.front().MakeOutputTensors(node);
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // ATEN operators follows here, listed in alphabetical order.
 //////////////////////////////////////////////////////////////////////////////
@@ -443,20 +715,34 @@ void XLATensor::acos_(XLATensor& input) {
   input.SetInPlaceIrValue(ir::ops::Acos(input.GetIrValue()));
 }
 
+XLATensor XLATensor::adaptive_avg_pool3d(const XLATensor& input,
+                                         std::vector<xla::int64> output_size) {
+  return input.CreateFrom(ir::MakeNode<ir::ops::AdaptiveAvgPool3d>(
+      input.GetIrValue(), std::move(output_size)));
+}
+
+XLATensor XLATensor::adaptive_avg_pool3d_backward(const XLATensor& grad_output,
+                                                  const XLATensor& input) {
+  return input.CreateFrom(ir::ops::AdaptiveAvgPool3dBackward(
+      grad_output.GetIrValue(), input.GetIrValue()));
+}
+
 XLATensor XLATensor::add(const XLATensor& input, const XLATensor& other,
                          at::Scalar alpha,
                          c10::optional<at::ScalarType> logical_element_type) {
   ir::Value constant = GetIrValueForScalar(
       alpha, other.shape(), logical_element_type, input.GetDevice());
-  return input.CreateFrom(input.GetIrValue() + other.GetIrValue() * constant,
-                          logical_element_type);
+  return input.CreateFrom(
+      AddValues(input.GetIrValue(), MulValues(other.GetIrValue(), constant)),
+      logical_element_type);
 }
 
 void XLATensor::add_(XLATensor& input, const XLATensor& other,
                      at::Scalar alpha) {
   ir::Value constant =
       GetIrValueForScalar(alpha, other.shape(), input.GetDevice());
-  input.SetInPlaceIrValue(input.GetIrValue() + other.GetIrValue() * constant);
+  input.SetInPlaceIrValue(
+      AddValues(input.GetIrValue(), MulValues(other.GetIrValue(), constant)));
 }
 
 XLATensor XLATensor::add(const XLATensor& input, at::Scalar other,
@@ -466,8 +752,9 @@ XLATensor XLATensor::add(const XLATensor& input, at::Scalar other,
       other, input.shape(), logical_element_type, input.GetDevice());
   ir::Value alpha_constant = GetIrValueForScalar(
       alpha, input.shape(), logical_element_type, input.GetDevice());
-  return input.CreateFrom(input.GetIrValue() + other_constant * alpha_constant,
-                          logical_element_type);
+  return input.CreateFrom(
+      AddValues(input.GetIrValue(), MulValues(other_constant, alpha_constant)),
+      logical_element_type);
 }
 
 void XLATensor::add_(XLATensor& input, at::Scalar other, at::Scalar alpha) {
@@ -475,7 +762,8 @@ void XLATensor::add_(XLATensor& input, at::Scalar other, at::Scalar alpha) {
       GetIrValueForScalar(other, input.shape(), input.GetDevice());
   ir::Value alpha_constant =
       GetIrValueForScalar(alpha, input.shape(), input.GetDevice());
-  input.SetInPlaceIrValue(input.GetIrValue() + other_constant * alpha_constant);
+  input.SetInPlaceIrValue(
+      AddValues(input.GetIrValue(), MulValues(other_constant, alpha_constant)));
 }
 
 void XLATensor::addcmul_(XLATensor& input, at::Scalar value,
@@ -514,8 +802,11 @@ XLATensor XLATensor::addcmul(const XLATensor& input, at::Scalar value,
 
 XLATensor XLATensor::addmm(const XLATensor& input, const XLATensor& weight,
                            const XLATensor& bias) {
-  return input.CreateFrom(ir::ops::AddMatMulOp(
-      input.GetIrValue(), weight.GetIrValue(), bias.GetIrValue()));
+  AutocastOp autocast(ir::OpKind(at::aten::addmm));
+  return input.CreateFrom(autocast.Result(ir::ops::AddMatMulOp(
+      autocast.Operand(input.GetIrValue()),
+      autocast.Operand(weight.GetIrValue()),
+      autocast.Operand(bias.GetIrValue()))));
 }
 
 XLATensor XLATensor::all(const XLATensor& input,
@@ -605,6 +896,12 @@ void XLATensor::asin_(XLATensor& input) {
   input.SetInPlaceIrValue(ir::ops::Asin(input.GetIrValue()));
 }
 
+XLATensor XLATensor::assume_unique_indices(const XLATensor& input,
+                                           bool sorted) {
+  return input.CreateFrom(
+      ir::MakeNode<ir::ops::UniqueIndices>(input.GetIrValue(), sorted));
+}
+
 XLATensor XLATensor::atan(const XLATensor& input) {
   return input.CreateFrom(ir::ops::Atan(input.GetIrValue()));
 }
@@ -844,11 +1141,14 @@ XLATensor XLATensor::convolution_overrideable(
     std::vector<xla::int64> stride, std::vector<xla::int64> padding,
     std::vector<xla::int64> dilation, bool transposed,
     std::vector<xla::int64> output_padding, xla::int64 groups) {
+  AutocastOp autocast(ir::OpKind(at::aten::convolution_overrideable));
   ir::NodePtr ir_value = ir::MakeNode<ir::ops::ConvolutionOverrideable>(
-      input.GetIrValue(), weight.GetIrValue(), bias.GetIrValue(),
-      std::move(stride), std::move(padding), std::move(dilation), transposed,
+      autocast.Operand(input.GetIrValue()),
+      autocast.Operand(weight.GetIrValue()),
+      autocast.Operand(bias.GetIrValue()), std::move(stride),
+      std::move(padding), std::move(dilation), transposed,
       std::move(output_padding), groups);
-  return input.CreateFrom(ir_value);
+  return input.CreateFrom(autocast.Result(ir_value));
 }
 
 XLATensor XLATensor::convolution_overrideable(
@@ -856,11 +1156,13 @@ XLATensor XLATensor::convolution_overrideable(
     std::vector<xla::int64> stride, std::vector<xla::int64> padding,
     std::vector<xla::int64> dilation, bool transposed,
     std::vector<xla::int64> output_padding, xla::int64 groups) {
+  AutocastOp autocast(ir::OpKind(at::aten::convolution_overrideable));
   ir::NodePtr ir_value = ir::MakeNode<ir::ops::ConvolutionOverrideable>(
-      input.GetIrValue(), weight.GetIrValue(), std::move(stride),
+      autocast.Operand(input.GetIrValue()),
+      autocast.Operand(weight.GetIrValue()), std::move(stride),
       std::move(padding), std::move(dilation), transposed,
       std::move(output_padding), groups);
-  return input.CreateFrom(ir_value);
+  return input.CreateFrom(autocast.Result(ir_value));
 }
 
 std::tuple<XLATensor, XLATensor, XLATensor>
@@ -902,6 +1204,26 @@ XLATensor XLATensor::cross(const XLATensor& input, const XLATensor& other,
   return tensor_ops::Cross(input, other, dim);
 }
 
+std::pair<XLATensor, XLATensor> XLATensor::cross_entropy(
+    const XLATensor& logits, const XLATensor& labels, xla::int64 ignore_index,
+    xla::int64 chunk_size) {
+  ir::NodePtr node = ir::MakeNode<ir::ops::CrossEntropy>(
+      logits.GetIrValue(), labels.GetIrValue(), ignore_index, chunk_size);
+  // The logsumexp is kept in the full precision type used by the lowering.
+  return std::pair<XLATensor, XLATensor>(
+      logits.CreateFrom(ir::Value(node, 0)),
+      Create(ir::Value(node, 1), logits.GetDevice()));
+}
+
+XLATensor XLATensor::cross_entropy_backward(
+    const XLATensor& grad_output, const XLATensor& logits,
+    const XLATensor& labels, const XLATensor& logsumexp,
+    xla::int64 ignore_index, xla::int64 chunk_size) {
+  return logits.CreateFrom(ir::MakeNode<ir::ops::CrossEntropyBackward>(
+      grad_output.GetIrValue(), logits.GetIrValue(), labels.GetIrValue(),
+      logsumexp.GetIrValue(), ignore_index, chunk_size));
+}
+
 XLATensor XLATensor::cumprod(const XLATensor& input, xla::int64 dim,
                              c10::optional<at::ScalarType> dtype) {
   xla::int64 canonical_dim =
@@ -975,6 +1297,30 @@ void XLATensor::div_(XLATensor& input, at::Scalar other) {
   input.SetInPlaceIrValue(input.GetIrValue() / constant);
 }
 
+std::pair<XLATensor, XLATensor> XLATensor::dropout(const XLATensor& input,
+                                                   double probability) {
+  ir::Value seed = GetRngSeed(input.GetDevice());
+  XLATensor output = input.CreateFrom(
+      ir::MakeNode<ir::ops::Dropout>(input.GetIrValue(), seed, probability));
+  return std::pair<XLATensor, XLATensor>(
+      std::move(output), Create(std::move(seed), input.GetDevice()));
+}
+
+XLATensor XLATensor::dropout_backward(const XLATensor& grad_output,
+                                      const XLATensor& seed,
+                                      double probability) {
+  return grad_output.CreateFrom(ir::MakeNode<ir::ops::Dropout>(
+      grad_output.GetIrValue(), seed.GetIrValue(), probability));
+}
+
+void XLATensor::dynamic_update_slice_(XLATensor& input,
+                                      const XLATensor& source,
+                                      const XLATensor& start, xla::int64 dim) {
+  input.SetInPlaceIrValue(ir::MakeNode<ir::ops::DynamicUpdateSlice>(
+      input.GetIrValue(), source.GetIrValue(), start.GetIrValue(),
+      XlaHelpers::GetCanonicalDimensionIndex(dim, input.shape().get().rank())));
+}
+
 XLATensor XLATensor::eq(const XLATensor& input, at::Scalar other) {
   return DispatchComparisonOp(at::aten::eq, input, other);
 }
@@ -1002,9 +1348,34 @@ XLATensor XLATensor::einsum(const std::string& equation,
   for (const auto& tensor : tensors) {
     tensor_ir_values.push_back(tensor.GetIrValue());
   }
-  XLA_CHECK_EQ(tensors.size(), 2);
-  return tensors[0].CreateFrom(
-      ir::MakeNode<ir::ops::Einsum>(equation, tensor_ir_values));
+  if (tensors.size() == 2) {
+    return tensors[0].CreateFrom(
+        ir::MakeNode<ir::ops::Einsum>(equation, tensor_ir_values));
+  }
+  std::vector<std::vector<xla::int64>> operand_sizes;
+  for (const auto& tensor : tensors) {
+    operand_sizes.push_back(
+        xla::util::ToVector<xla::int64>(tensor.shape().get().dimensions()));
+  }
+  std::shared_ptr<const EinsumPath> path =
+      GetEinsumPath(equation, operand_sizes);
+  XLA_CHECK(path != nullptr) << "Unsupported einsum equation: " << equation;
+  for (size_t i = 0; i < tensor_ir_values.size(); ++i) {
+    if (!path->reduce_dimensions[i].empty()) {
+      tensor_ir_values[i] = ir::MakeNode<ir::ops::Sum>(
+          tensor_ir_values[i], path->reduce_dimensions[i],
+          /*keep_reduced_dimensions=*/false, c10::nullopt);
+    }
+  }
+  for (auto& step : path->steps) {
+    ir::NodePtr contraction = ir::MakeNode<ir::ops::Einsum>(
+        step.equation, std::vector<ir::Value>{tensor_ir_values[step.x],
+                                              tensor_ir_values[step.y]});
+    tensor_ir_values.erase(tensor_ir_values.begin() + step.y);
+    tensor_ir_values.erase(tensor_ir_values.begin() + step.x);
+    tensor_ir_values.push_back(contraction);
+  }
+  return tensors[0].CreateFrom(tensor_ir_values.front());
 }
 
 XLATensor XLATensor::elu(const XLATensor& input, at::Scalar alpha,
@@ -1028,6 +1399,36 @@ XLATensor XLATensor::elu_backward(const XLATensor& grad_output,
                                                      scale, input_scale));
 }
 
+std::tuple<XLATensor, XLATensor, XLATensor, XLATensor>
+XLATensor::embedding_bag(const XLATensor& weight, const XLATensor& indices,
+                         const XLATensor& offsets,
+                         const XLATensor& per_sample_weights, xla::int64 mode,
+                         bool include_last_offset) {
+  XLA_CHECK(mode >= 0 && mode <= 2) << "Invalid embedding bag mode: " << mode;
+  ir::NodePtr node = ir::MakeNode<ir::ops::EmbeddingBag>(
+      weight.GetIrValue(), indices.GetIrValue(), offsets.GetIrValue(),
+      GetOptionalIrValue(per_sample_weights),
+      static_cast<EmbeddingBagMode>(mode), include_last_offset);
+  return std::make_tuple(
+      weight.CreateFrom(ir::Value(node, 0)),
+      indices.CreateFrom(ir::Value(node, 1), at::ScalarType::Long),
+      indices.CreateFrom(ir::Value(node, 2), at::ScalarType::Long),
+      indices.CreateFrom(ir::Value(node, 3), at::ScalarType::Long));
+}
+
+XLATensor XLATensor::embedding_bag_dense_backward(
+    const XLATensor& grad_output, const XLATensor& indices,
+    const XLATensor& offset2bag, const XLATensor& bag_size,
+    const XLATensor& max_indices, const XLATensor& per_sample_weights,
+    xla::int64 num_weights, bool scale_grad_by_freq, xla::int64 mode) {
+  XLA_CHECK(mode >= 0 && mode <= 2) << "Invalid embedding bag mode: " << mode;
+  return grad_output.CreateFrom(ir::MakeNode<ir::ops::EmbeddingBagBackward>(
+      grad_output.GetIrValue(), indices.GetIrValue(), offset2bag.GetIrValue(),
+      bag_size.GetIrValue(), max_indices.GetIrValue(),
+      GetOptionalIrValue(per_sample_weights), num_weights, scale_grad_by_freq,
+      static_cast<EmbeddingBagMode>(mode)));
+}
+
 XLATensor XLATensor::embedding_dense_backward(const XLATensor& grad_output,
                                               const XLATensor& indices,
                                               xla::int64 num_weights,
@@ -1072,9 +1473,16 @@ void XLATensor::exp_(XLATensor& input) {
 XLATensor XLATensor::expand(const XLATensor& input,
                             std::vector<xla::int64> size) {
   auto input_shape = input.shape();
-  return input.CreateFrom(ir::MakeNode<ir::ops::Expand>(
-      input.GetIrValue(),
-      GetExpandDimensions(input_shape.get(), std::move(size))));
+  std::vector<xla::int64> dimensions =
+      GetExpandDimensions(input_shape.get(), std::move(size));
+  if (IsSimplifyEnabled() &&
+      xla::util::ToVector<xla::int64>(input_shape.get().dimensions()) ==
+          dimensions) {
+    XLA_COUNTER("SimplifiedIrOps", 1);
+    return input.CreateFrom(input.GetIrValue());
+  }
+  return input.CreateFrom(
+      ir::MakeNode<ir::ops::Expand>(input.GetIrValue(), std::move(dimensions)));
 }
 
 XLATensor XLATensor::expm1(const XLATensor& input) {
@@ -1496,11 +1904,16 @@ XLATensor XLATensor::log_softmax(const XLATensor& input, xla::int64 dim,
   if (!dtype) {
     dtype = input.dtype_optional();
   }
+  AutocastOp autocast(ir::OpKind(at::aten::log_softmax));
+  ir::Value ir_input = dtype == input.dtype_optional()
+                           ? autocast.Operand(input.GetIrValue())
+                           : input.GetIrValue();
   return input.CreateFrom(
-      ir::MakeNode<ir::ops::LogSoftmax>(input.GetIrValue(),
-                                        XlaHelpers::GetCanonicalDimensionIndex(
-                                            dim, input.shape().get().rank()),
-                                        dtype),
+      autocast.Result(ir::MakeNode<ir::ops::LogSoftmax>(
+          ir_input,
+          XlaHelpers::GetCanonicalDimensionIndex(dim,
+                                                 input.shape().get().rank()),
+          autocast.cast() ? c10::nullopt : dtype)),
       dtype);
 }
 
@@ -1578,8 +1991,10 @@ XLATensor XLATensor::masked_select(const XLATensor& input,
 }
 
 XLATensor XLATensor::matmul(const XLATensor& input, const XLATensor& other) {
+  AutocastOp autocast(ir::OpKind(at::aten::matmul));
   return input.CreateFrom(
-      ir::ops::MatMul(input.GetIrValue(), other.GetIrValue()));
+      autocast.Result(ir::ops::MatMul(autocast.Operand(input.GetIrValue()),
+                                      autocast.Operand(other.GetIrValue()))));
 }
 
 XLATensor XLATensor::max(const XLATensor& input, const XLATensor& other) {
@@ -1648,11 +2063,16 @@ XLATensor XLATensor::mean(const XLATensor& input,
   if (!dtype) {
     dtype = input.dtype_optional();
   }
+  AutocastOp autocast(ir::OpKind(at::aten::mean));
+  ir::Value ir_input = dtype == input.dtype_optional()
+                           ? autocast.Operand(input.GetIrValue())
+                           : input.GetIrValue();
   return input.CreateFrom(
-      ir::MakeNode<ir::ops::Mean>(input.GetIrValue(),
-                                  XlaHelpers::GetCanonicalDimensionIndices(
-                                      dimensions, input.shape().get().rank()),
-                                  keep_reduced_dimensions, dtype),
+      autocast.Result(ir::MakeNode<ir::ops::Mean>(
+          ir_input,
+          XlaHelpers::GetCanonicalDimensionIndices(dimensions,
+                                                   input.shape().get().rank()),
+          keep_reduced_dimensions, autocast.cast() ? c10::nullopt : dtype)),
       dtype);
 }
 
@@ -1685,8 +2105,10 @@ void XLATensor::min_out(XLATensor& min, XLATensor& min_indices,
   min_indices.SetIrValue(ir::Value(node, 1));
 }
 XLATensor XLATensor::mm(const XLATensor& input, const XLATensor& weight) {
+  AutocastOp autocast(ir::OpKind(at::aten::mm));
   return input.CreateFrom(
-      ir::ops::Dot(input.GetIrValue(), weight.GetIrValue()));
+      autocast.Result(ir::ops::Dot(autocast.Operand(input.GetIrValue()),
+                                   autocast.Operand(weight.GetIrValue()))));
 }
 
 XLATensor XLATensor::mse_loss(const XLATensor& input, const XLATensor& target,
@@ -1706,7 +2128,7 @@ XLATensor XLATensor::mse_loss_backward(const XLATensor& grad_output,
 
 XLATensor XLATensor::mul(const XLATensor& input, const XLATensor& other,
                          c10::optional<at::ScalarType> logical_element_type) {
-  return input.CreateFrom(input.GetIrValue() * other.GetIrValue(),
+  return input.CreateFrom(MulValues(input.GetIrValue(), other.GetIrValue()),
                           logical_element_type);
 }
 
@@ -1714,17 +2136,18 @@ XLATensor XLATensor::mul(const XLATensor& input, at::Scalar other,
                          c10::optional<at::ScalarType> logical_element_type) {
   ir::Value constant = GetIrValueForScalar(
       other, input.shape(), logical_element_type, input.GetDevice());
-  return input.CreateFrom(input.GetIrValue() * constant, logical_element_type);
+  return input.CreateFrom(MulValues(input.GetIrValue(), constant),
+                          logical_element_type);
 }
 
 void XLATensor::mul_(XLATensor& input, const XLATensor& other) {
-  input.SetInPlaceIrValue(input.GetIrValue() * other.GetIrValue());
+  input.SetInPlaceIrValue(MulValues(input.GetIrValue(), other.GetIrValue()));
 }
 
 void XLATensor::mul_(XLATensor& input, at::Scalar other) {
   ir::Value constant =
       GetIrValueForScalar(other, input.shape(), input.GetDevice());
-  input.SetInPlaceIrValue(input.GetIrValue() * constant);
+  input.SetInPlaceIrValue(MulValues(input.GetIrValue(), constant));
 }
 
 XLATensor XLATensor::mv(const XLATensor& input, const XLATensor& vec) {
@@ -1757,6 +2180,13 @@ std::tuple<XLATensor, XLATensor, XLATensor> XLATensor::native_batch_norm(
     const XLATensor& input, const XLATensor& weight, const XLATensor& bias,
     XLATensor& running_mean, XLATensor& running_var, bool training,
     double momentum, double eps) {
+  if (!training) {
+    XLATensor output = TryFoldConvBatchNorm(input, weight, bias, running_mean,
+                                            running_var, eps);
+    if (!output.is_null()) {
+      return std::make_tuple(std::move(output), XLATensor(), XLATensor());
+    }
+  }
   xla::Shape features_shape = BatchNormFeaturesShape(input);
   ir::Value weight_value =
       GetIrValueOrDefault(weight, 1, features_shape, input.GetDevice());
@@ -1840,9 +2270,12 @@ void XLATensor::neg_(XLATensor& input) {
 XLATensor XLATensor::nll_loss(const XLATensor& input, const XLATensor& target,
                               const XLATensor& weight, xla::int64 reduction,
                               int ignore_index) {
-  return input.CreateFrom(ir::MakeNode<ir::ops::NllLoss>(
-      input.GetIrValue(), target.GetIrValue(), GetOptionalIrValue(weight),
-      GetXlaReductionMode(reduction), ignore_index));
+  AutocastOp autocast(ir::OpKind(at::aten::nll_loss));
+  ir::Value ir_weight = GetOptionalIrValue(weight);
+  return input.CreateFrom(autocast.Result(ir::MakeNode<ir::ops::NllLoss>(
+      autocast.Operand(input.GetIrValue()), target.GetIrValue(),
+      ir_weight ? autocast.Operand(ir_weight) : ir_weight,
+      GetXlaReductionMode(reduction), ignore_index)));
 }
 
 XLATensor XLATensor::nll_loss_backward(const XLATensor& grad_output,
@@ -1870,6 +2303,18 @@ std::pair<XLATensor, XLATensor> XLATensor::nms(const XLATensor& boxes,
       Create(ir::Value(node, 1), boxes.GetDevice(), at::ScalarType::Int));
 }
 
+std::pair<XLATensor, XLATensor> XLATensor::batched_nms(
+    const XLATensor& boxes, const XLATensor& scores,
+    const XLATensor& score_threshold, const XLATensor& iou_threshold,
+    xla::int64 output_size, xla::int64 top_k) {
+  ir::NodePtr node = ir::MakeNode<ir::ops::BatchedNms>(
+      boxes.GetIrValue(), scores.GetIrValue(), score_threshold.GetIrValue(),
+      iou_threshold.GetIrValue(), output_size, top_k);
+  return std::pair<XLATensor, XLATensor>(
+      Create(ir::Value(node, 0), boxes.GetDevice(), at::ScalarType::Int),
+      Create(ir::Value(node, 1), boxes.GetDevice(), at::ScalarType::Int));
+}
+
 XLATensor XLATensor::nonzero(const XLATensor& input) {
   ir::NodePtr node = ir::MakeNode<ir::ops::NonZero>(input.GetIrValue());
   return input.CreateFrom(ir::Value(node, 0), at::ScalarType::Long);
@@ -1985,6 +2430,41 @@ std::tuple<XLATensor, XLATensor> XLATensor::qr(const XLATensor& input,
                          input.CreateFrom(ir::Value(node, 1)));
 }
 
+XLATensor XLATensor::quantized_convolution(
+    const XLATensor& input, const XLATensor& weight,
+    const XLATensor& weight_scale, const XLATensor& weight_zero_point,
+    const XLATensor& bias, std::vector<xla::int64> stride,
+    std::vector<xla::int64> padding, std::vector<xla::int64> dilation,
+    xla::int64 groups, absl::optional<QuantizationParams> input_params,
+    absl::optional<QuantizationParams> output_params) {
+  at::ScalarType result_type =
+      QuantizedResultType(input, weight_scale, input_params, output_params);
+  xla::PrimitiveType output_type =
+      GetDevicePrimitiveType(xla::PrimitiveType::S8, &input.GetDevice());
+  ir::NodePtr node = ir::MakeNode<ir::ops::QuantizedConvolution>(
+      input.GetIrValue(), weight.GetIrValue(), weight_scale.GetIrValue(),
+      weight_zero_point.GetIrValue(), GetOptionalIrValue(bias),
+      std::move(stride), std::move(padding), std::move(dilation), groups,
+      std::move(input_params), std::move(output_params), output_type);
+  return input.CreateFrom(node, result_type);
+}
+
+XLATensor XLATensor::quantized_matmul(
+    const XLATensor& input, const XLATensor& weight,
+    const XLATensor& weight_scale, const XLATensor& weight_zero_point,
+    const XLATensor& bias, absl::optional<QuantizationParams> input_params,
+    absl::optional<QuantizationParams> output_params) {
+  at::ScalarType result_type =
+      QuantizedResultType(input, weight_scale, input_params, output_params);
+  xla::PrimitiveType output_type =
+      GetDevicePrimitiveType(xla::PrimitiveType::S8, &input.GetDevice());
+  ir::NodePtr node = ir::MakeNode<ir::ops::QuantizedMatMul>(
+      input.GetIrValue(), weight.GetIrValue(), weight_scale.GetIrValue(),
+      weight_zero_point.GetIrValue(), GetOptionalIrValue(bias),
+      std::move(input_params), std::move(output_params), output_type);
+  return input.CreateFrom(node, result_type);
+}
+
 XLATensor XLATensor::reciprocal(const XLATensor& input) {
   return input.CreateFrom(ir::ops::ReciprocalOp(input.GetIrValue()));
 }
@@ -2149,6 +2629,32 @@ void XLATensor::copy_(XLATensor& input, XLATensor& src) {
   }
 }
 
+std::pair<XLATensor, XLATensor> XLATensor::scaled_dot_product_attention(
+    const XLATensor& query, const XLATensor& key, const XLATensor& value,
+    double scale, xla::int64 block_size) {
+  ir::NodePtr node = ir::MakeNode<ir::ops::ScaledDotProductAttention>(
+      query.GetIrValue(), key.GetIrValue(), value.GetIrValue(), scale,
+      block_size);
+  // The logsumexp is kept in the full precision type used by the lowering.
+  return std::pair<XLATensor, XLATensor>(
+      query.CreateFrom(ir::Value(node, 0)),
+      Create(ir::Value(node, 1), query.GetDevice()));
+}
+
+std::tuple<XLATensor, XLATensor, XLATensor>
+XLATensor::scaled_dot_product_attention_backward(
+    const XLATensor& grad_output, const XLATensor& query, const XLATensor& key,
+    const XLATensor& value, const XLATensor& output, const XLATensor& logsumexp,
+    double scale, xla::int64 block_size) {
+  ir::NodePtr node = ir::MakeNode<ir::ops::ScaledDotProductAttentionBackward>(
+      grad_output.GetIrValue(), query.GetIrValue(), key.GetIrValue(),
+      value.GetIrValue(), output.GetIrValue(), logsumexp.GetIrValue(), scale,
+      block_size);
+  return std::make_tuple(query.CreateFrom(ir::Value(node, 0)),
+                         key.CreateFrom(ir::Value(node, 1)),
+                         value.CreateFrom(ir::Value(node, 2)));
+}
+
 void XLATensor::scatter_(XLATensor& input, xla::int64 dim,
                          const XLATensor& index, const XLATensor& src) {
   input.SetIrValue(ir::MakeNode<ir::ops::Scatter>(
@@ -2254,11 +2760,16 @@ XLATensor XLATensor::softmax(const XLATensor& input, xla::int64 dim,
   if (!dtype) {
     dtype = input.dtype_optional();
   }
+  AutocastOp autocast(ir::OpKind(at::aten::softmax));
+  ir::Value ir_input = dtype == input.dtype_optional()
+                           ? autocast.Operand(input.GetIrValue())
+                           : input.GetIrValue();
   return input.CreateFrom(
-      ir::MakeNode<ir::ops::Softmax>(input.GetIrValue(),
-                                     XlaHelpers::GetCanonicalDimensionIndex(
-                                         dim, input.shape().get().rank()),
-                                     dtype),
+      autocast.Result(ir::MakeNode<ir::ops::Softmax>(
+          ir_input,
+          XlaHelpers::GetCanonicalDimensionIndex(dim,
+                                                 input.shape().get().rank()),
+          autocast.cast() ? c10::nullopt : dtype)),
       dtype);
 }
 
@@ -2389,15 +2900,17 @@ XLATensor XLATensor::sub(const XLATensor& input, const XLATensor& other,
                          c10::optional<at::ScalarType> logical_element_type) {
   ir::Value constant = GetIrValueForScalar(
       alpha, other.shape(), logical_element_type, other.GetDevice());
-  return input.CreateFrom(input.GetIrValue() - other.GetIrValue() * constant,
-                          logical_element_type);
+  return input.CreateFrom(
+      SubValues(input.GetIrValue(), MulValues(other.GetIrValue(), constant)),
+      logical_element_type);
 }
 
 void XLATensor::sub_(XLATensor& input, const XLATensor& other,
                      at::Scalar alpha) {
   ir::Value constant =
       GetIrValueForScalar(alpha, other.shape(), other.GetDevice());
-  input.SetInPlaceIrValue(input.GetIrValue() - other.GetIrValue() * constant);
+  input.SetInPlaceIrValue(
+      SubValues(input.GetIrValue(), MulValues(other.GetIrValue(), constant)));
 }
 
 XLATensor XLATensor::sub(const XLATensor& input, at::Scalar other,
@@ -2407,8 +2920,9 @@ XLATensor XLATensor::sub(const XLATensor& input, at::Scalar other,
       other, input.shape(), logical_element_type, input.GetDevice());
   ir::Value alpha_constant = GetIrValueForScalar(
       alpha, input.shape(), logical_element_type, input.GetDevice());
-  return input.CreateFrom(input.GetIrValue() - other_constant * alpha_constant,
-                          logical_element_type);
+  return input.CreateFrom(
+      SubValues(input.GetIrValue(), MulValues(other_constant, alpha_constant)),
+      logical_element_type);
 }
 
 void XLATensor::sub_(XLATensor& input, at::Scalar other, at::Scalar alpha) {
@@ -2416,7 +2930,8 @@ void XLATensor::sub_(XLATensor& input, at::Scalar other, at::Scalar alpha) {
       GetIrValueForScalar(other, input.shape(), input.GetDevice());
   ir::Value alpha_constant =
       GetIrValueForScalar(alpha, input.shape(), input.GetDevice());
-  input.SetInPlaceIrValue(input.GetIrValue() - other_constant * alpha_constant);
+  input.SetInPlaceIrValue(
+      SubValues(input.GetIrValue(), MulValues(other_constant, alpha_constant)));
 }
 
 XLATensor XLATensor::sum(const XLATensor& input,
@@ -2428,11 +2943,16 @@ XLATensor XLATensor::sum(const XLATensor& input,
   } else if (!dtype) {
     dtype = input.dtype_optional();
   }
+  AutocastOp autocast(ir::OpKind(at::aten::sum));
+  ir::Value ir_input = dtype == input.dtype_optional()
+                           ? autocast.Operand(input.GetIrValue())
+                           : input.GetIrValue();
   return input.CreateFrom(
-      ir::MakeNode<ir::ops::Sum>(input.GetIrValue(),
-                                 XlaHelpers::GetCanonicalDimensionIndices(
-                                     dimensions, input.shape().get().rank()),
-                                 keep_reduced_dimensions, dtype),
+      autocast.Result(ir::MakeNode<ir::ops::Sum>(
+          ir_input,
+          XlaHelpers::GetCanonicalDimensionIndices(dimensions,
+                                                   input.shape().get().rank()),
+          keep_reduced_dimensions, autocast.cast() ? c10::nullopt : dtype)),
       dtype);
 }
 
@@ -2690,6 +3210,25 @@ XLATensor XLATensor::upsample_nearest2d_backward(
       grad_output.GetIrValue(), std::move(output_size), std::move(input_size)));
 }
 
+XLATensor XLATensor::var(const XLATensor& input,
+                         std::vector<xla::int64> dimensions,
+                         bool keep_reduced_dimensions, bool unbiased) {
+  return std::get<0>(var_mean(input, std::move(dimensions),
+                              keep_reduced_dimensions, unbiased));
+}
+
+std::tuple<XLATensor, XLATensor> XLATensor::var_mean(
+    const XLATensor& input, std::vector<xla::int64> dimensions,
+    bool keep_reduced_dimensions, bool unbiased) {
+  ir::NodePtr node = ir::MakeNode<ir::ops::VarMean>(
+      input.GetIrValue(),
+      XlaHelpers::GetCanonicalDimensionIndices(dimensions,
+                                               input.shape().get().rank()),
+      keep_reduced_dimensions, unbiased);
+  return std::make_tuple(input.CreateFrom(ir::Value(node, 0)),
+                         input.CreateFrom(ir::Value(node, 1)));
+}
+
 XLATensor XLATensor::view(const XLATensor& input,
                           absl::Span<const xla::int64> output_size) {
   auto input_shape = input.shape();
@@ -228,12 +228,11 @@ XLATensor EmbeddingDenseBackward(const XLATensor& grad_output,
       xla::util::ToVector<xla::int64>(grad.shape().get().dimensions()));
   XLATensor zero_grad =
       XLATensor::full_like(grad, 0, grad.GetDevice(), grad.dtype());
-  return XLATensor::index_put(
-      grad_weight, {indices_rank1},
-      /*start_dim=*/0,
-      /*values=*/XLATensor::where(skip_padding, grad, zero_grad),
-      /*accumulate=*/true,
-      /*result_permutation=*/{0, 1});
+  // The index_add() lowering takes care of combining the gradients of the
+  // duplicated indices before scattering them into grad_weight.
+  return XLATensor::index_add(
+      grad_weight, /*dim=*/0, indices_rank1,
+      /*source=*/XLATensor::where(skip_padding, grad, zero_grad));
 }
 
 }  // namespace tensor_ops
@@ -0,0 +1,178 @@
+#include "torch_xla/csrc/tensor_shard.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+
+namespace torch_xla {
+namespace {
+
+constexpr char kMagic[8] = {'X', 'L', 'A', 'S', 'H', 'R', 'D', '1'};
+// The blobs are page aligned, so that the mapping of the batches of different
+// columns never share pages.
+constexpr size_t kAlignment = 4096;
+
+struct FileHeader {
+  char magic[sizeof(kMagic)];
+  xla::uint64 num_records;
+  xla::uint64 num_columns;
+  xla::uint64 index_offset;
+};
+
+struct ColumnInfo {
+  int32_t scalar_type;
+  int32_t rank;
+  xla::int64 sizes[TensorShard::kMaxRank];
+  xla::uint64 offset;
+};
+
+size_t AlignUp(size_t size) {
+  return (size + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+void WritePadding(std::ofstream* stream, size_t size) {
+  static const char zeros[kAlignment] = {};
+  stream->write(zeros, AlignUp(size) - size);
+}
+
+}  // namespace
+
+struct TensorShard::Mapping {
+  Mapping(void* data, size_t size) : data(data), size(size) {}
+
+  ~Mapping() { munmap(data, size); }
+
+  void* data;
+  size_t size;
+};
+
+void TensorShard::Write(const std::string& path,
+                        absl::Span<const at::Tensor> columns) {
+  XLA_CHECK(!columns.empty());
+  FileHeader header;
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.num_records = columns.front().size(0);
+  header.num_columns = columns.size();
+
+  std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+  XLA_CHECK(stream) << "Unable to create tensor shard " << path;
+  stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  WritePadding(&stream, sizeof(header));
+  size_t offset = AlignUp(sizeof(header));
+  std::vector<ColumnInfo> index;
+  for (auto& column : columns) {
+    XLA_CHECK(column.device().is_cpu()) << path;
+    XLA_CHECK_GE(column.dim(), 1) << path;
+    XLA_CHECK_LE(column.dim(), kMaxRank + 1) << path;
+    XLA_CHECK_EQ(column.size(0), header.num_records) << path;
+    at::Tensor data = column.contiguous();
+    ColumnInfo info = {};
+    info.scalar_type = static_cast<int32_t>(data.scalar_type());
+    info.rank = data.dim() - 1;
+    for (xla::int64 dim = 1; dim < data.dim(); ++dim) {
+      info.sizes[dim - 1] = data.size(dim);
+    }
+    info.offset = offset;
+    index.push_back(info);
+
+    size_t nbytes = data.numel() * data.element_size();
+    stream.write(static_cast<const char*>(data.data_ptr()), nbytes);
+    WritePadding(&stream, nbytes);
+    offset += AlignUp(nbytes);
+  }
+  header.index_offset = offset;
+  stream.write(reinterpret_cast<const char*>(index.data()),
+               index.size() * sizeof(ColumnInfo));
+  stream.seekp(0);
+  stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  stream.close();
+  XLA_CHECK(stream) << "Unable to write tensor shard " << path;
+}
+
+TensorShard::TensorShard(const std::string& path) : path_(path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  XLA_CHECK_GE(fd, 0) << "Unable to open tensor shard " << path << ": "
+                      << std::strerror(errno);
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    int error = errno;
+    close(fd);
+    XLA_ERROR() << "Unable to stat tensor shard " << path << ": "
+                << std::strerror(error);
+  }
+  size_t size = st.st_size;
+  XLA_CHECK_GE(size, sizeof(FileHeader)) << "Invalid tensor shard " << path;
+  // The private mapping makes the returned views writable without touching the
+  // file, with the pages copied only if they are actually written.
+  void* data =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  XLA_CHECK(data != MAP_FAILED) << "Unable to map tensor shard " << path
+                                << ": " << std::strerror(errno);
+  mapping_ = std::make_shared<Mapping>(data, size);
+
+  const char* base = static_cast<const char*>(data);
+  const FileHeader* header = reinterpret_cast<const FileHeader*>(base);
+  XLA_CHECK_EQ(std::memcmp(header->magic, kMagic, sizeof(kMagic)), 0)
+      << "Invalid tensor shard " << path;
+  XLA_CHECK_LE(header->index_offset + header->num_columns * sizeof(ColumnInfo),
+               size)
+      << "Truncated tensor shard " << path;
+  num_records_ = header->num_records;
+  const ColumnInfo* index =
+      reinterpret_cast<const ColumnInfo*>(base + header->index_offset);
+  for (xla::uint64 i = 0; i < header->num_columns; ++i) {
+    XLA_CHECK_LE(index[i].rank, kMaxRank) << "Invalid tensor shard " << path;
+    Column column;
+    column.scalar_type = static_cast<at::ScalarType>(index[i].scalar_type);
+    column.record_sizes.assign(index[i].sizes, index[i].sizes + index[i].rank);
+    column.record_bytes = c10::elementSize(column.scalar_type);
+    for (auto dim_size : column.record_sizes) {
+      column.record_bytes *= dim_size;
+    }
+    column.offset = index[i].offset;
+    XLA_CHECK_LE(column.offset + num_records_ * column.record_bytes, size)
+        << "Truncated tensor shard " << path;
+    columns_.push_back(std::move(column));
+  }
+}
+
+std::vector<at::Tensor> TensorShard::GetBatch(xla::int64 start,
+                                              xla::int64 count) const {
+  XLA_CHECK_GE(start, 0);
+  XLA_CHECK_GE(count, 0);
+  XLA_CHECK_LE(start + count, num_records_) << path_;
+  XLA_COUNTER("TensorShardBatches", 1);
+  std::shared_ptr<Mapping> mapping = mapping_;
+  std::vector<at::Tensor> tensors;
+  for (auto& column : columns_) {
+    char* data = static_cast<char*>(mapping->data) + column.offset +
+                 start * column.record_bytes;
+    size_t nbytes = count * column.record_bytes;
+    // Starts the read-ahead of the whole batch, which is then going to be
+    // copied into the transfer buffers.
+    static const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+    uintptr_t page_start =
+        reinterpret_cast<uintptr_t>(data) / page_size * page_size;
+    madvise(reinterpret_cast<void*>(page_start),
+            reinterpret_cast<uintptr_t>(data) + nbytes - page_start,
+            MADV_WILLNEED);
+    std::vector<xla::int64> sizes = {count};
+    sizes.insert(sizes.end(), column.record_sizes.begin(),
+                 column.record_sizes.end());
+    tensors.push_back(at::from_blob(
+        data, sizes, [mapping](void*) {},
+        at::TensorOptions(column.scalar_type)));
+  }
+  return tensors;
+}
+
+}  // namespace torch_xla
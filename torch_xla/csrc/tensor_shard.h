@@ -0,0 +1,58 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/xla/types.h"
+#include "torch/csrc/autograd/variable.h"
+
+namespace torch_xla {
+
+// A read-only columnar dataset shard, memory mapped from a file holding a
+// fixed header, one page aligned raw blob per column, and an index describing
+// the columns. Every column stores the [num_records, ...] contiguous values of
+// one of the record tensors, so a batch of consecutive records is a slice of
+// every blob, and is returned as an at::Tensor view over the mapping. Such
+// views are uploaded by copying them straight into the device transfer
+// buffers, so reading a batch costs page cache hits, plus such single copy.
+class TensorShard {
+ public:
+  static constexpr size_t kMaxRank = 8;
+
+  // Writes the columns (which must have the same first dimension size, the
+  // number of records) into a shard file at path.
+  static void Write(const std::string& path,
+                    absl::Span<const at::Tensor> columns);
+
+  explicit TensorShard(const std::string& path);
+
+  const std::string& path() const { return path_; }
+
+  xla::int64 num_records() const { return num_records_; }
+
+  size_t num_columns() const { return columns_.size(); }
+
+  // Returns the views of the [start, start + count) records of every column.
+  // The views keep the mapping alive, and are copy-on-write, so writing them
+  // does not change the file.
+  std::vector<at::Tensor> GetBatch(xla::int64 start, xla::int64 count) const;
+
+ private:
+  struct Mapping;
+
+  struct Column {
+    at::ScalarType scalar_type;
+    std::vector<xla::int64> record_sizes;
+    size_t record_bytes = 0;
+    size_t offset = 0;
+  };
+
+  std::string path_;
+  std::shared_ptr<Mapping> mapping_;
+  xla::int64 num_records_ = 0;
+  std::vector<Column> columns_;
+};
+
+}  // namespace torch_xla
@@ -1,23 +1,35 @@
 #include "torch_xla/csrc/tensor_util.h"
 
+#include <unistd.h>
+
 #include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <cstring>
 #include <functional>
 #include <list>
+#include <mutex>
 #include <numeric>
 #include <thread>
+#include <unordered_map>
 
+#include "tensorflow/compiler/xla/layout_util.h"
 #include "tensorflow/compiler/xla/literal_util.h"
 #include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/host_memory_pool.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
 #include "tensorflow/compiler/xla/xla_client/multi_wait.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/xla/xla_client/tf_logging.h"
 #include "tensorflow/compiler/xla/xla_client/thread_pool.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/lib/bfloat16/bfloat16.h"
+#include "torch_xla/csrc/convert_kernels.h"
 #include "torch_xla/csrc/helpers.h"
 #include "torch_xla/csrc/layout_manager.h"
+#include "torch_xla/csrc/xla_sharding_util.h"
 
 namespace torch_xla {
 namespace {
@@ -243,6 +255,23 @@ void CopyData<tensorflow::bfloat16, at::BFloat16>(tensorflow::bfloat16* dest,
   CheckedMemcpy<tensorflow::bfloat16, at::BFloat16>(dest, source, n);
 }
 template <>
+void CopyData<tensorflow::bfloat16, float>(tensorflow::bfloat16* dest,
+                                           const float* source, xla::int64 n,
+                                           const CopyCasted&) {
+  kernels::ConvertFloatToBFloat16(source, dest, n);
+}
+template <>
+void CopyData<float, tensorflow::bfloat16>(float* dest,
+                                           const tensorflow::bfloat16* source,
+                                           xla::int64 n, const CopyCasted&) {
+  kernels::ConvertBFloat16ToFloat(source, dest, n);
+}
+template <>
+void CopyData<float, uint8_t>(float* dest, const uint8_t* source, xla::int64 n,
+                              const CopyDirect&) {
+  kernels::ConvertUInt8ToFloat(source, dest, n);
+}
+template <>
 void CopyData<std::complex<float>, std::complex<float>>(
     std::complex<float>* dest, const std::complex<float>* source, xla::int64 n,
     const CopyCasted&) {
@@ -287,14 +316,40 @@ struct CopyPartition {
   std::vector<xla::int64> limit;
 };
 
+xla::int64 DivUp(xla::int64 value, xla::int64 divisor) {
+  return (value + divisor - 1) / divisor;
+}
+
+// Returns the side of the square tiles used by SlicedCopy(), sized so that the
+// source and destination tiles fit together in half of the L1 data cache. The
+// XLA_COPY_TILE_SIZE environment variable can be used to force a given size.
+xla::int64 GetCopyTileSize(size_t src_element_size, size_t dest_element_size) {
+  static const xla::int64 forced_tile_size =
+      xla::sys_util::GetEnvInt("XLA_COPY_TILE_SIZE", 0);
+  static const xla::int64 l1_cache_size = []() -> xla::int64 {
+    long size = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+    return size > 0 ? size : 32 * 1024;
+  }();
+  if (forced_tile_size > 0) {
+    return forced_tile_size;
+  }
+  xla::int64 tile_elements =
+      l1_cache_size / (2 * (src_element_size + dest_element_size));
+  xla::int64 tile_size =
+      static_cast<xla::int64>(std::sqrt(static_cast<double>(tile_elements)));
+  // Keep it a multiple of 8 elements, so that the rows of the contiguous side
+  // map to whole cache lines (or SIMD vectors).
+  return std::min<xla::int64>(std::max<xla::int64>(tile_size / 8 * 8, 8), 128);
+}
+
 std::vector<CopyPartition> CreateCopyPartitions(
-    absl::Span<const xla::int64> dimensions,
-    xla::int64 strided_copy_dimension) {
+    absl::Span<const xla::int64> dimensions, xla::int64 strided_copy_dimension,
+    xla::int64 tile_size) {
   // The minimum number of elements copy that can be assigned to a thread.
   static const xla::int64 kMinThreadElements = 100000;
-  // Use at most 50% of the available cores.
+  // Use at most 50% of the cores of the process.
   xla::int64 max_parts =
-      std::max<xla::int64>(std::thread::hardware_concurrency() / 2, 1);
+      std::max<xla::int64>(xla::env::GetProcessCpus().size() / 2, 1);
   // Find the maximum dimension which is not the strided copy dimension.
   xla::int64 max_dim = -1;
   for (xla::int64 i = 0; i < dimensions.size(); ++i) {
@@ -310,35 +365,73 @@ std::vector<CopyPartition> CreateCopyPartitions(
   xla::int64 part_size =
       std::max<xla::int64>(std::max<xla::int64>(max_dim_size / max_parts, 1),
                            kMinThreadElements / max_dim_unit_elements);
+  xla::int64 max_dim_parts = DivUp(max_dim_size, part_size);
+  // If slicing the biggest dimension does not create enough partitions to keep
+  // the threads busy, slice the strided copy dimension as well, by multiples of
+  // the tile size.
+  xla::int64 strided_dim_size = dimensions[strided_copy_dimension];
+  xla::int64 strided_part_size = strided_dim_size;
+  if (max_dim_parts < max_parts) {
+    xla::int64 part_elements = part_size * max_dim_unit_elements;
+    xla::int64 strided_parts = std::min<xla::int64>(
+        {max_parts / max_dim_parts, DivUp(strided_dim_size, tile_size),
+         std::max<xla::int64>(part_elements / kMinThreadElements, 1)});
+    strided_part_size =
+        DivUp(DivUp(strided_dim_size, strided_parts), tile_size) * tile_size;
+  }
   std::vector<CopyPartition> parts;
-  xla::int64 csize = 0;
-  while (csize < max_dim_size) {
-    xla::int64 n = std::min<xla::int64>(part_size, max_dim_size - csize);
-    CopyPartition p(dimensions);
-    p.base[max_dim] = csize;
-    p.limit[max_dim] = csize + n;
-    csize += n;
-    parts.emplace_back(std::move(p));
+  for (xla::int64 csize = 0; csize < max_dim_size; csize += part_size) {
+    for (xla::int64 ssize = 0; ssize < strided_dim_size;
+         ssize += strided_part_size) {
+      CopyPartition p(dimensions);
+      p.base[max_dim] = csize;
+      p.limit[max_dim] = std::min<xla::int64>(csize + part_size, max_dim_size);
+      p.base[strided_copy_dimension] = ssize;
+      p.limit[strided_copy_dimension] =
+          std::min<xla::int64>(ssize + strided_part_size, strided_dim_size);
+      parts.emplace_back(std::move(p));
+    }
   }
   return parts;
 }
 
+// Copies the partition by tiles of the two innermost iteration dimensions.
+// When the copy is a transpose (a minor dimension for the source is a major one
+// for the destination), walking both buffers in small square blocks keeps the
+// cache lines touched by the strided side hot, instead of fetching a new line
+// for every element. This code requires rank >= 2 shapes, which CopyTensors()
+// guarantees.
 template <typename SType, typename DType>
 void SlicedCopy(absl::Span<const xla::int64> dimensions, const SType* src_data,
                 absl::Span<const xla::int64> src_strides, DType* dest_data,
                 absl::Span<const xla::int64> dest_strides,
                 absl::Span<const xla::int64> iter_dims,
-                const CopyPartition& part) {
+                xla::int64 tile_size, const CopyPartition& part) {
+  xla::int64 dim0 = iter_dims[0];
+  xla::int64 dim1 = iter_dims[1];
+  xla::int64 size0 = part.limit[dim0] - part.base[dim0];
+  xla::int64 size1 = part.limit[dim1] - part.base[dim1];
   std::vector<xla::int64> indices(part.base);
-  xla::int64 inner_src_stride = src_strides[iter_dims.front()];
-  xla::int64 inner_dest_stride = dest_strides[iter_dims.front()];
   xla::int64 n = 0;
   while (n < indices.size()) {
-    StridedCopy(dest_data + GetFlatTensorOffset(dest_strides, indices),
-                inner_dest_stride,
-                src_data + GetFlatTensorOffset(src_strides, indices),
-                inner_src_stride, dimensions[iter_dims.front()]);
-    for (n = 1; n < indices.size(); ++n) {
+    const SType* src_base =
+        src_data + GetFlatTensorOffset(src_strides, indices);
+    DType* dest_base = dest_data + GetFlatTensorOffset(dest_strides, indices);
+    for (xla::int64 i1 = 0; i1 < size1; i1 += tile_size) {
+      xla::int64 end1 = std::min(i1 + tile_size, size1);
+      for (xla::int64 i0 = 0; i0 < size0; i0 += tile_size) {
+        xla::int64 count = std::min(tile_size, size0 - i0);
+        for (xla::int64 j1 = i1; j1 < end1; ++j1) {
+          xla::int64 dest_offset =
+              j1 * dest_strides[dim1] + i0 * dest_strides[dim0];
+          xla::int64 src_offset =
+              j1 * src_strides[dim1] + i0 * src_strides[dim0];
+          StridedCopy(dest_base + dest_offset, dest_strides[dim0],
+                      src_base + src_offset, src_strides[dim0], count);
+        }
+      }
+    }
+    for (n = 2; n < indices.size(); ++n) {
       xla::int64 dim = iter_dims[n];
       indices[dim] += 1;
       if (indices[dim] < part.limit[dim]) {
@@ -349,6 +442,30 @@ void SlicedCopy(absl::Span<const xla::int64> dimensions, const SType* src_data,
   }
 }
 
+// Copies a source with arbitrary strides into the destination buffer, by
+// slicing the bigger dimension and assigning its copy to different threads.
+// This code is only valid for ranks >= 2.
+template <typename SType, typename DType>
+void ParallelSlicedCopy(const SType* src_data,
+                        absl::Span<const xla::int64> src_strides,
+                        DType* dest_data, const xla::Shape& dest_shape) {
+  std::vector<xla::int64> dest_strides = ComputeShapeStrides(dest_shape);
+  std::vector<xla::int64> iter_dims = GetIterationDimensions(dest_shape);
+  xla::int64 tile_size = GetCopyTileSize(sizeof(SType), sizeof(DType));
+  std::vector<CopyPartition> parts = CreateCopyPartitions(
+      dest_shape.dimensions(), iter_dims.front(), tile_size);
+  xla::util::MultiWait mwait(parts.size());
+  for (size_t i = 0; i < parts.size(); ++i) {
+    auto copy_fn = [&, i]() {
+      SlicedCopy<SType, DType>(dest_shape.dimensions(), src_data, src_strides,
+                               dest_data, dest_strides, iter_dims, tile_size,
+                               parts[i]);
+    };
+    xla::env::ScheduleClosure(mwait.Completer(std::move(copy_fn)));
+  }
+  mwait.Wait();
+}
+
 template <typename SType, typename DType>
 void CopyTensors(const void* src_buffer, const xla::Shape& src_shape,
                  void* dest_buffer, size_t dest_buffer_size,
@@ -367,30 +484,48 @@ void CopyTensors(const void* src_buffer, const xla::Shape& src_shape,
                            typename CopyType < NeedCast<SType>::value ||
                                NeedCast<DType>::value > ::type());
   } else if (total_elements > 0) {
-    // We issue a multi-threaded copy by slicing the bigger dimension and
-    // assigning its copy to different threads. This code is only valid for
-    // ranks >= 2, but the layout check above covers the case.
-    std::vector<xla::int64> src_strides = ComputeShapeStrides(src_shape);
-    std::vector<xla::int64> dest_strides = ComputeShapeStrides(dest_shape);
-    std::vector<xla::int64> iter_dims = GetIterationDimensions(dest_shape);
-    std::vector<CopyPartition> parts =
-        CreateCopyPartitions(dest_shape.dimensions(), iter_dims.front());
-    xla::util::MultiWait mwait(parts.size());
-    for (size_t i = 0; i < parts.size(); ++i) {
-      auto copy_fn = [&, i]() {
-        SlicedCopy<SType, DType>(dest_shape.dimensions(), src_data, src_strides,
-                                 dest_data, dest_strides, iter_dims, parts[i]);
-      };
-      xla::env::ScheduleClosure(mwait.Completer(std::move(copy_fn)));
-    }
-    mwait.Wait();
+    // Different layouts imply ranks >= 2, as ParallelSlicedCopy() requires.
+    ParallelSlicedCopy<SType, DType>(
+        src_data, ComputeShapeStrides(src_shape), dest_data, dest_shape);
   }
 }
 
+// Copies a non contiguous tensor straight from its strides into the
+// destination buffer, without creating a contiguous copy first. Complex types
+// are excluded, as their casting StridedCopy() drops the imaginary part.
+template <typename SType, typename DType>
+bool MaybeStridedTensorToBuffer(const at::Tensor& tensor,
+                                const xla::Shape& dest_shape,
+                                void* dest_buffer, size_t dest_buffer_size) {
+  if (tensor.is_contiguous() || tensor.dim() == 0 || tensor.numel() == 0 ||
+      at::isComplexType(tensor.scalar_type())) {
+    return false;
+  }
+  std::vector<xla::int64> sizes = XlaHelpers::I64List(tensor.sizes());
+  XLA_CHECK(dest_shape.dimensions() == absl::Span<const xla::int64>(sizes))
+      << dest_shape;
+  XLA_CHECK_EQ(dest_buffer_size, tensor.numel() * sizeof(DType));
+  XLA_COUNTER("StridedTensorToBuffer", 1);
+  const SType* src_data = tensor.data_ptr<SType>();
+  DType* dest_data = reinterpret_cast<DType*>(dest_buffer);
+  if (tensor.dim() == 1) {
+    StridedCopy(dest_data, 1, src_data, tensor.stride(0), tensor.numel());
+  } else {
+    ParallelSlicedCopy<SType, DType>(
+        src_data, XlaHelpers::I64List(tensor.strides()), dest_data,
+        dest_shape);
+  }
+  return true;
+}
+
 template <typename SType, typename DType>
 void TensorToBuffer(const at::Tensor& tensor, const xla::Shape& dest_shape,
                     void* dest_buffer, size_t dest_buffer_size,
                     const Device& device) {
+  if (MaybeStridedTensorToBuffer<SType, DType>(tensor, dest_shape, dest_buffer,
+                                               dest_buffer_size)) {
+    return;
+  }
   at::Tensor contiguous_tensor = tensor.contiguous();
   xla::Shape src_shape = MakeTorchTensorLayout(
       XlaHelpers::I64List(contiguous_tensor.sizes()), /*dynamic_dimensions=*/{},
@@ -469,6 +604,8 @@ void TensorToBufferSType(const at::Tensor& tensor, const xla::Shape& dest_shape,
   }
 }
 
+}  // namespace
+
 void PopulateTensorBuffer(const at::Tensor& tensor,
                           const xla::Shape& dest_shape, void* dest_buffer,
                           size_t dest_buffer_size, const Device& device) {
@@ -526,6 +663,31 @@ void PopulateTensorBuffer(const at::Tensor& tensor,
   }
 }
 
+namespace {
+
+// If the tensor memory can be used as is by the device (no type conversion and
+// same layout), lends it to the transfer source, avoiding the host copy.
+void MaybeLendTensorData(const at::Tensor& tensor,
+                         xla::ComputationClient::TensorSource* source) {
+  static const bool lend_data =
+      xla::sys_util::GetEnvBool("XLA_ZERO_COPY_TRANSFER", true);
+  if (!lend_data || !tensor.is_contiguous() ||
+      TensorTypeToRawXlaType(tensor.type().scalarType()) !=
+          source->shape.element_type() ||
+      !xla::LayoutUtil::IsMonotonicWithDim0Major(source->shape.layout())) {
+    return;
+  }
+  const void* data = tensor.data_ptr();
+  if (reinterpret_cast<uintptr_t>(data) %
+          tensorflow::Allocator::kAllocatorAlignment !=
+      0) {
+    return;
+  }
+  source->data = data;
+  source->data_size = tensor.numel() * tensor.element_size();
+  source->data_owner = std::make_shared<at::Tensor>(tensor);
+}
+
 xla::ComputationClient::DataPtr TensorToXlaData(const at::Tensor& tensor,
                                                 const xla::Shape& shape,
                                                 const Device& device) {
@@ -538,6 +700,7 @@ xla::ComputationClient::DataPtr TensorToXlaData(const at::Tensor& tensor,
 
   std::vector<xla::ComputationClient::TensorSource> source_tensors;
   source_tensors.emplace_back(shape, device.ToString(), std::move(populate_fn));
+  MaybeLendTensorData(tensor, &source_tensors.back());
 
   auto handles =
       xla::ComputationClient::Get()->TransferToServer(source_tensors);
@@ -545,6 +708,24 @@ xla::ComputationClient::DataPtr TensorToXlaData(const at::Tensor& tensor,
   return std::move(handles.front());
 }
 
+// Allocates the CPU tensor receiving the data of a device tensor. With
+// XLA_HOST_POOL_DOWNLOADS the tensor memory comes from the host memory pool,
+// and goes back to it once the tensor is released. Such tensors cannot be
+// resized, which is why the pool is not used by default.
+at::Tensor EmptyHostTensor(const std::vector<int64_t>& dimensions,
+                           at::ScalarType atype, size_t num_bytes) {
+  static const bool use_pool =
+      xla::sys_util::GetEnvBool("XLA_HOST_POOL_DOWNLOADS", false);
+  if (!use_pool || num_bytes == 0) {
+    return at::empty(dimensions, at::TensorOptions(atype));
+  }
+  xla::util::HostMemoryPool* pool = xla::util::HostMemoryPool::Get();
+  void* data = pool->Allocate(/*alignment=*/64, num_bytes);
+  return at::from_blob(
+      data, dimensions, [pool](void* ptr) { pool->Free(ptr); },
+      at::TensorOptions(atype));
+}
+
 template <typename SType, typename DType>
 at::Tensor XlaLiteralToTensor(const xla::Literal& literal,
                               at::ScalarType atype) {
@@ -556,7 +737,8 @@ at::Tensor XlaLiteralToTensor(const xla::Literal& literal,
   xla::int64 total_elements = xla::ShapeUtil::ElementsIn(torch_shape);
 
   const auto literal_data = literal.data<SType>();
-  at::Tensor tensor = at::empty(dimensions, at::TensorOptions(atype));
+  at::Tensor tensor = EmptyHostTensor(dimensions, atype,
+                                      total_elements * sizeof(DType));
   CopyTensors<SType, DType>(literal_data.data(), literal.shape(),
                             tensor.data_ptr<DType>(),
                             total_elements * sizeof(DType), torch_shape);
@@ -599,6 +781,96 @@ at::Tensor XlaLiteralToTensorHelper(const xla::Literal& literal,
   }
 }
 
+size_t GetTensorBytes(const at::Tensor& tensor) {
+  return tensor.defined() ? tensor.numel() * tensor.element_size() : 0;
+}
+
+// Tracks the placeholders created by CreateDeferredTensorData(), together with
+// the tensors holding their content. The same placeholder can be reached by
+// many computations (for example via the scalar device data cache), and the
+// lock is held across the transfer, so that all of them observe a value once
+// the Materialize() call returns.
+class DeferredTensorsRegistry {
+ public:
+  static DeferredTensorsRegistry* Get() {
+    static DeferredTensorsRegistry* registry = new DeferredTensorsRegistry();
+    return registry;
+  }
+
+  void Register(const xla::ComputationClient::DataPtr& data,
+                const at::Tensor& tensor) {
+    std::lock_guard<std::mutex> lock(lock_);
+    PendingTensor& pending = pending_[data.get()];
+    pending_bytes_ -= GetTensorBytes(pending.tensor);
+    pending = {data, tensor};
+    pending_bytes_ += GetTensorBytes(tensor);
+    if (pending_.size() >= purge_size_) {
+      PurgeExpired();
+    }
+  }
+
+  // The host memory held by the pending tensors. Read without the lock, as it
+  // is only used as an estimate.
+  size_t GetPendingBytes() const { return pending_bytes_; }
+
+  void Materialize(absl::Span<const xla::ComputationClient::DataPtr> datas) {
+    std::lock_guard<std::mutex> lock(lock_);
+    if (pending_.empty()) {
+      return;
+    }
+    std::vector<xla::ComputationClient::DataPtr> placeholders;
+    std::vector<at::Tensor> tensors;
+    std::vector<std::string> devices;
+    for (auto& data : datas) {
+      if (data->HasValue()) {
+        continue;
+      }
+      auto it = pending_.find(data.get());
+      if (it != pending_.end() && it->second.data.lock() == data) {
+        placeholders.push_back(data);
+        tensors.push_back(it->second.tensor);
+        devices.push_back(data->device());
+        pending_bytes_ -= GetTensorBytes(it->second.tensor);
+        pending_.erase(it);
+      }
+    }
+    if (!placeholders.empty()) {
+      XLA_VALUE_METRIC("DeferredTensorsDataBatch", placeholders.size());
+      std::vector<xla::ComputationClient::DataPtr> handles =
+          CreateTensorsData(tensors, devices);
+      for (size_t i = 0; i < placeholders.size(); ++i) {
+        placeholders[i]->Assign(*handles[i]);
+      }
+    }
+  }
+
+ private:
+  struct PendingTensor {
+    std::weak_ptr<xla::ComputationClient::Data> data;
+    at::Tensor tensor;
+  };
+
+  // Placeholders which never made it into a computation are dropped here. The
+  // purge size doubles with the live entries, to keep the purge cost amortized.
+  void PurgeExpired() {
+    for (auto it = pending_.begin(); it != pending_.end();) {
+      if (it->second.data.expired()) {
+        pending_bytes_ -= GetTensorBytes(it->second.tensor);
+        it = pending_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    purge_size_ = std::max<size_t>(2 * pending_.size(), 256);
+  }
+
+  std::mutex lock_;
+  std::unordered_map<const xla::ComputationClient::Data*, PendingTensor>
+      pending_;
+  size_t purge_size_ = 256;
+  std::atomic<size_t> pending_bytes_{0};
+};
+
 }  // namespace
 
 std::vector<xla::int64> ComputeShapeStrides(const xla::Shape& shape) {
@@ -696,10 +968,30 @@ std::vector<xla::ComputationClient::DataPtr> CreateTensorsData(
         };
     source_tensors.emplace_back(std::move(shape), devices[i],
                                 std::move(populate_fn));
+    MaybeLendTensorData(tensors[i], &source_tensors.back());
   }
   return xla::ComputationClient::Get()->TransferToServer(source_tensors);
 }
 
+xla::ComputationClient::DataPtr CreateDeferredTensorData(
+    const at::Tensor& tensor, const Device& device) {
+  DeferredTensorsRegistry* registry = DeferredTensorsRegistry::Get();
+  xla::ComputationClient::DataPtr data =
+      xla::ComputationClient::Get()->CreateDataPlaceholder(
+          device.ToString(), CreateComputationShapeFromTensor(tensor, &device));
+  registry->Register(data, tensor);
+  return data;
+}
+
+void MaterializeDeferredTensorsData(
+    absl::Span<const xla::ComputationClient::DataPtr> datas) {
+  DeferredTensorsRegistry::Get()->Materialize(datas);
+}
+
+size_t GetDeferredTensorsBytes() {
+  return DeferredTensorsRegistry::Get()->GetPendingBytes();
+}
+
 xla::Literal GetTensorLiteral(const at::Tensor& tensor, const xla::Shape* shape,
                               const Device* device) {
   Device xla_device = GetDeviceOrCurrent(device);
@@ -720,12 +1012,39 @@ xla::Literal GetTensorLiteral(const at::Tensor& tensor, const xla::Shape* shape,
 std::vector<at::Tensor> XlaDataToTensors(
     absl::Span<const xla::ComputationClient::DataPtr> xla_data,
     at::ScalarType dest_element_type) {
-  std::vector<xla::Literal> literals =
-      xla::ComputationClient::Get()->TransferFromServer(xla_data);
-  std::vector<at::Tensor> tensors;
-  tensors.reserve(literals.size());
-  for (auto& literal : literals) {
-    tensors.push_back(MakeTensorFromXlaLiteral(literal, dest_element_type));
+  std::vector<at::ScalarType> dest_element_types(xla_data.size(),
+                                                 dest_element_type);
+  return XlaDataToTensors(xla_data, dest_element_types);
+}
+
+std::vector<at::Tensor> XlaDataToTensors(
+    absl::Span<const xla::ComputationClient::DataPtr> xla_data,
+    absl::Span<const at::ScalarType> dest_element_types) {
+  XLA_CHECK_EQ(xla_data.size(), dest_element_types.size());
+  // The sharded data is fetched shard by shard, and stitched on the host.
+  std::vector<at::Tensor> tensors(xla_data.size());
+  std::vector<xla::ComputationClient::DataPtr> unsharded_data;
+  std::vector<size_t> unsharded_indices;
+  for (size_t i = 0; i < xla_data.size(); ++i) {
+    ShardedData* sharded_data = ShardingUtil::GetShardedData(xla_data[i]);
+    if (sharded_data != nullptr) {
+      tensors[i] = ShardingUtil::ShardedDataToTensor(*sharded_data,
+                                                     dest_element_types[i]);
+    } else {
+      unsharded_data.push_back(xla_data[i]);
+      unsharded_indices.push_back(i);
+    }
+  }
+  // The conversion of every literal starts as soon as its value lands from the
+  // server, instead of waiting for all of them.
+  auto literal_fn = [&](size_t index, xla::Literal literal) {
+    size_t tensor_index = unsharded_indices[index];
+    tensors[tensor_index] =
+        MakeTensorFromXlaLiteral(literal, dest_element_types[tensor_index]);
+  };
+  if (!unsharded_data.empty()) {
+    xla::ComputationClient::Get()->TransferFromServer(unsharded_data,
+                                                      literal_fn);
   }
   return tensors;
 }
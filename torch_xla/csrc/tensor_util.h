@@ -25,8 +25,20 @@ std::vector<at::Tensor> XlaDataToTensors(
     absl::Span<const xla::ComputationClient::DataPtr> xla_data,
     at::ScalarType dest_element_type);
 
+// Same as above, with a different element type for every data. Literals are
+// converted as they are fetched from the device.
+std::vector<at::Tensor> XlaDataToTensors(
+    absl::Span<const xla::ComputationClient::DataPtr> xla_data,
+    absl::Span<const at::ScalarType> dest_element_types);
+
 bool TensorCompare(const at::Tensor& t1, const at::Tensor& t2);
 
+// Writes the tensor data into dest_buffer, in the type and layout of
+// dest_shape, converting the elements if needed.
+void PopulateTensorBuffer(const at::Tensor& tensor,
+                          const xla::Shape& dest_shape, void* dest_buffer,
+                          size_t dest_buffer_size, const Device& device);
+
 // Uploads an ATEN tensor data to the device and fetches the corresponding
 // device data handle.
 xla::ComputationClient::DataPtr TensorToXlaData(const at::Tensor& tensor,
@@ -40,6 +52,21 @@ std::vector<xla::ComputationClient::DataPtr> CreateTensorsData(
     const std::vector<at::Tensor>& tensors,
     const std::vector<std::string>& devices);
 
+// Creates a placeholder device data for the tensor, whose content is uploaded
+// by a later MaterializeDeferredTensorsData() call. This allows many small
+// uploads (like the scalars of a step) to be issued with a single transfer.
+xla::ComputationClient::DataPtr CreateDeferredTensorData(
+    const at::Tensor& tensor, const Device& device);
+
+// Uploads, with a single TransferToServer() call, the content of all the
+// deferred device data within the input which do not have a value yet.
+void MaterializeDeferredTensorsData(
+    absl::Span<const xla::ComputationClient::DataPtr> datas);
+
+// Returns the host memory held by the tensors of the deferred device data not
+// yet uploaded.
+size_t GetDeferredTensorsBytes();
+
 // Creates an XLA literal out of an ATEN tensor. If shape is specified, that
 // shape+layout will be used, otherwise one will be generated out of the ATEN
 // tensor shape. The device argument (can be nullptr for the default device)
@@ -8,24 +8,21 @@
 namespace torch_xla {
 namespace {
 
+// Returns the first element of the input, as a tensor of the same rank with
+// all dimensions of size one.
+xla::XlaOp SliceFirstElement(xla::XlaOp input, const xla::Shape& input_shape) {
+  xla::int64 input_rank = input_shape.rank();
+  return xla::Slice(input, std::vector<xla::int64>(input_rank, 0),
+                    std::vector<xla::int64>(input_rank, 1),
+                    std::vector<xla::int64>(input_rank, 1));
+}
+
 xla::XlaOp SliceOneToken(xla::XlaOp input) {
   const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
-  xla::int64 input_rank = input_shape.rank();
-  if (input_rank > 0) {
-    xla::GatherDimensionNumbers dim_numbers;
-    for (xla::int64 i = 0; i < input_rank; ++i) {
-      dim_numbers.add_collapsed_slice_dims(i);
-      dim_numbers.add_start_index_map(i);
-    }
-    dim_numbers.set_index_vector_dim(0);
-
-    std::vector<xla::int64> slice_sizes(input_rank, 1);
-    xla::XlaOp indices = xla::Zeros(
-        input.builder(),
-        xla::ShapeUtil::MakeShape(xla::PrimitiveType::S32, {input_rank}));
-    input = xla::Gather(input, indices, dim_numbers, slice_sizes);
+  if (input_shape.rank() == 0) {
+    return input;
   }
-  return input;
+  return xla::Reshape(SliceFirstElement(input, input_shape), {});
 }
 
 }  // namespace
@@ -36,7 +33,20 @@ xla::XlaOp TokenHandler::GetInput(xla::XlaOp input,
     input_shape = &XlaHelpers::ShapeOfXlaOp(input);
   }
   // Token is always a numeric zero, so adding to input does not change input.
-  return input + MaybeConvertTo(token_, input_shape->element_type());
+  xla::XlaOp token = MaybeConvertTo(token_, input_shape->element_type());
+  if (input_shape->rank() == 0 ||
+      xla::ShapeUtil::ElementsIn(*input_shape) == 0) {
+    return input + token;
+  }
+  // Only the first element of the input carries the dependency on the token,
+  // so the collective gets ordered after the previous one without an extra
+  // elementwise pass over the whole input, as the update of a single element
+  // is done in place when the input buffer is not used by anyone else.
+  std::vector<xla::XlaOp> start_indices(
+      input_shape->rank(),
+      xla::Zero(input.builder(), xla::PrimitiveType::S32));
+  return xla::DynamicUpdateSlice(
+      input, SliceFirstElement(input, *input_shape) + token, start_indices);
 }
 
 xla::XlaOp TokenHandler::GetNewToken(xla::XlaOp result) {
@@ -7,10 +7,13 @@
 #include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/util.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
 #include "torch_xla/csrc/helpers.h"
 #include "torch_xla/csrc/ops/as_strided.h"
 #include "torch_xla/csrc/ops/as_strided_view_update.h"
+#include "torch_xla/csrc/ops/cat.h"
 #include "torch_xla/csrc/ops/diagonal.h"
 #include "torch_xla/csrc/ops/diagonal_view_update.h"
 #include "torch_xla/csrc/ops/generic_slice.h"
@@ -121,6 +124,98 @@ ir::Value ApplyUpdate(ir::Value ir_value,
   return result;
 }
 
+// The box of the alias IR value written by an update, whose view path is made
+// of slices followed by reshapes and permutes (which do not change the set of
+// written elements). The value is the update value brought back to the box
+// shape.
+struct UpdateRegion {
+  std::vector<xla::int64> indices;
+  std::vector<xla::int64> sizes;
+  ir::Value value;
+};
+
+absl::optional<UpdateRegion> GetUpdateRegion(
+    const Alias::UpdateData& update_data, const xla::Shape& base_shape) {
+  UpdateRegion region;
+  region.indices.assign(base_shape.rank(), 0);
+  region.sizes = xla::util::ToVector<xla::int64>(base_shape.dimensions());
+  const std::vector<ViewInfo>& view_infos = update_data.view_infos;
+  size_t slices_end = 0;
+  for (; slices_end < view_infos.size(); ++slices_end) {
+    const ViewInfo& view_info = view_infos[slices_end];
+    if (view_info.view_type == ViewInfo::Type::kNarrow) {
+      for (size_t dim = 0; dim < region.indices.size(); ++dim) {
+        region.indices[dim] += view_info.indices[dim];
+        region.sizes[dim] = view_info.shape.dimensions(dim);
+      }
+    } else if (view_info.view_type == ViewInfo::Type::kSelect &&
+               view_info.select->stride == 1) {
+      xla::int64 dim = view_info.select->dim;
+      region.indices[dim] += view_info.select->start;
+      region.sizes[dim] = view_info.shape.dimensions(dim);
+    } else if (view_info.view_type != ViewInfo::Type::kNoOp) {
+      break;
+    }
+  }
+  for (size_t i = slices_end; i < view_infos.size(); ++i) {
+    ViewInfo::Type view_type = view_infos[i].view_type;
+    if (view_type != ViewInfo::Type::kReshape &&
+        view_type != ViewInfo::Type::kPermute &&
+        view_type != ViewInfo::Type::kNoOp) {
+      return absl::nullopt;
+    }
+  }
+  region.value = update_data.ir_value;
+  for (size_t i = view_infos.size(); i > slices_end; --i) {
+    const ViewInfo& view_info = view_infos[i - 1];
+    if (view_info.view_type == ViewInfo::Type::kPermute) {
+      region.value = ir::MakeNode<ir::ops::Permute>(
+          region.value, xla::InversePermutation(view_info.permutation));
+    } else if (view_info.view_type == ViewInfo::Type::kReshape) {
+      region.value = ir::MakeNode<ir::ops::View>(
+          region.value, xla::util::ToVector<xla::int64>(
+                            view_info.source_shape.dimensions()));
+    }
+  }
+  return region;
+}
+
+bool RegionContains(const UpdateRegion& outer, const UpdateRegion& inner) {
+  for (size_t dim = 0; dim < outer.indices.size(); ++dim) {
+    if (inner.indices[dim] < outer.indices[dim] ||
+        inner.indices[dim] + inner.sizes[dim] >
+            outer.indices[dim] + outer.sizes[dim]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Returns the dimension along which the next region extends the current one,
+// without overlapping it, or -1 if the two do not form a bigger box.
+xla::int64 GetAdjacentDimension(const UpdateRegion& region,
+                                const UpdateRegion& next) {
+  xla::int64 adjacent_dim = -1;
+  for (size_t dim = 0; dim < region.indices.size(); ++dim) {
+    if (next.indices[dim] == region.indices[dim] &&
+        next.sizes[dim] == region.sizes[dim]) {
+      continue;
+    }
+    if (adjacent_dim >= 0 ||
+        next.indices[dim] != region.indices[dim] + region.sizes[dim]) {
+      return -1;
+    }
+    adjacent_dim = dim;
+  }
+  return adjacent_dim;
+}
+
+bool IsCoalescingEnabled() {
+  static const bool enabled =
+      xla::sys_util::GetEnvBool("XLA_COALESCE_VIEW_UPDATES", true);
+  return enabled;
+}
+
 }  // namespace
 
 ViewInfo::ViewInfo(Type view_type, xla::Shape shape, xla::Shape source_shape)
@@ -177,13 +272,81 @@ void Alias::Update(ir::Value ir_value, std::vector<ViewInfo> view_infos) {
 }
 
 ir::Value Alias::SyncUpdateOperations() {
-  for (auto& update_data : updates_) {
-    ir_value_ = ApplyUpdate(ir_value_, update_data);
+  if (updates_.size() > 1 && IsCoalescingEnabled()) {
+    CoalesceUpdateOperations();
+  } else {
+    for (auto& update_data : updates_) {
+      ir_value_ = ApplyUpdate(ir_value_, update_data);
+    }
   }
   updates_.clear();
   return ir_value_;
 }
 
+void Alias::CoalesceUpdateOperations() {
+  std::vector<absl::optional<UpdateRegion>> regions;
+  regions.reserve(updates_.size());
+  for (auto& update_data : updates_) {
+    regions.push_back(GetUpdateRegion(update_data, ir_value_.shape()));
+  }
+  // The values of the pending updates cannot depend on each other (reading a
+  // view syncs the updates), so an update whose region is entirely rewritten
+  // by a later one has no effect.
+  std::vector<bool> overwritten(updates_.size(), false);
+  size_t num_overwritten = 0;
+  for (size_t i = 0; i < updates_.size(); ++i) {
+    for (size_t j = i + 1; j < updates_.size() && !overwritten[i]; ++j) {
+      overwritten[i] = updates_[j].view_infos == updates_[i].view_infos ||
+                       (regions[i] && regions[j] &&
+                        RegionContains(*regions[j], *regions[i]));
+    }
+    num_overwritten += overwritten[i] ? 1 : 0;
+  }
+  XLA_COUNTER("ViewUpdatesOverwritten", num_overwritten);
+
+  // Runs of consecutive updates whose regions are adjacent along the same
+  // dimension are concatenated and written with a single slice update.
+  size_t i = 0;
+  while (i < updates_.size()) {
+    if (overwritten[i]) {
+      ++i;
+      continue;
+    }
+    std::vector<ir::Value> values;
+    xla::int64 run_dim = -1;
+    size_t next = i + 1;
+    if (regions[i]) {
+      UpdateRegion run = *regions[i];
+      values.push_back(run.value);
+      for (; next < updates_.size(); ++next) {
+        if (overwritten[next]) {
+          continue;
+        }
+        if (!regions[next]) {
+          break;
+        }
+        xla::int64 dim = GetAdjacentDimension(run, *regions[next]);
+        if (dim < 0 || (run_dim >= 0 && dim != run_dim)) {
+          break;
+        }
+        run_dim = dim;
+        run.sizes[dim] += regions[next]->sizes[dim];
+        values.push_back(regions[next]->value);
+      }
+    }
+    if (values.size() > 1) {
+      XLA_COUNTER("ViewUpdatesCoalesced", values.size());
+      ir_value_ = ir::MakeNode<ir::ops::UpdateSlice>(
+          ir_value_, ir::MakeNode<ir::ops::Cat>(values, run_dim),
+          regions[i]->indices);
+    } else {
+      ir_value_ = ApplyUpdate(ir_value_, updates_[i]);
+      next = i + 1;
+    }
+    i = next;
+  }
+}
+
 View::View(xla::Shape shape, std::shared_ptr<Alias> alias, ViewInfo view_info)
     : shape_(std::move(shape)), alias_(std::move(alias)) {
   view_infos_.push_back(std::move(view_info));
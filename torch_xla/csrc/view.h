@@ -112,9 +112,15 @@ class Alias {
   // the alias's ir_value to the update ir_value.
   void Update(ir::Value ir_value, std::vector<ViewInfo> view_infos);
 
+  // Applies the pending updates to the IR value. Unless the
+  // XLA_COALESCE_VIEW_UPDATES environment variable is set to false, updates
+  // entirely overwritten by later ones are dropped, and runs of updates of
+  // adjacent slices are written with a single slice update.
   ir::Value SyncUpdateOperations();
 
  private:
+  void CoalesceUpdateOperations();
+
   // The IR value which is the root at which the view was created.
   ir::Value ir_value_;
   // The stacked updates on the view. Orders matter, as most recent updates
@@ -1,6 +1,7 @@
 #include "torch_xla/csrc/xla_lower_util.h"
 
 #include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "tensorflow/compiler/xla/client/lib/arithmetic.h"
@@ -11,6 +12,7 @@
 #include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/util.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
 #include "torch_xla/csrc/convert_ops.h"
 #include "torch_xla/csrc/data_ops.h"
@@ -62,9 +64,9 @@ xla::XlaOp GetPromotedR1Mask(xla::XlaOp mask, const xla::Shape& input_shape) {
 
 bool ShouldUseDenseScatter(const Device& device, const xla::Shape& input_shape,
                            const xla::Shape& index_shape) {
-  static int dense_scatter_factor =
-      xla::sys_util::GetEnvInt("XLA_DENSE_SCATTER_FACTOR", 100);
-  if (device.hw_type == DeviceType::TPU) {
+  xla::int64 dense_scatter_factor =
+      GetSparseLoweringCosts(&device).dense_scatter_factor;
+  if (dense_scatter_factor > 0) {
     xla::int64 input_elements = xla::ShapeUtil::ElementsIn(input_shape);
     xla::int64 index_elements = xla::ShapeUtil::ElementsIn(index_shape);
     return index_elements * dense_scatter_factor >= input_elements;
@@ -72,6 +74,14 @@ bool ShouldUseDenseScatter(const Device& device, const xla::Shape& input_shape,
   return false;
 }
 
+bool ShouldUseSortedScatter(const Device& device,
+                            const xla::Shape& index_shape) {
+  xla::int64 min_indices =
+      GetSparseLoweringCosts(&device).sorted_scatter_min_indices;
+  return min_indices > 0 && index_shape.rank() == 1 &&
+         index_shape.dimensions(0) >= min_indices;
+}
+
 xla::XlaOp DotExpand(xla::XlaOp op, const xla::Shape& op_shape,
                      const xla::Shape& to_shape) {
   xla::int64 rank_delta = to_shape.rank() - op_shape.rank();
@@ -282,6 +292,117 @@ std::vector<xla::XlaOp> BuildConditionIndices(xla::XlaOp condition) {
   return {result_padded, cmd.length};
 }
 
+// Selections of k elements out of a dimension spanning at least two blocks,
+// with k at most 1/kTopKMinBlockRatio of the block size, sort the blocks
+// independently and then only the top-k candidates of each block, instead of
+// the whole dimension. A zero block size disables it.
+xla::int64 GetTopKBlockSize(const Device& device) {
+  static const xla::int64 block_size =
+      xla::sys_util::GetEnvInt("XLA_TOPK_BLOCK_SIZE", -1);
+  if (block_size >= 0) {
+    return block_size;
+  }
+  switch (device.hw_type) {
+    case DeviceType::TPU:
+      // The TPU sorts are bitonic networks, whose depth grows with the
+      // square of the log of the sorted size.
+      return 512;
+    default:
+      return 1024;
+  }
+}
+
+bool UseBlockTopK(const Device& device, xla::int64 k, xla::int64 dim_size) {
+  static const xla::int64 kTopKMinBlockRatio = 8;
+  xla::int64 block_size = GetTopKBlockSize(device);
+  return block_size > 0 && dim_size >= 2 * block_size &&
+         k * kTopKMinBlockRatio <= block_size;
+}
+
+std::vector<xla::int64> SliceLimits(const xla::Shape& shape, xla::int64 dim,
+                                    xla::int64 size) {
+  std::vector<xla::int64> limit_indices(shape.dimensions().begin(),
+                                        shape.dimensions().end());
+  limit_indices[dim] = size;
+  return limit_indices;
+}
+
+// Sorts values and indices along dim, and returns their first k elements.
+std::vector<xla::XlaOp> SortAndSlice(xla::XlaOp values, xla::XlaOp indices,
+                                     xla::int64 k, xla::int64 dim,
+                                     bool largest, bool is_stable) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(values);
+  std::vector<xla::PrimitiveType> types = {shape.element_type(),
+                                           xla::PrimitiveType::S32};
+  xla::XlaComputation comparator =
+      largest ? xla::CreateScalarGtComputation(types, values.builder())
+              : xla::CreateScalarLtComputation(types, values.builder());
+  xla::XlaOp sort_result =
+      xla::Sort({values, indices}, comparator, dim, is_stable);
+
+  std::vector<xla::int64> start_indices(shape.rank(), 0);
+  std::vector<xla::int64> limit_indices = SliceLimits(shape, dim, k);
+  std::vector<xla::int64> strides(shape.rank(), 1);
+  return {xla::Slice(xla::GetTupleElement(sort_result, 0), start_indices,
+                     limit_indices, strides),
+          xla::Slice(xla::GetTupleElement(sort_result, 1), start_indices,
+                     limit_indices, strides)};
+}
+
+// Splits dim in blocks of block_size elements, sorts every block, and merges
+// the top-k candidates of all the blocks with a second sort. The dimension is
+// padded to a multiple of block_size with the value ranking last, and the
+// sorts are stable, so the padding never wins over a real element.
+std::vector<xla::XlaOp> BuildBlockTopK(xla::XlaOp input, xla::XlaOp iota,
+                                       xla::int64 k, xla::int64 dim,
+                                       bool largest, xla::int64 block_size) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(input);
+  xla::int64 dim_size = shape.dimensions(dim);
+  xla::int64 num_blocks = xla::CeilOfRatio(dim_size, block_size);
+  if (num_blocks * block_size > dim_size) {
+    std::vector<xla::int64> padded_sizes =
+        SliceLimits(shape, dim, num_blocks * block_size);
+    xla::XlaOp pad_value =
+        largest ? xla::MinValue(input.builder(), shape.element_type())
+                : xla::MaxValue(input.builder(), shape.element_type());
+    input = PadToSize(input, padded_sizes, pad_value);
+    iota = PadToSize(iota, padded_sizes,
+                     xla::ConstantR0<xla::int32>(iota.builder(), dim_size));
+  }
+  std::vector<xla::int64> block_sizes(shape.dimensions().begin(),
+                                      shape.dimensions().end());
+  block_sizes[dim] = block_size;
+  block_sizes.insert(block_sizes.begin() + dim, num_blocks);
+  std::vector<xla::XlaOp> block_top =
+      SortAndSlice(XlaHelpers::DynamicReshape(input, block_sizes),
+                   XlaHelpers::DynamicReshape(iota, block_sizes), k, dim + 1,
+                   largest, /*is_stable=*/true);
+
+  std::vector<xla::int64> candidate_sizes =
+      SliceLimits(shape, dim, num_blocks * k);
+  return SortAndSlice(
+      XlaHelpers::DynamicReshape(block_top[0], candidate_sizes),
+      XlaHelpers::DynamicReshape(block_top[1], candidate_sizes), k, dim,
+      largest, /*is_stable=*/true);
+}
+
+// Returns the k largest (or smallest) values along dim, in order, together
+// with their S32 indices.
+std::vector<xla::XlaOp> BuildSortedTopK(const Device& device, xla::XlaOp input,
+                                        xla::int64 k, xla::int64 dim,
+                                        bool largest) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(input);
+  XLA_CHECK_LE(k, shape.dimensions(dim));
+  xla::Shape iota_shape =
+      xla::ShapeUtil::MakeShape(xla::PrimitiveType::S32, shape.dimensions());
+  xla::XlaOp iota = xla::Iota(input.builder(), iota_shape, dim);
+  if (UseBlockTopK(device, k, shape.dimensions(dim))) {
+    return BuildBlockTopK(input, iota, k, dim, largest,
+                          GetTopKBlockSize(device));
+  }
+  return SortAndSlice(input, iota, k, dim, largest, /*is_stable=*/false);
+}
+
 }  // namespace
 
 xla::XlaOp PadToSize(xla::XlaOp input, absl::Span<const xla::int64> size,
@@ -302,31 +423,23 @@ xla::XlaOp PadToSize(xla::XlaOp input, absl::Span<const xla::int64> size,
   return xla::Pad(input, *pad_value, padding_config);
 }
 
-std::vector<xla::XlaOp> CreateKthValue(xla::XlaOp input, xla::int64 k,
+std::vector<xla::XlaOp> CreateKthValue(const Device& device,
+                                       xla::XlaOp input, xla::int64 k,
                                        xla::int64 dim, bool keepdim) {
   // Here 'k' is 1 based (1...).
   const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(input);
-  XLA_CHECK_LE(k, shape.dimensions(dim));
-  xla::Shape iota_shape =
-      xla::ShapeUtil::MakeShape(xla::PrimitiveType::S32, shape.dimensions());
-  xla::XlaOp iota = xla::Iota(input.builder(), iota_shape, dim);
-  xla::XlaOp sort_result = xla::Sort(
-      {input, iota},
-      xla::CreateScalarLtComputation(
-          {shape.element_type(), xla::PrimitiveType::S32}, input.builder()),
-      dim);
+  std::vector<xla::XlaOp> top_k =
+      BuildSortedTopK(device, input, k, dim, /*largest=*/false);
 
   std::vector<xla::int64> start_indices(shape.rank(), 0);
   start_indices[dim] = k - 1;
-  std::vector<xla::int64> limit_indices(shape.dimensions().begin(),
-                                        shape.dimensions().end());
-  limit_indices[dim] = k;
+  std::vector<xla::int64> limit_indices = SliceLimits(shape, dim, k);
   std::vector<xla::int64> strides(shape.rank(), 1);
 
-  xla::XlaOp values = xla::Slice(xla::GetTupleElement(sort_result, 0),
-                                 start_indices, limit_indices, strides);
-  xla::XlaOp indices = xla::Slice(xla::GetTupleElement(sort_result, 1),
-                                  start_indices, limit_indices, strides);
+  xla::XlaOp values =
+      xla::Slice(top_k[0], start_indices, limit_indices, strides);
+  xla::XlaOp indices =
+      xla::Slice(top_k[1], start_indices, limit_indices, strides);
   if (!keepdim) {
     auto reshape_sizes = XlaHelpers::DropDimensions(shape.dimensions(), {dim});
     values = XlaHelpers::DynamicReshape(values, reshape_sizes);
@@ -338,38 +451,17 @@ std::vector<xla::XlaOp> CreateKthValue(xla::XlaOp input, xla::int64 k,
                                                       /*device=*/nullptr))};
 }
 
-std::vector<xla::XlaOp> CreateTopK(xla::XlaOp input, xla::int64 k,
-                                   xla::int64 dim, bool largest,
+std::vector<xla::XlaOp> CreateTopK(const Device& device, xla::XlaOp input,
+                                   xla::int64 k, xla::int64 dim, bool largest,
                                    bool /* sorted */) {
   // Here 'k' is 1 based (1...).
-  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(input);
-  XLA_CHECK_LE(k, shape.dimensions(dim));
-  xla::Shape iota_shape =
-      xla::ShapeUtil::MakeShape(xla::PrimitiveType::S32, shape.dimensions());
-  xla::XlaOp iota = xla::Iota(input.builder(), iota_shape, dim);
-  xla::XlaComputation comparator =
-      largest ? xla::CreateScalarGtComputation(
-                    {shape.element_type(), xla::PrimitiveType::S32},
-                    input.builder())
-              : xla::CreateScalarLtComputation(
-                    {shape.element_type(), xla::PrimitiveType::S32},
-                    input.builder());
-  xla::XlaOp sort_result = xla::Sort({input, iota}, comparator, dim);
-
-  std::vector<xla::int64> start_indices(shape.rank(), 0);
-  std::vector<xla::int64> limit_indices(shape.dimensions().begin(),
-                                        shape.dimensions().end());
-  limit_indices[dim] = k;
-  std::vector<xla::int64> strides(shape.rank(), 1);
-
-  xla::XlaOp values = xla::Slice(xla::GetTupleElement(sort_result, 0),
-                                 start_indices, limit_indices, strides);
-  xla::XlaOp indices = xla::Slice(xla::GetTupleElement(sort_result, 1),
-                                  start_indices, limit_indices, strides);
+  std::vector<xla::XlaOp> top_k =
+      BuildSortedTopK(device, input, k, dim, largest);
   // aten::topk() wants Long tensors as indices.
-  return {values, xla::ConvertElementType(
-                      indices, GetDevicePrimitiveType(xla::PrimitiveType::S64,
-                                                      /*device=*/nullptr))};
+  return {top_k[0], xla::ConvertElementType(
+                        top_k[1], GetDevicePrimitiveType(
+                                      xla::PrimitiveType::S64,
+                                      /*device=*/nullptr))};
 }
 
 xla::XlaOp CreateMatMul(xla::XlaOp lhs, xla::XlaOp rhs) {
@@ -463,15 +555,30 @@ xla::XlaOp BuildExponential(xla::XlaOp lambda, xla::XlaOp seed,
   return xla::Neg(xla::Log1p(xla::Neg(rng)) * xla::Reciprocal(lambda));
 }
 
-xla::XlaOp BuildDropout(xla::XlaOp input, float probability, xla::XlaOp seed) {
+xla::XlaOp BuildDropout(xla::XlaOp input, double drop_probability,
+                        xla::XlaOp seed) {
+  XLA_CHECK(drop_probability >= 0.0 && drop_probability <= 1.0)
+      << drop_probability;
   const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(input);
-  xla::XlaOp prob =
-      XlaHelpers::ScalarBroadcast<float>(probability, shape, input.builder());
-  xla::XlaOp mask = BuildBernoulli(prob, seed, shape.element_type());
-  if (probability > 0.0f) {
-    mask = mask / prob;
-  }
-  return input * mask;
+  xla::XlaOp zeros =
+      XlaHelpers::ScalarBroadcast<float>(0, shape, input.builder());
+  if (drop_probability == 1.0) {
+    return zeros;
+  }
+  // The mask is drawn from raw 32 bit words compared to a threshold, instead
+  // of uniform floats of the input type, and the scaling is fused with the
+  // selection.
+  static const double kNumWords = 4294967296.0;
+  xla::uint32 threshold = static_cast<xla::uint32>(
+      std::min(std::round(drop_probability * kNumWords), kNumWords - 1));
+  xla::XlaOp bits = RngBits(
+      seed, xla::ShapeUtil::MakeShape(xla::PrimitiveType::U32,
+                                      shape.dimensions()));
+  xla::XlaOp keep =
+      xla::Ge(bits, xla::ConstantR0<xla::uint32>(input.builder(), threshold));
+  xla::XlaOp scale = XlaHelpers::ScalarValue<double>(
+      1.0 / (1.0 - drop_probability), shape.element_type(), input.builder());
+  return xla::Select(keep, input * scale, zeros);
 }
 
 std::vector<xla::XlaOp> CreateBroadcastTensors(
@@ -525,7 +632,8 @@ xla::XlaOp CreateIndex(xla::XlaOp input, xla::XlaOp indices,
 xla::XlaOp CreateIndexUpdate(
     xla::XlaOp buffer, xla::XlaOp indices, xla::int64 start_dim,
     xla::XlaOp values,
-    const std::function<xla::XlaOp(xla::XlaOp, xla::XlaOp)>& combiner) {
+    const std::function<xla::XlaOp(xla::XlaOp, xla::XlaOp)>& combiner,
+    bool indices_are_sorted, bool unique_indices) {
   const xla::Shape& buffer_shape = XlaHelpers::ShapeOfXlaOp(buffer);
   const xla::Shape& indices_shape = XlaHelpers::ShapeOfXlaOp(indices);
   const xla::Shape& values_shape = XlaHelpers::ShapeOfXlaOp(values);
@@ -576,14 +684,18 @@ xla::XlaOp CreateIndexUpdate(
   xla::XlaComputation combiner_computation =
       MakeScatterComputation(combiner, buffer_shape.element_type());
   return xla::Scatter(buffer, indices, new_values, combiner_computation,
-                      dim_numbers);
+                      dim_numbers, indices_are_sorted, unique_indices);
 }
 
-xla::XlaOp CreateIndexAdd(xla::XlaOp buffer, xla::int64 dim, xla::XlaOp index,
-                          xla::XlaOp value) {
+xla::XlaOp CreateIndexAdd(const Device& device, xla::XlaOp buffer,
+                          xla::int64 dim, xla::XlaOp index, xla::XlaOp value) {
   auto add_scatter_combiner = [](xla::XlaOp x, xla::XlaOp y) -> xla::XlaOp {
     return x + y;
   };
+  if (dim == 0 &&
+      ShouldUseSortedScatter(device, XlaHelpers::ShapeOfXlaOp(index))) {
+    return CreateSortedRowScatter(buffer, index, value, add_scatter_combiner);
+  }
   return CreateIndexAlongDim(buffer, dim, index, value,
                              /*broadcast_value_to_index=*/false,
                              add_scatter_combiner);
@@ -612,6 +724,69 @@ XlaOpCombiner NumericAddCombiner() {
   };
 }
 
+xla::XlaOp CreateSortedRowScatter(xla::XlaOp buffer, xla::XlaOp index,
+                                  xla::XlaOp values,
+                                  const XlaOpCombiner& combiner) {
+  xla::XlaBuilder* builder = buffer.builder();
+  const xla::Shape& buffer_shape = XlaHelpers::ShapeOfXlaOp(buffer);
+  const xla::Shape& index_shape = XlaHelpers::ShapeOfXlaOp(index);
+  XLA_CHECK_EQ(index_shape.rank(), 1) << index_shape;
+  xla::int64 num_indices = index_shape.dimensions(0);
+  xla::XlaOp updates = values;
+  const xla::Shape& values_shape = XlaHelpers::ShapeOfXlaOp(values);
+  if (buffer_shape.element_type() != values_shape.element_type()) {
+    updates = ConvertTo(updates, values_shape.element_type(),
+                        buffer_shape.element_type(), /*device=*/nullptr);
+  }
+  if (num_indices < 2) {
+    return CreateIndexAlongDim(buffer, 0, index, updates,
+                               /*broadcast_value_to_index=*/false, combiner);
+  }
+  xla::XlaOp positions = xla::Iota(builder, xla::PrimitiveType::S32,
+                                   num_indices);
+  xla::XlaOp sorted = xla::Sort(
+      {index, positions},
+      xla::CreateScalarLtComputation(
+          {index_shape.element_type(), xla::PrimitiveType::S32}, builder),
+      /*dimension=*/0, /*is_stable=*/true);
+  xla::XlaOp sorted_index = xla::GetTupleElement(sorted, 0);
+  xla::XlaOp sorted_updates =
+      xla::TorchIndexSelect(updates, xla::GetTupleElement(sorted, 1), 0);
+  std::vector<xla::int64> updates_dims =
+      xla::util::ToVector<xla::int64>(values_shape.dimensions());
+  // Segmented inclusive scan over the runs of equal indices, so that the last
+  // row of each run ends up holding the combination of the whole run.
+  for (xla::int64 shift = 1; shift < num_indices; shift *= 2) {
+    xla::XlaOp same_index =
+        xla::Eq(xla::SliceInDim(sorted_index, shift, num_indices, 1, 0),
+                xla::SliceInDim(sorted_index, 0, num_indices - shift, 1, 0));
+    xla::XlaOp head = xla::SliceInDim(sorted_updates, 0, shift, 1, 0);
+    xla::XlaOp tail =
+        xla::SliceInDim(sorted_updates, shift, num_indices, 1, 0);
+    xla::XlaOp prev =
+        xla::SliceInDim(sorted_updates, 0, num_indices - shift, 1, 0);
+    updates_dims[0] = num_indices - shift;
+    xla::XlaOp mask = xla::BroadcastInDim(same_index, updates_dims, {0});
+    sorted_updates = xla::ConcatInDim(
+        builder, {head, xla::Select(mask, combiner(prev, tail), tail)}, 0);
+  }
+  // Only the last row of each run is scattered, the other ones are pointed out
+  // of bounds, which makes the scatter skip them.
+  xla::XlaOp is_last = xla::ConcatInDim(
+      builder,
+      {xla::Ne(xla::SliceInDim(sorted_index, 0, num_indices - 1, 1, 0),
+               xla::SliceInDim(sorted_index, 1, num_indices, 1, 0)),
+       xla::ConstantR1<bool>(builder, {true})},
+      0);
+  xla::XlaOp out_of_bounds = xla::Broadcast(
+      XlaHelpers::ScalarValue(buffer_shape.dimensions(0),
+                              index_shape.element_type(), builder),
+      {num_indices});
+  xla::XlaOp unique_index = xla::Select(is_last, sorted_index, out_of_bounds);
+  return CreateIndexAlongDim(buffer, 0, unique_index, sorted_updates,
+                             /*broadcast_value_to_index=*/false, combiner);
+}
+
 xla::XlaOp CreateScatter(const Device& device, xla::XlaOp input,
                          xla::XlaOp index, xla::XlaOp source, xla::int64 dim,
                          const XlaOpCombiner& combiner) {
@@ -627,6 +802,10 @@ xla::XlaOp CreateScatter(const Device& device, xla::XlaOp input,
   if (ShouldUseDenseScatter(device, input_shape, index_shape)) {
     return XlaDenseScatter(input, index, source_op, dim, combiner);
   }
+  if (combiner != nullptr && input_shape.rank() == 1 &&
+      ShouldUseSortedScatter(device, index_shape)) {
+    return CreateSortedRowScatter(input, index, source_op, combiner);
+  }
 
   xla::ShapeUtil::AppendMajorDimension(1, &index_shape);
   std::vector<xla::XlaOp> to_concat;
@@ -12,11 +12,13 @@ namespace torch_xla {
 xla::XlaOp PadToSize(xla::XlaOp input, absl::Span<const xla::int64> size,
                      absl::optional<xla::XlaOp> pad_value = absl::nullopt);
 
-std::vector<xla::XlaOp> CreateKthValue(xla::XlaOp input, xla::int64 k,
+std::vector<xla::XlaOp> CreateKthValue(const Device& device,
+                                       xla::XlaOp input, xla::int64 k,
                                        xla::int64 dim, bool keepdim);
 
-std::vector<xla::XlaOp> CreateTopK(xla::XlaOp input, xla::int64 k,
-                                   xla::int64 dim, bool largest, bool sorted);
+std::vector<xla::XlaOp> CreateTopK(const Device& device, xla::XlaOp input,
+                                   xla::int64 k, xla::int64 dim, bool largest,
+                                   bool sorted);
 
 xla::XlaOp CreateMatMul(xla::XlaOp lhs, xla::XlaOp rhs);
 
@@ -32,7 +34,11 @@ xla::XlaOp BuildBernoulli(xla::XlaOp probability, xla::XlaOp seed,
 xla::XlaOp BuildExponential(xla::XlaOp lambda, xla::XlaOp seed,
                             xla::PrimitiveType type);
 
-xla::XlaOp BuildDropout(xla::XlaOp input, float probability, xla::XlaOp seed);
+// Zeroes the input elements with drop_probability, and scales the other ones
+// by 1 / (1 - drop_probability). The mask only depends on the input shape and
+// on the seed, so the backward regenerates it from the same seed.
+xla::XlaOp BuildDropout(xla::XlaOp input, double drop_probability,
+                        xla::XlaOp seed);
 
 std::vector<xla::XlaOp> CreateBroadcastTensors(
     absl::Span<const xla::XlaOp> operands);
@@ -41,14 +47,16 @@ std::vector<xla::XlaOp> CreateBroadcastTensors(
 xla::XlaOp CreateIndex(xla::XlaOp input, xla::XlaOp indices,
                        xla::int64 start_dim);
 
-// Similar to tf.scatter_nd, used to implement advanced indexing updates.
+// Similar to tf.scatter_nd, used to implement advanced indexing updates. The
+// indices_are_sorted and unique_indices flags are forwarded to the scatter.
 xla::XlaOp CreateIndexUpdate(
     xla::XlaOp buffer, xla::XlaOp indices, xla::int64 start_dim,
     xla::XlaOp updates,
-    const std::function<xla::XlaOp(xla::XlaOp, xla::XlaOp)>& combiner);
+    const std::function<xla::XlaOp(xla::XlaOp, xla::XlaOp)>& combiner,
+    bool indices_are_sorted = false, bool unique_indices = false);
 
-xla::XlaOp CreateIndexAdd(xla::XlaOp buffer, xla::int64 dim, xla::XlaOp index,
-                          xla::XlaOp value);
+xla::XlaOp CreateIndexAdd(const Device& device, xla::XlaOp buffer,
+                          xla::int64 dim, xla::XlaOp index, xla::XlaOp value);
 
 xla::XlaOp CreateIndexCopy(xla::XlaOp buffer, xla::int64 dim, xla::XlaOp index,
                            xla::XlaOp value);
@@ -60,6 +68,15 @@ using XlaOpCombiner = std::function<xla::XlaOp(xla::XlaOp, xla::XlaOp)>;
 
 XlaOpCombiner NumericAddCombiner();
 
+// Combines the rows of values into the rows of buffer selected by the rank 1
+// index. The index is sorted, and the rows sharing the same index are combined
+// together before the scatter, which then only sees unique indices. This
+// avoids the serialization of the updates hitting the same rows, like in the
+// embedding gradients.
+xla::XlaOp CreateSortedRowScatter(xla::XlaOp buffer, xla::XlaOp index,
+                                  xla::XlaOp values,
+                                  const XlaOpCombiner& combiner);
+
 // Used to lower scatter and scatter_add.
 xla::XlaOp CreateScatter(const Device& device, xla::XlaOp input,
                          xla::XlaOp index, xla::XlaOp source, xla::int64 dim,
@@ -0,0 +1,325 @@
+#include "torch_xla/csrc/xla_sharding_util.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "tensorflow/compiler/xla/layout_util.h"
+#include "tensorflow/compiler/xla/literal.h"
+#include "tensorflow/compiler/xla/xla_client/cache.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "torch_xla/csrc/helpers.h"
+#include "torch_xla/csrc/tensor_util.h"
+
+namespace torch_xla {
+namespace {
+
+// The replicas, on the partition devices, of an unsharded parameter of a
+// sharded graph. The source is kept alive, so that its opaque handle cannot be
+// reused by other data while the entry is cached.
+struct ReplicatedData {
+  xla::ComputationClient::DataPtr source;
+  std::vector<xla::ComputationClient::DataPtr> replicas;
+};
+
+using ReplicatedDataCache =
+    xla::util::Cache<xla::hash_t, ReplicatedData, xla::util::HashReducer>;
+
+ReplicatedDataCache* GetReplicatedDataCache() {
+  static const size_t kMaxCacheSize = 1024;
+  static ReplicatedDataCache* cache = new ReplicatedDataCache(kMaxCacheSize);
+  return cache;
+}
+
+xla::int64 GetShardSize(xla::int64 size, xla::int64 tiles) {
+  return (size + tiles - 1) / tiles;
+}
+
+// Returns the index, along every dimension, of the tile of partition.
+std::vector<xla::int64> GetTileIndex(const xla::OpSharding& sharding,
+                                     xla::int64 partition) {
+  const auto& tile_devices = sharding.tile_assignment_devices();
+  auto it = std::find(tile_devices.begin(), tile_devices.end(), partition);
+  XLA_CHECK(it != tile_devices.end())
+      << "Partition " << partition << " has no tile";
+  xla::int64 position = it - tile_devices.begin();
+  std::vector<xla::int64> index(sharding.tile_assignment_dimensions_size());
+  for (xla::int64 i = index.size() - 1; i >= 0; --i) {
+    xla::int64 tiles = sharding.tile_assignment_dimensions(i);
+    index[i] = position % tiles;
+    position /= tiles;
+  }
+  return index;
+}
+
+// Returns the slice of tensor held by partition, padded to the shard size.
+at::Tensor GetTensorShard(const at::Tensor& tensor, const ShardingSpec& spec,
+                          xla::int64 partition) {
+  if (ShardingUtil::IsReplicated(spec)) {
+    return tensor;
+  }
+  std::vector<xla::int64> tile_index = GetTileIndex(spec.sharding, partition);
+  XLA_CHECK_EQ(tile_index.size(), tensor.dim());
+  at::Tensor shard = tensor;
+  std::vector<int64_t> pad(2 * tile_index.size(), 0);
+  for (size_t i = 0; i < tile_index.size(); ++i) {
+    xla::int64 size = tensor.size(i);
+    xla::int64 shard_size =
+        GetShardSize(size, spec.sharding.tile_assignment_dimensions(i));
+    xla::int64 offset = std::min(tile_index[i] * shard_size, size);
+    xla::int64 extent = std::min(shard_size, size - offset);
+    shard = shard.narrow(i, offset, extent);
+    // The at::constant_pad_nd() padding starts from the last dimension.
+    pad[2 * (tile_index.size() - i) - 1] = shard_size - extent;
+  }
+  return at::constant_pad_nd(shard, pad, 0).contiguous();
+}
+
+}  // namespace
+
+ShardedData::ShardedData(std::string device, xla::Shape shape,
+                         ShardingSpecPtr spec,
+                         std::vector<xla::ComputationClient::DataPtr> shards)
+    : Data(std::move(device), std::move(shape)),
+      spec_(std::move(spec)),
+      shards_(std::move(shards)) {}
+
+ShardedData::OpaqueHandle ShardedData::GetOpaqueHandle() {
+  return reinterpret_cast<OpaqueHandle>(this);
+}
+
+void ShardedData::Assign(const Data& data) {
+  const ShardedData& sharded_data = dynamic_cast<const ShardedData&>(data);
+  spec_ = sharded_data.spec_;
+  shards_ = sharded_data.shards_;
+}
+
+bool ShardedData::HasValue() const {
+  if (shards_.empty()) {
+    return false;
+  }
+  for (auto& shard : shards_) {
+    if (!shard->HasValue()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+ShardingSpecPtr ShardingUtil::CreateShardingSpec(
+    absl::Span<const xla::int64> tile_dimensions,
+    absl::Span<const xla::int64> tile_devices,
+    std::vector<std::string> devices) {
+  if (tile_dimensions.empty()) {
+    return CreateReplicatedSpec(std::move(devices));
+  }
+  XLA_CHECK_EQ(xla::util::Multiply<xla::int64>(tile_dimensions),
+               tile_devices.size());
+  XLA_CHECK_EQ(tile_devices.size(), devices.size());
+  auto spec = std::make_shared<ShardingSpec>();
+  spec->sharding.set_type(xla::OpSharding::OTHER);
+  for (auto dimension : tile_dimensions) {
+    spec->sharding.add_tile_assignment_dimensions(dimension);
+  }
+  for (auto partition : tile_devices) {
+    XLA_CHECK(partition >= 0 && partition < devices.size())
+        << "Invalid partition " << partition << " for " << devices.size()
+        << " devices";
+    spec->sharding.add_tile_assignment_devices(partition);
+  }
+  spec->devices = std::move(devices);
+  return spec;
+}
+
+ShardingSpecPtr ShardingUtil::CreateReplicatedSpec(
+    std::vector<std::string> devices) {
+  auto spec = std::make_shared<ShardingSpec>();
+  spec->sharding.set_type(xla::OpSharding::REPLICATED);
+  spec->devices = std::move(devices);
+  return spec;
+}
+
+bool ShardingUtil::IsReplicated(const ShardingSpec& spec) {
+  return spec.sharding.type() == xla::OpSharding::REPLICATED;
+}
+
+bool ShardingUtil::EqualSpecs(const ShardingSpec& spec1,
+                              const ShardingSpec& spec2) {
+  return spec1.devices == spec2.devices &&
+         spec1.sharding.SerializeAsString() ==
+             spec2.sharding.SerializeAsString();
+}
+
+xla::hash_t ShardingUtil::GetSpecHash(const ShardingSpec& spec) {
+  return xla::util::MHash(spec.sharding.SerializeAsString(), spec.devices);
+}
+
+std::string ShardingUtil::GetSpecString(const ShardingSpec& spec) {
+  return absl::StrCat(spec.sharding.ShortDebugString(), " devices=[",
+                      absl::StrJoin(spec.devices, ","), "]");
+}
+
+ShardedData* ShardingUtil::GetShardedData(
+    const xla::ComputationClient::DataPtr& data) {
+  return dynamic_cast<ShardedData*>(data.get());
+}
+
+xla::ComputationClient::DataPtr ShardingUtil::CreateShardedData(
+    const at::Tensor& tensor, const Device& device, ShardingSpecPtr spec) {
+  std::vector<at::Tensor> shards;
+  shards.reserve(spec->devices.size());
+  for (size_t i = 0; i < spec->devices.size(); ++i) {
+    shards.push_back(GetTensorShard(tensor, *spec, i));
+  }
+  std::vector<xla::ComputationClient::DataPtr> shards_data =
+      CreateTensorsData(shards, spec->devices);
+  return std::make_shared<ShardedData>(
+      device.ToString(), CreateComputationShapeFromTensor(tensor, &device),
+      std::move(spec), std::move(shards_data));
+}
+
+xla::ComputationClient::DataPtr ShardingUtil::CreateShardedPlaceholder(
+    const Device& device, xla::Shape shape, ShardingSpecPtr spec) {
+  return std::make_shared<ShardedData>(device.ToString(), std::move(shape),
+                                       std::move(spec));
+}
+
+at::Tensor ShardingUtil::ShardedDataToTensor(const ShardedData& data,
+                                             at::ScalarType dest_element_type) {
+  XLA_CHECK(data.HasValue()) << "Sharded data has no value";
+  const ShardingSpec& spec = *data.spec();
+  if (IsReplicated(spec)) {
+    return XlaDataToTensors({data.shards().front()}, dest_element_type)
+        .front();
+  }
+  std::vector<at::Tensor> shards =
+      XlaDataToTensors(data.shards(), dest_element_type);
+  at::Tensor tensor =
+      at::empty(XlaHelpers::I64List(data.shape().dimensions()),
+                shards.front().options());
+  for (size_t partition = 0; partition < shards.size(); ++partition) {
+    std::vector<xla::int64> tile_index =
+        GetTileIndex(spec.sharding, partition);
+    at::Tensor dest = tensor;
+    at::Tensor source = shards[partition];
+    for (size_t i = 0; i < tile_index.size(); ++i) {
+      xla::int64 size = tensor.size(i);
+      xla::int64 shard_size = source.size(i);
+      xla::int64 offset = std::min(tile_index[i] * shard_size, size);
+      xla::int64 extent = std::min(shard_size, size - offset);
+      dest = dest.narrow(i, offset, extent);
+      source = source.narrow(i, 0, extent);
+    }
+    dest.copy_(source);
+  }
+  return tensor;
+}
+
+std::vector<std::vector<xla::ComputationClient::DataPtr>>
+ShardingUtil::GetShardedArguments(
+    absl::Span<const xla::ComputationClient::DataPtr> parameters_data,
+    absl::Span<const std::string> devices) {
+  ReplicatedDataCache* cache = GetReplicatedDataCache();
+  xla::hash_t devices_hash = xla::util::Hash(devices);
+  std::vector<std::shared_ptr<ReplicatedData>> replicated(
+      parameters_data.size());
+  std::vector<size_t> missing;
+  for (size_t i = 0; i < parameters_data.size(); ++i) {
+    const xla::ComputationClient::DataPtr& data = parameters_data[i];
+    ShardedData* sharded_data = GetShardedData(data);
+    if (sharded_data != nullptr) {
+      XLA_CHECK(sharded_data->spec()->devices ==
+                std::vector<std::string>(devices.begin(), devices.end()))
+          << "Sharded graph on devices [" << absl::StrJoin(devices, ",")
+          << "] got a parameter sharded as "
+          << GetSpecString(*sharded_data->spec());
+      continue;
+    }
+    replicated[i] = cache->Get(
+        xla::util::HashCombine(devices_hash, data->GetOpaqueHandle()));
+    if (replicated[i] == nullptr) {
+      missing.push_back(i);
+    }
+  }
+  if (!missing.empty()) {
+    // The unsharded parameters are copied to the other partition devices
+    // through the host, which is expensive. Parameters which are used across
+    // steps should be marked as replicated instead.
+    XLA_COUNTER("ShardingReplicatedParameters", missing.size());
+    std::vector<xla::ComputationClient::DataPtr> sources;
+    for (auto index : missing) {
+      sources.push_back(parameters_data[index]);
+    }
+    std::vector<xla::Literal> literals =
+        xla::ComputationClient::Get()->TransferFromServer(sources);
+    std::vector<xla::ComputationClient::TensorSource> tensor_sources;
+    for (size_t i = 0; i < sources.size(); ++i) {
+      auto literal = std::make_shared<xla::Literal>(literals[i].Relayout(
+          xla::LayoutUtil::GetDefaultLayoutForShape(literals[i].shape())));
+      auto populate_fn =
+          [literal](const xla::ComputationClient::TensorSource& source_tensor,
+                    void* dest_buffer, size_t dest_buffer_size) {
+            std::memcpy(dest_buffer, literal->untyped_data(),
+                        std::min(dest_buffer_size, literal->size_bytes()));
+          };
+      for (auto& device : devices) {
+        if (device != sources[i]->device()) {
+          tensor_sources.emplace_back(sources[i]->shape(), device,
+                                      populate_fn);
+        }
+      }
+    }
+    std::vector<xla::ComputationClient::DataPtr> replicas =
+        xla::ComputationClient::Get()->TransferToServer(tensor_sources);
+    size_t replica_index = 0;
+    for (size_t i = 0; i < sources.size(); ++i) {
+      auto entry = std::make_shared<ReplicatedData>();
+      entry->source = sources[i];
+      for (auto& device : devices) {
+        entry->replicas.push_back(device != sources[i]->device()
+                                      ? replicas.at(replica_index++)
+                                      : sources[i]);
+      }
+      replicated[missing[i]] = cache->Add(
+          xla::util::HashCombine(devices_hash, sources[i]->GetOpaqueHandle()),
+          std::move(entry));
+    }
+  }
+
+  std::vector<std::vector<xla::ComputationClient::DataPtr>> arguments(
+      devices.size());
+  for (size_t partition = 0; partition < devices.size(); ++partition) {
+    arguments[partition].reserve(parameters_data.size());
+    for (size_t i = 0; i < parameters_data.size(); ++i) {
+      ShardedData* sharded_data = GetShardedData(parameters_data[i]);
+      arguments[partition].push_back(
+          sharded_data != nullptr ? sharded_data->shards()[partition]
+                                  : replicated[i]->replicas[partition]);
+    }
+  }
+  return arguments;
+}
+
+std::vector<xla::ComputationClient::DataPtr> ShardingUtil::WrapShardedResults(
+    const ShardedGraph& graph, const std::string& device,
+    std::vector<std::vector<xla::ComputationClient::DataPtr>> results) {
+  XLA_CHECK_EQ(results.size(), graph.devices.size());
+  std::vector<xla::ComputationClient::DataPtr> sharded_results;
+  sharded_results.reserve(graph.output_specs.size());
+  for (size_t i = 0; i < graph.output_specs.size(); ++i) {
+    std::vector<xla::ComputationClient::DataPtr> shards;
+    shards.reserve(results.size());
+    for (auto& partition_results : results) {
+      XLA_CHECK_EQ(partition_results.size(), graph.output_specs.size());
+      shards.push_back(std::move(partition_results[i]));
+    }
+    sharded_results.push_back(std::make_shared<ShardedData>(
+        device, graph.output_shapes[i], graph.output_specs[i],
+        std::move(shards)));
+  }
+  return sharded_results;
+}
+
+}  // namespace torch_xla
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/compiler/xla/xla_data.pb.h"
+#include "torch/csrc/autograd/variable.h"
+#include "torch_xla/csrc/device.h"
+
+namespace torch_xla {
+
+// The sharding of a tensor across the devices of a mesh, in the format used by
+// the XLA SPMD partitioner. The partition with index i runs on devices[i], and
+// the tile_assignment_devices of the sharding are partition indices.
+struct ShardingSpec {
+  xla::OpSharding sharding;
+  std::vector<std::string> devices;
+};
+
+using ShardingSpecPtr = std::shared_ptr<const ShardingSpec>;
+
+// The device data of a tensor split according to a sharding spec, which lives
+// on the device of the tensor only nominally. The shard of partition i lives
+// on spec->devices[i]. The shards of unevenly split dimensions are padded to
+// the same size, as the partitioned computations expect.
+class ShardedData : public xla::ComputationClient::Data {
+ public:
+  ShardedData(std::string device, xla::Shape shape, ShardingSpecPtr spec,
+              std::vector<xla::ComputationClient::DataPtr> shards = {});
+
+  OpaqueHandle GetOpaqueHandle() override;
+
+  void Assign(const Data& data) override;
+
+  bool HasValue() const override;
+
+  const ShardingSpecPtr& spec() const { return spec_; }
+
+  const std::vector<xla::ComputationClient::DataPtr>& shards() const {
+    return shards_;
+  }
+
+ private:
+  ShardingSpecPtr spec_;
+  std::vector<xla::ComputationClient::DataPtr> shards_;
+};
+
+// The partition devices and the output shardings of a graph compiled with the
+// SPMD partitioner.
+struct ShardedGraph {
+  std::vector<std::string> devices;
+  std::vector<ShardingSpecPtr> output_specs;
+  // The unpartitioned shapes of the outputs.
+  std::vector<xla::Shape> output_shapes;
+};
+
+class ShardingUtil {
+ public:
+  // Creates a spec tiling the dimensions of a tensor by tile_dimensions, with
+  // tile_devices (row-major over the tiles) as the partition of every tile. An
+  // empty tile_dimensions creates a replicated spec.
+  static ShardingSpecPtr CreateShardingSpec(
+      absl::Span<const xla::int64> tile_dimensions,
+      absl::Span<const xla::int64> tile_devices,
+      std::vector<std::string> devices);
+
+  static ShardingSpecPtr CreateReplicatedSpec(std::vector<std::string> devices);
+
+  static bool IsReplicated(const ShardingSpec& spec);
+
+  static bool EqualSpecs(const ShardingSpec& spec1, const ShardingSpec& spec2);
+
+  static xla::hash_t GetSpecHash(const ShardingSpec& spec);
+
+  static std::string GetSpecString(const ShardingSpec& spec);
+
+  // Returns the sharded data behind data, or nullptr if data is not sharded.
+  static ShardedData* GetShardedData(
+      const xla::ComputationClient::DataPtr& data);
+
+  // Splits the tensor according to spec, and uploads every shard to the
+  // device of its partition.
+  static xla::ComputationClient::DataPtr CreateShardedData(
+      const at::Tensor& tensor, const Device& device, ShardingSpecPtr spec);
+
+  // Creates a sharded data with no value, assigned by a later execution.
+  static xla::ComputationClient::DataPtr CreateShardedPlaceholder(
+      const Device& device, xla::Shape shape, ShardingSpecPtr spec);
+
+  // Fetches the shards of the data, and stitches them back together.
+  static at::Tensor ShardedDataToTensor(const ShardedData& data,
+                                        at::ScalarType dest_element_type);
+
+  // Returns the arguments of every partition of a sharded graph. The unsharded
+  // parameters are replicated on all the partition devices, and the replicas
+  // cached for the next executions.
+  static std::vector<std::vector<xla::ComputationClient::DataPtr>>
+  GetShardedArguments(
+      absl::Span<const xla::ComputationClient::DataPtr> parameters_data,
+      absl::Span<const std::string> devices);
+
+  // Wraps the per partition results of a sharded graph execution into sharded
+  // data.
+  static std::vector<xla::ComputationClient::DataPtr> WrapShardedResults(
+      const ShardedGraph& graph, const std::string& device,
+      std::vector<std::vector<xla::ComputationClient::DataPtr>> results);
+};
+
+}  // namespace torch_xla
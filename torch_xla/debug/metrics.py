@@ -1,5 +1,6 @@
 from __future__ import print_function
 
+import contextlib
 import torch_xla
 
 
@@ -45,3 +46,286 @@ def metric_data(name):
 def metrics_report():
   """Retrieves a string containing the full metrics and counters report."""
   return torch_xla._XLAC._xla_metrics_report()
+
+
+def metrics_snapshot():
+  """Captures the current counter values and metric totals.
+
+  Unlike `metrics_report()`, the snapshot only copies the counter values, and
+  the sample counts and accumulators of the metrics, so it is cheap enough to
+  be taken at every step. Example::
+
+    snapshot = met.metrics_snapshot()
+    train_step()
+    delta = met.metrics_delta(snapshot)
+    compiles, _ = delta['metrics'].get('CompileTime', (0, 0.0))
+
+  Returns:
+    An opaque snapshot object, to be passed to `metrics_delta()`.
+  """
+  return torch_xla._XLAC._xla_metrics_snapshot()
+
+
+def metrics_delta(before, after=None):
+  """Returns the changes of the counters and metrics between two snapshots.
+
+  Args:
+    before: The snapshot taken with `metrics_snapshot()` at the start of the
+      monitored interval.
+    after (optional): The snapshot taken at the end of the monitored interval.
+      If `None`, a new snapshot is taken.
+      Default: None
+
+  Returns:
+    A dictionary with a `counters` entry, mapping the names of the counters
+    which changed to their increments, and a `metrics` entry, mapping the names
+    of the metrics which got new samples to a (SAMPLES, ACCUMULATOR) tuple with
+    the number of new samples and their sum.
+  """
+  if after is None:
+    after = metrics_snapshot()
+  return torch_xla._XLAC._xla_metrics_delta(before, after)
+
+
+def timeline_trace():
+  """Retrieves the flight recorder timeline of the last graph executions.
+
+  Each graph execution contributes the device lock wait, compile and execute
+  phases, together with the graph hash, the number of nodes and the bytes
+  moved in and out of the device.
+  The transfers to and from the devices get their own `H2D` and `D2H` tracks,
+  which show how they overlap with the executions.
+
+  Returns:
+    A string in the Chrome trace event (JSON) format, which can be saved to a
+    file and loaded by chrome://tracing or Perfetto.
+  """
+  return torch_xla._XLAC._xla_dump_timeline()
+
+
+def fallback_stats():
+  """Returns the statistics about the ATEN operations executed on CPU.
+
+  Operations which have no XLA lowering are executed on CPU, which requires
+  syncing the graph of their inputs and moving data back and forth between
+  host and device.
+
+  Returns:
+    A dictionary mapping the ATEN operation name (like `aten::foo`) to a
+    dictionary holding the number of fallbacks (`count`), the bytes transferred
+    to host (`bytes_to_host`) and to device (`bytes_to_device`), the time spent
+    within the fallbacks in nanoseconds (`time_ns`), and the Python locations
+    which triggered them, together with their counts (`frames`).
+  """
+  return torch_xla._XLAC._xla_fallback_stats()
+
+
+def fallback_report():
+  """Retrieves a string containing the report of the CPU fallbacks."""
+  return torch_xla._XLAC._xla_fallback_report()
+
+
+def clear_fallback_stats():
+  """Clears the statistics about the CPU fallbacks."""
+  torch_xla._XLAC._xla_reset_fallback_stats()
+
+
+@contextlib.contextmanager
+def strict_fallbacks():
+  """Context manager which raises an error on any CPU fallback.
+
+  The region is local to the calling thread. Example::
+
+    with met.strict_fallbacks():
+      for data, target in loader:
+        train_step(data, target)
+  """
+  torch_xla._XLAC._xla_enter_fallback_strict()
+  try:
+    yield
+  finally:
+    torch_xla._XLAC._xla_exit_fallback_strict()
+
+
+def compiled_graphs_stats(top_n=0):
+  """Retrieves the compilation stats of the graphs in the compilation cache.
+
+  Args:
+    top_n (int, optional): If not zero, the maximum number of graphs to return.
+      Default: 0
+
+  Returns:
+    A list of dictionaries, sorted by decreasing compile time, with the
+    `hash`, `hlo_instructions`, `num_parameters`, `parameters_bytes`,
+    `num_outputs`, `outputs_bytes`, `num_aliases`, `aliased_bytes` (the outputs
+    bytes reusing the parameters buffers), `peak_bytes` (the device memory of
+    the parameters and outputs, with the aliased buffers counted once),
+    `compile_time_ns` and `devices` (the devices compiled for) of every graph.
+    The backend temporary allocations are not included in `peak_bytes`.
+  """
+  return torch_xla._XLAC._xla_compiled_graphs_stats(top_n)
+
+
+def pin_compiled_graph(hash, pinned=True):
+  """Pins a graph within the compilation cache.
+
+  The compilation cache evicts first the graphs which are cheap to compile and
+  rarely used. A pinned graph is evicted only when all the graphs sharing its
+  cache shard are pinned as well, which allows protecting a graph whose
+  recompilation would take long, from bursts of new graphs. Example::
+
+    stats = met.dry_run_stats()
+    met.pin_compiled_graph(stats['hash'])
+
+  Args:
+    hash (string): The graph hash, as returned within the
+      `compiled_graphs_stats()` and `dry_run_stats()` dictionaries. The graph
+      does not need to be compiled yet.
+    pinned (bool, optional): Whether to pin or unpin the graph.
+      Default: True
+  """
+  torch_xla._XLAC._xla_pin_compiled_graph(hash, pinned)
+
+
+def dry_run_stats(tensors=None, devices=[]):
+  """Compiles the pending graph of the tensors without executing it.
+
+  Allows checking the device memory a step needs, like for candidate batch
+  sizes, before running it. The compiled graph is added to the compilation
+  cache, and the tensors keep their pending values. Example::
+
+    for batch_size in [64, 128, 256]:
+      loss = loss_fn(model(data[:batch_size]), target[:batch_size])
+      loss.backward()
+      print(batch_size, met.dry_run_stats()['peak_bytes'])
+      optimizer.zero_grad()
+
+  Args:
+    tensors (list, optional): The XLA tensors whose graph is compiled. If
+      `None`, the graph of all the live tensors of the current device is
+      compiled, like `xm.mark_step()` would.
+      Default: None
+    devices (list, optional): The replication devices, as passed to
+      `xm.mark_step()`.
+      Default: []
+
+  Returns:
+    The compilation stats dictionary of the graph, with the same keys as the
+    `compiled_graphs_stats()` ones.
+  """
+  return torch_xla._XLAC._xla_dry_run_compile(tensors or [], devices)
+
+
+def recompile_reports():
+  """Retrieves the reports of the most recent recompilations.
+
+  Every report compares the recompiled graph with the most similar previously
+  compiled one, and lists the first differing nodes. Requires the
+  `XLA_RECOMPILE_ANALYSIS_GRAPHS` environment variable to be set to the number
+  of compiled graphs to keep for the comparison.
+
+  Returns:
+    The list of the report strings, from the oldest to the newer.
+  """
+  return torch_xla._XLAC._xla_recompile_reports()
+
+
+@contextlib.contextmanager
+def ir_scope(name):
+  """Context manager tagging the IR nodes created within it with a scope.
+
+  Scopes nest, and show up in the IR dumps, the HLO metadata and the scope
+  profile reports.
+
+  Args:
+    name (string): The name of the scope.
+  """
+  torch_xla._XLAC._xla_push_ir_scope(name)
+  try:
+    yield
+  finally:
+    torch_xla._XLAC._xla_pop_ir_scope()
+
+
+def annotate_module_scopes(module):
+  """Runs the forward of every submodule within an IR scope named after it.
+
+  Args:
+    module (torch.nn.Module): The root module, whose scope is named after its
+      class.
+
+  Returns:
+    The list of the hook handles, whose `remove()` API drops the scopes.
+  """
+
+  def pre_hook(name):
+
+    def hook(mod, inputs):
+      torch_xla._XLAC._xla_push_ir_scope(name)
+
+    return hook
+
+  def post_hook(mod, inputs, output):
+    torch_xla._XLAC._xla_pop_ir_scope()
+
+  handles = []
+  for name, submodule in module.named_modules():
+    name = name.rsplit('.', 1)[-1] or type(submodule).__name__
+    handles.append(submodule.register_forward_pre_hook(pre_hook(name)))
+    handles.append(submodule.register_forward_hook(post_hook))
+  return handles
+
+
+def start_scope_profile(num_steps):
+  """Starts attributing the device time of the next steps to the IR scopes.
+
+  The graphs synced within the next `num_steps` steps are also run op by op
+  (which slows those steps down), timing every op on its own. The times include
+  the per op dispatch overhead, so they rank scopes and ops against each other,
+  rather than measuring the fused graph time. Scopes are entered with
+  `ir_scope()` or `annotate_module_scopes()`, and the Python frames are
+  reported if the `XLA_IR_DEBUG` environment variable is set. Example::
+
+    met.annotate_module_scopes(model)
+    met.start_scope_profile(5)
+    for step, (data, target) in enumerate(loader):
+      train_step(data, target)
+      if step == 10:
+        print(met.scope_profile_report())
+
+  Args:
+    num_steps (int): The number of steps to profile.
+  """
+  torch_xla._XLAC._xla_start_scope_profile(num_steps)
+
+
+def stop_scope_profile():
+  """Stops the scope profiling, before its steps window ends."""
+  torch_xla._XLAC._xla_stop_scope_profile()
+
+
+def scope_profile_report():
+  """Retrieves the table of the profiled time per IR scope and op kind.
+
+  Returns:
+    The report string, sorted by decreasing time.
+  """
+  return torch_xla._XLAC._xla_scope_profile_report()
+
+
+def scope_profile_folded_stacks():
+  """Retrieves the profiled times in the folded stacks format.
+
+  Every line holds the Python frames, the IR scopes and the op kind, separated
+  by semicolons, followed by the nanoseconds spent. The output can be rendered
+  with the flame graph tools, like `flamegraph.pl`.
+
+  Returns:
+    The folded stacks string.
+  """
+  return torch_xla._XLAC._xla_scope_profile_folded_stacks()
+
+
+def clear_scope_profile():
+  """Drops the scope profile samples collected so far."""
+  torch_xla._XLAC._xla_reset_scope_profile()
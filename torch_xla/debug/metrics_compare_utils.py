@@ -178,7 +178,30 @@ def compare_metrics(
     metrics_report and the aggregates of raw_data_points, this report will have
     1 line reporting the difference.
   """
-  parsed_report = _parse_metrics_report(metrics_report)
+  return compare_data_points(
+      data_points, parse_metrics_report(metrics_report), config=config)
+
+
+def compare_data_points(
+    data_points,
+    parsed_report,
+    config={'base_expression': 'v <= v_mean + (v_stddev * 2.0)'}):
+  """Compare parsed metrics to historical averages and report differences.
+
+  Same as `compare_metrics()`, but the latest values are passed as a dict of
+  metric name to value, like the one returned by `parse_metrics_report()`.
+  This allows comparing values which are not part of a metrics report (like
+  the ones computed by a benchmark).
+
+  Args:
+    data_points(dict): Dict of metric name to list of historical values.
+    parsed_report(dict): Dict of metric name to the latest value.
+    config(dict): Configuration for metrics comparison, as documented in
+      `compare_metrics()`.
+
+  Returns:
+    Metrics difference report (string), as documented in `compare_metrics()`.
+  """
   means_and_stddevs = _compute_aggregates(data_points)
 
   difference_report = ''
@@ -43,9 +43,13 @@ class DataParallel(object):
     device_ids (string... or :class:`torch.device`...): The list of devices on
       which the replication should happen. If the list is empty, the network
       will be run on PyTorch CPU device.
+    broadcast_params (bool, optional): Whether the network weights should be
+      uploaded to the first device only, and then broadcast to the other ones
+      with a device side all-reduce, instead of being uploaded to each device.
+      Default: False
   """
 
-  def __init__(self, network, device_ids=None):
+  def __init__(self, network, device_ids=None, broadcast_params=False):
     if device_ids is None:
       device_ids = xm.get_xla_supported_devices()
     self._device_ids = [str(x) for x in device_ids]
@@ -53,10 +57,16 @@ class DataParallel(object):
     self._models = []
     self._contexts = []
     module = network if isinstance(network, torch.nn.Module) else network()
-    for device in device_ids:
-      device_module = deepcopy(module).to(device=torch.device(device))
+    for i, device in enumerate(device_ids):
+      device_module = deepcopy(module)
+      if broadcast_params and i > 0:
+        xm.zeros_on_device(device_module, torch.device(device))
+      else:
+        device_module.to(device=torch.device(device))
       self._models.append(device_module)
       self._contexts.append(Context(torch.device(device)))
+    if broadcast_params and len(self._models) > 1:
+      self._broadcast_params()
     if not self._models:
       # No XLA device, push a vanilla network in.
       device = self._get_model_device(module)
@@ -95,6 +105,24 @@ class DataParallel(object):
     # device.
     os._exit(17)
 
+  def _broadcast_runner(self, device, module):
+    xm.set_replication(device, self._device_ids)
+    try:
+      xm.broadcast_master_param(module)
+    except Exception as e:
+      self._handle_runner_exception(device, e)
+
+  def _broadcast_params(self):
+    threads = []
+    for module, device in zip(self._models, self._device_ids):
+      thread = threading.Thread(
+          target=self._broadcast_runner, args=(device, module))
+      thread.daemon = True
+      thread.start()
+      threads.append(thread)
+    for thread in threads:
+      thread.join()
+
   def _module_runner(self, loop_fn, device, module, loader, context, result):
     xm.set_replication(device, self._device_ids)
     try:
@@ -2,6 +2,9 @@ from __future__ import division
 from __future__ import print_function
 
 from six import iteritems, itervalues
+import itertools
+import os
+import pickle
 import threading
 import torch
 import torch_xla
@@ -12,12 +15,32 @@ import torch_xla.core.xla_model as xm
 
 class PerDeviceQueue(object):
 
-  def __init__(self, device, loader_prefetch_size, device_prefetch_size):
+  def __init__(self, device, index, device_prefetch_size):
     self.device = device
-    self.loader_queue = kq.Queue(maxsize=loader_prefetch_size)
+    self.index = index
     self.queue = kq.Queue(maxsize=device_prefetch_size)
 
 
+class _TensorIndex(object):
+
+  def __init__(self, index):
+    self.index = index
+
+
+def _flatten_cpu_tensors(data):
+  tensors = []
+
+  def convert_fn(cpu_tensors):
+    tensors.extend(cpu_tensors)
+    return [_TensorIndex(i) for i in range(len(cpu_tensors))]
+
+  def select_fn(v):
+    return type(v) == torch.Tensor and v.device.type == 'cpu'
+
+  refs = xm.ToXlaTensorArena(convert_fn, select_fn).transform(data)
+  return refs, tensors
+
+
 class PerDeviceLoader(object):
 
   def __init__(self, loader, device):
@@ -58,11 +81,11 @@ class ParallelLoader(object):
       Default: False
     loader_prefetch_size (int, optional): The max capacity of the queue used by
       the thread which is reading samples from the `loader`, to be processed by
-      the worker threads which upload data to the devices.
+      the worker thread which uploads data to the devices.
       Default: 8
-    device_prefetch_size (int, optional): The max size of the per-device queues,
-      where the worker threads deposit tensors which have already been sent to
-      devices.
+    device_prefetch_size (int, optional): The size of the per-device rings of
+      batches which have already been sent to devices. The batches for all the
+      devices are uploaded together, with a single transfer.
       Default: 4
   """
 
@@ -79,17 +102,19 @@ class ParallelLoader(object):
     self._fixed_batch_size = fixed_batch_size
     self._per_device_samples = len(loader) // len(devices)
     self._done = False
+    self._native = torch_xla._XLAC._xla_create_device_data_loader(
+        [str(device) for device in self._devices],
+        ring_size=device_prefetch_size)
+    self._loader_queue = kq.Queue(maxsize=loader_prefetch_size)
     self._queues = dict()
-    for device in self._devices:
-      self._queues[device] = PerDeviceQueue(device, loader_prefetch_size,
-                                            device_prefetch_size)
+    for index, device in enumerate(self._devices):
+      self._queues[device] = PerDeviceQueue(device, index, device_prefetch_size)
     thread = threading.Thread(target=self._loader_worker)
     thread.daemon = True
     thread.start()
-    for dqueue in itervalues(self._queues):
-      thread = threading.Thread(target=self._worker, args=(dqueue,))
-      thread.daemon = True
-      thread.start()
+    thread = threading.Thread(target=self._worker)
+    thread.daemon = True
+    thread.start()
 
   def per_device_loader(self, device):
     """Retrieves the loader iterator object for the given device.
@@ -110,13 +135,22 @@ class ParallelLoader(object):
 
   def next_item(self, device):
     dqueue = self._queues[device]
-    return dqueue.queue.get()
+    refs = dqueue.queue.get()
+    if refs is None:
+      return None
+    tensors = torch_xla._XLAC._xla_device_data_loader_next(
+        self._native, dqueue.index)
+    if tensors is None:
+      return None
+    return xu.for_each_instance_rewrite(
+        refs, lambda v: isinstance(v, _TensorIndex), lambda r: tensors[r.index])
 
   def close(self):
     self._done = True
+    torch_xla._XLAC._xla_device_data_loader_close(self._native)
+    self._loader_queue.close()
     for dqueue in itervalues(self._queues):
       dqueue.queue.close()
-      dqueue.loader_queue.close()
 
   def _get_batch_size(self, data, dim):
     size = []
@@ -132,7 +166,6 @@ class ParallelLoader(object):
     return size[0] if size else None
 
   def _loader_worker(self):
-    queues = list(self._queues.values())
     data_iter = enumerate(self._loader)
     batch_size = None
     batch = []
@@ -148,31 +181,31 @@ class ParallelLoader(object):
           break
       batch.append(data)
       if len(batch) == len(self._devices):
-        for queue_no, device_batch in enumerate(batch):
-          queues[queue_no].loader_queue.put(device_batch)
+        self._loader_queue.put(batch)
         batch = []
-    for dqueue in queues:
-      dqueue.loader_queue.close_write()
-
-  def _get_batch(self, dqueue):
-    batch = []
-    while dqueue.queue.max_size() > len(batch):
-      item = dqueue.loader_queue.get()
-      if item is None:
-        break
-      batch.append(item)
-    return batch
+    self._loader_queue.close_write()
 
-  def _worker(self, dqueue):
-    device = torch.device(dqueue.device)
+  def _worker(self):
+    queues = [self._queues[device] for device in self._devices]
     while True:
-      batch = self._get_batch(dqueue)
-      if not batch:
+      batch = self._loader_queue.get()
+      if batch is None:
         break
-      batch = xm.send_cpu_data_to_device(batch, device)
-      for data in batch:
-        dqueue.queue.put(data)
-    dqueue.queue.close_write()
+      device_refs, device_tensors = [], []
+      for device_batch in batch:
+        refs, tensors = _flatten_cpu_tensors(device_batch)
+        device_refs.append(refs)
+        device_tensors.append(tensors)
+      # A single transfer uploads the batches of all the devices, and waits for
+      # their rings to have room for them.
+      if not torch_xla._XLAC._xla_device_data_loader_upload(
+          self._native, device_tensors):
+        break
+      for dqueue, refs in zip(queues, device_refs):
+        dqueue.queue.put(refs)
+    torch_xla._XLAC._xla_device_data_loader_close_write(self._native)
+    for dqueue in queues:
+      dqueue.queue.close_write()
 
 
 class MpDeviceLoader(object):
@@ -199,3 +232,123 @@ class MpDeviceLoader(object):
 
   def __len__(self):
     return len(self._loader)
+
+
+_SHARED_RING_IDS = itertools.count()
+_ATTACHED_RINGS = dict()
+
+
+def _attach_shared_ring(name, num_slots, slot_size):
+  ring = _ATTACHED_RINGS.get(name)
+  if ring is None:
+    ring = torch_xla._XLAC._xla_create_shared_batch_ring(
+        name, num_slots, slot_size, create=False)
+    _ATTACHED_RINGS[name] = ring
+  return ring
+
+
+class _SharedRingCollate(object):
+
+  def __init__(self, collate_fn, ring_args):
+    self._collate_fn = collate_fn
+    self._ring_args = ring_args
+
+  def __call__(self, samples):
+    data = self._collate_fn(samples)
+    refs, tensors = _flatten_cpu_tensors(data)
+    ring = _attach_shared_ring(*self._ring_args)
+    torch_xla._XLAC._xla_shared_batch_ring_write(
+        ring, [tensor.contiguous() for tensor in tensors], pickle.dumps(refs))
+
+
+class _SharedRingDeviceLoader(object):
+
+  def __init__(self, loader, device, num_slots, slot_size, device_prefetch_size):
+    name = '/torch_xla_ring_{}_{}'.format(os.getpid(), next(_SHARED_RING_IDS))
+    self._ring = torch_xla._XLAC._xla_create_shared_batch_ring(
+        name, num_slots, slot_size, create=True)
+    self._prefetcher = torch_xla._XLAC._xla_create_device_prefetcher(
+        self._ring, str(device), queue_size=device_prefetch_size)
+    # The DataLoader iterator captures the collate function at creation.
+    collate_fn = loader.collate_fn
+    loader.collate_fn = _SharedRingCollate(collate_fn,
+                                           (name, num_slots, slot_size))
+    try:
+      data_iter = iter(loader)
+    finally:
+      loader.collate_fn = collate_fn
+    thread = threading.Thread(target=self._feeder, args=(data_iter,))
+    thread.daemon = True
+    thread.start()
+
+  def __iter__(self):
+    return self
+
+  def __next__(self):
+    return self.next()
+
+  def __del__(self):
+    torch_xla._XLAC._xla_shared_batch_ring_close(self._ring)
+
+  def next(self):
+    xm.mark_step()
+    item = torch_xla._XLAC._xla_device_prefetcher_next(self._prefetcher)
+    if item is None:
+      raise StopIteration
+    tensors, metadata = item
+    return xu.for_each_instance_rewrite(
+        pickle.loads(metadata), lambda v: isinstance(v, _TensorIndex),
+        lambda r: tensors[r.index])
+
+  def _feeder(self, data_iter):
+    # The batches travel through the shared memory ring, so the DataLoader
+    # iteration only needs to keep the workers going, and count the batches.
+    num_batches = 0
+    for _ in data_iter:
+      num_batches += 1
+    torch_xla._XLAC._xla_shared_batch_ring_close_write(self._ring, num_batches)
+
+
+class MpSharedMemoryLoader(object):
+  """Wraps an existing PyTorch DataLoader with native background data upload.
+
+  The DataLoader workers store their collated batches straight into a shared
+  memory ring, from which a native thread uploads them onto the device, with
+  no Python (hence no GIL contention with the training thread) involved. The
+  batches are returned in the order the workers completed them, which might
+  differ from the DataLoader one.
+
+  This class should only be using with multi-processing data parallelism.
+
+  Args:
+    loader (:class:`torch.utils.data.DataLoader`): The PyTorch DataLoader to be
+      wrapped.
+    device (`torch.device`...): The device where the data has to be sent.
+    num_slots (int, optional): The number of batches the shared memory ring
+      can hold.
+      Default: 8
+    slot_size (int, optional): The maximum size in bytes of the batch tensors.
+      Default: 64MB
+    device_prefetch_size (int, optional): The maximum number of batches which
+      have already been sent to the device.
+      Default: 4
+  """
+
+  def __init__(self,
+               loader,
+               device,
+               num_slots=8,
+               slot_size=64 * 1024 * 1024,
+               device_prefetch_size=4):
+    self._loader = loader
+    self._device = device
+    self._num_slots = num_slots
+    self._slot_size = slot_size
+    self._device_prefetch_size = device_prefetch_size
+
+  def __iter__(self):
+    return _SharedRingDeviceLoader(self._loader, self._device, self._num_slots,
+                                   self._slot_size, self._device_prefetch_size)
+
+  def __len__(self):
+    return len(self._loader)
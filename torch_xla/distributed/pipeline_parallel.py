@@ -0,0 +1,216 @@
+from __future__ import division
+from __future__ import print_function
+
+from six.moves import queue
+import sys
+import threading
+import time
+import torch
+import torch_xla.core.xla_model as xm
+import traceback
+
+
+class StageStats(object):
+  """The timing statistics of a pipeline stage.
+
+  The `idle_time` is the time the stage spent waiting for activations or
+  gradients from its neighbour stages (the pipeline bubble), while `busy_time`
+  is the rest of its running time.
+  """
+
+  def __init__(self):
+    self.busy_time = 0.0
+    self.idle_time = 0.0
+    self.steps = 0
+
+  @property
+  def bubble_fraction(self):
+    total_time = self.busy_time + self.idle_time
+    return self.idle_time / total_time if total_time > 0 else 0.0
+
+  def __repr__(self):
+    return 'StageStats(steps={}, busy={:.3f}s, idle={:.3f}s, bubble={:.1%})'.format(
+        self.steps, self.busy_time, self.idle_time, self.bubble_fraction)
+
+
+class _StageError(object):
+
+  def __init__(self, index, error):
+    self.index = index
+    self.error = error
+
+
+class PipelineParallel(object):
+  """Runs a model split in sequential stages, with every stage on its own device.
+
+  Every training step splits the input batch into micro-batches, which flow
+  through the stages with a 1F1B (one forward, one backward) schedule. Every
+  stage is driven by its own thread, and materializes its micro-batch graphs
+  on its own device, so the stages executions overlap with each other. The
+  activations and the gradients move across stages with device to device
+  copies.
+  Example::
+
+    pipeline = PipelineParallel([stage0, stage1], ['xla:0', 'xla:1'],
+                                loss_fn=nn.CrossEntropyLoss(),
+                                num_micro_batches=4)
+    optimizers = [optim.SGD(s.parameters(), lr=0.1) for s in pipeline.stages]
+    for data, target in loader:
+      loss = pipeline.train_step(data, target, optimizers=optimizers)
+
+  Args:
+    stages (list): The `torch.nn.Module` partitions of the model, in execution
+      order. The output of a stage is the input of the next one.
+    devices (list): The devices where the stages should run, one per stage.
+    loss_fn (callable): The function computing the loss from the output of the
+      last stage, and the target.
+    num_micro_batches (int): The number of micro-batches each input batch
+      should be split into.
+  """
+
+  def __init__(self, stages, devices, loss_fn, num_micro_batches):
+    assert len(stages) == len(devices), 'One device per stage is required'
+    assert num_micro_batches > 0
+    self._devices = [torch.device(x) for x in devices]
+    self._stages = [
+        stage.to(device=device)
+        for stage, device in zip(stages, self._devices)
+    ]
+    self._loss_fn = loss_fn
+    self._num_micro_batches = num_micro_batches
+    self._stats = [StageStats() for _ in stages]
+
+  @property
+  def stages(self):
+    return self._stages
+
+  @property
+  def devices(self):
+    return self._devices
+
+  @property
+  def stage_stats(self):
+    """The list of `StageStats` objects, one per stage."""
+    return self._stats
+
+  def _schedule(self, index):
+    # The stage runs as many warmup forwards as the number of stages after it,
+    # then alternates one forward and one backward, and finally drains the
+    # remaining backwards.
+    num_micro_batches = self._num_micro_batches
+    num_warmup = min(len(self._stages) - index - 1, num_micro_batches)
+    ops = [('F', i) for i in range(num_warmup)]
+    for i in range(num_warmup, num_micro_batches):
+      ops.append(('F', i))
+      ops.append(('B', i - num_warmup))
+    for i in range(num_micro_batches - num_warmup, num_micro_batches):
+      ops.append(('B', i))
+    return ops
+
+  def _receive(self, stage_queue, stats):
+    start = time.time()
+    value = stage_queue.get()
+    stats.idle_time += time.time() - start
+    if isinstance(value, _StageError):
+      raise RuntimeError('Pipeline stage {} failed: {}'.format(
+          value.index, value.error))
+    return value
+
+  def _run_stage(self, index, micro_batches, targets, optimizer, fwd_queues,
+                 bwd_queues, losses):
+    device = self._devices[index]
+    stage = self._stages[index]
+    stats = self._stats[index]
+    is_last = index == len(self._stages) - 1
+    xm.set_replication(device, [])
+    start = time.time()
+    idle_start = stats.idle_time
+    inputs = dict()
+    outputs = dict()
+    for op, mb in self._schedule(index):
+      if op == 'F':
+        if index == 0:
+          x = micro_batches[mb].to(device=device)
+        else:
+          x = self._receive(fwd_queues[index], stats)
+          x.requires_grad_(True)
+        y = stage(x)
+        if is_last:
+          y = self._loss_fn(y, targets[mb].to(device=device))
+          y = y / self._num_micro_batches
+          losses.append(y.detach())
+        inputs[mb] = x
+        outputs[mb] = y
+        xm.mark_step()
+        if not is_last:
+          fwd_queues[index + 1].put(y.detach().to(self._devices[index + 1]))
+      else:
+        x = inputs.pop(mb)
+        y = outputs.pop(mb)
+        if is_last:
+          torch.autograd.backward(y)
+        else:
+          torch.autograd.backward(y, self._receive(bwd_queues[index], stats))
+        xm.mark_step()
+        if index > 0:
+          bwd_queues[index - 1].put(x.grad.to(self._devices[index - 1]))
+    if optimizer is not None:
+      optimizer.step()
+      xm.mark_step()
+    stats.busy_time += (time.time() - start) - (stats.idle_time - idle_start)
+    stats.steps += 1
+
+  def _stage_runner(self, index, queues, *args):
+    try:
+      self._run_stage(index, *args)
+    except Exception as e:
+      print(
+          'Exception in pipeline stage {}: {}'.format(index, str(e)),
+          file=sys.stderr)
+      traceback.print_exc(limit=16, file=sys.stderr)
+      # Unblock the neighbour stages, which would otherwise wait forever on
+      # the values this stage is not going to produce.
+      for stage_queue in queues:
+        stage_queue.put(_StageError(index, e))
+
+  def train_step(self, data, target, optimizers=None):
+    """Runs forward and backward of one batch through the pipeline.
+
+    The gradients of the micro-batches are accumulated into the stages
+    parameters. If the optimizers are passed, they are zeroed before the step,
+    and stepped after it, by the thread of their stage.
+
+    Args:
+      data (torch.Tensor): The input batch of the first stage.
+      target (torch.Tensor): The target batch, passed to the `loss_fn`.
+      optimizers (list, optional): The optimizers of the stages, one per stage.
+        Default: None
+    Returns:
+      The loss of the batch, on the device of the last stage.
+    """
+    if optimizers is not None:
+      assert len(optimizers) == len(self._stages)
+      for optimizer in optimizers:
+        optimizer.zero_grad()
+    micro_batches = data.chunk(self._num_micro_batches)
+    targets = target.chunk(self._num_micro_batches)
+    assert len(micro_batches) == self._num_micro_batches, (
+        'The batch size must be at least the number of micro-batches')
+    fwd_queues = [queue.Queue() for _ in self._stages]
+    bwd_queues = [queue.Queue() for _ in self._stages]
+    losses = []
+    threads = []
+    for index in range(0, len(self._stages)):
+      optimizer = optimizers[index] if optimizers is not None else None
+      thread = threading.Thread(
+          target=self._stage_runner,
+          args=(index, fwd_queues + bwd_queues, micro_batches, targets,
+                optimizer, fwd_queues, bwd_queues, losses))
+      thread.daemon = True
+      thread.start()
+      threads.append(thread)
+    for thread in threads:
+      thread.join()
+    if len(losses) != self._num_micro_batches:
+      raise RuntimeError('Pipeline step failed')
+    return sum(losses)
@@ -204,6 +204,7 @@ def _prepare_env_for_index(index, pf_cfg):
   gindex = _local_index_to_global(index, pf_cfg.num_devices)
   os.environ[xenv.ORDINAL] = str(gindex)
   os.environ[xenv.LOCAL_ORDINAL] = str(index)
+  os.environ[xenv.LOCAL_WORLD_SIZE] = str(pf_cfg.num_devices)
 
   if pf_cfg.dev_kind == 'TPU':
     _setup_tpu_worker(index, gindex, pf_cfg,
@@ -331,16 +332,26 @@ class MpModelWrapper(object):
     self._model = model
     self._lock = torch.multiprocessing.Lock()
 
-  def to(self, device):
+  def to(self, device, broadcast=False):
     """Retrieves the model moved onto the specified device.
 
     Args:
       device (torch.device): The device where the model should be moved onto.
+      broadcast (bool, optional): Whether only the master ordinal should upload
+        the model weights, with the other ordinals receiving them from a device
+        side broadcast. This cuts the host upload bytes by the number of
+        replicas, but it must be called by all the replicas.
+        Default: False
     Returns:
       The model on the specified device.
     """
-    with self._lock:
-      self._model.to(device)
+    if broadcast and not xm.is_master_ordinal(local=False):
+      xm.zeros_on_device(self._model, device)
+    else:
+      with self._lock:
+        self._model.to(device)
+    if broadcast:
+      xm.broadcast_master_param(self._model)
     return self._model
 
 
@@ -0,0 +1,115 @@
+from __future__ import division
+from __future__ import print_function
+
+import torch
+import torch_xla
+
+
+class Mesh(object):
+  """A logical mesh of devices, for the tensor sharding annotations.
+
+  Args:
+    device_ids (list of int): The ordinals of the mesh devices, among the ones
+      of the tensors device type (like 3 for `TPU:3`), in mesh row-major order.
+    mesh_shape (tuple of int): The size of every axis of the mesh. The product
+      of the sizes must be the number of devices.
+  Example::
+
+    # A 2x4 mesh over 8 devices, with the model axis (of size 4) as minor one.
+    mesh = Mesh(list(range(8)), (2, 4))
+  """
+
+  def __init__(self, device_ids, mesh_shape):
+    device_ids = list(device_ids)
+    mesh_shape = tuple(mesh_shape)
+    size = 1
+    for axis_size in mesh_shape:
+      size *= axis_size
+    if size != len(device_ids):
+      raise ValueError('Mesh shape {} does not match {} devices'.format(
+          mesh_shape, len(device_ids)))
+    if len(set(device_ids)) != len(device_ids):
+      raise ValueError('Duplicated mesh devices: {}'.format(device_ids))
+    self.device_ids = device_ids
+    self.mesh_shape = mesh_shape
+
+  def size(self):
+    return len(self.device_ids)
+
+  def get_tile_assignment(self, partition_spec):
+    """Returns the tile dimensions and devices of a partition spec.
+
+    The partitions are the positions of the devices within the mesh, so the
+    tile devices index `device_ids`. An empty tile dimensions list means a
+    replicated tensor.
+    """
+    mapped_axes = [axis for axis in partition_spec if axis is not None]
+    if len(set(mapped_axes)) != len(mapped_axes):
+      raise ValueError(
+          'Mesh axes used more than once in {}'.format(partition_spec))
+    for axis in mapped_axes:
+      if axis < 0 or axis >= len(self.mesh_shape):
+        raise ValueError('Invalid mesh axis {} for mesh shape {}'.format(
+            axis, self.mesh_shape))
+    unmapped_axes = [
+        axis for axis in range(len(self.mesh_shape)) if axis not in mapped_axes
+    ]
+    if not mapped_axes:
+      return [], []
+    for axis in unmapped_axes:
+      if self.mesh_shape[axis] > 1:
+        raise ValueError(
+            'Partial replication is not supported: mesh axis {} of size {} is '
+            'not used by {}'.format(axis, self.mesh_shape[axis],
+                                    partition_spec))
+    tile_dims = [
+        self.mesh_shape[axis] if axis is not None else 1
+        for axis in partition_spec
+    ]
+    partitions = torch.arange(self.size()).reshape(self.mesh_shape)
+    tile_devices = partitions.permute(mapped_axes + unmapped_axes).reshape(
+        tile_dims).flatten().tolist()
+    return tile_dims, tile_devices
+
+
+def mark_sharding(t, mesh, partition_spec):
+  """Splits an XLA tensor across the devices of a mesh.
+
+  The graphs computing or reading sharded tensors are compiled once for the
+  whole mesh, with the XLA SPMD partitioner, which inserts the collectives
+  the partitioned computation needs, and run on all the mesh devices. The
+  other tensors of such graphs are replicated on all the devices. A tensor
+  already holding device data is split right away, while one with a pending
+  computation gets split by the graph materializing it. Reading a sharded
+  tensor gathers its shards on the host.
+
+  Args:
+    t (torch.Tensor): The XLA tensor to be sharded.
+    mesh (Mesh): The mesh of devices the tensor is split across.
+    partition_spec (tuple): The mesh axis every tensor dimension is split
+      along, or `None` for the dimensions which are not split. Every mesh axis
+      of size greater than one must be used. A spec with only `None` entries
+      replicates the tensor on all the mesh devices.
+  Example::
+
+    mesh = Mesh(list(range(4)), (1, 4))
+    # Splits the output features of a linear layer across 4 devices.
+    mark_sharding(linear.weight, mesh, (1, None))
+  """
+  partition_spec = tuple(partition_spec)
+  if len(partition_spec) != t.dim():
+    raise ValueError('Partition spec {} does not match a {}D tensor'.format(
+        partition_spec, t.dim()))
+  tile_dims, tile_devices = mesh.get_tile_assignment(partition_spec)
+  torch_xla._XLAC._xla_mark_sharding(t, tile_dims, tile_devices,
+                                     mesh.device_ids)
+
+
+def clear_sharding(t):
+  """Removes the sharding of an XLA tensor, gathering it on its device."""
+  torch_xla._XLAC._xla_clear_sharding(t)
+
+
+def get_sharding_spec(t):
+  """Returns a description of the sharding of a tensor, or an empty string."""
+  return torch_xla._XLAC._get_xla_sharding_spec(t)
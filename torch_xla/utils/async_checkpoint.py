@@ -0,0 +1,129 @@
+from __future__ import division
+from __future__ import print_function
+
+import io
+import os
+import threading
+import torch
+import torch_xla
+import torch_xla.core.xla_model as xm
+import torch_xla.utils.gcsfs as gcsfs
+import torch_xla.utils.utils as xu
+
+
+class _TensorReference(object):
+
+  def __init__(self, index):
+    self.index = index
+
+
+def _is_xla_tensor(v):
+  return type(v) == torch.Tensor and xm.is_xla_tensor(v)
+
+
+def _write_data(data, path):
+  if path.startswith(gcsfs.CLOUD_STORAGE_PREFIX):
+    bio = io.BytesIO()
+    torch.save(data, bio)
+    gcsfs.write(path, bio.getvalue())
+  else:
+    # Write to a temporary file first, so that a crash in the middle of the
+    # write does not corrupt a previous checkpoint with the same path.
+    tmp_path = '{}.tmp.{}'.format(path, os.getpid())
+    torch.save(data, tmp_path)
+    os.replace(tmp_path, path)
+
+
+class AsyncCheckpointer(object):
+  """Saves checkpoints without blocking the training loop.
+
+  The `save()` API snapshots the device data of the XLA tensors within the
+  saved data, and returns right away. The data is fetched to host in the
+  background, in parallel chunks, and then serialized and written (to local or
+  GCS storage) by a writer thread, while the following training steps proceed.
+  The execution of the following steps on device waits until the snapshotted
+  data has been fetched, so that their in-place updates do not overwrite it.
+
+  Args:
+    max_pending (int, optional): The maximum number of saves which can be in
+      flight. A `save()` call exceeding it waits for the oldest one to complete.
+      Default: 1
+  """
+
+  def __init__(self, max_pending=1):
+    assert max_pending > 0, max_pending
+    self._max_pending = max_pending
+    self._pending = []
+    self._lock = threading.Lock()
+
+  def _writer(self, fetch, ref_data, path, state):
+    try:
+      cpu_tensors = []
+      if fetch is not None:
+        cpu_tensors = torch_xla._XLAC._xla_wait_fetch(fetch)
+      data = xu.for_each_instance_rewrite(
+          ref_data, lambda v: isinstance(v, _TensorReference),
+          lambda r: cpu_tensors[r.index])
+      _write_data(data, path)
+    except Exception as e:
+      state['error'] = e
+
+  def save(self, data, path, master_only=True, global_master=False):
+    """Schedules the save of the input data into a file.
+
+    Args:
+      data: The input data to be saved, like in `xla_model.save()`.
+      path (string): The destination file. Paths starting with "gs://" are
+        written to Google Cloud Storage.
+      master_only (bool, optional): Whether only the master device should save
+        the data. If False, the `path` argument should be a different path for
+        each of the ordinals taking part to the replication.
+        Default: True
+      global_master (bool, optional): When ``master_only`` is ``True`` this
+        flag controls whether every host's master (if ``global_master`` is
+        ``False``) saves the content, or only the global master (ordinal 0).
+        Default: False
+    """
+    should_write_data = not master_only or xm.is_master_ordinal(
+        local=not global_master)
+    fetches = []
+
+    def convert_fn(tensors):
+      if not should_write_data:
+        # The replicas which do not write still need to sync the same tensors,
+        # to keep the executed graphs in lockstep.
+        torch_xla._XLAC._xla_sync_multi(
+            tensors, devices=[], wait=False, sync_xla_data=True)
+      else:
+        fetches.append(torch_xla._XLAC._xla_fetch_tensors_async(tensors))
+      return [_TensorReference(i) for i in range(len(tensors))]
+
+    ref_data = xm.ToXlaTensorArena(convert_fn, _is_xla_tensor).transform(data)
+    if not should_write_data:
+      return
+    while len(self._pending) >= self._max_pending:
+      self._wait_oldest()
+    # No fetch is issued if the data contains no XLA tensors.
+    fetch = fetches[0] if fetches else None
+    state = dict()
+    thread = threading.Thread(
+        target=self._writer, args=(fetch, ref_data, path, state), daemon=True)
+    thread.start()
+    with self._lock:
+      self._pending.append((thread, state))
+
+  def _wait_oldest(self):
+    with self._lock:
+      thread, state = self._pending.pop(0)
+    thread.join()
+    error = state.get('error', None)
+    if error is not None:
+      raise error
+
+  def wait(self):
+    """Waits for all the scheduled saves to complete.
+
+    Raises the exception of the first failed save, if any.
+    """
+    while self._pending:
+      self._wait_oldest()
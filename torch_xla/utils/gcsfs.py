@@ -14,6 +14,10 @@ import torch_xla
 GcsBlob = collections.namedtuple('GcsBlob', 'path size mtime isdir')
 
 CLOUD_STORAGE_PREFIX = 'gs://'
+# The size of the reads issued by the GCS file objects, which the native layer
+# splits into parallel ranged reads (see XLA_TFFILE_READ_STRIPE_SIZE).
+_READ_BUFFER_SIZE = 64 * 1024 * 1024
+_WRITE_CHUNK_SIZE = 16 * 1024 * 1024
 
 
 def _mkblob(path, fstat):
@@ -30,6 +34,96 @@ def _slurp_file(path):
   return torch_xla._XLAC._xla_tffile_read(gcs_file, 0, fstat['length'])
 
 
+class ReadableFile(io.RawIOBase):
+  """Streams the content of a GCS blob with parallel ranged reads."""
+
+  def __init__(self, path):
+    super(ReadableFile, self).__init__()
+    self._path = path
+    self._size = torch_xla._XLAC._xla_tffile_stat(path)['length']
+    self._rfile = torch_xla._XLAC._xla_tffile_open(path)
+    self._offset = 0
+
+  def close(self):
+    self._rfile = None
+    super(ReadableFile, self).close()
+
+  def readable(self):
+    return True
+
+  def seekable(self):
+    return True
+
+  def tell(self):
+    return self._offset
+
+  def seek(self, offset, whence=os.SEEK_SET):
+    if whence == os.SEEK_CUR:
+      offset += self._offset
+    elif whence == os.SEEK_END:
+      offset += self._size
+    self._offset = max(offset, 0)
+    return self._offset
+
+  def _read_range(self, size):
+    size = max(min(size, self._size - self._offset), 0)
+    if size == 0:
+      return b''
+    data = torch_xla._XLAC._xla_tffile_read(self._rfile, self._offset, size)
+    self._offset += size
+    return data
+
+  def readall(self):
+    return self._read_range(self._size - self._offset)
+
+  def readinto(self, bbuf):
+    data = self._read_range(len(bbuf))
+    bbuf[:len(data)] = data
+    return len(data)
+
+
+class StreamingWriteFile(io.RawIOBase):
+  """Writes a GCS blob by streaming chunks of data to the native file."""
+
+  def __init__(self, path, encoding=None):
+    super(StreamingWriteFile, self).__init__()
+    self._path = path
+    self._encoding = encoding
+    self._wfile = torch_xla._XLAC._xla_tffile_create(path)
+    self._buffer = bytearray()
+
+  def close(self):
+    if self._wfile is not None:
+      self._write_buffer()
+      torch_xla._XLAC._xla_tffile_flush(self._wfile)
+      self._wfile = None
+    super(StreamingWriteFile, self).close()
+
+  def _write_buffer(self):
+    if self._buffer:
+      torch_xla._XLAC._xla_tffile_write(self._wfile, bytes(self._buffer))
+      self._buffer = bytearray()
+
+  def writable(self):
+    return True
+
+  def _get_bytes(self, data):
+    return data.encode(self._encoding) if isinstance(data, str) else data
+
+  def write(self, bbuf):
+    data = self._get_bytes(bbuf)
+    self._buffer += data
+    if len(self._buffer) >= _WRITE_CHUNK_SIZE:
+      self._write_buffer()
+    return len(data)
+
+  def __enter__(self):
+    return self
+
+  def __exit__(self, type, value, traceback):
+    self.close()
+
+
 class WriteableFile(io.RawIOBase):
 
   def __init__(self, path, init_data=None, append=False, encoding=None):
@@ -51,7 +145,7 @@ class WriteableFile(io.RawIOBase):
     self._wfile.flush()
     offset = self._wfile.tell()
     self._wfile.seek(0, os.SEEK_SET)
-    write(self._path, self._wfile.read())
+    write(self._path, self._wfile)
     self._wfile.seek(offset, os.SEEK_SET)
 
   def _get_bytes(self, data):
@@ -136,7 +230,7 @@ def open(path, mode='r', encoding=None):
   if encoding is None:
     encoding = locale.getpreferredencoding()
   if mode.startswith('w'):
-    return WriteableFile(path, encoding=encoding)
+    return StreamingWriteFile(path, encoding=encoding)
   if mode.startswith('a') or mode.startswith('r+'):
     try:
       data = _slurp_file(path)
@@ -144,10 +238,10 @@ def open(path, mode='r', encoding=None):
       data = None
     return WriteableFile(
         path, init_data=data, append=mode.startswith('a'), encoding=encoding)
-  data = _slurp_file(path)
+  rfile = io.BufferedReader(ReadableFile(path), buffer_size=_READ_BUFFER_SIZE)
   if binary:
-    return io.BytesIO(data)
-  return io.StringIO(data.decode(encoding))
+    return rfile
+  return io.TextIOWrapper(rfile, encoding=encoding)
 
 
 def list(path):
@@ -244,10 +338,15 @@ def write(path, content):
     content (string, bytes or file object): The content to be written into
       ``path``.
   """
-  if not isinstance(content, (bytes, str)):
-    content = content.read()
   gcs_file = torch_xla._XLAC._xla_tffile_create(path)
-  torch_xla._XLAC._xla_tffile_write(gcs_file, content)
+  if isinstance(content, (bytes, str)):
+    torch_xla._XLAC._xla_tffile_write(gcs_file, content)
+  else:
+    while True:
+      data = content.read(_WRITE_CHUNK_SIZE)
+      if not data:
+        break
+      torch_xla._XLAC._xla_tffile_write(gcs_file, data)
   torch_xla._XLAC._xla_tffile_flush(gcs_file)
 
 
@@ -0,0 +1,114 @@
+from __future__ import division
+from __future__ import print_function
+
+import numpy as np
+import torch
+
+
+class ToUint8HWC(object):
+  """Converts a PIL image into a `uint8` HWC tensor.
+
+  Unlike `torchvision.transforms.ToTensor()`, it leaves the data as `uint8`, so
+  that the batches sent to the device are one fourth of the size of the `float`
+  ones. It is meant to be the last host transform of a dataset whose batches
+  are processed by a `DeviceImageAugment` object.
+  """
+
+  def __call__(self, image):
+    return torch.from_numpy(np.array(image, dtype=np.uint8, copy=True))
+
+
+class DeviceImageAugment(object):
+  """Augments and normalizes `uint8` NHWC image batches on device.
+
+  The random crop, horizontal flip, `uint8` to floating point conversion and
+  normalization steps are all expressed as tensor operations over the batch
+  (with per sample random values), so they get lowered to IR and fused within
+  the training step graph, instead of running on the host data loader CPUs.
+  Example::
+
+    augment = DeviceImageAugment(224, mean=[0.485, 0.456, 0.406],
+                                 std=[0.229, 0.224, 0.225])
+    for data, target in loader:
+      output = model(augment(data))
+
+  Args:
+    crop_size (int or tuple): The `(height, width)` of the output images.
+    mean (list): The per channel mean used to normalize the `[0, 1]` values.
+    std (list): The per channel standard deviation used to normalize the
+      `[0, 1]` values.
+    train (bool, optional): Whether the random crop and flip should be applied.
+      If `False` the images are center cropped.
+      Default: True
+    flip (bool, optional): Whether the images should be randomly flipped
+      horizontally in training mode.
+      Default: True
+    dtype (torch.dtype, optional): The floating point type of the output.
+      Default: torch.float32
+  """
+
+  def __init__(self,
+               crop_size,
+               mean,
+               std,
+               train=True,
+               flip=True,
+               dtype=torch.float32):
+    if isinstance(crop_size, int):
+      crop_size = (crop_size, crop_size)
+    self._crop_size = tuple(crop_size)
+    self._train = train
+    self._flip = flip
+    self._dtype = dtype
+    std = torch.tensor(std, dtype=torch.float32)
+    mean = torch.tensor(mean, dtype=torch.float32)
+    # Fold the 1/255 scaling and the normalization into one multiply-add.
+    self._scale = (1.0 / (255.0 * std)).view(1, -1, 1, 1)
+    self._bias = (-mean / std).view(1, -1, 1, 1)
+    self._device_params = dict()
+
+  def _get_device_params(self, device):
+    params = self._device_params.get(device, None)
+    if params is None:
+      params = (self._scale.to(device=device, dtype=self._dtype),
+                self._bias.to(device=device, dtype=self._dtype))
+      self._device_params[device] = params
+    return params
+
+  def _crop_offsets(self, batch_size, size, crop_size, device):
+    if self._train:
+      return torch.randint(
+          0, size - crop_size + 1, (batch_size,), device=device)
+    return torch.full((batch_size,), (size - crop_size) // 2,
+                      dtype=torch.int64,
+                      device=device)
+
+  def _crop(self, images):
+    n, c, h, w = images.size()
+    ch, cw = self._crop_size
+    assert ch <= h and cw <= w, 'Crop size {} larger than image size {}'.format(
+        self._crop_size, (h, w))
+    device = images.device
+    rows = self._crop_offsets(n, h, ch, device).view(n, 1) + torch.arange(
+        ch, device=device).view(1, ch)
+    images = torch.gather(images, 2, rows.view(n, 1, ch, 1).expand(n, c, ch, w))
+    cols = self._crop_offsets(n, w, cw, device).view(n, 1) + torch.arange(
+        cw, device=device).view(1, cw)
+    return torch.gather(images, 3,
+                        cols.view(n, 1, 1, cw).expand(n, c, ch, cw))
+
+  def __call__(self, images):
+    """Augments a batch of images.
+
+    Args:
+      images (torch.Tensor): The `uint8` NHWC images batch, already on device.
+    Returns:
+      The NCHW augmented images, in the floating point type selected at
+      construction.
+    """
+    images = self._crop(images.permute(0, 3, 1, 2))
+    if self._train and self._flip:
+      flip = torch.rand(images.size(0), device=images.device) < 0.5
+      images = torch.where(flip.view(-1, 1, 1, 1), images.flip(3), images)
+    scale, bias = self._get_device_params(images.device)
+    return images.to(self._dtype) * scale + bias
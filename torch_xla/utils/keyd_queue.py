@@ -1,86 +1,52 @@
 from __future__ import print_function
 
-import collections
-import threading
+import torch_xla
 
 
 class QueueBase(object):
+  """Base of the bounded queues, which are implemented natively.
 
-  def __init__(self, maxsize=1024):
+  The waits on the queues happen with the Python GIL released, and the items
+  are handed over between the threads without touching the Python objects.
+  """
+
+  def __init__(self, queue, maxsize):
+    self._queue = queue
     self._maxsize = maxsize
-    self._lock = threading.Lock()
-    self._ready_cv = threading.Condition(self._lock)
-    self._space_available_cv = threading.Condition(self._lock)
-    self._close_read = False
-    self._close_write = False
 
   def max_size(self):
     return self._maxsize
 
   def close(self):
-    with self._lock:
-      self._close_read = True
-      self._close_write = True
-      self._ready_cv.notify_all()
-      self._space_available_cv.notify_all()
+    torch_xla._XLAC._xla_queue_close(self._queue)
 
   def close_write(self):
-    with self._lock:
-      self._close_write = True
-      self._ready_cv.notify_all()
+    torch_xla._XLAC._xla_queue_close_write(self._queue)
 
 
 class KeydQueue(QueueBase):
+  """A queue whose items are stored, and retrieved, with integer keys."""
 
   def __init__(self, maxsize=1024):
-    super(KeydQueue, self).__init__(maxsize=maxsize)
-    self._items = dict()
-    self._waited_keys = set()
+    super(KeydQueue, self).__init__(
+        torch_xla._XLAC._xla_create_keyd_queue(maxsize), maxsize)
 
   def put(self, key, item):
-    with self._lock:
-      # Wait for space available, unless there is a waiter for the incoming
-      # key.
-      while (len(self._items) >= self._maxsize and
-             key not in self._waited_keys and not self._close_read):
-        self._space_available_cv.wait()
-      if not self._close_read:
-        self._items[key] = item
-        if key in self._waited_keys:
-          self._ready_cv.notify_all()
+    # Waits for space available, unless there is a waiter for the incoming key.
+    torch_xla._XLAC._xla_keyd_queue_put(self._queue, key, item)
 
   def get(self, key):
-    with self._lock:
-      while key not in self._items and not self._close_write:
-        self._waited_keys.add(key)
-        self._space_available_cv.notify_all()
-        self._ready_cv.wait()
-        self._waited_keys.discard(key)
-      item = self._items.pop(key, None)
-      if item is not None:
-        self._space_available_cv.notify()
-      return item
+    return torch_xla._XLAC._xla_keyd_queue_get(self._queue, key)
 
 
 class Queue(QueueBase):
 
   def __init__(self, maxsize=1024):
-    super(Queue, self).__init__(maxsize=maxsize)
-    self._items = collections.deque()
+    super(Queue, self).__init__(
+        torch_xla._XLAC._xla_create_queue(maxsize), maxsize)
 
   def put(self, item):
-    with self._lock:
-      while (len(self._items) >= self._maxsize and not self._close_read):
-        self._space_available_cv.wait()
-      if not self._close_read:
-        self._items.append(item)
-        self._ready_cv.notify()
+    torch_xla._XLAC._xla_queue_put(self._queue, item)
 
   def get(self):
-    with self._lock:
-      while not self._items and not self._close_write:
-        self._ready_cv.wait()
-      item = self._items.popleft() if self._items else None
-      if item is not None:
-        self._space_available_cv.notify()
-      return item
+    return torch_xla._XLAC._xla_queue_get(self._queue)
@@ -1,10 +1,12 @@
 from __future__ import division
 from __future__ import print_function
 
+import io
 import os
 
 import torch
 import torch_xla
+import torch_xla.utils.gcsfs as gcsfs
 import torch_xla.utils.utils as xu
 import torch_xla.core.xla_model as xm
 
@@ -98,3 +100,99 @@ def load(path):
     return type(v) == TensorReference
 
   return xm.ToXlaTensorArena(convert_fn, select_fn).transform(ref_data)
+
+
+def _get_structure_file(path):
+  return os.path.join(path, 'structure.pt')
+
+
+def _write_bytes(path, data):
+  if path.startswith(gcsfs.CLOUD_STORAGE_PREFIX):
+    gcsfs.write(path, data)
+  else:
+    with open(path, 'wb') as fd:
+      fd.write(data)
+
+
+def _read_bytes(path):
+  if path.startswith(gcsfs.CLOUD_STORAGE_PREFIX):
+    return gcsfs.read(path)
+  with open(path, 'rb') as fd:
+    return fd.read()
+
+
+def save_sharded(data, path, num_shards=8, master_only=True,
+                 global_master=False):
+  """Saves the input data into a native sharded checkpoint.
+
+  The tensors are written as raw data blobs into `num_shards` shard files
+  (written in parallel), described by a flat index file, while the rest of the
+  data is saved with `torch.save()`. Unlike the `save()` API, the checkpoint
+  can then be restored directly to device with the `load_sharded()` API.
+
+  Args:
+    data: The input data to be saved. Any nested combination of Python objects
+      (list, tuples, sets, dicts, ...).
+    path: The destination folder for the checkpoint. Both local and GCS
+      ("gs://BUCKET_NAME/PATH") paths are supported.
+    num_shards (int, optional): The number of shard files the tensors data is
+      spread over.
+      Default: 8
+    master_only (bool, optional): Whether only the master device should save the
+      data, like in the `save()` API.
+      Default: True
+    global_master (bool, optional): When ``master_only`` is ``True`` this flag
+      controls whether every host's master (if ``global_master`` is ``False``)
+      saves the content, or only the global master (ordinal 0).
+      Default: False
+  """
+  should_write_data = not master_only or xm.is_master_ordinal(
+      local=not global_master)
+  names = []
+  xtensors = []
+
+  def convert_fn(tensors):
+    torch_xla._XLAC._xla_sync_multi(
+        tensors, devices=[], wait=True, sync_xla_data=True)
+    names.extend(str(i) for i in range(len(tensors)))
+    xtensors.extend(tensors)
+    return [TensorReference(i) for i in range(len(tensors))]
+
+  def select_fn(v):
+    return type(v) == torch.Tensor and xm.is_xla_tensor(v)
+
+  ref_data = xm.ToXlaTensorArena(convert_fn, select_fn).transform(data)
+  if should_write_data:
+    torch_xla._XLAC._xla_save_tensor_checkpoint(path, names, xtensors,
+                                                num_shards)
+    bio = io.BytesIO()
+    torch.save(ref_data, bio)
+    _write_bytes(_get_structure_file(path), bio.getvalue())
+  xm.rendezvous('torch_xla.utils.serialization.save_sharded')
+
+
+def load_sharded(path, device=None):
+  """Loads data previously saved with the `save_sharded()` API.
+
+  The tensors data is read in parallel from the shard files, and uploaded
+  directly to device, without creating intermediate CPU tensors.
+
+  Args:
+    path (str): The path passed to the `save_sharded()` API.
+    device (torch.device, optional): The XLA device the tensors should be
+      restored onto. If missing, the current default device is used.
+  Returns:
+    The loaded data.
+  """
+  ref_data = torch.load(io.BytesIO(_read_bytes(_get_structure_file(path))))
+  names, tensors = torch_xla._XLAC._xla_load_tensor_checkpoint(
+      path, str(device) if device is not None else '')
+  tensors_map = dict(zip(names, tensors))
+
+  def convert_fn(refs):
+    return [tensors_map[str(r.tid)] for r in refs]
+
+  def select_fn(v):
+    return type(v) == TensorReference
+
+  return xm.ToXlaTensorArena(convert_fn, select_fn).transform(ref_data)
@@ -0,0 +1,71 @@
+from __future__ import division
+from __future__ import print_function
+
+import random
+import torch_xla
+
+
+def write_tensor_shard(path, columns):
+  """Writes a tensor shard file, readable with :class:`TensorShardReader`.
+
+  Args:
+    path (string): The path of the shard file.
+    columns (list): The list of the CPU tensors to store. All the tensors must
+      have the same first dimension size, which is the number of records, and
+      the record `i` is made of the `column[i]` values of every column.
+  """
+  torch_xla._XLAC._xla_write_tensor_shard(path, list(columns))
+
+
+class TensorShardReader(object):
+  """Reads the batches of a tensor shard file, as views over its mapping.
+
+  The file is memory mapped, and every batch of consecutive records is
+  returned as a list of CPU tensors (one per column) pointing to the mapping,
+  without being parsed nor copied. Moving them to the device (like the
+  `ParallelLoader` does) copies them straight into the transfer buffers.
+
+  Args:
+    path (string): The path of the shard file written by
+      :func:`write_tensor_shard`.
+    batch_size (int): The number of records per batch.
+    drop_last (bool, optional): Whether to drop the last batch, if smaller
+      than `batch_size`.
+      Default: False
+    shuffle (bool, optional): Whether to iterate the batches in a random order.
+      The records within the batches are not shuffled, as they need to be
+      consecutive within the mapping.
+      Default: False
+    seed (int, optional): The seed used to shuffle the batches.
+      Default: 0
+  """
+
+  def __init__(self, path, batch_size, drop_last=False, shuffle=False, seed=0):
+    self._shard = torch_xla._XLAC._xla_open_tensor_shard(path)
+    self._num_records = torch_xla._XLAC._xla_tensor_shard_num_records(
+        self._shard)
+    self._batch_size = batch_size
+    self._drop_last = drop_last
+    self._shuffle = shuffle
+    self._rng = random.Random(seed)
+
+  @property
+  def num_records(self):
+    return self._num_records
+
+  def __len__(self):
+    if self._drop_last:
+      return self._num_records // self._batch_size
+    return (self._num_records + self._batch_size - 1) // self._batch_size
+
+  def read_batch(self, start, count):
+    """Returns the views of the `[start, start + count)` records, per column."""
+    return torch_xla._XLAC._xla_tensor_shard_batch(self._shard, start, count)
+
+  def __iter__(self):
+    starts = [i * self._batch_size for i in range(0, len(self))]
+    if self._shuffle:
+      self._rng.shuffle(starts)
+    for start in starts:
+      count = min(self._batch_size, self._num_records - start)
+      yield self.read_batch(start, count)
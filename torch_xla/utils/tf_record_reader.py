@@ -1,6 +1,7 @@
 from __future__ import division
 from __future__ import print_function
 
+import torch
 import torch_xla
 
 
@@ -8,7 +9,8 @@ class TfRecordReader(object):
   """Reads TfRecords or TfExamples.
 
   Args:
-    path (string): The path to the file containing TfRecords.
+    path (string or list): The path to the file containing TfRecords, or a list
+      of paths of TfRecord shards, which are read as a single stream.
     compression (string, optional): The compression type. The empty string for
       no compression, otherwise ``ZLIB`` or ``GZIP``.
       Default: No compression.
@@ -19,15 +21,38 @@ class TfRecordReader(object):
       TfExample label name, and value which is either a callable which will be
       called to tranform the matching tensor data, or ``STR`` for string
       conversion.
+    num_readers (int, optional): The number of background threads reading the
+      shards, each one a different shard, with their records interleaved. Zero
+      means the records are read by the threads calling the read APIs.
+      Default: 0
+    prefetch_size (int, optional): The maximum number of records the background
+      readers can queue ahead of the consumer.
+      Default: 1024
+    shuffle_size (int, optional): The size of the buffer the returned records
+      are randomly sampled from. Zero disables the shuffling.
+      Default: 0
+    seed (int, optional): The seed used to shuffle the records.
+      Default: 0
   """
 
   def __init__(self,
                path,
                compression='',
                buffer_size=16 * 1024 * 1024,
-               transforms=None):
+               transforms=None,
+               num_readers=0,
+               prefetch_size=1024,
+               shuffle_size=0,
+               seed=0):
+    paths = [path] if isinstance(path, str) else list(path)
     self._reader = torch_xla._XLAC._xla_create_tfrecord_reader(
-        path, compression=compression, buffer_size=buffer_size)
+        paths,
+        compression=compression,
+        buffer_size=buffer_size,
+        num_readers=num_readers,
+        prefetch_size=prefetch_size,
+        shuffle_size=shuffle_size,
+        seed=seed)
     self._transforms = transforms
 
   def read_record(self):
@@ -51,14 +76,113 @@ class TfRecordReader(object):
       return ex
     return self._transform_example(ex)
 
+  def read_examples(self, max_examples):
+    """Reads a batch of TfExamples.
+
+    The examples are parsed into tensors without holding the Python GIL.
+
+    Args:
+      max_examples (int): The maximum number of examples to be read.
+
+    Returns:
+      A list of up to `max_examples` examples, in the same format returned by
+      `read_example()`. The list is shorter only at EOF.
+    """
+    exs = torch_xla._XLAC._xla_tfexample_read_batch(self._reader, max_examples)
+    if self._transforms is None:
+      return exs
+    return [self._transform_example(ex) for ex in exs]
+
   def _transform_example(self, ex):
-    for lbl, data in ex.items():
-      trs = self._transforms.get(lbl, None)
-      if trs is not None:
-        if callable(trs):
-          ex[lbl] = trs(data)
-        elif trs == 'STR':
-          ex[lbl] = data.numpy().tobytes().decode('ascii')
-        else:
-          raise RuntimeError('Invalid transform: {}'.format(trs))
-    return ex
+    return _transform_example(ex, self._transforms)
+
+
+class IndexedTfRecordReader(object):
+  """Reads TfRecords or TfExamples at arbitrary positions.
+
+  Every shard gets an index of its record offsets, stored next to it in a
+  sidecar file (with the ``.index`` suffix), which is built with a sequential
+  scan of the shard the first time it is opened. The records are then read
+  with parallel positional reads, which allows exact global shuffles of the
+  whole dataset without shuffle buffers. Only uncompressed shards are
+  supported.
+
+  Args:
+    path (string or list): The path to the file containing TfRecords, or a list
+      of paths of TfRecord shards. The records of the shards are numbered in
+      order.
+    num_threads (int, optional): The maximum number of parallel reads.
+      Default: 8
+    transforms (dict, optional): The example transforms, like in
+      :class:`TfRecordReader`.
+  """
+
+  def __init__(self, path, num_threads=8, transforms=None):
+    paths = [path] if isinstance(path, str) else list(path)
+    self._reader = torch_xla._XLAC._xla_create_indexed_record_reader(
+        paths, num_threads=num_threads)
+    self._transforms = transforms
+
+  @property
+  def num_records(self):
+    return torch_xla._XLAC._xla_indexed_record_reader_num_records(self._reader)
+
+  def read_records(self, indices):
+    """Reads the raw bytes of the TfRecords with the given indices.
+
+    Args:
+      indices (list): The global indices of the records to be read.
+
+    Returns:
+      The list of the raw bytes of the records.
+    """
+    return torch_xla._XLAC._xla_indexed_record_read_at(self._reader,
+                                                       list(indices))
+
+  def read_examples(self, indices):
+    """Reads the TfExamples with the given indices.
+
+    Args:
+      indices (list): The global indices of the examples to be read.
+
+    Returns:
+      The list of the examples, in the same format returned by
+      `TfRecordReader.read_example()`.
+    """
+    exs = torch_xla._XLAC._xla_indexed_example_read_at(self._reader,
+                                                       list(indices))
+    if self._transforms is None:
+      return exs
+    return [_transform_example(ex, self._transforms) for ex in exs]
+
+  def shuffled_examples(self, batch_size, seed=0):
+    """Iterates over batches of examples, in a global random order.
+
+    Args:
+      batch_size (int): The number of examples per batch (the last batch can
+        be smaller).
+      seed (int, optional): The seed of the permutation, which should change
+        every epoch.
+        Default: 0
+
+    Returns:
+      A generator of lists of examples.
+    """
+    generator = torch.Generator()
+    generator.manual_seed(seed)
+    order = torch.randperm(self.num_records, generator=generator)
+    for start in range(0, order.numel(), batch_size):
+      yield self.read_examples(order[start:start + batch_size].tolist())
+
+
+def _transform_example(ex, transforms):
+  for lbl, data in ex.items():
+    trs = transforms.get(lbl, None)
+    if trs is not None:
+      if callable(trs):
+        ex[lbl] = trs(data)
+      elif trs == 'STR':
+        ex[lbl] = data.numpy().tobytes().decode('ascii')
+      else:
+        raise RuntimeError('Invalid transform: {}'.format(trs))
+  return ex